@@ -42,6 +42,9 @@ struct holos_cli_options {
 	char *subcommand;
 	char **args;
 	int arg_count;
+	char *batch_file;                        /* Script of commands, "-" for stdin */
+	int jobs;                                /* Batch commands run at once */
+	int threads;                             /* Threads of the holos_exec pool (0: one per CPU) */
 };
 
 /* Callback type for subcommand handlers */
@@ -0,0 +1,107 @@
+/* ai_int8.h - INT8 quantized layers of the AI models for HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+   Post-training quantization for inference:
+   - weights are int8, symmetric per output channel: w = scale[o] q
+   - activations are uint8 per tensor with a zero point: x = s (q - z),
+     the range taken from a calibration set (and always holding 0)
+   A layer is then y[o] = s scale[o] (sum_k q_w q_x - z sum_k q_w) + b[o]:
+   one int32 dot product per output (u8 x s8, what AVX-512 VNNI vpdpbusd
+   and the AArch64 dot-product instructions compute), with the zero
+   point correction, bias, activation and requantization to the next
+   layer's uint8 fused into the store.
+
+   Rows of weights and activations are zero padded to AI_I8_PAD bytes,
+   so the SIMD paths need no tails.
+*/
+
+#ifndef HOLOS_AI_INT8_H
+#define HOLOS_AI_INT8_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define AI_I8_PAD 64        /* row stride multiple, in bytes */
+
+/* Instruction set of the int8 dot products. */
+typedef enum {
+   AI_I8_ISA_AUTO = 0,      /* best available on this CPU */
+   AI_I8_ISA_SCALAR,        /* portable C */
+   AI_I8_ISA_AVX2,          /* x86-64 AVX2, widened to 16-bit madd */
+   AI_I8_ISA_AVX512_VNNI,   /* x86-64 AVX-512 VNNI vpdpbusd */
+   AI_I8_ISA_NEON_DOT       /* AArch64 sdot */
+} ai_i8_isa_t;
+
+/* uint8 quantization of a tensor: x = scale (q - zero). */
+typedef struct {
+   float scale;
+   int32_t zero;
+} ai_u8_quant_t;
+
+/* Quantized dense map of in inputs to out outputs. */
+typedef struct {
+   size_t in, out;
+   size_t stride;            /* row length of w, in padded to AI_I8_PAD */
+   int8_t *w;                /* out x stride */
+   float *scale;             /* out */
+   int32_t *wsum;            /* out, sum of each row of w */
+   float *bias;              /* out */
+} ai_i8_linear_t;
+
+/* Output activation of a layer */
+typedef enum {
+   AI_I8_LINEAR,
+   AI_I8_TANH
+} ai_i8_act_t;
+
+static inline size_t ai_i8_stride(size_t n) {
+   return (n + AI_I8_PAD - 1) / AI_I8_PAD * AI_I8_PAD;
+}
+
+/* Quantization of the range [lo, hi] (widened to hold 0). */
+ai_u8_quant_t ai_u8_range(double lo, double hi);
+
+/* q[k] = round(x[k] / scale) + zero, clamped to 0..255. */
+void ai_u8_quantize(const double *x, size_t n, ai_u8_quant_t q, uint8_t *out);
+
+/* Quantize the out x in weights w (row-major, doubles, or floats when
+   w is NULL) and biases into lin. Returns 0 or -1. */
+int ai_i8_linear_init(ai_i8_linear_t *lin, size_t out, size_t in, const double *w, const float *wf, const double *b,
+                      const float *bf);
+void ai_i8_linear_free(ai_i8_linear_t *lin);
+
+/* For rows rows of x (stride lin->stride, quantized by xq): each
+   output through act, then stored as uint8 by yq at y (row stride
+   y_stride), or as doubles at yd (row stride lin->out) when yd is set.
+   ychan, if not 0, stores output o of row r at y[o * ychan + r]
+   instead (channel-major maps). */
+void ai_i8_linear_forward(const ai_i8_linear_t *lin, const uint8_t *x, size_t rows, ai_u8_quant_t xq, ai_i8_act_t act,
+                          ai_u8_quant_t yq, uint8_t *y, size_t y_stride, double *yd, size_t ychan);
+
+/* Force a specific instruction set (falls back to scalar if unsupported). */
+void ai_i8_set_isa(ai_i8_isa_t isa);
+
+/* Instruction set the dot products currently dispatch to. */
+ai_i8_isa_t ai_i8_active_isa(void);
+
+/* Human-readable name of an instruction set. */
+const char *ai_i8_isa_name(ai_i8_isa_t isa);
+
+#endif /* HOLOS_AI_INT8_H */
@@ -0,0 +1,88 @@
+/* ai_model.h - Memory-mapped model files of the AI models for HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+   One container for the parameters of every model: a 64-byte header
+   (the model's magic and file version, the container format, the file
+   size), the model's shape as u64 metadata, a table of tensors (dtype,
+   shape, offset, size) and the tensors themselves, each at an offset
+   that is a multiple of AI_MODEL_ALIGN. Values are in host byte order.
+
+   Opening maps the file (private, copy on write), so a loaded model
+   uses the tensors in place: nothing is read until a page is touched,
+   and processes loading the same file share its page-cache pages. A
+   page only turns into a private copy once the process writes to it
+   (training a loaded model). Files are written to a temporary name and
+   renamed, so a save never truncates a file another process has mapped.
+*/
+
+#ifndef HOLOS_AI_MODEL_H
+#define HOLOS_AI_MODEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define AI_MODEL_ALIGN 64   /* tensor offsets in the file, in bytes */
+#define AI_MODEL_RANK 4     /* most dimensions of a tensor */
+
+typedef enum {
+   AI_DTYPE_F64,
+   AI_DTYPE_F32,
+   AI_DTYPE_I8,
+   AI_DTYPE_I32
+} ai_dtype_t;
+
+/* A tensor to write: shape[0..rank) of dtype values at data. */
+typedef struct {
+   ai_dtype_t dtype;
+   size_t rank;
+   size_t shape[AI_MODEL_RANK];
+   const void *data;
+} ai_blob_t;
+
+/* An open model file. */
+typedef struct {
+   unsigned char *map;
+   size_t size;
+   uint32_t version;       /* the model's file version */
+   size_t n_meta;
+   const uint64_t *meta;
+   size_t count;           /* tensors */
+   const void *table;
+} ai_model_t;
+
+/* Write meta[0..n_meta) and blobs[0..count) as a model file tagged
+   with magic (8 bytes) and version. Returns 0 or -1. */
+int ai_model_write(const char *filename, const char *magic, uint32_t version, const uint64_t *meta, size_t n_meta,
+                   const ai_blob_t *blobs, size_t count);
+
+/* Map a model file tagged with magic; NULL if it is not one (or is
+   truncated or damaged). */
+ai_model_t *ai_model_open(const char *filename, const char *magic);
+
+/* Unmap the file; tensors of models bound to it become invalid. */
+void ai_model_close(ai_model_t *model);
+
+/* Tensor i in place, if it holds count values of dtype; NULL otherwise. */
+void *ai_model_tensor(const ai_model_t *model, size_t i, ai_dtype_t dtype, size_t count);
+
+/* Shape of tensor i (shape[0..rank)); returns the rank, 0 if i is out of range. */
+size_t ai_model_shape(const ai_model_t *model, size_t i, size_t *shape);
+
+#endif /* HOLOS_AI_MODEL_H */
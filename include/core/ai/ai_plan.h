@@ -0,0 +1,117 @@
+/* ai_plan.h - Execution plans and arenas of the AI models for HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+   Every pass of a model (forward, training step) declares its
+   intermediates as tensors with the steps they are live in. A plan packs
+   them into one block, two tensors sharing bytes only when their
+   lifetimes do not overlap; the block is carved out of an arena.
+
+   A model planned for a batch (and sequence length) runs every pass of
+   that size or smaller inside the arena without allocating. Models that
+   run one after another can share one arena: it grows to the largest
+   plan, not the sum. Models that run concurrently must not share one.
+   Unplanned passes lay themselves out the same way and allocate one
+   block per call.
+*/
+
+#ifndef HOLOS_AI_PLAN_H
+#define HOLOS_AI_PLAN_H
+
+#include <stddef.h>
+
+#define AI_PLAN_ALIGN 64   /* tensor offsets and sizes, in bytes */
+
+typedef struct {
+   size_t bytes;     /* rounded up to AI_PLAN_ALIGN */
+   size_t first;     /* first and last step the tensor is live in */
+   size_t last;
+   size_t offset;    /* from the block start, set by ai_plan_pack */
+} ai_tensor_t;
+
+typedef struct {
+   ai_tensor_t *tensors; /* in declaration order */
+   size_t count, cap;
+   size_t bytes;         /* block size after ai_plan_pack */
+} ai_plan_t;
+
+typedef struct {
+   void *base;
+   size_t size;
+} ai_arena_t;
+
+typedef enum {
+   AI_PASS_FORWARD,
+   AI_PASS_TRAIN
+} ai_pass_t;
+
+#define AI_PASS_COUNT 2
+
+/* Declare the tensors of one pass of model at the given sizes. */
+typedef int (*ai_layout_fn)(const void *model, ai_pass_t pass, size_t batch, size_t length, int threads, ai_plan_t *plan);
+
+/* The plans of a model for every pass at its largest planned sizes. */
+typedef struct {
+   ai_arena_t *arena;    /* shared, or &own */
+   ai_arena_t own;
+   size_t batch, length;
+   int threads;
+   ai_plan_t pass[AI_PASS_COUNT];
+} ai_exec_plan_t;
+
+void ai_plan_init(ai_plan_t *plan);
+void ai_plan_free(ai_plan_t *plan);
+
+/* Append a tensor live from step first to step last. */
+int ai_plan_add(ai_plan_t *plan, size_t bytes, size_t first, size_t last);
+
+/* Assign offsets (largest tensor first, lowest free offset) and set bytes. */
+int ai_plan_pack(ai_plan_t *plan);
+
+static inline void *ai_plan_at(const ai_plan_t *plan, void *base, size_t i) {
+   return (char *)base + plan->tensors[i].offset;
+}
+
+void ai_arena_init(ai_arena_t *arena);
+void ai_arena_free(ai_arena_t *arena);
+
+/* Grow the arena to at least bytes (contents are not kept). */
+int ai_arena_reserve(ai_arena_t *arena, size_t bytes);
+
+/* (Re)build *exec for model at the given sizes, in arena or, when
+   arena is NULL, in an arena of its own. */
+int ai_exec_plan(ai_exec_plan_t **exec, ai_arena_t *arena, ai_layout_fn layout, const void *model,
+                 size_t batch, size_t length, int threads);
+
+/* Rebuild *exec to cover the given sizes as well, in the same arena
+   (its own one when there is no plan yet). */
+int ai_exec_grow(ai_exec_plan_t **exec, ai_layout_fn layout, const void *model, size_t batch, size_t length, int threads);
+
+void ai_exec_plan_free(ai_exec_plan_t *exec);
+
+int ai_exec_covers(const ai_exec_plan_t *exec, size_t batch, size_t length, int threads);
+
+/* Memory of one pass: the planned block when exec covers the call,
+   otherwise a layout in local and a block allocated for it. *used is
+   the plan to address the tensors with. NULL on failure. */
+void *ai_exec_begin(const ai_exec_plan_t *exec, ai_layout_fn layout, const void *model, ai_pass_t pass,
+                    size_t batch, size_t length, int threads, ai_plan_t *local, const ai_plan_t **used);
+void ai_exec_end(void *base, ai_plan_t *local, const ai_plan_t *used);
+
+#endif /* HOLOS_AI_PLAN_H */
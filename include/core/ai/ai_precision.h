@@ -0,0 +1,58 @@
+/* ai_precision.h - Numeric precision of the AI models for HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+   A model in AI_PRECISION_FP32 or AI_PRECISION_BF16 keeps its parameters
+   in float arrays next to the double ones (which are then NULL). BF16 is
+   the mixed mode: float master weights, every GEMM operand rounded to
+   bfloat16 (8-bit mantissa) on the way in, float accumulation, so it
+   reproduces what bf16 hardware computes. Inputs and outputs of the
+   model API stay double in every precision.
+*/
+
+#ifndef HOLOS_AI_PRECISION_H
+#define HOLOS_AI_PRECISION_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef enum {
+   AI_PRECISION_FP64,
+   AI_PRECISION_FP32,
+   AI_PRECISION_BF16
+} ai_precision_t;
+
+/* Nearest bfloat16 (ties to even), returned as a float. */
+static inline float ai_bf16_round(float x) {
+   uint32_t u;
+   float r;
+   memcpy(&u, &x, sizeof u);
+   if ((u & 0x7f800000u) == 0x7f800000u) return x;
+   u += 0x7fffu + ((u >> 16) & 1u);
+   u &= 0xffff0000u;
+   memcpy(&r, &u, sizeof r);
+   return r;
+}
+
+static inline void ai_bf16_round_n(float *x, size_t n) {
+   for (size_t i = 0; i < n; i++) x[i] = ai_bf16_round(x[i]);
+}
+
+#endif /* HOLOS_AI_PRECISION_H */
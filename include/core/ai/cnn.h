@@ -18,6 +18,11 @@
 
    ----------------------------------------------------------------------
    API for Convolutional Neural Networks (CNN).
+
+   Maps are channel-major (channels x height x width), convolutions are
+   stride 1 with zero "same" padding, so every layer keeps the input
+   extent; kernel sizes must be odd. Hidden layers use tanh, the output
+   layer is linear, and training minimizes 1/2 |y - t|^2.
 */
 
 #ifndef HOLOS_CNN_H
@@ -25,6 +30,10 @@
 
 
 #include <stddef.h>
+#include "core/ai/ai_precision.h"
+#include "core/ai/ai_plan.h"
+#include "core/ai/ai_model.h"
+#include "core/ai/ai_int8.h"
 
 /* Structure representing a convolutional layer. */
 typedef struct {
@@ -33,28 +42,89 @@ typedef struct {
    size_t kernel_size;
    double *kernels;   /* kernels: output_channels x input_channels x kernel_size x kernel_size */
    double *biases;    /* biases: output_channels */
+   float *kernels_f;  /* FP32/BF16 storage of kernels and biases (the double ones are NULL) */
+   float *biases_f;
 } cnn_layer_t;
 
 /* Structure representing the full CNN network. */
 typedef struct {
    size_t num_layers;
    cnn_layer_t *layers;
+   size_t height;     /* input extent, see cnn_set_input */
+   size_t width;
+   int winograd;      /* F(2x2,3x3) for 3x3 layers (default 1), im2col + GEMM otherwise */
+   ai_precision_t precision;
+   ai_exec_plan_t *plan; /* workspace of the passes, redone by cnn_set_input */
+   ai_model_t *file;     /* file the parameters are mapped from, NULL when allocated */
 } cnn_t;
 
+/* Layer of the INT8 inference form: a quantized map of the input
+   channels x kernel x kernel patches to the output channels. */
+typedef struct {
+   size_t input_channels;
+   size_t kernel_size;
+   ai_i8_linear_t map;
+} cnn_q8_layer_t;
+
+/* INT8 inference form of a CNN (see ai_int8.h). */
+typedef struct {
+   size_t num_layers;
+   cnn_q8_layer_t *layers;
+   ai_u8_quant_t *inputs;  /* quantization of each layer's input */
+   size_t height;          /* input extent, as the model's at quantization; may be changed */
+   size_t width;
+   ai_model_t *file;       /* file the layers are mapped from, NULL when allocated */
+} cnn_q8_t;
+
 /* Allocate a new CNN with the given layer parameters. */
 cnn_t *cnn_alloc(const size_t *input_channels, const size_t *output_channels, const size_t *kernel_sizes, size_t num_layers);
+cnn_t *cnn_alloc_precision(const size_t *input_channels, const size_t *output_channels, const size_t *kernel_sizes, size_t num_layers,
+                           ai_precision_t precision);
+
+/* Convert the parameters to another precision. */
+int cnn_set_precision(cnn_t *cnn, ai_precision_t precision);
 
 /* Free a CNN and all associated memory. */
 void cnn_free(cnn_t *cnn);
 
+/* Set the spatial extent of the maps; required before the first pass. */
+int cnn_set_input(cnn_t *cnn, size_t height, size_t width);
+
+/* Lay out the passes at the current input extent in arena (shared with
+   other models run in turn, or NULL for one of its own), so that they
+   run without allocating. Training plans itself on first use. */
+int cnn_plan(cnn_t *cnn, ai_arena_t *arena);
+
 /* Forward pass: compute output for given input. */
 void cnn_forward(const cnn_t *cnn, const double *input, double *output);
 
 /* Train the CNN on a single example. */
 void cnn_train(cnn_t *cnn, const double *input, const double *target, double learning_rate);
 
-/* Save/load CNN to/from file. */
+/* Save/load CNN to/from file. Files keep the storage precision of the
+   model; cnn_load returns that precision, cnn_load_precision converts.
+   cnn_load maps the file and uses the parameters in place (see
+   ai_model.h); a precision change copies them out. */
 int cnn_save(const cnn_t *cnn, const char *filename);
 cnn_t *cnn_load(const char *filename);
+cnn_t *cnn_load_precision(const char *filename, ai_precision_t precision);
+
+/* Post-training quantization: the kernels per output channel, the
+   input of every layer per tensor over the range it takes on the n
+   calibration maps of calib, at the model's input extent. */
+cnn_q8_t *cnn_quantize(const cnn_t *cnn, const double *calib, size_t n);
+void cnn_q8_free(cnn_q8_t *q);
+
+/* Bytes of work for cnn_q8_forward at the current extent. */
+size_t cnn_q8_work_size(const cnn_q8_t *q);
+
+/* Forward pass of the quantized model; work holds cnn_q8_work_size
+   bytes (NULL allocates them for the call). */
+int cnn_q8_forward(const cnn_q8_t *q, const double *input, double *output, void *work);
+
+/* Save/load the quantized form; the load maps the file and runs on the
+   int8 kernels in place. */
+int cnn_q8_save(const cnn_q8_t *q, const char *filename);
+cnn_q8_t *cnn_q8_load(const char *filename);
 
 #endif /* HOLOS_CNN_H */
@@ -18,6 +18,21 @@
 
    ----------------------------------------------------------------------
    API for Generative Adversarial Networks (GAN).
+
+   The generator and discriminator are FP64 MLPs (mlp.h) owned by the
+   GAN: the generator maps noise (its input size, standard normal) to a
+   sample, the discriminator a sample to one logit. Training uses the
+   binary cross-entropy for the discriminator and the non-saturating
+   loss -log D(G(z)) for the generator, each updated with its own MLP
+   optimizer.
+
+   gan_train is data-parallel: the batch is split across n_threads
+   workers, each with its own gradient buffers, and the worker
+   gradients are summed by a tree reduction into the step of the master
+   weights. With a reduce hook set, the summed gradient then goes to it
+   to be summed across peers (e.g. over the P2P layer) before the step,
+   so peers training on their own data take identical steps from
+   identical weights.
 */
 
 #ifndef HOLOS_GAN_H
@@ -25,24 +40,50 @@
 
 
 #include <stddef.h>
+#include <stdint.h>
+#include "core/ai/mlp.h"
+
+/* Sum the n values of grad with those of every peer, in place, the
+   same on every peer. The last value is the example count, so peers
+   may train on batches of different sizes. Returns 0 or -1. */
+typedef int (*gan_reduce_fn)(void *ctx, double *grad, size_t n);
 
 /* Structure representing a simple GAN (generator and discriminator as MLPs). */
 typedef struct {
-   void *generator;      /* pointer to MLP or other NN struct */
-   void *discriminator;  /* pointer to MLP or other NN struct */
+   void *generator;      /* mlp_t, noise to sample */
+   void *discriminator;  /* mlp_t, sample to logit */
+   int n_threads;        /* training workers: 0 serial, < 0 all available */
+   uint64_t seed;        /* noise stream, advanced by every draw */
+   gan_reduce_fn reduce; /* optional sum across peers, NULL when training alone */
+   void *reduce_ctx;
+   double d_loss;        /* losses of the last gan_train, before its steps */
+   double g_loss;
+   ai_exec_plan_t *plan; /* worker buffers, grown with the batch and threads */
 } gan_t;
 
-/* Allocate a new GAN with given generator and discriminator. */
+/* Allocate a new GAN with given generator and discriminator (mlp_t),
+   which it owns once allocated. The generator output must match the
+   discriminator input, whose output is one logit. */
 gan_t *gan_alloc(void *generator, void *discriminator);
 
 /* Free a GAN and all associated memory. */
 void gan_free(gan_t *gan);
 
-/* Train the GAN on a batch of data. */
-void gan_train(gan_t *gan, const double *real_data, size_t batch_size, double learning_rate);
+/* Train the GAN on a batch of data: one discriminator step on
+   batch_size real rows and as many generated ones, then one generator
+   step on batch_size fresh samples. Returns 0 or -1. */
+int gan_train(gan_t *gan, const double *real_data, size_t batch_size, double learning_rate);
+
+/* Lay out the training buffers for batches of up to batch rows in
+   arena (shared with other models run in turn, or NULL for one of its
+   own). Training plans itself on first use. */
+int gan_plan(gan_t *gan, ai_arena_t *arena, size_t batch);
+
+/* Generate a sample from the GAN (noise from its stream). */
+void gan_generate(gan_t *gan, double *output);
 
-/* Generate a sample from the GAN. */
-void gan_generate(const gan_t *gan, double *output);
+/* Generate batch samples from the given noise rows. Returns 0 or -1. */
+int gan_generate_batch(const gan_t *gan, const double *noise, size_t batch, double *outputs);
 
 /* Save/load GAN to/from file. */
 int gan_save(const gan_t *gan, const char *filename);
@@ -18,6 +18,11 @@
 
    ----------------------------------------------------------------------
    API for Multilayer Perceptron (MLP) neural networks.
+
+   Hidden layers use tanh, the output layer is linear, and training
+   minimizes the squared error 1/2 |y - t|^2 averaged over the batch.
+   Batches are row-major matrices (one example per row) and every layer
+   of a batch is a single dgemm forward and two backward.
 */
 
 #ifndef HOLOS_MLP_H
@@ -25,6 +30,10 @@
 
 
 #include <stddef.h>
+#include "core/ai/ai_precision.h"
+#include "core/ai/ai_plan.h"
+#include "core/ai/ai_model.h"
+#include "core/ai/ai_int8.h"
 
 /* Structure representing a single layer in the MLP. */
 typedef struct {
@@ -32,17 +41,49 @@ typedef struct {
    size_t output_size;
    double *weights;   /* weights: output_size x input_size */
    double *biases;    /* biases: output_size */
+   float *weights_f;  /* FP32/BF16 storage of weights and biases (the double ones are NULL) */
+   float *biases_f;
+   double *m_weights; /* optimizer first moment (velocity for momentum), NULL for SGD; double in every precision */
+   double *m_biases;
+   double *v_weights; /* Adam second moment, NULL otherwise */
+   double *v_biases;
 } mlp_layer_t;
 
+/* Weight update rule. */
+typedef enum {
+   MLP_OPT_SGD,
+   MLP_OPT_MOMENTUM,  /* v = beta1 v + g, w -= lr v */
+   MLP_OPT_ADAM       /* bias-corrected moments with beta1, beta2, epsilon */
+} mlp_optimizer_t;
+
 /* Structure representing the full MLP network. */
 typedef struct {
    size_t num_layers;
    mlp_layer_t *layers;
    double *activations; /* optional: buffer for activations */
+   ai_precision_t precision;
+   mlp_optimizer_t optimizer;
+   double beta1, beta2, epsilon;
+   size_t step;         /* optimizer updates so far (Adam bias correction) */
+   ai_exec_plan_t *plan; /* workspace of the passes, grown with the batch size */
+   ai_model_t *file;     /* file the parameters are mapped from, NULL when allocated */
 } mlp_t;
 
-/* Allocate a new MLP with the given layer sizes. */
+/* INT8 inference form of an MLP (see ai_int8.h). */
+typedef struct {
+   size_t num_layers;
+   ai_i8_linear_t *layers;
+   ai_u8_quant_t *inputs;  /* quantization of each layer's input */
+   ai_model_t *file;       /* file the layers are mapped from, NULL when allocated */
+} mlp_q8_t;
+
+/* Allocate a new MLP of num_layers layers; layer_sizes holds the
+   num_layers + 1 widths, input first. */
 mlp_t *mlp_alloc(const size_t *layer_sizes, size_t num_layers);
+mlp_t *mlp_alloc_precision(const size_t *layer_sizes, size_t num_layers, ai_precision_t precision);
+
+/* Convert the parameters to another precision; resets the optimizer state. */
+int mlp_set_precision(mlp_t *mlp, ai_precision_t precision);
 
 /* Free an MLP and all associated memory. */
 void mlp_free(mlp_t *mlp);
@@ -50,11 +91,66 @@ void mlp_free(mlp_t *mlp);
 /* Forward pass: compute output for given input. */
 void mlp_forward(const mlp_t *mlp, const double *input, double *output);
 
-/* Train the MLP on a single example (stochastic gradient descent). */
+/* Forward pass over a batch: inputs batch x input size, outputs batch x output size. */
+int mlp_forward_batch(const mlp_t *mlp, const double *inputs, size_t batch, double *outputs);
+
+/* Train the MLP on a single example (one optimizer step, batch of one). */
 void mlp_train(mlp_t *mlp, const double *input, const double *target, double learning_rate);
 
-/* Save/load MLP to/from file. */
+/* One optimizer step on a batch (rows of inputs and targets); loss, if
+   not NULL, receives the batch loss before the step. */
+int mlp_train_batch(mlp_t *mlp, const double *inputs, const double *targets, size_t batch, double learning_rate, double *loss);
+
+/* Lay out the forward and training passes for batches of up to batch
+   rows in arena (shared with other models run in turn, or NULL for one
+   of its own), so that they run without allocating. */
+int mlp_plan(mlp_t *mlp, ai_arena_t *arena, size_t batch);
+
+/* Gradients of a loss of the caller's own, for models trained by
+   another model (the GAN); FP64 only. The parameters are one vector,
+   layer after layer, weights then biases. work holds mlp_work_count
+   doubles for a batch: mlp_forward_work keeps every layer's outputs in
+   it and returns the output rows (inside work), and mlp_backward_work,
+   given d loss / d output, adds the gradient summed over the batch to
+   grad and writes d loss / d input to d_in (either may be NULL). The
+   two leave the model untouched and may run concurrently with their
+   own work buffers. */
+size_t mlp_param_count(const mlp_t *mlp);
+size_t mlp_work_count(const mlp_t *mlp, size_t batch);
+const double *mlp_forward_work(const mlp_t *mlp, const double *inputs, size_t batch, double *work);
+int mlp_backward_work(const mlp_t *mlp, const double *inputs, size_t batch, const double *d_out, double *grad, double *d_in,
+                      double *work);
+
+/* One optimizer step along grad (mlp_param_count values, already averaged). */
+int mlp_apply_gradient(mlp_t *mlp, const double *grad, double learning_rate);
+
+/* Select the optimizer and reset its state (SGD by default). */
+int mlp_set_optimizer(mlp_t *mlp, mlp_optimizer_t optimizer, double beta1, double beta2, double epsilon);
+
+/* Save/load MLP to/from file. Files keep the storage precision of the
+   model; mlp_load returns that precision, mlp_load_precision converts.
+   mlp_load maps the file and uses the parameters in place (see
+   ai_model.h); a precision change copies them out. */
 int mlp_save(const mlp_t *mlp, const char *filename);
 mlp_t *mlp_load(const char *filename);
+mlp_t *mlp_load_precision(const char *filename, ai_precision_t precision);
+
+/* Post-training quantization: the weights per output row, the input of
+   every layer per tensor over the range it takes on the n calibration
+   rows of calib (batch x input size). Any precision. */
+mlp_q8_t *mlp_quantize(const mlp_t *mlp, const double *calib, size_t n);
+void mlp_q8_free(mlp_q8_t *q);
+
+/* Bytes of work for mlp_q8_forward_batch on batch rows. */
+size_t mlp_q8_work_size(const mlp_q8_t *q, size_t batch);
+
+/* Forward pass of the quantized model; work holds mlp_q8_work_size
+   bytes (NULL allocates them for the call). */
+int mlp_q8_forward_batch(const mlp_q8_t *q, const double *inputs, size_t batch, double *outputs, void *work);
+
+/* Save/load the quantized form; the load maps the file and runs on the
+   int8 weights in place. */
+int mlp_q8_save(const mlp_q8_t *q, const char *filename);
+mlp_q8_t *mlp_q8_load(const char *filename);
 
 #endif /* HOLOS_MLP_H */
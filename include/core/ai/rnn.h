@@ -18,6 +18,17 @@
 
    ----------------------------------------------------------------------
    API for Recurrent Neural Networks (RNN).
+
+   Layers are stacked Elman cells; layer l at step t computes
+      h_t = tanh(Wxh x_t + Whh h_{t-1} + bh),   y_t = Why h_t + by
+   and y_t is the input of layer l + 1. Weights are output x input.
+   Every sequence starts from hidden_state and training minimizes
+   1/2 |y - t|^2 summed over steps and averaged over the batch.
+
+   Batched calls take time-major arrays, seq_len x batch x size, so
+   the rows of one step are contiguous. They are double in every
+   precision; FP32 and BF16 models store and compute in float (BF16
+   rounding every GEMM operand to bfloat16, see ai_precision.h).
 */
 
 #ifndef HOLOS_RNN_H
@@ -25,27 +36,47 @@
 
 
 #include <stddef.h>
+#include "core/ai/ai_plan.h"
+#include "core/ai/ai_model.h"
+#include "core/ai/ai_precision.h"
 
 /* Structure representing a recurrent layer. */
 typedef struct {
    size_t input_size;
    size_t hidden_size;
+   size_t output_size;
    double *Wxh;   /* input-to-hidden weights */
    double *Whh;   /* hidden-to-hidden weights */
    double *Why;   /* hidden-to-output weights */
    double *bh;    /* hidden bias */
    double *by;    /* output bias */
+   float *Wxh_f;  /* FP32/BF16 storage of the same arrays (the double ones are NULL) */
+   float *Whh_f;
+   float *Why_f;
+   float *bh_f;
+   float *by_f;
 } rnn_layer_t;
 
 /* Structure representing the full RNN network. */
 typedef struct {
    size_t num_layers;
    rnn_layer_t *layers;
-   double *hidden_state;
+   double *hidden_state; /* initial h of every layer, layer after layer; double in every precision */
+   ai_precision_t precision;
+   size_t bptt_window;   /* truncated BPTT steps per update, 0 = whole sequence */
+   ai_exec_plan_t *plan; /* workspace of the passes, kept between training calls */
+   ai_model_t *file;     /* file the parameters are mapped from, NULL when allocated */
 } rnn_t;
 
-/* Allocate a new RNN with the given layer sizes. */
+/* Allocate a new RNN of num_layers layers. input_sizes holds
+   num_layers + 1 widths: the input of each layer, then the output of
+   the last; hidden_sizes the num_layers hidden widths. */
 rnn_t *rnn_alloc(const size_t *input_sizes, const size_t *hidden_sizes, size_t num_layers);
+rnn_t *rnn_alloc_precision(const size_t *input_sizes, const size_t *hidden_sizes, size_t num_layers,
+                           ai_precision_t precision);
+
+/* Convert the parameters to another precision. */
+int rnn_set_precision(rnn_t *rnn, ai_precision_t precision);
 
 /* Free an RNN and all associated memory. */
 void rnn_free(rnn_t *rnn);
@@ -56,8 +87,29 @@ void rnn_forward(const rnn_t *rnn, const double *input_seq, size_t seq_len, doub
 /* Train the RNN on a single sequence. */
 void rnn_train(rnn_t *rnn, const double *input_seq, const double *target_seq, size_t seq_len, double learning_rate);
 
-/* Save/load RNN to/from file. */
+/* Forward pass of batch sequences (time-major). Returns 0 or -1. */
+int rnn_forward_batch(const rnn_t *rnn, const double *inputs, size_t batch, size_t seq_len, double *outputs);
+
+/* One SGD step per bptt_window steps of batch sequences (time-major);
+   the hidden state carries over between windows, the gradient does
+   not. The BPTT buffers are the model's plan, grown on demand and
+   reused by later calls of the same or a smaller size. loss, if set,
+   receives the mean over the batch of the whole sequence's loss.
+   Returns 0 or -1. */
+int rnn_train_batch(rnn_t *rnn, const double *inputs, const double *targets, size_t batch, size_t seq_len,
+                    double learning_rate, double *loss);
+
+/* Lay out the passes for batch sequences of seq_len steps (or of
+   bptt_window steps, when set and shorter) in arena, shared with other
+   models run in turn, or NULL for one of its own. */
+int rnn_plan(rnn_t *rnn, ai_arena_t *arena, size_t batch, size_t seq_len);
+
+/* Save/load RNN to/from file. Files keep the storage precision of the
+   model; rnn_load returns that precision, rnn_load_precision converts.
+   rnn_load maps the file and uses the parameters in place (see
+   ai_model.h); a precision change copies them out. */
 int rnn_save(const rnn_t *rnn, const char *filename);
 rnn_t *rnn_load(const char *filename);
+rnn_t *rnn_load_precision(const char *filename, ai_precision_t precision);
 
 #endif /* HOLOS_RNN_H */
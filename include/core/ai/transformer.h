@@ -18,6 +18,18 @@
 
    ----------------------------------------------------------------------
    API for Transformer neural networks.
+
+   Sequences are row-major, seq_len x d_model. A layer is causal
+   multi-head self-attention followed by a ReLU feed-forward block, each
+   with a residual connection:
+      x1 = x + Attn(x) Wo^T + bo,   y = x1 + relu(x1 Wff1^T + bff1) Wff2^T + bff2
+   Wq, Wk, Wv, Wo are d_model x d_model, Wff1 d_ff x d_model and Wff2
+   d_model x d_ff, all output x input. Every layer has the same d_model
+   and num_heads divides it. Training minimizes 1/2 |y - t|^2.
+
+   Inputs and outputs are double in every precision; FP32 and BF16
+   models store and compute in float (BF16 rounding every GEMM operand
+   to bfloat16, see ai_precision.h).
 */
 
 #ifndef HOLOS_TRANSFORMER_H
@@ -25,6 +37,9 @@
 
 
 #include <stddef.h>
+#include "core/ai/ai_plan.h"
+#include "core/ai/ai_model.h"
+#include "core/ai/ai_precision.h"
 
 /* Structure representing a transformer layer. */
 typedef struct {
@@ -43,16 +58,38 @@ typedef struct {
    double *bo; /* output bias */
    double *bff1; /* feedforward bias 1 */
    double *bff2; /* feedforward bias 2 */
+   float *Wq_f;  /* FP32/BF16 storage of the same arrays (the double ones are NULL) */
+   float *Wk_f;
+   float *Wv_f;
+   float *Wo_f;
+   float *Wff1_f;
+   float *Wff2_f;
+   float *bq_f;
+   float *bk_f;
+   float *bv_f;
+   float *bo_f;
+   float *bff1_f;
+   float *bff2_f;
 } transformer_layer_t;
 
 /* Structure representing the full transformer network. */
 typedef struct {
    size_t num_layers;
    transformer_layer_t *layers;
+   int n_threads; /* attention threads: 0 serial, < 0 all available */
+   ai_precision_t precision;
+   ai_exec_plan_t *plan; /* workspace of the passes, NULL until planned or trained */
+   ai_model_t *file;     /* file the weights are mapped from, NULL when allocated */
 } transformer_t;
 
 /* Allocate a new transformer with the given layer parameters. */
 transformer_t *transformer_alloc(const size_t *d_models, const size_t *num_heads, const size_t *d_ffs, size_t num_layers);
+transformer_t *transformer_alloc_precision(const size_t *d_models, const size_t *num_heads, const size_t *d_ffs,
+                                           size_t num_layers, ai_precision_t precision);
+
+/* Convert the weights to another precision. Sessions allocated before
+   stop working (their steps fail) and have to be allocated again. */
+int transformer_set_precision(transformer_t *tr, ai_precision_t precision);
 
 /* Free a transformer and all associated memory. */
 void transformer_free(transformer_t *tr);
@@ -60,11 +97,56 @@ void transformer_free(transformer_t *tr);
 /* Forward pass: compute output for given input sequence. */
 void transformer_forward(const transformer_t *tr, const double *input_seq, size_t seq_len, double *output_seq);
 
+/* Forward pass of batch independent sequences, stored one after the
+   other (batch x seq_len x d_model). Returns 0 on success, -1 on error. */
+int transformer_forward_batch(const transformer_t *tr, const double *inputs, size_t batch, size_t seq_len, double *outputs);
+
 /* Train the transformer on a single sequence. */
 void transformer_train(transformer_t *tr, const double *input_seq, const double *target_seq, size_t seq_len, double learning_rate);
 
-/* Save/load transformer to/from file. */
+/* Lay out the forward and training passes for batch sequences of up
+   to seq_len positions in arena (shared with other models run in turn,
+   or NULL for one of its own); such passes then run without allocating.
+   Training plans itself on first use. */
+int transformer_plan(transformer_t *tr, ai_arena_t *arena, size_t batch, size_t seq_len);
+
+/* Save/load transformer to/from file. Files keep the storage precision
+   of the model; transformer_load returns that precision,
+   transformer_load_precision converts. transformer_load maps the file
+   and uses the weights in place (see ai_model.h); a precision change
+   copies them out. */
 int transformer_save(const transformer_t *tr, const char *filename);
 transformer_t *transformer_load(const char *filename);
+transformer_t *transformer_load_precision(const char *filename, ai_precision_t precision);
+
+/* Incremental inference: one position per step, with the keys and
+   values of past positions cached per layer, so a step costs
+   O(window d_model) attention instead of a forward over the whole
+   history. The cache is a ring of `window` positions; once full, the
+   oldest position is evicted, so attention slides over the last window
+   steps. Until then the outputs equal the rows of transformer_forward.
+   The cache is in the compute type of the model (double for FP64,
+   float otherwise). */
+typedef struct {
+   const transformer_t *tr;
+   size_t window;     /* cached positions per layer */
+   size_t length;     /* positions in the cache */
+   size_t head;       /* ring slot of the oldest position */
+   size_t position;   /* steps taken since the last reset */
+   ai_precision_t precision; /* of the model when allocated */
+   void *keys;        /* num_layers x window x d_model */
+   void *values;
+   void *work;
+} transformer_session_t;
+
+transformer_session_t *transformer_session_alloc(const transformer_t *tr, size_t window);
+void transformer_session_free(transformer_session_t *s);
+void transformer_session_reset(transformer_session_t *s);
+
+/* Drop the n oldest cached positions. */
+void transformer_session_evict(transformer_session_t *s, size_t n);
+
+/* Append one position (d_model inputs) and compute its output. */
+int transformer_session_step(transformer_session_t *s, const double *input, double *output);
 
 #endif /* HOLOS_TRANSFORMER_H */
@@ -0,0 +1,122 @@
+/* exec.h - Shared task runtime of HOLOS
+	 Copyright (C) 2025 4137314
+
+	 This file is part of HOLOS.
+
+	 HOLOS is free software: you can redistribute it and/or modify
+	 it under the terms of the GNU General Public License as published by
+	 the Free Software Foundation, either version 3 of the License, or
+	 (at your option) any later version.
+
+	 HOLOS is distributed in the hope that it will be useful,
+	 but WITHOUT ANY WARRANTY; without even the implied warranty of
+	 MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	 GNU General Public License for more details.
+
+	 You should have received a copy of the GNU General Public License
+	 along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+	 One pool of threads for the parallel work of HOLOS, started on the
+	 first call that needs it. Every thread keeps the tasks it spawns in
+	 a deque of its own and runs them newest first; a thread with
+	 nothing to do steals the oldest of another's, from the threads of
+	 its NUMA node first. On a machine of several nodes the workers are
+	 pinned, worker i to a CPU of node i modulo the nodes.
+
+	 A thread that waits for its loop or graph runs tasks meanwhile,
+	 whatever their origin, so loops and graphs nest: a task may run a
+	 loop of its own. Callers from outside the pool take part as one
+	 more thread.
+
+	 holos_exec_for() splits [0, n) into blocks of grain; the threads of
+	 the loop start from even shares of the blocks and, done with theirs,
+	 steal half of what another has left. holos_exec_reduce() keeps one
+	 accumulator per block and combines them pairwise in block order: as
+	 the blocks depend on n and grain only, the result is the same, bit
+	 for bit, whatever the threads and the order they ran in.
+
+	 Work across peers goes through p2p_task.h: each peer runs the tasks
+	 it holds on its pool, up to holos_exec_threads() at a time.
+*/
+
+#ifndef HOLOS_EXEC_H
+#define HOLOS_EXEC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+#define HOLOS_EXEC_THREADS_MAX 256
+#define HOLOS_EXEC_BLOCKS 1024            /* Blocks of a loop of grain 0 */
+#define HOLOS_EXEC_NOT_RUN (-0x7fffffff - 1)  /* Status of a task whose dependency failed */
+
+/* Threads of the pool, the caller included (0: the online CPUs, 1: all
+   the work in the caller), pinned if pin > 0, not if 0, or if the
+   machine has several NUMA nodes if < 0 (the default). Not while work
+   runs: a pool already started is stopped, and starts again as set.
+   0, or -1 on a bad count. */
+int holos_exec_setup(unsigned threads, int pin);
+
+/* Threads a loop may use, the caller included */
+unsigned holos_exec_threads(void);
+
+/* Stops the pool; it starts again when needed */
+void holos_exec_shutdown(void);
+
+/* ---------------- Loops ---------------- */
+
+/* Runs [lo, hi) of a loop. slot, below holos_exec_slots(width), is the
+   same for every range one thread runs in this loop, and no other
+   thread runs a range with it meanwhile: an index of scratch space. */
+typedef void (*holos_exec_range_fn)(size_t lo, size_t hi, unsigned slot, void *cls);
+
+/* Slots of a loop of at most width threads (0: no limit) */
+unsigned holos_exec_slots(unsigned width);
+
+/* fn over [0, n) in blocks of grain indices (0: n / HOLOS_EXEC_BLOCKS,
+   rounded up), on at most width threads at a time (0: no limit).
+   Returns when every block has run: 0, or -1 on bad arguments. */
+int holos_exec_for(size_t n, size_t grain, unsigned width, holos_exec_range_fn fn, void *cls);
+
+/* Folds [lo, hi) into acc; combine folds other into acc */
+typedef void (*holos_exec_reduce_fn)(size_t lo, size_t hi, void *acc, void *cls);
+typedef void (*holos_exec_combine_fn)(void *acc, const void *other, void *cls);
+
+/* Reduces [0, n) into result, size bytes: each block starts from a
+   copy of identity, then the blocks combine as a balanced tree, left
+   to right. 0, or -1 on bad arguments or out of memory (result as it
+   was). */
+int holos_exec_reduce(size_t n, size_t grain, const void *identity, size_t size, holos_exec_reduce_fn fn,
+                      holos_exec_combine_fn combine, void *result, void *cls);
+
+/* ---------------- Graphs ---------------- */
+
+/* A task of a graph: 0, or a failure status */
+typedef int (*holos_exec_task_fn)(void *cls);
+
+struct holos_exec_graph;
+
+struct holos_exec_graph *holos_exec_graph_new(void);
+void holos_exec_graph_free(struct holos_exec_graph *g);
+
+/* Adds a task run after the n_deps tasks of deps, added before it: its
+   id (from 0, in the order added), or -1. */
+int holos_exec_graph_add(struct holos_exec_graph *g, holos_exec_task_fn fn, void *cls, const int *deps, size_t n_deps);
+
+/* Runs every task once its dependencies have succeeded; those of a task
+   that failed are not run. Returns 0, or minus the tasks that failed
+   or were not run. A graph may be run again. */
+int holos_exec_graph_run(struct holos_exec_graph *g);
+
+/* What task id returned in the last run, or HOLOS_EXEC_NOT_RUN */
+int holos_exec_graph_status(const struct holos_exec_graph *g, int id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HOLOS_EXEC_H */
@@ -168,7 +168,7 @@ int holos_project_check_security_profile(const struct holos_project *project); /
 int holos_project_register_event_callback(struct holos_project *project, holos_project_event_callback cb, void *user_data); /**< Register event callback. */
 int holos_project_unregister_event_callback(struct holos_project *project, holos_project_event_callback cb); /**< Unregister event callback. */
 int holos_project_load_plugin(struct holos_project *project, const char *plugin_path); /**< Load a project plugin/extension. */
-};
+
 /**
  * Advanced analytics and sustainability utilities
  */
@@ -185,6 +185,19 @@ int holos_project_provenance_report(const struct holos_project *project, const c
 /**
  * Batch compliance and analytics utilities
  */
+/**
+ * The batch calls run their projects on the holos_exec pool (core/exec/exec.h),
+ * the calling thread included: at most threads projects at a time, git
+ * processes and disk_ops file operations across them (0 leaves a limit as it
+ * is; the defaults are the threads of the pool, 2 and 4). A project that fails
+ * does not stop the others: a batch returns 0, or minus the number of
+ * projects that failed. The event callbacks of each project, and those
+ * registered for a NULL project (every project), are called as it is done,
+ * one call at a time, from the threads of the pool; one returning nonzero
+ * cancels the projects of the batch not yet started. Reports are written to
+ * dir_path/ID.txt.
+ */
+int holos_project_batch_limits(unsigned threads, unsigned git, unsigned disk_ops); /**< Set the batch concurrency limits. */
 int holos_project_batch_check_compliance(struct holos_project **projects, size_t count); /**< Batch compliance check. */
 int holos_project_batch_generate_reports(struct holos_project **projects, size_t count, const char *dir_path); /**< Batch report generation. */
 
@@ -200,6 +213,31 @@ int holos_project_link_digital_twin_model(struct holos_project *project, const c
  * All functions return 0 on success, negative on error unless otherwise specified.
  * Memory for returned structures must be freed with holos_project_free().
  */
+/**
+ * Project store
+ *
+ * Projects live in one SQLite database (default ".holos/forge.db", its
+ * directory created as needed), indexed on owner, organization, tags and
+ * updated_at. A save stamps updated_at (and created_at, the first time).
+ *
+ * holos_project_list() reads the summary fields only: id, name, description,
+ * version, created_at, updated_at, owner, organization, tags, state and the
+ * scores. holos_project_load_details() reads the others when needed, and
+ * holos_project_load() reads both. A NULL string field is left as the store
+ * has it on save, so a listed project can be changed and saved back; the
+ * empty string clears a field.
+ *
+ * The filter of holos_project_list() is terms separated by spaces, all of
+ * which must hold (NULL or "" lists all):
+ *   owner:NAME  org:NAME  tag:TAG  state:STATE  since:TIME  before:TIME  WORD
+ * STATE is a name ("active") or a number, TIME an ISO 8601 timestamp (or its
+ * leading part, "2025-06") compared to updated_at, and a bare WORD is looked
+ * for in the name. Projects come newest first.
+ */
+int holos_project_store(const char *path); /**< Use the store at path (closing the one open). */
+void holos_project_store_close(void); /**< Close the store (reopened on the next call). */
+int holos_project_load_details(struct holos_project *project); /**< Fill in the fields holos_project_list() left out. */
+
 struct holos_project *holos_project_create(const char *name, const char *description); /**< Create a new project. */
 struct holos_project *holos_project_load(const char *id); /**< Load a project from disk by ID. */
 int holos_project_save(const struct holos_project *project); /**< Save project metadata to disk. */
@@ -230,13 +268,13 @@ int holos_project_link_digital_twin(struct holos_project *project, const char *d
 int holos_project_run_diagnostics(struct holos_project *project); /**< Run diagnostics on project. */
 int holos_project_check_compliance(const struct holos_project *project); /**< Check compliance. */
 int holos_project_generate_report(const struct holos_project *project, const char *report_path); /**< Generate project report. */
-int holos_project_list(const char *filter, struct holos_project ***out_projects, size_t *out_count); /**< List projects by filter. */
+int holos_project_list(const char *filter, struct holos_project ***out_projects, size_t *out_count); /**< List projects by filter (free each, then the array). */
 
 /**
  * Batch operations
  */
-int holos_project_batch_save(struct holos_project **projects, size_t count); /**< Batch save projects. */
-int holos_project_batch_run_diagnostics(struct holos_project **projects, size_t count); /**< Batch diagnostics. */
+int holos_project_batch_save(struct holos_project **projects, size_t count); /**< Batch save projects, all or none. */
+int holos_project_batch_run_diagnostics(struct holos_project **projects, size_t count); /**< Batch diagnostics (see above). */
 
 /**
  * Free project structure
@@ -38,7 +38,8 @@ enum holos_p2p_error {
 	HOLOS_P2P_ERR_PEER_NOT_FOUND = -3,
 	HOLOS_P2P_ERR_PROJECT_NOT_FOUND = -4,
 	HOLOS_P2P_ERR_AUTH = -5,
-	HOLOS_P2P_ERR_TIMEOUT = -6
+	HOLOS_P2P_ERR_TIMEOUT = -6,
+	HOLOS_P2P_ERR_AGAIN = -7          /* Send queue full, retry on "drain" */
 };
 
 /* Supported message types */
@@ -50,6 +51,19 @@ enum holos_p2p_message_type {
 	HOLOS_P2P_MSG_EVENT
 };
 
+/* Binary peer identity: the EdDSA public key with GNUnet, the name
+   zero-padded offline */
+#define HOLOS_P2P_PEER_ID_SIZE 32
+typedef struct {
+	unsigned char b[HOLOS_P2P_PEER_ID_SIZE];
+} holos_p2p_peer_id_t;
+
+/* Piece of a message gathered on send */
+struct holos_p2p_iovec {
+	const void *base;
+	size_t len;
+};
+
 /* Structure for P2P peer metadata */
 struct holos_p2p_peer {
 	char *id;              /* Unique peer identifier */
@@ -58,6 +72,8 @@ struct holos_p2p_peer {
 	int online;            /* Online status */
 	time_t last_seen;      /* Last seen timestamp */
 	char *public_key;      /* Public key for authentication */
+	double latency_ms;     /* Smoothed round trip, 0 until measured */
+	double bandwidth;      /* Bytes/s the peer receives from us, 0 until measured */
 };
 
 /* Structure for P2P project metadata */
@@ -81,6 +97,17 @@ struct holos_p2p_message {
 	time_t timestamp;        /* Message timestamp */
 };
 
+/* A received message as it lies in the receive buffer: nothing is
+   copied or allocated, and it is only valid during the callback. */
+struct holos_p2p_message_view {
+	enum holos_p2p_message_type type;
+	const holos_p2p_peer_id_t *sender;   /* As sent */
+	const holos_p2p_peer_id_t *receiver; /* All zero when broadcast */
+	const char *peer_id;                 /* Link it came over, printable */
+	const void *payload;
+	size_t size;
+};
+
 /* Structure for P2P event */
 struct holos_p2p_event {
 	char *event_type;        /* Event type (e.g., "connect", "disconnect", "data_received") */
@@ -88,18 +115,72 @@ struct holos_p2p_event {
 	time_t timestamp;        /* Event timestamp */
 };
 
-/* Callback type for event hooks */
+/* Callback type for event hooks. Events: "connect", "disconnect" and
+   "drain" (event_data the peer ID), "message" (a holos_p2p_message,
+   valid during the call), "project_received" (the project ID, once a
+   requested project is whole, see holos_p2p_project_dir) and
+   "data_received" (the sender ID: holos_p2p_receive_data has it) */
 typedef void (*holos_p2p_event_callback)(const struct holos_p2p_event *event);
 
-/* Register an event callback */
+/* Register an event callback. It runs inline, on the network path,
+   unless holos_p2p_event_dispatch has started dispatcher threads. */
 int holos_p2p_register_event_callback(holos_p2p_event_callback cb);
 
-/* Discover peers on the network */
+/* Event dispatch: the events are copied into lock-free rings, one per
+   priority, and the callback runs on the dispatcher threads (in order
+   with one thread; as they come with more). A full ring drops the
+   event. Start, restart or (threads 0) stop after the queued events
+   are delivered, from the thread that runs the P2P layer;
+   holos_p2p_finalize stops it too. capacity is per ring, 0 for the
+   default of 4096. */
+enum holos_p2p_event_priority {
+	HOLOS_P2P_EVENT_LOW,
+	HOLOS_P2P_EVENT_NORMAL,   /* Default; "connect" and "disconnect" are high */
+	HOLOS_P2P_EVENT_HIGH
+};
+
+struct holos_p2p_event_stats {
+	uint64_t posted;          /* Events queued */
+	uint64_t delivered;       /* Callbacks run */
+	uint64_t coalesced;       /* Dropped for a later one of the same type and peer */
+	uint64_t dropped;         /* Dropped on a full ring */
+	size_t pending;           /* Queued now */
+	size_t high_water;        /* Most queued in one ring */
+};
+
+int holos_p2p_event_dispatch(unsigned threads, size_t capacity);
+
+/* Priority of an event type, and whether the dispatcher collapses a
+   burst of them about one peer into the last ("drain" is coalesced).
+   Set while no dispatcher runs. */
+int holos_p2p_event_priority(const char *type, enum holos_p2p_event_priority priority, int coalesce);
+
+void holos_p2p_event_stats(struct holos_p2p_event_stats *stats);
+
+/* Discover peers on the network: a copy of the peer table (free each
+   with holos_p2p_free_peer, then the array) */
 int holos_p2p_discover_peers(struct holos_p2p_peer **peers, size_t *count);
 
-/* Get peer info by ID */
+/* Get peer info by ID (a copy, for holos_p2p_free_peer) */
 int holos_p2p_get_peer(const char *peer_id, struct holos_p2p_peer *peer);
 
+/* The peer table: every peer heard of through a link or peerinfo,
+   updated as they come and go; a peer offline for longer than the TTL
+   (default 600 s) is dropped. The entries below are the table's own,
+   valid until the P2P layer next runs (holos_p2p_poll, or a GNUnet
+   scheduler task): read them, copy what is kept. */
+int holos_p2p_peer_ttl(unsigned seconds);
+
+/* Entry of a peer by ID, in constant time, or NULL */
+const struct holos_p2p_peer *holos_p2p_peer_find(const char *peer_id);
+
+/* Up to max entries (all, or the online ones); returns how many there are */
+size_t holos_p2p_peer_list(const struct holos_p2p_peer **peers, size_t max, int online_only);
+
+/* IDs of up to max online peers, cheapest first (the time to move 64
+   KiB to each, from latency and bandwidth); returns the online count */
+size_t holos_p2p_peer_nearest(const char **ids, size_t max);
+
 /* Authenticate with a peer */
 int holos_p2p_authenticate_peer(const char *peer_id, const char *public_key);
 
@@ -115,34 +196,91 @@ int holos_p2p_connect(const char *peer_address);
 /* Disconnect from P2P network */
 int holos_p2p_disconnect(const char *peer_address);
 
-/* Share a project over P2P */
+/* Share a project over P2P: its data_path is served as an object (see
+   p2p_chunk.h) and the connected peers are told of it */
 int holos_p2p_share_project(const struct holos_p2p_project *project);
 
-/* Update project metadata on the network */
+/* Share a project again after its data changed */
 int holos_p2p_update_project(const struct holos_p2p_project *project);
 
-/* Request a project from P2P network */
+/* Request a project from P2P network: the peers sharing it answer and
+   it is fetched from all of them */
 int holos_p2p_request_project(const char *project_id);
 
-/* Send a message to a peer */
+/* Send a message to a peer (sender_id and receiver_id are not used:
+   the wire carries the binary identities) */
 int holos_p2p_send_message(const char *peer_address, const struct holos_p2p_message *msg);
 
-/* Receive a message from a peer */
+/* Receive a message from a peer (legacy): the oldest message that no
+   holos_p2p_on_message callback took, into msg (to free with
+   holos_p2p_free_message), its link copied to peer_address if not
+   NULL. HOLOS_P2P_ERR_AGAIN when there is none. */
 int holos_p2p_receive_message(char *peer_address, struct holos_p2p_message *msg);
 
 /* Broadcast a message to all peers */
 int holos_p2p_broadcast_message(const struct holos_p2p_message *msg);
 
-/* Send raw data to a peer (legacy) */
+/* Send a message gathered from iovcnt pieces, encoded straight into
+   the send buffer of the link */
+int holos_p2p_send_messagev(const char *peer_address, enum holos_p2p_message_type type,
+                            const struct holos_p2p_iovec *iov, size_t iovcnt);
+int holos_p2p_broadcast_messagev(enum holos_p2p_message_type type, const struct holos_p2p_iovec *iov,
+                                 size_t iovcnt);
+
+/* Take received messages as views into the receive buffer (NULL: queue
+   them for holos_p2p_receive_message again). The "message" event is
+   raised either way. */
+typedef void (*holos_p2p_message_callback)(const struct holos_p2p_message_view *msg, void *cls);
+int holos_p2p_on_message(holos_p2p_message_callback cb, void *cls);
+
+/* Binary identity of a printable peer ID, and back (n >= 128 is always
+   enough); the identity of this peer */
+int holos_p2p_peer_id_parse(const char *peer_id, holos_p2p_peer_id_t *id);
+int holos_p2p_peer_id_format(const holos_p2p_peer_id_t *id, char *out, size_t n);
+void holos_p2p_self(holos_p2p_peer_id_t *id);
+
+/* Callback for a message on a subscribed topic; data is only valid
+   during the call */
+typedef void (*holos_p2p_topic_callback)(const char *topic, const char *sender_id, const void *data, size_t size,
+                                         void *cls);
+
+/* Subscribe to a topic. Connected peers learn the subscription and only
+   forward topics this peer follows. */
+int holos_p2p_subscribe(const char *topic, holos_p2p_topic_callback cb, void *cls);
+int holos_p2p_unsubscribe(const char *topic, holos_p2p_topic_callback cb, void *cls);
+
+/* Publish on a topic to the local subscribers and to every connected
+   peer following it. Small messages are coalesced into batched frames
+   per peer. HOLOS_P2P_ERR_AGAIN: a peer's send queue is full and nothing
+   was queued; retry after its "drain" event. */
+int holos_p2p_publish(const char *topic, const void *data, size_t size);
+
+/* Without GNUnet, run the loopback links (a connected peer is this
+   process): send their open frames and deliver what they carry.
+   Returns the frames delivered; 0 with GNUnet, whose scheduler runs
+   the links. */
+int holos_p2p_poll(void);
+
+/* Bytes queued to a peer and not yet taken by the network */
+size_t holos_p2p_pending(const char *peer_id);
+
+/* Print the peer table to stderr */
+int holos_p2p_list_peers(void);
+
+/* Send raw data to a peer (legacy): a copy is served until
+   the sixteenth next send; large data is better shared as a path */
 int holos_p2p_send_data(const char *peer_address, const void *data, uint64_t size);
 
-/* Receive raw data from a peer (legacy) */
+/* Receive raw data from a peer (legacy): the oldest data received, its
+   size returned and its sender copied to peer_address (if not NULL,
+   room for a peer ID). HOLOS_P2P_ERR_AGAIN when there is none,
+   HOLOS_P2P_ERR_GENERIC if it is larger than size (it is kept). */
 int holos_p2p_receive_data(char *peer_address, void *buffer, uint64_t size);
 
 /* Finalize and clean up P2P subsystem */
 void holos_p2p_finalize(void);
 
-/* Utility: Free peer structure */
+/* Utility: Free peer structure (its strings; the structure is the caller's) */
 void holos_p2p_free_peer(struct holos_p2p_peer *peer);
 
 /* Utility: Free project structure */
@@ -154,82 +292,6 @@ void holos_p2p_free_message(struct holos_p2p_message *msg);
 /* Utility: Free event structure */
 void holos_p2p_free_event(struct holos_p2p_event *event);
 
-/* Structure for P2P peer metadata */
-struct holos_p2p_peer {
-	char *id;              /* Unique peer identifier */
-	char *address;         /* Network address */
-	char *name;            /* Peer name */
-	int online;            /* Online status */
-};
-
-/* Structure for P2P message */
-struct holos_p2p_message {
-	char *type;            /* Message type (e.g., "data", "request", "status") */
-	void *payload;         /* Message payload */
-	size_t size;           /* Payload size */
-};
-
-/* Structure for P2P event */
-struct holos_p2p_event {
-	char *event_type;      /* Event type (e.g., "connect", "disconnect", "data_received") */
-	void *event_data;      /* Event-specific data */
-};
-
-/* Callback type for event hooks */
-typedef void (*holos_p2p_event_callback)(const struct holos_p2p_event *event);
-
-/* Register an event callback */
-int holos_p2p_register_event_callback(holos_p2p_event_callback cb);
-
-/* Discover peers on the network */
-int holos_p2p_discover_peers(struct holos_p2p_peer **peers, size_t *count);
-
-/* Get peer info by ID */
-int holos_p2p_get_peer(const char *peer_id, struct holos_p2p_peer *peer);
-
-/* Error handling */
-void holos_p2p_error(const char *msg);
-
-/* Structure for P2P project metadata */
-struct holos_p2p_project {
-	char *id;                /* Unique project identifier */
-	char *name;              /* Project name */
-	char *description;       /* Project description */
-	char *owner;             /* Owner or creator */
-	char *data_path;         /* Path to shared data */
-};
-
-
-/* Initialize P2P subsystem (GNUnet) */
-int holos_p2p_init(void);
-
-/* Connect to P2P network or peer */
-int holos_p2p_connect(const char *peer_address);
-
-/* Disconnect from P2P network */
-int holos_p2p_disconnect(const char *peer_address);
-
-/* Share a project over P2P */
-int holos_p2p_share_project(const struct holos_p2p_project *project);
-
-/* Request a project from P2P network */
-int holos_p2p_request_project(const char *project_id);
-
-/* Send a message to a peer */
-int holos_p2p_send_message(const char *peer_address, const struct holos_p2p_message *msg);
-
-/* Receive a message from a peer */
-int holos_p2p_receive_message(char *peer_address, struct holos_p2p_message *msg);
-
-/* Send raw data to a peer (legacy) */
-int holos_p2p_send_data(const char *peer_address, const void *data, uint64_t size);
-
-/* Receive raw data from a peer (legacy) */
-int holos_p2p_receive_data(char *peer_address, void *buffer, uint64_t size);
-
-/* Finalize and clean up P2P subsystem */
-void holos_p2p_finalize(void);
-
 #ifdef __cplusplus
 }
 #endif
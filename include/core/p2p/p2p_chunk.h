@@ -0,0 +1,113 @@
+/* p2p_chunk.h - Content-addressed bulk transfer for HOLOS
+	 Copyright (C) 2025 4137314
+
+	 This file is part of HOLOS.
+
+	 HOLOS is free software: you can redistribute it and/or modify
+	 it under the terms of the GNU General Public License as published by
+	 the Free Software Foundation, either version 3 of the License, or
+	 (at your option) any later version.
+
+	 HOLOS is distributed in the hope that it will be useful,
+	 but WITHOUT ANY WARRANTY; without even the implied warranty of
+	 MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	 GNU General Public License for more details.
+
+	 You should have received a copy of the GNU General Public License
+	 along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+	 Files and directory trees move as objects: the files are cut into
+	 HOLOS_P2P_CHUNK_SIZE chunks named by their SHA-256, and the object is
+	 named by the hash of its manifest (the file list and the chunk list).
+	 A fetch takes the manifest, then the chunks, from every peer given
+	 (HOLOS_P2P_FETCH_WINDOW requests outstanding on each), and verifies
+	 each chunk against its name. Chunks land in a local store as well,
+	 so a chunk already there, from an earlier fetch or another object,
+	 is never transferred again, a fetch started again after a failure
+	 only asks for what is missing, and the store serves its chunks to
+	 other peers. A chunk in flight from a peer that goes away is asked
+	 of another from the byte it had reached.
+
+	 A changed chunk need not come whole: a fetch given a base (the
+	 version it replaces, fetched before) asks for it as a delta against
+	 the chunk at the same place of the same file, which the peer
+	 answers with the blocks the fetch has already, found where they
+	 moved to, and the other bytes, coded for doubles, or with the chunk
+	 when that is smaller. A project fetched again is based on the
+	 version before.
+*/
+
+#ifndef HOLOS_P2P_CHUNK_H
+#define HOLOS_P2P_CHUNK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define HOLOS_P2P_CHUNK_SIZE (256 * 1024)
+#define HOLOS_P2P_FETCH_WINDOW 4
+
+/* SHA-256 naming a chunk or an object */
+typedef struct {
+	unsigned char b[32];
+} holos_p2p_hash_t;
+
+/* Progress and outcome of a fetch */
+struct holos_p2p_fetch;
+
+/* Called once a fetch is over: HOLOS_P2P_OK, or the error that ended it */
+typedef void (*holos_p2p_fetch_callback)(struct holos_p2p_fetch *fetch, int status, void *cls);
+
+/* Directory of the local chunk store (default ".holos/chunks"), created
+   as needed */
+int holos_p2p_chunk_store(const char *dir);
+
+/* Directory the projects asked for with holos_p2p_request_project are
+   fetched into, one subdirectory per project ID (default
+   ".holos/projects") */
+int holos_p2p_project_dir(const char *dir);
+
+/* Serve a file or a directory tree (its regular files, through a
+   read-only map of each, which must not change while shared); id
+   receives the object name. */
+int holos_p2p_share_path(const char *path, holos_p2p_hash_t *id);
+int holos_p2p_unshare(const holos_p2p_hash_t *id);
+
+/* Fetch object id from peers into the directory dir. done, if not NULL,
+   runs when it is over; the fetch is the caller's to free after that
+   (or to cancel before). */
+struct holos_p2p_fetch *holos_p2p_fetch(const holos_p2p_hash_t *id, const char *const *peers, size_t n_peers,
+                                        const char *dir, holos_p2p_fetch_callback done, void *cls);
+
+/* Delta codings asked for and served (default both; 0: plain chunks) */
+#define HOLOS_P2P_DELTA_BLOCKS 1        /* Blocks already there, by reference */
+#define HOLOS_P2P_DELTA_XOR 2           /* Other bytes XOR-delta coded by 8-byte word */
+int holos_p2p_delta(unsigned codings);
+
+/* Take the chunks asked from now on as deltas against object base,
+   whose manifest and chunks are in the store */
+int holos_p2p_fetch_base(struct holos_p2p_fetch *fetch, const holos_p2p_hash_t *base);
+
+/* Add a source peer to a running fetch */
+int holos_p2p_fetch_add_peer(struct holos_p2p_fetch *fetch, const char *peer_id);
+
+/* Bytes present and total (0 until the manifest is in) */
+void holos_p2p_fetch_progress(const struct holos_p2p_fetch *fetch, uint64_t *have, uint64_t *total);
+
+/* Stop a fetch (the chunks it has already are kept) and free it */
+void holos_p2p_fetch_free(struct holos_p2p_fetch *fetch);
+
+/* Printable name: 64 hex digits and a NUL */
+void holos_p2p_hash_hex(const holos_p2p_hash_t *hash, char out[65]);
+int holos_p2p_hash_parse(const char *hex, holos_p2p_hash_t *hash);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HOLOS_P2P_CHUNK_H */
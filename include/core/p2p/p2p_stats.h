@@ -0,0 +1,118 @@
+/* p2p_stats.h - Traffic and latency metrics of the P2P layer of HOLOS
+	 Copyright (C) 2025 4137314
+
+	 This file is part of HOLOS.
+
+	 HOLOS is free software: you can redistribute it and/or modify
+	 it under the terms of the GNU General Public License as published by
+	 the Free Software Foundation, either version 3 of the License, or
+	 (at your option) any later version.
+
+	 HOLOS is distributed in the hope that it will be useful,
+	 but WITHOUT ANY WARRANTY; without even the implied warranty of
+	 MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	 GNU General Public License for more details.
+
+	 You should have received a copy of the GNU General Public License
+	 along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+	 The P2P layer counts what it sends and receives, per peer and per
+	 kind of record (publishes, messages, chunk requests, tasks, ...), the
+	 round trips of its requests in latency histograms, and the requests
+	 it had to make again. The counters are atomic: any thread may read
+	 them while the network runs, and counting costs no lock. Queue
+	 depths are read from the links when asked for, so those calls
+	 belong in the thread running the P2P layer.
+
+	 A histogram has HOLOS_P2P_HIST_SUB buckets per power of two of
+	 microseconds (exact below HOLOS_P2P_HIST_SUB), so a quantile is
+	 within 1 / HOLOS_P2P_HIST_SUB of the true value, from a microsecond
+	 to days, in a few KiB.
+*/
+
+#ifndef HOLOS_P2P_STATS_H
+#define HOLOS_P2P_STATS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#define HOLOS_P2P_HIST_SUB 16
+#define HOLOS_P2P_HIST_BUCKETS (HOLOS_P2P_HIST_SUB * 38)
+#define HOLOS_P2P_STATS_KINDS 32
+
+/* Round trips measured */
+enum holos_p2p_rtt {
+	HOLOS_P2P_RTT_PING,       /* PING to PONG of the peer table */
+	HOLOS_P2P_RTT_CHUNK,      /* A chunk asked to it placed */
+	HOLOS_P2P_RTT_STEAL,      /* A STEAL to its END */
+	HOLOS_P2P_RTT_TASK,       /* A task lent to its result back */
+	HOLOS_P2P_RTTS
+};
+
+/* Work done again */
+enum holos_p2p_retry {
+	HOLOS_P2P_RETRY_REFUSED,  /* Records refused by a full link (HOLOS_P2P_ERR_AGAIN) */
+	HOLOS_P2P_RETRY_CHUNK,    /* Chunks asked again of another peer */
+	HOLOS_P2P_RETRY_DELTA,    /* Chunk deltas that failed, asked again as bytes */
+	HOLOS_P2P_RETRY_TASK,     /* Tasks taken back from a lost peer to run again */
+	HOLOS_P2P_RETRIES
+};
+
+struct holos_p2p_histogram {
+	uint64_t count;
+	uint64_t sum_us, min_us, max_us;
+	uint64_t buckets[HOLOS_P2P_HIST_BUCKETS];
+};
+
+struct holos_p2p_peer_stats {
+	const char *id;
+	uint64_t bytes_sent, bytes_received;
+	uint64_t frames_sent, frames_received;
+	uint64_t records_sent, records_received;
+	uint64_t refused;              /* Records its link refused */
+	int linked;                    /* A link is up: the depths below are its */
+	size_t queued;                 /* Bytes waiting to go */
+	size_t frames_queued;          /* Frames waiting for the transport */
+	size_t frames_inflight;        /* Frames handed to it, not yet out */
+	double rtt_ms;                 /* Smoothed, from the peer table (0: unknown) */
+};
+
+struct holos_p2p_kind_stats {
+	const char *name;              /* "publish", "message", "chunk_get", ... */
+	uint64_t sent, received;
+	uint64_t bytes_sent, bytes_received;
+};
+
+/* Counters of up to max peers (every peer linked since the P2P layer
+   started); returns how many there are */
+size_t holos_p2p_stats_peers(struct holos_p2p_peer_stats *peers, size_t max);
+
+/* Counters per record kind, the kinds never seen left out; returns how
+   many there are */
+size_t holos_p2p_stats_kinds(struct holos_p2p_kind_stats *kinds, size_t max);
+
+void holos_p2p_stats_rtt(enum holos_p2p_rtt which, struct holos_p2p_histogram *hist);
+uint64_t holos_p2p_stats_retries(enum holos_p2p_retry which);
+
+/* Value (microseconds) under which a fraction q of the samples lie */
+double holos_p2p_histogram_quantile(const struct holos_p2p_histogram *hist, double q);
+
+/* Zero every counter and histogram */
+void holos_p2p_stats_reset(void);
+
+/* The metrics as a table, and as one JSON object */
+void holos_p2p_stats_print(FILE *out);
+int holos_p2p_stats_dump(FILE *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HOLOS_P2P_STATS_H */
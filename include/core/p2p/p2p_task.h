@@ -0,0 +1,94 @@
+/* p2p_task.h - Work stealing across the P2P peers of HOLOS
+	 Copyright (C) 2025 4137314
+
+	 This file is part of HOLOS.
+
+	 HOLOS is free software: you can redistribute it and/or modify
+	 it under the terms of the GNU General Public License as published by
+	 the Free Software Foundation, either version 3 of the License, or
+	 (at your option) any later version.
+
+	 HOLOS is distributed in the hope that it will be useful,
+	 but WITHOUT ANY WARRANTY; without even the implied warranty of
+	 MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	 GNU General Public License for more details.
+
+	 You should have received a copy of the GNU General Public License
+	 along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+	 A job is a batch of independent tasks of one registered kind (a
+	 parameter sweep, a Monte Carlo batch, ...), submitted on one peer.
+	 Every peer keeps the tasks it holds in a deque: it runs them from
+	 the bottom, and a peer with nothing to do steals half of another's
+	 from the top, so uneven tasks spread on their own. Results come back
+	 to the submitter as each task ends. A peer that holds stolen tasks
+	 tells the one it stole from that it is alive; a peer that goes away
+	 or stays silent for the timeout has its tasks taken back and run
+	 again. holos_p2p_task_run does the work, next to holos_p2p_poll:
+	 the tasks it takes run side by side on the holos_exec pool
+	 (core/exec/exec.h), up to holos_exec_threads() at a time, and end
+	 in the caller's thread.
+*/
+
+#ifndef HOLOS_P2P_TASK_H
+#define HOLOS_P2P_TASK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Largest task input, and output of a task run on another peer */
+#define HOLOS_P2P_TASK_INPUT_MAX 32000
+#define HOLOS_P2P_TASK_OUTPUT_MAX 32000
+
+/* Runs one task: 0 with *output (malloc'd, taken over) and *output_size
+   set, or an error status passed on to the result callback. */
+typedef int (*holos_p2p_task_fn)(const void *input, size_t size, void **output, size_t *output_size, void *cls);
+
+struct holos_p2p_job;
+
+/* Called on the submitter once per task, in the order they end */
+typedef void (*holos_p2p_result_callback)(struct holos_p2p_job *job, size_t task, int status, const void *output,
+                                          size_t size, void *cls);
+
+/* Make a kind of task runnable here. Every peer that takes part
+   registers the same names; a stolen task of a kind unknown here ends
+   with HOLOS_P2P_ERR_GENERIC. fn runs in threads of the pool, several
+   at once, and must not call the functions of p2p. */
+int holos_p2p_task_register(const char *name, holos_p2p_task_fn fn, void *cls);
+
+/* Submit n_tasks tasks of kind name, task i with inputs[i] and sizes[i]
+   bytes (copied) */
+struct holos_p2p_job *holos_p2p_job_submit(const char *name, const void *const *inputs, const size_t *sizes,
+                                           size_t n_tasks, holos_p2p_result_callback cb, void *cls);
+
+/* Submit a sweep: a task per point, each dim doubles of points (row
+   major), which the task reads back with holos_p2p_sweep_point */
+struct holos_p2p_job *holos_p2p_job_sweep(const char *name, const double *points, size_t n_points, size_t dim,
+                                          holos_p2p_result_callback cb, void *cls);
+int holos_p2p_sweep_point(const void *input, size_t size, double *point, size_t dim);
+
+/* Tasks of the job whose result is still to come */
+size_t holos_p2p_job_pending(const struct holos_p2p_job *job);
+
+/* Cancel what is left of the job and free it */
+void holos_p2p_job_free(struct holos_p2p_job *job);
+
+/* Silence after which a peer holding stolen tasks is taken for dead
+   (default 30000 ms: keep it above the longest task) */
+int holos_p2p_task_timeout(unsigned ms);
+
+/* Run up to max tasks held here, steal when there are none, and keep
+   the liveness checks going. Returns the tasks run. */
+int holos_p2p_task_run(size_t max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HOLOS_P2P_TASK_H */
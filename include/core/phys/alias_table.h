@@ -0,0 +1,65 @@
+/* alias_table.h - Walker alias sampling for HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+    Discrete distributions sampled in O(1) per draw, shared by the
+    emission spectra of nuclear_decay.h and fission_fusion.h.
+    - Built in O(n) by Vose's method from non-negative weights
+    - One uniform picks a column and decides between it and its alias
+    - Bulk draws are keyed by (seed, stream, index) through Philox, so a
+      buffer filled by any number of threads holds the same samples
+*/
+
+#ifndef HOLOS_ALIAS_TABLE_H
+#define HOLOS_ALIAS_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    size_t n;               /* Outcomes */
+    double *prob;           /* Probability of keeping column i, in [0, 1] */
+    uint32_t *alias;        /* Outcome taken otherwise */
+    double total;           /* Sum of the weights */
+} alias_table;
+
+/* Table for weights w[0..n-1]; NULL if n == 0, n >= 2^32, a weight is
+   negative or not finite, or all are zero. */
+alias_table *alias_table_alloc(const double *w, size_t n);
+void alias_table_free(alias_table *t);
+
+/* Outcome for a uniform u in [0, 1). */
+static inline size_t alias_table_pick(const alias_table *t, double u) {
+    const double x = u * (double)t->n;
+    size_t i = (size_t)x;
+    if (i >= t->n) i = t->n - 1;
+    return x - (double)i < t->prob[i] ? i : t->alias[i];
+}
+
+/*
+    Draws first .. first + count - 1 of (seed, stream): out[k] is the
+    outcome of draw first + k and, if frac is not NULL, frac[k] a second
+    uniform in (0, 1) from the same Philox block (e.g. the position inside
+    a histogram bin). Blocks of draws are split across n_threads threads
+    (0 = serial, < 0 = all available). Returns 0, or -1 on bad arguments.
+*/
+int alias_table_sample(const alias_table *t, uint64_t seed, uint64_t stream, uint64_t first, size_t count,
+                       size_t *out, double *frac, int n_threads);
+
+#endif /* HOLOS_ALIAS_TABLE_H */
@@ -0,0 +1,116 @@
+/* checkpoint.h - Asynchronous checkpoint and restart for HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+    Checkpoints of the state of a run, kept in one directory while the
+    run goes on.
+    - The state is a list of named sections: plain memory (ckpt_add) or
+      a stepper walked field by field (ckpt_add_state, with the walkers
+      below for the systems and grids of HOLOS)
+    - ckpt_snapshot() gathers every section into one of two staging
+      buffers and returns; a background thread writes the buffer and
+      fsyncs it, then its manifest, while the run goes on. The run waits
+      only when both buffers are still being written (or, with skip,
+      does not take that checkpoint)
+    - A checkpoint counts once its manifest is renamed into place:
+      ckpt_restore() loads the newest one whose data matches the
+      manifest's checksums and the sections now registered, skipping
+      any that was torn (a crash while writing) or does not fit
+    Walkers save what a step changes, not the setup: a run restarts by
+    building its systems as before and restoring into them.
+
+    Files, for checkpoint n: ckpt-<n>.dat (a header and the sections)
+    and ckpt-<n>.manifest, text (see checkpoint.c). The last keep are
+    kept. One thread at a time may call the functions of a store.
+*/
+
+#ifndef HOLOS_CHECKPOINT_H
+#define HOLOS_CHECKPOINT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CKPT_MAX_SECTIONS 64
+
+typedef struct {
+    size_t keep;            /* Checkpoints kept on disk, 0 for 2 */
+    int skip;               /* Skip a snapshot while both buffers are written, instead of waiting */
+} ckpt_params;
+
+typedef struct {
+    size_t n_sections;
+    uint64_t seq;           /* Last checkpoint taken (0: none yet) */
+    uint64_t seq_written;   /* Last one on disk */
+    size_t n_written;
+    size_t n_skipped;       /* Snapshots not taken, with skip */
+    size_t bytes;           /* Bytes written */
+    double stall;           /* Seconds spent in ckpt_snapshot() */
+    void *work;             /* Sections, buffers and the writer thread */
+} ckpt_store;
+
+/* What a walker is given: ckpt_io() sizes, copies out or copies back
+   one field, in the order of the walk. */
+typedef struct ckpt_cursor ckpt_cursor;
+typedef int (*ckpt_walk_fn)(void *state, ckpt_cursor *c);
+
+void ckpt_io(ckpt_cursor *c, void *field, size_t bytes);
+
+/* 1 while restoring (after the last ckpt_io the walker may fix up the
+   state: caches, device copies), else 0 */
+int ckpt_restoring(const ckpt_cursor *c);
+
+/* Checkpoints into dir (made if missing), numbered after the ones it
+   holds; prm may be NULL for the defaults. NULL on failure. */
+ckpt_store *ckpt_open(const char *dir, const ckpt_params *prm);
+
+/* Waits for the writer and stops it. Returns 0, or -1 if any write
+   failed. */
+int ckpt_close(ckpt_store *s);
+
+/* New section, named at most 63 printable characters without spaces:
+   size bytes at data, or state as walk sees it. Returns 0, or -1. */
+int ckpt_add(ckpt_store *s, const char *name, void *data, size_t size);
+int ckpt_add_state(ckpt_store *s, const char *name, void *state, ckpt_walk_fn walk);
+
+/* Takes checkpoint seq + 1 of the sections, at time t of step step.
+   Returns 0, 1 if skipped, or -1 on failure or after a write error (the
+   checkpoints already on disk stay). */
+int ckpt_snapshot(ckpt_store *s, double t, uint64_t step);
+
+/* Waits until every checkpoint taken is on disk. Returns 0, or -1 if a
+   write failed. */
+int ckpt_wait(ckpt_store *s);
+
+/* Restores the sections from the newest consistent checkpoint that has
+   all of them, with their sizes now; seq, t and step (each may be NULL)
+   get its number, time and step. Returns 0, or -1 if there is none
+   (nothing changed). */
+int ckpt_restore(ckpt_store *s, uint64_t *seq, double *t, uint64_t *step);
+
+/* Walkers of the steppers (checkpoint_state.c); state is the system or
+   grid. */
+int ckpt_walk_dyn_system(void *state, ckpt_cursor *c);      /* dyn_system_t: particles, time, step */
+int ckpt_walk_lorentz_system(void *state, ckpt_cursor *c);  /* lorentz_system */
+int ckpt_walk_maxwell_grid(void *state, ckpt_cursor *c);    /* maxwell_field_grid, point or Yee mode */
+int ckpt_walk_wave_grid(void *state, ckpt_cursor *c);       /* wave_field_grid */
+int ckpt_walk_wave_engine(void *state, ckpt_cursor *c);     /* wave_engine: the two current levels */
+int ckpt_walk_bs_system(void *state, ckpt_cursor *c);       /* bs_system_t: the SCF density */
+int ckpt_walk_nd_system(void *state, ckpt_cursor *c);       /* nd_system_t: nuclei, abundances and diagnostics */
+
+#endif /* HOLOS_CHECKPOINT_H */
@@ -21,7 +21,10 @@
 #define HOLOS_CIRCUIT_ANALYSIS_H
 
 #include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <gsl/gsl_matrix.h>
+#include <gsl/gsl_matrix_complex.h>
 #include <gsl/gsl_vector.h>
 
 /* Supported circuit element types */
@@ -59,6 +62,15 @@ typedef struct {
     void *params;   /* Pointer to parameter set (for nonlinear models) */
 } circuit_element;
 
+/* Structure for a probe (voltage, current, power, etc.) */
+typedef struct {
+    char *type;        /* "voltage", "current", "power", etc. */
+    int node1;
+    int node2;
+    char *label;
+    void *userdata;
+} circuit_probe;
+
 /* Structure for a netlist (circuit description) */
 typedef struct circuit_netlist_s circuit_netlist;
 
@@ -116,19 +128,14 @@ int circuit_nonlinear_dc_analysis(const circuit_netlist *net, gsl_vector *node_v
 /* Sensitivity analysis: compute dV/d(param) for each node (returns 0 on success) */
 int circuit_sensitivity_analysis(const circuit_netlist *net, const char *param, gsl_vector *sensitivities);
 
-/* Small-signal analysis (returns 0 on success) */
+/* Small-signal analysis (returns 0 on success): node voltage magnitudes at
+   omega, as circuit_ac_analysis(). */
 int circuit_small_signal_analysis(const circuit_netlist *net, double omega, gsl_vector *node_voltages);
 
-/* Monte Carlo analysis (returns 0 on success) */
+/* Monte Carlo analysis (returns 0 on success): DC node voltages of n_runs
+   samples into the rows of results (n_runs x n_nodes), with the default
+   circuit_mc_options on all cores. */
 int circuit_monte_carlo_analysis(const circuit_netlist *net, size_t n_runs, gsl_matrix *results);
-/* Structure for a probe (voltage, current, power, etc.) */
-typedef struct {
-    char *type;        /* "voltage", "current", "power", etc. */
-    int node1;
-    int node2;
-    char *label;
-    void *userdata;
-} circuit_probe;
 
 /* Structure for a voltage/current source with time-dependent function */
 typedef double (*circuit_source_func)(double t, void *userdata);
@@ -181,13 +188,132 @@ circuit_element *circuit_netlist_find_element(circuit_netlist *net, const char *
 /* Print a netlist to file or stdout */
 void circuit_netlist_print(const circuit_netlist *net, FILE *f);
 
-/* DC analysis: solve for node voltages (returns 0 on success) */
+/* DC analysis: solve for node voltages (returns 0 on success). The
+   analyses below run on the sparse MNA engine. */
 int circuit_dc_analysis(const circuit_netlist *net, gsl_vector *node_voltages);
 
-/* AC analysis: solve for node voltages at frequency omega (returns 0 on success) */
+/* AC analysis: solve for node voltages at frequency omega (returns 0 on success).
+   node_voltages receives magnitudes; circuit_ac_sweep() gives phasors. */
 int circuit_ac_analysis(const circuit_netlist *net, double omega, gsl_vector *node_voltages);
 
 /* Transient analysis: simulate time evolution (returns 0 on success) */
 int circuit_transient_analysis(const circuit_netlist *net, double t0, double t1, double dt, gsl_matrix *node_voltages);
 
+/* ---- Sparse MNA Engine ---- */
+
+/*
+    Sparse modified nodal analysis. Node 0 is ground; the unknowns are the
+    voltages of nodes 1..n_nodes-1 followed by one branch current per
+    voltage source, inductor and VCVS. Resistors, capacitors, inductors,
+    independent sources, VCCS, VCVS and diodes (value = Is, value2 = n)
+    are supported; probes are ignored.
+
+    Construction fixes the topology: the CSC pattern, the position of every
+    element stamp in it and a minimum-degree ordering. The first
+    factorization picks pivots (threshold partial pivoting, preferring the
+    diagonal) and with them the L/U pattern; every later assembly - Newton
+    iterations, transient steps, edited element values - only refactors
+    the numbers in place, and pivots again only if a pivot degrades.
+*/
+#define CIRCUIT_LU_PIVOT_TOL 1e-3   /* Diagonal kept if >= tol * column max */
+
+/* Sparse LU of the column-permuted MNA matrix: P A Q = L U. */
+typedef struct {
+    size_t n;
+    size_t *q;          /* Fill-reducing column order (symbolic, per topology) */
+    size_t *prow;       /* Pivot row of column k */
+    size_t *pinv;       /* Column whose pivot is row i */
+    size_t *Lp, *Li;    /* L by columns, unit diagonal first, original row indices */
+    double *Lx;
+    size_t *Up, *Ui;    /* U by columns in elimination order, diagonal last */
+    double *Ux;
+    size_t l_cap, u_cap;
+    int have_pattern;   /* Pivots and L/U pattern fixed by a full factorization */
+    double *work;       /* n */
+    size_t *stack;      /* 3n: DFS stack, positions and reach set */
+    size_t *mark;       /* n */
+    size_t stamp;
+} circuit_lu;
+
+typedef struct {
+    const circuit_netlist *net;  /* Element values are read on every assembly */
+    size_t n;                    /* Unknowns */
+    size_t n_branches;
+    long *branch;                /* Branch unknown per element (-1 = none) */
+    size_t *stamp_off;           /* Stamps of element e: [stamp_off[e], stamp_off[e + 1]) */
+    size_t *stamp_pos;           /* Entry in Ax of each stamp (SIZE_MAX = ground) */
+    size_t *Ap, *Ai;             /* CSC pattern, n + 1 and nnz */
+    double *Ax;
+    size_t nnz;
+    double *b;                   /* Right-hand side */
+    double *x;                   /* Solution */
+    double *x_prev;              /* Previous timestep */
+    double *v_diode;             /* Linearization voltage per element (diodes) */
+    circuit_lu lu;
+    size_t n_factor;             /* Full (pivoting) factorizations */
+    size_t n_refactor;           /* Numeric-only refactorizations */
+    size_t n_newton;             /* Newton iterations in the last solve */
+} circuit_mna;
+
+/* Build the engine for the topology of net (NULL on unsupported elements,
+   bad node indices or allocation failure). net must outlive the engine. */
+circuit_mna *circuit_mna_alloc(const circuit_netlist *net);
+void circuit_mna_free(circuit_mna *m);
+
+/* DC operating point (Newton for diodes); node_voltages has n_nodes
+   entries, [0] = ground. Returns a circuit_error_code. */
+int circuit_mna_dc(circuit_mna *m, gsl_vector *node_voltages);
+
+/* Copy of src for another netlist with the same topology (typically a
+   clone), including the ordering and the pivots and pattern of its last
+   factorization, so the copy starts with numeric refactorizations. */
+circuit_mna *circuit_mna_clone(const circuit_mna *src, const circuit_netlist *net);
+
+/* Backward-Euler transient from a discharged state (capacitor voltages
+   and inductor currents zero) with sources applied from t0. Row k of
+   node_voltages is t0 + k dt, for k = 0 .. ceil((t1 - t0) / dt). */
+int circuit_mna_transient(circuit_mna *m, double t0, double t1, double dt, gsl_matrix *node_voltages);
+
+/* ---- AC Sweep ---- */
+
+/*
+    Small-signal frequency response. Diodes are linearized at the DC
+    operating point and every independent source drives with its value as
+    a zero-phase amplitude. Y(w) = G + jw C is solved in its real form
+    [G -wC; wC G] on a single pattern: G, C and the ordering are built
+    once, the first frequency picks the pivots and every other frequency
+    only refactors numerically. Frequencies are split between threads,
+    each with its own copy of the factors; results do not depend on the
+    thread count.
+*/
+
+/* Phasors for omega[0 .. n_omega) [rad/s] into the rows of node_voltages
+   (n_omega x n_nodes, ground = 0). n_threads: 0 serial, negative = all
+   cores. Returns a circuit_error_code. */
+int circuit_ac_sweep(const circuit_netlist *net, const double *omega, size_t n_omega, int n_threads,
+                     gsl_matrix_complex *node_voltages);
+
+/* ---- Monte Carlo ---- */
+
+/*
+    Sample r scales every resistor, capacitor and inductor by 1 + sigma z,
+    with z a standard normal clipped to |z| <= 4 and drawn from the Philox
+    stream (seed, r) at the element's index. Threads each clone the netlist
+    and the engine once and start every run from the same pivots, so the
+    results are bitwise identical for any thread count.
+*/
+#define CIRCUIT_MC_SIGMA 0.05       /* Default relative tolerance */
+
+typedef struct {
+    uint64_t seed;
+    double sigma;                   /* Relative standard deviation, [0, 0.25) */
+    int n_threads;                  /* 0 = serial, negative = the holos_exec pool */
+} circuit_mc_options;
+
+/* Monte Carlo DC analysis with explicit options. Runs that fail get a row
+   of NaN; the return value is the error of the first failing run, or
+   CIRCUIT_OK. */
+int circuit_monte_carlo_run(const circuit_netlist *net, size_t n_runs, const circuit_mc_options *opt,
+                            gsl_matrix *results);
+
 #endif /* HOLOS_CIRCUIT_ANALYSIS_H */
@@ -0,0 +1,98 @@
+/* field_h5.h - Chunked HDF5 output of field grids for HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+    Time series of field components in one HDF5 file (configure
+    --with-hdf5; without it every call fails).
+    - One dataset per component ("E_x", ..., "u"), of frames x nz x ny x
+      nx doubles (x fastest, as in the grids), the frames unlimited: each
+      frame appends one time, and any component can then be written
+      into it. Frames a component misses read as NaN
+    - Chunks of one frame and about a MiB, shuffled and deflated, so a
+      hyperslab read decompresses only the chunks it touches
+    - "time" holds the time of each frame; the root attributes "format"
+      ("holos-field"), "version", "dims" (x, y, z) and "spacing"
+      describe the grid, and h5dump or h5py read the file as is
+    Unstructured grids (points in a list) are written with dims n x 1 x 1.
+
+    The distributed grids write collectively, each rank its own block
+    (see grid_mpi.h), with an MPI build of HDF5.
+*/
+
+#ifndef HOLOS_FIELD_H5_H
+#define HOLOS_FIELD_H5_H
+
+#include <stddef.h>
+
+#include "core/phys/em/maxwell.h"
+#include "core/phys/em/wave_equations.h"
+
+typedef struct {
+    size_t chunk[3];        /* Points per chunk along x, y, z; 0 for about 1 MiB of whole rows */
+    int deflate;            /* zlib level 1-9, 0 for 4, negative for none */
+} field_h5_params;
+
+typedef struct {
+    size_t dims[3];         /* Points along x, y, z */
+    double spacing[3];      /* dx, dy, dz */
+    size_t n_frames;
+    int writable;
+    void *work;             /* HDF5 handles */
+} field_h5;
+
+/* Creates path (truncating it) for a grid of dims points; prm may be
+   NULL for the defaults. NULL on failure. */
+field_h5 *field_h5_create(const char *path, const size_t dims[3], const double spacing[3], const field_h5_params *prm);
+
+/* Opens a file of field_h5_create(), to append frames if writable, else
+   to read. NULL on failure. */
+field_h5 *field_h5_open(const char *path, int writable);
+
+/* Returns 0, or -1 if the file could not be completed. */
+int field_h5_close(field_h5 *f);
+
+/* Appends frame n_frames at time t. Returns 0, or -1. */
+int field_h5_frame(field_h5 *f, double t);
+
+/* Writes component name of the last frame from data, nz x ny x nx. */
+int field_h5_write(field_h5 *f, const char *name, const double *data);
+
+/* Same, for a block: the count[] points from lo[] of a local array of
+   local[] points go to offset[] of the grid (all x, y, z). */
+int field_h5_write_block(field_h5 *f, const char *name, const double *data, const size_t local[3],
+                         const size_t lo[3], const size_t count[3], const size_t offset[3]);
+
+/* Reads the count[] points from lo[] of component name in frame into
+   out, count[2] x count[1] x count[0]. Returns 0, or -1. */
+int field_h5_read(const field_h5 *f, const char *name, size_t frame, const size_t lo[3], const size_t count[3],
+                  double *out);
+
+/* Time of frame, NaN if there is none. */
+double field_h5_time(const field_h5 *f, size_t frame);
+
+/*
+    A frame of a grid at its time: E_x ... H_z of a Yee grid or E_x ...
+    B_z of a point grid (dims n x 1 x 1); u, and U_0 ... of the vector
+    field if the points have one, of a wave grid; u of a wave engine.
+*/
+int maxwell_field_grid_h5_append(field_h5 *f, const maxwell_field_grid *grid);
+int wave_field_grid_h5_append(field_h5 *f, const wave_field_grid *grid);
+int wave_engine_h5_append(field_h5 *f, const wave_engine *e);
+
+#endif /* HOLOS_FIELD_H5_H */
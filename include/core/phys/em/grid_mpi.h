@@ -0,0 +1,148 @@
+/* grid_mpi.h - Distributed Maxwell and wave grids for HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+    MPI domain decomposition of structured Yee grids and wave engines
+    (configure --enable-mpi).
+
+    The global grid is split over a Cartesian communicator of 1 x py x pz
+    ranks: x rows are never split, so each rank keeps whole unit-stride
+    rows for the vectorized sweeps and only y/z faces travel. Every rank
+    holds an ordinary local grid (maxwell_field_grid or wave_engine) of
+    its owned block plus one ghost layer on each side facing another rank,
+    and steps it with the grid's own row kernels:
+    - Maxwell: H needs E ghosts from the high neighbors, E needs H ghosts
+      from the low neighbors; each exchange is posted non-blocking, the
+      rows that do not touch a ghost layer are updated meanwhile, and the
+      frame of rows next to the ghosts follows the wait
+    - Wave: both faces of u are exchanged once per step the same way; the
+      global outer layer stays the engine's fixed (Dirichlet) boundary and
+      temporal tiling is not used
+    PEC walls stay on the ranks at the domain edge; periodic axes wrap
+    through the communicator. Sources are kept by the rank owning their
+    cell. Results match a single-rank run bitwise.
+
+    All calls are collective over the communicator unless noted. MPI is
+    only called from the calling thread, so MPI_THREAD_FUNNELED suffices
+    with threaded local grids.
+*/
+
+#ifndef HOLOS_GRID_MPI_H
+#define HOLOS_GRID_MPI_H
+
+#include <stddef.h>
+#include <mpi.h>
+
+#include "core/phys/em/maxwell.h"
+#include "core/phys/em/wave_equations.h"
+#include "core/phys/em/field_h5.h"
+
+/* Placement of one rank's block. Index arrays are per axis x, y, z. */
+typedef struct {
+    MPI_Comm comm;              /* Cartesian communicator (owned; freed with the grid) */
+    int rank, size;
+    int dims[3], coords[3];     /* Process grid and this rank's position (dims[0] = 1) */
+    int nbr_lo[3], nbr_hi[3];   /* Neighbor ranks, MPI_PROC_NULL at walls */
+    size_t global[3];           /* Global cells (points) per axis */
+    size_t local[3];            /* Local array size, ghosts included */
+    size_t lo[3];               /* Local index of the first owned layer */
+    size_t owned[3];            /* Owned layers */
+    size_t offset[3];           /* Global index of the first owned layer */
+    size_t io_lo[3];            /* Local start of the layers this rank writes */
+    size_t io_count[3];         /* Layers this rank writes: owned plus held walls */
+    size_t io_offset[3];        /* Global start of the same layers */
+} grid_mpi_decomp;
+
+/* Local linear index of global point (gi, gj, gk) if this rank writes it
+   (see io_*); returns 1 and sets *idx, else 0. Not collective. */
+int grid_mpi_local_index(const grid_mpi_decomp *d, size_t gi, size_t gj, size_t gk, size_t *idx);
+
+/* Global coordinates of local linear index idx. Not collective. */
+void grid_mpi_global_coords(const grid_mpi_decomp *d, size_t idx, size_t g[3]);
+
+/* ---- Distributed Yee Grid ---- */
+
+typedef struct {
+    grid_mpi_decomp d;
+    maxwell_field_grid *grid;   /* Local grid: owned cells plus ghost layers */
+    void *halo;                 /* Face buffers and requests */
+} maxwell_mpi_grid;
+
+/* Decompose an nx * ny * nz grid (all ranks pass the same arguments).
+   boundary may be NULL (PEC everywhere). The material table starts as
+   vacuum; add materials on every rank through grid->yee in the same order. */
+maxwell_mpi_grid *maxwell_mpi_grid_alloc(MPI_Comm comm, size_t nx, size_t ny, size_t nz, double dx, double dy,
+                                         double dz, const maxwell_yee_boundary_t boundary[3]);
+void maxwell_mpi_grid_free(maxwell_mpi_grid *m);
+
+/* Material of the global cell box [i0, i1) x [j0, j1) x [k0, k1), clipped
+   to this rank. Not collective. */
+int maxwell_mpi_grid_set_material_box(maxwell_mpi_grid *m, size_t i0, size_t i1, size_t j0, size_t j1,
+                                      size_t k0, size_t k1, unsigned index);
+
+/* Add a source whose idx is a global cell index. Returns 1 if this rank
+   owns the cell and keeps the source, 0 if not, -1 on error. Not collective. */
+int maxwell_mpi_grid_add_source(maxwell_mpi_grid *m, const maxwell_yee_source *src);
+
+/* Advance the distributed grid by dt (same rules as maxwell_grid_fdtd_step()). */
+int maxwell_mpi_grid_step(maxwell_mpi_grid *m, double dt);
+
+/* Field energy 0.5 (eps E^2 + mu H^2) dV summed over all ranks. */
+double maxwell_mpi_grid_total_energy(const maxwell_mpi_grid *m);
+
+/* Parallel I/O (MPI-IO, collective): E then H as six blocks of
+   nx * ny * nz native doubles in global cell order. */
+int maxwell_mpi_grid_write(const maxwell_mpi_grid *m, const char *path);
+int maxwell_mpi_grid_read(maxwell_mpi_grid *m, const char *path);
+
+/* ---- Distributed Wave Engine ---- */
+
+typedef struct {
+    grid_mpi_decomp d;
+    wave_engine *engine;        /* Local engine: owned points plus ghost/wall layers */
+    void *halo;
+} wave_mpi_engine;
+
+/* Decompose an nx * ny * nz engine (same arguments on all ranks). The
+   interior points are split; wall ranks also hold the fixed outer layer. */
+wave_mpi_engine *wave_mpi_engine_alloc(MPI_Comm comm, size_t nx, size_t ny, size_t nz, double dx, double dy,
+                                       double dz, double c, double dt);
+void wave_mpi_engine_free(wave_mpi_engine *w);
+
+/* Advance n_steps timesteps. */
+int wave_mpi_engine_step(wave_mpi_engine *w, size_t n_steps);
+
+/* Parallel I/O: u(t) then u(t - dt) as two blocks of nx * ny * nz
+   native doubles in global point order. */
+int wave_mpi_engine_write(const wave_mpi_engine *w, const char *path);
+int wave_mpi_engine_read(wave_mpi_engine *w, const char *path);
+
+/* ---- Chunked Output (field_h5.h) ---- */
+
+/* Creates path for the global grid of dims points, opened on every rank
+   of comm; NULL on all ranks if any fails, or without a parallel HDF5. */
+field_h5 *field_h5_create_mpi(MPI_Comm comm, const char *path, const size_t dims[3], const double spacing[3],
+                              const field_h5_params *prm);
+
+/* A frame of the distributed grid, each rank writing the layers it owns
+   (E_x ... H_z, or u). */
+int maxwell_mpi_grid_h5_append(field_h5 *f, const maxwell_mpi_grid *m);
+int wave_mpi_engine_h5_append(field_h5 *f, const wave_mpi_engine *w);
+
+#endif /* HOLOS_GRID_MPI_H */
@@ -57,6 +57,7 @@ typedef struct {
     void *materials;            /* Pointer to material map/structure */
     void *sources;              /* Pointer to source definitions */
     void *userdata;
+    void *yee;                  /* maxwell_yee_grid storage (structured mode), else NULL */
 } maxwell_field_grid;
 /* Structure for boundary condition (Dirichlet, Neumann, periodic, etc.) */
 typedef struct {
@@ -86,6 +87,62 @@ typedef struct {
     void *userdata;
     char *label;
 } maxwell_source;
+
+/*
+    Structured grid with staggered (Yee) storage.
+    Cell (i, j, k) has linear index (k * ny + j) * nx + i, so x is the
+    unit-stride axis. Each vector field is a single block of 3 * n doubles
+    holding the components back to back, x[0..n) | y[0..n) | z[0..n).
+    Component positions in cell (i, j, k), in cell units:
+        Ex (i+1/2, j, k)      Ey (i, j+1/2, k)      Ez (i, j, k+1/2)
+        Hx (i, j+1/2, k+1/2)  Hy (i+1/2, j, k+1/2)  Hz (i+1/2, j+1/2, k)
+    J is co-located with E. Material constants come from a per-cell index
+    into a small table instead of per-point epsilon/mu/sigma.
+*/
+#define MAXWELL_YEE_MAX_MATERIALS 256
+
+/* Outer boundary of a Yee grid along one axis. Axes with a single cell are
+   always treated as invariant (periodic), which gives 2D and 1D grids. */
+typedef enum {
+    MAXWELL_YEE_PEC = 0,        /* Perfect electric conductor walls (default) */
+    MAXWELL_YEE_PERIODIC        /* Wrap around */
+} maxwell_yee_boundary_t;
+
+/* Point source driving one field component of one cell. func must be
+   thread-safe: sources in different rows are evaluated concurrently. */
+typedef struct {
+    size_t idx;                 /* Cell index */
+    int component;              /* 0..2 = Ex..Ez, 3..5 = Hx..Hz */
+    int hard;                   /* 1: field = func(t), 0: field += func(t) after the update */
+    maxwell_source_func func;
+    void *userdata;
+} maxwell_yee_source;
+
+typedef struct {
+    size_t nx, ny, nz;          /* Cells per axis (1 for collapsed axes) */
+    size_t n;                   /* nx * ny * nz */
+    double dx, dy, dz;          /* Cell size [m] */
+    double *E;                  /* Electric field, 3 * n [V/m] */
+    double *H;                  /* Magnetic field intensity, 3 * n [A/m] */
+    double *J;                  /* Current density, 3 * n [A/m^2] */
+    unsigned char *material;    /* Material index per cell, n */
+    maxwell_material *materials; /* Material table; entry 0 is vacuum */
+    size_t n_materials;         /* Entries in the material table */
+    maxwell_yee_boundary_t boundary[3]; /* Outer boundaries along x, y, z */
+    maxwell_yee_source *sources; /* Point sources, sorted by cell index */
+    size_t n_sources;           /* Sources in use */
+    size_t sources_cap;         /* Sources allocated */
+    int n_threads;              /* 0 = serial, otherwise threads for the stepper */
+} maxwell_yee_grid;
+
+/* Point-API view of one Yee cell. pt.E, pt.H and pt.J are strided views of
+   the cell's components in the grid blocks; pt.B and pt.D are snapshots
+   (mu H and epsilon E) and pt.epsilon/mu/sigma come from the cell material. */
+typedef struct {
+    maxwell_field_point pt;
+    gsl_vector E, H, J, B, D;   /* Headers the point refers to */
+    double B_data[3], D_data[3];
+} maxwell_yee_view;
 /* ---- Grid/Field Utilities ---- */
 
 maxwell_field_point *maxwell_field_point_clone(const maxwell_field_point *src);
@@ -102,6 +159,47 @@ maxwell_source *maxwell_field_grid_find_source(maxwell_field_grid *grid, const c
 int maxwell_field_grid_add_boundary(maxwell_field_grid *grid, const maxwell_boundary *bnd);
 int maxwell_field_grid_remove_boundary(maxwell_field_grid *grid, const char *type);
 maxwell_boundary *maxwell_field_grid_find_boundary(maxwell_field_grid *grid, const char *type);
+/* ---- Structured (Yee) Grids ---- */
+
+/* Allocate a zeroed nx * ny * nz Yee grid filled with vacuum. */
+maxwell_yee_grid *maxwell_yee_grid_alloc(size_t nx, size_t ny, size_t nz, double dx, double dy, double dz);
+void maxwell_yee_grid_free(maxwell_yee_grid *g);
+
+/* Linear index of cell (i, j, k). */
+static inline size_t maxwell_yee_index(const maxwell_yee_grid *g, size_t i, size_t j, size_t k) {
+    return (k * g->ny + j) * g->nx + i;
+}
+
+/* Append a material to the table; returns its index or -1 when full. */
+int maxwell_yee_add_material(maxwell_yee_grid *g, const maxwell_material *mat);
+
+/* Assign material index to the cells [i0, i1) x [j0, j1) x [k0, k1). */
+int maxwell_yee_set_material_box(maxwell_yee_grid *g, size_t i0, size_t i1, size_t j0, size_t j1,
+                                 size_t k0, size_t k1, unsigned index);
+
+/* Fill a point view of cell idx (returns 0 on success). */
+int maxwell_yee_cell_view(maxwell_yee_grid *g, size_t idx, maxwell_yee_view *view);
+
+/* Set the boundary along axis (0..2). */
+int maxwell_yee_set_boundary(maxwell_yee_grid *g, size_t axis, maxwell_yee_boundary_t type);
+
+/* Add a point source (returns 0 on success). */
+int maxwell_yee_add_source(maxwell_yee_grid *g, const maxwell_yee_source *src);
+
+/* Threads used by maxwell_grid_fdtd_step(): 0 serial, negative = all cores.
+   Results do not depend on the thread count. Returns the count in effect. */
+int maxwell_yee_set_threads(maxwell_yee_grid *g, int n_threads);
+
+/* Largest stable timestep (Courant limit) for the grid's materials. */
+double maxwell_yee_max_dt(const maxwell_yee_grid *g);
+
+/* Allocate a field grid in structured mode: n = cells, pts = NULL, yee set. */
+maxwell_field_grid *maxwell_field_grid_alloc_yee(size_t nx, size_t ny, size_t nz, double dx, double dy, double dz);
+
+/* Point idx of either kind of grid: &pts[idx], or a view of Yee cell idx
+   built in scratch. NULL if idx is out of range. */
+maxwell_field_point *maxwell_field_grid_point(maxwell_field_grid *grid, size_t idx, maxwell_yee_view *scratch);
+
 /* ---- Diagnostics and Energy ---- */
 
 void maxwell_poynting_vector(const maxwell_field_point *pt, gsl_vector *S);
@@ -127,6 +225,19 @@ void maxwell_curl_E(const maxwell_field_point *pt_now, const maxwell_field_point
 /* Compute curl of B: curl(B) = mu0 J + mu0 epsilon0 dE/dt */
 void maxwell_curl_B(const maxwell_field_point *pt_now, const maxwell_field_point *pt_prev, double mu0, double epsilon0, double dt, gsl_vector *curlB);
 
+/* Advance a structured grid by dt (leapfrog: H from t - dt/2 to t + dt/2,
+   then E from t to t + dt, with conductivity losses). Boundaries and point
+   sources are applied within the same sweeps. Returns -1 for point grids or
+   a dt above maxwell_yee_max_dt(). */
+int maxwell_grid_fdtd_step(maxwell_field_grid *grid, double dt);
+
+/* Split form of maxwell_grid_fdtd_step() for distributed grids (grid_mpi.h):
+   one H (field 3, to t + dt/2) or E (field 0, to t + dt) sweep over rows
+   j in [j0, j1), k in [k0, k1), sources included. grid->t is left alone;
+   the caller advances it once both sweeps covered every row. */
+int maxwell_grid_fdtd_rows(maxwell_field_grid *grid, double dt, int field, size_t j0, size_t j1,
+                           size_t k0, size_t k1);
+
 /* Update E and B fields at a point using finite difference (FDTD step) */
 void maxwell_fdtd_step(maxwell_field_point *pt, const maxwell_field_point *pt_prev, double mu0, double epsilon0, double dt);
 
@@ -51,8 +51,27 @@ typedef struct {
 	void *boundaries;          /* Pointer to boundary structure */
 	void *sources;             /* Pointer to source definitions */
 	void *userdata;
+	void *stencil;             /* Compiled Laplacian (wave_stencil), built on demand */
 } wave_field_grid;
 
+/*
+	Laplacian of an unstructured grid as a sparse matrix in CSR form:
+	lap(u)_i = sum over k in [row_ptr[i], row_ptr[i + 1]) of w[k] u[col[k]].
+	Along each axis a point couples to its nearest neighbors on either
+	side that share all other coordinates exactly, with the three-point
+	weights for uneven spacing. Axes where a point lacks a neighbor on
+	one side contribute nothing (the point is a boundary there).
+*/
+typedef struct {
+	size_t n;              /* Rows (points) */
+	size_t nnz;            /* Stored entries */
+	size_t *row_ptr;       /* n + 1 row offsets */
+	size_t *col;           /* Neighbor index per entry (diagonal first) */
+	double *w;             /* Finite-difference weight per entry [1/m^2] */
+	double *u;             /* Scratch: gathered field, n */
+	double *lap;           /* Scratch: Laplacian, n */
+} wave_stencil;
+
 /* Structure for boundary condition (Dirichlet, Neumann, periodic, etc.) */
 typedef struct {
 	char *type;         /* "dirichlet", "neumann", "periodic", etc. */
@@ -73,9 +92,88 @@ typedef struct {
 	char *label;
 } wave_source;
 
+/*
+	Structured scalar wave engine for u_tt = c^2 lap(u) (second-order
+	leapfrog). Three buffers hold the levels t - dt, t and t + dt and
+	rotate by index, so a step never copies the grid. Point (i, j, k) is
+	stored at (k * ny + j) * nx + i; the outermost layer of every axis with
+	more than one point is a fixed (Dirichlet) boundary.
+
+	Steps are cache blocked in y/z tiles of full x rows. With a time tile
+	T > 1, the engine advances T steps at a time over slabs of z planes:
+	shrinking trapezoids first, then the valleys between them, so each slab
+	is reused T times while it sits in cache. Every point is computed from
+	the same operands in both modes, so results are bitwise identical.
+*/
+#define WAVE_ENGINE_CACHE_BYTES (1u << 20)	/* Working-set target for blocking (L2) */
+
+typedef struct {
+	size_t nx, ny, nz;     /* Points per axis (1 for collapsed axes) */
+	size_t n;              /* nx * ny * nz */
+	double dx, dy, dz;     /* Spacing [m] */
+	double c;              /* Uniform wave speed [m/s] */
+	double dt;             /* Timestep [s] */
+	double *buf[3];        /* Level L lives in buf[L % 3] */
+	double *k2;            /* Optional per-point (c dt)^2, n (NULL = uniform c) */
+	size_t level;          /* Level of the current field */
+	double t;              /* Time of the current field */
+	size_t block_y;        /* Rows per spatial tile (0 = automatic) */
+	size_t block_z;        /* Planes per spatial tile (0 = automatic) */
+	size_t time_tile;      /* Steps per temporal tile (<= 1 = off) */
+	int n_threads;         /* 0 = serial, otherwise threads */
+} wave_engine;
+
+/* ---- Structured Engine ---- */
+
+/* Allocate a zeroed engine; fails if dt violates the CFL limit for c. */
+wave_engine *wave_engine_alloc(size_t nx, size_t ny, size_t nz, double dx, double dy, double dz,
+                               double c, double dt);
+void wave_engine_free(wave_engine *e);
+
+/* Current field u(t) and previous level u(t - dt), n values each, writable. */
+double *wave_engine_u(wave_engine *e);
+double *wave_engine_u_prev(wave_engine *e);
+
+/* Per-point wave speed (n values, copied); NULL returns to the uniform c.
+   Fails if any speed violates the CFL limit. */
+int wave_engine_set_speed(wave_engine *e, const double *c);
+
+/* Tile sizes (0 = automatic) and steps per temporal tile (<= 1 disables). */
+int wave_engine_set_blocking(wave_engine *e, size_t block_y, size_t block_z, size_t time_tile);
+
+/* Threads for wave_engine_step(): 0 serial, negative = all cores. */
+int wave_engine_set_threads(wave_engine *e, int n_threads);
+
+/* Advance n_steps timesteps (returns 0 on success). */
+int wave_engine_step(wave_engine *e, size_t n_steps);
+
+/* Split step for halo exchange (grid_mpi.h): compute level + 1 on the
+   interior rows y in [y0, y1), z in [z0, z1) (clipped to the interior),
+   as often as needed to cover every row; wave_engine_advance() then
+   carries the boundary layer over and makes the new level current. */
+int wave_engine_step_rows(wave_engine *e, size_t y0, size_t y1, size_t z0, size_t z1);
+int wave_engine_advance(wave_engine *e);
+
+/* ---- Compiled Stencil ---- */
+
+/* Build (or return the cached) stencil of grid from coords (n x dim).
+   Returns NULL if coords is missing or has the wrong shape. */
+const wave_stencil *wave_field_grid_compile(wave_field_grid *grid);
+
+/* Drop the cached stencil; needed after editing coords directly. Adding or
+   removing points does this automatically. */
+void wave_field_grid_invalidate(wave_field_grid *grid);
+
+/* out = L u for n values (out must not alias u). */
+void wave_stencil_apply(const wave_stencil *s, const double *u, double *out);
+
+void wave_stencil_free(wave_stencil *s);
+
 /* ---- Wave Equation Operations ---- */
 
-/* Compute Laplacian of scalar field at a point (finite difference) */
+/* Compute Laplacian of scalar field at a point (finite difference). Uses the
+   compiled stencil when the grid has one, otherwise searches coords for the
+   same neighbors (identical result, O(n) per call). */
 double wave_laplacian(const wave_field_grid *grid, size_t idx);
 
 /* Compute time derivative (finite difference) */
@@ -84,7 +182,9 @@ double wave_time_derivative(const wave_field_point *pt_now, const wave_field_poi
 /* Update field at a point using finite difference (FDTD step) */
 void wave_fdtd_step(wave_field_point *pt, const wave_field_point *pt_prev, double c, double dt, double laplacian);
 
-/* Update all points in a grid (FDTD step) */
+/* Update all points in a grid (FDTD step): grid holds u(t) and becomes
+   u(t + dt), grid_prev holds u(t - dt). Compiles the stencil if needed and
+   applies the Laplacian as one sparse matrix-vector product. */
 void wave_grid_fdtd_step(wave_field_grid *grid, const wave_field_grid *grid_prev, double c, double dt);
 
 /* Special cases: standing wave, traveling wave, Gaussian pulse */
@@ -108,6 +208,8 @@ wave_field_point *wave_field_point_clone(const wave_field_point *src);
 wave_field_grid *wave_field_grid_alloc(size_t n);
 void wave_field_grid_free(wave_field_grid *grid);
 wave_field_grid *wave_field_grid_clone(const wave_field_grid *src);
+/* Appends a copy of pt; coords (if present) grows by a zero row for the
+   caller to fill in. */
 int wave_field_grid_add_point(wave_field_grid *grid, const wave_field_point *pt);
 int wave_field_grid_remove_point(wave_field_grid *grid, size_t idx);
 wave_field_point *wave_field_grid_find_point(wave_field_grid *grid, const char *tag);
@@ -28,6 +28,7 @@
 #define HOLOS_QFT_H
 
 #include <stddef.h>
+#include <stdint.h>
 #include <gsl/gsl_vector.h>
 #include <gsl/gsl_matrix.h>
 
@@ -140,6 +141,139 @@ typedef struct {
 	void *extra;
 } qft_diagnostics_t;
 
+/*
+	Euclidean lattice for the path integral (qft_lattice.c): a real scalar
+	field on a periodic hypercubic lattice with the phi^4 action
+		S = sum_x [ 1/2 sum_mu (phi(x + mu) - phi(x))^2
+		            + 1/2 mass2 phi^2 + lambda/24 phi^4 ].
+	Sites are stored contiguously in checkerboard order: even sites (sum
+	of the coordinates even) first, then odd, each half in rows along
+	axis 0; every extent must be even. Sites of one colour only couple to
+	the other colour, so a half sweep updates them all at once.
+	Random numbers are Philox draws keyed by (seed, sweep, site), so the
+	chain is the same for any thread count.
+*/
+#define QFT_LATTICE_MAX_DIM 4
+
+typedef enum {
+	QFT_LATTICE_METROPOLIS,               /* uniform proposals of width delta */
+	QFT_LATTICE_HEATBATH,                 /* Gaussian heat bath, quartic accept */
+	QFT_LATTICE_HMC                       /* hybrid Monte Carlo, leapfrog */
+} qft_lattice_update_t;
+
+typedef struct {
+	size_t dim;                           /* Euclidean dimensions, 1 .. QFT_LATTICE_MAX_DIM */
+	size_t L[QFT_LATTICE_MAX_DIM];        /* extents (even) */
+	size_t volume;
+	double *phi;                          /* field, checkerboard order (see qft_lattice_index()) */
+	double mass2;                         /* bare mass squared */
+	double lambda;                        /* quartic coupling */
+	qft_lattice_update_t update;
+	double delta;                         /* Metropolis step (0 means 1) */
+	size_t n_hits;                        /* site updates per sweep (0 means 1) */
+	double hmc_step;                      /* leapfrog step (0 means 0.1) */
+	size_t hmc_steps;                     /* leapfrog steps per trajectory (0 means 10) */
+	uint64_t seed;
+	uint64_t sweep;                       /* sweeps done; keys the random streams */
+	int n_threads;                        /* 0 serial, < 0 all available */
+	size_t n_accepted, n_proposed;        /* site updates or trajectories */
+	double action;                        /* after the last sweep */
+	double delta_h;                       /* energy violation of the last trajectory */
+	void *work;                           /* row tables, HMC buffers */
+	void *extra;
+} qft_lattice_t;
+
+qft_lattice_t *qft_lattice_alloc(size_t dim, const size_t *L);
+void qft_lattice_free(qft_lattice_t *lat);
+/* Storage index of the site with coordinates x[0 .. dim-1] */
+size_t qft_lattice_index(const qft_lattice_t *lat, const size_t *x);
+/* One sweep (all sites n_hits times), or one HMC trajectory. */
+int qft_lattice_sweep(qft_lattice_t *lat);
+double qft_lattice_action(const qft_lattice_t *lat);
+double qft_lattice_magnetization(const qft_lattice_t *lat);
+/* Copies phi into field->values in lexicographic order (axis dim-1 fastest) */
+int qft_lattice_store(const qft_lattice_t *lat, qft_field_t *field);
+
+/*
+	Two-point function accumulated over Monte Carlo configurations
+	(qft_correlator.c). Each configuration adds its power spectrum
+	|phi(k)|^2, computed by FFT; the connected correlator
+		G(r) = < 1/V sum_x phi(x) phi(x + r) > - <phi>^2
+	at every separation r then comes from one inverse transform
+	(Wiener-Khinchin), O(V log V) instead of O(V^2). Arrays are in
+	lexicographic order, axis dim-1 fastest, as in qft_lattice_store().
+*/
+typedef struct {
+	size_t dim;
+	size_t L[QFT_LATTICE_MAX_DIM];
+	size_t volume;
+	size_t n_configs;                     /* configurations accumulated */
+	double *power;                        /* sum of |phi(k)|^2 over configurations */
+	double sum_mean;                      /* sum of the configuration means */
+	int n_threads;                        /* 0 serial, < 0 all available */
+	void *work;                           /* FFT tables and buffer */
+} qft_correlator_t;
+
+qft_correlator_t *qft_correlator_alloc(size_t dim, const size_t *L);
+void qft_correlator_free(qft_correlator_t *c);
+void qft_correlator_reset(qft_correlator_t *c);
+/* Adds one configuration, volume values in lexicographic order */
+int qft_correlator_add(qft_correlator_t *c, const double *phi);
+int qft_correlator_add_lattice(qft_correlator_t *c, const qft_lattice_t *lat);
+/* Connected G(r) for all volume separations */
+int qft_correlator_result(qft_correlator_t *c, double *G);
+/* Time slice correlator at spatial momentum 2 pi p / L (p[time] unused):
+   C(t) = sum_x exp(-i p x) G(t, x) for t < L[time]. */
+int qft_correlator_project(qft_correlator_t *c, size_t time, const size_t *p, double *C);
+
+/*
+	Diagram topologies and memoized evaluation (qft_feynman.c). A field
+	object stands for one line: listed by two vertices (or twice by one,
+	a tadpole) it is a propagator of its mass, listed once it is an
+	external leg. Topologies are canonically labelled, so relabelled
+	copies of a diagram compare equal. The expensive part of evaluating a
+	diagram, the reduction to master-integral coefficients, is cached by
+	topology and kinematics (the external invariants, then the line
+	masses in canonical order) and can be kept on disk; the value is
+		prod_v coupling_v * master(coefficients, mu),
+	so scans over couplings and the renormalization scale never reduce
+	a topology twice.
+*/
+typedef struct {
+	size_t n_vertices;
+	size_t n_edges;
+	size_t *edges; /* canonical vertex pairs (u <= v), 2 x n_edges, sorted */
+	double *masses; /* line masses, canonical order */
+	size_t *legs; /* external legs per canonical vertex */
+	uint64_t hash; /* of vertices, legs and edges */
+} qft_topology_t;
+
+typedef int (*qft_reduce_fn)(const qft_topology_t *topo, const double *kin, size_t n_kin, double *coeffs, size_t n_coeffs, void *params);
+typedef double (*qft_master_fn)(const qft_topology_t *topo, const double *kin, size_t n_kin, const double *coeffs, size_t n_coeffs, double mu, void *params);
+
+typedef struct {
+	qft_reduce_fn reduce;
+	qft_master_fn master;
+	void *params;
+	size_t n_coeffs; /* coefficients per reduction */
+	int n_threads; /* 0 serial, < 0 all available */
+	size_t n_hits; /* evaluations served from the cache */
+	size_t n_reductions; /* reductions performed */
+	void *cache;
+} qft_diagram_engine_t;
+
+qft_topology_t *qft_topology_alloc(const qft_feynman_diagram_t *diagram);
+void qft_topology_free(qft_topology_t *topo);
+int qft_topology_equal(const qft_topology_t *a, const qft_topology_t *b);
+qft_diagram_engine_t *qft_diagram_engine_alloc(qft_reduce_fn reduce, qft_master_fn master, size_t n_coeffs, void *params);
+void qft_diagram_engine_free(qft_diagram_engine_t *engine);
+/* values[i] for diagrams[i], all at the same external invariants and mu */
+int qft_diagram_engine_evaluate(qft_diagram_engine_t *engine, qft_feynman_diagram_t *const *diagrams, size_t n,
+	const double *invariants, size_t n_invariants, double mu, double *values);
+/* Cached reductions to and from a file; load merges into the cache. */
+int qft_diagram_engine_save(const qft_diagram_engine_t *engine, const char *path);
+int qft_diagram_engine_load(qft_diagram_engine_t *engine, const char *path);
+
 /* Structure for a QFT system. */
 typedef struct {
 	qft_field_t **fields;
@@ -157,6 +291,8 @@ typedef struct {
 	qft_source_t **sources;
 	size_t n_sources;
 	qft_diagnostics_t diagnostics;
+	qft_lattice_t *lattice; /* path-integral lattice (NULL if none) */
+	qft_correlator_t *correlator; /* fed by qft_step_path_integral() (NULL if none) */
 	void *extra;
 } qft_system_t;
 
@@ -189,6 +325,13 @@ void qft_interaction_print(const qft_interaction_t *interaction);
 void qft_lagrangian_print(const qft_lagrangian_t *lagrangian);
 void qft_feynman_diagram_print(const qft_feynman_diagram_t *diagram);
 
+/* Lattice for qft_step_path_integral(), phi^4 with the mass of the first
+   field; the step runs one sweep, or an HMC trajectory of length dt. */
+int qft_system_enable_lattice(qft_system_t *system, size_t dim, const size_t *L, double lambda);
+
+/* Values of system->diagrams at the renormalization scale (1 if none) */
+int qft_system_evaluate_diagrams(qft_system_t *system, qft_diagram_engine_t *engine, const double *invariants, size_t n_invariants, double *values);
+
 /* Simulation step utilities. */
 int qft_step_euler(qft_system_t *system, double dt);
 int qft_step_runge_kutta(qft_system_t *system, double dt);
@@ -25,6 +25,7 @@
     - API exposes force computation, integration, diagnostics, and utilities
     - Integrators: Euler, Verlet, Leapfrog, RK4, GSL ODE
     - Diagnostics: energy, momentum, center of mass, conservation checks
+    - Storage: per-particle vectors (AoS) or contiguous component arrays (SoA)
 */
 
 #ifndef HOLOS_DYNAMICS_H
@@ -33,6 +34,8 @@
 
 
 #include <gsl/gsl_vector.h>
+#include <gsl/gsl_matrix.h>
+#include <stdio.h>
 #include <stddef.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -62,6 +65,19 @@ struct dyn_system_s;
 
 typedef void (*dyn_force_cb)(struct dyn_system_s *system, void *userdata);
 
+/*
+    Range force callback: handles particles [begin, end) of a fixed partition
+    of the system and may add force contributions for ANY particle into acc,
+    a private zeroed buffer of 3 * N doubles laid out x[0..N) | y[0..N) | z[0..N).
+    Ranges run concurrently; the buffers are summed pairwise over a fixed
+    tree of the ranges afterwards.
+*/
+typedef void (*dyn_range_force_cb)(struct dyn_system_s *system, size_t begin, size_t end,
+                                   double *acc, void *userdata);
+
+/* Default number of ranges the particle set is split into for range callbacks. */
+#define DYN_FORCE_SLOTS 64
+
 
 typedef enum {
     DYN_INT_EULER = 0,      /* Euler integrator */
@@ -71,6 +87,132 @@ typedef enum {
     DYN_INT_GSL_ODE         /* Use GSL ODE integrator */
 } dyn_integrator_t;
 
+/*
+    Reusable integrator scratch space.
+    Buffers are sized for capacity particles and only grow, so repeated
+    dyn_system_step() calls perform no heap allocation once warmed up.
+*/
+typedef struct {
+    size_t capacity;        /* Particles the buffers can hold */
+    double *x0;             /* Positions at step start, 3 * capacity (RK4) */
+    double *v0;             /* Velocities at step start, 3 * capacity (RK4) */
+    double *dx;             /* Accumulated position increment, 3 * capacity (RK4) */
+    double *dv;             /* Accumulated velocity increment, 3 * capacity (RK4) */
+    double *y;              /* Packed [x v] ODE state, 6 * capacity (GSL ODE) */
+    void *ode_driver;       /* gsl_odeiv2_driver for DYN_INT_GSL_ODE */
+    void *ode_system;       /* gsl_odeiv2_system the driver refers to */
+    size_t ode_dim;         /* Dimension the driver was built for */
+    double ode_epsabs;      /* Absolute tolerance for the GSL ODE driver */
+    double ode_epsrel;      /* Relative tolerance for the GSL ODE driver */
+} dyn_workspace_t;
+
+
+/* Particle storage layout. */
+typedef enum {
+    DYN_LAYOUT_AOS = 0,     /* One heap gsl_vector per particle quantity (default) */
+    DYN_LAYOUT_SOA          /* Contiguous x/y/z component arrays */
+} dyn_layout_t;
+
+/* Per-particle vector quantities addressable in both layouts. */
+typedef enum {
+    DYN_FIELD_POS = 0,      /* Position */
+    DYN_FIELD_VEL,          /* Velocity */
+    DYN_FIELD_FORCE         /* Net force */
+} dyn_field_t;
+
+/*
+    Structure-of-arrays particle storage.
+    Each of pos/vel/force is a single block of 3 * capacity doubles holding
+    the x, y and z components back to back: x[0..cap) | y[0..cap) | z[0..cap).
+    Particle i's 3-vector is therefore the stride-capacity view starting at
+    block + i, which is what dyn_particle_t.pos/vel/force point at in SoA mode.
+*/
+typedef struct {
+    size_t capacity;        /* Particles allocated per component array */
+    double *pos;            /* Positions, 3 * capacity */
+    double *vel;            /* Velocities, 3 * capacity */
+    double *force;          /* Forces, 3 * capacity */
+    double *mass;           /* Masses, capacity (mirrors dyn_particle_t.mass) */
+    gsl_vector *views;      /* 3 * capacity non-owning vector headers */
+} dyn_soa_t;
+
+/* Gravity solver used behind dyn_system_compute_pairwise_gravity(). */
+typedef enum {
+    DYN_GRAVITY_DIRECT = 0,     /* O(N^2) direct summation (default) */
+    DYN_GRAVITY_BARNES_HUT,     /* O(N log N) octree, monopole moments */
+    DYN_GRAVITY_BARNES_HUT_QUAD /* Octree with quadrupole corrections */
+} dyn_gravity_solver_t;
+
+/*
+    Verlet neighbor list built from a linked-cell grid.
+    Pairs closer than cutoff + skin are stored once (j > i) in CSR form:
+    the neighbors of i are index[offset[i] .. offset[i + 1]). The list stays
+    valid until some particle has moved more than skin / 2 since the build.
+*/
+typedef struct {
+    double cutoff;          /* Interaction range */
+    double skin;            /* Extra shell kept in the list */
+    size_t n;               /* Particles the list was built for */
+    size_t *offset;         /* Row starts, n + 1 */
+    size_t *index;          /* Neighbor indices, offset[n] entries */
+    size_t index_cap;       /* Entries allocated in index */
+    double *ref;            /* Positions at the last build, interleaved xyz (3 * n) */
+    size_t *cell_head;      /* First particle per cell, (size_t)-1 if empty */
+    size_t *cell_next;      /* Next particle in the same cell (n) */
+    size_t cell_cap;        /* Entries allocated in cell_head */
+    size_t n_builds;        /* Full rebuilds performed */
+    size_t n_updates;       /* Update requests (rebuilt or reused) */
+} dyn_neighbor_list_t;
+
+/*
+    Hierarchical block time-stepping state.
+    Particle i advances with dt / 2^level[i]; the finest level max_level
+    sets the substep dt / 2^max_level. Levels follow the Aarseth-style
+    criterion dt_i = eta |a_i| / |da_i/dt|, with the jerk estimated from
+    the accelerations at the particle's last two kicks.
+*/
+typedef struct {
+    int max_level;          /* Finest level (at most 30) */
+    double eta;             /* Accuracy parameter of the timestep criterion */
+    size_t n;               /* Particles the arrays are sized for */
+    unsigned char *level;   /* Current level per particle (n) */
+    double *acc_prev;       /* Acceleration at the last kick, interleaved xyz (3 * n) */
+    double *t_prev;         /* Time of the last kick (n) */
+    size_t *active;         /* Scratch: particles synchronized at a substep (n) */
+    size_t n_force_evals;   /* Per-particle force evaluations so far */
+} dyn_block_t;
+
+/* Quantities accumulated on the fly by dyn_system_compute_forces() and the integrators. */
+#define DYN_DIAG_KINETIC    0x01u   /* Kinetic energy */
+#define DYN_DIAG_POTENTIAL  0x02u   /* Gravitational (or callback) potential energy */
+#define DYN_DIAG_MOMENTUM   0x04u   /* Linear momentum */
+#define DYN_DIAG_ANGULAR    0x08u   /* Angular momentum about the origin */
+#define DYN_DIAG_COM        0x10u   /* Center of mass position and velocity */
+#define DYN_DIAG_ALL        0x1fu
+
+/*
+    Diagnostics of one system state, filled in the same sweeps that
+    evaluate forces and kick velocities. mask tells which fields are valid:
+    the potential is only reported when the last force evaluation happened
+    at the recorded positions (velocity Verlet, or a bare compute_forces).
+*/
+typedef struct {
+    unsigned mask;          /* DYN_DIAG_* bits valid in this record */
+    double t;               /* Time of the state */
+    int step;               /* step_count of the state */
+    double kinetic;         /* Sum m v^2 / 2 */
+    double potential;       /* Pair potential energy */
+    double energy;          /* kinetic + potential (when both are valid) */
+    double momentum[3];     /* Sum m v */
+    double angular[3];      /* Sum m r x v */
+    double total_mass;      /* Sum m */
+    double com[3];          /* Center of mass */
+    double com_vel[3];      /* Center of mass velocity */
+} dyn_diagnostics_t;
+
+/* Contact callback: particles i < j overlap by overlap = radius_i + radius_j - |r_ij| > 0. */
+typedef void (*dyn_contact_cb)(struct dyn_system_s *system, size_t i, size_t j,
+                               double overlap, void *userdata);
 
 typedef struct dyn_system_s {
     size_t N;                   /* Number of particles */
@@ -96,6 +238,38 @@ typedef struct dyn_system_s {
     int has_constraints;        /* 1 if constraints are present */
     void *constraints;          /* Pointer to constraints structure */
     void *userdata;             /* User-defined pointer for extensions */
+
+    dyn_layout_t layout;        /* Particle storage layout */
+    dyn_soa_t *soa;             /* SoA storage (NULL in AoS layout) */
+
+    dyn_gravity_solver_t gravity_solver; /* Gravity engine */
+    double tree_theta;          /* Barnes-Hut opening angle */
+    double tree_rebuild_tol;    /* Allowed drift, in leaf-cell sizes, before a rebuild */
+    void *gravity_tree;         /* Cached octree (opaque, owned by the system) */
+
+    dyn_workspace_t *workspace; /* Integrator scratch used by dyn_system_step */
+    int forces_valid;           /* 1 if forces match the current positions */
+
+    int n_threads;              /* Threads for force evaluation, 0 or 1 serial */
+    size_t force_slots;         /* Ranges (and accumulators) used for range callbacks */
+    dyn_range_force_cb range_force_cb; /* Parallel force callback (overrides force_cb) */
+    void *range_force_cb_userdata;     /* User data for the range callback */
+    double *force_acc;          /* Range accumulators, 3 * N each, ~n_threads * log2(force_slots) of them */
+    size_t force_acc_size;      /* Doubles allocated in force_acc */
+
+    dyn_neighbor_list_t *neighbors; /* Short-range neighbor list (NULL if disabled) */
+    dyn_block_t *blocks;        /* Block time-stepping state (NULL for a global dt) */
+
+    void *trajectory;           /* dyn_traj_t appended to by dyn_system_step (not owned) */
+    size_t trajectory_every;    /* Steps between appended frames */
+
+    unsigned diag_mask;         /* DYN_DIAG_* quantities to accumulate (0 = off) */
+    dyn_diagnostics_t diag;     /* Latest record; force_cb may add to diag.potential */
+    dyn_diagnostics_t diag_ref; /* Reference for dyn_system_check_conservation */
+    double *phi;                /* Per-particle potential scratch (N) */
+    size_t phi_cap;             /* Entries allocated in phi */
+
+    void *gpu;                  /* dyn_gpu_t device mirror (NULL = host only, owned) */
 } dyn_system_t;
 
 
@@ -126,6 +300,38 @@ void dyn_system_set_softening(dyn_system_t *sys, bool use_softening, double eps)
 /* Set a custom force callback for the system. */
 void dyn_system_set_force_callback(dyn_system_t *sys, dyn_force_cb cb, void *userdata);
 
+/* Set a range force callback, evaluated in parallel over sys->force_slots ranges. */
+void dyn_system_set_range_force_callback(dyn_system_t *sys, dyn_range_force_cb cb, void *userdata);
+
+/* ---- Parallel Evaluation ---- */
+
+/* Threads used by dyn_system_compute_forces(): 0 or 1 runs serially, a
+   negative value uses every available core. Each force is summed in a
+   fixed order, so results are bitwise identical for any thread count.
+   Returns the thread count in effect. */
+int dyn_system_set_threads(dyn_system_t *sys, int n_threads);
+
+/* Number of ranges for range callbacks (default DYN_FORCE_SLOTS). Results
+   depend on this value, never on the thread count; memory is 3 * N doubles
+   per thread and level of the range tree, about
+   n_threads * (log2(slots / n_threads) + 1) * 3 * N. */
+int dyn_system_set_force_slots(dyn_system_t *sys, size_t slots);
+
+/* ---- Storage Layout ---- */
+
+/* Convert particle storage to the given layout, preserving state (returns 0 on success). */
+int dyn_system_set_layout(dyn_system_t *sys, dyn_layout_t layout);
+
+/* View of one particle's 3-vector; valid in both layouts until the system is resized. */
+gsl_vector_view dyn_system_particle_vector(dyn_system_t *sys, dyn_field_t field, size_t idx);
+
+/* Contiguous view over one component (axis 0..2) of a field for all N particles.
+   Only available in SoA layout; the returned view has size 0 otherwise. */
+gsl_vector_view dyn_system_component(dyn_system_t *sys, dyn_field_t field, size_t axis);
+
+/* Copy dyn_particle_t.mass into the SoA mass array after masses were edited directly. */
+void dyn_system_sync_masses(dyn_system_t *sys);
+
 /* ---- Force Computation ---- */
 
 /* Compute all forces in the system (calls force callback or default). */
@@ -134,11 +340,73 @@ int dyn_system_compute_forces(dyn_system_t *sys);
 /* Compute pairwise gravitational forces. */
 int dyn_system_compute_pairwise_gravity(dyn_system_t *sys);
 
+/* Overwrite the forces of particles active[0..n_active) with the gravity of the
+   whole system; every other force is left untouched. */
+int dyn_system_compute_gravity_active(dyn_system_t *sys, const size_t *active, size_t n_active);
+
+/* ---- Gravity Solvers ---- */
+
+/* Select the gravity engine; theta is the Barnes-Hut opening angle (ignored for direct). */
+int dyn_system_set_gravity_solver(dyn_system_t *sys, dyn_gravity_solver_t solver, double theta);
+
+/* Reuse the tree topology between calls while no particle drifted further than
+   tol leaf-cell sizes since the last build (0 rebuilds on every evaluation). */
+void dyn_system_set_tree_rebuild_tolerance(dyn_system_t *sys, double tol);
+
+/* Compute gravity with the octree solver, honoring the softening settings. */
+int dyn_system_compute_tree_gravity(dyn_system_t *sys);
+
+/* Octree version of dyn_system_compute_gravity_active(). */
+int dyn_system_compute_tree_gravity_active(dyn_system_t *sys, const size_t *active, size_t n_active);
+
+/* Discard the cached gravity tree (forces a full rebuild on next evaluation). */
+void dyn_system_reset_tree(dyn_system_t *sys);
+
+/* ---- Neighbor Lists ---- */
+
+/* Keep a Verlet list of pairs within cutoff + skin; dyn_system_compute_forces()
+   refreshes it before calling the force callbacks. cutoff <= 0 disables it. */
+int dyn_system_enable_neighbor_list(dyn_system_t *sys, double cutoff, double skin);
+
+/* Rebuild the list if any particle moved more than skin / 2 since the last build.
+   Returns 1 if rebuilt, 0 if reused, -1 on error. */
+int dyn_system_update_neighbor_list(dyn_system_t *sys);
+
+/* Neighbors j > i of particle i in the current list; *count receives their number. */
+const size_t *dyn_system_neighbors(const dyn_system_t *sys, size_t i, size_t *count);
+
+/* Report every overlapping pair (by dyn_particle_t.radius) from the neighbor list.
+   cutoff must cover the largest radius_i + radius_j. Returns the number of contacts. */
+long dyn_system_find_contacts(dyn_system_t *sys, dyn_contact_cb cb, void *userdata);
+
 /* ---- Integration ---- */
 
-/* Perform an integration step using the chosen integrator. */
+/* Perform an integration step using the chosen integrator.
+   Uses (and lazily grows) sys->workspace, so no allocation happens per step.
+   Velocity Verlet reuses the forces of the previous step: clear
+   sys->forces_valid after moving particles by hand. */
 int dyn_system_step(dyn_system_t *sys, double dt, dyn_integrator_t integrator);
 
+/* Enable block time-stepping with levels 0..max_level (max_level <= 0 disables).
+   dyn_system_step() with DYN_INT_VERLET or DYN_INT_LEAPFROG then advances each
+   particle by kick-drift-kick on its own power-of-two level, recomputing only
+   the forces of particles that finish a step. With force callbacks the whole
+   system is re-evaluated at each substep. */
+int dyn_system_set_block_timesteps(dyn_system_t *sys, int max_level, double eta);
+
+/* Current timestep level of particle i (-1 if block time-stepping is off). */
+int dyn_system_particle_level(const dyn_system_t *sys, size_t i);
+
+/* Same as dyn_system_step, with caller-provided scratch space. */
+int dyn_system_step_ws(dyn_system_t *sys, double dt, dyn_integrator_t integrator, dyn_workspace_t *ws);
+
+/* Allocate/free integrator scratch space for up to N particles. */
+dyn_workspace_t *dyn_workspace_alloc(size_t N);
+void dyn_workspace_free(dyn_workspace_t *ws);
+
+/* Grow a workspace to hold N particles (returns 0 on success). */
+int dyn_workspace_reserve(dyn_workspace_t *ws, size_t N);
+
 /* Set the system's simulation time. */
 void dyn_system_set_time(dyn_system_t *sys, double t);
 
@@ -147,6 +415,16 @@ double dyn_system_get_time(const dyn_system_t *sys);
 
 /* ---- Diagnostics ---- */
 
+/* Select quantities to accumulate during force evaluation and stepping.
+   Also records the current state as the conservation reference. */
+int dyn_system_set_diagnostics(dyn_system_t *sys, unsigned mask);
+
+/* Latest on-the-fly diagnostics record (mask 0 if none yet). */
+const dyn_diagnostics_t *dyn_system_diagnostics(const dyn_system_t *sys);
+
+/* The functions below reuse the latest record when it describes the current
+   state, and otherwise compute the quantity with a dedicated pass. */
+
 /* Compute total kinetic energy of the system. */
 double dyn_system_total_kinetic(const dyn_system_t *sys);
 
@@ -168,7 +446,9 @@ int dyn_system_center_of_mass(const dyn_system_t *sys, gsl_vector *out_r, gsl_ve
 /* Compute moment of inertia tensor. */
 int dyn_system_moment_of_inertia(const dyn_system_t *sys, gsl_vector *origin, gsl_matrix *out_I);
 
-/* Check conservation of energy and momentum (returns 0 if conserved). */
+/* Check conservation of energy and momentum against the reference taken by
+   dyn_system_set_diagnostics, to relative tolerance tol (returns 0 if conserved,
+   1 if not, -1 without a reference). */
 int dyn_system_check_conservation(const dyn_system_t *sys, double tol);
 
 /* Compute temperature, pressure, and volume if available. */
@@ -184,10 +464,10 @@ void dyn_system_print(const dyn_system_t *sys, FILE *f);
 /* Print a single particle to file or stdout. */
 void dyn_particle_print(const dyn_particle_t *p, FILE *f);
 
-/* Save system state to file (ASCII or binary). */
+/* Save system state to file (binary trajectory format, see trajectory.h). */
 int dyn_system_save(const dyn_system_t *sys, const char *filename);
 
-/* Load system state from file (ASCII or binary). */
+/* Load system state from file (last frame of a trajectory file). */
 dyn_system_t *dyn_system_load(const char *filename);
 
 /* Deep copy of a system. */
@@ -0,0 +1,115 @@
+/* dynamics_gpu.h - GPU offload of dyn_system_t for HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+    Device-resident particle state for dyn_system_t (configure --enable-cuda).
+
+    With a GPU attached, dyn_system_step() keeps positions, velocities and
+    forces on the device for DYN_INT_EULER, DYN_INT_VERLET and
+    DYN_INT_LEAPFROG, and direct-summation gravity runs there as well.
+    Data crosses the bus only when the host needs it:
+    - force callbacks and the tree solver: positions and velocities down,
+      forces back up, once per force evaluation
+    - diagnostics: positions and velocities down after each step
+    - trajectories and dyn_system_save(): the recorded fields, per frame
+    - other integrators and block time-stepping: the whole state, per step
+
+    Library functions synchronize by themselves. Code that reads particle
+    vectors directly calls dyn_system_sync_host() first, and code that
+    writes them calls dyn_system_invalidate_gpu() afterwards.
+*/
+
+#ifndef HOLOS_DYNAMICS_GPU_H
+#define HOLOS_DYNAMICS_GPU_H
+
+#include <stddef.h>
+
+#include "core/phys/mech/classical/dynamics.h"
+
+/* Particle fields mirrored on the device. */
+#define DYN_GPU_POS     0x1u    /* Positions */
+#define DYN_GPU_VEL     0x2u    /* Velocities */
+#define DYN_GPU_FORCE   0x4u    /* Forces */
+#define DYN_GPU_MASS    0x8u    /* Masses and fixed flags */
+#define DYN_GPU_ALL     0xfu
+
+/* Host-side record of a device mirror (sys->gpu). */
+typedef struct {
+    int device;             /* Device ordinal */
+    size_t n;               /* Particles allocated on the device */
+    unsigned dirty;         /* Fields newer on the host (uploaded by dyn_gpu_push) */
+    unsigned stale;         /* Fields newer on the device (downloaded by dyn_gpu_pull) */
+    double *stage;          /* Transfer buffer, 3 * n doubles */
+    unsigned char *fixed;   /* Transfer buffer for fixed flags, n */
+    void *backend;          /* Device buffers */
+    size_t n_uploads;       /* Field uploads so far */
+    size_t n_downloads;     /* Field downloads so far */
+} dyn_gpu_t;
+
+/* ---- Offload ---- */
+
+/* Number of usable devices (0 when built without GPU support). */
+int dyn_gpu_device_count(void);
+
+/* Keep the state of sys resident on the given device. A negative device
+   copies the state back and detaches. Returns 0 on success, -1 if there is
+   no such device. */
+int dyn_system_enable_gpu(dyn_system_t *sys, int device);
+
+/* Copy any state that is newer on the device back into the particles. */
+int dyn_system_sync_host(const dyn_system_t *sys);
+
+/* Mark the whole host state as edited, so the next step uploads it again. */
+void dyn_system_invalidate_gpu(dyn_system_t *sys);
+
+/* ---- Transfers (used by the dynamics module) ---- */
+
+/* Download the fields in mask that are newer on the device (no-op without a GPU). */
+int dyn_gpu_pull(const dyn_system_t *sys, unsigned mask);
+
+/* Record that the host copies of the fields in mask were overwritten. */
+void dyn_gpu_touch(dyn_system_t *sys, unsigned mask);
+
+/* Upload the dirty fields, reallocating device buffers if N changed. */
+int dyn_gpu_push(dyn_system_t *sys);
+
+/* Direct-summation gravity into the device forces; *u receives the
+   potential energy when u is non-NULL. */
+int dyn_gpu_gravity(dyn_system_t *sys, double *u);
+
+/* v += (dt_v / m) F, then x += dt_x v, for every non-fixed particle. */
+int dyn_gpu_kick_drift(dyn_system_t *sys, double dt_v, double dt_x);
+
+/* Release a mirror without copying anything back. */
+void dyn_gpu_free(dyn_gpu_t *gpu);
+
+/* ---- Backend ---- */
+
+/* Flat-array device operations behind the functions above, implemented
+   by dynamics_cuda.cu. Vector fields are x[0..n) | y[0..n) | z[0..n). */
+int dyn_cuda_device_count(void);
+void *dyn_cuda_create(int device, size_t n);
+void dyn_cuda_destroy(void *backend);
+int dyn_cuda_upload(void *backend, unsigned field, const double *src);
+int dyn_cuda_upload_fixed(void *backend, const unsigned char *fixed);
+int dyn_cuda_download(void *backend, unsigned field, double *dst);
+int dyn_cuda_gravity(void *backend, double G, double eps2, double *phi);
+int dyn_cuda_kick_drift(void *backend, double dt_v, double dt_x);
+
+#endif /* HOLOS_DYNAMICS_GPU_H */
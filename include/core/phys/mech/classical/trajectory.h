@@ -0,0 +1,135 @@
+/* trajectory.h - Memory-mapped binary trajectories for HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+    On-disk trajectory of a dyn_system_t.
+
+    File layout (native byte order):
+        header | masses (N doubles) | chunk 0 | chunk 1 | ...
+    Each chunk holds chunk_frames frames and starts with its frame index:
+        index (chunk_frames x {t, step}) | frame 0 | frame 1 | ...
+    A frame is fixed-stride SoA: x|y|z, then vx|vy|vz and fx|fy|fz when
+    recorded, each block N doubles long.
+
+    Writers only append; header.n_frames is rewritten on flush, so a reader
+    never sees a partly written frame. Readers map the file and touch only
+    the pages of the frames they access.
+*/
+
+#ifndef HOLOS_TRAJECTORY_H
+#define HOLOS_TRAJECTORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core/phys/mech/classical/dynamics.h"
+#include "core/phys/mech/classical/kinematics.h"
+
+/* Per-frame fields besides positions. */
+#define DYN_TRAJ_VEL      0x1u  /* Velocities */
+#define DYN_TRAJ_FORCE    0x2u  /* Forces */
+
+#define DYN_TRAJ_VERSION  1u
+
+/* File header. */
+typedef struct {
+    char magic[8];          /* "HOLOSTRJ" */
+    uint32_t version;       /* DYN_TRAJ_VERSION */
+    uint32_t fields;        /* DYN_TRAJ_* mask */
+    uint64_t n_particles;   /* Particles per frame */
+    uint64_t n_frames;      /* Complete frames in the file */
+    uint64_t chunk_frames;  /* Frames per chunk */
+    uint64_t frame_size;    /* Bytes per frame */
+    uint64_t chunk_size;    /* Bytes per chunk, index included */
+    uint64_t data_offset;   /* File offset of chunk 0 */
+} dyn_traj_header_t;
+
+/* Frame index entry. */
+typedef struct {
+    double t;               /* Simulation time */
+    int64_t step;           /* dyn_system_t.step_count */
+} dyn_traj_index_t;
+
+/* Open trajectory (write or read mode). */
+typedef struct {
+    int fd;                 /* File descriptor */
+    int writable;           /* 1 if opened by dyn_traj_create */
+    dyn_traj_header_t hdr;  /* Header (n_frames is current in write mode) */
+    unsigned char *map;     /* Read-only mapping (read mode) */
+    size_t map_size;        /* Bytes mapped */
+    double *buf;            /* Frame gather buffer (write mode) */
+} dyn_traj_t;
+
+/* Pointers into one mapped frame; unrecorded fields are NULL. */
+typedef struct {
+    double t;
+    int64_t step;
+    size_t n;               /* Particles */
+    const double *pos[3];   /* x, y, z blocks */
+    const double *vel[3];   /* vx, vy, vz blocks */
+    const double *force[3]; /* fx, fy, fz blocks */
+} dyn_traj_frame_t;
+
+/* ---- Writing ---- */
+
+/* Create a trajectory for sys's particle count and masses (chunk_frames 0 -> 64). */
+dyn_traj_t *dyn_traj_create(const char *filename, const dyn_system_t *sys,
+                            unsigned fields, size_t chunk_frames);
+
+/* Append the current state of sys as a new frame (returns 0 on success). */
+int dyn_traj_append(dyn_traj_t *tr, const dyn_system_t *sys);
+
+/* Publish appended frames by rewriting the header. */
+int dyn_traj_flush(dyn_traj_t *tr);
+
+/* ---- Reading ---- */
+
+/* Map an existing trajectory read-only. */
+dyn_traj_t *dyn_traj_open(const char *filename);
+
+/* Number of complete frames. */
+size_t dyn_traj_frames(const dyn_traj_t *tr);
+
+/* Masses stored with the trajectory (N doubles). */
+const double *dyn_traj_masses(const dyn_traj_t *tr);
+
+/* Resolve frame k without reading any other frame (returns 0 on success). */
+int dyn_traj_frame(const dyn_traj_t *tr, size_t k, dyn_traj_frame_t *out);
+
+/* Copy frame k into a system with the same particle count. */
+int dyn_traj_load_frame(const dyn_traj_t *tr, size_t k, dyn_system_t *sys);
+
+/* Trajectory of one particle over frames [first, first + count) as a
+   kin_trajectory whose vectors point into the mapping (acc is NULL).
+   Must be released with dyn_traj_view_free and not outlive tr. */
+kin_trajectory *dyn_traj_particle_view(const dyn_traj_t *tr, size_t particle,
+                                       size_t first, size_t count);
+
+/* Free a view returned by dyn_traj_particle_view. */
+void dyn_traj_view_free(kin_trajectory *view);
+
+/* ---- Common ---- */
+
+/* Flush (write mode), unmap and close (returns 0 on success). */
+int dyn_traj_close(dyn_traj_t *tr);
+
+/* Append a frame to tr from dyn_system_step() every `every` steps (NULL detaches). */
+void dyn_system_attach_trajectory(dyn_system_t *sys, dyn_traj_t *tr, size_t every);
+
+#endif /* HOLOS_TRAJECTORY_H */
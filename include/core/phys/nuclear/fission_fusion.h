@@ -26,6 +26,7 @@
 #define HOLOS_FISSION_FUSION_H
 
 #include <stddef.h>
+#include <stdint.h>
 #include <gsl/gsl_vector.h>
 
 /* Nucleus structure, supporting extensible nuclear properties. */
@@ -69,9 +70,12 @@ typedef struct {
 	int n_gammas_emitted;
 	double *neutron_energies; /* Array of neutron energies (MeV) */
 	double *gamma_energies;   /* Array of gamma energies (MeV) */
+	double *neutron_weights;  /* Relative intensity of each neutron energy, NULL for equal */
+	double *gamma_weights;    /* Relative intensity of each gamma energy, NULL for equal */
 	double Q_value;           /* Energy released (MeV) */
 	double cross_section;     /* Cross-section (barns) */
 	double rate;              /* Reaction rate (1/s) */
+	void *sampler;            /* Cached alias tables of the emission lines (ff_reaction_sample_*()) */
 	void *extra;
 } ff_reaction_t;
 
@@ -146,7 +150,140 @@ int ff_emit_gammas(ff_reaction_t *reaction, double *energies, int n);
 int ff_step_euler(ff_system_t *system, double dt);
 int ff_step_runge_kutta(ff_system_t *system, double dt);
 
-/* Special-case solutions and utilities, including advanced yield and rate calculations. */
+/*
+   Emission sampling. The n_neutrons_emitted (n_gammas_emitted) entries of
+   neutron_energies (gamma_energies) are discrete lines drawn in O(1)
+   through a Walker alias table (alias_table.h) over their weights. The
+   tables are built on first use and kept on reaction->sampler, and rebuilt
+   when an energy or weight array or its length is replaced. After editing
+   values in place, and before freeing the reaction, call
+   ff_reaction_reset_samplers(). Draw once before sampling one reaction
+   from several threads.
+
+   ff_reaction_sample_*() fill energies[k] with draw first + k of
+   (seed, stream), split across n_threads threads (0 = serial, < 0 = all);
+   the buffer does not depend on the thread count. ff_emit_*() take the
+   next n draws of a process-wide sequence and return n, or -1.
+*/
+int ff_reaction_sample_neutrons(ff_reaction_t *reaction, uint64_t seed, uint64_t stream, uint64_t first,
+                                double *energies, size_t n, int n_threads);
+int ff_reaction_sample_gammas(ff_reaction_t *reaction, uint64_t seed, uint64_t stream, uint64_t first,
+                              double *energies, size_t n, int n_threads);
+void ff_reaction_reset_samplers(ff_reaction_t *reaction);
+
+/*
+   Implicit reaction network. Species are the system's nuclei, in
+   system->nuclei order, with abundances Y. Each reaction with rate > 0
+   proceeds at the mass-action flux rate * prod Y_r over its reactants
+   (repeated entries raise the power; densities and symmetry factors are
+   folded into rate), consuming its reactants and producing its products.
+   Reactants and products are matched to the species by pointer, else by
+   Z, N and energy; untracked reactants count as Y = 1 and untracked
+   products are dropped.
+
+   ff_network_integrate() advances Y with variable-step BDF (order 1 on the
+   first step of each call, then 2) and local error control. The Jacobian
+   is analytic and sparse, assembled through positions precomputed at
+   alloc; the LU pattern of I - gamma J is fixed then too. Newton
+   iterations reuse the last Jacobian and factorization while they
+   converge: the matrix is refactored when gamma drifts by more than 30%,
+   and the Jacobian is re-evaluated after 20 steps or when Newton
+   converges too slowly.
+*/
+typedef struct {
+	double rtol;                /* Relative tolerance (default 1e-6) */
+	double atol;                /* Absolute tolerance on abundances (default 1e-12) */
+	double h_init;              /* First step [s], 0 for automatic */
+	double h_max;               /* Largest step [s], 0 for none */
+	size_t max_steps;           /* Steps per ff_network_integrate() call, 0 for 100000 */
+} ff_network_params;
+
+typedef struct {
+	size_t n;                   /* Species */
+	size_t n_reactions;         /* Reactions with rate > 0 */
+	size_t nnz;                 /* Jacobian entries (diagonal included) */
+	ff_network_params prm;
+	double h;                   /* Step to try next [s], kept across calls */
+	size_t n_steps;             /* Accepted steps */
+	size_t n_rejected;          /* Error-test and Newton failures */
+	size_t n_jacobians;         /* Jacobian evaluations */
+	size_t n_factorizations;    /* LU factorizations */
+	size_t n_rhs;               /* Right-hand side evaluations */
+	void *work;                 /* Compiled reactions, LU pattern and history */
+} ff_network_t;
+
+/* prm may be NULL for the defaults. Rebuild after editing reactions. */
+ff_network_t *ff_network_alloc(const ff_system_t *system, const ff_network_params *prm);
+void ff_network_free(ff_network_t *net);
+
+/* dY/dt at abundances Y. */
+int ff_network_rates(ff_network_t *net, const double *Y, double *dYdt);
+
+/* Advance Y (in place) by dt >= 0 seconds. Returns 0, or -1 when the step
+   size underflows or max_steps is exceeded (Y then holds the last
+   accepted state). */
+int ff_network_integrate(ff_network_t *net, double *Y, double dt);
+
+/*
+   Cross-section tables. ff_xs_table_alloc() groups ff_cross_section_t
+   points by label into one reaction each, sorted by energy in contiguous
+   arrays, and builds the unionized grid of all their energies. For every
+   reaction and grid point it stores the reaction's own interval, so once
+   E is located on the grid every reaction is one gather away; E itself is
+   located through n_bins equal bins in ln E, each holding the first grid
+   point to scan from (O(1) on average for n_bins near n_union).
+
+   sigma(E) is lin-lin between points (a repeated energy is a step) and
+   constant beyond the first and last ones.
+*/
+typedef struct {
+	size_t n_reactions;
+	char (*labels)[32];         /* Reaction labels, ascending */
+	size_t *offset;             /* Reaction r holds points offset[r] .. offset[r + 1] - 1 */
+	double *energy;             /* Point energies (MeV), ascending per reaction */
+	double *value;              /* Cross sections (barns) */
+	double *slope;              /* (value[j + 1] - value[j]) / (energy[j + 1] - energy[j]), 0 at steps and ends */
+	size_t n_union;
+	double *grid;               /* Unionized energies, ascending and distinct */
+	uint32_t *index;            /* index[r * n_union + u]: last point of r at or below grid[u], else its first */
+	size_t n_bins;
+	size_t first_positive;      /* First grid point > 0, where the bins start */
+	double log_emin, inv_dlog;
+	uint32_t *bin;              /* bin[b]: last grid point at or below the lower edge of bin b */
+	void *extra;
+} ff_xs_table_t;
+
+/* Table over cs[0..n-1] (NULL entries skipped); n_bins = 0 picks the grid
+   size. NULL for no points, a non-finite energy or value, or 2^32 points. */
+ff_xs_table_t *ff_xs_table_alloc(const ff_cross_section_t *const *cs, size_t n, size_t n_bins);
+void ff_xs_table_free(ff_xs_table_t *table);
+
+/* Reaction index of label, or -1. */
+long ff_xs_table_find(const ff_xs_table_t *table, const char *label);
+
+double ff_xs_eval(const ff_xs_table_t *table, size_t reaction, double energy);
+
+/* out[k] = sigma_reaction(energies[k]) for k < n, in blocks over n_threads
+   threads (0 = serial, < 0 = all). Returns 0, or -1 on bad arguments. */
+int ff_xs_eval_batch(const ff_xs_table_t *table, size_t reaction, const double *energies, double *out, size_t n,
+                     int n_threads);
+
+/* Maxwellian reactivity <sigma v> (cm^3/s) at kT (MeV) for reduced mass mu
+   (u), integrated exactly over the tabulated range of the lin-lin sigma. */
+double ff_xs_reactivity(const ff_xs_table_t *table, size_t reaction, double mu, double kT);
+
+/* Table read by ff_fission_yield() and ff_fusion_rate(); NULL to detach.
+   Set it before those are called from several threads. */
+void ff_xs_set_default(const ff_xs_table_t *table);
+
+/*
+   Special-case solutions and utilities, including advanced yield and rate calculations.
+   ff_fission_yield() is the "<symbol>(n,f)" cross section (barns) of the
+   default table at energy (MeV); ff_fusion_rate() the reactivity (cm^3/s)
+   of "<symbol1>+<symbol2>" (either order) at temperature kT (MeV), with
+   masses from nucleus->mass, else Z + N. Both are 0 when no such
+   reaction is tabulated.
+*/
 double ff_average_neutron_energy(const ff_reaction_t *reaction);
 double ff_average_gamma_energy(const ff_reaction_t *reaction);
 double ff_fission_yield(const ff_nucleus_t *nucleus, double energy);
@@ -26,6 +26,7 @@
 #define HOLOS_NUCLEAR_DECAY_H
 
 #include <stddef.h>
+#include <stdint.h>
 #include <gsl/gsl_vector.h>
 
 /* Nucleus structure for decay modeling, supporting extensible nuclear properties. */
@@ -73,6 +74,7 @@ typedef struct {
 	double *time_evolution;         /* Array of time-dependent observables */
 	size_t n_time;
 	nd_nucleus_t *daughter;         /* Daughter nucleus */
+	void *sampler;                  /* Cached alias table of emission_spectrum (nd_decay_branch_sample()) */
 	void *extra;
 } nd_decay_branch_t;
 
@@ -83,6 +85,7 @@ typedef struct {
 	size_t n_branches;
 	double *time_evolution;         /* Array of time-dependent observables */
 	size_t n_time;
+	void *bateman;                  /* Cached Bateman coefficients (nd_bateman_chain_batch()) */
 	void *extra;
 } nd_decay_chain_t;
 
@@ -108,6 +111,8 @@ typedef struct {
 	char **materials;               /* Array of material/medium names */
 	size_t n_materials;
 	nd_diagnostics_t diagnostics;
+	double *abundances;             /* Numbers of nuclei [n_nuclei], advanced by nd_step_decay(), not owned */
+	void *depletion;                /* Cached depletion engine of nd_step_decay() */
 	void *extra;
 } nd_system_t;
 
@@ -136,7 +141,34 @@ void nd_decay_chain_print(const nd_decay_chain_t *chain);
 /* Simulation step utilities, including delayed emission. */
 int nd_emit_delayed_neutrons(nd_decay_branch_t *branch, double *energies, int n);
 int nd_emit_delayed_gammas(nd_decay_branch_t *branch, double *energies, int n);
+
+/* Advances system->abundances by dt seconds with the depletion engine
+   below, built on the first step and kept on system->depletion (its
+   factorizations are reused while dt is unchanged), and sets
+   diagnostics.total_activity to the activity after the step (Bq).
+   Release the engine with nd_step_decay_release() after editing chains or
+   branches, and before freeing the system. */
 int nd_step_decay(nd_system_t *system, double dt);
+void nd_step_decay_release(nd_system_t *system);
+
+/*
+   Spectrum sampling. emission_spectrum holds n_spectrum relative
+   intensities over equal-width energy bins spanning [0, Q_value] MeV; a
+   draw picks a bin in O(1) through a Walker alias table (alias_table.h)
+   and a uniform energy inside it. The table is built on first use and
+   kept on branch->sampler, and rebuilt when emission_spectrum or
+   n_spectrum is replaced. After editing the intensities in place, and
+   before freeing the branch, call nd_decay_branch_reset_sampler(). Draw
+   once before sampling one branch from several threads.
+
+   nd_decay_branch_sample() fills energies[k] with draw first + k of
+   (seed, stream), split across n_threads threads (0 = serial, < 0 = all);
+   the buffer does not depend on the thread count. nd_emit_delayed_*()
+   take the next n draws of a process-wide sequence and return n, or -1.
+*/
+int nd_decay_branch_sample(nd_decay_branch_t *branch, uint64_t seed, uint64_t stream, uint64_t first,
+                           double *energies, size_t n, int n_threads);
+void nd_decay_branch_reset_sampler(nd_decay_branch_t *branch);
 
 /* Special-case solutions and utilities, including Bateman equations and advanced activity calculations. */
 double nd_bateman_chain(const nd_decay_chain_t *chain, double t, double n0);
@@ -144,4 +176,60 @@ double nd_average_emission_energy(const nd_decay_branch_t *branch);
 double nd_branch_activity(const nd_decay_branch_t *branch, double n_parent);
 double nd_chain_activity(const nd_decay_chain_t *chain, double n_parent);
 
+/*
+   Batch Bateman evaluation. The chain is read as a linear sequence: member
+   0 is the parent, member k + 1 is branches[k]->daughter, and member k
+   decays with constant ln2 / branches[k]->half_life, a fraction
+   branching_ratio of it feeding member k + 1. The last member is the end
+   of the chain and does not decay. nd_bateman_chain() is the abundance of
+   the last member, nd_chain_activity() the parent activity at t = 0.
+
+   The batch calls evaluate out[i] for times t[i] and parent abundances
+   n0[i] at t = 0 (n0 may be NULL for 1) as sums of cached coefficients
+   times exponentials, with a vectorized exp over the time points. The
+   O(chain^2) coefficients are built on the first call and kept on
+   chain->bateman; later calls rebuild them only when a half-life or
+   branching ratio changed. Release them with nd_bateman_chain_release()
+   before freeing the chain. Coincident decay constants are split by a
+   relative 1e-9.
+*/
+int nd_bateman_chain_batch(nd_decay_chain_t *chain, const double *t, const double *n0, size_t count, double *out);
+/* Total activity of all decaying members (Bq) at each t[i]. */
+int nd_chain_activity_batch(nd_decay_chain_t *chain, const double *t, const double *n0, size_t count, double *out);
+void nd_bateman_chain_release(nd_decay_chain_t *chain);
+
+/*
+   Depletion engine: the whole system as one sparse transmutation matrix,
+   dN/dt = A N, advanced by N(t + dt) = exp(A dt) N(t) with the order-16
+   Chebyshev Rational Approximation (CRAM, Pusa 2011). Each branch of each
+   chain contributes a partial constant branching_ratio * ln2 / half_life,
+   removed from its parent and, when the daughter is one of the system's
+   nuclei (same pointer, else same Z, N and energy), added to the daughter.
+   Branches with a non-positive or infinite half-life are stable.
+
+   CRAM is accurate to ~1e-14 for any eigenvalues on the negative real
+   axis, so one step covers any dt however stiff the network. The matrix,
+   its ordering (parents before daughters, so a pure decay network factors
+   without fill) and the symbolic LU pattern are built once at alloc; the
+   8 complex factorizations are kept for the last dt and reused while dt
+   is unchanged. Rebuild the engine after editing chains or branches.
+*/
+typedef struct {
+	size_t n;                       /* Nuclides, in system->nuclei order */
+	size_t nnz;                     /* Stored entries of A */
+	size_t *row_ptr;                /* A in CSR over nuclide indices [n + 1] */
+	size_t *col;                    /* [nnz] */
+	double *val;                    /* [nnz], 1/s */
+	int n_threads;                  /* 0 = serial, otherwise threads over the CRAM poles */
+	void *work;                     /* Ordering, LU pattern and cached factors */
+} nd_depletion_t;
+
+nd_depletion_t *nd_depletion_alloc(const nd_system_t *system);
+void nd_depletion_free(nd_depletion_t *dep);
+int nd_depletion_set_threads(nd_depletion_t *dep, int n_threads);
+
+/* n1 = exp(A dt) n0 for abundances indexed like system->nuclei (n1 may
+   alias n0). dt >= 0 in seconds. */
+int nd_depletion_step(nd_depletion_t *dep, double dt, const double *n0, double *n1);
+
 #endif /* HOLOS_NUCLEAR_DECAY_H */
@@ -70,6 +70,7 @@ typedef struct {
 	double (*tensor_fn)(double r, void *params);    /* Tensor term (optional) */
 	double (*three_body_fn)(double r1, double r2, void *params); /* Three-body term (optional) */
 	void *params;
+	void *table;                                    /* Spline tables (nf_potential_tabulate()), NULL for direct calls */
 	void *extra;
 } nf_potential_t;
 
@@ -144,4 +145,30 @@ double nf_average_correlation(const nf_system_t *system);
 double nf_binding_energy(const nf_system_t *system);
 double nf_pair_potential(const nf_nucleon_t *n1, const nf_nucleon_t *n2, const nf_potential_t *pot);
 
+/*
+   Tabulated potentials. nf_potential_tabulate() samples potential_fn (and
+   tensor_fn when set) on a uniform grid over [r_min, r_max] and fits a
+   clamped cubic spline, doubling the grid until the spline is within
+   rtol * |V| + atol of the callback at the interval quarter points (up to
+   2^20 intervals; -1 if that is not enough, or a callback is not finite).
+   Inside the range the nf_potential_eval*() functions, nf_pair_potential()
+   and nf_binding_energy() then read the table without branching; outside
+   it, and for untabulated potentials, they call the callbacks (dV/dr by
+   central differences). Retabulate after changing params.
+
+   nf_pair_potential() is V at the distance of the two positions (0 if
+   one is missing); nf_binding_energy() is minus the sum of V(r_ij) over
+   nucleon pairs and force models, each model scaled by its
+   coupling_constant when that is non-zero.
+*/
+int nf_potential_tabulate(nf_potential_t *pot, double r_min, double r_max, double rtol, double atol);
+void nf_potential_untabulate(nf_potential_t *pot);
+
+/* V(r) (MeV) and, if dvdr is not NULL, dV/dr (MeV/fm). */
+double nf_potential_eval(const nf_potential_t *pot, double r, double *dvdr);
+double nf_potential_eval_tensor(const nf_potential_t *pot, double r, double *dvdr);
+
+/* v[k] = V(r[k]) and dvdr[k] = dV/dr (dvdr may be NULL) for k < n. */
+int nf_potential_eval_batch(const nf_potential_t *pot, const double *r, double *v, double *dvdr, size_t n);
+
 #endif /* HOLOS_NUCLEAR_FORCES_H */
\ No newline at end of file
@@ -0,0 +1,119 @@
+/* obs_stream.h - Streaming observable sink for HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+    Time series of observables (a scalar or a fixed-width profile per
+    step) written to one binary file while a run goes on, for the
+    *_diagnostics_update() functions of entropy.h, heat_transfer.h and
+    thermodynamics.h.
+    - Each observable has a bounded ring of chunks; a push copies one
+      record into the current chunk and never formats or writes
+    - A background thread encodes full chunks and appends them to the
+      file: columns XOR-delta coded against the previous record, each
+      word stored without its leading zero bytes
+    - Optional decimation (every k-th push) or reduction (min, max and
+      mean per element over each window of k pushes) before the ring
+    When a ring is full, push waits for the writer, or drops the record
+    (counted) with drop set. One thread at a time may push to a given
+    observable; flush and close must not race with pushes.
+
+    File: "HOLOSOBS", a uint32 version, then blocks in native byte order:
+    'D' declares an observable before its first chunk, 'C' holds a chunk
+    (see obs_stream.c). obs_stream_dump() prints a file as text.
+*/
+
+#ifndef HOLOS_OBS_STREAM_H
+#define HOLOS_OBS_STREAM_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+typedef enum {
+    OBS_SAMPLE,             /* First push of each window, as is */
+    OBS_STATS               /* Per element min, max, mean over the window: width minima, maxima, then means */
+} obs_reduce_t;
+
+typedef struct {
+    size_t chunk_records;   /* Records per chunk, 0 for 256 */
+    size_t ring_chunks;     /* Chunks buffered per observable, 0 for 4 */
+    int drop;               /* Drop records while a ring is full instead of waiting */
+    int raw;                /* Store chunks unencoded */
+} obs_stream_params;
+
+typedef struct {
+    size_t n_observables;
+    size_t n_pushed;        /* Pushes accepted (before decimation) */
+    size_t n_dropped;       /* Records lost to full rings */
+    size_t n_chunks;        /* Chunks written */
+    size_t bytes;           /* Bytes written */
+    void *work;             /* Series, rings and the writer thread */
+} obs_stream;
+
+/* Creates path (truncating it) and starts the writer; prm may be NULL
+   for the defaults. NULL on failure. */
+obs_stream *obs_stream_open(const char *path, const obs_stream_params *prm);
+
+/* Flushes, stops the writer and closes the file. Returns 0, or -1 if any
+   write failed. */
+int obs_stream_close(obs_stream *s);
+
+/* New observable of width values per push (name at most 63 characters),
+   kept every decimate-th push or reduced over windows of decimate pushes
+   (0 or 1: every push). Returns its id, or -1. */
+int obs_stream_add(obs_stream *s, const char *name, size_t width, size_t decimate, obs_reduce_t reduce);
+
+/* One push of values[0..width-1] at time t. Returns 0, or -1 on bad
+   arguments or after a write error. */
+int obs_stream_push(obs_stream *s, int id, double t, const double *values);
+
+/* Hands the partly filled chunks to the writer and waits until all of
+   them are on disk (windows of OBS_STATS still open stay open). */
+int obs_stream_flush(obs_stream *s);
+
+/* Prints every record of the file at path as "name t v0 v1 ...". Returns
+   0, or -1 if the file is unreadable or malformed. */
+int obs_stream_dump(const char *path, FILE *out);
+
+/*
+    Binding of a diagnostics struct to a stream, for the
+    *_diagnostics_update() functions: field k is added to the stream as
+    "<prefix>.<name>" on its first push, with the width of that push;
+    later pushes of another width are dropped. n_updates counts the
+    updates, the time of records that have no other.
+*/
+#define OBS_BINDING_FIELDS 8
+
+typedef struct {
+    obs_stream *stream;
+    char prefix[16];
+    size_t decimate;
+    obs_reduce_t reduce;
+    size_t n_updates;
+    int id[OBS_BINDING_FIELDS];         /* -1 until added */
+    size_t width[OBS_BINDING_FIELDS];
+} obs_binding;
+
+obs_binding *obs_binding_alloc(obs_stream *s, const char *prefix, size_t decimate, obs_reduce_t reduce);
+void obs_binding_free(obs_binding *b);
+
+/* Pushes values[0..width-1] as field k (nothing for width 0). Returns 0,
+   or -1 on bad arguments, a width change or a stream error. */
+int obs_binding_push(obs_binding *b, size_t k, const char *name, double t, const double *values, size_t width);
+
+#endif /* HOLOS_OBS_STREAM_H */
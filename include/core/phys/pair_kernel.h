@@ -0,0 +1,75 @@
+/* pair_kernel.h - Vectorized inverse-square pair interactions for HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+    Direct-summation kernel shared by gravity (dynamics.h) and Coulomb
+    interactions (lorentz_forces.h).
+    - Inputs are structure-of-arrays component pointers
+    - AVX-512F, AVX2+FMA and NEON paths, selected at runtime
+    - 1/sqrt(r^2) from the hardware estimate plus Newton refinement
+*/
+
+#ifndef HOLOS_PAIR_KERNEL_H
+#define HOLOS_PAIR_KERNEL_H
+
+#include <stddef.h>
+
+/* Instruction set used by the kernel. */
+typedef enum {
+    PK_ISA_AUTO = 0,    /* Best available on this CPU */
+    PK_ISA_SCALAR,      /* Portable C */
+    PK_ISA_AVX2,        /* x86-64 AVX2 + FMA, 4 doubles per lane group */
+    PK_ISA_AVX512,      /* x86-64 AVX-512F, 8 doubles per lane group */
+    PK_ISA_NEON         /* AArch64 Advanced SIMD, 2 doubles per lane group */
+} pk_isa_t;
+
+/*
+    For every target i in [i0, i1):
+
+        f_i += scale * w_i * sum_j w_j (x_j - x_i) / (|x_j - x_i|^2 + eps2)^(3/2)
+
+    over all n sources j (the i == j term vanishes). For gravity use
+    scale = G and w = mass; for Coulomb use scale = -k_e and w = charge.
+    Targets and sources are the same particle set.
+*/
+void pk_inverse_square(const double *x, const double *y, const double *z,
+                       const double *w, size_t n, size_t i0, size_t i1,
+                       double scale, double eps2,
+                       double *fx, double *fy, double *fz);
+
+/* Same as pk_inverse_square, also adding the pair potential sum to pot:
+
+        pot_i += scale * w_i * sum_{j != i} w_j / sqrt(|x_j - x_i|^2 + eps2)
+
+   Every pair appears in two targets' sums. */
+void pk_inverse_square_pot(const double *x, const double *y, const double *z,
+                           const double *w, size_t n, size_t i0, size_t i1,
+                           double scale, double eps2,
+                           double *fx, double *fy, double *fz, double *pot);
+
+/* Force a specific instruction set (falls back to scalar if unsupported). */
+void pk_set_isa(pk_isa_t isa);
+
+/* Instruction set the kernel currently dispatches to. */
+pk_isa_t pk_active_isa(void);
+
+/* Human-readable name of an instruction set. */
+const char *pk_isa_name(pk_isa_t isa);
+
+#endif /* HOLOS_PAIR_KERNEL_H */
@@ -30,6 +30,8 @@
 #include <gsl/gsl_vector.h>
 #include <gsl/gsl_matrix.h>
 
+#include "core/phys/ss/crystal_lattice.h"
+
 /* Lattice structure for solid state systems, supporting symmetry and atomic basis. */
 typedef struct {
 	char name[32];
@@ -92,6 +94,144 @@ typedef struct {
 	void *extra;
 } bs_diagnostics_t;
 
+/*
+    Band engine (band_structure_engine.c). The model writes H(k), a
+    Hermitian n x n matrix, row-major with interleaved real and imaginary
+    parts; only its lower triangle (diagonal included) is read, and h
+    arrives zeroed so terms may be accumulated. Each step solves every
+    k-point in parallel and keeps the n_bands consecutive bands from
+    band_first (say, those around the Fermi level) with a partial solver:
+    LAPACK zheevr over that index range with configure --with-lapack,
+    gsl_eigen_herm and a sort otherwise. Per-thread workspaces are made
+    on the first step and reused while n and the thread count hold.
+*/
+typedef int (*bs_hamiltonian_fn)(const double *k, size_t dim, double *h, size_t n, void *params);
+
+/* SCF output, called by bs_step_scf() after each band calculation: the
+   density (or potential) that the bands (energies, n_kpoints x n_bands
+   as in bs_hamiltonian_t) and k-point weights give, from the input
+   density_in the model was built with. */
+typedef int (*bs_scf_fn)(const double *energies, const double *weights, size_t n_kpoints, size_t n_bands,
+	const double *density_in, double *density_out, size_t n_density, void *params);
+
+/*
+    SCF mixing (band_structure_scf.c). With F = out - in the residual of
+    an iteration, the next input is in + alpha P F corrected from the
+    last history iterations: Pulay/Anderson picks the combination of past
+    residuals of least norm, Broyden (second method) builds an inverse
+    Jacobian from rank-one secant updates. P is Kerker's
+    g2 / (g2 + kerker_q0^2) when the density is stored by reciprocal
+    vector with its |G|^2 in g2, the identity otherwise. Checkpoints hold
+    the density and the mixer history; a run with restart set resumes
+    from one written for the same n_density and method.
+*/
+typedef enum {
+	BS_MIX_LINEAR,
+	BS_MIX_PULAY,
+	BS_MIX_BROYDEN
+} bs_mix_t;
+
+typedef struct {
+	bs_mix_t method;
+	double alpha;                    /* Mixing weight, 0 for 0.3 */
+	size_t history;                  /* Iterations kept, 0 for 8 */
+	double kerker_q0;                /* Kerker wavevector, 0 for none */
+	const double *g2;                /* |G|^2 per density element for Kerker, n_density */
+	const char *checkpoint;          /* Checkpoint file, NULL for none */
+	size_t checkpoint_every;         /* Iterations between checkpoints, 0 for 10 */
+	int restart;                     /* Resume from checkpoint when it exists */
+} bs_scf_params;
+
+typedef struct {
+	size_t n;                        /* Basis size (order of H(k)) */
+	bs_hamiltonian_fn fn;
+	void *params;
+	bs_scf_fn update;                /* For bs_step_scf(), may be NULL */
+	double *density;                 /* SCF input read by fn through params, n_density (not owned) */
+	size_t n_density;
+	bs_scf_params scf;
+	size_t band_first;               /* First band kept, counted from the lowest */
+	size_t n_bands;                  /* Bands kept, 0 for all from band_first */
+	int n_threads;                   /* 0 serial, < 0 all available */
+	double *energies;                /* n_kpoints x n_kept band energies (eV), a row per k-point, ascending */
+	size_t n_kpoints;
+	size_t n_kept;
+	size_t n_solves;                 /* Diagonalizations so far */
+	size_t n_scf_iterations;         /* Of the last bs_step_scf(), with those resumed */
+	double scf_residual;             /* RMS of out - in */
+	void *work;                      /* Per-thread eigensolver workspaces */
+	void *extra;
+} bs_hamiltonian_t;
+
+bs_hamiltonian_t *bs_hamiltonian_alloc(size_t n, bs_hamiltonian_fn fn, void *params);
+void bs_hamiltonian_free(bs_hamiltonian_t *ham);
+
+/*
+    k-point meshes and tetrahedron integration (band_structure_kmesh.c).
+    A Monkhorst-Pack mesh of n[0] x n[1] x n[2] points, optionally
+    shifted by half a step per axis, is reduced to its irreducible wedge
+    under a point group (and time reversal, k ~ -k): one representative
+    per orbit, weighted by the orbit size. Band energies of the wedge are
+    unfolded to the full mesh by the irr map; the linear tetrahedron
+    method (six tetrahedra per mesh cell, split along the shortest cell
+    diagonal) then gives the DOS, the Fermi energy and the Fermi surface
+    area without broadening.
+    Fractional coordinates are in the reciprocal basis; recip holds the
+    reciprocal vectors as rows (dim x dim), NULL to stay fractional.
+*/
+#define BS_MAX_OPS 48
+
+typedef struct {
+	size_t n_ops;
+	int rot[BS_MAX_OPS][9];          /* Rotations of fractional k, row-major 3 x 3 */
+} bs_point_group_t;
+
+typedef struct {
+	size_t dim;
+	size_t n[3];                     /* Divisions per axis, 1 beyond dim */
+	int shift[3];                    /* 1 for the half-step offset */
+	size_t n_full;
+	size_t n_irr;
+	double *k;                       /* n_irr x 3 fractional k of the representatives */
+	double *weight;                  /* n_irr, summing to 1 */
+	size_t *irr;                     /* n_full: irreducible point of each mesh point */
+	int *op;                         /* n_full: op o (-o-1 for o with time reversal) taking the representative there */
+	size_t *full;                    /* n_irr: mesh index of each representative */
+} bs_kmesh_t;
+
+/* Holohedry of the lattice geom->vectors: the integer matrices of entries
+   -1, 0, 1 that preserve its metric (to relative tol, 0 for 1e-6). */
+int bs_point_group(const cl_geometry_t *geom, double tol, bs_point_group_t *group);
+
+/* group may be NULL for time reversal only; ops that do not map the mesh
+   onto itself are left out. NULL on bad arguments. */
+bs_kmesh_t *bs_kmesh_alloc(size_t dim, const size_t n[3], const int shift[3], const bs_point_group_t *group);
+void bs_kmesh_free(bs_kmesh_t *mesh);
+
+/* kpoints[0..n_irr-1] for the wedge (Cartesian k with recip). */
+int bs_kmesh_kpoints(const bs_kmesh_t *mesh, const gsl_matrix *recip, bs_kpoint_t **kpoints);
+
+/* Fractional k of mesh point i */
+void bs_kmesh_point(const bs_kmesh_t *mesh, size_t i, double k[3]);
+
+/* full (n_full x width) from values (n_irr x width), for quantities that
+   the point group leaves unchanged such as band energies. */
+int bs_kmesh_unfold(const bs_kmesh_t *mesh, const double *values, size_t width, double *full);
+
+/* Tetrahedron integrals over the bands in energies (n_irr x n_bands, as
+   in bs_hamiltonian_t), each holding degeneracy electrons. dos and idos
+   (either may be NULL) get the states per energy and per cell below E
+   at each of E[0..n_e-1]. */
+int bs_tetra_dos(const bs_kmesh_t *mesh, const gsl_matrix *recip, const double *energies, size_t n_bands,
+	double degeneracy, const double *E, size_t n_e, double *dos, double *idos);
+/* Energy at which the bands hold n_electrons; -1 if they cannot. */
+int bs_tetra_fermi(const bs_kmesh_t *mesh, const double *energies, size_t n_bands, double degeneracy,
+	double n_electrons, double *fermi);
+/* Area of the surface E = fermi summed over the bands, in the units of
+   recip squared (recip required). Negative on error. */
+double bs_tetra_fermi_area(const bs_kmesh_t *mesh, const gsl_matrix *recip, const double *energies, size_t n_bands,
+	double fermi);
+
 /* Band structure system, supporting batch operations and extensibility. */
 typedef struct {
 	bs_lattice_t *lattice;
@@ -105,6 +245,9 @@ typedef struct {
 	char **materials;                   /* Array of material/compound names */
 	size_t n_materials;
 	bs_diagnostics_t diagnostics;
+	bs_hamiltonian_t *hamiltonian;     /* Model of bs_step_band_calculation(), not owned */
+	bs_kmesh_t *kmesh;                 /* Mesh that kpoints were made from, not owned */
+	double n_electrons;                /* Per cell in the bands of hamiltonian->energies (spin degenerate) */
 	void *extra;
 } bs_system_t;
 
@@ -137,10 +280,18 @@ void bs_eigenvalue_print(const bs_eigenvalue_t *eig);
 /* Simulation step utilities, including Fermi surface and velocity calculations. */
 int bs_step_fermi_surface(bs_system_t *system);
 int bs_step_velocity(bs_system_t *system);
+/* Band calculations through system->hamiltonian, each followed by its
+   update and a mixing step into density, until the residual is below
+   tol (density then holds the last input); -1 if max_iter pass first.
+   Without update, or with n_density 0, one band calculation. */
 int bs_step_scf(bs_system_t *system, double tol, int max_iter);
+/* Fills system->hamiltonian->energies over system->kpoints, and the bands
+   whose n_kpoints match with the columns kept. */
 int bs_step_band_calculation(bs_system_t *system);
 
-/* Special-case solutions and utilities, including advanced band gap and Fermi surface calculations. */
+/* Special-case solutions and utilities, including advanced band gap and Fermi surface calculations.
+   bs_fermi_energy() and bs_fermi_surface_area() integrate over system->kmesh with tetrahedra (NAN
+   without a mesh or bands); the area is at diagnostics.fermi_energy. */
 double bs_average_velocity(const bs_system_t *system);
 double bs_fermi_surface_area(const bs_system_t *system);
 double bs_find_band_gap(const bs_system_t *system);
@@ -82,9 +82,168 @@ typedef struct {
 	size_t n_angles;
 	int **neighbor_list;                 /* Neighbor list for each atom */
 	size_t *n_neighbors;
+	size_t n_force_calls;                /* Energy model evaluations by relaxation */
+	size_t n_relax_steps;                /* Relaxation iterations */
+	double energy;                       /* Energy (enthalpy, variable cell) after relaxation */
+	double max_force;                    /* Largest residual force after relaxation */
 	void *extra;
 } cl_diagnostics_t;
 
+/*
+    Periodic neighbor list (crystal_lattice_neighbors.c), shared by the
+    relaxation, phonon and defect code. Atoms are at the Cartesian
+    basis->positions of a cell spanned by the rows of geometry->vectors
+    (any triclinic cell; dim < 3 is periodic along the dim axes only).
+    Every pair closer than cutoff + skin is stored from both ends, in CSR
+    form: the neighbors of atom i are index[k] for k in
+    offset[i] .. offset[i + 1] - 1, each at the periodic image
+    image[3k .. 3k+2] (cells along the lattice vectors), so that
+        r_ij = pos[index[k]] + sum_a image[3k+a] vectors[a] - pos[i].
+    Atoms may leave the cell; images follow them. The list stays valid
+    while the atoms have moved less than skin / 2 (less still once the
+    cell has been strained).
+*/
+typedef struct {
+	double cutoff;                       /* Interaction range */
+	double skin;                         /* Extra shell kept in the list */
+	int n_threads;                       /* 0 serial, < 0 all available */
+	size_t n_atoms;                      /* Atoms the list was built for */
+	size_t *offset;                      /* Row starts, n_atoms + 1 */
+	size_t *index;                       /* Neighbor atoms, offset[n_atoms] entries */
+	int *image;                          /* Cell shift per entry, 3 x offset[n_atoms] */
+	size_t cap;                          /* Entries allocated in index */
+	double *ref;                         /* Positions at the last build (3 x n_atoms) */
+	double cell[9];                      /* Lattice vectors at the last build */
+	size_t n_builds;                     /* Full rebuilds performed */
+	size_t n_updates;                    /* Update requests (rebuilt or reused) */
+	void *work;                          /* Bins */
+} cl_neighbor_list_t;
+
+cl_neighbor_list_t *cl_neighbor_list_alloc(double cutoff, double skin);
+void cl_neighbor_list_free(cl_neighbor_list_t *nl);
+
+/* Rebuilds the list for geom and basis. */
+int cl_neighbor_list_build(cl_neighbor_list_t *nl, const cl_geometry_t *geom, const cl_basis_t *basis);
+
+/* Rebuilds only if the moves since the last build could have brought a
+   pair from beyond cutoff + skin to within cutoff: skin / 2 per atom in a
+   fixed cell, less under strain (see crystal_lattice_neighbors.c), or if
+   the atom count changed. Returns 1 if rebuilt, 0 if the list was still
+   valid, -1 on error. */
+int cl_neighbor_list_update(cl_neighbor_list_t *nl, const cl_geometry_t *geom, const cl_basis_t *basis);
+
+/* Bond vector r_ij of entry k (row i) at the current positions and cell */
+void cl_neighbor_vector(const cl_neighbor_list_t *nl, const cl_geometry_t *geom, const cl_basis_t *basis, size_t i, size_t k, double r[3]);
+
+/*
+    Virtual supercell (crystal_lattice_supercell.c): n[0] x n[1] x n[2]
+    copies of a unit cell that are never stored. Atom a of the supercell
+    is basis atom a % n_basis in cell a / n_basis, cells numbered
+    (c0 n[1] + c1) n[2] + c2; its position is computed from the lattice
+    translation. Only perturbed sites (displaced, substituted, vacant)
+    are kept, sorted by atom index.
+
+    Neighbors come from the unit-cell neighbor list: atom (b, c) sees the
+    row of b, shifted by c. With displaced sites the list stays right as
+    long as no displacement exceeds skin / 2.
+*/
+#define CL_SITE_DISPLACED   0x1
+#define CL_SITE_SUBSTITUTED 0x2
+#define CL_SITE_VACANCY     0x4
+
+typedef struct {
+	size_t atom;                         /* Supercell atom index */
+	int flags;                           /* CL_SITE_* */
+	int atomic_number;                   /* Substituted species */
+	double mass;                         /* Substituted mass (u) */
+	double u[3];                         /* Displacement from the lattice site */
+} cl_site_t;
+
+typedef struct {
+	const cl_unit_cell_t *cell;          /* Unit cell (not owned) */
+	size_t n[3];                         /* Replication along each lattice vector */
+	size_t n_basis, n_cells, n_atoms;
+	size_t dim;
+	double vectors[9];                   /* Unit cell lattice vectors, padded to 3 x 3 */
+	cl_site_t *sites;                    /* Perturbed sites, sorted by atom */
+	size_t n_sites, cap_sites;
+	void *extra;
+} cl_supercell_t;
+
+/* Pair term for cl_supercell_pair_energy(); species are atomic numbers,
+   or basis indices when the basis has none; fn(zi, zj) = fn(zj, zi). */
+typedef double (*cl_pair_fn)(int zi, int zj, double r, void *params);
+
+cl_supercell_t *cl_supercell_alloc(const cl_unit_cell_t *cell, size_t nx, size_t ny, size_t nz);
+void cl_supercell_free(cl_supercell_t *sc);
+size_t cl_supercell_atom(const cl_supercell_t *sc, size_t b, const size_t c[3]);
+void cl_supercell_split(const cl_supercell_t *sc, size_t atom, size_t *b, size_t c[3]);
+
+/* Perturbed site of atom, or NULL for a perfect one */
+const cl_site_t *cl_supercell_site(const cl_supercell_t *sc, size_t atom);
+int cl_supercell_displace(cl_supercell_t *sc, size_t atom, const double u[3]);
+int cl_supercell_substitute(cl_supercell_t *sc, size_t atom, int atomic_number, double mass);
+int cl_supercell_vacate(cl_supercell_t *sc, size_t atom);
+/* Drops the perturbation of atom, back to the perfect site */
+int cl_supercell_restore(cl_supercell_t *sc, size_t atom);
+
+/* Cartesian position (displacement included), mass and species of atom;
+   a vacancy still has its lattice site. */
+void cl_supercell_position(const cl_supercell_t *sc, size_t atom, double r[3]);
+double cl_supercell_mass(const cl_supercell_t *sc, size_t atom);
+int cl_supercell_species(const cl_supercell_t *sc, size_t atom);
+int cl_supercell_vacant(const cl_supercell_t *sc, size_t atom);
+
+/* Neighbors of atom from nl, a list built for sc->cell: the row has
+   cl_supercell_row() entries, and entry k is the atom returned by
+   cl_supercell_neighbor(), at bond vector r (displacements included). */
+size_t cl_supercell_row(const cl_supercell_t *sc, const cl_neighbor_list_t *nl, size_t atom);
+size_t cl_supercell_neighbor(const cl_supercell_t *sc, const cl_neighbor_list_t *nl, size_t atom, size_t k, double r[3]);
+
+/* Pair energy of the whole supercell, sum over pairs of fn(r) within
+   nl->cutoff: n_cells times the unit-cell sum, corrected at the
+   perturbed sites only. */
+int cl_supercell_pair_energy(const cl_supercell_t *sc, const cl_neighbor_list_t *nl, cl_pair_fn fn, void *params, double *energy);
+
+/*
+    Structural relaxation (crystal_lattice_relax.c). The energy model
+    fills the energy, the Cartesian forces (n_atoms x dim) and, when
+    stress is not NULL, the stress dE/d(strain) / volume (dim x dim);
+    nl is the system's neighbor list, refreshed before every call (NULL
+    when the system has none). Steps are line-search free: FIRE damped
+    dynamics, or L-BFGS with the step length capped at max_step. A
+    variable cell relaxes the deformation of the lattice vectors along
+    with the atoms, minimizing E + pressure V.
+*/
+typedef enum {
+	CL_RELAX_FIRE,
+	CL_RELAX_LBFGS
+} cl_relax_method_t;
+
+typedef int (*cl_force_fn)(const cl_geometry_t *geom, const cl_basis_t *basis, const cl_neighbor_list_t *nl,
+	double *energy, double *forces, double *stress, void *params);
+
+typedef struct {
+	cl_relax_method_t method;
+	cl_force_fn force;
+	void *params;
+	int variable_cell;                   /* Relax the lattice vectors too */
+	double pressure;                     /* External pressure (variable cell) */
+	double cell_factor;                  /* Cell coordinate scale (0 means n_atoms) */
+	double max_step;                     /* Largest move of one atom per step (0 means 0.2) */
+	double dt, dt_max;                   /* FIRE time step, start and ceiling (0 means 0.1, 1.0) */
+	size_t history;                      /* L-BFGS pairs kept (0 means 10) */
+	double curvature;                    /* L-BFGS initial Hessian (0 means 70) */
+	size_t n_force_calls;                /* Counters over the lifetime of the engine */
+	size_t n_iterations;
+	double energy;                       /* At the last evaluation */
+	double max_force;
+	void *work;
+} cl_relax_t;
+
+cl_relax_t *cl_relax_alloc(cl_relax_method_t method, cl_force_fn force, void *params);
+void cl_relax_free(cl_relax_t *relax);
+
 /* Crystal lattice system, supporting batch operations and extensibility. */
 typedef struct {
 	cl_unit_cell_t *unit_cell;
@@ -92,6 +251,9 @@ typedef struct {
 	cl_diagnostics_t diagnostics;
 	char **materials;                    /* Array of material/compound names */
 	size_t n_materials;
+	cl_neighbor_list_t *neighbors;       /* Shared neighbor list (NULL if disabled) */
+	cl_supercell_t *supercell;           /* Virtual supercell of unit_cell (NULL if none) */
+	cl_relax_t *relax;                   /* Minimizer for cl_step_relaxation() (NULL if none) */
 	void *extra;
 } cl_system_t;
 
@@ -118,8 +280,16 @@ void cl_geometry_print(const cl_geometry_t *geom);
 void cl_basis_print(const cl_basis_t *basis);
 void cl_unit_cell_print(const cl_unit_cell_t *cell);
 
+/* Keeps system->neighbors for unit_cell, pairs within cutoff + skin;
+   update refreshes it (see cl_neighbor_list_update()). */
+int cl_system_enable_neighbor_list(cl_system_t *system, double cutoff, double skin);
+int cl_system_update_neighbor_list(cl_system_t *system);
+
 /* Simulation step utilities, including defect and supercell operations. */
 int cl_step_defect(cl_system_t *system, int defect_index);
+/* Relaxes unit_cell with system->relax until no atom (or cell row) feels
+   a force above tol; returns 0 when converged, 1 after max_iter steps,
+   -1 on error. */
 int cl_step_relaxation(cl_system_t *system, double tol, int max_iter);
 int cl_step_supercell(cl_system_t *system, size_t nx, size_t ny, size_t nz);
 
@@ -77,6 +77,61 @@ typedef struct {
 	void *extra;
 } ph_diagnostics_t;
 
+/*
+    Phonon engine (phonons_engine.c). Force constants are kept once in
+    real space as a sparse list of 3 x 3 blocks Phi(i, j, r), one per
+    atom pair and bond vector r (Cartesian, the cell translation plus
+    any basis offset) within the neighbor shells the caller supplies.
+    The dynamical matrix at any q is their Fourier sum
+        D_(ia, jb)(q) = sum Phi_ab(i, j, r) e^(i q.r) / sqrt(m_i m_j),
+    diagonalized per q-point in parallel with per-thread workspaces
+    (LAPACK zheevr with configure --with-lapack, gsl_eigen_hermv
+    otherwise). Group velocities come from the same eigenvectors by
+    Hellmann-Feynman, d(omega^2)/dq = e^+ (dD/dq) e, averaged over
+    degenerate modes (that average does not depend on the basis chosen
+    inside the degenerate subspace).
+    Units: Phi in eV/A^2, masses in u, r in A, q in 1/A (with the 2 pi),
+    frequencies in THz (negative for unstable modes), velocities in km/s.
+*/
+typedef struct {
+	size_t i, j;                         /* Atoms of the basis */
+	double r[3];                         /* Bond vector (A) */
+	double phi[9];                       /* Force constant block, row-major (eV/A^2) */
+} ph_fc_term_t;
+
+typedef struct {
+	size_t n_atoms;
+	double *masses;                      /* n_atoms (u) */
+	ph_fc_term_t *terms;
+	size_t n_terms;
+	size_t cap_terms;
+	const double *qpoints;               /* n_qpoints x 3 Cartesian q (1/A), not owned */
+	size_t n_qpoints;
+	int n_threads;                       /* 0 serial, < 0 all available */
+	double *frequencies;                 /* n_qpoints x 3 n_atoms (THz), ascending per q */
+	double *velocities;                  /* n_qpoints x 3 n_atoms x 3 (km/s), by ph_step_group_velocity() */
+	size_t n_solves;                     /* Diagonalizations so far */
+	void *work;                          /* Per-thread eigensolver workspaces */
+	void *extra;
+} ph_engine_t;
+
+ph_engine_t *ph_engine_alloc(size_t n_atoms, const double *masses);
+void ph_engine_free(ph_engine_t *engine);
+
+/* Adds Phi(i, j, r) and its partner Phi(j, i, -r) = Phi^T (once for the
+   on-site block i = j, r = 0). */
+int ph_engine_add_pair(ph_engine_t *engine, size_t i, size_t j, const double r[3], const double phi[9]);
+
+/* Sets the on-site blocks to minus the sum of the others, so that
+   uniform translations cost nothing (acoustic sum rule). The symmetric
+   part is kept, which is exact for force constants with the symmetry of
+   a physical crystal. */
+int ph_engine_acoustic_sum_rule(ph_engine_t *engine);
+
+/* Frequencies (n_q x 3 n_atoms), and velocities (n_q x 3 n_atoms x 3)
+   unless NULL, at the Cartesian q[0..n_q-1]. */
+int ph_engine_solve(ph_engine_t *engine, const double *q, size_t n_q, double *frequencies, double *velocities);
+
 /* Phonon system structure, supporting batch operations and extensibility. */
 typedef struct {
 	ph_mode_t **modes;
@@ -87,6 +142,7 @@ typedef struct {
 	ph_diagnostics_t diagnostics;
 	char **materials;                    /* Array of material/compound names */
 	size_t n_materials;
+	ph_engine_t *engine;                 /* Force constants and q-points of the steps, not owned */
 	void *extra;
 } ph_system_t;
 
@@ -111,6 +167,9 @@ void ph_participation_ratio_print(const double *pr, size_t n);
 void ph_mean_free_path_print(const double *mfp, size_t n);
 
 /* Simulation step utilities, including group velocity and mean free path calculations. */
+/* ph_step_dispersion() fills engine->frequencies over engine->qpoints,
+   ph_step_group_velocity() the velocities too (in the same pass); the
+   dispersions whose n_kpoints match get branch frequencies and speeds. */
 int ph_step_dispersion(ph_system_t *system);
 int ph_step_lifetime(ph_system_t *system);
 int ph_step_group_velocity(ph_system_t *system);
@@ -27,6 +27,8 @@
 
 #include <stddef.h>
 
+#include "core/phys/obs_stream.h"
+
 /* Entropy state structure, supporting phase, chemical potential, and extensibility. */
 typedef struct {
 	double S;                      /* Entropy (J/K) */
@@ -66,6 +68,7 @@ typedef struct {
 	size_t n_flux;
 	double *entropy_production_profile; /* Array of entropy production values */
 	size_t n_prod;
+	obs_binding *stream;           /* Sink of ent_diagnostics_update() (ent_diagnostics_stream()), NULL for none */
 	void *extra;
 } ent_diagnostics_t;
 
@@ -91,7 +94,12 @@ void ent_process_free(ent_process_t *process);
 ent_system_t *ent_system_alloc(size_t n_processes);
 void ent_system_free(ent_system_t *system);
 
-/* Diagnostics and I/O utilities, including entropy flux and profile output. */
+/* Diagnostics and I/O utilities, including entropy flux and profile output.
+   ent_diagnostics_stream() attaches stream (NULL detaches), and every
+   ent_diagnostics_update() then pushes total_entropy,
+   entropy_production and the non-empty profiles as "ent.*" observables,
+   at the update count as time. */
+int ent_diagnostics_stream(ent_system_t *system, obs_stream *stream, size_t decimate, obs_reduce_t reduce);
 void ent_diagnostics_update(ent_system_t *system);
 void ent_system_print(const ent_system_t *system);
 void ent_state_print(const ent_state_t *state);
@@ -107,4 +115,19 @@ double ent_entropy_phase_change(double n, double L, double T);
 double ent_entropy_chemical(const double *mu, const double *composition, size_t n_components);
 double ent_entropy_change(const ent_state_t *initial, const ent_state_t *final);
 
+/*
+   Formulas (R = 8.314462618 J/mol/K): ent_entropy_ideal_gas() is
+   td_ideal_gas_entropy(), ent_entropy_mixing() the molar mixing entropy
+   -R sum x_c ln x_c (J/mol/K, zero fractions contributing 0) and
+   ent_entropy_phase_change() n L / T for a molar latent heat L.
+
+   Columnar forms, pointwise over count states with the conventions of
+   the td_*_n() kernels (thermodynamics.h); composition is row-major,
+   n_components fractions per state.
+*/
+int ent_entropy_ideal_gas_n(const double *n, const double *V, const double *T, double *S, size_t count, int n_threads);
+int ent_entropy_mixing_n(const double *composition, size_t n_components, double *S, size_t count, int n_threads);
+int ent_entropy_phase_change_n(const double *n, const double *L, const double *T, double *S, size_t count,
+                               int n_threads);
+
 #endif /* HOLOS_ENTROPY_H */
\ No newline at end of file
@@ -27,6 +27,8 @@
 
 #include <stddef.h>
 
+#include "core/phys/obs_stream.h"
+
 /* Heat state structure, supporting phase, anisotropy, and heat source. */
 typedef struct {
 	double T;                      /* Temperature (K) */
@@ -94,6 +96,7 @@ typedef struct {
 	size_t n_biot;
 	double *time_profile;              /* Array of time values */
 	size_t n_time;
+	obs_binding *stream;               /* Sink of ht_diagnostics_update() (ht_diagnostics_stream()), NULL for none */
 	void *extra;
 } ht_diagnostics_t;
 
@@ -120,7 +123,12 @@ void ht_boundary_free(ht_boundary_t *bc);
 ht_system_t *ht_system_alloc(size_t n_materials, size_t n_boundaries);
 void ht_system_free(ht_system_t *system);
 
-/* Diagnostics and I/O utilities, including Nusselt/Biot number and profile output. */
+/* Diagnostics and I/O utilities, including Nusselt/Biot number and profile output.
+   ht_diagnostics_stream() attaches stream (NULL detaches), and every
+   ht_diagnostics_update() then pushes total_heat, heat_flux and the
+   non-empty temperature and heat flux profiles as "ht.*" observables at
+   time state->t. */
+int ht_diagnostics_stream(ht_system_t *system, obs_stream *stream, size_t decimate, obs_reduce_t reduce);
 void ht_diagnostics_update(ht_system_t *system);
 void ht_system_print(const ht_system_t *system);
 void ht_state_print(const ht_state_t *state);
@@ -139,4 +147,68 @@ double ht_nusselt_number(double h, double L, double k);
 double ht_biot_number(double h, double L, double k);
 double ht_transient_temperature(double T0, double T_inf, double Bi, double Fo);
 
+/*
+   Transient conduction. An ht_mesh_t is a box of n[0] x n[1] x n[2]
+   finite-volume cells of size d[0] x d[1] x d[2] (m); a 1D or 2D problem
+   sets n = 1 on the other axes, with d the cross-section or depth it
+   stands for. Cell (i, j, k) is index i + n[0] * (j + n[1] * k).
+   region[cell] picks system->materials[region[cell]] (NULL: all cells
+   material 0), whose anisotropy[a], when given, replaces conductivity on
+   axis a; faces between cells conduct through the harmonic mean.
+
+   system->boundaries[2 a] and [2 a + 1] hold the low and high faces of
+   axis a; NULL, HT_BC_NONE or a missing entry is insulated. Dirichlet
+   holds value (K), Neumann feeds value (W/m^2, positive inward),
+   Robin/convective exchange with T_inf through h, radiative with T_inf
+   through emissivity (linearized about the current temperatures every
+   step), and periodic on either face of an axis wraps it. Moving
+   boundaries are not supported. heat_source (W/m^3 per cell, NULL for
+   system->state->heat_source or none) is constant.
+
+   ht_conduction_step() takes one Crank-Nicolson step. A straight 1D
+   problem is a tridiagonal (Thomas) solve; anything else goes to CG
+   preconditioned by one multigrid V-cycle: 2x aggregation per axis with
+   Galerkin coarse operators, damped Jacobi smoothing split over
+   n_threads threads, and a dense Cholesky solve on the coarsest level.
+   The hierarchy is rebuilt when dt changes and, with radiative faces,
+   every step.
+*/
+typedef struct {
+	size_t n[3];                   /* Cells per axis */
+	double d[3];                   /* Cell size per axis (m) */
+	const size_t *region;          /* Material per cell, NULL for all 0 */
+	const double *heat_source;     /* W/m^3 per cell, NULL for the system's */
+} ht_mesh_t;
+
+typedef struct {
+	double rtol;                   /* CG residual reduction (default 1e-8) */
+	size_t max_iter;               /* CG iterations per step, 0 for 200 */
+	int n_threads;                 /* 0 = serial, < 0 = all */
+} ht_conduction_params;
+
+typedef struct {
+	ht_mesh_t mesh;
+	size_t n_cells;
+	ht_conduction_params prm;
+	size_t n_steps;                /* Accepted steps */
+	size_t n_iterations;           /* CG iterations, all steps */
+	size_t n_setups;               /* Multigrid hierarchies built */
+	double residual;               /* Relative residual of the last solve */
+	double heat;                   /* Sum of rho c V T after the last step (J) */
+	double boundary_flux;          /* Heat into the domain through its faces after the last step (W) */
+	void *work;                    /* Conductances, hierarchy and vectors */
+} ht_conduction_t;
+
+/* The mesh is copied and the system read now (region and heat_source
+   included); rebuild after editing either. prm may be NULL for the
+   defaults. NULL on bad arguments, a moving boundary, a material index
+   out of range or allocation failure. */
+ht_conduction_t *ht_conduction_alloc(const ht_system_t *system, const ht_mesh_t *mesh, const ht_conduction_params *prm);
+void ht_conduction_free(ht_conduction_t *cond);
+
+/* Advance the cell temperatures T (K, in place) by dt > 0 seconds.
+   Returns 0, or -1 on bad arguments or when CG misses rtol within
+   max_iter iterations (T is then left unchanged). */
+int ht_conduction_step(ht_conduction_t *cond, double *T, double dt);
+
 #endif /* HOLOS_HEAT_TRANSFER_H */
\ No newline at end of file
@@ -27,6 +27,8 @@
 
 #include <stddef.h>
 
+#include "core/phys/obs_stream.h"
+
 /* Thermodynamic state structure, supporting fugacity, compressibility, transport, and field properties. */
 typedef struct {
 	double T;                          /* Temperature (K) */
@@ -79,6 +81,7 @@ typedef struct {
 	char *name;                    /* EOS name (ideal_gas, van_der_waals, etc.) */
 	double (*eos_fn)(const td_state_t *state, void *params);
 	void *params;
+	void *table;                   /* Interpolation table (td_eos_tabulate()), NULL for direct calls */
 	void *extra;
 } td_eos_t;
 
@@ -97,6 +100,7 @@ typedef struct {
 	double *electric_field_profile;    /* Array of electric field values */
 	double *magnetic_field_profile;    /* Array of magnetic field values */
 	size_t n_field_profile;
+	obs_binding *stream;               /* Sink of td_diagnostics_update() (td_diagnostics_stream()), NULL for none */
 	void *extra;
 } td_diagnostics_t;
 
@@ -124,7 +128,12 @@ void td_eos_free(td_eos_t *eos);
 td_system_t *td_system_alloc(size_t n_processes);
 void td_system_free(td_system_t *system);
 
-/* Diagnostics and I/O utilities, including response function and profile output. */
+/* Diagnostics and I/O utilities, including response function and profile output.
+   td_diagnostics_stream() attaches stream (NULL detaches), and every
+   td_diagnostics_update() then pushes the non-empty property, response
+   function and field profiles as "td.*" observables, at the update
+   count as time (records carry their time, in place of time_profile). */
+int td_diagnostics_stream(td_system_t *system, obs_stream *stream, size_t decimate, obs_reduce_t reduce);
 void td_diagnostics_update(td_system_t *system);
 void td_system_print(const td_system_t *system);
 void td_state_print(const td_state_t *state);
@@ -150,4 +159,104 @@ double td_heat_capacity(const td_state_t *state);
 double td_compressibility(const td_state_t *state);
 double td_thermal_expansion(const td_state_t *state);
 
+/*
+   Closed forms behind the scalar functions above (R = 8.314462618 J/mol/K):
+   ideal gas P = nRT/V, van der Waals P = nRT/(V - nb) - a n^2/V^2,
+   monatomic ideal-gas entropy S = n (3/2 R ln T + R ln(V/n)) up to the
+   constant n s0, G = H - TS, F = U - TS and H = U + PV.
+*/
+double td_enthalpy(double U, double P, double V);
+
+/*
+   Columnar state blocks. A td_state_block holds n states as one
+   contiguous column per property, so the *_n() kernels below stream them
+   with unit stride; the kernels take any arrays though, and write out[i]
+   from element i of the inputs only (out may alias an input). Their
+   iterations are split across n_threads threads (0 = serial, < 0 = all)
+   and evaluate the same expressions as the scalar functions, whose
+   logarithms share the td_log_n() core. Kernels return 0, or -1 on a
+   NULL array with count > 0.
+*/
+typedef struct {
+	size_t n;                          /* States */
+	double *T, *P, *V, *U, *S;         /* Temperature (K), pressure (Pa), volume (m^3), energy (J), entropy (J/K) */
+	double *H, *G, *F;                 /* Enthalpy, Gibbs and Helmholtz free energies (J) */
+	double *n_moles;                   /* Number of moles */
+	void *extra;
+} td_state_block;
+
+/* Zeroed block of n states; columns share one allocation. */
+td_state_block *td_state_block_alloc(size_t n);
+void td_state_block_free(td_state_block *block);
+
+/* Copy T, P, V, U, S, H, G, F and n between states[0..n-1] and the first
+   n rows (n <= block->n; NULL states are skipped). */
+int td_state_block_load(td_state_block *block, td_state_t *const *states, size_t n);
+int td_state_block_store(const td_state_block *block, td_state_t **states, size_t n);
+
+/* y[i] = ln x[i], within 1 ulp; libm for x <= 0, subnormal or not finite. */
+int td_log_n(const double *x, double *y, size_t count, int n_threads);
+
+int td_ideal_gas_pressure_n(const double *n, const double *T, const double *V, double *P, size_t count, int n_threads);
+int td_van_der_waals_pressure_n(const double *n, const double *T, const double *V, double a, double b, double *P,
+                                size_t count, int n_threads);
+int td_ideal_gas_entropy_n(const double *n, const double *V, const double *T, double *S, size_t count, int n_threads);
+int td_gibbs_free_energy_n(const double *H, const double *T, const double *S, double *G, size_t count, int n_threads);
+int td_helmholtz_free_energy_n(const double *U, const double *T, const double *S, double *F, size_t count,
+                               int n_threads);
+int td_enthalpy_n(const double *U, const double *P, const double *V, double *H, size_t count, int n_threads);
+
+/*
+   Tabulated EOS. td_eos_tabulate() samples eos_fn over x in [x_min, x_max]
+   and T in [T_min, T_max], with x the molar density n/V (mol/m^3; eos_fn
+   sees n = 1, V = 1/x) or the pressure P (Pa; n = 1), on a rectilinear
+   grid (x optionally log-spaced). Starting from nx by nT intervals, every
+   interval whose midpoint row or column, or a cell center on it, misses
+   the interpolant by more than rtol * |f| + atol is split, until all pass
+   or an axis holds max_nodes nodes; the graded grid then resolves phase
+   boundaries and other sharp features without refining elsewhere.
+
+   Interpolation is bicubic Hermite on f, f_x, f_T, f_xT, with monotone
+   (PCHIP) node derivatives, so it does not overshoot across a boundary
+   and the derivatives returned are those of the interpolant itself:
+   partials such as dP/drho stay consistent with f and continuous.
+
+   With cache_dir set, the table is stored in
+   cache_dir/td_eos_<key>.bin, keyed by a hash of the EOS name, the first
+   params_size bytes of eos->params and these settings, and later calls
+   with the same key load it instead of calling eos_fn. Returns 0, or -1
+   on bad settings, a non-finite eos_fn value or allocation failure.
+*/
+typedef enum {
+	TD_EOS_RHO_T,                  /* x = molar density */
+	TD_EOS_P_T                     /* x = pressure */
+} td_eos_axes_t;
+
+typedef struct {
+	td_eos_axes_t axes;
+	double x_min, x_max;
+	double T_min, T_max;           /* K */
+	size_t nx, nT;                 /* Initial intervals, 0 for 32 */
+	int log_x;                     /* Space and interpolate x logarithmically (x_min > 0) */
+	double rtol, atol;             /* Refinement tolerance on f */
+	size_t max_nodes;              /* Nodes per axis at most, 0 for 1025 */
+	size_t params_size;            /* Bytes of eos->params in the cache key, 0 for none */
+	const char *cache_dir;         /* NULL for no on-disk cache */
+	int n_threads;                 /* Threads calling eos_fn while sampling (then thread-safe), 0 = serial */
+} td_eos_table_params;
+
+int td_eos_tabulate(td_eos_t *eos, const td_eos_table_params *prm);
+void td_eos_untabulate(td_eos_t *eos);
+
+/* f at (x, T) from the table, or from eos_fn outside it (derivatives by
+   central differences there); dfdx and dfdT may be NULL. */
+double td_eos_eval_xt(const td_eos_t *eos, double x, double T, double *dfdx, double *dfdT);
+
+/* f at a state: x is n/V (n <= 0 read as 1) or P, per the table axes. */
+double td_eos_eval(const td_eos_t *eos, const td_state_t *state);
+
+/* f[i] = td_eos_eval_xt(eos, x[i], T[i], NULL, NULL), across n_threads
+   threads (0 = serial, < 0 = all). */
+int td_eos_eval_n(const td_eos_t *eos, const double *x, const double *T, double *f, size_t count, int n_threads);
+
 #endif /* HOLOS_THERMODYNAMICS_H */
\ No newline at end of file
@@ -25,6 +25,7 @@ extern "C" {
 #endif
 
 #include <stdint.h>
+#include <stddef.h>
 
 /* Technology metadata structure, supporting cybersecurity, ethics, circularity, localization, and accessibility. */
 struct holos_technology {
@@ -134,6 +135,153 @@ void holos_tech_batch_free(struct holos_technology **techs, int n);
 struct holos_technology *holos_tech_find_by_tag(struct holos_technology **techs, int n, const char *tag);
 struct holos_technology *holos_tech_find_by_category(struct holos_technology **techs, int n, const char *category);
 
+/* Catalogs: technologies kept in one arena, freed all at once. The
+   strings that repeat from technology to technology (category,
+   physics_model, creator, lifecycle_stage, version, localization, tags,
+   certifications and supply chain sources) are interned: kept once per
+   catalog, so that equal strings are one pointer, and numbered from 1.
+   A technology of a catalog belongs to it: never free it or assign its
+   fields. holos_tech_batch_create() makes a catalog of its own, freed by
+   holos_tech_batch_free(). */
+struct holos_tech_catalog;
+
+struct holos_tech_catalog *holos_tech_catalog_new(void);
+void holos_tech_catalog_free(struct holos_tech_catalog *catalog);
+
+/* A copy of tech, or a new technology, in the catalog (NULL if out of
+   memory); an ID is made for it if it has none */
+struct holos_technology *holos_tech_catalog_add(struct holos_tech_catalog *catalog, const struct holos_technology *tech);
+struct holos_technology *holos_tech_catalog_create(struct holos_tech_catalog *catalog, const char *name, const char *description, const char *category, const char *physics_model, const char *creator, const char *lifecycle_stage);
+/* Technology i replaced by a copy of tech (NULL if none or out of
+   memory); the technology it was stays readable until the catalog is
+   freed */
+struct holos_technology *holos_tech_catalog_set(struct holos_tech_catalog *catalog, size_t i, const struct holos_technology *tech);
+
+size_t holos_tech_catalog_count(const struct holos_tech_catalog *catalog);
+struct holos_technology *holos_tech_catalog_get(const struct holos_tech_catalog *catalog, size_t i);
+size_t holos_tech_catalog_memory(const struct holos_tech_catalog *catalog);	/* Bytes held */
+
+/* Interned strings: the number of s (interned if new; 0 for NULL or out
+   of memory), the number of s if interned (else 0), the string of a
+   number (NULL if none), and how many there are */
+uint32_t holos_tech_intern(struct holos_tech_catalog *catalog, const char *s);
+uint32_t holos_tech_string_id(const struct holos_tech_catalog *catalog, const char *s);
+const char *holos_tech_string(const struct holos_tech_catalog *catalog, uint32_t id);
+uint32_t holos_tech_string_count(const struct holos_tech_catalog *catalog);
+
+/* Indexes over a catalog, from tag, category, lifecycle stage or
+   certification to the technologies that have it, kept up to date as
+   technologies are added or set. A find gives every match, in catalog
+   order: up to max into out (which may be NULL), returning how many
+   there are in all, or -1 on bad arguments. A query of terms matches
+   those with all of them, or with any if any is nonzero; at most
+   HOLOS_TECH_QUERY_MAX terms. An index outliving its catalog is empty. */
+enum holos_tech_key {
+	HOLOS_TECH_TAG,
+	HOLOS_TECH_CATEGORY,
+	HOLOS_TECH_LIFECYCLE,
+	HOLOS_TECH_CERTIFICATION
+};
+
+#define HOLOS_TECH_QUERY_MAX 16
+
+struct holos_tech_term {
+	enum holos_tech_key key;
+	const char *value;
+};
+
+struct holos_tech_index;
+
+struct holos_tech_index *holos_tech_index_new(struct holos_tech_catalog *catalog);
+void holos_tech_index_free(struct holos_tech_index *index);
+long holos_tech_index_find(const struct holos_tech_index *index, enum holos_tech_key key, const char *value, struct holos_technology **out, size_t max);
+long holos_tech_index_query(const struct holos_tech_index *index, const struct holos_tech_term *terms, size_t n, int any, struct holos_technology **out, size_t max);
+
+/* Columnar snapshots of a catalog, in the layout of Arrow: columns id,
+   name, category, creator, lifecycle_stage (strings, NULL kept), trl
+   (int32) and the measures below (float64). A snapshot is its own,
+   unchanged by its catalog after. Rows are catalog positions; a set of
+   them (rows, n) is every row when rows is NULL.
+   holos_tech_columns_measure() gives a column in place.
+   holos_tech_columns_filter() writes into out (room for n rows, or for
+   all; may be rows) those with the measure within [lo, hi], returning
+   how many. holos_tech_columns_group() adds up a measure by category or
+   lifecycle stage, one aggregate per value in the order first met (a
+   NULL value last), up to max into out, returning how many groups there
+   are or -1. */
+enum holos_tech_measure {
+	HOLOS_TECH_EFFICIENCY,
+	HOLOS_TECH_COST,
+	HOLOS_TECH_IMPACT,
+	HOLOS_TECH_SUSTAINABILITY,
+	HOLOS_TECH_RISK,
+	HOLOS_TECH_AI_BIAS,
+	HOLOS_TECH_CARBON,
+	HOLOS_TECH_WATER,
+	HOLOS_TECH_CYBER_RISK,
+	HOLOS_TECH_ETHICS,
+	HOLOS_TECH_CIRCULARITY,
+	HOLOS_TECH_ACCESSIBILITY,
+	HOLOS_TECH_MEASURES
+};
+
+struct holos_tech_aggregate {
+	const char *value;                       /* Of the group, NULL for none; the snapshot's */
+	size_t count;
+	double sum, min, max, mean;              /* NaN with no rows */
+};
+
+struct holos_tech_columns;
+
+struct holos_tech_columns *holos_tech_columns_new(const struct holos_tech_catalog *catalog);
+void holos_tech_columns_free(struct holos_tech_columns *columns);
+size_t holos_tech_columns_rows(const struct holos_tech_columns *columns);
+const double *holos_tech_columns_measure(const struct holos_tech_columns *columns, enum holos_tech_measure m);
+size_t holos_tech_columns_filter(const struct holos_tech_columns *columns, enum holos_tech_measure m, double lo, double hi, const uint32_t *rows, size_t n, uint32_t *out);
+int holos_tech_columns_aggregate(const struct holos_tech_columns *columns, enum holos_tech_measure m, const uint32_t *rows, size_t n, struct holos_tech_aggregate *out);
+long holos_tech_columns_group(const struct holos_tech_columns *columns, enum holos_tech_key by, enum holos_tech_measure m, const uint32_t *rows, size_t n, struct holos_tech_aggregate *out, size_t max);
+
+/* Export without copying. An Arrow IPC file (one record batch, read by
+   Arrow and the tools built on it; Parquet is a conversion away), or a
+   struct array through the C data interface of Arrow, which keeps the
+   snapshot until released: 0, or -1 on error. */
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+struct ArrowSchema {
+	const char *format;
+	const char *name;
+	const char *metadata;
+	int64_t flags;
+	int64_t n_children;
+	struct ArrowSchema **children;
+	struct ArrowSchema *dictionary;
+	void (*release)(struct ArrowSchema *);
+	void *private_data;
+};
+
+struct ArrowArray {
+	int64_t length;
+	int64_t null_count;
+	int64_t offset;
+	int64_t n_buffers;
+	int64_t n_children;
+	const void **buffers;
+	struct ArrowArray **children;
+	struct ArrowArray *dictionary;
+	void (*release)(struct ArrowArray *);
+	void *private_data;
+};
+
+#endif /* ARROW_C_DATA_INTERFACE */
+
+int holos_tech_columns_write_arrow(const struct holos_tech_columns *columns, const char *path);
+int holos_tech_columns_export(struct holos_tech_columns *columns, struct ArrowSchema *schema, struct ArrowArray *array);
+
 /* Diagnostics and output utilities */
 void holos_tech_print(const struct holos_technology *tech);
 void holos_tech_print_brief(const struct holos_technology *tech);
@@ -0,0 +1,116 @@
+/* trace.h - Zones of the hot paths of HOLOS, timed while profiling
+	 Copyright (C) 2025 4137314
+
+	 This file is part of HOLOS.
+
+	 HOLOS is free software: you can redistribute it and/or modify
+	 it under the terms of the GNU General Public License as published by
+	 the Free Software Foundation, either version 3 of the License, or
+	 (at your option) any later version.
+
+	 HOLOS is distributed in the hope that it will be useful,
+	 but WITHOUT ANY WARRANTY; without even the implied warranty of
+	 MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	 GNU General Public License for more details.
+
+	 You should have received a copy of the GNU General Public License
+	 along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+	 HOLOS_TRACE_ZONE("name") at the top of a block times the block, to
+	 its end by any path, while tracing is on; off, a zone costs a relaxed load
+	 and a branch, and without HOLOS_TRACE (configure --disable-trace)
+	 nothing at all. The name must be a literal or live as long as the
+	 trace.
+
+	 Each thread records its zones into a ring of its own, no lock
+	 taken: when a ring is full the oldest zones go, and reports cover
+	 the ones left. With HOLOS_TRACE_COUNTERS, each zone also counts the
+	 instructions and cycles of its thread (Linux perf events, read in
+	 user space where the kernel allows), if the system has them.
+
+	 holos_trace_print() sums the zones by call path, a flame graph as a
+	 tree: calls, total and self time of each path. holos_trace_dump()
+	 writes them as a Chrome trace (the JSON of chrome://tracing and
+	 Perfetto), one complete event per zone. Both, and reset, are for
+	 when tracing is stopped and no zone is open.
+*/
+
+#ifndef HOLOS_TRACE_H
+#define HOLOS_TRACE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#define HOLOS_TRACE_COUNTERS 1u           /* Flag: hardware counters per zone */
+#define HOLOS_TRACE_RING 65536            /* Zones kept per thread, by default */
+
+struct holos_trace_site {
+	const char *name;
+	const char *file;
+	int line;
+};
+
+struct holos_trace_scope {
+	const struct holos_trace_site *site;   /* NULL: not traced */
+	uint64_t start_ns;
+	uint64_t counters[2];                  /* Instructions, cycles at the start */
+};
+
+/* Start recording, with ring_zones per thread (0: HOLOS_TRACE_RING);
+   0, or -1 if out of memory. Stop leaves what was recorded. */
+int holos_trace_start(unsigned flags, size_t ring_zones);
+void holos_trace_stop(void);
+void holos_trace_reset(void);
+
+/* Whether hardware counters are being read (after a start with
+   HOLOS_TRACE_COUNTERS, 0 if the system has none) */
+int holos_trace_counters(void);
+
+void holos_trace_print(FILE *out);
+int holos_trace_dump(FILE *out);
+
+/* Whether tracing is on; read relaxed, written by start and stop */
+extern int holos_trace_on;
+
+/* The slow halves of a zone, for when tracing is on */
+struct holos_trace_scope holos_trace_open(const struct holos_trace_site *site);
+void holos_trace_close(struct holos_trace_scope *scope);
+
+/* What HOLOS_TRACE_ZONE expands to: inline, so that a zone costs a
+   relaxed load and a branch while tracing is off, no call */
+static inline struct holos_trace_scope holos_trace_begin(const struct holos_trace_site *site) {
+	struct holos_trace_scope scope = {NULL, 0, {0, 0}};
+	if (__builtin_expect(!__atomic_load_n(&holos_trace_on, __ATOMIC_RELAXED), 1)) return scope;
+	return holos_trace_open(site);
+}
+
+static inline void holos_trace_end(struct holos_trace_scope *scope) {
+	if (__builtin_expect(scope->site != NULL, 0)) holos_trace_close(scope);
+}
+
+#define HOLOS_TRACE_CAT_(a, b) a##b
+#define HOLOS_TRACE_CAT(a, b) HOLOS_TRACE_CAT_(a, b)
+
+#if defined(HOLOS_TRACE) && (defined(__GNUC__) || defined(__clang__))
+#define HOLOS_TRACE_ZONE(zone_name)                                                                         \
+	static const struct holos_trace_site HOLOS_TRACE_CAT(holos_trace_site_, __LINE__) = {zone_name, __FILE__, \
+	                                                                                     __LINE__};          \
+	struct holos_trace_scope HOLOS_TRACE_CAT(holos_trace_scope_, __LINE__)                                 \
+		__attribute__((cleanup(holos_trace_end), unused)) =                                               \
+			holos_trace_begin(&HOLOS_TRACE_CAT(holos_trace_site_, __LINE__))
+#else
+#define HOLOS_TRACE_ZONE(zone_name) do { } while (0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HOLOS_TRACE_H */
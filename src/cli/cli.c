@@ -1,96 +1,490 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
 #include <readline/readline.h>
 #include <readline/history.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
-/* moduli fisici */
-#include "core/phys/nuclear/nuclear_decay.h"
-#include "core/phys/nuclear/fission_fusion.h"
-#include "core/phys/nuclear/nuclear_forces.h"
-#include "core/phys/thermo/entropy.h"
-#include "core/phys/thermo/heat_transfer.h"
-#include "core/phys/thermo/thermodynamics.h"
-#include "core/phys/ss/band_structure.h"
-#include "core/phys/ss/crystal_lattice.h"
-#include "core/phys/ss/phonons.h"
-
-/* Definizione generica di funzione */
-typedef void (*phys_func_t)(void);
-
-/* Struttura di registro */
-typedef struct {
-    const char *name;
-    const char *description;
-    phys_func_t func;
-} phys_entry_t;
-
-/* Stub di esempio: queste sono implementazioni banali per illustrare */
-void run_nuclear_decay(void) { printf("Running nuclear_decay...\n"); }
-void run_fission_fusion(void) { printf("Running fission_fusion...\n"); }
-void run_nuclear_forces(void) { printf("Running nuclear_forces...\n"); }
-void run_entropy(void) { printf("Running entropy...\n"); }
-void run_heat_transfer(void) { printf("Running heat_transfer...\n"); }
-void run_thermodynamics(void) { printf("Running thermodynamics...\n"); }
-void run_band_structure(void) { printf("Running band_structure...\n"); }
-void run_crystal_lattice(void) { printf("Running crystal_lattice...\n"); }
-void run_phonons(void) { printf("Running phonons...\n"); }
-
-/* Registro delle funzioni */
-phys_entry_t registry[] = {
-    {"nuclear_decay", "Nuclear decay processes", run_nuclear_decay},
-    {"fission_fusion", "Nuclear fission and fusion", run_fission_fusion},
-    {"nuclear_forces", "Nuclear forces simulation", run_nuclear_forces},
-    {"entropy", "Entropy calculations", run_entropy},
-    {"heat_transfer", "Heat transfer simulations", run_heat_transfer},
-    {"thermodynamics", "General thermodynamics", run_thermodynamics},
-    {"band_structure", "Solid-state band structure", run_band_structure},
-    {"crystal_lattice", "Crystal lattice modeling", run_crystal_lattice},
-    {"phonons", "Phonon dynamics", run_phonons},
-    {NULL, NULL, NULL}
-};
+#include "config.h"
+#include "cli/cli.h"
 
-/* Trova una funzione nel registro */
-phys_func_t find_function(const char *name) {
-    for (int i = 0; registry[i].name != NULL; i++) {
-        if (strcmp(name, registry[i].name) == 0)
-            return registry[i].func;
-    }
-    return NULL;
-}
+/* rete P2P */
+#include "core/p2p/p2p.h"
+#include "core/p2p/p2p_stats.h"
+
+/* moduli, caricati al primo uso */
+#include "cli_plugin.h"
+
+/* zone per il comando profile */
+#include "core/trace/trace.h"
+#include "core/exec/exec.h"
 
 /* Stampa la lista dei comandi */
 void print_help(void) {
     printf("Available commands:\n");
-    for (int i = 0; registry[i].name != NULL; i++) {
-        printf("  %-15s - %s\n", registry[i].name, registry[i].description);
-    }
+    for (size_t i = 0; i < cli_plugin_count(); i++)
+        printf("  %-15s - %s\n", cli_plugin_name(i), cli_plugin_description(i));
+    if (!cli_plugin_count()) printf("  (no modules found: see HOLOS_PLUGIN_PATH)\n");
+    printf("  p2p ...         - P2P network (p2p alone for usage)\n");
+    printf("  profile ...     - Run a command, timing its zones (profile alone for usage)\n");
     printf("  help            - Show this help message\n");
     printf("  quit            - Exit the CLI\n");
 }
 
-int main(void) {
+/* Stampa i messaggi degli argomenti sottoscritti */
+static void p2p_print_topic(const char *topic, const char *sender_id, const void *data, size_t size, void *cls) {
+    (void)cls;
+    printf("[%s] %s: %.*s\n", topic, sender_id ? sender_id : "local", (int)size, (const char *)data);
+}
+
+/* Comandi "p2p ..." */
+static void p2p_command(char *args) {
+    char *cmd = strtok(args, " ");
+    int rc = HOLOS_P2P_OK;
+    if (!cmd) {
+        printf("Usage: p2p init | peers | connect PEER | disconnect PEER | publish TOPIC MSG | subscribe TOPIC\n"
+               "       | stats [json | reset]\n");
+        return;
+    }
+    if (strcmp(cmd, "init") == 0) {
+        rc = holos_p2p_init();
+    } else if (strcmp(cmd, "peers") == 0) {
+        rc = holos_p2p_list_peers();
+    } else if (strcmp(cmd, "connect") == 0 || strcmp(cmd, "disconnect") == 0) {
+        char *peer = strtok(NULL, " ");
+        if (!peer) {
+            printf("Usage: p2p %s PEER\n", cmd);
+            return;
+        }
+        rc = cmd[0] == 'c' ? holos_p2p_connect(peer) : holos_p2p_disconnect(peer);
+    } else if (strcmp(cmd, "publish") == 0) {
+        char *topic = strtok(NULL, " ");
+        char *msg = strtok(NULL, "");
+        if (!topic || !msg) {
+            printf("Usage: p2p publish TOPIC MSG\n");
+            return;
+        }
+        rc = holos_p2p_publish(topic, msg, strlen(msg));
+    } else if (strcmp(cmd, "subscribe") == 0) {
+        char *topic = strtok(NULL, " ");
+        if (!topic) {
+            printf("Usage: p2p subscribe TOPIC\n");
+            return;
+        }
+        rc = holos_p2p_subscribe(topic, p2p_print_topic, NULL);
+    } else if (strcmp(cmd, "stats") == 0) {
+        char *how = strtok(NULL, " ");
+        holos_p2p_poll();               /* Counts what is due first */
+        if (!how) holos_p2p_stats_print(stdout);
+        else if (strcmp(how, "json") == 0) rc = holos_p2p_stats_dump(stdout);
+        else if (strcmp(how, "reset") == 0) holos_p2p_stats_reset();
+        else printf("Usage: p2p stats [json | reset]\n");
+    } else {
+        printf("Unknown p2p command: %s\n", cmd);
+        return;
+    }
+    if (rc != HOLOS_P2P_OK) holos_p2p_error(cmd, (enum holos_p2p_error)rc);
+    holos_p2p_poll();
+}
+
+/* Codici di uscita, per l'automazione */
+enum {
+    CLI_OK = 0,                         /* Tutto riuscito */
+    CLI_FAILED = 1,                     /* Almeno un job fallito */
+    CLI_USAGE = 2,                      /* Opzioni o script non validi */
+    CLI_UNKNOWN = 127                   /* Comando sconosciuto (di un job) */
+};
+
+static int run_command(char *input);
+
+/* "profile [-c] [-o FILE] COMMAND": esegue COMMAND con il tracing
+   acceso, in una zona col suo nome, e stampa il riepilogo per zona;
+   -c conta anche istruzioni e cicli, -o scrive il trace Chrome in FILE */
+static int profile_command(char *args) {
+    unsigned flags = 0;
+    const char *json = NULL;
+    struct holos_trace_site site = {NULL, "cli", 0};
+    struct holos_trace_scope scope;
+    int rc;
+    for (;;) {
+        args += strspn(args, " ");
+        if (strncmp(args, "-c", 2) == 0 && (args[2] == ' ' || args[2] == '\0')) {
+            flags |= HOLOS_TRACE_COUNTERS;
+            args += 2;
+        } else if (strncmp(args, "-o", 2) == 0 && (args[2] == ' ' || args[2] == '\0')) {
+            args += 2 + strspn(args + 2, " ");
+            json = args;
+            args += strcspn(args, " ");
+            if (*args) *args++ = '\0';
+        } else {
+            break;
+        }
+    }
+    if (!*args || (json && !*json)) {
+        printf("Usage: profile [-c] [-o FILE] COMMAND\n");
+        return CLI_FAILED;
+    }
+    site.name = args;
+    holos_trace_reset();
+    if (holos_trace_start(flags, 0) != 0) {
+        fprintf(stderr, "[trace] out of memory\n");
+        return CLI_FAILED;
+    }
+    scope = holos_trace_begin(&site);
+    rc = run_command(args);
+    holos_trace_end(&scope);
+    holos_trace_stop();
+    holos_trace_print(stdout);
+    if (json) {
+        FILE *out = fopen(json, "w");
+        if (!out || holos_trace_dump(out) != 0) {
+            fprintf(stderr, "[trace] %s: %s\n", json, strerror(errno));
+            rc = CLI_FAILED;
+        }
+        if (out) fclose(out);
+    }
+    holos_trace_reset();                /* Il nome della zona era args */
+    return rc;
+}
+
+/* Esegue una riga di comando: 0, CLI_FAILED o CLI_UNKNOWN */
+static int run_command(char *input) {
+    phys_func_t func;
+    if (strcmp(input, "help") == 0) {
+        print_help();
+        return CLI_OK;
+    }
+    if (strncmp(input, "p2p", 3) == 0 && (input[3] == ' ' || input[3] == '\0')) {
+        p2p_command(input + 3);
+        return CLI_OK;
+    }
+    if (strncmp(input, "profile", 7) == 0 && (input[7] == ' ' || input[7] == '\0')) return profile_command(input + 7);
+    if ((func = cli_plugin_find(input))) {
+        func();
+        return CLI_OK;
+    }
+    printf("Unknown command: %s\n", input);
+    return CLI_UNKNOWN;
+}
+
+/* I comandi che toccano lo stato del processo (la rete P2P) vanno nel
+   processo batch stesso, non in un job */
+static int runs_in_place(const char *input) {
+    return strcmp(input, "help") == 0 || (strncmp(input, "p2p", 3) == 0 && (input[3] == ' ' || input[3] == '\0'));
+}
+
+/* ---------------- Batch ---------------- */
+
+/* Un job: un comando dello script, eseguito in un processo figlio con
+   l'output raccolto in un file temporaneo, stampato tutto insieme alla
+   fine, cosi' che job paralleli non mescolino le righe */
+struct cli_job {
+    pid_t pid;
+    int line;
+    char *command;
+    FILE *out;
+    struct timespec start;
+};
+
+struct cli_batch {
+    const char *name;                   /* Dello script */
+    struct cli_job *jobs;
+    int max, running;
+    int total, failed;
+    int verbose;
+};
+
+static double elapsed(const struct timespec *since) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - since->tv_sec) + (double)(now.tv_nsec - since->tv_nsec) * 1e-9;
+}
+
+static void job_report(struct cli_batch *b, const struct cli_job *job, int status, double wall, long rss_kb) {
+    char buf[4096];
+    size_t n;
+    if (job->out) {
+        rewind(job->out);
+        while ((n = fread(buf, 1, sizeof(buf), job->out)) > 0) fwrite(buf, 1, n, stdout);
+        fclose(job->out);
+    }
+    fflush(stdout);
+    b->total++;
+    if (status != CLI_OK) b->failed++;
+    if (status != CLI_OK || b->verbose || b->max > 1)
+        fprintf(stderr, "[cli] %s:%d: %s: exit %d, %.3f s, %.1f MiB\n", b->name, job->line, job->command, status,
+                wall, (double)rss_kb / 1024.0);
+}
+
+/* Attende un job in corso e ne riporta l'esito */
+static void batch_reap(struct cli_batch *b) {
+    struct rusage ru;
+    int status, code, i;
+    pid_t pid;
+    while ((pid = wait4(-1, &status, 0, &ru)) < 0 && errno == EINTR)
+        ;
+    if (pid < 0) {
+        b->running = 0;
+        return;
+    }
+    for (i = 0; i < b->running && b->jobs[i].pid != pid; i++)
+        ;
+    if (i == b->running) return;        /* Non nostro */
+    code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    job_report(b, &b->jobs[i], code, elapsed(&b->jobs[i].start), ru.ru_maxrss);
+    free(b->jobs[i].command);
+    b->jobs[i] = b->jobs[--b->running];
+}
+
+static void batch_drain(struct cli_batch *b) {
+    while (b->running > 0) batch_reap(b);
+}
+
+static void batch_start(struct cli_batch *b, int line, const char *command) {
+    struct cli_job *job;
+    while (b->running >= b->max) batch_reap(b);
+    job = &b->jobs[b->running];
+    job->line = line;
+    job->command = strdup(command);
+    job->out = tmpfile();
+    clock_gettime(CLOCK_MONOTONIC, &job->start);
+    fflush(stdout);
+    fflush(stderr);
+    flockfile(stdout);                  /* Non preso da un thread P2P nel figlio */
+    flockfile(stderr);
+    job->pid = job->command ? fork() : -1;
+    funlockfile(stderr);
+    funlockfile(stdout);
+    if (job->pid < 0) {
+        fprintf(stderr, "[cli] %s:%d: %s\n", b->name, line, strerror(errno ? errno : ENOMEM));
+        if (job->out) fclose(job->out);
+        job->out = NULL;
+        job_report(b, job, CLI_FAILED, 0, 0);
+        free(job->command);
+        return;
+    }
+    if (job->pid == 0) {
+        int rc;
+        if (job->out) {
+            dup2(fileno(job->out), STDOUT_FILENO);
+            dup2(fileno(job->out), STDERR_FILENO);
+        }
+        rc = run_command(job->command);
+        fflush(stdout);
+        fflush(stderr);
+        _exit(rc);
+    }
+    b->running++;
+}
+
+/* Esegue uno script: un comando per riga, righe vuote e commenti (#)
+   saltati. I comandi sono indipendenti e vanno fino a jobs alla volta;
+   "wait" attende quelli in corso, come i comandi p2p e help, che vanno
+   nel processo stesso. */
+static int run_batch(const char *path, int jobs, int verbose) {
+    struct cli_batch b;
+    struct timespec start;
+    FILE *in = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    char *line = NULL;
+    size_t cap = 0;
+    ssize_t len;
+    int n = 0;
+    if (!in) {
+        fprintf(stderr, "[cli] %s: %s\n", path, strerror(errno));
+        return CLI_USAGE;
+    }
+    memset(&b, 0, sizeof(b));
+    b.name = in == stdin ? "stdin" : path;
+    b.max = jobs;
+    b.verbose = verbose;
+    if (!(b.jobs = calloc((size_t)jobs, sizeof(*b.jobs)))) {
+        if (in != stdin) fclose(in);
+        return CLI_FAILED;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while ((len = getline(&line, &cap, in)) >= 0) {
+        char *cmd = line, *end = line + len;
+        n++;
+        while (*cmd == ' ' || *cmd == '\t') cmd++;
+        while (end > cmd && (end[-1] == '\n' || end[-1] == '\r' || end[-1] == ' ' || end[-1] == '\t')) *--end = '\0';
+        if (!*cmd || *cmd == '#') continue;
+        if (strcmp(cmd, "quit") == 0) break;
+        if (strcmp(cmd, "wait") == 0) {
+            batch_drain(&b);
+        } else if (runs_in_place(cmd)) {
+            struct cli_job job = {0, n, cmd, NULL, start};
+            struct rusage ru;
+            int rc;
+            batch_drain(&b);
+            clock_gettime(CLOCK_MONOTONIC, &job.start);
+            rc = run_command(cmd);
+            getrusage(RUSAGE_SELF, &ru);
+            job_report(&b, &job, rc, elapsed(&job.start), ru.ru_maxrss);
+        } else {
+            batch_start(&b, n, cmd);
+        }
+    }
+    batch_drain(&b);
+    free(line);
+    free(b.jobs);
+    if (in != stdin) fclose(in);
+    fprintf(stderr, "[cli] %s: %d jobs, %d failed, %.3f s\n", b.name, b.total, b.failed, elapsed(&start));
+    return b.failed ? CLI_FAILED : CLI_OK;
+}
+
+/* ---------------- Opzioni ---------------- */
+
+void holos_cli_print_version(void) {
+    printf("%s %s\n", PACKAGE_NAME, PACKAGE_VERSION);
+}
+
+void holos_cli_print_help(const char *subcommand) {
+    if (subcommand) {
+        printf("Usage: holos %s\n", subcommand);
+        return;
+    }
+    printf("Usage: holos [OPTION]... [COMMAND [ARG]...]\n"
+           "Runs COMMAND, the commands of a batch script, or the interactive CLI.\n\n"
+           "  -b, --batch FILE  run the commands of FILE (- for stdin), one per line\n"
+           "  -j, --jobs N      run up to N batch commands at once (0: one per CPU)\n"
+           "  -t, --threads N   run the work of a command on N threads (0: one per CPU)\n"
+           "  -v, --verbose     report every job, also when serial\n"
+           "  -h, --help        show this help and exit\n"
+           "  -V, --version     show the version and exit\n\n"
+           "In a script, blank lines and lines starting with # are skipped, and\n"
+           "\"wait\" waits for the commands started before it; p2p and help run in\n"
+           "order, after them. Each job is reported on stderr with its exit code,\n"
+           "wall time and peak RSS.\n\n"
+           "Exit status: 0 if all succeeded, 1 if a command failed, 2 on bad\n"
+           "options or an unreadable script.\n\n");
+    print_help();
+}
+
+int holos_parse_options(int argc, char **argv, struct holos_cli_options *opts) {
+    static const struct option longopts[] = {
+        {"batch", required_argument, NULL, 'b'}, {"jobs", required_argument, NULL, 'j'},
+        {"threads", required_argument, NULL, 't'}, {"verbose", no_argument, NULL, 'v'},
+        {"help", no_argument, NULL, 'h'},        {"version", no_argument, NULL, 'V'},
+        {NULL, 0, NULL, 0}};
+    int c;
+    memset(opts, 0, sizeof(*opts));
+    opts->jobs = 1;
+    while ((c = getopt_long(argc, argv, "+b:j:t:vhV", longopts, NULL)) != -1) {
+        char *end;
+        long n;
+        switch (c) {
+        case 'b': opts->batch_file = optarg; break;
+        case 'j':
+            n = strtol(optarg, &end, 10);
+            if (*end || n < 0 || n > 1024) {
+                fprintf(stderr, "[cli] --jobs: not a number of jobs: %s\n", optarg);
+                return -1;
+            }
+            if (n == 0) n = sysconf(_SC_NPROCESSORS_ONLN);
+            opts->jobs = n > 0 ? (int)n : 1;
+            break;
+        case 't':
+            n = strtol(optarg, &end, 10);
+            if (*end || n < 0 || n > HOLOS_EXEC_THREADS_MAX) {
+                fprintf(stderr, "[cli] --threads: not a number of threads: %s\n", optarg);
+                return -1;
+            }
+            opts->threads = (int)n;
+            break;
+        case 'v': opts->verbose = 1; break;
+        case 'h': opts->help = 1; break;
+        case 'V': opts->version = 1; break;
+        default: return -1;
+        }
+    }
+    if (optind < argc) {
+        opts->subcommand = argv[optind];
+        opts->args = argv + optind + 1;
+        opts->arg_count = argc - optind - 1;
+    }
+    if (opts->subcommand && opts->batch_file) {
+        fprintf(stderr, "[cli] a command and --batch are exclusive\n");
+        return -1;
+    }
+    opts->interactive = !opts->subcommand && !opts->batch_file && isatty(STDIN_FILENO);
+    if (!opts->subcommand && !opts->batch_file && !opts->interactive) opts->batch_file = "-";
+    return 0;
+}
+
+/* Il comando e i suoi argomenti, come una riga della CLI */
+int holos_cli_dispatch(const char *subcommand, int argc, char **argv, struct holos_cli_options *opts) {
+    size_t n = strlen(subcommand) + 1;
+    char *line;
+    int rc;
+    (void)opts;
+    for (int i = 0; i < argc; i++) n += strlen(argv[i]) + 1;
+    if (!(line = malloc(n))) return CLI_FAILED;
+    strcpy(line, subcommand);
+    for (int i = 0; i < argc; i++) {
+        strcat(line, " ");
+        strcat(line, argv[i]);
+    }
+    rc = run_command(line);
+    free(line);
+    return rc;
+}
+
+int main(int argc, char **argv) {
+    struct holos_cli_options opts;
     char *input;
-    printf("Holos Physics CLI (type 'help' for commands)\n");
+    int rc = CLI_OK;
+    if (holos_parse_options(argc, argv, &opts) != 0) {
+        fprintf(stderr, "Try 'holos --help'.\n");
+        return CLI_USAGE;
+    }
+    /* Un solo limite per i thread: il pool di holos_exec e, per i cicli
+       OpenMP che ne usano "tutti", lo stesso numero */
+    holos_exec_setup((unsigned)opts.threads, -1);
+#ifdef _OPENMP
+    if (opts.threads > 0) omp_set_num_threads(opts.threads);
+#endif
+    cli_plugins_load(NULL);
+    if (opts.help || opts.version) {
+        if (opts.help) holos_cli_print_help(NULL);
+        else holos_cli_print_version();
+        cli_plugins_free();
+        return CLI_OK;
+    }
+    if (opts.subcommand) {
+        rc = holos_cli_dispatch(opts.subcommand, opts.arg_count, opts.args, &opts);
+        holos_p2p_finalize();
+        cli_plugins_free();
+        return rc;
+    }
+    if (opts.batch_file) {
+        rc = run_batch(opts.batch_file, opts.jobs, opts.verbose);
+        holos_p2p_finalize();
+        cli_plugins_free();
+        return rc;
+    }
 
+    printf("Holos Physics CLI (type 'help' for commands)\n");
     while ((input = readline("holos ~> ")) != NULL) {
         if (*input) add_history(input);
 
         if (strcmp(input, "quit") == 0) {
             free(input);
             break;
-        } else if (strcmp(input, "help") == 0) {
-            print_help();
-        } else {
-            phys_func_t func = find_function(input);
-            if (func) {
-                func();
-            } else {
-                printf("Unknown command: %s\n", input);
-            }
+        } else if (*input) {
+            run_command(input);
         }
 
         free(input);
     }
+    holos_p2p_finalize();
+    cli_plugins_free();
     return 0;
-}
\ No newline at end of file
+}
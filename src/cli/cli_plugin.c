@@ -0,0 +1,376 @@
+/* cli_plugin.c - Modules of the HOLOS CLI, loaded on first use
+    Copyright (C) 2025  4137314 <holos@mail.com>
+
+    This file is part of HOLOS.
+
+    HOLOS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    HOLOS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+    ----------------------------------------------------------------------
+    A module is a shared object and a manifest beside it, NAME.manifest,
+    of lines
+
+        # comment
+        library phys.so
+        command NAME SYMBOL DESCRIPTION...
+
+    a command being a void (void) function of the last library named,
+    found relative to the manifest. Startup reads the manifests only:
+    the library is opened (dlopen) when one of its commands is first
+    run, and a command named twice is the first one read, the
+    directories in the order of the path and their manifests in that of
+    their names.
+
+    Commands are found by a perfect hash, built once the manifests are
+    read (hash and displace): the names fall into buckets of about four,
+    and each bucket, the fullest first, gets the first seed that puts
+    its names into slots still free. A lookup is then one hash, one
+    slot and one compare.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <dirent.h>
+#include <dlfcn.h>
+
+#include "cli_plugin.h"
+
+#ifndef HOLOS_PLUGIN_DIR
+#define HOLOS_PLUGIN_DIR "/usr/local/lib/holos"
+#endif
+
+#define CLI_SEEDS_MAX (1u << 16)        /* Per bucket, before the table grows */
+
+struct cli_library {
+    char *path;
+    void *handle;                       /* NULL until first used */
+    int failed;
+};
+
+struct cli_command {
+    char *name, *symbol, *description;
+    size_t library;
+    uint64_t hash;
+    phys_func_t func;                   /* NULL until first used */
+};
+
+static struct cli_library *g_libs = NULL;
+static size_t g_n_libs = 0, g_cap_libs = 0;
+static struct cli_command *g_commands = NULL;
+static size_t g_n_commands = 0, g_cap_commands = 0;
+
+static uint32_t *g_seeds = NULL;        /* Per bucket */
+static size_t g_buckets = 0;
+static int32_t *g_slots = NULL;         /* Command of each slot, -1 for none */
+static size_t g_mask = 0;
+
+/* ---------------- Hashing ---------------- */
+
+static uint64_t cli_hash(const char *s) {
+    uint64_t h = 0xcbf29ce484222325u;
+    for (; *s; s++) h = (h ^ (unsigned char)*s) * 0x100000001b3u;
+    return h;
+}
+
+static size_t cli_slot(uint64_t hash, uint32_t seed, size_t mask) {
+    uint64_t x = hash ^ ((uint64_t)seed * 0x9e3779b97f4a7c15u);
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9u;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebu;
+    return (size_t)(x ^ (x >> 31)) & mask;
+}
+
+static int cli_by_bucket_size(const void *a, const void *b) {
+    const size_t *x = a, *y = b;        /* (size, bucket) pairs */
+    return x[0] < y[0] ? 1 : x[0] > y[0] ? -1 : (x[1] > y[1]) - (x[1] < y[1]);
+}
+
+/* Seeds for a table of mask + 1 slots; 0, or -1 if a bucket had none */
+static int cli_hash_try(size_t mask, const size_t *order, const size_t *first, const size_t *members) {
+    for (size_t slot = 0; slot <= mask; slot++) g_slots[slot] = -1;
+    for (size_t k = 0; k < g_buckets; k++) {
+        const size_t b = order[2 * k + 1], n = order[2 * k];
+        uint32_t seed;
+        if (!n) break;
+        for (seed = 0; seed < CLI_SEEDS_MAX; seed++) {
+            size_t i;
+            for (i = 0; i < n; i++) {
+                const size_t c = members[first[b] + i], slot = cli_slot(g_commands[c].hash, seed, mask);
+                if (g_slots[slot] >= 0) break;
+                g_slots[slot] = (int32_t)c;
+            }
+            if (i == n) break;
+            while (i-- > 0) g_slots[cli_slot(g_commands[members[first[b] + i]].hash, seed, mask)] = -1;
+        }
+        if (seed == CLI_SEEDS_MAX) return -1;
+        g_seeds[b] = seed;
+    }
+    return 0;
+}
+
+static int cli_hash_build(void) {
+    size_t mask = 0, *order, *first, *members;
+    int rc = -1;
+    while (mask + 1 < g_n_commands) mask = 2 * mask + 1;
+    g_buckets = g_n_commands / 4 + 1;
+    order = calloc(2 * g_buckets, sizeof(*order));
+    first = calloc(g_buckets + 1, sizeof(*first));
+    members = malloc((g_n_commands + 1) * sizeof(*members));
+    g_seeds = calloc(g_buckets, sizeof(*g_seeds));
+    if (!order || !first || !members || !g_seeds) goto out;
+    for (size_t c = 0; c < g_n_commands; c++) first[g_commands[c].hash % g_buckets + 1]++;
+    for (size_t b = 0; b < g_buckets; b++) {
+        order[2 * b + 1] = b;
+        first[b + 1] += first[b];
+    }
+    for (size_t c = 0; c < g_n_commands; c++) {         /* Bucket by bucket; order[] counts them */
+        const size_t b = g_commands[c].hash % g_buckets;
+        members[first[b] + order[2 * b]++] = c;
+    }
+    qsort(order, g_buckets, 2 * sizeof(*order), cli_by_bucket_size);
+    for (int tries = 0; tries < 8; tries++, mask = 2 * mask + 1) {
+        int32_t *slots = realloc(g_slots, (mask + 1) * sizeof(*slots));
+        if (!slots) break;
+        g_slots = slots;
+        if (cli_hash_try(mask, order, first, members) == 0) {
+            g_mask = mask;
+            rc = 0;
+            break;
+        }
+    }
+out:
+    if (rc != 0) fprintf(stderr, "[cli] commands: cannot hash %zu names\n", g_n_commands);
+    free(order);
+    free(first);
+    free(members);
+    return rc;
+}
+
+static int cli_by_name(const void *a, const void *b) {
+    const size_t x = *(const size_t *)a, y = *(const size_t *)b;
+    const int c = strcmp(g_commands[x].name, g_commands[y].name);
+    return c ? c : (x > y) - (x < y);
+}
+
+/* Drops the later of commands named alike */
+static void cli_dedup(void) {
+    size_t *by = malloc((g_n_commands + 1) * sizeof(*by)), kept = 0;
+    if (!by) return;
+    for (size_t c = 0; c < g_n_commands; c++) by[c] = c;
+    qsort(by, g_n_commands, sizeof(*by), cli_by_name);
+    for (size_t k = 1; k < g_n_commands; k++)
+        if (strcmp(g_commands[by[k]].name, g_commands[by[k - 1]].name) == 0) {
+            struct cli_command *dup = &g_commands[by[k]];
+            fprintf(stderr, "[cli] command %s of %s ignored: one is of %s\n", dup->name, g_libs[dup->library].path,
+                    g_libs[g_commands[by[k - 1]].library].path);
+            free(dup->name);
+            dup->name = NULL;
+            by[k] = by[k - 1];          /* The first, against the next */
+        }
+    for (size_t c = 0; c < g_n_commands; c++) {
+        if (!g_commands[c].name) {
+            free(g_commands[c].symbol);
+            free(g_commands[c].description);
+            continue;
+        }
+        g_commands[kept++] = g_commands[c];
+    }
+    g_n_commands = kept;
+    free(by);
+}
+
+/* ---------------- Manifests ---------------- */
+
+static int cli_add_library(const char *dir, const char *file) {
+    const size_t n = strlen(dir) + strlen(file) + 2;
+    char *path;
+    if (g_n_libs == g_cap_libs) {
+        const size_t cap = g_cap_libs ? 2 * g_cap_libs : 8;
+        struct cli_library *grown = realloc(g_libs, cap * sizeof(*grown));
+        if (!grown) return -1;
+        g_libs = grown;
+        g_cap_libs = cap;
+    }
+    if (!(path = malloc(n))) return -1;
+    if (file[0] == '/') snprintf(path, n, "%s", file);
+    else snprintf(path, n, "%s/%s", dir, file);
+    g_libs[g_n_libs].path = path;
+    g_libs[g_n_libs].handle = NULL;
+    g_libs[g_n_libs].failed = 0;
+    g_n_libs++;
+    return 0;
+}
+
+static int cli_add_command(const char *name, const char *symbol, const char *description) {
+    struct cli_command *cmd;
+    if (g_n_commands == g_cap_commands) {
+        const size_t cap = g_cap_commands ? 2 * g_cap_commands : 32;
+        struct cli_command *grown = realloc(g_commands, cap * sizeof(*grown));
+        if (!grown) return -1;
+        g_commands = grown;
+        g_cap_commands = cap;
+    }
+    cmd = &g_commands[g_n_commands];
+    cmd->name = strdup(name);
+    cmd->symbol = strdup(symbol);
+    cmd->description = strdup(description);
+    cmd->library = g_n_libs - 1;
+    cmd->hash = cli_hash(name);
+    cmd->func = NULL;
+    if (!cmd->name || !cmd->symbol || !cmd->description) {
+        free(cmd->name);
+        free(cmd->symbol);
+        free(cmd->description);
+        return -1;
+    }
+    g_n_commands++;
+    return 0;
+}
+
+static void cli_read_manifest(const char *dir, const char *path) {
+    FILE *f = fopen(path, "r");
+    char *line = NULL, *save;
+    size_t cap = 0, libs = g_n_libs;
+    int n = 0;
+    if (!f) {
+        perror(path);
+        return;
+    }
+    while (getline(&line, &cap, f) >= 0) {
+        char *word = strtok_r(line, " \t\r\n", &save);
+        n++;
+        if (!word || word[0] == '#') continue;
+        if (strcmp(word, "library") == 0 && (word = strtok_r(NULL, " \t\r\n", &save))) {
+            if (cli_add_library(dir, word) != 0) break;
+        } else if (strcmp(word, "command") == 0) {
+            char *name = strtok_r(NULL, " \t\r\n", &save), *symbol = strtok_r(NULL, " \t\r\n", &save);
+            char *description = strtok_r(NULL, "\r\n", &save);
+            if (!name || !symbol || g_n_libs == libs) {
+                fprintf(stderr, "[cli] %s:%d: command NAME SYMBOL, after a library\n", path, n);
+                continue;
+            }
+            while (description && (*description == ' ' || *description == '\t')) description++;
+            if (cli_add_command(name, symbol, description ? description : "") != 0) break;
+        } else {
+            fprintf(stderr, "[cli] %s:%d: not library or command\n", path, n);
+        }
+    }
+    free(line);
+    fclose(f);
+}
+
+static int cli_by_string(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static void cli_read_dir(const char *dir) {
+    DIR *d = opendir(dir);
+    struct dirent *e;
+    char **names = NULL;
+    size_t n = 0, cap = 0;
+    if (!d) return;                     /* A directory of the path may be missing */
+    while ((e = readdir(d))) {
+        const size_t len = strlen(e->d_name);
+        if (len <= 9 || strcmp(e->d_name + len - 9, ".manifest") != 0) continue;
+        if (n == cap) {
+            char **grown = realloc(names, (cap = cap ? 2 * cap : 16) * sizeof(*grown));
+            if (!grown) break;
+            names = grown;
+        }
+        if (!(names[n] = malloc(strlen(dir) + len + 2))) break;
+        sprintf(names[n++], "%s/%s", dir, e->d_name);
+    }
+    closedir(d);
+    qsort(names, n, sizeof(*names), cli_by_string);
+    for (size_t i = 0; i < n; i++) {
+        cli_read_manifest(dir, names[i]);
+        free(names[i]);
+    }
+    free(names);
+}
+
+size_t cli_plugins_load(const char *path) {
+    char *dirs, *dir, *save;
+    if (!path && !(path = getenv("HOLOS_PLUGIN_PATH"))) path = HOLOS_PLUGIN_DIR;
+    if (!(dirs = strdup(path))) return 0;
+    for (dir = strtok_r(dirs, ":", &save); dir; dir = strtok_r(NULL, ":", &save)) cli_read_dir(dir);
+    free(dirs);
+    cli_dedup();
+    if (g_n_commands && cli_hash_build() != 0) {
+        cli_plugins_free();
+        return 0;
+    }
+    return g_n_commands;
+}
+
+void cli_plugins_free(void) {
+    for (size_t i = 0; i < g_n_libs; i++) {
+        if (g_libs[i].handle) dlclose(g_libs[i].handle);
+        free(g_libs[i].path);
+    }
+    for (size_t c = 0; c < g_n_commands; c++) {
+        free(g_commands[c].name);
+        free(g_commands[c].symbol);
+        free(g_commands[c].description);
+    }
+    free(g_libs);
+    free(g_commands);
+    free(g_seeds);
+    free(g_slots);
+    g_libs = NULL;
+    g_commands = NULL;
+    g_seeds = NULL;
+    g_slots = NULL;
+    g_n_libs = g_cap_libs = g_n_commands = g_cap_commands = g_buckets = g_mask = 0;
+}
+
+/* ---------------- Lookup ---------------- */
+
+phys_func_t cli_plugin_find(const char *name) {
+    struct cli_command *cmd;
+    struct cli_library *lib;
+    uint64_t hash;
+    int32_t c;
+    void *sym;
+    if (!g_n_commands || !name) return NULL;
+    hash = cli_hash(name);
+    c = g_slots[cli_slot(hash, g_seeds[hash % g_buckets], g_mask)];
+    if (c < 0 || strcmp((cmd = &g_commands[c])->name, name) != 0) return NULL;
+    if (cmd->func) return cmd->func;
+    lib = &g_libs[cmd->library];
+    if (lib->failed) return NULL;
+    if (!lib->handle && !(lib->handle = dlopen(lib->path, RTLD_NOW | RTLD_LOCAL))) {
+        fprintf(stderr, "[cli] %s\n", dlerror());
+        lib->failed = 1;
+        return NULL;
+    }
+    if (!(sym = dlsym(lib->handle, cmd->symbol))) {
+        fprintf(stderr, "[cli] %s: no %s\n", lib->path, cmd->symbol);
+        return NULL;
+    }
+    memcpy(&cmd->func, &sym, sizeof(sym));      /* POSIX: a function's address */
+    return cmd->func;
+}
+
+size_t cli_plugin_count(void) {
+    return g_n_commands;
+}
+
+const char *cli_plugin_name(size_t i) {
+    return i < g_n_commands ? g_commands[i].name : NULL;
+}
+
+const char *cli_plugin_description(size_t i) {
+    return i < g_n_commands ? g_commands[i].description : NULL;
+}
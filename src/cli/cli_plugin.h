@@ -0,0 +1,46 @@
+/* cli_plugin.h - Modules of the HOLOS CLI, loaded on first use
+    Copyright (C) 2025  4137314 <holos@mail.com>
+
+    This file is part of HOLOS.
+
+    HOLOS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    HOLOS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+    ----------------------------------------------------------------------
+    Private to src/cli.
+*/
+
+#ifndef HOLOS_CLI_PLUGIN_H
+#define HOLOS_CLI_PLUGIN_H
+
+#include <stddef.h>
+
+/* Definizione generica di funzione */
+typedef void (*phys_func_t)(void);
+
+/* Reads the manifests of the directories of path (':' between them;
+   HOLOS_PLUGIN_PATH, else the installed directory, if NULL) and hashes
+   their commands; no module is opened. The number of commands. */
+size_t cli_plugins_load(const char *path);
+void cli_plugins_free(void);
+
+/* The function of a command, its module opened on first use; NULL if
+   no command is so named or its module fails to open (said on stderr) */
+phys_func_t cli_plugin_find(const char *name);
+
+/* The commands, in the order of the manifests */
+size_t cli_plugin_count(void);
+const char *cli_plugin_name(size_t i);
+const char *cli_plugin_description(size_t i);
+
+#endif /* HOLOS_CLI_PLUGIN_H */
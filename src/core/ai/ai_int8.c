@@ -0,0 +1,335 @@
+/* ai_int8.c - INT8 quantized layers of the AI models for HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+   ----------------------------------------------------------------------
+   Every ISA path is the same loop (rows, then outputs) around its own
+   dot product, with the store inlined into it. The x86 paths are
+   compiled with per-function target attributes and picked at runtime,
+   so no global -m flags are needed:
+   - AVX-512 VNNI: vpdpbusd multiplies 64 u8 x s8 pairs and adds each
+     group of 4 into an int32 lane, exactly
+   - AVX2: both operands widened to int16 and vpmaddwd, 16 pairs per
+     step (vpmaddubsw would saturate at 255 x 127 x 2)
+   The AArch64 sdot path is compiled in when the target has the
+   dot-product extension (-march=armv8.2-a+dotprod or later). sdot is
+   s8 x s8, so the activations go in as q - 128 and 128 times the row
+   sum of the weights is added back.
+
+   Sums are exact in int32 for rows up to 2^31 / (255 x 127) = 66000
+   inputs, far above any layer here.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "core/ai/ai_int8.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define AI_I8_HAVE_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_DOTPROD)
+#define AI_I8_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+static ai_i8_isa_t ai_i8_isa = AI_I8_ISA_AUTO;
+
+/* -------------------------------
+   Quantization
+   ------------------------------- */
+
+ai_u8_quant_t ai_u8_range(double lo, double hi) {
+    ai_u8_quant_t q;
+    if (!(lo < 0)) lo = 0;
+    if (!(hi > 0)) hi = 0;
+    if (hi - lo < 1e-30) {
+        q.scale = 1.0f;
+        q.zero = 0;
+        return q;
+    }
+    q.scale = (float)((hi - lo) / 255.0);
+    q.zero = (int32_t)lrint(-lo / q.scale);
+    if (q.zero < 0) q.zero = 0;
+    if (q.zero > 255) q.zero = 255;
+    return q;
+}
+
+void ai_u8_quantize(const double *x, size_t n, ai_u8_quant_t q, uint8_t *out) {
+    const double inv = 1.0 / q.scale;
+    for (size_t k = 0; k < n; k++) {
+        double v = x[k] * inv + q.zero;
+        v = !(v > 0.0) ? 0.0 : v > 255.0 ? 255.0 : v;
+        out[k] = (uint8_t)(v + 0.5);
+    }
+}
+
+void ai_i8_linear_free(ai_i8_linear_t *lin) {
+    if (!lin) return;
+    free(lin->w);
+    free(lin->scale);
+    free(lin->wsum);
+    free(lin->bias);
+    memset(lin, 0, sizeof(*lin));
+}
+
+int ai_i8_linear_init(ai_i8_linear_t *lin, size_t out, size_t in, const double *w, const float *wf, const double *b,
+                      const float *bf) {
+    if (!lin || out == 0 || in == 0 || (!w && !wf)) return -1;
+    memset(lin, 0, sizeof(*lin));
+    lin->in = in;
+    lin->out = out;
+    lin->stride = ai_i8_stride(in);
+    lin->w = calloc(out * lin->stride, 1);
+    lin->scale = malloc(out * sizeof(float));
+    lin->wsum = malloc(out * sizeof(int32_t));
+    lin->bias = malloc(out * sizeof(float));
+    if (!lin->w || !lin->scale || !lin->wsum || !lin->bias) {
+        ai_i8_linear_free(lin);
+        return -1;
+    }
+    for (size_t o = 0; o < out; o++) {
+        double most = 0.0, inv;
+        int32_t sum = 0;
+        for (size_t k = 0; k < in; k++) {
+            const double v = fabs(w ? w[o * in + k] : (double)wf[o * in + k]);
+            if (v > most) most = v;
+        }
+        lin->scale[o] = most > 0 ? (float)(most / 127.0) : 1.0f;
+        inv = 1.0 / lin->scale[o];
+        for (size_t k = 0; k < in; k++) {
+            long q = lrint((w ? w[o * in + k] : (double)wf[o * in + k]) * inv);
+            q = q < -127 ? -127 : q > 127 ? 127 : q;
+            lin->w[o * lin->stride + k] = (int8_t)q;
+            sum += (int32_t)q;
+        }
+        lin->wsum[o] = sum;
+        lin->bias[o] = b ? (float)b[o] : bf ? bf[o] : 0.0f;
+    }
+    return 0;
+}
+
+/* -------------------------------
+   Layers
+   ------------------------------- */
+
+typedef struct {
+    float sx;           /* input scale */
+    int32_t zx;         /* input zero point */
+    float inv_y;        /* 1 / output scale */
+    int32_t zy;
+} ai_i8_epilogue;
+
+/* tanh as a [13/6] rational in x, clamped where it rounds to +-1 in
+   float; within 4e-7 of tanh, far below a uint8 step, and inlined
+   where the libm call would cost more than the dot product */
+static inline float ai_i8_tanh(float x) {
+    const float c = 7.90531110763549805f;
+    float x2, p, q;
+    x = x > c ? c : x < -c ? -c : x;
+    x2 = x * x;
+    p = -2.76076847742355e-16f;
+    p = p * x2 + 2.00018790482477e-13f;
+    p = p * x2 - 8.60467152213735e-11f;
+    p = p * x2 + 5.12229709037114e-08f;
+    p = p * x2 + 1.48572235717979e-05f;
+    p = p * x2 + 6.37261928875436e-04f;
+    p = p * x2 + 4.89352455891786e-03f;
+    q = 1.19825839466702e-06f;
+    q = q * x2 + 1.18534705686654e-04f;
+    q = q * x2 + 2.26843463243900e-03f;
+    q = q * x2 + 4.89352518554385e-03f;
+    return x * p / q;
+}
+
+/* Requantize, bias, activation and store of output o of row r. */
+static inline void ai_i8_store(const ai_i8_linear_t *lin, const ai_i8_epilogue *e, size_t r, size_t o, int32_t acc,
+                               ai_i8_act_t act, uint8_t *y, size_t y_stride, double *yd, size_t ychan) {
+    float v = e->sx * lin->scale[o] * (float)(acc - e->zx * lin->wsum[o]) + lin->bias[o];
+    const size_t at = ychan ? o * ychan + r : r * (yd ? lin->out : y_stride) + o;
+    if (act == AI_I8_TANH) v = ai_i8_tanh(v);
+    if (yd) {
+        yd[at] = (double)v;
+    } else {
+        v = v * e->inv_y + (float)e->zy;
+        v = !(v > 0.0f) ? 0.0f : v > 255.0f ? 255.0f : v;
+        y[at] = (uint8_t)(v + 0.5f);
+    }
+}
+
+#define AI_I8_LOOP(DOT)                                                                                   \
+    for (size_t r = 0; r < rows; r++) {                                                                   \
+        const uint8_t *xr = x + r * lin->stride;                                                          \
+        for (size_t o = 0; o < lin->out; o++)                                                             \
+            ai_i8_store(lin, e, r, o, DOT(xr, lin->w + o * lin->stride, lin->stride, lin->wsum[o]), act,  \
+                        y, y_stride, yd, ychan);                                                           \
+    }
+
+static inline int32_t ai_i8_dot_scalar(const uint8_t *x, const int8_t *w, size_t n, int32_t wsum) {
+    int32_t acc = 0;
+    (void)wsum;
+    for (size_t k = 0; k < n; k++) acc += (int32_t)x[k] * (int32_t)w[k];
+    return acc;
+}
+
+static void ai_i8_scalar(const ai_i8_linear_t *lin, const ai_i8_epilogue *e, const uint8_t *x, size_t rows, ai_i8_act_t act,
+                         uint8_t *y, size_t y_stride, double *yd, size_t ychan) {
+    AI_I8_LOOP(ai_i8_dot_scalar)
+}
+
+#ifdef AI_I8_HAVE_X86
+
+__attribute__((target("avx2"), always_inline))
+static inline int32_t ai_i8_dot_avx2(const uint8_t *x, const int8_t *w, size_t n, int32_t wsum) {
+    __m256i acc0 = _mm256_setzero_si256(), acc1 = _mm256_setzero_si256();
+    __m128i s;
+    (void)wsum;
+    for (size_t k = 0; k < n; k += 32) {
+        const __m256i x0 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(x + k)));
+        const __m256i w0 = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(w + k)));
+        const __m256i x1 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(x + k + 16)));
+        const __m256i w1 = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(w + k + 16)));
+        acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(x0, w0));
+        acc1 = _mm256_add_epi32(acc1, _mm256_madd_epi16(x1, w1));
+    }
+    acc0 = _mm256_add_epi32(acc0, acc1);
+    s = _mm_add_epi32(_mm256_castsi256_si128(acc0), _mm256_extracti128_si256(acc0, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4e));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xb1));
+    return _mm_cvtsi128_si32(s);
+}
+
+__attribute__((target("avx2")))
+static void ai_i8_avx2(const ai_i8_linear_t *lin, const ai_i8_epilogue *e, const uint8_t *x, size_t rows, ai_i8_act_t act,
+                       uint8_t *y, size_t y_stride, double *yd, size_t ychan) {
+    AI_I8_LOOP(ai_i8_dot_avx2)
+}
+
+__attribute__((target("avx512f,avx512bw,avx512vnni"), always_inline))
+static inline int32_t ai_i8_dot_vnni(const uint8_t *x, const int8_t *w, size_t n, int32_t wsum) {
+    __m512i acc = _mm512_setzero_si512();
+    (void)wsum;
+    for (size_t k = 0; k < n; k += 64)
+        acc = _mm512_dpbusd_epi32(acc, _mm512_loadu_si512((const void *)(x + k)), _mm512_loadu_si512((const void *)(w + k)));
+    return _mm512_reduce_add_epi32(acc);
+}
+
+__attribute__((target("avx512f,avx512bw,avx512vnni")))
+static void ai_i8_vnni(const ai_i8_linear_t *lin, const ai_i8_epilogue *e, const uint8_t *x, size_t rows, ai_i8_act_t act,
+                       uint8_t *y, size_t y_stride, double *yd, size_t ychan) {
+    AI_I8_LOOP(ai_i8_dot_vnni)
+}
+
+#endif /* AI_I8_HAVE_X86 */
+
+#ifdef AI_I8_HAVE_NEON
+
+static inline int32_t ai_i8_dot_neon(const uint8_t *x, const int8_t *w, size_t n, int32_t wsum) {
+    const uint8x16_t flip = vdupq_n_u8(0x80);
+    int32x4_t acc = vdupq_n_s32(0);
+    for (size_t k = 0; k < n; k += 16)
+        acc = vdotq_s32(acc, vreinterpretq_s8_u8(veorq_u8(vld1q_u8(x + k), flip)), vld1q_s8(w + k));
+    return vaddvq_s32(acc) + 128 * wsum;
+}
+
+static void ai_i8_neon(const ai_i8_linear_t *lin, const ai_i8_epilogue *e, const uint8_t *x, size_t rows, ai_i8_act_t act,
+                       uint8_t *y, size_t y_stride, double *yd, size_t ychan) {
+    AI_I8_LOOP(ai_i8_dot_neon)
+}
+
+#endif /* AI_I8_HAVE_NEON */
+
+void ai_i8_linear_forward(const ai_i8_linear_t *lin, const uint8_t *x, size_t rows, ai_u8_quant_t xq, ai_i8_act_t act,
+                          ai_u8_quant_t yq, uint8_t *y, size_t y_stride, double *yd, size_t ychan) {
+    ai_i8_epilogue e;
+    if (!lin || !x || rows == 0 || (!y && !yd)) return;
+    e.sx = xq.scale;
+    e.zx = xq.zero;
+    e.inv_y = 1.0f / yq.scale;
+    e.zy = yq.zero;
+    switch (ai_i8_active_isa()) {
+#ifdef AI_I8_HAVE_X86
+    case AI_I8_ISA_AVX512_VNNI:
+        ai_i8_vnni(lin, &e, x, rows, act, y, y_stride, yd, ychan);
+        return;
+    case AI_I8_ISA_AVX2:
+        ai_i8_avx2(lin, &e, x, rows, act, y, y_stride, yd, ychan);
+        return;
+#endif
+#ifdef AI_I8_HAVE_NEON
+    case AI_I8_ISA_NEON_DOT:
+        ai_i8_neon(lin, &e, x, rows, act, y, y_stride, yd, ychan);
+        return;
+#endif
+    default:
+        ai_i8_scalar(lin, &e, x, rows, act, y, y_stride, yd, ychan);
+        return;
+    }
+}
+
+/* -------------------------------
+   Instruction sets
+   ------------------------------- */
+
+static int ai_i8_isa_supported(ai_i8_isa_t isa) {
+    switch (isa) {
+    case AI_I8_ISA_SCALAR:
+        return 1;
+#ifdef AI_I8_HAVE_X86
+    case AI_I8_ISA_AVX2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+    case AI_I8_ISA_AVX512_VNNI:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vnni");
+#endif
+#ifdef AI_I8_HAVE_NEON
+    case AI_I8_ISA_NEON_DOT:
+        return 1;
+#endif
+    default:
+        return 0;
+    }
+}
+
+static ai_i8_isa_t ai_i8_detect(void) {
+    static const ai_i8_isa_t order[] = { AI_I8_ISA_AVX512_VNNI, AI_I8_ISA_AVX2, AI_I8_ISA_NEON_DOT };
+    for (size_t k = 0; k < sizeof(order) / sizeof(order[0]); k++)
+        if (ai_i8_isa_supported(order[k])) return order[k];
+    return AI_I8_ISA_SCALAR;
+}
+
+void ai_i8_set_isa(ai_i8_isa_t isa) {
+    if (isa == AI_I8_ISA_AUTO) ai_i8_isa = ai_i8_detect();
+    else ai_i8_isa = ai_i8_isa_supported(isa) ? isa : AI_I8_ISA_SCALAR;
+}
+
+ai_i8_isa_t ai_i8_active_isa(void) {
+    if (ai_i8_isa == AI_I8_ISA_AUTO) ai_i8_isa = ai_i8_detect();
+    return ai_i8_isa;
+}
+
+const char *ai_i8_isa_name(ai_i8_isa_t isa) {
+    switch (isa) {
+    case AI_I8_ISA_SCALAR:      return "scalar";
+    case AI_I8_ISA_AVX2:        return "avx2";
+    case AI_I8_ISA_AVX512_VNNI: return "avx512-vnni";
+    case AI_I8_ISA_NEON_DOT:    return "neon-dot";
+    default:                    return "auto";
+    }
+}
@@ -0,0 +1,230 @@
+/* ai_model.c - Memory-mapped model files of the AI models for HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+   ----------------------------------------------------------------------
+   File layout (ai_model_header, then):
+   - meta: n_meta u64
+   - table: count ai_model_entry
+   - tensors, each at a multiple of AI_MODEL_ALIGN, zero padded
+   The header records the file size, so a truncated copy is rejected
+   at open instead of faulting on first touch; the byte-order tag
+   rejects files written on a host of the other endianness.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "core/ai/ai_model.h"
+
+#define AI_MODEL_FORMAT 1u
+#define AI_MODEL_ORDER 0x0102030405060708ULL
+
+typedef struct {
+    char magic[8];
+    uint32_t version;               /* model file version */
+    uint32_t format;                /* AI_MODEL_FORMAT */
+    uint64_t size;                  /* bytes in the file */
+    uint64_t n_meta;
+    uint64_t count;
+    uint64_t order;                 /* AI_MODEL_ORDER in host byte order */
+    uint64_t reserved[2];
+} ai_model_header;
+
+typedef struct {
+    uint32_t dtype;
+    uint32_t rank;
+    uint64_t shape[AI_MODEL_RANK];
+    uint64_t offset;
+    uint64_t bytes;
+} ai_model_entry;
+
+static size_t ai_dtype_size(uint32_t dtype) {
+    switch (dtype) {
+    case AI_DTYPE_F64: return sizeof(double);
+    case AI_DTYPE_F32: return sizeof(float);
+    case AI_DTYPE_I8: return sizeof(int8_t);
+    case AI_DTYPE_I32: return sizeof(int32_t);
+    default: return 0;
+    }
+}
+
+static uint64_t ai_model_round(uint64_t x) {
+    return (x + AI_MODEL_ALIGN - 1) / AI_MODEL_ALIGN * AI_MODEL_ALIGN;
+}
+
+/* -------------------------------
+   Writing
+   ------------------------------- */
+
+static int ai_model_pad(FILE *fp, uint64_t *at) {
+    static const unsigned char zero[AI_MODEL_ALIGN];
+    const size_t n = (size_t)(ai_model_round(*at) - *at);
+    *at += n;
+    return fwrite(zero, 1, n, fp) == n ? 0 : -1;
+}
+
+int ai_model_write(const char *filename, const char *magic, uint32_t version, const uint64_t *meta, size_t n_meta,
+                   const ai_blob_t *blobs, size_t count) {
+    ai_model_header h;
+    ai_model_entry *table;
+    uint64_t at;
+    char *tmp;
+    FILE *fp;
+    int ok;
+    if (!filename || !magic || (n_meta && !meta) || (count && !blobs)) return -1;
+    table = calloc(count ? count : 1, sizeof(*table));
+    tmp = malloc(strlen(filename) + 32);
+    if (!table || !tmp) {
+        free(table);
+        free(tmp);
+        return -1;
+    }
+    at = ai_model_round(sizeof h + n_meta * sizeof(uint64_t) + count * sizeof(*table));
+    ok = 1;
+    for (size_t i = 0; i < count && ok; i++) {
+        const ai_blob_t *b = &blobs[i];
+        uint64_t n = 1;
+        ok = ai_dtype_size(b->dtype) && b->rank <= AI_MODEL_RANK;
+        for (size_t d = 0; d < b->rank && ok; d++) {
+            table[i].shape[d] = b->shape[d];
+            n *= b->shape[d];
+        }
+        table[i].dtype = (uint32_t)b->dtype;
+        table[i].rank = (uint32_t)b->rank;
+        table[i].offset = at;
+        table[i].bytes = n * ai_dtype_size(b->dtype);
+        ok = ok && (table[i].bytes == 0 || b->data);
+        at = ai_model_round(at + table[i].bytes);
+    }
+    memset(&h, 0, sizeof h);
+    memcpy(h.magic, magic, sizeof h.magic);
+    h.version = version;
+    h.format = AI_MODEL_FORMAT;
+    h.size = at;
+    h.n_meta = n_meta;
+    h.count = count;
+    h.order = AI_MODEL_ORDER;
+
+    sprintf(tmp, "%s.%ld.tmp", filename, (long)getpid());
+    fp = ok ? fopen(tmp, "wb") : NULL;
+    ok = fp != NULL;
+    at = sizeof h + n_meta * sizeof(uint64_t) + count * sizeof(*table);
+    ok = ok && fwrite(&h, sizeof h, 1, fp) == 1 && fwrite(meta, sizeof(uint64_t), n_meta, fp) == n_meta
+         && fwrite(table, sizeof(*table), count, fp) == count && ai_model_pad(fp, &at) == 0;
+    for (size_t i = 0; i < count && ok; i++) {
+        const size_t bytes = (size_t)table[i].bytes;
+        at += bytes;
+        ok = fwrite(blobs[i].data, 1, bytes, fp) == bytes && ai_model_pad(fp, &at) == 0;
+    }
+    if (fp) ok = fclose(fp) == 0 && ok;
+    ok = ok && rename(tmp, filename) == 0;
+    if (fp && !ok) remove(tmp);
+    free(table);
+    free(tmp);
+    return ok ? 0 : -1;
+}
+
+/* -------------------------------
+   Mapping
+   ------------------------------- */
+
+static int ai_model_check(const unsigned char *map, size_t size, const char *magic) {
+    const ai_model_header *h = (const ai_model_header *)map;
+    const ai_model_entry *table;
+    uint64_t end;
+    if (size < sizeof *h || memcmp(h->magic, magic, sizeof h->magic) != 0 || h->format != AI_MODEL_FORMAT
+        || h->order != AI_MODEL_ORDER || h->size != size)
+        return -1;
+    if (h->n_meta > size / sizeof(uint64_t) || h->count > size / sizeof(ai_model_entry)) return -1;
+    end = sizeof *h + h->n_meta * sizeof(uint64_t) + h->count * sizeof(ai_model_entry);
+    if (end > size) return -1;
+    table = (const ai_model_entry *)(map + sizeof *h + h->n_meta * sizeof(uint64_t));
+    for (uint64_t i = 0; i < h->count; i++) {
+        const ai_model_entry *e = &table[i];
+        const size_t value = ai_dtype_size(e->dtype);
+        uint64_t n = 1;
+        if (!value || e->rank > AI_MODEL_RANK || e->offset % AI_MODEL_ALIGN || e->offset < end || e->offset > size
+            || e->bytes > size - e->offset)
+            return -1;
+        for (uint32_t d = 0; d < e->rank; d++) {
+            if (e->shape[d] && n > UINT64_MAX / e->shape[d]) return -1;
+            n *= e->shape[d];
+        }
+        if (n > e->bytes / value || n * value != e->bytes) return -1;
+    }
+    return 0;
+}
+
+ai_model_t *ai_model_open(const char *filename, const char *magic) {
+    ai_model_t *m;
+    struct stat st;
+    void *map;
+    int fd;
+    if (!filename || !magic) return NULL;
+    fd = open(filename, O_RDONLY);
+    if (fd < 0) return NULL;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(ai_model_header)) {
+        close(fd);
+        return NULL;
+    }
+    /* The mapping outlives the descriptor */
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return NULL;
+    m = calloc(1, sizeof(*m));
+    if (!m || ai_model_check(map, (size_t)st.st_size, magic) != 0) {
+        munmap(map, (size_t)st.st_size);
+        free(m);
+        return NULL;
+    }
+    m->map = map;
+    m->size = (size_t)st.st_size;
+    m->version = ((const ai_model_header *)map)->version;
+    m->n_meta = (size_t)((const ai_model_header *)map)->n_meta;
+    m->count = (size_t)((const ai_model_header *)map)->count;
+    m->meta = (const uint64_t *)(m->map + sizeof(ai_model_header));
+    m->table = m->meta + m->n_meta;
+    return m;
+}
+
+void ai_model_close(ai_model_t *model) {
+    if (!model) return;
+    munmap(model->map, model->size);
+    free(model);
+}
+
+void *ai_model_tensor(const ai_model_t *model, size_t i, ai_dtype_t dtype, size_t count) {
+    const ai_model_entry *e;
+    if (!model || i >= model->count) return NULL;
+    e = (const ai_model_entry *)model->table + i;
+    if (e->dtype != (uint32_t)dtype || e->bytes != (uint64_t)count * ai_dtype_size(dtype)) return NULL;
+    return model->map + e->offset;
+}
+
+size_t ai_model_shape(const ai_model_t *model, size_t i, size_t *shape) {
+    const ai_model_entry *e;
+    if (!model || i >= model->count) return 0;
+    e = (const ai_model_entry *)model->table + i;
+    for (uint32_t d = 0; shape && d < e->rank; d++) shape[d] = (size_t)e->shape[d];
+    return e->rank;
+}
@@ -0,0 +1,220 @@
+/* ai_plan.c - Execution plans and arenas of the AI models for HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+   ----------------------------------------------------------------------
+   Packing is the greedy interval-colouring heuristic: tensors in order
+   of decreasing size, each at the lowest offset where it overlaps no
+   already placed tensor whose lifetime meets its own. Passes declare a
+   few dozen tensors, so the quadratic scan (and insertion sorts, which
+   keep packing reentrant) are noise next to one GEMM.
+
+   A pass's tensor count must not depend on the sizes: a plan made for
+   a larger batch is addressed by index in smaller calls.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "core/ai/ai_plan.h"
+
+/* -------------------------------
+   Plans
+   ------------------------------- */
+
+void ai_plan_init(ai_plan_t *plan) {
+    memset(plan, 0, sizeof(*plan));
+}
+
+void ai_plan_free(ai_plan_t *plan) {
+    if (!plan) return;
+    free(plan->tensors);
+    ai_plan_init(plan);
+}
+
+int ai_plan_add(ai_plan_t *plan, size_t bytes, size_t first, size_t last) {
+    ai_tensor_t *t;
+    if (!plan || last < first) return -1;
+    if (plan->count == plan->cap) {
+        const size_t cap = plan->cap ? 2 * plan->cap : 16;
+        ai_tensor_t *grown = realloc(plan->tensors, cap * sizeof(*grown));
+        if (!grown) return -1;
+        plan->tensors = grown;
+        plan->cap = cap;
+    }
+    t = &plan->tensors[plan->count++];
+    t->bytes = (bytes + AI_PLAN_ALIGN - 1) / AI_PLAN_ALIGN * AI_PLAN_ALIGN;
+    t->first = first;
+    t->last = last;
+    t->offset = 0;
+    return 0;
+}
+
+/* Insertion sort of the indices idx[0..n) by key (ascending), ties by index. */
+static void ai_sort(size_t *idx, size_t n, const ai_tensor_t *t, int by_offset) {
+    for (size_t i = 1; i < n; i++) {
+        const size_t v = idx[i];
+        size_t j = i;
+        for (; j > 0; j--) {
+            const size_t u = idx[j - 1];
+            const int after = by_offset ? t[u].offset > t[v].offset
+                                        : t[u].bytes < t[v].bytes || (t[u].bytes == t[v].bytes && u > v);
+            if (!after) break;
+            idx[j] = u;
+        }
+        idx[j] = v;
+    }
+}
+
+int ai_plan_pack(ai_plan_t *plan) {
+    const size_t n = plan ? plan->count : 0;
+    size_t *order, *live;
+    if (!plan) return -1;
+    plan->bytes = 0;
+    if (n == 0) return 0;
+    order = malloc(2 * n * sizeof(size_t));
+    if (!order) return -1;
+    live = order + n;
+    for (size_t i = 0; i < n; i++) order[i] = i;
+    ai_sort(order, n, plan->tensors, 0);
+    for (size_t k = 0; k < n; k++) {
+        ai_tensor_t *t = &plan->tensors[order[k]];
+        size_t m = 0, at = 0;
+        /* Placed tensors alive at the same time, by offset */
+        for (size_t p = 0; p < k; p++) {
+            const ai_tensor_t *o = &plan->tensors[order[p]];
+            if (o->bytes && t->bytes && o->first <= t->last && t->first <= o->last) live[m++] = order[p];
+        }
+        ai_sort(live, m, plan->tensors, 1);
+        for (size_t p = 0; p < m; p++) {
+            const ai_tensor_t *o = &plan->tensors[live[p]];
+            if (o->offset >= at + t->bytes) break;
+            if (o->offset + o->bytes > at) at = o->offset + o->bytes;
+        }
+        t->offset = at;
+        if (at + t->bytes > plan->bytes) plan->bytes = at + t->bytes;
+    }
+    free(order);
+    return 0;
+}
+
+/* -------------------------------
+   Arenas
+   ------------------------------- */
+
+void ai_arena_init(ai_arena_t *arena) {
+    arena->base = NULL;
+    arena->size = 0;
+}
+
+void ai_arena_free(ai_arena_t *arena) {
+    if (!arena) return;
+    free(arena->base);
+    ai_arena_init(arena);
+}
+
+int ai_arena_reserve(ai_arena_t *arena, size_t bytes) {
+    void *base;
+    if (!arena) return -1;
+    if (bytes <= arena->size) return 0;
+    base = malloc(bytes);
+    if (!base) return -1;
+    free(arena->base);
+    arena->base = base;
+    arena->size = bytes;
+    return 0;
+}
+
+/* -------------------------------
+   Model plans
+   ------------------------------- */
+
+void ai_exec_plan_free(ai_exec_plan_t *exec) {
+    if (!exec) return;
+    for (int p = 0; p < AI_PASS_COUNT; p++) ai_plan_free(&exec->pass[p]);
+    ai_arena_free(&exec->own);
+    free(exec);
+}
+
+int ai_exec_plan(ai_exec_plan_t **exec, ai_arena_t *arena, ai_layout_fn layout, const void *model,
+                 size_t batch, size_t length, int threads) {
+    ai_exec_plan_t *e;
+    size_t most = 0;
+    if (!exec || !layout || !model) return -1;
+    e = calloc(1, sizeof(*e));
+    if (!e) return -1;
+    ai_arena_init(&e->own);
+    e->arena = arena ? arena : &e->own;
+    e->batch = batch;
+    e->length = length;
+    e->threads = threads;
+    for (int p = 0; p < AI_PASS_COUNT; p++) {
+        ai_plan_init(&e->pass[p]);
+        if (layout(model, (ai_pass_t)p, batch, length, threads, &e->pass[p]) != 0 || ai_plan_pack(&e->pass[p]) != 0) {
+            ai_exec_plan_free(e);
+            return -1;
+        }
+        if (e->pass[p].bytes > most) most = e->pass[p].bytes;
+    }
+    if (ai_arena_reserve(e->arena, most) != 0) {
+        ai_exec_plan_free(e);
+        return -1;
+    }
+    ai_exec_plan_free(*exec);
+    *exec = e;
+    return 0;
+}
+
+int ai_exec_grow(ai_exec_plan_t **exec, ai_layout_fn layout, const void *model, size_t batch, size_t length, int threads) {
+    const ai_exec_plan_t *e = exec ? *exec : NULL;
+    if (!exec) return -1;
+    if (e) {
+        if (e->batch > batch) batch = e->batch;
+        if (e->length > length) length = e->length;
+        if (e->threads > threads) threads = e->threads;
+    }
+    return ai_exec_plan(exec, e && e->arena != &e->own ? e->arena : NULL, layout, model, batch, length, threads);
+}
+
+int ai_exec_covers(const ai_exec_plan_t *exec, size_t batch, size_t length, int threads) {
+    return exec && batch <= exec->batch && length <= exec->length && threads <= exec->threads;
+}
+
+void *ai_exec_begin(const ai_exec_plan_t *exec, ai_layout_fn layout, const void *model, ai_pass_t pass,
+                    size_t batch, size_t length, int threads, ai_plan_t *local, const ai_plan_t **used) {
+    void *base;
+    ai_plan_init(local);
+    if (ai_exec_covers(exec, batch, length, threads) && exec->arena->size >= exec->pass[pass].bytes) {
+        *used = &exec->pass[pass];
+        return exec->arena->base;
+    }
+    *used = local;
+    if (layout(model, pass, batch, length, threads, local) != 0 || ai_plan_pack(local) != 0) {
+        ai_plan_free(local);
+        return NULL;
+    }
+    base = malloc(local->bytes ? local->bytes : 1);
+    if (!base) ai_plan_free(local);
+    return base;
+}
+
+void ai_exec_end(void *base, ai_plan_t *local, const ai_plan_t *used) {
+    if (used == local) {
+        free(base);
+        ai_plan_free(local);
+    }
+}
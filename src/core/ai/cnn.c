@@ -0,0 +1,828 @@
+/* cnn.c - Convolutional Neural Network for HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+   ----------------------------------------------------------------------
+   Convolutions are lowered to dgemm:
+   - im2col: a block of output rows is unfolded into a (Cin k k) x pixels
+     panel, and Y[:, block] = K panel writes straight into the output
+     (K is Cout x Cin k k as stored); blocks keep the panel in cache and
+     bound its memory whatever the map size
+   - Winograd F(2x2,3x3): 4x4 input tiles d and kernels g are taken to
+     V = B^T d B and U = G g G^T, the 16 positions are 16 GEMMs
+     Cout x Cin by Cin x tiles, and A^T M A gives each 2x2 output tile,
+     2.25x fewer multiplies than the direct form
+   - backward: grad K = dY panel^T and grad panel = K^T dY, folded back
+     by col2im (all kernel sizes)
+   The passes are written once in cnn_kernels.h and instantiated for
+   double (FP64) and float (FP32, BF16).
+
+   Files are model containers (ai_model.h), "HOLOSCNN" version 3: meta
+   precision, layers, height, width and per layer input channels,
+   output channels, kernel size, then per layer the kernels and biases
+   as doubles (FP64) or floats (FP32, BF16). A loaded model computes on
+   the mapped arrays. Versions 1 and 2 were streams: "HOLOSCNN", u32
+   version, u32 storage precision (from version 2), u64 layers, height,
+   width, then per layer the u64 shape and the arrays; they are still
+   read (into allocated arrays).
+
+   The INT8 form unfolds uint8 maps into pixel-major panels (one patch
+   per row, the zero point standing for the padding) so that a block of
+   pixels is one ai_i8_linear_forward, stored channel-major into the
+   next layer's map. cnn_quantize calibrates each layer alone, as a
+   one-layer model with a linear output. Its files are "HOLOSCQ8".
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <gsl/gsl_cblas.h>
+
+#include "core/ai/cnn.h"
+
+#define CNN_MAGIC "HOLOSCNN"
+#define CNN_VERSION 3u
+#define CNN_STREAM_VERSION 2u       /* Last version before the container */
+#define CNN_COL_BLOCK 4096          /* Output pixels per im2col panel */
+#define CNN_TILE_BLOCK 1024         /* Winograd tiles per GEMM batch */
+#define CNN_Q8_BLOCK 64             /* Output pixels per int8 patch panel */
+#define CNN_Q8_MAGIC "HOLOSCQ8"
+#define CNN_Q8_VERSION 1u
+
+static void cnn_replan(cnn_t *cnn);
+
+/* -------------------------------
+   Allocation
+   ------------------------------- */
+
+static uint64_t cnn_splitmix(uint64_t *s) {
+    uint64_t z = (*s += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static size_t cnn_kernel_count(const cnn_layer_t *ly) {
+    return ly->output_channels * ly->input_channels * ly->kernel_size * ly->kernel_size;
+}
+
+static void cnn_params_free(cnn_layer_t *ly) {
+    free(ly->kernels);
+    free(ly->biases);
+    free(ly->kernels_f);
+    free(ly->biases_f);
+    ly->kernels = ly->biases = NULL;
+    ly->kernels_f = ly->biases_f = NULL;
+}
+
+/* Parameter arrays of the storage type of precision, zeroed. */
+static int cnn_params_alloc(cnn_layer_t *ly, ai_precision_t precision) {
+    if (precision == AI_PRECISION_FP64) {
+        ly->kernels = calloc(cnn_kernel_count(ly), sizeof(double));
+        ly->biases = calloc(ly->output_channels, sizeof(double));
+        return ly->kernels && ly->biases ? 0 : -1;
+    }
+    ly->kernels_f = calloc(cnn_kernel_count(ly), sizeof(float));
+    ly->biases_f = calloc(ly->output_channels, sizeof(float));
+    return ly->kernels_f && ly->biases_f ? 0 : -1;
+}
+
+/* Kernels and biases are zero, or left NULL for the caller to bind when params is 0. */
+static cnn_t *cnn_shell(const size_t *input_channels, const size_t *output_channels, const size_t *kernel_sizes, size_t num_layers,
+                        ai_precision_t precision, int params) {
+    cnn_t *cnn;
+    if (!input_channels || !output_channels || !kernel_sizes || num_layers == 0) return NULL;
+    if (precision < AI_PRECISION_FP64 || precision > AI_PRECISION_BF16) return NULL;
+    for (size_t l = 0; l < num_layers; l++) {
+        if (input_channels[l] == 0 || output_channels[l] == 0 || kernel_sizes[l] % 2 == 0) return NULL;
+        if (l > 0 && input_channels[l] != output_channels[l - 1]) return NULL;
+    }
+    cnn = calloc(1, sizeof(*cnn));
+    if (!cnn) return NULL;
+    cnn->layers = calloc(num_layers, sizeof(cnn_layer_t));
+    if (!cnn->layers) {
+        free(cnn);
+        return NULL;
+    }
+    cnn->num_layers = num_layers;
+    cnn->winograd = 1;
+    cnn->precision = precision;
+    for (size_t l = 0; l < num_layers; l++) {
+        cnn_layer_t *ly = &cnn->layers[l];
+        ly->input_channels = input_channels[l];
+        ly->output_channels = output_channels[l];
+        ly->kernel_size = kernel_sizes[l];
+        if (params && cnn_params_alloc(ly, precision) != 0) {
+            cnn_free(cnn);
+            return NULL;
+        }
+    }
+    return cnn;
+}
+
+/* Kernels are Glorot uniform over the fan of each layer, fixed seed. */
+cnn_t *cnn_alloc_precision(const size_t *input_channels, const size_t *output_channels, const size_t *kernel_sizes, size_t num_layers,
+                           ai_precision_t precision) {
+    cnn_t *cnn = cnn_shell(input_channels, output_channels, kernel_sizes, num_layers, precision, 1);
+    uint64_t seed = 0x484f4c4f53434e4eULL;
+    if (!cnn) return NULL;
+    for (size_t l = 0; l < num_layers; l++) {
+        cnn_layer_t *ly = &cnn->layers[l];
+        const size_t kk = ly->kernel_size * ly->kernel_size, n = cnn_kernel_count(ly);
+        const double a = sqrt(6.0 / (double)((ly->input_channels + ly->output_channels) * kk));
+        for (size_t k = 0; k < n; k++) {
+            const double u = (double)(cnn_splitmix(&seed) >> 11) * 0x1.0p-53;
+            if (ly->kernels) ly->kernels[k] = a * (2.0 * u - 1.0);
+            else ly->kernels_f[k] = (float)(a * (2.0 * u - 1.0));
+        }
+    }
+    return cnn;
+}
+
+cnn_t *cnn_alloc(const size_t *input_channels, const size_t *output_channels, const size_t *kernel_sizes, size_t num_layers) {
+    return cnn_alloc_precision(input_channels, output_channels, kernel_sizes, num_layers, AI_PRECISION_FP64);
+}
+
+void cnn_free(cnn_t *cnn) {
+    if (!cnn) return;
+    if (cnn->layers && !cnn->file)
+        for (size_t l = 0; l < cnn->num_layers; l++) cnn_params_free(&cnn->layers[l]);
+    ai_model_close(cnn->file);
+    ai_exec_plan_free(cnn->plan);
+    free(cnn->layers);
+    free(cnn);
+}
+
+int cnn_set_input(cnn_t *cnn, size_t height, size_t width) {
+    if (!cnn || height == 0 || width == 0) return -1;
+    cnn->height = height;
+    cnn->width = width;
+    cnn_replan(cnn);
+    return 0;
+}
+
+int cnn_set_precision(cnn_t *cnn, ai_precision_t precision) {
+    cnn_layer_t *fresh;
+    if (!cnn || precision < AI_PRECISION_FP64 || precision > AI_PRECISION_BF16) return -1;
+    if ((precision == AI_PRECISION_FP64) == (cnn->precision == AI_PRECISION_FP64)) {
+        cnn->precision = precision;
+        cnn_replan(cnn);
+        return 0;
+    }
+    /* All layers converted before any is replaced */
+    fresh = calloc(cnn->num_layers, sizeof(cnn_layer_t));
+    if (!fresh) return -1;
+    for (size_t l = 0; l < cnn->num_layers; l++) {
+        const cnn_layer_t *ly = &cnn->layers[l];
+        cnn_layer_t *nl = &fresh[l];
+        const size_t n = cnn_kernel_count(ly);
+        *nl = *ly;
+        nl->kernels = nl->biases = NULL;
+        nl->kernels_f = nl->biases_f = NULL;
+        if (cnn_params_alloc(nl, precision) != 0) {
+            for (size_t k = 0; k <= l; k++) cnn_params_free(&fresh[k]);
+            free(fresh);
+            return -1;
+        }
+        if (precision == AI_PRECISION_FP64) {
+            for (size_t k = 0; k < n; k++) nl->kernels[k] = ly->kernels_f[k];
+            for (size_t k = 0; k < ly->output_channels; k++) nl->biases[k] = ly->biases_f[k];
+        } else {
+            for (size_t k = 0; k < n; k++) nl->kernels_f[k] = (float)ly->kernels[k];
+            for (size_t k = 0; k < ly->output_channels; k++) nl->biases_f[k] = (float)ly->biases[k];
+        }
+    }
+    /* Converted arrays are allocated; the mapped file is no longer used */
+    for (size_t l = 0; l < cnn->num_layers; l++) {
+        if (!cnn->file) cnn_params_free(&cnn->layers[l]);
+        cnn->layers[l] = fresh[l];
+    }
+    free(fresh);
+    ai_model_close(cnn->file);
+    cnn->file = NULL;
+    cnn->precision = precision;
+    cnn_replan(cnn);
+    return 0;
+}
+
+/* -------------------------------
+   Passes
+   ------------------------------- */
+
+/* Scratch sizes in values, for either compute type */
+typedef struct {
+    size_t col;                     /* im2col panel */
+    size_t U, V, M;                 /* Winograd, 0 without 3x3 layers */
+    size_t kernels;                 /* largest kernel array */
+} cnn_sizes;
+
+static size_t cnn_block_rows(const cnn_t *cnn) {
+    const size_t r = CNN_COL_BLOCK / cnn->width;
+    return r ? (r < cnn->height ? r : cnn->height) : 1;
+}
+
+static size_t cnn_widest(const cnn_t *cnn) {
+    size_t c = 0;
+    for (size_t l = 0; l < cnn->num_layers; l++)
+        if (cnn->layers[l].output_channels > c) c = cnn->layers[l].output_channels;
+    return c;
+}
+
+static void cnn_scratch_sizes(const cnn_t *cnn, cnn_sizes *z) {
+    const size_t pixels = cnn_block_rows(cnn) * cnn->width;
+    const size_t tiles = ((cnn->height + 1) / 2) * ((cnn->width + 1) / 2);
+    const size_t tb = tiles < CNN_TILE_BLOCK ? tiles : CNN_TILE_BLOCK;
+    size_t col = 0, cin = 0, cio = 0, cout = 0;
+    memset(z, 0, sizeof(*z));
+    for (size_t l = 0; l < cnn->num_layers; l++) {
+        const cnn_layer_t *ly = &cnn->layers[l];
+        const size_t c = ly->input_channels * ly->kernel_size * ly->kernel_size;
+        if (c > col) col = c;
+        if (cnn_kernel_count(ly) > z->kernels) z->kernels = cnn_kernel_count(ly);
+        if (ly->kernel_size == 3) {
+            if (ly->input_channels > cin) cin = ly->input_channels;
+            if (ly->output_channels > cout) cout = ly->output_channels;
+            if (ly->input_channels * ly->output_channels > cio) cio = ly->input_channels * ly->output_channels;
+        }
+    }
+    z->col = col * pixels;
+    if (cnn->winograd && cio) {
+        z->U = 16 * cio;
+        z->V = 16 * cin * tb;
+        z->M = 16 * cout * tb;
+    }
+}
+
+/* -------------------------------
+   Plans
+   ------------------------------- */
+
+/* Tensors of both passes, then of one or the other */
+enum { CNN_COL, CNN_U, CNN_V, CNN_M, CNN_KQ, CNN_XIN, CNN_PING, CNN_PONG };
+enum { CNN_ACTS = CNN_PING, CNN_DELTA, CNN_BELOW, CNN_GRAD, CNN_LAYERS };
+
+/* The layout is for the current input extent (length is its pixels)
+   and holds the Winograd buffers whether or not winograd is set, so
+   the flag can change under a plan. Training steps are those of the
+   MLP: forward l at l, loss at L, backward l at 2L - l, and a layer's
+   maps are last read by the backward of the layer above. */
+static int cnn_layout(const void *model, ai_pass_t pass, size_t batch, size_t length, int threads, ai_plan_t *plan) {
+    const cnn_t *cnn = model;
+    const size_t L = cnn->num_layers, HW = length, last = pass == AI_PASS_TRAIN ? 2 * L : 0;
+    const size_t elem = cnn->precision == AI_PRECISION_FP64 ? sizeof(double) : sizeof(float);
+    const size_t n_in = cnn->layers[0].input_channels * HW;
+    cnn_t wide = *cnn;
+    cnn_sizes z;
+    size_t widest;
+    int rc;
+    (void)batch;
+    (void)threads;
+    wide.winograd = 1;
+    cnn_scratch_sizes(&wide, &z);
+    widest = cnn_widest(cnn);
+    rc = ai_plan_add(plan, z.col * elem, 0, last) || ai_plan_add(plan, z.U * elem, 0, last)
+         || ai_plan_add(plan, z.V * elem, 0, last) || ai_plan_add(plan, z.M * elem, 0, last)
+         || ai_plan_add(plan, cnn->precision == AI_PRECISION_BF16 ? z.kernels * elem : 0, 0, last)
+         || ai_plan_add(plan, elem != sizeof(double) ? n_in * elem : 0, 0, last);
+    if (pass == AI_PASS_FORWARD)
+        return rc || ai_plan_add(plan, widest * HW * elem, 0, 0) || ai_plan_add(plan, widest * HW * elem, 0, 0) ? -1 : 0;
+    if (cnn->layers[0].input_channels > widest) widest = cnn->layers[0].input_channels;
+    rc = rc || ai_plan_add(plan, L * sizeof(void *), 0, last)
+         || ai_plan_add(plan, widest * HW * elem, L, last) || ai_plan_add(plan, widest * HW * elem, L, last)
+         || ai_plan_add(plan, z.kernels * elem, L + 1, last);
+    for (size_t l = 0; l < L && rc == 0; l++)
+        rc = ai_plan_add(plan, cnn->layers[l].output_channels * HW * elem, l, 2 * L - l - 1);
+    return rc ? -1 : 0;
+}
+
+/* Redo the plan for a new extent or precision; drop it if that fails. */
+static void cnn_replan(cnn_t *cnn) {
+    if (cnn->plan && ai_exec_plan(&cnn->plan, cnn->plan->arena != &cnn->plan->own ? cnn->plan->arena : NULL, cnn_layout, cnn,
+                                  1, cnn->height * cnn->width, 1) != 0) {
+        ai_exec_plan_free(cnn->plan);
+        cnn->plan = NULL;
+    }
+}
+
+int cnn_plan(cnn_t *cnn, ai_arena_t *arena) {
+    if (!cnn || cnn->num_layers == 0 || cnn->height == 0 || cnn->width == 0) return -1;
+    return ai_exec_plan(&cnn->plan, arena, cnn_layout, cnn, 1, cnn->height * cnn->width, 1);
+}
+
+#define CNN_REAL double
+#define CNN_FN(name) name##_f64
+#define CNN_GEMM cblas_dgemm
+#define CNN_TANH tanh
+#define CNN_K(ly) ((ly)->kernels)
+#define CNN_B(ly) ((ly)->biases)
+#define CNN_NATIVE 1
+#include "cnn_kernels.h"
+#undef CNN_REAL
+#undef CNN_FN
+#undef CNN_GEMM
+#undef CNN_TANH
+#undef CNN_K
+#undef CNN_B
+#undef CNN_NATIVE
+
+#define CNN_REAL float
+#define CNN_FN(name) name##_f32
+#define CNN_GEMM cblas_sgemm
+#define CNN_TANH tanhf
+#define CNN_K(ly) ((ly)->kernels_f)
+#define CNN_B(ly) ((ly)->biases_f)
+#define CNN_NATIVE 0
+#include "cnn_kernels.h"
+#undef CNN_REAL
+#undef CNN_FN
+#undef CNN_GEMM
+#undef CNN_TANH
+#undef CNN_K
+#undef CNN_B
+#undef CNN_NATIVE
+
+void cnn_forward(const cnn_t *cnn, const double *input, double *output) {
+    const ai_plan_t *plan;
+    ai_plan_t local;
+    void *base;
+    if (!cnn || !input || !output || cnn->height == 0 || cnn->width == 0) return;
+    base = ai_exec_begin(cnn->plan, cnn_layout, cnn, AI_PASS_FORWARD, 1, cnn->height * cnn->width, 1, &local, &plan);
+    if (!base) return;
+    if (cnn->precision == AI_PRECISION_FP64) cnn_forward_f64(cnn, plan, base, input, output);
+    else cnn_forward_f32(cnn, plan, base, input, output);
+    ai_exec_end(base, &local, plan);
+}
+
+void cnn_train(cnn_t *cnn, const double *input, const double *target, double learning_rate) {
+    const size_t HW = cnn ? cnn->height * cnn->width : 0;
+    const ai_plan_t *plan;
+    ai_plan_t local;
+    void *base;
+    if (!cnn || !input || !target || HW == 0) return;
+    if (!cnn->plan && cnn_plan(cnn, NULL) != 0) return;
+    base = ai_exec_begin(cnn->plan, cnn_layout, cnn, AI_PASS_TRAIN, 1, HW, 1, &local, &plan);
+    if (!base) return;
+    if (cnn->precision == AI_PRECISION_FP64) cnn_train_f64(cnn, plan, base, input, target, learning_rate);
+    else cnn_train_f32(cnn, plan, base, input, target, learning_rate);
+    ai_exec_end(base, &local, plan);
+}
+
+/* -------------------------------
+   Quantization
+   ------------------------------- */
+
+static cnn_q8_t *cnn_q8_shell(size_t num_layers) {
+    cnn_q8_t *q = calloc(1, sizeof(*q));
+    if (!q) return NULL;
+    q->num_layers = num_layers;
+    q->layers = calloc(num_layers, sizeof(cnn_q8_layer_t));
+    q->inputs = calloc(num_layers, sizeof(ai_u8_quant_t));
+    if (!q->layers || !q->inputs) {
+        free(q->layers);
+        free(q->inputs);
+        free(q);
+        return NULL;
+    }
+    return q;
+}
+
+void cnn_q8_free(cnn_q8_t *q) {
+    if (!q) return;
+    for (size_t l = 0; !q->file && l < q->num_layers; l++) ai_i8_linear_free(&q->layers[l].map);
+    ai_model_close(q->file);
+    free(q->layers);
+    free(q->inputs);
+    free(q);
+}
+
+static ai_u8_quant_t cnn_q8_range(const double *x, size_t n) {
+    double lo = 0.0, hi = 0.0;
+    for (size_t k = 0; k < n; k++) {
+        if (x[k] < lo) lo = x[k];
+        if (x[k] > hi) hi = x[k];
+    }
+    return ai_u8_range(lo, hi);
+}
+
+cnn_q8_t *cnn_quantize(const cnn_t *cnn, const double *calib, size_t n) {
+    const size_t HW = cnn ? cnn->height * cnn->width : 0;
+    size_t most;
+    cnn_q8_t *q;
+    double *x, *z;
+    int ok;
+    if (!cnn || cnn->num_layers == 0 || HW == 0 || !calib || n == 0) return NULL;
+    most = cnn_widest(cnn);
+    if (cnn->layers[0].input_channels > most) most = cnn->layers[0].input_channels;
+    q = cnn_q8_shell(cnn->num_layers);
+    x = malloc(n * most * HW * sizeof(double));
+    z = malloc(n * most * HW * sizeof(double));
+    ok = q && x && z;
+    if (ok) {
+        q->height = cnn->height;
+        q->width = cnn->width;
+        memcpy(x, calib, n * cnn->layers[0].input_channels * HW * sizeof(double));
+    }
+    /* x holds the inputs of layer l over the calibration set */
+    for (size_t l = 0; ok && l < cnn->num_layers; l++) {
+        const cnn_layer_t *ly = &cnn->layers[l];
+        const size_t cin = ly->input_channels, cout = ly->output_channels, kk = ly->kernel_size * ly->kernel_size;
+        q->layers[l].input_channels = cin;
+        q->layers[l].kernel_size = ly->kernel_size;
+        q->inputs[l] = cnn_q8_range(x, n * cin * HW);
+        ok = ai_i8_linear_init(&q->layers[l].map, cout, cin * kk, ly->kernels, ly->kernels_f, ly->biases, ly->biases_f) == 0;
+        if (ok && l + 1 < cnn->num_layers) {
+            /* Layer l alone is a model with a linear output */
+            cnn_t view = *cnn;
+            double *t;
+            view.num_layers = 1;
+            view.layers = (cnn_layer_t *)ly;
+            view.plan = NULL;
+            view.file = NULL;
+            ok = cnn_plan(&view, NULL) == 0;
+            for (size_t e = 0; ok && e < n; e++) cnn_forward(&view, x + e * cin * HW, z + e * cout * HW);
+            ai_exec_plan_free(view.plan);
+            for (size_t k = 0; k < n * cout * HW; k++) z[k] = tanh(z[k]);
+            t = x;
+            x = z;
+            z = t;
+        }
+    }
+    free(x);
+    free(z);
+    if (!ok) {
+        cnn_q8_free(q);
+        return NULL;
+    }
+    return q;
+}
+
+/* Rows p0..p0+np of the patch panel of map in (C x H x W), stride apart. */
+static void cnn_q8_patches(const uint8_t *in, size_t C, size_t H, size_t W, size_t k, uint8_t zero, size_t p0, size_t np,
+                           size_t stride, uint8_t *panel) {
+    const long r = (long)k / 2;
+    for (size_t p = 0; p < np; p++) {
+        const long y = (long)((p0 + p) / W), x = (long)((p0 + p) % W);
+        uint8_t *row = panel + p * stride;
+        for (size_t c = 0; c < C; c++) {
+            const uint8_t *ch = in + c * H * W;
+            for (long i = 0; i < (long)k; i++) {
+                const long yy = y + i - r;
+                for (long j = 0; j < (long)k; j++) {
+                    const long xx = x + j - r;
+                    *row++ = (yy < 0 || yy >= (long)H || xx < 0 || xx >= (long)W) ? zero : ch[yy * (long)W + xx];
+                }
+            }
+        }
+    }
+}
+
+/* Two maps of the most input channels, then the panel */
+static size_t cnn_q8_map_size(const cnn_q8_t *q) {
+    size_t c = 0;
+    for (size_t l = 0; l < q->num_layers; l++)
+        if (q->layers[l].input_channels > c) c = q->layers[l].input_channels;
+    return c * q->height * q->width;
+}
+
+size_t cnn_q8_work_size(const cnn_q8_t *q) {
+    size_t stride = 0;
+    if (!q) return 0;
+    for (size_t l = 0; l < q->num_layers; l++)
+        if (q->layers[l].map.stride > stride) stride = q->layers[l].map.stride;
+    return 2 * cnn_q8_map_size(q) + CNN_Q8_BLOCK * stride;
+}
+
+int cnn_q8_forward(const cnn_q8_t *q, const double *input, double *output, void *work) {
+    const size_t HW = q ? q->height * q->width : 0;
+    size_t maps, bytes;
+    uint8_t *a, *b, *panel, *own = NULL;
+    if (!q || q->num_layers == 0 || HW == 0 || !input || !output) return -1;
+    maps = cnn_q8_map_size(q);
+    bytes = cnn_q8_work_size(q);
+    if (!work) work = own = malloc(bytes);
+    if (!work) return -1;
+    a = work;
+    b = a + maps;
+    panel = b + maps;
+    /* The kernels are zero past each row, this only defines the padding */
+    memset(panel, 0, bytes - 2 * maps);
+    ai_u8_quantize(input, q->layers[0].input_channels * HW, q->inputs[0], a);
+    for (size_t l = 0; l < q->num_layers; l++) {
+        const cnn_q8_layer_t *ly = &q->layers[l];
+        const int last = l + 1 == q->num_layers;
+        uint8_t *t;
+        for (size_t p0 = 0; p0 < HW; p0 += CNN_Q8_BLOCK) {
+            const size_t np = HW - p0 < CNN_Q8_BLOCK ? HW - p0 : CNN_Q8_BLOCK;
+            cnn_q8_patches(a, ly->input_channels, q->height, q->width, ly->kernel_size, (uint8_t)q->inputs[l].zero, p0, np,
+                           ly->map.stride, panel);
+            if (last)
+                ai_i8_linear_forward(&ly->map, panel, np, q->inputs[l], AI_I8_LINEAR, q->inputs[l], NULL, 0, output + p0, HW);
+            else
+                ai_i8_linear_forward(&ly->map, panel, np, q->inputs[l], AI_I8_TANH, q->inputs[l + 1], b + p0, 0, NULL, HW);
+        }
+        t = a;
+        a = b;
+        b = t;
+    }
+    free(own);
+    return 0;
+}
+
+/* -------------------------------
+   Files
+   ------------------------------- */
+
+int cnn_save(const cnn_t *cnn, const char *filename) {
+    uint64_t *meta;
+    ai_blob_t *blobs;
+    size_t L;
+    int rc;
+    if (!cnn || !filename || cnn->num_layers == 0) return -1;
+    L = cnn->num_layers;
+    meta = malloc((4 + 3 * L) * sizeof(uint64_t));
+    blobs = calloc(2 * L, sizeof(ai_blob_t));
+    if (!meta || !blobs) {
+        free(meta);
+        free(blobs);
+        return -1;
+    }
+    meta[0] = (uint64_t)cnn->precision;
+    meta[1] = L;
+    meta[2] = cnn->height;
+    meta[3] = cnn->width;
+    for (size_t l = 0; l < L; l++) {
+        const cnn_layer_t *ly = &cnn->layers[l];
+        const ai_dtype_t dtype = ly->kernels ? AI_DTYPE_F64 : AI_DTYPE_F32;
+        ai_blob_t *k = &blobs[2 * l], *b = &blobs[2 * l + 1];
+        meta[4 + 3 * l] = ly->input_channels;
+        meta[5 + 3 * l] = ly->output_channels;
+        meta[6 + 3 * l] = ly->kernel_size;
+        k->dtype = b->dtype = dtype;
+        k->rank = 4;
+        k->shape[0] = ly->output_channels;
+        k->shape[1] = ly->input_channels;
+        k->shape[2] = k->shape[3] = ly->kernel_size;
+        k->data = ly->kernels ? (const void *)ly->kernels : (const void *)ly->kernels_f;
+        b->rank = 1;
+        b->shape[0] = ly->output_channels;
+        b->data = ly->biases ? (const void *)ly->biases : (const void *)ly->biases_f;
+    }
+    rc = ai_model_write(filename, CNN_MAGIC, CNN_VERSION, meta, 4 + 3 * L, blobs, 2 * L);
+    free(meta);
+    free(blobs);
+    return rc;
+}
+
+/* The parameters are bound to the mapped tensors, which the model then owns. */
+static cnn_t *cnn_load_mapped(ai_model_t *file) {
+    const uint64_t *meta = file->meta;
+    size_t *shape = NULL;
+    cnn_t *cnn = NULL;
+    size_t L = 0;
+    int ok;
+    ok = file->version == CNN_VERSION && file->n_meta >= 4 && meta[0] <= AI_PRECISION_BF16 && meta[1] > 0 && meta[1] < 4096
+         && file->n_meta == 4 + 3 * meta[1] && file->count == 2 * meta[1];
+    if (ok) {
+        L = (size_t)meta[1];
+        shape = malloc(3 * L * sizeof(size_t));
+        ok = shape != NULL;
+    }
+    for (size_t l = 0; ok && l < L; l++) {
+        const uint64_t *sh = meta + 4 + 3 * l;
+        ok = sh[0] && sh[1] && sh[2] && sh[0] < ((uint64_t)1 << 20) && sh[1] < ((uint64_t)1 << 20) && sh[2] < 1024;
+        shape[l] = (size_t)sh[0];
+        shape[L + l] = (size_t)sh[1];
+        shape[2 * L + l] = (size_t)sh[2];
+    }
+    if (ok) {
+        cnn = cnn_shell(shape, shape + L, shape + 2 * L, L, (ai_precision_t)meta[0], 0);
+        ok = cnn != NULL;
+    }
+    if (cnn) cnn->file = file;
+    else ai_model_close(file);
+    for (size_t l = 0; ok && l < L; l++) {
+        cnn_layer_t *ly = &cnn->layers[l];
+        if (cnn->precision == AI_PRECISION_FP64) {
+            ly->kernels = ai_model_tensor(file, 2 * l, AI_DTYPE_F64, cnn_kernel_count(ly));
+            ly->biases = ai_model_tensor(file, 2 * l + 1, AI_DTYPE_F64, ly->output_channels);
+            ok = ly->kernels && ly->biases;
+        } else {
+            ly->kernels_f = ai_model_tensor(file, 2 * l, AI_DTYPE_F32, cnn_kernel_count(ly));
+            ly->biases_f = ai_model_tensor(file, 2 * l + 1, AI_DTYPE_F32, ly->output_channels);
+            ok = ly->kernels_f && ly->biases_f;
+        }
+    }
+    free(shape);
+    if (ok && meta[2] && meta[3]) ok = cnn_set_input(cnn, (size_t)meta[2], (size_t)meta[3]) == 0;
+    if (!ok) {
+        cnn_free(cnn);
+        return NULL;
+    }
+    return cnn;
+}
+
+/* Versions 1 and 2 */
+static cnn_t *cnn_load_stream(const char *filename) {
+    char magic[8];
+    uint32_t version, precision = AI_PRECISION_FP64;
+    uint64_t hdr[3];
+    size_t *shape = NULL, value;
+    cnn_t *cnn = NULL;
+    long body;
+    FILE *fp;
+    int ok;
+    fp = fopen(filename, "rb");
+    if (!fp) return NULL;
+    ok = fread(magic, 1, 8, fp) == 8 && memcmp(magic, CNN_MAGIC, 8) == 0
+         && fread(&version, sizeof version, 1, fp) == 1 && version >= 1 && version <= CNN_STREAM_VERSION;
+    if (ok && version >= 2)
+        ok = fread(&precision, sizeof precision, 1, fp) == 1 && precision <= AI_PRECISION_BF16;
+    ok = ok && fread(hdr, sizeof hdr[0], 3, fp) == 3 && hdr[0] > 0 && hdr[0] < 4096;
+    value = precision == AI_PRECISION_FP64 ? sizeof(double) : sizeof(float);
+    body = ok ? ftell(fp) : -1;
+    if (ok) {
+        shape = malloc(3 * hdr[0] * sizeof(size_t));
+        ok = shape != NULL && body >= 0;
+    }
+    /* Shapes first, then rewind for the weights */
+    for (uint64_t l = 0; ok && l < hdr[0]; l++) {
+        uint64_t sh[3];
+        ok = fread(sh, sizeof sh[0], 3, fp) == 3 && sh[0] && sh[1] && sh[2] && sh[0] < ((uint64_t)1 << 20)
+             && sh[1] < ((uint64_t)1 << 20) && sh[2] < 1024;
+        if (ok) {
+            const size_t n = (size_t)(sh[0] * sh[1] * sh[2] * sh[2] + sh[1]);
+            shape[l] = (size_t)sh[0];
+            shape[hdr[0] + l] = (size_t)sh[1];
+            shape[2 * hdr[0] + l] = (size_t)sh[2];
+            ok = fseek(fp, (long)(n * value), SEEK_CUR) == 0;
+        }
+    }
+    if (ok) {
+        cnn = cnn_shell(shape, shape + hdr[0], shape + 2 * hdr[0], (size_t)hdr[0], (ai_precision_t)precision, 1);
+        ok = cnn != NULL && fseek(fp, body, SEEK_SET) == 0;
+    }
+    for (size_t l = 0; ok && l < cnn->num_layers; l++) {
+        cnn_layer_t *ly = &cnn->layers[l];
+        const size_t n = cnn_kernel_count(ly);
+        ok = fseek(fp, 3 * sizeof(uint64_t), SEEK_CUR) == 0;
+        if (ly->kernels)
+            ok = ok && fread(ly->kernels, sizeof(double), n, fp) == n
+                 && fread(ly->biases, sizeof(double), ly->output_channels, fp) == ly->output_channels;
+        else
+            ok = ok && fread(ly->kernels_f, sizeof(float), n, fp) == n
+                 && fread(ly->biases_f, sizeof(float), ly->output_channels, fp) == ly->output_channels;
+    }
+    fclose(fp);
+    free(shape);
+    if (ok && hdr[1] && hdr[2]) ok = cnn_set_input(cnn, (size_t)hdr[1], (size_t)hdr[2]) == 0;
+    if (!ok) {
+        cnn_free(cnn);
+        return NULL;
+    }
+    return cnn;
+}
+
+cnn_t *cnn_load(const char *filename) {
+    ai_model_t *file;
+    if (!filename) return NULL;
+    file = ai_model_open(filename, CNN_MAGIC);
+    return file ? cnn_load_mapped(file) : cnn_load_stream(filename);
+}
+
+cnn_t *cnn_load_precision(const char *filename, ai_precision_t precision) {
+    cnn_t *cnn = cnn_load(filename);
+    if (cnn && cnn->precision != precision && cnn_set_precision(cnn, precision) != 0) {
+        cnn_free(cnn);
+        return NULL;
+    }
+    return cnn;
+}
+
+/* Quantized form: meta layers, height, width and per layer input
+   channels, output channels, kernel size, then per layer the int8
+   kernels (output x stride), scales, row sums, biases and the input
+   quantization (scale, zero) */
+int cnn_q8_save(const cnn_q8_t *q, const char *filename) {
+    uint64_t *meta;
+    ai_blob_t *blobs;
+    float *quant;
+    size_t L;
+    int rc;
+    if (!q || !filename || q->num_layers == 0) return -1;
+    L = q->num_layers;
+    meta = malloc((3 + 3 * L) * sizeof(uint64_t));
+    blobs = calloc(5 * L, sizeof(ai_blob_t));
+    quant = malloc(2 * L * sizeof(float));
+    if (!meta || !blobs || !quant) {
+        free(meta);
+        free(blobs);
+        free(quant);
+        return -1;
+    }
+    meta[0] = L;
+    meta[1] = q->height;
+    meta[2] = q->width;
+    for (size_t l = 0; l < L; l++) {
+        const cnn_q8_layer_t *ly = &q->layers[l];
+        ai_blob_t *b = &blobs[5 * l];
+        meta[3 + 3 * l] = ly->input_channels;
+        meta[4 + 3 * l] = ly->map.out;
+        meta[5 + 3 * l] = ly->kernel_size;
+        quant[2 * l] = q->inputs[l].scale;
+        quant[2 * l + 1] = (float)q->inputs[l].zero;
+        b[0].dtype = AI_DTYPE_I8;
+        b[0].rank = 2;
+        b[0].shape[0] = ly->map.out;
+        b[0].shape[1] = ly->map.stride;
+        b[0].data = ly->map.w;
+        b[1].dtype = b[3].dtype = AI_DTYPE_F32;
+        b[2].dtype = AI_DTYPE_I32;
+        for (size_t k = 1; k < 4; k++) {
+            b[k].rank = 1;
+            b[k].shape[0] = ly->map.out;
+        }
+        b[1].data = ly->map.scale;
+        b[2].data = ly->map.wsum;
+        b[3].data = ly->map.bias;
+        b[4].dtype = AI_DTYPE_F32;
+        b[4].rank = 1;
+        b[4].shape[0] = 2;
+        b[4].data = &quant[2 * l];
+    }
+    rc = ai_model_write(filename, CNN_Q8_MAGIC, CNN_Q8_VERSION, meta, 3 + 3 * L, blobs, 5 * L);
+    free(meta);
+    free(blobs);
+    free(quant);
+    return rc;
+}
+
+cnn_q8_t *cnn_q8_load(const char *filename) {
+    ai_model_t *file;
+    const uint64_t *meta;
+    cnn_q8_t *q = NULL;
+    int ok;
+    if (!filename) return NULL;
+    file = ai_model_open(filename, CNN_Q8_MAGIC);
+    if (!file) return NULL;
+    meta = file->meta;
+    ok = file->version == CNN_Q8_VERSION && file->n_meta >= 3 && meta[0] > 0 && meta[0] < 4096
+         && file->n_meta == 3 + 3 * meta[0] && file->count == 5 * meta[0] && meta[1] < ((uint64_t)1 << 20)
+         && meta[2] < ((uint64_t)1 << 20);
+    for (uint64_t l = 0; ok && l < meta[0]; l++) {
+        const uint64_t *sh = meta + 3 + 3 * l;
+        ok = sh[0] && sh[1] && sh[2] % 2 == 1 && sh[0] < ((uint64_t)1 << 20) && sh[1] < ((uint64_t)1 << 20) && sh[2] < 1024
+             && (l == 0 || sh[0] == sh[-2]);
+    }
+    if (ok) {
+        q = cnn_q8_shell((size_t)meta[0]);
+        ok = q != NULL;
+    }
+    if (q) q->file = file;
+    else ai_model_close(file);
+    for (size_t l = 0; ok && l < q->num_layers; l++) {
+        const uint64_t *sh = meta + 3 + 3 * l;
+        cnn_q8_layer_t *ly = &q->layers[l];
+        ai_i8_linear_t *lin = &ly->map;
+        const float *quant;
+        ly->input_channels = (size_t)sh[0];
+        ly->kernel_size = (size_t)sh[2];
+        lin->in = ly->input_channels * ly->kernel_size * ly->kernel_size;
+        lin->out = (size_t)sh[1];
+        lin->stride = ai_i8_stride(lin->in);
+        lin->w = ai_model_tensor(file, 5 * l, AI_DTYPE_I8, lin->out * lin->stride);
+        lin->scale = ai_model_tensor(file, 5 * l + 1, AI_DTYPE_F32, lin->out);
+        lin->wsum = ai_model_tensor(file, 5 * l + 2, AI_DTYPE_I32, lin->out);
+        lin->bias = ai_model_tensor(file, 5 * l + 3, AI_DTYPE_F32, lin->out);
+        quant = ai_model_tensor(file, 5 * l + 4, AI_DTYPE_F32, 2);
+        ok = lin->w && lin->scale && lin->wsum && lin->bias && quant && quant[0] > 0 && quant[1] >= 0 && quant[1] <= 255;
+        if (ok) {
+            q->inputs[l].scale = quant[0];
+            q->inputs[l].zero = (int32_t)quant[1];
+        }
+    }
+    if (ok) {
+        q->height = (size_t)meta[1];
+        q->width = (size_t)meta[2];
+    }
+    if (!ok) {
+        cnn_q8_free(q);
+        return NULL;
+    }
+    return q;
+}
@@ -0,0 +1,306 @@
+/* cnn_kernels.h - Precision-generic CNN passes for HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+   ----------------------------------------------------------------------
+   Included by cnn.c once per compute type, with
+     CNN_REAL       double or float
+     CNN_FN(name)   name with the type suffix
+     CNN_GEMM       cblas_dgemm or cblas_sgemm
+     CNN_TANH       tanh or tanhf
+     CNN_K, CNN_B   the layer's kernel and bias arrays of that type
+     CNN_NATIVE     1 when CNN_REAL is double (API buffers used in place)
+   bf16 is only ever set for float.
+*/
+
+typedef struct {
+    CNN_REAL *col;                  /* im2col panel */
+    CNN_REAL *U, *V, *M;            /* Winograd kernels, input tiles, products */
+    CNN_REAL *kq;                   /* bf16 copy of one layer's kernels */
+    int bf16;
+} CNN_FN(cnn_scratch);
+
+/* Scratch of a pass from its plan (tensors CNN_COL to CNN_KQ). */
+static void CNN_FN(cnn_scratch_bind)(const cnn_t *cnn, const ai_plan_t *plan, void *base, CNN_FN(cnn_scratch) *s) {
+    s->col = ai_plan_at(plan, base, CNN_COL);
+    s->U = ai_plan_at(plan, base, CNN_U);
+    s->V = ai_plan_at(plan, base, CNN_V);
+    s->M = ai_plan_at(plan, base, CNN_M);
+    s->kq = ai_plan_at(plan, base, CNN_KQ);
+    s->bf16 = cnn->precision == AI_PRECISION_BF16;
+}
+
+static void CNN_FN(cnn_round)(CNN_REAL *x, size_t n) {
+    for (size_t k = 0; k < n; k++) x[k] = (CNN_REAL)ai_bf16_round((float)x[k]);
+}
+
+/* Kernels as the GEMM sees them: the stored array, or a bf16 copy. */
+static const CNN_REAL *CNN_FN(cnn_kernels)(const cnn_layer_t *ly, CNN_FN(cnn_scratch) *s) {
+    const size_t n = ly->output_channels * ly->input_channels * ly->kernel_size * ly->kernel_size;
+    if (!s->bf16) return CNN_K(ly);
+    memcpy(s->kq, CNN_K(ly), n * sizeof(CNN_REAL));
+    CNN_FN(cnn_round)(s->kq, n);
+    return s->kq;
+}
+
+/* -------------------------------
+   im2col
+   ------------------------------- */
+
+/* Rows y0 .. y0 + rows of the unfolded input, one column per pixel. */
+static void CNN_FN(cnn_im2col)(const CNN_REAL *x, size_t C, size_t H, size_t W, size_t k, size_t y0, size_t rows, CNN_REAL *col) {
+    const long p = (long)k / 2, P = (long)(rows * W);
+    for (size_t c = 0; c < C; c++)
+        for (size_t ky = 0; ky < k; ky++)
+            for (size_t kx = 0; kx < k; kx++) {
+                CNN_REAL *out = col + ((c * k + ky) * k + kx) * (size_t)P;
+                for (size_t r = 0; r < rows; r++) {
+                    const long yy = (long)(y0 + r) + (long)ky - p;
+                    CNN_REAL *o = out + r * W;
+                    if (yy < 0 || yy >= (long)H) {
+                        memset(o, 0, W * sizeof(CNN_REAL));
+                        continue;
+                    }
+                    const CNN_REAL *src = x + (c * H + (size_t)yy) * W;
+                    for (size_t xo = 0; xo < W; xo++) {
+                        const long xx = (long)xo + (long)kx - p;
+                        o[xo] = xx < 0 || xx >= (long)W ? 0 : src[xx];
+                    }
+                }
+            }
+}
+
+/* Adjoint of cnn_im2col: accumulate the panel into dx. */
+static void CNN_FN(cnn_col2im)(const CNN_REAL *col, size_t C, size_t H, size_t W, size_t k, size_t y0, size_t rows, CNN_REAL *dx) {
+    const long p = (long)k / 2, P = (long)(rows * W);
+    for (size_t c = 0; c < C; c++)
+        for (size_t ky = 0; ky < k; ky++)
+            for (size_t kx = 0; kx < k; kx++) {
+                const CNN_REAL *in = col + ((c * k + ky) * k + kx) * (size_t)P;
+                for (size_t r = 0; r < rows; r++) {
+                    const long yy = (long)(y0 + r) + (long)ky - p;
+                    if (yy < 0 || yy >= (long)H) continue;
+                    CNN_REAL *dst = dx + (c * H + (size_t)yy) * W;
+                    const CNN_REAL *i = in + r * W;
+                    for (size_t xo = 0; xo < W; xo++) {
+                        const long xx = (long)xo + (long)kx - p;
+                        if (xx >= 0 && xx < (long)W) dst[xx] += i[xo];
+                    }
+                }
+            }
+}
+
+static void CNN_FN(cnn_conv_gemm)(const cnn_t *cnn, const cnn_layer_t *ly, const CNN_REAL *x, CNN_REAL *y, CNN_FN(cnn_scratch) *s) {
+    const size_t H = cnn->height, W = cnn->width, HW = H * W, rb = cnn_block_rows(cnn);
+    const size_t ck = ly->input_channels * ly->kernel_size * ly->kernel_size;
+    const CNN_REAL *K = CNN_FN(cnn_kernels)(ly, s);
+    for (size_t y0 = 0; y0 < H; y0 += rb) {
+        const size_t rows = H - y0 < rb ? H - y0 : rb, P = rows * W;
+        CNN_FN(cnn_im2col)(x, ly->input_channels, H, W, ly->kernel_size, y0, rows, s->col);
+        CNN_GEMM(CblasRowMajor, CblasNoTrans, CblasNoTrans, (int)ly->output_channels, (int)P, (int)ck,
+                 1, K, (int)ck, s->col, (int)P, 0, y + y0 * W, (int)HW);
+    }
+}
+
+/* -------------------------------
+   Winograd F(2x2,3x3)
+   ------------------------------- */
+
+/* U[xi][o][i] = (G g G^T)[xi] */
+static void CNN_FN(cnn_winograd_kernels)(const cnn_layer_t *ly, CNN_REAL *U) {
+    const size_t ci = ly->input_channels, co = ly->output_channels, cio = ci * co;
+    for (size_t o = 0; o < co; o++)
+        for (size_t i = 0; i < ci; i++) {
+            const CNN_REAL *g = CNN_K(ly) + (o * ci + i) * 9;
+            CNN_REAL t[4][3], u[4][4];
+            for (int c = 0; c < 3; c++) {
+                t[0][c] = g[c];
+                t[1][c] = (CNN_REAL)0.5 * (g[c] + g[3 + c] + g[6 + c]);
+                t[2][c] = (CNN_REAL)0.5 * (g[c] - g[3 + c] + g[6 + c]);
+                t[3][c] = g[6 + c];
+            }
+            for (int r = 0; r < 4; r++) {
+                u[r][0] = t[r][0];
+                u[r][1] = (CNN_REAL)0.5 * (t[r][0] + t[r][1] + t[r][2]);
+                u[r][2] = (CNN_REAL)0.5 * (t[r][0] - t[r][1] + t[r][2]);
+                u[r][3] = t[r][2];
+            }
+            for (int xi = 0; xi < 16; xi++) U[xi * cio + o * ci + i] = u[xi / 4][xi % 4];
+        }
+}
+
+static void CNN_FN(cnn_conv_winograd)(const cnn_t *cnn, const cnn_layer_t *ly, const CNN_REAL *x, CNN_REAL *y, CNN_FN(cnn_scratch) *s) {
+    const size_t H = cnn->height, W = cnn->width, tx = (W + 1) / 2, T = ((H + 1) / 2) * tx;
+    const size_t ci = ly->input_channels, co = ly->output_channels;
+    CNN_FN(cnn_winograd_kernels)(ly, s->U);
+    if (s->bf16) CNN_FN(cnn_round)(s->U, 16 * ci * co);
+    for (size_t t0 = 0; t0 < T; t0 += CNN_TILE_BLOCK) {
+        const size_t tb = T - t0 < CNN_TILE_BLOCK ? T - t0 : CNN_TILE_BLOCK;
+        /* V[xi][i][t] = (B^T d B)[xi] */
+        for (size_t i = 0; i < ci; i++)
+            for (size_t t = 0; t < tb; t++) {
+                const long by = 2 * (long)((t0 + t) / tx) - 1, bx = 2 * (long)((t0 + t) % tx) - 1;
+                CNN_REAL d[4][4], e[4][4];
+                for (int r = 0; r < 4; r++)
+                    for (int c = 0; c < 4; c++) {
+                        const long yy = by + r, xx = bx + c;
+                        d[r][c] = yy < 0 || yy >= (long)H || xx < 0 || xx >= (long)W ? 0 : x[(i * H + (size_t)yy) * W + (size_t)xx];
+                    }
+                for (int c = 0; c < 4; c++) {
+                    e[0][c] = d[0][c] - d[2][c];
+                    e[1][c] = d[1][c] + d[2][c];
+                    e[2][c] = d[2][c] - d[1][c];
+                    e[3][c] = d[1][c] - d[3][c];
+                }
+                for (int r = 0; r < 4; r++) {
+                    CNN_REAL *v = s->V + (size_t)(r * 4) * ci * tb + i * tb + t;
+                    v[0] = e[r][0] - e[r][2];
+                    v[ci * tb] = e[r][1] + e[r][2];
+                    v[2 * ci * tb] = e[r][2] - e[r][1];
+                    v[3 * ci * tb] = e[r][1] - e[r][3];
+                }
+            }
+        if (s->bf16) CNN_FN(cnn_round)(s->V, 16 * ci * tb);
+        for (size_t xi = 0; xi < 16; xi++)
+            CNN_GEMM(CblasRowMajor, CblasNoTrans, CblasNoTrans, (int)co, (int)tb, (int)ci,
+                     1, s->U + xi * co * ci, (int)ci, s->V + xi * ci * tb, (int)tb, 0, s->M + xi * co * tb, (int)tb);
+        /* Y tile = A^T M A */
+        for (size_t o = 0; o < co; o++)
+            for (size_t t = 0; t < tb; t++) {
+                const size_t oy = 2 * ((t0 + t) / tx), ox = 2 * ((t0 + t) % tx);
+                const CNN_REAL *m = s->M + o * tb + t;
+                const size_t step = co * tb;
+                CNN_REAL a[2][4];
+                for (int c = 0; c < 4; c++) {
+                    a[0][c] = m[c * step] + m[(4 + c) * step] + m[(8 + c) * step];
+                    a[1][c] = m[(4 + c) * step] - m[(8 + c) * step] - m[(12 + c) * step];
+                }
+                for (int r = 0; r < 2; r++) {
+                    if (oy + (size_t)r >= H) break;
+                    CNN_REAL *row = y + (o * H + oy + (size_t)r) * W + ox;
+                    row[0] = a[r][0] + a[r][1] + a[r][2];
+                    if (ox + 1 < W) row[1] = a[r][1] - a[r][2] - a[r][3];
+                }
+            }
+    }
+}
+
+/* -------------------------------
+   Passes
+   ------------------------------- */
+
+static void CNN_FN(cnn_layer_forward)(const cnn_t *cnn, const cnn_layer_t *ly, const CNN_REAL *x, CNN_REAL *y, int hidden, CNN_FN(cnn_scratch) *s) {
+    const size_t HW = cnn->height * cnn->width;
+    if (cnn->winograd && ly->kernel_size == 3)
+        CNN_FN(cnn_conv_winograd)(cnn, ly, x, y, s);
+    else
+        CNN_FN(cnn_conv_gemm)(cnn, ly, x, y, s);
+    for (size_t o = 0; o < ly->output_channels; o++) {
+        CNN_REAL *yo = y + o * HW;
+        const CNN_REAL b = CNN_B(ly)[o];
+        if (hidden)
+            for (size_t p = 0; p < HW; p++) yo[p] = CNN_TANH(yo[p] + b);
+        else
+            for (size_t p = 0; p < HW; p++) yo[p] += b;
+    }
+    if (hidden && s->bf16) CNN_FN(cnn_round)(y, ly->output_channels * HW);
+}
+
+/* The input in the compute type: in place for double, else converted into buf. */
+static const CNN_REAL *CNN_FN(cnn_input)(const cnn_t *cnn, const double *input, CNN_REAL *buf, int bf16) {
+    const size_t n = cnn->layers[0].input_channels * cnn->height * cnn->width;
+#if CNN_NATIVE
+    (void)n;
+    (void)buf;
+    (void)bf16;
+    return input;
+#else
+    for (size_t k = 0; k < n; k++) buf[k] = (CNN_REAL)input[k];
+    if (bf16) CNN_FN(cnn_round)(buf, n);
+    return buf;
+#endif
+}
+
+static void CNN_FN(cnn_forward)(const cnn_t *cnn, const ai_plan_t *plan, void *base, const double *input, double *output) {
+    const size_t L = cnn->num_layers;
+    CNN_FN(cnn_scratch) s;
+    CNN_REAL *buf[2] = { ai_plan_at(plan, base, CNN_PING), ai_plan_at(plan, base, CNN_PONG) };
+    const CNN_REAL *x;
+    CNN_REAL *y = NULL;
+    CNN_FN(cnn_scratch_bind)(cnn, plan, base, &s);
+    x = CNN_FN(cnn_input)(cnn, input, ai_plan_at(plan, base, CNN_XIN), s.bf16);
+    for (size_t l = 0; l < L; l++) {
+        y = buf[l & 1];
+#if CNN_NATIVE
+        if (l + 1 == L) y = output;
+#endif
+        CNN_FN(cnn_layer_forward)(cnn, &cnn->layers[l], x, y, l + 1 < L, &s);
+        x = y;
+    }
+#if !CNN_NATIVE
+    for (size_t k = 0; k < cnn->layers[L - 1].output_channels * cnn->height * cnn->width; k++) output[k] = (double)y[k];
+#endif
+}
+
+static void CNN_FN(cnn_train)(cnn_t *cnn, const ai_plan_t *plan, void *base, const double *input, const double *target, double learning_rate) {
+    const size_t L = cnn->num_layers, HW = cnn->height * cnn->width;
+    CNN_FN(cnn_scratch) s;
+    CNN_REAL **acts = ai_plan_at(plan, base, CNN_ACTS);
+    CNN_REAL *delta = ai_plan_at(plan, base, CNN_DELTA), *below = ai_plan_at(plan, base, CNN_BELOW);
+    CNN_REAL *grad = ai_plan_at(plan, base, CNN_GRAD);
+    const CNN_REAL *in;
+    CNN_FN(cnn_scratch_bind)(cnn, plan, base, &s);
+    for (size_t l = 0; l < L; l++) acts[l] = ai_plan_at(plan, base, CNN_LAYERS + l);
+    in = CNN_FN(cnn_input)(cnn, input, ai_plan_at(plan, base, CNN_XIN), s.bf16);
+    for (size_t l = 0; l < L; l++)
+        CNN_FN(cnn_layer_forward)(cnn, &cnn->layers[l], l ? acts[l - 1] : in, acts[l], l + 1 < L, &s);
+
+    for (size_t k = 0; k < cnn->layers[L - 1].output_channels * HW; k++) delta[k] = (CNN_REAL)((double)acts[L - 1][k] - target[k]);
+    for (size_t l = L; l-- > 0;) {
+        cnn_layer_t *ly = &cnn->layers[l];
+        const size_t co = ly->output_channels, ci = ly->input_channels, ck = ci * ly->kernel_size * ly->kernel_size;
+        const size_t H = cnn->height, W = cnn->width, rb = cnn_block_rows(cnn);
+        const CNN_REAL *x = l ? acts[l - 1] : in;
+        const CNN_REAL *K = l ? CNN_FN(cnn_kernels)(ly, &s) : NULL;
+        CNN_REAL *tmp;
+
+        if (s.bf16) CNN_FN(cnn_round)(delta, co * HW);
+        if (l > 0) memset(below, 0, ci * HW * sizeof(CNN_REAL));
+        for (size_t y0 = 0; y0 < H; y0 += rb) {
+            const size_t rows = H - y0 < rb ? H - y0 : rb, P = rows * W;
+            CNN_FN(cnn_im2col)(x, ci, H, W, ly->kernel_size, y0, rows, s.col);
+            CNN_GEMM(CblasRowMajor, CblasNoTrans, CblasTrans, (int)co, (int)ck, (int)P,
+                     1, delta + y0 * W, (int)HW, s.col, (int)P, y0 ? 1 : 0, grad, (int)ck);
+            if (l > 0) {
+                CNN_GEMM(CblasRowMajor, CblasTrans, CblasNoTrans, (int)ck, (int)P, (int)co,
+                         1, K, (int)ck, delta + y0 * W, (int)HW, 0, s.col, (int)P);
+                CNN_FN(cnn_col2im)(s.col, ci, H, W, ly->kernel_size, y0, rows, below);
+            }
+        }
+        if (l > 0)
+            for (size_t k = 0; k < ci * HW; k++) below[k] *= 1 - x[k] * x[k];
+        for (size_t k = 0; k < co * ck; k++) CNN_K(ly)[k] -= (CNN_REAL)(learning_rate * grad[k]);
+        for (size_t o = 0; o < co; o++) {
+            double g = 0.0;
+            for (size_t p = 0; p < HW; p++) g += delta[o * HW + p];
+            CNN_B(ly)[o] -= (CNN_REAL)(learning_rate * g);
+        }
+        tmp = delta;
+        delta = below;
+        below = tmp;
+    }
+}
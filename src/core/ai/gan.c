@@ -0,0 +1,424 @@
+/* gan.c - Generative Adversarial Network for HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+   ----------------------------------------------------------------------
+   A training step has two phases, each a parallel pass over n_threads
+   shards of the batch followed by one optimizer step:
+   - discriminator: the shard's real rows and as many generated ones go
+     through D as one block; the error at the logits is sigmoid(z) - y
+     (y = 1 real, 0 generated) and the backward adds the D gradient to
+     the shard's buffer
+   - generator: fresh samples through G and D; the error sigmoid(z) - 1
+     of -log D(G(z)) is taken back through D (error only, D is not
+     updated) and then through G, into the shard's G buffer
+   Each buffer ends with the shard's loss sum and example count. The
+   buffers are summed pairwise in log2(n_threads) rounds (shard i takes
+   i + s for s = 1, 2, 4, ...), so the order of the additions depends on
+   n_threads only and not on the threads actually running; shard 0 then
+   holds the batch sum, which the reduce hook extends across peers.
+
+   Noise is counter based: value k of the stream is a function of seed
+   + k alone, so the samples of a batch do not depend on the sharding.
+
+   File layout: a model container (ai_model.h), "HOLOSGAN" version 1:
+   meta seed, generator layers and sizes, discriminator layers and
+   sizes, then the weights and biases of the generator layers and of the
+   discriminator layers, as doubles. They are copied into the MLPs, which
+   training rewrites anyway.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "core/ai/gan.h"
+
+#define GAN_MAGIC "HOLOSGAN"
+#define GAN_VERSION 1u
+
+/* Tensors of one shard */
+enum { GAN_NOISE, GAN_GWORK, GAN_DWORK, GAN_XIN, GAN_DLOGIT, GAN_DX, GAN_GRAD_G, GAN_GRAD_D, GAN_SHARD };
+
+typedef struct {
+    double *noise, *gwork, *dwork, *xin, *dlogit, *dx, *grad_g, *grad_d;
+} gan_shard;
+
+static int gan_valid(const mlp_t *g, const mlp_t *d) {
+    return g && d && g->num_layers && d->num_layers && g->precision == AI_PRECISION_FP64 && d->precision == AI_PRECISION_FP64
+           && g->layers[g->num_layers - 1].output_size == d->layers[0].input_size && d->layers[d->num_layers - 1].output_size == 1;
+}
+
+gan_t *gan_alloc(void *generator, void *discriminator) {
+    gan_t *gan;
+    if (!gan_valid(generator, discriminator)) return NULL;
+    gan = calloc(1, sizeof(*gan));
+    if (!gan) return NULL;
+    gan->generator = generator;
+    gan->discriminator = discriminator;
+    gan->seed = 0x484f4c4f5347414eULL;
+    return gan;
+}
+
+void gan_free(gan_t *gan) {
+    if (!gan) return;
+    mlp_free(gan->generator);
+    mlp_free(gan->discriminator);
+    ai_exec_plan_free(gan->plan);
+    free(gan);
+}
+
+/* -------------------------------
+   Noise
+   ------------------------------- */
+
+static uint64_t gan_mix(uint64_t z) {
+    z += 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/* Standard normal values first .. first + n - 1 of the stream (Box-Muller). */
+static void gan_noise(uint64_t first, size_t n, double *out) {
+    for (size_t k = 0; k < n; k++) {
+        const uint64_t key = gan_mix(first + k);
+        const double u1 = ((double)(key >> 11) + 0.5) * 0x1.0p-53;
+        const double u2 = (double)(gan_mix(key) >> 11) * 0x1.0p-53;
+        out[k] = sqrt(-2.0 * log(u1)) * cos(6.283185307179586 * u2);
+    }
+}
+
+/* -------------------------------
+   Plans
+   ------------------------------- */
+
+static int gan_threads(int n_threads) {
+    if (n_threads < 0) {
+#ifdef _OPENMP
+        return omp_get_max_threads();
+#else
+        return 1;
+#endif
+    }
+    return n_threads > 0 ? n_threads : 1;
+}
+
+/* Shards of a batch and their rows */
+static int gan_shards(const gan_t *gan, size_t batch) {
+    const int nt = gan_threads(gan->n_threads);
+    return (size_t)nt < batch ? nt : (int)batch;
+}
+
+static size_t gan_shard_rows(size_t batch, int shards) {
+    return (batch + (size_t)shards - 1) / (size_t)shards;
+}
+
+/* batch is the rows of one shard and threads the shards; every
+   tensor lives through the whole step. No forward tensors: generation
+   is the generator's own forward. */
+static int gan_layout(const void *model, ai_pass_t pass, size_t batch, size_t length, int threads, ai_plan_t *plan) {
+    const gan_t *gan = model;
+    const mlp_t *g = gan->generator, *d = gan->discriminator;
+    const size_t D = sizeof(double), nz = g->layers[0].input_size, nx = d->layers[0].input_size;
+    int rc = 0;
+    (void)length;
+    if (pass != AI_PASS_TRAIN) return 0;
+    for (int t = 0; t < threads && rc == 0; t++)
+        rc = ai_plan_add(plan, batch * nz * D, 0, 0) || ai_plan_add(plan, mlp_work_count(g, batch) * D, 0, 0)
+             || ai_plan_add(plan, mlp_work_count(d, 2 * batch) * D, 0, 0) || ai_plan_add(plan, 2 * batch * nx * D, 0, 0)
+             || ai_plan_add(plan, 2 * batch * D, 0, 0) || ai_plan_add(plan, batch * nx * D, 0, 0)
+             || ai_plan_add(plan, (mlp_param_count(g) + 2) * D, 0, 0) || ai_plan_add(plan, (mlp_param_count(d) + 2) * D, 0, 0);
+    return rc ? -1 : 0;
+}
+
+static void gan_shard_bind(const ai_plan_t *plan, void *base, int t, gan_shard *w) {
+    double **slot[GAN_SHARD] = { &w->noise, &w->gwork, &w->dwork, &w->xin, &w->dlogit, &w->dx, &w->grad_g, &w->grad_d };
+    for (size_t k = 0; k < GAN_SHARD; k++) *slot[k] = ai_plan_at(plan, base, (size_t)t * GAN_SHARD + k);
+}
+
+int gan_plan(gan_t *gan, ai_arena_t *arena, size_t batch) {
+    int shards;
+    if (!gan || batch == 0) return -1;
+    shards = gan_shards(gan, batch);
+    return ai_exec_plan(&gan->plan, arena, gan_layout, gan, gan_shard_rows(batch, shards), 1, shards);
+}
+
+/* -------------------------------
+   Training
+   ------------------------------- */
+
+static double gan_sigmoid(double z) {
+    return z >= 0 ? 1.0 / (1.0 + exp(-z)) : exp(z) / (1.0 + exp(z));
+}
+
+/* log(1 + e^z) */
+static double gan_softplus(double z) {
+    return (z > 0 ? z : 0) + log1p(exp(-fabs(z)));
+}
+
+/* Discriminator gradient of rows r0 .. r0 + m - 1, noise from first. */
+static void gan_d_shard(const gan_t *gan, const double *real, size_t r0, size_t m, uint64_t first, gan_shard *w) {
+    const mlp_t *g = gan->generator, *d = gan->discriminator;
+    const size_t nz = g->layers[0].input_size, nx = d->layers[0].input_size, n = mlp_param_count(d);
+    const double *fake, *logit;
+    double loss = 0.0;
+    memset(w->grad_d, 0, (n + 2) * sizeof(double));
+    if (m == 0) return;
+    gan_noise(first + r0 * nz, m * nz, w->noise);
+    fake = mlp_forward_work(g, w->noise, m, w->gwork);
+    memcpy(w->xin, real + r0 * nx, m * nx * sizeof(double));
+    memcpy(w->xin + m * nx, fake, m * nx * sizeof(double));
+    logit = mlp_forward_work(d, w->xin, 2 * m, w->dwork);
+    for (size_t i = 0; i < 2 * m; i++) {
+        const double y = i < m ? 1.0 : 0.0;
+        w->dlogit[i] = gan_sigmoid(logit[i]) - y;
+        loss += gan_softplus(i < m ? -logit[i] : logit[i]);
+    }
+    mlp_backward_work(d, w->xin, 2 * m, w->dlogit, w->grad_d, NULL, w->dwork);
+    w->grad_d[n] = loss;
+    w->grad_d[n + 1] = (double)m;
+}
+
+/* Generator gradient of m fresh samples, rows r0 .. of the stream at first. */
+static void gan_g_shard(const gan_t *gan, size_t r0, size_t m, uint64_t first, gan_shard *w) {
+    const mlp_t *g = gan->generator, *d = gan->discriminator;
+    const size_t nz = g->layers[0].input_size, n = mlp_param_count(g);
+    const double *fake, *logit;
+    double loss = 0.0;
+    memset(w->grad_g, 0, (n + 2) * sizeof(double));
+    if (m == 0) return;
+    gan_noise(first + r0 * nz, m * nz, w->noise);
+    fake = mlp_forward_work(g, w->noise, m, w->gwork);
+    logit = mlp_forward_work(d, fake, m, w->dwork);
+    for (size_t i = 0; i < m; i++) {
+        w->dlogit[i] = gan_sigmoid(logit[i]) - 1.0;
+        loss += gan_softplus(-logit[i]);
+    }
+    mlp_backward_work(d, fake, m, w->dlogit, NULL, w->dx, w->dwork);
+    mlp_backward_work(g, w->noise, m, w->dx, w->grad_g, NULL, w->gwork);
+    w->grad_g[n] = loss;
+    w->grad_g[n + 1] = (double)m;
+}
+
+/* Shard 0's slot += every other shard's, pairwise in rounds. Called by
+   every thread of the team. */
+static void gan_tree(const ai_plan_t *plan, void *base, int shards, size_t slot, size_t n) {
+    for (int s = 1; s < shards; s *= 2) {
+#pragma omp for schedule(static)
+        for (int i = 0; i < shards; i += 2 * s) {
+            if (i + s < shards) {
+                double *dst = ai_plan_at(plan, base, (size_t)i * GAN_SHARD + slot);
+                const double *src = ai_plan_at(plan, base, (size_t)(i + s) * GAN_SHARD + slot);
+                for (size_t k = 0; k < n; k++) dst[k] += src[k];
+            }
+        }
+    }
+}
+
+/* Global sum, mean gradient and step; loss receives the mean loss. */
+static int gan_step(gan_t *gan, mlp_t *net, double *grad, double learning_rate, double *loss) {
+    const size_t n = mlp_param_count(net);
+    if (gan->reduce && gan->reduce(gan->reduce_ctx, grad, n + 2) != 0) return -1;
+    if (!(grad[n + 1] > 0)) return -1;
+    for (size_t k = 0; k < n; k++) grad[k] /= grad[n + 1];
+    *loss = grad[n] / grad[n + 1];
+    return mlp_apply_gradient(net, grad, learning_rate);
+}
+
+int gan_train(gan_t *gan, const double *real_data, size_t batch_size, double learning_rate) {
+    const ai_plan_t *plan;
+    ai_plan_t local;
+    const mlp_t *g;
+    void *base;
+    uint64_t first;
+    size_t rows;
+    int shards, rc;
+    if (!gan || !real_data || batch_size == 0) return -1;
+    g = gan->generator;
+    shards = gan_shards(gan, batch_size);
+    rows = gan_shard_rows(batch_size, shards);
+    if (!ai_exec_covers(gan->plan, rows, 1, shards) && ai_exec_grow(&gan->plan, gan_layout, gan, rows, 1, shards) != 0) return -1;
+    base = ai_exec_begin(gan->plan, gan_layout, gan, AI_PASS_TRAIN, rows, 1, shards, &local, &plan);
+    if (!base) return -1;
+    first = gan->seed;
+    gan->seed += 2 * batch_size * g->layers[0].input_size;
+
+#pragma omp parallel num_threads(shards) if(shards > 1)
+    {
+#pragma omp for schedule(static, 1)
+        for (int t = 0; t < shards; t++) {
+            const size_t r0 = (size_t)t * rows, m = r0 < batch_size ? (batch_size - r0 < rows ? batch_size - r0 : rows) : 0;
+            gan_shard w;
+            gan_shard_bind(plan, base, t, &w);
+            gan_d_shard(gan, real_data, r0, m, first, &w);
+        }
+        gan_tree(plan, base, shards, GAN_GRAD_D, mlp_param_count(gan->discriminator) + 2);
+    }
+    rc = gan_step(gan, gan->discriminator, ai_plan_at(plan, base, GAN_GRAD_D), learning_rate, &gan->d_loss);
+
+    first += batch_size * g->layers[0].input_size;
+    if (rc == 0) {
+#pragma omp parallel num_threads(shards) if(shards > 1)
+        {
+#pragma omp for schedule(static, 1)
+            for (int t = 0; t < shards; t++) {
+                const size_t r0 = (size_t)t * rows, m = r0 < batch_size ? (batch_size - r0 < rows ? batch_size - r0 : rows) : 0;
+                gan_shard w;
+                gan_shard_bind(plan, base, t, &w);
+                gan_g_shard(gan, r0, m, first, &w);
+            }
+            gan_tree(plan, base, shards, GAN_GRAD_G, mlp_param_count(gan->generator) + 2);
+        }
+        rc = gan_step(gan, gan->generator, ai_plan_at(plan, base, GAN_GRAD_G), learning_rate, &gan->g_loss);
+    }
+    ai_exec_end(base, &local, plan);
+    return rc;
+}
+
+/* -------------------------------
+   Generation
+   ------------------------------- */
+
+int gan_generate_batch(const gan_t *gan, const double *noise, size_t batch, double *outputs) {
+    if (!gan || !noise || !outputs) return -1;
+    return mlp_forward_batch(gan->generator, noise, batch, outputs);
+}
+
+void gan_generate(gan_t *gan, double *output) {
+    const mlp_t *g;
+    double *noise;
+    if (!gan || !output) return;
+    g = gan->generator;
+    noise = malloc(g->layers[0].input_size * sizeof(double));
+    if (!noise) return;
+    gan_noise(gan->seed, g->layers[0].input_size, noise);
+    gan->seed += g->layers[0].input_size;
+    mlp_forward(g, noise, output);
+    free(noise);
+}
+
+/* -------------------------------
+   Files
+   ------------------------------- */
+
+int gan_save(const gan_t *gan, const char *filename) {
+    const mlp_t *net[2];
+    uint64_t *meta;
+    ai_blob_t *blobs;
+    size_t n_meta, count, m = 0, b = 0;
+    int rc;
+    if (!gan || !filename) return -1;
+    net[0] = gan->generator;
+    net[1] = gan->discriminator;
+    n_meta = 1 + (net[0]->num_layers + 2) + (net[1]->num_layers + 2);
+    count = 2 * (net[0]->num_layers + net[1]->num_layers);
+    meta = malloc(n_meta * sizeof(uint64_t));
+    blobs = calloc(count, sizeof(ai_blob_t));
+    if (!meta || !blobs) {
+        free(meta);
+        free(blobs);
+        return -1;
+    }
+    meta[m++] = gan->seed;
+    for (int k = 0; k < 2; k++) {
+        meta[m++] = net[k]->num_layers;
+        meta[m++] = net[k]->layers[0].input_size;
+        for (size_t l = 0; l < net[k]->num_layers; l++) {
+            const mlp_layer_t *ly = &net[k]->layers[l];
+            meta[m++] = ly->output_size;
+            blobs[b].dtype = AI_DTYPE_F64;
+            blobs[b].rank = 2;
+            blobs[b].shape[0] = ly->output_size;
+            blobs[b].shape[1] = ly->input_size;
+            blobs[b++].data = ly->weights;
+            blobs[b].dtype = AI_DTYPE_F64;
+            blobs[b].rank = 1;
+            blobs[b].shape[0] = ly->output_size;
+            blobs[b++].data = ly->biases;
+        }
+    }
+    rc = ai_model_write(filename, GAN_MAGIC, GAN_VERSION, meta, n_meta, blobs, count);
+    free(meta);
+    free(blobs);
+    return rc;
+}
+
+/* One of the two networks: its meta from *m, its tensors from *b. */
+static mlp_t *gan_load_net(const ai_model_t *file, size_t *m, size_t *b) {
+    const uint64_t *meta = file->meta;
+    size_t layers, *sizes;
+    mlp_t *net = NULL;
+    int ok;
+    ok = *m < file->n_meta && meta[*m] > 0 && meta[*m] < 4096 && file->n_meta - *m - 1 > meta[*m];
+    if (!ok) return NULL;
+    layers = (size_t)meta[(*m)++];
+    sizes = malloc((layers + 1) * sizeof(size_t));
+    ok = sizes != NULL;
+    for (size_t l = 0; ok && l <= layers; l++) {
+        ok = meta[*m + l] > 0 && meta[*m + l] < ((uint64_t)1 << 32);
+        sizes[l] = (size_t)meta[*m + l];
+    }
+    *m += layers + 1;
+    if (ok) {
+        net = mlp_alloc(sizes, layers);
+        ok = net != NULL;
+    }
+    for (size_t l = 0; ok && l < layers; l++) {
+        mlp_layer_t *ly = &net->layers[l];
+        const double *w = ai_model_tensor(file, (*b)++, AI_DTYPE_F64, ly->input_size * ly->output_size);
+        const double *bias = ai_model_tensor(file, (*b)++, AI_DTYPE_F64, ly->output_size);
+        ok = w && bias;
+        if (ok) {
+            memcpy(ly->weights, w, ly->input_size * ly->output_size * sizeof(double));
+            memcpy(ly->biases, bias, ly->output_size * sizeof(double));
+        }
+    }
+    free(sizes);
+    if (!ok) {
+        mlp_free(net);
+        return NULL;
+    }
+    return net;
+}
+
+gan_t *gan_load(const char *filename) {
+    ai_model_t *file;
+    mlp_t *g = NULL, *d = NULL;
+    gan_t *gan = NULL;
+    size_t m = 1, b = 0;
+    if (!filename) return NULL;
+    file = ai_model_open(filename, GAN_MAGIC);
+    if (!file) return NULL;
+    if (file->version == GAN_VERSION && file->n_meta >= 1) {
+        g = gan_load_net(file, &m, &b);
+        d = g ? gan_load_net(file, &m, &b) : NULL;
+    }
+    if (g && d && m == file->n_meta && b == file->count && gan_valid(g, d)) {
+        gan = gan_alloc(g, d);
+        if (gan) gan->seed = file->meta[0];
+    }
+    if (!gan) {
+        mlp_free(g);
+        mlp_free(d);
+    }
+    ai_model_close(file);
+    return gan;
+}
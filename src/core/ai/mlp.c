@@ -0,0 +1,838 @@
+/* mlp.c - Multilayer Perceptron Neural Network for HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+   ----------------------------------------------------------------------
+   With the batch as rows, a layer is Z = A W^T + 1 b^T (one dgemm over
+   the whole batch); backward, with D the error at the layer output,
+   grad W = D^T A / batch and the error below is (D W) * (1 - A^2).
+   The single-example calls are batches of one, so every path shares
+   the optimizer state. The passes are written once in mlp_kernels.h
+   and instantiated for double (FP64) and float (FP32, BF16).
+
+   Files are model containers (ai_model.h), "HOLOSMLP" version 3: meta
+   precision, layers and the layers + 1 sizes, then per layer the
+   weights (output x input) and biases as doubles (FP64) or floats
+   (FP32, BF16). A loaded model computes on the mapped arrays. Versions
+   1 and 2 were streams: "HOLOSMLP", u32 version, u32 storage precision
+   (from version 2), u64 layers, u64 sizes, then the same arrays; they
+   are still read (into allocated arrays).
+
+   mlp_quantize runs the calibration set through the model one layer at
+   a time (each layer alone is a model with a linear output) to take
+   the range of every layer's input. The quantized form is its own
+   container, "HOLOSMQ8", run from the mapped int8 weights.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <gsl/gsl_cblas.h>
+
+#include "core/ai/mlp.h"
+
+#define MLP_MAGIC "HOLOSMLP"
+#define MLP_VERSION 3u
+#define MLP_STREAM_VERSION 2u       /* Last version before the container */
+#define MLP_Q8_MAGIC "HOLOSMQ8"
+#define MLP_Q8_VERSION 1u
+#define MLP_FORWARD_CHUNK 256       /* Rows per block in mlp_forward_batch */
+
+typedef struct {
+    void **act;                     /* Layer outputs, batch x output_size */
+    void *delta, *below;            /* Errors, batch x widest layer */
+    void *grad_w, *grad_b;
+    void *xin;                      /* Inputs in the compute type (float) */
+    void *wq;                       /* bf16 copy of one layer's weights */
+} mlp_work;
+
+/* Training tensors after the L layer outputs */
+enum { MLP_ACT, MLP_DELTA, MLP_BELOW, MLP_GRAD_W, MLP_GRAD_B, MLP_XIN, MLP_WQ };
+
+/* -------------------------------
+   Allocation
+   ------------------------------- */
+
+static size_t mlp_widest(const mlp_t *mlp) {
+    size_t w = mlp->layers[0].input_size;
+    for (size_t l = 0; l < mlp->num_layers; l++)
+        if (mlp->layers[l].output_size > w) w = mlp->layers[l].output_size;
+    return w;
+}
+
+static size_t mlp_most_weights(const mlp_t *mlp) {
+    size_t n = 0;
+    for (size_t l = 0; l < mlp->num_layers; l++) {
+        const size_t k = mlp->layers[l].input_size * mlp->layers[l].output_size;
+        if (k > n) n = k;
+    }
+    return n;
+}
+
+static uint64_t mlp_splitmix(uint64_t *s) {
+    uint64_t z = (*s += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static void mlp_state_free(mlp_t *mlp) {
+    for (size_t l = 0; l < mlp->num_layers; l++) {
+        mlp_layer_t *ly = &mlp->layers[l];
+        free(ly->m_weights);
+        free(ly->m_biases);
+        free(ly->v_weights);
+        free(ly->v_biases);
+        ly->m_weights = ly->m_biases = ly->v_weights = ly->v_biases = NULL;
+    }
+}
+
+static void mlp_params_free(mlp_layer_t *ly) {
+    free(ly->weights);
+    free(ly->biases);
+    free(ly->weights_f);
+    free(ly->biases_f);
+    ly->weights = ly->biases = NULL;
+    ly->weights_f = ly->biases_f = NULL;
+}
+
+/* Parameter arrays of the storage type of precision, zeroed. */
+static int mlp_params_alloc(mlp_layer_t *ly, ai_precision_t precision) {
+    const size_t nw = ly->input_size * ly->output_size;
+    if (precision == AI_PRECISION_FP64) {
+        ly->weights = calloc(nw, sizeof(double));
+        ly->biases = calloc(ly->output_size, sizeof(double));
+        return ly->weights && ly->biases ? 0 : -1;
+    }
+    ly->weights_f = calloc(nw, sizeof(float));
+    ly->biases_f = calloc(ly->output_size, sizeof(float));
+    return ly->weights_f && ly->biases_f ? 0 : -1;
+}
+
+/* Layers sized from layer_sizes[0..num_layers]; weights are zero, or
+   left NULL for the caller to bind when params is 0. */
+static mlp_t *mlp_shell(const size_t *layer_sizes, size_t num_layers, ai_precision_t precision, int params) {
+    mlp_t *mlp;
+    if (!layer_sizes || num_layers == 0 || precision < AI_PRECISION_FP64 || precision > AI_PRECISION_BF16) return NULL;
+    for (size_t l = 0; l <= num_layers; l++)
+        if (layer_sizes[l] == 0) return NULL;
+    mlp = calloc(1, sizeof(*mlp));
+    if (!mlp) return NULL;
+    mlp->layers = calloc(num_layers, sizeof(mlp_layer_t));
+    if (!mlp->layers) {
+        free(mlp);
+        return NULL;
+    }
+    mlp->num_layers = num_layers;
+    mlp->precision = precision;
+    mlp->optimizer = MLP_OPT_SGD;
+    mlp->beta1 = 0.9;
+    mlp->beta2 = 0.999;
+    mlp->epsilon = 1e-8;
+    for (size_t l = 0; l < num_layers; l++) {
+        mlp_layer_t *ly = &mlp->layers[l];
+        ly->input_size = layer_sizes[l];
+        ly->output_size = layer_sizes[l + 1];
+        if (params && mlp_params_alloc(ly, precision) != 0) {
+            mlp_free(mlp);
+            return NULL;
+        }
+    }
+    return mlp;
+}
+
+/* Weights are Glorot uniform from a fixed seed, so allocation is
+   reproducible (and the same in every precision up to rounding). */
+mlp_t *mlp_alloc_precision(const size_t *layer_sizes, size_t num_layers, ai_precision_t precision) {
+    mlp_t *mlp = mlp_shell(layer_sizes, num_layers, precision, 1);
+    uint64_t seed = 0x484f4c4f534d4c50ULL;
+    if (!mlp) return NULL;
+    for (size_t l = 0; l < num_layers; l++) {
+        mlp_layer_t *ly = &mlp->layers[l];
+        const double a = sqrt(6.0 / (double)(ly->input_size + ly->output_size));
+        for (size_t k = 0; k < ly->input_size * ly->output_size; k++) {
+            const double u = (double)(mlp_splitmix(&seed) >> 11) * 0x1.0p-53;
+            if (ly->weights) ly->weights[k] = a * (2.0 * u - 1.0);
+            else ly->weights_f[k] = (float)(a * (2.0 * u - 1.0));
+        }
+    }
+    return mlp;
+}
+
+mlp_t *mlp_alloc(const size_t *layer_sizes, size_t num_layers) {
+    return mlp_alloc_precision(layer_sizes, num_layers, AI_PRECISION_FP64);
+}
+
+void mlp_free(mlp_t *mlp) {
+    if (!mlp) return;
+    if (mlp->layers) {
+        mlp_state_free(mlp);
+        for (size_t l = 0; l < mlp->num_layers && !mlp->file; l++) mlp_params_free(&mlp->layers[l]);
+    }
+    ai_model_close(mlp->file);
+    ai_exec_plan_free(mlp->plan);
+    free(mlp->layers);
+    free(mlp->activations);
+    free(mlp);
+}
+
+int mlp_set_optimizer(mlp_t *mlp, mlp_optimizer_t optimizer, double beta1, double beta2, double epsilon) {
+    if (!mlp || optimizer < MLP_OPT_SGD || optimizer > MLP_OPT_ADAM) return -1;
+    if (optimizer != MLP_OPT_SGD && !(beta1 >= 0.0 && beta1 < 1.0)) return -1;
+    if (optimizer == MLP_OPT_ADAM && (!(beta2 >= 0.0 && beta2 < 1.0) || !(epsilon > 0.0))) return -1;
+    mlp_state_free(mlp);
+    mlp->optimizer = optimizer;
+    mlp->beta1 = beta1;
+    mlp->beta2 = beta2;
+    mlp->epsilon = epsilon;
+    mlp->step = 0;
+    if (optimizer == MLP_OPT_SGD) return 0;
+    for (size_t l = 0; l < mlp->num_layers; l++) {
+        mlp_layer_t *ly = &mlp->layers[l];
+        const size_t nw = ly->input_size * ly->output_size;
+        ly->m_weights = calloc(nw, sizeof(double));
+        ly->m_biases = calloc(ly->output_size, sizeof(double));
+        if (optimizer == MLP_OPT_ADAM) {
+            ly->v_weights = calloc(nw, sizeof(double));
+            ly->v_biases = calloc(ly->output_size, sizeof(double));
+        }
+        if (!ly->m_weights || !ly->m_biases || (optimizer == MLP_OPT_ADAM && (!ly->v_weights || !ly->v_biases))) {
+            mlp_state_free(mlp);
+            mlp->optimizer = MLP_OPT_SGD;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* -------------------------------
+   Plans
+   ------------------------------- */
+
+/* Forward: two ping-pong blocks of MLP_FORWARD_CHUNK rows. Training:
+   layer l runs forward at step l, the loss is step L and layer l runs
+   backward at step 2L - l. A layer's output is last read by the
+   backward of the layer above (as its input), so the output layer dies
+   at the loss and the gradients can take its place. */
+static int mlp_layout(const void *model, ai_pass_t pass, size_t batch, size_t length, int threads, ai_plan_t *plan) {
+    const mlp_t *mlp = model;
+    const size_t L = mlp->num_layers, width = mlp_widest(mlp), nw = mlp_most_weights(mlp);
+    const size_t elem = mlp->precision == AI_PRECISION_FP64 ? sizeof(double) : sizeof(float);
+    const int bf16 = mlp->precision == AI_PRECISION_BF16;
+    int rc = 0;
+    (void)length;
+    (void)threads;
+    if (pass == AI_PASS_FORWARD) {
+        const size_t rows = batch < MLP_FORWARD_CHUNK ? batch : MLP_FORWARD_CHUNK;
+        rc = ai_plan_add(plan, rows * width * elem, 0, 0) || ai_plan_add(plan, rows * width * elem, 0, 0)
+             || ai_plan_add(plan, bf16 ? nw * elem : 0, 0, 0);
+        return rc ? -1 : 0;
+    }
+    for (size_t l = 0; l < L && rc == 0; l++)
+        rc = ai_plan_add(plan, batch * mlp->layers[l].output_size * elem, l, 2 * L - l - 1);
+    rc = rc || ai_plan_add(plan, L * sizeof(void *), 0, 2 * L)
+         || ai_plan_add(plan, batch * width * elem, L, 2 * L) || ai_plan_add(plan, batch * width * elem, L, 2 * L)
+         || ai_plan_add(plan, nw * elem, L + 1, 2 * L) || ai_plan_add(plan, width * elem, L + 1, 2 * L)
+         || ai_plan_add(plan, elem != sizeof(double) ? batch * mlp->layers[0].input_size * elem : 0, 0, 2 * L)
+         || ai_plan_add(plan, bf16 ? nw * elem : 0, 0, 2 * L);
+    return rc ? -1 : 0;
+}
+
+static void mlp_work_bind(const mlp_t *mlp, const ai_plan_t *plan, void *base, mlp_work *w) {
+    const size_t L = mlp->num_layers;
+    w->act = ai_plan_at(plan, base, L + MLP_ACT);
+    for (size_t l = 0; l < L; l++) w->act[l] = ai_plan_at(plan, base, l);
+    w->delta = ai_plan_at(plan, base, L + MLP_DELTA);
+    w->below = ai_plan_at(plan, base, L + MLP_BELOW);
+    w->grad_w = ai_plan_at(plan, base, L + MLP_GRAD_W);
+    w->grad_b = ai_plan_at(plan, base, L + MLP_GRAD_B);
+    w->xin = ai_plan_at(plan, base, L + MLP_XIN);
+    w->wq = ai_plan_at(plan, base, L + MLP_WQ);
+}
+
+/* The layout follows the precision; a plan that cannot be redone is dropped. */
+static void mlp_replan(mlp_t *mlp) {
+    if (mlp->plan && ai_exec_grow(&mlp->plan, mlp_layout, mlp, 0, 0, 1) != 0) {
+        ai_exec_plan_free(mlp->plan);
+        mlp->plan = NULL;
+    }
+}
+
+int mlp_plan(mlp_t *mlp, ai_arena_t *arena, size_t batch) {
+    if (!mlp || mlp->num_layers == 0 || batch == 0) return -1;
+    return ai_exec_plan(&mlp->plan, arena, mlp_layout, mlp, batch, 1, 1);
+}
+
+int mlp_set_precision(mlp_t *mlp, ai_precision_t precision) {
+    mlp_layer_t *fresh;
+    if (!mlp || precision < AI_PRECISION_FP64 || precision > AI_PRECISION_BF16) return -1;
+    if ((precision == AI_PRECISION_FP64) == (mlp->precision == AI_PRECISION_FP64)) {
+        mlp->precision = precision;
+        mlp_replan(mlp);
+        return mlp_set_optimizer(mlp, mlp->optimizer, mlp->beta1, mlp->beta2, mlp->epsilon);
+    }
+    /* All layers converted before any is replaced */
+    fresh = calloc(mlp->num_layers, sizeof(mlp_layer_t));
+    if (!fresh) return -1;
+    for (size_t l = 0; l < mlp->num_layers; l++) {
+        const mlp_layer_t *ly = &mlp->layers[l];
+        mlp_layer_t *nl = &fresh[l];
+        const size_t nw = ly->input_size * ly->output_size;
+        nl->input_size = ly->input_size;
+        nl->output_size = ly->output_size;
+        if (mlp_params_alloc(nl, precision) != 0) {
+            for (size_t k = 0; k <= l; k++) mlp_params_free(&fresh[k]);
+            free(fresh);
+            return -1;
+        }
+        if (precision == AI_PRECISION_FP64) {
+            for (size_t k = 0; k < nw; k++) nl->weights[k] = ly->weights_f[k];
+            for (size_t k = 0; k < ly->output_size; k++) nl->biases[k] = ly->biases_f[k];
+        } else {
+            for (size_t k = 0; k < nw; k++) nl->weights_f[k] = (float)ly->weights[k];
+            for (size_t k = 0; k < ly->output_size; k++) nl->biases_f[k] = (float)ly->biases[k];
+        }
+    }
+    /* Converted arrays are allocated; the mapped file is no longer used */
+    for (size_t l = 0; l < mlp->num_layers; l++) {
+        mlp_layer_t *ly = &mlp->layers[l];
+        if (!mlp->file) mlp_params_free(ly);
+        ly->weights = fresh[l].weights;
+        ly->biases = fresh[l].biases;
+        ly->weights_f = fresh[l].weights_f;
+        ly->biases_f = fresh[l].biases_f;
+    }
+    free(fresh);
+    ai_model_close(mlp->file);
+    mlp->file = NULL;
+    mlp->precision = precision;
+    mlp_replan(mlp);
+    return mlp_set_optimizer(mlp, mlp->optimizer, mlp->beta1, mlp->beta2, mlp->epsilon);
+}
+
+/* -------------------------------
+   Passes
+   ------------------------------- */
+
+#define MLP_REAL double
+#define MLP_FN(name) name##_f64
+#define MLP_GEMM cblas_dgemm
+#define MLP_TANH tanh
+#define MLP_W(ly) ((ly)->weights)
+#define MLP_B(ly) ((ly)->biases)
+#define MLP_NATIVE 1
+#include "mlp_kernels.h"
+#undef MLP_REAL
+#undef MLP_FN
+#undef MLP_GEMM
+#undef MLP_TANH
+#undef MLP_W
+#undef MLP_B
+#undef MLP_NATIVE
+
+#define MLP_REAL float
+#define MLP_FN(name) name##_f32
+#define MLP_GEMM cblas_sgemm
+#define MLP_TANH tanhf
+#define MLP_W(ly) ((ly)->weights_f)
+#define MLP_B(ly) ((ly)->biases_f)
+#define MLP_NATIVE 0
+#include "mlp_kernels.h"
+#undef MLP_REAL
+#undef MLP_FN
+#undef MLP_GEMM
+#undef MLP_TANH
+#undef MLP_W
+#undef MLP_B
+#undef MLP_NATIVE
+
+int mlp_forward_batch(const mlp_t *mlp, const double *inputs, size_t batch, double *outputs) {
+    const ai_plan_t *plan;
+    ai_plan_t local;
+    void *base, *buf[3];
+    if (!mlp || mlp->num_layers == 0 || (batch && (!inputs || !outputs))) return -1;
+    if (batch == 0) return 0;
+    base = ai_exec_begin(mlp->plan, mlp_layout, mlp, AI_PASS_FORWARD, batch, 1, 1, &local, &plan);
+    if (!base) return -1;
+    for (size_t i = 0; i < 3; i++) buf[i] = ai_plan_at(plan, base, i);
+    if (mlp->precision == AI_PRECISION_FP64) mlp_forward_batch_f64(mlp, inputs, batch, outputs, buf);
+    else mlp_forward_batch_f32(mlp, inputs, batch, outputs, buf);
+    ai_exec_end(base, &local, plan);
+    return 0;
+}
+
+void mlp_forward(const mlp_t *mlp, const double *input, double *output) {
+    mlp_forward_batch(mlp, input, 1, output);
+}
+
+int mlp_train_batch(mlp_t *mlp, const double *inputs, const double *targets, size_t batch, double learning_rate, double *loss) {
+    const ai_plan_t *plan;
+    ai_plan_t local;
+    mlp_work w;
+    void *base;
+    if (!mlp || mlp->num_layers == 0 || !inputs || !targets || batch == 0) return -1;
+    if (!ai_exec_covers(mlp->plan, batch, 1, 1) && ai_exec_grow(&mlp->plan, mlp_layout, mlp, batch, 1, 1) != 0) return -1;
+    base = ai_exec_begin(mlp->plan, mlp_layout, mlp, AI_PASS_TRAIN, batch, 1, 1, &local, &plan);
+    if (!base) return -1;
+    mlp_work_bind(mlp, plan, base, &w);
+    if (mlp->precision == AI_PRECISION_FP64) mlp_train_batch_f64(mlp, &w, inputs, targets, batch, learning_rate, loss);
+    else mlp_train_batch_f32(mlp, &w, inputs, targets, batch, learning_rate, loss);
+    ai_exec_end(base, &local, plan);
+    return 0;
+}
+
+void mlp_train(mlp_t *mlp, const double *input, const double *target, double learning_rate) {
+    mlp_train_batch(mlp, input, target, 1, learning_rate, NULL);
+}
+
+/* -------------------------------
+   Gradients
+   ------------------------------- */
+
+size_t mlp_param_count(const mlp_t *mlp) {
+    size_t n = 0;
+    for (size_t l = 0; mlp && l < mlp->num_layers; l++)
+        n += (mlp->layers[l].input_size + 1) * mlp->layers[l].output_size;
+    return n;
+}
+
+/* The layer outputs, then two error blocks of batch x widest */
+size_t mlp_work_count(const mlp_t *mlp, size_t batch) {
+    size_t n = 0;
+    if (!mlp || mlp->num_layers == 0) return 0;
+    for (size_t l = 0; l < mlp->num_layers; l++) n += batch * mlp->layers[l].output_size;
+    return n + 2 * batch * mlp_widest(mlp);
+}
+
+const double *mlp_forward_work(const mlp_t *mlp, const double *inputs, size_t batch, double *work) {
+    const double *in = inputs;
+    double *out = work;
+    if (!mlp || mlp->num_layers == 0 || mlp->precision != AI_PRECISION_FP64 || !inputs || !work) return NULL;
+    for (size_t l = 0; l < mlp->num_layers; l++) {
+        const mlp_layer_t *ly = &mlp->layers[l];
+        if (l) out += batch * mlp->layers[l - 1].output_size;
+        mlp_layer_forward_f64(ly, ly->weights, in, batch, out, l + 1 < mlp->num_layers, 0);
+        in = out;
+    }
+    return out;
+}
+
+int mlp_backward_work(const mlp_t *mlp, const double *inputs, size_t batch, const double *d_out, double *grad, double *d_in,
+                      double *work) {
+    const size_t L = mlp ? mlp->num_layers : 0;
+    double *act, *delta, *below, *g = grad;
+    if (L == 0 || mlp->precision != AI_PRECISION_FP64 || !inputs || !d_out || !work) return -1;
+    delta = work + mlp_work_count(mlp, batch) - 2 * batch * mlp_widest(mlp);
+    below = delta + batch * mlp_widest(mlp);
+    act = delta - batch * mlp->layers[L - 1].output_size;
+    memcpy(delta, d_out, batch * mlp->layers[L - 1].output_size * sizeof(double));
+    if (g) g += mlp_param_count(mlp);
+    for (size_t l = L; l-- > 0;) {
+        const mlp_layer_t *ly = &mlp->layers[l];
+        const size_t n = ly->output_size, m = ly->input_size;
+        const double *below_act;
+        double *tmp;
+        if (l) act -= batch * m;
+        below_act = l ? act : inputs;
+        if (g) {
+            g -= (m + 1) * n;
+            cblas_dgemm(CblasRowMajor, CblasTrans, CblasNoTrans, (int)n, (int)m, (int)batch,
+                        1.0, delta, (int)n, below_act, (int)m, 1.0, g, (int)m);
+            for (size_t r = 0; r < batch; r++)
+                for (size_t j = 0; j < n; j++) g[n * m + j] += delta[r * n + j];
+        }
+        if (l == 0 && !d_in) break;
+        cblas_dgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, (int)batch, (int)m, (int)n,
+                    1.0, delta, (int)n, ly->weights, (int)m, 0.0, l ? below : d_in, (int)m);
+        if (l == 0) break;
+        for (size_t k = 0; k < batch * m; k++) below[k] *= 1 - below_act[k] * below_act[k];
+        tmp = delta;
+        delta = below;
+        below = tmp;
+    }
+    return 0;
+}
+
+int mlp_apply_gradient(mlp_t *mlp, const double *grad, double learning_rate) {
+    if (!mlp || mlp->num_layers == 0 || mlp->precision != AI_PRECISION_FP64 || !grad) return -1;
+    mlp->step++;
+    for (size_t l = 0; l < mlp->num_layers; l++) {
+        mlp_layer_t *ly = &mlp->layers[l];
+        const size_t nw = ly->input_size * ly->output_size;
+        mlp_update_f64(mlp, ly->weights, ly->m_weights, ly->v_weights, grad, nw, learning_rate);
+        mlp_update_f64(mlp, ly->biases, ly->m_biases, ly->v_biases, grad + nw, ly->output_size, learning_rate);
+        grad += nw + ly->output_size;
+    }
+    return 0;
+}
+
+/* -------------------------------
+   Quantization
+   ------------------------------- */
+
+static mlp_q8_t *mlp_q8_shell(size_t num_layers) {
+    mlp_q8_t *q = calloc(1, sizeof(*q));
+    if (!q) return NULL;
+    q->num_layers = num_layers;
+    q->layers = calloc(num_layers, sizeof(ai_i8_linear_t));
+    q->inputs = calloc(num_layers, sizeof(ai_u8_quant_t));
+    if (!q->layers || !q->inputs) {
+        free(q->layers);
+        free(q->inputs);
+        free(q);
+        return NULL;
+    }
+    return q;
+}
+
+void mlp_q8_free(mlp_q8_t *q) {
+    if (!q) return;
+    for (size_t l = 0; !q->file && l < q->num_layers; l++) ai_i8_linear_free(&q->layers[l]);
+    ai_model_close(q->file);
+    free(q->layers);
+    free(q->inputs);
+    free(q);
+}
+
+static ai_u8_quant_t mlp_q8_range(const double *x, size_t n) {
+    double lo = 0.0, hi = 0.0;
+    for (size_t k = 0; k < n; k++) {
+        if (x[k] < lo) lo = x[k];
+        if (x[k] > hi) hi = x[k];
+    }
+    return ai_u8_range(lo, hi);
+}
+
+mlp_q8_t *mlp_quantize(const mlp_t *mlp, const double *calib, size_t n) {
+    mlp_q8_t *q;
+    double *x, *z;
+    int ok;
+    if (!mlp || mlp->num_layers == 0 || !calib || n == 0) return NULL;
+    q = mlp_q8_shell(mlp->num_layers);
+    x = malloc(n * mlp_widest(mlp) * sizeof(double));
+    z = malloc(n * mlp_widest(mlp) * sizeof(double));
+    ok = q && x && z;
+    if (ok) memcpy(x, calib, n * mlp->layers[0].input_size * sizeof(double));
+    /* x holds the inputs of layer l over the calibration set */
+    for (size_t l = 0; ok && l < mlp->num_layers; l++) {
+        const mlp_layer_t *ly = &mlp->layers[l];
+        q->inputs[l] = mlp_q8_range(x, n * ly->input_size);
+        ok = ai_i8_linear_init(&q->layers[l], ly->output_size, ly->input_size, ly->weights, ly->weights_f, ly->biases,
+                               ly->biases_f) == 0;
+        if (ok && l + 1 < mlp->num_layers) {
+            /* Layer l alone is a model with a linear output */
+            mlp_t view = *mlp;
+            double *t;
+            view.num_layers = 1;
+            view.layers = (mlp_layer_t *)ly;
+            view.plan = NULL;
+            view.file = NULL;
+            ok = mlp_forward_batch(&view, x, n, z) == 0;
+            for (size_t k = 0; k < n * ly->output_size; k++) z[k] = tanh(z[k]);
+            t = x;
+            x = z;
+            z = t;
+        }
+    }
+    free(x);
+    free(z);
+    if (!ok) {
+        mlp_q8_free(q);
+        return NULL;
+    }
+    return q;
+}
+
+size_t mlp_q8_work_size(const mlp_q8_t *q, size_t batch) {
+    size_t most = 0;
+    for (size_t l = 0; q && l < q->num_layers; l++)
+        if (q->layers[l].stride > most) most = q->layers[l].stride;
+    return 2 * batch * most;
+}
+
+int mlp_q8_forward_batch(const mlp_q8_t *q, const double *inputs, size_t batch, double *outputs, void *work) {
+    const size_t bytes = mlp_q8_work_size(q, batch);
+    const ai_i8_linear_t *first;
+    uint8_t *a, *b, *own = NULL;
+    if (!q || q->num_layers == 0 || (batch && (!inputs || !outputs))) return -1;
+    if (batch == 0) return 0;
+    if (!work) work = own = malloc(bytes);
+    if (!work) return -1;
+    /* The weights are zero past each row, this only defines the padding */
+    memset(work, 0, bytes);
+    a = work;
+    b = a + bytes / 2;
+    first = &q->layers[0];
+    for (size_t r = 0; r < batch; r++)
+        ai_u8_quantize(inputs + r * first->in, first->in, q->inputs[0], a + r * first->stride);
+    for (size_t l = 0; l + 1 < q->num_layers; l++) {
+        uint8_t *t;
+        ai_i8_linear_forward(&q->layers[l], a, batch, q->inputs[l], AI_I8_TANH, q->inputs[l + 1], b, q->layers[l + 1].stride,
+                             NULL, 0);
+        t = a;
+        a = b;
+        b = t;
+    }
+    ai_i8_linear_forward(&q->layers[q->num_layers - 1], a, batch, q->inputs[q->num_layers - 1], AI_I8_LINEAR,
+                         q->inputs[q->num_layers - 1], NULL, 0, outputs, 0);
+    free(own);
+    return 0;
+}
+
+/* -------------------------------
+   Files
+   ------------------------------- */
+
+int mlp_save(const mlp_t *mlp, const char *filename) {
+    uint64_t *meta;
+    ai_blob_t *blobs;
+    size_t L;
+    int rc;
+    if (!mlp || !filename || mlp->num_layers == 0) return -1;
+    L = mlp->num_layers;
+    meta = malloc((L + 3) * sizeof(uint64_t));
+    blobs = calloc(2 * L, sizeof(ai_blob_t));
+    if (!meta || !blobs) {
+        free(meta);
+        free(blobs);
+        return -1;
+    }
+    meta[0] = (uint64_t)mlp->precision;
+    meta[1] = L;
+    meta[2] = mlp->layers[0].input_size;
+    for (size_t l = 0; l < L; l++) {
+        const mlp_layer_t *ly = &mlp->layers[l];
+        const ai_dtype_t dtype = ly->weights ? AI_DTYPE_F64 : AI_DTYPE_F32;
+        ai_blob_t *w = &blobs[2 * l], *b = &blobs[2 * l + 1];
+        meta[3 + l] = ly->output_size;
+        w->dtype = b->dtype = dtype;
+        w->rank = 2;
+        w->shape[0] = ly->output_size;
+        w->shape[1] = ly->input_size;
+        w->data = ly->weights ? (const void *)ly->weights : (const void *)ly->weights_f;
+        b->rank = 1;
+        b->shape[0] = ly->output_size;
+        b->data = ly->biases ? (const void *)ly->biases : (const void *)ly->biases_f;
+    }
+    rc = ai_model_write(filename, MLP_MAGIC, MLP_VERSION, meta, L + 3, blobs, 2 * L);
+    free(meta);
+    free(blobs);
+    return rc;
+}
+
+/* The parameters are bound to the mapped tensors, which the model then owns. */
+static mlp_t *mlp_load_mapped(ai_model_t *file) {
+    const uint64_t *meta = file->meta;
+    size_t *sizes;
+    mlp_t *mlp = NULL;
+    int ok;
+    ok = file->version == MLP_VERSION && file->n_meta >= 3 && meta[0] <= AI_PRECISION_BF16 && meta[1] > 0
+         && meta[1] < 4096 && file->n_meta == meta[1] + 3 && file->count == 2 * meta[1];
+    sizes = ok ? malloc((size_t)(meta[1] + 1) * sizeof(size_t)) : NULL;
+    ok = ok && sizes != NULL;
+    for (uint64_t l = 0; ok && l <= meta[1]; l++) {
+        ok = meta[2 + l] > 0 && meta[2 + l] < ((uint64_t)1 << 32);
+        if (ok) sizes[l] = (size_t)meta[2 + l];
+    }
+    if (ok) {
+        mlp = mlp_shell(sizes, (size_t)meta[1], (ai_precision_t)meta[0], 0);
+        ok = mlp != NULL;
+    }
+    if (mlp) mlp->file = file;
+    else ai_model_close(file);
+    for (size_t l = 0; ok && l < mlp->num_layers; l++) {
+        mlp_layer_t *ly = &mlp->layers[l];
+        const size_t nw = ly->input_size * ly->output_size;
+        if (mlp->precision == AI_PRECISION_FP64) {
+            ly->weights = ai_model_tensor(file, 2 * l, AI_DTYPE_F64, nw);
+            ly->biases = ai_model_tensor(file, 2 * l + 1, AI_DTYPE_F64, ly->output_size);
+            ok = ly->weights && ly->biases;
+        } else {
+            ly->weights_f = ai_model_tensor(file, 2 * l, AI_DTYPE_F32, nw);
+            ly->biases_f = ai_model_tensor(file, 2 * l + 1, AI_DTYPE_F32, ly->output_size);
+            ok = ly->weights_f && ly->biases_f;
+        }
+    }
+    free(sizes);
+    if (!ok) {
+        mlp_free(mlp);
+        return NULL;
+    }
+    return mlp;
+}
+
+/* Versions 1 and 2 */
+static mlp_t *mlp_load_stream(const char *filename) {
+    char magic[8];
+    uint32_t version, precision = AI_PRECISION_FP64;
+    uint64_t layers;
+    size_t *sizes = NULL;
+    mlp_t *mlp = NULL;
+    FILE *fp;
+    int ok;
+    fp = fopen(filename, "rb");
+    if (!fp) return NULL;
+    ok = fread(magic, 1, 8, fp) == 8 && memcmp(magic, MLP_MAGIC, 8) == 0
+         && fread(&version, sizeof version, 1, fp) == 1 && version >= 1 && version <= MLP_STREAM_VERSION;
+    if (ok && version >= 2)
+        ok = fread(&precision, sizeof precision, 1, fp) == 1 && precision <= AI_PRECISION_BF16;
+    ok = ok && fread(&layers, sizeof layers, 1, fp) == 1 && layers > 0 && layers < 4096;
+    if (ok) {
+        sizes = malloc((layers + 1) * sizeof(size_t));
+        ok = sizes != NULL;
+    }
+    for (uint64_t l = 0; ok && l <= layers; l++) {
+        uint64_t size;
+        ok = fread(&size, sizeof size, 1, fp) == 1 && size > 0 && size < ((uint64_t)1 << 32);
+        if (ok) sizes[l] = (size_t)size;
+    }
+    if (ok) {
+        mlp = mlp_shell(sizes, (size_t)layers, (ai_precision_t)precision, 1);
+        ok = mlp != NULL;
+    }
+    for (size_t l = 0; ok && l < mlp->num_layers; l++) {
+        mlp_layer_t *ly = &mlp->layers[l];
+        const size_t nw = ly->input_size * ly->output_size;
+        if (ly->weights)
+            ok = fread(ly->weights, sizeof(double), nw, fp) == nw
+                 && fread(ly->biases, sizeof(double), ly->output_size, fp) == ly->output_size;
+        else
+            ok = fread(ly->weights_f, sizeof(float), nw, fp) == nw
+                 && fread(ly->biases_f, sizeof(float), ly->output_size, fp) == ly->output_size;
+    }
+    fclose(fp);
+    free(sizes);
+    if (!ok) {
+        mlp_free(mlp);
+        return NULL;
+    }
+    return mlp;
+}
+
+mlp_t *mlp_load(const char *filename) {
+    ai_model_t *file;
+    if (!filename) return NULL;
+    file = ai_model_open(filename, MLP_MAGIC);
+    return file ? mlp_load_mapped(file) : mlp_load_stream(filename);
+}
+
+mlp_t *mlp_load_precision(const char *filename, ai_precision_t precision) {
+    mlp_t *mlp = mlp_load(filename);
+    if (mlp && mlp->precision != precision && mlp_set_precision(mlp, precision) != 0) {
+        mlp_free(mlp);
+        return NULL;
+    }
+    return mlp;
+}
+
+/* Quantized form: meta layers and the layers + 1 sizes, then per layer
+   the int8 weights (output x stride), scales, row sums, biases and the
+   input quantization (scale, zero) */
+int mlp_q8_save(const mlp_q8_t *q, const char *filename) {
+    uint64_t *meta;
+    ai_blob_t *blobs;
+    float *quant;
+    size_t L;
+    int rc;
+    if (!q || !filename || q->num_layers == 0) return -1;
+    L = q->num_layers;
+    meta = malloc((L + 2) * sizeof(uint64_t));
+    blobs = calloc(5 * L, sizeof(ai_blob_t));
+    quant = malloc(2 * L * sizeof(float));
+    if (!meta || !blobs || !quant) {
+        free(meta);
+        free(blobs);
+        free(quant);
+        return -1;
+    }
+    meta[0] = L;
+    meta[1] = q->layers[0].in;
+    for (size_t l = 0; l < L; l++) {
+        const ai_i8_linear_t *lin = &q->layers[l];
+        ai_blob_t *b = &blobs[5 * l];
+        meta[2 + l] = lin->out;
+        quant[2 * l] = q->inputs[l].scale;
+        quant[2 * l + 1] = (float)q->inputs[l].zero;
+        b[0].dtype = AI_DTYPE_I8;
+        b[0].rank = 2;
+        b[0].shape[0] = lin->out;
+        b[0].shape[1] = lin->stride;
+        b[0].data = lin->w;
+        b[1].dtype = b[3].dtype = AI_DTYPE_F32;
+        b[2].dtype = AI_DTYPE_I32;
+        for (size_t k = 1; k < 4; k++) {
+            b[k].rank = 1;
+            b[k].shape[0] = lin->out;
+        }
+        b[1].data = lin->scale;
+        b[2].data = lin->wsum;
+        b[3].data = lin->bias;
+        b[4].dtype = AI_DTYPE_F32;
+        b[4].rank = 1;
+        b[4].shape[0] = 2;
+        b[4].data = &quant[2 * l];
+    }
+    rc = ai_model_write(filename, MLP_Q8_MAGIC, MLP_Q8_VERSION, meta, L + 2, blobs, 5 * L);
+    free(meta);
+    free(blobs);
+    free(quant);
+    return rc;
+}
+
+mlp_q8_t *mlp_q8_load(const char *filename) {
+    ai_model_t *file;
+    const uint64_t *meta;
+    mlp_q8_t *q = NULL;
+    int ok;
+    if (!filename) return NULL;
+    file = ai_model_open(filename, MLP_Q8_MAGIC);
+    if (!file) return NULL;
+    meta = file->meta;
+    ok = file->version == MLP_Q8_VERSION && file->n_meta >= 2 && meta[0] > 0 && meta[0] < 4096
+         && file->n_meta == meta[0] + 2 && file->count == 5 * meta[0];
+    for (uint64_t l = 0; ok && l <= meta[0]; l++) ok = meta[1 + l] > 0 && meta[1 + l] < ((uint64_t)1 << 32);
+    if (ok) {
+        q = mlp_q8_shell((size_t)meta[0]);
+        ok = q != NULL;
+    }
+    if (q) q->file = file;
+    else ai_model_close(file);
+    for (size_t l = 0; ok && l < q->num_layers; l++) {
+        ai_i8_linear_t *lin = &q->layers[l];
+        const float *quant;
+        lin->in = (size_t)meta[1 + l];
+        lin->out = (size_t)meta[2 + l];
+        lin->stride = ai_i8_stride(lin->in);
+        lin->w = ai_model_tensor(file, 5 * l, AI_DTYPE_I8, lin->out * lin->stride);
+        lin->scale = ai_model_tensor(file, 5 * l + 1, AI_DTYPE_F32, lin->out);
+        lin->wsum = ai_model_tensor(file, 5 * l + 2, AI_DTYPE_I32, lin->out);
+        lin->bias = ai_model_tensor(file, 5 * l + 3, AI_DTYPE_F32, lin->out);
+        quant = ai_model_tensor(file, 5 * l + 4, AI_DTYPE_F32, 2);
+        ok = lin->w && lin->scale && lin->wsum && lin->bias && quant && quant[0] > 0 && quant[1] >= 0 && quant[1] <= 255;
+        if (ok) {
+            q->inputs[l].scale = quant[0];
+            q->inputs[l].zero = (int32_t)quant[1];
+        }
+    }
+    if (!ok) {
+        mlp_q8_free(q);
+        return NULL;
+    }
+    return q;
+}
@@ -0,0 +1,177 @@
+/* mlp_kernels.h - Precision-generic MLP passes for HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+   ----------------------------------------------------------------------
+   Included by mlp.c once per compute type, with
+     MLP_REAL       double or float
+     MLP_FN(name)   name with the type suffix
+     MLP_GEMM       cblas_dgemm or cblas_sgemm
+     MLP_TANH       tanh or tanhf
+     MLP_W, MLP_B   the layer's weight and bias arrays of that type
+     MLP_NATIVE     1 when MLP_REAL is double (API buffers used in place)
+   bf16 is only ever set for float.
+*/
+
+/* Weights as the GEMM sees them: the stored array, or a bf16 copy. */
+static const MLP_REAL *MLP_FN(mlp_weights)(const mlp_layer_t *ly, MLP_REAL *scratch, int bf16) {
+    const size_t n = ly->input_size * ly->output_size;
+    if (!bf16) return MLP_W(ly);
+    for (size_t k = 0; k < n; k++) scratch[k] = (MLP_REAL)ai_bf16_round((float)MLP_W(ly)[k]);
+    return scratch;
+}
+
+/* out = act(in W^T + b) for rows rows of one layer. */
+static void MLP_FN(mlp_layer_forward)(const mlp_layer_t *ly, const MLP_REAL *w, const MLP_REAL *in, size_t rows, MLP_REAL *out, int hidden, int bf16) {
+    const size_t n = ly->output_size;
+    for (size_t r = 0; r < rows; r++)
+        memcpy(out + r * n, MLP_B(ly), n * sizeof(MLP_REAL));
+    MLP_GEMM(CblasRowMajor, CblasNoTrans, CblasTrans, (int)rows, (int)n, (int)ly->input_size,
+             1, in, (int)ly->input_size, w, (int)ly->input_size, 1, out, (int)n);
+    if (hidden) {
+        for (size_t k = 0; k < rows * n; k++) out[k] = MLP_TANH(out[k]);
+        if (bf16)
+            for (size_t k = 0; k < rows * n; k++) out[k] = (MLP_REAL)ai_bf16_round((float)out[k]);
+    }
+}
+
+#if !MLP_NATIVE
+static void MLP_FN(mlp_load_input)(const double *src, size_t n, MLP_REAL *dst, int bf16) {
+    for (size_t k = 0; k < n; k++) dst[k] = bf16 ? (MLP_REAL)ai_bf16_round((float)src[k]) : (MLP_REAL)src[k];
+}
+#endif
+
+/* work: the two ping-pong blocks and the bf16 weight copy of the forward plan */
+static void MLP_FN(mlp_forward_batch)(const mlp_t *mlp, const double *inputs, size_t batch, double *outputs, void **work) {
+    const size_t L = mlp->num_layers, n_in = mlp->layers[0].input_size, n_out = mlp->layers[L - 1].output_size;
+    const int bf16 = mlp->precision == AI_PRECISION_BF16;
+    const size_t chunk = batch < MLP_FORWARD_CHUNK ? batch : MLP_FORWARD_CHUNK;
+    MLP_REAL *buf[2] = { work[0], work[1] }, *wq = work[2];
+    for (size_t r0 = 0; r0 < batch; r0 += chunk) {
+        const size_t rows = batch - r0 < chunk ? batch - r0 : chunk;
+        const MLP_REAL *in;
+        MLP_REAL *out = NULL;
+#if MLP_NATIVE
+        in = inputs + r0 * n_in;
+#else
+        MLP_FN(mlp_load_input)(inputs + r0 * n_in, rows * n_in, buf[1], bf16);
+        in = buf[1];
+#endif
+        for (size_t l = 0; l < L; l++) {
+            const mlp_layer_t *ly = &mlp->layers[l];
+            out = buf[l & 1];
+#if MLP_NATIVE
+            if (l + 1 == L) out = outputs + r0 * n_out;
+#endif
+            MLP_FN(mlp_layer_forward)(ly, MLP_FN(mlp_weights)(ly, wq, bf16), in, rows, out, l + 1 < L, bf16);
+            in = out;
+        }
+#if !MLP_NATIVE
+        for (size_t k = 0; k < rows * n_out; k++) outputs[r0 * n_out + k] = (double)out[k];
+#else
+        (void)out;
+#endif
+    }
+}
+
+static void MLP_FN(mlp_update)(const mlp_t *mlp, MLP_REAL *p, double *m, double *v, const MLP_REAL *g, size_t n, double lr) {
+    switch (mlp->optimizer) {
+    case MLP_OPT_SGD:
+        for (size_t k = 0; k < n; k++) p[k] -= (MLP_REAL)(lr * g[k]);
+        break;
+    case MLP_OPT_MOMENTUM:
+        for (size_t k = 0; k < n; k++) {
+            m[k] = mlp->beta1 * m[k] + g[k];
+            p[k] -= (MLP_REAL)(lr * m[k]);
+        }
+        break;
+    case MLP_OPT_ADAM: {
+        const double t = (double)mlp->step;
+        const double c1 = 1.0 / (1.0 - pow(mlp->beta1, t)), c2 = 1.0 / (1.0 - pow(mlp->beta2, t));
+        for (size_t k = 0; k < n; k++) {
+            m[k] = mlp->beta1 * m[k] + (1.0 - mlp->beta1) * g[k];
+            v[k] = mlp->beta2 * v[k] + (1.0 - mlp->beta2) * (double)g[k] * g[k];
+            p[k] -= (MLP_REAL)(lr * (m[k] * c1) / (sqrt(v[k] * c2) + mlp->epsilon));
+        }
+        break;
+    }
+    }
+}
+
+static void MLP_FN(mlp_train_batch)(mlp_t *mlp, const mlp_work *w, const double *inputs, const double *targets, size_t batch,
+                                    double learning_rate, double *loss) {
+    const size_t L = mlp->num_layers, n_out = mlp->layers[L - 1].output_size;
+    const int bf16 = mlp->precision == AI_PRECISION_BF16;
+    MLP_REAL *delta, *below, *gw, *gb, *wq, *out;
+    const MLP_REAL *in;
+    double sum = 0.0;
+    delta = w->delta;
+    below = w->below;
+    gw = w->grad_w;
+    gb = w->grad_b;
+    wq = w->wq;
+#if MLP_NATIVE
+    in = inputs;
+#else
+    MLP_FN(mlp_load_input)(inputs, batch * mlp->layers[0].input_size, w->xin, bf16);
+    in = w->xin;
+#endif
+
+    for (size_t l = 0; l < L; l++) {
+        const mlp_layer_t *ly = &mlp->layers[l];
+        MLP_FN(mlp_layer_forward)(ly, MLP_FN(mlp_weights)(ly, wq, bf16), l ? (const MLP_REAL *)w->act[l - 1] : in, batch, w->act[l], l + 1 < L, bf16);
+    }
+
+    out = w->act[L - 1];
+    for (size_t k = 0; k < batch * n_out; k++) {
+        const double e = (double)out[k] - targets[k];
+        delta[k] = (MLP_REAL)e;
+        sum += e * e;
+    }
+    if (loss) *loss = 0.5 * sum / (double)batch;
+
+    mlp->step++;
+    for (size_t l = L; l-- > 0;) {
+        mlp_layer_t *ly = &mlp->layers[l];
+        const size_t n = ly->output_size, m = ly->input_size;
+        const MLP_REAL *below_act = l ? (const MLP_REAL *)w->act[l - 1] : in;
+        MLP_REAL *tmp;
+
+        if (bf16)
+            for (size_t k = 0; k < batch * n; k++) delta[k] = (MLP_REAL)ai_bf16_round((float)delta[k]);
+        MLP_GEMM(CblasRowMajor, CblasTrans, CblasNoTrans, (int)n, (int)m, (int)batch,
+                 (MLP_REAL)(1.0 / (double)batch), delta, (int)n, below_act, (int)m, 0, gw, (int)m);
+        for (size_t j = 0; j < n; j++) gb[j] = 0;
+        for (size_t r = 0; r < batch; r++)
+            for (size_t j = 0; j < n; j++) gb[j] += delta[r * n + j];
+        for (size_t j = 0; j < n; j++) gb[j] /= (MLP_REAL)batch;
+
+        /* Error below, with the weights of this step */
+        if (l > 0) {
+            MLP_GEMM(CblasRowMajor, CblasNoTrans, CblasNoTrans, (int)batch, (int)m, (int)n,
+                     1, delta, (int)n, MLP_FN(mlp_weights)(ly, wq, bf16), (int)m, 0, below, (int)m);
+            for (size_t k = 0; k < batch * m; k++) below[k] *= 1 - below_act[k] * below_act[k];
+        }
+
+        MLP_FN(mlp_update)(mlp, MLP_W(ly), ly->m_weights, ly->v_weights, gw, n * m, learning_rate);
+        MLP_FN(mlp_update)(mlp, MLP_B(ly), ly->m_biases, ly->v_biases, gb, n, learning_rate);
+
+        tmp = delta;
+        delta = below;
+        below = tmp;
+    }
+}
@@ -0,0 +1,621 @@
+/* rnn.c - Recurrent Neural Network for HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+   ----------------------------------------------------------------------
+   Sequences are time-major, so a block of steps of the whole batch is
+   one row-major matrix. Per layer and block, the input projection
+   X Wxh^T + bh of every step is a single dgemm written straight into
+   the hidden-state rows; the recurrent loop then only adds h_{t-1}
+   Whh^T (batch x hidden) and applies tanh. The output projection is
+   again one dgemm per block.
+
+   Backward, the same holds in reverse: dH = dY Why, then the loop
+   dZ_t = (dH_t + dZ_{t+1} Whh) * (1 - h_t^2), and the weight
+   gradients are one dgemm each over the block (Whh against the hidden
+   rows shifted by one step, which is why slot 0 of the hidden buffer
+   holds h_{-1}).
+
+   Truncated BPTT cuts the sequence into bptt_window steps; each window
+   is a forward, a backward and an SGD step, and its last hidden state
+   starts the next window. The buffers are the model's plan (ai_plan.h),
+   which training grows only when a larger window or batch comes in.
+   The passes are written once in rnn_kernels.h and instantiated for
+   double (FP64) and float (FP32, BF16).
+
+   Files are model containers (ai_model.h), "HOLOSRNN" version 3: meta
+   precision, layers and per layer the input, hidden and output sizes,
+   then per layer Wxh, Whh, Why, bh, by as doubles (FP64) or floats
+   (FP32, BF16) and last hidden_state as doubles. A loaded model
+   computes on the mapped arrays. Version 2 was the same container
+   without the precision (FP64). Version 1 was a stream: "HOLOSRNN",
+   u32 version, u64 layers, then per layer the u64 sizes and the
+   arrays, then hidden_state; it is still read (into allocated arrays).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <gsl/gsl_cblas.h>
+
+#include "core/ai/rnn.h"
+
+#define RNN_MAGIC "HOLOSRNN"
+#define RNN_VERSION 3u
+#define RNN_FP64_VERSION 2u         /* Container before the precision */
+#define RNN_STREAM_VERSION 1u       /* Last version before the container */
+#define RNN_FORWARD_CHUNK 256       /* Steps per block in rnn_forward_batch */
+
+typedef struct {
+    void **H;                       /* Per layer, (steps + 1) x batch x hidden; slot 0 is h_{-1} */
+    void **Y;                       /* Per layer, steps x batch x output */
+    void *dY, *dX;                  /* steps x batch x widest input/output */
+    void *dH;                       /* steps x batch x widest hidden, becomes dZ */
+    void *grad;                     /* One layer's gradients */
+    void *xin;                      /* Inputs in the compute type (float) */
+    void *wq;                       /* bf16 copies of one layer's weights */
+} rnn_work;
+
+/* Tensors after the 2 per layer */
+enum { RNN_HP, RNN_YP, RNN_DY, RNN_DX, RNN_DH, RNN_GRAD, RNN_XIN, RNN_WQ };
+
+/* -------------------------------
+   Allocation
+   ------------------------------- */
+
+static uint64_t rnn_splitmix(uint64_t *s) {
+    uint64_t z = (*s += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static size_t rnn_params(const rnn_layer_t *ly) {
+    return ly->hidden_size * (ly->input_size + ly->hidden_size + ly->output_size + 1) + ly->output_size;
+}
+
+/* Parameter arrays of a layer, in file order, of both storage types,
+   with their sizes. */
+static size_t rnn_arrays(rnn_layer_t *ly, double ***arrays, float ***arrays_f, size_t *sizes) {
+    const size_t ni = ly->input_size, nh = ly->hidden_size, no = ly->output_size;
+    double **a[5] = { &ly->Wxh, &ly->Whh, &ly->Why, &ly->bh, &ly->by };
+    float **af[5] = { &ly->Wxh_f, &ly->Whh_f, &ly->Why_f, &ly->bh_f, &ly->by_f };
+    const size_t n[5] = { nh * ni, nh * nh, no * nh, nh, no };
+    memcpy(arrays, a, sizeof a);
+    memcpy(arrays_f, af, sizeof af);
+    memcpy(sizes, n, sizeof n);
+    return 5;
+}
+
+static void rnn_params_free(rnn_layer_t *ly) {
+    double **a[5];
+    float **af[5];
+    size_t n[5];
+    rnn_arrays(ly, a, af, n);
+    for (size_t k = 0; k < 5; k++) {
+        free(*a[k]);
+        free(*af[k]);
+        *a[k] = NULL;
+        *af[k] = NULL;
+    }
+}
+
+/* Parameter arrays of the storage type of precision, zeroed. */
+static int rnn_params_alloc(rnn_layer_t *ly, ai_precision_t precision) {
+    double **a[5];
+    float **af[5];
+    size_t n[5];
+    rnn_arrays(ly, a, af, n);
+    for (size_t k = 0; k < 5; k++) {
+        if (precision == AI_PRECISION_FP64) *a[k] = calloc(n[k], sizeof(double));
+        else *af[k] = calloc(n[k], sizeof(float));
+        if (!*a[k] && !*af[k]) return -1;
+    }
+    return 0;
+}
+
+static size_t rnn_hidden_total(const rnn_t *rnn) {
+    size_t n = 0;
+    for (size_t l = 0; l < rnn->num_layers; l++) n += rnn->layers[l].hidden_size;
+    return n;
+}
+
+static size_t rnn_widest_io(const rnn_t *rnn) {
+    size_t w = rnn->layers[0].input_size;
+    for (size_t l = 0; l < rnn->num_layers; l++)
+        if (rnn->layers[l].output_size > w) w = rnn->layers[l].output_size;
+    return w;
+}
+
+static size_t rnn_widest_hidden(const rnn_t *rnn) {
+    size_t w = 0;
+    for (size_t l = 0; l < rnn->num_layers; l++)
+        if (rnn->layers[l].hidden_size > w) w = rnn->layers[l].hidden_size;
+    return w;
+}
+
+/* length is the steps of one block; the blocks reuse the same buffers.
+   Steps are layers: the hidden rows carry over to the next block, and
+   so do not die, but in the forward pass a layer's outputs die once the
+   layer above has read them. Training keeps everything for backward. */
+static int rnn_layout(const void *model, ai_pass_t pass, size_t batch, size_t length, int threads, ai_plan_t *plan) {
+    const rnn_t *rnn = model;
+    const size_t L = rnn->num_layers;
+    const size_t D = rnn->precision == AI_PRECISION_FP64 ? sizeof(double) : sizeof(float);
+    const size_t steps = pass == AI_PASS_FORWARD && length > RNN_FORWARD_CHUNK ? RNN_FORWARD_CHUNK : length;
+    const size_t rows = steps * batch;
+    const int train = pass == AI_PASS_TRAIN, native = rnn->precision == AI_PRECISION_FP64;
+    size_t most = 0;
+    int rc = 0;
+    (void)threads;
+    for (size_t l = 0; l < L && rc == 0; l++) {
+        const rnn_layer_t *ly = &rnn->layers[l];
+        const int direct = native && !train && l + 1 == L;   /* forward writes the top layer to the caller */
+        rc = ai_plan_add(plan, (rows + batch) * ly->hidden_size * D, 0, L)
+             || ai_plan_add(plan, direct ? 0 : rows * ly->output_size * D, train ? 0 : l, train ? L : l + 1);
+        if (rnn_params(ly) > most) most = rnn_params(ly);
+    }
+    rc = rc || ai_plan_add(plan, L * sizeof(void *), 0, L) || ai_plan_add(plan, L * sizeof(void *), 0, L)
+         || ai_plan_add(plan, train ? rows * rnn_widest_io(rnn) * D : 0, 0, L)
+         || ai_plan_add(plan, train ? rows * rnn_widest_io(rnn) * D : 0, 0, L)
+         || ai_plan_add(plan, train ? rows * rnn_widest_hidden(rnn) * D : 0, 0, L)
+         || ai_plan_add(plan, train ? most * D : 0, 0, L)
+         || ai_plan_add(plan, native ? 0 : rows * rnn->layers[0].input_size * D, 0, L)
+         || ai_plan_add(plan, rnn->precision == AI_PRECISION_BF16 ? most * D : 0, 0, L);
+    return rc ? -1 : 0;
+}
+
+static void rnn_work_bind(const rnn_t *rnn, const ai_plan_t *plan, void *base, rnn_work *w) {
+    const size_t e = 2 * rnn->num_layers;
+    w->H = ai_plan_at(plan, base, e + RNN_HP);
+    w->Y = ai_plan_at(plan, base, e + RNN_YP);
+    for (size_t l = 0; l < rnn->num_layers; l++) {
+        w->H[l] = ai_plan_at(plan, base, 2 * l);
+        w->Y[l] = ai_plan_at(plan, base, 2 * l + 1);
+    }
+    w->dY = ai_plan_at(plan, base, e + RNN_DY);
+    w->dX = ai_plan_at(plan, base, e + RNN_DX);
+    w->dH = ai_plan_at(plan, base, e + RNN_DH);
+    w->grad = ai_plan_at(plan, base, e + RNN_GRAD);
+    w->xin = ai_plan_at(plan, base, e + RNN_XIN);
+    w->wq = ai_plan_at(plan, base, e + RNN_WQ);
+}
+
+/* The layout follows the precision; a plan that cannot be redone is dropped. */
+static void rnn_replan(rnn_t *rnn) {
+    if (rnn->plan && ai_exec_grow(&rnn->plan, rnn_layout, rnn, 0, 0, 1) != 0) {
+        ai_exec_plan_free(rnn->plan);
+        rnn->plan = NULL;
+    }
+}
+
+int rnn_plan(rnn_t *rnn, ai_arena_t *arena, size_t batch, size_t seq_len) {
+    if (!rnn || rnn->num_layers == 0 || batch == 0 || seq_len == 0) return -1;
+    if (rnn->bptt_window && rnn->bptt_window < seq_len) seq_len = rnn->bptt_window;
+    return ai_exec_plan(&rnn->plan, arena, rnn_layout, rnn, batch, seq_len, 1);
+}
+
+/* Parameters are zero, or left NULL for the caller to bind when params is 0. */
+static rnn_t *rnn_shell(const size_t *input_sizes, const size_t *hidden_sizes, size_t num_layers,
+                        ai_precision_t precision, int params) {
+    rnn_t *rnn;
+    if (!input_sizes || !hidden_sizes || num_layers == 0) return NULL;
+    if (precision < AI_PRECISION_FP64 || precision > AI_PRECISION_BF16) return NULL;
+    for (size_t l = 0; l < num_layers; l++)
+        if (input_sizes[l] == 0 || hidden_sizes[l] == 0) return NULL;
+    if (input_sizes[num_layers] == 0) return NULL;
+    rnn = calloc(1, sizeof(*rnn));
+    if (!rnn) return NULL;
+    rnn->layers = calloc(num_layers, sizeof(rnn_layer_t));
+    if (!rnn->layers) {
+        free(rnn);
+        return NULL;
+    }
+    rnn->num_layers = num_layers;
+    rnn->precision = precision;
+    for (size_t l = 0; l < num_layers; l++) {
+        rnn_layer_t *ly = &rnn->layers[l];
+        ly->input_size = input_sizes[l];
+        ly->hidden_size = hidden_sizes[l];
+        ly->output_size = input_sizes[l + 1];
+    }
+    if (!params) return rnn;
+    for (size_t l = 0; l < num_layers; l++)
+        if (rnn_params_alloc(&rnn->layers[l], precision) != 0) {
+            rnn_free(rnn);
+            return NULL;
+        }
+    rnn->hidden_state = calloc(rnn_hidden_total(rnn), sizeof(double));
+    if (!rnn->hidden_state) {
+        rnn_free(rnn);
+        return NULL;
+    }
+    return rnn;
+}
+
+/* Into w, or wf when the storage is float */
+static void rnn_glorot(double *w, float *wf, size_t n, size_t fan_in, size_t fan_out, uint64_t *seed) {
+    const double a = sqrt(6.0 / (double)(fan_in + fan_out));
+    for (size_t k = 0; k < n; k++) {
+        const double u = (double)(rnn_splitmix(seed) >> 11) * 0x1.0p-53;
+        if (w) w[k] = a * (2.0 * u - 1.0);
+        else wf[k] = (float)(a * (2.0 * u - 1.0));
+    }
+}
+
+/* Weights are Glorot uniform from a fixed seed (the same in every
+   precision up to rounding); biases and the initial hidden state are
+   zero. */
+rnn_t *rnn_alloc_precision(const size_t *input_sizes, const size_t *hidden_sizes, size_t num_layers,
+                           ai_precision_t precision) {
+    rnn_t *rnn = rnn_shell(input_sizes, hidden_sizes, num_layers, precision, 1);
+    uint64_t seed = 0x484f4c4f53524e4eULL;
+    if (!rnn) return NULL;
+    for (size_t l = 0; l < num_layers; l++) {
+        rnn_layer_t *ly = &rnn->layers[l];
+        const size_t ni = ly->input_size, nh = ly->hidden_size, no = ly->output_size;
+        rnn_glorot(ly->Wxh, ly->Wxh_f, nh * ni, ni, nh, &seed);
+        rnn_glorot(ly->Whh, ly->Whh_f, nh * nh, nh, nh, &seed);
+        rnn_glorot(ly->Why, ly->Why_f, no * nh, nh, no, &seed);
+    }
+    return rnn;
+}
+
+rnn_t *rnn_alloc(const size_t *input_sizes, const size_t *hidden_sizes, size_t num_layers) {
+    return rnn_alloc_precision(input_sizes, hidden_sizes, num_layers, AI_PRECISION_FP64);
+}
+
+void rnn_free(rnn_t *rnn) {
+    if (!rnn) return;
+    if (rnn->layers && !rnn->file)
+        for (size_t l = 0; l < rnn->num_layers; l++) rnn_params_free(&rnn->layers[l]);
+    if (!rnn->file) free(rnn->hidden_state);
+    ai_model_close(rnn->file);
+    ai_exec_plan_free(rnn->plan);
+    free(rnn->layers);
+    free(rnn);
+}
+
+int rnn_set_precision(rnn_t *rnn, ai_precision_t precision) {
+    rnn_layer_t *fresh;
+    double *h0 = rnn ? rnn->hidden_state : NULL;
+    if (!rnn || precision < AI_PRECISION_FP64 || precision > AI_PRECISION_BF16) return -1;
+    if ((precision == AI_PRECISION_FP64) == (rnn->precision == AI_PRECISION_FP64)) {
+        rnn->precision = precision;
+        rnn_replan(rnn);
+        return 0;
+    }
+    /* All layers converted before any is replaced; the hidden state
+       stays double but has to leave a mapped file as well */
+    fresh = calloc(rnn->num_layers, sizeof(rnn_layer_t));
+    if (!fresh) return -1;
+    if (rnn->file) {
+        h0 = malloc(rnn_hidden_total(rnn) * sizeof(double));
+        if (h0) memcpy(h0, rnn->hidden_state, rnn_hidden_total(rnn) * sizeof(double));
+    }
+    for (size_t l = 0; l < rnn->num_layers && h0; l++) {
+        rnn_layer_t *ly = &rnn->layers[l], *nl = &fresh[l];
+        double **a[5], **na[5];
+        float **af[5], **naf[5];
+        size_t n[5];
+        nl->input_size = ly->input_size;
+        nl->hidden_size = ly->hidden_size;
+        nl->output_size = ly->output_size;
+        if (rnn_params_alloc(nl, precision) != 0) {
+            for (size_t k = 0; k <= l; k++) rnn_params_free(&fresh[k]);
+            if (rnn->file) free(h0);
+            h0 = NULL;
+            break;
+        }
+        rnn_arrays(ly, a, af, n);
+        rnn_arrays(nl, na, naf, n);
+        for (size_t k = 0; k < 5; k++)
+            for (size_t i = 0; i < n[k]; i++) {
+                if (precision == AI_PRECISION_FP64) (*na[k])[i] = (*af[k])[i];
+                else (*naf[k])[i] = (float)(*a[k])[i];
+            }
+    }
+    if (!h0) {
+        free(fresh);
+        return -1;
+    }
+    /* Converted arrays are allocated; the mapped file is no longer used */
+    for (size_t l = 0; l < rnn->num_layers; l++) {
+        rnn_layer_t *ly = &rnn->layers[l];
+        if (!rnn->file) rnn_params_free(ly);
+        *ly = fresh[l];
+    }
+    free(fresh);
+    rnn->hidden_state = h0;
+    ai_model_close(rnn->file);
+    rnn->file = NULL;
+    rnn->precision = precision;
+    rnn_replan(rnn);
+    return 0;
+}
+
+/* -------------------------------
+   Passes
+   ------------------------------- */
+
+#define RNN_REAL double
+#define RNN_FN(name) name##_f64
+#define RNN_GEMM cblas_dgemm
+#define RNN_AXPY cblas_daxpy
+#define RNN_TANH tanh
+#define RNN_P(ly, a) ((ly)->a)
+#define RNN_NATIVE 1
+#include "rnn_kernels.h"
+#undef RNN_REAL
+#undef RNN_FN
+#undef RNN_GEMM
+#undef RNN_AXPY
+#undef RNN_TANH
+#undef RNN_P
+#undef RNN_NATIVE
+
+#define RNN_REAL float
+#define RNN_FN(name) name##_f32
+#define RNN_GEMM cblas_sgemm
+#define RNN_AXPY cblas_saxpy
+#define RNN_TANH tanhf
+#define RNN_P(ly, a) ((ly)->a##_f)
+#define RNN_NATIVE 0
+#include "rnn_kernels.h"
+#undef RNN_REAL
+#undef RNN_FN
+#undef RNN_GEMM
+#undef RNN_AXPY
+#undef RNN_TANH
+#undef RNN_P
+#undef RNN_NATIVE
+
+int rnn_forward_batch(const rnn_t *rnn, const double *inputs, size_t batch, size_t seq_len, double *outputs) {
+    size_t chunk;
+    const ai_plan_t *plan;
+    ai_plan_t local;
+    rnn_work w;
+    void *base;
+    if (!rnn || rnn->num_layers == 0 || !inputs || !outputs || batch == 0 || seq_len == 0) return -1;
+    chunk = seq_len < RNN_FORWARD_CHUNK ? seq_len : RNN_FORWARD_CHUNK;
+    base = ai_exec_begin(rnn->plan, rnn_layout, rnn, AI_PASS_FORWARD, batch, chunk, 1, &local, &plan);
+    if (!base) return -1;
+    rnn_work_bind(rnn, plan, base, &w);
+    if (rnn->precision == AI_PRECISION_FP64) rnn_forward_batch_f64(rnn, &w, inputs, batch, seq_len, chunk, outputs);
+    else rnn_forward_batch_f32(rnn, &w, inputs, batch, seq_len, chunk, outputs);
+    ai_exec_end(base, &local, plan);
+    return 0;
+}
+
+void rnn_forward(const rnn_t *rnn, const double *input_seq, size_t seq_len, double *output_seq) {
+    rnn_forward_batch(rnn, input_seq, 1, seq_len, output_seq);
+}
+
+int rnn_train_batch(rnn_t *rnn, const double *inputs, const double *targets, size_t batch, size_t seq_len,
+                    double learning_rate, double *loss) {
+    size_t window;
+    double sum = 0.0;
+    const ai_plan_t *plan;
+    ai_plan_t local;
+    rnn_work w;
+    void *base;
+    if (!rnn || rnn->num_layers == 0 || !inputs || !targets || batch == 0 || seq_len == 0) return -1;
+    window = rnn->bptt_window && rnn->bptt_window < seq_len ? rnn->bptt_window : seq_len;
+    if (!ai_exec_covers(rnn->plan, batch, window, 1) && ai_exec_grow(&rnn->plan, rnn_layout, rnn, batch, window, 1) != 0)
+        return -1;
+    base = ai_exec_begin(rnn->plan, rnn_layout, rnn, AI_PASS_TRAIN, batch, window, 1, &local, &plan);
+    if (!base) return -1;
+    rnn_work_bind(rnn, plan, base, &w);
+    if (rnn->precision == AI_PRECISION_FP64)
+        rnn_train_batch_f64(rnn, &w, inputs, targets, batch, seq_len, window, learning_rate, &sum);
+    else rnn_train_batch_f32(rnn, &w, inputs, targets, batch, seq_len, window, learning_rate, &sum);
+    ai_exec_end(base, &local, plan);
+    if (loss) *loss = 0.5 * sum / (double)batch;
+    return 0;
+}
+
+void rnn_train(rnn_t *rnn, const double *input_seq, const double *target_seq, size_t seq_len, double learning_rate) {
+    rnn_train_batch(rnn, input_seq, target_seq, 1, seq_len, learning_rate, NULL);
+}
+
+/* -------------------------------
+   Files
+   ------------------------------- */
+
+int rnn_save(const rnn_t *rnn, const char *filename) {
+    uint64_t *meta;
+    ai_blob_t *blobs;
+    size_t L;
+    int rc;
+    if (!rnn || !filename || rnn->num_layers == 0) return -1;
+    L = rnn->num_layers;
+    meta = malloc((2 + 3 * L) * sizeof(uint64_t));
+    blobs = calloc(5 * L + 1, sizeof(ai_blob_t));
+    if (!meta || !blobs) {
+        free(meta);
+        free(blobs);
+        return -1;
+    }
+    meta[0] = (uint64_t)rnn->precision;
+    meta[1] = L;
+    for (size_t l = 0; l < L; l++) {
+        rnn_layer_t *ly = &rnn->layers[l];
+        const size_t rows[5] = { ly->hidden_size, ly->hidden_size, ly->output_size, ly->hidden_size, ly->output_size };
+        double **a[5];
+        float **af[5];
+        size_t n[5];
+        meta[2 + 3 * l] = ly->input_size;
+        meta[3 + 3 * l] = ly->hidden_size;
+        meta[4 + 3 * l] = ly->output_size;
+        rnn_arrays(ly, a, af, n);
+        for (size_t k = 0; k < 5; k++) {
+            ai_blob_t *b = &blobs[5 * l + k];
+            b->dtype = *a[k] ? AI_DTYPE_F64 : AI_DTYPE_F32;
+            b->rank = k < 3 ? 2 : 1;
+            b->shape[0] = rows[k];
+            b->shape[1] = n[k] / rows[k];
+            b->data = *a[k] ? (const void *)*a[k] : (const void *)*af[k];
+        }
+    }
+    blobs[5 * L].dtype = AI_DTYPE_F64;
+    blobs[5 * L].rank = 1;
+    blobs[5 * L].shape[0] = rnn_hidden_total(rnn);
+    blobs[5 * L].data = rnn->hidden_state;
+    rc = ai_model_write(filename, RNN_MAGIC, RNN_VERSION, meta, 2 + 3 * L, blobs, 5 * L + 1);
+    free(meta);
+    free(blobs);
+    return rc;
+}
+
+/* The parameters are bound to the mapped tensors, which the model then
+   owns. Version 2 has the same layout after the precision. */
+static rnn_t *rnn_load_mapped(ai_model_t *file) {
+    const size_t skip = file->version == RNN_VERSION ? 1 : 0;
+    const uint64_t *meta = file->meta;
+    ai_precision_t precision = AI_PRECISION_FP64;
+    size_t *in = NULL, *hid = NULL;
+    rnn_t *rnn = NULL;
+    size_t L = 0;
+    int ok;
+    ok = (file->version == RNN_VERSION || file->version == RNN_FP64_VERSION) && file->n_meta >= skip + 1
+         && (!skip || meta[0] <= AI_PRECISION_BF16) && meta[skip] > 0 && meta[skip] < 4096
+         && file->n_meta == skip + 1 + 3 * meta[skip] && file->count == 5 * meta[skip] + 1;
+    if (ok) {
+        if (skip) precision = (ai_precision_t)meta[0];
+        L = (size_t)meta[skip];
+        in = calloc(L + 1, sizeof(size_t));
+        hid = calloc(L, sizeof(size_t));
+        ok = in && hid;
+    }
+    for (size_t l = 0; ok && l < L; l++) {
+        const uint64_t *sh = meta + skip + 1 + 3 * l;
+        ok = sh[0] && sh[1] && sh[2] && sh[0] < ((uint64_t)1 << 24) && sh[1] < ((uint64_t)1 << 24) && sh[2] < ((uint64_t)1 << 24)
+             && (l == 0 || in[l] == sh[0]);
+        in[l] = (size_t)sh[0];
+        hid[l] = (size_t)sh[1];
+        in[l + 1] = (size_t)sh[2];
+    }
+    if (ok) {
+        rnn = rnn_shell(in, hid, L, precision, 0);
+        ok = rnn != NULL;
+    }
+    if (rnn) rnn->file = file;
+    else ai_model_close(file);
+    for (size_t l = 0; ok && l < L; l++) {
+        double **a[5];
+        float **af[5];
+        size_t n[5];
+        rnn_arrays(&rnn->layers[l], a, af, n);
+        for (size_t k = 0; k < 5 && ok; k++) {
+            if (precision == AI_PRECISION_FP64) {
+                *a[k] = ai_model_tensor(file, 5 * l + k, AI_DTYPE_F64, n[k]);
+                ok = *a[k] != NULL;
+            } else {
+                *af[k] = ai_model_tensor(file, 5 * l + k, AI_DTYPE_F32, n[k]);
+                ok = *af[k] != NULL;
+            }
+        }
+    }
+    if (ok) {
+        rnn->hidden_state = ai_model_tensor(file, 5 * L, AI_DTYPE_F64, rnn_hidden_total(rnn));
+        ok = rnn->hidden_state != NULL;
+    }
+    free(in);
+    free(hid);
+    if (!ok) {
+        rnn_free(rnn);
+        return NULL;
+    }
+    return rnn;
+}
+
+/* Version 1 */
+static rnn_t *rnn_load_stream(const char *filename) {
+    char magic[8];
+    uint32_t version;
+    uint64_t layers = 0;
+    size_t *in = NULL, *hid = NULL;
+    rnn_t *rnn = NULL;
+    long body;
+    FILE *fp;
+    int ok;
+    fp = fopen(filename, "rb");
+    if (!fp) return NULL;
+    ok = fread(magic, 1, 8, fp) == 8 && memcmp(magic, RNN_MAGIC, 8) == 0
+         && fread(&version, sizeof version, 1, fp) == 1 && version == RNN_STREAM_VERSION
+         && fread(&layers, sizeof layers, 1, fp) == 1 && layers > 0 && layers < 4096;
+    body = ok ? ftell(fp) : -1;
+    if (ok) {
+        in = calloc(layers + 1, sizeof(size_t));
+        hid = calloc(layers, sizeof(size_t));
+        ok = in && hid && body >= 0;
+    }
+    /* Shapes first (consecutive layers must chain), then the weights */
+    for (uint64_t l = 0; ok && l < layers; l++) {
+        uint64_t sh[3];
+        ok = fread(sh, sizeof sh[0], 3, fp) == 3 && sh[0] && sh[1] && sh[2]
+             && sh[0] < ((uint64_t)1 << 24) && sh[1] < ((uint64_t)1 << 24) && sh[2] < ((uint64_t)1 << 24)
+             && (l == 0 || in[l] == sh[0]);
+        if (ok) {
+            const uint64_t count = sh[1] * (sh[0] + sh[1] + sh[2] + 1) + sh[2];
+            in[l] = (size_t)sh[0];
+            hid[l] = (size_t)sh[1];
+            in[l + 1] = (size_t)sh[2];
+            ok = fseek(fp, (long)(count * sizeof(double)), SEEK_CUR) == 0;
+        }
+    }
+    if (ok) {
+        rnn = rnn_shell(in, hid, (size_t)layers, AI_PRECISION_FP64, 1);
+        ok = rnn != NULL && fseek(fp, body, SEEK_SET) == 0;
+    }
+    for (size_t l = 0; ok && l < rnn->num_layers; l++) {
+        rnn_layer_t *ly = &rnn->layers[l];
+        const size_t ni = ly->input_size, nh = ly->hidden_size, no = ly->output_size;
+        ok = fseek(fp, 3 * sizeof(uint64_t), SEEK_CUR) == 0
+             && fread(ly->Wxh, sizeof(double), nh * ni, fp) == nh * ni
+             && fread(ly->Whh, sizeof(double), nh * nh, fp) == nh * nh
+             && fread(ly->Why, sizeof(double), no * nh, fp) == no * nh
+             && fread(ly->bh, sizeof(double), nh, fp) == nh
+             && fread(ly->by, sizeof(double), no, fp) == no;
+    }
+    ok = ok && fread(rnn->hidden_state, sizeof(double), rnn_hidden_total(rnn), fp) == rnn_hidden_total(rnn);
+    fclose(fp);
+    free(in);
+    free(hid);
+    if (!ok) {
+        rnn_free(rnn);
+        return NULL;
+    }
+    return rnn;
+}
+rnn_t *rnn_load(const char *filename) {
+    ai_model_t *file;
+    if (!filename) return NULL;
+    file = ai_model_open(filename, RNN_MAGIC);
+    return file ? rnn_load_mapped(file) : rnn_load_stream(filename);
+}
+
+rnn_t *rnn_load_precision(const char *filename, ai_precision_t precision) {
+    rnn_t *rnn = rnn_load(filename);
+    if (rnn && rnn->precision != precision && rnn_set_precision(rnn, precision) != 0) {
+        rnn_free(rnn);
+        return NULL;
+    }
+    return rnn;
+}
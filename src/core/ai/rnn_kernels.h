@@ -0,0 +1,225 @@
+/* rnn_kernels.h - Precision-generic RNN passes for HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+   ----------------------------------------------------------------------
+   Included by rnn.c once per compute type, with
+     RNN_REAL       double or float
+     RNN_FN(name)   name with the type suffix
+     RNN_GEMM       cblas_dgemm or cblas_sgemm
+     RNN_AXPY       cblas_daxpy or cblas_saxpy
+     RNN_TANH       tanh or tanhf
+     RNN_P(ly, a)   the layer's parameter array a (Wxh ... by) of that type
+     RNN_NATIVE     1 when RNN_REAL is double (API buffers used in place)
+   bf16 is only ever set for float.
+*/
+
+static void RNN_FN(rnn_round)(RNN_REAL *x, size_t n, int bf16) {
+    if (bf16)
+        for (size_t k = 0; k < n; k++) x[k] = (RNN_REAL)ai_bf16_round((float)x[k]);
+}
+
+/* Wxh, Whh, Why as the GEMMs see them: the stored arrays, or bf16
+   copies one after the other in wq. */
+static void RNN_FN(rnn_weights)(const rnn_layer_t *ly, RNN_REAL *wq, int bf16, const RNN_REAL **W) {
+    const size_t ni = ly->input_size, nh = ly->hidden_size, no = ly->output_size;
+    const RNN_REAL *src[3] = { RNN_P(ly, Wxh), RNN_P(ly, Whh), RNN_P(ly, Why) };
+    const size_t n[3] = { nh * ni, nh * nh, no * nh };
+    for (size_t k = 0; k < 3; k++) {
+        W[k] = src[k];
+        if (!bf16) continue;
+        for (size_t i = 0; i < n[k]; i++) wq[i] = (RNN_REAL)ai_bf16_round((float)src[k][i]);
+        W[k] = wq;
+        wq += n[k];
+    }
+}
+
+/* Y (rows x out) = X (rows x in) W^T + b */
+static void RNN_FN(rnn_linear)(const RNN_REAL *X, size_t rows, size_t in, const RNN_REAL *W, const RNN_REAL *b, size_t out,
+                               RNN_REAL *Y) {
+    for (size_t r = 0; r < rows; r++) memcpy(Y + r * out, b, out * sizeof(RNN_REAL));
+    RNN_GEMM(CblasRowMajor, CblasNoTrans, CblasTrans, (int)rows, (int)out, (int)in,
+             1, X, (int)in, W, (int)in, 1, Y, (int)out);
+}
+
+/* steps x batch rows through every layer. Slot 0 of each H[l] holds
+   the hidden state to start from; on return the last slot holds the
+   one to continue with. The top layer writes to out when set. */
+static void RNN_FN(rnn_block_forward)(const rnn_t *rnn, const RNN_REAL *x, size_t steps, size_t batch, void *const *H,
+                                      void *const *Y, RNN_REAL *out, RNN_REAL *wq, int bf16) {
+    const size_t rows = steps * batch;
+    for (size_t l = 0; l < rnn->num_layers; l++) {
+        const rnn_layer_t *ly = &rnn->layers[l];
+        const size_t nh = ly->hidden_size;
+        const RNN_REAL *W[3];
+        RNN_REAL *h = H[l], *y = l + 1 == rnn->num_layers && out ? out : (RNN_REAL *)Y[l];
+        RNN_FN(rnn_weights)(ly, wq, bf16, W);
+        RNN_FN(rnn_linear)(x, rows, ly->input_size, W[0], RNN_P(ly, bh), nh, h + batch * nh);
+        for (size_t t = 0; t < steps; t++) {
+            RNN_REAL *cur = h + (t + 1) * batch * nh;
+            RNN_GEMM(CblasRowMajor, CblasNoTrans, CblasTrans, (int)batch, (int)nh, (int)nh,
+                     1, cur - batch * nh, (int)nh, W[1], (int)nh, 1, cur, (int)nh);
+            for (size_t k = 0; k < batch * nh; k++) cur[k] = RNN_TANH(cur[k]);
+            RNN_FN(rnn_round)(cur, batch * nh, bf16);
+        }
+        RNN_FN(rnn_linear)(h + batch * nh, rows, nh, W[2], RNN_P(ly, by), ly->output_size, y);
+        if (l + 1 < rnn->num_layers) RNN_FN(rnn_round)(y, rows * ly->output_size, bf16);
+        x = y;
+    }
+}
+
+/* Slot 0 of every layer from rnn->hidden_state. */
+static void RNN_FN(rnn_start)(const rnn_t *rnn, void *const *H, size_t batch, int bf16) {
+    const double *h0 = rnn->hidden_state;
+    for (size_t l = 0; l < rnn->num_layers; l++) {
+        const size_t nh = rnn->layers[l].hidden_size;
+        RNN_REAL *h = H[l];
+        for (size_t b = 0; b < batch; b++)
+            for (size_t k = 0; k < nh; k++) h[b * nh + k] = (RNN_REAL)h0[k];
+        RNN_FN(rnn_round)(h, batch * nh, bf16);
+        h0 += nh;
+    }
+}
+
+/* Last slot of a block of steps to slot 0, to continue the sequence. */
+static void RNN_FN(rnn_carry)(const rnn_t *rnn, void *const *H, size_t steps, size_t batch) {
+    for (size_t l = 0; l < rnn->num_layers; l++) {
+        const size_t n = batch * rnn->layers[l].hidden_size;
+        RNN_REAL *h = H[l];
+        memmove(h, h + steps * n, n * sizeof(RNN_REAL));
+    }
+}
+
+#if !RNN_NATIVE
+static void RNN_FN(rnn_load_input)(const double *src, size_t n, RNN_REAL *dst, int bf16) {
+    for (size_t k = 0; k < n; k++) dst[k] = bf16 ? (RNN_REAL)ai_bf16_round((float)src[k]) : (RNN_REAL)src[k];
+}
+#endif
+
+static void RNN_FN(rnn_forward_batch)(const rnn_t *rnn, const rnn_work *w, const double *inputs, size_t batch,
+                                      size_t seq_len, size_t chunk, double *outputs) {
+    const size_t n_in = rnn->layers[0].input_size, n_out = rnn->layers[rnn->num_layers - 1].output_size;
+    const int bf16 = rnn->precision == AI_PRECISION_BF16;
+    RNN_FN(rnn_start)(rnn, w->H, batch, bf16);
+    for (size_t t0 = 0; t0 < seq_len; t0 += chunk) {
+        const size_t steps = seq_len - t0 < chunk ? seq_len - t0 : chunk;
+        if (t0) RNN_FN(rnn_carry)(rnn, w->H, chunk, batch);
+#if RNN_NATIVE
+        RNN_FN(rnn_block_forward)(rnn, inputs + t0 * batch * n_in, steps, batch, w->H, w->Y,
+                                  outputs + t0 * batch * n_out, w->wq, bf16);
+#else
+        {
+            const RNN_REAL *y = w->Y[rnn->num_layers - 1];
+            RNN_FN(rnn_load_input)(inputs + t0 * batch * n_in, steps * batch * n_in, w->xin, bf16);
+            RNN_FN(rnn_block_forward)(rnn, w->xin, steps, batch, w->H, w->Y, NULL, w->wq, bf16);
+            for (size_t k = 0; k < steps * batch * n_out; k++) outputs[t0 * batch * n_out + k] = (double)y[k];
+        }
+#endif
+    }
+}
+
+/* Backward of one window and the SGD step, top layer first. w->dY
+   holds the error at the network output (already / batch). x is the
+   window's input. */
+static void RNN_FN(rnn_block_backward)(rnn_t *rnn, const rnn_work *w, const RNN_REAL *x, size_t steps, size_t batch,
+                                       double lr, int bf16) {
+    const size_t rows = steps * batch;
+    RNN_REAL *dY = w->dY, *dX = w->dX;
+    for (size_t l = rnn->num_layers; l-- > 0;) {
+        rnn_layer_t *ly = &rnn->layers[l];
+        const size_t ni = ly->input_size, nh = ly->hidden_size, no = ly->output_size;
+        const RNN_REAL *h = w->H[l], *hs = h + batch * nh, *in = l ? (const RNN_REAL *)w->Y[l - 1] : x;
+        RNN_REAL *gWxh = w->grad, *gWhh = gWxh + nh * ni, *gWhy = gWhh + nh * nh, *gbh = gWhy + no * nh, *gby = gbh + nh;
+        RNN_REAL *dH = w->dH, *tmp;
+        const RNN_REAL *W[3];
+
+        /* The weights of this step, before the update */
+        RNN_FN(rnn_weights)(ly, w->wq, bf16, W);
+        RNN_FN(rnn_round)(dY, rows * no, bf16);
+
+        /* Output projection */
+        RNN_GEMM(CblasRowMajor, CblasTrans, CblasNoTrans, (int)no, (int)nh, (int)rows,
+                 1, dY, (int)no, hs, (int)nh, 0, gWhy, (int)nh);
+        memset(gby, 0, no * sizeof(RNN_REAL));
+        for (size_t r = 0; r < rows; r++)
+            for (size_t j = 0; j < no; j++) gby[j] += dY[r * no + j];
+        RNN_GEMM(CblasRowMajor, CblasNoTrans, CblasNoTrans, (int)rows, (int)nh, (int)no,
+                 1, dY, (int)no, W[2], (int)nh, 0, dH, (int)nh);
+
+        /* Through time: dH_t becomes dZ_t */
+        for (size_t t = steps; t-- > 0;) {
+            RNN_REAL *dz = dH + t * batch * nh;
+            const RNN_REAL *ht = hs + t * batch * nh;
+            if (t + 1 < steps)
+                RNN_GEMM(CblasRowMajor, CblasNoTrans, CblasNoTrans, (int)batch, (int)nh, (int)nh,
+                         1, dz + batch * nh, (int)nh, W[1], (int)nh, 1, dz, (int)nh);
+            for (size_t k = 0; k < batch * nh; k++) dz[k] *= 1 - ht[k] * ht[k];
+            RNN_FN(rnn_round)(dz, batch * nh, bf16);
+        }
+
+        RNN_GEMM(CblasRowMajor, CblasTrans, CblasNoTrans, (int)nh, (int)nh, (int)rows,
+                 1, dH, (int)nh, h, (int)nh, 0, gWhh, (int)nh);
+        RNN_GEMM(CblasRowMajor, CblasTrans, CblasNoTrans, (int)nh, (int)ni, (int)rows,
+                 1, dH, (int)nh, in, (int)ni, 0, gWxh, (int)ni);
+        memset(gbh, 0, nh * sizeof(RNN_REAL));
+        for (size_t r = 0; r < rows; r++)
+            for (size_t j = 0; j < nh; j++) gbh[j] += dH[r * nh + j];
+        if (l > 0)
+            RNN_GEMM(CblasRowMajor, CblasNoTrans, CblasNoTrans, (int)rows, (int)ni, (int)nh,
+                     1, dH, (int)nh, W[0], (int)ni, 0, dX, (int)ni);
+
+        RNN_AXPY((int)(nh * ni), (RNN_REAL)-lr, gWxh, 1, RNN_P(ly, Wxh), 1);
+        RNN_AXPY((int)(nh * nh), (RNN_REAL)-lr, gWhh, 1, RNN_P(ly, Whh), 1);
+        RNN_AXPY((int)(no * nh), (RNN_REAL)-lr, gWhy, 1, RNN_P(ly, Why), 1);
+        RNN_AXPY((int)nh, (RNN_REAL)-lr, gbh, 1, RNN_P(ly, bh), 1);
+        RNN_AXPY((int)no, (RNN_REAL)-lr, gby, 1, RNN_P(ly, by), 1);
+
+        tmp = dY;
+        dY = dX;
+        dX = tmp;
+    }
+}
+
+/* Windows of truncated BPTT over the whole sequence; sum gets the
+   squared error of every step. */
+static void RNN_FN(rnn_train_batch)(rnn_t *rnn, const rnn_work *w, const double *inputs, const double *targets,
+                                    size_t batch, size_t seq_len, size_t window, double lr, double *sum) {
+    const size_t n_in = rnn->layers[0].input_size, n_out = rnn->layers[rnn->num_layers - 1].output_size;
+    const int bf16 = rnn->precision == AI_PRECISION_BF16;
+    const RNN_REAL *y = w->Y[rnn->num_layers - 1];
+    RNN_REAL *dY = w->dY;
+    RNN_FN(rnn_start)(rnn, w->H, batch, bf16);
+    for (size_t t0 = 0; t0 < seq_len; t0 += window) {
+        const size_t steps = seq_len - t0 < window ? seq_len - t0 : window;
+        const double *tg = targets + t0 * batch * n_out;
+        const RNN_REAL *x;
+#if RNN_NATIVE
+        x = inputs + t0 * batch * n_in;
+#else
+        RNN_FN(rnn_load_input)(inputs + t0 * batch * n_in, steps * batch * n_in, w->xin, bf16);
+        x = w->xin;
+#endif
+        if (t0) RNN_FN(rnn_carry)(rnn, w->H, window, batch);
+        RNN_FN(rnn_block_forward)(rnn, x, steps, batch, w->H, w->Y, NULL, w->wq, bf16);
+        for (size_t k = 0; k < steps * batch * n_out; k++) {
+            const double e = (double)y[k] - tg[k];
+            dY[k] = (RNN_REAL)(e / (double)batch);
+            *sum += e * e;
+        }
+        RNN_FN(rnn_block_backward)(rnn, w, x, steps, batch, lr, bf16);
+    }
+}
@@ -0,0 +1,683 @@
+/* transformer.c - Transformer Neural Network for HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+   ----------------------------------------------------------------------
+   The projections of a whole batch are dgemm calls (positions as rows).
+   Attention is causal, with scores scaled by 1/sqrt(d_head), and fused:
+   each (sequence, head) pair walks TR_BLOCK_Q query rows at a time over
+   TR_BLOCK_K key rows, keeping a running max and sum per row (online
+   softmax), so the seq_len x seq_len probabilities never exist. A tile
+   pair is 64 x 64 doubles (32 KiB), which stays in L1/L2 together with
+   the Q, K, V rows it reads. The pairs run in parallel.
+
+   Training keeps every layer's activations plus the log-sum-exp of each
+   attention row (O(seq_len) per head); the backward pass recomputes the
+   probability tiles from it, the same way, and then takes one SGD step.
+
+   A session step pushes a single row through the same layers: its key
+   and value go into the layer's ring, and its query attends over the
+   ring, which holds exactly the positions a causal forward would see
+   (or the last `window` of them).
+
+   The passes are written once in transformer_kernels.h and
+   instantiated for double (FP64) and float (FP32, BF16).
+
+   Files are model containers (ai_model.h), "HOLOSTRF" version 3: meta
+   precision, layers and per layer d_model, num_heads, d_ff, then per
+   layer the arrays Wq, Wk, Wv, Wo, Wff1, Wff2, bq, bk, bv, bo, bff1,
+   bff2 as doubles (FP64) or floats (FP32, BF16). A loaded model
+   computes on the mapped arrays. Version 2 was the same container
+   without the precision (FP64). Version 1 was a stream: "HOLOSTRF",
+   u32 version, u64 layers, then per layer the u64 shape and the arrays;
+   it is still read (into allocated arrays).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <gsl/gsl_cblas.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "core/ai/transformer.h"
+#include "core/trace/trace.h"
+
+#define TR_MAGIC "HOLOSTRF"
+#define TR_VERSION 3u
+#define TR_FP64_VERSION 2u      /* container before the precision */
+#define TR_STREAM_VERSION 1u    /* last version before the container */
+#define TR_BLOCK_Q 64   /* query rows per attention tile */
+#define TR_BLOCK_K 64   /* key rows per attention tile */
+
+/* -------------------------------
+   Allocation
+   ------------------------------- */
+
+static uint64_t tr_splitmix(uint64_t *s) {
+    uint64_t z = (*s += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/* Sizes of the 12 arrays of a layer, in file order */
+static void tr_sizes(const transformer_layer_t *ly, size_t *sizes) {
+    const size_t d = ly->d_model, f = ly->d_ff;
+    const size_t n[12] = { d * d, d * d, d * d, d * d, f * d, d * f, d, d, d, d, f, d };
+    memcpy(sizes, n, sizeof n);
+}
+
+/* Weight arrays of a layer, in file order, with their sizes. */
+static size_t tr_arrays(transformer_layer_t *ly, double ***arrays, size_t *sizes) {
+    double **a[12] = { &ly->Wq, &ly->Wk, &ly->Wv, &ly->Wo, &ly->Wff1, &ly->Wff2,
+                       &ly->bq, &ly->bk, &ly->bv, &ly->bo, &ly->bff1, &ly->bff2 };
+    memcpy(arrays, a, sizeof a);
+    tr_sizes(ly, sizes);
+    return 12;
+}
+
+/* The same for the float storage */
+static size_t tr_arrays_f(transformer_layer_t *ly, float ***arrays, size_t *sizes) {
+    float **a[12] = { &ly->Wq_f, &ly->Wk_f, &ly->Wv_f, &ly->Wo_f, &ly->Wff1_f, &ly->Wff2_f,
+                      &ly->bq_f, &ly->bk_f, &ly->bv_f, &ly->bo_f, &ly->bff1_f, &ly->bff2_f };
+    memcpy(arrays, a, sizeof a);
+    tr_sizes(ly, sizes);
+    return 12;
+}
+
+static void tr_layer_free(transformer_layer_t *ly) {
+    double **a[12];
+    float **af[12];
+    size_t n[12];
+    tr_arrays(ly, a, n);
+    tr_arrays_f(ly, af, n);
+    for (size_t k = 0; k < 12; k++) {
+        free(*a[k]);
+        free(*af[k]);
+        *a[k] = NULL;
+        *af[k] = NULL;
+    }
+}
+
+/* Weight arrays of the storage type of precision, zeroed. */
+static int tr_layer_alloc(transformer_layer_t *ly, ai_precision_t precision) {
+    double **a[12];
+    float **af[12];
+    size_t n[12];
+    tr_arrays(ly, a, n);
+    tr_arrays_f(ly, af, n);
+    for (size_t k = 0; k < 12; k++) {
+        if (precision == AI_PRECISION_FP64) *a[k] = calloc(n[k], sizeof(double));
+        else *af[k] = calloc(n[k], sizeof(float));
+        if (!*a[k] && !*af[k]) return -1;
+    }
+    return 0;
+}
+
+/* Weights are zero, or left NULL for the caller to bind when params is 0. */
+static transformer_t *tr_shell(const size_t *d_models, const size_t *num_heads, const size_t *d_ffs, size_t num_layers,
+                               ai_precision_t precision, int params) {
+    transformer_t *tr;
+    if (!d_models || !num_heads || !d_ffs || num_layers == 0) return NULL;
+    if (precision < AI_PRECISION_FP64 || precision > AI_PRECISION_BF16) return NULL;
+    for (size_t l = 0; l < num_layers; l++)
+        if (d_models[l] == 0 || d_models[l] != d_models[0] || num_heads[l] == 0 || d_models[l] % num_heads[l] || d_ffs[l] == 0)
+            return NULL;
+    tr = calloc(1, sizeof(*tr));
+    if (!tr) return NULL;
+    tr->layers = calloc(num_layers, sizeof(transformer_layer_t));
+    if (!tr->layers) {
+        free(tr);
+        return NULL;
+    }
+    tr->num_layers = num_layers;
+    tr->precision = precision;
+    for (size_t l = 0; l < num_layers; l++) {
+        transformer_layer_t *ly = &tr->layers[l];
+        ly->d_model = d_models[l];
+        ly->num_heads = num_heads[l];
+        ly->d_ff = d_ffs[l];
+        if (params && tr_layer_alloc(ly, precision) != 0) {
+            transformer_free(tr);
+            return NULL;
+        }
+    }
+    return tr;
+}
+
+/* Weights are Glorot uniform from a fixed seed (the same in every
+   precision up to rounding), biases zero. */
+transformer_t *transformer_alloc_precision(const size_t *d_models, const size_t *num_heads, const size_t *d_ffs,
+                                           size_t num_layers, ai_precision_t precision) {
+    transformer_t *tr = tr_shell(d_models, num_heads, d_ffs, num_layers, precision, 1);
+    uint64_t seed = 0x484f4c4f53545246ULL;
+    if (!tr) return NULL;
+    for (size_t l = 0; l < num_layers; l++) {
+        transformer_layer_t *ly = &tr->layers[l];
+        double **a[12];
+        float **af[12];
+        size_t n[12];
+        tr_arrays(ly, a, n);
+        tr_arrays_f(ly, af, n);
+        for (size_t k = 0; k < 6; k++) {
+            const size_t fan = k == 4 ? ly->d_model + ly->d_ff : k == 5 ? ly->d_ff + ly->d_model : 2 * ly->d_model;
+            const double r = sqrt(6.0 / (double)fan);
+            for (size_t i = 0; i < n[k]; i++) {
+                const double u = (double)(tr_splitmix(&seed) >> 11) * 0x1.0p-53;
+                if (*a[k]) (*a[k])[i] = r * (2.0 * u - 1.0);
+                else (*af[k])[i] = (float)(r * (2.0 * u - 1.0));
+            }
+        }
+    }
+    return tr;
+}
+
+transformer_t *transformer_alloc(const size_t *d_models, const size_t *num_heads, const size_t *d_ffs, size_t num_layers) {
+    return transformer_alloc_precision(d_models, num_heads, d_ffs, num_layers, AI_PRECISION_FP64);
+}
+
+void transformer_free(transformer_t *tr) {
+    if (!tr) return;
+    if (tr->layers && !tr->file)
+        for (size_t l = 0; l < tr->num_layers; l++) tr_layer_free(&tr->layers[l]);
+    ai_model_close(tr->file);
+    ai_exec_plan_free(tr->plan);
+    free(tr->layers);
+    free(tr);
+}
+
+/* -------------------------------
+   Plans
+   ------------------------------- */
+
+static int tr_threads(int n_threads) {
+    if (n_threads < 0) {
+#ifdef _OPENMP
+        return omp_get_max_threads();
+#else
+        return 1;
+#endif
+    }
+    return n_threads > 0 ? n_threads : 1;
+}
+
+static int tr_thread_id(void) {
+#ifdef _OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+}
+
+/* Attention scratch per thread, in elements of the compute type */
+#define TR_SCRATCH (2 * TR_BLOCK_Q * TR_BLOCK_K + 2 * TR_BLOCK_Q)
+
+typedef struct {
+    const void *X;                       /* Layer input */
+    void *Q, *K, *V, *A, *X1, *Z;        /* Projections, heads, residual, post-ReLU */
+    void *lse;                           /* heads x rows, for the backward pass */
+} tr_cache;
+
+/* Tensors of a layer's cache, in declaration order */
+enum { TR_Q, TR_K, TR_V, TR_A, TR_X1, TR_Z, TR_LSE, TR_PER_LAYER };
+
+/* Forward tensors after the 8 per layer */
+enum { TR_FWD_XIN, TR_FWD_WQ, TR_FWD_EXTRA };
+
+/* Backward temporaries of the training pass, after the layers */
+enum { TR_OUT, TR_DY, TR_DX1, TR_DA, TR_DQ, TR_DK, TR_DV, TR_DZ, TR_GRAD, TR_SCRATCH_T, TR_CACHES, TR_WQ, TR_TRAIN_EXTRA };
+
+static size_t tr_params(const transformer_layer_t *ly) {
+    return 4 * ly->d_model * ly->d_model + 2 * ly->d_model * ly->d_ff + 5 * ly->d_model + ly->d_ff;
+}
+
+static size_t tr_most_params(const transformer_t *tr) {
+    size_t g = 0;
+    for (size_t l = 0; l < tr->num_layers; l++)
+        if (tr_params(&tr->layers[l]) > g) g = tr_params(&tr->layers[l]);
+    return g;
+}
+
+static size_t tr_widest_ff(const transformer_t *tr) {
+    size_t f = 0;
+    for (size_t l = 0; l < tr->num_layers; l++)
+        if (tr->layers[l].d_ff > f) f = tr->layers[l].d_ff;
+    return f;
+}
+
+/* Forward: layer l runs steps 5l (projections) to 5l + 4 (its output),
+   and its output lives until the next layer's residual (5l + 7). Training:
+   layer l runs forward at step l and backward at step 2L - l, and its
+   cache lives from one to the other. Float models convert the input
+   into a tensor of its own and keep the top layer's output for the
+   conversion back. */
+static int tr_layout(const void *model, ai_pass_t pass, size_t batch, size_t n, int nt, ai_plan_t *plan) {
+    const transformer_t *tr = model;
+    const size_t L = tr->num_layers, d = tr->layers[0].d_model, rows = batch * n;
+    const size_t D = tr->precision == AI_PRECISION_FP64 ? sizeof(double) : sizeof(float);
+    const size_t scratch = (size_t)nt * TR_SCRATCH * D;
+    const size_t wq = tr->precision == AI_PRECISION_BF16 ? tr_most_params(tr) * D : 0;
+    const int native = tr->precision == AI_PRECISION_FP64;
+    int rc = 0;
+    if (pass == AI_PASS_FORWARD) {
+        for (size_t l = 0; l < L && rc == 0; l++) {
+            const transformer_layer_t *ly = &tr->layers[l];
+            const size_t s = 5 * l;
+            rc = ai_plan_add(plan, rows * d * D, s, s + 1) || ai_plan_add(plan, rows * d * D, s, s + 1)
+                 || ai_plan_add(plan, rows * d * D, s, s + 1) || ai_plan_add(plan, rows * d * D, s + 1, s + 2)
+                 || ai_plan_add(plan, rows * d * D, s + 2, s + 4) || ai_plan_add(plan, rows * ly->d_ff * D, s + 3, s + 4)
+                 || ai_plan_add(plan, scratch, s + 1, s + 1)
+                 || ai_plan_add(plan, l + 1 < L || !native ? rows * d * D : 0, s + 4, s + 7);
+        }
+        rc = rc || ai_plan_add(plan, native ? 0 : rows * d * D, 0, 2) || ai_plan_add(plan, wq, 0, 5 * L);
+        return rc ? -1 : 0;
+    }
+    for (size_t l = 0; l < L && rc == 0; l++) {
+        const transformer_layer_t *ly = &tr->layers[l];
+        const size_t first = l ? l - 1 : 0, last = 2 * L - l;
+        rc = ai_plan_add(plan, l || !native ? n * d * D : 0, first, last);
+        for (int k = 0; k < TR_PER_LAYER && rc == 0; k++) {
+            const size_t w = k == TR_Z ? ly->d_ff : k == TR_LSE ? ly->num_heads : d;
+            rc = ai_plan_add(plan, n * w * D, l, last);
+        }
+    }
+    for (int k = 0; k < TR_TRAIN_EXTRA && rc == 0; k++) {
+        const size_t bytes = k == TR_DZ ? n * tr_widest_ff(tr) * D : k == TR_GRAD ? tr_most_params(tr) * D
+                             : k == TR_SCRATCH_T ? scratch : k == TR_CACHES ? L * sizeof(tr_cache) : k == TR_WQ ? wq
+                             : n * d * D;
+        const size_t first = k == TR_OUT ? L - 1 : k == TR_GRAD ? L + 1
+                             : k == TR_SCRATCH_T || k == TR_CACHES || k == TR_WQ ? 0 : L;
+        rc = ai_plan_add(plan, bytes, first, k == TR_OUT ? L : 2 * L);
+    }
+    return rc ? -1 : 0;
+}
+
+/* The layout follows the precision; a plan that cannot be redone is dropped. */
+static void tr_replan(transformer_t *tr) {
+    if (tr->plan && ai_exec_grow(&tr->plan, tr_layout, tr, 0, 0, tr_threads(tr->n_threads)) != 0) {
+        ai_exec_plan_free(tr->plan);
+        tr->plan = NULL;
+    }
+}
+
+int transformer_plan(transformer_t *tr, ai_arena_t *arena, size_t batch, size_t seq_len) {
+    if (!tr || tr->num_layers == 0 || batch == 0 || seq_len == 0) return -1;
+    return ai_exec_plan(&tr->plan, arena, tr_layout, tr, batch, seq_len, tr_threads(tr->n_threads));
+}
+
+int transformer_set_precision(transformer_t *tr, ai_precision_t precision) {
+    transformer_layer_t *fresh;
+    if (!tr || precision < AI_PRECISION_FP64 || precision > AI_PRECISION_BF16) return -1;
+    if ((precision == AI_PRECISION_FP64) == (tr->precision == AI_PRECISION_FP64)) {
+        tr->precision = precision;
+        tr_replan(tr);
+        return 0;
+    }
+    /* All layers converted before any is replaced */
+    fresh = calloc(tr->num_layers, sizeof(transformer_layer_t));
+    if (!fresh) return -1;
+    for (size_t l = 0; l < tr->num_layers; l++) {
+        transformer_layer_t *ly = &tr->layers[l], *nl = &fresh[l];
+        double **a[12], **na[12];
+        float **af[12], **naf[12];
+        size_t n[12];
+        nl->d_model = ly->d_model;
+        nl->num_heads = ly->num_heads;
+        nl->d_ff = ly->d_ff;
+        if (tr_layer_alloc(nl, precision) != 0) {
+            for (size_t k = 0; k <= l; k++) tr_layer_free(&fresh[k]);
+            free(fresh);
+            return -1;
+        }
+        tr_arrays(ly, a, n);
+        tr_arrays_f(ly, af, n);
+        tr_arrays(nl, na, n);
+        tr_arrays_f(nl, naf, n);
+        for (size_t k = 0; k < 12; k++)
+            for (size_t i = 0; i < n[k]; i++) {
+                if (precision == AI_PRECISION_FP64) (*na[k])[i] = (*af[k])[i];
+                else (*naf[k])[i] = (float)(*a[k])[i];
+            }
+    }
+    /* Converted arrays are allocated; the mapped file is no longer used */
+    for (size_t l = 0; l < tr->num_layers; l++) {
+        if (!tr->file) tr_layer_free(&tr->layers[l]);
+        tr->layers[l] = fresh[l];
+    }
+    free(fresh);
+    ai_model_close(tr->file);
+    tr->file = NULL;
+    tr->precision = precision;
+    tr_replan(tr);
+    return 0;
+}
+
+/* -------------------------------
+   Passes
+   ------------------------------- */
+
+#define TR_REAL double
+#define TR_FN(name) name##_f64
+#define TR_GEMM cblas_dgemm
+#define TR_DOT cblas_ddot
+#define TR_SCAL cblas_dscal
+#define TR_AXPY cblas_daxpy
+#define TR_EXP exp
+#define TR_LOG log
+#define TR_P(ly, a) ((ly)->a)
+#define TR_NATIVE 1
+#include "transformer_kernels.h"
+#undef TR_REAL
+#undef TR_FN
+#undef TR_GEMM
+#undef TR_DOT
+#undef TR_SCAL
+#undef TR_AXPY
+#undef TR_EXP
+#undef TR_LOG
+#undef TR_P
+#undef TR_NATIVE
+
+#define TR_REAL float
+#define TR_FN(name) name##_f32
+#define TR_GEMM cblas_sgemm
+#define TR_DOT cblas_sdot
+#define TR_SCAL cblas_sscal
+#define TR_AXPY cblas_saxpy
+#define TR_EXP expf
+#define TR_LOG logf
+#define TR_P(ly, a) ((ly)->a##_f)
+#define TR_NATIVE 0
+#include "transformer_kernels.h"
+#undef TR_REAL
+#undef TR_FN
+#undef TR_GEMM
+#undef TR_DOT
+#undef TR_SCAL
+#undef TR_AXPY
+#undef TR_EXP
+#undef TR_LOG
+#undef TR_P
+#undef TR_NATIVE
+
+int transformer_forward_batch(const transformer_t *tr, const double *inputs, size_t batch, size_t seq_len, double *outputs) {
+    const ai_plan_t *plan;
+    ai_plan_t local;
+    void *base;
+    int nt;
+    if (!tr || tr->num_layers == 0 || !inputs || !outputs || batch == 0 || seq_len == 0) return -1;
+    nt = tr_threads(tr->n_threads);
+    base = ai_exec_begin(tr->plan, tr_layout, tr, AI_PASS_FORWARD, batch, seq_len, nt, &local, &plan);
+    if (!base) return -1;
+    if (tr->precision == AI_PRECISION_FP64) tr_forward_batch_f64(tr, nt, plan, base, inputs, batch, seq_len, outputs);
+    else tr_forward_batch_f32(tr, nt, plan, base, inputs, batch, seq_len, outputs);
+    ai_exec_end(base, &local, plan);
+    return 0;
+}
+
+void transformer_forward(const transformer_t *tr, const double *input_seq, size_t seq_len, double *output_seq) {
+    transformer_forward_batch(tr, input_seq, 1, seq_len, output_seq);
+}
+
+void transformer_train(transformer_t *tr, const double *input_seq, const double *target_seq, size_t seq_len, double learning_rate) {
+    const ai_plan_t *plan;
+    ai_plan_t local;
+    void *base;
+    int nt;
+    if (!tr || tr->num_layers == 0 || !input_seq || !target_seq || seq_len == 0) return;
+    nt = tr_threads(tr->n_threads);
+    if (!ai_exec_covers(tr->plan, 1, seq_len, nt) && ai_exec_grow(&tr->plan, tr_layout, tr, 1, seq_len, nt) != 0) return;
+    base = ai_exec_begin(tr->plan, tr_layout, tr, AI_PASS_TRAIN, 1, seq_len, nt, &local, &plan);
+    if (!base) return;
+    if (tr->precision == AI_PRECISION_FP64) tr_train_f64(tr, nt, plan, base, input_seq, target_seq, seq_len, learning_rate);
+    else tr_train_f32(tr, nt, plan, base, input_seq, target_seq, seq_len, learning_rate);
+    ai_exec_end(base, &local, plan);
+}
+
+/* -------------------------------
+   Sessions
+   ------------------------------- */
+
+transformer_session_t *transformer_session_alloc(const transformer_t *tr, size_t window) {
+    transformer_session_t *s;
+    size_t d, elem;
+    if (!tr || tr->num_layers == 0 || window == 0) return NULL;
+    d = tr->layers[0].d_model;
+    elem = tr->precision == AI_PRECISION_FP64 ? sizeof(double) : sizeof(float);
+    s = calloc(1, sizeof(*s));
+    if (!s) return NULL;
+    s->tr = tr;
+    s->window = window;
+    s->precision = tr->precision;
+    s->keys = malloc(tr->num_layers * window * d * elem);
+    s->values = malloc(tr->num_layers * window * d * elem);
+    s->work = malloc((7 * d + tr_widest_ff(tr) + window + (tr->precision == AI_PRECISION_BF16 ? tr_most_params(tr) : 0))
+                     * elem);
+    if (!s->keys || !s->values || !s->work) {
+        transformer_session_free(s);
+        return NULL;
+    }
+    return s;
+}
+
+void transformer_session_free(transformer_session_t *s) {
+    if (!s) return;
+    free(s->keys);
+    free(s->values);
+    free(s->work);
+    free(s);
+}
+
+void transformer_session_reset(transformer_session_t *s) {
+    if (!s) return;
+    s->length = 0;
+    s->head = 0;
+    s->position = 0;
+}
+
+void transformer_session_evict(transformer_session_t *s, size_t n) {
+    if (!s) return;
+    if (n > s->length) n = s->length;
+    s->head = (s->head + n) % s->window;
+    s->length -= n;
+}
+
+int transformer_session_step(transformer_session_t *s, const double *input, double *output) {
+    HOLOS_TRACE_ZONE("transformer_session_step");
+    if (!s || !input || !output || s->precision != s->tr->precision) return -1;
+    if (s->length == s->window) transformer_session_evict(s, 1);
+    if (s->precision == AI_PRECISION_FP64) tr_session_step_f64(s, input, output);
+    else tr_session_step_f32(s, input, output);
+    s->length++;
+    s->position++;
+    return 0;
+}
+
+/* -------------------------------
+   Files
+   ------------------------------- */
+
+int transformer_save(const transformer_t *tr, const char *filename) {
+    uint64_t *meta;
+    ai_blob_t *blobs;
+    size_t L;
+    int rc;
+    if (!tr || !filename || tr->num_layers == 0) return -1;
+    L = tr->num_layers;
+    meta = malloc((2 + 3 * L) * sizeof(uint64_t));
+    blobs = calloc(12 * L, sizeof(ai_blob_t));
+    if (!meta || !blobs) {
+        free(meta);
+        free(blobs);
+        return -1;
+    }
+    meta[0] = (uint64_t)tr->precision;
+    meta[1] = L;
+    for (size_t l = 0; l < L; l++) {
+        transformer_layer_t *ly = &tr->layers[l];
+        const size_t d = ly->d_model, f = ly->d_ff;
+        const size_t rows[6] = { d, d, d, d, f, d };
+        double **a[12];
+        float **af[12];
+        size_t n[12];
+        meta[2 + 3 * l] = d;
+        meta[3 + 3 * l] = ly->num_heads;
+        meta[4 + 3 * l] = f;
+        tr_arrays(ly, a, n);
+        tr_arrays_f(ly, af, n);
+        for (size_t k = 0; k < 12; k++) {
+            ai_blob_t *b = &blobs[12 * l + k];
+            b->dtype = *a[k] ? AI_DTYPE_F64 : AI_DTYPE_F32;
+            b->rank = k < 6 ? 2 : 1;
+            b->shape[0] = k < 6 ? rows[k] : n[k];
+            b->shape[1] = k < 6 ? n[k] / rows[k] : 0;
+            b->data = *a[k] ? (const void *)*a[k] : (const void *)*af[k];
+        }
+    }
+    rc = ai_model_write(filename, TR_MAGIC, TR_VERSION, meta, 2 + 3 * L, blobs, 12 * L);
+    free(meta);
+    free(blobs);
+    return rc;
+}
+
+/* The weights are bound to the mapped tensors, which the model then
+   owns. Version 2 has the same layout after the precision. */
+static transformer_t *tr_load_mapped(ai_model_t *file) {
+    const size_t skip = file->version == TR_VERSION ? 1 : 0;
+    const uint64_t *meta = file->meta;
+    ai_precision_t precision = AI_PRECISION_FP64;
+    size_t *shape = NULL;
+    transformer_t *tr = NULL;
+    size_t L = 0;
+    int ok;
+    ok = (file->version == TR_VERSION || file->version == TR_FP64_VERSION) && file->n_meta >= skip + 1
+         && (!skip || meta[0] <= AI_PRECISION_BF16) && meta[skip] > 0 && meta[skip] < 4096
+         && file->n_meta == skip + 1 + 3 * meta[skip] && file->count == 12 * meta[skip];
+    if (ok) {
+        if (skip) precision = (ai_precision_t)meta[0];
+        L = (size_t)meta[skip];
+        shape = malloc(3 * L * sizeof(size_t));
+        ok = shape != NULL;
+    }
+    for (size_t l = 0; ok && l < L; l++) {
+        const uint64_t *sh = meta + skip + 1 + 3 * l;
+        ok = sh[0] && sh[1] && sh[2] && sh[0] < ((uint64_t)1 << 20) && sh[2] < ((uint64_t)1 << 20);
+        shape[l] = (size_t)sh[0];
+        shape[L + l] = (size_t)sh[1];
+        shape[2 * L + l] = (size_t)sh[2];
+    }
+    if (ok) {
+        tr = tr_shell(shape, shape + L, shape + 2 * L, L, precision, 0);
+        ok = tr != NULL;
+    }
+    if (tr) tr->file = file;
+    else ai_model_close(file);
+    for (size_t l = 0; ok && l < L; l++) {
+        double **a[12];
+        float **af[12];
+        size_t n[12];
+        tr_arrays(&tr->layers[l], a, n);
+        tr_arrays_f(&tr->layers[l], af, n);
+        for (size_t k = 0; k < 12 && ok; k++) {
+            if (precision == AI_PRECISION_FP64) {
+                *a[k] = ai_model_tensor(file, 12 * l + k, AI_DTYPE_F64, n[k]);
+                ok = *a[k] != NULL;
+            } else {
+                *af[k] = ai_model_tensor(file, 12 * l + k, AI_DTYPE_F32, n[k]);
+                ok = *af[k] != NULL;
+            }
+        }
+    }
+    free(shape);
+    if (!ok) {
+        transformer_free(tr);
+        return NULL;
+    }
+    return tr;
+}
+
+/* Version 1 */
+static transformer_t *tr_load_stream(const char *filename) {
+    char magic[8];
+    uint32_t version;
+    uint64_t layers = 0;
+    size_t *shape = NULL;
+    transformer_t *tr = NULL;
+    long body;
+    FILE *fp;
+    int ok;
+    fp = fopen(filename, "rb");
+    if (!fp) return NULL;
+    ok = fread(magic, 1, 8, fp) == 8 && memcmp(magic, TR_MAGIC, 8) == 0
+         && fread(&version, sizeof version, 1, fp) == 1 && version == TR_STREAM_VERSION
+         && fread(&layers, sizeof layers, 1, fp) == 1 && layers > 0 && layers < 4096;
+    body = ok ? ftell(fp) : -1;
+    if (ok) {
+        shape = malloc(3 * layers * sizeof(size_t));
+        ok = shape != NULL && body >= 0;
+    }
+    /* Shapes first, then rewind for the weights */
+    for (uint64_t l = 0; ok && l < layers; l++) {
+        uint64_t sh[3];
+        ok = fread(sh, sizeof sh[0], 3, fp) == 3 && sh[0] && sh[1] && sh[2] && sh[0] < ((uint64_t)1 << 20) && sh[2] < ((uint64_t)1 << 20);
+        if (ok) {
+            const size_t count = (size_t)(4 * sh[0] * sh[0] + 2 * sh[0] * sh[2] + 5 * sh[0] + sh[2]);
+            shape[l] = (size_t)sh[0];
+            shape[layers + l] = (size_t)sh[1];
+            shape[2 * layers + l] = (size_t)sh[2];
+            ok = fseek(fp, (long)(count * sizeof(double)), SEEK_CUR) == 0;
+        }
+    }
+    if (ok) {
+        tr = tr_shell(shape, shape + layers, shape + 2 * layers, (size_t)layers, AI_PRECISION_FP64, 1);
+        ok = tr != NULL && fseek(fp, body, SEEK_SET) == 0;
+    }
+    for (size_t l = 0; ok && l < tr->num_layers; l++) {
+        double **a[12];
+        size_t n[12];
+        tr_arrays(&tr->layers[l], a, n);
+        ok = fseek(fp, 3 * sizeof(uint64_t), SEEK_CUR) == 0;
+        for (size_t k = 0; k < 12 && ok; k++) ok = fread(*a[k], sizeof(double), n[k], fp) == n[k];
+    }
+    fclose(fp);
+    free(shape);
+    if (!ok) {
+        transformer_free(tr);
+        return NULL;
+    }
+    return tr;
+}
+
+transformer_t *transformer_load(const char *filename) {
+    ai_model_t *file;
+    if (!filename) return NULL;
+    file = ai_model_open(filename, TR_MAGIC);
+    return file ? tr_load_mapped(file) : tr_load_stream(filename);
+}
+
+transformer_t *transformer_load_precision(const char *filename, ai_precision_t precision) {
+    transformer_t *tr = transformer_load(filename);
+    if (tr && tr->precision != precision && transformer_set_precision(tr, precision) != 0) {
+        transformer_free(tr);
+        return NULL;
+    }
+    return tr;
+}
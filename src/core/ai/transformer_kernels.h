@@ -0,0 +1,437 @@
+/* transformer_kernels.h - Precision-generic transformer passes for HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+   ----------------------------------------------------------------------
+   Included by transformer.c once per compute type, with
+     TR_REAL       double or float
+     TR_FN(name)   name with the type suffix
+     TR_GEMM       cblas_dgemm or cblas_sgemm
+     TR_DOT        cblas_ddot or cblas_sdot
+     TR_SCAL       cblas_dscal or cblas_sscal
+     TR_AXPY       cblas_daxpy or cblas_saxpy
+     TR_EXP        exp or expf
+     TR_LOG        log or logf
+     TR_P(ly, a)   the layer's parameter array a (Wq ... bff2) of that type
+     TR_NATIVE     1 when TR_REAL is double (API buffers used in place)
+   bf16 is only ever set for float.
+*/
+
+static void TR_FN(tr_round)(TR_REAL *x, size_t n, int bf16) {
+    if (bf16)
+        for (size_t k = 0; k < n; k++) x[k] = (TR_REAL)ai_bf16_round((float)x[k]);
+}
+
+/* The 12 parameter arrays of a layer, in file order */
+static void TR_FN(tr_params_of)(const transformer_layer_t *ly, TR_REAL **P) {
+    TR_REAL *a[12] = { TR_P(ly, Wq), TR_P(ly, Wk), TR_P(ly, Wv), TR_P(ly, Wo), TR_P(ly, Wff1), TR_P(ly, Wff2),
+                       TR_P(ly, bq), TR_P(ly, bk), TR_P(ly, bv), TR_P(ly, bo), TR_P(ly, bff1), TR_P(ly, bff2) };
+    memcpy(P, a, sizeof a);
+}
+
+/* Wq, Wk, Wv, Wo, Wff1, Wff2 as the GEMMs see them: the stored arrays,
+   or bf16 copies one after the other in wq. */
+static void TR_FN(tr_weights)(const transformer_layer_t *ly, TR_REAL *wq, int bf16, const TR_REAL **W) {
+    TR_REAL *P[12];
+    size_t n[12];
+    TR_FN(tr_params_of)(ly, P);
+    tr_sizes(ly, n);
+    for (size_t k = 0; k < 6; k++) {
+        W[k] = P[k];
+        if (!bf16) continue;
+        for (size_t i = 0; i < n[k]; i++) wq[i] = (TR_REAL)ai_bf16_round((float)P[k][i]);
+        W[k] = wq;
+        wq += n[k];
+    }
+}
+
+#if !TR_NATIVE
+static void TR_FN(tr_load_input)(const double *src, size_t n, TR_REAL *dst, int bf16) {
+    for (size_t k = 0; k < n; k++) dst[k] = bf16 ? (TR_REAL)ai_bf16_round((float)src[k]) : (TR_REAL)src[k];
+}
+#endif
+
+/* -------------------------------
+   Dense pieces
+   ------------------------------- */
+
+/* Y (n x out) = X (n x in) W^T + b */
+static void TR_FN(tr_linear)(const TR_REAL *X, size_t n, size_t in, const TR_REAL *W, const TR_REAL *b, size_t out,
+                             TR_REAL *Y) {
+    for (size_t r = 0; r < n; r++) memcpy(Y + r * out, b, out * sizeof(TR_REAL));
+    TR_GEMM(CblasRowMajor, CblasNoTrans, CblasTrans, (int)n, (int)out, (int)in,
+            1, X, (int)in, W, (int)in, 1, Y, (int)out);
+}
+
+/* gW += dY^T X, gb += colsum dY, and dX (+)= dY W when dX is set */
+static void TR_FN(tr_linear_back)(const TR_REAL *X, const TR_REAL *dY, size_t n, size_t in, const TR_REAL *W, size_t out,
+                                  TR_REAL *gW, TR_REAL *gb, TR_REAL *dX, TR_REAL beta) {
+    TR_GEMM(CblasRowMajor, CblasTrans, CblasNoTrans, (int)out, (int)in, (int)n,
+            1, dY, (int)out, X, (int)in, 1, gW, (int)in);
+    for (size_t r = 0; r < n; r++)
+        for (size_t j = 0; j < out; j++) gb[j] += dY[r * out + j];
+    if (dX)
+        TR_GEMM(CblasRowMajor, CblasNoTrans, CblasNoTrans, (int)n, (int)in, (int)out,
+                1, dY, (int)out, W, (int)in, beta, dX, (int)in);
+}
+
+/* -------------------------------
+   Fused attention
+   ------------------------------- */
+
+/* Scores of a tile: S = scale Q_i K_j^T, keys after the query masked to
+   -inf (the tile is bi x bj, stored with stride TR_BLOCK_K). */
+static void TR_FN(tr_tile_scores)(const TR_REAL *Q, const TR_REAL *K, size_t d, size_t dh, size_t i0, size_t bi, size_t j0,
+                                  size_t bj, TR_REAL scale, TR_REAL *S) {
+    TR_GEMM(CblasRowMajor, CblasNoTrans, CblasTrans, (int)bi, (int)bj, (int)dh,
+            scale, Q + i0 * d, (int)d, K + j0 * d, (int)d, 0, S, TR_BLOCK_K);
+    if (j0 + bj > i0 + 1)
+        for (size_t r = 0; r < bi; r++)
+            for (size_t c = i0 + r + 1 > j0 ? i0 + r + 1 - j0 : 0; c < bj; c++) S[r * TR_BLOCK_K + c] = -INFINITY;
+}
+
+/* Causal attention of one head over n positions, one query tile at a
+   time. Q, K, V and A are the head's columns (stride d); lse, if set,
+   receives the log-sum-exp of every row for the backward pass. */
+static void TR_FN(tr_flash_forward)(const TR_REAL *Q, const TR_REAL *K, const TR_REAL *V, size_t n, size_t d, size_t dh,
+                                    TR_REAL scale, TR_REAL *A, TR_REAL *lse, TR_REAL *scratch, int bf16) {
+    TR_REAL *S = scratch, *m = S + TR_BLOCK_Q * TR_BLOCK_K, *l = m + TR_BLOCK_Q;
+    for (size_t i0 = 0; i0 < n; i0 += TR_BLOCK_Q) {
+        const size_t bi = n - i0 < TR_BLOCK_Q ? n - i0 : TR_BLOCK_Q;
+        for (size_t r = 0; r < bi; r++) {
+            m[r] = -INFINITY;
+            l[r] = 0;
+            memset(A + (i0 + r) * d, 0, dh * sizeof(TR_REAL));
+        }
+        for (size_t j0 = 0; j0 < i0 + bi; j0 += TR_BLOCK_K) {
+            const size_t bj = i0 + bi - j0 < TR_BLOCK_K ? i0 + bi - j0 : TR_BLOCK_K;
+            TR_FN(tr_tile_scores)(Q, K, d, dh, i0, bi, j0, bj, scale, S);
+            /* Online softmax: rescale what the row has so far to the new max */
+            for (size_t r = 0; r < bi; r++) {
+                TR_REAL *s = S + r * TR_BLOCK_K, mx = m[r], sum = 0, alpha;
+                for (size_t c = 0; c < bj; c++)
+                    if (s[c] > mx) mx = s[c];
+                for (size_t c = 0; c < bj; c++) {
+                    s[c] = TR_EXP(s[c] - mx);
+                    if (bf16) s[c] = (TR_REAL)ai_bf16_round((float)s[c]);
+                    sum += s[c];
+                }
+                alpha = TR_EXP(m[r] - mx);
+                l[r] = alpha * l[r] + sum;
+                m[r] = mx;
+                if (alpha != 1) TR_SCAL((int)dh, alpha, A + (i0 + r) * d, 1);
+            }
+            TR_GEMM(CblasRowMajor, CblasNoTrans, CblasNoTrans, (int)bi, (int)dh, (int)bj,
+                    1, S, TR_BLOCK_K, V + j0 * d, (int)d, 1, A + i0 * d, (int)d);
+        }
+        for (size_t r = 0; r < bi; r++) {
+            TR_SCAL((int)dh, 1 / l[r], A + (i0 + r) * d, 1);
+            if (lse) lse[i0 + r] = m[r] + TR_LOG(l[r]);
+        }
+    }
+}
+
+/* Backward of tr_flash_forward for one head: the probabilities are
+   recomputed tile by tile from lse, and dQ, dK, dV accumulate into the
+   head's columns (which the caller zeroes). */
+static void TR_FN(tr_flash_backward)(const TR_REAL *Q, const TR_REAL *K, const TR_REAL *V, const TR_REAL *A,
+                                     const TR_REAL *dA, const TR_REAL *lse, size_t n, size_t d, size_t dh, TR_REAL scale,
+                                     TR_REAL *dQ, TR_REAL *dK, TR_REAL *dV, TR_REAL *scratch, int bf16) {
+    TR_REAL *P = scratch, *dS = P + TR_BLOCK_Q * TR_BLOCK_K, *D = dS + TR_BLOCK_Q * TR_BLOCK_K;
+    for (size_t i0 = 0; i0 < n; i0 += TR_BLOCK_Q) {
+        const size_t bi = n - i0 < TR_BLOCK_Q ? n - i0 : TR_BLOCK_Q;
+        for (size_t r = 0; r < bi; r++) D[r] = TR_DOT((int)dh, dA + (i0 + r) * d, 1, A + (i0 + r) * d, 1);
+        for (size_t j0 = 0; j0 < i0 + bi; j0 += TR_BLOCK_K) {
+            const size_t bj = i0 + bi - j0 < TR_BLOCK_K ? i0 + bi - j0 : TR_BLOCK_K;
+            TR_FN(tr_tile_scores)(Q, K, d, dh, i0, bi, j0, bj, scale, P);
+            for (size_t r = 0; r < bi; r++)
+                for (size_t c = 0; c < bj; c++) P[r * TR_BLOCK_K + c] = TR_EXP(P[r * TR_BLOCK_K + c] - lse[i0 + r]);
+            for (size_t r = 0; r < bi && bf16; r++) TR_FN(tr_round)(P + r * TR_BLOCK_K, bj, bf16);
+            TR_GEMM(CblasRowMajor, CblasTrans, CblasNoTrans, (int)bj, (int)dh, (int)bi,
+                    1, P, TR_BLOCK_K, dA + i0 * d, (int)d, 1, dV + j0 * d, (int)d);
+            TR_GEMM(CblasRowMajor, CblasNoTrans, CblasTrans, (int)bi, (int)bj, (int)dh,
+                    1, dA + i0 * d, (int)d, V + j0 * d, (int)d, 0, dS, TR_BLOCK_K);
+            for (size_t r = 0; r < bi; r++)
+                for (size_t c = 0; c < bj; c++) {
+                    const size_t k = r * TR_BLOCK_K + c;
+                    dS[k] = scale * P[k] * (dS[k] - D[r]);
+                }
+            for (size_t r = 0; r < bi && bf16; r++) TR_FN(tr_round)(dS + r * TR_BLOCK_K, bj, bf16);
+            TR_GEMM(CblasRowMajor, CblasNoTrans, CblasNoTrans, (int)bi, (int)dh, (int)bj,
+                    1, dS, TR_BLOCK_K, K + j0 * d, (int)d, 1, dQ + i0 * d, (int)d);
+            TR_GEMM(CblasRowMajor, CblasTrans, CblasNoTrans, (int)bj, (int)dh, (int)bi,
+                    1, dS, TR_BLOCK_K, Q + i0 * d, (int)d, 1, dK + j0 * d, (int)d);
+        }
+    }
+}
+
+/* Attention of every (sequence, head) pair of a batch; the pairs touch
+   disjoint columns, so they run in parallel, each thread on its own
+   TR_SCRATCH elements of scratch. */
+static void TR_FN(tr_attention)(const transformer_layer_t *ly, int nt, const TR_REAL *Q, const TR_REAL *K,
+                                const TR_REAL *V, size_t batch, size_t n, TR_REAL *A, TR_REAL *lse, TR_REAL *scratch,
+                                int bf16) {
+    const size_t d = ly->d_model, H = ly->num_heads, dh = d / H, tasks = batch * H;
+    const TR_REAL scale = (TR_REAL)(1.0 / sqrt((double)dh));
+#pragma omp parallel for schedule(dynamic) num_threads(nt) if(nt > 1 && tasks > 1)
+    for (size_t t = 0; t < tasks; t++) {
+        const size_t b = t / H, h = t % H, off = b * n * d + h * dh;
+        TR_FN(tr_flash_forward)(Q + off, K + off, V + off, n, d, dh, scale, A + off, lse ? lse + (b * H + h) * n : NULL,
+                                scratch + (size_t)tr_thread_id() * TR_SCRATCH, bf16);
+    }
+}
+
+static void TR_FN(tr_attention_back)(const transformer_layer_t *ly, int nt, const TR_REAL *Q, const TR_REAL *K,
+                                     const TR_REAL *V, const TR_REAL *A, const TR_REAL *dA, const TR_REAL *lse,
+                                     size_t batch, size_t n, TR_REAL *dQ, TR_REAL *dK, TR_REAL *dV, TR_REAL *scratch,
+                                     int bf16) {
+    const size_t d = ly->d_model, H = ly->num_heads, dh = d / H, tasks = batch * H;
+    const TR_REAL scale = (TR_REAL)(1.0 / sqrt((double)dh));
+    memset(dQ, 0, batch * n * d * sizeof(TR_REAL));
+    memset(dK, 0, batch * n * d * sizeof(TR_REAL));
+    memset(dV, 0, batch * n * d * sizeof(TR_REAL));
+#pragma omp parallel for schedule(dynamic) num_threads(nt) if(nt > 1 && tasks > 1)
+    for (size_t t = 0; t < tasks; t++) {
+        const size_t b = t / H, h = t % H, off = b * n * d + h * dh;
+        TR_FN(tr_flash_backward)(Q + off, K + off, V + off, A + off, dA + off, lse + (b * H + h) * n, n, d, dh, scale,
+                                 dQ + off, dK + off, dV + off, scratch + (size_t)tr_thread_id() * TR_SCRATCH, bf16);
+    }
+}
+
+/* -------------------------------
+   Forward
+   ------------------------------- */
+
+/* One layer over batch sequences of n positions (batch n rows), with
+   the weights W of tr_weights. */
+static void TR_FN(tr_layer_forward)(const transformer_layer_t *ly, int nt, const TR_REAL *X, size_t batch, size_t n,
+                                    const tr_cache *c, TR_REAL *scratch, TR_REAL *Y, const TR_REAL *const *W, int bf16) {
+    const size_t d = ly->d_model, f = ly->d_ff, rows = batch * n;
+    TR_REAL *Q = c->Q, *K = c->K, *V = c->V, *A = c->A, *X1 = c->X1, *Z = c->Z;
+    TR_FN(tr_linear)(X, rows, d, W[0], TR_P(ly, bq), d, Q);
+    TR_FN(tr_linear)(X, rows, d, W[1], TR_P(ly, bk), d, K);
+    TR_FN(tr_linear)(X, rows, d, W[2], TR_P(ly, bv), d, V);
+    TR_FN(tr_round)(Q, rows * d, bf16);
+    TR_FN(tr_round)(K, rows * d, bf16);
+    TR_FN(tr_round)(V, rows * d, bf16);
+    TR_FN(tr_attention)(ly, nt, Q, K, V, batch, n, A, c->lse, scratch, bf16);
+    TR_FN(tr_round)(A, rows * d, bf16);
+    TR_FN(tr_linear)(A, rows, d, W[3], TR_P(ly, bo), d, X1);
+    for (size_t k = 0; k < rows * d; k++) X1[k] += X[k];
+    TR_FN(tr_round)(X1, rows * d, bf16);
+    TR_FN(tr_linear)(X1, rows, d, W[4], TR_P(ly, bff1), f, Z);
+    for (size_t k = 0; k < rows * f; k++) Z[k] = Z[k] > 0 ? Z[k] : 0;
+    TR_FN(tr_round)(Z, rows * f, bf16);
+    TR_FN(tr_linear)(Z, rows, f, W[5], TR_P(ly, bff2), d, Y);
+    for (size_t k = 0; k < rows * d; k++) Y[k] += X1[k];
+}
+
+/* The forward plan: 8 tensors per layer, then TR_FWD_EXTRA */
+static void TR_FN(tr_forward_batch)(const transformer_t *tr, int nt, const ai_plan_t *plan, void *base,
+                                    const double *inputs, size_t batch, size_t seq_len, double *outputs) {
+    const size_t L = tr->num_layers, rows = batch * seq_len, d = tr->layers[0].d_model;
+    const int bf16 = tr->precision == AI_PRECISION_BF16;
+    TR_REAL *wq = ai_plan_at(plan, base, 8 * L + TR_FWD_WQ);
+    const TR_REAL *x;
+#if TR_NATIVE
+    x = inputs;
+#else
+    {
+        TR_REAL *xin = ai_plan_at(plan, base, 8 * L + TR_FWD_XIN);
+        TR_FN(tr_load_input)(inputs, rows * d, xin, bf16);
+        x = xin;
+    }
+#endif
+    for (size_t l = 0; l < L; l++) {
+        const size_t t = 8 * l;
+        const TR_REAL *W[6];
+        tr_cache c;
+#if TR_NATIVE
+        TR_REAL *y = l + 1 == L ? outputs : ai_plan_at(plan, base, t + 7);
+#else
+        TR_REAL *y = ai_plan_at(plan, base, t + 7);
+#endif
+        c.Q = ai_plan_at(plan, base, t + TR_Q);
+        c.K = ai_plan_at(plan, base, t + TR_K);
+        c.V = ai_plan_at(plan, base, t + TR_V);
+        c.A = ai_plan_at(plan, base, t + TR_A);
+        c.X1 = ai_plan_at(plan, base, t + TR_X1);
+        c.Z = ai_plan_at(plan, base, t + TR_Z);
+        c.lse = NULL;
+        TR_FN(tr_weights)(&tr->layers[l], wq, bf16, W);
+        TR_FN(tr_layer_forward)(&tr->layers[l], nt, x, batch, seq_len, &c, ai_plan_at(plan, base, t + 6), y, W, bf16);
+        if (l + 1 < L) TR_FN(tr_round)(y, rows * d, bf16);
+        x = y;
+    }
+#if !TR_NATIVE
+    for (size_t k = 0; k < rows * d; k++) outputs[k] = (double)x[k];
+#endif
+}
+
+/* -------------------------------
+   Training
+   ------------------------------- */
+
+/* The training plan: TR_PER_LAYER + 1 tensors per layer, then TR_TRAIN_EXTRA */
+static void TR_FN(tr_train)(transformer_t *tr, int nt, const ai_plan_t *plan, void *base, const double *input_seq,
+                            const double *target_seq, size_t n, double learning_rate) {
+    const size_t L = tr->num_layers, d = tr->layers[0].d_model, e = (TR_PER_LAYER + 1) * L;
+    const int bf16 = tr->precision == AI_PRECISION_BF16;
+    const TR_REAL lr = (TR_REAL)learning_rate;
+    TR_REAL *out = ai_plan_at(plan, base, e + TR_OUT), *dY = ai_plan_at(plan, base, e + TR_DY);
+    TR_REAL *dX1 = ai_plan_at(plan, base, e + TR_DX1), *dA = ai_plan_at(plan, base, e + TR_DA);
+    TR_REAL *dQ = ai_plan_at(plan, base, e + TR_DQ), *dK = ai_plan_at(plan, base, e + TR_DK);
+    TR_REAL *dV = ai_plan_at(plan, base, e + TR_DV), *dZ = ai_plan_at(plan, base, e + TR_DZ);
+    TR_REAL *grad = ai_plan_at(plan, base, e + TR_GRAD), *scratch = ai_plan_at(plan, base, e + TR_SCRATCH_T);
+    TR_REAL *wq = ai_plan_at(plan, base, e + TR_WQ);
+    tr_cache *c = ai_plan_at(plan, base, e + TR_CACHES);
+    for (size_t l = 0; l < L; l++) {
+        const size_t t = (TR_PER_LAYER + 1) * l;
+        c[l].X = l ? ai_plan_at(plan, base, t) : NULL;
+        c[l].Q = ai_plan_at(plan, base, t + 1 + TR_Q);
+        c[l].K = ai_plan_at(plan, base, t + 1 + TR_K);
+        c[l].V = ai_plan_at(plan, base, t + 1 + TR_V);
+        c[l].A = ai_plan_at(plan, base, t + 1 + TR_A);
+        c[l].X1 = ai_plan_at(plan, base, t + 1 + TR_X1);
+        c[l].Z = ai_plan_at(plan, base, t + 1 + TR_Z);
+        c[l].lse = ai_plan_at(plan, base, t + 1 + TR_LSE);
+    }
+#if TR_NATIVE
+    c[0].X = input_seq;
+#else
+    {
+        TR_REAL *x0 = ai_plan_at(plan, base, 0);
+        TR_FN(tr_load_input)(input_seq, n * d, x0, bf16);
+        c[0].X = x0;
+    }
+#endif
+
+    /* Forward, keeping every layer */
+    for (size_t l = 0; l < L; l++) {
+        const TR_REAL *W[6];
+        TR_REAL *y = l + 1 < L ? (TR_REAL *)c[l + 1].X : out;
+        TR_FN(tr_weights)(&tr->layers[l], wq, bf16, W);
+        TR_FN(tr_layer_forward)(&tr->layers[l], nt, c[l].X, 1, n, &c[l], scratch, y, W, bf16);
+        if (l + 1 < L) TR_FN(tr_round)(y, n * d, bf16);
+    }
+    for (size_t k = 0; k < n * d; k++) dY[k] = (TR_REAL)((double)out[k] - target_seq[k]);
+
+    for (size_t l = L; l-- > 0;) {
+        transformer_layer_t *ly = &tr->layers[l];
+        const size_t f = ly->d_ff;
+        const TR_REAL *W[6];
+        TR_REAL *P[12], *g[12];
+        size_t sz[12];
+        const tr_cache *cl = &c[l];
+        const TR_REAL *X = cl->X, *Q = cl->Q, *K = cl->K, *V = cl->V, *A = cl->A, *X1 = cl->X1, *Z = cl->Z;
+
+        /* The weights of this step, before the update */
+        TR_FN(tr_weights)(ly, wq, bf16, W);
+        TR_FN(tr_params_of)(ly, P);
+        tr_sizes(ly, sz);
+        memset(grad, 0, tr_params(ly) * sizeof(TR_REAL));
+        g[0] = grad;
+        for (size_t k = 1; k < 12; k++) g[k] = g[k - 1] + sz[k - 1];
+        TR_FN(tr_round)(dY, n * d, bf16);
+
+        /* Feed-forward block: y = x1 + relu(z) Wff2^T + bff2 */
+        TR_FN(tr_linear_back)(Z, dY, n, f, W[5], d, g[5], g[11], dZ, 0);
+        for (size_t k = 0; k < n * f; k++)
+            if (Z[k] <= 0) dZ[k] = 0;
+        TR_FN(tr_round)(dZ, n * f, bf16);
+        memcpy(dX1, dY, n * d * sizeof(TR_REAL));
+        TR_FN(tr_linear_back)(X1, dZ, n, d, W[4], f, g[4], g[10], dX1, 1);
+        TR_FN(tr_round)(dX1, n * d, bf16);
+
+        /* Attention block: x1 = x + A Wo^T + bo */
+        TR_FN(tr_linear_back)(A, dX1, n, d, W[3], d, g[3], g[9], dA, 0);
+        TR_FN(tr_round)(dA, n * d, bf16);
+        TR_FN(tr_attention_back)(ly, nt, Q, K, V, A, dA, cl->lse, 1, n, dQ, dK, dV, scratch, bf16);
+        TR_FN(tr_round)(dQ, n * d, bf16);
+        TR_FN(tr_round)(dK, n * d, bf16);
+        TR_FN(tr_round)(dV, n * d, bf16);
+
+        /* dX = dX1 + dQ Wq + dK Wk + dV Wv, into dY for the layer below */
+        memcpy(dY, dX1, n * d * sizeof(TR_REAL));
+        TR_FN(tr_linear_back)(X, dQ, n, d, W[0], d, g[0], g[6], dY, 1);
+        TR_FN(tr_linear_back)(X, dK, n, d, W[1], d, g[1], g[7], dY, 1);
+        TR_FN(tr_linear_back)(X, dV, n, d, W[2], d, g[2], g[8], dY, 1);
+
+        for (size_t k = 0; k < 12; k++)
+            for (size_t i = 0; i < sz[k]; i++) P[k][i] -= lr * g[k][i];
+    }
+}
+
+/* -------------------------------
+   Sessions
+   ------------------------------- */
+
+/* s->work: q, a, x, x1, y (d each), the scores (window), z (widest
+   d_ff), then the bf16 weights of one layer */
+static void TR_FN(tr_session_step)(transformer_session_t *s, const double *input, double *output) {
+    const transformer_t *tr = s->tr;
+    const size_t d = tr->layers[0].d_model, slot = (s->head + s->length) % s->window, len = s->length + 1;
+    const int bf16 = tr->precision == AI_PRECISION_BF16;
+    TR_REAL *q = s->work, *a = q + d, *x = a + d, *x1 = x + d, *y = x1 + d, *row = y + d, *z = row + s->window;
+    TR_REAL *wq = z + tr_widest_ff(tr);
+    for (size_t k = 0; k < d; k++) x[k] = (TR_REAL)input[k];
+    TR_FN(tr_round)(x, d, bf16);
+    for (size_t l = 0; l < tr->num_layers; l++) {
+        const transformer_layer_t *ly = &tr->layers[l];
+        const size_t H = ly->num_heads, dh = d / H, f = ly->d_ff;
+        const TR_REAL scale = (TR_REAL)(1.0 / sqrt((double)dh));
+        TR_REAL *K = (TR_REAL *)s->keys + l * s->window * d, *V = (TR_REAL *)s->values + l * s->window * d;
+        const TR_REAL *W[6];
+
+        TR_FN(tr_weights)(ly, wq, bf16, W);
+        TR_FN(tr_linear)(x, 1, d, W[0], TR_P(ly, bq), d, q);
+        TR_FN(tr_linear)(x, 1, d, W[1], TR_P(ly, bk), d, K + slot * d);
+        TR_FN(tr_linear)(x, 1, d, W[2], TR_P(ly, bv), d, V + slot * d);
+        TR_FN(tr_round)(q, d, bf16);
+        TR_FN(tr_round)(K + slot * d, d, bf16);
+        TR_FN(tr_round)(V + slot * d, d, bf16);
+        for (size_t h = 0; h < H; h++) {
+            TR_REAL mx = -INFINITY, sum = 0;
+            for (size_t j = 0; j < len; j++) {
+                const size_t r = (s->head + j) % s->window;
+                row[j] = scale * TR_DOT((int)dh, q + h * dh, 1, K + r * d + h * dh, 1);
+                if (row[j] > mx) mx = row[j];
+            }
+            memset(a + h * dh, 0, dh * sizeof(TR_REAL));
+            for (size_t j = 0; j < len; j++) {
+                row[j] = TR_EXP(row[j] - mx);
+                if (bf16) row[j] = (TR_REAL)ai_bf16_round((float)row[j]);
+                sum += row[j];
+            }
+            for (size_t j = 0; j < len; j++) {
+                const size_t r = (s->head + j) % s->window;
+                TR_AXPY((int)dh, row[j] / sum, V + r * d + h * dh, 1, a + h * dh, 1);
+            }
+        }
+        TR_FN(tr_round)(a, d, bf16);
+        TR_FN(tr_linear)(a, 1, d, W[3], TR_P(ly, bo), d, x1);
+        for (size_t k = 0; k < d; k++) x1[k] += x[k];
+        TR_FN(tr_round)(x1, d, bf16);
+        TR_FN(tr_linear)(x1, 1, d, W[4], TR_P(ly, bff1), f, z);
+        for (size_t k = 0; k < f; k++) z[k] = z[k] > 0 ? z[k] : 0;
+        TR_FN(tr_round)(z, f, bf16);
+        TR_FN(tr_linear)(z, 1, f, W[5], TR_P(ly, bff2), d, y);
+        for (size_t k = 0; k < d; k++) x[k] = y[k] + x1[k];
+        if (l + 1 < tr->num_layers) TR_FN(tr_round)(x, d, bf16);
+    }
+    for (size_t k = 0; k < d; k++) output[k] = (double)x[k];
+}
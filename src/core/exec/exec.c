@@ -0,0 +1,636 @@
+/* exec.c - Shared task runtime of HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+   ----------------------------------------------------------------------
+   The pool (see exec.h) is workers 1 ... threads - 1, each with a
+   deque under a lock of its own, and an inject deque where threads
+   outside the pool put their tasks. A task is a struct exec_task at
+   the head of what it runs: a runner of a loop or a node of a graph.
+   g_queued counts the tasks in the deques (a push counts before it
+   queues, so the count is never short); a worker that finds none
+   after a few tries sleeps on g_wake, and a push wakes one when any
+   sleeps (the push counts before it looks at the sleepers, the worker
+   counts itself before it looks at g_queued, so one of the two sees
+   the other).
+
+   A loop of w threads has w runners, runner r with the span [lo, hi)
+   of blocks packed in one atomic word: the runner takes blocks from lo,
+   a thief the upper half of the largest span, both by compare and
+   swap. The caller runs runner 0 and pushes the others; a runner
+   pushed that nobody took before the blocks ran out ends at once.
+
+   What waits for a loop or a graph (struct exec_wait) runs tasks until
+   none is left to take, then sleeps until the last of its own ends:
+   the tasks not yet done are then running in other threads.
+   Workers do not survive fork(): in the child the pool starts anew.
+*/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "core/exec/exec.h"
+
+#define EXEC_SPIN 64                    /* Tries before a worker sleeps */
+#define EXEC_NODES_MAX 64
+
+struct exec_task {
+    void (*run)(struct exec_task *t);
+};
+
+struct exec_deque {
+    pthread_mutex_t lock;
+    struct exec_task **ring;            /* Top is stolen, bottom is run */
+    size_t cap, top, n;
+};
+
+struct exec_worker {
+    pthread_t thread;
+    int started;
+    unsigned index;
+    int node;
+    int cpu;                            /* Pinned to, or -1 */
+    struct exec_deque dq;
+};
+
+struct exec_wait {
+    atomic_size_t left;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int done;
+};
+
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_wake = PTHREAD_COND_INITIALIZER;
+static atomic_int g_started = 0;
+static int g_stop = 0;
+static unsigned g_want = 0;             /* Threads set (0: the online CPUs) */
+static int g_pin = -1;
+static unsigned g_threads = 1;          /* Of the running pool, the caller included */
+static struct exec_worker *g_workers = NULL;
+static unsigned g_n_workers = 0;
+static int g_n_nodes = 1;
+static struct exec_deque g_inject;
+static atomic_size_t g_queued = 0;
+static atomic_uint g_sleeping = 0;
+static pthread_once_t g_once = PTHREAD_ONCE_INIT;
+
+static _Thread_local struct exec_worker *t_self = NULL;
+static _Thread_local uint64_t t_rand = 0;
+
+/* ---------------- Deques ---------------- */
+
+static void exec_dq_init(struct exec_deque *dq) {
+    memset(dq, 0, sizeof(*dq));
+    pthread_mutex_init(&dq->lock, NULL);
+}
+
+static void exec_dq_free(struct exec_deque *dq) {
+    pthread_mutex_destroy(&dq->lock);
+    free(dq->ring);
+}
+
+/* 0, or -1 out of memory (the task not pushed) */
+static int exec_dq_push(struct exec_deque *dq, struct exec_task *t) {
+    pthread_mutex_lock(&dq->lock);
+    if (dq->n == dq->cap) {
+        const size_t cap = dq->cap ? 2 * dq->cap : 64;
+        struct exec_task **ring = malloc(cap * sizeof(*ring));
+        if (!ring) {
+            pthread_mutex_unlock(&dq->lock);
+            return -1;
+        }
+        for (size_t i = 0; i < dq->n; i++) ring[i] = dq->ring[(dq->top + i) % dq->cap];
+        free(dq->ring);
+        dq->ring = ring;
+        dq->cap = cap;
+        dq->top = 0;
+    }
+    dq->ring[(dq->top + dq->n++) % dq->cap] = t;
+    pthread_mutex_unlock(&dq->lock);
+    return 0;
+}
+
+static struct exec_task *exec_dq_pop(struct exec_deque *dq, int steal) {
+    struct exec_task *t = NULL;
+    pthread_mutex_lock(&dq->lock);
+    if (dq->n) {
+        if (steal) {
+            t = dq->ring[dq->top];
+            dq->top = (dq->top + 1) % dq->cap;
+            dq->n--;
+        } else {
+            t = dq->ring[(dq->top + --dq->n) % dq->cap];
+        }
+    }
+    pthread_mutex_unlock(&dq->lock);
+    return t;
+}
+
+/* ---------------- Topology ---------------- */
+
+/* CPUs of NUMA node n, from sysfs ("0-3,8-11"): how many, into cpus */
+static size_t exec_node_cpus(int n, int *cpus, size_t max) {
+    char path[64], line[1024], *p = line;
+    size_t count = 0;
+    FILE *f;
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", n);
+    if (!(f = fopen(path, "r"))) return 0;
+    if (!fgets(line, sizeof(line), f)) line[0] = '\0';
+    fclose(f);
+    while (*p >= '0' && *p <= '9') {
+        long lo = strtol(p, &p, 10), hi = lo;
+        if (*p == '-') hi = strtol(p + 1, &p, 10);
+        for (long c = lo; c <= hi && count < max; c++) cpus[count++] = (int)c;
+        if (*p != ',') break;
+        p++;
+    }
+    return count;
+}
+
+/* Node and CPU of each worker, pinned if pin */
+static void exec_place(int pin) {
+    static int cpus[EXEC_NODES_MAX][HOLOS_EXEC_THREADS_MAX];
+    size_t n_cpus[EXEC_NODES_MAX];
+    int n_nodes = 0;
+    while (n_nodes < EXEC_NODES_MAX &&
+           (n_cpus[n_nodes] = exec_node_cpus(n_nodes, cpus[n_nodes], HOLOS_EXEC_THREADS_MAX)) > 0)
+        n_nodes++;
+    if (pin < 0) pin = n_nodes > 1;
+    if (!n_nodes) pin = 0;
+    g_n_nodes = n_nodes > 1 ? n_nodes : 1;
+    for (unsigned i = 0; i < g_n_workers; i++) {
+        struct exec_worker *w = &g_workers[i];
+        w->node = (int)(w->index % (unsigned)g_n_nodes);
+        w->cpu = pin ? cpus[w->node][w->index / (unsigned)g_n_nodes % n_cpus[w->node]] : -1;
+    }
+}
+
+/* ---------------- Pool ---------------- */
+
+static uint64_t exec_random(void) {
+    if (!t_rand) t_rand = (uint64_t)(uintptr_t)&t_rand * 0x9e3779b97f4a7c15ull | 1;
+    t_rand ^= t_rand << 13;
+    t_rand ^= t_rand >> 7;
+    t_rand ^= t_rand << 17;
+    return t_rand;
+}
+
+static void exec_push(struct exec_task *t) {
+    struct exec_deque *dq = t_self ? &t_self->dq : &g_inject;
+    atomic_fetch_add(&g_queued, 1);     /* Before: a pop never comes first */
+    if (exec_dq_push(dq, t) != 0) {     /* No room: run it here */
+        atomic_fetch_sub(&g_queued, 1);
+        t->run(t);
+        return;
+    }
+    if (atomic_load(&g_sleeping)) {
+        pthread_mutex_lock(&g_lock);
+        pthread_cond_signal(&g_wake);
+        pthread_mutex_unlock(&g_lock);
+    }
+}
+
+/* A task to run: the newest of this thread's, the oldest of the inject
+   deque or of another worker's, those of the same node tried first. */
+static struct exec_task *exec_find(void) {
+    struct exec_worker *self = t_self;
+    struct exec_task *t = NULL;
+    if (!atomic_load(&g_queued)) return NULL;
+    if (self) t = exec_dq_pop(&self->dq, 0);
+    if (!t) t = exec_dq_pop(&g_inject, 1);
+    for (int pass = 0; !t && pass < 2 && g_n_workers; pass++) {
+        const unsigned start = (unsigned)(exec_random() % g_n_workers);
+        for (unsigned k = 0; !t && k < g_n_workers; k++) {
+            struct exec_worker *v = &g_workers[(start + k) % g_n_workers];
+            if (v == self || (pass == 0 && self && v->node != self->node)) continue;
+            t = exec_dq_pop(&v->dq, 1);
+        }
+        if (!self || g_n_nodes < 2) break;     /* No node, or one for all */
+    }
+    if (t) atomic_fetch_sub(&g_queued, 1);
+    return t;
+}
+
+static void *exec_worker_main(void *arg) {
+    struct exec_worker *self = arg;
+    t_self = self;
+    for (;;) {
+        struct exec_task *t = NULL;
+        for (int k = 0; !t && k < EXEC_SPIN; k++)
+            if (!(t = exec_find())) sched_yield();
+        if (t) {
+            t->run(t);
+            continue;
+        }
+        pthread_mutex_lock(&g_lock);
+        atomic_fetch_add(&g_sleeping, 1);
+        while (!g_stop && !atomic_load(&g_queued)) pthread_cond_wait(&g_wake, &g_lock);
+        atomic_fetch_sub(&g_sleeping, 1);
+        if (g_stop) {
+            pthread_mutex_unlock(&g_lock);
+            break;
+        }
+        pthread_mutex_unlock(&g_lock);
+    }
+    return NULL;
+}
+
+/* The child of a fork has none of the workers */
+static void exec_atfork_child(void) {
+    pthread_mutex_init(&g_lock, NULL);
+    pthread_cond_init(&g_wake, NULL);
+    g_workers = NULL;                   /* Their memory is lost with them */
+    g_n_workers = 0;
+    g_threads = 1;
+    g_stop = 0;
+    exec_dq_init(&g_inject);
+    atomic_store(&g_queued, 0);
+    atomic_store(&g_sleeping, 0);
+    atomic_store(&g_started, 0);
+    t_self = NULL;
+}
+
+static void exec_once(void) {
+    exec_dq_init(&g_inject);
+    pthread_atfork(NULL, NULL, exec_atfork_child);
+}
+
+static unsigned exec_wanted(void) {
+    long cpus;
+    if (g_want) return g_want;
+    cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 1 ? (unsigned)(cpus < HOLOS_EXEC_THREADS_MAX ? cpus : HOLOS_EXEC_THREADS_MAX) : 1;
+}
+
+/* Starts the pool if it is not running */
+static void exec_start(void) {
+    unsigned n;
+    if (atomic_load_explicit(&g_started, memory_order_acquire)) return;
+    pthread_once(&g_once, exec_once);
+    pthread_mutex_lock(&g_lock);
+    if (atomic_load(&g_started)) {
+        pthread_mutex_unlock(&g_lock);
+        return;
+    }
+    n = exec_wanted();
+    g_threads = 1;
+    g_n_workers = 0;
+    if (n > 1 && (g_workers = calloc(n - 1, sizeof(*g_workers)))) {
+        g_n_workers = n - 1;
+        for (unsigned i = 0; i < g_n_workers; i++) {
+            g_workers[i].index = i + 1;
+            exec_dq_init(&g_workers[i].dq);
+        }
+        exec_place(g_pin);
+        for (unsigned i = 0; i < g_n_workers; i++) {
+            struct exec_worker *w = &g_workers[i];
+            if (pthread_create(&w->thread, NULL, exec_worker_main, w) != 0) break;
+            w->started = 1;
+            g_threads++;
+            if (w->cpu >= 0) {
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                CPU_SET(w->cpu, &set);
+                pthread_setaffinity_np(w->thread, sizeof(set), &set);
+            }
+        }
+    }
+    atomic_store_explicit(&g_started, 1, memory_order_release);
+    pthread_mutex_unlock(&g_lock);
+}
+
+void holos_exec_shutdown(void) {
+    if (!atomic_load(&g_started)) return;
+    pthread_mutex_lock(&g_lock);
+    g_stop = 1;
+    pthread_cond_broadcast(&g_wake);
+    pthread_mutex_unlock(&g_lock);
+    for (unsigned i = 0; i < g_n_workers; i++)
+        if (g_workers[i].started) pthread_join(g_workers[i].thread, NULL);
+    pthread_mutex_lock(&g_lock);
+    for (unsigned i = 0; i < g_n_workers; i++) exec_dq_free(&g_workers[i].dq);
+    free(g_workers);
+    g_workers = NULL;
+    g_n_workers = 0;
+    g_threads = 1;
+    g_stop = 0;
+    atomic_store(&g_started, 0);
+    pthread_mutex_unlock(&g_lock);
+}
+
+int holos_exec_setup(unsigned threads, int pin) {
+    if (threads > HOLOS_EXEC_THREADS_MAX) return -1;
+    holos_exec_shutdown();
+    pthread_mutex_lock(&g_lock);
+    g_want = threads;
+    g_pin = pin;
+    pthread_mutex_unlock(&g_lock);
+    return 0;
+}
+
+unsigned holos_exec_threads(void) {
+    exec_start();
+    return g_threads;
+}
+
+/* ---------------- Waiting ---------------- */
+
+static void exec_wait_init(struct exec_wait *w, size_t count) {
+    atomic_init(&w->left, count);
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->cond, NULL);
+    w->done = !count;
+}
+
+/* One of the tasks of w has ended; w is not touched past the last */
+static void exec_wait_done(struct exec_wait *w) {
+    if (atomic_fetch_sub(&w->left, 1) != 1) return;
+    pthread_mutex_lock(&w->lock);
+    w->done = 1;
+    pthread_cond_signal(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+}
+
+static void exec_wait(struct exec_wait *w) {
+    struct exec_task *t;
+    while (atomic_load(&w->left) && (t = exec_find())) t->run(t);
+    pthread_mutex_lock(&w->lock);
+    while (!w->done) pthread_cond_wait(&w->cond, &w->lock);
+    pthread_mutex_unlock(&w->lock);
+    pthread_cond_destroy(&w->cond);
+    pthread_mutex_destroy(&w->lock);
+}
+
+/* ---------------- Loops ---------------- */
+
+struct exec_loop;
+
+struct exec_runner {
+    struct exec_task task;
+    struct exec_loop *loop;
+    unsigned slot;
+};
+
+struct exec_loop {
+    size_t n, grain, n_blocks;
+    unsigned width;
+    holos_exec_range_fn fn;
+    holos_exec_reduce_fn reduce;
+    unsigned char *acc;                 /* Of block b at b * stride */
+    size_t stride;
+    void *cls;
+    _Atomic uint64_t *span;             /* lo | hi << 32, per runner */
+    struct exec_runner *runners;
+    struct exec_wait wait;
+};
+
+#define EXEC_SPAN(lo, hi) ((uint64_t)(lo) | (uint64_t)(hi) << 32)
+
+static void exec_block(struct exec_loop *l, size_t b, unsigned slot) {
+    const size_t lo = b * l->grain, hi = lo + l->grain < l->n ? lo + l->grain : l->n;
+    if (l->reduce) l->reduce(lo, hi, l->acc + b * l->stride, l->cls);
+    else l->fn(lo, hi, slot, l->cls);
+}
+
+/* The upper half of the largest span left, as runner r's; 0 if none */
+static int exec_steal(struct exec_loop *l, unsigned r) {
+    for (;;) {
+        unsigned best = r;
+        uint64_t s, best_s = 0, left = 0;
+        for (unsigned v = 0; v < l->width; v++) {
+            s = atomic_load(&l->span[v]);
+            if (v != r && (s >> 32) - (uint32_t)s > left) {
+                left = (s >> 32) - (uint32_t)s;
+                best = v;
+                best_s = s;
+            }
+        }
+        if (best == r) return 0;
+        {
+            const uint64_t lo = (uint32_t)best_s, hi = best_s >> 32, mid = lo + (hi - lo) / 2;
+            if (atomic_compare_exchange_weak(&l->span[best], &best_s, EXEC_SPAN(lo, mid))) {
+                atomic_store(&l->span[r], EXEC_SPAN(mid, hi));
+                return 1;
+            }
+        }
+    }
+}
+
+static void exec_runner_run(struct exec_task *t) {
+    struct exec_runner *rn = (struct exec_runner *)t;
+    struct exec_loop *l = rn->loop;
+    const unsigned r = rn->slot;
+    do {
+        uint64_t s = atomic_load(&l->span[r]);
+        while ((uint32_t)s < (s >> 32)) {
+            if (atomic_compare_exchange_weak(&l->span[r], &s, s + 1)) {
+                exec_block(l, (uint32_t)s, r);
+                s = atomic_load(&l->span[r]);
+            }
+        }
+    } while (exec_steal(l, r));
+    exec_wait_done(&l->wait);
+}
+
+unsigned holos_exec_slots(unsigned width) {
+    const unsigned n = holos_exec_threads();
+    return width && width < n ? width : n;
+}
+
+/* Runs the blocks of l on its threads; serially in the caller if the
+   runners cannot be had */
+static void exec_loop_run(struct exec_loop *l, unsigned width) {
+    unsigned w = holos_exec_slots(width);
+    if (w > l->n_blocks) w = (unsigned)l->n_blocks;
+    l->width = w;
+    l->span = w > 1 ? malloc(w * sizeof(*l->span)) : NULL;
+    l->runners = l->span ? malloc(w * sizeof(*l->runners)) : NULL;
+    if (!l->runners) {
+        for (size_t b = 0; b < l->n_blocks; b++) exec_block(l, b, 0);
+        free(l->span);
+        return;
+    }
+    for (unsigned r = 0; r < w; r++) {
+        atomic_init(&l->span[r], EXEC_SPAN(l->n_blocks * r / w, l->n_blocks * (r + 1) / w));
+        l->runners[r].task.run = exec_runner_run;
+        l->runners[r].loop = l;
+        l->runners[r].slot = r;
+    }
+    exec_wait_init(&l->wait, w);
+    for (unsigned r = w - 1; r > 0; r--) exec_push(&l->runners[r].task);
+    exec_runner_run(&l->runners[0].task);
+    exec_wait(&l->wait);
+    free(l->runners);
+    free((void *)l->span);
+}
+
+/* Blocks of grain over n, at most 2^32 - 1 of them */
+static void exec_loop_init(struct exec_loop *l, size_t n, size_t grain, void *cls) {
+    memset(l, 0, sizeof(*l));
+    if (!grain) grain = (n + HOLOS_EXEC_BLOCKS - 1) / HOLOS_EXEC_BLOCKS;
+    if (!grain) grain = 1;
+    if ((n + grain - 1) / grain > UINT32_MAX) grain = (n + UINT32_MAX - 1) / UINT32_MAX;
+    l->n = n;
+    l->grain = grain;
+    l->n_blocks = (n + grain - 1) / grain;
+    l->cls = cls;
+}
+
+int holos_exec_for(size_t n, size_t grain, unsigned width, holos_exec_range_fn fn, void *cls) {
+    struct exec_loop l;
+    if (!fn) return -1;
+    if (!n) return 0;
+    exec_loop_init(&l, n, grain, cls);
+    l.fn = fn;
+    exec_loop_run(&l, width);
+    return 0;
+}
+
+int holos_exec_reduce(size_t n, size_t grain, const void *identity, size_t size, holos_exec_reduce_fn fn,
+                      holos_exec_combine_fn combine, void *result, void *cls) {
+    struct exec_loop l;
+    if (!fn || !combine || !result || !identity || !size) return -1;
+    if (!n) {
+        memmove(result, identity, size);
+        return 0;
+    }
+    exec_loop_init(&l, n, grain, cls);
+    l.reduce = fn;
+    l.stride = (size + 63) / 64 * 64;   /* A cache line each, at least */
+    if (l.n_blocks > SIZE_MAX / l.stride || !(l.acc = aligned_alloc(64, l.n_blocks * l.stride))) return -1;
+    for (size_t b = 0; b < l.n_blocks; b++) memcpy(l.acc + b * l.stride, identity, size);
+    exec_loop_run(&l, 0);
+    for (size_t s = 1; s < l.n_blocks; s *= 2)
+        for (size_t b = 0; b + s < l.n_blocks; b += 2 * s) combine(l.acc + b * l.stride, l.acc + (b + s) * l.stride, cls);
+    memcpy(result, l.acc, size);
+    free(l.acc);
+    return 0;
+}
+
+/* ---------------- Graphs ---------------- */
+
+struct exec_node {
+    struct exec_task task;
+    struct holos_exec_graph *graph;
+    holos_exec_task_fn fn;
+    void *cls;
+    int *next;                          /* Tasks that depend on this one */
+    size_t n_next, cap_next, n_deps;
+    atomic_size_t waiting;              /* Dependencies not yet ended */
+    atomic_int failed;                  /* One of them did not succeed */
+    int status;
+};
+
+struct holos_exec_graph {
+    struct exec_node *nodes;
+    size_t n, cap;
+    struct exec_wait wait;
+};
+
+struct holos_exec_graph *holos_exec_graph_new(void) {
+    return calloc(1, sizeof(struct holos_exec_graph));
+}
+
+void holos_exec_graph_free(struct holos_exec_graph *g) {
+    if (!g) return;
+    for (size_t i = 0; i < g->n; i++) free(g->nodes[i].next);
+    free(g->nodes);
+    free(g);
+}
+
+int holos_exec_graph_add(struct holos_exec_graph *g, holos_exec_task_fn fn, void *cls, const int *deps, size_t n_deps) {
+    struct exec_node *node;
+    if (!g || !fn || (n_deps && !deps) || g->n >= 0x7fffffff) return -1;
+    for (size_t k = 0; k < n_deps; k++)
+        if (deps[k] < 0 || (size_t)deps[k] >= g->n) return -1;
+    if (g->n == g->cap) {
+        const size_t cap = g->cap ? 2 * g->cap : 16;
+        struct exec_node *nodes = realloc(g->nodes, cap * sizeof(*nodes));
+        if (!nodes) return -1;
+        g->nodes = nodes;
+        g->cap = cap;
+    }
+    for (size_t k = 0; k < n_deps; k++) {
+        struct exec_node *d = &g->nodes[deps[k]];
+        if (d->n_next == d->cap_next) {
+            const size_t cap = d->cap_next ? 2 * d->cap_next : 4;
+            int *next = realloc(d->next, cap * sizeof(*next));
+            if (!next) {
+                while (k-- > 0) g->nodes[deps[k]].n_next--;     /* Undo the links made */
+                return -1;
+            }
+            d->next = next;
+            d->cap_next = cap;
+        }
+        d->next[d->n_next++] = (int)g->n;
+    }
+    node = &g->nodes[g->n];
+    memset(node, 0, sizeof(*node));
+    node->graph = g;
+    node->fn = fn;
+    node->cls = cls;
+    node->n_deps = n_deps;
+    node->status = HOLOS_EXEC_NOT_RUN;
+    return (int)g->n++;
+}
+
+static void exec_node_run(struct exec_task *t) {
+    struct exec_node *node = (struct exec_node *)t;
+    struct holos_exec_graph *g = node->graph;
+    int ok = 0;
+    if (!atomic_load(&node->failed)) ok = (node->status = node->fn(node->cls)) == 0;
+    for (size_t k = 0; k < node->n_next; k++) {
+        struct exec_node *next = &g->nodes[node->next[k]];
+        if (!ok) atomic_store(&next->failed, 1);
+        if (atomic_fetch_sub(&next->waiting, 1) == 1) exec_push(&next->task);
+    }
+    exec_wait_done(&g->wait);
+}
+
+int holos_exec_graph_run(struct holos_exec_graph *g) {
+    size_t failed = 0;
+    if (!g) return -1;
+    if (!g->n) return 0;
+    exec_start();
+    for (size_t i = 0; i < g->n; i++) {
+        struct exec_node *node = &g->nodes[i];
+        node->task.run = exec_node_run;
+        node->status = HOLOS_EXEC_NOT_RUN;
+        atomic_init(&node->waiting, node->n_deps);
+        atomic_init(&node->failed, 0);
+    }
+    exec_wait_init(&g->wait, g->n);
+    for (size_t i = g->n; i-- > 0;)
+        if (!g->nodes[i].n_deps) exec_push(&g->nodes[i].task);
+    exec_wait(&g->wait);
+    for (size_t i = 0; i < g->n; i++) failed += g->nodes[i].status != 0;
+    return failed ? -(int)failed : 0;
+}
+
+int holos_exec_graph_status(const struct holos_exec_graph *g, int id) {
+    if (!g || id < 0 || (size_t)id >= g->n) return HOLOS_EXEC_NOT_RUN;
+    return g->nodes[id].status;
+}
@@ -0,0 +1,147 @@
+/* forge_batch.c - Parallel batch work over HOLOS projects
+    Copyright (C) 2025  4137314 <holos@mail.com>
+
+    This file is part of HOLOS.
+
+    HOLOS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    HOLOS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+    ----------------------------------------------------------------------
+    A batch is a loop of the holos_exec pool (core/exec/exec.h) over its
+    projects, one at a time per block, on at most the limit set of the
+    pool's threads; the calling thread works on it too, so batches from
+    several threads run side by side, and one called from an event
+    callback still makes progress with the pool busy.
+
+    A project is done when its work returns, failed or not, and when
+    its callbacks have been told; a callback returning nonzero cancels
+    the projects of the batch not yet started, which count as failed.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+
+#include "core/forge/forge.h"
+#include "core/exec/exec.h"
+#include "forge_work.h"
+
+#define FORGE_THREADS_MAX 64
+
+enum {
+    FORGE_DIAGNOSTICS,
+    FORGE_COMPLIANCE,
+    FORGE_REPORTS
+};
+
+struct forge_batch {
+    int work;
+    struct holos_project **projects;
+    const char *dir;                    /* Of the reports */
+    atomic_size_t failed;
+    atomic_int stop;                    /* Cancelled by a callback */
+};
+
+static atomic_uint g_threads = 0;       /* Projects at a time (0: the pool's threads) */
+
+/* ---------------- Work ---------------- */
+
+/* dir/ID.txt, the ID's characters past [A-Za-z0-9._-] replaced */
+static char *forge_report_path(const char *dir, const char *id) {
+    const size_t n = strlen(dir) + strlen(id) + 6;
+    char *path = malloc(n), *name;
+    if (!path) return NULL;
+    snprintf(path, n, "%s/%s.txt", dir, id);
+    for (name = path + strlen(dir) + 1; name < path + n - 5; name++) {
+        const char c = *name;
+        if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '.' || c == '-' ||
+              c == '_'))
+            *name = '_';
+    }
+    return path;
+}
+
+/* Work on project i of b, unless the batch was cancelled */
+static void forge_batch_run(struct forge_batch *b, size_t i) {
+    static const holos_project_event_type events[] = {HOLOS_EVENT_DIAGNOSTICS, HOLOS_EVENT_COMPLIANCE,
+                                                      HOLOS_EVENT_ANALYTICS};
+    struct holos_project *p = b->projects[i];
+    int rc = -1;
+    if (atomic_load(&b->stop)) {
+        atomic_fetch_add(&b->failed, 1);
+        return;
+    }
+    if (p && b->work == FORGE_DIAGNOSTICS) {
+        rc = forge_diagnostics(p);
+    } else if (p && b->work == FORGE_COMPLIANCE) {
+        rc = forge_compliance(p);
+    } else if (p && p->id) {
+        char *path = forge_report_path(b->dir, p->id);
+        rc = path ? forge_report(p, path) : -1;
+        free(path);
+    }
+    if (p && forge_notify(p, events[b->work])) atomic_store(&b->stop, 1);
+    if (rc != 0) atomic_fetch_add(&b->failed, 1);
+}
+
+static void forge_batch_range(size_t lo, size_t hi, unsigned slot, void *cls) {
+    (void)slot;
+    for (size_t i = lo; i < hi; i++) forge_batch_run(cls, i);
+}
+
+/* ---------------- Batches ---------------- */
+
+int holos_project_batch_limits(unsigned threads, unsigned git, unsigned disk_ops) {
+    if (threads > FORGE_THREADS_MAX) return -1;
+    if (git) forge_gate_limit(FORGE_GATE_GIT, git);
+    if (disk_ops) forge_gate_limit(FORGE_GATE_DISK, disk_ops);
+    if (threads) atomic_store(&g_threads, threads);     /* From the next batch */
+    return 0;
+}
+
+static int forge_batch(int work, struct holos_project **projects, size_t count, const char *dir) {
+    struct forge_batch b;
+    size_t failed;
+    unsigned width = atomic_load(&g_threads);
+    if (!projects && count) return -1;
+    if (count == 0) return 0;
+    if (!width) width = FORGE_THREADS_MAX;
+    b.work = work;
+    b.projects = projects;
+    b.dir = dir;
+    atomic_init(&b.failed, 0);
+    atomic_init(&b.stop, 0);
+    holos_exec_for(count, 1, width, forge_batch_range, &b);
+    failed = atomic_load(&b.failed);
+    return failed ? -(int)(failed < 0x7fffffff ? failed : 0x7fffffff) : 0;
+}
+
+int holos_project_batch_run_diagnostics(struct holos_project **projects, size_t count) {
+    return forge_batch(FORGE_DIAGNOSTICS, projects, count, NULL);
+}
+
+int holos_project_batch_check_compliance(struct holos_project **projects, size_t count) {
+    return forge_batch(FORGE_COMPLIANCE, projects, count, NULL);
+}
+
+int holos_project_batch_generate_reports(struct holos_project **projects, size_t count, const char *dir_path) {
+    if (!dir_path || !*dir_path) return -1;
+    if (mkdir(dir_path, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "[forge] %s: %s\n", dir_path, strerror(errno));
+        return -1;
+    }
+    return forge_batch(FORGE_REPORTS, projects, count, dir_path);
+}
@@ -0,0 +1,347 @@
+/* forge_project.c - Diagnostics, compliance and reports of HOLOS projects
+    Copyright (C) 2025  4137314 <holos@mail.com>
+
+    This file is part of HOLOS.
+
+    HOLOS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    HOLOS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+    ----------------------------------------------------------------------
+    The work on one project, safe to run on several projects at once
+    (forge_batch.c does): it touches only its project, and takes a gate
+    around each git process and file operation so that a batch does not
+    run more of them than the disk and the machine take.
+    - diagnostics: which of the linked files are missing, into the
+      project's diagnostics string;
+    - compliance: the project names its owner and its compliance terms,
+      and the compliance report it links to exists;
+    - report: the metadata, the diagnostics, the compliance verdict and
+      the git status, written to a temporary file renamed into place.
+    The holos_project_* calls tell the project's event callbacks when
+    done; the forge_* ones under them leave that to the batch.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <spawn.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "core/forge/forge.h"
+#include "forge_work.h"
+
+#define FORGE_GIT_MAX 65536             /* Bytes of git output kept */
+
+extern char **environ;
+
+/* ---------------- Gates ---------------- */
+
+struct forge_gate {
+    pthread_mutex_t lock;
+    pthread_cond_t free;
+    unsigned held, limit;
+};
+
+static struct forge_gate g_gates[FORGE_GATES] = {
+    {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, 0, 2},
+    {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, 0, 4},
+};
+
+void forge_gate_enter(int gate) {
+    struct forge_gate *g = &g_gates[gate];
+    pthread_mutex_lock(&g->lock);
+    while (g->held >= g->limit) pthread_cond_wait(&g->free, &g->lock);
+    g->held++;
+    pthread_mutex_unlock(&g->lock);
+}
+
+void forge_gate_leave(int gate) {
+    struct forge_gate *g = &g_gates[gate];
+    pthread_mutex_lock(&g->lock);
+    g->held--;
+    pthread_cond_signal(&g->free);
+    pthread_mutex_unlock(&g->lock);
+}
+
+void forge_gate_limit(int gate, unsigned limit) {
+    struct forge_gate *g = &g_gates[gate];
+    pthread_mutex_lock(&g->lock);
+    g->limit = limit;
+    pthread_cond_broadcast(&g->free);
+    pthread_mutex_unlock(&g->lock);
+}
+
+/* ---------------- Event callbacks ---------------- */
+
+struct forge_callback {
+    struct holos_project *project;      /* NULL: every project */
+    holos_project_event_callback cb;
+    void *user_data;
+};
+
+static struct forge_callback *g_callbacks = NULL;
+static size_t g_n_callbacks = 0, g_cap_callbacks = 0;
+static pthread_mutex_t g_callbacks_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t g_calls_lock = PTHREAD_MUTEX_INITIALIZER;  /* One call at a time */
+
+int holos_project_register_event_callback(struct holos_project *project, holos_project_event_callback cb,
+                                          void *user_data) {
+    int rc = 0;
+    if (!cb) return -1;
+    pthread_mutex_lock(&g_callbacks_lock);
+    if (g_n_callbacks == g_cap_callbacks) {
+        const size_t cap = g_cap_callbacks ? 2 * g_cap_callbacks : 8;
+        struct forge_callback *grown = realloc(g_callbacks, cap * sizeof(*grown));
+        if (grown) {
+            g_callbacks = grown;
+            g_cap_callbacks = cap;
+        } else {
+            rc = -1;
+        }
+    }
+    if (rc == 0) {
+        g_callbacks[g_n_callbacks].project = project;
+        g_callbacks[g_n_callbacks].cb = cb;
+        g_callbacks[g_n_callbacks].user_data = user_data;
+        g_n_callbacks++;
+    }
+    pthread_mutex_unlock(&g_callbacks_lock);
+    return rc;
+}
+
+int holos_project_unregister_event_callback(struct holos_project *project, holos_project_event_callback cb) {
+    int rc = -1;
+    pthread_mutex_lock(&g_callbacks_lock);
+    for (size_t i = 0; i < g_n_callbacks;) {
+        if (g_callbacks[i].project == project && g_callbacks[i].cb == cb) {
+            memmove(&g_callbacks[i], &g_callbacks[i + 1], (g_n_callbacks - i - 1) * sizeof(*g_callbacks));
+            g_n_callbacks--;
+            rc = 0;
+        } else {
+            i++;
+        }
+    }
+    pthread_mutex_unlock(&g_callbacks_lock);
+    return rc;
+}
+
+/* The callbacks are copied out first: one may register or unregister */
+int forge_notify(struct holos_project *project, holos_project_event_type event) {
+    struct forge_callback *calls;
+    size_t n = 0;
+    int stop = 0;
+    pthread_mutex_lock(&g_calls_lock);
+    pthread_mutex_lock(&g_callbacks_lock);
+    calls = g_n_callbacks ? malloc(g_n_callbacks * sizeof(*calls)) : NULL;
+    for (size_t i = 0; calls && i < g_n_callbacks; i++)
+        if (!g_callbacks[i].project || g_callbacks[i].project == project) calls[n++] = g_callbacks[i];
+    pthread_mutex_unlock(&g_callbacks_lock);
+    for (size_t i = 0; i < n; i++)
+        if (calls[i].cb(project, event, calls[i].user_data) != 0) stop = 1;
+    pthread_mutex_unlock(&g_calls_lock);
+    free(calls);
+    return stop;
+}
+
+/* ---------------- Diagnostics and compliance ---------------- */
+
+/* Files a project links to, by field */
+static const struct {
+    const char *name;
+    size_t offset;
+} g_links[] = {
+#define FORGE_LINK(f) {#f, offsetof(struct holos_project, f)}
+    FORGE_LINK(database_path),  FORGE_LINK(physics_file),           FORGE_LINK(ai_file),
+    FORGE_LINK(p2p_file),       FORGE_LINK(git_repo_path),          FORGE_LINK(analytics_path),
+    FORGE_LINK(digital_twin_path), FORGE_LINK(ai_model_path),       FORGE_LINK(compliance_report_path),
+    FORGE_LINK(advanced_analytics_path), FORGE_LINK(audit_trail_path),
+#undef FORGE_LINK
+};
+
+static const char *forge_link(const struct holos_project *project, size_t i) {
+    return *(char *const *)((const char *)project + g_links[i].offset);
+}
+
+static int forge_exists(const char *path) {
+    struct stat st;
+    int rc;
+    forge_gate_enter(FORGE_GATE_DISK);
+    rc = stat(path, &st) == 0;
+    forge_gate_leave(FORGE_GATE_DISK);
+    return rc;
+}
+
+/* "ok", or "missing:" and the fields whose files are not there */
+static char *forge_diagnose(const struct holos_project *project) {
+    char text[1024] = "missing:";
+    int missing = 0;
+    for (size_t i = 0; i < sizeof(g_links) / sizeof(g_links[0]); i++) {
+        const char *path = forge_link(project, i);
+        if (!path || !*path || forge_exists(path)) continue;
+        strncat(text, " ", sizeof(text) - strlen(text) - 1);
+        strncat(text, g_links[i].name, sizeof(text) - strlen(text) - 1);
+        missing = 1;
+    }
+    return strdup(missing ? text : "ok");
+}
+
+int forge_diagnostics(struct holos_project *project) {
+    char *text;
+    if (!project || !(text = forge_diagnose(project))) return -1;
+    free(project->diagnostics);
+    project->diagnostics = text;
+    return 0;
+}
+
+int holos_project_run_diagnostics(struct holos_project *project) {
+    const int rc = forge_diagnostics(project);
+    if (project) forge_notify(project, HOLOS_EVENT_DIAGNOSTICS);
+    return rc;
+}
+
+static int forge_compliant(const struct holos_project *project) {
+    if (!project->id || !project->name || !project->owner || !*project->owner) return 0;
+    if (!project->compliance || !*project->compliance) return 0;
+    return !project->compliance_report_path || !*project->compliance_report_path ||
+           forge_exists(project->compliance_report_path);
+}
+
+int forge_compliance(const struct holos_project *project) {
+    return project && forge_compliant(project) ? 0 : -1;
+}
+
+int holos_project_check_compliance(const struct holos_project *project) {
+    const int rc = forge_compliance(project);
+    if (project) forge_notify((struct holos_project *)project, HOLOS_EVENT_COMPLIANCE);
+    return rc;
+}
+
+/* ---------------- Reports ---------------- */
+
+/* Output of git -C repo args..., at most FORGE_GIT_MAX bytes: malloc'd,
+   NULL if git did not run. */
+static char *forge_git(const char *repo, const char *const *args, size_t n_args) {
+    const char *argv[16] = {"git", "-C", repo};
+    posix_spawn_file_actions_t actions;
+    char *out = NULL;
+    size_t used = 0;
+    int fds[2], status;
+    pid_t pid;
+    if (n_args > 12) return NULL;
+    memcpy(argv + 3, args, n_args * sizeof(*args));
+    argv[3 + n_args] = NULL;
+    if (pipe(fds) != 0) return NULL;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+    posix_spawn_file_actions_addclose(&actions, fds[0]);
+    posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+    forge_gate_enter(FORGE_GATE_GIT);
+    status = posix_spawnp(&pid, "git", &actions, NULL, (char *const *)argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(fds[1]);
+    if (status == 0 && (out = malloc(FORGE_GIT_MAX + 1))) {
+        ssize_t r;
+        while ((r = read(fds[0], out + used, FORGE_GIT_MAX - used)) != 0) {
+            if (r < 0 && errno == EINTR) continue;
+            if (r < 0) break;
+            used += (size_t)r;
+            if (used == FORGE_GIT_MAX) {    /* Drain the rest */
+                char skip[4096];
+                while (read(fds[0], skip, sizeof(skip)) > 0) {
+                }
+                break;
+            }
+        }
+        out[used] = '\0';
+    }
+    close(fds[0]);
+    if (status == 0 && (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)) {
+        free(out);
+        out = NULL;
+    }
+    forge_gate_leave(FORGE_GATE_GIT);
+    return out;
+}
+
+static void forge_field(FILE *f, const char *name, const char *value) {
+    if (value && *value) fprintf(f, "%-24s %s\n", name, value);
+}
+
+static void forge_report_write(FILE *f, const struct holos_project *p, const char *diagnostics, int compliant,
+                               const char *git) {
+    fprintf(f, "HOLOS project report\n\n");
+    forge_field(f, "id", p->id);
+    forge_field(f, "name", p->name);
+    forge_field(f, "description", p->description);
+    forge_field(f, "version", p->version);
+    forge_field(f, "owner", p->owner);
+    forge_field(f, "organization", p->organization);
+    forge_field(f, "created_at", p->created_at);
+    forge_field(f, "updated_at", p->updated_at);
+    forge_field(f, "tags", p->tags);
+    fprintf(f, "%-24s %d\n", "state", (int)p->state);
+    fprintf(f, "%-24s %.3f\n", "risk_score", p->risk_score);
+    fprintf(f, "%-24s %.3f\n", "sustainability_score", p->sustainability_score);
+    fprintf(f, "%-24s %d\n", "digital_twin_status", p->digital_twin_status);
+    forge_field(f, "compliance", p->compliance);
+    forge_field(f, "sustainability", p->sustainability);
+    forge_field(f, "provenance", p->provenance);
+    forge_field(f, "security_profile", p->security_profile);
+    forge_field(f, "dependencies", p->dependencies);
+    forge_field(f, "collaborators", p->collaborators);
+    fprintf(f, "\nLinked files\n");
+    for (size_t i = 0; i < sizeof(g_links) / sizeof(g_links[0]); i++) forge_field(f, g_links[i].name, forge_link(p, i));
+    fprintf(f, "\n%-24s %s\n", "diagnostics", diagnostics ? diagnostics : "-");
+    fprintf(f, "%-24s %s\n", "compliant", compliant ? "yes" : "no");
+    if (p->git_repo_path && *p->git_repo_path)
+        fprintf(f, "\nGit status\n%s", git ? git : "(not a git repository)\n");
+}
+
+int forge_report(const struct holos_project *project, const char *report_path) {
+    static const char *const status[] = {"status", "--porcelain", "--branch"};
+    char *diagnostics, *git = NULL, *tmp;
+    FILE *f;
+    int compliant, rc = -1, err = 0;
+    if (!project || !report_path) return -1;
+    diagnostics = forge_diagnose(project);
+    compliant = forge_compliant(project);
+    if (project->git_repo_path && *project->git_repo_path) git = forge_git(project->git_repo_path, status, 3);
+    if ((tmp = malloc(strlen(report_path) + 8))) {
+        sprintf(tmp, "%s.part", report_path);
+        forge_gate_enter(FORGE_GATE_DISK);
+        if ((f = fopen(tmp, "w"))) {
+            forge_report_write(f, project, diagnostics, compliant, git);
+            rc = fclose(f) == 0 && rename(tmp, report_path) == 0 ? 0 : -1;
+            if (rc != 0) remove(tmp);
+        }
+        err = errno;
+        forge_gate_leave(FORGE_GATE_DISK);
+        free(tmp);
+    }
+    if (rc != 0) fprintf(stderr, "[forge] report %s: %s\n", report_path, strerror(err));
+    free(diagnostics);
+    free(git);
+    return rc;
+}
+
+int holos_project_generate_report(const struct holos_project *project, const char *report_path) {
+    const int rc = forge_report(project, report_path);
+    if (project) forge_notify((struct holos_project *)project, HOLOS_EVENT_ANALYTICS);
+    return rc;
+}
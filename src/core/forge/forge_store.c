@@ -0,0 +1,632 @@
+/* forge_store.c - Indexed project store of the HOLOS forge
+    Copyright (C) 2025  4137314 <holos@mail.com>
+
+    This file is part of HOLOS.
+
+    HOLOS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    HOLOS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+    ----------------------------------------------------------------------
+    Projects in one SQLite database (see forge.h), three tables:
+      projects         the summary fields, one narrow row per project,
+                       indexed on owner, organization and updated_at
+      project_details  the other string fields, read only when asked for
+      project_tags     (tag, id) per tag of a project, indexed on tag
+    so a listing walks an index to the rows it returns, and reads little
+    of each. The filter is turned into a WHERE clause with its values
+    bound, never pasted into the SQL.
+
+    The string fields of struct holos_project are described by the two
+    field tables below, from which the SQL is built when the store opens.
+    A save is one statement per table under a transaction: an upsert
+    whose NULL values leave the stored ones alone. The statements are
+    prepared once and kept; the store is used from one thread at a time.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sqlite3.h>
+
+#include "core/forge/forge.h"
+
+#define FORGE_PATH 4096
+#define FORGE_SQL 4096
+
+/* String field of struct holos_project and its column */
+struct forge_field {
+    const char *column;
+    size_t offset;
+};
+
+#define FORGE_FIELD(name) {#name, offsetof(struct holos_project, name)}
+
+/* projects: id first, then the strings read by a listing */
+static const struct forge_field g_summary[] = {
+    FORGE_FIELD(id),         FORGE_FIELD(name),    FORGE_FIELD(description),
+    FORGE_FIELD(version),    FORGE_FIELD(created_at), FORGE_FIELD(updated_at),
+    FORGE_FIELD(owner),      FORGE_FIELD(organization), FORGE_FIELD(tags),
+};
+
+static const struct forge_field g_details[] = {
+    FORGE_FIELD(database_path),      FORGE_FIELD(physics_file),
+    FORGE_FIELD(ai_file),            FORGE_FIELD(p2p_file),
+    FORGE_FIELD(git_repo_path),      FORGE_FIELD(compliance),
+    FORGE_FIELD(sustainability),     FORGE_FIELD(provenance),
+    FORGE_FIELD(analytics_path),     FORGE_FIELD(digital_twin_path),
+    FORGE_FIELD(diagnostics),        FORGE_FIELD(provenance_id),
+    FORGE_FIELD(ai_model_path),      FORGE_FIELD(compliance_report_path),
+    FORGE_FIELD(accessibility_notes), FORGE_FIELD(advanced_analytics_path),
+    FORGE_FIELD(dependencies),       FORGE_FIELD(collaborators),
+    FORGE_FIELD(audit_trail_path),   FORGE_FIELD(security_profile),
+    FORGE_FIELD(future_reserved1),   FORGE_FIELD(future_reserved2),
+    FORGE_FIELD(future_reserved3),   FORGE_FIELD(future_reserved4),
+};
+
+#define FORGE_N_SUMMARY (sizeof(g_summary) / sizeof(g_summary[0]))
+#define FORGE_N_DETAILS (sizeof(g_details) / sizeof(g_details[0]))
+#define FORGE_CREATED 4                 /* g_summary indices */
+#define FORGE_UPDATED 5
+
+/* The numbers after the summary strings, in this order */
+#define FORGE_NUMBERS "state, risk_score, sustainability_score, digital_twin_status"
+#define FORGE_N_NUMBERS 4
+
+static const char *const g_states[] = {"undefined", "init", "active", "paused", "completed", "archived", "error"};
+
+static char g_path[FORGE_PATH] = ".holos/forge.db";
+static sqlite3 *g_db = NULL;
+
+enum {
+    FORGE_PUT_SUMMARY,
+    FORGE_PUT_DETAILS,
+    FORGE_DROP_TAGS,
+    FORGE_PUT_TAG,
+    FORGE_GET_SUMMARY,
+    FORGE_GET_DETAILS,
+    FORGE_DELETE,
+    FORGE_COPY_DETAILS,
+    FORGE_BEGIN,
+    FORGE_COMMIT,
+    FORGE_ROLLBACK,
+    FORGE_STATEMENTS
+};
+
+static sqlite3_stmt *g_stmt[FORGE_STATEMENTS];
+
+static int forge_error(const char *what) {
+    fprintf(stderr, "[forge] %s: %s\n", what, g_db ? sqlite3_errmsg(g_db) : "no store");
+    return -1;
+}
+
+static char **forge_slot(struct holos_project *project, const struct forge_field *f) {
+    return (char **)((char *)project + f->offset);
+}
+
+static const char *forge_value(const struct holos_project *project, const struct forge_field *f) {
+    return *(char *const *)((const char *)project + f->offset);
+}
+
+/* ---------------- Opening ---------------- */
+
+static int forge_mkdirs(const char *path) {
+    char dir[FORGE_PATH];
+    snprintf(dir, sizeof(dir), "%s", path);
+    for (char *p = dir + 1; *p; p++) {
+        if (*p != '/') continue;
+        *p = '\0';
+        if (mkdir(dir, 0755) != 0 && errno != EEXIST) return -1;
+        *p = '/';
+    }
+    return 0;
+}
+
+/* Appends the columns of fields to sql, each as fmt (with %s the column) */
+static void forge_columns(char *sql, size_t n, const struct forge_field *fields, size_t count, const char *fmt) {
+    for (size_t i = 0; i < count; i++) {
+        size_t at = strlen(sql);
+        if (i) at += (size_t)snprintf(sql + at, n - at, ", ");
+        snprintf(sql + at, n - at, fmt, fields[i].column, fields[i].column, fields[i].column);
+    }
+}
+
+static void forge_params(char *sql, size_t n, size_t from, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        const size_t at = strlen(sql);
+        snprintf(sql + at, n - at, "%s?%zu", i ? ", " : "", from + i);
+    }
+}
+
+static int forge_schema(void) {
+    char sql[FORGE_SQL] = "CREATE TABLE IF NOT EXISTS projects (";
+    char *err = NULL;
+    forge_columns(sql, sizeof(sql), g_summary, FORGE_N_SUMMARY, "%s TEXT");
+    strncat(sql,
+            ", state INTEGER NOT NULL DEFAULT 0, risk_score REAL NOT NULL DEFAULT 0,"
+            " sustainability_score REAL NOT NULL DEFAULT 0, digital_twin_status INTEGER NOT NULL DEFAULT 0,"
+            " PRIMARY KEY (id)) WITHOUT ROWID;"
+            "CREATE INDEX IF NOT EXISTS projects_owner ON projects (owner, updated_at);"
+            "CREATE INDEX IF NOT EXISTS projects_organization ON projects (organization, updated_at);"
+            "CREATE INDEX IF NOT EXISTS projects_updated ON projects (updated_at);"
+            "CREATE TABLE IF NOT EXISTS project_details (id TEXT PRIMARY KEY"
+            " REFERENCES projects (id) ON DELETE CASCADE, ",
+            sizeof(sql) - strlen(sql) - 1);
+    forge_columns(sql, sizeof(sql), g_details, FORGE_N_DETAILS, "%s TEXT");
+    strncat(sql,
+            ") WITHOUT ROWID;"
+            "CREATE TABLE IF NOT EXISTS project_tags (tag TEXT NOT NULL,"
+            " id TEXT NOT NULL REFERENCES projects (id) ON DELETE CASCADE, PRIMARY KEY (tag, id)) WITHOUT ROWID;"
+            "CREATE INDEX IF NOT EXISTS project_tags_id ON project_tags (id);"
+            "PRAGMA user_version = 1;",
+            sizeof(sql) - strlen(sql) - 1);
+    if (sqlite3_exec(g_db, sql, NULL, NULL, &err) != SQLITE_OK) {
+        fprintf(stderr, "[forge] schema: %s\n", err ? err : "?");
+        sqlite3_free(err);
+        return -1;
+    }
+    return 0;
+}
+
+static int forge_prepare_all(void) {
+    char sql[FORGE_STATEMENTS][FORGE_SQL];
+    const size_t n = sizeof(sql[0]);
+    memset(sql, 0, sizeof(sql));
+
+    /* ?1.. the summary strings, then the numbers; a NULL keeps the
+       stored value, created_at is kept once set, updated_at replaced */
+    strcpy(sql[FORGE_PUT_SUMMARY], "INSERT INTO projects (");
+    forge_columns(sql[FORGE_PUT_SUMMARY], n, g_summary, FORGE_N_SUMMARY, "%s");
+    strcat(sql[FORGE_PUT_SUMMARY], ", " FORGE_NUMBERS ") VALUES (");
+    forge_params(sql[FORGE_PUT_SUMMARY], n, 1, FORGE_N_SUMMARY + FORGE_N_NUMBERS);
+    strcat(sql[FORGE_PUT_SUMMARY], ") ON CONFLICT (id) DO UPDATE SET ");
+    for (size_t i = 1; i < FORGE_N_SUMMARY; i++) {
+        const char *fmt = i == FORGE_CREATED ? "%s%s = coalesce(%s, excluded.%s)"
+                          : i == FORGE_UPDATED ? "%s%s = excluded.%s"
+                                               : "%s%s = coalesce(excluded.%s, %s)";
+        const size_t at = strlen(sql[FORGE_PUT_SUMMARY]);
+        snprintf(sql[FORGE_PUT_SUMMARY] + at, n - at, fmt, i > 1 ? ", " : "", g_summary[i].column,
+                 g_summary[i].column, g_summary[i].column);
+    }
+    strcat(sql[FORGE_PUT_SUMMARY], ", state = excluded.state, risk_score = excluded.risk_score,"
+                                   " sustainability_score = excluded.sustainability_score,"
+                                   " digital_twin_status = excluded.digital_twin_status");
+
+    strcpy(sql[FORGE_PUT_DETAILS], "INSERT INTO project_details (id, ");
+    forge_columns(sql[FORGE_PUT_DETAILS], n, g_details, FORGE_N_DETAILS, "%s");
+    strcat(sql[FORGE_PUT_DETAILS], ") VALUES (");
+    forge_params(sql[FORGE_PUT_DETAILS], n, 1, FORGE_N_DETAILS + 1);
+    strcat(sql[FORGE_PUT_DETAILS], ") ON CONFLICT (id) DO UPDATE SET ");
+    forge_columns(sql[FORGE_PUT_DETAILS], n, g_details, FORGE_N_DETAILS, "%s = coalesce(excluded.%s, %s)");
+
+    strcpy(sql[FORGE_DROP_TAGS], "DELETE FROM project_tags WHERE id = ?1");
+    strcpy(sql[FORGE_PUT_TAG], "INSERT OR IGNORE INTO project_tags (tag, id) VALUES (?1, ?2)");
+
+    strcpy(sql[FORGE_GET_SUMMARY], "SELECT ");
+    forge_columns(sql[FORGE_GET_SUMMARY], n, g_summary, FORGE_N_SUMMARY, "%s");
+    strcat(sql[FORGE_GET_SUMMARY], ", " FORGE_NUMBERS " FROM projects WHERE id = ?1");
+
+    strcpy(sql[FORGE_GET_DETAILS], "SELECT ");
+    forge_columns(sql[FORGE_GET_DETAILS], n, g_details, FORGE_N_DETAILS, "%s");
+    strcat(sql[FORGE_GET_DETAILS], " FROM project_details WHERE id = ?1");
+
+    strcpy(sql[FORGE_DELETE], "DELETE FROM projects WHERE id = ?1");
+
+    /* ?1 the new ID, ?2 the one copied, ?3.. the details in memory:
+       a NULL takes the copied one's stored value */
+    strcpy(sql[FORGE_COPY_DETAILS], "INSERT OR REPLACE INTO project_details (id, ");
+    forge_columns(sql[FORGE_COPY_DETAILS], n, g_details, FORGE_N_DETAILS, "%s");
+    strcat(sql[FORGE_COPY_DETAILS], ") SELECT ?1");
+    for (size_t i = 0; i < FORGE_N_DETAILS; i++) {
+        const size_t at = strlen(sql[FORGE_COPY_DETAILS]);
+        snprintf(sql[FORGE_COPY_DETAILS] + at, n - at, ", coalesce(?%zu, %s)", i + 3, g_details[i].column);
+    }
+    strcat(sql[FORGE_COPY_DETAILS], " FROM project_details WHERE id = ?2");
+
+    strcpy(sql[FORGE_BEGIN], "BEGIN IMMEDIATE");
+    strcpy(sql[FORGE_COMMIT], "COMMIT");
+    strcpy(sql[FORGE_ROLLBACK], "ROLLBACK");
+
+    for (int i = 0; i < FORGE_STATEMENTS; i++)
+        if (sqlite3_prepare_v2(g_db, sql[i], -1, &g_stmt[i], NULL) != SQLITE_OK) return forge_error("prepare");
+    return 0;
+}
+
+void holos_project_store_close(void) {
+    for (int i = 0; i < FORGE_STATEMENTS; i++) {
+        sqlite3_finalize(g_stmt[i]);
+        g_stmt[i] = NULL;
+    }
+    sqlite3_close(g_db);
+    g_db = NULL;
+}
+
+static int forge_open(void) {
+    if (g_db) return 0;
+    if (forge_mkdirs(g_path) != 0 || sqlite3_open(g_path, &g_db) != SQLITE_OK) {
+        forge_error(g_path);
+        holos_project_store_close();
+        return -1;
+    }
+    sqlite3_busy_timeout(g_db, 5000);
+    if (sqlite3_exec(g_db, "PRAGMA journal_mode = WAL; PRAGMA synchronous = NORMAL; PRAGMA foreign_keys = ON;"
+                     " PRAGMA cache_size = -65536;", NULL,
+                     NULL, NULL) != SQLITE_OK ||
+        forge_schema() != 0 || forge_prepare_all() != 0) {
+        holos_project_store_close();
+        return -1;
+    }
+    return 0;
+}
+
+int holos_project_store(const char *path) {
+    if (!path || !*path || strlen(path) >= FORGE_PATH) return -1;
+    holos_project_store_close();
+    strcpy(g_path, path);
+    return forge_open();
+}
+
+/* ---------------- Rows ---------------- */
+
+static int forge_step(sqlite3_stmt *stmt) {
+    const int rc = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    return rc == SQLITE_DONE || rc == SQLITE_ROW ? 0 : -1;
+}
+
+static int forge_exec(int which) {
+    return forge_step(g_stmt[which]);
+}
+
+static void forge_bind_text(sqlite3_stmt *stmt, int at, const char *value) {
+    if (value) sqlite3_bind_text(stmt, at, value, -1, SQLITE_STATIC);
+    else sqlite3_bind_null(stmt, at);
+}
+
+/* Column at of the current row into *slot, if not set already; the
+   empty string stands for a cleared field. */
+static int forge_take(sqlite3_stmt *stmt, int at, char **slot) {
+    const unsigned char *v = sqlite3_column_text(stmt, at);
+    if (*slot || !v || !*v) return 0;
+    return (*slot = strdup((const char *)v)) ? 0 : -1;
+}
+
+static int forge_take_summary(sqlite3_stmt *stmt, struct holos_project *p) {
+    for (size_t i = 0; i < FORGE_N_SUMMARY; i++)
+        if (forge_take(stmt, (int)i, forge_slot(p, &g_summary[i])) != 0) return -1;
+    p->state = (holos_project_state)sqlite3_column_int(stmt, FORGE_N_SUMMARY);
+    p->risk_score = sqlite3_column_double(stmt, FORGE_N_SUMMARY + 1);
+    p->sustainability_score = sqlite3_column_double(stmt, FORGE_N_SUMMARY + 2);
+    p->digital_twin_status = sqlite3_column_int(stmt, FORGE_N_SUMMARY + 3);
+    return 0;
+}
+
+/* Each tag of a comma-separated list, spaces trimmed, to project_tags */
+static int forge_put_tags(const char *id, const char *tags) {
+    sqlite3_stmt *stmt = g_stmt[FORGE_PUT_TAG];
+    sqlite3_bind_text(g_stmt[FORGE_DROP_TAGS], 1, id, -1, SQLITE_STATIC);
+    if (forge_exec(FORGE_DROP_TAGS) != 0) return -1;
+    while (*tags) {
+        const char *end = strchr(tags, ',');
+        size_t n;
+        if (!end) end = tags + strlen(tags);
+        while (tags < end && *tags == ' ') tags++;
+        n = (size_t)(end - tags);
+        while (n && tags[n - 1] == ' ') n--;
+        if (n) {
+            sqlite3_bind_text(stmt, 1, tags, (int)n, SQLITE_STATIC);
+            sqlite3_bind_text(stmt, 2, id, -1, SQLITE_STATIC);
+            if (forge_step(stmt) != 0) return -1;
+        }
+        tags = *end ? end + 1 : end;
+    }
+    return 0;
+}
+
+/* The projects row and the tags of p */
+static int forge_put_summary(const struct holos_project *p) {
+    sqlite3_stmt *stmt = g_stmt[FORGE_PUT_SUMMARY];
+    char now[32];
+    const time_t t = time(NULL);
+    struct tm tm;
+    if (!p || !p->id || !*p->id) return -1;
+    gmtime_r(&t, &tm);
+    strftime(now, sizeof(now), "%Y-%m-%dT%H:%M:%SZ", &tm);
+    for (size_t i = 0; i < FORGE_N_SUMMARY; i++) {
+        const char *v = forge_value(p, &g_summary[i]);
+        if (i == FORGE_UPDATED || (i == FORGE_CREATED && !v)) v = now;
+        forge_bind_text(stmt, (int)i + 1, v);
+    }
+    sqlite3_bind_int(stmt, FORGE_N_SUMMARY + 1, (int)p->state);
+    sqlite3_bind_double(stmt, FORGE_N_SUMMARY + 2, p->risk_score);
+    sqlite3_bind_double(stmt, FORGE_N_SUMMARY + 3, p->sustainability_score);
+    sqlite3_bind_int(stmt, FORGE_N_SUMMARY + 4, p->digital_twin_status);
+    if (forge_step(stmt) != 0) return forge_error("save");
+    if (p->tags && forge_put_tags(p->id, p->tags) != 0) return forge_error("save tags");
+    return 0;
+}
+
+static int forge_put_details(const struct holos_project *p) {
+    sqlite3_stmt *stmt = g_stmt[FORGE_PUT_DETAILS];
+    sqlite3_bind_text(stmt, 1, p->id, -1, SQLITE_STATIC);
+    for (size_t i = 0; i < FORGE_N_DETAILS; i++) forge_bind_text(stmt, (int)i + 2, forge_value(p, &g_details[i]));
+    return forge_step(stmt) == 0 ? 0 : forge_error("save");
+}
+
+static int forge_put(const struct holos_project *p) {
+    if (forge_put_summary(p) != 0) return -1;
+    return forge_put_details(p);
+}
+
+static int forge_begin(void) {
+    if (forge_open() != 0) return -1;
+    return forge_exec(FORGE_BEGIN) == 0 ? 0 : forge_error("begin");
+}
+
+static int forge_end(int rc) {
+    if (rc == 0 && forge_exec(FORGE_COMMIT) == 0) return 0;
+    if (rc == 0) forge_error("commit");
+    forge_exec(FORGE_ROLLBACK);
+    return -1;
+}
+
+/* ---------------- Projects ---------------- */
+
+static char *forge_strdup(const char *s) {
+    return s ? strdup(s) : NULL;
+}
+
+struct holos_project *holos_project_create(const char *name, const char *description) {
+    struct holos_project *p;
+    unsigned char bytes[8];
+    char id[17];
+    FILE *rnd;
+    int ok = 0;
+    if (!name || !*name) return NULL;
+    if ((rnd = fopen("/dev/urandom", "rb"))) {
+        ok = fread(bytes, 1, sizeof(bytes), rnd) == sizeof(bytes);
+        fclose(rnd);
+    }
+    if (!ok) {
+        const uint64_t seed = (uint64_t)time(NULL) * 6364136223846793005u + (uint64_t)(uintptr_t)&bytes;
+        for (size_t i = 0; i < sizeof(bytes); i++) bytes[i] = (unsigned char)(seed >> (8 * i));
+    }
+    for (size_t i = 0; i < sizeof(bytes); i++) snprintf(id + 2 * i, 3, "%02x", bytes[i]);
+    p = calloc(1, sizeof(*p));
+    if (!p) return NULL;
+    p->id = strdup(id);
+    p->name = strdup(name);
+    p->description = forge_strdup(description);
+    p->state = HOLOS_PROJECT_STATE_INIT;
+    if (!p->id || !p->name || (description && !p->description)) {
+        holos_project_free(p);
+        return NULL;
+    }
+    return p;
+}
+
+void holos_project_free(struct holos_project *project) {
+    if (!project) return;
+    for (size_t i = 0; i < FORGE_N_SUMMARY; i++) free(*forge_slot(project, &g_summary[i]));
+    for (size_t i = 0; i < FORGE_N_DETAILS; i++) free(*forge_slot(project, &g_details[i]));
+    free(project);
+}
+
+int holos_project_load_details(struct holos_project *project) {
+    sqlite3_stmt *stmt;
+    int rc = 0;
+    if (!project || !project->id || forge_open() != 0) return -1;
+    stmt = g_stmt[FORGE_GET_DETAILS];
+    sqlite3_bind_text(stmt, 1, project->id, -1, SQLITE_STATIC);
+    if (sqlite3_step(stmt) == SQLITE_ROW)
+        for (size_t i = 0; rc == 0 && i < FORGE_N_DETAILS; i++)
+            rc = forge_take(stmt, (int)i, forge_slot(project, &g_details[i]));
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    return rc;
+}
+
+struct holos_project *holos_project_load(const char *id) {
+    struct holos_project *p;
+    sqlite3_stmt *stmt;
+    int rc;
+    if (!id || forge_open() != 0) return NULL;
+    stmt = g_stmt[FORGE_GET_SUMMARY];
+    sqlite3_bind_text(stmt, 1, id, -1, SQLITE_STATIC);
+    if (sqlite3_step(stmt) != SQLITE_ROW) {
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+        return NULL;
+    }
+    p = calloc(1, sizeof(*p));
+    rc = p ? forge_take_summary(stmt, p) : -1;
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    if (rc != 0 || holos_project_load_details(p) != 0) {
+        holos_project_free(p);
+        return NULL;
+    }
+    return p;
+}
+
+int holos_project_save(const struct holos_project *project) {
+    if (forge_begin() != 0) return -1;
+    return forge_end(forge_put(project));
+}
+
+int holos_project_batch_save(struct holos_project **projects, size_t count) {
+    int rc = 0;
+    if (!projects && count) return -1;
+    if (forge_begin() != 0) return -1;
+    for (size_t i = 0; rc == 0 && i < count; i++) rc = forge_put(projects[i]);
+    return forge_end(rc);
+}
+
+int holos_project_delete(const char *id) {
+    int rc;
+    if (!id || forge_open() != 0) return -1;
+    sqlite3_bind_text(g_stmt[FORGE_DELETE], 1, id, -1, SQLITE_STATIC);
+    rc = forge_exec(FORGE_DELETE);
+    if (rc != 0) return forge_error("delete");
+    return sqlite3_changes(g_db) ? 0 : -1;
+}
+
+/* The details src has not loaded are copied from its row: the new
+   rows are each written once */
+int holos_project_clone(const struct holos_project *src, const char *new_id) {
+    struct holos_project copy;
+    int rc;
+    if (!src || !src->id || !new_id || !*new_id || strcmp(src->id, new_id) == 0) return -1;
+    copy = *src;
+    copy.id = (char *)new_id;
+    copy.created_at = NULL;
+    if (forge_begin() != 0) return -1;
+    rc = forge_put_summary(&copy);
+    if (rc == 0) {
+        sqlite3_stmt *stmt = g_stmt[FORGE_COPY_DETAILS];
+        sqlite3_bind_text(stmt, 1, new_id, -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 2, src->id, -1, SQLITE_STATIC);
+        for (size_t i = 0; i < FORGE_N_DETAILS; i++)
+            forge_bind_text(stmt, (int)i + 3, forge_value(&copy, &g_details[i]));
+        if (forge_step(stmt) != 0) rc = forge_error("clone");
+        else if (sqlite3_changes(g_db) == 0) rc = forge_put_details(&copy); /* src has no row of details */
+    }
+    return forge_end(rc);
+}
+
+/* ---------------- Listing ---------------- */
+
+static int forge_state(const char *v) {
+    char *end;
+    long n;
+    for (size_t i = 0; i < sizeof(g_states) / sizeof(g_states[0]); i++)
+        if (strcmp(v, g_states[i]) == 0) return (int)i;
+    n = strtol(v, &end, 10);
+    return *v && !*end && n >= 0 && n <= HOLOS_PROJECT_STATE_ERROR ? (int)n : -1;
+}
+
+/* v with LIKE's wildcards and the escape escaped, into out: past it */
+static char *forge_like_escape(const char *v, char *out) {
+    for (; *v; v++) {
+        if (*v == '%' || *v == '_' || *v == '\\') *out++ = '\\';
+        *out++ = *v;
+    }
+    *out++ = '\0';
+    return out;
+}
+
+/* Turns filter into a WHERE clause in sql, its values (pointers into
+   terms, a copy of filter, or for names into escaped, of twice its
+   size) in values, or in numbers if not -1 there: the number of
+   values, or -1. */
+static int forge_where(char *terms, char *escaped, char *sql, size_t n, const char **values, int *numbers, int max) {
+    int count = 0;
+    strcpy(sql, " WHERE 1");
+    for (char *save = NULL, *t = strtok_r(terms, " \t", &save); t; t = strtok_r(NULL, " \t", &save)) {
+        char *v = strchr(t, ':');
+        const char *clause;
+        if (count == max) return -1;
+        numbers[count] = -1;
+        if (!v) {
+            clause = " AND name LIKE '%%' || ?%d || '%%' ESCAPE '\\'";
+            v = escaped;
+            escaped = forge_like_escape(t, escaped);
+        } else {
+            *v++ = '\0';
+            if (!*v) return -1;
+            if (strcmp(t, "owner") == 0) clause = " AND owner = ?%d";
+            else if (strcmp(t, "org") == 0) clause = " AND organization = ?%d";
+            else if (strcmp(t, "tag") == 0) clause = " AND id IN (SELECT id FROM project_tags WHERE tag = ?%d)";
+            else if (strcmp(t, "since") == 0) clause = " AND updated_at >= ?%d";
+            else if (strcmp(t, "before") == 0) clause = " AND updated_at < ?%d";
+            else if (strcmp(t, "state") == 0) {
+                if ((numbers[count] = forge_state(v)) < 0) return -1;
+                clause = " AND state = ?%d";
+            } else {
+                return -1;
+            }
+        }
+        values[count++] = v;
+        snprintf(sql + strlen(sql), n - strlen(sql), clause, count);
+    }
+    return count;
+}
+
+int holos_project_list(const char *filter, struct holos_project ***out_projects, size_t *out_count) {
+    char sql[2 * FORGE_SQL] = "SELECT ", where[FORGE_SQL];
+    const char *values[32];
+    int numbers[32];
+    struct holos_project **list = NULL;
+    size_t count = 0, cap = 0;
+    sqlite3_stmt *stmt;
+    char *terms;
+    int n, rc = 0, step;
+    if (!out_projects || !out_count) return -1;
+    *out_projects = NULL;
+    *out_count = 0;
+    if (!filter) filter = "";
+    /* The terms, then room for their escaped names */
+    if (forge_open() != 0 || !(terms = malloc(3 * strlen(filter) + 2))) return -1;
+    strcpy(terms, filter);
+    n = forge_where(terms, terms + strlen(filter) + 1, where, sizeof(where), values, numbers, 32);
+    if (n < 0) {
+        fprintf(stderr, "[forge] bad filter: %s\n", filter);
+        free(terms);
+        return -1;
+    }
+    forge_columns(sql, sizeof(sql), g_summary, FORGE_N_SUMMARY, "%s");
+    snprintf(sql + strlen(sql), sizeof(sql) - strlen(sql), ", %s FROM projects%s ORDER BY updated_at DESC, id",
+             FORGE_NUMBERS, where);
+    if (sqlite3_prepare_v2(g_db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+        free(terms);
+        return forge_error("list");
+    }
+    for (int i = 0; i < n; i++) {
+        if (numbers[i] >= 0) sqlite3_bind_int(stmt, i + 1, numbers[i]);
+        else sqlite3_bind_text(stmt, i + 1, values[i], -1, SQLITE_STATIC);
+    }
+    while (rc == 0 && (step = sqlite3_step(stmt)) == SQLITE_ROW) {
+        struct holos_project *p;
+        if (count == cap) {
+            const size_t grown = cap ? 2 * cap : 64;
+            struct holos_project **more = realloc(list, grown * sizeof(*more));
+            if (!more) {
+                rc = -1;
+                break;
+            }
+            list = more;
+            cap = grown;
+        }
+        if (!(p = calloc(1, sizeof(*p))) || forge_take_summary(stmt, p) != 0) {
+            holos_project_free(p);
+            rc = -1;
+            break;
+        }
+        list[count++] = p;
+    }
+    if (rc == 0 && step != SQLITE_DONE) rc = forge_error("list");
+    sqlite3_finalize(stmt);
+    free(terms);
+    if (rc != 0) {
+        for (size_t i = 0; i < count; i++) holos_project_free(list[i]);
+        free(list);
+        return -1;
+    }
+    *out_projects = list;
+    *out_count = count;
+    return 0;
+}
@@ -0,0 +1,52 @@
+/* forge_work.h - Shared by the forge modules of HOLOS
+    Copyright (C) 2025  4137314 <holos@mail.com>
+
+    This file is part of HOLOS.
+
+    HOLOS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    HOLOS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+    ----------------------------------------------------------------------
+    Private to src/core/forge. The work on a project (diagnostics,
+    compliance, reports) may run in the threads of the batch pool, so it
+    passes the gates below around git and file operations, and tells the
+    event callbacks through forge_notify.
+*/
+
+#ifndef HOLOS_FORGE_WORK_H
+#define HOLOS_FORGE_WORK_H
+
+#include "core/forge/forge.h"
+
+/* Gates: at most their limit of holders at a time (forge_project.c) */
+enum {
+    FORGE_GATE_GIT,
+    FORGE_GATE_DISK,
+    FORGE_GATES
+};
+
+void forge_gate_enter(int gate);
+void forge_gate_leave(int gate);
+void forge_gate_limit(int gate, unsigned limit);
+
+/* Calls the callbacks of project and those of every project, one call
+   at a time: nonzero if one returned nonzero. */
+int forge_notify(struct holos_project *project, holos_project_event_type event);
+
+/* The work of holos_project_run_diagnostics, _check_compliance and
+   _generate_report, without the callbacks (forge_project.c) */
+int forge_diagnostics(struct holos_project *project);
+int forge_compliance(const struct holos_project *project);
+int forge_report(const struct holos_project *project, const char *report_path);
+
+#endif /* HOLOS_FORGE_WORK_H */
@@ -17,16 +17,44 @@
     along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
 
     ----------------------------------------------------------------------
-    Minimal GNUnet-aware P2P helper for HOLOS.
-    - Builds and runs even when GNUnet is not present (graceful fallback).
-    - To compile with GNUnet: use -DHAVE_GNUNET and link with gnunetutil.
-    - If using Autotools, add PKG_CHECK_MODULES for gnunet in configure.ac.
+    GNUnet-aware P2P layer for HOLOS.
+    - Builds and runs even when GNUnet is not present (graceful fallback:
+      connected peers are loopback links, run by holos_p2p_poll).
+    - configure defines HAVE_GNUNET and links gnunetutil, gnunetcadet and
+      gnunetpeerinfo when it finds them (--without-gnunet forces the
+      loopback).
+
+    Every connected peer is a link: one CADET channel on the HOLOS port
+    and a send queue. Publishes, subscription changes and messages are
+    records appended to the link's open frame; a frame closes when the
+    next record does not fit or when the coalescing task fires, so a
+    burst of small messages costs one CADET message. Up to P2P_INFLIGHT
+    frames per link are in the message queue at a time, closed frames
+    wait here, and a link with more than P2P_HIGH_WATER bytes queued refuses
+    new records with HOLOS_P2P_ERR_AGAIN until it drains below
+    P2P_LOW_WATER (the "drain" event). All of it runs as GNUnet
+    scheduler tasks (g_sched) in the caller's thread: nothing blocks.
+
+    Frame: records back to back, each
+      u8 kind, u8 topic length, u16 0, u32 length (network order),
+      topic bytes, length bytes of payload
+    A MESSAGE record's payload starts with
+      u8 type, u8 0, u16 0, sender and receiver (HOLOS_P2P_PEER_ID_SIZE
+      bytes each, receiver zero for a broadcast)
+    and is gathered into the frame from the caller's pieces; receivers
+    get a view of it in the frame.
+    Peers tell each other their subscriptions (SUBSCRIBE/UNSUBSCRIBE
+    records) and a publish goes only to the links that follow its topic.
+    The kinds above MESSAGE belong to the modules of p2p_link.h.
 */
 
+#include "config.h"
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <signal.h>
+#include <time.h>
+#include <arpa/inet.h>
 
 #ifdef HAVE_GNUNET
 /* GNUnet headers (the exact header names depend on installed GNUnet version).
@@ -35,45 +63,806 @@
 #include <gnunet/gnunet_util_lib.h>
 #include <gnunet/gnunet_peerinfo_service.h>
 #include <gnunet/gnunet_scheduler.h>
+#include <gnunet/gnunet_cadet_service.h>
+#endif
+
+#include "core/p2p/p2p.h"
+#include "core/p2p/p2p_stats.h"
+#include "p2p_link.h"
+
+#define P2P_PORT "holos-p2p"        /* CADET port name, hashed */
+#define P2P_MESSAGE_TYPE 40960      /* GNUnet message type of HOLOS frames */
+#define P2P_INFLIGHT 16             /* Frames in the message queue, per link */
+#define P2P_HIGH_WATER (1u << 20)   /* Queued bytes at which a link refuses records */
+#define P2P_LOW_WATER (1u << 18)    /* ... and drains again */
+#define P2P_COALESCE_MS 1           /* Delay of the flush of a partial frame */
+
+#define P2P_WATCHERS 8              /* Modules watching the links */
+#define P2P_MESSAGE_HEAD (4 + 2 * HOLOS_P2P_PEER_ID_SIZE)
+#define P2P_INBOX 1024              /* Messages kept for holos_p2p_receive_message */
+
+struct p2p_sub {
+    char *topic;
+    uint64_t hash;
+    holos_p2p_topic_callback cb;
+    void *cls;
+};
+
+/* Closed frame waiting for a place in the message queue */
+struct p2p_frame {
+    struct p2p_frame *next;
+    size_t n;
+    unsigned char data[];
+};
+
+/* Message kept for holos_p2p_receive_message */
+struct p2p_inbox {
+    struct p2p_inbox *next;
+    enum holos_p2p_message_type type;
+    char *peer;                     /* Into data, after the payload */
+    size_t size;
+    time_t timestamp;
+    unsigned char data[];
+};
+
+struct p2p_link {
+    char *id;                       /* Peer identity, printable */
+    holos_p2p_peer_id_t bin;        /* ... and binary */
+    unsigned char frame[P2P_FRAME_MAX];
+    size_t used;                    /* Bytes in the open frame */
+    struct p2p_frame *ready, *last; /* Closed frames, oldest first */
+    size_t ready_bytes;
+    size_t sent[P2P_INFLIGHT];      /* Sizes of the frames in the message queue, oldest first */
+    size_t head, count, inflight;   /* ... and their total */
+    uint64_t *topics;               /* Hashes of the peer's subscriptions */
+    size_t n_topics, cap_topics;
+    int blocked;                    /* Refused a record: "drain" is due */
+    struct p2p_stats_peer *stats;   /* Its counters (p2p_stats.c) */
+#ifdef HAVE_GNUNET
+    struct GNUNET_CADET_Channel *channel;
+    struct GNUNET_SCHEDULER_Task *flush_task;
+#endif
+};
+
+static struct p2p_sub *g_subs = NULL;
+static size_t g_n_subs = 0, g_cap_subs = 0;
+static struct p2p_link **g_links = NULL;
+static size_t g_n_links = 0, g_cap_links = 0;
+static holos_p2p_event_callback g_event_cb = NULL;
+static p2p_record_fn g_handlers[P2P_REC_KINDS];
+static p2p_peer_fn g_drain_fns[P2P_WATCHERS], g_gone_fns[P2P_WATCHERS];
+static void (*g_finalize_fns[P2P_WATCHERS])(void);
+static size_t g_n_watchers = 0;
+static void (*g_tick_fns[P2P_WATCHERS])(void);
+static size_t g_n_ticks = 0;
+static holos_p2p_message_callback g_msg_cb = NULL;
+static void *g_msg_cls = NULL;
+static holos_p2p_peer_id_t g_self;
+static struct p2p_inbox *g_inbox = NULL, *g_inbox_last = NULL;
+static size_t g_n_inbox = 0;
+
+static int p2p_transmit(struct p2p_link *link, const unsigned char *frame, size_t n);
+static void p2p_schedule_flush(struct p2p_link *link);
+
+/* ---------------- Links, records and subscriptions ---------------- */
+
+static uint64_t p2p_hash(const char *s) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    while (*s) h = (h ^ (unsigned char)*s++) * 0x100000001b3ULL;
+    return h;
+}
+
+static void p2p_emit(const char *type, void *data) {
+    struct holos_p2p_event ev;
+    if (!g_event_cb) return;
+    ev.event_type = (char *)type;
+    ev.event_data = data;
+    ev.timestamp = time(NULL);
+    if (p2p_event_post(g_event_cb, &ev) == 0) g_event_cb(&ev);    /* -1: dropped, and counted */
+}
+
+void p2p_link_emit(const char *type, void *data) {
+    p2p_emit(type, data);
+}
+
+int p2p_link_handle(int kind, p2p_record_fn fn) {
+    if (kind <= P2P_REC_MESSAGE || kind >= P2P_REC_KINDS) return -1;
+    g_handlers[kind] = fn;
+    return 0;
+}
+
+int p2p_link_watch(p2p_peer_fn drain, p2p_peer_fn gone, void (*finalize)(void)) {
+    for (size_t i = 0; i < g_n_watchers; i++)
+        if (g_drain_fns[i] == drain && g_gone_fns[i] == gone && g_finalize_fns[i] == finalize) return 0;
+    if (g_n_watchers == P2P_WATCHERS) return -1;
+    g_drain_fns[g_n_watchers] = drain;
+    g_gone_fns[g_n_watchers] = gone;
+    g_finalize_fns[g_n_watchers++] = finalize;
+    return 0;
+}
+
+int p2p_link_tick(void (*fn)(void)) {
+    for (size_t i = 0; i < g_n_ticks; i++)
+        if (g_tick_fns[i] == fn) return 0;
+    if (!fn || g_n_ticks == P2P_WATCHERS) return -1;
+    g_tick_fns[g_n_ticks++] = fn;
+    return 0;
+}
+
+static void p2p_ticks(void) {
+    for (size_t i = 0; i < g_n_ticks; i++) g_tick_fns[i]();
+}
+
+int holos_p2p_register_event_callback(holos_p2p_event_callback cb) {
+    g_event_cb = cb;
+    return HOLOS_P2P_OK;
+}
+
+void holos_p2p_error(const char *msg, enum holos_p2p_error code) {
+    fprintf(stderr, "[p2p] %s (error %d)\n", msg ? msg : "error", (int)code);
+}
+
+static struct p2p_link *p2p_link_find(const char *id) {
+    for (size_t i = 0; id && i < g_n_links; i++)
+        if (strcmp(g_links[i]->id, id) == 0) return g_links[i];
+    return NULL;
+}
+
+static struct p2p_link *p2p_link_new(const char *id) {
+    struct p2p_link *link;
+    if (g_n_links == g_cap_links) {
+        const size_t cap = g_cap_links ? 2 * g_cap_links : 8;
+        struct p2p_link **grown = realloc(g_links, cap * sizeof(*grown));
+        if (!grown) return NULL;
+        g_links = grown;
+        g_cap_links = cap;
+    }
+    link = calloc(1, sizeof(*link));
+    if (!link) return NULL;
+    link->id = strdup(id);
+    if (!link->id || holos_p2p_peer_id_parse(id, &link->bin) != 0) {
+        free(link->id);
+        free(link);
+        return NULL;
+    }
+    link->stats = p2p_stats_peer(link->id);
+    g_links[g_n_links++] = link;
+    p2p_peer_link(link->id, 1);
+    return link;
+}
+
+/* Unlinks and frees; the channel is the caller's. */
+static void p2p_link_free(struct p2p_link *link) {
+    for (size_t i = 0; i < g_n_watchers; i++)
+        if (g_gone_fns[i]) g_gone_fns[i](link->id);
+    p2p_peer_link(link->id, 0);
+    for (size_t i = 0; i < g_n_links; i++)
+        if (g_links[i] == link) {
+            g_links[i] = g_links[--g_n_links];
+            break;
+        }
+#ifdef HAVE_GNUNET
+    if (link->flush_task) GNUNET_SCHEDULER_cancel(link->flush_task);
 #endif
+    while (link->ready) {
+        struct p2p_frame *f = link->ready;
+        link->ready = f->next;
+        free(f);
+    }
+    free(link->topics);
+    free(link->id);
+    free(link);
+}
+
+static size_t p2p_link_queued(const struct p2p_link *link) {
+    return link->used + link->ready_bytes + link->inflight;
+}
+
+int p2p_link_depth(const char *id, size_t *queued, size_t *frames_queued, size_t *frames_inflight) {
+    const struct p2p_link *link = p2p_link_find(id);
+    size_t waiting = 0;
+    if (!link) return -1;
+    for (const struct p2p_frame *f = link->ready; f; f = f->next) waiting++;
+    if (queued) *queued = p2p_link_queued(link);
+    if (frames_queued) *frames_queued = waiting;
+    if (frames_inflight) *frames_inflight = link->count;
+    return 0;
+}
+
+static int p2p_link_follows(const struct p2p_link *link, uint64_t hash) {
+    for (size_t i = 0; i < link->n_topics; i++)
+        if (link->topics[i] == hash) return 1;
+    return 0;
+}
+
+static void p2p_link_send(struct p2p_link *link, const unsigned char *frame, size_t n) {
+    if (p2p_transmit(link, frame, n) != 0) return;
+    p2p_stats_frame(link->stats, 1, n);
+    link->sent[(link->head + link->count) % P2P_INFLIGHT] = n;
+    link->count++;
+    link->inflight += n;
+}
+
+/* Closes the open frame: to the transport, or behind the frames
+   waiting while P2P_INFLIGHT are in the message queue. */
+static void p2p_link_flush(struct p2p_link *link) {
+    if (link->used == 0) return;
+    if (link->count < P2P_INFLIGHT && !link->ready) {
+        p2p_link_send(link, link->frame, link->used);
+    } else {
+        struct p2p_frame *f = malloc(sizeof(*f) + link->used);
+        if (!f) {
+            fprintf(stderr, "[p2p] out of memory, frame to %s dropped\n", link->id);
+            link->used = 0;
+            return;
+        }
+        f->next = NULL;
+        f->n = link->used;
+        memcpy(f->data, link->frame, link->used);
+        if (link->last) link->last->next = f;
+        else link->ready = f;
+        link->last = f;
+        link->ready_bytes += f->n;
+    }
+    link->used = 0;
+}
 
-static volatile int keep_running = 1;
+/* The oldest frame in the message queue went out. */
+static void p2p_frame_sent(struct p2p_link *link) {
+    if (link->count == 0) return;
+    link->inflight -= link->sent[link->head];
+    link->head = (link->head + 1) % P2P_INFLIGHT;
+    link->count--;
+    while (link->ready && link->count < P2P_INFLIGHT) {
+        struct p2p_frame *f = link->ready;
+        link->ready = f->next;
+        if (!link->ready) link->last = NULL;
+        link->ready_bytes -= f->n;
+        p2p_link_send(link, f->data, f->n);
+        free(f);
+    }
+    if (link->blocked && p2p_link_queued(link) < P2P_LOW_WATER) {
+        link->blocked = 0;
+        p2p_emit("drain", link->id);
+        for (size_t i = 0; i < g_n_watchers; i++)
+            if (g_drain_fns[i]) g_drain_fns[i](link->id);
+    }
+}
+
+static size_t p2p_record_size(const char *topic, size_t size) {
+    return P2P_RECORD_HEAD + (topic ? strlen(topic) : 0) + size;
+}
+
+static size_t p2p_iov_size(const struct holos_p2p_iovec *iov, size_t n) {
+    size_t size = 0;
+    for (size_t i = 0; i < n; i++) size += iov[i].len;
+    return size;
+}
+
+/* Appends a record gathered from iov to the open frame of link,
+   flushing first when it would not fit. The caller has checked the
+   size and the queue. */
+static void p2p_link_putv(struct p2p_link *link, int kind, const char *topic, const struct holos_p2p_iovec *iov,
+                          size_t n) {
+    const size_t tlen = topic ? strlen(topic) : 0, size = p2p_iov_size(iov, n);
+    const uint32_t len = htonl((uint32_t)size);
+    unsigned char *r;
+    if (link->used + P2P_RECORD_HEAD + tlen + size > P2P_FRAME_MAX) p2p_link_flush(link);
+    r = link->frame + link->used;
+    r[0] = (unsigned char)kind;
+    r[1] = (unsigned char)tlen;
+    r[2] = r[3] = 0;
+    memcpy(r + 4, &len, 4);
+    if (tlen) memcpy(r + P2P_RECORD_HEAD, topic, tlen);
+    r += P2P_RECORD_HEAD + tlen;
+    for (size_t i = 0; i < n; r += iov[i++].len)
+        if (iov[i].len) memcpy(r, iov[i].base, iov[i].len);
+    if (link->used == 0) p2p_schedule_flush(link);
+    link->used += P2P_RECORD_HEAD + tlen + size;
+    p2p_stats_record(link->stats, 1, kind, P2P_RECORD_HEAD + tlen + size);
+}
+
+static void p2p_link_put(struct p2p_link *link, int kind, const char *topic, const void *head, size_t nhead,
+                         const void *data, size_t size) {
+    const struct holos_p2p_iovec iov[2] = {{head, nhead}, {data, size}};
+    p2p_link_putv(link, kind, topic, iov, 2);
+}
+
+/* Whether link can take bytes more; marks it blocked if not. */
+static int p2p_link_admits(struct p2p_link *link, size_t bytes) {
+    if (p2p_link_queued(link) + bytes > P2P_HIGH_WATER) {
+        link->blocked = 1;
+        p2p_stats_retry(link->stats, HOLOS_P2P_RETRY_REFUSED);
+        return 0;
+    }
+    return 1;
+}
+
+static void p2p_deliver(const char *topic, const char *sender, const void *data, size_t size) {
+    const uint64_t hash = p2p_hash(topic);
+    /* A callback may unsubscribe: walk a snapshot of the count */
+    for (size_t i = 0, n = g_n_subs; i < n && i < g_n_subs; i++)
+        if (g_subs[i].hash == hash && strcmp(g_subs[i].topic, topic) == 0)
+            g_subs[i].cb(topic, sender, data, size, g_subs[i].cls);
+}
+
+static int p2p_topic_followed(uint64_t hash) {
+    for (size_t i = 0; i < g_n_subs; i++)
+        if (g_subs[i].hash == hash) return 1;
+    return 0;
+}
+
+/* Tells link every topic followed here (a new link). */
+static void p2p_link_announce(struct p2p_link *link) {
+    for (size_t i = 0; i < g_n_subs; i++) {
+        int seen = 0;
+        for (size_t k = 0; k < i && !seen; k++) seen = g_subs[k].hash == g_subs[i].hash;
+        if (!seen) p2p_link_put(link, P2P_REC_SUBSCRIBE, g_subs[i].topic, NULL, 0, NULL, 0);
+    }
+}
+
+static void p2p_link_topic(struct p2p_link *link, uint64_t hash, int follow) {
+    if (!follow) {
+        for (size_t i = 0; i < link->n_topics; i++)
+            if (link->topics[i] == hash) {
+                link->topics[i] = link->topics[--link->n_topics];
+                return;
+            }
+        return;
+    }
+    if (p2p_link_follows(link, hash)) return;
+    if (link->n_topics == link->cap_topics) {
+        const size_t cap = link->cap_topics ? 2 * link->cap_topics : 8;
+        uint64_t *grown = realloc(link->topics, cap * sizeof(*grown));
+        if (!grown) return;
+        link->topics = grown;
+        link->cap_topics = cap;
+    }
+    link->topics[link->n_topics++] = hash;
+}
+
+/* Keeps a copy for holos_p2p_receive_message: one allocation. */
+static void p2p_inbox_put(const struct holos_p2p_message_view *v) {
+    const size_t plen = strlen(v->peer_id) + 1;
+    struct p2p_inbox *m;
+    if (g_n_inbox == P2P_INBOX) {
+        struct p2p_inbox *old = g_inbox;
+        g_inbox = old->next;
+        if (!g_inbox) g_inbox_last = NULL;
+        free(old);
+        g_n_inbox--;
+    }
+    m = malloc(sizeof(*m) + v->size + plen);
+    if (!m) return;
+    m->next = NULL;
+    m->type = v->type;
+    m->size = v->size;
+    m->timestamp = time(NULL);
+    if (v->size) memcpy(m->data, v->payload, v->size);
+    m->peer = (char *)m->data + v->size;
+    memcpy(m->peer, v->peer_id, plen);
+    if (g_inbox_last) g_inbox_last->next = m;
+    else g_inbox = m;
+    g_inbox_last = m;
+    g_n_inbox++;
+}
+
+static void p2p_message_parse(struct p2p_link *link, const unsigned char *r, size_t len) {
+    struct holos_p2p_message_view v;
+    struct holos_p2p_message msg;
+    v.type = (enum holos_p2p_message_type)r[0];
+    v.sender = (const holos_p2p_peer_id_t *)(r + 4);
+    v.receiver = (const holos_p2p_peer_id_t *)(r + 4 + HOLOS_P2P_PEER_ID_SIZE);
+    v.peer_id = link->id;
+    v.payload = r + P2P_MESSAGE_HEAD;
+    v.size = len - P2P_MESSAGE_HEAD;
+    if (g_msg_cb) g_msg_cb(&v, g_msg_cls);
+    else p2p_inbox_put(&v);
+    if (!g_event_cb) return;
+    memset(&msg, 0, sizeof msg);
+    msg.type = v.type;
+    msg.payload = (void *)v.payload;
+    msg.size = v.size;
+    msg.sender_id = link->id;
+    msg.timestamp = time(NULL);
+    p2p_emit("message", &msg);
+}
 
-static void int_handler(int signo) {
-    (void)signo;
-    keep_running = 0;
+/* Dispatches the records of a frame received on link. */
+static int p2p_frame_parse(struct p2p_link *link, const unsigned char *frame, size_t n) {
+    size_t at = 0;
+    p2p_peer_heard(link->id, n);
+    p2p_stats_frame(link->stats, 0, n);
+    while (n - at >= P2P_RECORD_HEAD) {
+        const unsigned char *r = frame + at;
+        const int kind = r[0];
+        const size_t tlen = r[1];
+        char topic[256];
+        uint32_t len;
+        memcpy(&len, r + 4, 4);
+        len = ntohl(len);
+        if (tlen > n - at - P2P_RECORD_HEAD || len > n - at - P2P_RECORD_HEAD - tlen) return -1;
+        memcpy(topic, r + P2P_RECORD_HEAD, tlen);
+        topic[tlen] = '\0';
+        r += P2P_RECORD_HEAD + tlen;
+        p2p_stats_record(link->stats, 0, kind, P2P_RECORD_HEAD + tlen + len);
+        if (kind == P2P_REC_PUBLISH) {
+            p2p_deliver(topic, link->id, r, len);
+        } else if (kind == P2P_REC_SUBSCRIBE || kind == P2P_REC_UNSUBSCRIBE) {
+            p2p_link_topic(link, p2p_hash(topic), kind == P2P_REC_SUBSCRIBE);
+        } else if (kind == P2P_REC_MESSAGE && len >= P2P_MESSAGE_HEAD) {
+            p2p_message_parse(link, r, len);
+        } else if (kind > P2P_REC_MESSAGE && kind < P2P_REC_KINDS && g_handlers[kind]) {
+            g_handlers[kind](link->id, r, len);
+        }                           /* Unknown kinds are skipped */
+        at += P2P_RECORD_HEAD + tlen + len;
+    }
+    return at == n ? 0 : -1;
+}
+
+/* ---------------- Publish / subscribe ---------------- */
+
+int holos_p2p_subscribe(const char *topic, holos_p2p_topic_callback cb, void *cls) {
+    struct p2p_sub *s;
+    uint64_t hash;
+    int fresh;
+    if (!topic || !*topic || strlen(topic) > 255 || !cb) return HOLOS_P2P_ERR_GENERIC;
+    hash = p2p_hash(topic);
+    fresh = !p2p_topic_followed(hash);
+    if (g_n_subs == g_cap_subs) {
+        const size_t cap = g_cap_subs ? 2 * g_cap_subs : 8;
+        struct p2p_sub *grown = realloc(g_subs, cap * sizeof(*grown));
+        if (!grown) return HOLOS_P2P_ERR_GENERIC;
+        g_subs = grown;
+        g_cap_subs = cap;
+    }
+    s = &g_subs[g_n_subs];
+    s->topic = strdup(topic);
+    if (!s->topic) return HOLOS_P2P_ERR_GENERIC;
+    s->hash = hash;
+    s->cb = cb;
+    s->cls = cls;
+    g_n_subs++;
+    /* Control records are small and go past the high-water mark */
+    for (size_t i = 0; fresh && i < g_n_links; i++) p2p_link_put(g_links[i], P2P_REC_SUBSCRIBE, topic, NULL, 0, NULL, 0);
+    return HOLOS_P2P_OK;
+}
+
+int holos_p2p_unsubscribe(const char *topic, holos_p2p_topic_callback cb, void *cls) {
+    uint64_t hash;
+    if (!topic) return HOLOS_P2P_ERR_GENERIC;
+    hash = p2p_hash(topic);
+    for (size_t i = 0; i < g_n_subs; i++) {
+        if (g_subs[i].hash != hash || g_subs[i].cb != cb || g_subs[i].cls != cls || strcmp(g_subs[i].topic, topic) != 0)
+            continue;
+        free(g_subs[i].topic);
+        memmove(&g_subs[i], &g_subs[i + 1], (g_n_subs - i - 1) * sizeof(*g_subs));
+        g_n_subs--;
+        for (size_t k = 0; !p2p_topic_followed(hash) && k < g_n_links; k++)
+            p2p_link_put(g_links[k], P2P_REC_UNSUBSCRIBE, topic, NULL, 0, NULL, 0);
+        return HOLOS_P2P_OK;
+    }
+    return HOLOS_P2P_ERR_GENERIC;
+}
+
+int holos_p2p_publish(const char *topic, const void *data, size_t size) {
+    uint64_t hash;
+    size_t bytes;
+    int refused = 0;
+    if (!topic || !*topic || strlen(topic) > 255 || (size && !data)) return HOLOS_P2P_ERR_GENERIC;
+    bytes = p2p_record_size(topic, size);
+    if (bytes > P2P_FRAME_MAX) return HOLOS_P2P_ERR_GENERIC;
+    hash = p2p_hash(topic);
+    /* All or nothing: every following link must take the record */
+    for (size_t i = 0; i < g_n_links; i++)
+        if (p2p_link_follows(g_links[i], hash) && !p2p_link_admits(g_links[i], bytes)) refused = 1;
+    if (refused) return HOLOS_P2P_ERR_AGAIN;
+    for (size_t i = 0; i < g_n_links; i++)
+        if (p2p_link_follows(g_links[i], hash)) p2p_link_put(g_links[i], P2P_REC_PUBLISH, topic, NULL, 0, data, size);
+    p2p_deliver(topic, NULL, data, size);
+    return HOLOS_P2P_OK;
+}
+
+int p2p_link_send_record(const char *peer_id, int kind, const void *head, size_t nhead, const void *data, size_t size) {
+    struct p2p_link *link;
+    if (kind <= 0 || kind >= P2P_REC_KINDS || nhead + size > P2P_RECORD_MAX || (nhead && !head) || (size && !data))
+        return HOLOS_P2P_ERR_GENERIC;
+    link = p2p_link_find(peer_id);
+    if (!link) return HOLOS_P2P_ERR_PEER_NOT_FOUND;
+    if (!p2p_link_admits(link, P2P_RECORD_HEAD + nhead + size)) return HOLOS_P2P_ERR_AGAIN;
+    p2p_link_put(link, kind, NULL, head, nhead, data, size);
+    return HOLOS_P2P_OK;
+}
+
+size_t p2p_link_peers(const char **ids, size_t max) {
+    for (size_t i = 0; ids && i < g_n_links && i < max; i++) ids[i] = g_links[i]->id;
+    return g_n_links;
+}
+
+size_t holos_p2p_pending(const char *peer_id) {
+    const struct p2p_link *link = p2p_link_find(peer_id);
+    return link ? p2p_link_queued(link) : 0;
 }
 
+#define P2P_IOV_MAX 16              /* Pieces of a message */
+
+/* Puts the message head then the caller's pieces (validated by
+   p2p_message_bytes) on link; to == NULL broadcasts. */
+static void p2p_message_put(struct p2p_link *link, const struct p2p_link *to, enum holos_p2p_message_type type,
+                            const struct holos_p2p_iovec *iov, size_t iovcnt) {
+    unsigned char head[P2P_MESSAGE_HEAD];
+    struct holos_p2p_iovec all[P2P_IOV_MAX + 1];
+    head[0] = (unsigned char)type;
+    head[1] = head[2] = head[3] = 0;
+    memcpy(head + 4, g_self.b, HOLOS_P2P_PEER_ID_SIZE);
+    if (to) memcpy(head + 4 + HOLOS_P2P_PEER_ID_SIZE, to->bin.b, HOLOS_P2P_PEER_ID_SIZE);
+    else memset(head + 4 + HOLOS_P2P_PEER_ID_SIZE, 0, HOLOS_P2P_PEER_ID_SIZE);
+    all[0].base = head;
+    all[0].len = sizeof(head);
+    if (iovcnt) memcpy(all + 1, iov, iovcnt * sizeof(*iov));
+    p2p_link_putv(link, P2P_REC_MESSAGE, NULL, all, iovcnt + 1);
+}
+
+/* Record bytes of a message, 0 if it is not valid. */
+static size_t p2p_message_bytes(enum holos_p2p_message_type type, const struct holos_p2p_iovec *iov, size_t iovcnt) {
+    size_t bytes;
+    if ((unsigned)type > 255 || iovcnt > P2P_IOV_MAX || (iovcnt && !iov)) return 0;
+    for (size_t i = 0; i < iovcnt; i++)
+        if (iov[i].len && !iov[i].base) return 0;
+    bytes = p2p_record_size(NULL, P2P_MESSAGE_HEAD + p2p_iov_size(iov, iovcnt));
+    return bytes <= P2P_FRAME_MAX ? bytes : 0;
+}
+
+int holos_p2p_send_messagev(const char *peer_address, enum holos_p2p_message_type type,
+                            const struct holos_p2p_iovec *iov, size_t iovcnt) {
+    const size_t bytes = p2p_message_bytes(type, iov, iovcnt);
+    struct p2p_link *link;
+    if (!bytes) return HOLOS_P2P_ERR_GENERIC;
+    link = p2p_link_find(peer_address);
+    if (!link) return HOLOS_P2P_ERR_PEER_NOT_FOUND;
+    if (!p2p_link_admits(link, bytes)) return HOLOS_P2P_ERR_AGAIN;
+    p2p_message_put(link, link, type, iov, iovcnt);
+    return HOLOS_P2P_OK;
+}
+
+int holos_p2p_broadcast_messagev(enum holos_p2p_message_type type, const struct holos_p2p_iovec *iov,
+                                 size_t iovcnt) {
+    const size_t bytes = p2p_message_bytes(type, iov, iovcnt);
+    int refused = 0;
+    if (!bytes) return HOLOS_P2P_ERR_GENERIC;
+    for (size_t i = 0; i < g_n_links; i++)
+        if (!p2p_link_admits(g_links[i], bytes)) refused = 1;
+    if (refused) return HOLOS_P2P_ERR_AGAIN;
+    for (size_t i = 0; i < g_n_links; i++) p2p_message_put(g_links[i], NULL, type, iov, iovcnt);
+    return HOLOS_P2P_OK;
+}
+
+int holos_p2p_send_message(const char *peer_address, const struct holos_p2p_message *msg) {
+    struct holos_p2p_iovec iov;
+    if (!msg) return HOLOS_P2P_ERR_GENERIC;
+    iov.base = msg->payload;
+    iov.len = msg->size;
+    return holos_p2p_send_messagev(peer_address, msg->type, &iov, 1);
+}
+
+int holos_p2p_broadcast_message(const struct holos_p2p_message *msg) {
+    struct holos_p2p_iovec iov;
+    if (!msg) return HOLOS_P2P_ERR_GENERIC;
+    iov.base = msg->payload;
+    iov.len = msg->size;
+    return holos_p2p_broadcast_messagev(msg->type, &iov, 1);
+}
+
+int holos_p2p_on_message(holos_p2p_message_callback cb, void *cls) {
+    g_msg_cb = cb;
+    g_msg_cls = cls;
+    return HOLOS_P2P_OK;
+}
+
+int holos_p2p_receive_message(char *peer_address, struct holos_p2p_message *msg) {
+    struct p2p_inbox *m = g_inbox;
+    if (!msg) return HOLOS_P2P_ERR_GENERIC;
+    if (!m) return HOLOS_P2P_ERR_AGAIN;
+    memset(msg, 0, sizeof(*msg));
+    msg->payload = malloc(m->size ? m->size : 1);
+    msg->sender_id = strdup(m->peer);
+    if (!msg->payload || !msg->sender_id) {
+        free(msg->payload);
+        free(msg->sender_id);
+        msg->payload = NULL;
+        msg->sender_id = NULL;
+        return HOLOS_P2P_ERR_GENERIC;
+    }
+    memcpy(msg->payload, m->data, m->size);
+    msg->type = m->type;
+    msg->size = m->size;
+    msg->timestamp = m->timestamp;
+    if (peer_address) strcpy(peer_address, m->peer);
+    g_inbox = m->next;
+    if (!g_inbox) g_inbox_last = NULL;
+    g_n_inbox--;
+    free(m);
+    return HOLOS_P2P_OK;
+}
+
+void holos_p2p_free_message(struct holos_p2p_message *msg) {
+    if (!msg) return;
+    free(msg->payload);
+    free(msg->sender_id);
+    free(msg->receiver_id);
+    msg->payload = NULL;
+    msg->sender_id = msg->receiver_id = NULL;
+    msg->size = 0;
+}
+
+void holos_p2p_self(holos_p2p_peer_id_t *id) {
+    if (id) *id = g_self;
+}
+
+static void p2p_links_free(void) {
+    while (g_n_links) p2p_link_free(g_links[g_n_links - 1]);
+    free(g_links);
+    g_links = NULL;
+    g_cap_links = 0;
+    for (size_t i = 0; i < g_n_watchers; i++)
+        if (g_finalize_fns[i]) g_finalize_fns[i]();
+    g_n_watchers = g_n_ticks = 0;
+    memset(g_handlers, 0, sizeof(g_handlers));
+    for (size_t i = 0; i < g_n_subs; i++) free(g_subs[i].topic);
+    free(g_subs);
+    g_subs = NULL;
+    g_n_subs = g_cap_subs = 0;
+    while (g_inbox) {
+        struct p2p_inbox *m = g_inbox;
+        g_inbox = m->next;
+        free(m);
+    }
+    g_inbox_last = NULL;
+    g_n_inbox = 0;
+    g_msg_cb = NULL;
+}
 
 /* ---------------- Generic fallback implementations ---------------- */
 
 #ifndef HAVE_GNUNET
 
 
-/* If GNUnet not available, provide no-op implementations so program still builds. */
+/* Without GNUnet a connected "peer" is a loopback link: its frames come
+   back to this process as if the peer had sent them, on the next
+   holos_p2p_poll, which also stands in for the coalescing task. */
 
-int p2p_init(void) {
-    fprintf(stderr, "[p2p] GNUnet not available: running in offline stub mode.\n");
+struct p2p_loop {
+    struct p2p_loop *next;
+    struct p2p_link *link;
+    size_t n;
+    unsigned char data[];
+};
+
+static struct p2p_loop *g_loop = NULL, *g_loop_last = NULL;
+
+static int p2p_transmit(struct p2p_link *link, const unsigned char *frame, size_t n) {
+    struct p2p_loop *f = malloc(sizeof(*f) + n);
+    if (!f) return -1;
+    f->next = NULL;
+    f->link = link;
+    f->n = n;
+    memcpy(f->data, frame, n);
+    if (g_loop_last) g_loop_last->next = f;
+    else g_loop = f;
+    g_loop_last = f;
+    return 0;
+}
+
+static void p2p_schedule_flush(struct p2p_link *link) {
+    (void)link;
+}
+
+static int p2p_link_alive(const struct p2p_link *link) {
+    for (size_t i = 0; i < g_n_links; i++)
+        if (g_links[i] == link) return 1;
     return 0;
 }
 
-void p2p_shutdown(void) {
-    /* nothing */
+/* Drops the frames of link still in the loop. */
+static void p2p_loop_forget(const struct p2p_link *link) {
+    struct p2p_loop **at = &g_loop;
+    g_loop_last = NULL;
+    while (*at) {
+        struct p2p_loop *f = *at;
+        if (f->link == link) {
+            *at = f->next;
+            free(f);
+        } else {
+            g_loop_last = f;
+            at = &f->next;
+        }
+    }
+}
+
+static uint64_t g_tick_at = 0;
+
+int holos_p2p_poll(void) {
+    size_t n = 0, delivered = 0;
+    struct timespec ts;
+    uint64_t now;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    now = (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+    if (now - g_tick_at >= P2P_TICK_MS) {
+        g_tick_at = now;
+        p2p_ticks();
+    }
+    for (size_t i = 0; i < g_n_links; i++) p2p_link_flush(g_links[i]);
+    for (const struct p2p_loop *f = g_loop; f; f = f->next) n++;
+    /* Frames sent from the callbacks wait for the next poll */
+    while (g_loop && delivered < n) {
+        struct p2p_loop *f = g_loop;
+        g_loop = f->next;
+        if (!g_loop) g_loop_last = NULL;
+        if (p2p_frame_parse(f->link, f->data, f->n) != 0) fprintf(stderr, "[p2p] malformed frame from %s\n", f->link->id);
+        if (p2p_link_alive(f->link)) p2p_frame_sent(f->link);
+        free(f);
+        delivered++;
+    }
+    return (int)delivered;
+}
+
+/* Offline a peer ID is any name of up to HOLOS_P2P_PEER_ID_SIZE bytes. */
+int holos_p2p_peer_id_parse(const char *peer_id, holos_p2p_peer_id_t *id) {
+    const size_t n = peer_id ? strlen(peer_id) : 0;
+    if (n == 0 || n > HOLOS_P2P_PEER_ID_SIZE || !id) return HOLOS_P2P_ERR_GENERIC;
+    memset(id->b, 0, sizeof(id->b));
+    memcpy(id->b, peer_id, n);
+    return HOLOS_P2P_OK;
+}
+
+int holos_p2p_peer_id_format(const holos_p2p_peer_id_t *id, char *out, size_t n) {
+    size_t len = 0;
+    if (!id || !out) return HOLOS_P2P_ERR_GENERIC;
+    while (len < HOLOS_P2P_PEER_ID_SIZE && id->b[len]) len++;
+    if (n <= len) return HOLOS_P2P_ERR_GENERIC;
+    memcpy(out, id->b, len);
+    out[len] = '\0';
+    return HOLOS_P2P_OK;
+}
+
+int holos_p2p_init(void) {
+    fprintf(stderr, "[p2p] GNUnet not available: running in offline loopback mode.\n");
+    holos_p2p_peer_id_parse("local", &g_self);
+    p2p_chunk_attach();
+    p2p_task_attach();
+    p2p_peers_attach();
+    p2p_event_attach();
+    return 0;
 }
 
-int p2p_list_peers(void) {
-    fprintf(stderr, "[p2p] GNUnet not present: peer listing unavailable.\n");
-    return -1;
+void holos_p2p_finalize(void) {
+    while (g_loop) {
+        struct p2p_loop *f = g_loop;
+        g_loop = f->next;
+        free(f);
+    }
+    g_loop_last = NULL;
+    p2p_links_free();
 }
 
-int p2p_publish_message(const char *topic, const char *msg) {
-    fprintf(stderr, "[p2p] GNUnet not present: publish '%s' suppressed.\n", topic);
-    return -1;
+int holos_p2p_connect(const char *peer_address) {
+    struct p2p_link *link;
+    if (!peer_address || !*peer_address) return HOLOS_P2P_ERR_GENERIC;
+    if (p2p_link_find(peer_address)) return HOLOS_P2P_OK;
+    link = p2p_link_new(peer_address);
+    if (!link) return HOLOS_P2P_ERR_GENERIC;
+    p2p_link_announce(link);
+    p2p_emit("connect", link->id);
+    return HOLOS_P2P_OK;
 }
 
-int p2p_subscribe_topic(const char *topic) {
-    fprintf(stderr, "[p2p] GNUnet not present: subscribe '%s' suppressed.\n", topic);
-    return -1;
+int holos_p2p_disconnect(const char *peer_address) {
+    struct p2p_link *link = p2p_link_find(peer_address);
+    if (!link) return HOLOS_P2P_ERR_PEER_NOT_FOUND;
+    p2p_emit("disconnect", link->id);
+    p2p_loop_forget(link);
+    p2p_link_free(link);
+    return HOLOS_P2P_OK;
 }
 
 #else /* HAVE_GNUNET */
@@ -87,6 +876,117 @@ int p2p_subscribe_topic(const char *topic) {
 /* Global GNUnet objects (simple program-level usage) */
 static struct GNUNET_CONFIGURATION_Handle *g_cfg = NULL;
 static struct GNUNET_SCHEDULER_Context *g_sched = NULL;
+static struct GNUNET_CADET_Handle *g_cadet = NULL;
+static struct GNUNET_CADET_Port *g_port = NULL;
+static struct GNUNET_HashCode g_port_hash;
+static struct GNUNET_PEERINFO_NotifyContext *g_peerinfo = NULL;
+static struct GNUNET_SCHEDULER_Task *g_tick_task = NULL;
+
+static void p2p_peerinfo_notify(void *cls, const struct GNUNET_PeerIdentity *peer,
+                                const struct GNUNET_HELLO_Message *hello, const char *err_msg);
+
+static void p2p_tick_task(void *cls) {
+    (void)cls;
+    p2p_ticks();
+    g_tick_task = GNUNET_SCHEDULER_add_delayed(
+        GNUNET_TIME_relative_multiply(GNUNET_TIME_UNIT_MILLISECONDS, P2P_TICK_MS), &p2p_tick_task, NULL);
+}
+
+static int check_frame(void *cls, const struct GNUNET_MessageHeader *msg) {
+    (void)cls;
+    (void)msg;
+    return GNUNET_OK;               /* Records are checked as they are parsed */
+}
+
+static void handle_frame(void *cls, const struct GNUNET_MessageHeader *msg) {
+    struct p2p_link *link = cls;
+    if (p2p_frame_parse(link, (const unsigned char *)&msg[1], ntohs(msg->size) - sizeof(*msg)) != 0)
+        fprintf(stderr, "[p2p] malformed frame from %s\n", link->id);
+    if (link->channel) GNUNET_CADET_receive_done(link->channel);
+}
+
+static void p2p_sent(void *cls) {
+    p2p_frame_sent(cls);
+}
+
+static int p2p_transmit(struct p2p_link *link, const unsigned char *frame, size_t n) {
+    struct GNUNET_MessageHeader *hdr;
+    struct GNUNET_MQ_Envelope *env;
+    if (!link->channel) return -1;
+    env = GNUNET_MQ_msg_header_extra(hdr, n, P2P_MESSAGE_TYPE);
+    memcpy(&hdr[1], frame, n);
+    GNUNET_MQ_notify_sent(env, &p2p_sent, link);
+    GNUNET_MQ_send(GNUNET_CADET_get_mq(link->channel), env);
+    return 0;
+}
+
+int holos_p2p_poll(void) {
+    return 0;                       /* The scheduler runs the link tasks */
+}
+
+static void p2p_flush_task(void *cls) {
+    struct p2p_link *link = cls;
+    link->flush_task = NULL;
+    p2p_link_flush(link);
+}
+
+static void p2p_schedule_flush(struct p2p_link *link) {
+    if (link->flush_task) return;
+    link->flush_task = GNUNET_SCHEDULER_add_delayed(
+        GNUNET_TIME_relative_multiply(GNUNET_TIME_UNIT_MILLISECONDS, P2P_COALESCE_MS), &p2p_flush_task, link);
+}
+
+static void p2p_gone(void *cls, const struct GNUNET_CADET_Channel *channel) {
+    struct p2p_link *link = cls;
+    (void)channel;
+    if (!link) return;
+    link->channel = NULL;
+    p2p_emit("disconnect", link->id);
+    p2p_link_free(link);
+}
+
+static void *p2p_incoming(void *cls, struct GNUNET_CADET_Channel *channel, const struct GNUNET_PeerIdentity *source) {
+    struct p2p_link *link;
+    (void)cls;
+    link = p2p_link_new(GNUNET_i2s_full(source));
+    if (!link) {
+        GNUNET_CADET_channel_destroy(channel);
+        return NULL;
+    }
+    link->channel = channel;
+    p2p_link_announce(link);
+    p2p_emit("connect", link->id);
+    return link;
+}
+
+int holos_p2p_peer_id_parse(const char *peer_id, holos_p2p_peer_id_t *id) {
+    struct GNUNET_CRYPTO_EddsaPublicKey pub;
+    if (!peer_id || !id || GNUNET_CRYPTO_eddsa_public_key_from_string(peer_id, strlen(peer_id), &pub) != GNUNET_OK)
+        return HOLOS_P2P_ERR_GENERIC;
+    memcpy(id->b, &pub, HOLOS_P2P_PEER_ID_SIZE);
+    return HOLOS_P2P_OK;
+}
+
+int holos_p2p_peer_id_format(const holos_p2p_peer_id_t *id, char *out, size_t n) {
+    struct GNUNET_CRYPTO_EddsaPublicKey pub;
+    char *s;
+    int rc = HOLOS_P2P_ERR_GENERIC;
+    if (!id || !out) return rc;
+    memcpy(&pub, id->b, HOLOS_P2P_PEER_ID_SIZE);
+    s = GNUNET_CRYPTO_eddsa_public_key_to_string(&pub);
+    if (s && strlen(s) < n) {
+        strcpy(out, s);
+        rc = HOLOS_P2P_OK;
+    }
+    GNUNET_free(s);
+    return rc;
+}
+
+#define P2P_HANDLERS(name)                                                                      \
+    struct GNUNET_MQ_MessageHandler name[] = {                                                  \
+        GNUNET_MQ_hd_var_size(frame, P2P_MESSAGE_TYPE, struct GNUNET_MessageHeader, NULL),      \
+        GNUNET_MQ_handler_end()                                                                 \
+    }
 
 /* Helper: simple logging init */
 static void p2p_setup_logging(void) {
@@ -95,10 +995,12 @@ static void p2p_setup_logging(void) {
 }
 
 /*
-    Initialize GNUnet configuration and scheduler.
+    Initialize GNUnet configuration, scheduler and the CADET port.
     Returns 0 on success, -1 on error.
 */
-int p2p_init(void) {
+int holos_p2p_init(void) {
+    P2P_HANDLERS(handlers);
+
     p2p_setup_logging();
 
     /* Create and load configuration (uses default configuration directory) */
@@ -115,6 +1017,12 @@ int p2p_init(void) {
         return -1;
     }
 
+    {
+        struct GNUNET_PeerIdentity self;
+        if (GNUNET_CRYPTO_get_peer_identity(g_cfg, &self) == GNUNET_OK)
+            memcpy(g_self.b, &self.public_key, HOLOS_P2P_PEER_ID_SIZE);
+    }
+
     /* Create a scheduler context for asynchronous callbacks (many GNUnet APIs require this) */
     g_sched = GNUNET_SCHEDULER_create();
     if (g_sched == NULL) {
@@ -124,11 +1032,28 @@ int p2p_init(void) {
         return -1;
     }
 
-    /* Optional: start GNUnet core or ensure the GNUnet daemon is running.
-     * Usually GNUnet runs as system service (gnunet-arm). This code assumes the GNUnet
-     * infrastructure/daemons are already running and accessible via IPC.
-     */
+    /* Peers reach each other on one CADET port; the GNUnet daemons
+     * (gnunet-arm) are assumed to be running. */
+    g_cadet = GNUNET_CADET_connect(g_cfg);
+    if (g_cadet == NULL) {
+        fprintf(stderr, "[p2p] Failed to connect to the CADET service.\n");
+        holos_p2p_finalize();
+        return -1;
+    }
+    GNUNET_CRYPTO_hash(P2P_PORT, strlen(P2P_PORT), &g_port_hash);
+    g_port = GNUNET_CADET_open_port(g_cadet, &g_port_hash, &p2p_incoming, NULL, NULL, &p2p_gone, handlers);
+    if (g_port == NULL) {
+        fprintf(stderr, "[p2p] Failed to open the CADET port.\n");
+        holos_p2p_finalize();
+        return -1;
+    }
 
+    p2p_chunk_attach();
+    p2p_task_attach();
+    p2p_peers_attach();
+    p2p_event_attach();
+    g_peerinfo = GNUNET_PEERINFO_notify(g_cfg, GNUNET_NO, &p2p_peerinfo_notify, NULL);
+    g_tick_task = GNUNET_SCHEDULER_add_now(&p2p_tick_task, NULL);
     fprintf(stderr, "[p2p] GNUnet initialized successfully.\n");
     return 0;
 }
@@ -136,7 +1061,29 @@ int p2p_init(void) {
 /*
     Shutdown and cleanup GNUnet resources.
 */
-void p2p_shutdown(void) {
+void holos_p2p_finalize(void) {
+    if (g_tick_task) {
+        GNUNET_SCHEDULER_cancel(g_tick_task);
+        g_tick_task = NULL;
+    }
+    if (g_peerinfo) {
+        GNUNET_PEERINFO_notify_cancel(g_peerinfo);
+        g_peerinfo = NULL;
+    }
+    for (size_t i = 0; i < g_n_links; i++) {
+        struct GNUNET_CADET_Channel *ch = g_links[i]->channel;
+        g_links[i]->channel = NULL;
+        if (ch) GNUNET_CADET_channel_destroy(ch);
+    }
+    p2p_links_free();
+    if (g_port) {
+        GNUNET_CADET_close_port(g_port);
+        g_port = NULL;
+    }
+    if (g_cadet) {
+        GNUNET_CADET_disconnect(g_cadet);
+        g_cadet = NULL;
+    }
     if (g_sched) {
         GNUNET_SCHEDULER_destroy(g_sched);
         g_sched = NULL;
@@ -149,162 +1096,53 @@ void p2p_shutdown(void) {
 }
 
 /*
-    Example: simple peerinfo callback. This function signature is a sketch: adapt
-    the types to the exact GNUNET_PEERINFO_iterator callback your version expects.
+    Open a channel to a peer, given its identity (the public key string).
 */
-static void peerinfo_callback(void *cls,
-        const struct GNUNET_PeerIdentity *peer,
-        const struct GNUNET_HELLO_Address *address,
-        struct GNUNET_TIME_Absolute expiration,
-        const char *err_msg)
-{
-    (void)cls;
-    (void)expiration;
-    (void)err_msg;
-
-    if (peer != NULL) {
-        char *s = GNUNET_i2s(peer);
-        fprintf(stderr, "[p2p] Peer: %s\n", s);
-        GNUNET_free(s);
-    } else {
-        fprintf(stderr, "[p2p] peerinfo: end or null\n");
-    }
-
-    /* Optionally print addresses if present */
-    if (address) {
-        /* The structure and fields depend on GNUnet version. Inspect header for details. */
-        fprintf(stderr, "[p2p] address (peer): <address info available>\n");
+int holos_p2p_connect(const char *peer_address) {
+    P2P_HANDLERS(handlers);
+    struct GNUNET_PeerIdentity pid;
+    struct p2p_link *link;
+    if (!g_cadet || !peer_address) return HOLOS_P2P_ERR_NETWORK;
+    if (p2p_link_find(peer_address)) return HOLOS_P2P_OK;
+    if (GNUNET_CRYPTO_eddsa_public_key_from_string(peer_address, strlen(peer_address), &pid.public_key) != GNUNET_OK)
+        return HOLOS_P2P_ERR_PEER_NOT_FOUND;
+    link = p2p_link_new(peer_address);
+    if (!link) return HOLOS_P2P_ERR_GENERIC;
+    link->channel = GNUNET_CADET_channel_create(g_cadet, link, &pid, &g_port_hash, NULL, &p2p_gone, handlers);
+    if (!link->channel) {
+        p2p_link_free(link);
+        return HOLOS_P2P_ERR_NETWORK;
     }
+    p2p_link_announce(link);
+    p2p_emit("connect", link->id);
+    return HOLOS_P2P_OK;
 }
 
-/*
-    List peers (example using peerinfo service).
-    Returns 0 on success, -1 on error.
-*/
-int p2p_list_peers(void) {
-    if (!g_cfg) {
-        fprintf(stderr, "[p2p] not initialized\n");
-        return -1;
-    }
-
-    /* Example: iterate peers. The exact GNUnet API names and params might differ:
-     *
-     * GNUNET_PEERINFO_iterate(g_cfg, ... , peerinfo_callback, NULL);
-     *
-     * Some versions return a context/iterator handle; others use synchronous api.
-     *
-     * Here we attempt a call and print a note if the exact symbol is unavailable.
-     */
-#if defined(GNUNET_PEERINFO_ITERATE_AVAILABLE)
-    GNUNET_PEERINFO_iterate(g_cfg, NULL, GNUNET_YES, &peerinfo_callback, NULL);
-#else
-    /* Fallback: try to call the peerinfo service via simple helper (if available) */
-    fprintf(stderr, "[p2p] peer iteration API symbol not detected at compile-time; implement using your GNUnet release API.\n");
-#endif
-
-    return 0;
+int holos_p2p_disconnect(const char *peer_address) {
+    struct p2p_link *link = p2p_link_find(peer_address);
+    struct GNUNET_CADET_Channel *ch;
+    if (!link) return HOLOS_P2P_ERR_PEER_NOT_FOUND;
+    ch = link->channel;
+    link->channel = NULL;
+    p2p_emit("disconnect", link->id);
+    p2p_link_free(link);
+    if (ch) GNUNET_CADET_channel_destroy(ch);
+    return HOLOS_P2P_OK;
 }
 
-
 /*
-    Simplified publish/subscribe placeholders:
-    A full implementation would use GNUNET core messaging services (e.g. GNUNET_MESSAGE_* or a service plugin).
-    Here we show a stub that demonstrates intent and where to call GNUnet APIs.
+    Peerinfo tells of every peer it learns a HELLO of; the peer table
+    keeps them (they expire like the others when no link comes).
 */
-
-int p2p_publish_message(const char *topic, const char *msg) {
-    if (!g_cfg) return -1;
-
-    fprintf(stderr, "[p2p] publish requested: topic='%s' msg='%s'\n", topic, msg);
-
-    /* TODO: implement using GNUNET core API for messaging or a custom GNUnet service.
-     * e.g. GNUNET_MESSAGE_publish(...), or interact with a specific GNUNET plugin.
-     */
-
-    return 0;
-}
-
-int p2p_subscribe_topic(const char *topic) {
-    if (!g_cfg) return -1;
-
-    fprintf(stderr, "[p2p] subscribe requested: topic='%s'\n", topic);
-
-    /* TODO: create subscription using GNUNET APIs, register callbacks to receive messages */
-
-    return 0;
+static void p2p_peerinfo_notify(void *cls, const struct GNUNET_PeerIdentity *peer,
+                                const struct GNUNET_HELLO_Message *hello, const char *err_msg) {
+    (void)cls;
+    (void)hello;
+    if (err_msg) {
+        fprintf(stderr, "[p2p] peerinfo: %s\n", err_msg);
+        return;
+    }
+    if (peer) p2p_peer_known(GNUNET_i2s_full(peer), NULL);
 }
 
 #endif /* HAVE_GNUNET */
-
-/* ---------------- small CLI for testing ---------------- */
-
-/*
-   Print usage information for the p2p CLI.
-*/
-static void usage(const char *prog) {
-    fprintf(stderr,
-            "Usage: %s [command]\n"
-            "Commands:\n"
-            "  init          Initialize P2P subsystem\n"
-            "  peers         List peers (best-effort)\n"
-            "  publish TOPIC MSG   Publish a message (placeholder)\n"
-            "  subscribe TOPIC     Subscribe to a topic (placeholder)\n"
-            "  quit\n", prog);
-}
-
-
-int main(int argc, char *argv[]) {
-    (void)argc;
-    (void)argv;
-
-    signal(SIGINT, int_handler);
-    signal(SIGTERM, int_handler);
-
-    printf("Holos P2P helper (GNUnet-aware)\n");
-
-    if (p2p_init() != 0) {
-        fprintf(stderr, "[p2p] initialization failed (running in degraded mode)\n");
-    }
-
-    /* Simple REPL for demonstration */
-    char line[1024];
-    while (keep_running) {
-        printf("p2p> ");
-        if (!fgets(line, sizeof(line), stdin)) break;
-
-        /* Strip newline */
-        line[strcspn(line, "\r\n")] = '\0';
-        if (line[0] == '\0') continue;
-
-        char *cmd = strtok(line, " ");
-        if (!cmd) continue;
-
-        if (strcmp(cmd, "quit") == 0 || strcmp(cmd, "exit") == 0) {
-            break;
-        } else if (strcmp(cmd, "peers") == 0) {
-            p2p_list_peers();
-        } else if (strcmp(cmd, "publish") == 0) {
-            char *topic = strtok(NULL, " ");
-            char *msg = strtok(NULL, "");
-            if (!topic || !msg) {
-                fprintf(stderr, "Usage: publish TOPIC MSG\n");
-            } else {
-                p2p_publish_message(topic, msg);
-            }
-        } else if (strcmp(cmd, "subscribe") == 0) {
-            char *topic = strtok(NULL, " ");
-            if (!topic) {
-                fprintf(stderr, "Usage: subscribe TOPIC\n");
-            } else {
-                p2p_subscribe_topic(topic);
-            }
-        } else {
-            fprintf(stderr, "Unknown command: %s\n", cmd);
-            usage(argv[0]);
-        }
-    }
-
-    p2p_shutdown();
-    printf("p2p: exiting\n");
-    return 0;
-}
\ No newline at end of file
@@ -0,0 +1,2011 @@
+/* p2p_chunk.c - Content-addressed bulk transfer for HOLOS
+    Copyright (C) 2025  4137314 <holos@mail.com>
+
+    This file is part of HOLOS.
+
+    HOLOS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    HOLOS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+    ----------------------------------------------------------------------
+    Objects (see p2p_chunk.h) over the links of p2p.c. A shared file is
+    mapped read-only and a piece goes from the map into the frame of the
+    link, the one copy before CADET takes it; received pieces are
+    written once, to the store and the destination, when their chunk is
+    whole and verified.
+
+    Manifest (network order):
+      "HPM1", u32 files, u32 chunks,
+      per file: u16 path length, path (relative, '/'), u64 size,
+      the chunk hashes, file by file (a chunk never spans two files)
+    Records:
+      GET      hash, u64 offset, u64 length: bytes of a chunk or manifest
+      PIECE    hash, u64 offset, u64 total, bytes
+      MISSING  hash: the peer has no such chunk
+      WANT     u8 length, project ID
+      HAVE     object hash, u8 length, project ID (empty: data sent
+               with holos_p2p_send_data)
+      DELTA    hash, u32 codings taken, u32 blocks, the hash of the
+               chunk the asker has in its place (zero: none), per block
+               of it: u32 rolling hash, the first 8 bytes of its SHA-256
+      DPIECE   as PIECE, bytes of the delta
+    A GET is answered by P2P_PIECE byte pieces, queued per peer and
+    resumed from the "drain" of a link that refused one. The chunk store
+    keeps dir/<first two hex digits>/<hash>, manifests included, so it
+    answers GETs as a share does.
+
+    A chunk asked from its first byte is asked as a DELTA, against the
+    chunk at the same place of the same file in the fetch's base (the
+    version fetched before). The server rolls rsync's checksum over the
+    chunk to find the blocks the asker has, anywhere; if it has the old
+    chunk itself (a share keeps each chunk it serves to a DELTA in the
+    store, for the next version), it also XORs the new one against it,
+    word by word, which leaves little of values that barely moved. It
+    answers with the smaller delta if that is smaller than the chunk,
+    with the chunk (PIECE) if not:
+      'C' u32 first block, u32 count: blocks of the old chunk
+      'R' u32 n, n bytes
+      'X' u32 n, u32 m, n bytes in m, XOR-delta coded (p2p_xor_encode)
+      'B' u32 n, u32 m, as 'X', each word XORed with the old chunk's
+          at the same place instead of with the word before
+    A delta is not resumed: a peer gone mid-way, or a delta that does
+    not rebuild the chunk, and it is asked again as bytes.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "core/p2p/p2p.h"
+#include "core/p2p/p2p_stats.h"
+#include "core/p2p/p2p_chunk.h"
+#include "p2p_link.h"
+
+#define P2P_PIECE 16384                 /* Bytes of a PIECE record */
+#define P2P_MANIFEST_MAX (64u << 20)
+#define P2P_PATH 4096
+#define P2P_BLOBS 16                    /* holos_p2p_send_data objects kept shared */
+
+#define P2P_GET_HEAD 48                 /* hash, u64, u64 */
+#define P2P_DELTA_HEAD 72               /* hash, u32, u32, hash */
+#define P2P_DELTA_BLOCK 1024
+#define P2P_DELTA_SIGNED (HOLOS_P2P_CHUNK_SIZE / P2P_DELTA_BLOCK)
+
+/* ---------------- SHA-256 ---------------- */
+
+typedef struct {
+    uint32_t h[8];
+    uint64_t n;                         /* Bytes hashed */
+    unsigned char buf[64];
+    size_t used;
+} p2p_sha256_t;
+
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+#define SHA_ROR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha256_block(p2p_sha256_t *s, const unsigned char *p) {
+    uint32_t w[64], a, b, c, d, e, f, g, h;
+    for (int i = 0; i < 16; i++)
+        w[i] = (uint32_t)p[4 * i] << 24 | (uint32_t)p[4 * i + 1] << 16 | (uint32_t)p[4 * i + 2] << 8 | p[4 * i + 3];
+    for (int i = 16; i < 64; i++) {
+        const uint32_t s0 = SHA_ROR(w[i - 15], 7) ^ SHA_ROR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        const uint32_t s1 = SHA_ROR(w[i - 2], 17) ^ SHA_ROR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    a = s->h[0]; b = s->h[1]; c = s->h[2]; d = s->h[3];
+    e = s->h[4]; f = s->h[5]; g = s->h[6]; h = s->h[7];
+    for (int i = 0; i < 64; i++) {
+        const uint32_t t1 = h + (SHA_ROR(e, 6) ^ SHA_ROR(e, 11) ^ SHA_ROR(e, 25)) + ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+        const uint32_t t2 = (SHA_ROR(a, 2) ^ SHA_ROR(a, 13) ^ SHA_ROR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+    s->h[0] += a; s->h[1] += b; s->h[2] += c; s->h[3] += d;
+    s->h[4] += e; s->h[5] += f; s->h[6] += g; s->h[7] += h;
+}
+
+static void sha256_init(p2p_sha256_t *s) {
+    static const uint32_t iv[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                                   0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    memcpy(s->h, iv, sizeof(iv));
+    s->n = 0;
+    s->used = 0;
+}
+
+static void sha256_update(p2p_sha256_t *s, const void *data, size_t n) {
+    const unsigned char *p = data;
+    s->n += n;
+    if (s->used) {
+        const size_t take = n < 64 - s->used ? n : 64 - s->used;
+        memcpy(s->buf + s->used, p, take);
+        s->used += take;
+        p += take;
+        n -= take;
+        if (s->used < 64) return;
+        sha256_block(s, s->buf);
+        s->used = 0;
+    }
+    for (; n >= 64; p += 64, n -= 64) sha256_block(s, p);
+    memcpy(s->buf, p, n);
+    s->used = n;
+}
+
+static void sha256_final(p2p_sha256_t *s, holos_p2p_hash_t *out) {
+    const uint64_t bits = s->n * 8;
+    s->buf[s->used++] = 0x80;
+    if (s->used > 56) {
+        memset(s->buf + s->used, 0, 64 - s->used);
+        sha256_block(s, s->buf);
+        s->used = 0;
+    }
+    memset(s->buf + s->used, 0, 56 - s->used);
+    for (int i = 0; i < 8; i++) s->buf[56 + i] = (unsigned char)(bits >> (56 - 8 * i));
+    sha256_block(s, s->buf);
+    for (int i = 0; i < 8; i++) {
+        out->b[4 * i] = (unsigned char)(s->h[i] >> 24);
+        out->b[4 * i + 1] = (unsigned char)(s->h[i] >> 16);
+        out->b[4 * i + 2] = (unsigned char)(s->h[i] >> 8);
+        out->b[4 * i + 3] = (unsigned char)s->h[i];
+    }
+}
+
+static void p2p_sha256(const void *data, size_t n, holos_p2p_hash_t *out) {
+    p2p_sha256_t s;
+    sha256_init(&s);
+    sha256_update(&s, data, n);
+    sha256_final(&s, out);
+}
+
+void holos_p2p_hash_hex(const holos_p2p_hash_t *hash, char out[65]) {
+    static const char digits[] = "0123456789abcdef";
+    for (int i = 0; i < 32; i++) {
+        out[2 * i] = digits[hash->b[i] >> 4];
+        out[2 * i + 1] = digits[hash->b[i] & 15];
+    }
+    out[64] = '\0';
+}
+
+static int p2p_hex_digit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+int holos_p2p_hash_parse(const char *hex, holos_p2p_hash_t *hash) {
+    if (!hex || !hash || strlen(hex) != 64) return -1;
+    for (int i = 0; i < 32; i++) {
+        const int hi = p2p_hex_digit(hex[2 * i]), lo = p2p_hex_digit(hex[2 * i + 1]);
+        if (hi < 0 || lo < 0) return -1;
+        hash->b[i] = (unsigned char)(hi << 4 | lo);
+    }
+    return 0;
+}
+
+/* ---------------- Objects ---------------- */
+
+struct p2p_file {
+    char *path;                         /* Relative to the object root */
+    uint64_t size;
+    size_t first;                       /* Index of the first chunk */
+    const unsigned char *map;           /* Shares only; NULL when empty */
+};
+
+struct p2p_object {
+    holos_p2p_hash_t id;
+    unsigned char *manifest;
+    size_t manifest_size;
+    struct p2p_file *files;
+    size_t n_files;
+    holos_p2p_hash_t *chunks;
+    size_t *owner;                      /* File of each chunk */
+    size_t *order;                      /* Chunks sorted by hash */
+    size_t n_chunks;
+};
+
+static void p2p_put32(unsigned char *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = (unsigned char)(v >> (24 - 8 * i));
+}
+
+static void p2p_put64(unsigned char *p, uint64_t v) {
+    for (int i = 0; i < 8; i++) p[i] = (unsigned char)(v >> (56 - 8 * i));
+}
+
+static uint32_t p2p_get32(const unsigned char *p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static uint64_t p2p_get64(const unsigned char *p) {
+    return (uint64_t)p2p_get32(p) << 32 | p2p_get32(p + 4);
+}
+
+static size_t p2p_chunks_of(uint64_t size) {
+    return (size_t)((size + HOLOS_P2P_CHUNK_SIZE - 1) / HOLOS_P2P_CHUNK_SIZE);
+}
+
+/* File offset and size of chunk i. */
+static void p2p_chunk_span(const struct p2p_object *o, size_t i, uint64_t *offset, size_t *size) {
+    const struct p2p_file *f = &o->files[o->owner[i]];
+    const uint64_t at = (uint64_t)(i - f->first) * HOLOS_P2P_CHUNK_SIZE;
+    *offset = at;
+    *size = (size_t)(f->size - at < HOLOS_P2P_CHUNK_SIZE ? f->size - at : HOLOS_P2P_CHUNK_SIZE);
+}
+
+static const holos_p2p_hash_t *g_sort_chunks;
+
+static int p2p_order_cmp(const void *a, const void *b) {
+    const int c = memcmp(&g_sort_chunks[*(const size_t *)a], &g_sort_chunks[*(const size_t *)b], 32);
+    return c ? c : (*(const size_t *)a > *(const size_t *)b) - (*(const size_t *)a < *(const size_t *)b);
+}
+
+/* First position in o->order of a chunk named hash, or n_chunks. */
+static size_t p2p_object_find(const struct p2p_object *o, const holos_p2p_hash_t *hash) {
+    size_t lo = 0, hi = o->n_chunks;
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+        if (memcmp(&o->chunks[o->order[mid]], hash, 32) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo < o->n_chunks && memcmp(&o->chunks[o->order[lo]], hash, 32) == 0 ? lo : o->n_chunks;
+}
+
+/* Chunk owners and the hash order, once files and chunks are set. */
+static int p2p_object_index(struct p2p_object *o) {
+    o->owner = malloc((o->n_chunks ? o->n_chunks : 1) * sizeof(*o->owner));
+    o->order = malloc((o->n_chunks ? o->n_chunks : 1) * sizeof(*o->order));
+    if (!o->owner || !o->order) return -1;
+    for (size_t f = 0; f < o->n_files; f++)
+        for (size_t i = 0; i < p2p_chunks_of(o->files[f].size); i++) o->owner[o->files[f].first + i] = f;
+    for (size_t i = 0; i < o->n_chunks; i++) o->order[i] = i;
+    g_sort_chunks = o->chunks;
+    qsort(o->order, o->n_chunks, sizeof(*o->order), p2p_order_cmp);
+    return 0;
+}
+
+static void p2p_object_free(struct p2p_object *o) {
+    for (size_t f = 0; f < o->n_files; f++) {
+        if (o->files[f].map) munmap((void *)o->files[f].map, (size_t)o->files[f].size);
+        free(o->files[f].path);
+    }
+    free(o->files);
+    free(o->chunks);
+    free(o->owner);
+    free(o->order);
+    free(o->manifest);
+    memset(o, 0, sizeof(*o));
+}
+
+/* A relative path with no empty, "." or ".." component. */
+static int p2p_path_ok(const char *p, size_t n) {
+    size_t start = 0;
+    if (n == 0 || p[0] == '/') return 0;
+    for (size_t i = 0; i <= n; i++) {
+        if (i < n && p[i] == '\0') return 0;
+        if (i == n || p[i] == '/') {
+            const size_t len = i - start;
+            if (len == 0 || (len == 1 && p[start] == '.') || (len == 2 && p[start] == '.' && p[start + 1] == '.'))
+                return 0;
+            start = i + 1;
+        }
+    }
+    return 1;
+}
+
+/* Builds the manifest and the id of o from its files and chunks. */
+static int p2p_manifest_build(struct p2p_object *o) {
+    size_t n = 12 + o->n_chunks * 32, at = 12;
+    for (size_t f = 0; f < o->n_files; f++) n += 10 + strlen(o->files[f].path);
+    if (n > P2P_MANIFEST_MAX || o->n_files > UINT32_MAX || o->n_chunks > UINT32_MAX) return -1;
+    o->manifest = malloc(n);
+    if (!o->manifest) return -1;
+    memcpy(o->manifest, "HPM1", 4);
+    p2p_put32(o->manifest + 4, (uint32_t)o->n_files);
+    p2p_put32(o->manifest + 8, (uint32_t)o->n_chunks);
+    for (size_t f = 0; f < o->n_files; f++) {
+        const size_t len = strlen(o->files[f].path);
+        o->manifest[at] = (unsigned char)(len >> 8);
+        o->manifest[at + 1] = (unsigned char)len;
+        memcpy(o->manifest + at + 2, o->files[f].path, len);
+        p2p_put64(o->manifest + at + 2 + len, o->files[f].size);
+        at += 10 + len;
+    }
+    memcpy(o->manifest + at, o->chunks, o->n_chunks * 32);
+    o->manifest_size = n;
+    p2p_sha256(o->manifest, n, &o->id);
+    return p2p_object_index(o);
+}
+
+/* Parses a manifest (taking m, which is freed on failure). */
+static int p2p_manifest_parse(unsigned char *m, size_t n, struct p2p_object *o) {
+    size_t at = 12, chunks = 0;
+    memset(o, 0, sizeof(*o));
+    o->manifest = m;
+    o->manifest_size = n;
+    if (n < 12 || memcmp(m, "HPM1", 4) != 0) goto fail;
+    o->n_files = p2p_get32(m + 4);
+    o->n_chunks = p2p_get32(m + 8);
+    if (o->n_files > n / 10 || o->n_chunks > n / 32) goto fail;
+    o->files = calloc(o->n_files ? o->n_files : 1, sizeof(*o->files));
+    if (!o->files) goto fail;
+    for (size_t f = 0; f < o->n_files; f++) {
+        size_t len;
+        if (n - at < 10) goto fail;
+        len = (size_t)m[at] << 8 | m[at + 1];
+        if (n - at - 10 < len || !p2p_path_ok((const char *)m + at + 2, len)) goto fail;
+        o->files[f].path = malloc(len + 1);
+        if (!o->files[f].path) goto fail;
+        memcpy(o->files[f].path, m + at + 2, len);
+        o->files[f].path[len] = '\0';
+        o->files[f].size = p2p_get64(m + at + 2 + len);
+        o->files[f].first = chunks;
+        if (o->files[f].size > (uint64_t)o->n_chunks * HOLOS_P2P_CHUNK_SIZE) goto fail;
+        chunks += p2p_chunks_of(o->files[f].size);
+        at += 10 + len;
+    }
+    if (chunks != o->n_chunks || n - at != o->n_chunks * 32) goto fail;
+    o->chunks = malloc((o->n_chunks ? o->n_chunks : 1) * 32);
+    if (!o->chunks) goto fail;
+    memcpy(o->chunks, m + at, o->n_chunks * 32);
+    p2p_sha256(m, n, &o->id);
+    if (p2p_object_index(o) != 0) goto fail;
+    return 0;
+fail:
+    p2p_object_free(o);
+    return -1;
+}
+
+/* ---------------- Chunk store ---------------- */
+
+static char g_store[P2P_PATH] = ".holos/chunks";
+static char g_projects[P2P_PATH] = ".holos/projects";
+
+/* mkdir -p of the directories of path (all of it if whole). */
+static int p2p_mkdirs(const char *path, int whole) {
+    char buf[P2P_PATH];
+    size_t n = strlen(path);
+    if (n >= sizeof(buf)) return -1;
+    memcpy(buf, path, n + 1);
+    for (size_t i = 1; i <= n; i++) {
+        if (buf[i] != '/' && !(whole && i == n)) continue;
+        buf[i] = '\0';
+        if (mkdir(buf, 0755) != 0 && errno != EEXIST) return -1;
+        if (i < n) buf[i] = '/';
+    }
+    return 0;
+}
+
+static int p2p_set_dir(char *dst, const char *dir) {
+    size_t n = dir ? strlen(dir) : 0;
+    if (n == 0 || n >= P2P_PATH - 80) return HOLOS_P2P_ERR_GENERIC;
+    memcpy(dst, dir, n + 1);
+    while (n > 1 && dst[n - 1] == '/') dst[--n] = '\0';
+    return p2p_mkdirs(dst, 1) == 0 ? HOLOS_P2P_OK : HOLOS_P2P_ERR_GENERIC;
+}
+
+int holos_p2p_chunk_store(const char *dir) {
+    return p2p_set_dir(g_store, dir);
+}
+
+int holos_p2p_project_dir(const char *dir) {
+    return p2p_set_dir(g_projects, dir);
+}
+
+/* Path of the stored copy of hash: 0, or -1 if it does not fit in n. */
+static int p2p_store_path(const holos_p2p_hash_t *hash, char *out, size_t n) {
+    char hex[65];
+    int rc;
+    holos_p2p_hash_hex(hash, hex);
+    rc = snprintf(out, n, "%s/%.2s/%s", g_store, hex, hex);
+    return rc < 0 || (size_t)rc >= n ? -1 : 0;
+}
+
+static int p2p_write_all(int fd, const unsigned char *data, size_t n, uint64_t offset) {
+    while (n) {
+        const ssize_t w = pwrite(fd, data, n, (off_t)offset);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return -1;
+        data += w;
+        offset += (uint64_t)w;
+        n -= (size_t)w;
+    }
+    return 0;
+}
+
+/* Keeps data named hash (write then rename: a reader never sees half). */
+static int p2p_store_put(const holos_p2p_hash_t *hash, const unsigned char *data, size_t n) {
+    char path[P2P_PATH], tmp[P2P_PATH + 24];
+    int fd;
+    if (p2p_store_path(hash, path, sizeof(path)) != 0) return -1;
+    if (access(path, F_OK) == 0) return 0;
+    snprintf(tmp, sizeof(tmp), "%s.%ld", path, (long)getpid());
+    if (p2p_mkdirs(tmp, 0) != 0) return -1;
+    fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return -1;
+    if (p2p_write_all(fd, data, n, 0) != 0) {
+        close(fd);
+        unlink(tmp);
+        return -1;
+    }
+    if (close(fd) != 0 || rename(tmp, path) != 0) {
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+/* Maps the stored copy of hash; NULL if there is none. */
+static unsigned char *p2p_store_map(const holos_p2p_hash_t *hash, size_t *size) {
+    char path[P2P_PATH];
+    struct stat st;
+    void *map;
+    int fd;
+    if (p2p_store_path(hash, path, sizeof(path)) != 0) return NULL;
+    fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0 || (uint64_t)st.st_size > P2P_MANIFEST_MAX) {
+        close(fd);
+        return NULL;
+    }
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return NULL;
+    *size = (size_t)st.st_size;
+    return map;
+}
+
+/* The stored copy of hash if it is whole and sound, in a map. */
+static unsigned char *p2p_store_verified(const holos_p2p_hash_t *hash, size_t *size) {
+    holos_p2p_hash_t got;
+    unsigned char *map = p2p_store_map(hash, size);
+    if (!map) return NULL;
+    p2p_sha256(map, *size, &got);
+    if (memcmp(&got, hash, 32) == 0) return map;
+    munmap(map, *size);
+    return NULL;
+}
+
+/* ---------------- Deltas ---------------- */
+
+static unsigned g_delta = HOLOS_P2P_DELTA_BLOCKS | HOLOS_P2P_DELTA_XOR;
+
+int holos_p2p_delta(unsigned codings) {
+    if (codings & ~(unsigned)(HOLOS_P2P_DELTA_BLOCKS | HOLOS_P2P_DELTA_XOR)) return HOLOS_P2P_ERR_GENERIC;
+    g_delta = codings;
+    return HOLOS_P2P_OK;
+}
+
+/* rsync's rolling checksum of n bytes: a the sum of the bytes, b the
+   sum of the running sums; the hash is their low 16 bits each. */
+static void p2p_weak(const unsigned char *p, size_t n, uint32_t *a, uint32_t *b) {
+    uint32_t s = 0, t = 0;
+    for (size_t i = 0; i < n; i++) {
+        s += p[i];
+        t += s;
+    }
+    *a = s;
+    *b = t;
+}
+
+static uint32_t p2p_weak_hash(uint32_t a, uint32_t b) {
+    return (a & 0xffff) | b << 16;
+}
+
+/* Signature of the whole blocks of base, 12 bytes a block. */
+static size_t p2p_delta_sign(const unsigned char *base, size_t n, unsigned char *sig) {
+    const size_t blocks = n / P2P_DELTA_BLOCK;
+    for (size_t k = 0; k < blocks; k++) {
+        const unsigned char *blk = base + k * P2P_DELTA_BLOCK;
+        holos_p2p_hash_t strong;
+        uint32_t a, b;
+        p2p_weak(blk, P2P_DELTA_BLOCK, &a, &b);
+        p2p_put32(sig + 12 * k, p2p_weak_hash(a, b));
+        p2p_sha256(blk, P2P_DELTA_BLOCK, &strong);
+        memcpy(sig + 12 * k + 4, strong.b, 8);
+    }
+    return blocks;
+}
+
+/* XOR-delta coding, for arrays of doubles: the bytes as 8-byte words,
+   each XORed with the word before (zero before the first), or with the
+   word at the same place of ref, keep their low-order bytes up to the
+   last nonzero one (the sign and exponent bytes of close values XOR to
+   zero). A nibble per word counts them, two per byte, low nibble
+   first; then the kept bytes, then the n % 8 bytes left over as they
+   are. At most n + n / 16 + 1 bytes. */
+static size_t p2p_xor_encode(const unsigned char *in, const unsigned char *ref, size_t n, unsigned char *out) {
+    const size_t words = n / 8, nib = (words + 1) / 2;
+    unsigned char zero[8] = {0};
+    size_t at = nib;
+    memset(out, 0, nib);
+    for (size_t w = 0; w < words; w++) {
+        const unsigned char *prev = ref ? ref + 8 * w : w ? in + 8 * (w - 1) : zero;
+        unsigned char x[8];
+        size_t kept = 0;
+        for (size_t j = 0; j < 8; j++) {
+            x[j] = in[8 * w + j] ^ prev[j];
+            if (x[j]) kept = j + 1;
+        }
+        out[w / 2] |= (unsigned char)(kept << (4 * (w & 1)));
+        memcpy(out + at, x, kept);
+        at += kept;
+    }
+    memcpy(out + at, in + 8 * words, n % 8);
+    return at + n % 8;
+}
+
+static int p2p_xor_decode(const unsigned char *in, size_t m, const unsigned char *ref, unsigned char *out, size_t n) {
+    const size_t words = n / 8, nib = (words + 1) / 2;
+    unsigned char zero[8] = {0};
+    size_t at = nib;
+    if (m < nib) return -1;
+    for (size_t w = 0; w < words; w++) {
+        const unsigned char *prev = ref ? ref + 8 * w : w ? out + 8 * (w - 1) : zero;
+        const size_t kept = (size_t)(in[w / 2] >> (4 * (w & 1))) & 0xf;
+        if (kept > 8 || m - at < kept) return -1;
+        for (size_t j = 0; j < 8; j++) out[8 * w + j] = prev[j] ^ (j < kept ? in[at + j] : 0);
+        at += kept;
+    }
+    if (m - at != n % 8) return -1;
+    memcpy(out + 8 * words, in + at, n % 8);
+    return 0;
+}
+
+struct p2p_sig {
+    uint32_t weak, block;
+    const unsigned char *strong;
+};
+
+static int p2p_sig_cmp(const void *a, const void *b) {
+    const struct p2p_sig *x = a, *y = b;
+    if (x->weak != y->weak) return x->weak < y->weak ? -1 : 1;
+    return (x->block > y->block) - (x->block < y->block);
+}
+
+/* Block of the signature holding the P2P_DELTA_BLOCK bytes at p, or
+   blocks. */
+static size_t p2p_sig_match(const struct p2p_sig *v, size_t blocks, uint32_t weak, const unsigned char *p) {
+    size_t lo = 0, hi = blocks;
+    holos_p2p_hash_t strong;
+    int hashed = 0;
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+        if (v[mid].weak < weak) lo = mid + 1;
+        else hi = mid;
+    }
+    for (; lo < blocks && v[lo].weak == weak; lo++) {
+        if (!hashed) {
+            p2p_sha256(p, P2P_DELTA_BLOCK, &strong);
+            hashed = 1;
+        }
+        if (memcmp(strong.b, v[lo].strong, 8) == 0) return v[lo].block;
+    }
+    return blocks;
+}
+
+struct p2p_script {
+    unsigned char *out, *xor;
+    size_t n, cap;
+    unsigned codings;
+};
+
+static int p2p_script_copy(struct p2p_script *s, size_t first, size_t count) {
+    if (!count) return 0;
+    if (s->cap - s->n < 9) return -1;
+    s->out[s->n] = 'C';
+    p2p_put32(s->out + s->n + 1, (uint32_t)first);
+    p2p_put32(s->out + s->n + 5, (uint32_t)count);
+    s->n += 9;
+    return 0;
+}
+
+static int p2p_script_bytes(struct p2p_script *s, const unsigned char *p, size_t len) {
+    size_t m = len;
+    if (!len) return 0;
+    if (s->codings & HOLOS_P2P_DELTA_XOR) m = p2p_xor_encode(p, NULL, len, s->xor);
+    if (m < len) {
+        if (s->cap - s->n < 9 || s->cap - s->n - 9 < m) return -1;
+        s->out[s->n] = 'X';
+        p2p_put32(s->out + s->n + 1, (uint32_t)len);
+        p2p_put32(s->out + s->n + 5, (uint32_t)m);
+        memcpy(s->out + s->n + 9, s->xor, m);
+        s->n += 9 + m;
+    } else {
+        if (s->cap - s->n < 5 || s->cap - s->n - 5 < len) return -1;
+        s->out[s->n] = 'R';
+        p2p_put32(s->out + s->n + 1, (uint32_t)len);
+        memcpy(s->out + s->n + 5, p, len);
+        s->n += 5 + len;
+    }
+    return 0;
+}
+
+/* Delta of data against the blocks of sig, or NULL if it would not be
+   smaller than data. */
+static unsigned char *p2p_delta_make(const unsigned char *data, size_t size, const unsigned char *sig, size_t blocks,
+                                     unsigned codings, size_t *out_size) {
+    struct p2p_script s;
+    struct p2p_sig *v = malloc((blocks ? blocks : 1) * sizeof(*v));
+    unsigned char *filter = calloc(8192, 1);   /* Bit per low 16 bits of a weak hash */
+    size_t i = 0, lit = 0, run_first = 0, run_n = 0;
+    uint32_t a = 0, b = 0;
+    int rolled = 0, rc = 0;
+    s.out = malloc(size ? size : 1);
+    s.xor = malloc(size + size / 16 + 1);
+    s.n = 0;
+    s.cap = size ? size - 1 : 0;        /* Smaller than data, or not worth it */
+    s.codings = codings;
+    if (!v || !filter || !s.out || !s.xor || !(codings & HOLOS_P2P_DELTA_BLOCKS)) blocks = 0;
+    if (!v || !filter || !s.out || !s.xor) rc = -1;
+    for (size_t k = 0; k < blocks; k++) {
+        v[k].weak = p2p_get32(sig + 12 * k);
+        v[k].block = (uint32_t)k;
+        v[k].strong = sig + 12 * k + 4;
+        filter[(v[k].weak & 0xffff) >> 3] |= (unsigned char)(1u << (v[k].weak & 7));
+    }
+    if (blocks) qsort(v, blocks, sizeof(*v), p2p_sig_cmp);
+    while (rc == 0 && blocks && i + P2P_DELTA_BLOCK <= size) {
+        uint32_t weak;
+        size_t k = blocks;
+        if (!rolled) {
+            p2p_weak(data + i, P2P_DELTA_BLOCK, &a, &b);
+            rolled = 1;
+        }
+        weak = p2p_weak_hash(a, b);
+        if (filter[(weak & 0xffff) >> 3] & (1u << (weak & 7))) k = p2p_sig_match(v, blocks, weak, data + i);
+        if (k < blocks) {
+            if (lit < i || (run_n && run_first + run_n != k)) {
+                rc = p2p_script_copy(&s, run_first, run_n);
+                if (rc == 0) rc = p2p_script_bytes(&s, data + lit, i - lit);
+                run_n = 0;
+            }
+            if (!run_n) run_first = k;
+            run_n++;
+            i += P2P_DELTA_BLOCK;
+            lit = i;
+            rolled = 0;
+            continue;
+        }
+        if (i + P2P_DELTA_BLOCK < size) {
+            a += data[i + P2P_DELTA_BLOCK] - (uint32_t)data[i];
+            b += a - (uint32_t)P2P_DELTA_BLOCK * data[i];
+        }
+        i++;
+    }
+    if (rc == 0) rc = p2p_script_copy(&s, run_first, run_n);
+    if (rc == 0) rc = p2p_script_bytes(&s, data + lit, size - lit);
+    free(v);
+    free(filter);
+    free(s.xor);
+    if (rc != 0) {
+        free(s.out);
+        return NULL;
+    }
+    *out_size = s.n;
+    return s.out;
+}
+
+/* Delta of data against the old chunk itself, or NULL if it would not
+   be smaller than data. */
+static unsigned char *p2p_delta_xor(const unsigned char *data, size_t size, const unsigned char *old, size_t old_size,
+                                    size_t *out_size) {
+    const size_t n = (old_size < size ? old_size : size) / 8 * 8;
+    struct p2p_script s;
+    size_t m;
+    s.out = malloc(size ? size : 1);
+    s.xor = malloc(size + size / 16 + 1);
+    s.n = 0;
+    s.cap = size ? size - 1 : 0;
+    s.codings = HOLOS_P2P_DELTA_XOR;
+    if (!s.out || !s.xor || (m = p2p_xor_encode(data, old, n, s.xor)) > s.cap || s.cap - m < 9) {
+        free(s.out);
+        free(s.xor);
+        return NULL;
+    }
+    s.out[0] = 'B';
+    p2p_put32(s.out + 1, (uint32_t)n);
+    p2p_put32(s.out + 5, (uint32_t)m);
+    memcpy(s.out + 9, s.xor, m);
+    s.n = 9 + m;
+    if (p2p_script_bytes(&s, data + n, size - n) != 0) {
+        free(s.out);
+        s.out = NULL;
+    }
+    free(s.xor);
+    *out_size = s.n;
+    return s.out;
+}
+
+/* Rebuilds the size bytes of a chunk from its delta and the old chunk. */
+static int p2p_delta_apply(const unsigned char *d, size_t n, const unsigned char *base, size_t base_size,
+                           unsigned char *out, size_t size) {
+    const size_t base_blocks = base ? base_size / P2P_DELTA_BLOCK : 0;
+    size_t at = 0, len = 0;
+    while (at < n) {
+        if (d[at] == 'C') {
+            size_t first, count;
+            if (n - at < 9) return -1;
+            first = p2p_get32(d + at + 1);
+            count = p2p_get32(d + at + 5);
+            if (first > base_blocks || count > base_blocks - first || count > (size - len) / P2P_DELTA_BLOCK) return -1;
+            memcpy(out + len, base + first * P2P_DELTA_BLOCK, count * P2P_DELTA_BLOCK);
+            len += count * P2P_DELTA_BLOCK;
+            at += 9;
+        } else if (d[at] == 'R') {
+            size_t m;
+            if (n - at < 5) return -1;
+            m = p2p_get32(d + at + 1);
+            if (m > n - at - 5 || m > size - len) return -1;
+            memcpy(out + len, d + at + 5, m);
+            len += m;
+            at += 5 + m;
+        } else if (d[at] == 'X') {
+            size_t raw, m;
+            if (n - at < 9) return -1;
+            raw = p2p_get32(d + at + 1);
+            m = p2p_get32(d + at + 5);
+            if (m > n - at - 9 || raw > size - len || p2p_xor_decode(d + at + 9, m, NULL, out + len, raw) != 0)
+                return -1;
+            len += raw;
+            at += 9 + m;
+        } else if (d[at] == 'B') {
+            size_t raw, m;
+            if (n - at < 9 || !base) return -1;
+            raw = p2p_get32(d + at + 1);
+            m = p2p_get32(d + at + 5);
+            if (m > n - at - 9 || raw > size - len || len > base_size || raw > base_size - len ||
+                p2p_xor_decode(d + at + 9, m, base + len, out + len, raw) != 0)
+                return -1;
+            len += raw;
+            at += 9 + m;
+        } else {
+            return -1;
+        }
+    }
+    return len == size ? 0 : -1;
+}
+
+/* ---------------- Shares ---------------- */
+
+struct p2p_share {
+    struct p2p_share *next;
+    struct p2p_object obj;
+    unsigned char *blob;                /* holos_p2p_send_data copy, or NULL */
+};
+
+static struct p2p_share *g_shares = NULL;
+static size_t g_n_blobs = 0;
+
+struct p2p_names {
+    char **v;
+    size_t n, cap;
+};
+
+static int p2p_names_add(struct p2p_names *names, const char *s) {
+    if (names->n == names->cap) {
+        const size_t cap = names->cap ? 2 * names->cap : 16;
+        char **grown = realloc(names->v, cap * sizeof(*grown));
+        if (!grown) return -1;
+        names->v = grown;
+        names->cap = cap;
+    }
+    if (!(names->v[names->n] = strdup(s))) return -1;
+    names->n++;
+    return 0;
+}
+
+/* Regular files under root/rel, as paths relative to root. */
+static int p2p_walk(const char *root, const char *rel, struct p2p_names *names) {
+    char dir[P2P_PATH];
+    struct dirent *e;
+    DIR *d;
+    int rc = 0;
+    snprintf(dir, sizeof(dir), "%s%s%s", root, *rel ? "/" : "", rel);
+    d = opendir(dir);
+    if (!d) return -1;
+    while (rc == 0 && (e = readdir(d))) {
+        char sub[P2P_PATH], full[P2P_PATH];
+        struct stat st;
+        if (strcmp(e->d_name, ".") == 0 || strcmp(e->d_name, "..") == 0) continue;
+        if ((size_t)snprintf(sub, sizeof(sub), "%s%s%s", rel, *rel ? "/" : "", e->d_name) >= sizeof(sub) ||
+            (size_t)snprintf(full, sizeof(full), "%s/%s", root, sub) >= sizeof(full) || strlen(sub) > 0xffff) {
+            rc = -1;
+            break;
+        }
+        if (lstat(full, &st) != 0) continue;
+        if (S_ISDIR(st.st_mode)) rc = p2p_walk(root, sub, names);
+        else if (S_ISREG(st.st_mode)) rc = p2p_names_add(names, sub);
+    }
+    closedir(d);
+    return rc;
+}
+
+static int p2p_name_cmp(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/* Maps file i of o from path and names its chunks. */
+static int p2p_share_file(struct p2p_object *o, size_t i, const char *path) {
+    struct p2p_file *f = &o->files[i];
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    f->size = (uint64_t)st.st_size;
+    if (f->size) {
+        void *map = mmap(NULL, (size_t)f->size, PROT_READ, MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED) {
+            close(fd);
+            return -1;
+        }
+        f->map = map;
+    }
+    close(fd);
+    return 0;
+}
+
+static struct p2p_share *p2p_share_find(const holos_p2p_hash_t *id) {
+    for (struct p2p_share *s = g_shares; s; s = s->next)
+        if (memcmp(&s->obj.id, id, 32) == 0) return s;
+    return NULL;
+}
+
+/* Names the chunks of a share whose files are mapped, and links it. */
+static int p2p_share_add(struct p2p_share *s, holos_p2p_hash_t *id) {
+    struct p2p_object *o = &s->obj;
+    o->n_chunks = 0;
+    for (size_t f = 0; f < o->n_files; f++) {
+        o->files[f].first = o->n_chunks;
+        o->n_chunks += p2p_chunks_of(o->files[f].size);
+    }
+    o->chunks = malloc((o->n_chunks ? o->n_chunks : 1) * sizeof(*o->chunks));
+    if (!o->chunks) return -1;
+    for (size_t f = 0, c = 0; f < o->n_files; f++)
+        for (uint64_t at = 0; at < o->files[f].size; at += HOLOS_P2P_CHUNK_SIZE, c++) {
+            const uint64_t left = o->files[f].size - at;
+            p2p_sha256(o->files[f].map + at, (size_t)(left < HOLOS_P2P_CHUNK_SIZE ? left : HOLOS_P2P_CHUNK_SIZE),
+                       &o->chunks[c]);
+        }
+    if (p2p_manifest_build(o) != 0) return -1;
+    if (id) *id = o->id;
+    if (p2p_share_find(&o->id)) {           /* Already served */
+        if (s->blob) o->files[0].map = NULL;
+        p2p_object_free(o);
+        free(s->blob);
+        free(s);
+        return 1;
+    }
+    s->next = g_shares;
+    g_shares = s;
+    return 0;
+}
+
+int holos_p2p_share_path(const char *path, holos_p2p_hash_t *id) {
+    struct p2p_names names = {NULL, 0, 0};
+    struct p2p_share *s;
+    struct stat st;
+    int rc = -1;
+    if (!path || stat(path, &st) != 0) return HOLOS_P2P_ERR_GENERIC;
+    s = calloc(1, sizeof(*s));
+    if (!s) return HOLOS_P2P_ERR_GENERIC;
+    if (S_ISDIR(st.st_mode)) {
+        if (p2p_walk(path, "", &names) != 0) goto done;
+        qsort(names.v, names.n, sizeof(*names.v), p2p_name_cmp);
+    } else {
+        const char *base = strrchr(path, '/');
+        if (p2p_names_add(&names, base ? base + 1 : path) != 0) goto done;
+    }
+    s->obj.files = calloc(names.n ? names.n : 1, sizeof(*s->obj.files));
+    if (!s->obj.files) goto done;
+    s->obj.n_files = names.n;
+    for (size_t i = 0; i < names.n; i++) {
+        char full[P2P_PATH];
+        s->obj.files[i].path = names.v[i];
+        names.v[i] = NULL;
+        if (S_ISDIR(st.st_mode)) snprintf(full, sizeof(full), "%s/%s", path, s->obj.files[i].path);
+        else snprintf(full, sizeof(full), "%s", path);
+        if (p2p_share_file(&s->obj, i, full) != 0) goto done;
+    }
+    rc = p2p_share_add(s, id);
+    if (rc >= 0) s = NULL;
+done:
+    for (size_t i = 0; i < names.n; i++) free(names.v[i]);
+    free(names.v);
+    if (s) {
+        p2p_object_free(&s->obj);
+        free(s);
+    }
+    return rc >= 0 ? HOLOS_P2P_OK : HOLOS_P2P_ERR_GENERIC;
+}
+
+static void p2p_serve_drop_share(const struct p2p_share *share);
+
+static void p2p_share_free(struct p2p_share *s) {
+    p2p_serve_drop_share(s);
+    if (s->blob) {
+        s->obj.files[0].map = NULL;
+        g_n_blobs--;
+    }
+    p2p_object_free(&s->obj);
+    free(s->blob);
+    free(s);
+}
+
+int holos_p2p_unshare(const holos_p2p_hash_t *id) {
+    for (struct p2p_share **at = &g_shares; id && *at; at = &(*at)->next)
+        if (memcmp(&(*at)->obj.id, id, 32) == 0) {
+            struct p2p_share *s = *at;
+            *at = s->next;
+            p2p_share_free(s);
+            return HOLOS_P2P_OK;
+        }
+    return HOLOS_P2P_ERR_PROJECT_NOT_FOUND;
+}
+
+/* ---------------- Serving ---------------- */
+
+/* A GET being answered */
+struct p2p_serve {
+    struct p2p_serve *next;
+    char *peer;
+    holos_p2p_hash_t hash;
+    const struct p2p_share *share;      /* Source of data, or NULL */
+    const unsigned char *data;          /* NULL: answer MISSING */
+    unsigned char *map;                 /* From the store, unmapped when done */
+    size_t map_size;
+    unsigned char *delta;               /* Answer to a DELTA, freed when done */
+    int kind;                           /* PIECE, or DPIECE with delta */
+    uint64_t total, at, end;
+};
+
+static struct p2p_serve *g_serves = NULL;
+
+static void p2p_serve_free(struct p2p_serve *v) {
+    if (v->map) munmap(v->map, v->map_size);
+    free(v->delta);
+    free(v->peer);
+    free(v);
+}
+
+static void p2p_serve_drop(int (*match)(const struct p2p_serve *, const void *), const void *arg) {
+    struct p2p_serve **at = &g_serves;
+    while (*at) {
+        struct p2p_serve *v = *at;
+        if (match(v, arg)) {
+            *at = v->next;
+            p2p_serve_free(v);
+        } else {
+            at = &v->next;
+        }
+    }
+}
+
+static int p2p_serve_of_share(const struct p2p_serve *v, const void *share) {
+    return v->share == share;
+}
+
+static int p2p_serve_of_peer(const struct p2p_serve *v, const void *peer) {
+    return strcmp(v->peer, peer) == 0;
+}
+
+static void p2p_serve_drop_share(const struct p2p_share *share) {
+    p2p_serve_drop(p2p_serve_of_share, share);
+}
+
+/* Sends what is queued to peer until its link refuses. */
+static void p2p_serve_pump(const char *peer) {
+    struct p2p_serve **at = &g_serves;
+    while (*at) {
+        struct p2p_serve *v = *at;
+        int rc = HOLOS_P2P_OK;
+        if (strcmp(v->peer, peer) != 0) {
+            at = &v->next;
+            continue;
+        }
+        if (!v->data) {
+            rc = p2p_link_send_record(peer, P2P_REC_CHUNK_MISSING, &v->hash, 32, NULL, 0);
+        } else {
+            do {                        /* At least one piece, if empty */
+                unsigned char head[P2P_GET_HEAD];
+                const size_t n = (size_t)(v->end - v->at < P2P_PIECE ? v->end - v->at : P2P_PIECE);
+                memcpy(head, &v->hash, 32);
+                p2p_put64(head + 32, v->at);
+                p2p_put64(head + 40, v->total);
+                rc = p2p_link_send_record(peer, v->kind, head, sizeof(head), v->data + v->at, n);
+                if (rc == HOLOS_P2P_OK) v->at += n;
+            } while (rc == HOLOS_P2P_OK && v->at < v->end);
+        }
+        if (rc == HOLOS_P2P_ERR_AGAIN) return;
+        *at = v->next;
+        p2p_serve_free(v);
+    }
+}
+
+/* A serve of the object or chunk named by the hash at r, from a share
+   or the store (data NULL if neither has it). */
+static struct p2p_serve *p2p_serve_new(const char *peer, const unsigned char *r) {
+    struct p2p_serve *v = calloc(1, sizeof(*v));
+    if (!v || !(v->peer = strdup(peer))) {
+        free(v);
+        return NULL;
+    }
+    memcpy(&v->hash, r, 32);
+    v->kind = P2P_REC_CHUNK_PIECE;
+    for (struct p2p_share *s = g_shares; s && !v->data; s = s->next) {
+        size_t pos;
+        if (memcmp(&s->obj.id, &v->hash, 32) == 0) {
+            v->share = s;
+            v->data = s->obj.manifest;
+            v->total = s->obj.manifest_size;
+        } else if ((pos = p2p_object_find(&s->obj, &v->hash)) < s->obj.n_chunks) {
+            const size_t c = s->obj.order[pos];
+            uint64_t at;
+            size_t size;
+            p2p_chunk_span(&s->obj, c, &at, &size);
+            v->share = s;
+            v->data = s->obj.files[s->obj.owner[c]].map + at;
+            v->total = size;
+        }
+    }
+    if (!v->data && (v->map = p2p_store_map(&v->hash, &v->map_size))) {
+        v->data = v->map;
+        v->total = v->map_size;
+    }
+    return v;
+}
+
+static void p2p_serve_queue(struct p2p_serve *v) {
+    struct p2p_serve **tail;
+    for (tail = &g_serves; *tail; tail = &(*tail)->next) {}
+    *tail = v;
+    p2p_serve_pump(v->peer);
+}
+
+static void p2p_on_get(const char *peer, const unsigned char *r, size_t n) {
+    struct p2p_serve *v;
+    uint64_t offset, length;
+    if (n != P2P_GET_HEAD || !(v = p2p_serve_new(peer, r))) return;
+    offset = p2p_get64(r + 32);
+    length = p2p_get64(r + 40);
+    v->at = offset < v->total ? offset : v->total;
+    v->end = length < v->total - v->at ? v->at + length : v->total;
+    p2p_serve_queue(v);
+}
+
+/* Answered with the smaller delta if it is smaller than the chunk,
+   with the chunk if not. */
+static void p2p_on_delta(const char *peer, const unsigned char *r, size_t n) {
+    static const holos_p2p_hash_t none;
+    struct p2p_serve *v;
+    const unsigned codings = g_delta & (n >= P2P_DELTA_HEAD ? p2p_get32(r + 32) : 0);
+    const size_t blocks = n >= P2P_DELTA_HEAD ? p2p_get32(r + 36) : 0;
+    const holos_p2p_hash_t *old = (const holos_p2p_hash_t *)(r + 40);
+    if (n < P2P_DELTA_HEAD || blocks > P2P_DELTA_SIGNED || n != P2P_DELTA_HEAD + 12 * blocks) return;
+    if (!(v = p2p_serve_new(peer, r))) return;
+    if (codings && v->data && v->total <= HOLOS_P2P_CHUNK_SIZE) {
+        const size_t total = (size_t)v->total;
+        size_t size = total, old_size, xsize;
+        unsigned char *d, *x = NULL, *map;
+        if (v->share && v->data != v->share->obj.manifest) p2p_store_put(&v->hash, v->data, total);
+        d = p2p_delta_make(v->data, total, r + P2P_DELTA_HEAD, blocks, codings, &size);
+        if ((codings & HOLOS_P2P_DELTA_XOR) && memcmp(old, &none, 32) != 0 && (map = p2p_store_map(old, &old_size))) {
+            x = p2p_delta_xor(v->data, total, map, old_size, &xsize);
+            munmap(map, old_size);
+        }
+        if (x && (!d || xsize < size)) {
+            free(d);
+            d = x;
+            size = xsize;
+        } else {
+            free(x);
+        }
+        if (d) {
+            v->delta = d;
+            v->data = d;
+            v->total = size;
+            v->kind = P2P_REC_CHUNK_DELTA_PIECE;
+        }
+    }
+    v->end = v->total;
+    p2p_serve_queue(v);
+}
+
+/* ---------------- Fetching ---------------- */
+
+enum { P2P_WANTED, P2P_ASKED, P2P_DONE };
+
+struct p2p_want {
+    int state;
+    size_t peer;                        /* Asked of, while P2P_ASKED */
+    size_t have;                        /* Bytes received: the resume point */
+    unsigned char *buf;
+    int delta;                          /* Asked as a DELTA: have and buf are its */
+    int plain;                          /* A delta failed: ask the bytes */
+    size_t delta_total;
+    uint64_t asked_at;                  /* p2p_stats_now when asked */
+};
+
+struct holos_p2p_fetch {
+    struct holos_p2p_fetch *next;
+    holos_p2p_hash_t id;
+    char *dir;
+    char **peers;                       /* NULL once dropped */
+    size_t *busy;                       /* Requests outstanding per peer */
+    size_t n_peers, cap_peers;
+    unsigned char *manifest;            /* Until it is whole */
+    uint64_t manifest_total, manifest_have;
+    size_t manifest_peer;               /* n_peers: not asked */
+    int parsed;
+    struct p2p_object obj;
+    struct p2p_object base;             /* Deltas against, if based */
+    int based;
+    size_t *base_files;                 /* Base file of each file (base.n_files: none) */
+    struct p2p_want *wants;
+    size_t cursor;                      /* No P2P_WANTED chunk before */
+    size_t left;
+    uint64_t have, total;
+    int over, status;
+    int starting, calling, doomed;      /* done deferred; in done; freed from done */
+    holos_p2p_fetch_callback done;
+    void *cls;
+};
+
+static struct holos_p2p_fetch *g_fetches = NULL;
+
+static void p2p_fetch_finish(struct holos_p2p_fetch *f, int status);
+static void p2p_fetch_reap(void);
+void holos_p2p_fetch_free(struct holos_p2p_fetch *f);
+
+static int p2p_fetch_open(const struct holos_p2p_fetch *f, size_t file, int flags) {
+    char path[P2P_PATH];
+    if ((size_t)snprintf(path, sizeof(path), "%s/%s", f->dir, f->obj.files[file].path) >= sizeof(path)) return -1;
+    if ((flags & O_CREAT) && p2p_mkdirs(path, 0) != 0) return -1;
+    return open(path, flags, 0644);
+}
+
+/* Writes chunk c (data) to the destination and marks it done. */
+static void p2p_fetch_place(struct holos_p2p_fetch *f, size_t c, const unsigned char *data) {
+    struct p2p_want *w = &f->wants[c];
+    uint64_t at;
+    size_t size;
+    int fd;
+    p2p_chunk_span(&f->obj, c, &at, &size);
+    fd = p2p_fetch_open(f, f->obj.owner[c], O_WRONLY);
+    if (fd < 0 || p2p_write_all(fd, data, size, at) != 0) {
+        if (fd >= 0) close(fd);
+        p2p_fetch_finish(f, HOLOS_P2P_ERR_GENERIC);
+        return;
+    }
+    close(fd);
+    if (w->state == P2P_ASKED) f->busy[w->peer]--;
+    f->have += size - w->have;
+    free(w->buf);
+    w->buf = NULL;
+    w->have = size;
+    w->state = P2P_DONE;
+    f->left--;
+}
+
+/* Places data as chunk c and as every other wanted chunk of the same
+   name, which then need not be asked for. */
+static void p2p_fetch_place_all(struct holos_p2p_fetch *f, size_t c, const unsigned char *data) {
+    for (size_t p = p2p_object_find(&f->obj, &f->obj.chunks[c]);
+         p < f->obj.n_chunks && memcmp(&f->obj.chunks[f->obj.order[p]], &f->obj.chunks[c], 32) == 0 && !f->over; p++) {
+        const size_t d = f->obj.order[p];
+        if (f->wants[d].state != P2P_DONE) p2p_fetch_place(f, d, data);
+    }
+}
+
+/* Manifest in: lays out the destination and takes what the store has. */
+static int p2p_fetch_begin(struct holos_p2p_fetch *f) {
+    f->wants = calloc(f->obj.n_chunks ? f->obj.n_chunks : 1, sizeof(*f->wants));
+    if (!f->wants) return -1;
+    f->parsed = 1;
+    f->left = f->obj.n_chunks;
+    for (size_t i = 0; i < f->obj.n_files; i++) {
+        const int fd = p2p_fetch_open(f, i, O_WRONLY | O_CREAT);
+        if (fd < 0) return -1;
+        if (ftruncate(fd, (off_t)f->obj.files[i].size) != 0) {
+            close(fd);
+            return -1;
+        }
+        close(fd);
+        f->total += f->obj.files[i].size;
+    }
+    for (size_t c = 0; c < f->obj.n_chunks && !f->over; c++) {
+        unsigned char *map;
+        size_t size;
+        if (f->wants[c].state == P2P_DONE || !(map = p2p_store_verified(&f->obj.chunks[c], &size))) continue;
+        p2p_fetch_place_all(f, c, map);
+        munmap(map, size);
+    }
+    return f->over ? -1 : 0;
+}
+
+static int p2p_fetch_manifest(struct holos_p2p_fetch *f, unsigned char *m, size_t n) {
+    if (p2p_manifest_parse(m, n, &f->obj) != 0 || memcmp(&f->obj.id, &f->id, 32) != 0) {
+        if (f->obj.manifest) p2p_object_free(&f->obj);
+        return -1;
+    }
+    p2p_store_put(&f->id, f->obj.manifest, f->obj.manifest_size);
+    return 0;
+}
+
+static int p2p_fetch_ask(struct holos_p2p_fetch *f, size_t p, const holos_p2p_hash_t *hash, uint64_t offset,
+                         uint64_t length) {
+    unsigned char head[P2P_GET_HEAD];
+    memcpy(head, hash, 32);
+    p2p_put64(head + 32, offset);
+    p2p_put64(head + 40, length);
+    return p2p_link_send_record(f->peers[p], P2P_REC_CHUNK_GET, head, sizeof(head), NULL, 0);
+}
+
+/* Maps the chunk of the base at the place of chunk c (named in *old if
+   old is not NULL), if it is in the store. */
+static unsigned char *p2p_fetch_base_map(struct holos_p2p_fetch *f, size_t c, size_t *size, holos_p2p_hash_t *old) {
+    const size_t file = f->obj.owner[c];
+    size_t bf, k;
+    if (!f->based) return NULL;
+    if (!f->base_files) {
+        f->base_files = malloc((f->obj.n_files ? f->obj.n_files : 1) * sizeof(*f->base_files));
+        if (!f->base_files) return NULL;
+        for (size_t i = 0; i < f->obj.n_files; i++) {
+            f->base_files[i] = f->base.n_files;
+            for (size_t j = 0; j < f->base.n_files && f->base_files[i] == f->base.n_files; j++)
+                if (strcmp(f->obj.files[i].path, f->base.files[j].path) == 0) f->base_files[i] = j;
+        }
+    }
+    if ((bf = f->base_files[file]) == f->base.n_files) return NULL;
+    k = c - f->obj.files[file].first;
+    if (k >= p2p_chunks_of(f->base.files[bf].size)) return NULL;
+    if (old) *old = f->base.chunks[f->base.files[bf].first + k];
+    return p2p_store_map(&f->base.chunks[f->base.files[bf].first + k], size);
+}
+
+static int p2p_fetch_ask_delta(struct holos_p2p_fetch *f, size_t p, size_t c) {
+    unsigned char head[P2P_DELTA_HEAD], sig[12 * P2P_DELTA_SIGNED];
+    size_t blocks = 0, size;
+    holos_p2p_hash_t old;
+    unsigned char *base = p2p_fetch_base_map(f, c, &size, &old);
+    memset(head + 40, 0, 32);
+    if (base) {
+        if (g_delta & HOLOS_P2P_DELTA_BLOCKS)
+            blocks = p2p_delta_sign(base, size < HOLOS_P2P_CHUNK_SIZE ? size : HOLOS_P2P_CHUNK_SIZE, sig);
+        memcpy(head + 40, &old, 32);
+        munmap(base, size);
+    }
+    memcpy(head, &f->obj.chunks[c], 32);
+    p2p_put32(head + 32, g_delta);
+    p2p_put32(head + 36, (uint32_t)blocks);
+    return p2p_link_send_record(f->peers[p], P2P_REC_CHUNK_DELTA, head, sizeof(head), sig, 12 * blocks);
+}
+
+static void p2p_fetch_drop(struct holos_p2p_fetch *f, size_t p);
+
+/* Asks each peer for chunks up to its window. */
+static void p2p_fetch_schedule(struct holos_p2p_fetch *f) {
+    size_t live = 0;
+    if (f->over) return;
+    if (f->parsed && f->left == 0) {
+        p2p_fetch_finish(f, HOLOS_P2P_OK);
+        return;
+    }
+    for (size_t p = 0; p < f->n_peers && !f->over; p++) {
+        if (!f->peers[p]) continue;
+        if (!f->parsed) {
+            if (f->manifest_peer == f->n_peers) {
+                const int rc = p2p_fetch_ask(f, p, &f->id, f->manifest_have, P2P_MANIFEST_MAX);
+                if (rc == HOLOS_P2P_OK) f->manifest_peer = p;
+                else if (rc != HOLOS_P2P_ERR_AGAIN) p2p_fetch_drop(f, p);
+            }
+            if (f->peers[p]) live++;
+            continue;
+        }
+        while (f->busy[p] < HOLOS_P2P_FETCH_WINDOW) {
+            size_t c, size;
+            uint64_t at;
+            int rc, delta;
+            while (f->cursor < f->obj.n_chunks && f->wants[f->cursor].state != P2P_WANTED) f->cursor++;
+            if ((c = f->cursor) == f->obj.n_chunks) break;
+            p2p_chunk_span(&f->obj, c, &at, &size);
+            delta = g_delta && !f->wants[c].have && !f->wants[c].plain;
+            rc = delta ? p2p_fetch_ask_delta(f, p, c)
+                       : p2p_fetch_ask(f, p, &f->obj.chunks[c], f->wants[c].have, size - f->wants[c].have);
+            if (rc != HOLOS_P2P_OK) {
+                if (rc != HOLOS_P2P_ERR_AGAIN) p2p_fetch_drop(f, p);
+                break;
+            }
+            f->wants[c].state = P2P_ASKED;
+            f->wants[c].peer = p;
+            f->wants[c].delta = delta;
+            f->wants[c].asked_at = p2p_stats_now();
+            f->busy[p]++;
+        }
+        if (f->peers[p]) live++;
+    }
+    if (!f->over && live == 0) p2p_fetch_finish(f, HOLOS_P2P_ERR_NETWORK);
+}
+
+/* Forgets peer p: what it was asked for goes back to the others, from
+   the byte it had reached. */
+static void p2p_fetch_drop(struct holos_p2p_fetch *f, size_t p) {
+    if (!f->peers[p]) return;
+    free(f->peers[p]);
+    f->peers[p] = NULL;
+    f->busy[p] = 0;
+    if (f->manifest_peer == p) f->manifest_peer = f->n_peers;
+    for (size_t c = 0; f->parsed && c < f->obj.n_chunks; c++)
+        if (f->wants[c].state == P2P_ASKED && f->wants[c].peer == p) {
+            struct p2p_want *w = &f->wants[c];
+            if (w->delta) {             /* Not resumed */
+                free(w->buf);
+                w->buf = NULL;
+                w->have = 0;
+                w->delta = 0;
+            }
+            w->state = P2P_WANTED;
+            if (c < f->cursor) f->cursor = c;
+            p2p_stats_retry(NULL, HOLOS_P2P_RETRY_CHUNK);
+        }
+}
+
+static size_t p2p_fetch_peer(const struct holos_p2p_fetch *f, const char *peer) {
+    for (size_t p = 0; p < f->n_peers; p++)
+        if (f->peers[p] && strcmp(f->peers[p], peer) == 0) return p;
+    return f->n_peers;
+}
+
+static void p2p_fetch_piece(struct holos_p2p_fetch *f, size_t p, const holos_p2p_hash_t *hash, uint64_t offset,
+                            uint64_t total, const unsigned char *data, size_t n) {
+    if (!f->parsed) {
+        if (memcmp(hash, &f->id, 32) != 0 || f->manifest_peer != p || offset != f->manifest_have) return;
+        if (total > P2P_MANIFEST_MAX || n > total - offset || (f->manifest_total && total != f->manifest_total)) {
+            p2p_fetch_drop(f, p);
+            return;
+        }
+        if (!f->manifest && !(f->manifest = malloc(total ? (size_t)total : 1))) {
+            p2p_fetch_finish(f, HOLOS_P2P_ERR_GENERIC);
+            return;
+        }
+        f->manifest_total = total;
+        memcpy(f->manifest + offset, data, n);
+        f->manifest_have += n;
+        if (f->manifest_have < total) return;
+        if (p2p_fetch_manifest(f, f->manifest, (size_t)total) != 0) {
+            f->manifest = NULL;
+            f->manifest_have = f->manifest_total = 0;
+            p2p_fetch_drop(f, p);
+        } else {
+            f->manifest = NULL;
+            if (p2p_fetch_begin(f) != 0) p2p_fetch_finish(f, HOLOS_P2P_ERR_GENERIC);
+        }
+        p2p_fetch_schedule(f);
+        return;
+    }
+    for (size_t q = p2p_object_find(&f->obj, hash);
+         q < f->obj.n_chunks && memcmp(&f->obj.chunks[f->obj.order[q]], hash, 32) == 0; q++) {
+        const size_t c = f->obj.order[q];
+        struct p2p_want *w = &f->wants[c];
+        holos_p2p_hash_t got;
+        uint64_t at;
+        size_t size;
+        if (w->state != P2P_ASKED || w->peer != p || w->have != offset || (w->delta && w->have)) continue;
+        p2p_chunk_span(&f->obj, c, &at, &size);
+        if (total != size || n > size - offset) {
+            p2p_fetch_drop(f, p);
+            break;
+        }
+        w->delta = 0;                   /* A DELTA answered with the bytes */
+        if (!w->buf && !(w->buf = malloc(size ? size : 1))) {
+            p2p_fetch_finish(f, HOLOS_P2P_ERR_GENERIC);
+            return;
+        }
+        memcpy(w->buf + offset, data, n);
+        w->have += n;
+        f->have += n;
+        if (w->have < size) return;
+        p2p_sha256(w->buf, size, &got);
+        if (memcmp(&got, hash, 32) != 0) {  /* Bad data: start over elsewhere */
+            f->have -= w->have;
+            w->have = 0;
+            free(w->buf);
+            w->buf = NULL;
+            p2p_fetch_drop(f, p);
+        } else {
+            unsigned char *buf = w->buf;
+            w->buf = NULL;
+            p2p_stats_rtt(HOLOS_P2P_RTT_CHUNK, w->asked_at);
+            p2p_store_put(hash, buf, size);
+            p2p_fetch_place_all(f, c, buf);
+            free(buf);
+        }
+        break;
+    }
+    p2p_fetch_schedule(f);
+}
+
+/* The delta of chunk c is whole: the chunk, or asked again as bytes. */
+static void p2p_fetch_rebuild(struct holos_p2p_fetch *f, size_t c) {
+    struct p2p_want *w = &f->wants[c];
+    unsigned char *out, *base;
+    size_t base_size = 0, size;
+    uint64_t at;
+    holos_p2p_hash_t got;
+    int ok;
+    p2p_chunk_span(&f->obj, c, &at, &size);
+    out = malloc(size ? size : 1);
+    base = p2p_fetch_base_map(f, c, &base_size, NULL);
+    ok = out && p2p_delta_apply(w->buf, w->delta_total, base, base_size, out, size) == 0;
+    if (ok) p2p_sha256(out, size, &got);
+    if (base) munmap(base, base_size);
+    free(w->buf);
+    w->buf = NULL;
+    w->have = 0;
+    w->delta = 0;
+    if (!out) {
+        p2p_fetch_finish(f, HOLOS_P2P_ERR_GENERIC);
+        return;
+    }
+    if (!ok || memcmp(&got, &f->obj.chunks[c], 32) != 0) {
+        free(out);
+        p2p_stats_retry(NULL, HOLOS_P2P_RETRY_DELTA);
+        w->plain = 1;
+        w->state = P2P_WANTED;
+        f->busy[w->peer]--;
+        if (c < f->cursor) f->cursor = c;
+        return;
+    }
+    p2p_stats_rtt(HOLOS_P2P_RTT_CHUNK, w->asked_at);
+    p2p_store_put(&f->obj.chunks[c], out, size);
+    p2p_fetch_place_all(f, c, out);
+    free(out);
+}
+
+static void p2p_fetch_delta_piece(struct holos_p2p_fetch *f, size_t p, const holos_p2p_hash_t *hash, uint64_t offset,
+                                  uint64_t total, const unsigned char *data, size_t n) {
+    if (!f->parsed) return;
+    for (size_t q = p2p_object_find(&f->obj, hash);
+         q < f->obj.n_chunks && memcmp(&f->obj.chunks[f->obj.order[q]], hash, 32) == 0; q++) {
+        const size_t c = f->obj.order[q];
+        struct p2p_want *w = &f->wants[c];
+        uint64_t at;
+        size_t size;
+        if (w->state != P2P_ASKED || w->peer != p || !w->delta || w->have != offset) continue;
+        p2p_chunk_span(&f->obj, c, &at, &size);
+        if (total >= size || n > total - offset || (w->have && total != w->delta_total)) {
+            p2p_fetch_drop(f, p);
+            break;
+        }
+        if (!w->buf && !(w->buf = malloc(total ? (size_t)total : 1))) {
+            p2p_fetch_finish(f, HOLOS_P2P_ERR_GENERIC);
+            return;
+        }
+        w->delta_total = (size_t)total;
+        memcpy(w->buf + offset, data, n);
+        w->have += n;
+        if (w->have < total) return;
+        p2p_fetch_rebuild(f, c);
+        break;
+    }
+    p2p_fetch_schedule(f);
+}
+
+static void p2p_on_delta_piece(const char *peer, const unsigned char *r, size_t n) {
+    holos_p2p_hash_t hash;
+    if (n < P2P_GET_HEAD) return;
+    memcpy(&hash, r, 32);
+    for (struct holos_p2p_fetch *f = g_fetches; f; f = f->next) {
+        const size_t p = p2p_fetch_peer(f, peer);
+        if (!f->over && p < f->n_peers)
+            p2p_fetch_delta_piece(f, p, &hash, p2p_get64(r + 32), p2p_get64(r + 40), r + P2P_GET_HEAD,
+                                  n - P2P_GET_HEAD);
+    }
+    p2p_fetch_reap();
+}
+
+static void p2p_on_piece(const char *peer, const unsigned char *r, size_t n) {
+    holos_p2p_hash_t hash;
+    if (n < P2P_GET_HEAD) return;
+    memcpy(&hash, r, 32);
+    for (struct holos_p2p_fetch *f = g_fetches; f; f = f->next) {
+        const size_t p = p2p_fetch_peer(f, peer);
+        if (!f->over && p < f->n_peers)
+            p2p_fetch_piece(f, p, &hash, p2p_get64(r + 32), p2p_get64(r + 40), r + P2P_GET_HEAD, n - P2P_GET_HEAD);
+    }
+    p2p_fetch_reap();
+}
+
+/* The peer has no such chunk: it cannot help the fetches that asked. */
+static void p2p_on_missing(const char *peer, const unsigned char *r, size_t n) {
+    if (n != 32) return;
+    for (struct holos_p2p_fetch *f = g_fetches; f; f = f->next) {
+        const size_t p = p2p_fetch_peer(f, peer);
+        if (f->over || p == f->n_peers) continue;
+        if (f->parsed ? p2p_object_find(&f->obj, (const holos_p2p_hash_t *)r) < f->obj.n_chunks
+                      : memcmp(r, &f->id, 32) == 0) {
+            p2p_fetch_drop(f, p);
+            p2p_fetch_schedule(f);
+        }
+    }
+    p2p_fetch_reap();
+}
+
+static void p2p_fetch_report(struct holos_p2p_fetch *f) {
+    if (!f->done) return;
+    f->calling = 1;
+    f->done(f, f->status, f->cls);
+    f->calling = 0;
+}
+
+/* Over; done runs at once unless the fetch is being set up. */
+static void p2p_fetch_finish(struct holos_p2p_fetch *f, int status) {
+    if (f->over) return;
+    f->over = 1;
+    f->status = status;
+    if (!f->starting) p2p_fetch_report(f);
+}
+
+/* Frees the fetches freed from their done, once nothing refers to them. */
+static void p2p_fetch_reap(void) {
+    struct holos_p2p_fetch *f = g_fetches;
+    while (f) {
+        struct holos_p2p_fetch *next = f->next;
+        if (f->doomed) {
+            f->doomed = 0;
+            holos_p2p_fetch_free(f);
+        }
+        f = next;
+    }
+}
+
+static int p2p_fetch_add(struct holos_p2p_fetch *f, const char *peer_id) {
+    if (!f || !peer_id || f->over) return HOLOS_P2P_ERR_GENERIC;
+    if (p2p_fetch_peer(f, peer_id) < f->n_peers) return HOLOS_P2P_OK;
+    if (f->n_peers == f->cap_peers) {
+        const size_t cap = f->cap_peers ? 2 * f->cap_peers : 4;
+        char **peers = realloc(f->peers, cap * sizeof(*peers));
+        size_t *busy;
+        if (!peers) return HOLOS_P2P_ERR_GENERIC;
+        f->peers = peers;
+        busy = realloc(f->busy, cap * sizeof(*busy));
+        if (!busy) return HOLOS_P2P_ERR_GENERIC;
+        f->busy = busy;
+        f->cap_peers = cap;
+    }
+    f->peers[f->n_peers] = strdup(peer_id);
+    if (!f->peers[f->n_peers]) return HOLOS_P2P_ERR_GENERIC;
+    f->busy[f->n_peers] = 0;
+    if (f->manifest_peer == f->n_peers) f->manifest_peer++;
+    f->n_peers++;
+    p2p_fetch_schedule(f);
+    return HOLOS_P2P_OK;
+}
+
+int holos_p2p_fetch_add_peer(struct holos_p2p_fetch *f, const char *peer_id) {
+    const int rc = p2p_fetch_add(f, peer_id);
+    p2p_fetch_reap();
+    return rc;
+}
+
+struct holos_p2p_fetch *holos_p2p_fetch(const holos_p2p_hash_t *id, const char *const *peers, size_t n_peers,
+                                        const char *dir, holos_p2p_fetch_callback done, void *cls) {
+    struct holos_p2p_fetch *f;
+    unsigned char *m;
+    size_t n;
+    if (!id || !dir || !*dir || (n_peers && !peers)) return NULL;
+    f = calloc(1, sizeof(*f));
+    if (!f || !(f->dir = strdup(dir))) {
+        free(f);
+        return NULL;
+    }
+    f->id = *id;
+    f->done = done;
+    f->cls = cls;
+    f->next = g_fetches;
+    g_fetches = f;
+    f->starting = 1;
+    if ((m = p2p_store_verified(id, &n))) {   /* Fetched before: resume */
+        unsigned char *copy = malloc(n);
+        if (copy) memcpy(copy, m, n);
+        munmap(m, n);
+        if (copy && p2p_fetch_manifest(f, copy, n) == 0 && p2p_fetch_begin(f) != 0)
+            p2p_fetch_finish(f, HOLOS_P2P_ERR_GENERIC);
+    }
+    for (size_t i = 0; i < n_peers && !f->over; i++) p2p_fetch_add(f, peers[i]);
+    p2p_fetch_schedule(f);
+    f->starting = 0;
+    if (f->over) {
+        p2p_fetch_report(f);
+        if (f->doomed) {
+            f->doomed = 0;
+            holos_p2p_fetch_free(f);
+            return NULL;
+        }
+    }
+    return f;
+}
+
+int holos_p2p_fetch_base(struct holos_p2p_fetch *f, const holos_p2p_hash_t *base) {
+    unsigned char *m, *copy;
+    size_t n;
+    if (!f || !base || f->based || !(m = p2p_store_verified(base, &n))) return HOLOS_P2P_ERR_GENERIC;
+    copy = malloc(n);
+    if (copy) memcpy(copy, m, n);
+    munmap(m, n);
+    if (!copy || p2p_manifest_parse(copy, n, &f->base) != 0) return HOLOS_P2P_ERR_GENERIC;
+    f->based = 1;
+    return HOLOS_P2P_OK;
+}
+
+void holos_p2p_fetch_progress(const struct holos_p2p_fetch *f, uint64_t *have, uint64_t *total) {
+    if (have) *have = f ? f->have : 0;
+    if (total) *total = f ? f->total : 0;
+}
+
+void holos_p2p_fetch_free(struct holos_p2p_fetch *f) {
+    if (!f) return;
+    if (f->calling) {                   /* From done: after it returns */
+        f->doomed = 1;
+        return;
+    }
+    for (struct holos_p2p_fetch **at = &g_fetches; *at; at = &(*at)->next)
+        if (*at == f) {
+            *at = f->next;
+            break;
+        }
+    for (size_t p = 0; p < f->n_peers; p++) free(f->peers[p]);
+    for (size_t c = 0; f->wants && c < f->obj.n_chunks; c++) free(f->wants[c].buf);
+    free(f->wants);
+    p2p_object_free(&f->obj);
+    if (f->based) p2p_object_free(&f->base);
+    free(f->base_files);
+    free(f->manifest);
+    free(f->peers);
+    free(f->busy);
+    free(f->dir);
+    free(f);
+}
+
+/* ---------------- Projects and raw data ---------------- */
+
+struct p2p_project {
+    struct p2p_project *next;
+    char *id;
+    holos_p2p_hash_t object;
+    int shared, wanted;
+    struct holos_p2p_fetch *fetch;
+    holos_p2p_hash_t base;              /* Fetched last, if based */
+    int based;
+};
+
+/* Data received with holos_p2p_receive_data pending */
+struct p2p_inbox {
+    struct p2p_inbox *next;
+    char *peer;
+    char *dir;
+    struct holos_p2p_fetch *fetch;      /* NULL once over */
+    int failed;
+};
+
+static struct p2p_project *g_projects_list = NULL;
+static struct p2p_inbox *g_inbox = NULL;
+
+static int p2p_id_ok(const char *id) {
+    const size_t n = id ? strlen(id) : 0;
+    return n > 0 && n < 256 && !strchr(id, '/') && strcmp(id, ".") != 0 && strcmp(id, "..") != 0;
+}
+
+static struct p2p_project *p2p_project_get(const char *id, int create) {
+    struct p2p_project *p;
+    for (p = g_projects_list; p; p = p->next)
+        if (strcmp(p->id, id) == 0) return p;
+    if (!create || !(p = calloc(1, sizeof(*p)))) return NULL;
+    if (!(p->id = strdup(id))) {
+        free(p);
+        return NULL;
+    }
+    p->next = g_projects_list;
+    g_projects_list = p;
+    return p;
+}
+
+static int p2p_send_have(const char *peer, const holos_p2p_hash_t *object, const char *project) {
+    unsigned char head[33 + 255];
+    const size_t n = strlen(project);
+    memcpy(head, object, 32);
+    head[32] = (unsigned char)n;
+    memcpy(head + 33, project, n);
+    return p2p_link_send_record(peer, P2P_REC_CHUNK_HAVE, head, 33 + n, NULL, 0);
+}
+
+/* Tells every connected peer (best effort: a peer can still WANT it). */
+static void p2p_announce(const struct p2p_project *p) {
+    const char *ids[64];
+    const size_t n = p2p_link_peers(ids, 64);
+    for (size_t i = 0; i < n && i < 64; i++) p2p_send_have(ids[i], &p->object, p->id);
+}
+
+int holos_p2p_share_project(const struct holos_p2p_project *project) {
+    holos_p2p_hash_t id;
+    struct p2p_project *p;
+    if (!project || !p2p_id_ok(project->id) || !project->data_path) return HOLOS_P2P_ERR_GENERIC;
+    if (holos_p2p_share_path(project->data_path, &id) != HOLOS_P2P_OK) return HOLOS_P2P_ERR_GENERIC;
+    p = p2p_project_get(project->id, 1);
+    if (!p) return HOLOS_P2P_ERR_GENERIC;
+    if (p->shared && memcmp(&p->object, &id, 32) != 0) holos_p2p_unshare(&p->object);
+    p->object = id;
+    p->shared = 1;
+    p2p_announce(p);
+    return HOLOS_P2P_OK;
+}
+
+int holos_p2p_update_project(const struct holos_p2p_project *project) {
+    struct p2p_project *p = project && p2p_id_ok(project->id) ? p2p_project_get(project->id, 0) : NULL;
+    if (!p || !p->shared) return HOLOS_P2P_ERR_PROJECT_NOT_FOUND;
+    return holos_p2p_share_project(project);
+}
+
+int holos_p2p_request_project(const char *project_id) {
+    const char *ids[64];
+    unsigned char head[1 + 255];
+    struct p2p_project *p;
+    size_t n, asked = 0;
+    if (!p2p_id_ok(project_id) || !(p = p2p_project_get(project_id, 1))) return HOLOS_P2P_ERR_GENERIC;
+    p->wanted = 1;
+    head[0] = (unsigned char)strlen(project_id);
+    memcpy(head + 1, project_id, head[0]);
+    n = p2p_link_peers(ids, 64);
+    for (size_t i = 0; i < n && i < 64; i++)
+        if (p2p_link_send_record(ids[i], P2P_REC_CHUNK_WANT, head, 1 + head[0], NULL, 0) == HOLOS_P2P_OK) asked++;
+    return asked ? HOLOS_P2P_OK : HOLOS_P2P_ERR_PEER_NOT_FOUND;
+}
+
+static void p2p_on_want(const char *peer, const unsigned char *r, size_t n) {
+    char id[256];
+    const struct p2p_project *p;
+    if (n < 1 || n != 1u + r[0]) return;
+    memcpy(id, r + 1, r[0]);
+    id[r[0]] = '\0';
+    p = p2p_id_ok(id) ? p2p_project_get(id, 0) : NULL;
+    if (p && p->shared) p2p_send_have(peer, &p->object, p->id);
+}
+
+static void p2p_project_done(struct holos_p2p_fetch *fetch, int status, void *cls) {
+    struct p2p_project *p = cls;
+    p->fetch = NULL;
+    if (status == HOLOS_P2P_OK) {
+        p->base = fetch->id;
+        p->based = 1;
+    }
+    holos_p2p_fetch_free(fetch);
+    if (status != HOLOS_P2P_OK) {
+        holos_p2p_error("project fetch failed", (enum holos_p2p_error)status);
+        return;
+    }
+    p->wanted = 0;
+    p2p_link_emit("project_received", p->id);
+}
+
+static void p2p_inbox_done(struct holos_p2p_fetch *fetch, int status, void *cls) {
+    struct p2p_inbox *in = cls;
+    in->fetch = NULL;
+    holos_p2p_fetch_free(fetch);
+    if (status != HOLOS_P2P_OK) {
+        in->failed = 1;                 /* Cleared by holos_p2p_receive_data */
+        return;
+    }
+    p2p_link_emit("data_received", in->peer);
+}
+
+/* Data offered by holos_p2p_send_data: fetched into the inbox. */
+static void p2p_inbox_add(const char *peer, const holos_p2p_hash_t *object) {
+    char hex[65];
+    struct p2p_inbox *in = calloc(1, sizeof(*in)), **tail;
+    size_t n;
+    holos_p2p_hash_hex(object, hex);
+    if (!in || !(in->peer = strdup(peer)) || !(in->dir = malloc((n = strlen(g_store) + 80)))) {
+        if (in) free(in->peer);
+        free(in);
+        return;
+    }
+    snprintf(in->dir, n, "%s/inbox/%s", g_store, hex);
+    for (tail = &g_inbox; *tail; tail = &(*tail)->next) {}
+    *tail = in;
+    in->fetch = holos_p2p_fetch(object, &peer, 1, in->dir, p2p_inbox_done, in);
+}
+
+static void p2p_on_have(const char *peer, const unsigned char *r, size_t n) {
+    holos_p2p_hash_t object;
+    struct p2p_project *p;
+    char id[256];
+    if (n < 33 || n != 33u + r[32]) return;
+    memcpy(&object, r, 32);
+    memcpy(id, r + 33, r[32]);
+    id[r[32]] = '\0';
+    if (!*id) {
+        p2p_inbox_add(peer, &object);
+        return;
+    }
+    if (!p2p_id_ok(id) || !(p = p2p_project_get(id, 0)) || !p->wanted) return;
+    if (p->fetch) {
+        if (memcmp(&p->fetch->id, &object, 32) == 0) p2p_fetch_add(p->fetch, peer);
+    } else {
+        char dir[P2P_PATH + 256];
+        snprintf(dir, sizeof(dir), "%s/%s", g_projects, id);
+        p->fetch = holos_p2p_fetch(&object, &peer, 1, dir, p2p_project_done, p);
+        if (p->fetch && p->based) holos_p2p_fetch_base(p->fetch, &p->base);
+    }
+    p2p_fetch_reap();
+}
+
+int holos_p2p_send_data(const char *peer_address, const void *data, uint64_t size) {
+    struct p2p_share *s;
+    holos_p2p_hash_t id;
+    int rc;
+    if (!peer_address || (size && !data) || size > INT_MAX) return HOLOS_P2P_ERR_GENERIC;
+    s = calloc(1, sizeof(*s));
+    if (!s || !(s->blob = malloc(size ? (size_t)size : 1)) || !(s->obj.files = calloc(1, sizeof(*s->obj.files))) ||
+        !(s->obj.files[0].path = strdup("data"))) {
+        if (s) {
+            free(s->obj.files);
+            free(s->blob);
+        }
+        free(s);
+        return HOLOS_P2P_ERR_GENERIC;
+    }
+    if (size) memcpy(s->blob, data, (size_t)size);
+    s->obj.n_files = 1;
+    s->obj.files[0].size = size;
+    s->obj.files[0].map = s->blob;
+    rc = p2p_share_add(s, &id);
+    if (rc < 0) {
+        s->obj.files[0].map = NULL;
+        p2p_object_free(&s->obj);
+        free(s->blob);
+        free(s);
+        return HOLOS_P2P_ERR_GENERIC;
+    }
+    if (rc == 0 && ++g_n_blobs > P2P_BLOBS) { /* Retire the oldest */
+        struct p2p_share **at = &g_shares, **oldest = NULL;
+        for (; *at; at = &(*at)->next)
+            if ((*at)->blob) oldest = at;
+        if (oldest) {
+            struct p2p_share *old = *oldest;
+            *oldest = old->next;
+            p2p_share_free(old);
+        }
+    }
+    return p2p_send_have(peer_address, &id, "");
+}
+
+static void p2p_inbox_drop(struct p2p_inbox **at) {
+    struct p2p_inbox *in = *at;
+    char path[P2P_PATH];
+    snprintf(path, sizeof(path), "%s/data", in->dir);
+    unlink(path);
+    rmdir(in->dir);
+    *at = in->next;
+    free(in->peer);
+    free(in->dir);
+    free(in);
+}
+
+int holos_p2p_receive_data(char *peer_address, void *buffer, uint64_t size) {
+    struct p2p_inbox **at = &g_inbox;
+    while (*at) {
+        struct p2p_inbox *in = *at;
+        char path[P2P_PATH];
+        struct stat st;
+        ssize_t got = 0, r = 1;
+        int fd;
+        if (in->fetch) {
+            at = &in->next;
+            continue;
+        }
+        snprintf(path, sizeof(path), "%s/data", in->dir);
+        if (in->failed || stat(path, &st) != 0 || (fd = open(path, O_RDONLY)) < 0) {
+            p2p_inbox_drop(at);
+            continue;
+        }
+        if ((uint64_t)st.st_size > size || (st.st_size && !buffer)) {
+            close(fd);                  /* Kept for a larger buffer */
+            return HOLOS_P2P_ERR_GENERIC;
+        }
+        while (got < st.st_size && (r = pread(fd, (char *)buffer + got, (size_t)(st.st_size - got), got)) > 0)
+            got += r;
+        close(fd);
+        if (peer_address) strcpy(peer_address, in->peer);
+        p2p_inbox_drop(at);
+        return got == st.st_size ? (int)got : HOLOS_P2P_ERR_GENERIC;
+    }
+    return HOLOS_P2P_ERR_AGAIN;
+}
+
+/* ---------------- Links ---------------- */
+
+static void p2p_chunk_drain(const char *peer) {
+    p2p_serve_pump(peer);
+    for (struct holos_p2p_fetch *f = g_fetches; f; f = f->next)
+        if (p2p_fetch_peer(f, peer) < f->n_peers) p2p_fetch_schedule(f);
+    p2p_fetch_reap();
+}
+
+static void p2p_chunk_gone(const char *peer) {
+    p2p_serve_drop(p2p_serve_of_peer, peer);
+    for (struct holos_p2p_fetch *f = g_fetches; f; f = f->next) {
+        const size_t p = p2p_fetch_peer(f, peer);
+        if (p == f->n_peers || f->over) continue;
+        p2p_fetch_drop(f, p);
+        p2p_fetch_schedule(f);
+    }
+    p2p_fetch_reap();
+}
+
+/* After the links (so every fetch has ended with its peers) */
+static void p2p_chunk_finalize(void) {
+    while (g_serves) {
+        struct p2p_serve *v = g_serves;
+        g_serves = v->next;
+        p2p_serve_free(v);
+    }
+    while (g_shares) {
+        struct p2p_share *s = g_shares;
+        g_shares = s->next;
+        p2p_share_free(s);
+    }
+    while (g_projects_list) {
+        struct p2p_project *p = g_projects_list;
+        g_projects_list = p->next;
+        holos_p2p_fetch_free(p->fetch);
+        free(p->id);
+        free(p);
+    }
+    while (g_inbox) {
+        struct p2p_inbox *in = g_inbox;
+        g_inbox = in->next;
+        holos_p2p_fetch_free(in->fetch);
+        free(in->peer);
+        free(in->dir);
+        free(in);
+    }
+    g_fetches = NULL;                   /* The callers' to free */
+}
+
+void p2p_chunk_attach(void) {
+    p2p_link_handle(P2P_REC_CHUNK_GET, p2p_on_get);
+    p2p_link_handle(P2P_REC_CHUNK_PIECE, p2p_on_piece);
+    p2p_link_handle(P2P_REC_CHUNK_MISSING, p2p_on_missing);
+    p2p_link_handle(P2P_REC_CHUNK_WANT, p2p_on_want);
+    p2p_link_handle(P2P_REC_CHUNK_HAVE, p2p_on_have);
+    p2p_link_handle(P2P_REC_CHUNK_DELTA, p2p_on_delta);
+    p2p_link_handle(P2P_REC_CHUNK_DELTA_PIECE, p2p_on_delta_piece);
+    p2p_link_watch(p2p_chunk_drain, p2p_chunk_gone, p2p_chunk_finalize);
+}
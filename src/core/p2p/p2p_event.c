@@ -0,0 +1,361 @@
+/* p2p_event.c - Event dispatch threads for the P2P layer of HOLOS
+    Copyright (C) 2025  4137314 <holos@mail.com>
+
+    This file is part of HOLOS.
+
+    HOLOS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    HOLOS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+    ----------------------------------------------------------------------
+    Once holos_p2p_event_dispatch has started its threads, an event
+    raised on the network path is copied into a ring of its priority
+    and the callback runs on a dispatcher thread, so a slow callback
+    costs the network a copy and a compare-and-swap, never a wait.
+
+    Each ring is a bounded array of slots with a sequence number each
+    (Vyukov's queue): a producer claims the slot at head with a CAS on
+    head, fills it and publishes it by bumping its sequence; a consumer
+    does the same at tail. No locks, any number of producers, and the
+    dispatchers share the rings the same way. A full ring drops the new
+    event and counts it. A dispatcher with nothing to do sleeps on a
+    condition variable, which a producer signals only when one sleeps.
+
+    A dispatcher takes up to P2P_EVENT_BATCH events at a time, from the
+    highest priority first; within a batch an event of a coalescing type
+    is dropped when a later one of the same type and peer follows it, so
+    a burst of them costs one callback.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "core/p2p/p2p.h"
+#include "p2p_link.h"
+
+#define P2P_EVENT_PRIOS 3
+#define P2P_EVENT_TYPES 32
+#define P2P_EVENT_BATCH 64
+#define P2P_EVENT_THREADS 16
+#define P2P_EVENT_CAPACITY 4096         /* Default slots per ring */
+
+struct p2p_event_item {
+    holos_p2p_event_callback cb;
+    struct holos_p2p_event ev;          /* event_data owned: a string or a message */
+    const char *key;                    /* Peer the event is about, within event_data */
+    int message, coalesce;
+};
+
+struct p2p_event_slot {
+    atomic_size_t seq;
+    struct p2p_event_item item;
+};
+
+struct p2p_event_ring {
+    struct p2p_event_slot *slots;
+    size_t mask;
+    _Alignas(64) atomic_size_t head;    /* Next slot to fill */
+    _Alignas(64) atomic_size_t tail;    /* Next slot to take */
+};
+
+struct p2p_event_type {
+    char name[32];
+    enum holos_p2p_event_priority priority;
+    int coalesce;
+};
+
+static struct p2p_event_type g_types[P2P_EVENT_TYPES] = {
+    {"connect", HOLOS_P2P_EVENT_HIGH, 0},
+    {"disconnect", HOLOS_P2P_EVENT_HIGH, 0},
+    {"drain", HOLOS_P2P_EVENT_NORMAL, 1},
+};
+static size_t g_n_types = 3;
+
+static struct p2p_event_ring g_rings[P2P_EVENT_PRIOS];
+static pthread_t g_threads[P2P_EVENT_THREADS];
+static size_t g_n_threads = 0;
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_wake = PTHREAD_COND_INITIALIZER;
+static atomic_int g_sleepers = 0;
+static atomic_int g_stop = 0;
+static atomic_uint_fast64_t g_posted, g_delivered, g_coalesced, g_dropped;
+static atomic_size_t g_high_water;
+
+/* ---------------- Rings ---------------- */
+
+static int p2p_ring_init(struct p2p_event_ring *r, size_t capacity) {
+    size_t n = 2;
+    while (n < capacity) n <<= 1;
+    r->slots = malloc(n * sizeof *r->slots);
+    if (!r->slots) return -1;
+    for (size_t i = 0; i < n; i++) atomic_init(&r->slots[i].seq, i);
+    r->mask = n - 1;
+    atomic_init(&r->head, 0);
+    atomic_init(&r->tail, 0);
+    return 0;
+}
+
+static int p2p_ring_push(struct p2p_event_ring *r, const struct p2p_event_item *item) {
+    size_t pos = atomic_load_explicit(&r->head, memory_order_relaxed);
+    struct p2p_event_slot *s;
+    for (;;) {
+        intptr_t diff;
+        s = &r->slots[pos & r->mask];
+        diff = (intptr_t)atomic_load_explicit(&s->seq, memory_order_acquire) - (intptr_t)pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&r->head, &pos, pos + 1, memory_order_relaxed,
+                                                      memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            return -1;                  /* Full */
+        } else {
+            pos = atomic_load_explicit(&r->head, memory_order_relaxed);
+        }
+    }
+    s->item = *item;
+    atomic_store_explicit(&s->seq, pos + 1, memory_order_release);
+    return 0;
+}
+
+static int p2p_ring_pop(struct p2p_event_ring *r, struct p2p_event_item *item) {
+    size_t pos = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    struct p2p_event_slot *s;
+    for (;;) {
+        intptr_t diff;
+        s = &r->slots[pos & r->mask];
+        diff = (intptr_t)atomic_load_explicit(&s->seq, memory_order_acquire) - (intptr_t)(pos + 1);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&r->tail, &pos, pos + 1, memory_order_relaxed,
+                                                      memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            return -1;                  /* Empty */
+        } else {
+            pos = atomic_load_explicit(&r->tail, memory_order_relaxed);
+        }
+    }
+    *item = s->item;
+    atomic_store_explicit(&s->seq, pos + r->mask + 1, memory_order_release);
+    return 0;
+}
+
+static size_t p2p_ring_count(struct p2p_event_ring *r) {
+    const size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    const size_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    return head > tail ? head - tail : 0;
+}
+
+/* ---------------- Events ---------------- */
+
+static void p2p_item_free(struct p2p_event_item *it) {
+    if (it->message) {
+        struct holos_p2p_message *m = it->ev.event_data;
+        holos_p2p_free_message(m);
+        free(m);
+    } else {
+        free(it->ev.event_data);
+    }
+}
+
+/* Copies the event data: the message of "message", a string otherwise */
+static int p2p_item_fill(struct p2p_event_item *it, holos_p2p_event_callback cb, const struct holos_p2p_event *ev) {
+    it->cb = cb;
+    it->ev = *ev;
+    it->key = NULL;
+    it->message = ev->event_data && strcmp(ev->event_type, "message") == 0;
+    if (it->message) {
+        const struct holos_p2p_message *src = ev->event_data;
+        struct holos_p2p_message *m = calloc(1, sizeof *m);
+        if (!m) return -1;
+        m->type = src->type;
+        m->size = src->size;
+        m->timestamp = src->timestamp;
+        m->payload = malloc(src->size ? src->size : 1);
+        m->sender_id = src->sender_id ? strdup(src->sender_id) : NULL;
+        m->receiver_id = src->receiver_id ? strdup(src->receiver_id) : NULL;
+        if (!m->payload || (src->sender_id && !m->sender_id) || (src->receiver_id && !m->receiver_id)) {
+            holos_p2p_free_message(m);
+            free(m);
+            return -1;
+        }
+        if (src->size) memcpy(m->payload, src->payload, src->size);
+        it->ev.event_data = m;
+        it->key = m->sender_id;
+    } else if (ev->event_data) {
+        it->ev.event_data = strdup(ev->event_data);
+        if (!it->ev.event_data) return -1;
+        it->key = it->ev.event_data;
+    }
+    return 0;
+}
+
+static const struct p2p_event_type *p2p_type_find(const char *name) {
+    for (size_t i = 0; i < g_n_types; i++)
+        if (strcmp(g_types[i].name, name) == 0) return &g_types[i];
+    return NULL;
+}
+
+int p2p_event_post(holos_p2p_event_callback cb, const struct holos_p2p_event *ev) {
+    const struct p2p_event_type *t;
+    struct p2p_event_ring *r;
+    struct p2p_event_item it;
+    size_t depth, high;
+    if (!g_n_threads) return 0;
+    t = p2p_type_find(ev->event_type);
+    r = &g_rings[t ? t->priority : HOLOS_P2P_EVENT_NORMAL];
+    if (p2p_item_fill(&it, cb, ev) != 0) {
+        atomic_fetch_add(&g_dropped, 1);
+        return -1;
+    }
+    it.coalesce = t && t->coalesce;
+    if (p2p_ring_push(r, &it) != 0) {
+        p2p_item_free(&it);
+        atomic_fetch_add(&g_dropped, 1);
+        return -1;
+    }
+    atomic_fetch_add(&g_posted, 1);
+    depth = p2p_ring_count(r);
+    high = atomic_load_explicit(&g_high_water, memory_order_relaxed);
+    while (depth > high && !atomic_compare_exchange_weak(&g_high_water, &high, depth)) {
+    }
+    /* Pairs with the fence of a dispatcher going to sleep: either it
+       sees the event or this sees it sleeping */
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&g_sleepers, memory_order_relaxed)) {
+        pthread_mutex_lock(&g_lock);
+        pthread_cond_signal(&g_wake);
+        pthread_mutex_unlock(&g_lock);
+    }
+    return 1;
+}
+
+/* ---------------- Dispatchers ---------------- */
+
+static size_t p2p_batch_take(struct p2p_event_item *batch) {
+    size_t n = 0;
+    for (int p = P2P_EVENT_PRIOS - 1; p >= 0; p--)
+        while (n < P2P_EVENT_BATCH && p2p_ring_pop(&g_rings[p], &batch[n]) == 0) n++;
+    return n;
+}
+
+static int p2p_batch_superseded(const struct p2p_event_item *batch, size_t i, size_t n) {
+    const struct p2p_event_item *a = &batch[i];
+    if (!a->coalesce) return 0;
+    for (size_t j = i + 1; j < n; j++) {
+        const struct p2p_event_item *b = &batch[j];
+        if (b->cb == a->cb && strcmp(b->ev.event_type, a->ev.event_type) == 0 &&
+            (a->key == b->key || (a->key && b->key && strcmp(a->key, b->key) == 0)))
+            return 1;
+    }
+    return 0;
+}
+
+static void *p2p_dispatcher(void *arg) {
+    struct p2p_event_item batch[P2P_EVENT_BATCH];
+    (void)arg;
+    for (;;) {
+        const size_t n = p2p_batch_take(batch);
+        if (!n) {
+            if (atomic_load(&g_stop)) break;
+            pthread_mutex_lock(&g_lock);
+            atomic_fetch_add(&g_sleepers, 1);
+            atomic_thread_fence(memory_order_seq_cst);
+            if (!p2p_ring_count(&g_rings[0]) && !p2p_ring_count(&g_rings[1]) && !p2p_ring_count(&g_rings[2]) &&
+                !atomic_load(&g_stop))
+                pthread_cond_wait(&g_wake, &g_lock);
+            atomic_fetch_sub(&g_sleepers, 1);
+            pthread_mutex_unlock(&g_lock);
+            continue;
+        }
+        for (size_t i = 0; i < n; i++) {
+            if (p2p_batch_superseded(batch, i, n)) {
+                atomic_fetch_add(&g_coalesced, 1);
+            } else {
+                batch[i].cb(&batch[i].ev);
+                atomic_fetch_add(&g_delivered, 1);
+            }
+            p2p_item_free(&batch[i]);
+        }
+    }
+    return NULL;
+}
+
+static void p2p_dispatch_stop(void) {
+    if (!g_n_threads) return;
+    pthread_mutex_lock(&g_lock);
+    atomic_store(&g_stop, 1);
+    pthread_cond_broadcast(&g_wake);
+    pthread_mutex_unlock(&g_lock);
+    for (size_t i = 0; i < g_n_threads; i++) pthread_join(g_threads[i], NULL);
+    g_n_threads = 0;
+    for (int p = 0; p < P2P_EVENT_PRIOS; p++) {
+        free(g_rings[p].slots);
+        g_rings[p].slots = NULL;
+    }
+}
+
+int holos_p2p_event_dispatch(unsigned threads, size_t capacity) {
+    p2p_dispatch_stop();                /* Drains what was queued */
+    if (!threads) return HOLOS_P2P_OK;
+    if (threads > P2P_EVENT_THREADS) threads = P2P_EVENT_THREADS;
+    if (!capacity) capacity = P2P_EVENT_CAPACITY;
+    for (int p = 0; p < P2P_EVENT_PRIOS; p++)
+        if (p2p_ring_init(&g_rings[p], capacity) != 0) {
+            while (p--) free(g_rings[p].slots);
+            return HOLOS_P2P_ERR_GENERIC;
+        }
+    atomic_store(&g_stop, 0);
+    for (unsigned i = 0; i < threads; i++) {
+        if (pthread_create(&g_threads[i], NULL, p2p_dispatcher, NULL) != 0) break;
+        g_n_threads++;
+    }
+    if (!g_n_threads) {
+        for (int p = 0; p < P2P_EVENT_PRIOS; p++) free(g_rings[p].slots);
+        return HOLOS_P2P_ERR_GENERIC;
+    }
+    return HOLOS_P2P_OK;
+}
+
+int holos_p2p_event_priority(const char *type, enum holos_p2p_event_priority priority, int coalesce) {
+    struct p2p_event_type *t;
+    if (!type || strlen(type) >= sizeof t->name || (unsigned)priority >= P2P_EVENT_PRIOS || g_n_threads)
+        return HOLOS_P2P_ERR_GENERIC;
+    t = (struct p2p_event_type *)p2p_type_find(type);
+    if (!t) {
+        if (g_n_types == P2P_EVENT_TYPES) return HOLOS_P2P_ERR_GENERIC;
+        t = &g_types[g_n_types++];
+        strcpy(t->name, type);
+    }
+    t->priority = priority;
+    t->coalesce = coalesce != 0;
+    return HOLOS_P2P_OK;
+}
+
+void holos_p2p_event_stats(struct holos_p2p_event_stats *stats) {
+    if (!stats) return;
+    stats->posted = atomic_load(&g_posted);
+    stats->delivered = atomic_load(&g_delivered);
+    stats->coalesced = atomic_load(&g_coalesced);
+    stats->dropped = atomic_load(&g_dropped);
+    stats->pending = 0;
+    if (g_n_threads)
+        for (int p = 0; p < P2P_EVENT_PRIOS; p++) stats->pending += p2p_ring_count(&g_rings[p]);
+    stats->high_water = atomic_load(&g_high_water);
+}
+
+void p2p_event_attach(void) {
+    p2p_link_watch(NULL, NULL, p2p_dispatch_stop);
+}
@@ -0,0 +1,127 @@
+/* p2p_link.h - Record layer shared by the P2P modules of HOLOS
+    Copyright (C) 2025  4137314 <holos@mail.com>
+
+    This file is part of HOLOS.
+
+    HOLOS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    HOLOS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+    ----------------------------------------------------------------------
+    Private to src/core/p2p. The modules above pub/sub (bulk transfer,
+    scheduling, ...) speak their own record kinds over the same links:
+    they send records to a peer by ID, take the records of their kinds
+    as they are parsed, and are told when a link drains or goes away.
+    Everything runs in the thread of the GNUnet scheduler (or of
+    holos_p2p_poll offline), so no locking.
+*/
+
+#ifndef HOLOS_P2P_LINK_H
+#define HOLOS_P2P_LINK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define P2P_FRAME_MAX 32768         /* Record bytes per frame */
+#define P2P_RECORD_HEAD 8
+
+/* Record kinds */
+enum {
+    P2P_REC_PUBLISH = 1,
+    P2P_REC_SUBSCRIBE,
+    P2P_REC_UNSUBSCRIBE,
+    P2P_REC_MESSAGE,
+    P2P_REC_CHUNK_GET,              /* p2p_chunk.c */
+    P2P_REC_CHUNK_PIECE,
+    P2P_REC_CHUNK_MISSING,
+    P2P_REC_CHUNK_WANT,
+    P2P_REC_CHUNK_HAVE,
+    P2P_REC_TASK_STEAL,             /* p2p_task.c */
+    P2P_REC_TASK,
+    P2P_REC_TASK_END,
+    P2P_REC_TASK_RESULT,
+    P2P_REC_TASK_ALIVE,
+    P2P_REC_PEER_PING,              /* p2p_peers.c */
+    P2P_REC_PEER_PONG,
+    P2P_REC_CHUNK_DELTA,            /* p2p_chunk.c, delta sync */
+    P2P_REC_CHUNK_DELTA_PIECE,
+    P2P_REC_KINDS
+};
+
+/* Largest payload (head + data) of a record without a topic */
+#define P2P_RECORD_MAX (P2P_FRAME_MAX - P2P_RECORD_HEAD)
+
+typedef void (*p2p_record_fn)(const char *peer_id, const unsigned char *data, size_t size);
+typedef void (*p2p_peer_fn)(const char *peer_id);
+
+/* Take the records of kind as they arrive. Returns 0 or -1. */
+int p2p_link_handle(int kind, p2p_record_fn fn);
+
+/* Be told when a link falls below its low-water mark, when one goes
+   away (its ID is valid during the call), and at holos_p2p_finalize,
+   after the links, which also drops the watch. Any may be NULL.
+   Returns 0 or -1. */
+int p2p_link_watch(p2p_peer_fn drain, p2p_peer_fn gone, void (*finalize)(void));
+
+/* Run fn every P2P_TICK_MS or so (from holos_p2p_poll offline), until
+   holos_p2p_finalize. Returns 0 or -1. */
+#define P2P_TICK_MS 100
+int p2p_link_tick(void (*fn)(void));
+
+/* Queue a record of head then data to a peer: HOLOS_P2P_OK,
+   HOLOS_P2P_ERR_AGAIN (full: retry on drain) or
+   HOLOS_P2P_ERR_PEER_NOT_FOUND. */
+int p2p_link_send_record(const char *peer_id, int kind, const void *head, size_t nhead, const void *data, size_t size);
+
+/* IDs of the connected peers, valid until the next link change. */
+size_t p2p_link_peers(const char **ids, size_t max);
+
+/* Raise a holos_p2p_event. */
+void p2p_link_emit(const char *type, void *data);
+
+/* Modules, attached by holos_p2p_init so that their records are taken
+   from the first frame on */
+void p2p_chunk_attach(void);
+void p2p_task_attach(void);
+void p2p_peers_attach(void);
+void p2p_event_attach(void);
+
+/* Hand an event to the dispatcher threads of p2p_event.c, which copy
+   it: 1 if queued, -1 if dropped (a full ring or no memory; counted in
+   the stats), 0 if none run and the caller is to call cb itself. */
+struct holos_p2p_event;
+int p2p_event_post(void (*cb)(const struct holos_p2p_event *), const struct holos_p2p_event *ev);
+
+/* Peer table (p2p_peers.c), fed by the links: a link up or down, bytes
+   received on one, a peer known to peerinfo. The cost of a peer is the
+   estimated ms to move 64 KiB to it. */
+void p2p_peer_link(const char *id, int up);
+void p2p_peer_heard(const char *id, size_t bytes);
+void p2p_peer_known(const char *id, const char *address);
+double p2p_peer_cost(const char *id);
+
+/* Metrics (p2p_stats.c). The counters of a peer live as long as the
+   program (NULL once the slots run out; the hooks take NULL). out is 1
+   for sent, 0 for received; a round trip is timed from a stamp of
+   p2p_stats_now (µs, monotonic), 0 meaning none. */
+struct p2p_stats_peer;
+struct p2p_stats_peer *p2p_stats_peer(const char *id);
+void p2p_stats_frame(struct p2p_stats_peer *s, int out, size_t bytes);
+void p2p_stats_record(struct p2p_stats_peer *s, int out, int kind, size_t bytes);
+void p2p_stats_retry(struct p2p_stats_peer *s, int which);
+void p2p_stats_rtt(int which, uint64_t since);
+uint64_t p2p_stats_now(void);
+
+/* Queue depths of the link to a peer (p2p.c): 0, or -1 if none is up */
+int p2p_link_depth(const char *id, size_t *queued, size_t *frames_queued, size_t *frames_inflight);
+
+#endif /* HOLOS_P2P_LINK_H */
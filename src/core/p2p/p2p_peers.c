@@ -0,0 +1,397 @@
+/* p2p_peers.c - Peer table of HOLOS
+    Copyright (C) 2025  4137314 <holos@mail.com>
+
+    This file is part of HOLOS.
+
+    HOLOS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    HOLOS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+    ----------------------------------------------------------------------
+    Every peer heard of, from a link or from peerinfo, has an entry,
+    found by ID in an open-addressing hash table (linear probing, with
+    deletion by backward shift) and listed in a dense array for the
+    walks. Links keep their peer online and its last_seen current; a
+    peer offline for longer than the TTL is dropped on the next tick.
+
+    Estimates, per online peer:
+    - latency: round trip of a PING every P2P_PING_MS, smoothed by 1/8
+      as TCP smooths its RTT;
+    - bandwidth: the rate at which the peer receives from this one,
+      which it measures over one-second windows with traffic (idle
+      windows say nothing of the path) and returns in the PONG.
+    Records (network order):
+      PING  u32 sequence, u64 send time (µs, the sender's clock)
+      PONG  u32 sequence, u64 send time echoed, u64 bytes/s received
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "core/p2p/p2p.h"
+#include "core/p2p/p2p_stats.h"
+#include "p2p_link.h"
+
+#define P2P_PING_MS 2000
+#define P2P_WINDOW_MS 1000
+#define P2P_PEER_TTL 600                /* s */
+#define P2P_COST_BYTES 65536.0          /* Transfer the cost of a peer is taken on */
+#define P2P_PING_HEAD 12
+#define P2P_PONG_HEAD 20
+
+struct p2p_peer_entry {
+    struct holos_p2p_peer peer;         /* peer.id and address owned */
+    size_t dense;                       /* Index in g_dense */
+    uint64_t window, bytes;             /* Window start (ms) and bytes received in it */
+    double rate;                        /* Bytes/s received from the peer */
+    uint64_t ping_at;                   /* Last PING sent (ms) */
+    uint32_t ping_seq;
+};
+
+static struct p2p_peer_entry **g_slots = NULL;   /* Hash table, a power of two */
+static size_t g_n_slots = 0;
+static struct p2p_peer_entry **g_dense = NULL;
+static size_t g_n_peers = 0, g_cap_dense = 0;
+static unsigned g_ttl = P2P_PEER_TTL;
+
+static uint64_t p2p_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static void p2p_put32(unsigned char *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = (unsigned char)(v >> (24 - 8 * i));
+}
+
+static void p2p_put64(unsigned char *p, uint64_t v) {
+    for (int i = 0; i < 8; i++) p[i] = (unsigned char)(v >> (56 - 8 * i));
+}
+
+static uint32_t p2p_get32(const unsigned char *p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static uint64_t p2p_get64(const unsigned char *p) {
+    return (uint64_t)p2p_get32(p) << 32 | p2p_get32(p + 4);
+}
+
+/* ---------------- Table ---------------- */
+
+static size_t p2p_slot_of(const char *id) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    while (*id) h = (h ^ (unsigned char)*id++) * 0x100000001b3ULL;
+    return (size_t)(h ^ h >> 32) & (g_n_slots - 1);
+}
+
+/* Slot of id, or the empty slot where it would go. */
+static size_t p2p_slot_find(const char *id) {
+    size_t i = p2p_slot_of(id);
+    while (g_slots[i] && strcmp(g_slots[i]->peer.id, id) != 0) i = (i + 1) & (g_n_slots - 1);
+    return i;
+}
+
+static int p2p_table_grow(void) {
+    const size_t n = g_n_slots ? 2 * g_n_slots : 64;
+    struct p2p_peer_entry **old = g_slots;
+    const size_t n_old = g_n_slots;
+    g_slots = calloc(n, sizeof(*g_slots));
+    if (!g_slots) {
+        g_slots = old;
+        return -1;
+    }
+    g_n_slots = n;
+    for (size_t i = 0; i < n_old; i++)
+        if (old[i]) g_slots[p2p_slot_find(old[i]->peer.id)] = old[i];
+    free(old);
+    return 0;
+}
+
+static struct p2p_peer_entry *p2p_entry_find(const char *id) {
+    return id && g_n_slots ? g_slots[p2p_slot_find(id)] : NULL;
+}
+
+static struct p2p_peer_entry *p2p_entry_get(const char *id) {
+    struct p2p_peer_entry *e = p2p_entry_find(id);
+    if (e) return e;
+    if ((g_n_peers + 1) * 2 > g_n_slots && p2p_table_grow() != 0) return NULL;
+    if (g_n_peers == g_cap_dense) {
+        const size_t cap = g_cap_dense ? 2 * g_cap_dense : 32;
+        struct p2p_peer_entry **grown = realloc(g_dense, cap * sizeof(*grown));
+        if (!grown) return NULL;
+        g_dense = grown;
+        g_cap_dense = cap;
+    }
+    e = calloc(1, sizeof(*e));
+    if (!e || !(e->peer.id = strdup(id))) {
+        free(e);
+        return NULL;
+    }
+    e->peer.last_seen = time(NULL);
+    e->dense = g_n_peers;
+    g_dense[g_n_peers++] = e;
+    g_slots[p2p_slot_find(id)] = e;
+    return e;
+}
+
+static void p2p_entry_remove(struct p2p_peer_entry *e) {
+    size_t i = p2p_slot_find(e->peer.id), j = i;
+    g_slots[i] = NULL;
+    for (;;) {                          /* Backward shift: no tombstones */
+        size_t home;
+        j = (j + 1) & (g_n_slots - 1);
+        if (!g_slots[j]) break;
+        home = p2p_slot_of(g_slots[j]->peer.id);
+        if (((j - home) & (g_n_slots - 1)) >= ((j - i) & (g_n_slots - 1))) {
+            g_slots[i] = g_slots[j];
+            g_slots[j] = NULL;
+            i = j;
+        }
+    }
+    g_dense[e->dense] = g_dense[--g_n_peers];
+    g_dense[e->dense]->dense = e->dense;
+    free(e->peer.id);
+    free(e->peer.address);
+    free(e);
+}
+
+static int p2p_entry_expired(const struct p2p_peer_entry *e, time_t now) {
+    return !e->peer.online && now - e->peer.last_seen > (time_t)g_ttl;
+}
+
+/* ---------------- Links ---------------- */
+
+void p2p_peer_link(const char *id, int up) {
+    struct p2p_peer_entry *e = p2p_entry_get(id);
+    if (!e) return;
+    e->peer.online = up;
+    e->peer.last_seen = time(NULL);
+    if (up) {
+        e->window = p2p_now_ms();
+        e->bytes = 0;
+        e->ping_at = 0;                 /* PING on the next tick */
+    }
+}
+
+void p2p_peer_heard(const char *id, size_t bytes) {
+    struct p2p_peer_entry *e = p2p_entry_find(id);
+    if (!e) return;
+    e->peer.last_seen = time(NULL);
+    e->bytes += bytes;
+}
+
+void p2p_peer_known(const char *id, const char *address) {
+    struct p2p_peer_entry *e = p2p_entry_get(id);
+    if (!e) return;
+    e->peer.last_seen = time(NULL);
+    if (address && (!e->peer.address || strcmp(e->peer.address, address) != 0)) {
+        char *copy = strdup(address);
+        if (!copy) return;
+        free(e->peer.address);
+        e->peer.address = copy;
+    }
+}
+
+double p2p_peer_cost(const char *id) {
+    const struct p2p_peer_entry *e = p2p_entry_find(id);
+    double cost = 1000.0;               /* Not measured yet: a remote peer */
+    if (!e) return cost;
+    if (e->peer.latency_ms > 0) cost = e->peer.latency_ms;
+    if (e->peer.bandwidth > 0) cost += 1000.0 * P2P_COST_BYTES / e->peer.bandwidth;
+    return cost;
+}
+
+static void p2p_on_ping(const char *peer, const unsigned char *r, size_t n) {
+    const struct p2p_peer_entry *e = p2p_entry_find(peer);
+    unsigned char pong[P2P_PONG_HEAD];
+    if (n != P2P_PING_HEAD) return;
+    memcpy(pong, r, P2P_PING_HEAD);
+    p2p_put64(pong + P2P_PING_HEAD, e ? (uint64_t)e->rate : 0);
+    p2p_link_send_record(peer, P2P_REC_PEER_PONG, pong, sizeof(pong), NULL, 0);
+}
+
+static void p2p_on_pong(const char *peer, const unsigned char *r, size_t n) {
+    struct p2p_peer_entry *e = p2p_entry_find(peer);
+    uint64_t sent, rate;
+    double rtt;
+    if (n != P2P_PONG_HEAD || !e || p2p_get32(r) != e->ping_seq) return;
+    sent = p2p_get64(r + 4);
+    rate = p2p_get64(r + 12);
+    rtt = (double)(p2p_stats_now() - sent) / 1000.0;
+    if (rtt <= 0) rtt = 0.001;          /* Under the clock's resolution */
+    p2p_stats_rtt(HOLOS_P2P_RTT_PING, sent);
+    e->peer.latency_ms = e->peer.latency_ms > 0 ? 0.875 * e->peer.latency_ms + 0.125 * rtt : rtt;
+    if (rate) e->peer.bandwidth = (double)rate;
+}
+
+static void p2p_peers_tick(void) {
+    const uint64_t now = p2p_now_ms();
+    const time_t secs = time(NULL);
+    for (size_t i = 0; i < g_n_peers;) {
+        struct p2p_peer_entry *e = g_dense[i];
+        if (p2p_entry_expired(e, secs)) {
+            p2p_entry_remove(e);        /* The last entry moved to i */
+            continue;
+        }
+        i++;
+        if (!e->peer.online) continue;
+        if (now - e->window >= P2P_WINDOW_MS) {
+            if (e->bytes) {
+                const double sample = 1000.0 * (double)e->bytes / (double)(now - e->window);
+                e->rate = e->rate > 0 ? 0.75 * e->rate + 0.25 * sample : sample;
+            }
+            e->window = now;
+            e->bytes = 0;
+        }
+        if (!e->ping_at || now - e->ping_at >= P2P_PING_MS) {
+            unsigned char ping[P2P_PING_HEAD];
+            p2p_put32(ping, ++e->ping_seq);
+            p2p_put64(ping + 4, p2p_stats_now());
+            if (p2p_link_send_record(e->peer.id, P2P_REC_PEER_PING, ping, sizeof(ping), NULL, 0) == HOLOS_P2P_OK)
+                e->ping_at = now;
+        }
+    }
+}
+
+static void p2p_peers_finalize(void) {
+    while (g_n_peers) p2p_entry_remove(g_dense[g_n_peers - 1]);
+    free(g_slots);
+    free(g_dense);
+    g_slots = g_dense = NULL;
+    g_n_slots = g_cap_dense = 0;
+}
+
+void p2p_peers_attach(void) {
+    p2p_link_handle(P2P_REC_PEER_PING, p2p_on_ping);
+    p2p_link_handle(P2P_REC_PEER_PONG, p2p_on_pong);
+    p2p_link_watch(NULL, NULL, p2p_peers_finalize);
+    p2p_link_tick(p2p_peers_tick);
+}
+
+/* ---------------- Public API ---------------- */
+
+int holos_p2p_peer_ttl(unsigned seconds) {
+    g_ttl = seconds;
+    return HOLOS_P2P_OK;
+}
+
+const struct holos_p2p_peer *holos_p2p_peer_find(const char *peer_id) {
+    const struct p2p_peer_entry *e = p2p_entry_find(peer_id);
+    return e && !p2p_entry_expired(e, time(NULL)) ? &e->peer : NULL;
+}
+
+size_t holos_p2p_peer_list(const struct holos_p2p_peer **peers, size_t max, int online_only) {
+    const time_t now = time(NULL);
+    size_t n = 0;
+    for (size_t i = 0; i < g_n_peers; i++) {
+        const struct p2p_peer_entry *e = g_dense[i];
+        if ((online_only && !e->peer.online) || p2p_entry_expired(e, now)) continue;
+        if (peers && n < max) peers[n] = &e->peer;
+        n++;
+    }
+    return n;
+}
+
+size_t holos_p2p_peer_nearest(const char **ids, size_t max) {
+    size_t n = 0, kept = 0;
+    for (size_t i = 0; i < g_n_peers; i++) {
+        const struct p2p_peer_entry *e = g_dense[i];
+        double cost;
+        size_t at;
+        if (!e->peer.online) continue;
+        n++;
+        if (!ids || max == 0) continue;
+        /* Insertion into the max cheapest so far */
+        cost = p2p_peer_cost(e->peer.id);
+        at = kept < max ? kept++ : max;
+        while (at > 0 && p2p_peer_cost(ids[at - 1]) > cost) {
+            if (at < max) ids[at] = ids[at - 1];
+            at--;
+        }
+        if (at < max) ids[at] = e->peer.id;
+    }
+    return n;
+}
+
+static int p2p_peer_copy(const struct holos_p2p_peer *src, struct holos_p2p_peer *dst) {
+    memset(dst, 0, sizeof(*dst));
+    dst->online = src->online;
+    dst->last_seen = src->last_seen;
+    dst->latency_ms = src->latency_ms;
+    dst->bandwidth = src->bandwidth;
+    if (!(dst->id = strdup(src->id)) || (src->address && !(dst->address = strdup(src->address)))) {
+        holos_p2p_free_peer(dst);
+        return HOLOS_P2P_ERR_GENERIC;
+    }
+    return HOLOS_P2P_OK;
+}
+
+int holos_p2p_get_peer(const char *peer_id, struct holos_p2p_peer *peer) {
+    const struct holos_p2p_peer *p = holos_p2p_peer_find(peer_id);
+    if (!peer) return HOLOS_P2P_ERR_GENERIC;
+    if (!p) return HOLOS_P2P_ERR_PEER_NOT_FOUND;
+    return p2p_peer_copy(p, peer);
+}
+
+int holos_p2p_discover_peers(struct holos_p2p_peer **peers, size_t *count) {
+    const size_t n = holos_p2p_peer_list(NULL, 0, 0);
+    const struct holos_p2p_peer **view;
+    struct holos_p2p_peer *out;
+    if (!peers || !count) return HOLOS_P2P_ERR_GENERIC;
+    view = malloc((n ? n : 1) * sizeof(*view));
+    out = calloc(n ? n : 1, sizeof(*out));
+    if (!view || !out) {
+        free(view);
+        free(out);
+        return HOLOS_P2P_ERR_GENERIC;
+    }
+    holos_p2p_peer_list(view, n, 0);
+    for (size_t i = 0; i < n; i++)
+        if (p2p_peer_copy(view[i], &out[i]) != HOLOS_P2P_OK) {
+            while (i--) holos_p2p_free_peer(&out[i]);
+            free(view);
+            free(out);
+            return HOLOS_P2P_ERR_GENERIC;
+        }
+    free(view);
+    *peers = out;
+    *count = n;
+    return HOLOS_P2P_OK;
+}
+
+void holos_p2p_free_peer(struct holos_p2p_peer *peer) {
+    if (!peer) return;
+    free(peer->id);
+    free(peer->address);
+    free(peer->name);
+    free(peer->public_key);
+    peer->id = peer->address = peer->name = peer->public_key = NULL;
+}
+
+int holos_p2p_list_peers(void) {
+    const time_t now = time(NULL);
+    if (g_n_peers == 0) fprintf(stderr, "[p2p] no known peers\n");
+    for (size_t i = 0; i < g_n_peers; i++) {
+        const struct holos_p2p_peer *p = &g_dense[i]->peer;
+        if (p2p_entry_expired(g_dense[i], now)) continue;
+        fprintf(stderr, "[p2p] %s %s, seen %lds ago", p->id, p->online ? "online" : "offline",
+                (long)(now - p->last_seen));
+        if (p->latency_ms > 0) fprintf(stderr, ", rtt %.1f ms", p->latency_ms);
+        if (p->bandwidth > 0) fprintf(stderr, ", %.0f KiB/s", p->bandwidth / 1024.0);
+        if (p->address) fprintf(stderr, ", %s", p->address);
+        fputc('\n', stderr);
+    }
+    return 0;
+}
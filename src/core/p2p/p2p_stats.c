@@ -0,0 +1,399 @@
+/* p2p_stats.c - Traffic and latency metrics of the P2P layer of HOLOS
+    Copyright (C) 2025  4137314 <holos@mail.com>
+
+    This file is part of HOLOS.
+
+    HOLOS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    HOLOS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+    ----------------------------------------------------------------------
+    Metrics (see p2p_stats.h), counted from the links of p2p.c and the
+    modules. Every counter is a relaxed atomic: counting is one add,
+    and a reader in another thread sees each counter whole (a snapshot
+    of several is not taken at one instant). The peers are slots of a
+    fixed array, taken when a link to a new peer comes up and never
+    given back, published by the count of slots: a reader needs no
+    lock either, and a link keeps a pointer to its slot.
+
+    Histogram bucket of v microseconds: v itself below SUB; otherwise,
+    with e the index of the top bit of v, SUB * (e - E0 + 1) plus the
+    E0 bits below the top one, where SUB = 2^E0.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <math.h>
+#include <time.h>
+
+#include "core/p2p/p2p.h"
+#include "core/p2p/p2p_stats.h"
+#include "p2p_link.h"
+
+#define P2P_STATS_PEERS 256
+#define P2P_STATS_ID 64
+#define P2P_HIST_E0 4                   /* log2 of HOLOS_P2P_HIST_SUB */
+
+struct p2p_stats_peer {
+    char id[P2P_STATS_ID];
+    atomic_uint_fast64_t bytes[2], frames[2], records[2];  /* Received, sent */
+    atomic_uint_fast64_t refused;
+};
+
+struct p2p_stats_kind {
+    atomic_uint_fast64_t records[2], bytes[2];
+};
+
+struct p2p_stats_hist {
+    atomic_uint_fast64_t count, sum, min, max;
+    atomic_uint_fast64_t buckets[HOLOS_P2P_HIST_BUCKETS];
+};
+
+static struct p2p_stats_peer g_peers[P2P_STATS_PEERS];
+static atomic_size_t g_n_peers;
+static struct p2p_stats_kind g_kinds[HOLOS_P2P_STATS_KINDS];
+static struct p2p_stats_hist g_hists[HOLOS_P2P_RTTS];
+static atomic_uint_fast64_t g_retries[HOLOS_P2P_RETRIES];
+
+static const char *const g_kind_names[P2P_REC_KINDS] = {
+    [P2P_REC_PUBLISH] = "publish",
+    [P2P_REC_SUBSCRIBE] = "subscribe",
+    [P2P_REC_UNSUBSCRIBE] = "unsubscribe",
+    [P2P_REC_MESSAGE] = "message",
+    [P2P_REC_CHUNK_GET] = "chunk_get",
+    [P2P_REC_CHUNK_PIECE] = "chunk_piece",
+    [P2P_REC_CHUNK_MISSING] = "chunk_missing",
+    [P2P_REC_CHUNK_WANT] = "chunk_want",
+    [P2P_REC_CHUNK_HAVE] = "chunk_have",
+    [P2P_REC_TASK_STEAL] = "task_steal",
+    [P2P_REC_TASK] = "task",
+    [P2P_REC_TASK_END] = "task_end",
+    [P2P_REC_TASK_RESULT] = "task_result",
+    [P2P_REC_TASK_ALIVE] = "task_alive",
+    [P2P_REC_PEER_PING] = "peer_ping",
+    [P2P_REC_PEER_PONG] = "peer_pong",
+    [P2P_REC_CHUNK_DELTA] = "chunk_delta",
+    [P2P_REC_CHUNK_DELTA_PIECE] = "chunk_delta_piece",
+};
+
+static const char *const g_rtt_names[HOLOS_P2P_RTTS] = {"ping", "chunk", "steal", "task"};
+static const char *const g_retry_names[HOLOS_P2P_RETRIES] = {"refused", "chunk", "delta", "task"};
+
+#define P2P_ADD(counter, v) atomic_fetch_add_explicit(&(counter), (v), memory_order_relaxed)
+#define P2P_GET(counter) atomic_load_explicit(&(counter), memory_order_relaxed)
+
+/* ---------------- Counting ---------------- */
+
+uint64_t p2p_stats_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+struct p2p_stats_peer *p2p_stats_peer(const char *id) {
+    const size_t n = atomic_load_explicit(&g_n_peers, memory_order_acquire);
+    struct p2p_stats_peer *s;
+    for (size_t i = 0; i < n; i++)
+        if (strncmp(g_peers[i].id, id, P2P_STATS_ID - 1) == 0) return &g_peers[i];
+    if (n == P2P_STATS_PEERS) return NULL;
+    s = &g_peers[n];
+    strncpy(s->id, id, P2P_STATS_ID - 1);
+    atomic_store_explicit(&g_n_peers, n + 1, memory_order_release);
+    return s;
+}
+
+void p2p_stats_frame(struct p2p_stats_peer *s, int out, size_t bytes) {
+    if (!s) return;
+    P2P_ADD(s->frames[out != 0], 1);
+    P2P_ADD(s->bytes[out != 0], bytes);
+}
+
+void p2p_stats_record(struct p2p_stats_peer *s, int out, int kind, size_t bytes) {
+    if (s) P2P_ADD(s->records[out != 0], 1);
+    if (kind <= 0 || kind >= HOLOS_P2P_STATS_KINDS) return;
+    P2P_ADD(g_kinds[kind].records[out != 0], 1);
+    P2P_ADD(g_kinds[kind].bytes[out != 0], bytes);
+}
+
+void p2p_stats_retry(struct p2p_stats_peer *s, int which) {
+    if (which < 0 || which >= HOLOS_P2P_RETRIES) return;
+    P2P_ADD(g_retries[which], 1);
+    if (s && which == HOLOS_P2P_RETRY_REFUSED) P2P_ADD(s->refused, 1);
+}
+
+static size_t p2p_hist_bucket(uint64_t v) {
+    int e = 63;
+    size_t b;
+    if (v < HOLOS_P2P_HIST_SUB) return (size_t)v;
+    while (!(v >> e)) e--;
+    b = (size_t)HOLOS_P2P_HIST_SUB * (size_t)(e - P2P_HIST_E0 + 1) +
+        (size_t)((v >> (e - P2P_HIST_E0)) & (HOLOS_P2P_HIST_SUB - 1));
+    return b < HOLOS_P2P_HIST_BUCKETS ? b : HOLOS_P2P_HIST_BUCKETS - 1;
+}
+
+/* Lowest value of bucket b, and its width */
+static uint64_t p2p_hist_low(size_t b, uint64_t *width) {
+    size_t e;
+    if (b < HOLOS_P2P_HIST_SUB) {
+        *width = 1;
+        return b;
+    }
+    e = b / HOLOS_P2P_HIST_SUB + P2P_HIST_E0 - 1;
+    *width = (uint64_t)1 << (e - P2P_HIST_E0);
+    return (uint64_t)(HOLOS_P2P_HIST_SUB + b % HOLOS_P2P_HIST_SUB) << (e - P2P_HIST_E0);
+}
+
+void p2p_stats_rtt(int which, uint64_t since) {
+    struct p2p_stats_hist *h;
+    uint64_t us, seen;
+    if (which < 0 || which >= HOLOS_P2P_RTTS || !since) return;
+    h = &g_hists[which];
+    us = p2p_stats_now() - since;
+    P2P_ADD(h->buckets[p2p_hist_bucket(us)], 1);
+    P2P_ADD(h->sum, us);
+    seen = P2P_GET(h->max);
+    while (us > seen && !atomic_compare_exchange_weak(&h->max, &seen, us)) {
+    }
+    seen = P2P_GET(h->min);
+    while ((!seen || us < seen) && !atomic_compare_exchange_weak(&h->min, &seen, us ? us : 1)) {
+    }
+    P2P_ADD(h->count, 1);
+}
+
+/* ---------------- Reading ---------------- */
+
+size_t holos_p2p_stats_peers(struct holos_p2p_peer_stats *peers, size_t max) {
+    const size_t n = atomic_load_explicit(&g_n_peers, memory_order_acquire);
+    for (size_t i = 0; peers && i < n && i < max; i++) {
+        struct p2p_stats_peer *s = &g_peers[i];
+        struct holos_p2p_peer_stats *o = &peers[i];
+        const struct holos_p2p_peer *p = holos_p2p_peer_find(s->id);
+        o->id = s->id;
+        o->bytes_received = P2P_GET(s->bytes[0]);
+        o->bytes_sent = P2P_GET(s->bytes[1]);
+        o->frames_received = P2P_GET(s->frames[0]);
+        o->frames_sent = P2P_GET(s->frames[1]);
+        o->records_received = P2P_GET(s->records[0]);
+        o->records_sent = P2P_GET(s->records[1]);
+        o->refused = P2P_GET(s->refused);
+        o->linked = p2p_link_depth(s->id, &o->queued, &o->frames_queued, &o->frames_inflight) == 0;
+        if (!o->linked) o->queued = o->frames_queued = o->frames_inflight = 0;
+        o->rtt_ms = p ? p->latency_ms : 0;
+    }
+    return n;
+}
+
+size_t holos_p2p_stats_kinds(struct holos_p2p_kind_stats *kinds, size_t max) {
+    size_t n = 0;
+    for (int k = 1; k < P2P_REC_KINDS && k < HOLOS_P2P_STATS_KINDS; k++) {
+        const struct p2p_stats_kind *s = &g_kinds[k];
+        struct holos_p2p_kind_stats o;
+        o.name = g_kind_names[k] ? g_kind_names[k] : "?";
+        o.received = P2P_GET(s->records[0]);
+        o.sent = P2P_GET(s->records[1]);
+        o.bytes_received = P2P_GET(s->bytes[0]);
+        o.bytes_sent = P2P_GET(s->bytes[1]);
+        if (!o.sent && !o.received) continue;
+        if (kinds && n < max) kinds[n] = o;
+        n++;
+    }
+    return n;
+}
+
+void holos_p2p_stats_rtt(enum holos_p2p_rtt which, struct holos_p2p_histogram *hist) {
+    const struct p2p_stats_hist *h;
+    if (!hist) return;
+    memset(hist, 0, sizeof(*hist));
+    if ((unsigned)which >= HOLOS_P2P_RTTS) return;
+    h = &g_hists[which];
+    for (size_t b = 0; b < HOLOS_P2P_HIST_BUCKETS; b++) {
+        hist->buckets[b] = P2P_GET(h->buckets[b]);
+        hist->count += hist->buckets[b];  /* Agrees with the buckets */
+    }
+    hist->sum_us = P2P_GET(h->sum);
+    hist->min_us = P2P_GET(h->min);
+    hist->max_us = P2P_GET(h->max);
+}
+
+uint64_t holos_p2p_stats_retries(enum holos_p2p_retry which) {
+    return (unsigned)which < HOLOS_P2P_RETRIES ? P2P_GET(g_retries[which]) : 0;
+}
+
+double holos_p2p_histogram_quantile(const struct holos_p2p_histogram *hist, double q) {
+    uint64_t seen = 0, rank;
+    if (!hist || !hist->count) return 0;
+    if (q <= 0) return (double)hist->min_us;
+    if (q >= 1) return (double)hist->max_us;
+    rank = (uint64_t)ceil(q * (double)hist->count);    /* The rank-th smallest */
+    for (size_t b = 0; b < HOLOS_P2P_HIST_BUCKETS; b++) {
+        seen += hist->buckets[b];
+        if (seen >= rank) {
+            uint64_t width;
+            const uint64_t low = p2p_hist_low(b, &width);
+            double v = (double)low + 0.5 * (double)(width - 1);
+            if (v < (double)hist->min_us) v = (double)hist->min_us;
+            if (v > (double)hist->max_us) v = (double)hist->max_us;
+            return v;
+        }
+    }
+    return (double)hist->max_us;
+}
+
+void holos_p2p_stats_reset(void) {
+    const size_t n = atomic_load_explicit(&g_n_peers, memory_order_acquire);
+    for (size_t i = 0; i < n; i++) {
+        struct p2p_stats_peer *s = &g_peers[i];
+        for (int d = 0; d < 2; d++) {
+            atomic_store(&s->bytes[d], 0);
+            atomic_store(&s->frames[d], 0);
+            atomic_store(&s->records[d], 0);
+        }
+        atomic_store(&s->refused, 0);
+    }
+    for (int k = 0; k < HOLOS_P2P_STATS_KINDS; k++)
+        for (int d = 0; d < 2; d++) {
+            atomic_store(&g_kinds[k].records[d], 0);
+            atomic_store(&g_kinds[k].bytes[d], 0);
+        }
+    for (int r = 0; r < HOLOS_P2P_RTTS; r++) {
+        struct p2p_stats_hist *h = &g_hists[r];
+        atomic_store(&h->count, 0);
+        atomic_store(&h->sum, 0);
+        atomic_store(&h->min, 0);
+        atomic_store(&h->max, 0);
+        for (size_t b = 0; b < HOLOS_P2P_HIST_BUCKETS; b++) atomic_store(&h->buckets[b], 0);
+    }
+    for (int r = 0; r < HOLOS_P2P_RETRIES; r++) atomic_store(&g_retries[r], 0);
+}
+
+/* ---------------- Output ---------------- */
+
+static void p2p_json_string(FILE *out, const char *s) {
+    fputc('"', out);
+    for (; *s; s++) {
+        const unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') fprintf(out, "\\%c", c);
+        else if (c < 0x20) fprintf(out, "\\u%04x", c);
+        else fputc(c, out);
+    }
+    fputc('"', out);
+}
+
+static void p2p_print_hist(FILE *out, const char *name, const struct holos_p2p_histogram *h) {
+    if (!h->count) {
+        fprintf(out, "  %-6s -\n", name);
+        return;
+    }
+    fprintf(out, "  %-6s n %llu  mean %.1f  p50 %.1f  p90 %.1f  p99 %.1f  max %.1f ms\n", name,
+            (unsigned long long)h->count, (double)h->sum_us / (double)h->count / 1000.0,
+            holos_p2p_histogram_quantile(h, 0.5) / 1000.0, holos_p2p_histogram_quantile(h, 0.9) / 1000.0,
+            holos_p2p_histogram_quantile(h, 0.99) / 1000.0, (double)h->max_us / 1000.0);
+}
+
+void holos_p2p_stats_print(FILE *out) {
+    struct holos_p2p_peer_stats peers[P2P_STATS_PEERS];
+    struct holos_p2p_kind_stats kinds[HOLOS_P2P_STATS_KINDS];
+    struct holos_p2p_event_stats ev;
+    static struct holos_p2p_histogram h;
+    const size_t np = holos_p2p_stats_peers(peers, P2P_STATS_PEERS);
+    const size_t nk = holos_p2p_stats_kinds(kinds, HOLOS_P2P_STATS_KINDS);
+    if (!out) out = stdout;
+    fprintf(out, "%-20s %12s %12s %9s %9s %7s %8s\n", "peer", "bytes out", "bytes in", "recs out", "recs in",
+            "refused", "rtt ms");
+    for (size_t i = 0; i < np; i++)
+        fprintf(out, "%-20.20s %12llu %12llu %9llu %9llu %7llu %8.2f\n", peers[i].id,
+                (unsigned long long)peers[i].bytes_sent, (unsigned long long)peers[i].bytes_received,
+                (unsigned long long)peers[i].records_sent, (unsigned long long)peers[i].records_received,
+                (unsigned long long)peers[i].refused, peers[i].rtt_ms);
+    for (size_t i = 0; i < np; i++)
+        if (peers[i].linked)
+            fprintf(out, "  %s: %zu bytes queued, %zu frames waiting, %zu in flight\n", peers[i].id, peers[i].queued,
+                    peers[i].frames_queued, peers[i].frames_inflight);
+    fprintf(out, "%-20s %12s %12s %9s %9s\n", "record", "bytes out", "bytes in", "out", "in");
+    for (size_t i = 0; i < nk; i++)
+        fprintf(out, "%-20s %12llu %12llu %9llu %9llu\n", kinds[i].name, (unsigned long long)kinds[i].bytes_sent,
+                (unsigned long long)kinds[i].bytes_received, (unsigned long long)kinds[i].sent,
+                (unsigned long long)kinds[i].received);
+    fprintf(out, "round trips:\n");
+    for (int r = 0; r < HOLOS_P2P_RTTS; r++) {
+        holos_p2p_stats_rtt((enum holos_p2p_rtt)r, &h);
+        p2p_print_hist(out, g_rtt_names[r], &h);
+    }
+    fprintf(out, "retries:");
+    for (int r = 0; r < HOLOS_P2P_RETRIES; r++)
+        fprintf(out, " %s %llu", g_retry_names[r], (unsigned long long)P2P_GET(g_retries[r]));
+    holos_p2p_event_stats(&ev);
+    fprintf(out, "\nevents: %llu posted, %llu delivered, %llu coalesced, %llu dropped, %zu pending\n",
+            (unsigned long long)ev.posted, (unsigned long long)ev.delivered, (unsigned long long)ev.coalesced,
+            (unsigned long long)ev.dropped, ev.pending);
+}
+
+int holos_p2p_stats_dump(FILE *out) {
+    struct holos_p2p_peer_stats peers[P2P_STATS_PEERS];
+    struct holos_p2p_kind_stats kinds[HOLOS_P2P_STATS_KINDS];
+    struct holos_p2p_event_stats ev;
+    static struct holos_p2p_histogram h;
+    const size_t np = holos_p2p_stats_peers(peers, P2P_STATS_PEERS);
+    const size_t nk = holos_p2p_stats_kinds(kinds, HOLOS_P2P_STATS_KINDS);
+    if (!out) return HOLOS_P2P_ERR_GENERIC;
+    fprintf(out, "{\"peers\":[");
+    for (size_t i = 0; i < np; i++) {
+        const struct holos_p2p_peer_stats *p = &peers[i];
+        fprintf(out, "%s{\"id\":", i ? "," : "");
+        p2p_json_string(out, p->id);
+        fprintf(out,
+                ",\"bytes_sent\":%llu,\"bytes_received\":%llu,\"frames_sent\":%llu,\"frames_received\":%llu,"
+                "\"records_sent\":%llu,\"records_received\":%llu,\"refused\":%llu,\"linked\":%s,\"queued\":%zu,"
+                "\"frames_queued\":%zu,\"frames_inflight\":%zu,\"rtt_ms\":%.3f}",
+                (unsigned long long)p->bytes_sent, (unsigned long long)p->bytes_received,
+                (unsigned long long)p->frames_sent, (unsigned long long)p->frames_received,
+                (unsigned long long)p->records_sent, (unsigned long long)p->records_received,
+                (unsigned long long)p->refused, p->linked ? "true" : "false", p->queued, p->frames_queued,
+                p->frames_inflight, p->rtt_ms);
+    }
+    fprintf(out, "],\"records\":{");
+    for (size_t i = 0; i < nk; i++)
+        fprintf(out, "%s\"%s\":{\"sent\":%llu,\"received\":%llu,\"bytes_sent\":%llu,\"bytes_received\":%llu}",
+                i ? "," : "", kinds[i].name, (unsigned long long)kinds[i].sent, (unsigned long long)kinds[i].received,
+                (unsigned long long)kinds[i].bytes_sent, (unsigned long long)kinds[i].bytes_received);
+    fprintf(out, "},\"rtt_us\":{");
+    for (int r = 0; r < HOLOS_P2P_RTTS; r++) {
+        int first = 1;
+        holos_p2p_stats_rtt((enum holos_p2p_rtt)r, &h);
+        fprintf(out,
+                "%s\"%s\":{\"count\":%llu,\"sum\":%llu,\"min\":%llu,\"max\":%llu,\"p50\":%.1f,\"p90\":%.1f,"
+                "\"p99\":%.1f,\"buckets\":[",
+                r ? "," : "", g_rtt_names[r], (unsigned long long)h.count, (unsigned long long)h.sum_us,
+                (unsigned long long)h.min_us, (unsigned long long)h.max_us, holos_p2p_histogram_quantile(&h, 0.5),
+                holos_p2p_histogram_quantile(&h, 0.9), holos_p2p_histogram_quantile(&h, 0.99));
+        for (size_t b = 0; b < HOLOS_P2P_HIST_BUCKETS; b++) {
+            uint64_t width;
+            if (!h.buckets[b]) continue;
+            fprintf(out, "%s[%llu,%llu]", first ? "" : ",", (unsigned long long)p2p_hist_low(b, &width),
+                    (unsigned long long)h.buckets[b]);
+            first = 0;
+        }
+        fprintf(out, "]}");
+    }
+    fprintf(out, "},\"retries\":{");
+    for (int r = 0; r < HOLOS_P2P_RETRIES; r++)
+        fprintf(out, "%s\"%s\":%llu", r ? "," : "", g_retry_names[r], (unsigned long long)P2P_GET(g_retries[r]));
+    holos_p2p_event_stats(&ev);
+    fprintf(out,
+            "},\"events\":{\"posted\":%llu,\"delivered\":%llu,\"coalesced\":%llu,\"dropped\":%llu,\"pending\":%zu,"
+            "\"high_water\":%zu}}\n",
+            (unsigned long long)ev.posted, (unsigned long long)ev.delivered, (unsigned long long)ev.coalesced,
+            (unsigned long long)ev.dropped, ev.pending, ev.high_water);
+    return ferror(out) ? HOLOS_P2P_ERR_GENERIC : HOLOS_P2P_OK;
+}
@@ -0,0 +1,767 @@
+/* p2p_task.c - Work stealing across the P2P peers of HOLOS
+    Copyright (C) 2025  4137314 <holos@mail.com>
+
+    This file is part of HOLOS.
+
+    HOLOS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    HOLOS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+    ----------------------------------------------------------------------
+    Tasks (see p2p_task.h) over the links of p2p.c. A task is named by
+    its job (a random 64-bit ID drawn by the submitter) and its index.
+    A peer holding one or no task asks the nearer of two random peers
+    for work (STEAL); the victim lends half of its deque from the top,
+    one TASK record each, then END with the count (0: try elsewhere,
+    after a back-off).
+    A lent task stays on the lender's list until its RESULT comes back,
+    and a result goes back the way the task came, so a task stolen
+    twice is relayed to its submitter. The borrower sends ALIVE to
+    each peer it holds tasks of while it holds them; the lender puts the
+    tasks lent to a peer that goes away, or is silent for the timeout,
+    back at the bottom of its own deque. A late result of a task taken
+    back is still taken if the task has not run again.
+
+    Records (network order):
+      STEAL   u32 tasks wanted
+      TASK    u64 job, u32 index, u8 name length, name, input
+      END     u32 tasks lent
+      RESULT  u64 job, u32 index, i32 status, output
+      ALIVE   (empty)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "core/p2p/p2p.h"
+#include "core/p2p/p2p_stats.h"
+#include "core/p2p/p2p_task.h"
+#include "core/exec/exec.h"
+#include "p2p_link.h"
+
+#define P2P_STEAL_MAX 32                /* Tasks asked for at a time */
+#define P2P_STEAL_LOW 1                 /* Tasks held at which a peer steals */
+#define P2P_STEAL_WAIT_MS 1000          /* Unanswered STEAL given up after */
+#define P2P_BACKOFF_MAX_MS 1000         /* After empty answers, up to */
+#define P2P_ALIVE_MS 1000               /* ALIVE period */
+#define P2P_TASK_HEAD 13                /* job, index, name length */
+#define P2P_RESULT_HEAD 16
+#define P2P_RUN_MAX 64                  /* Tasks run side by side */
+
+struct p2p_task {
+    struct p2p_task *next;              /* On g_lent */
+    uint64_t job;
+    uint32_t index;
+    char *name;
+    char *from;                         /* Peer it came from, NULL if submitted here */
+    char *lent;                         /* Peer it is lent to, on g_lent */
+    uint64_t lent_at;                   /* ... since (p2p_stats_now) */
+    size_t size;
+    unsigned char input[];
+};
+
+/* Result waiting for room on the link back */
+struct p2p_result {
+    struct p2p_result *next;
+    char *peer;
+    unsigned char head[P2P_RESULT_HEAD];
+    size_t size;
+    unsigned char data[];
+};
+
+struct p2p_borrower {
+    char *id;
+    uint64_t heard;                     /* ms */
+};
+
+struct p2p_kind {
+    char *name;
+    holos_p2p_task_fn fn;
+    void *cls;
+};
+
+struct holos_p2p_job {
+    struct holos_p2p_job *next;
+    uint64_t id;
+    size_t n_tasks, completed;
+    unsigned char *done;
+    holos_p2p_result_callback cb;
+    void *cls;
+};
+
+static struct p2p_task **g_deque = NULL;  /* Ring: top is stolen, bottom is run */
+static size_t g_dq_cap = 0, g_dq_top = 0, g_dq_n = 0;
+static struct p2p_task *g_lent = NULL;
+static struct p2p_result *g_outbox = NULL;
+static struct p2p_borrower *g_borrowers = NULL;
+static size_t g_n_borrowers = 0, g_cap_borrowers = 0;
+static struct p2p_kind *g_kinds = NULL;
+static size_t g_n_kinds = 0;
+static struct holos_p2p_job *g_jobs = NULL;
+static char *g_victim = NULL;           /* Asked with STEAL, not answered */
+static uint64_t g_steal_at = 0, g_next_steal = 0, g_backoff = 0, g_alive_at = 0;
+static uint64_t g_steal_us = 0;         /* The STEAL out, for its round trip */
+static uint64_t g_timeout = 30000;
+static uint64_t g_rand = 0;
+
+/* ---------------- Helpers ---------------- */
+
+static uint64_t p2p_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static uint64_t p2p_random(void) {
+    uint64_t z;
+    if (!g_rand) g_rand = (uint64_t)time(NULL) ^ (uint64_t)getpid() << 32 ^ (uint64_t)(uintptr_t)&g_rand;
+    z = (g_rand += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static void p2p_put32(unsigned char *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = (unsigned char)(v >> (24 - 8 * i));
+}
+
+static void p2p_put64(unsigned char *p, uint64_t v) {
+    for (int i = 0; i < 8; i++) p[i] = (unsigned char)(v >> (56 - 8 * i));
+}
+
+static uint32_t p2p_get32(const unsigned char *p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static uint64_t p2p_get64(const unsigned char *p) {
+    return (uint64_t)p2p_get32(p) << 32 | p2p_get32(p + 4);
+}
+
+static int p2p_same(const char *a, const char *b) {
+    return a && b && strcmp(a, b) == 0;
+}
+
+static struct p2p_task *p2p_task_new(uint64_t job, uint32_t index, const char *name, size_t nlen, const char *from,
+                                     const void *input, size_t size) {
+    struct p2p_task *t = calloc(1, sizeof(*t) + size);
+    if (!t || !(t->name = malloc(nlen + 1)) || (from && !(t->from = strdup(from)))) {
+        if (t) free(t->name);
+        free(t);
+        return NULL;
+    }
+    memcpy(t->name, name, nlen);
+    t->name[nlen] = '\0';
+    t->job = job;
+    t->index = index;
+    t->size = size;
+    if (size) memcpy(t->input, input, size);
+    return t;
+}
+
+static void p2p_task_free(struct p2p_task *t) {
+    free(t->name);
+    free(t->from);
+    free(t->lent);
+    free(t);
+}
+
+/* ---------------- Deque ---------------- */
+
+static int p2p_dq_grow(void) {
+    const size_t cap = g_dq_cap ? 2 * g_dq_cap : 64;
+    struct p2p_task **q = malloc(cap * sizeof(*q));
+    if (!q) return -1;
+    for (size_t i = 0; i < g_dq_n; i++) q[i] = g_deque[(g_dq_top + i) % g_dq_cap];
+    free(g_deque);
+    g_deque = q;
+    g_dq_cap = cap;
+    g_dq_top = 0;
+    return 0;
+}
+
+static int p2p_dq_push_bottom(struct p2p_task *t) {
+    if (g_dq_n == g_dq_cap && p2p_dq_grow() != 0) return -1;
+    g_deque[(g_dq_top + g_dq_n++) % g_dq_cap] = t;
+    return 0;
+}
+
+/* Back on top, where it was stolen from (room is there). */
+static void p2p_dq_push_top(struct p2p_task *t) {
+    g_dq_top = (g_dq_top + g_dq_cap - 1) % g_dq_cap;
+    g_deque[g_dq_top] = t;
+    g_dq_n++;
+}
+
+static struct p2p_task *p2p_dq_pop_bottom(void) {
+    return g_dq_n ? g_deque[(g_dq_top + --g_dq_n) % g_dq_cap] : NULL;
+}
+
+static struct p2p_task *p2p_dq_pop_top(void) {
+    struct p2p_task *t;
+    if (!g_dq_n) return NULL;
+    t = g_deque[g_dq_top];
+    g_dq_top = (g_dq_top + 1) % g_dq_cap;
+    g_dq_n--;
+    return t;
+}
+
+/* Takes the tasks matching out of the deque (the others keep their
+   order) and frees them; with keep, takes only the first, returned. */
+static struct p2p_task *p2p_dq_remove(int (*match)(const struct p2p_task *, const void *), const void *arg,
+                                      int keep) {
+    struct p2p_task *found = NULL;
+    size_t kept = 0;
+    for (size_t i = 0; i < g_dq_n; i++) {
+        struct p2p_task *t = g_deque[(g_dq_top + i) % g_dq_cap];
+        if (!(keep && found) && match(t, arg)) {
+            if (keep) found = t;
+            else p2p_task_free(t);
+            continue;
+        }
+        g_deque[(g_dq_top + kept++) % g_dq_cap] = t;
+    }
+    g_dq_n = kept;
+    return found;
+}
+
+/* ---------------- Jobs and results ---------------- */
+
+struct p2p_task_key {
+    uint64_t job;
+    uint32_t index;
+};
+
+static int p2p_task_is(const struct p2p_task *t, const void *key) {
+    const struct p2p_task_key *k = key;
+    return t->job == k->job && t->index == k->index;
+}
+
+static int p2p_task_of_job(const struct p2p_task *t, const void *job) {
+    return !t->from && t->job == *(const uint64_t *)job;
+}
+
+static int p2p_task_from(const struct p2p_task *t, const void *peer) {
+    return p2p_same(t->from, peer);
+}
+
+static struct holos_p2p_job *p2p_job_find(uint64_t id) {
+    for (struct holos_p2p_job *j = g_jobs; j; j = j->next)
+        if (j->id == id) return j;
+    return NULL;
+}
+
+static void p2p_job_deliver(uint64_t id, uint32_t index, int status, const void *out, size_t size) {
+    struct holos_p2p_job *j = p2p_job_find(id);
+    if (!j || index >= j->n_tasks || j->done[index]) return;
+    j->done[index] = 1;
+    j->completed++;
+    if (j->cb) j->cb(j, index, status, out, size, j->cls);
+}
+
+static int p2p_outbox_send(struct p2p_result *r) {
+    return p2p_link_send_record(r->peer, P2P_REC_TASK_RESULT, r->head, sizeof(r->head), r->data, r->size);
+}
+
+static void p2p_result_free(struct p2p_result *r) {
+    free(r->peer);
+    free(r);
+}
+
+/* Sends the results waiting for peer (all peers if NULL), in order. */
+static void p2p_outbox_pump(const char *peer) {
+    struct p2p_result **at = &g_outbox;
+    const char *stuck[8];
+    size_t n_stuck = 0;
+    while (*at) {
+        struct p2p_result *r = *at;
+        int rc, skip = 0;
+        for (size_t i = 0; i < n_stuck; i++) skip |= p2p_same(stuck[i], r->peer);
+        if (skip || (peer && !p2p_same(peer, r->peer))) {
+            at = &r->next;
+            continue;
+        }
+        rc = p2p_outbox_send(r);
+        if (rc == HOLOS_P2P_ERR_AGAIN) {
+            if (n_stuck == 8) return;
+            stuck[n_stuck++] = r->peer;
+            at = &r->next;
+            continue;
+        }
+        *at = r->next;
+        p2p_result_free(r);
+    }
+}
+
+static void p2p_result_send(const char *peer, uint64_t job, uint32_t index, int status, const void *out,
+                            size_t size) {
+    struct p2p_result *r, **tail;
+    int blocked = 0;
+    if (size > HOLOS_P2P_TASK_OUTPUT_MAX) {
+        status = HOLOS_P2P_ERR_GENERIC;
+        size = 0;
+    }
+    r = malloc(sizeof(*r) + size);
+    if (!r || !(r->peer = strdup(peer))) {
+        free(r);
+        return;
+    }
+    r->next = NULL;
+    p2p_put64(r->head, job);
+    p2p_put32(r->head + 8, index);
+    p2p_put32(r->head + 12, (uint32_t)status);
+    r->size = size;
+    if (size) memcpy(r->data, out, size);
+    for (tail = &g_outbox; *tail; tail = &(*tail)->next) blocked |= p2p_same((*tail)->peer, peer);
+    if (!blocked && p2p_outbox_send(r) != HOLOS_P2P_ERR_AGAIN) {
+        p2p_result_free(r);             /* Sent, or to a peer gone */
+        return;
+    }
+    *tail = r;
+}
+
+/* The task ended here or came back: to its job, or the way it came. */
+static void p2p_task_done(struct p2p_task *t, int status, const void *out, size_t size) {
+    if (t->from) p2p_result_send(t->from, t->job, t->index, status, out, size);
+    else p2p_job_deliver(t->job, t->index, status, out, size);
+    p2p_task_free(t);
+}
+
+/* A task run on the holos_exec pool, ended in the caller's thread */
+struct p2p_run {
+    struct p2p_task *task;
+    void *out;
+    size_t size;
+    int status;
+};
+
+static void p2p_run_range(size_t lo, size_t hi, unsigned slot, void *cls) {
+    struct p2p_run *runs = cls;
+    (void)slot;
+    for (size_t k = lo; k < hi; k++) {
+        struct p2p_run *r = &runs[k];
+        const struct p2p_task *t = r->task;
+        r->out = NULL;
+        r->size = 0;
+        r->status = HOLOS_P2P_ERR_GENERIC;
+        for (size_t i = 0; i < g_n_kinds; i++)
+            if (strcmp(g_kinds[i].name, t->name) == 0) {
+                r->status = g_kinds[i].fn(t->input, t->size, &r->out, &r->size, g_kinds[i].cls);
+                break;
+            }
+        if (r->status != 0) r->size = 0;
+    }
+}
+
+/* Runs n tasks of the bottom of the deque side by side, then ends them */
+static void p2p_task_exec(size_t n) {
+    struct p2p_run runs[P2P_RUN_MAX];
+    for (size_t k = 0; k < n; k++) runs[k].task = p2p_dq_pop_bottom();
+    holos_exec_for(n, 1, 0, p2p_run_range, runs);
+    for (size_t k = 0; k < n; k++) {
+        p2p_task_done(runs[k].task, runs[k].status, runs[k].out, runs[k].size);
+        free(runs[k].out);
+    }
+}
+
+/* ---------------- Borrowers ---------------- */
+
+static struct p2p_borrower *p2p_borrower_find(const char *peer) {
+    for (size_t i = 0; i < g_n_borrowers; i++)
+        if (strcmp(g_borrowers[i].id, peer) == 0) return &g_borrowers[i];
+    return NULL;
+}
+
+static void p2p_borrower_touch(const char *peer, int create) {
+    struct p2p_borrower *b = p2p_borrower_find(peer);
+    if (!b && create) {
+        char *id;
+        if (g_n_borrowers == g_cap_borrowers) {
+            const size_t cap = g_cap_borrowers ? 2 * g_cap_borrowers : 8;
+            struct p2p_borrower *grown = realloc(g_borrowers, cap * sizeof(*grown));
+            if (!grown) return;
+            g_borrowers = grown;
+            g_cap_borrowers = cap;
+        }
+        if (!(id = strdup(peer))) return;
+        b = &g_borrowers[g_n_borrowers++];
+        b->id = id;
+    }
+    if (b) b->heard = p2p_now_ms();
+}
+
+/* Takes back what was lent to peer, to be run again. */
+static void p2p_borrower_lost(const char *peer) {
+    struct p2p_task **at = &g_lent;
+    struct p2p_borrower *b;
+    while (*at) {
+        struct p2p_task *t = *at;
+        if (!p2p_same(t->lent, peer)) {
+            at = &t->next;
+            continue;
+        }
+        *at = t->next;
+        t->next = NULL;
+        free(t->lent);
+        t->lent = NULL;
+        p2p_stats_retry(NULL, HOLOS_P2P_RETRY_TASK);
+        if (p2p_dq_push_bottom(t) != 0) p2p_task_done(t, HOLOS_P2P_ERR_GENERIC, NULL, 0);
+    }
+    if ((b = p2p_borrower_find(peer))) {
+        free(b->id);
+        *b = g_borrowers[--g_n_borrowers];
+    }
+}
+
+/* ---------------- Records ---------------- */
+
+static void p2p_on_steal(const char *peer, const unsigned char *r, size_t n) {
+    unsigned char end[4];
+    uint32_t want, lent = 0;
+    if (n != 4) return;
+    want = p2p_get32(r);
+    if (want > P2P_STEAL_MAX) want = P2P_STEAL_MAX;
+    if (want > g_dq_n / 2) want = (uint32_t)(g_dq_n / 2);   /* Half, from the top */
+    while (lent < want) {
+        struct p2p_task *t = p2p_dq_pop_top();
+        unsigned char head[P2P_TASK_HEAD + 255];
+        const size_t nlen = strlen(t->name);
+        p2p_put64(head, t->job);
+        p2p_put32(head + 8, t->index);
+        head[12] = (unsigned char)nlen;
+        memcpy(head + P2P_TASK_HEAD, t->name, nlen);
+        if (!(t->lent = strdup(peer)) ||
+            p2p_link_send_record(peer, P2P_REC_TASK, head, P2P_TASK_HEAD + nlen, t->input, t->size) != HOLOS_P2P_OK) {
+            free(t->lent);
+            t->lent = NULL;
+            p2p_dq_push_top(t);
+            break;
+        }
+        t->lent_at = p2p_stats_now();
+        t->next = g_lent;
+        g_lent = t;
+        lent++;
+    }
+    if (lent) p2p_borrower_touch(peer, 1);
+    p2p_put32(end, lent);
+    p2p_link_send_record(peer, P2P_REC_TASK_END, end, 4, NULL, 0);
+}
+
+static void p2p_on_task(const char *peer, const unsigned char *r, size_t n) {
+    struct p2p_task *t;
+    if (n < P2P_TASK_HEAD || n - P2P_TASK_HEAD < r[12]) return;
+    t = p2p_task_new(p2p_get64(r), p2p_get32(r + 8), (const char *)r + P2P_TASK_HEAD, r[12], peer,
+                     r + P2P_TASK_HEAD + r[12], n - P2P_TASK_HEAD - r[12]);
+    if (!t) {
+        p2p_result_send(peer, p2p_get64(r), p2p_get32(r + 8), HOLOS_P2P_ERR_GENERIC, NULL, 0);
+        return;
+    }
+    if (p2p_dq_push_bottom(t) != 0) p2p_task_done(t, HOLOS_P2P_ERR_GENERIC, NULL, 0);
+}
+
+static void p2p_on_end(const char *peer, const unsigned char *r, size_t n) {
+    if (n != 4 || !p2p_same(g_victim, peer)) return;
+    p2p_stats_rtt(HOLOS_P2P_RTT_STEAL, g_steal_us);
+    free(g_victim);
+    g_victim = NULL;
+    if (p2p_get32(r)) {
+        g_backoff = 0;
+    } else {
+        g_backoff = g_backoff ? 2 * g_backoff : 10;
+        if (g_backoff > P2P_BACKOFF_MAX_MS) g_backoff = P2P_BACKOFF_MAX_MS;
+        g_next_steal = p2p_now_ms() + g_backoff;
+    }
+}
+
+static void p2p_on_result(const char *peer, const unsigned char *r, size_t n) {
+    struct p2p_task_key key;
+    struct p2p_task *t = NULL;
+    if (n < P2P_RESULT_HEAD) return;
+    key.job = p2p_get64(r);
+    key.index = p2p_get32(r + 8);
+    for (struct p2p_task **at = &g_lent; *at; at = &(*at)->next)
+        if (p2p_task_is(*at, &key) && p2p_same((*at)->lent, peer)) {
+            t = *at;
+            *at = t->next;
+            break;
+        }
+    if (t) {
+        p2p_borrower_touch(peer, 0);
+        p2p_stats_rtt(HOLOS_P2P_RTT_TASK, t->lent_at);
+    } else {
+        t = p2p_dq_remove(p2p_task_is, &key, 1);    /* Taken back, not run yet */
+    }
+    if (t) p2p_task_done(t, (int)(int32_t)p2p_get32(r + 12), r + P2P_RESULT_HEAD, n - P2P_RESULT_HEAD);
+}
+
+static void p2p_on_alive(const char *peer, const unsigned char *r, size_t n) {
+    (void)r;
+    (void)n;
+    p2p_borrower_touch(peer, 0);
+}
+
+/* ---------------- Links ---------------- */
+
+static void p2p_task_drain(const char *peer) {
+    p2p_outbox_pump(peer);
+}
+
+/* Tasks lent to the peer run again here; tasks held for it are dropped,
+   its own side takes them back. */
+static void p2p_task_gone(const char *peer) {
+    struct p2p_result **at = &g_outbox;
+    p2p_borrower_lost(peer);
+    p2p_dq_remove(p2p_task_from, peer, 0);
+    for (struct p2p_task **l = &g_lent; *l;) {
+        struct p2p_task *t = *l;
+        if (p2p_same(t->from, peer)) {
+            *l = t->next;
+            p2p_task_free(t);
+        } else {
+            l = &t->next;
+        }
+    }
+    while (*at) {
+        struct p2p_result *r = *at;
+        if (p2p_same(r->peer, peer)) {
+            *at = r->next;
+            p2p_result_free(r);
+        } else {
+            at = &r->next;
+        }
+    }
+    if (p2p_same(g_victim, peer)) {
+        free(g_victim);
+        g_victim = NULL;
+    }
+}
+
+static void p2p_task_finalize(void) {
+    struct p2p_task *t;
+    while ((t = p2p_dq_pop_bottom())) p2p_task_free(t);
+    free(g_deque);
+    g_deque = NULL;
+    g_dq_cap = g_dq_top = 0;
+    while (g_lent) {
+        t = g_lent;
+        g_lent = t->next;
+        p2p_task_free(t);
+    }
+    while (g_outbox) {
+        struct p2p_result *r = g_outbox;
+        g_outbox = r->next;
+        p2p_result_free(r);
+    }
+    for (size_t i = 0; i < g_n_borrowers; i++) free(g_borrowers[i].id);
+    free(g_borrowers);
+    g_borrowers = NULL;
+    g_n_borrowers = g_cap_borrowers = 0;
+    free(g_victim);
+    g_victim = NULL;
+    g_backoff = g_next_steal = 0;
+}
+
+void p2p_task_attach(void) {
+    p2p_link_handle(P2P_REC_TASK_STEAL, p2p_on_steal);
+    p2p_link_handle(P2P_REC_TASK, p2p_on_task);
+    p2p_link_handle(P2P_REC_TASK_END, p2p_on_end);
+    p2p_link_handle(P2P_REC_TASK_RESULT, p2p_on_result);
+    p2p_link_handle(P2P_REC_TASK_ALIVE, p2p_on_alive);
+    p2p_link_watch(p2p_task_drain, p2p_task_gone, p2p_task_finalize);
+}
+
+/* ---------------- Public API ---------------- */
+
+int holos_p2p_task_register(const char *name, holos_p2p_task_fn fn, void *cls) {
+    struct p2p_kind *grown;
+    if (!name || !*name || strlen(name) > 255 || !fn) return HOLOS_P2P_ERR_GENERIC;
+    for (size_t i = 0; i < g_n_kinds; i++)
+        if (strcmp(g_kinds[i].name, name) == 0) {
+            g_kinds[i].fn = fn;
+            g_kinds[i].cls = cls;
+            return HOLOS_P2P_OK;
+        }
+    grown = realloc(g_kinds, (g_n_kinds + 1) * sizeof(*grown));
+    if (!grown) return HOLOS_P2P_ERR_GENERIC;
+    g_kinds = grown;
+    if (!(g_kinds[g_n_kinds].name = strdup(name))) return HOLOS_P2P_ERR_GENERIC;
+    g_kinds[g_n_kinds].fn = fn;
+    g_kinds[g_n_kinds++].cls = cls;
+    return HOLOS_P2P_OK;
+}
+
+int holos_p2p_task_timeout(unsigned ms) {
+    if (ms < 2 * P2P_ALIVE_MS) return HOLOS_P2P_ERR_GENERIC;
+    g_timeout = ms;
+    return HOLOS_P2P_OK;
+}
+
+struct holos_p2p_job *holos_p2p_job_submit(const char *name, const void *const *inputs, const size_t *sizes,
+                                           size_t n_tasks, holos_p2p_result_callback cb, void *cls) {
+    struct holos_p2p_job *j;
+    const size_t nlen = name ? strlen(name) : 0;
+    if (nlen == 0 || nlen > 255 || n_tasks > UINT32_MAX || (n_tasks && (!inputs || !sizes))) return NULL;
+    for (size_t i = 0; i < n_tasks; i++)
+        if (sizes[i] > HOLOS_P2P_TASK_INPUT_MAX || (sizes[i] && !inputs[i])) return NULL;
+    j = calloc(1, sizeof(*j));
+    if (!j || !(j->done = calloc(n_tasks ? n_tasks : 1, 1))) {
+        free(j);
+        return NULL;
+    }
+    do j->id = p2p_random();
+    while (p2p_job_find(j->id));
+    j->n_tasks = n_tasks;
+    j->cb = cb;
+    j->cls = cls;
+    for (size_t i = 0; i < n_tasks; i++) {
+        struct p2p_task *t = p2p_task_new(j->id, (uint32_t)i, name, nlen, NULL, inputs[i], sizes[i]);
+        if (!t || p2p_dq_push_bottom(t) != 0) {
+            if (t) p2p_task_free(t);
+            p2p_dq_remove(p2p_task_of_job, &j->id, 0);
+            free(j->done);
+            free(j);
+            return NULL;
+        }
+    }
+    j->next = g_jobs;
+    g_jobs = j;
+    return j;
+}
+
+struct holos_p2p_job *holos_p2p_job_sweep(const char *name, const double *points, size_t n_points, size_t dim,
+                                          holos_p2p_result_callback cb, void *cls) {
+    struct holos_p2p_job *j;
+    unsigned char *buf;
+    const void **inputs;
+    size_t *sizes;
+    if ((n_points && (!points || !dim)) || dim > HOLOS_P2P_TASK_INPUT_MAX / 8) return NULL;
+    buf = malloc(n_points * dim * 8 + 1);
+    inputs = malloc((n_points + 1) * sizeof(*inputs));
+    sizes = malloc((n_points + 1) * sizeof(*sizes));
+    if (!buf || !inputs || !sizes) {
+        free(buf);
+        free(inputs);
+        free(sizes);
+        return NULL;
+    }
+    for (size_t i = 0; i < n_points * dim; i++) {
+        uint64_t bits;
+        memcpy(&bits, &points[i], 8);
+        p2p_put64(buf + 8 * i, bits);
+    }
+    for (size_t i = 0; i < n_points; i++) {
+        inputs[i] = buf + 8 * dim * i;
+        sizes[i] = 8 * dim;
+    }
+    j = holos_p2p_job_submit(name, inputs, sizes, n_points, cb, cls);
+    free(buf);
+    free(inputs);
+    free(sizes);
+    return j;
+}
+
+int holos_p2p_sweep_point(const void *input, size_t size, double *point, size_t dim) {
+    if (!input || !point || size != 8 * dim) return HOLOS_P2P_ERR_GENERIC;
+    for (size_t i = 0; i < dim; i++) {
+        const uint64_t bits = p2p_get64((const unsigned char *)input + 8 * i);
+        memcpy(&point[i], &bits, 8);
+    }
+    return HOLOS_P2P_OK;
+}
+
+size_t holos_p2p_job_pending(const struct holos_p2p_job *job) {
+    return job ? job->n_tasks - job->completed : 0;
+}
+
+void holos_p2p_job_free(struct holos_p2p_job *job) {
+    if (!job) return;
+    for (struct holos_p2p_job **at = &g_jobs; *at; at = &(*at)->next)
+        if (*at == job) {
+            *at = job->next;
+            break;
+        }
+    p2p_dq_remove(p2p_task_of_job, &job->id, 0);
+    for (struct p2p_task **at = &g_lent; *at;) {
+        struct p2p_task *t = *at;
+        if (p2p_task_of_job(t, &job->id)) {     /* Its result will find nothing */
+            *at = t->next;
+            p2p_task_free(t);
+        } else {
+            at = &t->next;
+        }
+    }
+    free(job->done);
+    free(job);
+}
+
+static void p2p_alive_to(const char *peer, const char **sent, size_t *n_sent) {
+    if (!peer || *n_sent == 64) return;
+    for (size_t k = 0; k < *n_sent; k++)
+        if (strcmp(sent[k], peer) == 0) return;
+    sent[(*n_sent)++] = peer;
+    p2p_link_send_record(peer, P2P_REC_TASK_ALIVE, NULL, 0, NULL, 0);
+}
+
+/* ALIVE to every peer this one holds tasks of (waiting, lent on or
+   with their result waiting). */
+static void p2p_send_alive(void) {
+    const char *sent[64];
+    size_t n_sent = 0;
+    for (size_t i = 0; i < g_dq_n; i++) p2p_alive_to(g_deque[(g_dq_top + i) % g_dq_cap]->from, sent, &n_sent);
+    for (const struct p2p_task *t = g_lent; t; t = t->next) p2p_alive_to(t->from, sent, &n_sent);
+    for (const struct p2p_result *r = g_outbox; r; r = r->next) p2p_alive_to(r->peer, sent, &n_sent);
+}
+
+int holos_p2p_task_run(size_t max) {
+    const uint64_t now = p2p_now_ms();
+    size_t ran = 0;
+    p2p_outbox_pump(NULL);
+    if (now - g_alive_at >= P2P_ALIVE_MS) {
+        g_alive_at = now;
+        p2p_send_alive();
+    }
+    for (size_t i = 0; i < g_n_borrowers;)
+        if (now - g_borrowers[i].heard > g_timeout) p2p_borrower_lost(g_borrowers[i].id);
+        else i++;
+    if (g_dq_n <= P2P_STEAL_LOW && (!g_victim || now - g_steal_at > P2P_STEAL_WAIT_MS) && now >= g_next_steal) {
+        const char *ids[64];
+        const size_t n = p2p_link_peers(ids, 64);
+        if (n) {
+            /* Of two random peers, the nearer one (p2p_peers.c) */
+            const size_t m = n < 64 ? n : 64;
+            const char *victim = ids[p2p_random() % m];
+            const char *other = ids[p2p_random() % m];
+            if (p2p_peer_cost(other) < p2p_peer_cost(victim)) victim = other;
+            unsigned char want[4];
+            p2p_put32(want, P2P_STEAL_MAX);
+            free(g_victim);
+            g_victim = NULL;
+            if (p2p_link_send_record(victim, P2P_REC_TASK_STEAL, want, 4, NULL, 0) == HOLOS_P2P_OK) {
+                g_victim = strdup(victim);
+                g_steal_at = now;
+                g_steal_us = p2p_stats_now();
+            }
+        }
+    }
+    while (ran < max && g_dq_n) {
+        size_t n = holos_exec_threads();
+        if (n > P2P_RUN_MAX) n = P2P_RUN_MAX;
+        if (n > max - ran) n = max - ran;
+        if (n > g_dq_n) n = g_dq_n;
+        p2p_task_exec(n);
+        ran += n;
+    }
+    return (int)ran;
+}
@@ -0,0 +1,127 @@
+/* alias_table.c - Walker alias sampling for HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+   ----------------------------------------------------------------------
+   Vose's construction keeps the columns below and above the mean in two
+   work lists and pairs them off, so every column ends up with at most one
+   alias. Columns left over at the end are exactly at the mean up to
+   rounding and keep probability 1.
+*/
+
+#include <stdlib.h>
+#include <math.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "core/phys/alias_table.h"
+#include "core/phys/philox.h"
+
+#define ALIAS_TABLE_CHUNK 2048      /* Draws per parallel work item */
+
+alias_table *alias_table_alloc(const double *w, size_t n) {
+    if (!w || n == 0 || n > UINT32_MAX) return NULL;
+    double total = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        if (!(w[i] >= 0.0) || isinf(w[i])) return NULL;
+        total += w[i];
+    }
+    if (!(total > 0.0) || isinf(total)) return NULL;
+
+    alias_table *t = calloc(1, sizeof *t);
+    double *q = malloc(n * sizeof *q);
+    uint32_t *small = malloc(n * sizeof *small), *large = malloc(n * sizeof *large);
+    if (t) {
+        t->prob = malloc(n * sizeof *t->prob);
+        t->alias = malloc(n * sizeof *t->alias);
+    }
+    if (!t || !q || !small || !large || !t->prob || !t->alias) {
+        alias_table_free(t);
+        free(q);
+        free(small);
+        free(large);
+        return NULL;
+    }
+    t->n = n;
+    t->total = total;
+
+    size_t ns = 0, nl = 0;
+    const double scale = (double)n / total;
+    for (size_t i = 0; i < n; i++) {
+        q[i] = w[i] * scale;
+        if (q[i] < 1.0) small[ns++] = (uint32_t)i;
+        else large[nl++] = (uint32_t)i;
+    }
+    while (ns && nl) {
+        const uint32_t s = small[--ns], l = large[nl - 1];
+        t->prob[s] = q[s];
+        t->alias[s] = l;
+        q[l] -= 1.0 - q[s];
+        if (q[l] < 1.0) {
+            nl--;
+            small[ns++] = l;
+        }
+    }
+    while (nl) {
+        const uint32_t l = large[--nl];
+        t->prob[l] = 1.0;
+        t->alias[l] = l;
+    }
+    while (ns) {
+        const uint32_t s = small[--ns];
+        t->prob[s] = 1.0;
+        t->alias[s] = s;
+    }
+    free(q);
+    free(small);
+    free(large);
+    return t;
+}
+
+void alias_table_free(alias_table *t) {
+    if (!t) return;
+    free(t->prob);
+    free(t->alias);
+    free(t);
+}
+
+int alias_table_sample(const alias_table *t, uint64_t seed, uint64_t stream, uint64_t first, size_t count,
+                       size_t *out, double *frac, int n_threads) {
+    if (!t || (count && !out)) return -1;
+    if (n_threads < 0) {
+#ifdef _OPENMP
+        n_threads = omp_get_max_threads();
+#else
+        n_threads = 1;
+#endif
+    }
+    const int nt = n_threads > 0 ? n_threads : 1;
+    const size_t n_chunks = (count + ALIAS_TABLE_CHUNK - 1) / ALIAS_TABLE_CHUNK;
+
+    #pragma omp parallel for schedule(static) num_threads(nt) if(nt > 1 && n_chunks > 1)
+    for (size_t c = 0; c < n_chunks; c++) {
+        double u0[ALIAS_TABLE_CHUNK], u1[ALIAS_TABLE_CHUNK];
+        const size_t k0 = c * ALIAS_TABLE_CHUNK;
+        const size_t len = count - k0 < ALIAS_TABLE_CHUNK ? count - k0 : ALIAS_TABLE_CHUNK;
+        philox_uniform2_n(seed, stream, first + k0, len, u0, u1);
+        for (size_t k = 0; k < len; k++) out[k0 + k] = alias_table_pick(t, u0[k]);
+        if (frac)
+            for (size_t k = 0; k < len; k++) frac[k0 + k] = u1[k];
+    }
+    return 0;
+}
@@ -0,0 +1,657 @@
+/* checkpoint.c - Asynchronous checkpoint and restart for HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+   ----------------------------------------------------------------------
+   A staging buffer goes FREE -> FILLING (the run gathers into it, no
+   lock held) -> READY -> WRITING (the writer's) -> FREE; the changes
+   are made under the store lock. Checkpoints are written in the order
+   they were taken.
+
+   Writing checkpoint n: ckpt-<n>.dat is written and fsynced, then the
+   manifest is written as ckpt-<n>.manifest.tmp, fsynced, renamed to
+   ckpt-<n>.manifest and the directory fsynced. A crash leaves at worst
+   a data file without a manifest, or an older manifest, and both are
+   skipped on restart. Then the checkpoints n - keep and older go.
+
+   Data file: "HOLOSCKP", u32 version, u32 0, u64 n, then the sections.
+   Manifest, one field per line:
+     HOLOSCKP <version>
+     seq <n>
+     t <time, %a>
+     step <step>
+     data <file name> <bytes>
+     section <name> <offset> <bytes> <checksum, hex>   (one per section)
+     end
+   The checksum is FNV-1a over 64-bit words, with a shift folding the
+   high bits down after each multiply.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "core/phys/checkpoint.h"
+
+#define CKPT_MAGIC "HOLOSCKP"
+#define CKPT_VERSION 1u
+#define CKPT_HEADER 24              /* Magic, version, 0, seq */
+#define CKPT_KEEP 2                 /* Default checkpoints kept */
+
+enum { CKPT_SIZE, CKPT_PACK, CKPT_UNPACK };
+enum { CKPT_FREE, CKPT_FILLING, CKPT_READY, CKPT_WRITING };
+
+struct ckpt_cursor {
+    int mode;
+    unsigned char *at;
+    size_t bytes;                   /* Sized so far, or room left */
+    int error;
+};
+
+typedef struct {
+    char name[64];
+    void *data;                     /* Plain memory of size bytes, or */
+    size_t size;
+    void *state;                    /* the state walk walks */
+    ckpt_walk_fn walk;
+} ckpt_section;
+
+typedef struct {
+    unsigned char *data;            /* CKPT_HEADER bytes, then the sections */
+    size_t size, cap;
+    size_t n_sections;
+    size_t offset[CKPT_MAX_SECTIONS], length[CKPT_MAX_SECTIONS];
+    uint64_t seq, step;
+    double t;
+    int state;
+} ckpt_buffer;
+
+typedef struct {
+    char *dir;
+    size_t keep;
+    int skip;
+    ckpt_section sections[CKPT_MAX_SECTIONS];
+    size_t n_sections;
+    ckpt_buffer buf[2];
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t work, space;
+    int stop, error;
+    uint64_t seq, seq_written;
+    size_t n_written, n_skipped, bytes;
+} ckpt_work;
+
+/* -------------------------------
+   Cursor
+   ------------------------------- */
+
+void ckpt_io(ckpt_cursor *c, void *field, size_t bytes) {
+    if (c->error || bytes == 0) return;
+    if (c->mode == CKPT_SIZE) {
+        c->bytes += bytes;
+        return;
+    }
+    if (bytes > c->bytes) {
+        c->error = 1;
+        return;
+    }
+    if (c->mode == CKPT_PACK) memcpy(c->at, field, bytes);
+    else memcpy(field, c->at, bytes);
+    c->at += bytes;
+    c->bytes -= bytes;
+}
+
+int ckpt_restoring(const ckpt_cursor *c) {
+    return c->mode == CKPT_UNPACK;
+}
+
+/* Bytes of section k as the state is now; (size_t)-1 if its walk fails. */
+static size_t ckpt_section_size(const ckpt_section *sec) {
+    ckpt_cursor c = {CKPT_SIZE, NULL, 0, 0};
+    if (!sec->walk) return sec->size;
+    if (sec->walk(sec->state, &c) != 0 || c.error) return (size_t)-1;
+    return c.bytes;
+}
+
+/* Copies the section out to (CKPT_PACK) or back from (CKPT_UNPACK) at,
+   exactly bytes of it. */
+static int ckpt_section_move(const ckpt_section *sec, int mode, unsigned char *at, size_t bytes) {
+    ckpt_cursor c = {mode, at, bytes, 0};
+    if (!sec->walk) {
+        if (mode == CKPT_PACK) memcpy(at, sec->data, bytes);
+        else memcpy(sec->data, at, bytes);
+        return 0;
+    }
+    if (sec->walk(sec->state, &c) != 0 || c.error || c.bytes) return -1;
+    return 0;
+}
+
+static uint64_t ckpt_sum(const unsigned char *p, size_t n) {
+    uint64_t h = 0xcbf29ce484222325u;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t x;
+        memcpy(&x, p + i, sizeof x);
+        h = (h ^ x) * 0x100000001b3u;
+        h ^= h >> 32;
+    }
+    for (; i < n; i++) h = (h ^ p[i]) * 0x100000001b3u;
+    return h;
+}
+
+/* -------------------------------
+   Files
+   ------------------------------- */
+
+/* dir/ckpt-<seq><suffix>, malloc'd */
+static char *ckpt_path(const char *dir, uint64_t seq, const char *suffix) {
+    const size_t len = strlen(dir) + strlen(suffix) + 32;
+    char *path = malloc(len);
+    if (path) snprintf(path, len, "%s/ckpt-%016llu%s", dir, (unsigned long long)seq, suffix);
+    return path;
+}
+
+static int ckpt_fsync_dir(const char *dir) {
+    const int fd = open(dir, O_RDONLY);
+    int rc;
+    if (fd < 0) return -1;
+    rc = fsync(fd);
+    close(fd);
+    return rc;
+}
+
+static int ckpt_write_file(const char *path, const unsigned char *data, size_t size) {
+    const int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    int ok;
+    if (fd < 0) return -1;
+    while (size) {
+        const ssize_t n = write(fd, data, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        data += n;
+        size -= (size_t)n;
+    }
+    ok = size == 0 && fsync(fd) == 0;
+    ok = close(fd) == 0 && ok;
+    if (!ok) unlink(path);
+    return ok ? 0 : -1;
+}
+
+/* Number of the checkpoint file name, with its suffix; 0 if not one */
+static uint64_t ckpt_file_seq(const char *name, const char *suffix) {
+    char *end;
+    unsigned long long seq;
+    if (strncmp(name, "ckpt-", 5) != 0 || name[5] < '0' || name[5] > '9') return 0;
+    seq = strtoull(name + 5, &end, 10);
+    return strcmp(end, suffix) == 0 ? (uint64_t)seq : 0;
+}
+
+/* The numbers of the manifests in dir, newest first; their count into n */
+static uint64_t *ckpt_list(const char *dir, size_t *n) {
+    DIR *d = opendir(dir);
+    struct dirent *e;
+    uint64_t *seqs = NULL;
+    size_t cap = 0;
+    *n = 0;
+    if (!d) return NULL;
+    while ((e = readdir(d))) {
+        const uint64_t seq = ckpt_file_seq(e->d_name, ".manifest");
+        if (!seq) continue;
+        if (*n == cap) {
+            uint64_t *grown = realloc(seqs, (cap = cap ? 2 * cap : 16) * sizeof(*seqs));
+            if (!grown) break;
+            seqs = grown;
+        }
+        seqs[(*n)++] = seq;
+    }
+    closedir(d);
+    for (size_t i = 1; i < *n; i++)
+        for (size_t j = i; j > 0 && seqs[j - 1] < seqs[j]; j--) {
+            const uint64_t tmp = seqs[j];
+            seqs[j] = seqs[j - 1];
+            seqs[j - 1] = tmp;
+        }
+    return seqs;
+}
+
+/* Removes the checkpoints numbered up to last, manifest first */
+static void ckpt_prune(const char *dir, uint64_t last) {
+    static const char *const suffixes[] = {".manifest", ".manifest.tmp", ".dat"};
+    DIR *d = opendir(dir);
+    struct dirent *e;
+    size_t n = 0, cap = 0;
+    uint64_t *old = NULL;
+    if (!d) return;
+    while ((e = readdir(d))) {
+        const uint64_t seq = ckpt_file_seq(e->d_name, ".dat");
+        if (!seq || seq > last) continue;
+        if (n == cap) {
+            uint64_t *grown = realloc(old, (cap = cap ? 2 * cap : 16) * sizeof(*old));
+            if (!grown) break;
+            old = grown;
+        }
+        old[n++] = seq;
+    }
+    closedir(d);
+    for (size_t i = 0; i < n; i++)
+        for (size_t k = 0; k < sizeof(suffixes) / sizeof(suffixes[0]); k++) {
+            char *path = ckpt_path(dir, old[i], suffixes[k]);
+            if (path) unlink(path);
+            free(path);
+        }
+    free(old);
+}
+
+static int ckpt_write_manifest(const ckpt_work *w, const ckpt_buffer *b) {
+    char *tmp = ckpt_path(w->dir, b->seq, ".manifest.tmp");
+    char *path = ckpt_path(w->dir, b->seq, ".manifest");
+    FILE *fp = tmp ? fopen(tmp, "w") : NULL;
+    int ok = fp != NULL;
+    if (ok) {
+        fprintf(fp, "%s %u\nseq %llu\nt %a\nstep %llu\ndata ckpt-%016llu.dat %zu\n", CKPT_MAGIC, CKPT_VERSION,
+                (unsigned long long)b->seq, b->t, (unsigned long long)b->step, (unsigned long long)b->seq,
+                b->size);
+        for (size_t k = 0; k < b->n_sections; k++)
+            fprintf(fp, "section %s %zu %zu %016llx\n", w->sections[k].name, b->offset[k], b->length[k],
+                    (unsigned long long)ckpt_sum(b->data + b->offset[k], b->length[k]));
+        fprintf(fp, "end\n");
+        ok = fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+        ok = fclose(fp) == 0 && ok;
+    }
+    ok = ok && path && rename(tmp, path) == 0 && ckpt_fsync_dir(w->dir) == 0;
+    if (!ok && tmp) unlink(tmp);
+    free(tmp);
+    free(path);
+    return ok ? 0 : -1;
+}
+
+static int ckpt_write(const ckpt_work *w, const ckpt_buffer *b) {
+    char *path = ckpt_path(w->dir, b->seq, ".dat");
+    int rc = path ? ckpt_write_file(path, b->data, b->size) : -1;
+    if (rc == 0 && (rc = ckpt_write_manifest(w, b)) != 0) unlink(path);
+    free(path);
+    if (rc == 0 && b->seq > w->keep) ckpt_prune(w->dir, b->seq - w->keep);
+    return rc;
+}
+
+/* -------------------------------
+   Writer thread
+   ------------------------------- */
+
+static ckpt_buffer *ckpt_next_ready(ckpt_work *w) {
+    ckpt_buffer *b = NULL;
+    for (int i = 0; i < 2; i++)
+        if (w->buf[i].state == CKPT_READY && (!b || w->buf[i].seq < b->seq)) b = &w->buf[i];
+    return b;
+}
+
+static void *ckpt_writer(void *arg) {
+    ckpt_work *w = arg;
+    pthread_mutex_lock(&w->lock);
+    for (;;) {
+        ckpt_buffer *b;
+        int rc;
+        while (!(b = ckpt_next_ready(w)) && !w->stop) pthread_cond_wait(&w->work, &w->lock);
+        if (!b) break;
+        b->state = CKPT_WRITING;
+        pthread_mutex_unlock(&w->lock);
+        rc = ckpt_write(w, b);
+        pthread_mutex_lock(&w->lock);
+        if (rc == 0) {
+            w->seq_written = b->seq;
+            w->n_written++;
+            w->bytes += b->size;
+        } else {
+            w->error = 1;
+        }
+        b->state = CKPT_FREE;
+        pthread_cond_broadcast(&w->space);
+    }
+    pthread_mutex_unlock(&w->lock);
+    return NULL;
+}
+
+/* Copies the writer's counters into s; under the lock. */
+static void ckpt_publish(ckpt_store *s, const ckpt_work *w) {
+    s->n_sections = w->n_sections;
+    s->seq = w->seq;
+    s->seq_written = w->seq_written;
+    s->n_written = w->n_written;
+    s->n_skipped = w->n_skipped;
+    s->bytes = w->bytes;
+}
+
+/* -------------------------------
+   Store
+   ------------------------------- */
+
+ckpt_store *ckpt_open(const char *dir, const ckpt_params *prm) {
+    ckpt_store *s;
+    ckpt_work *w;
+    uint64_t *seqs;
+    struct stat st;
+    size_t n;
+    if (!dir || (mkdir(dir, 0777) != 0 && errno != EEXIST)) return NULL;
+    if (stat(dir, &st) != 0 || !S_ISDIR(st.st_mode)) return NULL;
+    s = calloc(1, sizeof(*s));
+    w = calloc(1, sizeof(*w));
+    if (!s || !w || !(w->dir = strdup(dir))) goto fail;
+    w->keep = prm && prm->keep ? prm->keep : CKPT_KEEP;
+    w->skip = prm ? prm->skip : 0;
+    seqs = ckpt_list(dir, &n);
+    w->seq = w->seq_written = n ? seqs[0] : 0;
+    free(seqs);
+    if (pthread_mutex_init(&w->lock, NULL) != 0) goto fail;
+    if (pthread_cond_init(&w->work, NULL) != 0 || pthread_cond_init(&w->space, NULL) != 0
+        || pthread_create(&w->thread, NULL, ckpt_writer, w) != 0) {
+        pthread_mutex_destroy(&w->lock);
+        goto fail;
+    }
+    s->work = w;
+    ckpt_publish(s, w);
+    return s;
+fail:
+    if (w) free(w->dir);
+    free(w);
+    free(s);
+    return NULL;
+}
+
+int ckpt_wait(ckpt_store *s) {
+    ckpt_work *w;
+    int rc;
+    if (!s) return -1;
+    w = s->work;
+    pthread_mutex_lock(&w->lock);
+    while (w->buf[0].state != CKPT_FREE || w->buf[1].state != CKPT_FREE) pthread_cond_wait(&w->space, &w->lock);
+    rc = w->error ? -1 : 0;
+    ckpt_publish(s, w);
+    pthread_mutex_unlock(&w->lock);
+    return rc;
+}
+
+int ckpt_close(ckpt_store *s) {
+    ckpt_work *w;
+    int rc;
+    if (!s) return -1;
+    w = s->work;
+    rc = ckpt_wait(s);
+    pthread_mutex_lock(&w->lock);
+    w->stop = 1;
+    pthread_cond_signal(&w->work);
+    pthread_mutex_unlock(&w->lock);
+    pthread_join(w->thread, NULL);
+    pthread_cond_destroy(&w->work);
+    pthread_cond_destroy(&w->space);
+    pthread_mutex_destroy(&w->lock);
+    free(w->buf[0].data);
+    free(w->buf[1].data);
+    free(w->dir);
+    free(w);
+    free(s);
+    return rc;
+}
+
+static int ckpt_add_section(ckpt_store *s, const char *name, const ckpt_section *sec) {
+    ckpt_work *w;
+    size_t len;
+    if (!s || !name || !(len = strlen(name)) || len >= sizeof(sec->name)) return -1;
+    for (size_t i = 0; i < len; i++)
+        if (name[i] <= ' ' || name[i] > '~') return -1;
+    w = s->work;
+    pthread_mutex_lock(&w->lock);
+    for (size_t k = 0; k < w->n_sections; k++)
+        if (strcmp(w->sections[k].name, name) == 0) len = 0;
+    if (!len || w->n_sections == CKPT_MAX_SECTIONS) {
+        pthread_mutex_unlock(&w->lock);
+        return -1;
+    }
+    w->sections[w->n_sections] = *sec;
+    memcpy(w->sections[w->n_sections].name, name, strlen(name) + 1);
+    w->n_sections++;
+    ckpt_publish(s, w);
+    pthread_mutex_unlock(&w->lock);
+    return 0;
+}
+
+int ckpt_add(ckpt_store *s, const char *name, void *data, size_t size) {
+    const ckpt_section sec = {"", data, size, NULL, NULL};
+    if (!data && size) return -1;
+    return ckpt_add_section(s, name, &sec);
+}
+
+int ckpt_add_state(ckpt_store *s, const char *name, void *state, ckpt_walk_fn walk) {
+    const ckpt_section sec = {"", NULL, 0, state, walk};
+    if (!walk) return -1;
+    return ckpt_add_section(s, name, &sec);
+}
+
+static double ckpt_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + 1e-9 * (double)ts.tv_nsec;
+}
+
+/* Gathers the sections into b, which the caller holds FILLING */
+static int ckpt_gather(ckpt_work *w, ckpt_buffer *b) {
+    size_t size = CKPT_HEADER;
+    b->n_sections = w->n_sections;
+    for (size_t k = 0; k < b->n_sections; k++) {
+        const size_t len = ckpt_section_size(&w->sections[k]);
+        if (len == (size_t)-1) return -1;
+        b->offset[k] = size;
+        b->length[k] = len;
+        size += (len + 7) & ~(size_t)7;
+    }
+    if (size > b->cap) {
+        unsigned char *grown = realloc(b->data, size);
+        if (!grown) return -1;
+        b->data = grown;
+        b->cap = size;
+    }
+    b->size = size;
+    memset(b->data, 0, CKPT_HEADER);
+    memcpy(b->data, CKPT_MAGIC, 8);
+    {
+        const uint32_t version = CKPT_VERSION;
+        memcpy(b->data + 8, &version, sizeof version);
+    }
+    for (size_t k = 0; k < b->n_sections; k++) {
+        const size_t pad = ((b->length[k] + 7) & ~(size_t)7) - b->length[k];
+        if (ckpt_section_move(&w->sections[k], CKPT_PACK, b->data + b->offset[k], b->length[k]) != 0) return -1;
+        memset(b->data + b->offset[k] + b->length[k], 0, pad);
+    }
+    return 0;
+}
+
+int ckpt_snapshot(ckpt_store *s, double t, uint64_t step) {
+    const double start = ckpt_now();
+    ckpt_work *w;
+    ckpt_buffer *b = NULL;
+    int rc;
+    if (!s) return -1;
+    w = s->work;
+    pthread_mutex_lock(&w->lock);
+    while (!w->error && w->buf[0].state != CKPT_FREE && w->buf[1].state != CKPT_FREE && !w->skip)
+        pthread_cond_wait(&w->space, &w->lock);
+    if (!w->error) {
+        for (int i = 0; i < 2 && !b; i++)
+            if (w->buf[i].state == CKPT_FREE) b = &w->buf[i];
+        if (!b) w->n_skipped++;
+        else b->state = CKPT_FILLING;
+    }
+    rc = w->error ? -1 : b ? 0 : 1;
+    ckpt_publish(s, w);
+    pthread_mutex_unlock(&w->lock);
+    if (b) {
+        const int filled = ckpt_gather(w, b);
+        pthread_mutex_lock(&w->lock);
+        if (filled == 0) {
+            b->seq = ++w->seq;
+            b->t = t;
+            b->step = step;
+            memcpy(b->data + 16, &b->seq, sizeof b->seq);
+            b->state = CKPT_READY;
+            pthread_cond_signal(&w->work);
+        } else {
+            b->state = CKPT_FREE;
+            rc = -1;
+        }
+        ckpt_publish(s, w);
+        pthread_mutex_unlock(&w->lock);
+    }
+    s->stall += ckpt_now() - start;
+    return rc;
+}
+
+/* -------------------------------
+   Restart
+   ------------------------------- */
+
+typedef struct {
+    char name[64];
+    size_t offset, length;
+    unsigned long long sum;
+} ckpt_entry;
+
+/* Reads the manifest of checkpoint seq; its sections into *entries. */
+static int ckpt_read_manifest(const char *dir, uint64_t seq, double *t, uint64_t *step, size_t *data_size,
+                              ckpt_entry **entries, size_t *n) {
+    char *path = ckpt_path(dir, seq, ".manifest");
+    FILE *fp = path ? fopen(path, "r") : NULL;
+    char line[256], word[16], name[64], data[64], expect[64];
+    unsigned long long v;
+    unsigned version;
+    size_t cap = 0;
+    int ok, end = 0;
+    *entries = NULL;
+    *n = 0;
+    free(path);
+    if (!fp) return -1;
+    snprintf(expect, sizeof(expect), "ckpt-%016llu.dat", (unsigned long long)seq);
+    ok = fgets(line, sizeof(line), fp) && sscanf(line, CKPT_MAGIC " %u", &version) == 1 && version == CKPT_VERSION;
+    ok = ok && fgets(line, sizeof(line), fp) && sscanf(line, "seq %llu", &v) == 1 && v == seq;
+    ok = ok && fgets(line, sizeof(line), fp) && sscanf(line, "t %63s", data) == 1;
+    if (ok) *t = strtod(data, NULL);
+    ok = ok && fgets(line, sizeof(line), fp) && sscanf(line, "step %llu", &v) == 1;
+    if (ok) *step = v;
+    ok = ok && fgets(line, sizeof(line), fp) && sscanf(line, "data %63s %zu", data, data_size) == 2
+         && strcmp(data, expect) == 0;
+    while (ok && !end && fgets(line, sizeof(line), fp)) {
+        ckpt_entry e;
+        if (strcmp(line, "end\n") == 0) {
+            end = 1;
+        } else if (sscanf(line, "%15s %63s %zu %zu %llx", word, name, &e.offset, &e.length, &e.sum) == 5
+                   && strcmp(word, "section") == 0 && e.offset <= *data_size && e.length <= *data_size - e.offset) {
+            if (*n == cap) {
+                ckpt_entry *grown = realloc(*entries, (cap = cap ? 2 * cap : 16) * sizeof(e));
+                if (!grown) ok = 0;
+                else *entries = grown;
+            }
+            if (ok) {
+                memcpy(e.name, name, sizeof(name));
+                (*entries)[(*n)++] = e;
+            }
+        } else {
+            ok = 0;
+        }
+    }
+    fclose(fp);
+    if (ok && end) return 0;
+    free(*entries);
+    *entries = NULL;
+    return -1;
+}
+
+/* The data of checkpoint seq, size bytes with the right header, or NULL */
+static unsigned char *ckpt_read_data(const char *dir, uint64_t seq, size_t size) {
+    char *path = ckpt_path(dir, seq, ".dat");
+    FILE *fp = path ? fopen(path, "rb") : NULL;
+    unsigned char *data = NULL;
+    uint32_t version;
+    uint64_t at_seq;
+    free(path);
+    if (!fp) return NULL;
+    if (size >= CKPT_HEADER && (data = malloc(size)) && fread(data, 1, size, fp) == size && fgetc(fp) == EOF) {
+        memcpy(&version, data + 8, sizeof version);
+        memcpy(&at_seq, data + 16, sizeof at_seq);
+        if (memcmp(data, CKPT_MAGIC, 8) == 0 && version == CKPT_VERSION && at_seq == seq) {
+            fclose(fp);
+            return data;
+        }
+    }
+    free(data);
+    fclose(fp);
+    return NULL;
+}
+
+/* Restores checkpoint seq if it is whole and has every section, with
+   the size it has now; nothing is changed otherwise. */
+static int ckpt_load(ckpt_work *w, uint64_t seq, double *t, uint64_t *step) {
+    ckpt_entry *entries;
+    const ckpt_entry *match[CKPT_MAX_SECTIONS];
+    unsigned char *data = NULL;
+    size_t n, size;
+    int rc = -1;
+    if (ckpt_read_manifest(w->dir, seq, t, step, &size, &entries, &n) != 0) return -1;
+    for (size_t k = 0; k < w->n_sections; k++) {
+        match[k] = NULL;
+        for (size_t i = 0; i < n && !match[k]; i++)
+            if (strcmp(entries[i].name, w->sections[k].name) == 0) match[k] = &entries[i];
+        if (!match[k] || match[k]->length != ckpt_section_size(&w->sections[k])) goto done;
+    }
+    if (!(data = ckpt_read_data(w->dir, seq, size))) goto done;
+    for (size_t i = 0; i < n; i++)
+        if (ckpt_sum(data + entries[i].offset, entries[i].length) != entries[i].sum) goto done;
+    rc = 0;
+    for (size_t k = 0; k < w->n_sections; k++)
+        if (ckpt_section_move(&w->sections[k], CKPT_UNPACK, data + match[k]->offset, match[k]->length) != 0) rc = -1;
+done:
+    free(data);
+    free(entries);
+    return rc;
+}
+
+int ckpt_restore(ckpt_store *s, uint64_t *seq, double *t, uint64_t *step) {
+    ckpt_work *w;
+    uint64_t *seqs, at_step;
+    double at_t;
+    size_t n;
+    int rc = -1;
+    if (!s) return -1;
+    ckpt_wait(s);
+    w = s->work;
+    seqs = ckpt_list(w->dir, &n);
+    for (size_t i = 0; i < n && rc != 0; i++) {
+        if (ckpt_load(w, seqs[i], &at_t, &at_step) != 0) continue;
+        if (seq) *seq = seqs[i];
+        if (t) *t = at_t;
+        if (step) *step = at_step;
+        rc = 0;
+    }
+    free(seqs);
+    return rc;
+}
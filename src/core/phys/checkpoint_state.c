@@ -0,0 +1,180 @@
+/* checkpoint_state.c - Checkpoint walkers of the HOLOS steppers
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+   ----------------------------------------------------------------------
+   Each walker visits what a step of its stepper changes, in a fixed
+   order, so that the same walk sizes, saves and restores the state.
+   Counts (particles, points) are saved first and must match on
+   restore; caches built from the state (neighbor lists, trees,
+   stencils) are not saved and are rebuilt by the next step, and
+   forces are recomputed.
+*/
+
+#include <stdint.h>
+#include <gsl/gsl_vector.h>
+
+#include "core/phys/checkpoint.h"
+#include "core/phys/mech/classical/dynamics.h"
+#include "core/phys/mech/classical/dynamics_gpu.h"
+#include "core/phys/em/lorentz_forces.h"
+#include "core/phys/em/maxwell.h"
+#include "core/phys/em/wave_equations.h"
+#include "core/phys/ss/band_structure.h"
+#include "core/phys/nuclear/nuclear_decay.h"
+
+static void ckpt_io_vector(ckpt_cursor *c, gsl_vector *v) {
+    if (!v) return;
+    if (v->stride == 1) {
+        ckpt_io(c, v->data, v->size * sizeof(double));
+        return;
+    }
+    for (size_t i = 0; i < v->size; i++) ckpt_io(c, gsl_vector_ptr(v, i), sizeof(double));
+}
+
+/* The count saved is n; -1 if a restore brings another */
+static int ckpt_io_count(ckpt_cursor *c, size_t n) {
+    uint64_t count = n;
+    ckpt_io(c, &count, sizeof count);
+    return count == n ? 0 : -1;
+}
+
+int ckpt_walk_dyn_system(void *state, ckpt_cursor *c) {
+    dyn_system_t *sys = state;
+    if (!sys || ckpt_io_count(c, sys->N) != 0) return -1;
+    if (!ckpt_restoring(c) && dyn_system_sync_host(sys) != 0) return -1;
+    ckpt_io(c, &sys->t, sizeof sys->t);
+    ckpt_io(c, &sys->dt_last, sizeof sys->dt_last);
+    ckpt_io(c, &sys->step_count, sizeof sys->step_count);
+    for (size_t i = 0; i < sys->N; i++) {
+        gsl_vector_view pos = dyn_system_particle_vector(sys, DYN_FIELD_POS, i);
+        gsl_vector_view vel = dyn_system_particle_vector(sys, DYN_FIELD_VEL, i);
+        ckpt_io(c, &sys->particles[i].mass, sizeof(double));
+        ckpt_io_vector(c, &pos.vector);
+        ckpt_io_vector(c, &vel.vector);
+    }
+    if (sys->blocks && sys->blocks->n == sys->N) {
+        dyn_block_t *b = sys->blocks;
+        ckpt_io(c, b->level, b->n);
+        ckpt_io(c, b->acc_prev, 3 * b->n * sizeof(double));
+        ckpt_io(c, b->t_prev, b->n * sizeof(double));
+    }
+    if (ckpt_restoring(c)) {
+        sys->forces_valid = 0;
+        dyn_system_sync_masses(sys);
+        dyn_system_invalidate_gpu(sys);
+    }
+    return 0;
+}
+
+int ckpt_walk_lorentz_system(void *state, ckpt_cursor *c) {
+    lorentz_system *sys = state;
+    if (!sys || ckpt_io_count(c, sys->n) != 0) return -1;
+    ckpt_io(c, &sys->t, sizeof sys->t);
+    ckpt_io(c, &sys->step_count, sizeof sys->step_count);
+    for (size_t i = 0; i < sys->n; i++) {
+        lorentz_particle *p = &sys->particles[i];
+        ckpt_io_vector(c, p->pos);
+        ckpt_io_vector(c, p->vel);
+        ckpt_io_vector(c, p->acc);
+        ckpt_io(c, &p->gamma, sizeof p->gamma);
+        ckpt_io(c, &p->energy, sizeof p->energy);
+    }
+    return 0;
+}
+
+int ckpt_walk_maxwell_grid(void *state, ckpt_cursor *c) {
+    maxwell_field_grid *grid = state;
+    if (!grid || ckpt_io_count(c, grid->n) != 0) return -1;
+    ckpt_io(c, &grid->t, sizeof grid->t);
+    if (grid->yee) {
+        maxwell_yee_grid *g = grid->yee;
+        ckpt_io(c, g->E, 3 * g->n * sizeof(double));
+        ckpt_io(c, g->H, 3 * g->n * sizeof(double));
+        ckpt_io(c, g->J, 3 * g->n * sizeof(double));
+        return 0;
+    }
+    for (size_t i = 0; i < grid->n; i++) {
+        maxwell_field_point *p = &grid->pts[i];
+        ckpt_io_vector(c, p->E);
+        ckpt_io_vector(c, p->B);
+        ckpt_io_vector(c, p->D);
+        ckpt_io_vector(c, p->H);
+        ckpt_io_vector(c, p->J);
+        ckpt_io(c, &p->rho, sizeof p->rho);
+        ckpt_io(c, &p->t, sizeof p->t);
+    }
+    return 0;
+}
+
+int ckpt_walk_wave_grid(void *state, ckpt_cursor *c) {
+    wave_field_grid *grid = state;
+    if (!grid || ckpt_io_count(c, grid->n) != 0) return -1;
+    ckpt_io(c, &grid->t, sizeof grid->t);
+    for (size_t i = 0; i < grid->n; i++) {
+        wave_field_point *p = &grid->pts[i];
+        ckpt_io(c, &p->u, sizeof p->u);
+        ckpt_io_vector(c, p->U);
+        ckpt_io(c, &p->t, sizeof p->t);
+    }
+    return 0;
+}
+
+int ckpt_walk_wave_engine(void *state, ckpt_cursor *c) {
+    wave_engine *e = state;
+    if (!e || ckpt_io_count(c, e->n) != 0) return -1;
+    ckpt_io(c, &e->level, sizeof e->level);     /* First: it places the levels */
+    ckpt_io(c, &e->t, sizeof e->t);
+    ckpt_io(c, wave_engine_u_prev(e), e->n * sizeof(double));
+    ckpt_io(c, wave_engine_u(e), e->n * sizeof(double));
+    return 0;
+}
+
+int ckpt_walk_bs_system(void *state, ckpt_cursor *c) {
+    bs_system_t *system = state;
+    bs_hamiltonian_t *ham;
+    if (!system) return -1;
+    ham = system->hamiltonian;
+    if (!ham || !ham->density) return ckpt_io_count(c, 0);
+    if (ckpt_io_count(c, ham->n_density) != 0) return -1;
+    ckpt_io(c, ham->density, ham->n_density * sizeof(double));
+    ckpt_io(c, &ham->n_scf_iterations, sizeof ham->n_scf_iterations);
+    ckpt_io(c, &ham->scf_residual, sizeof ham->scf_residual);
+    return 0;
+}
+
+int ckpt_walk_nd_system(void *state, ckpt_cursor *c) {
+    nd_system_t *system = state;
+    nd_diagnostics_t *d;
+    if (!system || ckpt_io_count(c, system->n_nuclei) != 0) return -1;
+    for (size_t i = 0; i < system->n_nuclei; i++) {
+        nd_nucleus_t *nu = system->nuclei[i];
+        if (!nu) continue;
+        ckpt_io(c, &nu->energy, sizeof nu->energy);
+        ckpt_io(c, &nu->temperature, sizeof nu->temperature);
+        ckpt_io_vector(c, nu->momentum);
+        ckpt_io_vector(c, nu->position);
+    }
+    if (system->abundances) ckpt_io(c, system->abundances, system->n_nuclei * sizeof(double));
+    d = &system->diagnostics;
+    ckpt_io(c, &d->total_activity, sizeof d->total_activity);
+    ckpt_io(c, &d->total_energy, sizeof d->total_energy);
+    if (d->branch_activities) ckpt_io(c, d->branch_activities, d->n_branches * sizeof(double));
+    if (d->time_history) ckpt_io(c, d->time_history, d->n_time * sizeof(double));
+    if (d->energy_spectrum) ckpt_io(c, d->energy_spectrum, d->n_spectrum * sizeof(double));
+    return 0;
+}
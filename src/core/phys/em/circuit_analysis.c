@@ -0,0 +1,1295 @@
+/* circuit_analysis.c - Circuit analysis and simulation for HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include <gsl/gsl_vector.h>
+#include <gsl/gsl_matrix.h>
+#include <gsl/gsl_matrix_complex.h>
+
+#include "core/phys/em/circuit_analysis.h"
+#include "core/phys/philox.h"
+#include "core/exec/exec.h"
+#include "core/trace/trace.h"
+
+#define CIRCUIT_NONE      SIZE_MAX
+#define CIRCUIT_VT        0.025852    /* Thermal voltage at 300 K [V] */
+#define CIRCUIT_GMIN      1e-12       /* Conductance across every junction [S] */
+#define CIRCUIT_DIODE_IS  1e-14       /* Default saturation current [A] */
+#define CIRCUIT_MAX_NEWTON 100
+#define CIRCUIT_RELTOL    1e-6
+#define CIRCUIT_VNTOL     1e-9        /* Absolute tolerance on unknowns [V or A] */
+
+/* -------------------------------
+   Netlists
+   ------------------------------- */
+
+static void circuit_element_clear(circuit_element *e) {
+    free(e->model);
+    free(e->label);
+}
+
+circuit_netlist *circuit_netlist_alloc(size_t n_elements, size_t n_nodes) {
+    circuit_netlist *net = calloc(1, sizeof(*net));
+    if (!net) return NULL;
+    net->elements = n_elements ? calloc(n_elements, sizeof(circuit_element)) : NULL;
+    if (n_elements && !net->elements) {
+        free(net);
+        return NULL;
+    }
+    net->n_elements = n_elements;
+    net->n_nodes = n_nodes;
+    return net;
+}
+
+void circuit_netlist_free(circuit_netlist *net) {
+    if (!net) return;
+    for (size_t i = 0; i < net->n_elements; i++) circuit_element_clear(&net->elements[i]);
+    free(net->elements);
+    for (size_t i = 0; i < net->n_probes; i++) {
+        free(net->probes[i].type);
+        free(net->probes[i].label);
+    }
+    free(net->probes);
+    for (size_t i = 0; i < net->n_subcircuits; i++) {
+        free(net->subcircuits[i].name);
+        circuit_netlist_free(net->subcircuits[i].netlist);
+        free(net->subcircuits[i].external_nodes);
+    }
+    free(net->subcircuits);
+    free(net->title);
+    free(net->error_msg);
+    free(net);
+}
+
+/* strdup that maps NULL to NULL; *ok is cleared on allocation failure. */
+static char *circuit_strdup(const char *s, int *ok) {
+    if (!s) return NULL;
+    char *d = strdup(s);
+    if (!d) *ok = 0;
+    return d;
+}
+
+/* Elements, probes and subcircuits are deep copies; parameters and
+   userdata pointers are shared. */
+circuit_netlist *circuit_netlist_clone(const circuit_netlist *src) {
+    if (!src) return NULL;
+    circuit_netlist *net = circuit_netlist_alloc(0, src->n_nodes);
+    if (!net) return NULL;
+    int ok = 1;
+    net->title = circuit_strdup(src->title, &ok);
+    net->error_msg = circuit_strdup(src->error_msg, &ok);
+    net->userdata = src->userdata;
+    net->has_parameters = src->has_parameters;
+    net->parameters = src->parameters;
+    net->error_code = src->error_code;
+    for (size_t i = 0; ok && i < src->n_elements; i++)
+        if (circuit_netlist_add_element(net, &src->elements[i]) < 0) ok = 0;
+
+    if (ok && src->n_probes) {
+        net->probes = calloc(src->n_probes, sizeof(circuit_probe));
+        if (!net->probes) ok = 0;
+        for (size_t i = 0; ok && i < src->n_probes; i++, net->n_probes++) {
+            net->probes[i] = src->probes[i];
+            net->probes[i].type = circuit_strdup(src->probes[i].type, &ok);
+            net->probes[i].label = circuit_strdup(src->probes[i].label, &ok);
+        }
+        net->has_probes = src->has_probes;
+    }
+    if (ok && src->n_subcircuits) {
+        net->subcircuits = calloc(src->n_subcircuits, sizeof(circuit_subcircuit));
+        if (!net->subcircuits) ok = 0;
+        for (size_t i = 0; ok && i < src->n_subcircuits; i++, net->n_subcircuits++) {
+            const circuit_subcircuit *s = &src->subcircuits[i];
+            circuit_subcircuit *d = &net->subcircuits[i];
+            *d = *s;
+            d->name = circuit_strdup(s->name, &ok);
+            d->netlist = s->netlist ? circuit_netlist_clone(s->netlist) : NULL;
+            if (s->netlist && !d->netlist) ok = 0;
+            d->external_nodes = NULL;
+            if (s->n_external_nodes) {
+                d->external_nodes = malloc(s->n_external_nodes * sizeof(int));
+                if (d->external_nodes) memcpy(d->external_nodes, s->external_nodes, s->n_external_nodes * sizeof(int));
+                else ok = 0;
+            }
+        }
+        net->has_subcircuits = src->has_subcircuits;
+    }
+    if (!ok) {
+        circuit_netlist_free(net);
+        return NULL;
+    }
+    return net;
+}
+
+int circuit_netlist_add_element(circuit_netlist *net, const circuit_element *elem) {
+    if (!net || !elem) return -1;
+    circuit_element *els = realloc(net->elements, (net->n_elements + 1) * sizeof(circuit_element));
+    if (!els) return -1;
+    net->elements = els;
+    circuit_element *e = &els[net->n_elements];
+    *e = *elem;
+    e->model = elem->model ? strdup(elem->model) : NULL;
+    e->label = elem->label ? strdup(elem->label) : NULL;
+    if ((elem->model && !e->model) || (elem->label && !e->label)) {
+        circuit_element_clear(e);
+        return -1;
+    }
+    return (int)net->n_elements++;
+}
+
+/* -------------------------------
+   Minimum-degree ordering
+   ------------------------------- */
+
+/*
+    Plain minimum degree on the explicit elimination graph of A + A^T:
+    eliminating a node joins its neighbours into a clique. Circuit graphs
+    are sparse and low-degree, so the explicit graph stays small; ties go
+    to the most recently updated node, deterministically.
+*/
+typedef struct {
+    size_t **adj, *len, *cap;
+    size_t *deg, *head, *next, *prev, *mark;
+    size_t n, stamp;
+} circuit_md;
+
+static void circuit_md_unlink(circuit_md *g, size_t i) {
+    if (g->prev[i] != CIRCUIT_NONE) g->next[g->prev[i]] = g->next[i];
+    else g->head[g->deg[i]] = g->next[i];
+    if (g->next[i] != CIRCUIT_NONE) g->prev[g->next[i]] = g->prev[i];
+}
+
+static void circuit_md_link(circuit_md *g, size_t i) {
+    g->prev[i] = CIRCUIT_NONE;
+    g->next[i] = g->head[g->deg[i]];
+    if (g->next[i] != CIRCUIT_NONE) g->prev[g->next[i]] = i;
+    g->head[g->deg[i]] = i;
+}
+
+static int circuit_md_push(circuit_md *g, size_t i, size_t j) {
+    if (g->len[i] == g->cap[i]) {
+        size_t cap = g->cap[i] ? 2 * g->cap[i] : 4;
+        size_t *a = realloc(g->adj[i], cap * sizeof(size_t));
+        if (!a) return -1;
+        g->adj[i] = a;
+        g->cap[i] = cap;
+    }
+    g->adj[i][g->len[i]++] = j;
+    return 0;
+}
+
+static void circuit_md_free(circuit_md *g) {
+    if (g->adj)
+        for (size_t i = 0; i < g->n; i++) free(g->adj[i]);
+    free(g->adj);
+    free(g->len);
+    free(g->cap);
+    free(g->deg);
+    free(g->head);
+    free(g->next);
+    free(g->prev);
+    free(g->mark);
+}
+
+/* Fill q with a minimum-degree order of the n x n CSC pattern. */
+static int circuit_md_order(size_t n, const size_t *Ap, const size_t *Ai, size_t *q) {
+    circuit_md g = { 0 };
+    const size_t m = n ? n : 1;
+    int status = -1;
+    g.n = n;
+    g.adj = calloc(m, sizeof(size_t *));
+    g.len = calloc(m, sizeof(size_t));
+    g.cap = calloc(m, sizeof(size_t));
+    g.deg = calloc(m, sizeof(size_t));
+    g.head = malloc(m * sizeof(size_t));
+    g.next = malloc(m * sizeof(size_t));
+    g.prev = malloc(m * sizeof(size_t));
+    g.mark = calloc(m, sizeof(size_t));
+    if (!g.adj || !g.len || !g.cap || !g.deg || !g.head || !g.next || !g.prev || !g.mark) goto out;
+
+    /* Symmetrized adjacency without duplicates or self loops. */
+    for (size_t j = 0; j < n; j++) {
+        for (size_t p = Ap[j]; p < Ap[j + 1]; p++) {
+            const size_t i = Ai[p];
+            if (i == j) continue;
+            if (circuit_md_push(&g, i, j) != 0 || circuit_md_push(&g, j, i) != 0) goto out;
+        }
+    }
+    for (size_t i = 0; i < n; i++) {
+        g.stamp++;
+        size_t k = 0;
+        for (size_t p = 0; p < g.len[i]; p++) {
+            const size_t j = g.adj[i][p];
+            if (g.mark[j] == g.stamp) continue;
+            g.mark[j] = g.stamp;
+            g.adj[i][k++] = j;
+        }
+        g.len[i] = g.deg[i] = k;
+    }
+    for (size_t d = 0; d < n; d++) g.head[d] = CIRCUIT_NONE;
+    for (size_t i = n; i-- > 0;) circuit_md_link(&g, i);
+
+    size_t mindeg = 0;
+    for (size_t k = 0; k < n; k++) {
+        while (g.head[mindeg] == CIRCUIT_NONE) mindeg++;
+        const size_t p = g.head[mindeg];
+        circuit_md_unlink(&g, p);
+        q[k] = p;
+
+        const size_t *nb = g.adj[p];
+        const size_t nn = g.len[p];
+        for (size_t a = 0; a < nn; a++) circuit_md_unlink(&g, nb[a]);
+        for (size_t a = 0; a < nn; a++) {
+            const size_t u = nb[a];
+            g.stamp++;
+            g.mark[u] = g.stamp;
+            for (size_t t = 0; t < g.len[u];) {
+                if (g.adj[u][t] == p) {
+                    g.adj[u][t] = g.adj[u][--g.len[u]];
+                    continue;
+                }
+                g.mark[g.adj[u][t++]] = g.stamp;
+            }
+            for (size_t b = 0; b < nn; b++) {
+                if (g.mark[nb[b]] == g.stamp) continue;
+                if (circuit_md_push(&g, u, nb[b]) != 0) goto out;
+                g.mark[nb[b]] = g.stamp;
+            }
+            g.deg[u] = g.len[u];
+            circuit_md_link(&g, u);
+            if (g.deg[u] < mindeg) mindeg = g.deg[u];
+        }
+        free(g.adj[p]);
+        g.adj[p] = NULL;
+        g.len[p] = g.cap[p] = 0;
+    }
+    status = 0;
+out:
+    circuit_md_free(&g);
+    return status;
+}
+
+/* -------------------------------
+   Sparse LU (left-looking, Gilbert-Peierls)
+   ------------------------------- */
+
+static void circuit_lu_clear(circuit_lu *lu) {
+    free(lu->q);
+    free(lu->prow);
+    free(lu->pinv);
+    free(lu->Lp);
+    free(lu->Li);
+    free(lu->Lx);
+    free(lu->Up);
+    free(lu->Ui);
+    free(lu->Ux);
+    free(lu->work);
+    free(lu->stack);
+    free(lu->mark);
+    memset(lu, 0, sizeof(*lu));
+}
+
+static int circuit_lu_init(circuit_lu *lu, size_t n, const size_t *Ap, const size_t *Ai) {
+    const size_t m = n ? n : 1;
+    memset(lu, 0, sizeof(*lu));
+    lu->n = n;
+    lu->q = malloc(m * sizeof(size_t));
+    lu->prow = malloc(m * sizeof(size_t));
+    lu->pinv = malloc(m * sizeof(size_t));
+    lu->Lp = malloc((n + 1) * sizeof(size_t));
+    lu->Up = malloc((n + 1) * sizeof(size_t));
+    lu->work = calloc(2 * m, sizeof(double));
+    lu->stack = malloc(3 * m * sizeof(size_t));
+    lu->mark = calloc(m, sizeof(size_t));
+    if (!lu->q || !lu->prow || !lu->pinv || !lu->Lp || !lu->Up || !lu->work || !lu->stack || !lu->mark ||
+        circuit_md_order(n, Ap, Ai, lu->q) != 0) {
+        circuit_lu_clear(lu);
+        return -1;
+    }
+    return 0;
+}
+
+static int circuit_lu_reserve(size_t **idx, double **val, size_t *cap, size_t need) {
+    if (need <= *cap) return 0;
+    size_t c = *cap ? *cap : 16;
+    while (c < need) c *= 2;
+    size_t *i = realloc(*idx, c * sizeof(size_t));
+    if (!i) return -1;
+    *idx = i;
+    double *v = realloc(*val, c * sizeof(double));
+    if (!v) return -1;
+    *val = v;
+    *cap = c;
+    return 0;
+}
+
+/* Make dst's pivots and L/U pattern those of src (same n and ordering). */
+static int circuit_lu_copy(circuit_lu *dst, const circuit_lu *src) {
+    const size_t n = src->n;
+    dst->have_pattern = 0;
+    if (!src->have_pattern) return 0;
+    const size_t lnz = src->Lp[n], unz = src->Up[n];
+    if (circuit_lu_reserve(&dst->Li, &dst->Lx, &dst->l_cap, lnz) != 0 ||
+        circuit_lu_reserve(&dst->Ui, &dst->Ux, &dst->u_cap, unz) != 0)
+        return -1;
+    memcpy(dst->q, src->q, n * sizeof(size_t));
+    memcpy(dst->prow, src->prow, n * sizeof(size_t));
+    memcpy(dst->pinv, src->pinv, n * sizeof(size_t));
+    memcpy(dst->Lp, src->Lp, (n + 1) * sizeof(size_t));
+    memcpy(dst->Up, src->Up, (n + 1) * sizeof(size_t));
+    memcpy(dst->Li, src->Li, lnz * sizeof(size_t));
+    memcpy(dst->Lx, src->Lx, lnz * sizeof(double));
+    memcpy(dst->Ui, src->Ui, unz * sizeof(size_t));
+    memcpy(dst->Ux, src->Ux, unz * sizeof(double));
+    dst->have_pattern = 1;
+    return 0;
+}
+
+/* Allocate dst as a copy of src's ordering, pivots and pattern. */
+static int circuit_lu_clone(circuit_lu *dst, const circuit_lu *src) {
+    const size_t n = src->n, m = n ? n : 1;
+    memset(dst, 0, sizeof(*dst));
+    dst->n = n;
+    dst->q = malloc(m * sizeof(size_t));
+    dst->prow = malloc(m * sizeof(size_t));
+    dst->pinv = malloc(m * sizeof(size_t));
+    dst->Lp = malloc((n + 1) * sizeof(size_t));
+    dst->Up = malloc((n + 1) * sizeof(size_t));
+    dst->work = calloc(2 * m, sizeof(double));
+    dst->stack = malloc(3 * m * sizeof(size_t));
+    dst->mark = calloc(m, sizeof(size_t));
+    if (!dst->q || !dst->prow || !dst->pinv || !dst->Lp || !dst->Up || !dst->work || !dst->stack || !dst->mark ||
+        circuit_lu_copy(dst, src) != 0) {
+        circuit_lu_clear(dst);
+        return -1;
+    }
+    memcpy(dst->q, src->q, n * sizeof(size_t));
+    return 0;
+}
+
+/* Rows reachable from A(:, col) through the columns of L built so far, in
+   topological order, as stack[top .. n). */
+static size_t circuit_lu_reach(circuit_lu *lu, const size_t *Ap, const size_t *Ai, size_t col) {
+    const size_t n = lu->n;
+    size_t *xi = lu->stack, *st = lu->stack + n, *pos = lu->stack + 2 * n;
+    size_t top = n;
+    lu->stamp++;
+    for (size_t p0 = Ap[col]; p0 < Ap[col + 1]; p0++) {
+        if (lu->mark[Ai[p0]] == lu->stamp) continue;
+        size_t head = 0;
+        st[0] = Ai[p0];
+        for (;;) {
+            const size_t j = st[head], J = lu->pinv[j];
+            if (lu->mark[j] != lu->stamp) {
+                lu->mark[j] = lu->stamp;
+                pos[head] = J == CIRCUIT_NONE ? 0 : lu->Lp[J];
+            }
+            const size_t end = J == CIRCUIT_NONE ? 0 : lu->Lp[J + 1];
+            int descended = 0;
+            for (size_t p = pos[head]; p < end; p++) {
+                const size_t i = lu->Li[p];
+                if (lu->mark[i] == lu->stamp) continue;
+                pos[head] = p + 1;
+                st[++head] = i;
+                descended = 1;
+                break;
+            }
+            if (descended) continue;
+            xi[--top] = j;
+            if (head == 0) break;
+            head--;
+        }
+    }
+    return top;
+}
+
+/* Full factorization: choose pivots and the L/U pattern. */
+static int circuit_lu_factor(circuit_lu *lu, const size_t *Ap, const size_t *Ai, const double *Ax) {
+    const size_t n = lu->n;
+    double *x = lu->work;
+    size_t lnz = 0, unz = 0;
+    lu->have_pattern = 0;
+    for (size_t i = 0; i < n; i++) lu->pinv[i] = CIRCUIT_NONE;
+
+    for (size_t k = 0; k < n; k++) {
+        lu->Lp[k] = lnz;
+        lu->Up[k] = unz;
+        if (circuit_lu_reserve(&lu->Li, &lu->Lx, &lu->l_cap, lnz + n - k) != 0 ||
+            circuit_lu_reserve(&lu->Ui, &lu->Ux, &lu->u_cap, unz + k + 1) != 0)
+            return -1;
+        const size_t col = lu->q[k];
+        const size_t top = circuit_lu_reach(lu, Ap, Ai, col);
+        const size_t *xi = lu->stack;
+
+        for (size_t p = Ap[col]; p < Ap[col + 1]; p++) x[Ai[p]] = Ax[p];
+        for (size_t px = top; px < n; px++) {
+            const size_t j = xi[px], J = lu->pinv[j];
+            if (J == CIRCUIT_NONE) continue;
+            const double xj = x[j];
+            for (size_t p = lu->Lp[J] + 1; p < lu->Lp[J + 1]; p++) x[lu->Li[p]] -= lu->Lx[p] * xj;
+        }
+
+        size_t ipiv = CIRCUIT_NONE;
+        double amax = -1.0;
+        for (size_t px = top; px < n; px++) {
+            const size_t i = xi[px];
+            if (lu->pinv[i] == CIRCUIT_NONE) {
+                const double a = fabs(x[i]);
+                if (a > amax) {
+                    amax = a;
+                    ipiv = i;
+                }
+            } else {
+                lu->Ui[unz] = lu->pinv[i];
+                lu->Ux[unz++] = x[i];
+            }
+        }
+        if (ipiv == CIRCUIT_NONE || !(amax > 0.0) || !isfinite(amax)) {
+            for (size_t px = top; px < n; px++) x[xi[px]] = 0.0;
+            return -1;
+        }
+        /* Keep the ordering's diagonal when it is good enough. */
+        if (lu->mark[col] == lu->stamp && lu->pinv[col] == CIRCUIT_NONE && fabs(x[col]) >= CIRCUIT_LU_PIVOT_TOL * amax)
+            ipiv = col;
+
+        const double piv = x[ipiv];
+        lu->Ui[unz] = k;
+        lu->Ux[unz++] = piv;
+        lu->pinv[ipiv] = k;
+        lu->prow[k] = ipiv;
+        lu->Li[lnz] = ipiv;
+        lu->Lx[lnz++] = 1.0;
+        for (size_t px = top; px < n; px++) {
+            const size_t i = xi[px];
+            if (lu->pinv[i] == CIRCUIT_NONE) {
+                lu->Li[lnz] = i;
+                lu->Lx[lnz++] = x[i] / piv;
+            }
+            x[i] = 0.0;
+        }
+    }
+    lu->Lp[n] = lnz;
+    lu->Up[n] = unz;
+    lu->have_pattern = 1;
+    return 0;
+}
+
+/* Numeric refactorization on the existing pattern and pivots. Fails (and
+   drops the pattern) if a pivot became zero or too small. */
+static int circuit_lu_refactor(circuit_lu *lu, const size_t *Ap, const size_t *Ai, const double *Ax) {
+    const size_t n = lu->n;
+    double *x = lu->work;
+    for (size_t k = 0; k < n; k++) {
+        const size_t col = lu->q[k];
+        for (size_t p = Ap[col]; p < Ap[col + 1]; p++) x[Ai[p]] = Ax[p];
+        const size_t u_end = lu->Up[k + 1] - 1;
+        for (size_t p = lu->Up[k]; p < u_end; p++) {
+            const size_t J = lu->Ui[p], j = lu->prow[J];
+            const double xj = x[j];
+            lu->Ux[p] = xj;
+            x[j] = 0.0;
+            for (size_t t = lu->Lp[J] + 1; t < lu->Lp[J + 1]; t++) x[lu->Li[t]] -= lu->Lx[t] * xj;
+        }
+        const double piv = x[lu->prow[k]];
+        x[lu->prow[k]] = 0.0;
+        double amax = 0.0;
+        for (size_t p = lu->Lp[k] + 1; p < lu->Lp[k + 1]; p++) {
+            const double a = fabs(x[lu->Li[p]]);
+            if (a > amax) amax = a;
+        }
+        const int bad = !(fabs(piv) > 0.0) || !isfinite(piv) || fabs(piv) < CIRCUIT_LU_PIVOT_TOL * amax;
+        lu->Ux[u_end] = piv;
+        for (size_t p = lu->Lp[k] + 1; p < lu->Lp[k + 1]; p++) {
+            lu->Lx[p] = x[lu->Li[p]] / piv;
+            x[lu->Li[p]] = 0.0;
+        }
+        if (bad) {
+            lu->have_pattern = 0;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* x = A^{-1} b (x and b may alias). */
+static void circuit_lu_solve(const circuit_lu *lu, const double *b, double *x) {
+    const size_t n = lu->n;
+    double *w = lu->work, *z = lu->work + n;
+    memcpy(w, b, n * sizeof(double));
+    for (size_t k = 0; k < n; k++) {
+        const double v = w[lu->prow[k]];
+        z[k] = v;
+        for (size_t p = lu->Lp[k] + 1; p < lu->Lp[k + 1]; p++) w[lu->Li[p]] -= lu->Lx[p] * v;
+    }
+    for (size_t k = n; k-- > 0;) {
+        const size_t d = lu->Up[k + 1] - 1;
+        const double zk = z[k] / lu->Ux[d];
+        z[k] = zk;
+        for (size_t p = lu->Up[k]; p < d; p++) z[lu->Ui[p]] -= lu->Ux[p] * zk;
+    }
+    for (size_t k = 0; k < n; k++) x[lu->q[k]] = z[k];
+    memset(w, 0, 2 * n * sizeof(double));
+}
+
+/* -------------------------------
+   MNA assembly
+   ------------------------------- */
+
+#define CIRCUIT_MAX_STAMPS 6
+
+static size_t circuit_node_unknown(int node) {
+    return node > 0 ? (size_t)node - 1 : CIRCUIT_NONE;
+}
+
+static int circuit_element_supported(const circuit_netlist *net, const circuit_element *e) {
+    const int nn = (int)net->n_nodes;
+    if (e->node1 < 0 || e->node1 >= nn || e->node2 < 0 || e->node2 >= nn) return 0;
+    switch (e->type) {
+    case CIRCUIT_RESISTOR:       return e->value > 0.0;
+    case CIRCUIT_CAPACITOR:
+    case CIRCUIT_INDUCTOR:       return e->value >= 0.0;
+    case CIRCUIT_VOLTAGE_SOURCE:
+    case CIRCUIT_CURRENT_SOURCE:
+    case CIRCUIT_DIODE:
+    case CIRCUIT_PROBE:          return 1;
+    case CIRCUIT_VCVS:
+    case CIRCUIT_VCCS:           return e->ctrl1 >= 0 && e->ctrl1 < nn && e->ctrl2 >= 0 && e->ctrl2 < nn;
+    default:                     return 0;
+    }
+}
+
+static int circuit_has_branch(circuit_element_type t) {
+    return t == CIRCUIT_VOLTAGE_SOURCE || t == CIRCUIT_INDUCTOR || t == CIRCUIT_VCVS;
+}
+
+/* Matrix positions an element stamps, in the order circuit_mna_assemble() fills them. */
+static size_t circuit_element_stamps(const circuit_mna *m, size_t e, size_t *row, size_t *col) {
+    const circuit_element *el = &m->net->elements[e];
+    const size_t a = circuit_node_unknown(el->node1), b = circuit_node_unknown(el->node2);
+    const size_t c1 = circuit_node_unknown(el->ctrl1), c2 = circuit_node_unknown(el->ctrl2);
+    const size_t k = m->branch[e] >= 0 ? (size_t)m->branch[e] : CIRCUIT_NONE;
+    switch (el->type) {
+    case CIRCUIT_RESISTOR:
+    case CIRCUIT_CAPACITOR:
+    case CIRCUIT_DIODE:
+        row[0] = a; col[0] = a;
+        row[1] = b; col[1] = b;
+        row[2] = a; col[2] = b;
+        row[3] = b; col[3] = a;
+        return 4;
+    case CIRCUIT_VCCS:
+        row[0] = a; col[0] = c1;
+        row[1] = a; col[1] = c2;
+        row[2] = b; col[2] = c1;
+        row[3] = b; col[3] = c2;
+        return 4;
+    case CIRCUIT_VOLTAGE_SOURCE:
+    case CIRCUIT_INDUCTOR:
+    case CIRCUIT_VCVS:
+        row[0] = a; col[0] = k;
+        row[1] = b; col[1] = k;
+        row[2] = k; col[2] = a;
+        row[3] = k; col[3] = b;
+        if (el->type != CIRCUIT_VCVS) {
+            row[4] = k; col[4] = k;
+            return 5;
+        }
+        row[4] = k; col[4] = c1;
+        row[5] = k; col[5] = c2;
+        return 6;
+    default:
+        return 0;
+    }
+}
+
+static int circuit_pair_cmp(const void *x, const void *y) {
+    const size_t *a = x, *b = y;
+    if (a[0] != b[0]) return a[0] < b[0] ? -1 : 1;
+    return (a[1] > b[1]) - (a[1] < b[1]);
+}
+
+static size_t circuit_mna_find(const circuit_mna *m, size_t row, size_t col) {
+    if (row == CIRCUIT_NONE || col == CIRCUIT_NONE) return CIRCUIT_NONE;
+    size_t lo = m->Ap[col], hi = m->Ap[col + 1];
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+        if (m->Ai[mid] < row) lo = mid + 1;
+        else hi = mid;
+    }
+    return m->Ai[lo] == row ? lo : CIRCUIT_NONE;
+}
+
+void circuit_mna_free(circuit_mna *m) {
+    if (!m) return;
+    free(m->branch);
+    free(m->stamp_off);
+    free(m->stamp_pos);
+    free(m->Ap);
+    free(m->Ai);
+    free(m->Ax);
+    free(m->b);
+    free(m->x);
+    free(m->x_prev);
+    free(m->v_diode);
+    circuit_lu_clear(&m->lu);
+    free(m);
+}
+
+circuit_mna *circuit_mna_alloc(const circuit_netlist *net) {
+    if (!net || net->n_nodes == 0 || (net->n_elements && !net->elements)) return NULL;
+    for (size_t e = 0; e < net->n_elements; e++)
+        if (!circuit_element_supported(net, &net->elements[e])) return NULL;
+
+    circuit_mna *m = calloc(1, sizeof(*m));
+    if (!m) return NULL;
+    m->net = net;
+    const size_t ne = net->n_elements, nv = net->n_nodes - 1;
+    m->branch = malloc((ne ? ne : 1) * sizeof(long));
+    m->stamp_off = malloc((ne + 1) * sizeof(size_t));
+    if (!m->branch || !m->stamp_off) goto fail;
+    for (size_t e = 0; e < ne; e++)
+        m->branch[e] = circuit_has_branch(net->elements[e].type) ? (long)(nv + m->n_branches++) : -1;
+    m->n = nv + m->n_branches;
+    const size_t n = m->n;
+
+    /* Stamp positions: every (row, col) an element touches, plus the diagonal. */
+    size_t row[CIRCUIT_MAX_STAMPS], col[CIRCUIT_MAX_STAMPS];
+    m->stamp_off[0] = 0;
+    for (size_t e = 0; e < ne; e++) m->stamp_off[e + 1] = m->stamp_off[e] + circuit_element_stamps(m, e, row, col);
+    const size_t ns = m->stamp_off[ne];
+    m->stamp_pos = malloc((ns ? ns : 1) * sizeof(size_t));
+    size_t *pairs = malloc((ns + n + 1) * 2 * sizeof(size_t));
+    if (!m->stamp_pos || !pairs) {
+        free(pairs);
+        goto fail;
+    }
+    size_t np = 0;
+    for (size_t i = 0; i < n; i++) {
+        pairs[2 * np] = i;
+        pairs[2 * np++ + 1] = i;
+    }
+    for (size_t e = 0; e < ne; e++) {
+        const size_t c = circuit_element_stamps(m, e, row, col);
+        for (size_t s = 0; s < c; s++) {
+            if (row[s] == CIRCUIT_NONE || col[s] == CIRCUIT_NONE) continue;
+            pairs[2 * np] = col[s];
+            pairs[2 * np++ + 1] = row[s];
+        }
+    }
+    qsort(pairs, np, 2 * sizeof(size_t), circuit_pair_cmp);
+
+    m->Ap = calloc(n + 1, sizeof(size_t));
+    m->Ai = malloc((np ? np : 1) * sizeof(size_t));
+    if (!m->Ap || !m->Ai) {
+        free(pairs);
+        goto fail;
+    }
+    for (size_t p = 0; p < np; p++) {
+        if (p > 0 && pairs[2 * p] == pairs[2 * p - 2] && pairs[2 * p + 1] == pairs[2 * p - 1]) continue;
+        m->Ai[m->nnz++] = pairs[2 * p + 1];
+        m->Ap[pairs[2 * p] + 1]++;
+    }
+    free(pairs);
+    for (size_t j = 0; j < n; j++) m->Ap[j + 1] += m->Ap[j];
+    for (size_t e = 0; e < ne; e++) {
+        const size_t c = circuit_element_stamps(m, e, row, col);
+        for (size_t s = 0; s < c; s++) m->stamp_pos[m->stamp_off[e] + s] = circuit_mna_find(m, row[s], col[s]);
+    }
+
+    const size_t nb = n ? n : 1;
+    m->Ax = calloc(m->nnz ? m->nnz : 1, sizeof(double));
+    m->b = calloc(nb, sizeof(double));
+    m->x = calloc(nb, sizeof(double));
+    m->x_prev = calloc(nb, sizeof(double));
+    m->v_diode = calloc(ne ? ne : 1, sizeof(double));
+    if (!m->Ax || !m->b || !m->x || !m->x_prev || !m->v_diode) goto fail;
+    if (circuit_lu_init(&m->lu, n, m->Ap, m->Ai) != 0) goto fail;
+    return m;
+
+fail:
+    circuit_mna_free(m);
+    return NULL;
+}
+
+static void *circuit_dup(const void *src, size_t bytes) {
+    void *d = malloc(bytes ? bytes : 1);
+    if (d && bytes) memcpy(d, src, bytes);
+    return d;
+}
+
+circuit_mna *circuit_mna_clone(const circuit_mna *src, const circuit_netlist *net) {
+    if (!src || !net || net->n_elements != src->net->n_elements || net->n_nodes != src->net->n_nodes) return NULL;
+    circuit_mna *m = calloc(1, sizeof(*m));
+    if (!m) return NULL;
+    const size_t n = src->n, ne = net->n_elements, nb = n ? n : 1;
+    m->net = net;
+    m->n = n;
+    m->n_branches = src->n_branches;
+    m->nnz = src->nnz;
+    m->branch = circuit_dup(src->branch, ne * sizeof(long));
+    m->stamp_off = circuit_dup(src->stamp_off, (ne + 1) * sizeof(size_t));
+    m->stamp_pos = circuit_dup(src->stamp_pos, src->stamp_off[ne] * sizeof(size_t));
+    m->Ap = circuit_dup(src->Ap, (n + 1) * sizeof(size_t));
+    m->Ai = circuit_dup(src->Ai, src->nnz * sizeof(size_t));
+    m->Ax = calloc(src->nnz ? src->nnz : 1, sizeof(double));
+    m->b = calloc(nb, sizeof(double));
+    m->x = calloc(nb, sizeof(double));
+    m->x_prev = calloc(nb, sizeof(double));
+    m->v_diode = calloc(ne ? ne : 1, sizeof(double));
+    if (!m->branch || !m->stamp_off || !m->stamp_pos || !m->Ap || !m->Ai || !m->Ax || !m->b || !m->x ||
+        !m->x_prev || !m->v_diode || circuit_lu_clone(&m->lu, &src->lu) != 0) {
+        circuit_mna_free(m);
+        return NULL;
+    }
+    return m;
+}
+
+static double circuit_node_voltage(const double *x, int node) {
+    return node > 0 ? x[node - 1] : 0.0;
+}
+
+static void circuit_rhs_add(double *b, int node, double v) {
+    if (node > 0) b[node - 1] += v;
+}
+
+/* Stamp every element; dt = 0 is DC (capacitors open, inductors shorted). */
+static void circuit_mna_assemble(circuit_mna *m, double dt) {
+    const circuit_netlist *net = m->net;
+    memset(m->Ax, 0, m->nnz * sizeof(double));
+    memset(m->b, 0, m->n * sizeof(double));
+    for (size_t e = 0; e < net->n_elements; e++) {
+        const circuit_element *el = &net->elements[e];
+        const size_t *pos = m->stamp_pos + m->stamp_off[e];
+        double val[CIRCUIT_MAX_STAMPS] = { 0 };
+        double g = 0.0;
+        switch (el->type) {
+        case CIRCUIT_RESISTOR:
+            g = 1.0 / el->value;
+            break;
+        case CIRCUIT_CAPACITOR:
+            if (dt > 0.0) {
+                g = el->value / dt;
+                const double ieq = g * (circuit_node_voltage(m->x_prev, el->node1) -
+                                        circuit_node_voltage(m->x_prev, el->node2));
+                circuit_rhs_add(m->b, el->node1, ieq);
+                circuit_rhs_add(m->b, el->node2, -ieq);
+            }
+            break;
+        case CIRCUIT_DIODE: {
+            const double is = el->value > 0.0 ? el->value : CIRCUIT_DIODE_IS;
+            const double nvt = (el->value2 > 0.0 ? el->value2 : 1.0) * CIRCUIT_VT;
+            const double vd = m->v_diode[e], ex = exp(fmin(vd / nvt, 80.0));
+            g = is * ex / nvt + CIRCUIT_GMIN;
+            const double ieq = is * (ex - 1.0) + CIRCUIT_GMIN * vd - g * vd;
+            circuit_rhs_add(m->b, el->node1, -ieq);
+            circuit_rhs_add(m->b, el->node2, ieq);
+            break;
+        }
+        case CIRCUIT_CURRENT_SOURCE:
+            circuit_rhs_add(m->b, el->node1, -el->value);
+            circuit_rhs_add(m->b, el->node2, el->value);
+            break;
+        case CIRCUIT_VCCS:
+            val[0] = el->value;
+            val[1] = -el->value;
+            val[2] = -el->value;
+            val[3] = el->value;
+            break;
+        case CIRCUIT_VOLTAGE_SOURCE:
+        case CIRCUIT_INDUCTOR:
+        case CIRCUIT_VCVS: {
+            const size_t k = (size_t)m->branch[e];
+            val[0] = 1.0;
+            val[1] = -1.0;
+            val[2] = 1.0;
+            val[3] = -1.0;
+            if (el->type == CIRCUIT_VOLTAGE_SOURCE) {
+                m->b[k] = el->value;
+            } else if (el->type == CIRCUIT_INDUCTOR) {
+                if (dt > 0.0) {
+                    val[4] = -el->value / dt;
+                    m->b[k] = val[4] * m->x_prev[k];
+                }
+            } else {
+                val[4] = -el->value;
+                val[5] = el->value;
+            }
+            break;
+        }
+        default:
+            break;
+        }
+        if (el->type == CIRCUIT_RESISTOR || el->type == CIRCUIT_CAPACITOR || el->type == CIRCUIT_DIODE) {
+            val[0] = g;
+            val[1] = g;
+            val[2] = -g;
+            val[3] = -g;
+        }
+        const size_t c = m->stamp_off[e + 1] - m->stamp_off[e];
+        for (size_t s = 0; s < c; s++)
+            if (pos[s] != CIRCUIT_NONE) m->Ax[pos[s]] += val[s];
+    }
+}
+
+/* Refactor on the cached pattern, pivoting again only when that fails. */
+static int circuit_mna_factor(circuit_mna *m) {
+    if (m->lu.have_pattern) {
+        if (circuit_lu_refactor(&m->lu, m->Ap, m->Ai, m->Ax) == 0) {
+            m->n_refactor++;
+            return 0;
+        }
+    }
+    m->n_factor++;
+    return circuit_lu_factor(&m->lu, m->Ap, m->Ai, m->Ax);
+}
+
+/* SPICE-style junction voltage limiting (pnjlim). */
+static double circuit_diode_limit(double vnew, double vold, double nvt, double is) {
+    const double vcrit = nvt * log(nvt / (M_SQRT2 * is));
+    if (vnew > vcrit && fabs(vnew - vold) > 2.0 * nvt) {
+        if (vold > 0.0) {
+            const double arg = 1.0 + (vnew - vold) / nvt;
+            return arg > 0.0 ? vold + nvt * log(arg) : vcrit;
+        }
+        return nvt * log(vnew / nvt);
+    }
+    return vnew;
+}
+
+/* Solve the (possibly nonlinear) system at one time point into m->x. */
+static int circuit_mna_newton(circuit_mna *m, double dt) {
+    HOLOS_TRACE_ZONE("circuit_mna_newton");
+    const circuit_netlist *net = m->net;
+    int nonlinear = 0;
+    for (size_t e = 0; e < net->n_elements; e++) nonlinear |= net->elements[e].type == CIRCUIT_DIODE;
+
+    for (m->n_newton = 1; m->n_newton <= CIRCUIT_MAX_NEWTON; m->n_newton++) {
+        circuit_mna_assemble(m, dt);
+        if (circuit_mna_factor(m) != 0) return CIRCUIT_ERR_SINGULAR;
+        circuit_lu_solve(&m->lu, m->b, m->b);
+        int converged = 1;
+        for (size_t i = 0; i < m->n; i++) {
+            if (fabs(m->b[i] - m->x[i]) > CIRCUIT_VNTOL + CIRCUIT_RELTOL * fabs(m->b[i])) converged = 0;
+            m->x[i] = m->b[i];
+        }
+        if (!nonlinear) return CIRCUIT_OK;
+        for (size_t e = 0; e < net->n_elements; e++) {
+            const circuit_element *el = &net->elements[e];
+            if (el->type != CIRCUIT_DIODE) continue;
+            const double is = el->value > 0.0 ? el->value : CIRCUIT_DIODE_IS;
+            const double nvt = (el->value2 > 0.0 ? el->value2 : 1.0) * CIRCUIT_VT;
+            const double vd = circuit_node_voltage(m->x, el->node1) - circuit_node_voltage(m->x, el->node2);
+            const double lim = circuit_diode_limit(vd, m->v_diode[e], nvt, is);
+            if (lim != vd || fabs(vd - m->v_diode[e]) > CIRCUIT_VNTOL + CIRCUIT_RELTOL * fabs(vd)) converged = 0;
+            m->v_diode[e] = lim;
+        }
+        if (converged) return CIRCUIT_OK;
+    }
+    return CIRCUIT_ERR_CONVERGENCE;
+}
+
+static void circuit_mna_store(const circuit_mna *m, double *v, size_t stride) {
+    v[0] = 0.0;
+    for (size_t i = 1; i < m->net->n_nodes; i++) v[i * stride] = m->x[i - 1];
+}
+
+/* DC solve from a zero initial guess into m->x. */
+static int circuit_mna_operating_point(circuit_mna *m) {
+    memset(m->x, 0, m->n * sizeof(double));
+    memset(m->v_diode, 0, m->net->n_elements * sizeof(double));
+    return circuit_mna_newton(m, 0.0);
+}
+
+int circuit_mna_dc(circuit_mna *m, gsl_vector *node_voltages) {
+    if (!m || !node_voltages || node_voltages->size < m->net->n_nodes) return CIRCUIT_ERR_INVALID;
+    int status = circuit_mna_operating_point(m);
+    if (status != CIRCUIT_OK) return status;
+    circuit_mna_store(m, node_voltages->data, node_voltages->stride);
+    return CIRCUIT_OK;
+}
+
+int circuit_mna_transient(circuit_mna *m, double t0, double t1, double dt, gsl_matrix *node_voltages) {
+    if (!m || !node_voltages || !(dt > 0.0) || t1 < t0) return CIRCUIT_ERR_INVALID;
+    const size_t steps = (size_t)ceil((t1 - t0) / dt - 1e-9);
+    if (node_voltages->size1 < steps + 1 || node_voltages->size2 < m->net->n_nodes) return CIRCUIT_ERR_INVALID;
+    memset(m->x, 0, m->n * sizeof(double));
+    memset(m->v_diode, 0, m->net->n_elements * sizeof(double));
+    circuit_mna_store(m, node_voltages->data, 1);
+    for (size_t k = 1; k <= steps; k++) {
+        memcpy(m->x_prev, m->x, m->n * sizeof(double));
+        int status = circuit_mna_newton(m, dt);
+        if (status != CIRCUIT_OK) return status;
+        circuit_mna_store(m, node_voltages->data + k * node_voltages->tda, 1);
+    }
+    return CIRCUIT_OK;
+}
+
+/* -------------------------------
+   Analyses
+   ------------------------------- */
+
+static circuit_mna *circuit_mna_for(const circuit_netlist *net, int *status) {
+    if (!net) {
+        *status = CIRCUIT_ERR_INVALID;
+        return NULL;
+    }
+    for (size_t e = 0; e < net->n_elements; e++) {
+        if (!circuit_element_supported(net, &net->elements[e])) {
+            *status = CIRCUIT_ERR_INVALID;
+            return NULL;
+        }
+    }
+    circuit_mna *m = circuit_mna_alloc(net);
+    *status = m ? CIRCUIT_OK : net->n_nodes ? CIRCUIT_ERR_ALLOC : CIRCUIT_ERR_INVALID;
+    return m;
+}
+
+int circuit_dc_analysis(const circuit_netlist *net, gsl_vector *node_voltages) {
+    int status;
+    circuit_mna *m = circuit_mna_for(net, &status);
+    if (!m) return status;
+    status = circuit_mna_dc(m, node_voltages);
+    circuit_mna_free(m);
+    return status;
+}
+
+int circuit_nonlinear_dc_analysis(const circuit_netlist *net, gsl_vector *node_voltages) {
+    return circuit_dc_analysis(net, node_voltages);
+}
+
+int circuit_transient_analysis(const circuit_netlist *net, double t0, double t1, double dt, gsl_matrix *node_voltages) {
+    int status;
+    circuit_mna *m = circuit_mna_for(net, &status);
+    if (!m) return status;
+    status = circuit_mna_transient(m, t0, t1, dt, node_voltages);
+    circuit_mna_free(m);
+    return status;
+}
+
+/* -------------------------------
+   AC sweep
+   ------------------------------- */
+
+/* Reactive part C of Y = G + jw C, in the layout of m->Ax. */
+static void circuit_mna_reactive(const circuit_mna *m, double *Cx) {
+    memset(Cx, 0, m->nnz * sizeof(double));
+    for (size_t e = 0; e < m->net->n_elements; e++) {
+        const circuit_element *el = &m->net->elements[e];
+        const size_t *pos = m->stamp_pos + m->stamp_off[e];
+        if (el->type == CIRCUIT_CAPACITOR) {
+            const double sign[4] = { 1.0, 1.0, -1.0, -1.0 };
+            for (size_t s = 0; s < 4; s++)
+                if (pos[s] != CIRCUIT_NONE) Cx[pos[s]] += sign[s] * el->value;
+        } else if (el->type == CIRCUIT_INDUCTOR) {
+            Cx[pos[4]] -= el->value;
+        }
+    }
+}
+
+/* Small-signal excitation: the independent sources alone. */
+static void circuit_mna_sources(const circuit_mna *m, double *b) {
+    memset(b, 0, m->n * sizeof(double));
+    for (size_t e = 0; e < m->net->n_elements; e++) {
+        const circuit_element *el = &m->net->elements[e];
+        if (el->type == CIRCUIT_VOLTAGE_SOURCE) {
+            b[m->branch[e]] = el->value;
+        } else if (el->type == CIRCUIT_CURRENT_SOURCE) {
+            circuit_rhs_add(b, el->node1, -el->value);
+            circuit_rhs_add(b, el->node2, el->value);
+        }
+    }
+}
+
+/*
+    Entry p = Ap[j] + t of the n x n pattern expands to the 2 x 2 block
+    [G -wC; wC G] at rows/columns (2i, 2i + 1) x (2j, 2j + 1): column 2j
+    holds G, wC at 4 Ap[j] + 2t, and column 2j + 1 holds -wC, G after the
+    2 cnt_j entries of column 2j. Row order within a column is preserved.
+*/
+static void circuit_ac_pattern(size_t n, const size_t *Ap, const size_t *Ai, size_t *Ap2, size_t *Ai2) {
+    for (size_t j = 0; j < n; j++) {
+        const size_t cnt = Ap[j + 1] - Ap[j], c0 = 4 * Ap[j], c1 = c0 + 2 * cnt;
+        Ap2[2 * j] = c0;
+        Ap2[2 * j + 1] = c1;
+        for (size_t t = 0; t < cnt; t++) {
+            const size_t i = Ai[Ap[j] + t];
+            Ai2[c0 + 2 * t] = Ai2[c1 + 2 * t] = 2 * i;
+            Ai2[c0 + 2 * t + 1] = Ai2[c1 + 2 * t + 1] = 2 * i + 1;
+        }
+    }
+    Ap2[2 * n] = 4 * Ap[n];
+}
+
+static void circuit_ac_values(size_t n, const size_t *Ap, const double *G, const double *C, double w, double *Ax2) {
+    for (size_t j = 0; j < n; j++) {
+        const size_t cnt = Ap[j + 1] - Ap[j], c0 = 4 * Ap[j], c1 = c0 + 2 * cnt;
+        for (size_t t = 0; t < cnt; t++) {
+            const double g = G[Ap[j] + t], c = w * C[Ap[j] + t];
+            Ax2[c0 + 2 * t] = g;
+            Ax2[c0 + 2 * t + 1] = c;
+            Ax2[c1 + 2 * t] = -c;
+            Ax2[c1 + 2 * t + 1] = g;
+        }
+    }
+}
+
+int circuit_ac_sweep(const circuit_netlist *net, const double *omega, size_t n_omega, int n_threads,
+                     gsl_matrix_complex *node_voltages) {
+    if (!net || (n_omega && !omega) || !node_voltages) return CIRCUIT_ERR_INVALID;
+    if (n_omega == 0) return CIRCUIT_OK;
+    if (node_voltages->size1 < n_omega || node_voltages->size2 < net->n_nodes) return CIRCUIT_ERR_INVALID;
+
+    int status;
+    circuit_mna *m = circuit_mna_for(net, &status);
+    if (!m) return status;
+    int nonlinear = 0;
+    for (size_t e = 0; e < net->n_elements; e++) nonlinear |= net->elements[e].type == CIRCUIT_DIODE;
+    if (nonlinear && (status = circuit_mna_operating_point(m)) != CIRCUIT_OK) {
+        circuit_mna_free(m);
+        return status;
+    }
+
+    /* G (with diodes at the operating point), C and the excitation, once. */
+    const size_t n = m->n, n2 = 2 * n, nnz2 = 4 * m->nnz;
+    circuit_mna_assemble(m, 0.0);
+    double *G = m->Ax, *C = malloc((m->nnz ? m->nnz : 1) * sizeof(double));
+    size_t *Ap2 = malloc((n2 + 1) * sizeof(size_t)), *Ai2 = malloc((nnz2 ? nnz2 : 1) * sizeof(size_t));
+    double *b2 = calloc(n2 ? n2 : 1, sizeof(double)), *Ax2 = malloc((nnz2 ? nnz2 : 1) * sizeof(double));
+    circuit_lu proto = { 0 };
+    status = CIRCUIT_ERR_ALLOC;
+    if (!C || !Ap2 || !Ai2 || !b2 || !Ax2) goto out;
+    circuit_mna_reactive(m, C);
+    circuit_mna_sources(m, m->b);
+    for (size_t i = 0; i < n; i++) b2[2 * i] = m->b[i];
+    circuit_ac_pattern(n, m->Ap, m->Ai, Ap2, Ai2);
+    if (circuit_lu_init(&proto, n2, Ap2, Ai2) != 0) goto out;
+    circuit_ac_values(n, m->Ap, G, C, omega[0], Ax2);
+    circuit_lu_factor(&proto, Ap2, Ai2, Ax2);
+
+    int nt = n_threads;
+    if (nt < 0) {
+#ifdef _OPENMP
+        nt = omp_get_max_threads();
+#else
+        nt = 1;
+#endif
+    }
+    if (nt < 1) nt = 1;
+    if ((size_t)nt > n_omega) nt = (int)n_omega;
+
+    size_t first_fail = SIZE_MAX;
+    int fail_status = CIRCUIT_OK;
+    #pragma omp parallel num_threads(nt) if(nt > 1)
+    {
+        circuit_lu lu;
+        double *ax = malloc((nnz2 ? nnz2 : 1) * sizeof(double)), *x = malloc((n2 ? n2 : 1) * sizeof(double));
+        const int ready = ax && x && circuit_lu_clone(&lu, &proto) == 0;
+
+        #pragma omp for schedule(dynamic, 16)
+        for (size_t k = 0; k < n_omega; k++) {
+            double *row = node_voltages->data + 2 * k * node_voltages->tda;
+            int st = ready ? CIRCUIT_OK : CIRCUIT_ERR_ALLOC;
+            if (ready) {
+                circuit_ac_values(n, m->Ap, G, C, omega[k], ax);
+                /* Refactor on the prototype pivots; a frequency that needs new
+                   pivots gets them, and the next one starts over from the prototype. */
+                if (!lu.have_pattern && circuit_lu_copy(&lu, &proto) != 0) st = CIRCUIT_ERR_ALLOC;
+                else if (!lu.have_pattern || circuit_lu_refactor(&lu, Ap2, Ai2, ax) != 0) {
+                    if (circuit_lu_factor(&lu, Ap2, Ai2, ax) != 0) st = CIRCUIT_ERR_SINGULAR;
+                    lu.have_pattern = 0;
+                }
+            }
+            if (st == CIRCUIT_OK) {
+                circuit_lu_solve(&lu, b2, x);
+                row[0] = row[1] = 0.0;
+                for (size_t i = 1; i < net->n_nodes; i++) {
+                    row[2 * i] = x[2 * (i - 1)];
+                    row[2 * i + 1] = x[2 * (i - 1) + 1];
+                }
+            } else {
+                for (size_t i = 0; i < 2 * net->n_nodes; i++) row[i] = NAN;
+                #pragma omp critical(circuit_ac_fail)
+                {
+                    if (k < first_fail) {
+                        first_fail = k;
+                        fail_status = st;
+                    }
+                }
+            }
+        }
+        if (ready) circuit_lu_clear(&lu);
+        free(ax);
+        free(x);
+    }
+    status = fail_status;
+
+out:
+    circuit_lu_clear(&proto);
+    free(C);
+    free(Ap2);
+    free(Ai2);
+    free(b2);
+    free(Ax2);
+    circuit_mna_free(m);
+    return status;
+}
+
+/* Magnitudes of a single-frequency sweep. */
+int circuit_ac_analysis(const circuit_netlist *net, double omega, gsl_vector *node_voltages) {
+    if (!net || !node_voltages || node_voltages->size < net->n_nodes) return CIRCUIT_ERR_INVALID;
+    gsl_matrix_complex *z = gsl_matrix_complex_alloc(1, net->n_nodes ? net->n_nodes : 1);
+    if (!z) return CIRCUIT_ERR_ALLOC;
+    int status = circuit_ac_sweep(net, &omega, 1, 0, z);
+    if (status == CIRCUIT_OK)
+        for (size_t i = 0; i < net->n_nodes; i++)
+            node_voltages->data[i * node_voltages->stride] = hypot(z->data[2 * i], z->data[2 * i + 1]);
+    gsl_matrix_complex_free(z);
+    return status;
+}
+
+int circuit_small_signal_analysis(const circuit_netlist *net, double omega, gsl_vector *node_voltages) {
+    return circuit_ac_analysis(net, omega, node_voltages);
+}
+
+/* -------------------------------
+   Monte Carlo
+   ------------------------------- */
+
+/* Values of sample r in local, from the nominal values in net. */
+static void circuit_mc_sample(const circuit_netlist *net, circuit_netlist *local, const circuit_mc_options *opt,
+                              size_t r) {
+    double z[2] = { 0.0, 0.0 };
+    for (size_t e = 0; e < net->n_elements; e++) {
+        if (e % 2 == 0) philox_normal2(opt->seed, r, e / 2, z);
+        const circuit_element *el = &net->elements[e];
+        if (el->type != CIRCUIT_RESISTOR && el->type != CIRCUIT_CAPACITOR && el->type != CIRCUIT_INDUCTOR) continue;
+        const double ze = fmax(-4.0, fmin(4.0, z[e % 2]));
+        local->elements[e].value = el->value * (1.0 + opt->sigma * ze);
+    }
+}
+
+/* What a thread of the runs keeps: its clones, and its first failure */
+typedef struct {
+    circuit_netlist *local;
+    circuit_mna *m;
+    size_t n_factor;
+    size_t first_fail;
+    int fail_status;
+    int ready;
+} circuit_mc_slot;
+
+typedef struct {
+    const circuit_netlist *net;
+    const circuit_mc_options *opt;
+    const circuit_mna *proto;
+    gsl_matrix *results;
+    circuit_mc_slot *slots;
+} circuit_mc_work;
+
+static void circuit_mc_range(size_t lo, size_t hi, unsigned slot, void *cls) {
+    circuit_mc_work *w = cls;
+    const circuit_netlist *net = w->net;
+    circuit_mc_slot *sl = &w->slots[slot];
+    if (!sl->ready) {
+        sl->local = circuit_netlist_clone(net);
+        sl->m = sl->local ? circuit_mna_clone(w->proto, sl->local) : NULL;
+        sl->ready = 1;
+    }
+    for (size_t r = lo; r < hi; r++) {
+        double *row = w->results->data + r * w->results->tda;
+        circuit_mna *m = sl->m;
+        int st = CIRCUIT_ERR_ALLOC;
+        if (m) {
+            /* A run that had to pivot again must not leak its pivots into the next. */
+            if (m->n_factor != sl->n_factor) {
+                st = circuit_lu_copy(&m->lu, &w->proto->lu) == 0 ? CIRCUIT_OK : CIRCUIT_ERR_ALLOC;
+                sl->n_factor = m->n_factor;
+            } else {
+                st = CIRCUIT_OK;
+            }
+            if (st == CIRCUIT_OK) {
+                circuit_mc_sample(net, sl->local, w->opt, r);
+                st = circuit_mna_operating_point(m);
+            }
+        }
+        if (st == CIRCUIT_OK) {
+            circuit_mna_store(m, row, 1);
+        } else {
+            for (size_t i = 0; i < net->n_nodes; i++) row[i] = NAN;
+            if (r < sl->first_fail) {
+                sl->first_fail = r;
+                sl->fail_status = st;
+            }
+        }
+    }
+}
+
+int circuit_monte_carlo_run(const circuit_netlist *net, size_t n_runs, const circuit_mc_options *opt,
+                            gsl_matrix *results) {
+    const circuit_mc_options defaults = { 0, CIRCUIT_MC_SIGMA, -1 };
+    if (!opt) opt = &defaults;
+    if (!net || !results || !(opt->sigma >= 0.0 && opt->sigma < 0.25)) return CIRCUIT_ERR_INVALID;
+    if (n_runs == 0) return CIRCUIT_OK;
+    if (results->size1 < n_runs || results->size2 < net->n_nodes) return CIRCUIT_ERR_INVALID;
+
+    int status;
+    circuit_mna *proto = circuit_mna_for(net, &status);
+    if (!proto) return status;
+    /* The nominal solution fixes the pivots every run starts from. */
+    circuit_mna_operating_point(proto);
+
+    /* The runs go to the holos_exec pool: n_threads of them at most, or
+       the whole pool if negative. */
+    const unsigned width = opt->n_threads < 0 ? 0 : opt->n_threads > 0 ? (unsigned)opt->n_threads : 1;
+    const unsigned n_slots = holos_exec_slots(width);
+    circuit_mc_work w = { net, opt, proto, results, calloc(n_slots, sizeof(circuit_mc_slot)) };
+    if (!w.slots) {
+        circuit_mna_free(proto);
+        return CIRCUIT_ERR_ALLOC;
+    }
+    for (unsigned k = 0; k < n_slots; k++) {
+        w.slots[k].first_fail = SIZE_MAX;
+        w.slots[k].fail_status = CIRCUIT_OK;
+    }
+    holos_exec_for(n_runs, 16, width, circuit_mc_range, &w);
+
+    size_t first_fail = SIZE_MAX;
+    int fail_status = CIRCUIT_OK;
+    for (unsigned k = 0; k < n_slots; k++) {
+        if (w.slots[k].first_fail < first_fail) {
+            first_fail = w.slots[k].first_fail;
+            fail_status = w.slots[k].fail_status;
+        }
+        circuit_mna_free(w.slots[k].m);
+        circuit_netlist_free(w.slots[k].local);
+    }
+    free(w.slots);
+    circuit_mna_free(proto);
+    return fail_status;
+}
+
+int circuit_monte_carlo_analysis(const circuit_netlist *net, size_t n_runs, gsl_matrix *results) {
+    return circuit_monte_carlo_run(net, n_runs, NULL, results);
+}
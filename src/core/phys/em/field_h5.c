@@ -0,0 +1,606 @@
+/* field_h5.c - Chunked HDF5 output of field grids for HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+   ----------------------------------------------------------------------
+   Datasets are made on the first write of their component, as long as
+   the frames so far (NaN fill), and extended a frame at a time; their
+   handles stay open until the file closes. The chunk shape and deflate
+   level are root attributes too, so that frames appended after a
+   reopen make new components alike.
+
+   HDF5 arrays are C ordered, so a grid's x, y, z are the last three
+   dimensions of a dataset: every hsize_t[] here is (frame,) z, y, x.
+
+   In a collective file every rank makes the same calls in the same
+   order; rank 0 alone writes the time of a frame and each rank selects
+   its own block of a component (possibly none).
+*/
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef HAVE_HDF5
+#include <hdf5.h>
+#endif
+
+#include "core/phys/em/field_h5.h"
+#ifdef HAVE_MPI
+#include "core/phys/em/grid_mpi.h"
+#endif
+
+#define FIELD_H5_FORMAT "holos-field"
+#define FIELD_H5_VERSION 1
+#define FIELD_H5_CHUNK (1u << 17)       /* Doubles per automatic chunk (1 MiB) */
+#define FIELD_H5_DEFLATE 4
+#define FIELD_H5_CACHE (16u << 20)      /* Chunk cache bytes per dataset */
+#define FIELD_H5_SETS 64                /* Components per file */
+#define FIELD_H5_TIME_CHUNK 1024
+
+#ifdef HAVE_HDF5
+
+typedef struct {
+    hid_t file, time, dxpl;
+    hsize_t chunk[3];               /* z, y, x */
+    int deflate;
+    int rank;                       /* Writes the time of frames if 0 */
+    char names[FIELD_H5_SETS][64];
+    hid_t sets[FIELD_H5_SETS];
+    size_t n_sets;
+} field_h5_work;
+
+/* -------------------------------
+   Attributes
+   ------------------------------- */
+
+static int field_h5_attr_write(hid_t obj, const char *name, hid_t type, size_t n, const void *value) {
+    const hsize_t dim = n;
+    const hid_t space = n ? H5Screate_simple(1, &dim, NULL) : H5Screate(H5S_SCALAR);
+    const hid_t attr = H5Acreate2(obj, name, type, space, H5P_DEFAULT, H5P_DEFAULT);
+    const int ok = attr >= 0 && H5Awrite(attr, type, value) >= 0;
+    if (attr >= 0) H5Aclose(attr);
+    H5Sclose(space);
+    return ok ? 0 : -1;
+}
+
+static int field_h5_attr_read(hid_t obj, const char *name, hid_t type, void *value) {
+    const hid_t attr = H5Aexists(obj, name) > 0 ? H5Aopen(obj, name, H5P_DEFAULT) : -1;
+    const int ok = attr >= 0 && H5Aread(attr, type, value) >= 0;
+    if (attr >= 0) H5Aclose(attr);
+    return ok ? 0 : -1;
+}
+
+static int field_h5_describe(hid_t file, const field_h5 *f, const field_h5_work *w) {
+    const hid_t str = H5Tcopy(H5T_C_S1);
+    const int version = FIELD_H5_VERSION;
+    const unsigned long long dims[3] = {f->dims[0], f->dims[1], f->dims[2]};
+    const unsigned long long chunk[3] = {w->chunk[2], w->chunk[1], w->chunk[0]};
+    int rc;
+    H5Tset_size(str, sizeof(FIELD_H5_FORMAT));
+    rc = field_h5_attr_write(file, "format", str, 0, FIELD_H5_FORMAT);
+    H5Tclose(str);
+    if (rc == 0) rc = field_h5_attr_write(file, "version", H5T_NATIVE_INT, 0, &version);
+    if (rc == 0) rc = field_h5_attr_write(file, "dims", H5T_NATIVE_ULLONG, 3, dims);
+    if (rc == 0) rc = field_h5_attr_write(file, "spacing", H5T_NATIVE_DOUBLE, 3, f->spacing);
+    if (rc == 0) rc = field_h5_attr_write(file, "chunk", H5T_NATIVE_ULLONG, 3, chunk);
+    if (rc == 0) rc = field_h5_attr_write(file, "deflate", H5T_NATIVE_INT, 0, &w->deflate);
+    return rc;
+}
+
+/* -------------------------------
+   Files
+   ------------------------------- */
+
+static field_h5 *field_h5_alloc(void) {
+    field_h5 *f = calloc(1, sizeof(*f));
+    field_h5_work *w = calloc(1, sizeof(*w));
+    if (!f || !w) {
+        free(f);
+        free(w);
+        return NULL;
+    }
+    w->file = w->time = -1;
+    w->dxpl = H5P_DEFAULT;
+    f->work = w;
+    return f;
+}
+
+/* Chunk, z y x, of about FIELD_H5_CHUNK doubles of whole x rows */
+static void field_h5_auto_chunk(const size_t dims[3], hsize_t chunk[3]) {
+    size_t left = FIELD_H5_CHUNK;
+    for (int a = 0; a < 3; a++) {
+        const size_t c = dims[a] < left ? dims[a] : left;
+        chunk[2 - a] = c ? c : 1;
+        left = left / chunk[2 - a] ? left / chunk[2 - a] : 1;
+    }
+}
+
+static field_h5 *field_h5_create_with(const char *path, const size_t dims[3], const double spacing[3],
+                                      const field_h5_params *prm, hid_t fapl) {
+    const hsize_t zero = 0, unlimited = H5S_UNLIMITED, time_chunk = FIELD_H5_TIME_CHUNK;
+    field_h5 *f;
+    field_h5_work *w;
+    hid_t space, dcpl;
+    if (!path || !dims || !dims[0] || !dims[1] || !dims[2] || !(f = field_h5_alloc())) return NULL;
+    w = f->work;
+    memcpy(f->dims, dims, sizeof(f->dims));
+    if (spacing) memcpy(f->spacing, spacing, sizeof(f->spacing));
+    f->writable = 1;
+    field_h5_auto_chunk(dims, w->chunk);
+    for (int a = 0; prm && a < 3; a++)
+        if (prm->chunk[a]) w->chunk[2 - a] = prm->chunk[a] < dims[a] ? prm->chunk[a] : dims[a];
+    w->deflate = !prm || !prm->deflate ? FIELD_H5_DEFLATE : prm->deflate < 0 ? -1 : prm->deflate > 9 ? 9 : prm->deflate;
+    if ((w->file = H5Fcreate(path, H5F_ACC_TRUNC, H5P_DEFAULT, fapl)) < 0 || field_h5_describe(w->file, f, w) != 0)
+        goto fail;
+    space = H5Screate_simple(1, &zero, &unlimited);
+    dcpl = H5Pcreate(H5P_DATASET_CREATE);
+    H5Pset_chunk(dcpl, 1, &time_chunk);
+    w->time = H5Dcreate2(w->file, "time", H5T_NATIVE_DOUBLE, space, H5P_DEFAULT, dcpl, H5P_DEFAULT);
+    H5Pclose(dcpl);
+    H5Sclose(space);
+    if (w->time < 0) goto fail;
+    return f;
+fail:
+    field_h5_close(f);
+    return NULL;
+}
+
+field_h5 *field_h5_create(const char *path, const size_t dims[3], const double spacing[3], const field_h5_params *prm) {
+    return field_h5_create_with(path, dims, spacing, prm, H5P_DEFAULT);
+}
+
+field_h5 *field_h5_open(const char *path, int writable) {
+    field_h5 *f;
+    field_h5_work *w;
+    char format[sizeof(FIELD_H5_FORMAT)] = "";
+    unsigned long long dims[3], chunk[3];
+    int version = 0;
+    hid_t str, space;
+    hsize_t frames;
+    if (!path || !(f = field_h5_alloc())) return NULL;
+    w = f->work;
+    f->writable = writable != 0;
+    if ((w->file = H5Fopen(path, writable ? H5F_ACC_RDWR : H5F_ACC_RDONLY, H5P_DEFAULT)) < 0) goto fail;
+    str = H5Tcopy(H5T_C_S1);
+    H5Tset_size(str, sizeof(format));
+    if (field_h5_attr_read(w->file, "format", str, format) != 0 || strcmp(format, FIELD_H5_FORMAT) != 0) {
+        H5Tclose(str);
+        goto fail;
+    }
+    H5Tclose(str);
+    if (field_h5_attr_read(w->file, "version", H5T_NATIVE_INT, &version) != 0 || version != FIELD_H5_VERSION
+        || field_h5_attr_read(w->file, "dims", H5T_NATIVE_ULLONG, dims) != 0
+        || field_h5_attr_read(w->file, "spacing", H5T_NATIVE_DOUBLE, f->spacing) != 0
+        || field_h5_attr_read(w->file, "chunk", H5T_NATIVE_ULLONG, chunk) != 0
+        || field_h5_attr_read(w->file, "deflate", H5T_NATIVE_INT, &w->deflate) != 0)
+        goto fail;
+    for (int a = 0; a < 3; a++) {
+        f->dims[a] = (size_t)dims[a];
+        w->chunk[2 - a] = chunk[a];
+    }
+    if ((w->time = H5Dopen2(w->file, "time", H5P_DEFAULT)) < 0) goto fail;
+    space = H5Dget_space(w->time);
+    H5Sget_simple_extent_dims(space, &frames, NULL);
+    H5Sclose(space);
+    f->n_frames = (size_t)frames;
+    return f;
+fail:
+    field_h5_close(f);
+    return NULL;
+}
+
+int field_h5_close(field_h5 *f) {
+    field_h5_work *w;
+    int ok = 1;
+    if (!f) return -1;
+    w = f->work;
+    for (size_t i = 0; i < w->n_sets; i++) ok = H5Dclose(w->sets[i]) >= 0 && ok;
+    if (w->time >= 0) ok = H5Dclose(w->time) >= 0 && ok;
+    if (w->dxpl != H5P_DEFAULT) H5Pclose(w->dxpl);
+    if (w->file >= 0) ok = H5Fclose(w->file) >= 0 && ok;
+    else ok = 0;
+    free(w);
+    free(f);
+    return ok ? 0 : -1;
+}
+
+/* -------------------------------
+   Frames
+   ------------------------------- */
+
+int field_h5_frame(field_h5 *f, double t) {
+    field_h5_work *w;
+    hsize_t n, extent;
+    hid_t space, mem;
+    int ok;
+    if (!f || !f->writable) return -1;
+    w = f->work;
+    n = f->n_frames;
+    extent = n + 1;
+    if (H5Dset_extent(w->time, &extent) < 0) return -1;
+    space = H5Dget_space(w->time);
+    mem = H5Screate(H5S_SCALAR);
+    if (w->rank == 0) {
+        const hsize_t one = 1;
+        H5Sselect_hyperslab(space, H5S_SELECT_SET, &n, NULL, &one, NULL);
+    } else {
+        H5Sselect_none(space);
+        H5Sselect_none(mem);
+    }
+    ok = H5Dwrite(w->time, H5T_NATIVE_DOUBLE, mem, space, w->dxpl, &t) >= 0;
+    H5Sclose(mem);
+    H5Sclose(space);
+    if (!ok) return -1;
+    f->n_frames++;
+    return 0;
+}
+
+/* The dataset of component name, made if make and it is new; -1 if none */
+static hid_t field_h5_set(const field_h5 *f, const char *name, int make) {
+    field_h5_work *w = f->work;
+    const hsize_t dims[4] = {f->n_frames, f->dims[2], f->dims[1], f->dims[0]};
+    const hsize_t max[4] = {H5S_UNLIMITED, f->dims[2], f->dims[1], f->dims[0]};
+    const hsize_t chunk[4] = {1, w->chunk[0], w->chunk[1], w->chunk[2]};
+    const double fill = NAN;
+    hid_t set, dapl, dcpl, space;
+    for (size_t i = 0; i < w->n_sets; i++)
+        if (strcmp(w->names[i], name) == 0) return w->sets[i];
+    if (w->n_sets == FIELD_H5_SETS || strlen(name) >= sizeof(w->names[0])) return -1;
+    dapl = H5Pcreate(H5P_DATASET_ACCESS);
+    H5Pset_chunk_cache(dapl, H5D_CHUNK_CACHE_NSLOTS_DEFAULT, FIELD_H5_CACHE, H5D_CHUNK_CACHE_W0_DEFAULT);
+    if (H5Lexists(w->file, name, H5P_DEFAULT) > 0) {
+        set = H5Dopen2(w->file, name, dapl);
+    } else if (make) {
+        dcpl = H5Pcreate(H5P_DATASET_CREATE);
+        H5Pset_chunk(dcpl, 4, chunk);
+        H5Pset_fill_value(dcpl, H5T_NATIVE_DOUBLE, &fill);
+        if (w->deflate >= 0 && H5Zfilter_avail(H5Z_FILTER_DEFLATE) > 0) {
+            H5Pset_shuffle(dcpl);
+            H5Pset_deflate(dcpl, (unsigned)w->deflate);
+        }
+        space = H5Screate_simple(4, dims, max);
+        set = H5Dcreate2(w->file, name, H5T_NATIVE_DOUBLE, space, H5P_DEFAULT, dcpl, dapl);
+        H5Sclose(space);
+        H5Pclose(dcpl);
+    } else {
+        set = -1;
+    }
+    H5Pclose(dapl);
+    if (set < 0) return -1;
+    strcpy(w->names[w->n_sets], name);
+    w->sets[w->n_sets++] = set;
+    return set;
+}
+
+int field_h5_write_block(field_h5 *f, const char *name, const double *data, const size_t local[3],
+                         const size_t lo[3], const size_t count[3], const size_t offset[3]) {
+    field_h5_work *w;
+    hsize_t extent[4], fstart[4], fcount[4], mdims[3], mstart[3], mcount[3];
+    hid_t set, fspace, mspace;
+    int empty = 0, ok;
+    if (!f || !f->writable || !name || !f->n_frames || !local || !lo || !count || !offset) return -1;
+    for (int a = 0; a < 3; a++) {
+        if (lo[a] + count[a] > local[a] || offset[a] + count[a] > f->dims[a]) return -1;
+        if (count[a] && !data) return -1;
+        empty |= count[a] == 0;
+        mdims[2 - a] = local[a] ? local[a] : 1;
+        mstart[2 - a] = lo[a];
+        mcount[2 - a] = count[a];
+        fstart[3 - a] = offset[a];
+        fcount[3 - a] = count[a];
+    }
+    w = f->work;
+    if ((set = field_h5_set(f, name, 1)) < 0) return -1;
+    fspace = H5Dget_space(set);
+    H5Sget_simple_extent_dims(fspace, extent, NULL);
+    if (extent[0] < f->n_frames) {
+        H5Sclose(fspace);
+        extent[0] = f->n_frames;
+        if (H5Dset_extent(set, extent) < 0) return -1;
+        fspace = H5Dget_space(set);
+    }
+    fstart[0] = f->n_frames - 1;
+    fcount[0] = 1;
+    mspace = H5Screate_simple(3, mdims, NULL);
+    if (empty) {
+        H5Sselect_none(fspace);
+        H5Sselect_none(mspace);
+    } else {
+        H5Sselect_hyperslab(fspace, H5S_SELECT_SET, fstart, NULL, fcount, NULL);
+        H5Sselect_hyperslab(mspace, H5S_SELECT_SET, mstart, NULL, mcount, NULL);
+    }
+    ok = H5Dwrite(set, H5T_NATIVE_DOUBLE, mspace, fspace, w->dxpl, data) >= 0;
+    H5Sclose(mspace);
+    H5Sclose(fspace);
+    return ok ? 0 : -1;
+}
+
+int field_h5_write(field_h5 *f, const char *name, const double *data) {
+    static const size_t zero[3] = {0, 0, 0};
+    if (!f) return -1;
+    return field_h5_write_block(f, name, data, f->dims, zero, f->dims, zero);
+}
+
+int field_h5_read(const field_h5 *f, const char *name, size_t frame, const size_t lo[3], const size_t count[3],
+                  double *out) {
+    hsize_t extent[4], start[4], n[4];
+    hid_t set, fspace, mspace;
+    size_t total = 1;
+    int ok;
+    if (!f || !name || !lo || !count || !out || frame >= f->n_frames) return -1;
+    for (int a = 0; a < 3; a++) {
+        if (!count[a] || lo[a] + count[a] > f->dims[a]) return -1;
+        start[3 - a] = lo[a];
+        n[3 - a] = count[a];
+        total *= count[a];
+    }
+    if ((set = field_h5_set(f, name, 0)) < 0) return -1;
+    fspace = H5Dget_space(set);
+    H5Sget_simple_extent_dims(fspace, extent, NULL);
+    if (frame >= extent[0]) {
+        /* A component first written after this frame */
+        H5Sclose(fspace);
+        for (size_t i = 0; i < total; i++) out[i] = NAN;
+        return 0;
+    }
+    start[0] = frame;
+    n[0] = 1;
+    H5Sselect_hyperslab(fspace, H5S_SELECT_SET, start, NULL, n, NULL);
+    mspace = H5Screate_simple(4, n, NULL);
+    ok = H5Dread(set, H5T_NATIVE_DOUBLE, mspace, fspace, H5P_DEFAULT, out) >= 0;
+    H5Sclose(mspace);
+    H5Sclose(fspace);
+    return ok ? 0 : -1;
+}
+
+double field_h5_time(const field_h5 *f, size_t frame) {
+    const field_h5_work *w;
+    const hsize_t at = frame, one = 1;
+    hid_t space, mem;
+    double t = NAN;
+    if (!f || frame >= f->n_frames) return NAN;
+    w = f->work;
+    space = H5Dget_space(w->time);
+    mem = H5Screate(H5S_SCALAR);
+    H5Sselect_hyperslab(space, H5S_SELECT_SET, &at, NULL, &one, NULL);
+    if (H5Dread(w->time, H5T_NATIVE_DOUBLE, mem, space, H5P_DEFAULT, &t) < 0) t = NAN;
+    H5Sclose(mem);
+    H5Sclose(space);
+    return t;
+}
+
+#else /* !HAVE_HDF5 */
+
+/* Built without --with-hdf5: no file can be made or opened. */
+
+field_h5 *field_h5_create(const char *path, const size_t dims[3], const double spacing[3], const field_h5_params *prm) {
+    (void)path;
+    (void)dims;
+    (void)spacing;
+    (void)prm;
+    return NULL;
+}
+
+field_h5 *field_h5_open(const char *path, int writable) {
+    (void)path;
+    (void)writable;
+    return NULL;
+}
+
+int field_h5_close(field_h5 *f) {
+    (void)f;
+    return -1;
+}
+
+int field_h5_frame(field_h5 *f, double t) {
+    (void)f;
+    (void)t;
+    return -1;
+}
+
+int field_h5_write_block(field_h5 *f, const char *name, const double *data, const size_t local[3],
+                         const size_t lo[3], const size_t count[3], const size_t offset[3]) {
+    (void)f;
+    (void)name;
+    (void)data;
+    (void)local;
+    (void)lo;
+    (void)count;
+    (void)offset;
+    return -1;
+}
+
+int field_h5_write(field_h5 *f, const char *name, const double *data) {
+    (void)f;
+    (void)name;
+    (void)data;
+    return -1;
+}
+
+int field_h5_read(const field_h5 *f, const char *name, size_t frame, const size_t lo[3], const size_t count[3],
+                  double *out) {
+    (void)f;
+    (void)name;
+    (void)frame;
+    (void)lo;
+    (void)count;
+    (void)out;
+    return -1;
+}
+
+double field_h5_time(const field_h5 *f, size_t frame) {
+    (void)f;
+    (void)frame;
+    return NAN;
+}
+
+#endif /* HAVE_HDF5 */
+
+/* -------------------------------
+   Grids
+   ------------------------------- */
+
+static const char *const field_h5_axes = "xyz";
+
+/* Writes name_a (a = x, y, z) gathered from vector field at of every
+   point, NaN where a point has none. */
+static int field_h5_gather(field_h5 *f, const char *name, size_t n, size_t a, double *buf,
+                           const gsl_vector *(*at)(const void *pts, size_t i), const void *pts) {
+    for (size_t i = 0; i < n; i++) {
+        const gsl_vector *v = at(pts, i);
+        buf[i] = v && a < v->size ? gsl_vector_get(v, a) : NAN;
+    }
+    return field_h5_write(f, name, buf);
+}
+
+static const gsl_vector *field_h5_maxwell_E(const void *pts, size_t i) {
+    return ((const maxwell_field_point *)pts)[i].E;
+}
+
+static const gsl_vector *field_h5_maxwell_B(const void *pts, size_t i) {
+    return ((const maxwell_field_point *)pts)[i].B;
+}
+
+static const gsl_vector *field_h5_wave_U(const void *pts, size_t i) {
+    return ((const wave_field_point *)pts)[i].U;
+}
+
+int maxwell_field_grid_h5_append(field_h5 *f, const maxwell_field_grid *grid) {
+    char name[8];
+    double *buf;
+    int rc;
+    if (!f || !grid) return -1;
+    if (grid->yee) {
+        const maxwell_yee_grid *g = grid->yee;
+        if (f->dims[0] != g->nx || f->dims[1] != g->ny || f->dims[2] != g->nz || field_h5_frame(f, grid->t) != 0)
+            return -1;
+        for (size_t a = 0; a < 3; a++) {
+            snprintf(name, sizeof(name), "E_%c", field_h5_axes[a]);
+            if (field_h5_write(f, name, g->E + a * g->n) != 0) return -1;
+            snprintf(name, sizeof(name), "H_%c", field_h5_axes[a]);
+            if (field_h5_write(f, name, g->H + a * g->n) != 0) return -1;
+        }
+        return 0;
+    }
+    if (!grid->n || f->dims[0] != grid->n || f->dims[1] != 1 || f->dims[2] != 1) return -1;
+    if (!(buf = malloc(grid->n * sizeof(double)))) return -1;
+    rc = field_h5_frame(f, grid->t);
+    for (size_t a = 0; a < 3 && rc == 0; a++) {
+        snprintf(name, sizeof(name), "E_%c", field_h5_axes[a]);
+        rc = field_h5_gather(f, name, grid->n, a, buf, field_h5_maxwell_E, grid->pts);
+        snprintf(name, sizeof(name), "B_%c", field_h5_axes[a]);
+        if (rc == 0) rc = field_h5_gather(f, name, grid->n, a, buf, field_h5_maxwell_B, grid->pts);
+    }
+    free(buf);
+    return rc;
+}
+
+int wave_field_grid_h5_append(field_h5 *f, const wave_field_grid *grid) {
+    const size_t width = grid && grid->n && grid->pts[0].U ? grid->pts[0].U->size : 0;
+    char name[24];
+    double *buf;
+    int rc;
+    if (!f || !grid || !grid->n || f->dims[0] != grid->n || f->dims[1] != 1 || f->dims[2] != 1) return -1;
+    if (!(buf = malloc(grid->n * sizeof(double)))) return -1;
+    for (size_t i = 0; i < grid->n; i++) buf[i] = grid->pts[i].u;
+    rc = field_h5_frame(f, grid->t);
+    if (rc == 0) rc = field_h5_write(f, "u", buf);
+    for (size_t a = 0; a < width && rc == 0; a++) {
+        snprintf(name, sizeof(name), "U_%zu", a);
+        rc = field_h5_gather(f, name, grid->n, a, buf, field_h5_wave_U, grid->pts);
+    }
+    free(buf);
+    return rc;
+}
+
+int wave_engine_h5_append(field_h5 *f, const wave_engine *e) {
+    if (!f || !e || f->dims[0] != e->nx || f->dims[1] != e->ny || f->dims[2] != e->nz) return -1;
+    if (field_h5_frame(f, e->t) != 0) return -1;
+    return field_h5_write(f, "u", e->buf[e->level % 3]);
+}
+
+/* -------------------------------
+   Distributed grids
+   ------------------------------- */
+
+#ifdef HAVE_MPI
+
+field_h5 *field_h5_create_mpi(MPI_Comm comm, const char *path, const size_t dims[3], const double spacing[3],
+                              const field_h5_params *prm) {
+#if defined(HAVE_HDF5) && defined(H5_HAVE_PARALLEL)
+    const hid_t fapl = H5Pcreate(H5P_FILE_ACCESS);
+    field_h5 *f;
+    int ok, all;
+    H5Pset_fapl_mpio(fapl, comm, MPI_INFO_NULL);
+    f = field_h5_create_with(path, dims, spacing, prm, fapl);
+    H5Pclose(fapl);
+    if (f) {
+        field_h5_work *w = f->work;
+        MPI_Comm_rank(comm, &w->rank);
+        w->dxpl = H5Pcreate(H5P_DATASET_XFER);
+        H5Pset_dxpl_mpio(w->dxpl, H5FD_MPIO_COLLECTIVE);
+    }
+    ok = f != NULL;
+    MPI_Allreduce(&ok, &all, 1, MPI_INT, MPI_LAND, comm);
+    if (!all && f) {
+        field_h5_close(f);
+        f = NULL;
+    }
+    return f;
+#else
+    (void)comm;
+    (void)path;
+    (void)dims;
+    (void)spacing;
+    (void)prm;
+    return NULL;
+#endif
+}
+
+int maxwell_mpi_grid_h5_append(field_h5 *f, const maxwell_mpi_grid *m) {
+    const grid_mpi_decomp *d;
+    const maxwell_yee_grid *g;
+    char name[8];
+    if (!f || !m) return -1;
+    d = &m->d;
+    g = m->grid->yee;
+    if (memcmp(f->dims, d->global, sizeof(f->dims)) != 0 || field_h5_frame(f, m->grid->t) != 0) return -1;
+    for (size_t a = 0; a < 3; a++) {
+        snprintf(name, sizeof(name), "E_%c", field_h5_axes[a]);
+        if (field_h5_write_block(f, name, g->E + a * g->n, d->local, d->io_lo, d->io_count, d->io_offset) != 0)
+            return -1;
+        snprintf(name, sizeof(name), "H_%c", field_h5_axes[a]);
+        if (field_h5_write_block(f, name, g->H + a * g->n, d->local, d->io_lo, d->io_count, d->io_offset) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+int wave_mpi_engine_h5_append(field_h5 *f, const wave_mpi_engine *w) {
+    const grid_mpi_decomp *d;
+    const wave_engine *e;
+    if (!f || !w) return -1;
+    d = &w->d;
+    e = w->engine;
+    if (memcmp(f->dims, d->global, sizeof(f->dims)) != 0 || field_h5_frame(f, e->t) != 0) return -1;
+    return field_h5_write_block(f, "u", e->buf[e->level % 3], d->local, d->io_lo, d->io_count, d->io_offset);
+}
+
+#endif /* HAVE_MPI */
@@ -0,0 +1,489 @@
+/* grid_mpi.c - Distributed Maxwell and wave grids for HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+
+#include "core/phys/em/grid_mpi.h"
+
+/* Face exchange directions. */
+#define GRID_MPI_TO_LO 0x1      /* First owned layer to the low neighbor, high ghost filled */
+#define GRID_MPI_TO_HI 0x2      /* Last owned layer to the high neighbor, low ghost filled */
+
+/* -------------------------------
+   Decomposition
+   ------------------------------- */
+
+/* Even split of count layers over parts; part p gets *len from *start. */
+static void grid_mpi_split(size_t count, int parts, int p, size_t *start, size_t *len) {
+    const size_t q = count / (size_t)parts, r = count % (size_t)parts, pp = (size_t)p;
+    *len = q + (pp < r ? 1 : 0);
+    *start = pp * q + (pp < r ? pp : r);
+}
+
+/*
+    Cells: every cell is owned by one rank and ghosts sit only where a
+    neighbor rank exists (walls are handled by the local grid).
+    Points (wave): the interior points are split and every decomposed axis
+    carries one extra layer per side, a ghost or the fixed outer layer.
+*/
+static int grid_mpi_decompose(MPI_Comm comm, const size_t global[3], const int periodic[3], int points,
+                              grid_mpi_decomp *d) {
+    memset(d, 0, sizeof(*d));
+    d->comm = MPI_COMM_NULL;
+    int size;
+    MPI_Comm_size(comm, &size);
+    int dims[3] = { 1, global[1] > 1 ? 0 : 1, global[2] > 1 ? 0 : 1 };
+    if (dims[1] == 1 && dims[2] == 1 && size > 1) return -1;
+    if (MPI_Dims_create(size, 3, dims) != MPI_SUCCESS) return -1;
+    for (int a = 1; a < 3; a++) {
+        const size_t split = points ? global[a] - 2 : global[a];
+        if (dims[a] > 1 && (global[a] < 3 || split < (size_t)dims[a])) return -1;
+    }
+
+    int periods[3] = { 0, 0, 0 };
+    for (int a = 0; a < 3; a++) periods[a] = !points && periodic && periodic[a] && dims[a] > 1;
+    if (MPI_Cart_create(comm, 3, dims, periods, 0, &d->comm) != MPI_SUCCESS) return -1;
+    MPI_Comm_rank(d->comm, &d->rank);
+    d->size = size;
+    MPI_Cart_coords(d->comm, d->rank, 3, d->coords);
+
+    for (int a = 0; a < 3; a++) {
+        d->dims[a] = dims[a];
+        d->global[a] = global[a];
+        MPI_Cart_shift(d->comm, a, 1, &d->nbr_lo[a], &d->nbr_hi[a]);
+        if (dims[a] == 1) {
+            d->nbr_lo[a] = d->nbr_hi[a] = MPI_PROC_NULL;
+            d->local[a] = d->owned[a] = d->io_count[a] = global[a];
+            continue;
+        }
+        const int first = d->coords[a] == 0, last = d->coords[a] == dims[a] - 1;
+        size_t start, len;
+        if (points) {
+            grid_mpi_split(global[a] - 2, dims[a], d->coords[a], &start, &len);
+            d->lo[a] = 1;
+            d->owned[a] = len;
+            d->offset[a] = 1 + start;
+            d->local[a] = len + 2;
+            d->io_lo[a] = first ? 0 : 1;
+            d->io_count[a] = len + (size_t)first + (size_t)last;
+        } else {
+            grid_mpi_split(global[a], dims[a], d->coords[a], &start, &len);
+            const size_t glo = d->nbr_lo[a] != MPI_PROC_NULL, ghi = d->nbr_hi[a] != MPI_PROC_NULL;
+            d->lo[a] = glo;
+            d->owned[a] = len;
+            d->offset[a] = start;
+            d->local[a] = len + glo + ghi;
+            d->io_lo[a] = glo;
+            d->io_count[a] = len;
+        }
+        d->io_offset[a] = d->offset[a] - d->lo[a] + d->io_lo[a];
+    }
+    return 0;
+}
+
+static void grid_mpi_release(grid_mpi_decomp *d) {
+    if (d->comm != MPI_COMM_NULL) MPI_Comm_free(&d->comm);
+}
+
+int grid_mpi_local_index(const grid_mpi_decomp *d, size_t gi, size_t gj, size_t gk, size_t *idx) {
+    if (!d) return 0;
+    const size_t g[3] = { gi, gj, gk };
+    size_t l[3];
+    for (int a = 0; a < 3; a++) {
+        if (g[a] < d->io_offset[a] || g[a] >= d->io_offset[a] + d->io_count[a]) return 0;
+        l[a] = g[a] - d->io_offset[a] + d->io_lo[a];
+    }
+    if (idx) *idx = (l[2] * d->local[1] + l[1]) * d->local[0] + l[0];
+    return 1;
+}
+
+void grid_mpi_global_coords(const grid_mpi_decomp *d, size_t idx, size_t g[3]) {
+    const size_t l[3] = { idx % d->local[0], (idx / d->local[0]) % d->local[1], idx / (d->local[0] * d->local[1]) };
+    for (int a = 0; a < 3; a++) g[a] = d->offset[a] - d->lo[a] + l[a];
+}
+
+/* -------------------------------
+   Halo exchange
+   ------------------------------- */
+
+/*
+    Faces are the full x rows of one y (or z) layer over the owned range of
+    the other axis; the stencils have no diagonal terms, so edges and
+    corners never travel.
+*/
+typedef struct {
+    size_t ncomp;               /* Component blocks per field */
+    size_t n;                   /* Doubles per component block */
+    size_t face[3];             /* Doubles per face along y and z */
+    double *buf[3][4];          /* Send low, send high, receive low, receive high */
+    MPI_Request req[16];
+    int n_req;
+} grid_mpi_halo;
+
+static void grid_mpi_halo_free(grid_mpi_halo *h) {
+    if (!h) return;
+    for (int a = 1; a < 3; a++)
+        for (int b = 0; b < 4; b++) free(h->buf[a][b]);
+    free(h);
+}
+
+static grid_mpi_halo *grid_mpi_halo_alloc(const grid_mpi_decomp *d, size_t ncomp) {
+    grid_mpi_halo *h = calloc(1, sizeof(*h));
+    if (!h) return NULL;
+    h->ncomp = ncomp;
+    h->n = d->local[0] * d->local[1] * d->local[2];
+    for (int a = 1; a < 3; a++) {
+        if (d->dims[a] == 1) continue;
+        h->face[a] = ncomp * d->local[0] * d->owned[a == 1 ? 2 : 1];
+        for (int b = 0; b < 4; b++) {
+            h->buf[a][b] = malloc(h->face[a] * sizeof(double));
+            if (!h->buf[a][b]) {
+                grid_mpi_halo_free(h);
+                return NULL;
+            }
+        }
+    }
+    return h;
+}
+
+/* Copy layer `layer` of axis a between the field f and a face buffer. */
+static void grid_mpi_face(const grid_mpi_decomp *d, const grid_mpi_halo *h, double *f, int a, size_t layer,
+                          double *buf, int unpack) {
+    const size_t nx = d->local[0], ny = d->local[1], b = a == 1 ? 2 : 1;
+    for (size_t c = 0; c < h->ncomp; c++) {
+        double *blk = f + c * h->n;
+        for (size_t t = d->lo[b]; t < d->lo[b] + d->owned[b]; t++) {
+            const size_t row = a == 1 ? (t * ny + layer) * nx : (layer * ny + t) * nx;
+            if (unpack) memcpy(blk + row, buf, nx * sizeof(double));
+            else memcpy(buf, blk + row, nx * sizeof(double));
+            buf += nx;
+        }
+    }
+}
+
+static void grid_mpi_halo_begin(const grid_mpi_decomp *d, grid_mpi_halo *h, double *f, unsigned dirs) {
+    h->n_req = 0;
+    for (int a = 1; a < 3; a++) {
+        if (d->dims[a] == 1) continue;
+        const int cnt = (int)h->face[a];
+        if (dirs & GRID_MPI_TO_LO) {
+            const int tag = 4 * a;
+            MPI_Irecv(h->buf[a][3], cnt, MPI_DOUBLE, d->nbr_hi[a], tag, d->comm, &h->req[h->n_req++]);
+            if (d->nbr_lo[a] != MPI_PROC_NULL) grid_mpi_face(d, h, f, a, d->lo[a], h->buf[a][0], 0);
+            MPI_Isend(h->buf[a][0], cnt, MPI_DOUBLE, d->nbr_lo[a], tag, d->comm, &h->req[h->n_req++]);
+        }
+        if (dirs & GRID_MPI_TO_HI) {
+            const int tag = 4 * a + 1;
+            MPI_Irecv(h->buf[a][2], cnt, MPI_DOUBLE, d->nbr_lo[a], tag, d->comm, &h->req[h->n_req++]);
+            if (d->nbr_hi[a] != MPI_PROC_NULL)
+                grid_mpi_face(d, h, f, a, d->lo[a] + d->owned[a] - 1, h->buf[a][1], 0);
+            MPI_Isend(h->buf[a][1], cnt, MPI_DOUBLE, d->nbr_hi[a], tag, d->comm, &h->req[h->n_req++]);
+        }
+    }
+}
+
+static int grid_mpi_halo_end(const grid_mpi_decomp *d, grid_mpi_halo *h, double *f, unsigned dirs) {
+    if (MPI_Waitall(h->n_req, h->req, MPI_STATUSES_IGNORE) != MPI_SUCCESS) return -1;
+    h->n_req = 0;
+    for (int a = 1; a < 3; a++) {
+        if (d->dims[a] == 1) continue;
+        if ((dirs & GRID_MPI_TO_LO) && d->nbr_hi[a] != MPI_PROC_NULL)
+            grid_mpi_face(d, h, f, a, d->lo[a] + d->owned[a], h->buf[a][3], 1);
+        if ((dirs & GRID_MPI_TO_HI) && d->nbr_lo[a] != MPI_PROC_NULL)
+            grid_mpi_face(d, h, f, a, d->lo[a] - 1, h->buf[a][2], 1);
+    }
+    return 0;
+}
+
+/* -------------------------------
+   Overlapped row sweeps
+   ------------------------------- */
+
+typedef int (*grid_mpi_rows_fn)(void *ctx, size_t j0, size_t j1, size_t k0, size_t k1);
+
+/* Owned (j, k) rows around the ghost layers that exchange dirs fills:
+   frame = 0 sweeps the rows that never read those ghosts, frame = 1 the
+   layers next to them. */
+static int grid_mpi_rows(const grid_mpi_decomp *d, unsigned dirs, int frame, grid_mpi_rows_fn fn, void *ctx) {
+    size_t o0[3], o1[3], i0[3], i1[3];
+    for (int a = 1; a < 3; a++) {
+        o0[a] = d->lo[a];
+        o1[a] = d->lo[a] + d->owned[a];
+        const size_t slo = (dirs & GRID_MPI_TO_HI) && d->nbr_lo[a] != MPI_PROC_NULL;
+        const size_t shi = (dirs & GRID_MPI_TO_LO) && d->nbr_hi[a] != MPI_PROC_NULL;
+        i0[a] = o0[a] + slo < o1[a] ? o0[a] + slo : o1[a];
+        i1[a] = o1[a] - shi > i0[a] ? o1[a] - shi : i0[a];
+    }
+    if (!frame) return fn(ctx, i0[1], i1[1], i0[2], i1[2]);
+    if (fn(ctx, o0[1], o1[1], o0[2], i0[2]) != 0) return -1;
+    if (fn(ctx, o0[1], o1[1], i1[2], o1[2]) != 0) return -1;
+    if (fn(ctx, o0[1], i0[1], i0[2], i1[2]) != 0) return -1;
+    return fn(ctx, i1[1], o1[1], i0[2], i1[2]);
+}
+
+/* -------------------------------
+   Parallel I/O
+   ------------------------------- */
+
+/* Write (or read) nblk local blocks of n doubles as global blocks. */
+static int grid_mpi_io(const grid_mpi_decomp *d, const char *path, double *const *blk, size_t nblk, int write) {
+    int gs[3], ls[3], cnt[3], lst[3], gst[3];
+    for (int a = 0; a < 3; a++) {
+        gs[2 - a] = (int)d->global[a];
+        ls[2 - a] = (int)d->local[a];
+        cnt[2 - a] = (int)d->io_count[a];
+        lst[2 - a] = (int)d->io_lo[a];
+        gst[2 - a] = (int)d->io_offset[a];
+    }
+    MPI_Datatype mem, file;
+    MPI_Type_create_subarray(3, ls, cnt, lst, MPI_ORDER_C, MPI_DOUBLE, &mem);
+    MPI_Type_create_subarray(3, gs, cnt, gst, MPI_ORDER_C, MPI_DOUBLE, &file);
+    MPI_Type_commit(&mem);
+    MPI_Type_commit(&file);
+
+    MPI_File fh;
+    int rc = MPI_File_open(d->comm, path, write ? MPI_MODE_CREATE | MPI_MODE_WRONLY : MPI_MODE_RDONLY,
+                           MPI_INFO_NULL, &fh);
+    if (rc == MPI_SUCCESS) {
+        const MPI_Offset block = (MPI_Offset)(d->global[0] * d->global[1] * d->global[2] * sizeof(double));
+        if (write) MPI_File_set_size(fh, block * (MPI_Offset)nblk);
+        for (size_t b = 0; b < nblk && rc == MPI_SUCCESS; b++) {
+            rc = MPI_File_set_view(fh, block * (MPI_Offset)b, MPI_DOUBLE, file, "native", MPI_INFO_NULL);
+            if (rc != MPI_SUCCESS) break;
+            rc = write ? MPI_File_write_all(fh, blk[b], 1, mem, MPI_STATUS_IGNORE)
+                       : MPI_File_read_all(fh, blk[b], 1, mem, MPI_STATUS_IGNORE);
+        }
+        MPI_File_close(&fh);
+    }
+    MPI_Type_free(&mem);
+    MPI_Type_free(&file);
+    int ok = rc == MPI_SUCCESS, all;
+    MPI_Allreduce(&ok, &all, 1, MPI_INT, MPI_LAND, d->comm);
+    return all ? 0 : -1;
+}
+
+/* -------------------------------
+   Distributed Yee grid
+   ------------------------------- */
+
+maxwell_mpi_grid *maxwell_mpi_grid_alloc(MPI_Comm comm, size_t nx, size_t ny, size_t nz, double dx, double dy,
+                                         double dz, const maxwell_yee_boundary_t boundary[3]) {
+    if (nx == 0 || ny == 0 || nz == 0) return NULL;
+    maxwell_mpi_grid *m = calloc(1, sizeof(*m));
+    if (!m) return NULL;
+    const size_t global[3] = { nx, ny, nz };
+    int periodic[3];
+    for (int a = 0; a < 3; a++) periodic[a] = boundary && boundary[a] == MAXWELL_YEE_PERIODIC;
+    if (grid_mpi_decompose(comm, global, periodic, 0, &m->d) != 0) {
+        grid_mpi_release(&m->d);
+        free(m);
+        return NULL;
+    }
+    m->grid = maxwell_field_grid_alloc_yee(m->d.local[0], m->d.local[1], m->d.local[2], dx, dy, dz);
+    m->halo = grid_mpi_halo_alloc(&m->d, 3);
+    if (!m->grid || !m->halo) {
+        maxwell_mpi_grid_free(m);
+        return NULL;
+    }
+    /* Split axes meet their neighbors through ghosts; only unsplit axes wrap locally. */
+    for (int a = 0; a < 3; a++)
+        maxwell_yee_set_boundary(m->grid->yee, (size_t)a,
+                                 periodic[a] && m->d.dims[a] == 1 ? MAXWELL_YEE_PERIODIC : MAXWELL_YEE_PEC);
+    return m;
+}
+
+void maxwell_mpi_grid_free(maxwell_mpi_grid *m) {
+    if (!m) return;
+    maxwell_field_grid_free(m->grid);
+    grid_mpi_halo_free(m->halo);
+    grid_mpi_release(&m->d);
+    free(m);
+}
+
+int maxwell_mpi_grid_set_material_box(maxwell_mpi_grid *m, size_t i0, size_t i1, size_t j0, size_t j1,
+                                      size_t k0, size_t k1, unsigned index) {
+    if (!m) return -1;
+    size_t lo[3] = { i0, j0, k0 }, hi[3] = { i1, j1, k1 };
+    /* Ghost cells take the material too, so views of them stay consistent. */
+    for (int a = 0; a < 3; a++) {
+        const size_t base = m->d.offset[a] - m->d.lo[a];
+        lo[a] = lo[a] > base ? lo[a] - base : 0;
+        hi[a] = hi[a] > base ? hi[a] - base : 0;
+        if (hi[a] > m->d.local[a]) hi[a] = m->d.local[a];
+        if (lo[a] >= hi[a]) return 0;
+    }
+    return maxwell_yee_set_material_box(m->grid->yee, lo[0], hi[0], lo[1], hi[1], lo[2], hi[2], index);
+}
+
+int maxwell_mpi_grid_add_source(maxwell_mpi_grid *m, const maxwell_yee_source *src) {
+    if (!m || !src) return -1;
+    const size_t nx = m->d.global[0], ny = m->d.global[1];
+    if (src->idx >= nx * ny * m->d.global[2]) return -1;
+    size_t idx;
+    if (!grid_mpi_local_index(&m->d, src->idx % nx, (src->idx / nx) % ny, src->idx / (nx * ny), &idx)) return 0;
+    maxwell_yee_source local = *src;
+    local.idx = idx;
+    return maxwell_yee_add_source(m->grid->yee, &local) == 0 ? 1 : -1;
+}
+
+typedef struct {
+    maxwell_field_grid *grid;
+    double dt;
+    int field;
+} maxwell_mpi_sweep;
+
+static int maxwell_mpi_rows(void *ctx, size_t j0, size_t j1, size_t k0, size_t k1) {
+    const maxwell_mpi_sweep *s = ctx;
+    if (j0 >= j1 || k0 >= k1) return 0;
+    return maxwell_grid_fdtd_rows(s->grid, s->dt, s->field, j0, j1, k0, k1);
+}
+
+int maxwell_mpi_grid_step(maxwell_mpi_grid *m, double dt) {
+    if (!m || dt <= 0.0) return -1;
+    maxwell_yee_grid *g = m->grid->yee;
+    grid_mpi_halo *h = m->halo;
+    if (dt > maxwell_yee_max_dt(g)) return -1;
+
+    /* H reads E at +1: E ghosts come from the high neighbors. */
+    maxwell_mpi_sweep s = { m->grid, dt, 3 };
+    grid_mpi_halo_begin(&m->d, h, g->E, GRID_MPI_TO_LO);
+    int rc = grid_mpi_rows(&m->d, GRID_MPI_TO_LO, 0, maxwell_mpi_rows, &s);
+    if (grid_mpi_halo_end(&m->d, h, g->E, GRID_MPI_TO_LO) != 0) rc = -1;
+    if (rc == 0) rc = grid_mpi_rows(&m->d, GRID_MPI_TO_LO, 1, maxwell_mpi_rows, &s);
+
+    /* E reads H at -1: H ghosts come from the low neighbors. */
+    s.field = 0;
+    grid_mpi_halo_begin(&m->d, h, g->H, GRID_MPI_TO_HI);
+    if (rc == 0) rc = grid_mpi_rows(&m->d, GRID_MPI_TO_HI, 0, maxwell_mpi_rows, &s);
+    if (grid_mpi_halo_end(&m->d, h, g->H, GRID_MPI_TO_HI) != 0) rc = -1;
+    if (rc == 0) rc = grid_mpi_rows(&m->d, GRID_MPI_TO_HI, 1, maxwell_mpi_rows, &s);
+
+    int ok = rc == 0, all;
+    MPI_Allreduce(&ok, &all, 1, MPI_INT, MPI_LAND, m->d.comm);
+    if (!all) return -1;
+    m->grid->t += dt;
+    return 0;
+}
+
+double maxwell_mpi_grid_total_energy(const maxwell_mpi_grid *m) {
+    if (!m) return 0.0;
+    const maxwell_yee_grid *g = m->grid->yee;
+    const grid_mpi_decomp *d = &m->d;
+    double sum = 0.0;
+    for (size_t k = d->lo[2]; k < d->lo[2] + d->owned[2]; k++) {
+        for (size_t j = d->lo[1]; j < d->lo[1] + d->owned[1]; j++) {
+            for (size_t i = d->lo[0]; i < d->lo[0] + d->owned[0]; i++) {
+                const size_t c = maxwell_yee_index(g, i, j, k);
+                const maxwell_material *mat = &g->materials[g->material[c]];
+                double e2 = 0.0, h2 = 0.0;
+                for (size_t a = 0; a < 3; a++) {
+                    e2 += g->E[a * g->n + c] * g->E[a * g->n + c];
+                    h2 += g->H[a * g->n + c] * g->H[a * g->n + c];
+                }
+                sum += 0.5 * (mat->epsilon * e2 + mat->mu * h2);
+            }
+        }
+    }
+    double total = 0.0;
+    MPI_Allreduce(&sum, &total, 1, MPI_DOUBLE, MPI_SUM, d->comm);
+    return total * g->dx * g->dy * g->dz;
+}
+
+int maxwell_mpi_grid_write(const maxwell_mpi_grid *m, const char *path) {
+    if (!m || !path) return -1;
+    const maxwell_yee_grid *g = m->grid->yee;
+    double *const blk[6] = { g->E, g->E + g->n, g->E + 2 * g->n, g->H, g->H + g->n, g->H + 2 * g->n };
+    return grid_mpi_io(&m->d, path, blk, 6, 1);
+}
+
+int maxwell_mpi_grid_read(maxwell_mpi_grid *m, const char *path) {
+    if (!m || !path) return -1;
+    maxwell_yee_grid *g = m->grid->yee;
+    double *const blk[6] = { g->E, g->E + g->n, g->E + 2 * g->n, g->H, g->H + g->n, g->H + 2 * g->n };
+    return grid_mpi_io(&m->d, path, blk, 6, 0);
+}
+
+/* -------------------------------
+   Distributed wave engine
+   ------------------------------- */
+
+wave_mpi_engine *wave_mpi_engine_alloc(MPI_Comm comm, size_t nx, size_t ny, size_t nz, double dx, double dy,
+                                       double dz, double c, double dt) {
+    if (nx == 0 || ny == 0 || nz == 0) return NULL;
+    wave_mpi_engine *w = calloc(1, sizeof(*w));
+    if (!w) return NULL;
+    const size_t global[3] = { nx, ny, nz };
+    if (grid_mpi_decompose(comm, global, NULL, 1, &w->d) != 0) {
+        grid_mpi_release(&w->d);
+        free(w);
+        return NULL;
+    }
+    w->engine = wave_engine_alloc(w->d.local[0], w->d.local[1], w->d.local[2], dx, dy, dz, c, dt);
+    w->halo = grid_mpi_halo_alloc(&w->d, 1);
+    if (!w->engine || !w->halo) {
+        wave_mpi_engine_free(w);
+        return NULL;
+    }
+    return w;
+}
+
+void wave_mpi_engine_free(wave_mpi_engine *w) {
+    if (!w) return;
+    wave_engine_free(w->engine);
+    grid_mpi_halo_free(w->halo);
+    grid_mpi_release(&w->d);
+    free(w);
+}
+
+static int wave_mpi_rows(void *ctx, size_t j0, size_t j1, size_t k0, size_t k1) {
+    if (j0 >= j1 || k0 >= k1) return 0;
+    return wave_engine_step_rows(ctx, j0, j1, k0, k1);
+}
+
+int wave_mpi_engine_step(wave_mpi_engine *w, size_t n_steps) {
+    if (!w) return -1;
+    const unsigned both = GRID_MPI_TO_LO | GRID_MPI_TO_HI;
+    int rc = 0;
+    for (size_t s = 0; s < n_steps && rc == 0; s++) {
+        double *u = wave_engine_u(w->engine);
+        grid_mpi_halo_begin(&w->d, w->halo, u, both);
+        rc = grid_mpi_rows(&w->d, both, 0, wave_mpi_rows, w->engine);
+        if (grid_mpi_halo_end(&w->d, w->halo, u, both) != 0) rc = -1;
+        if (rc == 0) rc = grid_mpi_rows(&w->d, both, 1, wave_mpi_rows, w->engine);
+        if (rc == 0) rc = wave_engine_advance(w->engine);
+    }
+    int ok = rc == 0, all;
+    MPI_Allreduce(&ok, &all, 1, MPI_INT, MPI_LAND, w->d.comm);
+    return all ? 0 : -1;
+}
+
+int wave_mpi_engine_write(const wave_mpi_engine *w, const char *path) {
+    if (!w || !path) return -1;
+    wave_engine *e = w->engine;
+    double *const blk[2] = { e->buf[e->level % 3], e->buf[(e->level + 2) % 3] };
+    return grid_mpi_io(&w->d, path, blk, 2, 1);
+}
+
+int wave_mpi_engine_read(wave_mpi_engine *w, const char *path) {
+    if (!w || !path) return -1;
+    double *const blk[2] = { wave_engine_u(w->engine), wave_engine_u_prev(w->engine) };
+    return grid_mpi_io(&w->d, path, blk, 2, 0);
+}
@@ -0,0 +1,347 @@
+#include <stdlib.h>
+#include <math.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include <gsl/gsl_vector.h>
+
+#include "core/phys/em/lorentz_forces.h"
+#include "core/phys/pair_kernel.h"
+
+/* -------------------------------
+   Pairwise Coulomb interaction
+   ------------------------------- */
+
+int lorentz_system_compute_coulomb(const lorentz_system *sys, double k_e, double eps,
+                                   gsl_vector **F_array) {
+    if (!sys || !F_array) return -1;
+    const size_t n = sys->n;
+    if (n == 0) return 0;
+
+    /* Gather into x|y|z|q|fx|fy|fz blocks so the kernel sees contiguous components. */
+    double *buf = calloc(7 * n, sizeof(double));
+    if (!buf) return -1;
+    double *x = buf, *y = x + n, *z = y + n, *q = z + n;
+    double *fx = q + n, *fy = fx + n, *fz = fy + n;
+
+    for (size_t i = 0; i < n; i++) {
+        const lorentz_particle *p = &sys->particles[i];
+        if (!p->pos || !F_array[i]) { free(buf); return -1; }
+        x[i] = gsl_vector_get(p->pos, 0);
+        y[i] = gsl_vector_get(p->pos, 1);
+        z[i] = gsl_vector_get(p->pos, 2);
+        q[i] = p->q;
+    }
+
+    /* Like charges repel: the kernel sums along (r_j - r_i), so flip the sign. */
+    pk_inverse_square(x, y, z, q, n, 0, n, -k_e, eps * eps, fx, fy, fz);
+
+    for (size_t i = 0; i < n; i++) {
+        double *f = F_array[i]->data;
+        const size_t s = F_array[i]->stride;
+        f[0]     += fx[i];
+        f[s]     += fy[i];
+        f[2 * s] += fz[i];
+    }
+    free(buf);
+    return 0;
+}
+
+/* -------------------------------
+   SoA particle pusher
+   ------------------------------- */
+
+#define LORENTZ_SOA_BLOCK 256       /* Particles per work item (6 field blocks fit in L1) */
+
+lorentz_soa *lorentz_soa_alloc(size_t n) {
+    lorentz_soa *s = calloc(1, sizeof(*s));
+    if (!s) return NULL;
+    s->mem = calloc(8 * (n ? n : 1), sizeof(double));
+    if (!s->mem) { free(s); return NULL; }
+    s->n = n;
+    s->x = s->mem;
+    s->y = s->x + n;
+    s->z = s->y + n;
+    s->ux = s->z + n;
+    s->uy = s->ux + n;
+    s->uz = s->uy + n;
+    s->qm = s->uz + n;
+    s->gamma = s->qm + n;
+    for (size_t i = 0; i < n; i++) s->gamma[i] = 1.0;
+    return s;
+}
+
+void lorentz_soa_free(lorentz_soa *s) {
+    if (!s) return;
+    free(s->mem);
+    free(s);
+}
+
+int lorentz_soa_set_threads(lorentz_soa *s, int n_threads) {
+    if (!s) return -1;
+    if (n_threads < 0) {
+#ifdef _OPENMP
+        n_threads = omp_get_max_threads();
+#else
+        n_threads = 1;
+#endif
+    }
+    s->n_threads = n_threads;
+    return n_threads;
+}
+
+int lorentz_soa_gather(lorentz_soa *s, const lorentz_system *sys) {
+    if (!s || !sys || sys->n != s->n) return -1;
+    const double c2inv = 1.0 / (LORENTZ_C * LORENTZ_C);
+    for (size_t i = 0; i < s->n; i++) {
+        const lorentz_particle *p = &sys->particles[i];
+        if (!p->pos || !p->vel || !(p->m > 0.0)) return -1;
+        const double vx = gsl_vector_get(p->vel, 0), vy = gsl_vector_get(p->vel, 1), vz = gsl_vector_get(p->vel, 2);
+        const double beta2 = (vx * vx + vy * vy + vz * vz) * c2inv;
+        if (!(beta2 < 1.0)) return -1;
+        const double gamma = 1.0 / sqrt(1.0 - beta2);
+        s->x[i] = gsl_vector_get(p->pos, 0);
+        s->y[i] = gsl_vector_get(p->pos, 1);
+        s->z[i] = gsl_vector_get(p->pos, 2);
+        s->ux[i] = gamma * vx;
+        s->uy[i] = gamma * vy;
+        s->uz[i] = gamma * vz;
+        s->qm[i] = p->q / p->m;
+        s->gamma[i] = gamma;
+    }
+    return 0;
+}
+
+int lorentz_soa_scatter(const lorentz_soa *s, lorentz_system *sys) {
+    if (!s || !sys || sys->n != s->n) return -1;
+    for (size_t i = 0; i < s->n; i++) {
+        lorentz_particle *p = &sys->particles[i];
+        if (!p->pos || !p->vel) return -1;
+        const double w = 1.0 / s->gamma[i];
+        gsl_vector_set(p->pos, 0, s->x[i]);
+        gsl_vector_set(p->pos, 1, s->y[i]);
+        gsl_vector_set(p->pos, 2, s->z[i]);
+        gsl_vector_set(p->vel, 0, w * s->ux[i]);
+        gsl_vector_set(p->vel, 1, w * s->uy[i]);
+        gsl_vector_set(p->vel, 2, w * s->uz[i]);
+        p->gamma = s->gamma[i];
+        p->energy = s->gamma[i] * p->m * LORENTZ_C * LORENTZ_C;
+    }
+    return 0;
+}
+
+/* One Yee axis as seen by the interpolator. */
+typedef struct {
+    size_t n;
+    double inv_h;
+    int periodic;
+} lorentz_yee_axis;
+
+/* Bracketing samples i0, i1 and weight f of i1 for a component sitting at
+   offset off (0 or 1/2 cell) along one axis. Invariant axes collapse to a
+   single sample; clamping keeps i0 <= n - 2 so f stays in [0, 1]. */
+static inline void lorentz_yee_locate(const lorentz_yee_axis *a, double pos, double off,
+                                      size_t *i0, size_t *i1, double *f) {
+    if (a->n == 1) {
+        *i0 = *i1 = 0;
+        *f = 0.0;
+        return;
+    }
+    double u = pos * a->inv_h - off;
+    if (a->periodic) {
+        const double fl = floor(u);
+        long i = (long)fl % (long)a->n;
+        if (i < 0) i += (long)a->n;
+        *i0 = (size_t)i;
+        *i1 = (size_t)i + 1 == a->n ? 0 : (size_t)i + 1;
+        *f = u - fl;
+    } else {
+        u = fmin(fmax(u, 0.0), (double)(a->n - 1));
+        const double fl = fmin(floor(u), (double)(a->n - 2));
+        *i0 = (size_t)fl;
+        *i1 = *i0 + 1;
+        *f = u - fl;
+    }
+}
+
+/* Trilinear sample of one component block F. */
+static inline double lorentz_yee_trilinear(const double *F, size_t nx, size_t ny,
+                                           size_t i0, size_t i1, double fx,
+                                           size_t j0, size_t j1, double fy,
+                                           size_t k0, size_t k1, double fz) {
+    const size_t r00 = (k0 * ny + j0) * nx, r10 = (k0 * ny + j1) * nx;
+    const size_t r01 = (k1 * ny + j0) * nx, r11 = (k1 * ny + j1) * nx;
+    const double c00 = F[r00 + i0] + fx * (F[r00 + i1] - F[r00 + i0]);
+    const double c10 = F[r10 + i0] + fx * (F[r10 + i1] - F[r10 + i0]);
+    const double c01 = F[r01 + i0] + fx * (F[r01 + i1] - F[r01 + i0]);
+    const double c11 = F[r11 + i0] + fx * (F[r11 + i1] - F[r11 + i0]);
+    const double c0 = c00 + fy * (c10 - c00), c1 = c01 + fy * (c11 - c01);
+    return c0 + fz * (c1 - c0);
+}
+
+/* Add the grid's E and B at (px, py, pz) to e[] and b[]. */
+static inline void lorentz_yee_sample(const maxwell_yee_grid *g, const lorentz_yee_axis ax[3],
+                                      double px, double py, double pz, double e[3], double b[3]) {
+    size_t i0, i1, ih0, ih1, j0, j1, jh0, jh1, k0, k1, kh0, kh1;
+    double fx, fxh, fy, fyh, fz, fzh;
+    lorentz_yee_locate(&ax[0], px, 0.0, &i0, &i1, &fx);
+    lorentz_yee_locate(&ax[0], px, 0.5, &ih0, &ih1, &fxh);
+    lorentz_yee_locate(&ax[1], py, 0.0, &j0, &j1, &fy);
+    lorentz_yee_locate(&ax[1], py, 0.5, &jh0, &jh1, &fyh);
+    lorentz_yee_locate(&ax[2], pz, 0.0, &k0, &k1, &fz);
+    lorentz_yee_locate(&ax[2], pz, 0.5, &kh0, &kh1, &fzh);
+
+    const size_t n = g->n, nx = g->nx, ny = g->ny;
+    const double *E = g->E, *H = g->H;
+    e[0] += lorentz_yee_trilinear(E,         nx, ny, ih0, ih1, fxh, j0, j1, fy, k0, k1, fz);
+    e[1] += lorentz_yee_trilinear(E + n,     nx, ny, i0, i1, fx, jh0, jh1, fyh, k0, k1, fz);
+    e[2] += lorentz_yee_trilinear(E + 2 * n, nx, ny, i0, i1, fx, j0, j1, fy, kh0, kh1, fzh);
+
+    /* mu of the cell holding the particle: the lower offset-0 sample,
+       except on the clamped upper face where f reaches 1. */
+    const size_t ci = fx < 1.0 ? i0 : i1, cj = fy < 1.0 ? j0 : j1, ck = fz < 1.0 ? k0 : k1;
+    const double mu = g->materials[g->material[(ck * ny + cj) * nx + ci]].mu;
+    b[0] += mu * lorentz_yee_trilinear(H,         nx, ny, i0, i1, fx, jh0, jh1, fyh, kh0, kh1, fzh);
+    b[1] += mu * lorentz_yee_trilinear(H + n,     nx, ny, ih0, ih1, fxh, j0, j1, fy, kh0, kh1, fzh);
+    b[2] += mu * lorentz_yee_trilinear(H + 2 * n, nx, ny, ih0, ih1, fxh, jh0, jh1, fyh, k0, k1, fz);
+}
+
+/* Fields at each particle of a block, component blocks of LORENTZ_SOA_BLOCK. */
+typedef struct {
+    double ex[LORENTZ_SOA_BLOCK], ey[LORENTZ_SOA_BLOCK], ez[LORENTZ_SOA_BLOCK];
+    double bx[LORENTZ_SOA_BLOCK], by[LORENTZ_SOA_BLOCK], bz[LORENTZ_SOA_BLOCK];
+} lorentz_soa_fields;
+
+/* Boris rotation for particles [lo, hi), fields in f[0 .. hi - lo). */
+static void lorentz_boris_block(lorentz_soa *s, const lorentz_soa_fields *f, double dt, size_t lo, size_t hi) {
+    double *restrict x = s->x + lo, *restrict y = s->y + lo, *restrict z = s->z + lo;
+    double *restrict ux = s->ux + lo, *restrict uy = s->uy + lo, *restrict uz = s->uz + lo;
+    double *restrict gam = s->gamma + lo;
+    const double *restrict qm = s->qm + lo;
+    const double *restrict ex = f->ex, *restrict ey = f->ey, *restrict ez = f->ez;
+    const double *restrict bx = f->bx, *restrict by = f->by, *restrict bz = f->bz;
+    const double c2inv = 1.0 / (LORENTZ_C * LORENTZ_C);
+
+    #pragma omp simd
+    for (size_t i = 0; i < hi - lo; i++) {
+        const double h = 0.5 * dt * qm[i];
+
+        /* Half electric kick, magnetic rotation at gamma-, half kick. */
+        const double mx = ux[i] + h * ex[i], my = uy[i] + h * ey[i], mz = uz[i] + h * ez[i];
+        const double w = h / sqrt(1.0 + (mx * mx + my * my + mz * mz) * c2inv);
+        const double tx = w * bx[i], ty = w * by[i], tz = w * bz[i];
+        const double sw = 2.0 / (1.0 + tx * tx + ty * ty + tz * tz);
+        const double px = mx + (my * tz - mz * ty), py = my + (mz * tx - mx * tz), pz = mz + (mx * ty - my * tx);
+        const double nx = mx + sw * (py * tz - pz * ty) + h * ex[i];
+        const double ny = my + sw * (pz * tx - px * tz) + h * ey[i];
+        const double nz = mz + sw * (px * ty - py * tx) + h * ez[i];
+
+        const double gn = sqrt(1.0 + (nx * nx + ny * ny + nz * nz) * c2inv), vw = dt / gn;
+        ux[i] = nx;
+        uy[i] = ny;
+        uz[i] = nz;
+        gam[i] = gn;
+        x[i] += vw * nx;
+        y[i] += vw * ny;
+        z[i] += vw * nz;
+    }
+}
+
+/* Vay (2008) update for particles [lo, hi), fields in f[0 .. hi - lo). */
+static void lorentz_vay_block(lorentz_soa *s, const lorentz_soa_fields *f, double dt, size_t lo, size_t hi) {
+    double *restrict x = s->x + lo, *restrict y = s->y + lo, *restrict z = s->z + lo;
+    double *restrict ux = s->ux + lo, *restrict uy = s->uy + lo, *restrict uz = s->uz + lo;
+    double *restrict gam = s->gamma + lo;
+    const double *restrict qm = s->qm + lo;
+    const double *restrict ex = f->ex, *restrict ey = f->ey, *restrict ez = f->ez;
+    const double *restrict bx = f->bx, *restrict by = f->by, *restrict bz = f->bz;
+    const double c2inv = 1.0 / (LORENTZ_C * LORENTZ_C);
+
+    #pragma omp simd
+    for (size_t i = 0; i < hi - lo; i++) {
+        const double h = 0.5 * dt * qm[i];
+
+        /* u' = u + h (2E + v x B), then solve for gamma at n+1/2 in closed form. */
+        const double vw = 1.0 / gam[i];
+        const double vx = vw * ux[i], vy = vw * uy[i], vz = vw * uz[i];
+        const double qx = ux[i] + h * (2.0 * ex[i] + vy * bz[i] - vz * by[i]);
+        const double qy = uy[i] + h * (2.0 * ey[i] + vz * bx[i] - vx * bz[i]);
+        const double qz = uz[i] + h * (2.0 * ez[i] + vx * by[i] - vy * bx[i]);
+        const double tx = h * bx[i], ty = h * by[i], tz = h * bz[i];
+        const double tau2 = tx * tx + ty * ty + tz * tz;
+        const double ustar = (qx * tx + qy * ty + qz * tz) / LORENTZ_C;
+        const double sigma = 1.0 + (qx * qx + qy * qy + qz * qz) * c2inv - tau2;
+        const double gn = sqrt(0.5 * (sigma + sqrt(sigma * sigma + 4.0 * (tau2 + ustar * ustar))));
+
+        const double rx = tx / gn, ry = ty / gn, rz = tz / gn;
+        const double sw = 1.0 / (1.0 + rx * rx + ry * ry + rz * rz);
+        const double qr = qx * rx + qy * ry + qz * rz;
+        const double nx = sw * (qx + qr * rx + (qy * rz - qz * ry));
+        const double ny = sw * (qy + qr * ry + (qz * rx - qx * rz));
+        const double nz = sw * (qz + qr * rz + (qx * ry - qy * rx));
+
+        const double dw = dt / gn;
+        ux[i] = nx;
+        uy[i] = ny;
+        uz[i] = nz;
+        gam[i] = gn;
+        x[i] += dw * nx;
+        y[i] += dw * ny;
+        z[i] += dw * nz;
+    }
+}
+
+/* Gather fields for particles [lo, hi) into f, then push them. */
+static void lorentz_push_block(lorentz_soa *s, const maxwell_yee_grid *g, const lorentz_yee_axis ax[3],
+                               const double E0[3], const double B0[3], lorentz_pusher_t pusher, double dt,
+                               size_t lo, size_t hi, lorentz_soa_fields *f) {
+    const size_t m = hi - lo;
+    for (size_t i = 0; i < m; i++) {
+        double e[3] = { E0[0], E0[1], E0[2] }, b[3] = { B0[0], B0[1], B0[2] };
+        if (g) lorentz_yee_sample(g, ax, s->x[lo + i], s->y[lo + i], s->z[lo + i], e, b);
+        f->ex[i] = e[0];
+        f->ey[i] = e[1];
+        f->ez[i] = e[2];
+        f->bx[i] = b[0];
+        f->by[i] = b[1];
+        f->bz[i] = b[2];
+    }
+    if (pusher == LORENTZ_PUSH_VAY) lorentz_vay_block(s, f, dt, lo, hi);
+    else lorentz_boris_block(s, f, dt, lo, hi);
+}
+
+int lorentz_soa_push(lorentz_soa *s, const maxwell_field_grid *grid, const double E0[3], const double B0[3],
+                     lorentz_pusher_t pusher, double dt) {
+    if (!s) return -1;
+    if (pusher != LORENTZ_PUSH_BORIS && pusher != LORENTZ_PUSH_VAY) return -1;
+    const maxwell_yee_grid *g = NULL;
+    lorentz_yee_axis ax[3] = { { 0 } };
+    if (grid) {
+        g = grid->yee;
+        if (!g) return -1;
+        const size_t n[3] = { g->nx, g->ny, g->nz };
+        const double h[3] = { g->dx, g->dy, g->dz };
+        for (int a = 0; a < 3; a++) {
+            ax[a].n = n[a];
+            ax[a].inv_h = 1.0 / h[a];
+            ax[a].periodic = g->boundary[a] == MAXWELL_YEE_PERIODIC;
+        }
+    }
+    const double e0[3] = { E0 ? E0[0] : 0.0, E0 ? E0[1] : 0.0, E0 ? E0[2] : 0.0 };
+    const double b0[3] = { B0 ? B0[0] : 0.0, B0 ? B0[1] : 0.0, B0 ? B0[2] : 0.0 };
+
+    const size_t n_blocks = (s->n + LORENTZ_SOA_BLOCK - 1) / LORENTZ_SOA_BLOCK;
+    const int nt = s->n_threads > 0 ? s->n_threads : 1;
+    #pragma omp parallel num_threads(nt) if(nt > 1)
+    {
+        /* Per-thread field scratch: one block stays in L1 between gather and push. */
+        lorentz_soa_fields f;
+        #pragma omp for schedule(static)
+        for (size_t blk = 0; blk < n_blocks; blk++) {
+            const size_t lo = blk * LORENTZ_SOA_BLOCK;
+            const size_t hi = lo + LORENTZ_SOA_BLOCK < s->n ? lo + LORENTZ_SOA_BLOCK : s->n;
+            lorentz_push_block(s, g, ax, e0, b0, pusher, dt, lo, hi, &f);
+        }
+    }
+    return 0;
+}
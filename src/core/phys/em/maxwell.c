@@ -0,0 +1,487 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <string.h>
+#include <math.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include <gsl/gsl_vector.h>
+#include <gsl/gsl_matrix.h>
+
+#include "core/phys/em/maxwell.h"
+#include "core/trace/trace.h"
+
+#define MAXWELL_EPSILON0 8.8541878128e-12   /* Vacuum permittivity [F/m] */
+#define MAXWELL_MU0      1.25663706212e-6   /* Vacuum permeability [H/m] */
+
+/* -------------------------------
+   Field points and point grids
+   ------------------------------- */
+
+static int maxwell_point_init(maxwell_field_point *pt) {
+    memset(pt, 0, sizeof(*pt));
+    pt->E = gsl_vector_calloc(3);
+    pt->B = gsl_vector_calloc(3);
+    pt->D = gsl_vector_calloc(3);
+    pt->H = gsl_vector_calloc(3);
+    pt->J = gsl_vector_calloc(3);
+    pt->epsilon = MAXWELL_EPSILON0;
+    pt->mu = MAXWELL_MU0;
+    return pt->E && pt->B && pt->D && pt->H && pt->J ? 0 : -1;
+}
+
+static void maxwell_point_clear(maxwell_field_point *pt) {
+    gsl_vector *vecs[7] = { pt->E, pt->B, pt->D, pt->H, pt->J, pt->source_E, pt->source_B };
+    for (int v = 0; v < 7; v++)
+        if (vecs[v]) gsl_vector_free(vecs[v]);
+    free(pt->material);
+    free(pt->tag);
+}
+
+maxwell_field_point *maxwell_field_point_alloc(void) {
+    maxwell_field_point *pt = malloc(sizeof(*pt));
+    if (!pt) return NULL;
+    if (maxwell_point_init(pt) != 0) {
+        maxwell_field_point_free(pt);
+        return NULL;
+    }
+    return pt;
+}
+
+void maxwell_field_point_free(maxwell_field_point *pt) {
+    if (!pt) return;
+    maxwell_point_clear(pt);
+    free(pt);
+}
+
+maxwell_field_grid *maxwell_field_grid_alloc(size_t n) {
+    maxwell_field_grid *grid = calloc(1, sizeof(*grid));
+    if (!grid) return NULL;
+    grid->dim = 3;
+    grid->pts = n ? calloc(n, sizeof(maxwell_field_point)) : NULL;
+    if (n && !grid->pts) {
+        free(grid);
+        return NULL;
+    }
+    grid->n = n;
+    for (size_t i = 0; i < n; i++) {
+        if (maxwell_point_init(&grid->pts[i]) != 0) {
+            maxwell_field_grid_free(grid);
+            return NULL;
+        }
+    }
+    return grid;
+}
+
+void maxwell_field_grid_free(maxwell_field_grid *grid) {
+    if (!grid) return;
+    if (grid->pts) {
+        for (size_t i = 0; i < grid->n; i++) maxwell_point_clear(&grid->pts[i]);
+        free(grid->pts);
+    }
+    if (grid->coords) gsl_matrix_free(grid->coords);
+    maxwell_yee_grid_free(grid->yee);
+    free(grid->name);
+    free(grid);
+}
+
+/* -------------------------------
+   Structured (Yee) grids
+   ------------------------------- */
+
+maxwell_yee_grid *maxwell_yee_grid_alloc(size_t nx, size_t ny, size_t nz, double dx, double dy, double dz) {
+    if (nx == 0 || ny == 0 || nz == 0 || dx <= 0.0 || dy <= 0.0 || dz <= 0.0) return NULL;
+    maxwell_yee_grid *g = calloc(1, sizeof(*g));
+    if (!g) return NULL;
+    g->nx = nx;
+    g->ny = ny;
+    g->nz = nz;
+    g->n = nx * ny * nz;
+    g->dx = dx;
+    g->dy = dy;
+    g->dz = dz;
+    g->E = calloc(3 * g->n, sizeof(double));
+    g->H = calloc(3 * g->n, sizeof(double));
+    g->J = calloc(3 * g->n, sizeof(double));
+    g->material = calloc(g->n, 1);
+    g->materials = calloc(MAXWELL_YEE_MAX_MATERIALS, sizeof(maxwell_material));
+    if (!g->E || !g->H || !g->J || !g->material || !g->materials) {
+        maxwell_yee_grid_free(g);
+        return NULL;
+    }
+    maxwell_material vacuum = { "vacuum", MAXWELL_EPSILON0, MAXWELL_MU0, 0.0, NULL };
+    if (maxwell_yee_add_material(g, &vacuum) != 0) {
+        maxwell_yee_grid_free(g);
+        return NULL;
+    }
+    return g;
+}
+
+void maxwell_yee_grid_free(maxwell_yee_grid *g) {
+    if (!g) return;
+    if (g->materials)
+        for (size_t m = 0; m < g->n_materials; m++) free(g->materials[m].name);
+    free(g->materials);
+    free(g->sources);
+    free(g->material);
+    free(g->E);
+    free(g->H);
+    free(g->J);
+    free(g);
+}
+
+int maxwell_yee_add_material(maxwell_yee_grid *g, const maxwell_material *mat) {
+    if (!g || !mat || g->n_materials >= MAXWELL_YEE_MAX_MATERIALS) return -1;
+    if (mat->epsilon <= 0.0 || mat->mu <= 0.0 || mat->sigma < 0.0) return -1;
+    maxwell_material *m = &g->materials[g->n_materials];
+    *m = *mat;
+    m->name = mat->name ? strdup(mat->name) : NULL;
+    if (mat->name && !m->name) return -1;
+    return (int)g->n_materials++;
+}
+
+int maxwell_yee_set_material_box(maxwell_yee_grid *g, size_t i0, size_t i1, size_t j0, size_t j1,
+                                 size_t k0, size_t k1, unsigned index) {
+    if (!g || index >= g->n_materials) return -1;
+    if (i1 > g->nx) i1 = g->nx;
+    if (j1 > g->ny) j1 = g->ny;
+    if (k1 > g->nz) k1 = g->nz;
+    if (i0 >= i1) return 0;
+    for (size_t k = k0; k < k1; k++)
+        for (size_t j = j0; j < j1; j++)
+            memset(g->material + maxwell_yee_index(g, i0, j, k), (int)index, i1 - i0);
+    return 0;
+}
+
+int maxwell_yee_cell_view(maxwell_yee_grid *g, size_t idx, maxwell_yee_view *view) {
+    if (!g || !view || idx >= g->n) return -1;
+    const maxwell_material *m = &g->materials[g->material[idx]];
+    gsl_vector *blocks[3] = { &view->E, &view->H, &view->J };
+    double *data[3] = { g->E, g->H, g->J };
+    for (int f = 0; f < 3; f++) {
+        blocks[f]->size = 3;
+        blocks[f]->stride = g->n;
+        blocks[f]->data = data[f] + idx;
+        blocks[f]->block = NULL;
+        blocks[f]->owner = 0;
+    }
+    for (size_t a = 0; a < 3; a++) {
+        view->B_data[a] = m->mu * g->H[a * g->n + idx];
+        view->D_data[a] = m->epsilon * g->E[a * g->n + idx];
+    }
+    view->B = (gsl_vector){ 3, 1, view->B_data, NULL, 0 };
+    view->D = (gsl_vector){ 3, 1, view->D_data, NULL, 0 };
+
+    memset(&view->pt, 0, sizeof(view->pt));
+    view->pt.E = &view->E;
+    view->pt.H = &view->H;
+    view->pt.J = &view->J;
+    view->pt.B = &view->B;
+    view->pt.D = &view->D;
+    view->pt.epsilon = m->epsilon;
+    view->pt.mu = m->mu;
+    view->pt.sigma = m->sigma;
+    view->pt.material = m->name;
+    return 0;
+}
+
+int maxwell_yee_set_boundary(maxwell_yee_grid *g, size_t axis, maxwell_yee_boundary_t type) {
+    if (!g || axis > 2 || (type != MAXWELL_YEE_PEC && type != MAXWELL_YEE_PERIODIC)) return -1;
+    g->boundary[axis] = type;
+    return 0;
+}
+
+int maxwell_yee_add_source(maxwell_yee_grid *g, const maxwell_yee_source *src) {
+    if (!g || !src || !src->func || src->idx >= g->n || src->component < 0 || src->component > 5)
+        return -1;
+    if (g->n_sources == g->sources_cap) {
+        size_t cap = g->sources_cap ? 2 * g->sources_cap : 8;
+        maxwell_yee_source *s = realloc(g->sources, cap * sizeof(*s));
+        if (!s) return -1;
+        g->sources = s;
+        g->sources_cap = cap;
+    }
+    /* Insertion keeps the list sorted, so each row finds its sources by bisection. */
+    size_t k = g->n_sources++;
+    while (k > 0 && g->sources[k - 1].idx > src->idx) {
+        g->sources[k] = g->sources[k - 1];
+        k--;
+    }
+    g->sources[k] = *src;
+    return 0;
+}
+
+int maxwell_yee_set_threads(maxwell_yee_grid *g, int n_threads) {
+    if (!g) return -1;
+    if (n_threads < 0) {
+#ifdef _OPENMP
+        n_threads = omp_get_max_threads();
+#else
+        n_threads = 1;
+#endif
+    }
+    g->n_threads = n_threads;
+    return n_threads;
+}
+
+double maxwell_yee_max_dt(const maxwell_yee_grid *g) {
+    if (!g) return 0.0;
+    double v2 = 0.0;
+    for (size_t m = 0; m < g->n_materials; m++) {
+        double c2 = 1.0 / (g->materials[m].epsilon * g->materials[m].mu);
+        if (c2 > v2) v2 = c2;
+    }
+    double h2 = 0.0;
+    if (g->nx > 1) h2 += 1.0 / (g->dx * g->dx);
+    if (g->ny > 1) h2 += 1.0 / (g->dy * g->dy);
+    if (g->nz > 1) h2 += 1.0 / (g->dz * g->dz);
+    return h2 > 0.0 ? 1.0 / sqrt(v2 * h2) : INFINITY;
+}
+
+maxwell_field_grid *maxwell_field_grid_alloc_yee(size_t nx, size_t ny, size_t nz, double dx, double dy, double dz) {
+    maxwell_yee_grid *g = maxwell_yee_grid_alloc(nx, ny, nz, dx, dy, dz);
+    if (!g) return NULL;
+    maxwell_field_grid *grid = maxwell_field_grid_alloc(0);
+    if (!grid) {
+        maxwell_yee_grid_free(g);
+        return NULL;
+    }
+    grid->n = g->n;
+    grid->dim = (nx > 1) + (ny > 1) + (nz > 1);
+    if (grid->dim == 0) grid->dim = 1;
+    grid->yee = g;
+    return grid;
+}
+
+maxwell_field_point *maxwell_field_grid_point(maxwell_field_grid *grid, size_t idx, maxwell_yee_view *scratch) {
+    if (!grid || idx >= grid->n) return NULL;
+    if (!grid->yee) return &grid->pts[idx];
+    if (maxwell_yee_cell_view(grid->yee, idx, scratch) != 0) return NULL;
+    return &scratch->pt;
+}
+
+/* -------------------------------
+   Grid FDTD stepper
+   ------------------------------- */
+
+/*
+    Rows of nx cells (fixed j, k) are the unit of work: the x loop is an
+    aligned sweep over contiguous component arrays and vectorizes; rows are
+    shared between threads. Every cell is written by exactly one thread and
+    reads only fields of the other kind, so the result is independent of the
+    thread count. Neighbor rows outside a PEC wall read a shared zero row.
+*/
+
+/* Per-material update coefficients. */
+typedef struct {
+    double ca[MAXWELL_YEE_MAX_MATERIALS];   /* E decay: (1 - s) / (1 + s), s = sigma dt / 2 eps */
+    double cb[MAXWELL_YEE_MAX_MATERIALS];   /* E gain: (dt / eps) / (1 + s) */
+    double ch[MAXWELL_YEE_MAX_MATERIALS];   /* H gain: dt / mu */
+} maxwell_yee_coef;
+
+/* Neighbor "outside a PEC wall": real offsets are negative too, backwards
+   and on the wrap of the high periodic face. */
+#define MAXWELL_YEE_WALL LONG_MIN
+
+/* Neighbor row offset along an axis, or MAXWELL_YEE_WALL. */
+static long maxwell_yee_neighbor(size_t pos, size_t count, int step, size_t stride, int periodic) {
+    if (count == 1) return 0;
+    if (step > 0) {
+        if (pos + 1 < count) return (long)stride;
+        return periodic ? -(long)((count - 1) * stride) : MAXWELL_YEE_WALL;
+    }
+    if (pos > 0) return -(long)stride;
+    return periodic ? (long)((count - 1) * stride) : MAXWELL_YEE_WALL;
+}
+
+/* First source with idx >= lo. */
+static size_t maxwell_yee_first_source(const maxwell_yee_grid *g, size_t lo) {
+    size_t a = 0, b = g->n_sources;
+    while (a < b) {
+        size_t m = a + (b - a) / 2;
+        if (g->sources[m].idx < lo) a = m + 1;
+        else b = m;
+    }
+    return a;
+}
+
+/* Apply the sources of the row starting at base whose components lie in [c0, c0 + 3). */
+static void maxwell_yee_row_sources(const maxwell_yee_grid *g, double *field, size_t base, size_t nx,
+                                    int c0, double t) {
+    for (size_t s = maxwell_yee_first_source(g, base); s < g->n_sources && g->sources[s].idx < base + nx; s++) {
+        const maxwell_yee_source *src = &g->sources[s];
+        if (src->component < c0 || src->component >= c0 + 3) continue;
+        double *f = field + (size_t)(src->component - c0) * g->n + src->idx;
+        double v = src->func(t, src->userdata);
+        *f = src->hard ? v : *f + v;
+    }
+}
+
+/* H(t + dt/2) on one row. */
+static void maxwell_yee_h_row(const maxwell_yee_grid *g, const maxwell_yee_coef *c, const double *zero,
+                              size_t j, size_t k) {
+    const size_t nx = g->nx, n = g->n, base = (k * g->ny + j) * nx;
+    const double idx_ = 1.0 / g->dx, idy = 1.0 / g->dy, idz = 1.0 / g->dz;
+    const long oj = maxwell_yee_neighbor(j, g->ny, +1, nx, g->boundary[1] == MAXWELL_YEE_PERIODIC);
+    const long ok = maxwell_yee_neighbor(k, g->nz, +1, nx * g->ny, g->boundary[2] == MAXWELL_YEE_PERIODIC);
+    const int px = g->boundary[0] == MAXWELL_YEE_PERIODIC || nx == 1;
+
+    const double *ex = g->E + base, *ey = g->E + n + base, *ez = g->E + 2 * n + base;
+    const double *ex_j = oj == MAXWELL_YEE_WALL ? zero : ex + oj, *ez_j = oj == MAXWELL_YEE_WALL ? zero : ez + oj;
+    const double *ex_k = ok == MAXWELL_YEE_WALL ? zero : ex + ok, *ey_k = ok == MAXWELL_YEE_WALL ? zero : ey + ok;
+    double *hx = g->H + base, *hy = g->H + n + base, *hz = g->H + 2 * n + base;
+    const unsigned char *mat = g->material + base;
+
+    const size_t last = nx - 1;
+    #pragma omp simd
+    for (size_t i = 0; i < last; i++) {
+        const double ch = c->ch[mat[i]];
+        hx[i] -= ch * ((ez_j[i] - ez[i]) * idy - (ey_k[i] - ey[i]) * idz);
+        hy[i] -= ch * ((ex_k[i] - ex[i]) * idz - (ez[i + 1] - ez[i]) * idx_);
+        hz[i] -= ch * ((ey[i + 1] - ey[i]) * idx_ - (ex_j[i] - ex[i]) * idy);
+    }
+    /* Last cell: the x neighbor wraps or lies beyond the wall. */
+    const size_t i = last;
+    const double ch = c->ch[mat[i]], ez_x = px ? ez[0] : 0.0, ey_x = px ? ey[0] : 0.0;
+    hx[i] -= ch * ((ez_j[i] - ez[i]) * idy - (ey_k[i] - ey[i]) * idz);
+    hy[i] -= ch * ((ex_k[i] - ex[i]) * idz - (ez_x - ez[i]) * idx_);
+    hz[i] -= ch * ((ey_x - ey[i]) * idx_ - (ex_j[i] - ex[i]) * idy);
+}
+
+/* E(t + dt) on one row, PEC walls included. */
+static void maxwell_yee_e_row(const maxwell_yee_grid *g, const maxwell_yee_coef *c, const double *zero,
+                              size_t j, size_t k) {
+    const size_t nx = g->nx, n = g->n, base = (k * g->ny + j) * nx;
+    const double idx_ = 1.0 / g->dx, idy = 1.0 / g->dy, idz = 1.0 / g->dz;
+    const long oj = maxwell_yee_neighbor(j, g->ny, -1, nx, g->boundary[1] == MAXWELL_YEE_PERIODIC);
+    const long ok = maxwell_yee_neighbor(k, g->nz, -1, nx * g->ny, g->boundary[2] == MAXWELL_YEE_PERIODIC);
+    const int px = g->boundary[0] == MAXWELL_YEE_PERIODIC || nx == 1;
+
+    const double *hx = g->H + base, *hy = g->H + n + base, *hz = g->H + 2 * n + base;
+    const double *hx_j = oj == MAXWELL_YEE_WALL ? zero : hx + oj, *hz_j = oj == MAXWELL_YEE_WALL ? zero : hz + oj;
+    const double *hx_k = ok == MAXWELL_YEE_WALL ? zero : hx + ok, *hy_k = ok == MAXWELL_YEE_WALL ? zero : hy + ok;
+    const double *jx = g->J + base, *jy = g->J + n + base, *jz = g->J + 2 * n + base;
+    double *ex = g->E + base, *ey = g->E + n + base, *ez = g->E + 2 * n + base;
+    const unsigned char *mat = g->material + base;
+
+    /* First cell: the x neighbor wraps or lies beyond the wall. */
+    {
+        const unsigned char m = mat[0];
+        const double hz_x = px ? hz[nx - 1] : 0.0, hy_x = px ? hy[nx - 1] : 0.0;
+        ex[0] = c->ca[m] * ex[0] + c->cb[m] * ((hz[0] - hz_j[0]) * idy - (hy[0] - hy_k[0]) * idz - jx[0]);
+        ey[0] = c->ca[m] * ey[0] + c->cb[m] * ((hx[0] - hx_k[0]) * idz - (hz[0] - hz_x) * idx_ - jy[0]);
+        ez[0] = c->ca[m] * ez[0] + c->cb[m] * ((hy[0] - hy_x) * idx_ - (hx[0] - hx_j[0]) * idy - jz[0]);
+    }
+    #pragma omp simd
+    for (size_t i = 1; i < nx; i++) {
+        const unsigned char m = mat[i];
+        ex[i] = c->ca[m] * ex[i] + c->cb[m] * ((hz[i] - hz_j[i]) * idy - (hy[i] - hy_k[i]) * idz - jx[i]);
+        ey[i] = c->ca[m] * ey[i] + c->cb[m] * ((hx[i] - hx_k[i]) * idz - (hz[i] - hz[i - 1]) * idx_ - jy[i]);
+        ez[i] = c->ca[m] * ez[i] + c->cb[m] * ((hy[i] - hy[i - 1]) * idx_ - (hx[i] - hx_j[i]) * idy - jz[i]);
+    }
+
+    /* Tangential E vanishes on the low PEC walls (the high walls lie outside the arrays). */
+    if (!px) ey[0] = ez[0] = 0.0;
+    if (oj == MAXWELL_YEE_WALL) {
+        memset(ex, 0, nx * sizeof(double));
+        memset(ez, 0, nx * sizeof(double));
+    }
+    if (ok == MAXWELL_YEE_WALL) {
+        memset(ex, 0, nx * sizeof(double));
+        memset(ey, 0, nx * sizeof(double));
+    }
+}
+
+/* Update coefficients for every material at timestep dt. */
+static void maxwell_yee_coefficients(const maxwell_yee_grid *g, double dt, maxwell_yee_coef *c) {
+    for (size_t m = 0; m < g->n_materials; m++) {
+        const maxwell_material *mat = &g->materials[m];
+        const double s = 0.5 * mat->sigma * dt / mat->epsilon;
+        c->ca[m] = (1.0 - s) / (1.0 + s);
+        c->cb[m] = dt / mat->epsilon / (1.0 + s);
+        c->ch[m] = dt / mat->mu;
+    }
+}
+
+/* H (field 3) or E (field 0) sweep over rows [j0, j1) x [k0, k1), with
+   the sources of those rows at time t. Work-shares its rows when called
+   inside a parallel region. */
+static void maxwell_yee_sweep(const maxwell_yee_grid *g, const maxwell_yee_coef *c, const double *zero,
+                              int field, size_t j0, size_t j1, size_t k0, size_t k1, double t) {
+    const size_t ny = j1 - j0, rows = ny * (k1 - k0);
+    #pragma omp for schedule(static)
+    for (size_t r = 0; r < rows; r++) {
+        const size_t j = j0 + r % ny, k = k0 + r / ny;
+        if (field == 3) maxwell_yee_h_row(g, c, zero, j, k);
+        else maxwell_yee_e_row(g, c, zero, j, k);
+        if (g->n_sources)
+            maxwell_yee_row_sources(g, field == 3 ? g->H : g->E, (k * g->ny + j) * g->nx, g->nx, field, t);
+    }
+}
+
+int maxwell_grid_fdtd_step(maxwell_field_grid *grid, double dt) {
+    HOLOS_TRACE_ZONE("maxwell_grid_fdtd_step");
+    if (!grid || !grid->yee || dt <= 0.0) return -1;
+    maxwell_yee_grid *g = grid->yee;
+    if (dt > maxwell_yee_max_dt(g)) return -1;
+
+    maxwell_yee_coef c;
+    maxwell_yee_coefficients(g, dt, &c);
+    double *zero = calloc(g->nx, sizeof(double));
+    if (!zero) return -1;
+
+    const double t = grid->t;
+    const int nt = g->n_threads > 0 ? g->n_threads : 1;
+    #pragma omp parallel num_threads(nt) if(nt > 1)
+    {
+        maxwell_yee_sweep(g, &c, zero, 3, 0, g->ny, 0, g->nz, t + 0.5 * dt);
+        maxwell_yee_sweep(g, &c, zero, 0, 0, g->ny, 0, g->nz, t + dt);
+    }
+    free(zero);
+    grid->t = t + dt;
+    return 0;
+}
+
+int maxwell_grid_fdtd_rows(maxwell_field_grid *grid, double dt, int field, size_t j0, size_t j1,
+                           size_t k0, size_t k1) {
+    if (!grid || !grid->yee || dt <= 0.0 || (field != 0 && field != 3)) return -1;
+    maxwell_yee_grid *g = grid->yee;
+    if (j0 > j1 || j1 > g->ny || k0 > k1 || k1 > g->nz) return -1;
+    if (dt > maxwell_yee_max_dt(g)) return -1;
+
+    maxwell_yee_coef c;
+    maxwell_yee_coefficients(g, dt, &c);
+    double *zero = calloc(g->nx, sizeof(double));
+    if (!zero) return -1;
+
+    const double t = field == 3 ? grid->t + 0.5 * dt : grid->t + dt;
+    const int nt = g->n_threads > 0 ? g->n_threads : 1;
+    #pragma omp parallel num_threads(nt) if(nt > 1)
+    maxwell_yee_sweep(g, &c, zero, field, j0, j1, k0, k1, t);
+    free(zero);
+    return 0;
+}
+
+/* Yee grids enforce their walls inside maxwell_grid_fdtd_step(); this
+   re-applies them after fields were edited by hand. */
+void maxwell_apply_boundary_conditions(maxwell_field_grid *grid) {
+    if (!grid || !grid->yee) return;
+    maxwell_yee_grid *g = grid->yee;
+    const size_t nx = g->nx, ny = g->ny, nz = g->nz, n = g->n;
+    double *ex = g->E, *ey = g->E + n, *ez = g->E + 2 * n;
+    for (size_t k = 0; k < nz; k++) {
+        for (size_t j = 0; j < ny; j++) {
+            const size_t base = (k * ny + j) * nx;
+            if (nx > 1 && g->boundary[0] == MAXWELL_YEE_PEC) ey[base] = ez[base] = 0.0;
+            if (ny > 1 && g->boundary[1] == MAXWELL_YEE_PEC && j == 0) {
+                memset(ex + base, 0, nx * sizeof(double));
+                memset(ez + base, 0, nx * sizeof(double));
+            }
+            if (nz > 1 && g->boundary[2] == MAXWELL_YEE_PEC && k == 0) {
+                memset(ex + base, 0, nx * sizeof(double));
+                memset(ey + base, 0, nx * sizeof(double));
+            }
+        }
+    }
+}
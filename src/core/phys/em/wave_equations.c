@@ -0,0 +1,682 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "core/phys/em/wave_equations.h"
+#include "core/trace/trace.h"
+
+/* -------------------------------
+   Field points and point grids
+   ------------------------------- */
+
+static void wave_point_clear(wave_field_point *pt) {
+	if (pt->U) gsl_vector_free(pt->U);
+	free(pt->type);
+	free(pt->tag);
+}
+
+static int wave_point_copy(wave_field_point *dst, const wave_field_point *src) {
+	*dst = *src;
+	dst->U = NULL;
+	dst->type = src->type ? strdup(src->type) : NULL;
+	dst->tag = src->tag ? strdup(src->tag) : NULL;
+	if (src->U) {
+		dst->U = gsl_vector_alloc(src->U->size);
+		if (dst->U) gsl_vector_memcpy(dst->U, src->U);
+	}
+	if ((src->type && !dst->type) || (src->tag && !dst->tag) || (src->U && !dst->U)) {
+		wave_point_clear(dst);
+		return -1;
+	}
+	return 0;
+}
+
+wave_field_point *wave_field_point_alloc(void) {
+	return calloc(1, sizeof(wave_field_point));
+}
+
+void wave_field_point_free(wave_field_point *pt) {
+	if (!pt) return;
+	wave_point_clear(pt);
+	free(pt);
+}
+
+wave_field_point *wave_field_point_clone(const wave_field_point *src) {
+	if (!src) return NULL;
+	wave_field_point *pt = malloc(sizeof(*pt));
+	if (!pt) return NULL;
+	if (wave_point_copy(pt, src) != 0) {
+		free(pt);
+		return NULL;
+	}
+	return pt;
+}
+
+wave_field_grid *wave_field_grid_alloc(size_t n) {
+	wave_field_grid *grid = calloc(1, sizeof(*grid));
+	if (!grid) return NULL;
+	grid->dim = 1;
+	grid->pts = n ? calloc(n, sizeof(wave_field_point)) : NULL;
+	if (n && !grid->pts) {
+		free(grid);
+		return NULL;
+	}
+	grid->n = n;
+	return grid;
+}
+
+void wave_field_grid_free(wave_field_grid *grid) {
+	if (!grid) return;
+	for (size_t i = 0; i < grid->n; i++) wave_point_clear(&grid->pts[i]);
+	free(grid->pts);
+	if (grid->coords) gsl_matrix_free(grid->coords);
+	wave_stencil_free(grid->stencil);
+	free(grid->name);
+	free(grid);
+}
+
+/* Copies points, coords and time; boundaries, sources and the stencil cache are not cloned. */
+wave_field_grid *wave_field_grid_clone(const wave_field_grid *src) {
+	if (!src) return NULL;
+	wave_field_grid *grid = wave_field_grid_alloc(0);
+	if (!grid) return NULL;
+	grid->dim = src->dim;
+	grid->t = src->t;
+	grid->name = src->name ? strdup(src->name) : NULL;
+	grid->pts = src->n ? malloc(src->n * sizeof(wave_field_point)) : NULL;
+	if (src->n && !grid->pts) {
+		wave_field_grid_free(grid);
+		return NULL;
+	}
+	for (; grid->n < src->n; grid->n++) {
+		if (wave_point_copy(&grid->pts[grid->n], &src->pts[grid->n]) != 0) {
+			wave_field_grid_free(grid);
+			return NULL;
+		}
+	}
+	if (src->coords) {
+		grid->coords = gsl_matrix_alloc(src->coords->size1, src->coords->size2);
+		if (!grid->coords) {
+			wave_field_grid_free(grid);
+			return NULL;
+		}
+		gsl_matrix_memcpy(grid->coords, src->coords);
+	}
+	return grid;
+}
+
+int wave_field_grid_add_point(wave_field_grid *grid, const wave_field_point *pt) {
+	if (!grid || !pt) return -1;
+	if (grid->coords && grid->coords->size1 == grid->n) {
+		gsl_matrix *coords = gsl_matrix_calloc(grid->n + 1, grid->coords->size2);
+		if (!coords) return -1;
+		gsl_matrix_view old = gsl_matrix_submatrix(coords, 0, 0, grid->n, grid->coords->size2);
+		gsl_matrix_memcpy(&old.matrix, grid->coords);
+		gsl_matrix_free(grid->coords);
+		grid->coords = coords;
+	}
+	wave_field_point *pts = realloc(grid->pts, (grid->n + 1) * sizeof(wave_field_point));
+	if (!pts) return -1;
+	grid->pts = pts;
+	if (wave_point_copy(&grid->pts[grid->n], pt) != 0) return -1;
+	grid->n++;
+	wave_field_grid_invalidate(grid);
+	return 0;
+}
+
+int wave_field_grid_remove_point(wave_field_grid *grid, size_t idx) {
+	if (!grid || idx >= grid->n) return -1;
+	wave_point_clear(&grid->pts[idx]);
+	memmove(&grid->pts[idx], &grid->pts[idx + 1], (grid->n - idx - 1) * sizeof(wave_field_point));
+	if (grid->coords && grid->coords->size1 == grid->n) {
+		if (grid->n == 1) {
+			gsl_matrix_free(grid->coords);
+			grid->coords = NULL;
+		} else {
+			gsl_matrix *coords = gsl_matrix_alloc(grid->n - 1, grid->coords->size2);
+			if (!coords) return -1;
+			for (size_t i = 0, r = 0; i < grid->n; i++) {
+				if (i == idx) continue;
+				gsl_vector_const_view row = gsl_matrix_const_row(grid->coords, i);
+				gsl_matrix_set_row(coords, r++, &row.vector);
+			}
+			gsl_matrix_free(grid->coords);
+			grid->coords = coords;
+		}
+	}
+	grid->n--;
+	wave_field_grid_invalidate(grid);
+	return 0;
+}
+
+/* -------------------------------
+   Compiled stencil
+   ------------------------------- */
+
+#define WAVE_STENCIL_MAX_DIM 3
+#define WAVE_STENCIL_MAX_ROW (1 + 2 * WAVE_STENCIL_MAX_DIM)
+
+/* Neighbors of one point: per axis the index and distance on each side (none: h = 0). */
+typedef struct {
+	size_t lo[WAVE_STENCIL_MAX_DIM], hi[WAVE_STENCIL_MAX_DIM];
+	double h_lo[WAVE_STENCIL_MAX_DIM], h_hi[WAVE_STENCIL_MAX_DIM];
+} wave_neighbors;
+
+/* Sort record: the axis being linked is the last used key, so points on a common line come out adjacent. */
+typedef struct {
+	double key[WAVE_STENCIL_MAX_DIM];
+	size_t idx;
+} wave_sort_key;
+
+static int wave_sort_key_cmp(const void *a, const void *b) {
+	const wave_sort_key *x = a, *y = b;
+	for (int d = 0; d < WAVE_STENCIL_MAX_DIM; d++) {
+		if (x->key[d] < y->key[d]) return -1;
+		if (x->key[d] > y->key[d]) return 1;
+	}
+	return x->idx < y->idx ? -1 : x->idx > y->idx;
+}
+
+/* Row i of the stencil from its neighbors: the diagonal, then lo/hi per axis. */
+static size_t wave_stencil_row(const wave_neighbors *nb, size_t i, int dim, size_t *col, double *w) {
+	size_t k = 1;
+	double diag = 0.0;
+	for (int d = 0; d < dim; d++) {
+		const double hm = nb->h_lo[d], hp = nb->h_hi[d];
+		if (hm <= 0.0 || hp <= 0.0) continue;
+		diag -= 2.0 / (hm * hp);
+		col[k] = nb->lo[d];
+		w[k++] = 2.0 / (hm * (hm + hp));
+		col[k] = nb->hi[d];
+		w[k++] = 2.0 / (hp * (hm + hp));
+	}
+	col[0] = i;
+	w[0] = diag;
+	return k;
+}
+
+static int wave_grid_coords_ok(const wave_field_grid *grid) {
+	return grid->coords && grid->coords->size1 == grid->n && grid->dim >= 1 &&
+	       grid->dim <= WAVE_STENCIL_MAX_DIM && grid->coords->size2 == (size_t)grid->dim;
+}
+
+/* Whether points i and j coincide in every coordinate except axis. */
+static int wave_same_line(const gsl_matrix *coords, size_t i, size_t j, int dim, int axis) {
+	for (int d = 0; d < dim; d++)
+		if (d != axis && gsl_matrix_get(coords, i, d) != gsl_matrix_get(coords, j, d)) return 0;
+	return 1;
+}
+
+/* Neighbors of point i by a linear scan (used without a compiled stencil). */
+static void wave_find_neighbors(const wave_field_grid *grid, size_t i, wave_neighbors *nb) {
+	memset(nb, 0, sizeof(*nb));
+	for (int d = 0; d < grid->dim; d++) {
+		const double xi = gsl_matrix_get(grid->coords, i, d);
+		for (size_t j = 0; j < grid->n; j++) {
+			if (j == i || !wave_same_line(grid->coords, i, j, grid->dim, d)) continue;
+			const double h = gsl_matrix_get(grid->coords, j, d) - xi;
+			if (h > 0.0 && (nb->h_hi[d] == 0.0 || h < nb->h_hi[d] || (h == nb->h_hi[d] && j < nb->hi[d]))) {
+				nb->h_hi[d] = h;
+				nb->hi[d] = j;
+			} else if (h < 0.0 && (nb->h_lo[d] == 0.0 || -h < nb->h_lo[d] || (-h == nb->h_lo[d] && j < nb->lo[d]))) {
+				nb->h_lo[d] = -h;
+				nb->lo[d] = j;
+			}
+		}
+	}
+}
+
+void wave_stencil_free(wave_stencil *s) {
+	if (!s) return;
+	free(s->row_ptr);
+	free(s->col);
+	free(s->w);
+	free(s->u);
+	free(s->lap);
+	free(s);
+}
+
+void wave_field_grid_invalidate(wave_field_grid *grid) {
+	if (!grid) return;
+	wave_stencil_free(grid->stencil);
+	grid->stencil = NULL;
+}
+
+/*
+    Neighbors along axis d come from one sort per axis: ordered by the other
+    coordinates and then by x_d, points on a common line are adjacent, so
+    the whole grid is O(dim n log n) instead of a scan per point.
+*/
+const wave_stencil *wave_field_grid_compile(wave_field_grid *grid) {
+	if (!grid) return NULL;
+	if (grid->stencil) return grid->stencil;
+	if (!wave_grid_coords_ok(grid)) return NULL;
+	const size_t n = grid->n;
+	const int dim = grid->dim;
+
+	wave_neighbors *nb = calloc(n ? n : 1, sizeof(*nb));
+	wave_sort_key *keys = malloc((n ? n : 1) * sizeof(*keys));
+	wave_stencil *s = calloc(1, sizeof(*s));
+	if (!nb || !keys || !s) goto fail;
+	s->n = n;
+	s->row_ptr = malloc((n + 1) * sizeof(size_t));
+	s->col = malloc((n ? n : 1) * WAVE_STENCIL_MAX_ROW * sizeof(size_t));
+	s->w = malloc((n ? n : 1) * WAVE_STENCIL_MAX_ROW * sizeof(double));
+	s->u = malloc((n ? n : 1) * sizeof(double));
+	s->lap = malloc((n ? n : 1) * sizeof(double));
+	if (!s->row_ptr || !s->col || !s->w || !s->u || !s->lap) goto fail;
+
+	for (int d = 0; d < dim; d++) {
+		for (size_t i = 0; i < n; i++) {
+			memset(keys[i].key, 0, sizeof(keys[i].key));
+			for (int a = 0, k = 0; a < dim; a++)
+				if (a != d) keys[i].key[k++] = gsl_matrix_get(grid->coords, i, a);
+			keys[i].key[dim - 1] = gsl_matrix_get(grid->coords, i, d);
+			keys[i].idx = i;
+		}
+		qsort(keys, n, sizeof(*keys), wave_sort_key_cmp);
+		for (size_t r = 1; r < n; r++) {
+			const wave_sort_key *a = &keys[r - 1], *b = &keys[r];
+			if (!wave_same_line(grid->coords, a->idx, b->idx, dim, d)) continue;
+			const double h = b->key[dim - 1] - a->key[dim - 1];
+			if (h <= 0.0) continue;
+			nb[a->idx].hi[d] = b->idx;
+			nb[a->idx].h_hi[d] = h;
+			nb[b->idx].lo[d] = a->idx;
+			nb[b->idx].h_lo[d] = h;
+		}
+	}
+
+	s->row_ptr[0] = 0;
+	for (size_t i = 0; i < n; i++) {
+		const size_t k = s->row_ptr[i];
+		s->row_ptr[i + 1] = k + wave_stencil_row(&nb[i], i, dim, s->col + k, s->w + k);
+	}
+	s->nnz = s->row_ptr[n];
+	free(nb);
+	free(keys);
+	grid->stencil = s;
+	return s;
+
+fail:
+	free(nb);
+	free(keys);
+	wave_stencil_free(s);
+	return NULL;
+}
+
+void wave_stencil_apply(const wave_stencil *s, const double *u, double *out) {
+	const size_t *restrict row_ptr = s->row_ptr, *restrict col = s->col;
+	const double *restrict w = s->w;
+	for (size_t i = 0; i < s->n; i++) {
+		double acc = 0.0;
+		for (size_t k = row_ptr[i]; k < row_ptr[i + 1]; k++) acc += w[k] * u[col[k]];
+		out[i] = acc;
+	}
+}
+
+/* -------------------------------
+   Wave equation operations
+   ------------------------------- */
+
+double wave_laplacian(const wave_field_grid *grid, size_t idx) {
+	if (!grid || idx >= grid->n) return 0.0;
+	const wave_stencil *s = grid->stencil;
+	size_t local_col[WAVE_STENCIL_MAX_ROW];
+	double local_w[WAVE_STENCIL_MAX_ROW];
+	const size_t *col;
+	const double *w;
+	size_t len;
+	if (s) {
+		col = s->col + s->row_ptr[idx];
+		w = s->w + s->row_ptr[idx];
+		len = s->row_ptr[idx + 1] - s->row_ptr[idx];
+	} else {
+		if (!wave_grid_coords_ok(grid)) return 0.0;
+		wave_neighbors nb;
+		wave_find_neighbors(grid, idx, &nb);
+		len = wave_stencil_row(&nb, idx, grid->dim, local_col, local_w);
+		col = local_col;
+		w = local_w;
+	}
+	double acc = 0.0;
+	for (size_t k = 0; k < len; k++) acc += w[k] * grid->pts[col[k]].u;
+	return acc;
+}
+
+void wave_fdtd_step(wave_field_point *pt, const wave_field_point *pt_prev, double c, double dt, double laplacian) {
+	if (!pt || !pt_prev) return;
+	pt->u = 2.0 * pt->u - pt_prev->u + (c * dt) * (c * dt) * laplacian;
+	pt->t += dt;
+}
+
+void wave_grid_fdtd_step(wave_field_grid *grid, const wave_field_grid *grid_prev, double c, double dt) {
+	if (!grid || !grid_prev || grid_prev->n != grid->n) return;
+	const wave_stencil *s = wave_field_grid_compile(grid);
+	if (!s) return;
+	for (size_t i = 0; i < grid->n; i++) s->u[i] = grid->pts[i].u;
+	wave_stencil_apply(s, s->u, s->lap);
+	for (size_t i = 0; i < grid->n; i++) wave_fdtd_step(&grid->pts[i], &grid_prev->pts[i], c, dt, s->lap[i]);
+	grid->t += dt;
+}
+
+/* -------------------------------
+   Structured wave engine
+   ------------------------------- */
+
+/* Interior index range of an axis: the outer layer is a fixed boundary. */
+static void wave_axis_interior(size_t count, size_t *lo, size_t *hi) {
+	*lo = count > 1 ? 1 : 0;
+	*hi = count > 1 ? count - 1 : 1;
+}
+
+/* Largest (c dt)^2 allowed by the CFL condition. */
+static double wave_engine_k2_limit(const wave_engine *e) {
+	double h2 = 0.0;
+	if (e->nx > 1) h2 += 1.0 / (e->dx * e->dx);
+	if (e->ny > 1) h2 += 1.0 / (e->dy * e->dy);
+	if (e->nz > 1) h2 += 1.0 / (e->dz * e->dz);
+	return h2 > 0.0 ? 1.0 / h2 : INFINITY;
+}
+
+wave_engine *wave_engine_alloc(size_t nx, size_t ny, size_t nz, double dx, double dy, double dz,
+                               double c, double dt) {
+	if (nx == 0 || ny == 0 || nz == 0 || dx <= 0.0 || dy <= 0.0 || dz <= 0.0 || c < 0.0 || dt <= 0.0)
+		return NULL;
+	wave_engine *e = calloc(1, sizeof(*e));
+	if (!e) return NULL;
+	e->nx = nx;
+	e->ny = ny;
+	e->nz = nz;
+	e->n = nx * ny * nz;
+	e->dx = dx;
+	e->dy = dy;
+	e->dz = dz;
+	e->c = c;
+	e->dt = dt;
+	e->level = 1;
+	if ((c * dt) * (c * dt) > wave_engine_k2_limit(e)) {
+		free(e);
+		return NULL;
+	}
+	for (int b = 0; b < 3; b++) {
+		e->buf[b] = calloc(e->n, sizeof(double));
+		if (!e->buf[b]) {
+			wave_engine_free(e);
+			return NULL;
+		}
+	}
+	return e;
+}
+
+void wave_engine_free(wave_engine *e) {
+	if (!e) return;
+	for (int b = 0; b < 3; b++) free(e->buf[b]);
+	free(e->k2);
+	free(e);
+}
+
+double *wave_engine_u(wave_engine *e) {
+	return e ? e->buf[e->level % 3] : NULL;
+}
+
+double *wave_engine_u_prev(wave_engine *e) {
+	return e ? e->buf[(e->level + 2) % 3] : NULL;
+}
+
+int wave_engine_set_speed(wave_engine *e, const double *c) {
+	if (!e) return -1;
+	if (!c) {
+		free(e->k2);
+		e->k2 = NULL;
+		return 0;
+	}
+	const double limit = wave_engine_k2_limit(e);
+	double *k2 = e->k2 ? e->k2 : malloc(e->n * sizeof(double));
+	if (!k2) return -1;
+	for (size_t i = 0; i < e->n; i++) {
+		double k = (c[i] * e->dt) * (c[i] * e->dt);
+		if (c[i] < 0.0 || k > limit) {
+			if (!e->k2) free(k2);
+			return -1;
+		}
+		k2[i] = k;
+	}
+	e->k2 = k2;
+	return 0;
+}
+
+int wave_engine_set_blocking(wave_engine *e, size_t block_y, size_t block_z, size_t time_tile) {
+	if (!e) return -1;
+	e->block_y = block_y;
+	e->block_z = block_z;
+	e->time_tile = time_tile;
+	return 0;
+}
+
+int wave_engine_set_threads(wave_engine *e, int n_threads) {
+	if (!e) return -1;
+	if (n_threads < 0) {
+#ifdef _OPENMP
+		n_threads = omp_get_max_threads();
+#else
+		n_threads = 1;
+#endif
+	}
+	e->n_threads = n_threads;
+	return n_threads;
+}
+
+/* Compute level L on the interior rows [y0, y1) x [z0, z1) from levels L - 1 and L - 2. */
+static void wave_engine_rows(const wave_engine *e, size_t L, size_t y0, size_t y1, size_t z0, size_t z1) {
+	const size_t nx = e->nx, ny = e->ny;
+	/* Collapsed axes get stride 0, which makes their second difference vanish. */
+	const size_t sx = nx > 1 ? 1 : 0, sy = ny > 1 ? nx : 0, sz = e->nz > 1 ? nx * ny : 0;
+	const double lx = sx ? 1.0 / (e->dx * e->dx) : 0.0, ly = sy ? 1.0 / (e->dy * e->dy) : 0.0,
+	             lz = sz ? 1.0 / (e->dz * e->dz) : 0.0;
+	const double *restrict u = e->buf[(L + 2) % 3], *restrict up = e->buf[(L + 1) % 3];
+	double *restrict un = e->buf[L % 3];
+	const double *k2 = e->k2, kc = (e->c * e->dt) * (e->c * e->dt);
+	size_t x0, x1;
+	wave_axis_interior(nx, &x0, &x1);
+
+	for (size_t z = z0; z < z1; z++) {
+		for (size_t y = y0; y < y1; y++) {
+			const size_t row = (z * ny + y) * nx;
+			if (k2) {
+				#pragma omp simd
+				for (size_t i = row + x0; i < row + x1; i++) {
+					const double c2 = 2.0 * u[i];
+					const double lap = lx * (u[i - sx] + u[i + sx] - c2) + ly * (u[i - sy] + u[i + sy] - c2) +
+					                   lz * (u[i - sz] + u[i + sz] - c2);
+					un[i] = c2 - up[i] + k2[i] * lap;
+				}
+			} else {
+				#pragma omp simd
+				for (size_t i = row + x0; i < row + x1; i++) {
+					const double c2 = 2.0 * u[i];
+					const double lap = lx * (u[i - sx] + u[i + sx] - c2) + ly * (u[i - sy] + u[i + sy] - c2) +
+					                   lz * (u[i - sz] + u[i + sz] - c2);
+					un[i] = c2 - up[i] + kc * lap;
+				}
+			}
+		}
+	}
+}
+
+/* Hold the boundary layer of the current level in the other two buffers. */
+static void wave_engine_pin_boundary(wave_engine *e) {
+	const size_t nx = e->nx, ny = e->ny, nz = e->nz;
+	const double *u = e->buf[e->level % 3];
+	double *a = e->buf[(e->level + 1) % 3], *b = e->buf[(e->level + 2) % 3];
+	for (size_t z = 0; z < nz; z++) {
+		for (size_t y = 0; y < ny; y++) {
+			const size_t row = (z * ny + y) * nx;
+			const int face = (nz > 1 && (z == 0 || z == nz - 1)) || (ny > 1 && (y == 0 || y == ny - 1));
+			if (face) {
+				memcpy(a + row, u + row, nx * sizeof(double));
+				memcpy(b + row, u + row, nx * sizeof(double));
+			} else if (nx > 1) {
+				a[row] = b[row] = u[row];
+				a[row + nx - 1] = b[row + nx - 1] = u[row + nx - 1];
+			}
+		}
+	}
+}
+
+/* Copy the boundary layer of level `from` into level `to`. */
+static void wave_engine_carry_boundary(wave_engine *e, size_t from, size_t to) {
+	const size_t nx = e->nx, ny = e->ny, nz = e->nz;
+	const double *u = e->buf[from % 3];
+	double *a = e->buf[to % 3];
+	for (size_t z = 0; z < nz; z++) {
+		for (size_t y = 0; y < ny; y++) {
+			const size_t row = (z * ny + y) * nx;
+			const int face = (nz > 1 && (z == 0 || z == nz - 1)) || (ny > 1 && (y == 0 || y == ny - 1));
+			if (face) {
+				memcpy(a + row, u + row, nx * sizeof(double));
+			} else if (nx > 1) {
+				a[row] = u[row];
+				a[row + nx - 1] = u[row + nx - 1];
+			}
+		}
+	}
+}
+
+/* One step, tiled in y and z. */
+static void wave_engine_step_blocked(wave_engine *e, int nt) {
+	size_t y0, y1, z0, z1;
+	wave_axis_interior(e->ny, &y0, &y1);
+	wave_axis_interior(e->nz, &z0, &z1);
+	size_t by = e->block_y, bz = e->block_z;
+	if (by == 0) {
+		/* Three planes of a tile's rows, plus the two other levels, in cache. */
+		by = WAVE_ENGINE_CACHE_BYTES / (5 * e->nx * sizeof(double));
+		if (by < 1) by = 1;
+	}
+	if (bz == 0) bz = 16;
+	const size_t ty = (y1 - y0 + by - 1) / by, tz = (z1 - z0 + bz - 1) / bz;
+	const size_t L = e->level + 1;
+
+	#pragma omp parallel for collapse(2) schedule(static) num_threads(nt) if(nt > 1)
+	for (size_t kz = 0; kz < tz; kz++) {
+		for (size_t ky = 0; ky < ty; ky++) {
+			const size_t ya = y0 + ky * by, za = z0 + kz * bz;
+			const size_t yb = ya + by < y1 ? ya + by : y1, zb = za + bz < z1 ? za + bz : z1;
+			wave_engine_rows(e, L, ya, yb, za, zb);
+		}
+	}
+	e->level = L;
+}
+
+/* Rows [a, b) of the tiling axis as a (y, z) range. */
+static void wave_engine_slab(const wave_engine *e, int axis_z, size_t L, size_t a, size_t b) {
+	if (a >= b) return;
+	if (axis_z) {
+		size_t y0, y1;
+		wave_axis_interior(e->ny, &y0, &y1);
+		wave_engine_rows(e, L, y0, y1, a, b);
+	} else {
+		wave_engine_rows(e, L, a, b, 0, 1);
+	}
+}
+
+/*
+    T steps over slabs of the outermost non-collapsed axis. Slab s covers
+    [edge[s], edge[s + 1]); at sub-step q its trapezoid shrinks by q - 1 on
+    every side facing another slab. The valley around an inner edge z then
+    covers [z - (q - 1), z + (q - 1)). Level L shares its buffer with L + 3,
+    which a trapezoid only writes strictly inside the region the valleys
+    still need at level L, so three buffers suffice.
+*/
+static int wave_engine_step_temporal(wave_engine *e, size_t T, int nt) {
+	const int axis_z = e->nz > 1;
+	const size_t count = axis_z ? e->nz : e->ny;
+	const size_t plane = axis_z ? e->nx * e->ny : e->nx;
+	size_t lo, hi;
+	wave_axis_interior(count, &lo, &hi);
+	const size_t W = hi - lo;
+
+	size_t height = WAVE_ENGINE_CACHE_BYTES / (3 * plane * sizeof(double));
+	if (height < 2 * T) height = 2 * T;
+	size_t slabs = W / height;
+	if (slabs < 1) slabs = 1;
+	size_t *edge = malloc((slabs + 1) * sizeof(size_t));
+	if (!edge) return -1;
+	for (size_t s = 0; s <= slabs; s++) edge[s] = lo + s * W / slabs;
+
+	const size_t L0 = e->level;
+	#pragma omp parallel num_threads(nt) if(nt > 1)
+	{
+		#pragma omp for schedule(dynamic, 1)
+		for (size_t s = 0; s < slabs; s++) {
+			for (size_t q = 1; q <= T; q++) {
+				const size_t a = edge[s] + (s > 0 ? q - 1 : 0);
+				const size_t b = edge[s + 1] - (s + 1 < slabs ? q - 1 : 0);
+				wave_engine_slab(e, axis_z, L0 + q, a, b);
+			}
+		}
+		#pragma omp for schedule(dynamic, 1)
+		for (size_t s = 1; s < slabs; s++) {
+			for (size_t q = 2; q <= T; q++)
+				wave_engine_slab(e, axis_z, L0 + q, edge[s] - (q - 1), edge[s] + (q - 1));
+		}
+	}
+	free(edge);
+	e->level = L0 + T;
+	return 0;
+}
+
+int wave_engine_step(wave_engine *e, size_t n_steps) {
+    HOLOS_TRACE_ZONE("wave_engine_step");
+	if (!e) return -1;
+	if (n_steps == 0) return 0;
+	wave_engine_pin_boundary(e);
+	const int nt = e->n_threads > 0 ? e->n_threads : 1;
+
+	const size_t T = e->time_tile > 1 ? e->time_tile : 1;
+
+	size_t done = 0;
+	while (done < n_steps) {
+		const size_t chunk = T > 1 && n_steps - done >= 2 ? (n_steps - done < T ? n_steps - done : T) : 1;
+		if (chunk > 1) {
+			if (wave_engine_step_temporal(e, chunk, nt) != 0) return -1;
+		} else {
+			wave_engine_step_blocked(e, nt);
+		}
+		done += chunk;
+	}
+	e->t += (double)n_steps * e->dt;
+	return 0;
+}
+
+int wave_engine_step_rows(wave_engine *e, size_t y0, size_t y1, size_t z0, size_t z1) {
+	if (!e) return -1;
+	size_t ylo, yhi, zlo, zhi;
+	wave_axis_interior(e->ny, &ylo, &yhi);
+	wave_axis_interior(e->nz, &zlo, &zhi);
+	if (y0 < ylo) y0 = ylo;
+	if (y1 > yhi) y1 = yhi;
+	if (z0 < zlo) z0 = zlo;
+	if (z1 > zhi) z1 = zhi;
+	if (y0 >= y1 || z0 >= z1) return 0;
+
+	const int nt = e->n_threads > 0 ? e->n_threads : 1;
+	const size_t L = e->level + 1;
+	#pragma omp parallel for collapse(2) schedule(static) num_threads(nt) if(nt > 1)
+	for (size_t z = z0; z < z1; z++)
+		for (size_t y = y0; y < y1; y++)
+			wave_engine_rows(e, L, y, y + 1, z, z + 1);
+	return 0;
+}
+
+int wave_engine_advance(wave_engine *e) {
+	if (!e) return -1;
+	wave_engine_carry_boundary(e, e->level, e->level + 1);
+	e->level++;
+	e->t += e->dt;
+	return 0;
+}
@@ -0,0 +1,322 @@
+/*
+	qft_correlator.c - Lattice two-point functions for HOLOS
+
+	Streaming correlator of qft.h:
+	- A configuration costs one forward FFT (GSL mixed radix, any extent),
+	  axis by axis, with the lines of an axis spread over the threads;
+	  only its power spectrum is kept, summed with the others
+	- The connected part is taken in momentum space, where the mean only
+	  feeds k = 0
+	- Results need one inverse transform: over all axes for G(r), or over
+	  the time axis at a fixed spatial momentum for the projected C(t)
+
+	Copyright (C) 2025 HOLOS Scientific Computing Project
+
+	This file is part of HOLOS.
+
+	HOLOS is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 3 of the License, or
+	(at your option) any later version.
+
+	HOLOS is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with HOLOS; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include <gsl/gsl_errno.h>
+#include <gsl/gsl_fft_complex.h>
+
+#include "core/phys/fields/qft.h"
+
+typedef struct {
+	double *buf;                                    /* Interleaved complex, volume */
+	gsl_fft_complex_wavetable *wt[QFT_LATTICE_MAX_DIM];
+	gsl_fft_complex_workspace **ws;                 /* Per thread and axis */
+	int n_ws;                                       /* Threads ws is sized for */
+} qft_corr_work;
+
+static int qft_threads(int n_threads) {
+	if (n_threads < 0) {
+#ifdef _OPENMP
+		return omp_get_max_threads();
+#else
+		return 1;
+#endif
+	}
+	return n_threads > 0 ? n_threads : 1;
+}
+
+static void qft_corr_free_ws(qft_correlator_t *c) {
+	qft_corr_work *wk = c->work;
+
+	if (!wk->ws)
+		return;
+	for (size_t i = 0; i < (size_t)wk->n_ws * c->dim; i++)
+		if (wk->ws[i])
+			gsl_fft_complex_workspace_free(wk->ws[i]);
+	free(wk->ws);
+	wk->ws = NULL;
+	wk->n_ws = 0;
+}
+
+qft_correlator_t *qft_correlator_alloc(size_t dim, const size_t *L) {
+	qft_correlator_t *c;
+	qft_corr_work *wk;
+	size_t volume = 1;
+
+	if (dim == 0 || dim > QFT_LATTICE_MAX_DIM || !L)
+		return NULL;
+	for (size_t mu = 0; mu < dim; mu++) {
+		if (L[mu] == 0 || volume > ((size_t)-1) / (2 * L[mu]))
+			return NULL;
+		volume *= L[mu];
+	}
+	c = calloc(1, sizeof(*c));
+	wk = calloc(1, sizeof(*wk));
+	if (!c || !wk) {
+		free(c);
+		free(wk);
+		return NULL;
+	}
+	c->work = wk;
+	c->dim = dim;
+	for (size_t mu = 0; mu < dim; mu++)
+		c->L[mu] = L[mu];
+	c->volume = volume;
+	c->power = calloc(volume, sizeof(double));
+	wk->buf = malloc(2 * volume * sizeof(double));
+	if (!c->power || !wk->buf) {
+		qft_correlator_free(c);
+		return NULL;
+	}
+	for (size_t mu = 0; mu < dim; mu++) {
+		wk->wt[mu] = gsl_fft_complex_wavetable_alloc(L[mu]);
+		if (!wk->wt[mu]) {
+			qft_correlator_free(c);
+			return NULL;
+		}
+	}
+	return c;
+}
+
+void qft_correlator_free(qft_correlator_t *c) {
+	qft_corr_work *wk;
+
+	if (!c)
+		return;
+	wk = c->work;
+	if (wk) {
+		qft_corr_free_ws(c);
+		for (size_t mu = 0; mu < c->dim; mu++)
+			if (wk->wt[mu])
+				gsl_fft_complex_wavetable_free(wk->wt[mu]);
+		free(wk->buf);
+		free(wk);
+	}
+	free(c->power);
+	free(c);
+}
+
+void qft_correlator_reset(qft_correlator_t *c) {
+	if (!c)
+		return;
+	memset(c->power, 0, c->volume * sizeof(double));
+	c->sum_mean = 0.0;
+	c->n_configs = 0;
+}
+
+/* -------------------------------
+   Transforms
+   ------------------------------- */
+
+static int qft_corr_workspaces(qft_correlator_t *c, int nt) {
+	qft_corr_work *wk = c->work;
+
+	if (wk->n_ws >= nt)
+		return 0;
+	qft_corr_free_ws(c);
+	wk->ws = calloc((size_t)nt * c->dim, sizeof(*wk->ws));
+	if (!wk->ws)
+		return -1;
+	wk->n_ws = nt;
+	for (int t = 0; t < nt; t++) {
+		for (size_t mu = 0; mu < c->dim; mu++) {
+			wk->ws[(size_t)t * c->dim + mu] = gsl_fft_complex_workspace_alloc(c->L[mu]);
+			if (!wk->ws[(size_t)t * c->dim + mu])
+				return -1;
+		}
+	}
+	return 0;
+}
+
+/* FFT of wk->buf along every axis, forward or backward (unnormalized) */
+static int qft_corr_fft(qft_correlator_t *c, int backward, int nt) {
+	qft_corr_work *wk = c->work;
+	size_t stride = c->volume;
+	int failed = 0;
+
+	if (qft_corr_workspaces(c, nt) != 0)
+		return -1;
+	for (size_t mu = 0; mu < c->dim; mu++) {
+		const size_t n = c->L[mu], n_lines = c->volume / n;
+		stride /= n;
+		#pragma omp parallel for schedule(static) num_threads(nt) reduction(|:failed) if(nt > 1 && n_lines > 1)
+		for (size_t line = 0; line < n_lines; line++) {
+#ifdef _OPENMP
+			const size_t t = (size_t)omp_get_thread_num();
+#else
+			const size_t t = 0;
+#endif
+			const size_t base = (line / stride) * n * stride + line % stride;
+			double *data = wk->buf + 2 * base;
+			gsl_fft_complex_workspace *ws = wk->ws[t * c->dim + mu];
+			const int status = backward ? gsl_fft_complex_backward(data, stride, n, wk->wt[mu], ws)
+			                            : gsl_fft_complex_forward(data, stride, n, wk->wt[mu], ws);
+			if (status != GSL_SUCCESS)
+				failed |= 1;
+		}
+	}
+	return failed ? -1 : 0;
+}
+
+/* -------------------------------
+   Accumulation
+   ------------------------------- */
+
+/* wk->buf holds the configuration in its real parts */
+static int qft_corr_accumulate(qft_correlator_t *c, int nt) {
+	qft_corr_work *wk = c->work;
+	const double *buf = wk->buf;
+
+	if (qft_corr_fft(c, 0, nt) != 0)
+		return -1;
+	#pragma omp parallel for simd schedule(static) num_threads(nt) if(nt > 1 && c->volume > 4096)
+	for (size_t k = 0; k < c->volume; k++)
+		c->power[k] += buf[2 * k] * buf[2 * k] + buf[2 * k + 1] * buf[2 * k + 1];
+	c->sum_mean += buf[0] / (double)c->volume;
+	c->n_configs++;
+	return 0;
+}
+
+int qft_correlator_add(qft_correlator_t *c, const double *phi) {
+	qft_corr_work *wk;
+	int nt;
+
+	if (!c || !phi)
+		return -1;
+	wk = c->work;
+	nt = qft_threads(c->n_threads);
+	#pragma omp parallel for schedule(static) num_threads(nt) if(nt > 1 && c->volume > 4096)
+	for (size_t i = 0; i < c->volume; i++) {
+		wk->buf[2 * i] = phi[i];
+		wk->buf[2 * i + 1] = 0.0;
+	}
+	return qft_corr_accumulate(c, nt);
+}
+
+int qft_correlator_add_lattice(qft_correlator_t *c, const qft_lattice_t *lat) {
+	qft_corr_work *wk;
+	int nt;
+
+	if (!c || !lat || lat->dim != c->dim)
+		return -1;
+	for (size_t mu = 0; mu < c->dim; mu++)
+		if (lat->L[mu] != c->L[mu])
+			return -1;
+	wk = c->work;
+	nt = qft_threads(c->n_threads);
+	#pragma omp parallel for schedule(static) num_threads(nt) if(nt > 1 && c->volume > 4096)
+	for (size_t i = 0; i < c->volume; i++) {
+		size_t x[QFT_LATTICE_MAX_DIM], rest = i;
+		for (size_t mu = c->dim; mu-- > 0;) {
+			x[mu] = rest % c->L[mu];
+			rest /= c->L[mu];
+		}
+		wk->buf[2 * i] = lat->phi[qft_lattice_index(lat, x)];
+		wk->buf[2 * i + 1] = 0.0;
+	}
+	return qft_corr_accumulate(c, nt);
+}
+
+/* -------------------------------
+   Results
+   ------------------------------- */
+
+/* wk->buf = connected ensemble power spectrum */
+static void qft_corr_connected(qft_correlator_t *c) {
+	qft_corr_work *wk = c->work;
+	const double inv = 1.0 / (double)c->n_configs, mean = c->sum_mean * inv;
+	const double V = (double)c->volume;
+
+	for (size_t k = 0; k < c->volume; k++) {
+		wk->buf[2 * k] = c->power[k] * inv;
+		wk->buf[2 * k + 1] = 0.0;
+	}
+	wk->buf[0] -= V * V * mean * mean;
+}
+
+int qft_correlator_result(qft_correlator_t *c, double *G) {
+	qft_corr_work *wk;
+	const double scale = c ? 1.0 / ((double)c->volume * (double)c->volume) : 0.0;
+
+	if (!c || !G || c->n_configs == 0)
+		return -1;
+	wk = c->work;
+	qft_corr_connected(c);
+	if (qft_corr_fft(c, 1, qft_threads(c->n_threads)) != 0)
+		return -1;
+	for (size_t r = 0; r < c->volume; r++)
+		G[r] = wk->buf[2 * r] * scale;
+	return 0;
+}
+
+int qft_correlator_project(qft_correlator_t *c, size_t time, const size_t *p, double *C) {
+	qft_corr_work *wk;
+	double *line;
+	size_t stride = 1, base = 0;
+	int status;
+
+	if (!c || !C || time >= c->dim || (c->dim > 1 && !p) || c->n_configs == 0)
+		return -1;
+	if (qft_corr_workspaces(c, 1) != 0)
+		return -1;
+	wk = c->work;
+	qft_corr_connected(c);
+
+	/* Line k = (k_time, p) of the spectrum */
+	for (size_t mu = c->dim; mu-- > 0;) {
+		if (mu == time) {
+			stride = 1;
+			for (size_t nu = mu + 1; nu < c->dim; nu++)
+				stride *= c->L[nu];
+		} else {
+			size_t s = 1;
+			for (size_t nu = mu + 1; nu < c->dim; nu++)
+				s *= c->L[nu];
+			base += (p[mu] % c->L[mu]) * s;
+		}
+	}
+	line = malloc(2 * c->L[time] * sizeof(double));
+	if (!line)
+		return -1;
+	for (size_t k = 0; k < c->L[time]; k++) {
+		line[2 * k] = wk->buf[2 * (base + k * stride)];
+		line[2 * k + 1] = 0.0;
+	}
+	status = gsl_fft_complex_backward(line, 1, c->L[time], wk->wt[time], wk->ws[time]);
+	for (size_t t = 0; t < c->L[time]; t++)
+		C[t] = line[2 * t] / ((double)c->volume * (double)c->L[time]);
+	free(line);
+	return status == GSL_SUCCESS ? 0 : -1;
+}
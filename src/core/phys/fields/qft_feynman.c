@@ -0,0 +1,782 @@
+/*
+	qft_feynman.c - Feynman diagram topologies and memoized evaluation for HOLOS
+
+	Canonical topologies and the reduction cache of qft.h:
+	- Vertices are coloured by their legs and degree, then refined by the
+	  colours and masses of their neighbours until stable; the canonical
+	  labelling is the smallest sorted edge list over the orderings left
+	  inside each colour class (only the refined order when those are too
+	  many, which can split a class of equivalent diagrams but never
+	  merge distinct ones: cache keys are compared in full)
+	- The cache is an open-addressing table keyed by the canonical graph
+	  and the kinematics, compared bit for bit
+	- A batch is keyed in parallel, missing reductions are collected once
+	  each and run in parallel, then every value is assembled in parallel;
+	  the result does not depend on the thread count
+	- The on-disk file holds the reductions only, written to a temporary
+	  file and renamed
+
+	Copyright (C) 2025 HOLOS Scientific Computing Project
+
+	This file is part of HOLOS.
+
+	HOLOS is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 3 of the License, or
+	(at your option) any later version.
+
+	HOLOS is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with HOLOS; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "core/phys/fields/qft.h"
+
+#define QFT_TOPO_MAX_ORDERINGS 40320   /* 8!, labellings tried per topology */
+#define QFT_FDC_MAGIC "HOLOSFDC"
+#define QFT_FDC_VERSION 1u
+
+typedef struct {
+	size_t u, v;
+	double m;
+} qft_edge;
+
+static int qft_threads(int n_threads) {
+	if (n_threads < 0) {
+#ifdef _OPENMP
+		return omp_get_max_threads();
+#else
+		return 1;
+#endif
+	}
+	return n_threads > 0 ? n_threads : 1;
+}
+
+static uint64_t qft_fnv(uint64_t h, const void *data, size_t size) {
+	const unsigned char *p = data;
+
+	for (size_t i = 0; i < size; i++) {
+		h ^= p[i];
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+
+/* -------------------------------
+   Canonical labelling
+   ------------------------------- */
+
+static int qft_edge_cmp(const void *a, const void *b) {
+	const qft_edge *x = a, *y = b;
+
+	if (x->u != y->u)
+		return x->u < y->u ? -1 : 1;
+	if (x->v != y->v)
+		return x->v < y->v ? -1 : 1;
+	if (x->m != y->m)
+		return x->m < y->m ? -1 : 1;
+	return 0;
+}
+
+/* Refinement signatures: colour, then (neighbour colour, mass) sorted */
+typedef struct {
+	double *sig;
+	size_t len;
+	size_t vertex;
+} qft_sig;
+
+static int qft_pair_cmp(const void *a, const void *b) {
+	const double *x = a, *y = b;
+
+	if (x[0] != y[0])
+		return x[0] < y[0] ? -1 : 1;
+	if (x[1] != y[1])
+		return x[1] < y[1] ? -1 : 1;
+	return 0;
+}
+
+static int qft_sig_cmp(const void *a, const void *b) {
+	const qft_sig *x = a, *y = b;
+	const size_t n = x->len < y->len ? x->len : y->len;
+
+	for (size_t k = 0; k < n; k++)
+		if (x->sig[k] != y->sig[k])
+			return x->sig[k] < y->sig[k] ? -1 : 1;
+	if (x->len != y->len)
+		return x->len < y->len ? -1 : 1;
+	return x->vertex < y->vertex ? -1 : (x->vertex > y->vertex);
+}
+
+static int qft_sig_same(const qft_sig *x, const qft_sig *y) {
+	if (x->len != y->len)
+		return 0;
+	for (size_t k = 0; k < x->len; k++)
+		if (x->sig[k] != y->sig[k])
+			return 0;
+	return 1;
+}
+
+static int qft_next_permutation(size_t *a, size_t n) {
+	size_t i, j;
+
+	if (n < 2)
+		return 0;
+	i = n - 1;
+	while (i > 0 && a[i - 1] >= a[i])
+		i--;
+	if (i == 0) {
+		for (size_t l = 0, r = n - 1; l < r; l++, r--) {
+			const size_t t = a[l];
+			a[l] = a[r];
+			a[r] = t;
+		}
+		return 0;
+	}
+	j = n - 1;
+	while (a[j] <= a[i - 1])
+		j--;
+	{
+		const size_t t = a[i - 1];
+		a[i - 1] = a[j];
+		a[j] = t;
+	}
+	for (size_t l = i, r = n - 1; l < r; l++, r--) {
+		const size_t t = a[l];
+		a[l] = a[r];
+		a[r] = t;
+	}
+	return 1;
+}
+
+/* order[k] = vertex given canonical label k */
+static int qft_canonical_order(size_t n, const qft_edge *edges, size_t ne, const size_t *legs, size_t *order) {
+	size_t *color = calloc(n, sizeof(size_t)), *deg = calloc(n, sizeof(size_t)), *pi = malloc(n * sizeof(size_t));
+	qft_sig *sigs = calloc(n, sizeof(qft_sig));
+	qft_edge *cand = malloc((ne ? ne : 1) * sizeof(qft_edge)), *best = malloc((ne ? ne : 1) * sizeof(qft_edge));
+	size_t n_colors = 0, orderings = 1;
+	int status = -1;
+
+	if (!color || !deg || !pi || !sigs || !cand || !best)
+		goto done;
+	for (size_t e = 0; e < ne; e++) {
+		deg[edges[e].u]++;
+		deg[edges[e].v]++;
+	}
+	for (size_t v = 0; v < n; v++) {
+		sigs[v].sig = malloc((2 + 2 * deg[v]) * sizeof(double));
+		if (!sigs[v].sig)
+			goto done;
+	}
+
+	/* Colour refinement, starting from (legs, degree) */
+	for (size_t round = 0; round <= n; round++) {
+		size_t count = 0;
+		for (size_t v = 0; v < n; v++) {
+			qft_sig *s = &sigs[v];
+			s->vertex = v;
+			s->len = 2;
+			s->sig[0] = round ? (double)color[v] : (double)legs[v];
+			s->sig[1] = round ? 0.0 : (double)deg[v];
+			for (size_t e = 0; e < ne; e++) {
+				if (edges[e].u == v) {
+					s->sig[s->len++] = round ? (double)color[edges[e].v] : 0.0;
+					s->sig[s->len++] = edges[e].m;
+				}
+				if (edges[e].v == v) {
+					s->sig[s->len++] = round ? (double)color[edges[e].u] : 0.0;
+					s->sig[s->len++] = edges[e].m;
+				}
+			}
+			qsort(s->sig + 2, (s->len - 2) / 2, 2 * sizeof(double), qft_pair_cmp);
+		}
+		qsort(sigs, n, sizeof(qft_sig), qft_sig_cmp);
+		for (size_t k = 0; k < n; k++) {
+			if (k > 0 && !qft_sig_same(&sigs[k], &sigs[k - 1]))
+				count++;
+			order[k] = sigs[k].vertex;
+			pi[k] = count;
+		}
+		for (size_t k = 0; k < n; k++)
+			color[order[k]] = pi[k];
+		if (n && count + 1 == n_colors)
+			break;
+		n_colors = n ? count + 1 : 0;
+	}
+
+	/* Orderings within the colour classes */
+	for (size_t k = 0, len = 0; k < n; k++) {
+		len = k > 0 && color[order[k]] == color[order[k - 1]] ? len + 1 : 1;
+		if (orderings <= QFT_TOPO_MAX_ORDERINGS)
+			orderings *= len;
+	}
+	if (orderings <= QFT_TOPO_MAX_ORDERINGS && ne > 0) {
+		size_t *trial = malloc(n * sizeof(size_t));
+		int have = 0;
+		if (!trial)
+			goto done;
+		memcpy(trial, order, n * sizeof(size_t));
+		for (;;) {
+			for (size_t k = 0; k < n; k++)
+				pi[trial[k]] = k;
+			for (size_t e = 0; e < ne; e++) {
+				const size_t a = pi[edges[e].u], b = pi[edges[e].v];
+				cand[e].u = a < b ? a : b;
+				cand[e].v = a < b ? b : a;
+				cand[e].m = edges[e].m;
+			}
+			qsort(cand, ne, sizeof(qft_edge), qft_edge_cmp);
+			{
+				int better = !have;
+				for (size_t e = 0; e < ne && !better; e++) {
+					const int c = qft_edge_cmp(&cand[e], &best[e]);
+					if (c != 0) {
+						better = c < 0;
+						break;
+					}
+				}
+				if (better) {
+					memcpy(best, cand, ne * sizeof(qft_edge));
+					memcpy(order, trial, n * sizeof(size_t));
+					have = 1;
+				}
+			}
+			/* Odometer over the classes */
+			{
+				size_t k = 0;
+				int advanced = 0;
+				while (k < n && !advanced) {
+					size_t end = k + 1;
+					while (end < n && color[trial[end]] == color[trial[k]])
+						end++;
+					advanced = qft_next_permutation(trial + k, end - k);
+					k = end;
+				}
+				if (!advanced)
+					break;
+			}
+		}
+		free(trial);
+	}
+	status = 0;
+done:
+	if (sigs)
+		for (size_t v = 0; v < n; v++)
+			free(sigs[v].sig);
+	free(sigs);
+	free(color);
+	free(deg);
+	free(pi);
+	free(cand);
+	free(best);
+	return status;
+}
+
+/* -------------------------------
+   Topologies
+   ------------------------------- */
+
+qft_topology_t *qft_topology_alloc(const qft_feynman_diagram_t *diagram) {
+	const qft_field_t **seen = NULL;
+	size_t *first = NULL, *count = NULL, n_seen = 0, n_occ = 0, ne = 0;
+	size_t *legs = NULL, *order = NULL, *label = NULL;
+	qft_edge *edges = NULL;
+	qft_topology_t *topo = NULL;
+	size_t n;
+
+	if (!diagram || (diagram->n_vertices && !diagram->vertices))
+		return NULL;
+	n = diagram->n_vertices;
+	for (size_t i = 0; i < n; i++) {
+		if (!diagram->vertices[i] || (diagram->vertices[i]->n_fields && !diagram->vertices[i]->fields))
+			return NULL;
+		n_occ += diagram->vertices[i]->n_fields;
+	}
+	seen = malloc((n_occ ? n_occ : 1) * sizeof(*seen));
+	first = malloc((n_occ ? n_occ : 1) * sizeof(size_t));
+	count = calloc(n_occ ? n_occ : 1, sizeof(size_t));
+	edges = malloc((n_occ ? n_occ : 1) * sizeof(qft_edge));
+	legs = calloc(n ? n : 1, sizeof(size_t));
+	order = malloc((n ? n : 1) * sizeof(size_t));
+	label = malloc((n ? n : 1) * sizeof(size_t));
+	if (!seen || !first || !count || !edges || !legs || !order || !label)
+		goto fail;
+
+	/* Lines: each field object at most twice */
+	for (size_t i = 0; i < n; i++) {
+		const qft_interaction_t *vx = diagram->vertices[i];
+		for (size_t f = 0; f < vx->n_fields; f++) {
+			const qft_field_t *field = vx->fields[f];
+			size_t s = 0;
+			if (!field)
+				goto fail;
+			while (s < n_seen && seen[s] != field)
+				s++;
+			if (s == n_seen) {
+				seen[n_seen] = field;
+				first[n_seen++] = i;
+			} else if (count[s] == 1) {
+				edges[ne].u = first[s] < i ? first[s] : i;
+				edges[ne].v = first[s] < i ? i : first[s];
+				edges[ne].m = field->mass;
+				ne++;
+			} else {
+				goto fail;
+			}
+			count[s]++;
+		}
+	}
+	for (size_t s = 0; s < n_seen; s++)
+		if (count[s] == 1)
+			legs[first[s]]++;
+
+	if (qft_canonical_order(n, edges, ne, legs, order) != 0)
+		goto fail;
+	topo = calloc(1, sizeof(*topo));
+	if (!topo)
+		goto fail;
+	topo->n_vertices = n;
+	topo->n_edges = ne;
+	topo->edges = malloc((ne ? 2 * ne : 1) * sizeof(size_t));
+	topo->masses = malloc((ne ? ne : 1) * sizeof(double));
+	topo->legs = malloc((n ? n : 1) * sizeof(size_t));
+	if (!topo->edges || !topo->masses || !topo->legs)
+		goto fail;
+	for (size_t k = 0; k < n; k++) {
+		label[order[k]] = k;
+		topo->legs[k] = legs[order[k]];
+	}
+	for (size_t e = 0; e < ne; e++) {
+		const size_t a = label[edges[e].u], b = label[edges[e].v];
+		edges[e].u = a < b ? a : b;
+		edges[e].v = a < b ? b : a;
+	}
+	qsort(edges, ne, sizeof(qft_edge), qft_edge_cmp);
+	topo->hash = 0xcbf29ce484222325ULL;
+	{
+		const uint64_t hdr[2] = { n, ne };
+		topo->hash = qft_fnv(topo->hash, hdr, sizeof(hdr));
+	}
+	for (size_t k = 0; k < n; k++) {
+		const uint64_t l = topo->legs[k];
+		topo->hash = qft_fnv(topo->hash, &l, sizeof(l));
+	}
+	for (size_t e = 0; e < ne; e++) {
+		const uint64_t uv[2] = { edges[e].u, edges[e].v };
+		topo->edges[2 * e] = edges[e].u;
+		topo->edges[2 * e + 1] = edges[e].v;
+		topo->masses[e] = edges[e].m;
+		topo->hash = qft_fnv(topo->hash, uv, sizeof(uv));
+	}
+	free(seen);
+	free(first);
+	free(count);
+	free(edges);
+	free(legs);
+	free(order);
+	free(label);
+	return topo;
+
+fail:
+	qft_topology_free(topo);
+	free(seen);
+	free(first);
+	free(count);
+	free(edges);
+	free(legs);
+	free(order);
+	free(label);
+	return NULL;
+}
+
+void qft_topology_free(qft_topology_t *topo) {
+	if (!topo)
+		return;
+	free(topo->edges);
+	free(topo->masses);
+	free(topo->legs);
+	free(topo);
+}
+
+int qft_topology_equal(const qft_topology_t *a, const qft_topology_t *b) {
+	if (!a || !b || a->hash != b->hash || a->n_vertices != b->n_vertices || a->n_edges != b->n_edges)
+		return 0;
+	return memcmp(a->legs, b->legs, a->n_vertices * sizeof(size_t)) == 0
+	       && memcmp(a->edges, b->edges, 2 * a->n_edges * sizeof(size_t)) == 0
+	       && memcmp(a->masses, b->masses, a->n_edges * sizeof(double)) == 0;
+}
+
+/* -------------------------------
+   Reduction cache
+   ------------------------------- */
+
+typedef struct {
+	uint64_t hash;
+	uint64_t *key;                  /* n_vertices, n_edges, legs, edge pairs */
+	size_t n_key;
+	double *kin;
+	size_t n_kin;
+	double *coeffs;
+	int ready;
+} qft_fdc_entry;
+
+typedef struct {
+	qft_fdc_entry **slots;
+	size_t cap, count;
+} qft_fdc;
+
+static size_t qft_topo_key(const qft_topology_t *topo, uint64_t *key) {
+	size_t k = 0;
+
+	key[k++] = topo->n_vertices;
+	key[k++] = topo->n_edges;
+	for (size_t v = 0; v < topo->n_vertices; v++)
+		key[k++] = topo->legs[v];
+	for (size_t e = 0; e < 2 * topo->n_edges; e++)
+		key[k++] = topo->edges[e];
+	return k;
+}
+
+static uint64_t qft_fdc_hash(const uint64_t *key, size_t n_key, const double *kin, size_t n_kin) {
+	uint64_t h = qft_fnv(0xcbf29ce484222325ULL, key, n_key * sizeof(*key));
+	return qft_fnv(h, kin, n_kin * sizeof(*kin));
+}
+
+static void qft_fdc_entry_free(qft_fdc_entry *e) {
+	if (!e)
+		return;
+	free(e->key);
+	free(e->kin);
+	free(e->coeffs);
+	free(e);
+}
+
+static int qft_fdc_match(const qft_fdc_entry *e, uint64_t hash, const uint64_t *key, size_t n_key, const double *kin, size_t n_kin) {
+	return e->hash == hash && e->n_key == n_key && e->n_kin == n_kin
+	       && memcmp(e->key, key, n_key * sizeof(*key)) == 0 && memcmp(e->kin, kin, n_kin * sizeof(*kin)) == 0;
+}
+
+static int qft_fdc_grow(qft_fdc *c) {
+	const size_t cap = c->cap ? 2 * c->cap : 64;
+	qft_fdc_entry **slots = calloc(cap, sizeof(*slots));
+
+	if (!slots)
+		return -1;
+	for (size_t i = 0; i < c->cap; i++) {
+		qft_fdc_entry *e = c->slots[i];
+		if (e) {
+			size_t j = (size_t)e->hash & (cap - 1);
+			while (slots[j])
+				j = (j + 1) & (cap - 1);
+			slots[j] = e;
+		}
+	}
+	free(c->slots);
+	c->slots = slots;
+	c->cap = cap;
+	return 0;
+}
+
+/* Entry for the key, created (not ready) if absent */
+static qft_fdc_entry *qft_fdc_get(qft_fdc *c, const uint64_t *key, size_t n_key, const double *kin, size_t n_kin, size_t n_coeffs, int *created) {
+	const uint64_t hash = qft_fdc_hash(key, n_key, kin, n_kin);
+	qft_fdc_entry *e;
+	size_t j;
+
+	*created = 0;
+	if (2 * (c->count + 1) > c->cap && qft_fdc_grow(c) != 0)
+		return NULL;
+	for (j = (size_t)hash & (c->cap - 1); c->slots[j]; j = (j + 1) & (c->cap - 1))
+		if (qft_fdc_match(c->slots[j], hash, key, n_key, kin, n_kin))
+			return c->slots[j];
+	e = calloc(1, sizeof(*e));
+	if (!e)
+		return NULL;
+	e->hash = hash;
+	e->n_key = n_key;
+	e->n_kin = n_kin;
+	e->key = malloc((n_key ? n_key : 1) * sizeof(*key));
+	e->kin = malloc((n_kin ? n_kin : 1) * sizeof(*kin));
+	e->coeffs = calloc(n_coeffs ? n_coeffs : 1, sizeof(double));
+	if (!e->key || !e->kin || !e->coeffs) {
+		qft_fdc_entry_free(e);
+		return NULL;
+	}
+	memcpy(e->key, key, n_key * sizeof(*key));
+	memcpy(e->kin, kin, n_kin * sizeof(*kin));
+	c->slots[j] = e;
+	c->count++;
+	*created = 1;
+	return e;
+}
+
+/* -------------------------------
+   Engine
+   ------------------------------- */
+
+qft_diagram_engine_t *qft_diagram_engine_alloc(qft_reduce_fn reduce, qft_master_fn master, size_t n_coeffs, void *params) {
+	qft_diagram_engine_t *engine;
+
+	if (!reduce || !master || n_coeffs == 0)
+		return NULL;
+	engine = calloc(1, sizeof(*engine));
+	if (!engine)
+		return NULL;
+	engine->cache = calloc(1, sizeof(qft_fdc));
+	if (!engine->cache) {
+		free(engine);
+		return NULL;
+	}
+	engine->reduce = reduce;
+	engine->master = master;
+	engine->n_coeffs = n_coeffs;
+	engine->params = params;
+	return engine;
+}
+
+void qft_diagram_engine_free(qft_diagram_engine_t *engine) {
+	qft_fdc *c;
+
+	if (!engine)
+		return;
+	c = engine->cache;
+	if (c) {
+		for (size_t i = 0; i < c->cap; i++)
+			qft_fdc_entry_free(c->slots[i]);
+		free(c->slots);
+		free(c);
+	}
+	free(engine);
+}
+
+typedef struct {
+	qft_topology_t *topo;
+	uint64_t *key;
+	size_t n_key;
+	double *kin;
+	size_t n_kin;
+	double prefactor;
+	qft_fdc_entry *entry;
+} qft_fd_item;
+
+int qft_diagram_engine_evaluate(qft_diagram_engine_t *engine, qft_feynman_diagram_t *const *diagrams, size_t n,
+	const double *invariants, size_t n_invariants, double mu, double *values) {
+	qft_fd_item *items;
+	size_t *pending = NULL, n_pending = 0;
+	int failed = 0, nt;
+
+	if (!engine || (n && (!diagrams || !values)) || (n_invariants && !invariants))
+		return -1;
+	if (n == 0)
+		return 0;
+	items = calloc(n, sizeof(*items));
+	pending = malloc(n * sizeof(size_t));
+	if (!items || !pending) {
+		free(items);
+		free(pending);
+		return -1;
+	}
+	nt = qft_threads(engine->n_threads);
+
+	/* Canonical keys */
+	#pragma omp parallel for schedule(dynamic, 1) num_threads(nt) reduction(|:failed) if(nt > 1 && n > 1)
+	for (size_t i = 0; i < n; i++) {
+		qft_fd_item *it = &items[i];
+		const qft_feynman_diagram_t *d = diagrams[i];
+		it->topo = qft_topology_alloc(d);
+		if (!it->topo) {
+			failed |= 1;
+			continue;
+		}
+		it->n_kin = n_invariants + it->topo->n_edges;
+		it->key = malloc((2 + it->topo->n_vertices + 2 * it->topo->n_edges) * sizeof(uint64_t));
+		it->kin = malloc((it->n_kin ? it->n_kin : 1) * sizeof(double));
+		if (!it->key || !it->kin) {
+			failed |= 1;
+			continue;
+		}
+		it->n_key = qft_topo_key(it->topo, it->key);
+		if (n_invariants)
+			memcpy(it->kin, invariants, n_invariants * sizeof(double));
+		memcpy(it->kin + n_invariants, it->topo->masses, it->topo->n_edges * sizeof(double));
+		it->prefactor = 1.0;
+		for (size_t v = 0; v < d->n_vertices; v++)
+			it->prefactor *= d->vertices[v]->coupling;
+	}
+
+	/* Lookups, each missing reduction queued once */
+	for (size_t i = 0; i < n && !failed; i++) {
+		qft_fd_item *it = &items[i];
+		int created;
+		it->entry = qft_fdc_get(engine->cache, it->key, it->n_key, it->kin, it->n_kin, engine->n_coeffs, &created);
+		if (!it->entry) {
+			failed = 1;
+			break;
+		}
+		if (!it->entry->ready) {
+			size_t p = 0;
+			while (p < n_pending && items[pending[p]].entry != it->entry)
+				p++;
+			if (p == n_pending)
+				pending[n_pending++] = i;
+		} else {
+			engine->n_hits++;
+		}
+	}
+
+	/* Reductions */
+	if (!failed) {
+		#pragma omp parallel for schedule(dynamic, 1) num_threads(nt) reduction(|:failed) if(nt > 1 && n_pending > 1)
+		for (size_t p = 0; p < n_pending; p++) {
+			qft_fd_item *it = &items[pending[p]];
+			if (engine->reduce(it->topo, it->kin, it->n_kin, it->entry->coeffs, engine->n_coeffs, engine->params) == 0)
+				it->entry->ready = 1;
+			else
+				failed |= 1;
+		}
+		engine->n_reductions += n_pending;
+	}
+
+	/* Values */
+	if (!failed) {
+		#pragma omp parallel for schedule(dynamic, 1) num_threads(nt) if(nt > 1 && n > 1)
+		for (size_t i = 0; i < n; i++) {
+			const qft_fd_item *it = &items[i];
+			values[i] = it->prefactor * engine->master(it->topo, it->kin, it->n_kin, it->entry->coeffs, engine->n_coeffs, mu, engine->params);
+		}
+	}
+
+	for (size_t i = 0; i < n; i++) {
+		qft_topology_free(items[i].topo);
+		free(items[i].key);
+		free(items[i].kin);
+	}
+	free(items);
+	free(pending);
+	return failed ? -1 : 0;
+}
+
+/* -------------------------------
+   On-disk cache
+   ------------------------------- */
+
+int qft_diagram_engine_save(const qft_diagram_engine_t *engine, const char *path) {
+	const qft_fdc *c;
+	char *tmp;
+	FILE *fp;
+	int ok;
+	uint64_t count = 0, n_coeffs;
+	const uint32_t version = QFT_FDC_VERSION;
+
+	if (!engine || !path)
+		return -1;
+	c = engine->cache;
+	tmp = malloc(strlen(path) + 5);
+	if (!tmp)
+		return -1;
+	strcpy(tmp, path);
+	strcat(tmp, ".tmp");
+	fp = fopen(tmp, "wb");
+	if (!fp) {
+		free(tmp);
+		return -1;
+	}
+	for (size_t i = 0; i < c->cap; i++)
+		if (c->slots[i] && c->slots[i]->ready)
+			count++;
+	n_coeffs = engine->n_coeffs;
+	ok = fwrite(QFT_FDC_MAGIC, 1, 8, fp) == 8 && fwrite(&version, sizeof version, 1, fp) == 1
+	     && fwrite(&n_coeffs, sizeof n_coeffs, 1, fp) == 1 && fwrite(&count, sizeof count, 1, fp) == 1;
+	for (size_t i = 0; i < c->cap && ok; i++) {
+		const qft_fdc_entry *e = c->slots[i];
+		uint64_t nk, nq;
+		if (!e || !e->ready)
+			continue;
+		nk = e->n_key;
+		nq = e->n_kin;
+		ok = fwrite(&nk, sizeof nk, 1, fp) == 1 && fwrite(e->key, sizeof *e->key, e->n_key, fp) == e->n_key
+		     && fwrite(&nq, sizeof nq, 1, fp) == 1 && fwrite(e->kin, sizeof *e->kin, e->n_kin, fp) == e->n_kin
+		     && fwrite(e->coeffs, sizeof *e->coeffs, engine->n_coeffs, fp) == engine->n_coeffs;
+	}
+	ok = fclose(fp) == 0 && ok;
+	if (!ok || rename(tmp, path) != 0) {
+		remove(tmp);
+		ok = 0;
+	}
+	free(tmp);
+	return ok ? 0 : -1;
+}
+
+int qft_diagram_engine_load(qft_diagram_engine_t *engine, const char *path) {
+	char magic[8];
+	uint32_t version;
+	uint64_t n_coeffs, count;
+	uint64_t *key = NULL;
+	double *kin = NULL, *coeffs = NULL;
+	FILE *fp;
+	int status = -1;
+
+	if (!engine || !path)
+		return -1;
+	fp = fopen(path, "rb");
+	if (!fp)
+		return -1;
+	if (fread(magic, 1, 8, fp) != 8 || memcmp(magic, QFT_FDC_MAGIC, 8) != 0 || fread(&version, sizeof version, 1, fp) != 1
+	    || version != QFT_FDC_VERSION || fread(&n_coeffs, sizeof n_coeffs, 1, fp) != 1 || n_coeffs != engine->n_coeffs
+	    || fread(&count, sizeof count, 1, fp) != 1)
+		goto done;
+	coeffs = malloc(engine->n_coeffs * sizeof(double));
+	if (!coeffs)
+		goto done;
+	for (uint64_t r = 0; r < count; r++) {
+		uint64_t nk, nq;
+		qft_fdc_entry *e;
+		int created;
+		if (fread(&nk, sizeof nk, 1, fp) != 1 || nk < 2 || nk > (1u << 20))
+			goto done;
+		free(key);
+		key = malloc(nk * sizeof(*key));
+		if (!key || fread(key, sizeof *key, nk, fp) != nk || fread(&nq, sizeof nq, 1, fp) != 1 || nq > (1u << 20))
+			goto done;
+		free(kin);
+		kin = malloc((nq ? nq : 1) * sizeof(*kin));
+		if (!kin || fread(kin, sizeof *kin, nq, fp) != nq || fread(coeffs, sizeof *coeffs, engine->n_coeffs, fp) != engine->n_coeffs)
+			goto done;
+		e = qft_fdc_get(engine->cache, key, nk, kin, nq, engine->n_coeffs, &created);
+		if (!e)
+			goto done;
+		if (!e->ready) {
+			memcpy(e->coeffs, coeffs, engine->n_coeffs * sizeof(double));
+			e->ready = 1;
+		}
+	}
+	status = 0;
+done:
+	free(key);
+	free(kin);
+	free(coeffs);
+	fclose(fp);
+	return status;
+}
+
+/* -------------------------------
+   System
+   ------------------------------- */
+
+int qft_system_evaluate_diagrams(qft_system_t *system, qft_diagram_engine_t *engine, const double *invariants, size_t n_invariants, double *values) {
+	if (!system || !engine)
+		return -1;
+	return qft_diagram_engine_evaluate(engine, system->diagrams, system->n_diagrams, invariants, n_invariants,
+	                                   system->renormalization ? system->renormalization->scale : 1.0, values);
+}
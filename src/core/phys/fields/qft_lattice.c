@@ -0,0 +1,490 @@
+/*
+	qft_lattice.c - Lattice path integral for HOLOS
+
+	Monte Carlo for the phi^4 lattice of qft.h:
+	- Checkerboard storage: a site's neighbours are all of the other
+	  colour and sit at the same row offset in the neighbouring rows
+	  (axes 1 ..), or one slot away in the same row (axis 0), so a half
+	  sweep is a set of independent rows the threads split, each updated
+	  with unit-stride loops the compiler vectorizes
+	- Metropolis and Gaussian heat bath (exact for the quadratic part,
+	  corrected by a Metropolis test on the quartic term) site updates
+	- Hybrid Monte Carlo: Gaussian momenta, leapfrog integration of the
+	  molecular dynamics, global accept/reject
+	- Draws are Philox keyed by site and sweep, and sums are taken per row
+	  then added in row order, so results do not depend on the threads
+
+	Copyright (C) 2025 HOLOS Scientific Computing Project
+
+	This file is part of HOLOS.
+
+	HOLOS is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 3 of the License, or
+	(at your option) any later version.
+
+	HOLOS is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with HOLOS; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "core/phys/fields/qft.h"
+#include "core/phys/philox.h"
+
+#define QFT_LATTICE_CHUNK 256           /* Sites per vector block of a row */
+
+typedef struct {
+	size_t n_rows;                  /* Rows along axis 0 */
+	size_t hl;                      /* Sites per row of one colour, L[0] / 2 */
+	size_t half;                    /* Sites of one colour */
+	unsigned char *rowpar;          /* Parity of the row coordinates */
+	size_t *nbr;                    /* Forward, backward row per axis 1 .., per row */
+	double *row_sum;                /* Per-row partial sums */
+	double *pi, *old, *force;       /* HMC buffers (volume each), lazily */
+} qft_lat_work;
+
+static int qft_threads(int n_threads) {
+	if (n_threads < 0) {
+#ifdef _OPENMP
+		return omp_get_max_threads();
+#else
+		return 1;
+#endif
+	}
+	return n_threads > 0 ? n_threads : 1;
+}
+
+/* -------------------------------
+   Lattice
+   ------------------------------- */
+
+qft_lattice_t *qft_lattice_alloc(size_t dim, const size_t *L) {
+	qft_lattice_t *lat;
+	qft_lat_work *wk;
+	size_t n_rows = 1, volume;
+
+	if (dim == 0 || dim > QFT_LATTICE_MAX_DIM || !L)
+		return NULL;
+	for (size_t mu = 0; mu < dim; mu++) {
+		if (L[mu] < 2 || L[mu] % 2)
+			return NULL;
+		if (mu > 0) {
+			if (n_rows > ((size_t)-1) / L[mu])
+				return NULL;
+			n_rows *= L[mu];
+		}
+	}
+	if (n_rows > ((size_t)-1) / L[0])
+		return NULL;
+	volume = n_rows * L[0];
+
+	lat = calloc(1, sizeof(*lat));
+	wk = calloc(1, sizeof(*wk));
+	if (!lat || !wk) {
+		free(lat);
+		free(wk);
+		return NULL;
+	}
+	lat->dim = dim;
+	for (size_t mu = 0; mu < dim; mu++)
+		lat->L[mu] = L[mu];
+	lat->volume = volume;
+	lat->work = wk;
+	wk->n_rows = n_rows;
+	wk->hl = L[0] / 2;
+	wk->half = volume / 2;
+	lat->phi = calloc(volume, sizeof(double));
+	wk->rowpar = malloc(n_rows);
+	wk->nbr = dim > 1 ? malloc(n_rows * 2 * (dim - 1) * sizeof(size_t)) : NULL;
+	wk->row_sum = malloc(n_rows * sizeof(double));
+	if (!lat->phi || !wk->rowpar || (dim > 1 && !wk->nbr) || !wk->row_sum) {
+		qft_lattice_free(lat);
+		return NULL;
+	}
+
+	/* Row r holds x[1 ..] with x[dim - 1] fastest */
+	for (size_t r = 0; r < n_rows; r++) {
+		size_t x[QFT_LATTICE_MAX_DIM], rest = r, par = 0, stride = 1;
+		for (size_t mu = dim; mu-- > 1;) {
+			x[mu] = rest % L[mu];
+			rest /= L[mu];
+			par += x[mu];
+		}
+		wk->rowpar[r] = (unsigned char)(par & 1);
+		for (size_t mu = dim; mu-- > 1;) {
+			const size_t up = x[mu] + 1 == L[mu] ? 0 : x[mu] + 1, dn = x[mu] ? x[mu] - 1 : L[mu] - 1;
+			size_t *nb = wk->nbr + (r * (dim - 1) + (mu - 1)) * 2;
+			nb[0] = r + (up - x[mu]) * stride;
+			nb[1] = r + (dn - x[mu]) * stride;
+			stride *= L[mu];
+		}
+	}
+	return lat;
+}
+
+void qft_lattice_free(qft_lattice_t *lat) {
+	qft_lat_work *wk;
+
+	if (!lat)
+		return;
+	wk = lat->work;
+	if (wk) {
+		free(wk->rowpar);
+		free(wk->nbr);
+		free(wk->row_sum);
+		free(wk->pi);
+		free(wk->old);
+		free(wk->force);
+		free(wk);
+	}
+	free(lat->phi);
+	free(lat);
+}
+
+size_t qft_lattice_index(const qft_lattice_t *lat, const size_t *x) {
+	const qft_lat_work *wk = lat->work;
+	size_t r = 0, par = x[0];
+
+	for (size_t mu = 1; mu < lat->dim; mu++) {
+		r = r * lat->L[mu] + x[mu];
+		par += x[mu];
+	}
+	return (par & 1) * wk->half + r * wk->hl + x[0] / 2;
+}
+
+/* Sum of the 2 dim neighbours of sites h0 .. h0 + len - 1 of colour q in row r */
+static void qft_lat_neighbours(const qft_lattice_t *lat, size_t q, size_t r, size_t h0, size_t len, double *restrict out) {
+	const qft_lat_work *wk = lat->work;
+	const size_t hl = wk->hl;
+	const double *other = lat->phi + (1 - q) * wk->half;
+	const double *row = other + r * hl;
+	const size_t s = (q + wk->rowpar[r]) & 1;
+
+	/* Axis 0: x0 = 2h + s, neighbours at h and h - 1 + 2s */
+	if (s == 0) {
+		#pragma omp simd
+		for (size_t k = 0; k < len; k++) {
+			const size_t h = h0 + k;
+			out[k] = row[h] + row[h ? h - 1 : hl - 1];
+		}
+	} else {
+		#pragma omp simd
+		for (size_t k = 0; k < len; k++) {
+			const size_t h = h0 + k;
+			out[k] = row[h] + row[h + 1 == hl ? 0 : h + 1];
+		}
+	}
+	for (size_t mu = 1; mu < lat->dim; mu++) {
+		const size_t *nb = wk->nbr + (r * (lat->dim - 1) + (mu - 1)) * 2;
+		const double *up = other + nb[0] * hl + h0, *dn = other + nb[1] * hl + h0;
+		#pragma omp simd
+		for (size_t k = 0; k < len; k++)
+			out[k] += up[k] + dn[k];
+	}
+}
+
+/* -------------------------------
+   Local updates
+   ------------------------------- */
+
+static size_t qft_lat_half_sweep(qft_lattice_t *lat, size_t q, int nt) {
+	const qft_lat_work *wk = lat->work;
+	const size_t hl = wk->hl, n_hits = lat->n_hits ? lat->n_hits : 1;
+	const double delta = lat->delta > 0.0 ? lat->delta : 1.0;
+	const double c2 = (double)lat->dim + 0.5 * lat->mass2, l24 = lat->lambda / 24.0;
+	const double a = 2.0 * c2, rs = 1.0 / sqrt(a);
+	const int heatbath = lat->update == QFT_LATTICE_HEATBATH;
+	const uint64_t seed = lat->seed, sweep = lat->sweep;
+	size_t accepted = 0;
+
+	#pragma omp parallel for schedule(static) num_threads(nt) reduction(+:accepted) if(nt > 1 && wk->n_rows > 1)
+	for (size_t r = 0; r < wk->n_rows; r++) {
+		double ns[QFT_LATTICE_CHUNK], u0[QFT_LATTICE_CHUNK], u1[QFT_LATTICE_CHUNK];
+		double u2[QFT_LATTICE_CHUNK], u3[QFT_LATTICE_CHUNK];
+		double *self = lat->phi + q * wk->half + r * hl;
+
+		for (size_t h0 = 0; h0 < hl; h0 += QFT_LATTICE_CHUNK) {
+			const size_t len = hl - h0 < QFT_LATTICE_CHUNK ? hl - h0 : QFT_LATTICE_CHUNK;
+			const uint64_t first = q * wk->half + r * hl + h0;
+			double *p = self + h0;
+
+			qft_lat_neighbours(lat, q, r, h0, len, ns);
+			for (size_t hit = 0; hit < n_hits; hit++) {
+				const uint64_t stream = (sweep * n_hits + hit) << 2;
+				size_t acc = 0;
+				philox_uniform2_n(seed, stream, first, len, u0, u1);
+				if (heatbath) {
+					philox_uniform2_n(seed, stream | 1, first, len, u2, u3);
+					#pragma omp simd reduction(+:acc)
+					for (size_t k = 0; k < len; k++) {
+						const double z = sqrt(-2.0 * log(u0[k])) * cos(6.283185307179586 * u1[k]);
+						const double po = p[k], pn = ns[k] / a + rs * z;
+						const double po2 = po * po, pn2 = pn * pn;
+						const int ok = u2[k] < exp(-l24 * (pn2 * pn2 - po2 * po2));
+						p[k] = ok ? pn : po;
+						acc += (size_t)ok;
+					}
+				} else {
+					#pragma omp simd reduction(+:acc)
+					for (size_t k = 0; k < len; k++) {
+						const double po = p[k], pn = po + delta * (2.0 * u0[k] - 1.0);
+						const double po2 = po * po, pn2 = pn * pn;
+						const double dS = -(pn - po) * ns[k] + c2 * (pn2 - po2) + l24 * (pn2 * pn2 - po2 * po2);
+						const int ok = u1[k] < exp(-dS);
+						p[k] = ok ? pn : po;
+						acc += (size_t)ok;
+					}
+				}
+				accepted += acc;
+			}
+		}
+	}
+	return accepted;
+}
+
+/* -------------------------------
+   Action and observables
+   ------------------------------- */
+
+static double qft_lat_row_total(const qft_lat_work *wk) {
+	double sum = 0.0;
+
+	for (size_t r = 0; r < wk->n_rows; r++)
+		sum += wk->row_sum[r];
+	return sum;
+}
+
+/* Action of lat->phi, every link counted once from its even end */
+static double qft_lat_action(const qft_lattice_t *lat, int nt) {
+	qft_lat_work *wk = lat->work;
+	const size_t hl = wk->hl;
+	const double c2 = (double)lat->dim + 0.5 * lat->mass2, l24 = lat->lambda / 24.0;
+
+	#pragma omp parallel for schedule(static) num_threads(nt) if(nt > 1 && wk->n_rows > 1)
+	for (size_t r = 0; r < wk->n_rows; r++) {
+		double ns[QFT_LATTICE_CHUNK], s = 0.0;
+		for (size_t h0 = 0; h0 < hl; h0 += QFT_LATTICE_CHUNK) {
+			const size_t len = hl - h0 < QFT_LATTICE_CHUNK ? hl - h0 : QFT_LATTICE_CHUNK;
+			const double *pe = lat->phi + r * hl + h0, *po = lat->phi + wk->half + r * hl + h0;
+			qft_lat_neighbours(lat, 0, r, h0, len, ns);
+			#pragma omp simd reduction(+:s)
+			for (size_t k = 0; k < len; k++) {
+				const double e2 = pe[k] * pe[k], o2 = po[k] * po[k];
+				s += -pe[k] * ns[k] + c2 * (e2 + o2) + l24 * (e2 * e2 + o2 * o2);
+			}
+		}
+		wk->row_sum[r] = s;
+	}
+	return qft_lat_row_total(wk);
+}
+
+double qft_lattice_action(const qft_lattice_t *lat) {
+	if (!lat)
+		return 0.0;
+	return qft_lat_action(lat, qft_threads(lat->n_threads));
+}
+
+/* Row-ordered sum of v over both colours */
+static double qft_lat_sum(const qft_lattice_t *lat, const double *v, int square, int nt) {
+	qft_lat_work *wk = lat->work;
+	const size_t hl = wk->hl;
+
+	#pragma omp parallel for schedule(static) num_threads(nt) if(nt > 1 && wk->n_rows > 1)
+	for (size_t r = 0; r < wk->n_rows; r++) {
+		const double *ve = v + r * hl, *vo = v + wk->half + r * hl;
+		double s = 0.0;
+		if (square) {
+			#pragma omp simd reduction(+:s)
+			for (size_t h = 0; h < hl; h++)
+				s += ve[h] * ve[h] + vo[h] * vo[h];
+		} else {
+			#pragma omp simd reduction(+:s)
+			for (size_t h = 0; h < hl; h++)
+				s += ve[h] + vo[h];
+		}
+		wk->row_sum[r] = s;
+	}
+	return qft_lat_row_total(wk);
+}
+
+double qft_lattice_magnetization(const qft_lattice_t *lat) {
+	if (!lat)
+		return 0.0;
+	return qft_lat_sum(lat, lat->phi, 0, qft_threads(lat->n_threads)) / (double)lat->volume;
+}
+
+int qft_lattice_store(const qft_lattice_t *lat, qft_field_t *field) {
+	if (!lat || !field || !field->values || field->values->size != lat->volume)
+		return -1;
+	for (size_t i = 0; i < lat->volume; i++) {
+		size_t x[QFT_LATTICE_MAX_DIM], rest = i;
+		for (size_t mu = lat->dim; mu-- > 0;) {
+			x[mu] = rest % lat->L[mu];
+			rest /= lat->L[mu];
+		}
+		gsl_vector_set(field->values, i, lat->phi[qft_lattice_index(lat, x)]);
+	}
+	return 0;
+}
+
+/* -------------------------------
+   Hybrid Monte Carlo
+   ------------------------------- */
+
+/* force = -dS/dphi */
+static void qft_lat_force(const qft_lattice_t *lat, double *force, int nt) {
+	const qft_lat_work *wk = lat->work;
+	const size_t hl = wk->hl;
+	const double a = 2.0 * (double)lat->dim + lat->mass2, l6 = lat->lambda / 6.0;
+
+	#pragma omp parallel for collapse(2) schedule(static) num_threads(nt) if(nt > 1 && wk->n_rows > 1)
+	for (size_t q = 0; q < 2; q++) {
+		for (size_t r = 0; r < wk->n_rows; r++) {
+			double ns[QFT_LATTICE_CHUNK];
+			for (size_t h0 = 0; h0 < hl; h0 += QFT_LATTICE_CHUNK) {
+				const size_t len = hl - h0 < QFT_LATTICE_CHUNK ? hl - h0 : QFT_LATTICE_CHUNK;
+				const size_t off = q * wk->half + r * hl + h0;
+				const double *p = lat->phi + off;
+				double *f = force + off;
+				qft_lat_neighbours(lat, q, r, h0, len, ns);
+				#pragma omp simd
+				for (size_t k = 0; k < len; k++)
+					f[k] = ns[k] - a * p[k] - l6 * p[k] * p[k] * p[k];
+			}
+		}
+	}
+}
+
+static int qft_lat_hmc(qft_lattice_t *lat, int nt) {
+	qft_lat_work *wk = lat->work;
+	const size_t V = lat->volume, n_steps = lat->hmc_steps ? lat->hmc_steps : 10;
+	const double eps = lat->hmc_step > 0.0 ? lat->hmc_step : 0.1;
+	const uint64_t stream = lat->sweep << 2;
+	double h_old, h_new, u[2];
+	double *pi, *force;
+
+	if (!wk->pi) {
+		wk->pi = malloc(V * sizeof(double));
+		wk->old = malloc(V * sizeof(double));
+		wk->force = malloc(V * sizeof(double));
+		if (!wk->pi || !wk->old || !wk->force) {
+			free(wk->pi);
+			free(wk->old);
+			free(wk->force);
+			wk->pi = wk->old = wk->force = NULL;
+			return -1;
+		}
+	}
+	pi = wk->pi;
+	force = wk->force;
+
+	/* Momenta: site pair i of block i, V is even */
+	#pragma omp parallel for schedule(static) num_threads(nt) if(nt > 1 && V > QFT_LATTICE_CHUNK)
+	for (size_t i = 0; i < V / 2; i++) {
+		double z[2];
+		philox_normal2(lat->seed, stream | 2, i, z);
+		pi[2 * i] = z[0];
+		pi[2 * i + 1] = z[1];
+	}
+	memcpy(wk->old, lat->phi, V * sizeof(double));
+	h_old = 0.5 * qft_lat_sum(lat, pi, 1, nt) + qft_lat_action(lat, nt);
+
+	/* Leapfrog */
+	qft_lat_force(lat, force, nt);
+	for (size_t step = 0; step < n_steps; step++) {
+		const double kick = step == 0 ? 0.5 * eps : eps;
+		#pragma omp parallel for simd schedule(static) num_threads(nt) if(nt > 1 && V > QFT_LATTICE_CHUNK)
+		for (size_t i = 0; i < V; i++) {
+			pi[i] += kick * force[i];
+			lat->phi[i] += eps * pi[i];
+		}
+		qft_lat_force(lat, force, nt);
+	}
+	#pragma omp parallel for simd schedule(static) num_threads(nt) if(nt > 1 && V > QFT_LATTICE_CHUNK)
+	for (size_t i = 0; i < V; i++)
+		pi[i] += 0.5 * eps * force[i];
+
+	h_new = 0.5 * qft_lat_sum(lat, pi, 1, nt) + qft_lat_action(lat, nt);
+	lat->delta_h = h_new - h_old;
+	philox_uniform2(lat->seed, stream | 3, 0, u);
+	lat->n_proposed++;
+	if (isfinite(lat->delta_h) && u[0] < exp(-lat->delta_h)) {
+		lat->n_accepted++;
+	} else {
+		memcpy(lat->phi, wk->old, V * sizeof(double));
+	}
+	return 0;
+}
+
+/* -------------------------------
+   Sweeps
+   ------------------------------- */
+
+int qft_lattice_sweep(qft_lattice_t *lat) {
+	int nt;
+
+	if (!lat || !lat->phi)
+		return -1;
+	nt = qft_threads(lat->n_threads);
+	if (lat->update == QFT_LATTICE_HMC) {
+		if (qft_lat_hmc(lat, nt) != 0)
+			return -1;
+	} else {
+		const size_t n_hits = lat->n_hits ? lat->n_hits : 1;
+		if (lat->update == QFT_LATTICE_HEATBATH && !(2.0 * (double)lat->dim + lat->mass2 > 0.0))
+			return -1;
+		lat->n_accepted += qft_lat_half_sweep(lat, 0, nt);
+		lat->n_accepted += qft_lat_half_sweep(lat, 1, nt);
+		lat->n_proposed += n_hits * lat->volume;
+	}
+	lat->sweep++;
+	lat->action = qft_lat_action(lat, nt);
+	return 0;
+}
+
+/* -------------------------------
+   System
+   ------------------------------- */
+
+int qft_system_enable_lattice(qft_system_t *system, size_t dim, const size_t *L, double lambda) {
+	qft_lattice_t *lat;
+
+	if (!system)
+		return -1;
+	lat = qft_lattice_alloc(dim, L);
+	if (!lat)
+		return -1;
+	if (system->fields && system->n_fields && system->fields[0])
+		lat->mass2 = system->fields[0]->mass * system->fields[0]->mass;
+	lat->lambda = lambda;
+	qft_lattice_free(system->lattice);
+	system->lattice = lat;
+	return 0;
+}
+
+int qft_step_path_integral(qft_system_t *system, double dt) {
+	qft_lattice_t *lat;
+
+	if (!system || !system->lattice)
+		return -1;
+	lat = system->lattice;
+	if (lat->update == QFT_LATTICE_HMC && dt > 0.0)
+		lat->hmc_step = dt / (double)(lat->hmc_steps ? lat->hmc_steps : 10);
+	if (qft_lattice_sweep(lat) != 0)
+		return -1;
+	system->diagnostics.lagrangian_value = lat->action;
+	if (system->correlator)
+		return qft_correlator_add_lattice(system->correlator, lat);
+	return 0;
+}
@@ -1,4 +1,18 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
 #include <gsl/gsl_vector.h>
+#include <gsl/gsl_blas.h>
+#include <gsl/gsl_odeiv2.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "core/phys/mech/classical/dynamics.h"
+#include "core/phys/mech/classical/dynamics_gpu.h"
+#include "core/phys/mech/classical/trajectory.h"
+#include "core/phys/pair_kernel.h"
+#include "core/trace/trace.h"
 
 /* F = m * a */
 void compute_force(double mass, const gsl_vector *acc, gsl_vector *force) {
@@ -12,21 +26,13 @@ void compute_acceleration(const gsl_vector *force, double mass, gsl_vector *acc)
     gsl_vector_scale(acc, 1.0 / mass);
 }
 
-/* Aggiorna posizione e velocità con integrazione di Eulero */
+/* Aggiorna posizione e velocità con integrazione di Eulero (in place, senza allocazioni) */
 void euler_step(gsl_vector *pos, gsl_vector *vel, const gsl_vector *acc, double dt) {
-    gsl_vector *tmp = gsl_vector_alloc(pos->size);
-
     /* v = v + a*dt */
-    gsl_vector_memcpy(tmp, acc);
-    gsl_vector_scale(tmp, dt);
-    gsl_vector_add(vel, tmp);
+    gsl_blas_daxpy(dt, acc, vel);
 
     /* x = x + v*dt */
-    gsl_vector_memcpy(tmp, vel);
-    gsl_vector_scale(tmp, dt);
-    gsl_vector_add(pos, tmp);
-
-    gsl_vector_free(tmp);
+    gsl_blas_daxpy(dt, vel, pos);
 }
 
 /* Energia cinetica */
@@ -42,22 +48,1363 @@ void momentum(double mass, const gsl_vector *vel, gsl_vector *p) {
     gsl_vector_scale(p, mass);
 }
 
-/* Integrazione di Verlet */
+/* Integrazione di Verlet (in place, senza allocazioni) */
 void verlet_step(gsl_vector *pos, gsl_vector *vel,
                  const gsl_vector *acc, double dt) {
-    gsl_vector *tmp = gsl_vector_alloc(pos->size);
-
     /* x = x + v*dt + 0.5*a*dt^2 */
-    gsl_vector_memcpy(tmp, acc);
-    gsl_vector_scale(tmp, 0.5 * dt * dt);
-    gsl_vector_add(tmp, vel);
-    gsl_vector_scale(tmp, dt);
-    gsl_vector_add(pos, tmp);
+    gsl_blas_daxpy(dt, vel, pos);
+    gsl_blas_daxpy(0.5 * dt * dt, acc, pos);
 
     /* v = v + a*dt */
-    gsl_vector_memcpy(tmp, acc);
-    gsl_vector_scale(tmp, dt);
-    gsl_vector_add(vel, tmp);
+    gsl_blas_daxpy(dt, acc, vel);
+}
+
+
+/* -------------------------------
+   System management
+   ------------------------------- */
+
+static gsl_vector *dyn_field_vector(dyn_particle_t *p, dyn_field_t field) {
+    switch (field) {
+    case DYN_FIELD_VEL:   return p->vel;
+    case DYN_FIELD_FORCE: return p->force;
+    default:              return p->pos;
+    }
+}
+
+static double *dyn_soa_block(dyn_soa_t *soa, dyn_field_t field) {
+    switch (field) {
+    case DYN_FIELD_VEL:   return soa->vel;
+    case DYN_FIELD_FORCE: return soa->force;
+    default:              return soa->pos;
+    }
+}
+
+/* Point every particle's pos/vel/force at its stride-capacity SoA view. */
+static void dyn_soa_bind(dyn_system_t *sys) {
+    dyn_soa_t *soa = sys->soa;
+    for (size_t i = 0; i < sys->N; i++) {
+        for (int f = 0; f < 3; f++) {
+            gsl_vector *v = &soa->views[3 * i + f];
+            v->size = 3;
+            v->stride = soa->capacity;
+            v->data = dyn_soa_block(soa, (dyn_field_t)f) + i;
+            v->block = NULL;
+            v->owner = 0;
+        }
+        sys->particles[i].pos = &soa->views[3 * i + DYN_FIELD_POS];
+        sys->particles[i].vel = &soa->views[3 * i + DYN_FIELD_VEL];
+        sys->particles[i].force = &soa->views[3 * i + DYN_FIELD_FORCE];
+    }
+}
+
+/* Grow one x|y|z block from old_cap to new_cap, keeping the first n entries of each axis. */
+static double *dyn_soa_regrow(double *old, size_t old_cap, size_t new_cap, size_t n) {
+    double *blk = calloc(3 * new_cap, sizeof(double));
+    if (!blk) return NULL;
+    if (old) {
+        for (size_t a = 0; a < 3; a++)
+            memcpy(blk + a * new_cap, old + a * old_cap, n * sizeof(double));
+    }
+    return blk;
+}
+
+/* Ensure SoA storage for at least capacity particles (rebinds views on growth). */
+static int dyn_soa_reserve(dyn_system_t *sys, size_t capacity) {
+    dyn_soa_t *soa = sys->soa;
+    if (capacity <= soa->capacity) return 0;
+
+    double *pos = dyn_soa_regrow(soa->pos, soa->capacity, capacity, sys->N);
+    double *vel = dyn_soa_regrow(soa->vel, soa->capacity, capacity, sys->N);
+    double *force = dyn_soa_regrow(soa->force, soa->capacity, capacity, sys->N);
+    /* The particles point into the old views until the rebind, so they
+       are replaced, not realloc'd, and the old storage stays whole on failure */
+    gsl_vector *views = malloc(3 * capacity * sizeof(gsl_vector));
+    double *mass = realloc(soa->mass, capacity * sizeof(double));
+    if (mass) soa->mass = mass;
+    if (!pos || !vel || !force || !mass || !views) {
+        free(pos);
+        free(vel);
+        free(force);
+        free(views);
+        return -1;
+    }
+
+    free(soa->pos);
+    free(soa->vel);
+    free(soa->force);
+    free(soa->views);
+    soa->pos = pos;
+    soa->vel = vel;
+    soa->force = force;
+    soa->mass = mass;
+    soa->views = views;
+    soa->capacity = capacity;
+    dyn_soa_bind(sys);
+    return 0;
+}
+
+static void dyn_soa_free(dyn_soa_t *soa) {
+    if (!soa) return;
+    free(soa->pos);
+    free(soa->vel);
+    free(soa->force);
+    free(soa->mass);
+    free(soa->views);
+    free(soa);
+}
+
+dyn_system_t *dyn_system_alloc(size_t N) {
+    dyn_system_t *sys = calloc(1, sizeof(*sys));
+    if (!sys) return NULL;
+
+    sys->particles = N ? calloc(N, sizeof(dyn_particle_t)) : NULL;
+    if (N && !sys->particles) {
+        free(sys);
+        return NULL;
+    }
+    sys->N = N;
+    sys->G = 6.67430e-11;
+    sys->layout = DYN_LAYOUT_AOS;
+    sys->gravity_solver = DYN_GRAVITY_DIRECT;
+    sys->tree_theta = 0.5;
+    sys->force_slots = DYN_FORCE_SLOTS;
+
+    for (size_t i = 0; i < N; i++) {
+        dyn_particle_t *p = &sys->particles[i];
+        p->mass = 1.0;
+        p->id = (int)i;
+        p->pos = gsl_vector_calloc(3);
+        p->vel = gsl_vector_calloc(3);
+        p->force = gsl_vector_calloc(3);
+        if (!p->pos || !p->vel || !p->force) {
+            dyn_system_free(sys);
+            return NULL;
+        }
+    }
+    return sys;
+}
+
+void dyn_system_free(dyn_system_t *sys) {
+    if (!sys) return;
+    for (size_t i = 0; i < sys->N; i++) {
+        dyn_particle_t *p = &sys->particles[i];
+        if (sys->layout == DYN_LAYOUT_AOS) {
+            if (p->pos) gsl_vector_free(p->pos);
+            if (p->vel) gsl_vector_free(p->vel);
+            if (p->force) gsl_vector_free(p->force);
+        }
+        free(p->tag);
+    }
+    dyn_system_reset_tree(sys);
+    dyn_system_enable_neighbor_list(sys, 0.0, 0.0);
+    dyn_system_set_block_timesteps(sys, 0, 0.0);
+    dyn_gpu_free(sys->gpu);
+    dyn_workspace_free(sys->workspace);
+    dyn_soa_free(sys->soa);
+    free(sys->force_acc);
+    free(sys->phi);
+    free(sys->particles);
+    free(sys->name);
+    free(sys);
+}
+
+void dyn_system_zero_forces(dyn_system_t *sys) {
+    if (!sys) return;
+    dyn_gpu_touch(sys, DYN_GPU_FORCE);
+    if (sys->layout == DYN_LAYOUT_SOA) {
+        for (size_t a = 0; a < 3; a++)
+            memset(sys->soa->force + a * sys->soa->capacity, 0, sys->N * sizeof(double));
+        return;
+    }
+    for (size_t i = 0; i < sys->N; i++)
+        gsl_vector_set_zero(sys->particles[i].force);
+}
+
+void dyn_system_set_gravity(dyn_system_t *sys, double G) {
+    if (sys) sys->G = G;
+}
+
+void dyn_system_set_softening(dyn_system_t *sys, bool use_softening, double eps) {
+    if (!sys) return;
+    sys->use_softening = use_softening;
+    sys->softening_eps = eps;
+}
+
+void dyn_system_set_force_callback(dyn_system_t *sys, dyn_force_cb cb, void *userdata) {
+    if (!sys) return;
+    sys->force_cb = cb;
+    sys->force_cb_userdata = userdata;
+}
+
+void dyn_system_set_range_force_callback(dyn_system_t *sys, dyn_range_force_cb cb, void *userdata) {
+    if (!sys) return;
+    sys->range_force_cb = cb;
+    sys->range_force_cb_userdata = userdata;
+}
+
+int dyn_system_set_threads(dyn_system_t *sys, int n_threads) {
+    if (!sys) return -1;
+    if (n_threads < 0) {
+#ifdef _OPENMP
+        n_threads = omp_get_max_threads();
+#else
+        n_threads = 1;
+#endif
+    }
+    sys->n_threads = n_threads;
+    return n_threads;
+}
+
+int dyn_system_set_force_slots(dyn_system_t *sys, size_t slots) {
+    if (!sys || slots == 0) return -1;
+    sys->force_slots = slots;
+    return 0;
+}
+
+int dyn_system_add_particle(dyn_system_t *sys, const dyn_particle_t *p) {
+    if (!sys || !p) return -1;
+    if (dyn_system_sync_host(sys) != 0) return -1;
+    sys->forces_valid = 0;
+
+    dyn_particle_t *parts = realloc(sys->particles, (sys->N + 1) * sizeof(dyn_particle_t));
+    if (!parts) return -1;
+    sys->particles = parts;
+
+    size_t idx = sys->N;
+    dyn_particle_t *q = &parts[idx];
+    *q = *p;
+    q->tag = p->tag ? strdup(p->tag) : NULL;
+
+    if (sys->layout == DYN_LAYOUT_SOA) {
+        size_t cap = sys->soa->capacity;
+        if (idx + 1 > cap && dyn_soa_reserve(sys, cap ? 2 * cap : 16) != 0) {
+            free(q->tag);
+            return -1;
+        }
+        sys->N++;
+        dyn_soa_bind(sys);
+        for (size_t a = 0; a < 3; a++) {
+            q->pos->data[a * q->pos->stride] = p->pos ? gsl_vector_get(p->pos, a) : 0.0;
+            q->vel->data[a * q->vel->stride] = p->vel ? gsl_vector_get(p->vel, a) : 0.0;
+            q->force->data[a * q->force->stride] = p->force ? gsl_vector_get(p->force, a) : 0.0;
+        }
+        sys->soa->mass[idx] = p->mass;
+        return (int)idx;
+    }
+
+    q->pos = gsl_vector_calloc(3);
+    q->vel = gsl_vector_calloc(3);
+    q->force = gsl_vector_calloc(3);
+    if (!q->pos || !q->vel || !q->force) {
+        if (q->pos) gsl_vector_free(q->pos);
+        if (q->vel) gsl_vector_free(q->vel);
+        if (q->force) gsl_vector_free(q->force);
+        free(q->tag);
+        return -1;
+    }
+    if (p->pos) gsl_vector_memcpy(q->pos, p->pos);
+    if (p->vel) gsl_vector_memcpy(q->vel, p->vel);
+    if (p->force) gsl_vector_memcpy(q->force, p->force);
+    sys->N++;
+    return (int)idx;
+}
+
+int dyn_system_remove_particle(dyn_system_t *sys, size_t idx) {
+    if (!sys || idx >= sys->N) return -1;
+    if (dyn_system_sync_host(sys) != 0) return -1;
+    sys->forces_valid = 0;
+
+    dyn_particle_t *p = &sys->particles[idx];
+    free(p->tag);
+    size_t tail = sys->N - idx - 1;
+
+    if (sys->layout == DYN_LAYOUT_SOA) {
+        dyn_soa_t *soa = sys->soa;
+        double *blocks[3] = { soa->pos, soa->vel, soa->force };
+        for (int f = 0; f < 3; f++) {
+            for (size_t a = 0; a < 3; a++) {
+                double *axis = blocks[f] + a * soa->capacity;
+                memmove(axis + idx, axis + idx + 1, tail * sizeof(double));
+            }
+        }
+        memmove(soa->mass + idx, soa->mass + idx + 1, tail * sizeof(double));
+        memmove(p, p + 1, tail * sizeof(dyn_particle_t));
+        sys->N--;
+        dyn_soa_bind(sys);
+        return 0;
+    }
+
+    gsl_vector_free(p->pos);
+    gsl_vector_free(p->vel);
+    gsl_vector_free(p->force);
+    memmove(p, p + 1, tail * sizeof(dyn_particle_t));
+    sys->N--;
+    return 0;
+}
+
+/* -------------------------------
+   Storage layout
+   ------------------------------- */
+
+int dyn_system_set_layout(dyn_system_t *sys, dyn_layout_t layout) {
+    if (!sys) return -1;
+    if (sys->layout == layout) return 0;
+    if (dyn_system_sync_host(sys) != 0) return -1;
+
+    if (layout == DYN_LAYOUT_SOA) {
+        sys->soa = calloc(1, sizeof(dyn_soa_t));
+        if (!sys->soa) return -1;
+
+        /* Copy the AoS state into fresh blocks sized exactly to N. */
+        size_t N = sys->N;
+        double *pos = calloc(3 * (N ? N : 1), sizeof(double));
+        double *vel = calloc(3 * (N ? N : 1), sizeof(double));
+        double *force = calloc(3 * (N ? N : 1), sizeof(double));
+        double *mass = calloc(N ? N : 1, sizeof(double));
+        gsl_vector *views = calloc(3 * (N ? N : 1), sizeof(gsl_vector));
+        if (!pos || !vel || !force || !mass || !views) {
+            free(pos);
+            free(vel);
+            free(force);
+            free(mass);
+            free(views);
+            free(sys->soa);
+            sys->soa = NULL;
+            return -1;
+        }
+
+        size_t cap = N ? N : 1;
+        for (size_t i = 0; i < N; i++) {
+            dyn_particle_t *p = &sys->particles[i];
+            for (size_t a = 0; a < 3; a++) {
+                pos[a * cap + i] = gsl_vector_get(p->pos, a);
+                vel[a * cap + i] = gsl_vector_get(p->vel, a);
+                force[a * cap + i] = gsl_vector_get(p->force, a);
+            }
+            mass[i] = p->mass;
+            gsl_vector_free(p->pos);
+            gsl_vector_free(p->vel);
+            gsl_vector_free(p->force);
+        }
+
+        sys->soa->capacity = cap;
+        sys->soa->pos = pos;
+        sys->soa->vel = vel;
+        sys->soa->force = force;
+        sys->soa->mass = mass;
+        sys->soa->views = views;
+        sys->layout = DYN_LAYOUT_SOA;
+        dyn_soa_bind(sys);
+        return 0;
+    }
+
+    /* SoA -> AoS: allocate everything first so a failure leaves the system untouched. */
+    gsl_vector **vecs = calloc(3 * (sys->N ? sys->N : 1), sizeof(gsl_vector *));
+    if (!vecs) return -1;
+    for (size_t k = 0; k < 3 * sys->N; k++) {
+        vecs[k] = gsl_vector_alloc(3);
+        if (!vecs[k]) {
+            for (size_t j = 0; j < k; j++) gsl_vector_free(vecs[j]);
+            free(vecs);
+            return -1;
+        }
+    }
+    for (size_t i = 0; i < sys->N; i++) {
+        dyn_particle_t *p = &sys->particles[i];
+        gsl_vector_memcpy(vecs[3 * i + 0], p->pos);
+        gsl_vector_memcpy(vecs[3 * i + 1], p->vel);
+        gsl_vector_memcpy(vecs[3 * i + 2], p->force);
+        p->mass = sys->soa->mass[i];
+        p->pos = vecs[3 * i + 0];
+        p->vel = vecs[3 * i + 1];
+        p->force = vecs[3 * i + 2];
+    }
+    free(vecs);
+    dyn_soa_free(sys->soa);
+    sys->soa = NULL;
+    sys->layout = DYN_LAYOUT_AOS;
+    return 0;
+}
+
+gsl_vector_view dyn_system_particle_vector(dyn_system_t *sys, dyn_field_t field, size_t idx) {
+    gsl_vector_view view = {{0, 1, NULL, NULL, 0}};
+    if (!sys || idx >= sys->N) return view;
+    gsl_vector *v = dyn_field_vector(&sys->particles[idx], field);
+    return gsl_vector_view_array_with_stride(v->data, v->stride, v->size);
+}
+
+gsl_vector_view dyn_system_component(dyn_system_t *sys, dyn_field_t field, size_t axis) {
+    gsl_vector_view view = {{0, 1, NULL, NULL, 0}};
+    if (!sys || sys->layout != DYN_LAYOUT_SOA || axis > 2 || sys->N == 0) return view;
+    return gsl_vector_view_array(dyn_soa_block(sys->soa, field) + axis * sys->soa->capacity, sys->N);
+}
+
+void dyn_system_sync_masses(dyn_system_t *sys) {
+    if (!sys || sys->layout != DYN_LAYOUT_SOA) return;
+    for (size_t i = 0; i < sys->N; i++)
+        sys->soa->mass[i] = sys->particles[i].mass;
+    dyn_gpu_touch(sys, DYN_GPU_MASS);
+}
+
+static inline double dyn_mass(const dyn_system_t *sys, size_t i) {
+    return sys->layout == DYN_LAYOUT_SOA ? sys->soa->mass[i] : sys->particles[i].mass;
+}
+
+/* -------------------------------
+   On-the-fly diagnostics
+   ------------------------------- */
+
+/* Running sums of the O(N) diagnostics. */
+typedef struct {
+    double kinetic, mass;
+    double p[3], l[3], mr[3];
+} dyn_diag_acc_t;
+
+static inline void dyn_diag_add(dyn_diag_acc_t *d, double m, const double *x, size_t sx,
+                                const double *v, size_t sv) {
+    const double r[3] = { x[0], x[sx], x[2 * sx] }, u[3] = { v[0], v[sv], v[2 * sv] };
+    d->kinetic += 0.5 * m * (u[0] * u[0] + u[1] * u[1] + u[2] * u[2]);
+    d->mass += m;
+    for (size_t a = 0; a < 3; a++) {
+        d->p[a] += m * u[a];
+        d->mr[a] += m * r[a];
+    }
+    d->l[0] += m * (r[1] * u[2] - r[2] * u[1]);
+    d->l[1] += m * (r[2] * u[0] - r[0] * u[2]);
+    d->l[2] += m * (r[0] * u[1] - r[1] * u[0]);
+}
+
+/* Publish the sums as the current record; keeps diag.potential when with_pot. */
+static void dyn_diag_store(dyn_system_t *sys, const dyn_diag_acc_t *d, int with_pot) {
+    dyn_diagnostics_t *g = &sys->diag;
+    g->mask = sys->diag_mask & (with_pot ? DYN_DIAG_ALL : ~DYN_DIAG_POTENTIAL);
+    g->t = sys->t;
+    g->step = sys->step_count;
+    g->kinetic = d->kinetic;
+    g->total_mass = d->mass;
+    for (size_t a = 0; a < 3; a++) {
+        g->momentum[a] = d->p[a];
+        g->angular[a] = d->l[a];
+        g->com[a] = d->mass > 0.0 ? d->mr[a] / d->mass : 0.0;
+        g->com_vel[a] = d->mass > 0.0 ? d->p[a] / d->mass : 0.0;
+    }
+    if (!with_pot) g->potential = 0.0;
+    g->energy = g->kinetic + g->potential;
+}
+
+/* One pass over the current state. */
+static void dyn_diag_sweep(dyn_system_t *sys, int with_pot) {
+    dyn_diag_acc_t d = {0};
+    for (size_t i = 0; i < sys->N; i++) {
+        const dyn_particle_t *p = &sys->particles[i];
+        dyn_diag_add(&d, dyn_mass(sys, i), p->pos->data, p->pos->stride, p->vel->data, p->vel->stride);
+    }
+    dyn_diag_store(sys, &d, with_pot);
+}
+
+/* Zero the forces and sum the O(N) diagnostics in the same pass. */
+static void dyn_zero_forces_diag(dyn_system_t *sys, dyn_diag_acc_t *d) {
+    for (size_t i = 0; i < sys->N; i++) {
+        dyn_particle_t *p = &sys->particles[i];
+        double *f = p->force->data;
+        size_t sf = p->force->stride;
+        f[0] = f[sf] = f[2 * sf] = 0.0;
+        dyn_diag_add(d, dyn_mass(sys, i), p->pos->data, p->pos->stride, p->vel->data, p->vel->stride);
+    }
+}
+
+int dyn_system_set_diagnostics(dyn_system_t *sys, unsigned mask) {
+    if (!sys) return -1;
+    sys->diag_mask = mask & DYN_DIAG_ALL;
+    memset(&sys->diag, 0, sizeof(sys->diag));
+    if (!sys->diag_mask) return 0;
+    if (dyn_gpu_pull(sys, DYN_GPU_POS | DYN_GPU_VEL) != 0) return -1;
+
+    /* Reference state: full record, potential by direct summation. */
+    dyn_diag_sweep(sys, 1);
+    sys->diag.potential = dyn_system_total_potential(sys);
+    sys->diag.energy = sys->diag.kinetic + sys->diag.potential;
+    sys->diag.mask = DYN_DIAG_ALL;
+    sys->diag_ref = sys->diag;
+    sys->diag.mask = 0;
+    return 0;
+}
+
+const dyn_diagnostics_t *dyn_system_diagnostics(const dyn_system_t *sys) {
+    return sys ? &sys->diag : NULL;
+}
+
+/* Latest record if it still describes the current state and carries bits. */
+static const dyn_diagnostics_t *dyn_diag_cached(const dyn_system_t *sys, unsigned bits) {
+    const dyn_diagnostics_t *g = &sys->diag;
+    if (!sys->forces_valid || (g->mask & bits) != bits) return NULL;
+    return g->step == sys->step_count && g->t == sys->t ? g : NULL;
+}
+
+double dyn_system_total_kinetic(const dyn_system_t *sys) {
+    if (!sys) return 0.0;
+    const dyn_diagnostics_t *g = dyn_diag_cached(sys, DYN_DIAG_KINETIC);
+    if (g) return g->kinetic;
+    dyn_gpu_pull(sys, DYN_GPU_VEL);
+    double k = 0.0;
+    for (size_t i = 0; i < sys->N; i++) {
+        const gsl_vector *v = sys->particles[i].vel;
+        double v2 = 0.0;
+        for (size_t a = 0; a < 3; a++) v2 += v->data[a * v->stride] * v->data[a * v->stride];
+        k += 0.5 * dyn_mass(sys, i) * v2;
+    }
+    return k;
+}
+
+double dyn_system_total_potential(const dyn_system_t *sys) {
+    if (!sys) return 0.0;
+    const dyn_diagnostics_t *g = dyn_diag_cached(sys, DYN_DIAG_POTENTIAL);
+    if (g) return g->potential;
+    dyn_gpu_pull(sys, DYN_GPU_POS);
+    const double eps2 = sys->use_softening ? sys->softening_eps * sys->softening_eps : 0.0;
+    double u = 0.0;
+    for (size_t i = 0; i < sys->N; i++) {
+        const gsl_vector *ri = sys->particles[i].pos;
+        for (size_t j = i + 1; j < sys->N; j++) {
+            const gsl_vector *rj = sys->particles[j].pos;
+            double r2 = eps2;
+            for (size_t a = 0; a < 3; a++) {
+                double d = rj->data[a * rj->stride] - ri->data[a * ri->stride];
+                r2 += d * d;
+            }
+            if (r2 > 0.0) u -= sys->G * dyn_mass(sys, i) * dyn_mass(sys, j) / sqrt(r2);
+        }
+    }
+    return u;
+}
+
+double dyn_system_total_energy(const dyn_system_t *sys) {
+    return dyn_system_total_kinetic(sys) + dyn_system_total_potential(sys);
+}
+
+/* Fill a record with the O(N) quantities, from the cache when possible. */
+static dyn_diagnostics_t dyn_diag_current(const dyn_system_t *sys, unsigned bits) {
+    const dyn_diagnostics_t *g = dyn_diag_cached(sys, bits);
+    if (g) return *g;
+    dyn_gpu_pull(sys, DYN_GPU_POS | DYN_GPU_VEL);
+    dyn_diag_acc_t d = {0};
+    for (size_t i = 0; i < sys->N; i++) {
+        const dyn_particle_t *p = &sys->particles[i];
+        dyn_diag_add(&d, dyn_mass(sys, i), p->pos->data, p->pos->stride, p->vel->data, p->vel->stride);
+    }
+    dyn_diagnostics_t r = {0};
+    for (size_t a = 0; a < 3; a++) {
+        r.momentum[a] = d.p[a];
+        r.angular[a] = d.l[a];
+        r.com[a] = d.mass > 0.0 ? d.mr[a] / d.mass : 0.0;
+        r.com_vel[a] = d.mass > 0.0 ? d.p[a] / d.mass : 0.0;
+    }
+    r.kinetic = d.kinetic;
+    r.total_mass = d.mass;
+    return r;
+}
+
+int dyn_system_total_momentum(const dyn_system_t *sys, gsl_vector *out_p) {
+    if (!sys || !out_p || out_p->size < 3) return -1;
+    dyn_diagnostics_t r = dyn_diag_current(sys, DYN_DIAG_MOMENTUM);
+    for (size_t a = 0; a < 3; a++) gsl_vector_set(out_p, a, r.momentum[a]);
+    return 0;
+}
+
+int dyn_system_total_angular_momentum(const dyn_system_t *sys, gsl_vector *out_L) {
+    if (!sys || !out_L || out_L->size < 3) return -1;
+    dyn_diagnostics_t r = dyn_diag_current(sys, DYN_DIAG_ANGULAR);
+    for (size_t a = 0; a < 3; a++) gsl_vector_set(out_L, a, r.angular[a]);
+    return 0;
+}
+
+int dyn_system_center_of_mass(const dyn_system_t *sys, gsl_vector *out_r, gsl_vector *out_v) {
+    if (!sys || (out_r && out_r->size < 3) || (out_v && out_v->size < 3)) return -1;
+    dyn_diagnostics_t r = dyn_diag_current(sys, DYN_DIAG_COM);
+    for (size_t a = 0; a < 3; a++) {
+        if (out_r) gsl_vector_set(out_r, a, r.com[a]);
+        if (out_v) gsl_vector_set(out_v, a, r.com_vel[a]);
+    }
+    return 0;
+}
+
+int dyn_system_check_conservation(const dyn_system_t *sys, double tol) {
+    if (!sys || sys->diag_ref.mask != DYN_DIAG_ALL) return -1;
+    const dyn_diagnostics_t *ref = &sys->diag_ref;
+    double e = dyn_system_total_energy(sys);
+    dyn_diagnostics_t r = dyn_diag_current(sys, DYN_DIAG_MOMENTUM);
+
+    /* Momentum is compared against the scale sqrt(2 M K) when it starts near zero. */
+    double p_scale = sqrt(2.0 * ref->total_mass * ref->kinetic), dp2 = 0.0, p02 = 0.0;
+    for (size_t a = 0; a < 3; a++) {
+        dp2 += (r.momentum[a] - ref->momentum[a]) * (r.momentum[a] - ref->momentum[a]);
+        p02 += ref->momentum[a] * ref->momentum[a];
+    }
+    if (sqrt(p02) > p_scale) p_scale = sqrt(p02);
+
+    if (fabs(e - ref->energy) > tol * fabs(ref->energy)) return 1;
+    if (sqrt(dp2) > tol * p_scale) return 1;
+    return 0;
+}
+
+/* -------------------------------
+   Force computation
+   ------------------------------- */
+
+/* Zeroed per-particle potential scratch, or NULL when the potential is not wanted. */
+static double *dyn_phi_scratch(dyn_system_t *sys, int *err) {
+    *err = 0;
+    if (!(sys->diag_mask & DYN_DIAG_POTENTIAL)) return NULL;
+    if (sys->phi_cap < sys->N) {
+        double *phi = realloc(sys->phi, sys->N * sizeof(double));
+        if (!phi) {
+            *err = 1;
+            return NULL;
+        }
+        sys->phi = phi;
+        sys->phi_cap = sys->N;
+    }
+    memset(sys->phi, 0, sys->N * sizeof(double));
+    return sys->phi;
+}
+
+/* U = -1/2 sum_i phi_i, with phi_i = G m_i sum_j m_j / r_ij, summed in index order. */
+static double dyn_phi_energy(const dyn_system_t *sys) {
+    double u = 0.0;
+    for (size_t i = 0; i < sys->N; i++) u += sys->phi[i];
+    return -0.5 * u;
+}
+
+/* Targets per work item in the threaded loops. */
+#define DYN_PAR_CHUNK 64
+
+/* Most subtrees the range callbacks are split into across threads. */
+#define DYN_FORCE_FRONTIER_MAX 256
+
+/* Add the gravity of all N particles on target i (AoS layout), summed in index order.
+   With phi non-NULL, phi[i] receives G m_i sum_{j != i} m_j / r_ij. */
+static void dyn_aos_gravity_target(dyn_system_t *sys, size_t i, double eps2, double *phi) {
+    dyn_particle_t *pi = &sys->particles[i];
+    const double xi = gsl_vector_get(pi->pos, 0), yi = gsl_vector_get(pi->pos, 1),
+                 zi = gsl_vector_get(pi->pos, 2);
+    double acc[3] = {0.0, 0.0, 0.0}, pot = 0.0;
+    for (size_t j = 0; j < sys->N; j++) {
+        const gsl_vector *rj = sys->particles[j].pos;
+        double d[3] = { gsl_vector_get(rj, 0) - xi, gsl_vector_get(rj, 1) - yi,
+                        gsl_vector_get(rj, 2) - zi };
+        double r2 = d[0] * d[0] + d[1] * d[1] + d[2] * d[2] + eps2;
+        if (r2 == 0.0) continue;
+        double inv_r = 1.0 / sqrt(r2), mj = sys->particles[j].mass;
+        double s = mj * inv_r * inv_r * inv_r;
+        for (size_t a = 0; a < 3; a++) acc[a] += s * d[a];
+        if (j != i) pot += mj * inv_r;
+    }
+    double gm = sys->G * pi->mass;
+    for (size_t a = 0; a < 3; a++)
+        *gsl_vector_ptr(pi->force, a) += gm * acc[a];
+    if (phi) phi[i] = gm * pot;
+}
+
+/*
+    Direct summation. Every target sums all sources itself in index order
+    (no Newton's-third-law scatter), so each force has exactly one writer
+    and a thread-count independent summation order; n_threads = 0 runs the
+    same loop on one thread and gives the same bits.
+*/
+static int dyn_parallel_pairwise_gravity(dyn_system_t *sys) {
+    const size_t N = sys->N;
+    const double eps2 = sys->use_softening ? sys->softening_eps * sys->softening_eps : 0.0;
+    const size_t chunks = (N + DYN_PAR_CHUNK - 1) / DYN_PAR_CHUNK;
+    const int nt = sys->n_threads > 0 ? sys->n_threads : 1;
+    int err;
+    double *phi = dyn_phi_scratch(sys, &err);
+    if (err) return -1;
+
+    if (sys->layout == DYN_LAYOUT_SOA) {
+        const size_t cap = sys->soa->capacity;
+        const double *x = sys->soa->pos, *y = x + cap, *z = x + 2 * cap;
+        double *fx = sys->soa->force, *fy = fx + cap, *fz = fx + 2 * cap;
+        const double *m = sys->soa->mass;
+        (void)pk_active_isa(); /* resolve dispatch before the threads start */
+
+        #pragma omp parallel for schedule(dynamic, 1) num_threads(nt) if(nt > 1)
+        for (size_t c = 0; c < chunks; c++) {
+            size_t i0 = c * DYN_PAR_CHUNK, i1 = i0 + DYN_PAR_CHUNK < N ? i0 + DYN_PAR_CHUNK : N;
+            if (phi) pk_inverse_square_pot(x, y, z, m, N, i0, i1, sys->G, eps2, fx, fy, fz, phi);
+            else     pk_inverse_square(x, y, z, m, N, i0, i1, sys->G, eps2, fx, fy, fz);
+        }
+    } else {
+        #pragma omp parallel for schedule(dynamic, DYN_PAR_CHUNK) num_threads(nt) if(nt > 1)
+        for (size_t i = 0; i < N; i++)
+            dyn_aos_gravity_target(sys, i, eps2, phi);
+    }
+    if (phi) sys->diag.potential = dyn_phi_energy(sys);
+    return 0;
+}
+
+int dyn_system_compute_gravity_active(dyn_system_t *sys, const size_t *active, size_t n_active) {
+    if (!sys || (n_active && !active)) return -1;
+    if (sys->gravity_solver != DYN_GRAVITY_DIRECT)
+        return dyn_system_compute_tree_gravity_active(sys, active, n_active);
+
+    const size_t N = sys->N;
+    const double eps2 = sys->use_softening ? sys->softening_eps * sys->softening_eps : 0.0;
+    const int nt = sys->n_threads > 0 ? sys->n_threads : 1;
+    (void)pk_active_isa();
+
+    #pragma omp parallel for schedule(dynamic, 16) num_threads(nt) if(nt > 1)
+    for (size_t k = 0; k < n_active; k++) {
+        const size_t i = active[k];
+        gsl_vector *f = sys->particles[i].force;
+        for (size_t a = 0; a < 3; a++) f->data[a * f->stride] = 0.0;
+        if (sys->layout == DYN_LAYOUT_SOA) {
+            const size_t cap = sys->soa->capacity;
+            const double *x = sys->soa->pos;
+            double *fx = sys->soa->force;
+            pk_inverse_square(x, x + cap, x + 2 * cap, sys->soa->mass, N, i, i + 1,
+                              sys->G, eps2, fx, fx + cap, fx + 2 * cap);
+        } else {
+            dyn_aos_gravity_target(sys, i, eps2, NULL);
+        }
+    }
+    return 0;
+}
+
+/*
+    Range callbacks run on S = min(force_slots, N) fixed ranges, and their
+    accumulators are summed pairwise over a fixed binary tree of the ranges
+    ([lo, hi) splits at lo + (hi - lo) / 2). The tree depends on S only, so
+    any thread count gives the same sums.
+
+    The threads split the tree at the first depth with at least n_threads
+    nodes (the frontier); each frontier node is evaluated depth-first with
+    a stack of one buffer per level below it, and the frontier results are
+    then added up the top of the tree. Live buffers are about
+    n_threads * (log2(S / n_threads) + 1), not S.
+*/
+
+/* Depth of the tree over [lo, hi): levels below the node */
+static size_t dyn_range_depth(size_t lo, size_t hi) {
+    size_t d = 0;
+    for (size_t n = hi - lo; n > 1; n = n - n / 2) d++;
+    return d;
+}
+
+/* Frontier nodes at depth d under [lo, hi), in range order (leaves stop early) */
+static size_t dyn_range_frontier(size_t lo, size_t hi, size_t d, size_t *out, size_t n) {
+    if (d == 0 || hi - lo == 1) {
+        out[2 * n] = lo;
+        out[2 * n + 1] = hi;
+        return n + 1;
+    }
+    const size_t mid = lo + (hi - lo) / 2;
+    n = dyn_range_frontier(lo, mid, d - 1, out, n);
+    return dyn_range_frontier(mid, hi, d - 1, out, n);
+}
+
+static void dyn_range_eval(dyn_system_t *sys, size_t lo, size_t hi, double *stack, size_t len) {
+    const size_t N = sys->N, S = sys->force_slots < N ? sys->force_slots : N;
+    if (hi - lo == 1) {
+        memset(stack, 0, len * sizeof(double));
+        sys->range_force_cb(sys, lo * N / S, (lo + 1) * N / S, stack, sys->range_force_cb_userdata);
+        return;
+    }
+    const size_t mid = lo + (hi - lo) / 2;
+    double *right = stack + len;
+    dyn_range_eval(sys, lo, mid, stack, len);
+    dyn_range_eval(sys, mid, hi, right, len);
+    for (size_t k = 0; k < len; k++) stack[k] += right[k];
+}
+
+/* Adds the frontier results (stride apart) up the tree above depth d;
+   the index of the sum. Called by every thread of the region. */
+static size_t dyn_range_combine(double *frontier, size_t stride, size_t len, size_t lo, size_t hi, size_t d,
+                                size_t *next) {
+    if (d == 0 || hi - lo == 1) return (*next)++;
+    const size_t mid = lo + (hi - lo) / 2;
+    const size_t a = dyn_range_combine(frontier, stride, len, lo, mid, d - 1, next);
+    const size_t b = dyn_range_combine(frontier, stride, len, mid, hi, d - 1, next);
+    double *x = frontier + a * stride;
+    const double *y = frontier + b * stride;
+    #pragma omp for schedule(static)
+    for (size_t k = 0; k < len; k++) x[k] += y[k];
+    return a;
+}
+
+static int dyn_parallel_range_forces(dyn_system_t *sys) {
+    const size_t N = sys->N;
+    if (N == 0) return 0;
+    const size_t S = sys->force_slots < N ? sys->force_slots : N;
+    const size_t len = 3 * N;
+    const int nt = sys->n_threads > 0 ? sys->n_threads : 1;
+    const size_t depth = dyn_range_depth(0, S);
+    size_t d = 0, n_front, levels, bounds[2 * DYN_FORCE_FRONTIER_MAX];
+
+    /* Nodes at depth d number at most 2^d */
+    while (d < depth && ((size_t)1 << d) < (size_t)nt && ((size_t)2 << d) <= DYN_FORCE_FRONTIER_MAX) d++;
+    n_front = dyn_range_frontier(0, S, d, bounds, 0);
+    levels = depth - d + 1;
+
+    if (n_front * levels * len > sys->force_acc_size) {
+        double *acc = realloc(sys->force_acc, n_front * levels * len * sizeof(double));
+        if (!acc) return -1;
+        sys->force_acc = acc;
+        sys->force_acc_size = n_front * levels * len;
+    }
+
+    #pragma omp parallel num_threads(nt)
+    {
+        size_t next = 0, sum;
+        #pragma omp for schedule(dynamic, 1)
+        for (size_t f = 0; f < n_front; f++)
+            dyn_range_eval(sys, bounds[2 * f], bounds[2 * f + 1], sys->force_acc + f * levels * len, len);
+
+        sum = dyn_range_combine(sys->force_acc, levels * len, len, 0, S, d, &next);
+        const double *acc = sys->force_acc + sum * levels * len;
+
+        #pragma omp for schedule(static)
+        for (size_t i = 0; i < N; i++) {
+            gsl_vector *f = sys->particles[i].force;
+            for (size_t a = 0; a < 3; a++) f->data[a * f->stride] += acc[a * N + i];
+        }
+    }
+    return 0;
+}
+
+int dyn_system_compute_pairwise_gravity(dyn_system_t *sys) {
+    if (!sys) return -1;
+    if (sys->gravity_solver != DYN_GRAVITY_DIRECT)
+        return dyn_system_compute_tree_gravity(sys);
+    return dyn_parallel_pairwise_gravity(sys);
+}
+
+int dyn_system_compute_forces(dyn_system_t *sys) {
+    HOLOS_TRACE_ZONE("dyn_system_compute_forces");
+    if (!sys) return -1;
+    /* Host evaluation; the forces are about to be overwritten, so leave them. */
+    if (dyn_gpu_pull(sys, DYN_GPU_POS | DYN_GPU_VEL) != 0) return -1;
+    dyn_gpu_touch(sys, DYN_GPU_FORCE);
+    dyn_diag_acc_t diag = {0};
+    if (sys->diag_mask) {
+        dyn_zero_forces_diag(sys, &diag);
+        sys->diag.potential = 0.0;
+    } else {
+        dyn_system_zero_forces(sys);
+    }
+    if (sys->neighbors && dyn_system_update_neighbor_list(sys) < 0) {
+        sys->forces_valid = 0;
+        return -1;
+    }
+    if (sys->range_force_cb) {
+        if (dyn_parallel_range_forces(sys) != 0) {
+            sys->forces_valid = 0;
+            return -1;
+        }
+    } else if (sys->force_cb) {
+        sys->force_cb(sys, sys->force_cb_userdata);
+    } else if (dyn_system_compute_pairwise_gravity(sys) != 0) {
+        sys->forces_valid = 0;
+        return -1;
+    }
+    if (sys->diag_mask) dyn_diag_store(sys, &diag, !sys->range_force_cb);
+    sys->forces_valid = 1;
+    return 0;
+}
+
+/* -------------------------------
+   Integration
+   ------------------------------- */
+
+dyn_workspace_t *dyn_workspace_alloc(size_t N) {
+    dyn_workspace_t *ws = calloc(1, sizeof(*ws));
+    if (!ws) return NULL;
+    ws->ode_epsabs = 1e-10;
+    ws->ode_epsrel = 1e-10;
+    if (dyn_workspace_reserve(ws, N) != 0) {
+        dyn_workspace_free(ws);
+        return NULL;
+    }
+    return ws;
+}
+
+void dyn_workspace_free(dyn_workspace_t *ws) {
+    if (!ws) return;
+    free(ws->x0);
+    free(ws->v0);
+    free(ws->dx);
+    free(ws->dv);
+    free(ws->y);
+    if (ws->ode_driver) gsl_odeiv2_driver_free(ws->ode_driver);
+    free(ws->ode_system);
+    free(ws);
+}
+
+int dyn_workspace_reserve(dyn_workspace_t *ws, size_t N) {
+    if (!ws) return -1;
+    if (N <= ws->capacity) return 0;
+
+    double **bufs[4] = { &ws->x0, &ws->v0, &ws->dx, &ws->dv };
+    for (int b = 0; b < 4; b++) {
+        double *p = realloc(*bufs[b], 3 * N * sizeof(double));
+        if (!p) return -1;
+        *bufs[b] = p;
+    }
+    double *y = realloc(ws->y, 6 * N * sizeof(double));
+    if (!y) return -1;
+    ws->y = y;
+    ws->capacity = N;
+    return 0;
+}
+
+/*
+    Fused whole-system kernels. Particle vectors are accessed as (data, stride),
+    which covers both layouts: AoS vectors have stride 1, SoA views have
+    stride = capacity, so each axis streams linearly through its array in SoA.
+*/
+
+/* v += (dt_v / m) F, then x += dt_x v, in one pass. */
+static void dyn_kick_drift(dyn_system_t *sys, double dt_v, double dt_x, dyn_diag_acc_t *diag) {
+    for (size_t i = 0; i < sys->N; i++) {
+        dyn_particle_t *p = &sys->particles[i];
+        double *x = p->pos->data, *v = p->vel->data;
+        size_t sx = p->pos->stride, sv = p->vel->stride;
+        const double m = dyn_mass(sys, i);
+        if (!p->fixed) {
+            const double *f = p->force->data;
+            size_t sf = p->force->stride;
+            double w = dt_v / m;
+            for (size_t a = 0; a < 3; a++) {
+                v[a * sv] += w * f[a * sf];
+                x[a * sx] += dt_x * v[a * sv];
+            }
+        }
+        if (diag) dyn_diag_add(diag, m, x, sx, v, sv);
+    }
+}
+
+/* x += dt v. */
+static void dyn_drift(dyn_system_t *sys, double dt) {
+    for (size_t i = 0; i < sys->N; i++) {
+        dyn_particle_t *p = &sys->particles[i];
+        if (p->fixed) continue;
+        double *x = p->pos->data;
+        const double *v = p->vel->data;
+        size_t sx = p->pos->stride, sv = p->vel->stride;
+        for (size_t a = 0; a < 3; a++) x[a * sx] += dt * v[a * sv];
+    }
+}
+
+/* Semi-implicit Euler: v += a dt; x += v dt. */
+static int dyn_step_euler(dyn_system_t *sys, double dt) {
+    if (dyn_system_compute_forces(sys) != 0) return -1;
+    dyn_kick_drift(sys, dt, dt, NULL);
+    sys->forces_valid = 0;
+    return 0;
+}
+
+/* Velocity Verlet (kick-drift-kick), one force evaluation per step. */
+static int dyn_step_verlet(dyn_system_t *sys, double dt) {
+    if (!sys->forces_valid && dyn_system_compute_forces(sys) != 0) return -1;
+    dyn_kick_drift(sys, 0.5 * dt, dt, NULL);
+    if (dyn_system_compute_forces(sys) != 0) return -1;
+    /* The closing kick sees the final state; the potential came with the forces. */
+    dyn_diag_acc_t diag = {0};
+    dyn_kick_drift(sys, 0.5 * dt, 0.0, sys->diag_mask ? &diag : NULL);
+    if (sys->diag_mask) dyn_diag_store(sys, &diag, !sys->range_force_cb);
+    return 0;
+}
+
+/* Leapfrog (drift-kick-drift). */
+static int dyn_step_leapfrog(dyn_system_t *sys, double dt) {
+    dyn_drift(sys, 0.5 * dt);
+    if (dyn_system_compute_forces(sys) != 0) return -1;
+    dyn_kick_drift(sys, dt, 0.5 * dt, NULL);
+    sys->forces_valid = 0;
+    return 0;
+}
+
+/* Classical RK4 on (x, v); stage weights accumulate into ws->dx / ws->dv. */
+static int dyn_step_rk4(dyn_system_t *sys, double dt, dyn_workspace_t *ws) {
+    static const double stage_dt[4] = { 0.5, 0.5, 1.0, 0.0 };
+    static const double weight[4] = { 1.0 / 6.0, 1.0 / 3.0, 1.0 / 3.0, 1.0 / 6.0 };
+    const size_t N = sys->N;
+
+    for (size_t i = 0; i < N; i++) {
+        const gsl_vector *x = sys->particles[i].pos, *v = sys->particles[i].vel;
+        for (size_t a = 0; a < 3; a++) {
+            ws->x0[3 * i + a] = x->data[a * x->stride];
+            ws->v0[3 * i + a] = v->data[a * v->stride];
+            ws->dx[3 * i + a] = 0.0;
+            ws->dv[3 * i + a] = 0.0;
+        }
+    }
+
+    for (int s = 0; s < 4; s++) {
+        if (dyn_system_compute_forces(sys) != 0) return -1;
+        for (size_t i = 0; i < N; i++) {
+            dyn_particle_t *p = &sys->particles[i];
+            if (p->fixed) continue;
+            double *x = p->pos->data, *v = p->vel->data;
+            const double *f = p->force->data;
+            size_t sx = p->pos->stride, sv = p->vel->stride, sf = p->force->stride;
+            double inv_m = 1.0 / dyn_mass(sys, i);
+            for (size_t a = 0; a < 3; a++) {
+                double kx = v[a * sv], kv = f[a * sf] * inv_m;
+                ws->dx[3 * i + a] += weight[s] * kx;
+                ws->dv[3 * i + a] += weight[s] * kv;
+                /* Next stage evaluates at y0 + c * dt * k; the last stage writes the result. */
+                double c = s < 3 ? stage_dt[s] * dt : dt;
+                x[a * sx] = ws->x0[3 * i + a] + c * (s < 3 ? kx : ws->dx[3 * i + a]);
+                v[a * sv] = ws->v0[3 * i + a] + c * (s < 3 ? kv : ws->dv[3 * i + a]);
+            }
+        }
+    }
+    sys->forces_valid = 0;
+    return 0;
+}
+
+/* Scatter a packed ODE state y = [x v] per particle back into the system. */
+static void dyn_ode_unpack(dyn_system_t *sys, const double y[]) {
+    for (size_t i = 0; i < sys->N; i++) {
+        gsl_vector *x = sys->particles[i].pos, *v = sys->particles[i].vel;
+        for (size_t a = 0; a < 3; a++) {
+            x->data[a * x->stride] = y[6 * i + a];
+            v->data[a * v->stride] = y[6 * i + 3 + a];
+        }
+    }
+}
+
+/* Right-hand side for the GSL ODE driver. */
+static int dyn_ode_rhs(double t, const double y[], double dydt[], void *params) {
+    dyn_system_t *sys = params;
+    (void)t;
+    dyn_ode_unpack(sys, y);
+    if (dyn_system_compute_forces(sys) != 0) return GSL_EBADFUNC;
+    for (size_t i = 0; i < sys->N; i++) {
+        const gsl_vector *f = sys->particles[i].force;
+        int fixed = sys->particles[i].fixed;
+        double inv_m = fixed ? 0.0 : 1.0 / dyn_mass(sys, i);
+        for (size_t a = 0; a < 3; a++) {
+            dydt[6 * i + a] = fixed ? 0.0 : y[6 * i + 3 + a];
+            dydt[6 * i + 3 + a] = inv_m * f->data[a * f->stride];
+        }
+    }
+    return GSL_SUCCESS;
+}
+
+/* Adaptive GSL odeiv2 integration over [t, t + dt]; the driver lives in the workspace
+   and is only rebuilt when the particle count changes. */
+static int dyn_step_gsl_ode(dyn_system_t *sys, double dt, dyn_workspace_t *ws) {
+    size_t dim = 6 * sys->N;
+
+    if (!ws->ode_driver || ws->ode_dim != dim) {
+        gsl_odeiv2_system *ode = ws->ode_system ? ws->ode_system : malloc(sizeof(*ode));
+        if (!ode) return -1;
+        ws->ode_system = ode;
+        if (ws->ode_driver) gsl_odeiv2_driver_free(ws->ode_driver);
+        ode->function = dyn_ode_rhs;
+        ode->jacobian = NULL;
+        ode->dimension = dim;
+        ode->params = sys;
+        ws->ode_driver = gsl_odeiv2_driver_alloc_y_new(ode, gsl_odeiv2_step_rk8pd,
+                                                       dt, ws->ode_epsabs, ws->ode_epsrel);
+        ws->ode_dim = ws->ode_driver ? dim : 0;
+        if (!ws->ode_driver) return -1;
+    }
+    ((gsl_odeiv2_system *)ws->ode_system)->params = sys;
+
+    for (size_t i = 0; i < sys->N; i++) {
+        const gsl_vector *x = sys->particles[i].pos, *v = sys->particles[i].vel;
+        for (size_t a = 0; a < 3; a++) {
+            ws->y[6 * i + a] = x->data[a * x->stride];
+            ws->y[6 * i + 3 + a] = v->data[a * v->stride];
+        }
+    }
+    double t = sys->t;
+    int status = gsl_odeiv2_driver_apply(ws->ode_driver, &t, sys->t + dt, ws->y);
+    dyn_ode_unpack(sys, ws->y);
+    sys->forces_valid = 0;
+    return status == GSL_SUCCESS ? 0 : -1;
+}
+
+/* -------------------------------
+   Block time-stepping
+   ------------------------------- */
+
+static void dyn_block_free(dyn_block_t *b) {
+    if (!b) return;
+    free(b->level);
+    free(b->acc_prev);
+    free(b->t_prev);
+    free(b->active);
+    free(b);
+}
+
+/* Size the per-particle arrays for n particles and restart every particle
+   on the finest level (there is no acceleration history yet). */
+static int dyn_block_reset(dyn_block_t *b, size_t n) {
+    unsigned char *level = realloc(b->level, n ? n : 1);
+    if (!level) return -1;
+    b->level = level;
+    double *acc = realloc(b->acc_prev, (3 * n + 1) * sizeof(double));
+    if (!acc) return -1;
+    b->acc_prev = acc;
+    double *tp = realloc(b->t_prev, (n + 1) * sizeof(double));
+    if (!tp) return -1;
+    b->t_prev = tp;
+    size_t *active = realloc(b->active, (n + 1) * sizeof(size_t));
+    if (!active) return -1;
+    b->active = active;
+    for (size_t i = 0; i < n; i++) {
+        b->level[i] = (unsigned char)b->max_level;
+        b->t_prev[i] = NAN;
+    }
+    b->n = n;
+    return 0;
+}
+
+int dyn_system_set_block_timesteps(dyn_system_t *sys, int max_level, double eta) {
+    if (!sys) return -1;
+    dyn_block_free(sys->blocks);
+    sys->blocks = NULL;
+    if (max_level <= 0) return 0;
+    if (max_level > 30 || !(eta > 0.0)) return -1;
+
+    dyn_block_t *b = calloc(1, sizeof(*b));
+    if (!b) return -1;
+    b->max_level = max_level;
+    b->eta = eta;
+    if (dyn_block_reset(b, sys->N) != 0) {
+        dyn_block_free(b);
+        return -1;
+    }
+    sys->blocks = b;
+    return 0;
+}
+
+int dyn_system_particle_level(const dyn_system_t *sys, size_t i) {
+    if (!sys || !sys->blocks || i >= sys->blocks->n) return -1;
+    return sys->blocks->level[i];
+}
+
+/* v_i += dt f_i / m_i. */
+static void dyn_block_kick(dyn_system_t *sys, size_t i, double dt) {
+    dyn_particle_t *p = &sys->particles[i];
+    if (p->fixed) return;
+    double *v = p->vel->data;
+    const double *f = p->force->data;
+    size_t sv = p->vel->stride, sf = p->force->stride;
+    double w = dt / dyn_mass(sys, i);
+    for (size_t a = 0; a < 3; a++) v[a * sv] += w * f[a * sf];
+}
+
+/* Record a_i at time t and return the level the jerk criterion asks for. */
+static int dyn_block_level(dyn_system_t *sys, size_t i, double dt, double t) {
+    dyn_block_t *b = sys->blocks;
+    const gsl_vector *f = sys->particles[i].force;
+    const double inv_m = 1.0 / dyn_mass(sys, i);
+    double *ap = &b->acc_prev[3 * i];
+    double a2 = 0.0, j2 = 0.0;
+    const double span = t - b->t_prev[i];
+
+    for (size_t a = 0; a < 3; a++) {
+        double acc = inv_m * f->data[a * f->stride];
+        double jerk = (acc - ap[a]) / span;
+        a2 += acc * acc;
+        j2 += jerk * jerk;
+        ap[a] = acc;
+    }
+    b->t_prev[i] = t;
+    if (!(span > 0.0) || !(j2 > 0.0)) return isnan(span) ? b->level[i] : 0;
+
+    double dt_i = b->eta * sqrt(a2 / j2);
+    if (dt_i >= dt) return 0;
+    int level = (int)ceil(log2(dt / dt_i));
+    return level > b->max_level ? b->max_level : level;
+}
+
+/* Forces of the particles finishing a step; callbacks see the whole system. */
+static int dyn_block_forces(dyn_system_t *sys, const size_t *active, size_t n) {
+    if (sys->force_cb || sys->range_force_cb) {
+        sys->blocks->n_force_evals += sys->N;
+        return dyn_system_compute_forces(sys);
+    }
+    sys->blocks->n_force_evals += n;
+    return dyn_system_compute_gravity_active(sys, active, n);
+}
+
+/*
+    Hierarchical kick-drift-kick. A level-L particle is kicked by half its
+    step dt / 2^L when its step opens and closes; everyone drifts by the
+    finest substep h. Each level is therefore a leapfrog of its own. Levels
+    may refine at any closing and coarsen by one when the coarser step is
+    aligned with the substep count, which keeps the hierarchy synchronized.
+*/
+static int dyn_step_block(dyn_system_t *sys, double dt) {
+    dyn_block_t *b = sys->blocks;
+    const size_t N = sys->N;
+    if (b->n != N && dyn_block_reset(b, N) != 0) return -1;
+
+    const double t0 = sys->t;
+    if (!sys->forces_valid) {
+        if (dyn_system_compute_forces(sys) != 0) return -1;
+        b->n_force_evals += N;
+    }
+    for (size_t i = 0; i < N; i++) {
+        if (!isnan(b->t_prev[i])) continue;
+        const gsl_vector *f = sys->particles[i].force;
+        for (size_t a = 0; a < 3; a++)
+            b->acc_prev[3 * i + a] = f->data[a * f->stride] / dyn_mass(sys, i);
+        b->t_prev[i] = t0;
+    }
+
+    const int L = b->max_level;
+    const size_t nsub = (size_t)1 << L;
+    const double h = dt / (double)nsub;
+
+    for (size_t s = 0; s < nsub; s++) {
+        for (size_t i = 0; i < N; i++) {
+            size_t stride = (size_t)1 << (L - b->level[i]);
+            if (s % stride == 0) dyn_block_kick(sys, i, 0.5 * h * (double)stride);
+        }
+        dyn_drift(sys, h);
+
+        size_t n_active = 0;
+        for (size_t i = 0; i < N; i++)
+            if ((s + 1) % ((size_t)1 << (L - b->level[i])) == 0) b->active[n_active++] = i;
+
+        sys->t = t0 + (double)(s + 1) * h;
+        if (dyn_block_forces(sys, b->active, n_active) != 0) {
+            sys->t = t0;
+            sys->forces_valid = 0;
+            return -1;
+        }
+
+        for (size_t k = 0; k < n_active; k++) {
+            const size_t i = b->active[k];
+            dyn_block_kick(sys, i, 0.5 * h * (double)((size_t)1 << (L - b->level[i])));
+            int want = dyn_block_level(sys, i, dt, sys->t);
+            if (want >= b->level[i]) {
+                b->level[i] = (unsigned char)want;
+            } else {
+                int coarser = b->level[i] - 1;
+                if ((s + 1) % ((size_t)1 << (L - coarser)) == 0) b->level[i] = (unsigned char)coarser;
+            }
+        }
+    }
+    /* The last substep synchronizes every level, so all forces are current. */
+    sys->t = t0;
+    sys->forces_valid = 1;
+    return 0;
+}
+
+/* -------------------------------
+   Device-resident stepping
+   ------------------------------- */
+
+/* Direct gravity stays on the device; callbacks and the tree solver run on
+   the host from downloaded positions and their forces are uploaded again. */
+static int dyn_gpu_forces(dyn_system_t *sys) {
+    if (sys->range_force_cb || sys->force_cb || sys->gravity_solver != DYN_GRAVITY_DIRECT) {
+        if (dyn_system_compute_forces(sys) != 0) return -1;
+        return dyn_gpu_push(sys);
+    }
+    double u = 0.0;
+    const int want_pot = (sys->diag_mask & DYN_DIAG_POTENTIAL) != 0;
+    if (dyn_gpu_gravity(sys, want_pot ? &u : NULL) != 0) {
+        sys->forces_valid = 0;
+        return -1;
+    }
+    if (want_pot) sys->diag.potential = u;
+    sys->forces_valid = 1;
+    return 0;
+}
+
+/* Euler, velocity Verlet and leapfrog on the device mirror, with the same
+   sequence of kicks and drifts as the host versions. Returns 1 without
+   touching the system when the step has to run on the host. */
+static int dyn_step_gpu(dyn_system_t *sys, double dt, dyn_integrator_t integrator) {
+    if (sys->blocks || (integrator != DYN_INT_EULER && integrator != DYN_INT_VERLET &&
+                        integrator != DYN_INT_LEAPFROG))
+        return 1;
+    if (dyn_gpu_push(sys) != 0) return -1;
+
+    if (integrator == DYN_INT_EULER) {
+        if (dyn_gpu_forces(sys) != 0 || dyn_gpu_kick_drift(sys, dt, dt) != 0) return -1;
+        sys->forces_valid = 0;
+        return 0;
+    }
+    if (integrator == DYN_INT_VERLET) {
+        if (!sys->forces_valid && dyn_gpu_forces(sys) != 0) return -1;
+        if (dyn_gpu_kick_drift(sys, 0.5 * dt, dt) != 0 || dyn_gpu_forces(sys) != 0) return -1;
+        return dyn_gpu_kick_drift(sys, 0.5 * dt, 0.0);
+    }
+    if (dyn_gpu_kick_drift(sys, 0.0, 0.5 * dt) != 0 || dyn_gpu_forces(sys) != 0 ||
+        dyn_gpu_kick_drift(sys, dt, 0.5 * dt) != 0)
+        return -1;
+    sys->forces_valid = 0;
+    return 0;
+}
+
+int dyn_system_step_ws(dyn_system_t *sys, double dt, dyn_integrator_t integrator, dyn_workspace_t *ws) {
+    if (!sys || !ws) return -1;
+    if (dyn_workspace_reserve(ws, sys->N) != 0) return -1;
+
+    int status = sys->gpu ? dyn_step_gpu(sys, dt, integrator) : 1;
+    const int on_gpu = status == 0;
+    if (status > 0) {
+        /* Host step; with a device attached it runs on a fresh copy that is resent afterwards. */
+        if (dyn_system_sync_host(sys) != 0) return -1;
+        if (sys->blocks && (integrator == DYN_INT_VERLET || integrator == DYN_INT_LEAPFROG))
+            status = dyn_step_block(sys, dt);
+        else switch (integrator) {
+        case DYN_INT_EULER:    status = dyn_step_euler(sys, dt); break;
+        case DYN_INT_VERLET:   status = dyn_step_verlet(sys, dt); break;
+        case DYN_INT_LEAPFROG: status = dyn_step_leapfrog(sys, dt); break;
+        case DYN_INT_RK4:      status = dyn_step_rk4(sys, dt, ws); break;
+        case DYN_INT_GSL_ODE:  status = dyn_step_gsl_ode(sys, dt, ws); break;
+        default:               return -1;
+        }
+        dyn_system_invalidate_gpu(sys);
+    }
+    if (status != 0) return status;
+
+    sys->t += dt;
+    sys->dt_last = dt;
+    sys->step_count++;
+    if (sys->diag_mask) {
+        if (on_gpu) {
+            /* The potential (direct gravity) came back with the last force evaluation. */
+            if (dyn_gpu_pull(sys, DYN_GPU_POS | DYN_GPU_VEL) != 0) return -1;
+            dyn_diag_sweep(sys, integrator == DYN_INT_VERLET && !sys->range_force_cb);
+        } else if (integrator == DYN_INT_VERLET && !sys->blocks) {
+            /* Velocity Verlet already fused the sums into its last kick. */
+            sys->diag.t = sys->t;
+            sys->diag.step = sys->step_count;
+        } else {
+            dyn_diag_sweep(sys, 0);
+        }
+    }
+    if (sys->trajectory && sys->step_count % sys->trajectory_every == 0)
+        return dyn_traj_append(sys->trajectory, sys);
+    return 0;
+}
+
+int dyn_system_step(dyn_system_t *sys, double dt, dyn_integrator_t integrator) {
+    HOLOS_TRACE_ZONE("dyn_system_step");
+    if (!sys) return -1;
+    if (!sys->workspace) {
+        sys->workspace = dyn_workspace_alloc(sys->N);
+        if (!sys->workspace) return -1;
+    }
+    return dyn_system_step_ws(sys, dt, integrator, sys->workspace);
+}
+
+void dyn_system_set_time(dyn_system_t *sys, double t) {
+    if (sys) sys->t = t;
+}
 
-    gsl_vector_free(tmp);
+double dyn_system_get_time(const dyn_system_t *sys) {
+    return sys ? sys->t : 0.0;
 }
@@ -0,0 +1,211 @@
+/* dynamics_cuda.cu - CUDA backend for dyn_system_t offload in HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+   ----------------------------------------------------------------------
+   Device buffers and kernels behind dynamics_gpu.c (built with --enable-cuda).
+   - Component arrays x|y|z per field, so every kernel access is coalesced
+   - Direct gravity: one thread per target, sources staged through shared
+     memory tiles and summed in index order (same result on every run)
+   - Self terms are skipped exactly as in the host solver
+*/
+
+#include <cuda_runtime.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <gsl/gsl_vector.h>
+#include <gsl/gsl_matrix.h>
+
+/* The headers above carry their own C++ guards; ours do not. */
+extern "C" {
+#include "core/phys/mech/classical/dynamics_gpu.h"
+}
+
+#define DYN_CUDA_TILE 256
+
+typedef struct {
+    int device;
+    size_t n;
+    double *pos, *vel, *force;  /* 3 * n each */
+    double *mass, *phi;         /* n each */
+    unsigned char *fixed;       /* n */
+} dyn_cuda_t;
+
+static double *dyn_cuda_field(dyn_cuda_t *b, unsigned field) {
+    switch (field) {
+    case DYN_GPU_POS:   return b->pos;
+    case DYN_GPU_VEL:   return b->vel;
+    case DYN_GPU_FORCE: return b->force;
+    case DYN_GPU_MASS:  return b->mass;
+    default:            return NULL;
+    }
+}
+
+static size_t dyn_cuda_field_len(const dyn_cuda_t *b, unsigned field) {
+    return field == DYN_GPU_MASS ? b->n : 3 * b->n;
+}
+
+static unsigned dyn_cuda_blocks(size_t n) {
+    return (unsigned)((n + DYN_CUDA_TILE - 1) / DYN_CUDA_TILE);
+}
+
+__global__ static void dyn_cuda_gravity_kernel(size_t n, const double *__restrict__ pos,
+                                               const double *__restrict__ mass, double G, double eps2,
+                                               double *__restrict__ force, double *__restrict__ phi) {
+    __shared__ double sx[DYN_CUDA_TILE], sy[DYN_CUDA_TILE], sz[DYN_CUDA_TILE], sm[DYN_CUDA_TILE];
+    const size_t i = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
+    const bool live = i < n;
+    const double xi = live ? pos[i] : 0.0, yi = live ? pos[n + i] : 0.0, zi = live ? pos[2 * n + i] : 0.0;
+    double ax = 0.0, ay = 0.0, az = 0.0, pot = 0.0;
+
+    for (size_t base = 0; base < n; base += DYN_CUDA_TILE) {
+        const size_t j = base + threadIdx.x;
+        if (j < n) {
+            sx[threadIdx.x] = pos[j];
+            sy[threadIdx.x] = pos[n + j];
+            sz[threadIdx.x] = pos[2 * n + j];
+            sm[threadIdx.x] = mass[j];
+        }
+        __syncthreads();
+        const size_t tile = n - base < DYN_CUDA_TILE ? n - base : DYN_CUDA_TILE;
+        if (live) {
+            for (size_t k = 0; k < tile; k++) {
+                const double dx = sx[k] - xi, dy = sy[k] - yi, dz = sz[k] - zi;
+                const double r2 = dx * dx + dy * dy + dz * dz + eps2;
+                if (r2 == 0.0) continue;
+                const double inv_r = rsqrt(r2), s = sm[k] * inv_r * inv_r * inv_r;
+                ax += s * dx;
+                ay += s * dy;
+                az += s * dz;
+                if (base + k != i) pot += sm[k] * inv_r;
+            }
+        }
+        __syncthreads();
+    }
+    if (!live) return;
+    const double gm = G * mass[i];
+    force[i] = gm * ax;
+    force[n + i] = gm * ay;
+    force[2 * n + i] = gm * az;
+    if (phi) phi[i] = gm * pot;
+}
+
+__global__ static void dyn_cuda_kick_drift_kernel(size_t n, double *__restrict__ pos, double *__restrict__ vel,
+                                                  const double *__restrict__ force,
+                                                  const double *__restrict__ mass,
+                                                  const unsigned char *__restrict__ fixed,
+                                                  double dt_v, double dt_x) {
+    const size_t i = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
+    if (i >= n || fixed[i]) return;
+    /* dt_v == 0 is a pure drift and must not touch massless particles. */
+    const double w = dt_v != 0.0 ? dt_v / mass[i] : 0.0;
+    for (size_t a = 0; a < 3; a++) {
+        double v = vel[a * n + i];
+        if (dt_v != 0.0) {
+            v += w * force[a * n + i];
+            vel[a * n + i] = v;
+        }
+        pos[a * n + i] += dt_x * v;
+    }
+}
+
+extern "C" int dyn_cuda_device_count(void) {
+    int count = 0;
+    if (cudaGetDeviceCount(&count) != cudaSuccess) {
+        cudaGetLastError();
+        return 0;
+    }
+    return count;
+}
+
+extern "C" void dyn_cuda_destroy(void *backend) {
+    dyn_cuda_t *b = (dyn_cuda_t *)backend;
+    if (!b) return;
+    cudaSetDevice(b->device);
+    cudaFree(b->pos);
+    cudaFree(b->vel);
+    cudaFree(b->force);
+    cudaFree(b->mass);
+    cudaFree(b->phi);
+    cudaFree(b->fixed);
+    free(b);
+}
+
+extern "C" void *dyn_cuda_create(int device, size_t n) {
+    dyn_cuda_t *b = (dyn_cuda_t *)calloc(1, sizeof(*b));
+    if (!b) return NULL;
+    b->device = device;
+    b->n = n;
+    const size_t cap = n ? n : 1;
+    if (cudaSetDevice(device) != cudaSuccess ||
+        cudaMalloc((void **)&b->pos, 3 * cap * sizeof(double)) != cudaSuccess ||
+        cudaMalloc((void **)&b->vel, 3 * cap * sizeof(double)) != cudaSuccess ||
+        cudaMalloc((void **)&b->force, 3 * cap * sizeof(double)) != cudaSuccess ||
+        cudaMalloc((void **)&b->mass, cap * sizeof(double)) != cudaSuccess ||
+        cudaMalloc((void **)&b->phi, cap * sizeof(double)) != cudaSuccess ||
+        cudaMalloc((void **)&b->fixed, cap) != cudaSuccess) {
+        dyn_cuda_destroy(b);
+        return NULL;
+    }
+    return b;
+}
+
+extern "C" int dyn_cuda_upload(void *backend, unsigned field, const double *src) {
+    dyn_cuda_t *b = (dyn_cuda_t *)backend;
+    double *dst = dyn_cuda_field(b, field);
+    if (!dst || cudaSetDevice(b->device) != cudaSuccess) return -1;
+    if (b->n == 0) return 0;
+    return cudaMemcpy(dst, src, dyn_cuda_field_len(b, field) * sizeof(double),
+                      cudaMemcpyHostToDevice) == cudaSuccess ? 0 : -1;
+}
+
+extern "C" int dyn_cuda_upload_fixed(void *backend, const unsigned char *fixed) {
+    dyn_cuda_t *b = (dyn_cuda_t *)backend;
+    if (cudaSetDevice(b->device) != cudaSuccess) return -1;
+    if (b->n == 0) return 0;
+    return cudaMemcpy(b->fixed, fixed, b->n, cudaMemcpyHostToDevice) == cudaSuccess ? 0 : -1;
+}
+
+extern "C" int dyn_cuda_download(void *backend, unsigned field, double *dst) {
+    dyn_cuda_t *b = (dyn_cuda_t *)backend;
+    const double *src = dyn_cuda_field(b, field);
+    if (!src || cudaSetDevice(b->device) != cudaSuccess) return -1;
+    if (b->n == 0) return 0;
+    return cudaMemcpy(dst, src, dyn_cuda_field_len(b, field) * sizeof(double),
+                      cudaMemcpyDeviceToHost) == cudaSuccess ? 0 : -1;
+}
+
+extern "C" int dyn_cuda_gravity(void *backend, double G, double eps2, double *phi) {
+    dyn_cuda_t *b = (dyn_cuda_t *)backend;
+    if (cudaSetDevice(b->device) != cudaSuccess) return -1;
+    if (b->n == 0) return 0;
+    dyn_cuda_gravity_kernel<<<dyn_cuda_blocks(b->n), DYN_CUDA_TILE>>>(b->n, b->pos, b->mass, G, eps2,
+                                                                       b->force, phi ? b->phi : NULL);
+    if (cudaGetLastError() != cudaSuccess) return -1;
+    if (!phi) return 0;
+    return cudaMemcpy(phi, b->phi, b->n * sizeof(double), cudaMemcpyDeviceToHost) == cudaSuccess ? 0 : -1;
+}
+
+extern "C" int dyn_cuda_kick_drift(void *backend, double dt_v, double dt_x) {
+    dyn_cuda_t *b = (dyn_cuda_t *)backend;
+    if (cudaSetDevice(b->device) != cudaSuccess) return -1;
+    if (b->n == 0) return 0;
+    dyn_cuda_kick_drift_kernel<<<dyn_cuda_blocks(b->n), DYN_CUDA_TILE>>>(b->n, b->pos, b->vel, b->force,
+                                                                          b->mass, b->fixed, dt_v, dt_x);
+    return cudaGetLastError() == cudaSuccess ? 0 : -1;
+}
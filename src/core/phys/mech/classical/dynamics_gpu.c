@@ -0,0 +1,236 @@
+/* dynamics_gpu.c - GPU offload of dyn_system_t for HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+   ----------------------------------------------------------------------
+   Host side of the device mirror.
+   - Gathers particle vectors (either layout) into flat component arrays
+     and scatters them back, one field at a time
+   - Tracks which fields are newer on which side, so every transfer is
+     triggered by a reader that actually needs the data
+   - Without --enable-cuda the backend reports no devices
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+
+#include "core/phys/mech/classical/dynamics_gpu.h"
+
+static const unsigned dyn_gpu_fields[3] = { DYN_GPU_POS, DYN_GPU_VEL, DYN_GPU_FORCE };
+
+static gsl_vector *dyn_gpu_vector(const dyn_particle_t *p, unsigned field) {
+    return field == DYN_GPU_POS ? p->pos : field == DYN_GPU_VEL ? p->vel : p->force;
+}
+
+static int dyn_gpu_upload_field(const dyn_system_t *sys, dyn_gpu_t *g, unsigned field) {
+    const size_t n = sys->N;
+    if (field == DYN_GPU_MASS) {
+        for (size_t i = 0; i < n; i++) {
+            g->stage[i] = sys->layout == DYN_LAYOUT_SOA ? sys->soa->mass[i] : sys->particles[i].mass;
+            g->fixed[i] = sys->particles[i].fixed != 0;
+        }
+        if (dyn_cuda_upload_fixed(g->backend, g->fixed) != 0) return -1;
+    } else {
+        for (size_t i = 0; i < n; i++) {
+            const gsl_vector *v = dyn_gpu_vector(&sys->particles[i], field);
+            for (size_t a = 0; a < 3; a++) g->stage[a * n + i] = v->data[a * v->stride];
+        }
+    }
+    if (dyn_cuda_upload(g->backend, field, g->stage) != 0) return -1;
+    g->n_uploads++;
+    return 0;
+}
+
+static int dyn_gpu_download_field(const dyn_system_t *sys, dyn_gpu_t *g, unsigned field) {
+    const size_t n = sys->N;
+    if (dyn_cuda_download(g->backend, field, g->stage) != 0) return -1;
+    for (size_t i = 0; i < n; i++) {
+        gsl_vector *v = dyn_gpu_vector(&sys->particles[i], field);
+        for (size_t a = 0; a < 3; a++) v->data[a * v->stride] = g->stage[a * n + i];
+    }
+    g->n_downloads++;
+    return 0;
+}
+
+void dyn_gpu_free(dyn_gpu_t *gpu) {
+    if (!gpu) return;
+    dyn_cuda_destroy(gpu->backend);
+    free(gpu->stage);
+    free(gpu->fixed);
+    free(gpu);
+}
+
+int dyn_gpu_device_count(void) {
+    return dyn_cuda_device_count();
+}
+
+int dyn_system_enable_gpu(dyn_system_t *sys, int device) {
+    if (!sys) return -1;
+    if (device < 0) {
+        int status = dyn_system_sync_host(sys);
+        dyn_gpu_free(sys->gpu);
+        sys->gpu = NULL;
+        return status;
+    }
+    if (device >= dyn_cuda_device_count()) return -1;
+    if (sys->gpu) {
+        if (((dyn_gpu_t *)sys->gpu)->device == device) return 0;
+        if (dyn_system_enable_gpu(sys, -1) != 0) return -1;
+    }
+
+    dyn_gpu_t *g = calloc(1, sizeof(*g));
+    if (!g) return -1;
+    g->device = device;
+    g->dirty = DYN_GPU_ALL;
+    sys->gpu = g;
+    return dyn_gpu_push(sys);
+}
+
+int dyn_gpu_pull(const dyn_system_t *sys, unsigned mask) {
+    dyn_gpu_t *g = sys ? sys->gpu : NULL;
+    if (!g || !(g->stale & mask)) return 0;
+    for (size_t f = 0; f < 3; f++) {
+        if (!(g->stale & mask & dyn_gpu_fields[f])) continue;
+        if (dyn_gpu_download_field(sys, g, dyn_gpu_fields[f]) != 0) return -1;
+        g->stale &= ~dyn_gpu_fields[f];
+    }
+    return 0;
+}
+
+int dyn_system_sync_host(const dyn_system_t *sys) {
+    return dyn_gpu_pull(sys, DYN_GPU_ALL);
+}
+
+void dyn_gpu_touch(dyn_system_t *sys, unsigned mask) {
+    dyn_gpu_t *g = sys ? sys->gpu : NULL;
+    if (!g) return;
+    g->stale &= ~mask;
+    g->dirty |= mask;
+}
+
+void dyn_system_invalidate_gpu(dyn_system_t *sys) {
+    dyn_gpu_touch(sys, DYN_GPU_ALL);
+}
+
+int dyn_gpu_push(dyn_system_t *sys) {
+    dyn_gpu_t *g = sys ? sys->gpu : NULL;
+    if (!g) return -1;
+    if (g->n != sys->N || !g->backend) {
+        /* Resized on the host (which then holds the only valid copy). */
+        size_t n = sys->N ? sys->N : 1;
+        double *stage = realloc(g->stage, 3 * n * sizeof(double));
+        if (!stage) return -1;
+        g->stage = stage;
+        unsigned char *fixed = realloc(g->fixed, n);
+        if (!fixed) return -1;
+        g->fixed = fixed;
+        dyn_cuda_destroy(g->backend);
+        g->backend = dyn_cuda_create(g->device, sys->N);
+        g->n = sys->N;
+        g->stale = 0;
+        g->dirty = DYN_GPU_ALL;
+        if (!g->backend) return -1;
+    }
+    if (!g->dirty) return 0;
+    if ((g->dirty & DYN_GPU_MASS) && dyn_gpu_upload_field(sys, g, DYN_GPU_MASS) != 0) return -1;
+    for (size_t f = 0; f < 3; f++)
+        if ((g->dirty & dyn_gpu_fields[f]) && dyn_gpu_upload_field(sys, g, dyn_gpu_fields[f]) != 0)
+            return -1;
+    g->dirty = 0;
+    return 0;
+}
+
+int dyn_gpu_gravity(dyn_system_t *sys, double *u) {
+    if (dyn_gpu_push(sys) != 0) return -1;
+    dyn_gpu_t *g = sys->gpu;
+    const double eps2 = sys->use_softening ? sys->softening_eps * sys->softening_eps : 0.0;
+    /* phi_i = G m_i sum_{j != i} m_j / r_ij comes back in the staging buffer. */
+    if (dyn_cuda_gravity(g->backend, sys->G, eps2, u ? g->stage : NULL) != 0) return -1;
+    g->stale |= DYN_GPU_FORCE;
+    if (u) {
+        double s = 0.0;
+        for (size_t i = 0; i < sys->N; i++) s += g->stage[i];
+        *u = -0.5 * s;
+    }
+    return 0;
+}
+
+int dyn_gpu_kick_drift(dyn_system_t *sys, double dt_v, double dt_x) {
+    if (dyn_gpu_push(sys) != 0) return -1;
+    dyn_gpu_t *g = sys->gpu;
+    if (dyn_cuda_kick_drift(g->backend, dt_v, dt_x) != 0) return -1;
+    g->stale |= (dt_v != 0.0 ? DYN_GPU_VEL : 0u) | (dt_x != 0.0 ? DYN_GPU_POS : 0u);
+    return 0;
+}
+
+#ifndef HAVE_CUDA
+
+/* Built without --enable-cuda: no devices, and nothing to drive. */
+
+int dyn_cuda_device_count(void) {
+    return 0;
+}
+
+void *dyn_cuda_create(int device, size_t n) {
+    (void)device;
+    (void)n;
+    return NULL;
+}
+
+void dyn_cuda_destroy(void *backend) {
+    (void)backend;
+}
+
+int dyn_cuda_upload(void *backend, unsigned field, const double *src) {
+    (void)backend;
+    (void)field;
+    (void)src;
+    return -1;
+}
+
+int dyn_cuda_upload_fixed(void *backend, const unsigned char *fixed) {
+    (void)backend;
+    (void)fixed;
+    return -1;
+}
+
+int dyn_cuda_download(void *backend, unsigned field, double *dst) {
+    (void)backend;
+    (void)field;
+    (void)dst;
+    return -1;
+}
+
+int dyn_cuda_gravity(void *backend, double G, double eps2, double *phi) {
+    (void)backend;
+    (void)G;
+    (void)eps2;
+    (void)phi;
+    return -1;
+}
+
+int dyn_cuda_kick_drift(void *backend, double dt_v, double dt_x) {
+    (void)backend;
+    (void)dt_v;
+    (void)dt_x;
+    return -1;
+}
+
+#endif /* HAVE_CUDA */
@@ -0,0 +1,240 @@
+/* dynamics_neighbor.c - Cell-list / Verlet neighbor lists for HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+   ----------------------------------------------------------------------
+   Short-range pair search for dyn_system_t.
+   - Linked-cell grid over the particle bounding box (open boundaries),
+     cell edge >= cutoff + skin, so only the 27 surrounding cells are scanned
+   - Half Verlet list in CSR form, rows in particle order
+   - Rebuilt only when the largest displacement since the build exceeds
+     skin / 2, which keeps every pair inside cutoff in the list
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "core/phys/mech/classical/dynamics.h"
+#include "core/trace/trace.h"
+
+#define DYN_NL_NONE ((size_t)-1)
+
+static double dyn_nl_coord(const dyn_system_t *sys, size_t i, size_t a) {
+    const gsl_vector *r = sys->particles[i].pos;
+    return r->data[a * r->stride];
+}
+
+static void dyn_nl_free(dyn_neighbor_list_t *nl) {
+    if (!nl) return;
+    free(nl->offset);
+    free(nl->index);
+    free(nl->ref);
+    free(nl->cell_head);
+    free(nl->cell_next);
+    free(nl);
+}
+
+/* Size per-particle arrays for n particles. */
+static int dyn_nl_resize(dyn_neighbor_list_t *nl, size_t n) {
+    if (n == nl->n && nl->offset) return 0;
+    size_t *offset = realloc(nl->offset, (n + 1) * sizeof(size_t));
+    if (!offset) return -1;
+    nl->offset = offset;
+    double *ref = realloc(nl->ref, (3 * n + 1) * sizeof(double));
+    if (!ref) return -1;
+    nl->ref = ref;
+    size_t *next = realloc(nl->cell_next, (n + 1) * sizeof(size_t));
+    if (!next) return -1;
+    nl->cell_next = next;
+    nl->n = n;
+    return 0;
+}
+
+static int dyn_nl_push(dyn_neighbor_list_t *nl, size_t k, size_t j) {
+    if (k == nl->index_cap) {
+        size_t cap = nl->index_cap ? 2 * nl->index_cap : 1024;
+        size_t *idx = realloc(nl->index, cap * sizeof(size_t));
+        if (!idx) return -1;
+        nl->index = idx;
+        nl->index_cap = cap;
+    }
+    nl->index[k] = j;
+    return 0;
+}
+
+static int dyn_nl_build(dyn_system_t *sys) {
+    HOLOS_TRACE_ZONE("dyn_nl_build");
+    dyn_neighbor_list_t *nl = sys->neighbors;
+    const size_t n = sys->N;
+    if (dyn_nl_resize(nl, n) != 0) return -1;
+    nl->n_builds++;
+    nl->offset[0] = 0;
+    if (n == 0) return 0;
+
+    double lo[3], hi[3];
+    for (size_t a = 0; a < 3; a++) lo[a] = hi[a] = dyn_nl_coord(sys, 0, a);
+    for (size_t i = 0; i < n; i++) {
+        for (size_t a = 0; a < 3; a++) {
+            double x = dyn_nl_coord(sys, i, a);
+            nl->ref[3 * i + a] = x;
+            if (x < lo[a]) lo[a] = x;
+            if (x > hi[a]) hi[a] = x;
+        }
+    }
+
+    /* Cells no smaller than the list range, and no more than ~2 per particle. */
+    const double rlist = nl->cutoff + nl->skin, rlist2 = rlist * rlist;
+    double edge = rlist;
+    size_t nc[3], total;
+    for (;;) {
+        double cells = 1.0;
+        for (size_t a = 0; a < 3; a++) {
+            double c = floor((hi[a] - lo[a]) / edge);
+            nc[a] = c < 1.0 ? 1 : (size_t)c;
+            cells *= (double)nc[a];
+        }
+        if (cells <= 2.0 * (double)n + 64.0) {
+            total = nc[0] * nc[1] * nc[2];
+            break;
+        }
+        edge *= cbrt(cells / (2.0 * (double)n + 64.0)) * 1.01;
+    }
+    double inv_h[3];
+    for (size_t a = 0; a < 3; a++)
+        inv_h[a] = hi[a] > lo[a] ? (double)nc[a] / (hi[a] - lo[a]) : 0.0;
+
+    if (total > nl->cell_cap) {
+        size_t *head = realloc(nl->cell_head, total * sizeof(size_t));
+        if (!head) return -1;
+        nl->cell_head = head;
+        nl->cell_cap = total;
+    }
+    for (size_t c = 0; c < total; c++) nl->cell_head[c] = DYN_NL_NONE;
+
+    /* Insert in reverse so each cell chain is in ascending particle order. */
+    size_t *cell_of = nl->offset + 1; /* borrowed until the rows are written */
+    for (size_t i = n; i-- > 0;) {
+        size_t c = 0;
+        for (size_t a = 3; a-- > 0;) {
+            size_t k = (size_t)((nl->ref[3 * i + a] - lo[a]) * inv_h[a]);
+            if (k >= nc[a]) k = nc[a] - 1;
+            c = c * nc[a] + k;
+        }
+        cell_of[i] = c;
+        nl->cell_next[i] = nl->cell_head[c];
+        nl->cell_head[c] = i;
+    }
+
+    size_t k = 0;
+    for (size_t i = 0; i < n; i++) {
+        const size_t c = cell_of[i];
+        const size_t cx = c % nc[0], cy = (c / nc[0]) % nc[1], cz = c / (nc[0] * nc[1]);
+        const double *ri = &nl->ref[3 * i];
+        for (int dz = -1; dz <= 1; dz++) {
+            if ((dz < 0 && cz == 0) || (dz > 0 && cz + 1 >= nc[2])) continue;
+            for (int dy = -1; dy <= 1; dy++) {
+                if ((dy < 0 && cy == 0) || (dy > 0 && cy + 1 >= nc[1])) continue;
+                for (int dx = -1; dx <= 1; dx++) {
+                    if ((dx < 0 && cx == 0) || (dx > 0 && cx + 1 >= nc[0])) continue;
+                    size_t cc = ((cz + dz) * nc[1] + (cy + dy)) * nc[0] + (cx + dx);
+                    for (size_t j = nl->cell_head[cc]; j != DYN_NL_NONE; j = nl->cell_next[j]) {
+                        if (j <= i) continue;
+                        const double *rj = &nl->ref[3 * j];
+                        double d0 = rj[0] - ri[0], d1 = rj[1] - ri[1], d2 = rj[2] - ri[2];
+                        if (d0 * d0 + d1 * d1 + d2 * d2 >= rlist2) continue;
+                        if (dyn_nl_push(nl, k++, j) != 0) return -1;
+                    }
+                }
+            }
+        }
+        /* Row i ends here; cell_of[i] (aliasing offset[i + 1]) is no longer needed. */
+        nl->offset[i + 1] = k;
+    }
+    return 0;
+}
+
+int dyn_system_enable_neighbor_list(dyn_system_t *sys, double cutoff, double skin) {
+    if (!sys) return -1;
+    dyn_nl_free(sys->neighbors);
+    sys->neighbors = NULL;
+    if (cutoff <= 0.0) return 0;
+    if (skin < 0.0) return -1;
+
+    dyn_neighbor_list_t *nl = calloc(1, sizeof(*nl));
+    if (!nl) return -1;
+    nl->cutoff = cutoff;
+    nl->skin = skin;
+    sys->neighbors = nl;
+    if (dyn_nl_build(sys) != 0) {
+        dyn_nl_free(nl);
+        sys->neighbors = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+int dyn_system_update_neighbor_list(dyn_system_t *sys) {
+    if (!sys || !sys->neighbors) return -1;
+    dyn_neighbor_list_t *nl = sys->neighbors;
+    nl->n_updates++;
+
+    int rebuild = nl->n != sys->N;
+    const double lim2 = 0.25 * nl->skin * nl->skin;
+    for (size_t i = 0; !rebuild && i < sys->N; i++) {
+        double d2 = 0.0;
+        for (size_t a = 0; a < 3; a++) {
+            double d = dyn_nl_coord(sys, i, a) - nl->ref[3 * i + a];
+            d2 += d * d;
+        }
+        rebuild = d2 > lim2;
+    }
+    if (!rebuild) return 0;
+    return dyn_nl_build(sys) == 0 ? 1 : -1;
+}
+
+const size_t *dyn_system_neighbors(const dyn_system_t *sys, size_t i, size_t *count) {
+    if (count) *count = 0;
+    if (!sys || !sys->neighbors || i >= sys->neighbors->n) return NULL;
+    const dyn_neighbor_list_t *nl = sys->neighbors;
+    if (count) *count = nl->offset[i + 1] - nl->offset[i];
+    return nl->index + nl->offset[i];
+}
+
+long dyn_system_find_contacts(dyn_system_t *sys, dyn_contact_cb cb, void *userdata) {
+    if (!sys || !sys->neighbors) return -1;
+    if (dyn_system_update_neighbor_list(sys) < 0) return -1;
+
+    const dyn_neighbor_list_t *nl = sys->neighbors;
+    long contacts = 0;
+    for (size_t i = 0; i < sys->N; i++) {
+        const double ri = sys->particles[i].radius;
+        for (size_t k = nl->offset[i]; k < nl->offset[i + 1]; k++) {
+            const size_t j = nl->index[k];
+            double d2 = 0.0;
+            for (size_t a = 0; a < 3; a++) {
+                double d = dyn_nl_coord(sys, j, a) - dyn_nl_coord(sys, i, a);
+                d2 += d * d;
+            }
+            const double reach = ri + sys->particles[j].radius;
+            if (d2 >= reach * reach) continue;
+            contacts++;
+            if (cb) cb(sys, i, j, reach - sqrt(d2), userdata);
+        }
+    }
+    return contacts;
+}
@@ -0,0 +1,436 @@
+/* dynamics_tree.c - Barnes-Hut octree gravity for HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+   ----------------------------------------------------------------------
+   Tree-code gravity solver behind dyn_system_compute_pairwise_gravity().
+   - Octree over a private, interleaved copy of the particle positions
+   - Monopole or monopole + quadrupole cell moments
+   - Opening criterion s / d < theta, with softening from the system
+   - Topology reuse: when no particle drifted more than tree_rebuild_tol
+     leaf-cell sizes since the last build, only the moments are refitted
+     and the opening test is widened by the measured drift
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "core/phys/mech/classical/dynamics.h"
+#include "core/trace/trace.h"
+
+#define DYN_TREE_LEAF_SIZE 8    /* Max particles per leaf */
+#define DYN_TREE_MAX_DEPTH 48   /* Guard against coincident particles */
+
+typedef struct {
+    double center[3];   /* Geometric cell center */
+    double half;        /* Half edge length */
+    double mass;        /* Total mass */
+    double com[3];      /* Center of mass */
+    double quad[6];     /* Traceless quadrupole: xx, yy, zz, xy, xz, yz */
+    size_t first;       /* First slot in tree->index */
+    size_t count;       /* Number of particles below this node */
+    int child[8];       /* Child node indices, -1 if empty */
+    int leaf;           /* 1 if the node stores particles directly */
+} dyn_tree_node_t;
+
+typedef struct {
+    size_t n;           /* Particles in the tree */
+    double *pos;        /* Current positions, interleaved xyz (3 * n) */
+    double *ref;        /* Positions at the last full build (3 * n) */
+    double *mass;       /* Masses (n) */
+    double *phi;        /* Per-particle potential G m_i sum m_j / r (n) */
+    size_t *index;      /* Particle indices ordered by node */
+    size_t *scratch;    /* Partition buffer (n) */
+    dyn_tree_node_t *nodes;
+    size_t n_nodes;
+    size_t cap_nodes;
+    double min_leaf;    /* Smallest leaf edge length */
+    double drift;       /* Max displacement since the last build */
+} dyn_tree_t;
+
+static void dyn_tree_free(dyn_tree_t *tree) {
+    if (!tree) return;
+    free(tree->pos);
+    free(tree->ref);
+    free(tree->mass);
+    free(tree->phi);
+    free(tree->index);
+    free(tree->scratch);
+    free(tree->nodes);
+    free(tree);
+}
+
+static dyn_tree_t *dyn_tree_alloc(size_t n) {
+    dyn_tree_t *tree = calloc(1, sizeof(*tree));
+    if (!tree) return NULL;
+    tree->n = n;
+    tree->pos = malloc(3 * n * sizeof(double));
+    tree->ref = malloc(3 * n * sizeof(double));
+    tree->mass = malloc(n * sizeof(double));
+    tree->phi = malloc(n * sizeof(double));
+    tree->index = malloc(n * sizeof(size_t));
+    tree->scratch = malloc(n * sizeof(size_t));
+    if (!tree->pos || !tree->ref || !tree->mass || !tree->phi || !tree->index || !tree->scratch) {
+        dyn_tree_free(tree);
+        return NULL;
+    }
+    return tree;
+}
+
+/* Copy positions and masses out of the system (works for both layouts). */
+static void dyn_tree_gather(dyn_tree_t *tree, const dyn_system_t *sys) {
+    for (size_t i = 0; i < sys->N; i++) {
+        const gsl_vector *x = sys->particles[i].pos;
+        for (size_t a = 0; a < 3; a++)
+            tree->pos[3 * i + a] = x->data[a * x->stride];
+        tree->mass[i] = sys->layout == DYN_LAYOUT_SOA ? sys->soa->mass[i]
+                                                      : sys->particles[i].mass;
+    }
+}
+
+static int dyn_tree_push_node(dyn_tree_t *tree) {
+    if (tree->n_nodes == tree->cap_nodes) {
+        size_t cap = tree->cap_nodes ? 2 * tree->cap_nodes : 64;
+        dyn_tree_node_t *nodes = realloc(tree->nodes, cap * sizeof(dyn_tree_node_t));
+        if (!nodes) return -1;
+        tree->nodes = nodes;
+        tree->cap_nodes = cap;
+    }
+    dyn_tree_node_t *node = &tree->nodes[tree->n_nodes];
+    memset(node, 0, sizeof(*node));
+    for (int c = 0; c < 8; c++) node->child[c] = -1;
+    return (int)tree->n_nodes++;
+}
+
+static int dyn_tree_octant(const double *x, const double *center) {
+    return (x[0] > center[0]) | ((x[1] > center[1]) << 1) | ((x[2] > center[2]) << 2);
+}
+
+/* Build the subtree for index[first, first + count); returns the node index or -1. */
+static int dyn_tree_build_node(dyn_tree_t *tree, size_t first, size_t count,
+                               const double center[3], double half, int depth) {
+    int id = dyn_tree_push_node(tree);
+    if (id < 0) return -1;
+    dyn_tree_node_t *node = &tree->nodes[id];
+    memcpy(node->center, center, sizeof(node->center));
+    node->half = half;
+    node->first = first;
+    node->count = count;
+
+    if (count <= DYN_TREE_LEAF_SIZE || depth >= DYN_TREE_MAX_DEPTH) {
+        node->leaf = 1;
+        if (2.0 * half < tree->min_leaf) tree->min_leaf = 2.0 * half;
+        return id;
+    }
+
+    /* Counting sort of the range by octant. */
+    size_t counts[8] = {0}, offsets[8];
+    for (size_t k = first; k < first + count; k++)
+        counts[dyn_tree_octant(&tree->pos[3 * tree->index[k]], center)]++;
+    offsets[0] = 0;
+    for (int c = 1; c < 8; c++) offsets[c] = offsets[c - 1] + counts[c - 1];
+    for (size_t k = first; k < first + count; k++) {
+        size_t i = tree->index[k];
+        tree->scratch[first + offsets[dyn_tree_octant(&tree->pos[3 * i], center)]++] = i;
+    }
+    memcpy(tree->index + first, tree->scratch + first, count * sizeof(size_t));
+
+    size_t start = first;
+    for (int c = 0; c < 8; c++) {
+        if (counts[c] == 0) continue;
+        double cc[3];
+        for (int a = 0; a < 3; a++)
+            cc[a] = center[a] + ((c >> a) & 1 ? 0.5 : -0.5) * half;
+        int child = dyn_tree_build_node(tree, start, counts[c], cc, 0.5 * half, depth + 1);
+        if (child < 0) return -1;
+        tree->nodes[id].child[c] = child;
+        start += counts[c];
+    }
+    return id;
+}
+
+/* Accumulate mass, center of mass and quadrupole bottom-up from current positions. */
+static void dyn_tree_moments(dyn_tree_t *tree, int id, int with_quad) {
+    dyn_tree_node_t *node = &tree->nodes[id];
+    double m = 0.0, c[3] = {0.0, 0.0, 0.0};
+
+    if (node->leaf) {
+        for (size_t k = node->first; k < node->first + node->count; k++) {
+            size_t i = tree->index[k];
+            m += tree->mass[i];
+            for (int a = 0; a < 3; a++) c[a] += tree->mass[i] * tree->pos[3 * i + a];
+        }
+    } else {
+        for (int ch = 0; ch < 8; ch++) {
+            if (node->child[ch] < 0) continue;
+            dyn_tree_moments(tree, node->child[ch], with_quad);
+            const dyn_tree_node_t *sub = &tree->nodes[node->child[ch]];
+            m += sub->mass;
+            for (int a = 0; a < 3; a++) c[a] += sub->mass * sub->com[a];
+        }
+    }
+
+    node = &tree->nodes[id];
+    node->mass = m;
+    for (int a = 0; a < 3; a++)
+        node->com[a] = m > 0.0 ? c[a] / m : node->center[a];
+    memset(node->quad, 0, sizeof(node->quad));
+    if (!with_quad) return;
+
+    /* Q_ab = sum m (3 d_a d_b - d^2 delta_ab), shifted from children by the parallel-axis rule. */
+    if (node->leaf) {
+        for (size_t k = node->first; k < node->first + node->count; k++) {
+            size_t i = tree->index[k];
+            double d[3];
+            for (int a = 0; a < 3; a++) d[a] = tree->pos[3 * i + a] - node->com[a];
+            double d2 = d[0] * d[0] + d[1] * d[1] + d[2] * d[2], mi = tree->mass[i];
+            node->quad[0] += mi * (3.0 * d[0] * d[0] - d2);
+            node->quad[1] += mi * (3.0 * d[1] * d[1] - d2);
+            node->quad[2] += mi * (3.0 * d[2] * d[2] - d2);
+            node->quad[3] += mi * 3.0 * d[0] * d[1];
+            node->quad[4] += mi * 3.0 * d[0] * d[2];
+            node->quad[5] += mi * 3.0 * d[1] * d[2];
+        }
+        return;
+    }
+    for (int ch = 0; ch < 8; ch++) {
+        if (node->child[ch] < 0) continue;
+        const dyn_tree_node_t *sub = &tree->nodes[node->child[ch]];
+        double d[3];
+        for (int a = 0; a < 3; a++) d[a] = sub->com[a] - node->com[a];
+        double d2 = d[0] * d[0] + d[1] * d[1] + d[2] * d[2], ms = sub->mass;
+        node->quad[0] += sub->quad[0] + ms * (3.0 * d[0] * d[0] - d2);
+        node->quad[1] += sub->quad[1] + ms * (3.0 * d[1] * d[1] - d2);
+        node->quad[2] += sub->quad[2] + ms * (3.0 * d[2] * d[2] - d2);
+        node->quad[3] += sub->quad[3] + ms * 3.0 * d[0] * d[1];
+        node->quad[4] += sub->quad[4] + ms * 3.0 * d[0] * d[2];
+        node->quad[5] += sub->quad[5] + ms * 3.0 * d[1] * d[2];
+    }
+}
+
+static int dyn_tree_build(dyn_tree_t *tree) {
+    HOLOS_TRACE_ZONE("dyn_tree_build");
+    double lo[3], hi[3];
+    for (int a = 0; a < 3; a++) lo[a] = hi[a] = tree->pos[a];
+    for (size_t i = 0; i < tree->n; i++) {
+        tree->index[i] = i;
+        for (int a = 0; a < 3; a++) {
+            double x = tree->pos[3 * i + a];
+            if (x < lo[a]) lo[a] = x;
+            if (x > hi[a]) hi[a] = x;
+        }
+    }
+
+    double center[3], half = 0.0;
+    for (int a = 0; a < 3; a++) {
+        center[a] = 0.5 * (lo[a] + hi[a]);
+        if (0.5 * (hi[a] - lo[a]) > half) half = 0.5 * (hi[a] - lo[a]);
+    }
+    half = half > 0.0 ? half * (1.0 + 1e-9) : 1.0;
+
+    tree->n_nodes = 0;
+    tree->min_leaf = HUGE_VAL;
+    tree->drift = 0.0;
+    if (dyn_tree_build_node(tree, 0, tree->n, center, half, 0) < 0) return -1;
+    memcpy(tree->ref, tree->pos, 3 * tree->n * sizeof(double));
+    return 0;
+}
+
+/* Largest coordinate displacement of any particle since the last build. */
+static double dyn_tree_max_drift(const dyn_tree_t *tree) {
+    double drift = 0.0;
+    for (size_t k = 0; k < 3 * tree->n; k++) {
+        double d = fabs(tree->pos[k] - tree->ref[k]);
+        if (d > drift) drift = d;
+    }
+    return drift;
+}
+
+/* Acceleration (and potential sum M / r, positive) on a test point xi
+   (particle self excluded) by tree walk. */
+static void dyn_tree_accel(const dyn_tree_t *tree, size_t self, double theta2, double eps2,
+                           int with_quad, int *stack, double acc[3], double *phi) {
+    const double *xi = &tree->pos[3 * self];
+    int top = 0;
+    stack[top++] = 0;
+    acc[0] = acc[1] = acc[2] = 0.0;
+    *phi = 0.0;
+
+    while (top > 0) {
+        const dyn_tree_node_t *node = &tree->nodes[stack[--top]];
+        if (node->mass == 0.0) continue;
+
+        double d[3], r2 = 0.0;
+        for (int a = 0; a < 3; a++) {
+            d[a] = node->com[a] - xi[a];
+            r2 += d[a] * d[a];
+        }
+
+        /* Cell size widened by the drift since build; never approximate a cell containing xi. */
+        double s = 2.0 * (node->half + tree->drift), reach = node->half + tree->drift;
+        int inside = fabs(xi[0] - node->center[0]) <= reach &&
+                     fabs(xi[1] - node->center[1]) <= reach &&
+                     fabs(xi[2] - node->center[2]) <= reach;
+
+        if (!inside && s * s < theta2 * r2) {
+            double r2s = r2 + eps2, inv_r = 1.0 / sqrt(r2s), inv_r3 = inv_r * inv_r * inv_r;
+            for (int a = 0; a < 3; a++) acc[a] += node->mass * d[a] * inv_r3;
+            *phi += node->mass * inv_r;
+            if (with_quad) {
+                const double *q = node->quad;
+                double Qd[3] = {
+                    q[0] * d[0] + q[3] * d[1] + q[4] * d[2],
+                    q[3] * d[0] + q[1] * d[1] + q[5] * d[2],
+                    q[4] * d[0] + q[5] * d[1] + q[2] * d[2]
+                };
+                double dQd = d[0] * Qd[0] + d[1] * Qd[1] + d[2] * Qd[2];
+                double inv_r5 = inv_r3 * inv_r * inv_r, inv_r7 = inv_r5 * inv_r * inv_r;
+                for (int a = 0; a < 3; a++)
+                    acc[a] -= Qd[a] * inv_r5 - 2.5 * dQd * d[a] * inv_r7;
+                *phi += 0.5 * dQd * inv_r5;
+            }
+        } else if (node->leaf) {
+            for (size_t k = node->first; k < node->first + node->count; k++) {
+                size_t j = tree->index[k];
+                if (j == self) continue;
+                double dj[3], rj2 = eps2;
+                for (int a = 0; a < 3; a++) {
+                    dj[a] = tree->pos[3 * j + a] - xi[a];
+                    rj2 += dj[a] * dj[a];
+                }
+                if (rj2 == 0.0) continue;
+                double inv_r = 1.0 / sqrt(rj2), w = tree->mass[j] * inv_r * inv_r * inv_r;
+                for (int a = 0; a < 3; a++) acc[a] += w * dj[a];
+                *phi += tree->mass[j] * inv_r;
+            }
+        } else {
+            for (int c = 0; c < 8; c++)
+                if (node->child[c] >= 0) stack[top++] = node->child[c];
+        }
+    }
+}
+
+int dyn_system_set_gravity_solver(dyn_system_t *sys, dyn_gravity_solver_t solver, double theta) {
+    if (!sys) return -1;
+    if (solver != DYN_GRAVITY_DIRECT && !(theta > 0.0)) return -1;
+    sys->gravity_solver = solver;
+    if (solver != DYN_GRAVITY_DIRECT) sys->tree_theta = theta;
+    dyn_system_reset_tree(sys);
+    return 0;
+}
+
+void dyn_system_set_tree_rebuild_tolerance(dyn_system_t *sys, double tol) {
+    if (sys) sys->tree_rebuild_tol = tol > 0.0 ? tol : 0.0;
+}
+
+void dyn_system_reset_tree(dyn_system_t *sys) {
+    if (!sys) return;
+    dyn_tree_free(sys->gravity_tree);
+    sys->gravity_tree = NULL;
+}
+
+/* Build or refit the cached tree for the current positions. */
+static dyn_tree_t *dyn_tree_prepare(dyn_system_t *sys) {
+    dyn_tree_t *tree = sys->gravity_tree;
+    if (tree && tree->n != sys->N) {
+        dyn_system_reset_tree(sys);
+        tree = NULL;
+    }
+    int rebuild = tree == NULL;
+    if (!tree) {
+        tree = dyn_tree_alloc(sys->N);
+        if (!tree) return NULL;
+        sys->gravity_tree = tree;
+    }
+    dyn_tree_gather(tree, sys);
+
+    if (!rebuild) {
+        tree->drift = dyn_tree_max_drift(tree);
+        rebuild = sys->tree_rebuild_tol <= 0.0 ||
+                  tree->drift > sys->tree_rebuild_tol * tree->min_leaf;
+    }
+    if (rebuild && dyn_tree_build(tree) != 0) {
+        dyn_system_reset_tree(sys);
+        return NULL;
+    }
+    dyn_tree_moments(tree, 0, sys->gravity_solver == DYN_GRAVITY_BARNES_HUT_QUAD);
+    return tree;
+}
+
+/* Walk the tree for targets active[0..n) (or every particle when active is NULL). */
+static int dyn_tree_forces(dyn_system_t *sys, dyn_tree_t *tree,
+                           const size_t *active, size_t n) {
+    /* Each walk reads the shared tree and writes only its own particle, so
+       the traversal is split over threads without changing any result. */
+    const int with_quad = sys->gravity_solver == DYN_GRAVITY_BARNES_HUT_QUAD;
+    const double theta2 = sys->tree_theta * sys->tree_theta;
+    const double eps2 = sys->use_softening ? sys->softening_eps * sys->softening_eps : 0.0;
+    const int nt = sys->n_threads > 0 ? sys->n_threads : 1;
+    int err = 0;
+
+    #pragma omp parallel num_threads(nt) if(nt > 1)
+    {
+        int *stack = malloc((8 * DYN_TREE_MAX_DEPTH + 8) * sizeof(int));
+        if (!stack) {
+            #pragma omp atomic write
+            err = 1;
+        }
+        #pragma omp for schedule(dynamic, 64)
+        for (size_t k = 0; k < n; k++) {
+            if (!stack) continue;
+            const size_t i = active ? active[k] : k;
+            double acc[3], phi;
+            dyn_tree_accel(tree, i, theta2, eps2, with_quad, stack, acc, &phi);
+            gsl_vector *f = sys->particles[i].force;
+            double gm = sys->G * tree->mass[i];
+            for (size_t a = 0; a < 3; a++)
+                f->data[a * f->stride] += gm * acc[a];
+            tree->phi[i] = gm * phi;
+        }
+        free(stack);
+    }
+    if (err) return -1;
+
+    /* Potential of a full evaluation, reduced in index order. */
+    if (!active && (sys->diag_mask & DYN_DIAG_POTENTIAL)) {
+        double u = 0.0;
+        for (size_t i = 0; i < n; i++) u += tree->phi[i];
+        sys->diag.potential = -0.5 * u;
+    }
+    return 0;
+}
+
+int dyn_system_compute_tree_gravity(dyn_system_t *sys) {
+    if (!sys) return -1;
+    if (sys->N < 2) return 0;
+    dyn_tree_t *tree = dyn_tree_prepare(sys);
+    if (!tree) return -1;
+    return dyn_tree_forces(sys, tree, NULL, sys->N);
+}
+
+int dyn_system_compute_tree_gravity_active(dyn_system_t *sys, const size_t *active, size_t n_active) {
+    if (!sys || (n_active && !active)) return -1;
+    for (size_t k = 0; k < n_active; k++) {
+        gsl_vector *f = sys->particles[active[k]].force;
+        for (size_t a = 0; a < 3; a++) f->data[a * f->stride] = 0.0;
+    }
+    if (sys->N < 2 || n_active == 0) return 0;
+    dyn_tree_t *tree = dyn_tree_prepare(sys);
+    if (!tree) return -1;
+    return dyn_tree_forces(sys, tree, active, n_active);
+}
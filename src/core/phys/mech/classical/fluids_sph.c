@@ -0,0 +1,413 @@
+/* fluids_sph.c - Smoothed-particle hydrodynamics for HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+   ----------------------------------------------------------------------
+   Weakly compressible SPH engine behind fluid_sph_* (fluids.h).
+   - Compact spatial hash: cells of edge 2h hashed into a table of at
+     least n buckets, particles counting-sorted by bucket every update and
+     the state reordered to match, so memory is O(n) however far the
+     fluid spreads and neighbors are contiguous
+   - Cells sharing a bucket are told apart by a packed cell key per slot
+   - Cubic spline kernel written branch-free (fmax) so the bucket loops
+     vectorize; Tait pressure, Morris laminar viscosity
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include <gsl/gsl_vector.h>
+
+#include "core/phys/mech/classical/fluids.h"
+#include "core/trace/trace.h"
+
+#define FLUID_SPH_CHUNK 512         /* Particles per dynamic work item */
+
+/* 21 bits per axis: cells up to 2^21 apart never alias among 27 neighbors. */
+static inline uint64_t fluid_sph_cell_key(long ix, long iy, long iz) {
+    return ((uint64_t)ix & 0x1FFFFF) | (((uint64_t)iy & 0x1FFFFF) << 21) | (((uint64_t)iz & 0x1FFFFF) << 42);
+}
+
+/* Spatial hash of Teschner et al. (2003). */
+static inline size_t fluid_sph_hash(long ix, long iy, long iz, size_t mask) {
+    const uint64_t h = ((uint64_t)ix * 73856093u) ^ ((uint64_t)iy * 19349663u) ^ ((uint64_t)iz * 83492791u);
+    return (size_t)h & mask;
+}
+
+static inline long fluid_sph_cell_coord(double x, double inv_cell) {
+    return (long)floor(x * inv_cell);
+}
+
+static int fluid_sph_threads(const fluid_sph *s) {
+    return s->n_threads > 0 ? s->n_threads : 1;
+}
+
+fluid_sph *fluid_sph_alloc(size_t n, const fluid_sph_params *prm) {
+    if (!prm || !(prm->h > 0.0) || !(prm->volume > 0.0) || !(prm->rho0 > 0.0) ||
+        !(prm->c0 > 0.0) || !(prm->gamma > 0.0))
+        return NULL;
+    fluid_sph *s = calloc(1, sizeof(*s));
+    if (!s) return NULL;
+    s->n = n;
+    s->prm = *prm;
+    s->n_buckets = 1;
+    while (s->n_buckets < n) s->n_buckets <<= 1;
+
+    const size_t m = n ? n : 1;
+    s->x = calloc(m, sizeof(double));
+    s->y = calloc(m, sizeof(double));
+    s->z = calloc(m, sizeof(double));
+    s->vx = calloc(m, sizeof(double));
+    s->vy = calloc(m, sizeof(double));
+    s->vz = calloc(m, sizeof(double));
+    s->ax = calloc(m, sizeof(double));
+    s->ay = calloc(m, sizeof(double));
+    s->az = calloc(m, sizeof(double));
+    s->rho = calloc(m, sizeof(double));
+    s->p = calloc(m, sizeof(double));
+    s->m = calloc(m, sizeof(double));
+    s->mu = calloc(m, sizeof(double));
+    s->fixed = calloc(m, 1);
+    s->id = malloc(m * sizeof(size_t));
+    s->cell = calloc(m, sizeof(uint64_t));
+    s->bucket = calloc(s->n_buckets + 1, sizeof(size_t));
+    s->order = malloc(m * sizeof(size_t));
+    s->scratch = malloc(m * sizeof(double));
+    if (!s->x || !s->y || !s->z || !s->vx || !s->vy || !s->vz || !s->ax || !s->ay || !s->az ||
+        !s->rho || !s->p || !s->m || !s->mu || !s->fixed || !s->id || !s->cell || !s->bucket ||
+        !s->order || !s->scratch) {
+        fluid_sph_free(s);
+        return NULL;
+    }
+    for (size_t i = 0; i < n; i++) {
+        s->id[i] = i;
+        s->rho[i] = prm->rho0;
+        s->m[i] = prm->rho0 * prm->volume;
+    }
+    return s;
+}
+
+void fluid_sph_free(fluid_sph *s) {
+    if (!s) return;
+    free(s->x);
+    free(s->y);
+    free(s->z);
+    free(s->vx);
+    free(s->vy);
+    free(s->vz);
+    free(s->ax);
+    free(s->ay);
+    free(s->az);
+    free(s->rho);
+    free(s->p);
+    free(s->m);
+    free(s->mu);
+    free(s->fixed);
+    free(s->id);
+    free(s->cell);
+    free(s->bucket);
+    free(s->order);
+    free(s->scratch);
+    free(s);
+}
+
+int fluid_sph_set_threads(fluid_sph *s, int n_threads) {
+    if (!s) return -1;
+    if (n_threads < 0) {
+#ifdef _OPENMP
+        n_threads = omp_get_max_threads();
+#else
+        n_threads = 1;
+#endif
+    }
+    s->n_threads = n_threads;
+    return n_threads;
+}
+
+int fluid_sph_gather(fluid_sph *s, const fluid_system *sys, const double *pos) {
+    if (!s || !sys || !pos || sys->n != s->n) return -1;
+    for (size_t i = 0; i < s->n; i++) {
+        const fluid_element *e = &sys->elems[i];
+        double v[3] = { 0.0, 0.0, 0.0 };
+        if (e->v)
+            for (size_t a = 0; a < e->v->size && a < 3; a++) v[a] = gsl_vector_get(e->v, a);
+        const double rho = e->rho > 0.0 ? e->rho : s->prm.rho0;
+        s->id[i] = i;
+        s->x[i] = pos[3 * i];
+        s->y[i] = pos[3 * i + 1];
+        s->z[i] = pos[3 * i + 2];
+        s->vx[i] = v[0];
+        s->vy[i] = v[1];
+        s->vz[i] = v[2];
+        s->ax[i] = s->ay[i] = s->az[i] = 0.0;
+        s->rho[i] = rho;
+        s->p[i] = e->p;
+        s->m[i] = rho * s->prm.volume;
+        s->mu[i] = e->mu;
+        s->fixed[i] = e->fixed ? 1 : 0;
+    }
+    return 0;
+}
+
+int fluid_sph_scatter(const fluid_sph *s, fluid_system *sys, double *pos) {
+    if (!s || !sys || sys->n != s->n) return -1;
+    for (size_t k = 0; k < s->n; k++) {
+        const size_t i = s->id[k];
+        fluid_element *e = &sys->elems[i];
+        e->rho = s->rho[k];
+        e->p = s->p[k];
+        if (e->v) {
+            const double v[3] = { s->vx[k], s->vy[k], s->vz[k] };
+            for (size_t a = 0; a < e->v->size && a < 3; a++) gsl_vector_set(e->v, a, v[a]);
+        }
+        if (pos) {
+            pos[3 * i] = s->x[k];
+            pos[3 * i + 1] = s->y[k];
+            pos[3 * i + 2] = s->z[k];
+        }
+    }
+    return 0;
+}
+
+/* -------------------------------
+   Spatial hash
+   ------------------------------- */
+
+/* a[dest[k]] = a[k] through the scratch buffer. */
+static void fluid_sph_permute(fluid_sph *s, double *a) {
+    const size_t n = s->n, *dest = s->order;
+    double *tmp = s->scratch;
+    const int nt = fluid_sph_threads(s);
+    #pragma omp parallel for schedule(static) num_threads(nt) if(nt > 1)
+    for (size_t k = 0; k < n; k++) tmp[dest[k]] = a[k];
+    memcpy(a, tmp, n * sizeof(double));
+}
+
+/* Sort slots by bucket (stable, so equal buckets keep their last order)
+   and reorder the particle state to match. */
+static int fluid_sph_build_hash(fluid_sph *s) {
+    const size_t n = s->n, mask = s->n_buckets - 1;
+    const double inv_cell = 0.5 / s->prm.h;
+    size_t *bucket = s->bucket, *dest = s->order;
+    const int nt = fluid_sph_threads(s);
+
+    #pragma omp parallel for schedule(static) num_threads(nt) if(nt > 1)
+    for (size_t k = 0; k < n; k++)
+        dest[k] = fluid_sph_hash(fluid_sph_cell_coord(s->x[k], inv_cell), fluid_sph_cell_coord(s->y[k], inv_cell),
+                                 fluid_sph_cell_coord(s->z[k], inv_cell), mask);
+
+    memset(bucket, 0, (s->n_buckets + 1) * sizeof(size_t));
+    for (size_t k = 0; k < n; k++) bucket[dest[k] + 1]++;
+    for (size_t b = 0; b < s->n_buckets; b++) bucket[b + 1] += bucket[b];
+    /* dest[k] becomes the new slot of k; bucket[b] runs to the end of b. */
+    for (size_t k = 0; k < n; k++) dest[k] = bucket[dest[k]]++;
+    for (size_t b = s->n_buckets; b > 0; b--) bucket[b] = bucket[b - 1];
+    bucket[0] = 0;
+
+    fluid_sph_permute(s, s->x);
+    fluid_sph_permute(s, s->y);
+    fluid_sph_permute(s, s->z);
+    fluid_sph_permute(s, s->vx);
+    fluid_sph_permute(s, s->vy);
+    fluid_sph_permute(s, s->vz);
+    fluid_sph_permute(s, s->rho);
+    fluid_sph_permute(s, s->m);
+    fluid_sph_permute(s, s->mu);
+
+    /* Slot ids and flags go through the same scratch block. */
+    size_t *id = (size_t *)s->scratch;
+    for (size_t k = 0; k < n; k++) id[dest[k]] = s->id[k];
+    memcpy(s->id, id, n * sizeof(size_t));
+    unsigned char *fixed = (unsigned char *)s->scratch;
+    for (size_t k = 0; k < n; k++) fixed[dest[k]] = s->fixed[k];
+    memcpy(s->fixed, fixed, n);
+
+    #pragma omp parallel for schedule(static) num_threads(nt) if(nt > 1)
+    for (size_t k = 0; k < n; k++)
+        s->cell[k] = fluid_sph_cell_key(fluid_sph_cell_coord(s->x[k], inv_cell),
+                                        fluid_sph_cell_coord(s->y[k], inv_cell),
+                                        fluid_sph_cell_coord(s->z[k], inv_cell));
+    return 0;
+}
+
+/* -------------------------------
+   Kernel sums
+   ------------------------------- */
+
+/* Density at slot i: sum over the 27 cells around it of m_j W(r_ij). */
+static double fluid_sph_density_at(const fluid_sph *s, size_t i, size_t *pairs) {
+    const double h = s->prm.h, inv_h = 1.0 / h, r2max = 4.0 * h * h, inv_cell = 0.5 * inv_h;
+    const double *restrict x = s->x, *restrict y = s->y, *restrict z = s->z, *restrict m = s->m;
+    const uint64_t *restrict cell = s->cell;
+    const double xi = x[i], yi = y[i], zi = z[i];
+    const long cx = fluid_sph_cell_coord(xi, inv_cell), cy = fluid_sph_cell_coord(yi, inv_cell),
+               cz = fluid_sph_cell_coord(zi, inv_cell);
+    const size_t mask = s->n_buckets - 1;
+    double sum = 0.0;
+    size_t count = 0;
+
+    for (long dz = -1; dz <= 1; dz++)
+        for (long dy = -1; dy <= 1; dy++)
+            for (long dx = -1; dx <= 1; dx++) {
+                const uint64_t key = fluid_sph_cell_key(cx + dx, cy + dy, cz + dz);
+                const size_t b = fluid_sph_hash(cx + dx, cy + dy, cz + dz, mask);
+                const size_t j0 = s->bucket[b], j1 = s->bucket[b + 1];
+                #pragma omp simd reduction(+:sum, count)
+                for (size_t j = j0; j < j1; j++) {
+                    const double rx = xi - x[j], ry = yi - y[j], rz = zi - z[j];
+                    const double r2 = rx * rx + ry * ry + rz * rz;
+                    const int in = cell[j] == key && r2 < r2max;
+                    const double q = sqrt(r2) * inv_h;
+                    const double a = fmax(2.0 - q, 0.0), c = fmax(1.0 - q, 0.0);
+                    sum += in ? m[j] * (0.25 * a * a * a - c * c * c) : 0.0;
+                    count += (size_t)(in && r2 > 0.0);
+                }
+            }
+    *pairs += count;
+    return sum * (M_1_PI * inv_h * inv_h * inv_h);
+}
+
+/* Pressure and viscous acceleration at slot i; pr[j] = p_j / rho_j^2. */
+static void fluid_sph_accel_at(const fluid_sph *s, const double *restrict pr, size_t i, double acc[3]) {
+    const double h = s->prm.h, inv_h = 1.0 / h, r2max = 4.0 * h * h, inv_cell = 0.5 * inv_h;
+    const double eta2 = 0.01 * h * h, dsig = M_1_PI * inv_h * inv_h * inv_h * inv_h;
+    const double *restrict x = s->x, *restrict y = s->y, *restrict z = s->z;
+    const double *restrict vx = s->vx, *restrict vy = s->vy, *restrict vz = s->vz;
+    const double *restrict m = s->m, *restrict rho = s->rho, *restrict mu = s->mu;
+    const uint64_t *restrict cell = s->cell;
+    const double xi = x[i], yi = y[i], zi = z[i], vxi = vx[i], vyi = vy[i], vzi = vz[i];
+    const double pri = pr[i], mui = mu[i], inv_rhoi = 1.0 / rho[i];
+    const long cx = fluid_sph_cell_coord(xi, inv_cell), cy = fluid_sph_cell_coord(yi, inv_cell),
+               cz = fluid_sph_cell_coord(zi, inv_cell);
+    const size_t mask = s->n_buckets - 1;
+    double sx = 0.0, sy = 0.0, sz = 0.0;
+
+    for (long dz = -1; dz <= 1; dz++)
+        for (long dy = -1; dy <= 1; dy++)
+            for (long dx = -1; dx <= 1; dx++) {
+                const uint64_t key = fluid_sph_cell_key(cx + dx, cy + dy, cz + dz);
+                const size_t b = fluid_sph_hash(cx + dx, cy + dy, cz + dz, mask);
+                const size_t j0 = s->bucket[b], j1 = s->bucket[b + 1];
+                #pragma omp simd reduction(+:sx, sy, sz)
+                for (size_t j = j0; j < j1; j++) {
+                    const double rx = xi - x[j], ry = yi - y[j], rz = zi - z[j];
+                    const double r2 = rx * rx + ry * ry + rz * rz;
+                    const int in = cell[j] == key && r2 < r2max && r2 > 0.0;
+                    const double r = sqrt(r2), q = r * inv_h;
+                    const double a = fmax(2.0 - q, 0.0), c = fmax(1.0 - q, 0.0);
+                    const double dw = in ? dsig * (3.0 * c * c - 0.75 * a * a) : 0.0;      /* dW/dr */
+                    /* grad_i W = dW/dr r_ij / r; masked lanes have dw = 0 */
+                    const double fp = -m[j] * (pri + pr[j]) * dw / fmax(r, DBL_MIN);
+                    const double fv = m[j] * (mui + mu[j]) * inv_rhoi / rho[j] * dw * r / (r2 + eta2);
+                    sx += fp * rx + fv * (vxi - vx[j]);
+                    sy += fp * ry + fv * (vyi - vy[j]);
+                    sz += fp * rz + fv * (vzi - vz[j]);
+                }
+            }
+    acc[0] = sx;
+    acc[1] = sy;
+    acc[2] = sz;
+}
+
+/* -------------------------------
+   Passes
+   ------------------------------- */
+
+int fluid_sph_update(fluid_sph *s) {
+    if (!s) return -1;
+    const size_t n = s->n;
+    s->n_pairs = 0;
+    if (n == 0) return 0;
+    if (fluid_sph_build_hash(s) != 0) return -1;
+
+    const int nt = fluid_sph_threads(s);
+    const double rho0 = s->prm.rho0, gam = s->prm.gamma, B = rho0 * s->prm.c0 * s->prm.c0 / gam;
+    double *pr = s->scratch;
+    size_t pairs = 0;
+
+    #pragma omp parallel for schedule(dynamic, FLUID_SPH_CHUNK) reduction(+:pairs) num_threads(nt) if(nt > 1)
+    for (size_t i = 0; i < n; i++) {
+        const double rho = fluid_sph_density_at(s, i, &pairs);
+        const double p = B * (pow(rho / rho0, gam) - 1.0);
+        s->rho[i] = rho;
+        s->p[i] = p > 0.0 ? p : 0.0;
+        pr[i] = s->p[i] / (rho * rho);
+    }
+    s->n_pairs = pairs;
+
+    const double g0 = s->prm.g[0], g1 = s->prm.g[1], g2 = s->prm.g[2];
+    #pragma omp parallel for schedule(dynamic, FLUID_SPH_CHUNK) num_threads(nt) if(nt > 1)
+    for (size_t i = 0; i < n; i++) {
+        double acc[3] = { 0.0, 0.0, 0.0 };
+        if (!s->fixed[i]) {
+            fluid_sph_accel_at(s, pr, i, acc);
+            acc[0] += g0;
+            acc[1] += g1;
+            acc[2] += g2;
+        }
+        s->ax[i] = acc[0];
+        s->ay[i] = acc[1];
+        s->az[i] = acc[2];
+    }
+    return 0;
+}
+
+int fluid_sph_step(fluid_sph *s, double dt) {
+    HOLOS_TRACE_ZONE("fluid_sph_step");
+    if (!s || !(dt > 0.0)) return -1;
+    if (fluid_sph_update(s) != 0) return -1;
+    const int nt = fluid_sph_threads(s);
+    const size_t n = s->n;
+    double *restrict x = s->x, *restrict y = s->y, *restrict z = s->z;
+    double *restrict vx = s->vx, *restrict vy = s->vy, *restrict vz = s->vz;
+    const double *restrict ax = s->ax, *restrict ay = s->ay, *restrict az = s->az;
+    const unsigned char *restrict fixed = s->fixed;
+
+    #pragma omp parallel for simd schedule(static) num_threads(nt) if(nt > 1)
+    for (size_t i = 0; i < n; i++) {
+        const double w = fixed[i] ? 0.0 : dt;
+        vx[i] += w * ax[i];
+        vy[i] += w * ay[i];
+        vz[i] += w * az[i];
+        x[i] += w * vx[i];
+        y[i] += w * vy[i];
+        z[i] += w * vz[i];
+    }
+    return 0;
+}
+
+double fluid_sph_max_dt(const fluid_sph *s) {
+    if (!s) return 0.0;
+    const double h = s->prm.h;
+    double v2 = 0.0, a2 = 0.0, mu = 0.0;
+    for (size_t i = 0; i < s->n; i++) {
+        if (s->fixed[i]) continue;
+        const double vv = s->vx[i] * s->vx[i] + s->vy[i] * s->vy[i] + s->vz[i] * s->vz[i];
+        const double aa = s->ax[i] * s->ax[i] + s->ay[i] * s->ay[i] + s->az[i] * s->az[i];
+        if (vv > v2) v2 = vv;
+        if (aa > a2) a2 = aa;
+        if (s->mu[i] > mu) mu = s->mu[i];
+    }
+    double dt = 0.25 * h / (s->prm.c0 + sqrt(v2));
+    if (a2 > 0.0) dt = fmin(dt, 0.25 * sqrt(h / sqrt(a2)));
+    if (mu > 0.0) dt = fmin(dt, 0.125 * h * h * s->prm.rho0 / mu);
+    return dt;
+}
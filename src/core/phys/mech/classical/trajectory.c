@@ -0,0 +1,360 @@
+/* trajectory.c - Memory-mapped binary trajectories for HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "core/phys/mech/classical/trajectory.h"
+#include "core/phys/mech/classical/dynamics_gpu.h"
+
+static const char dyn_traj_magic[8] = { 'H', 'O', 'L', 'O', 'S', 'T', 'R', 'J' };
+
+#define DYN_TRAJ_ALIGN 4096u
+
+static uint64_t dyn_traj_round_up(uint64_t x, uint64_t a) {
+    return (x + a - 1) / a * a;
+}
+
+/* Number of 3N-double blocks in a frame. */
+static size_t dyn_traj_blocks(uint32_t fields) {
+    return 1 + !!(fields & DYN_TRAJ_VEL) + !!(fields & DYN_TRAJ_FORCE);
+}
+
+static uint64_t dyn_traj_index_size(const dyn_traj_header_t *h) {
+    return dyn_traj_round_up(h->chunk_frames * sizeof(dyn_traj_index_t), 64);
+}
+
+/* File offset of frame k's index entry and data. */
+static uint64_t dyn_traj_index_offset(const dyn_traj_header_t *h, uint64_t k) {
+    return h->data_offset + (k / h->chunk_frames) * h->chunk_size +
+           (k % h->chunk_frames) * sizeof(dyn_traj_index_t);
+}
+
+static uint64_t dyn_traj_frame_offset(const dyn_traj_header_t *h, uint64_t k) {
+    return h->data_offset + (k / h->chunk_frames) * h->chunk_size +
+           dyn_traj_index_size(h) + (k % h->chunk_frames) * h->frame_size;
+}
+
+static int dyn_traj_pwrite(int fd, const void *data, size_t len, uint64_t off) {
+    const unsigned char *p = data;
+    while (len > 0) {
+        ssize_t w = pwrite(fd, p, len, (off_t)off);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += w;
+        len -= (size_t)w;
+        off += (uint64_t)w;
+    }
+    return 0;
+}
+
+static int dyn_traj_pread(int fd, void *data, size_t len, uint64_t off) {
+    unsigned char *p = data;
+    while (len > 0) {
+        ssize_t r = pread(fd, p, len, (off_t)off);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return -1;
+        p += r;
+        len -= (size_t)r;
+        off += (uint64_t)r;
+    }
+    return 0;
+}
+
+/* -------------------------------
+   Writing
+   ------------------------------- */
+
+dyn_traj_t *dyn_traj_create(const char *filename, const dyn_system_t *sys,
+                            unsigned fields, size_t chunk_frames) {
+    if (!filename || !sys || sys->N == 0) return NULL;
+    dyn_traj_t *tr = calloc(1, sizeof(*tr));
+    if (!tr) return NULL;
+
+    dyn_traj_header_t *h = &tr->hdr;
+    memcpy(h->magic, dyn_traj_magic, sizeof(h->magic));
+    h->version = DYN_TRAJ_VERSION;
+    h->fields = fields & (DYN_TRAJ_VEL | DYN_TRAJ_FORCE);
+    h->n_particles = sys->N;
+    h->chunk_frames = chunk_frames ? chunk_frames : 64;
+    h->frame_size = 3 * dyn_traj_blocks(h->fields) * sys->N * sizeof(double);
+    h->chunk_size = dyn_traj_index_size(h) + h->chunk_frames * h->frame_size;
+    h->data_offset = dyn_traj_round_up(sizeof(*h) + sys->N * sizeof(double), DYN_TRAJ_ALIGN);
+    tr->writable = 1;
+
+    tr->buf = malloc(h->frame_size);
+    tr->fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (!tr->buf || tr->fd < 0) goto fail;
+
+    for (size_t i = 0; i < sys->N; i++)
+        tr->buf[i] = sys->layout == DYN_LAYOUT_SOA ? sys->soa->mass[i] : sys->particles[i].mass;
+    if (dyn_traj_pwrite(tr->fd, h, sizeof(*h), 0) != 0 ||
+        dyn_traj_pwrite(tr->fd, tr->buf, sys->N * sizeof(double), sizeof(*h)) != 0)
+        goto fail;
+    return tr;
+
+fail:
+    if (tr->fd >= 0) close(tr->fd);
+    free(tr->buf);
+    free(tr);
+    return NULL;
+}
+
+/* Copy one field of all particles into three consecutive N-blocks. */
+static void dyn_traj_gather(const dyn_system_t *sys, dyn_field_t field, double *out) {
+    const size_t N = sys->N;
+    if (sys->layout == DYN_LAYOUT_SOA) {
+        const size_t cap = sys->soa->capacity;
+        const double *blk = field == DYN_FIELD_POS ? sys->soa->pos :
+                            field == DYN_FIELD_VEL ? sys->soa->vel : sys->soa->force;
+        for (size_t a = 0; a < 3; a++)
+            memcpy(out + a * N, blk + a * cap, N * sizeof(double));
+        return;
+    }
+    for (size_t i = 0; i < N; i++) {
+        const dyn_particle_t *p = &sys->particles[i];
+        const gsl_vector *v = field == DYN_FIELD_POS ? p->pos :
+                              field == DYN_FIELD_VEL ? p->vel : p->force;
+        for (size_t a = 0; a < 3; a++) out[a * N + i] = v->data[a * v->stride];
+    }
+}
+
+int dyn_traj_append(dyn_traj_t *tr, const dyn_system_t *sys) {
+    if (!tr || !tr->writable || !sys || sys->N != tr->hdr.n_particles) return -1;
+    const unsigned need = DYN_GPU_POS | (tr->hdr.fields & DYN_TRAJ_VEL ? DYN_GPU_VEL : 0u) |
+                          (tr->hdr.fields & DYN_TRAJ_FORCE ? DYN_GPU_FORCE : 0u);
+    if (dyn_gpu_pull(sys, need) != 0) return -1;
+    const size_t N = sys->N;
+    double *p = tr->buf;
+
+    dyn_traj_gather(sys, DYN_FIELD_POS, p);
+    p += 3 * N;
+    if (tr->hdr.fields & DYN_TRAJ_VEL) {
+        dyn_traj_gather(sys, DYN_FIELD_VEL, p);
+        p += 3 * N;
+    }
+    if (tr->hdr.fields & DYN_TRAJ_FORCE) dyn_traj_gather(sys, DYN_FIELD_FORCE, p);
+
+    const uint64_t k = tr->hdr.n_frames;
+    dyn_traj_index_t idx = { sys->t, sys->step_count };
+    if (dyn_traj_pwrite(tr->fd, tr->buf, tr->hdr.frame_size, dyn_traj_frame_offset(&tr->hdr, k)) != 0 ||
+        dyn_traj_pwrite(tr->fd, &idx, sizeof(idx), dyn_traj_index_offset(&tr->hdr, k)) != 0)
+        return -1;
+    tr->hdr.n_frames = k + 1;
+
+    /* Publish every completed chunk so long runs stay readable after a crash. */
+    if (tr->hdr.n_frames % tr->hdr.chunk_frames == 0) return dyn_traj_flush(tr);
+    return 0;
+}
+
+int dyn_traj_flush(dyn_traj_t *tr) {
+    if (!tr || !tr->writable) return -1;
+    return dyn_traj_pwrite(tr->fd, &tr->hdr, sizeof(tr->hdr), 0);
+}
+
+/* -------------------------------
+   Reading
+   ------------------------------- */
+
+dyn_traj_t *dyn_traj_open(const char *filename) {
+    if (!filename) return NULL;
+    dyn_traj_t *tr = calloc(1, sizeof(*tr));
+    if (!tr) return NULL;
+    tr->fd = open(filename, O_RDONLY);
+    if (tr->fd < 0) goto fail;
+
+    dyn_traj_header_t *h = &tr->hdr;
+    struct stat st;
+    if (dyn_traj_pread(tr->fd, h, sizeof(*h), 0) != 0 || fstat(tr->fd, &st) != 0) goto fail;
+    if (memcmp(h->magic, dyn_traj_magic, sizeof(h->magic)) != 0 || h->version != DYN_TRAJ_VERSION ||
+        h->n_particles == 0 || h->chunk_frames == 0 ||
+        h->frame_size != 3 * dyn_traj_blocks(h->fields) * h->n_particles * sizeof(double))
+        goto fail;
+
+    /* Frames beyond the end of the file (truncated copy) are not visible. */
+    while (h->n_frames > 0 &&
+           dyn_traj_frame_offset(h, h->n_frames - 1) + h->frame_size > (uint64_t)st.st_size)
+        h->n_frames--;
+
+    tr->map_size = (size_t)st.st_size;
+    tr->map = mmap(NULL, tr->map_size, PROT_READ, MAP_SHARED, tr->fd, 0);
+    if (tr->map == MAP_FAILED) {
+        tr->map = NULL;
+        goto fail;
+    }
+    madvise(tr->map, tr->map_size, MADV_RANDOM);
+    return tr;
+
+fail:
+    if (tr->fd >= 0) close(tr->fd);
+    free(tr);
+    return NULL;
+}
+
+size_t dyn_traj_frames(const dyn_traj_t *tr) {
+    return tr ? (size_t)tr->hdr.n_frames : 0;
+}
+
+const double *dyn_traj_masses(const dyn_traj_t *tr) {
+    if (!tr || !tr->map) return NULL;
+    return (const double *)(tr->map + sizeof(dyn_traj_header_t));
+}
+
+int dyn_traj_frame(const dyn_traj_t *tr, size_t k, dyn_traj_frame_t *out) {
+    if (!tr || !tr->map || !out || k >= tr->hdr.n_frames) return -1;
+    const dyn_traj_header_t *h = &tr->hdr;
+    const size_t N = (size_t)h->n_particles;
+    const dyn_traj_index_t *idx = (const dyn_traj_index_t *)(tr->map + dyn_traj_index_offset(h, k));
+    const double *p = (const double *)(tr->map + dyn_traj_frame_offset(h, k));
+
+    memset(out, 0, sizeof(*out));
+    out->t = idx->t;
+    out->step = idx->step;
+    out->n = N;
+    for (size_t a = 0; a < 3; a++) out->pos[a] = p + a * N;
+    p += 3 * N;
+    if (h->fields & DYN_TRAJ_VEL) {
+        for (size_t a = 0; a < 3; a++) out->vel[a] = p + a * N;
+        p += 3 * N;
+    }
+    if (h->fields & DYN_TRAJ_FORCE)
+        for (size_t a = 0; a < 3; a++) out->force[a] = p + a * N;
+    return 0;
+}
+
+int dyn_traj_load_frame(const dyn_traj_t *tr, size_t k, dyn_system_t *sys) {
+    dyn_traj_frame_t fr;
+    if (!sys || dyn_traj_frame(tr, k, &fr) != 0 || fr.n != sys->N) return -1;
+    if (dyn_system_sync_host(sys) != 0) return -1;
+    for (size_t i = 0; i < sys->N; i++) {
+        dyn_particle_t *p = &sys->particles[i];
+        for (size_t a = 0; a < 3; a++) {
+            p->pos->data[a * p->pos->stride] = fr.pos[a][i];
+            if (fr.vel[0]) p->vel->data[a * p->vel->stride] = fr.vel[a][i];
+            if (fr.force[0]) p->force->data[a * p->force->stride] = fr.force[a][i];
+        }
+    }
+    sys->t = fr.t;
+    sys->step_count = (int)fr.step;
+    sys->forces_valid = 0;
+    dyn_system_invalidate_gpu(sys);
+    return 0;
+}
+
+kin_trajectory *dyn_traj_particle_view(const dyn_traj_t *tr, size_t particle,
+                                       size_t first, size_t count) {
+    if (!tr || !tr->map || particle >= tr->hdr.n_particles ||
+        first > tr->hdr.n_frames || count > tr->hdr.n_frames - first)
+        return NULL;
+
+    kin_trajectory *view = calloc(1, sizeof(*view));
+    kin_state *states = calloc(count ? count : 1, sizeof(*states));
+    gsl_vector *vecs = calloc(2 * (count ? count : 1), sizeof(*vecs));
+    if (!view || !states || !vecs) {
+        free(view);
+        free(states);
+        free(vecs);
+        return NULL;
+    }
+
+    const size_t N = (size_t)tr->hdr.n_particles;
+    for (size_t k = 0; k < count; k++) {
+        dyn_traj_frame_t fr;
+        dyn_traj_frame(tr, first + k, &fr);
+        gsl_vector *x = &vecs[2 * k], *v = &vecs[2 * k + 1];
+        x->size = 3;
+        x->stride = N;
+        x->data = (double *)fr.pos[0] + particle;
+        states[k].pos = x;
+        if (fr.vel[0]) {
+            v->size = 3;
+            v->stride = N;
+            v->data = (double *)fr.vel[0] + particle;
+            states[k].vel = v;
+        }
+        states[k].t = fr.t;
+    }
+    view->n = count;
+    view->states = states;
+    view->userdata = vecs;
+    return view;
+}
+
+void dyn_traj_view_free(kin_trajectory *view) {
+    if (!view) return;
+    free(view->userdata);
+    free(view->states);
+    free(view->name);
+    free(view);
+}
+
+/* -------------------------------
+   Common
+   ------------------------------- */
+
+int dyn_traj_close(dyn_traj_t *tr) {
+    if (!tr) return -1;
+    int status = 0;
+    if (tr->writable) status = dyn_traj_flush(tr);
+    if (tr->map) munmap(tr->map, tr->map_size);
+    if (tr->fd >= 0 && close(tr->fd) != 0) status = -1;
+    free(tr->buf);
+    free(tr);
+    return status;
+}
+
+void dyn_system_attach_trajectory(dyn_system_t *sys, dyn_traj_t *tr, size_t every) {
+    if (!sys) return;
+    sys->trajectory = tr;
+    sys->trajectory_every = tr ? (every ? every : 1) : 0;
+}
+
+/* Whole-system snapshot: a one-frame trajectory with velocities. */
+int dyn_system_save(const dyn_system_t *sys, const char *filename) {
+    dyn_traj_t *tr = dyn_traj_create(filename, sys, DYN_TRAJ_VEL, 1);
+    if (!tr) return -1;
+    int status = dyn_traj_append(tr, sys);
+    if (dyn_traj_close(tr) != 0) status = -1;
+    return status;
+}
+
+/* Load the last frame of a trajectory file into a new system. */
+dyn_system_t *dyn_system_load(const char *filename) {
+    dyn_traj_t *tr = dyn_traj_open(filename);
+    if (!tr) return NULL;
+    size_t n = dyn_traj_frames(tr);
+    dyn_system_t *sys = n ? dyn_system_alloc((size_t)tr->hdr.n_particles) : NULL;
+    if (sys) {
+        const double *m = dyn_traj_masses(tr);
+        for (size_t i = 0; i < sys->N; i++) sys->particles[i].mass = m[i];
+        if (dyn_traj_load_frame(tr, n - 1, sys) != 0) {
+            dyn_system_free(sys);
+            sys = NULL;
+        }
+    }
+    dyn_traj_close(tr);
+    return sys;
+}
@@ -0,0 +1,144 @@
+/*
+   fission_fusion.c - Nuclear fission and fusion module for HOLOS
+
+   Emission sampling of neutron and gamma lines through alias tables
+   cached per reaction (see fission_fusion.h).
+
+   Copyright (C) 2025 HOLOS Scientific Computing Project
+
+   This file is part of HOLOS.
+
+   HOLOS is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "core/phys/nuclear/fission_fusion.h"
+#include "core/phys/alias_table.h"
+
+#define FF_SAMPLE_CHUNK 2048            /* Draws per parallel work item */
+#define FF_EMIT_SEED 0x66697373696F6E31ull      /* Seed of the ff_emit_*() sequence */
+
+/* Alias table of one line set, with the arrays it was built from. */
+typedef struct {
+	const double *energies;
+	const double *weights;
+	size_t n;
+	alias_table *table;
+} ff_line_sampler;
+
+typedef struct {
+	ff_line_sampler neutrons;
+	ff_line_sampler gammas;
+} ff_reaction_sampler;
+
+static uint64_t ff_emit_counter;
+
+void ff_reaction_reset_samplers(ff_reaction_t *reaction) {
+	if (!reaction || !reaction->sampler)
+		return;
+	ff_reaction_sampler *s = reaction->sampler;
+	alias_table_free(s->neutrons.table);
+	alias_table_free(s->gammas.table);
+	free(s);
+	reaction->sampler = NULL;
+}
+
+static const alias_table *ff_line_table(ff_line_sampler *ls, const double *energies, const double *weights, int n) {
+	if (!energies || n <= 0)
+		return NULL;
+	if (ls->table && ls->energies == energies && ls->weights == weights && ls->n == (size_t)n)
+		return ls->table;
+	alias_table_free(ls->table);
+	ls->table = NULL;
+	if (weights) {
+		ls->table = alias_table_alloc(weights, (size_t)n);
+	} else {
+		double *ones = malloc((size_t)n * sizeof *ones);
+		if (!ones)
+			return NULL;
+		for (int i = 0; i < n; i++)
+			ones[i] = 1.0;
+		ls->table = alias_table_alloc(ones, (size_t)n);
+		free(ones);
+	}
+	ls->energies = energies;
+	ls->weights = weights;
+	ls->n = (size_t)n;
+	return ls->table;
+}
+
+static int ff_sample_lines(ff_reaction_t *reaction, int gammas, uint64_t seed, uint64_t stream, uint64_t first,
+                           double *energies, size_t n, int n_threads) {
+	if (!reaction || (n && !energies))
+		return -1;
+	if (!reaction->sampler && !(reaction->sampler = calloc(1, sizeof(ff_reaction_sampler))))
+		return -1;
+	ff_reaction_sampler *s = reaction->sampler;
+	const double *lines = gammas ? reaction->gamma_energies : reaction->neutron_energies;
+	const alias_table *t = gammas
+		? ff_line_table(&s->gammas, reaction->gamma_energies, reaction->gamma_weights, reaction->n_gammas_emitted)
+		: ff_line_table(&s->neutrons, reaction->neutron_energies, reaction->neutron_weights, reaction->n_neutrons_emitted);
+	if (!t)
+		return -1;
+	if (n_threads < 0) {
+#ifdef _OPENMP
+		n_threads = omp_get_max_threads();
+#else
+		n_threads = 1;
+#endif
+	}
+	const int nt = n_threads > 0 ? n_threads : 1;
+	const size_t n_chunks = (n + FF_SAMPLE_CHUNK - 1) / FF_SAMPLE_CHUNK;
+
+	#pragma omp parallel for schedule(static) num_threads(nt) if(nt > 1 && n_chunks > 1)
+	for (size_t c = 0; c < n_chunks; c++) {
+		size_t line[FF_SAMPLE_CHUNK];
+		const size_t k0 = c * FF_SAMPLE_CHUNK, len = n - k0 < FF_SAMPLE_CHUNK ? n - k0 : FF_SAMPLE_CHUNK;
+		alias_table_sample(t, seed, stream, first + k0, len, line, NULL, 0);
+		for (size_t k = 0; k < len; k++)
+			energies[k0 + k] = lines[line[k]];
+	}
+	return 0;
+}
+
+int ff_reaction_sample_neutrons(ff_reaction_t *reaction, uint64_t seed, uint64_t stream, uint64_t first,
+                                double *energies, size_t n, int n_threads) {
+	return ff_sample_lines(reaction, 0, seed, stream, first, energies, n, n_threads);
+}
+
+int ff_reaction_sample_gammas(ff_reaction_t *reaction, uint64_t seed, uint64_t stream, uint64_t first,
+                              double *energies, size_t n, int n_threads) {
+	return ff_sample_lines(reaction, 1, seed, stream, first, energies, n, n_threads);
+}
+
+static int ff_emit(ff_reaction_t *reaction, int gammas, double *energies, int n) {
+	if (n < 0)
+		return -1;
+	uint64_t first;
+	#pragma omp atomic capture
+	{ first = ff_emit_counter; ff_emit_counter += (uint64_t)n; }
+	return ff_sample_lines(reaction, gammas, FF_EMIT_SEED, 0, first, energies, (size_t)n, 0) == 0 ? n : -1;
+}
+
+int ff_emit_neutrons(ff_reaction_t *reaction, double *energies, int n) {
+	return ff_emit(reaction, 0, energies, n);
+}
+
+int ff_emit_gammas(ff_reaction_t *reaction, double *energies, int n) {
+	return ff_emit(reaction, 1, energies, n);
+}
@@ -0,0 +1,663 @@
+/*
+   fission_fusion_network.c - Implicit reaction networks for HOLOS
+
+   Stiff integration of ff_system_t reaction networks (see fission_fusion.h):
+   - Reactions compiled once into distinct reactants with powers and net
+     stoichiometry lists, with the Jacobian position of every
+     (reactant, species) pair, so rates and the analytic Jacobian are
+     straight sweeps over those lists
+   - Variable-step BDF1/BDF2; local error from the corrector minus an
+     explicit predictor of the same order (factors 1/2 and 2/5)
+   - Modified Newton on I - gamma J with a fixed no-pivot LU pattern: the
+     matrix is column diagonally dominant for conserving networks, and
+     the factorization is kept across steps and calls until gamma drifts,
+     the Jacobian ages out or convergence slows (CVODE's heuristics)
+
+   Copyright (C) 2025 HOLOS Scientific Computing Project
+
+   This file is part of HOLOS.
+
+   HOLOS is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "core/phys/nuclear/fission_fusion.h"
+
+#define FF_NET_MAX_NEWTON 3             /* Corrector iterations per attempt */
+#define FF_NET_JAC_AGE 20               /* Steps before the Jacobian is re-evaluated */
+#define FF_NET_GAMMA_DRIFT 0.3          /* Relative change of gamma that forces a refactor */
+
+typedef struct {
+	/* Reactions: distinct reactants with powers, net stoichiometry. */
+	size_t *rx_ptr, *rx_sp;
+	int *rx_pow;
+	size_t *nu_ptr, *nu_sp;
+	double *nu;
+	double *rate;
+	size_t *jac_ptr, *jac_pos;      /* Per reaction, n_reactants x n_nu positions in J */
+	/* Jacobian in CSR, diagonal included. */
+	size_t *row_ptr, *col, *diag;
+	double *J;
+	/* LU of I - gamma J on the filled pattern. */
+	size_t *lu_ptr, *lu_col, *lu_diag, *lu_src;
+	size_t lu_nnz;
+	double *lu, *w;
+	double gamma_lu;
+	int have_jac, have_lu;
+	size_t jac_age;
+	/* Integrator vectors [n]. */
+	double *y_prev, *f, *psi, *pred, *y, *res, *ewt;
+} ff_network_work;
+
+/* -------------------------------
+   Compilation
+   ------------------------------- */
+
+typedef struct {
+	const ff_nucleus_t *p;
+	size_t index;
+} ff_nucleus_key;
+
+static int ff_key_ptr_cmp(const void *a, const void *b) {
+	const uintptr_t x = (uintptr_t)((const ff_nucleus_key *)a)->p, y = (uintptr_t)((const ff_nucleus_key *)b)->p;
+	return x < y ? -1 : (x > y);
+}
+
+static int ff_key_nuclide_cmp(const void *a, const void *b) {
+	const ff_nucleus_t *x = ((const ff_nucleus_key *)a)->p, *y = ((const ff_nucleus_key *)b)->p;
+	if (x->Z != y->Z)
+		return x->Z < y->Z ? -1 : 1;
+	if (x->N != y->N)
+		return x->N < y->N ? -1 : 1;
+	return x->energy < y->energy ? -1 : (x->energy > y->energy);
+}
+
+static int ff_species(const ff_nucleus_key *by_ptr, const ff_nucleus_key *by_nuclide, size_t n,
+                      const ff_nucleus_t *p, size_t *index) {
+	if (!p)
+		return 0;
+	const ff_nucleus_key key = { p, 0 };
+	const ff_nucleus_key *hit = bsearch(&key, by_ptr, n, sizeof *by_ptr, ff_key_ptr_cmp);
+	if (!hit)
+		hit = bsearch(&key, by_nuclide, n, sizeof *by_nuclide, ff_key_nuclide_cmp);
+	if (!hit)
+		return 0;
+	*index = hit->index;
+	return 1;
+}
+
+static int ff_size_cmp(const void *a, const void *b) {
+	const size_t x = *(const size_t *)a, y = *(const size_t *)b;
+	return x < y ? -1 : (x > y);
+}
+
+static int ff_u64_cmp(const void *a, const void *b) {
+	const uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+	return x < y ? -1 : (x > y);
+}
+
+/* Position of column c in CSR row i. */
+static size_t ff_csr_find(const size_t *ptr, const size_t *col, size_t i, size_t c) {
+	size_t lo = ptr[i], hi = ptr[i + 1];
+	while (hi - lo > 1) {
+		const size_t mid = lo + (hi - lo) / 2;
+		if (col[mid] <= c)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+static int ff_network_compile(ff_network_t *net, ff_network_work *wk, const ff_system_t *system) {
+	const size_t n = net->n;
+	size_t n_rx = 0, n_terms = 0, n_prod = 0;
+	for (size_t k = 0; k < system->n_reactions; k++) {
+		const ff_reaction_t *r = system->reactions[k];
+		if (!r || !(r->rate > 0.0))
+			continue;
+		n_rx++;
+		n_terms += r->n_reactants;
+		n_prod += r->n_products;
+	}
+	net->n_reactions = n_rx;
+
+	ff_nucleus_key *by_ptr = malloc((n ? n : 1) * sizeof *by_ptr);
+	ff_nucleus_key *by_nuclide = malloc((n ? n : 1) * sizeof *by_nuclide);
+	size_t *sp = malloc((n_terms + n_prod + 1) * sizeof *sp);
+	wk->rx_ptr = calloc(n_rx + 1, sizeof *wk->rx_ptr);
+	wk->rx_sp = malloc((n_terms ? n_terms : 1) * sizeof *wk->rx_sp);
+	wk->rx_pow = malloc((n_terms ? n_terms : 1) * sizeof *wk->rx_pow);
+	wk->nu_ptr = calloc(n_rx + 1, sizeof *wk->nu_ptr);
+	wk->nu_sp = malloc((n_terms + n_prod + 1) * sizeof *wk->nu_sp);
+	wk->nu = malloc((n_terms + n_prod + 1) * sizeof *wk->nu);
+	wk->rate = malloc((n_rx ? n_rx : 1) * sizeof *wk->rate);
+	if (!by_ptr || !by_nuclide || !sp || !wk->rx_ptr || !wk->rx_sp || !wk->rx_pow || !wk->nu_ptr || !wk->nu_sp
+	    || !wk->nu || !wk->rate) {
+		free(by_ptr);
+		free(by_nuclide);
+		free(sp);
+		return -1;
+	}
+	size_t valid = 0;
+	for (size_t i = 0; i < n; i++)
+		if (system->nuclei[i]) {
+			by_ptr[valid] = (ff_nucleus_key){ system->nuclei[i], i };
+			by_nuclide[valid++] = (ff_nucleus_key){ system->nuclei[i], i };
+		}
+	qsort(by_ptr, valid, sizeof *by_ptr, ff_key_ptr_cmp);
+	qsort(by_nuclide, valid, sizeof *by_nuclide, ff_key_nuclide_cmp);
+
+	size_t kk = 0, nr = 0, nn = 0;
+	for (size_t k = 0; k < system->n_reactions; k++) {
+		const ff_reaction_t *r = system->reactions[k];
+		if (!r || !(r->rate > 0.0))
+			continue;
+		wk->rate[kk] = r->rate;
+		/* Reactants: sorted species, runs give the powers. */
+		size_t m = 0;
+		for (size_t a = 0; a < r->n_reactants; a++)
+			if (ff_species(by_ptr, by_nuclide, valid, r->reactants ? r->reactants[a] : NULL, &sp[m]))
+				m++;
+		qsort(sp, m, sizeof *sp, ff_size_cmp);
+		const size_t r0 = nr;
+		for (size_t a = 0; a < m; a++) {
+			if (nr > r0 && wk->rx_sp[nr - 1] == sp[a]) {
+				wk->rx_pow[nr - 1]++;
+				continue;
+			}
+			wk->rx_sp[nr] = sp[a];
+			wk->rx_pow[nr++] = 1;
+		}
+		wk->rx_ptr[kk + 1] = nr;
+		/* Net stoichiometry: -power per reactant, +1 per product. */
+		size_t q = 0;
+		for (size_t a = 0; a < m; a++)
+			sp[q++] = sp[a] << 1;
+		for (size_t b = 0; b < r->n_products; b++) {
+			size_t s;
+			if (ff_species(by_ptr, by_nuclide, valid, r->products ? r->products[b] : NULL, &s))
+				sp[q++] = (s << 1) | 1;
+		}
+		qsort(sp, q, sizeof *sp, ff_size_cmp);
+		const size_t n0 = nn;
+		for (size_t a = 0; a < q; a++) {
+			const size_t s = sp[a] >> 1;
+			const double d = (sp[a] & 1) ? 1.0 : -1.0;
+			if (nn > n0 && wk->nu_sp[nn - 1] == s) {
+				wk->nu[nn - 1] += d;
+				continue;
+			}
+			wk->nu_sp[nn] = s;
+			wk->nu[nn++] = d;
+		}
+		/* Drop species whose net change cancels (catalysts). */
+		size_t keep = n0;
+		for (size_t a = n0; a < nn; a++)
+			if (wk->nu[a] != 0.0) {
+				wk->nu_sp[keep] = wk->nu_sp[a];
+				wk->nu[keep++] = wk->nu[a];
+			}
+		nn = keep;
+		wk->nu_ptr[kk + 1] = nn;
+		kk++;
+	}
+	free(by_ptr);
+	free(by_nuclide);
+	free(sp);
+
+	/* Jacobian pattern: (species changed, reactant) pairs plus the diagonal. */
+	size_t n_pairs = n;
+	for (size_t k = 0; k < n_rx; k++)
+		n_pairs += (wk->rx_ptr[k + 1] - wk->rx_ptr[k]) * (wk->nu_ptr[k + 1] - wk->nu_ptr[k]);
+	uint64_t *key = malloc(n_pairs * sizeof *key);
+	wk->jac_ptr = calloc(n_rx + 1, sizeof *wk->jac_ptr);
+	wk->jac_pos = malloc((n_pairs ? n_pairs : 1) * sizeof *wk->jac_pos);
+	wk->row_ptr = calloc(n + 1, sizeof *wk->row_ptr);
+	wk->col = malloc((n_pairs ? n_pairs : 1) * sizeof *wk->col);
+	wk->diag = malloc((n ? n : 1) * sizeof *wk->diag);
+	if (!key || !wk->jac_ptr || !wk->jac_pos || !wk->row_ptr || !wk->col || !wk->diag) {
+		free(key);
+		return -1;
+	}
+	size_t m = 0;
+	for (size_t i = 0; i < n; i++)
+		key[m++] = ((uint64_t)i << 32) | i;
+	for (size_t k = 0; k < n_rx; k++)
+		for (size_t a = wk->rx_ptr[k]; a < wk->rx_ptr[k + 1]; a++)
+			for (size_t b = wk->nu_ptr[k]; b < wk->nu_ptr[k + 1]; b++)
+				key[m++] = ((uint64_t)wk->nu_sp[b] << 32) | wk->rx_sp[a];
+	qsort(key, m, sizeof *key, ff_u64_cmp);
+	size_t nnz = 0;
+	for (size_t q = 0; q < m; q++) {
+		if (nnz && key[q] == key[q - 1])
+			continue;
+		const size_t i = (size_t)(key[q] >> 32), j = (size_t)(key[q] & 0xFFFFFFFFu);
+		if (i == j)
+			wk->diag[i] = nnz;
+		wk->col[nnz] = j;
+		wk->row_ptr[i + 1]++;
+		key[nnz++] = key[q];
+	}
+	for (size_t i = 0; i < n; i++)
+		wk->row_ptr[i + 1] += wk->row_ptr[i];
+	free(key);
+	net->nnz = nnz;
+
+	size_t p = 0;
+	for (size_t k = 0; k < n_rx; k++) {
+		for (size_t a = wk->rx_ptr[k]; a < wk->rx_ptr[k + 1]; a++)
+			for (size_t b = wk->nu_ptr[k]; b < wk->nu_ptr[k + 1]; b++)
+				wk->jac_pos[p++] = ff_csr_find(wk->row_ptr, wk->col, wk->nu_sp[b], wk->rx_sp[a]);
+		wk->jac_ptr[k + 1] = p;
+	}
+	wk->J = malloc((nnz ? nnz : 1) * sizeof *wk->J);
+	return wk->J ? 0 : -1;
+}
+
+/* Symbolic no-pivot LU of the Jacobian pattern in natural order: row i
+   gathers the upper pattern of every row k < i it touches, ascending. */
+static int ff_network_symbolic(const ff_network_t *net, ff_network_work *wk) {
+	const size_t n = net->n;
+	size_t *link = malloc((n + 1) * sizeof *link);
+	size_t *mark = malloc((n ? n : 1) * sizeof *mark);
+	size_t cap = net->nnz + n, nnz = 0;
+	wk->lu_ptr = malloc((n + 1) * sizeof *wk->lu_ptr);
+	wk->lu_diag = malloc((n ? n : 1) * sizeof *wk->lu_diag);
+	wk->lu_col = malloc(cap * sizeof *wk->lu_col);
+	wk->lu_src = malloc((net->nnz ? net->nnz : 1) * sizeof *wk->lu_src);
+	if (!link || !mark || !wk->lu_ptr || !wk->lu_diag || !wk->lu_col || !wk->lu_src) {
+		free(link);
+		free(mark);
+		return -1;
+	}
+	for (size_t k = 0; k < n; k++)
+		mark[k] = SIZE_MAX;
+	wk->lu_ptr[0] = 0;
+	for (size_t i = 0; i < n; i++) {
+		/* Row i of J is sorted: chain it directly. */
+		size_t first = n, *tail = &first;
+		for (size_t q = wk->row_ptr[i]; q < wk->row_ptr[i + 1]; q++) {
+			mark[wk->col[q]] = i;
+			*tail = wk->col[q];
+			tail = &link[wk->col[q]];
+		}
+		*tail = n;
+		for (size_t k = first; k < i; k = link[k]) {
+			size_t at = k;
+			for (size_t q = wk->lu_diag[k] + 1; q < wk->lu_ptr[k + 1]; q++) {
+				const size_t c = wk->lu_col[q];
+				if (mark[c] == i)
+					continue;
+				mark[c] = i;
+				while (link[at] < c)
+					at = link[at];
+				link[c] = link[at];
+				link[at] = c;
+				at = c;
+			}
+		}
+		for (size_t c = first; c < n; c = link[c]) {
+			if (nnz == cap) {
+				cap *= 2;
+				size_t *grown = realloc(wk->lu_col, cap * sizeof *grown);
+				if (!grown) {
+					free(link);
+					free(mark);
+					return -1;
+				}
+				wk->lu_col = grown;
+			}
+			if (c == i)
+				wk->lu_diag[i] = nnz;
+			wk->lu_col[nnz++] = c;
+		}
+		wk->lu_ptr[i + 1] = nnz;
+		for (size_t q = wk->row_ptr[i]; q < wk->row_ptr[i + 1]; q++)
+			wk->lu_src[q] = ff_csr_find(wk->lu_ptr, wk->lu_col, i, wk->col[q]);
+	}
+	wk->lu_nnz = nnz;
+	free(link);
+	free(mark);
+	wk->lu = malloc((nnz ? nnz : 1) * sizeof *wk->lu);
+	wk->w = malloc((n ? n : 1) * sizeof *wk->w);
+	return wk->lu && wk->w ? 0 : -1;
+}
+
+/* -------------------------------
+   Rates, Jacobian, LU
+   ------------------------------- */
+
+static double ff_ipow(double y, int p) {
+	double r = 1.0;
+	for (int e = 0; e < p; e++)
+		r *= y;
+	return r;
+}
+
+static void ff_network_rhs(ff_network_t *net, const double *Y, double *dYdt) {
+	const ff_network_work *wk = net->work;
+	memset(dYdt, 0, net->n * sizeof *dYdt);
+	for (size_t k = 0; k < net->n_reactions; k++) {
+		double flux = wk->rate[k];
+		for (size_t a = wk->rx_ptr[k]; a < wk->rx_ptr[k + 1]; a++)
+			flux *= ff_ipow(Y[wk->rx_sp[a]], wk->rx_pow[a]);
+		for (size_t b = wk->nu_ptr[k]; b < wk->nu_ptr[k + 1]; b++)
+			dYdt[wk->nu_sp[b]] += wk->nu[b] * flux;
+	}
+	net->n_rhs++;
+}
+
+static void ff_network_jacobian(ff_network_t *net, const double *Y) {
+	ff_network_work *wk = net->work;
+	memset(wk->J, 0, net->nnz * sizeof *wk->J);
+	for (size_t k = 0; k < net->n_reactions; k++) {
+		const size_t a0 = wk->rx_ptr[k], a1 = wk->rx_ptr[k + 1];
+		const size_t b0 = wk->nu_ptr[k], b1 = wk->nu_ptr[k + 1];
+		const size_t *pos = wk->jac_pos + wk->jac_ptr[k];
+		for (size_t a = a0; a < a1; a++) {
+			/* d flux / d Y_a = rate p_a Y_a^(p_a - 1) prod_(b != a) Y_b^p_b */
+			double d = wk->rate[k] * wk->rx_pow[a] * ff_ipow(Y[wk->rx_sp[a]], wk->rx_pow[a] - 1);
+			for (size_t c = a0; c < a1; c++)
+				if (c != a)
+					d *= ff_ipow(Y[wk->rx_sp[c]], wk->rx_pow[c]);
+			for (size_t b = b0; b < b1; b++)
+				wk->J[*pos++] += wk->nu[b] * d;
+		}
+	}
+	wk->have_jac = 1;
+	wk->have_lu = 0;
+	wk->jac_age = 0;
+	net->n_jacobians++;
+}
+
+/* LU of I - gamma J; -1 on a zero pivot. */
+static int ff_network_factor(ff_network_t *net, double gamma) {
+	ff_network_work *wk = net->work;
+	const size_t n = net->n;
+	double *lu = wk->lu, *w = wk->w;
+	memset(lu, 0, wk->lu_nnz * sizeof *lu);
+	net->n_factorizations++;
+	wk->have_lu = 0;
+	for (size_t i = 0; i < n; i++) {
+		for (size_t q = wk->row_ptr[i]; q < wk->row_ptr[i + 1]; q++)
+			lu[wk->lu_src[q]] = -gamma * wk->J[q];
+		lu[wk->lu_diag[i]] += 1.0;
+		const size_t p0 = wk->lu_ptr[i], p1 = wk->lu_ptr[i + 1];
+		for (size_t q = p0; q < p1; q++)
+			w[wk->lu_col[q]] = lu[q];
+		for (size_t q = p0; q < wk->lu_diag[i]; q++) {
+			const size_t k = wk->lu_col[q];
+			const double l = w[k] / lu[wk->lu_diag[k]];
+			w[k] = l;
+			for (size_t u = wk->lu_diag[k] + 1; u < wk->lu_ptr[k + 1]; u++)
+				w[wk->lu_col[u]] -= l * lu[u];
+		}
+		for (size_t q = p0; q < p1; q++)
+			lu[q] = w[wk->lu_col[q]];
+		if (lu[wk->lu_diag[i]] == 0.0 || !isfinite(lu[wk->lu_diag[i]]))
+			return -1;
+	}
+	wk->gamma_lu = gamma;
+	wk->have_lu = 1;
+	return 0;
+}
+
+/* x := (L U)^-1 x, unit-diagonal L. */
+static void ff_network_solve(const ff_network_t *net, double *x) {
+	const ff_network_work *wk = net->work;
+	const double *lu = wk->lu;
+	for (size_t i = 0; i < net->n; i++) {
+		double s = x[i];
+		for (size_t q = wk->lu_ptr[i]; q < wk->lu_diag[i]; q++)
+			s -= lu[q] * x[wk->lu_col[q]];
+		x[i] = s;
+	}
+	for (size_t i = net->n; i-- > 0;) {
+		double s = x[i];
+		for (size_t q = wk->lu_diag[i] + 1; q < wk->lu_ptr[i + 1]; q++)
+			s -= lu[q] * x[wk->lu_col[q]];
+		x[i] = s / lu[wk->lu_diag[i]];
+	}
+}
+
+/* -------------------------------
+   Engine
+   ------------------------------- */
+
+static void ff_network_work_free(ff_network_work *wk) {
+	if (!wk)
+		return;
+	free(wk->rx_ptr);
+	free(wk->rx_sp);
+	free(wk->rx_pow);
+	free(wk->nu_ptr);
+	free(wk->nu_sp);
+	free(wk->nu);
+	free(wk->rate);
+	free(wk->jac_ptr);
+	free(wk->jac_pos);
+	free(wk->row_ptr);
+	free(wk->col);
+	free(wk->diag);
+	free(wk->J);
+	free(wk->lu_ptr);
+	free(wk->lu_col);
+	free(wk->lu_diag);
+	free(wk->lu_src);
+	free(wk->lu);
+	free(wk->w);
+	free(wk->y_prev);
+	free(wk->f);
+	free(wk->psi);
+	free(wk->pred);
+	free(wk->y);
+	free(wk->res);
+	free(wk->ewt);
+	free(wk);
+}
+
+ff_network_t *ff_network_alloc(const ff_system_t *system, const ff_network_params *prm) {
+	if (!system || (system->n_nuclei && !system->nuclei) || (system->n_reactions && !system->reactions)
+	    || system->n_nuclei > UINT32_MAX)
+		return NULL;
+	ff_network_t *net = calloc(1, sizeof *net);
+	ff_network_work *wk = calloc(1, sizeof *wk);
+	if (!net || !wk) {
+		free(net);
+		free(wk);
+		return NULL;
+	}
+	net->work = wk;
+	net->n = system->n_nuclei;
+	net->prm = prm ? *prm : (ff_network_params){ 0 };
+	if (!(net->prm.rtol > 0.0))
+		net->prm.rtol = 1e-6;
+	if (!(net->prm.atol > 0.0))
+		net->prm.atol = 1e-12;
+	if (!net->prm.max_steps)
+		net->prm.max_steps = 100000;
+	net->h = net->prm.h_init > 0.0 ? net->prm.h_init : 0.0;
+
+	const size_t n = net->n ? net->n : 1;
+	double **vec[] = { &wk->y_prev, &wk->f, &wk->psi, &wk->pred, &wk->y, &wk->res, &wk->ewt };
+	for (size_t v = 0; v < sizeof vec / sizeof *vec; v++)
+		if (!(*vec[v] = malloc(n * sizeof **vec[v]))) {
+			ff_network_free(net);
+			return NULL;
+		}
+	if (ff_network_compile(net, wk, system) != 0 || ff_network_symbolic(net, wk) != 0) {
+		ff_network_free(net);
+		return NULL;
+	}
+	return net;
+}
+
+void ff_network_free(ff_network_t *net) {
+	if (!net)
+		return;
+	ff_network_work_free(net->work);
+	free(net);
+}
+
+int ff_network_rates(ff_network_t *net, const double *Y, double *dYdt) {
+	if (!net || !Y || !dYdt)
+		return -1;
+	ff_network_rhs(net, Y, dYdt);
+	return 0;
+}
+
+static double ff_wrms(const double *v, const double *ewt, size_t n) {
+	double s = 0.0;
+	for (size_t i = 0; i < n; i++) {
+		const double e = v[i] * ewt[i];
+		s += e * e;
+	}
+	return n ? sqrt(s / (double)n) : 0.0;
+}
+
+/* Solve y = psi + gamma F(y) from y = pred; 0 when converged, 1 if not. */
+static int ff_network_newton(ff_network_t *net, double gamma) {
+	ff_network_work *wk = net->work;
+	const size_t n = net->n;
+	double crate = 1.0, del_prev = 0.0;
+	memcpy(wk->y, wk->pred, n * sizeof *wk->y);
+	for (int it = 0; it < FF_NET_MAX_NEWTON; it++) {
+		ff_network_rhs(net, wk->y, wk->res);
+		for (size_t i = 0; i < n; i++)
+			wk->res[i] = wk->psi[i] + gamma * wk->res[i] - wk->y[i];
+		ff_network_solve(net, wk->res);
+		for (size_t i = 0; i < n; i++)
+			wk->y[i] += wk->res[i];
+		const double del = ff_wrms(wk->res, wk->ewt, n);
+		if (!isfinite(del))
+			return 1;
+		if (it > 0) {
+			crate = fmax(0.3 * crate, del / del_prev);
+			if (del > 2.0 * del_prev)
+				return 1;
+		}
+		/* 0.1 of the error-test tolerance, scaled by the convergence rate. */
+		if (del * fmin(1.0, crate) <= 0.1 || del == 0.0)
+			return 0;
+		del_prev = del;
+	}
+	return 1;
+}
+
+int ff_network_integrate(ff_network_t *net, double *Y, double dt) {
+	if (!net || !Y || !(dt >= 0.0) || isinf(dt))
+		return -1;
+	if (dt == 0.0 || net->n == 0)
+		return 0;
+	ff_network_work *wk = net->work;
+	const size_t n = net->n;
+	const ff_network_params *prm = &net->prm;
+
+	ff_network_rhs(net, Y, wk->f);
+	for (size_t i = 0; i < n; i++)
+		wk->ewt[i] = 1.0 / (prm->rtol * fabs(Y[i]) + prm->atol);
+	double h = net->h;
+	if (!(h > 0.0)) {
+		const double d0 = ff_wrms(Y, wk->ewt, n), d1 = ff_wrms(wk->f, wk->ewt, n);
+		h = d0 < 1e-5 || d1 < 1e-5 ? 1e-6 * dt : 0.01 * d0 / d1;
+	}
+
+	double t = 0.0, h_prev = 0.0;
+	int order = 1;
+	size_t steps = 0;
+	while (t < dt) {
+		if (steps++ >= prm->max_steps)
+			return -1;
+		if (prm->h_max > 0.0 && h > prm->h_max)
+			h = prm->h_max;
+		int last = 0;
+		if (t + h >= dt * (1.0 - 1e-12)) {
+			h = dt - t;
+			last = 1;
+		}
+		if (!(h > 0.0) || (t > 0.0 && t + h == t))
+			return -1;
+		for (size_t i = 0; i < n; i++)
+			wk->ewt[i] = 1.0 / (prm->rtol * fabs(Y[i]) + prm->atol);
+
+		/* BDF coefficients and the explicit predictor of the same order. */
+		double gamma;
+		if (order == 1) {
+			gamma = h;
+			for (size_t i = 0; i < n; i++) {
+				wk->psi[i] = Y[i];
+				wk->pred[i] = Y[i] + h * wk->f[i];
+			}
+		} else {
+			const double om = h / h_prev, den = 1.0 + 2.0 * om;
+			gamma = h * (1.0 + om) / den;
+			for (size_t i = 0; i < n; i++) {
+				wk->psi[i] = ((1.0 + om) * (1.0 + om) * Y[i] - om * om * wk->y_prev[i]) / den;
+				const double c = (wk->y_prev[i] - Y[i] + wk->f[i] * h_prev) / (h_prev * h_prev);
+				wk->pred[i] = Y[i] + h * wk->f[i] + c * h * h;
+			}
+		}
+
+		/* Modified Newton on the kept factorization; refresh and retry once. */
+		if (!wk->have_jac || wk->jac_age >= FF_NET_JAC_AGE)
+			ff_network_jacobian(net, Y);
+		int fresh = wk->jac_age == 0, failed;
+		for (;;) {
+			failed = 0;
+			if (!wk->have_lu || fabs(gamma / wk->gamma_lu - 1.0) > FF_NET_GAMMA_DRIFT)
+				failed = ff_network_factor(net, gamma) != 0;
+			if (!failed)
+				failed = ff_network_newton(net, gamma);
+			if (!failed || fresh)
+				break;
+			ff_network_jacobian(net, Y);
+			fresh = 1;
+		}
+		if (failed) {
+			net->n_rejected++;
+			h *= 0.25;
+			continue;
+		}
+
+		for (size_t i = 0; i < n; i++)
+			wk->res[i] = wk->y[i] - wk->pred[i];
+		const double err = (order == 1 ? 0.5 : 0.4) * ff_wrms(wk->res, wk->ewt, n);
+		const double grow = err > 0.0 ? 0.9 * pow(err, -1.0 / (order + 1)) : 5.0;
+		if (err > 1.0) {
+			net->n_rejected++;
+			h *= fmax(0.2, fmin(0.9, grow));
+			continue;
+		}
+
+		for (size_t i = 0; i < n; i++) {
+			wk->y_prev[i] = Y[i];
+			wk->f[i] = (wk->y[i] - wk->psi[i]) / gamma;
+			Y[i] = wk->y[i];
+		}
+		t = last ? dt : t + h;
+		h_prev = h;
+		net->n_steps++;
+		wk->jac_age++;
+		/* BDF2 stays zero-stable for step ratios below 1 + sqrt(2). */
+		h *= fmax(0.2, fmin(order == 1 ? 5.0 : 2.0, grow));
+		order = 2;
+	}
+	net->h = h;
+	return 0;
+}
@@ -0,0 +1,354 @@
+/*
+   fission_fusion_xs.c - Cross-section tables for HOLOS
+
+   Unionized-grid lookup of tabulated cross sections (see fission_fusion.h).
+   Batches locate their energies on the grid in a scalar pass (bin, then a
+   short forward scan) and interpolate in a second pass that is two gathers
+   and a multiply-add per energy, with the slopes precomputed at alloc so
+   the loop has no division or branch and vectorizes.
+
+   Copyright (C) 2025 HOLOS Scientific Computing Project
+
+   This file is part of HOLOS.
+
+   HOLOS is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "core/phys/nuclear/fission_fusion.h"
+
+#define FF_XS_BLOCK 256                 /* Energies per located block */
+#define FF_XS_AMU_MEV 931.49410242      /* Atomic mass unit (MeV/c^2) */
+#define FF_XS_C_CM 2.99792458e10        /* Speed of light (cm/s) */
+#define FF_XS_BARN_CM2 1e-24
+
+static const ff_xs_table_t *ff_xs_default;
+
+/* -------------------------------
+   Construction
+   ------------------------------- */
+
+typedef struct {
+	const ff_cross_section_t *cs;
+	size_t order;
+} ff_xs_point;
+
+static int ff_xs_point_cmp(const void *a, const void *b) {
+	const ff_xs_point *x = a, *y = b;
+	const int c = strncmp(x->cs->label, y->cs->label, sizeof x->cs->label);
+	if (c)
+		return c;
+	if (x->cs->energy != y->cs->energy)
+		return x->cs->energy < y->cs->energy ? -1 : 1;
+	return x->order < y->order ? -1 : (x->order > y->order);
+}
+
+static int ff_xs_double_cmp(const void *a, const void *b) {
+	const double x = *(const double *)a, y = *(const double *)b;
+	return x < y ? -1 : (x > y);
+}
+
+void ff_xs_table_free(ff_xs_table_t *table) {
+	if (!table)
+		return;
+	free(table->labels);
+	free(table->offset);
+	free(table->energy);
+	free(table->value);
+	free(table->slope);
+	free(table->grid);
+	free(table->index);
+	free(table->bin);
+	free(table);
+}
+
+ff_xs_table_t *ff_xs_table_alloc(const ff_cross_section_t *const *cs, size_t n, size_t n_bins) {
+	if (!cs || n == 0)
+		return NULL;
+	size_t np = 0;
+	for (size_t i = 0; i < n; i++) {
+		if (!cs[i])
+			continue;
+		if (!isfinite(cs[i]->energy) || !isfinite(cs[i]->value))
+			return NULL;
+		np++;
+	}
+	if (np == 0 || np >= UINT32_MAX)
+		return NULL;
+
+	ff_xs_point *pts = malloc(np * sizeof *pts);
+	ff_xs_table_t *t = calloc(1, sizeof *t);
+	if (!pts || !t) {
+		free(pts);
+		free(t);
+		return NULL;
+	}
+	np = 0;
+	for (size_t i = 0; i < n; i++)
+		if (cs[i])
+			pts[np++] = (ff_xs_point){ cs[i], i };
+	qsort(pts, np, sizeof *pts, ff_xs_point_cmp);
+
+	size_t nr = 1;
+	for (size_t j = 1; j < np; j++)
+		if (strncmp(pts[j].cs->label, pts[j - 1].cs->label, sizeof pts[j].cs->label))
+			nr++;
+	t->n_reactions = nr;
+	t->labels = calloc(nr, sizeof *t->labels);
+	t->offset = malloc((nr + 1) * sizeof *t->offset);
+	t->energy = malloc(np * sizeof *t->energy);
+	t->value = malloc(np * sizeof *t->value);
+	t->slope = malloc(np * sizeof *t->slope);
+	t->grid = malloc(np * sizeof *t->grid);
+	if (!t->labels || !t->offset || !t->energy || !t->value || !t->slope || !t->grid) {
+		free(pts);
+		ff_xs_table_free(t);
+		return NULL;
+	}
+	size_t r = 0;
+	t->offset[0] = 0;
+	for (size_t j = 0; j < np; j++) {
+		if (j && strncmp(pts[j].cs->label, pts[j - 1].cs->label, sizeof pts[j].cs->label))
+			t->offset[++r] = j;
+		if (j == t->offset[r])
+			memcpy(t->labels[r], pts[j].cs->label, sizeof t->labels[r] - 1);
+		t->energy[j] = pts[j].cs->energy;
+		t->value[j] = pts[j].cs->value;
+		t->grid[j] = pts[j].cs->energy;
+	}
+	t->offset[nr] = np;
+	free(pts);
+	for (r = 0; r < nr; r++)
+		for (size_t j = t->offset[r]; j < t->offset[r + 1]; j++) {
+			const double de = j + 1 < t->offset[r + 1] ? t->energy[j + 1] - t->energy[j] : 0.0;
+			t->slope[j] = de > 0.0 ? (t->value[j + 1] - t->value[j]) / de : 0.0;
+		}
+
+	/* Unionized grid and each reaction's interval at every grid point. */
+	qsort(t->grid, np, sizeof *t->grid, ff_xs_double_cmp);
+	size_t nu = 1;
+	for (size_t j = 1; j < np; j++)
+		if (t->grid[j] != t->grid[nu - 1])
+			t->grid[nu++] = t->grid[j];
+	t->n_union = nu;
+	t->index = malloc(nr * nu * sizeof *t->index);
+	if (!t->index) {
+		ff_xs_table_free(t);
+		return NULL;
+	}
+	for (r = 0; r < nr; r++) {
+		size_t j = t->offset[r];
+		const size_t end = t->offset[r + 1];
+		uint32_t *idx = t->index + r * nu;
+		for (size_t u = 0; u < nu; u++) {
+			while (j + 1 < end && t->energy[j + 1] <= t->grid[u])
+				j++;
+			idx[u] = (uint32_t)j;
+		}
+	}
+
+	/* Bins in ln E over the positive part of the grid. */
+	size_t fp = 0;
+	while (fp < nu && !(t->grid[fp] > 0.0))
+		fp++;
+	t->first_positive = fp;
+	t->n_bins = fp < nu ? (n_bins ? n_bins : nu) : 0;
+	if (t->n_bins) {
+		t->bin = malloc(t->n_bins * sizeof *t->bin);
+		if (!t->bin) {
+			ff_xs_table_free(t);
+			return NULL;
+		}
+		t->log_emin = log(t->grid[fp]);
+		const double dlog = (log(t->grid[nu - 1]) - t->log_emin) / (double)t->n_bins;
+		t->inv_dlog = dlog > 0.0 ? 1.0 / dlog : 0.0;
+		size_t u = fp;
+		for (size_t b = 0; b < t->n_bins; b++) {
+			const double edge = exp(t->log_emin + (double)b * dlog);
+			while (u + 1 < nu && t->grid[u + 1] <= edge)
+				u++;
+			t->bin[b] = (uint32_t)u;
+		}
+	}
+	return t;
+}
+
+long ff_xs_table_find(const ff_xs_table_t *table, const char *label) {
+	if (!table || !label)
+		return -1;
+	size_t lo = 0, hi = table->n_reactions;
+	while (lo < hi) {
+		const size_t mid = lo + (hi - lo) / 2;
+		const int c = strncmp(table->labels[mid], label, sizeof table->labels[mid]);
+		if (c == 0)
+			return (long)mid;
+		if (c < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return -1;
+}
+
+/* -------------------------------
+   Lookup
+   ------------------------------- */
+
+/* Last grid point at or below E, clamped to the grid. */
+static size_t ff_xs_locate(const ff_xs_table_t *t, double E) {
+	const double *g = t->grid;
+	const size_t last = t->n_union - 1;
+	if (!(E > g[0]))
+		return 0;
+	if (E >= g[last])
+		return last;
+	size_t u;
+	if (t->first_positive > last || E < g[t->first_positive]) {
+		size_t lo = 0, hi = t->first_positive;
+		while (hi - lo > 1) {
+			const size_t mid = lo + (hi - lo) / 2;
+			if (g[mid] <= E)
+				lo = mid;
+			else
+				hi = mid;
+		}
+		return lo;
+	}
+	const double x = (log(E) - t->log_emin) * t->inv_dlog;
+	size_t b = x > 0.0 ? (size_t)x : 0;
+	if (b >= t->n_bins)
+		b = t->n_bins - 1;
+	u = t->bin[b];
+	/* log() rounding can land one bin high. */
+	while (u > 0 && g[u] > E)
+		u--;
+	while (g[u + 1] <= E)
+		u++;
+	return u;
+}
+
+double ff_xs_eval(const ff_xs_table_t *table, size_t reaction, double energy) {
+	if (!table || reaction >= table->n_reactions)
+		return 0.0;
+	const double e0 = table->energy[table->offset[reaction]];
+	const double e1 = table->energy[table->offset[reaction + 1] - 1];
+	const double E = energy < e0 ? e0 : (energy > e1 ? e1 : energy);
+	const size_t j = table->index[reaction * table->n_union + ff_xs_locate(table, energy)];
+	return table->value[j] + (E - table->energy[j]) * table->slope[j];
+}
+
+int ff_xs_eval_batch(const ff_xs_table_t *table, size_t reaction, const double *energies, double *out, size_t n,
+                     int n_threads) {
+	if (!table || reaction >= table->n_reactions || (n && (!energies || !out)))
+		return -1;
+	if (n_threads < 0) {
+#ifdef _OPENMP
+		n_threads = omp_get_max_threads();
+#else
+		n_threads = 1;
+#endif
+	}
+	const int nt = n_threads > 0 ? n_threads : 1;
+	const size_t n_blocks = (n + FF_XS_BLOCK - 1) / FF_XS_BLOCK;
+	const uint32_t *idx = table->index + reaction * table->n_union;
+	const double *en = table->energy, *val = table->value, *sl = table->slope;
+	const double e0 = en[table->offset[reaction]], e1 = en[table->offset[reaction + 1] - 1];
+
+	#pragma omp parallel for schedule(static) num_threads(nt) if(nt > 1 && n_blocks > 1)
+	for (size_t c = 0; c < n_blocks; c++) {
+		uint32_t j[FF_XS_BLOCK];
+		double E[FF_XS_BLOCK];
+		const size_t k0 = c * FF_XS_BLOCK, len = n - k0 < FF_XS_BLOCK ? n - k0 : FF_XS_BLOCK;
+		for (size_t k = 0; k < len; k++) {
+			const double e = energies[k0 + k];
+			j[k] = idx[ff_xs_locate(table, e)];
+			E[k] = e < e0 ? e0 : (e > e1 ? e1 : e);
+		}
+		double *o = out + k0;
+		#pragma omp simd
+		for (size_t k = 0; k < len; k++)
+			o[k] = val[j[k]] + (E[k] - en[j[k]]) * sl[j[k]];
+	}
+	return 0;
+}
+
+/* -------------------------------
+   Reactivity and consumers
+   ------------------------------- */
+
+double ff_xs_reactivity(const ff_xs_table_t *table, size_t reaction, double mu, double kT) {
+	if (!table || reaction >= table->n_reactions || !(mu > 0.0) || !(kT > 0.0))
+		return 0.0;
+	/* int (a + s E) E exp(-E/kT) dE from the antiderivatives of E and E^2. */
+	double sum = 0.0;
+	for (size_t j = table->offset[reaction]; j + 1 < table->offset[reaction + 1]; j++) {
+		double lo = table->energy[j];
+		const double hi = table->energy[j + 1];
+		if (!(hi > lo) || hi <= 0.0)
+			continue;
+		if (lo < 0.0)
+			lo = 0.0;
+		const double s = table->slope[j], a = table->value[j] - s * table->energy[j];
+		const double xl = exp(-lo / kT), xh = exp(-hi / kT);
+		const double f1 = kT * (xl * (lo + kT) - xh * (hi + kT));
+		const double f2 = kT * (xl * (lo * lo + 2.0 * kT * lo + 2.0 * kT * kT)
+		                        - xh * (hi * hi + 2.0 * kT * hi + 2.0 * kT * kT));
+		sum += a * f1 + s * f2;
+	}
+	const double mc2 = mu * FF_XS_AMU_MEV;
+	return FF_XS_BARN_CM2 * FF_XS_C_CM * sqrt(8.0 / (M_PI * mc2)) * pow(kT, -1.5) * sum;
+}
+
+void ff_xs_set_default(const ff_xs_table_t *table) {
+	ff_xs_default = table;
+}
+
+double ff_fission_yield(const ff_nucleus_t *nucleus, double energy) {
+	const ff_xs_table_t *t = ff_xs_default;
+	if (!t || !nucleus)
+		return 0.0;
+	char label[32];
+	snprintf(label, sizeof label, "%.*s(n,f)", (int)sizeof nucleus->symbol, nucleus->symbol);
+	const long r = ff_xs_table_find(t, label);
+	return r < 0 ? 0.0 : ff_xs_eval(t, (size_t)r, energy);
+}
+
+static double ff_xs_mass(const ff_nucleus_t *nucleus) {
+	return nucleus->mass > 0.0 ? nucleus->mass : (double)(nucleus->Z + nucleus->N);
+}
+
+double ff_fusion_rate(const ff_nucleus_t *nucleus1, const ff_nucleus_t *nucleus2, double temperature) {
+	const ff_xs_table_t *t = ff_xs_default;
+	if (!t || !nucleus1 || !nucleus2)
+		return 0.0;
+	const int w = (int)sizeof nucleus1->symbol;
+	char label[32];
+	snprintf(label, sizeof label, "%.*s+%.*s", w, nucleus1->symbol, w, nucleus2->symbol);
+	long r = ff_xs_table_find(t, label);
+	if (r < 0) {
+		snprintf(label, sizeof label, "%.*s+%.*s", w, nucleus2->symbol, w, nucleus1->symbol);
+		r = ff_xs_table_find(t, label);
+	}
+	if (r < 0)
+		return 0.0;
+	const double m1 = ff_xs_mass(nucleus1), m2 = ff_xs_mass(nucleus2);
+	return ff_xs_reactivity(t, (size_t)r, m1 * m2 / (m1 + m2), temperature);
+}
@@ -0,0 +1,598 @@
+/*
+   nuclear_depletion.c - CRAM depletion engine for HOLOS
+
+   Sparse transmutation matrix of an nd_system_t and its exponential by the
+   order-16 Chebyshev Rational Approximation in partial-fraction form:
+       exp(A dt) n0 ~ a0 n0 + 2 Re sum_j a_j (A dt - theta_j I)^-1 n0
+   over the 8 poles of the upper half plane.
+   - Nuclides are ordered parents before daughters (Kahn), so a pure decay
+     network is lower triangular and LU adds no fill; cycles (e.g. capture
+     feeding back) are appended and get a symbolic fill pattern
+   - Complex LU without pivoting on the fixed pattern: A dt - theta I is
+     diagonally dominant enough for burnup matrices (Pusa & Leppanen 2010)
+   - The 8 factorizations are independent and split across threads; the
+     partial fractions are summed in pole order, so results do not depend
+     on the thread count
+
+   Copyright (C) 2025 HOLOS Scientific Computing Project
+
+   This file is part of HOLOS.
+
+   HOLOS is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <complex.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "core/phys/nuclear/nuclear_decay.h"
+#include "core/trace/trace.h"
+
+#define ND_CRAM_POLES 8
+
+/* CRAM-16 partial-fraction coefficients (Pusa 2011). */
+static const double nd_cram_theta[ND_CRAM_POLES][2] = {
+	{ -1.0843917078696988026e1, 1.9277446167181652284e1 },
+	{ -5.2649713434426468895e0, 1.6220221473167927305e1 },
+	{  5.9481522689511774808e0, 3.5874573620183222829e0 },
+	{  3.5091036084149180974e0, 8.4361989858843750826e0 },
+	{  6.4161776990994341923e0, 1.1941223933701386874e0 },
+	{  1.4193758971856659786e0, 1.0925363484496722585e1 },
+	{  4.9931747377179963991e0, 5.9968817136039422260e0 },
+	{ -1.4139284624888862114e0, 1.3497725698892745389e1 }
+};
+static const double nd_cram_alpha[ND_CRAM_POLES][2] = {
+	{ -5.0901521865224915650e-7, -2.4220017652852287970e-5 },
+	{  2.1151742182466030907e-4,  4.3892969647380673918e-3 },
+	{  1.1339775178483930527e2,   1.0194721704215856450e2 },
+	{  1.5059585270023467528e1,  -5.7514052776421819979e0 },
+	{ -6.4500878025539646595e1,  -2.2459440762652096056e2 },
+	{ -1.4793007113557999718e0,   1.7686588323782937906e0 },
+	{ -6.2518392463207918892e1,  -1.1190391094283228480e1 },
+	{  4.1023136835410021273e-2, -1.5743466173455468191e-1 }
+};
+static const double nd_cram_alpha0 = 2.1248537104952237488e-16;
+
+/* Ordering, LU pattern and cached numeric factors of one engine. */
+typedef struct {
+	size_t *perm;                   /* perm[k] = nuclide eliminated k-th */
+	size_t *lu_ptr;                 /* Filled pattern in permuted CSR [n + 1] */
+	size_t *lu_col;                 /* Sorted columns per row */
+	size_t *lu_diag;                /* Position of the diagonal per row */
+	size_t *lu_src;                 /* Position in lu_col of each permuted A entry [nnz] */
+	size_t lu_nnz;
+	double complex *lu;             /* ND_CRAM_POLES factors of lu_nnz values */
+	double complex *x;              /* Per-pole solutions [ND_CRAM_POLES * n] */
+	double complex *w;              /* Dense rows, one per thread [n_w * n] */
+	int n_w;
+	double *b;                      /* Permuted right-hand side [n] */
+	double dt;                      /* Step the factors belong to, < 0 if none */
+} nd_depletion_work;
+
+/* -------------------------------
+   Assembly
+   ------------------------------- */
+
+typedef struct {
+	size_t row, col;
+	double val;
+} nd_triplet;
+
+static int nd_triplet_cmp(const void *a, const void *b) {
+	const nd_triplet *x = a, *y = b;
+	if (x->row != y->row)
+		return x->row < y->row ? -1 : 1;
+	return x->col < y->col ? -1 : (x->col > y->col);
+}
+
+typedef struct {
+	const nd_nucleus_t *p;
+	size_t index;
+} nd_nucleus_key;
+
+static int nd_key_ptr_cmp(const void *a, const void *b) {
+	const uintptr_t x = (uintptr_t)((const nd_nucleus_key *)a)->p, y = (uintptr_t)((const nd_nucleus_key *)b)->p;
+	return x < y ? -1 : (x > y);
+}
+
+static int nd_key_nuclide_cmp(const void *a, const void *b) {
+	const nd_nucleus_t *x = ((const nd_nucleus_key *)a)->p, *y = ((const nd_nucleus_key *)b)->p;
+	if (x->Z != y->Z)
+		return x->Z < y->Z ? -1 : 1;
+	if (x->N != y->N)
+		return x->N < y->N ? -1 : 1;
+	return x->energy < y->energy ? -1 : (x->energy > y->energy);
+}
+
+/* Index of nucleus in the system: same pointer, else same Z, N and energy. */
+static int nd_nucleus_lookup(const nd_nucleus_key *by_ptr, const nd_nucleus_key *by_nuclide, size_t n,
+                             const nd_nucleus_t *p, size_t *index) {
+	if (!p)
+		return 0;
+	const nd_nucleus_key key = { p, 0 };
+	const nd_nucleus_key *hit = bsearch(&key, by_ptr, n, sizeof *by_ptr, nd_key_ptr_cmp);
+	if (!hit)
+		hit = bsearch(&key, by_nuclide, n, sizeof *by_nuclide, nd_key_nuclide_cmp);
+	if (!hit)
+		return 0;
+	*index = hit->index;
+	return 1;
+}
+
+/* Triplets of A (diagonal always present); returns the count or -1. */
+static long nd_depletion_triplets(const nd_system_t *system, nd_triplet **out) {
+	const size_t n = system->n_nuclei;
+	size_t cap = n, m = 0;
+	nd_triplet *t = malloc(cap ? cap * sizeof *t : 1);
+	nd_nucleus_key *by_ptr = malloc((n ? n : 1) * sizeof *by_ptr);
+	nd_nucleus_key *by_nuclide = malloc((n ? n : 1) * sizeof *by_nuclide);
+	if (!t || !by_ptr || !by_nuclide) {
+		free(t);
+		free(by_ptr);
+		free(by_nuclide);
+		return -1;
+	}
+	size_t valid = 0;
+	for (size_t i = 0; i < n; i++) {
+		t[m++] = (nd_triplet){ i, i, 0.0 };
+		if (system->nuclei[i]) {
+			by_ptr[valid] = (nd_nucleus_key){ system->nuclei[i], i };
+			by_nuclide[valid++] = (nd_nucleus_key){ system->nuclei[i], i };
+		}
+	}
+	qsort(by_ptr, valid, sizeof *by_ptr, nd_key_ptr_cmp);
+	qsort(by_nuclide, valid, sizeof *by_nuclide, nd_key_nuclide_cmp);
+
+	for (size_t c = 0; c < system->n_chains; c++) {
+		const nd_decay_chain_t *chain = system->chains[c];
+		size_t p;
+		if (!chain || !nd_nucleus_lookup(by_ptr, by_nuclide, valid, chain->parent, &p))
+			continue;
+		for (size_t b = 0; b < chain->n_branches; b++) {
+			const nd_decay_branch_t *br = chain->branches[b];
+			if (!br || !(br->half_life > 0.0) || isinf(br->half_life) || !(br->branching_ratio > 0.0))
+				continue;
+			const double lambda = br->branching_ratio * 0.69314718055994530942 / br->half_life;
+			size_t d;
+			const int has_daughter = nd_nucleus_lookup(by_ptr, by_nuclide, valid, br->daughter, &d);
+			if (has_daughter && d == p)
+				continue;
+			if (m + 2 > cap) {
+				cap = 2 * cap + 2;
+				nd_triplet *grown = realloc(t, cap * sizeof *t);
+				if (!grown) {
+					free(t);
+					free(by_ptr);
+					free(by_nuclide);
+					return -1;
+				}
+				t = grown;
+			}
+			t[m++] = (nd_triplet){ p, p, -lambda };
+			if (has_daughter)
+				t[m++] = (nd_triplet){ d, p, lambda };
+		}
+	}
+	free(by_ptr);
+	free(by_nuclide);
+	qsort(t, m, sizeof *t, nd_triplet_cmp);
+	*out = t;
+	return (long)m;
+}
+
+/* Parents before daughters; nuclides left on cycles follow in index order. */
+static int nd_depletion_order(const nd_depletion_t *dep, size_t *perm) {
+	const size_t n = dep->n;
+	size_t *indeg = calloc(n ? n : 1, sizeof *indeg);
+	size_t *col_ptr = calloc(n + 1, sizeof *col_ptr);
+	size_t *col_row = malloc((dep->nnz ? dep->nnz : 1) * sizeof *col_row);
+	unsigned char *done = calloc(n ? n : 1, 1);
+	if (!indeg || !col_ptr || !col_row || !done) {
+		free(indeg);
+		free(col_ptr);
+		free(col_row);
+		free(done);
+		return -1;
+	}
+	/* Edge p -> d for every off-diagonal A[d][p]; transpose to walk out-edges. */
+	for (size_t i = 0; i < n; i++)
+		for (size_t q = dep->row_ptr[i]; q < dep->row_ptr[i + 1]; q++)
+			if (dep->col[q] != i) {
+				indeg[i]++;
+				col_ptr[dep->col[q] + 1]++;
+			}
+	for (size_t i = 0; i < n; i++)
+		col_ptr[i + 1] += col_ptr[i];
+	size_t *fill = malloc((n ? n : 1) * sizeof *fill);
+	if (!fill) {
+		free(indeg);
+		free(col_ptr);
+		free(col_row);
+		free(done);
+		return -1;
+	}
+	memcpy(fill, col_ptr, n * sizeof *fill);
+	for (size_t i = 0; i < n; i++)
+		for (size_t q = dep->row_ptr[i]; q < dep->row_ptr[i + 1]; q++)
+			if (dep->col[q] != i)
+				col_row[fill[dep->col[q]]++] = i;
+	free(fill);
+
+	/* perm doubles as the Kahn queue. */
+	size_t head = 0, tail = 0;
+	for (size_t i = 0; i < n; i++)
+		if (indeg[i] == 0) {
+			perm[tail++] = i;
+			done[i] = 1;
+		}
+	size_t next = 0;
+	while (tail < n) {
+		while (head < tail) {
+			const size_t p = perm[head++];
+			for (size_t q = col_ptr[p]; q < col_ptr[p + 1]; q++) {
+				const size_t d = col_row[q];
+				if (!done[d] && --indeg[d] == 0) {
+					perm[tail++] = d;
+					done[d] = 1;
+				}
+			}
+		}
+		if (tail == n)
+			break;
+		/* Break a cycle at the lowest pending index. */
+		while (done[next])
+			next++;
+		perm[tail++] = next;
+		done[next] = 1;
+	}
+	free(indeg);
+	free(col_ptr);
+	free(col_row);
+	free(done);
+	return 0;
+}
+
+/* Symbolic no-pivot LU of the permuted matrix: row i gathers the upper
+   pattern of every row k < i it touches, in ascending k. */
+static int nd_depletion_symbolic(const nd_depletion_t *dep, nd_depletion_work *wk) {
+	const size_t n = dep->n;
+	size_t *pos = malloc((n ? n : 1) * sizeof *pos);
+	size_t *link = malloc((n + 1) * sizeof *link);       /* Sorted list of the current row, n terminates */
+	size_t *mark = malloc((n ? n : 1) * sizeof *mark);
+	size_t cap = dep->nnz + n, nnz = 0;
+	wk->lu_ptr = malloc((n + 1) * sizeof *wk->lu_ptr);
+	wk->lu_diag = malloc((n ? n : 1) * sizeof *wk->lu_diag);
+	wk->lu_col = malloc(cap * sizeof *wk->lu_col);
+	wk->lu_src = malloc((dep->nnz ? dep->nnz : 1) * sizeof *wk->lu_src);
+	if (!pos || !link || !mark || !wk->lu_ptr || !wk->lu_diag || !wk->lu_col || !wk->lu_src) {
+		free(pos);
+		free(link);
+		free(mark);
+		return -1;
+	}
+	for (size_t k = 0; k < n; k++) {
+		pos[wk->perm[k]] = k;
+		mark[k] = SIZE_MAX;
+	}
+
+	wk->lu_ptr[0] = 0;
+	for (size_t i = 0; i < n; i++) {
+		const size_t r = wk->perm[i];
+		/* Insert the permuted columns of A row r into the sorted list. */
+		size_t first = n;
+		for (size_t q = dep->row_ptr[r]; q < dep->row_ptr[r + 1]; q++) {
+			const size_t c = pos[dep->col[q]];
+			if (mark[c] == i)
+				continue;
+			mark[c] = i;
+			if (first == n || c < first) {
+				link[c] = first;
+				first = c;
+			} else {
+				size_t at = first;
+				while (link[at] < c)
+					at = link[at];
+				link[c] = link[at];
+				link[at] = c;
+			}
+		}
+		/* Merge U rows of eliminated columns; insertions land after k. */
+		for (size_t k = first; k < i; k = link[k]) {
+			size_t at = k;
+			for (size_t q = wk->lu_diag[k] + 1; q < wk->lu_ptr[k + 1]; q++) {
+				const size_t c = wk->lu_col[q];
+				if (mark[c] == i)
+					continue;
+				mark[c] = i;
+				while (link[at] < c)
+					at = link[at];
+				link[c] = link[at];
+				link[at] = c;
+				at = c;
+			}
+		}
+		for (size_t c = first; c < n; c = link[c]) {
+			if (nnz == cap) {
+				cap *= 2;
+				size_t *grown = realloc(wk->lu_col, cap * sizeof *grown);
+				if (!grown) {
+					free(pos);
+					free(link);
+					free(mark);
+					return -1;
+				}
+				wk->lu_col = grown;
+			}
+			if (c == i)
+				wk->lu_diag[i] = nnz;
+			wk->lu_col[nnz++] = c;
+		}
+		wk->lu_ptr[i + 1] = nnz;
+		for (size_t q = dep->row_ptr[r]; q < dep->row_ptr[r + 1]; q++) {
+			const size_t c = pos[dep->col[q]];
+			size_t lo = wk->lu_ptr[i], hi = nnz;
+			while (wk->lu_col[lo] != c) {
+				const size_t mid = lo + (hi - lo) / 2;
+				if (wk->lu_col[mid] <= c)
+					lo = mid;
+				else
+					hi = mid;
+			}
+			wk->lu_src[q] = lo;
+		}
+	}
+	wk->lu_nnz = nnz;
+	free(pos);
+	free(link);
+	free(mark);
+	return 0;
+}
+
+/* -------------------------------
+   Engine
+   ------------------------------- */
+
+static void nd_depletion_work_free(nd_depletion_work *wk) {
+	if (!wk)
+		return;
+	free(wk->perm);
+	free(wk->lu_ptr);
+	free(wk->lu_col);
+	free(wk->lu_diag);
+	free(wk->lu_src);
+	free(wk->lu);
+	free(wk->x);
+	free(wk->w);
+	free(wk->b);
+	free(wk);
+}
+
+nd_depletion_t *nd_depletion_alloc(const nd_system_t *system) {
+	if (!system || (system->n_nuclei && !system->nuclei) || (system->n_chains && !system->chains))
+		return NULL;
+	nd_depletion_t *dep = calloc(1, sizeof *dep);
+	nd_depletion_work *wk = calloc(1, sizeof *wk);
+	nd_triplet *t = NULL;
+	if (!dep || !wk)
+		goto fail;
+	dep->work = wk;
+	dep->n = system->n_nuclei;
+	const long m = nd_depletion_triplets(system, &t);
+	if (m < 0)
+		goto fail;
+
+	/* Merge duplicates into CSR. */
+	const size_t n = dep->n;
+	dep->row_ptr = calloc(n + 1, sizeof *dep->row_ptr);
+	dep->col = malloc((m ? (size_t)m : 1) * sizeof *dep->col);
+	dep->val = malloc((m ? (size_t)m : 1) * sizeof *dep->val);
+	if (!dep->row_ptr || !dep->col || !dep->val)
+		goto fail;
+	size_t nnz = 0;
+	for (size_t q = 0; q < (size_t)m; q++) {
+		if (nnz && t[q].row == t[q - 1].row && t[q].col == t[q - 1].col) {
+			dep->val[nnz - 1] += t[q].val;
+			continue;
+		}
+		dep->col[nnz] = t[q].col;
+		dep->val[nnz] = t[q].val;
+		dep->row_ptr[t[q].row + 1]++;
+		nnz++;
+	}
+	for (size_t i = 0; i < n; i++)
+		dep->row_ptr[i + 1] += dep->row_ptr[i];
+	dep->nnz = nnz;
+	free(t);
+	t = NULL;
+
+	wk->dt = -1.0;
+	wk->perm = malloc((n ? n : 1) * sizeof *wk->perm);
+	wk->b = malloc((n ? n : 1) * sizeof *wk->b);
+	wk->x = malloc((n ? n : 1) * ND_CRAM_POLES * sizeof *wk->x);
+	if (!wk->perm || !wk->b || !wk->x)
+		goto fail;
+	if (nd_depletion_order(dep, wk->perm) != 0 || nd_depletion_symbolic(dep, wk) != 0)
+		goto fail;
+	wk->lu = malloc((wk->lu_nnz ? wk->lu_nnz : 1) * ND_CRAM_POLES * sizeof *wk->lu);
+	if (!wk->lu)
+		goto fail;
+	if (nd_depletion_set_threads(dep, 0) != 0)
+		goto fail;
+	return dep;
+
+fail:
+	free(t);
+	nd_depletion_free(dep);
+	if (!dep)
+		nd_depletion_work_free(wk);
+	return NULL;
+}
+
+void nd_depletion_free(nd_depletion_t *dep) {
+	if (!dep)
+		return;
+	nd_depletion_work_free(dep->work);
+	free(dep->row_ptr);
+	free(dep->col);
+	free(dep->val);
+	free(dep);
+}
+
+int nd_depletion_set_threads(nd_depletion_t *dep, int n_threads) {
+	if (!dep)
+		return -1;
+	if (n_threads < 0) {
+#ifdef _OPENMP
+		n_threads = omp_get_max_threads();
+#else
+		n_threads = 1;
+#endif
+	}
+	nd_depletion_work *wk = dep->work;
+	const int n_w = n_threads > 0 ? (n_threads < ND_CRAM_POLES ? n_threads : ND_CRAM_POLES) : 1;
+	if (n_w != wk->n_w) {
+		double complex *w = malloc((dep->n ? dep->n : 1) * (size_t)n_w * sizeof *w);
+		if (!w)
+			return -1;
+		free(wk->w);
+		wk->w = w;
+		wk->n_w = n_w;
+	}
+	dep->n_threads = n_threads;
+	return 0;
+}
+
+/* Numeric LU of A dt - theta I on the fixed pattern (row-wise IKJ). */
+static void nd_depletion_factor(const nd_depletion_t *dep, const nd_depletion_work *wk, double dt,
+                                double complex theta, double complex *lu, double complex *w) {
+	const size_t n = dep->n;
+	for (size_t q = 0; q < wk->lu_nnz; q++)
+		lu[q] = 0.0;
+	for (size_t i = 0; i < n; i++) {
+		const size_t r = wk->perm[i];
+		for (size_t q = dep->row_ptr[r]; q < dep->row_ptr[r + 1]; q++)
+			lu[wk->lu_src[q]] = dt * dep->val[q];
+		lu[wk->lu_diag[i]] -= theta;
+
+		const size_t p0 = wk->lu_ptr[i], p1 = wk->lu_ptr[i + 1];
+		for (size_t q = p0; q < p1; q++)
+			w[wk->lu_col[q]] = lu[q];
+		for (size_t q = p0; q < wk->lu_diag[i]; q++) {
+			const size_t k = wk->lu_col[q];
+			const double complex l = w[k] / lu[wk->lu_diag[k]];
+			w[k] = l;
+			for (size_t u = wk->lu_diag[k] + 1; u < wk->lu_ptr[k + 1]; u++)
+				w[wk->lu_col[u]] -= l * lu[u];
+		}
+		for (size_t q = p0; q < p1; q++)
+			lu[q] = w[wk->lu_col[q]];
+	}
+}
+
+/* x = (L U)^-1 b with unit-diagonal L. */
+static void nd_depletion_solve(const nd_depletion_t *dep, const nd_depletion_work *wk, const double complex *lu,
+                               const double *b, double complex *x) {
+	const size_t n = dep->n;
+	for (size_t i = 0; i < n; i++) {
+		double complex s = b[i];
+		for (size_t q = wk->lu_ptr[i]; q < wk->lu_diag[i]; q++)
+			s -= lu[q] * x[wk->lu_col[q]];
+		x[i] = s;
+	}
+	for (size_t i = n; i-- > 0;) {
+		double complex s = x[i];
+		for (size_t q = wk->lu_diag[i] + 1; q < wk->lu_ptr[i + 1]; q++)
+			s -= lu[q] * x[wk->lu_col[q]];
+		x[i] = s / lu[wk->lu_diag[i]];
+	}
+}
+
+int nd_depletion_step(nd_depletion_t *dep, double dt, const double *n0, double *n1) {
+    HOLOS_TRACE_ZONE("nd_depletion_step");
+	if (!dep || !n0 || !n1 || !(dt >= 0.0) || isinf(dt))
+		return -1;
+	nd_depletion_work *wk = dep->work;
+	const size_t n = dep->n;
+	if (dt == 0.0) {
+		if (n1 != n0)
+			memmove(n1, n0, n * sizeof *n1);
+		return 0;
+	}
+	for (size_t k = 0; k < n; k++)
+		wk->b[k] = n0[wk->perm[k]];
+
+	const int refactor = wk->dt != dt;
+	const int nt = wk->n_w;
+	#pragma omp parallel for schedule(static, 1) num_threads(nt) if(nt > 1)
+	for (int j = 0; j < ND_CRAM_POLES; j++) {
+#ifdef _OPENMP
+		double complex *w = wk->w + (size_t)omp_get_thread_num() * n;
+#else
+		double complex *w = wk->w;
+#endif
+		double complex *lu = wk->lu + (size_t)j * wk->lu_nnz;
+		if (refactor)
+			nd_depletion_factor(dep, wk, dt, nd_cram_theta[j][0] + I * nd_cram_theta[j][1], lu, w);
+		nd_depletion_solve(dep, wk, lu, wk->b, wk->x + (size_t)j * n);
+	}
+	wk->dt = dt;
+
+	for (size_t k = 0; k < n; k++) {
+		double s = nd_cram_alpha0 * wk->b[k];
+		for (int j = 0; j < ND_CRAM_POLES; j++) {
+			const double complex a = nd_cram_alpha[j][0] + I * nd_cram_alpha[j][1];
+			s += 2.0 * creal(a * wk->x[(size_t)j * n + k]);
+		}
+		n1[wk->perm[k]] = s;
+	}
+	return 0;
+}
+
+int nd_step_decay(nd_system_t *system, double dt) {
+	if (!system || (system->n_nuclei && !system->abundances))
+		return -1;
+	nd_depletion_t *dep = system->depletion;
+	if (dep && dep->n != system->n_nuclei) {
+		nd_step_decay_release(system);
+		dep = NULL;
+	}
+	if (!dep) {
+		if (!(dep = nd_depletion_alloc(system)))
+			return -1;
+		system->depletion = dep;
+	}
+	if (nd_depletion_step(dep, dt, system->abundances, system->abundances) != 0)
+		return -1;
+
+	/* The diagonal of A is minus the total decay constant of each nuclide. */
+	double activity = 0.0;
+	for (size_t i = 0; i < dep->n; i++)
+		for (size_t q = dep->row_ptr[i]; q < dep->row_ptr[i + 1]; q++)
+			if (dep->col[q] == i)
+				activity -= dep->val[q] * system->abundances[i];
+	system->diagnostics.total_activity = activity;
+	return 0;
+}
+
+void nd_step_decay_release(nd_system_t *system) {
+	if (!system)
+		return;
+	nd_depletion_free(system->depletion);
+	system->depletion = NULL;
+}
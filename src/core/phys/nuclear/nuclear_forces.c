@@ -0,0 +1,328 @@
+/*
+   nuclear_forces.c - Nuclear forces module for HOLOS
+
+   Tabulated potentials (see nuclear_forces.h): potential_fn and tensor_fn
+   are fit once by clamped cubic splines on a uniform grid, stored as four
+   polynomial coefficients per interval so an evaluation is an index, a
+   gather and a Horner step. Batches split off out-of-range distances in a
+   scalar pass and evaluate the rest in a simd loop; the pair sums of
+   nf_binding_energy() go through those batches one row at a time.
+
+   Copyright (C) 2025 HOLOS Scientific Computing Project
+
+   This file is part of HOLOS.
+
+   HOLOS is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <math.h>
+
+#include "core/phys/nuclear/nuclear_forces.h"
+
+#define NF_SPLINE_MIN 16                /* First grid tried, in intervals */
+#define NF_SPLINE_MAX ((size_t)1 << 20) /* Largest grid tried */
+#define NF_EVAL_BLOCK 256               /* Distances per batch block */
+#define NF_DIFF_STEP 6e-6               /* Relative step of the central differences, ~cbrt(eps) */
+
+/* Clamped cubic spline: V = c0 + t (c1 + t (c2 + t c3)) on interval i,
+   t = (r - r_min) / h - i. */
+typedef struct {
+	double r_min, r_max, inv_h;
+	size_t n;
+	double *c;
+} nf_spline;
+
+typedef struct {
+	nf_spline pot;
+	nf_spline tensor;
+	int has_tensor;
+} nf_potential_table;
+
+/* -------------------------------
+   Spline fitting
+   ------------------------------- */
+
+static int nf_spline_fit(nf_spline *s, double (*fn)(double, void *), void *params, double r_min, double r_max,
+                         size_t n) {
+	const double h = (r_max - r_min) / (double)n;
+	double *f = malloc((n + 1) * sizeof *f), *m = malloc((n + 1) * sizeof *m), *cp = malloc((n + 1) * sizeof *cp);
+	double *c = malloc(4 * n * sizeof *c);
+	if (!f || !m || !cp || !c) {
+		free(f);
+		free(m);
+		free(cp);
+		free(c);
+		return -1;
+	}
+	for (size_t i = 0; i <= n; i++) {
+		f[i] = fn(i == n ? r_max : r_min + (double)i * h, params);
+		if (!isfinite(f[i])) {
+			free(f);
+			free(m);
+			free(cp);
+			free(c);
+			return -1;
+		}
+	}
+	/* End slopes from fourth-order one-sided differences. */
+	const double d0 = (-25.0 * f[0] + 48.0 * f[1] - 36.0 * f[2] + 16.0 * f[3] - 3.0 * f[4]) / (12.0 * h);
+	const double dn = (25.0 * f[n] - 48.0 * f[n - 1] + 36.0 * f[n - 2] - 16.0 * f[n - 3] + 3.0 * f[n - 4])
+	                  / (12.0 * h);
+	/* Second derivatives: Thomas sweep of the clamped tridiagonal system. */
+	const double k = 6.0 / (h * h);
+	cp[0] = 0.5;
+	m[0] = 0.5 * k * (f[1] - f[0] - h * d0);
+	for (size_t i = 1; i < n; i++) {
+		const double den = 4.0 - cp[i - 1];
+		cp[i] = 1.0 / den;
+		m[i] = (k * (f[i + 1] - 2.0 * f[i] + f[i - 1]) - m[i - 1]) / den;
+	}
+	m[n] = (k * (h * dn - f[n] + f[n - 1]) - m[n - 1]) / (2.0 - cp[n - 1]);
+	for (size_t i = n; i-- > 0;)
+		m[i] -= cp[i] * m[i + 1];
+
+	const double h2 = h * h;
+	for (size_t i = 0; i < n; i++) {
+		c[4 * i] = f[i];
+		c[4 * i + 1] = f[i + 1] - f[i] - h2 * (2.0 * m[i] + m[i + 1]) / 6.0;
+		c[4 * i + 2] = 0.5 * h2 * m[i];
+		c[4 * i + 3] = h2 * (m[i + 1] - m[i]) / 6.0;
+	}
+	free(f);
+	free(m);
+	free(cp);
+	s->r_min = r_min;
+	s->r_max = r_max;
+	s->inv_h = 1.0 / h;
+	s->n = n;
+	s->c = c;
+	return 0;
+}
+
+/* r within [r_min, r_max]. */
+static inline double nf_spline_eval(const nf_spline *s, double r, double *dvdr) {
+	const double x = (r - s->r_min) * s->inv_h;
+	size_t i = (size_t)x;
+	i = i < s->n ? i : s->n - 1;
+	const double t = x - (double)i, *c = s->c + 4 * i;
+	if (dvdr)
+		*dvdr = (c[1] + t * (2.0 * c[2] + 3.0 * t * c[3])) * s->inv_h;
+	return c[0] + t * (c[1] + t * (c[2] + t * c[3]));
+}
+
+/* Fit on grids of doubling size until the quarter points are within tolerance. */
+static int nf_spline_build(nf_spline *s, double (*fn)(double, void *), void *params, double r_min, double r_max,
+                           double rtol, double atol) {
+	for (size_t n = NF_SPLINE_MIN; n <= NF_SPLINE_MAX; n *= 2) {
+		if (nf_spline_fit(s, fn, params, r_min, r_max, n) != 0)
+			return -1;
+		const double h = (r_max - r_min) / (double)n;
+		int ok = 1;
+		for (size_t i = 0; i < n && ok; i++)
+			for (int q = 1; q <= 3 && ok; q++) {
+				const double r = r_min + ((double)i + 0.25 * q) * h, v = fn(r, params);
+				if (!isfinite(v)) {
+					free(s->c);
+					s->c = NULL;
+					return -1;
+				}
+				ok = fabs(nf_spline_eval(s, r, NULL) - v) <= rtol * fabs(v) + atol;
+			}
+		if (ok)
+			return 0;
+		free(s->c);
+		s->c = NULL;
+	}
+	return -1;
+}
+
+int nf_potential_tabulate(nf_potential_t *pot, double r_min, double r_max, double rtol, double atol) {
+	if (!pot || !pot->potential_fn || !isfinite(r_min) || !isfinite(r_max) || !(r_max > r_min)
+	    || !(rtol >= 0.0) || !(atol >= 0.0) || !(rtol + atol > 0.0))
+		return -1;
+	nf_potential_table *tab = calloc(1, sizeof *tab);
+	if (!tab)
+		return -1;
+	if (nf_spline_build(&tab->pot, pot->potential_fn, pot->params, r_min, r_max, rtol, atol) != 0
+	    || (pot->tensor_fn
+	        && nf_spline_build(&tab->tensor, pot->tensor_fn, pot->params, r_min, r_max, rtol, atol) != 0)) {
+		free(tab->pot.c);
+		free(tab);
+		return -1;
+	}
+	tab->has_tensor = pot->tensor_fn != NULL;
+	nf_potential_untabulate(pot);
+	pot->table = tab;
+	return 0;
+}
+
+void nf_potential_untabulate(nf_potential_t *pot) {
+	if (!pot || !pot->table)
+		return;
+	nf_potential_table *tab = pot->table;
+	free(tab->pot.c);
+	free(tab->tensor.c);
+	free(tab);
+	pot->table = NULL;
+}
+
+/* -------------------------------
+   Evaluation
+   ------------------------------- */
+
+static double nf_callback_eval(double (*fn)(double, void *), void *params, double r, double *dvdr) {
+	if (dvdr) {
+		const double d = NF_DIFF_STEP * (fabs(r) > 1.0 ? fabs(r) : 1.0);
+		*dvdr = (fn(r + d, params) - fn(r - d, params)) / (2.0 * d);
+	}
+	return fn(r, params);
+}
+
+static double nf_channel_eval(const nf_spline *s, double (*fn)(double, void *), void *params, double r,
+                              double *dvdr) {
+	if (s && r >= s->r_min && r <= s->r_max)
+		return nf_spline_eval(s, r, dvdr);
+	if (!fn) {
+		if (dvdr)
+			*dvdr = 0.0;
+		return 0.0;
+	}
+	return nf_callback_eval(fn, params, r, dvdr);
+}
+
+double nf_potential_eval(const nf_potential_t *pot, double r, double *dvdr) {
+	if (!pot)
+		return 0.0;
+	const nf_potential_table *tab = pot->table;
+	return nf_channel_eval(tab ? &tab->pot : NULL, pot->potential_fn, pot->params, r, dvdr);
+}
+
+double nf_potential_eval_tensor(const nf_potential_t *pot, double r, double *dvdr) {
+	if (!pot)
+		return 0.0;
+	const nf_potential_table *tab = pot->table;
+	return nf_channel_eval(tab && tab->has_tensor ? &tab->tensor : NULL, pot->tensor_fn, pot->params, r, dvdr);
+}
+
+int nf_potential_eval_batch(const nf_potential_t *pot, const double *r, double *v, double *dvdr, size_t n) {
+	if (!pot || (n && (!r || !v)))
+		return -1;
+	const nf_potential_table *tab = pot->table;
+	if (!tab) {
+		for (size_t k = 0; k < n; k++)
+			v[k] = nf_potential_eval(pot, r[k], dvdr ? &dvdr[k] : NULL);
+		return 0;
+	}
+	const nf_spline *s = &tab->pot;
+	const double r0 = s->r_min, r1 = s->r_max, inv_h = s->inv_h, *coef = s->c;
+	const size_t last = s->n - 1;
+	for (size_t k0 = 0; k0 < n; k0 += NF_EVAL_BLOCK) {
+		const size_t len = n - k0 < NF_EVAL_BLOCK ? n - k0 : NF_EVAL_BLOCK;
+		double x[NF_EVAL_BLOCK];
+		size_t out[NF_EVAL_BLOCK], n_out = 0;
+		for (size_t k = 0; k < len; k++) {
+			const double rk = r[k0 + k];
+			const int in = rk >= r0 && rk <= r1;
+			x[k] = in ? (rk - r0) * inv_h : 0.0;
+			out[n_out] = k;
+			n_out += !in;
+		}
+		double *vo = v + k0;
+		if (dvdr) {
+			double *dvo = dvdr + k0;
+			#pragma omp simd
+			for (size_t k = 0; k < len; k++) {
+				size_t i = (size_t)x[k];
+				i = i < last ? i : last;
+				const double t = x[k] - (double)i, *c = coef + 4 * i;
+				vo[k] = c[0] + t * (c[1] + t * (c[2] + t * c[3]));
+				dvo[k] = (c[1] + t * (2.0 * c[2] + 3.0 * t * c[3])) * inv_h;
+			}
+		} else {
+			#pragma omp simd
+			for (size_t k = 0; k < len; k++) {
+				size_t i = (size_t)x[k];
+				i = i < last ? i : last;
+				const double t = x[k] - (double)i, *c = coef + 4 * i;
+				vo[k] = c[0] + t * (c[1] + t * (c[2] + t * c[3]));
+			}
+		}
+		for (size_t q = 0; q < n_out; q++) {
+			const size_t k = k0 + out[q];
+			v[k] = nf_callback_eval(pot->potential_fn, pot->params, r[k], dvdr ? &dvdr[k] : NULL);
+		}
+	}
+	return 0;
+}
+
+/* -------------------------------
+   Pair sums
+   ------------------------------- */
+
+static int nf_position(const nf_nucleon_t *n, double x[3]) {
+	if (!n || !n->position || n->position->size < 3)
+		return 0;
+	for (int d = 0; d < 3; d++)
+		x[d] = n->position->data[d * n->position->stride];
+	return 1;
+}
+
+double nf_pair_potential(const nf_nucleon_t *n1, const nf_nucleon_t *n2, const nf_potential_t *pot) {
+	double a[3], b[3];
+	if (!pot || !nf_position(n1, a) || !nf_position(n2, b))
+		return 0.0;
+	const double dx = a[0] - b[0], dy = a[1] - b[1], dz = a[2] - b[2];
+	return nf_potential_eval(pot, sqrt(dx * dx + dy * dy + dz * dz), NULL);
+}
+
+double nf_binding_energy(const nf_system_t *system) {
+	if (!system || !system->nucleons || system->n_nucleons < 2)
+		return 0.0;
+	const size_t n = system->n_nucleons;
+	double *x = malloc(3 * n * sizeof *x);
+	if (!x)
+		return 0.0;
+	size_t m = 0;
+	for (size_t i = 0; i < n; i++)
+		m += nf_position(system->nucleons[i], x + 3 * m);
+
+	double energy = 0.0;
+	for (size_t f = 0; f < system->n_force_models; f++) {
+		const nf_force_model_t *model = system->force_models ? system->force_models[f] : NULL;
+		if (!model || !model->potential)
+			continue;
+		const double scale = model->coupling_constant != 0.0 ? model->coupling_constant : 1.0;
+		double sum = 0.0;
+		for (size_t i = 0; i + 1 < m; i++) {
+			const double *xi = x + 3 * i;
+			for (size_t j0 = i + 1; j0 < m; j0 += NF_EVAL_BLOCK) {
+				const size_t len = m - j0 < NF_EVAL_BLOCK ? m - j0 : NF_EVAL_BLOCK;
+				double r[NF_EVAL_BLOCK], v[NF_EVAL_BLOCK];
+				#pragma omp simd
+				for (size_t k = 0; k < len; k++) {
+					const double *xj = x + 3 * (j0 + k);
+					const double dx = xi[0] - xj[0], dy = xi[1] - xj[1], dz = xi[2] - xj[2];
+					r[k] = sqrt(dx * dx + dy * dy + dz * dz);
+				}
+				nf_potential_eval_batch(model->potential, r, v, NULL, len);
+				for (size_t k = 0; k < len; k++)
+					sum += v[k];
+			}
+		}
+		energy += scale * sum;
+	}
+	free(x);
+	return -energy;
+}
@@ -0,0 +1,555 @@
+/* obs_stream.c - Streaming observable sink for HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+   ----------------------------------------------------------------------
+   A ring slot belongs to the producer until it is marked ready, then to
+   the writer until it is marked free again; both marks are taken under
+   the stream lock, so filling a slot and encoding one need no locking.
+   The producer locks only to hand over a chunk or to wait for a slot.
+
+   Blocks after the file header:
+     'D' u32 id, u32 values per record, u32 reduce, u64 decimate,
+         u32 name length, name
+     'C' u32 id, u32 records, u8 raw, u64 payload bytes, payload
+   A record is (t, values...). A raw payload is the records as doubles;
+   an encoded one is column by column, each word XORed with the word
+   above it (0 above the first record), stored as a 4-bit count of its
+   significant bytes (two per byte, low nibble first) followed by all
+   the low-order significant bytes.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "core/phys/obs_stream.h"
+
+#define OBS_MAGIC "HOLOSOBS"
+#define OBS_VERSION 1u
+#define OBS_CHUNK_RECORDS 256       /* Default records per chunk */
+#define OBS_RING_CHUNKS 4           /* Default chunks per ring */
+#define OBS_MAX_SERIES 256          /* Observables per stream */
+
+typedef struct {
+    char name[64];
+    size_t width, out, stride;      /* Values per push, per record; doubles per record (1 + out) */
+    size_t decimate;
+    obs_reduce_t reduce;
+    size_t count;                   /* Pushes into the current window */
+    double t_last;                  /* Time of the last push (OBS_STATS) */
+    double *acc;                    /* Window min, max, sum (OBS_STATS) */
+    double *ring;                   /* [ring_chunks][chunk_records][stride] */
+    size_t *fill;                   /* Records per slot */
+    unsigned char *ready;           /* Slot handed to the writer */
+    size_t head, tail;              /* Producer slot, next slot to write */
+    int have;                       /* Producer owns slot head */
+    int declared;
+    size_t n_pushed, n_dropped;
+} obs_series;
+
+typedef struct {
+    FILE *fp;
+    size_t chunk_records, ring_chunks;
+    int drop, raw;
+    obs_series *series[OBS_MAX_SERIES];
+    size_t n_series;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t work, space;
+    size_t n_ready;                 /* Slots marked ready, all series */
+    int stop, error;
+    size_t n_chunks, bytes;
+    unsigned char *buf;
+    size_t buf_cap;
+} obs_work;
+
+/* -------------------------------
+   Chunk coding
+   ------------------------------- */
+
+/* Significant bytes of x. */
+static inline unsigned obs_bytes(uint64_t x) {
+#if defined(__GNUC__)
+    return x ? (71u - (unsigned)__builtin_clzll(x)) / 8u : 0u;
+#else
+    unsigned nb = 0;
+    while (nb < 8 && x >> (8 * nb)) nb++;
+    return nb;
+#endif
+}
+
+static size_t obs_encode(const double *rec, size_t n, size_t stride, unsigned char *out) {
+    const size_t words = n * stride;
+    unsigned char *ctl = out, *data = out + (words + 1) / 2;
+    memset(ctl, 0, (words + 1) / 2);
+    size_t k = 0;
+    for (size_t c = 0; c < stride; c++) {
+        uint64_t prev = 0;
+        for (size_t r = 0; r < n; r++, k++) {
+            uint64_t u;
+            memcpy(&u, rec + r * stride + c, sizeof u);
+            uint64_t x = u ^ prev;
+            prev = u;
+            const unsigned nb = obs_bytes(x);
+            ctl[k / 2] |= (unsigned char)(nb << (4 * (k & 1)));
+            for (unsigned b = 0; b < nb; b++) data[b] = (unsigned char)(x >> (8 * b));
+            data += nb;
+        }
+    }
+    return (size_t)(data - out);
+}
+
+/* -1 if the payload is short or has bytes left over. */
+static int obs_decode(const unsigned char *in, size_t size, size_t n, size_t stride, double *rec) {
+    const size_t words = n * stride, nctl = (words + 1) / 2;
+    if (size < nctl) return -1;
+    const unsigned char *data = in + nctl, *end = in + size;
+    size_t k = 0;
+    for (size_t c = 0; c < stride; c++) {
+        uint64_t prev = 0;
+        for (size_t r = 0; r < n; r++, k++) {
+            const unsigned nb = (in[k / 2] >> (4 * (k & 1))) & 0xF;
+            if (nb > 8 || (size_t)(end - data) < nb) return -1;
+            uint64_t x = 0;
+            for (unsigned b = 0; b < nb; b++) x |= (uint64_t)*data++ << (8 * b);
+            prev ^= x;
+            memcpy(rec + r * stride + c, &prev, sizeof prev);
+        }
+    }
+    return data == end ? 0 : -1;
+}
+
+/* -------------------------------
+   Writer thread
+   ------------------------------- */
+
+static int obs_write_decl(obs_work *w, size_t id, const obs_series *o) {
+    const uint32_t id32 = (uint32_t)id, out = (uint32_t)o->out, reduce = (uint32_t)o->reduce;
+    const uint64_t dec = o->decimate;
+    const uint32_t len = (uint32_t)strlen(o->name);
+    return fputc('D', w->fp) != EOF && fwrite(&id32, sizeof id32, 1, w->fp) == 1
+           && fwrite(&out, sizeof out, 1, w->fp) == 1 && fwrite(&reduce, sizeof reduce, 1, w->fp) == 1
+           && fwrite(&dec, sizeof dec, 1, w->fp) == 1 && fwrite(&len, sizeof len, 1, w->fp) == 1
+           && fwrite(o->name, 1, len, w->fp) == len ? 0 : -1;
+}
+
+/* Writes slot of series id; returns the bytes written, 0 on failure. */
+static size_t obs_write_chunk(obs_work *w, size_t id, obs_series *o, size_t slot) {
+    const size_t n = o->fill[slot];
+    const double *rec = o->ring + slot * w->chunk_records * o->stride;
+    size_t size = n * o->stride * sizeof(double);
+    const void *payload = rec;
+    if (!w->raw) {
+        const size_t need = (n * o->stride + 1) / 2 + n * o->stride * 8;
+        if (need > w->buf_cap) {
+            unsigned char *b = realloc(w->buf, need);
+            if (!b) return 0;
+            w->buf = b;
+            w->buf_cap = need;
+        }
+        size = obs_encode(rec, n, o->stride, w->buf);
+        payload = w->buf;
+    }
+    size_t head = 0;
+    if (!o->declared) {
+        if (obs_write_decl(w, id, o) != 0) return 0;
+        o->declared = 1;
+        head += 25 + strlen(o->name);
+    }
+    const uint32_t id32 = (uint32_t)id, n32 = (uint32_t)n;
+    const unsigned char raw = (unsigned char)(w->raw != 0);
+    const uint64_t size64 = size;
+    if (fputc('C', w->fp) == EOF || fwrite(&id32, sizeof id32, 1, w->fp) != 1 || fwrite(&n32, sizeof n32, 1, w->fp) != 1
+        || fwrite(&raw, 1, 1, w->fp) != 1 || fwrite(&size64, sizeof size64, 1, w->fp) != 1
+        || fwrite(payload, 1, size, w->fp) != size)
+        return 0;
+    return head + 18 + size;
+}
+
+static void *obs_writer(void *arg) {
+    obs_work *w = arg;
+    pthread_mutex_lock(&w->lock);
+    for (;;) {
+        while (!w->n_ready && !w->stop) pthread_cond_wait(&w->work, &w->lock);
+        if (!w->n_ready) break;
+        for (size_t i = 0; i < w->n_series; i++) {
+            obs_series *o = w->series[i];
+            while (o->ready[o->tail]) {
+                const size_t slot = o->tail;
+                pthread_mutex_unlock(&w->lock);
+                const size_t bytes = obs_write_chunk(w, i, o, slot);
+                pthread_mutex_lock(&w->lock);
+                if (!bytes) w->error = 1;
+                w->bytes += bytes;
+                w->n_chunks += bytes != 0;
+                o->fill[slot] = 0;
+                o->ready[slot] = 0;
+                o->tail = (slot + 1) % w->ring_chunks;
+                w->n_ready--;
+                pthread_cond_broadcast(&w->space);
+            }
+        }
+    }
+    pthread_mutex_unlock(&w->lock);
+    return NULL;
+}
+
+/* -------------------------------
+   Producer side
+   ------------------------------- */
+
+/* Marks the producer slot ready (lock held) and takes the next one if free. */
+static void obs_hand_over(obs_work *w, obs_series *o) {
+    o->ready[o->head] = 1;
+    w->n_ready++;
+    o->head = (o->head + 1) % w->ring_chunks;
+    o->have = !o->ready[o->head];
+    pthread_cond_signal(&w->work);
+}
+
+/* Slot for the next record: 0, 1 to drop it, or -1 after a write error. */
+static int obs_slot(obs_work *w, obs_series *o) {
+    if (o->have) return 0;
+    pthread_mutex_lock(&w->lock);
+    while (o->ready[o->head] && !w->drop && !w->error) pthread_cond_wait(&w->space, &w->lock);
+    o->have = !o->ready[o->head];
+    const int rc = w->error ? -1 : o->have ? 0 : 1;
+    pthread_mutex_unlock(&w->lock);
+    return rc;
+}
+
+static int obs_store(obs_work *w, obs_series *o, double t, const double *v) {
+    const int rc = obs_slot(w, o);
+    if (rc) {
+        o->n_dropped += rc > 0;
+        return rc < 0 ? -1 : 0;
+    }
+    double *rec = o->ring + (o->head * w->chunk_records + o->fill[o->head]) * o->stride;
+    rec[0] = t;
+    memcpy(rec + 1, v, o->out * sizeof *v);
+    if (++o->fill[o->head] == w->chunk_records) {
+        pthread_mutex_lock(&w->lock);
+        obs_hand_over(w, o);
+        pthread_mutex_unlock(&w->lock);
+    }
+    return 0;
+}
+
+/* Closes the OBS_STATS window: min, max, mean into acc order. */
+static int obs_stats_emit(obs_work *w, obs_series *o, double t) {
+    const size_t n = o->width;
+    double *sum = o->acc + 2 * n;
+    const double inv = 1.0 / (double)o->count;
+    for (size_t k = 0; k < n; k++) sum[k] *= inv;
+    o->count = 0;
+    return obs_store(w, o, t, o->acc);
+}
+
+/* -------------------------------
+   Public API
+   ------------------------------- */
+
+static void obs_series_free(obs_series *o) {
+    if (!o) return;
+    free(o->acc);
+    free(o->ring);
+    free(o->fill);
+    free(o->ready);
+    free(o);
+}
+
+obs_stream *obs_stream_open(const char *path, const obs_stream_params *prm) {
+    if (!path) return NULL;
+    obs_stream *s = calloc(1, sizeof *s);
+    obs_work *w = calloc(1, sizeof *w);
+    if (!s || !w) {
+        free(s);
+        free(w);
+        return NULL;
+    }
+    w->chunk_records = prm && prm->chunk_records ? prm->chunk_records : OBS_CHUNK_RECORDS;
+    w->ring_chunks = prm && prm->ring_chunks ? prm->ring_chunks : OBS_RING_CHUNKS;
+    w->drop = prm && prm->drop;
+    w->raw = prm && prm->raw;
+    const uint32_t version = OBS_VERSION;
+    w->fp = w->chunk_records <= UINT32_MAX ? fopen(path, "wb") : NULL;
+    if (!w->fp || fwrite(OBS_MAGIC, 1, 8, w->fp) != 8 || fwrite(&version, sizeof version, 1, w->fp) != 1) {
+        if (w->fp) fclose(w->fp);
+        free(s);
+        free(w);
+        return NULL;
+    }
+    w->bytes = 12;
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->work, NULL);
+    pthread_cond_init(&w->space, NULL);
+    if (pthread_create(&w->thread, NULL, obs_writer, w) != 0) {
+        pthread_mutex_destroy(&w->lock);
+        pthread_cond_destroy(&w->work);
+        pthread_cond_destroy(&w->space);
+        fclose(w->fp);
+        free(s);
+        free(w);
+        return NULL;
+    }
+    s->work = w;
+    s->bytes = w->bytes;
+    return s;
+}
+
+int obs_stream_add(obs_stream *s, const char *name, size_t width, size_t decimate, obs_reduce_t reduce) {
+    if (!s || !name || strlen(name) >= 64 || width == 0 || (reduce != OBS_SAMPLE && reduce != OBS_STATS)) return -1;
+    obs_work *w = s->work;
+    const size_t out = reduce == OBS_STATS ? 3 * width : width;
+    if (out >= SIZE_MAX / 8 / w->chunk_records / w->ring_chunks) return -1;
+    obs_series *o = calloc(1, sizeof *o);
+    if (!o) return -1;
+    strcpy(o->name, name);
+    o->width = width;
+    o->out = out;
+    o->stride = 1 + out;
+    o->decimate = decimate ? decimate : 1;
+    o->reduce = reduce;
+    o->ring = malloc(w->ring_chunks * w->chunk_records * o->stride * sizeof *o->ring);
+    o->fill = calloc(w->ring_chunks, sizeof *o->fill);
+    o->ready = calloc(w->ring_chunks, 1);
+    o->acc = reduce == OBS_STATS ? malloc(3 * width * sizeof *o->acc) : NULL;
+    o->have = 1;
+    if (!o->ring || !o->fill || !o->ready || (reduce == OBS_STATS && !o->acc)) {
+        obs_series_free(o);
+        return -1;
+    }
+    int id = -1;
+    pthread_mutex_lock(&w->lock);
+    if (w->n_series < OBS_MAX_SERIES) {
+        id = (int)w->n_series;
+        w->series[w->n_series++] = o;
+        s->n_observables = w->n_series;
+    }
+    pthread_mutex_unlock(&w->lock);
+    if (id < 0) obs_series_free(o);
+    return id;
+}
+
+int obs_stream_push(obs_stream *s, int id, double t, const double *values) {
+    if (!s || !values || id < 0) return -1;
+    obs_work *w = s->work;
+    if (id >= OBS_MAX_SERIES) return -1;
+    obs_series *o = w->series[id];
+    if (!o) return -1;
+    o->n_pushed++;
+    if (o->reduce == OBS_SAMPLE) {
+        const size_t k = o->count;
+        o->count = k + 1 == o->decimate ? 0 : k + 1;
+        return k ? 0 : obs_store(w, o, t, values);
+    }
+    const size_t n = o->width;
+    double *mn = o->acc, *mx = o->acc + n, *sum = o->acc + 2 * n;
+    o->t_last = t;
+    if (o->count++ == 0) {
+        memcpy(mn, values, n * sizeof *mn);
+        memcpy(mx, values, n * sizeof *mx);
+        memcpy(sum, values, n * sizeof *sum);
+    } else {
+        for (size_t k = 0; k < n; k++) {
+            const double v = values[k];
+            mn[k] = v < mn[k] ? v : mn[k];
+            mx[k] = v > mx[k] ? v : mx[k];
+            sum[k] += v;
+        }
+    }
+    return o->count == o->decimate ? obs_stats_emit(w, o, t) : 0;
+}
+
+int obs_stream_flush(obs_stream *s) {
+    if (!s) return -1;
+    obs_work *w = s->work;
+    pthread_mutex_lock(&w->lock);
+    for (size_t i = 0; i < w->n_series; i++) {
+        obs_series *o = w->series[i];
+        if (o->have && o->fill[o->head]) obs_hand_over(w, o);
+    }
+    while (w->n_ready && !w->error) pthread_cond_wait(&w->space, &w->lock);
+    if (fflush(w->fp) != 0) w->error = 1;
+    s->n_pushed = s->n_dropped = 0;
+    for (size_t i = 0; i < w->n_series; i++) {
+        s->n_pushed += w->series[i]->n_pushed;
+        s->n_dropped += w->series[i]->n_dropped;
+    }
+    s->n_chunks = w->n_chunks;
+    s->bytes = w->bytes;
+    const int rc = w->error ? -1 : 0;
+    pthread_mutex_unlock(&w->lock);
+    return rc;
+}
+
+int obs_stream_close(obs_stream *s) {
+    if (!s) return -1;
+    obs_work *w = s->work;
+    int rc = 0;
+    for (size_t i = 0; i < w->n_series; i++) {
+        obs_series *o = w->series[i];
+        if (o->reduce == OBS_STATS && o->count && obs_stats_emit(w, o, o->t_last) != 0) rc = -1;
+    }
+    if (obs_stream_flush(s) != 0) rc = -1;
+    pthread_mutex_lock(&w->lock);
+    w->stop = 1;
+    pthread_cond_signal(&w->work);
+    pthread_mutex_unlock(&w->lock);
+    pthread_join(w->thread, NULL);
+    if (fclose(w->fp) != 0 || w->error) rc = -1;
+    pthread_mutex_destroy(&w->lock);
+    pthread_cond_destroy(&w->work);
+    pthread_cond_destroy(&w->space);
+    for (size_t i = 0; i < w->n_series; i++) obs_series_free(w->series[i]);
+    free(w->buf);
+    free(w);
+    free(s);
+    return rc;
+}
+
+/* -------------------------------
+   Bindings
+   ------------------------------- */
+
+obs_binding *obs_binding_alloc(obs_stream *s, const char *prefix, size_t decimate, obs_reduce_t reduce) {
+    if (!s || !prefix || strlen(prefix) >= sizeof ((obs_binding *)0)->prefix) return NULL;
+    obs_binding *b = calloc(1, sizeof *b);
+    if (!b) return NULL;
+    b->stream = s;
+    strcpy(b->prefix, prefix);
+    b->decimate = decimate;
+    b->reduce = reduce;
+    for (size_t k = 0; k < OBS_BINDING_FIELDS; k++) b->id[k] = -1;
+    return b;
+}
+
+void obs_binding_free(obs_binding *b) {
+    free(b);
+}
+
+int obs_binding_push(obs_binding *b, size_t k, const char *name, double t, const double *values, size_t width) {
+    if (!b || k >= OBS_BINDING_FIELDS || !name) return -1;
+    if (!width) return 0;
+    if (b->id[k] < 0) {
+        char full[64];
+        if ((size_t)snprintf(full, sizeof full, "%s.%s", b->prefix, name) >= sizeof full) return -1;
+        b->id[k] = obs_stream_add(b->stream, full, width, b->decimate, b->reduce);
+        if (b->id[k] < 0) return -1;
+        b->width[k] = width;
+    }
+    if (width != b->width[k]) return -1;
+    return obs_stream_push(b->stream, b->id[k], t, values);
+}
+
+/* -------------------------------
+   Reader
+   ------------------------------- */
+
+typedef struct {
+    char name[64];
+    size_t stride;
+} obs_decl;
+
+int obs_stream_dump(const char *path, FILE *out) {
+    if (!path || !out) return -1;
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return -1;
+    char magic[8];
+    uint32_t version;
+    int rc = fread(magic, 1, 8, fp) == 8 && memcmp(magic, OBS_MAGIC, 8) == 0
+             && fread(&version, sizeof version, 1, fp) == 1 && version == OBS_VERSION ? 0 : -1;
+    obs_decl *decl = NULL;
+    size_t n_decl = 0;
+    unsigned char *payload = NULL;
+    double *rec = NULL;
+    int kind;
+    while (rc == 0 && (kind = fgetc(fp)) != EOF) {
+        uint32_t id;
+        if (fread(&id, sizeof id, 1, fp) != 1) {
+            rc = -1;
+            break;
+        }
+        if (kind == 'D') {
+            uint32_t width, reduce, len;
+            uint64_t dec;
+            if (fread(&width, sizeof width, 1, fp) != 1 || fread(&reduce, sizeof reduce, 1, fp) != 1
+                || fread(&dec, sizeof dec, 1, fp) != 1 || fread(&len, sizeof len, 1, fp) != 1 || len >= 64
+                || width == 0 || width >= UINT32_MAX || id >= OBS_MAX_SERIES || (id < n_decl && decl[id].stride)) {
+                rc = -1;
+                break;
+            }
+            if (id >= n_decl) {
+                obs_decl *d = realloc(decl, ((size_t)id + 1) * sizeof *d);
+                if (!d) {
+                    rc = -1;
+                    break;
+                }
+                decl = d;
+                memset(decl + n_decl, 0, ((size_t)id + 1 - n_decl) * sizeof *decl);
+                n_decl = (size_t)id + 1;
+            }
+            if (fread(decl[id].name, 1, len, fp) != len) {
+                rc = -1;
+                break;
+            }
+            decl[id].stride = (size_t)width + 1;
+        } else if (kind == 'C') {
+            uint32_t n;
+            unsigned char raw;
+            uint64_t size;
+            if (id >= n_decl || !decl[id].stride || fread(&n, sizeof n, 1, fp) != 1 || fread(&raw, 1, 1, fp) != 1
+                || fread(&size, sizeof size, 1, fp) != 1 || size > SIZE_MAX / 2) {
+                rc = -1;
+                break;
+            }
+            const size_t stride = decl[id].stride, words = (size_t)n * stride;
+            free(payload);
+            free(rec);
+            payload = malloc(size ? (size_t)size : 1);
+            rec = malloc((words ? words : 1) * sizeof *rec);
+            if (!payload || !rec || fread(payload, 1, (size_t)size, fp) != size) {
+                rc = -1;
+                break;
+            }
+            if (raw) {
+                if (size != words * sizeof *rec) {
+                    rc = -1;
+                    break;
+                }
+                memcpy(rec, payload, (size_t)size);
+            } else if (obs_decode(payload, (size_t)size, n, stride, rec) != 0) {
+                rc = -1;
+                break;
+            }
+            for (size_t r = 0; r < n; r++) {
+                fprintf(out, "%s", decl[id].name);
+                for (size_t c = 0; c < stride; c++) fprintf(out, " %.17g", rec[r * stride + c]);
+                fputc('\n', out);
+            }
+        } else {
+            rc = -1;
+        }
+    }
+    free(decl);
+    free(payload);
+    free(rec);
+    fclose(fp);
+    return rc;
+}
@@ -0,0 +1,360 @@
+/* pair_kernel.c - Vectorized inverse-square pair interactions for HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+   ----------------------------------------------------------------------
+   Each ISA path vectorizes the source loop j for one target i and
+   reduces the lanes once per target. The SIMD paths are compiled with
+   per-function target attributes, so no global -m flags are needed and
+   the binary still runs on CPUs without them.
+*/
+
+#include <math.h>
+#include <stdatomic.h>
+
+#include "core/phys/pair_kernel.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PK_HAVE_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#define PK_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+/* Resolved on first use, possibly by several threads of a parallel
+   region at once: every detector stores the same answer, so the race is
+   benign once the accesses are atomic. */
+static _Atomic pk_isa_t pk_isa = PK_ISA_AUTO;
+
+/* Scalar contribution of sources [j0, n) to target i (also used for SIMD tails).
+   When phi is non-NULL it also accumulates sum_{j != i} w_j / r. */
+static inline void pk_scalar_range(const double *x, const double *y, const double *z,
+                                   const double *w, size_t j0, size_t n, size_t i,
+                                   double eps2, double acc[3], double *phi) {
+    const double xi = x[i], yi = y[i], zi = z[i];
+    for (size_t j = j0; j < n; j++) {
+        double dx = x[j] - xi, dy = y[j] - yi, dz = z[j] - zi;
+        double r2 = dx * dx + dy * dy + dz * dz + eps2;
+        if (r2 == 0.0) continue;
+        double inv_r = 1.0 / sqrt(r2);
+        double s = w[j] * inv_r * inv_r * inv_r;
+        acc[0] += s * dx;
+        acc[1] += s * dy;
+        acc[2] += s * dz;
+        if (phi && j != i) *phi += w[j] * inv_r;
+    }
+}
+
+static void pk_scalar(const double *x, const double *y, const double *z, const double *w,
+                      size_t n, size_t i0, size_t i1, double scale, double eps2,
+                      double *fx, double *fy, double *fz, double *pot) {
+    for (size_t i = i0; i < i1; i++) {
+        double acc[3] = {0.0, 0.0, 0.0}, phi = 0.0;
+        pk_scalar_range(x, y, z, w, 0, n, i, eps2, acc, pot ? &phi : NULL);
+        double s = scale * w[i];
+        fx[i] += s * acc[0];
+        fy[i] += s * acc[1];
+        fz[i] += s * acc[2];
+        if (pot) pot[i] += s * phi;
+    }
+}
+
+#ifdef PK_HAVE_X86
+
+__attribute__((target("avx2,fma")))
+static inline double pk_hsum256(__m256d v) {
+    __m128d lo = _mm256_castpd256_pd128(v), hi = _mm256_extractf128_pd(v, 1);
+    lo = _mm_add_pd(lo, hi);
+    return _mm_cvtsd_f64(_mm_add_sd(lo, _mm_unpackhi_pd(lo, lo)));
+}
+
+/* AVX2: 12-bit float rsqrt estimate, two Newton steps in double (~1e-14 relative).
+   The float estimate is only valid for r^2 inside the float range; vectors with
+   lanes outside it take an exact sqrt/div instead. */
+__attribute__((target("avx2,fma"), always_inline))
+static inline void pk_avx2_body(const double *x, const double *y, const double *z, const double *w,
+                                size_t n, size_t i0, size_t i1, double scale, double eps2,
+                                double *fx, double *fy, double *fz, double *pot, const int want_pot) {
+    const __m256d half = _mm256_set1_pd(0.5), three_halves = _mm256_set1_pd(1.5);
+    const __m256d zero = _mm256_setzero_pd(), one = _mm256_set1_pd(1.0);
+    const __m256d lo = _mm256_set1_pd(1e-36), hi = _mm256_set1_pd(1e36);
+    const __m256d veps2 = _mm256_set1_pd(eps2);
+    const size_t n4 = n & ~(size_t)3;
+
+    for (size_t i = i0; i < i1; i++) {
+        const __m256d xi = _mm256_set1_pd(x[i]), yi = _mm256_set1_pd(y[i]), zi = _mm256_set1_pd(z[i]);
+        const __m256d iv = _mm256_set1_pd((double)i), four = _mm256_set1_pd(4.0);
+        __m256d ax = zero, ay = zero, az = zero, ap = zero;
+        __m256d jv = _mm256_set_pd(3.0, 2.0, 1.0, 0.0);
+
+        for (size_t j = 0; j < n4; j += 4) {
+            __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(x + j), xi);
+            __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(y + j), yi);
+            __m256d dz = _mm256_sub_pd(_mm256_loadu_pd(z + j), zi);
+            __m256d r2 = _mm256_fmadd_pd(dx, dx, _mm256_fmadd_pd(dy, dy, _mm256_fmadd_pd(dz, dz, veps2)));
+            __m256d nonzero = _mm256_cmp_pd(r2, zero, _CMP_GT_OQ);
+            __m256d out = _mm256_or_pd(_mm256_cmp_pd(r2, lo, _CMP_LT_OQ), _mm256_cmp_pd(r2, hi, _CMP_GT_OQ));
+            __m256d inv_r;
+
+            if (_mm256_movemask_pd(_mm256_and_pd(out, nonzero)) == 0) {
+                __m256d safe = _mm256_blendv_pd(one, r2, nonzero);
+                inv_r = _mm256_cvtps_pd(_mm_rsqrt_ps(_mm256_cvtpd_ps(safe)));
+                __m256d h = _mm256_mul_pd(half, safe);
+                inv_r = _mm256_mul_pd(inv_r, _mm256_fnmadd_pd(_mm256_mul_pd(h, inv_r), inv_r, three_halves));
+                inv_r = _mm256_mul_pd(inv_r, _mm256_fnmadd_pd(_mm256_mul_pd(h, inv_r), inv_r, three_halves));
+            } else {
+                __m256d safe = _mm256_blendv_pd(one, r2, nonzero);
+                inv_r = _mm256_div_pd(one, _mm256_sqrt_pd(safe));
+            }
+            inv_r = _mm256_and_pd(inv_r, nonzero);
+
+            __m256d wj = _mm256_loadu_pd(w + j);
+            __m256d s = _mm256_mul_pd(wj, _mm256_mul_pd(inv_r, _mm256_mul_pd(inv_r, inv_r)));
+            ax = _mm256_fmadd_pd(s, dx, ax);
+            ay = _mm256_fmadd_pd(s, dy, ay);
+            az = _mm256_fmadd_pd(s, dz, az);
+            if (want_pot) {
+                /* Softening makes the self term finite, so mask j == i explicitly. */
+                __m256d other = _mm256_cmp_pd(jv, iv, _CMP_NEQ_OQ);
+                ap = _mm256_add_pd(ap, _mm256_and_pd(_mm256_mul_pd(wj, inv_r), other));
+                jv = _mm256_add_pd(jv, four);
+            }
+        }
+
+        double acc[3] = { pk_hsum256(ax), pk_hsum256(ay), pk_hsum256(az) };
+        double phi = want_pot ? pk_hsum256(ap) : 0.0;
+        pk_scalar_range(x, y, z, w, n4, n, i, eps2, acc, want_pot ? &phi : NULL);
+        double s = scale * w[i];
+        fx[i] += s * acc[0];
+        fy[i] += s * acc[1];
+        fz[i] += s * acc[2];
+        if (want_pot) pot[i] += s * phi;
+    }
+}
+
+__attribute__((target("avx2,fma")))
+static void pk_avx2(const double *x, const double *y, const double *z, const double *w,
+                    size_t n, size_t i0, size_t i1, double scale, double eps2,
+                    double *fx, double *fy, double *fz, double *pot) {
+    if (pot) pk_avx2_body(x, y, z, w, n, i0, i1, scale, eps2, fx, fy, fz, pot, 1);
+    else     pk_avx2_body(x, y, z, w, n, i0, i1, scale, eps2, fx, fy, fz, NULL, 0);
+}
+
+/* AVX-512F: 14-bit rsqrt14 estimate over the full double range, two Newton steps. */
+__attribute__((target("avx512f"), always_inline))
+static inline void pk_avx512_body(const double *x, const double *y, const double *z, const double *w,
+                                  size_t n, size_t i0, size_t i1, double scale, double eps2,
+                                  double *fx, double *fy, double *fz, double *pot, const int want_pot) {
+    const __m512d half = _mm512_set1_pd(0.5), three_halves = _mm512_set1_pd(1.5);
+    const __m512d zero = _mm512_setzero_pd(), veps2 = _mm512_set1_pd(eps2);
+    const size_t n8 = n & ~(size_t)7;
+
+    for (size_t i = i0; i < i1; i++) {
+        const __m512d xi = _mm512_set1_pd(x[i]), yi = _mm512_set1_pd(y[i]), zi = _mm512_set1_pd(z[i]);
+        __m512d ax = zero, ay = zero, az = zero, ap = zero;
+
+        for (size_t j = 0; j < n8; j += 8) {
+            __m512d dx = _mm512_sub_pd(_mm512_loadu_pd(x + j), xi);
+            __m512d dy = _mm512_sub_pd(_mm512_loadu_pd(y + j), yi);
+            __m512d dz = _mm512_sub_pd(_mm512_loadu_pd(z + j), zi);
+            __m512d r2 = _mm512_fmadd_pd(dx, dx, _mm512_fmadd_pd(dy, dy, _mm512_fmadd_pd(dz, dz, veps2)));
+            __mmask8 nonzero = _mm512_cmp_pd_mask(r2, zero, _CMP_GT_OQ);
+
+            __m512d inv_r = _mm512_maskz_rsqrt14_pd(nonzero, r2);
+            __m512d h = _mm512_mul_pd(half, r2);
+            inv_r = _mm512_mul_pd(inv_r, _mm512_fnmadd_pd(_mm512_mul_pd(h, inv_r), inv_r, three_halves));
+            inv_r = _mm512_mul_pd(inv_r, _mm512_fnmadd_pd(_mm512_mul_pd(h, inv_r), inv_r, three_halves));
+
+            __m512d wj = _mm512_loadu_pd(w + j);
+            __m512d s = _mm512_mul_pd(wj, _mm512_mul_pd(inv_r, _mm512_mul_pd(inv_r, inv_r)));
+            ax = _mm512_fmadd_pd(s, dx, ax);
+            ay = _mm512_fmadd_pd(s, dy, ay);
+            az = _mm512_fmadd_pd(s, dz, az);
+            if (want_pot) {
+                __mmask8 other = i - j < 8 ? (__mmask8)~(1u << (i - j)) : (__mmask8)0xff;
+                ap = _mm512_mask3_fmadd_pd(wj, inv_r, ap, other);
+            }
+        }
+
+        double acc[3] = { _mm512_reduce_add_pd(ax), _mm512_reduce_add_pd(ay), _mm512_reduce_add_pd(az) };
+        double phi = want_pot ? _mm512_reduce_add_pd(ap) : 0.0;
+        pk_scalar_range(x, y, z, w, n8, n, i, eps2, acc, want_pot ? &phi : NULL);
+        double s = scale * w[i];
+        fx[i] += s * acc[0];
+        fy[i] += s * acc[1];
+        fz[i] += s * acc[2];
+        if (want_pot) pot[i] += s * phi;
+    }
+}
+
+__attribute__((target("avx512f")))
+static void pk_avx512(const double *x, const double *y, const double *z, const double *w,
+                      size_t n, size_t i0, size_t i1, double scale, double eps2,
+                      double *fx, double *fy, double *fz, double *pot) {
+    if (pot) pk_avx512_body(x, y, z, w, n, i0, i1, scale, eps2, fx, fy, fz, pot, 1);
+    else     pk_avx512_body(x, y, z, w, n, i0, i1, scale, eps2, fx, fy, fz, NULL, 0);
+}
+
+#endif /* PK_HAVE_X86 */
+
+#ifdef PK_HAVE_NEON
+
+/* NEON: 8-bit vrsqrte estimate refined with three vrsqrts Newton steps. */
+static void pk_neon(const double *x, const double *y, const double *z, const double *w,
+                    size_t n, size_t i0, size_t i1, double scale, double eps2,
+                    double *fx, double *fy, double *fz, double *pot) {
+    const float64x2_t zero = vdupq_n_f64(0.0), veps2 = vdupq_n_f64(eps2);
+    const size_t n2 = n & ~(size_t)1;
+
+    for (size_t i = i0; i < i1; i++) {
+        const float64x2_t xi = vdupq_n_f64(x[i]), yi = vdupq_n_f64(y[i]), zi = vdupq_n_f64(z[i]);
+        float64x2_t ax = zero, ay = zero, az = zero, ap = zero;
+
+        for (size_t j = 0; j < n2; j += 2) {
+            float64x2_t dx = vsubq_f64(vld1q_f64(x + j), xi);
+            float64x2_t dy = vsubq_f64(vld1q_f64(y + j), yi);
+            float64x2_t dz = vsubq_f64(vld1q_f64(z + j), zi);
+            float64x2_t r2 = vfmaq_f64(vfmaq_f64(vfmaq_f64(veps2, dz, dz), dy, dy), dx, dx);
+            uint64x2_t nonzero = vcgtq_f64(r2, zero);
+
+            float64x2_t inv_r = vrsqrteq_f64(r2);
+            inv_r = vmulq_f64(inv_r, vrsqrtsq_f64(vmulq_f64(r2, inv_r), inv_r));
+            inv_r = vmulq_f64(inv_r, vrsqrtsq_f64(vmulq_f64(r2, inv_r), inv_r));
+            inv_r = vmulq_f64(inv_r, vrsqrtsq_f64(vmulq_f64(r2, inv_r), inv_r));
+            inv_r = vreinterpretq_f64_u64(vandq_u64(vreinterpretq_u64_f64(inv_r), nonzero));
+
+            float64x2_t wj = vld1q_f64(w + j);
+            float64x2_t s = vmulq_f64(wj, vmulq_f64(inv_r, vmulq_f64(inv_r, inv_r)));
+            ax = vfmaq_f64(ax, s, dx);
+            ay = vfmaq_f64(ay, s, dy);
+            az = vfmaq_f64(az, s, dz);
+            if (pot) {
+                float64x2_t p = vmulq_f64(wj, inv_r);
+                if (i == j) p = vsetq_lane_f64(0.0, p, 0);
+                else if (i == j + 1) p = vsetq_lane_f64(0.0, p, 1);
+                ap = vaddq_f64(ap, p);
+            }
+        }
+
+        double acc[3] = { vaddvq_f64(ax), vaddvq_f64(ay), vaddvq_f64(az) };
+        double phi = vaddvq_f64(ap);
+        pk_scalar_range(x, y, z, w, n2, n, i, eps2, acc, pot ? &phi : NULL);
+        double s = scale * w[i];
+        fx[i] += s * acc[0];
+        fy[i] += s * acc[1];
+        fz[i] += s * acc[2];
+        if (pot) pot[i] += s * phi;
+    }
+}
+
+#endif /* PK_HAVE_NEON */
+
+static int pk_isa_supported(pk_isa_t isa) {
+    switch (isa) {
+    case PK_ISA_SCALAR:
+        return 1;
+#ifdef PK_HAVE_X86
+    case PK_ISA_AVX2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    case PK_ISA_AVX512:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx512f");
+#endif
+#ifdef PK_HAVE_NEON
+    case PK_ISA_NEON:
+        return 1;
+#endif
+    default:
+        return 0;
+    }
+}
+
+static pk_isa_t pk_detect(void) {
+    static const pk_isa_t order[] = { PK_ISA_AVX512, PK_ISA_AVX2, PK_ISA_NEON };
+    for (size_t k = 0; k < sizeof(order) / sizeof(order[0]); k++)
+        if (pk_isa_supported(order[k])) return order[k];
+    return PK_ISA_SCALAR;
+}
+
+void pk_set_isa(pk_isa_t isa) {
+    if (isa != PK_ISA_AUTO && !pk_isa_supported(isa)) isa = PK_ISA_SCALAR;
+    if (isa == PK_ISA_AUTO) isa = pk_detect();
+    atomic_store_explicit(&pk_isa, isa, memory_order_release);
+}
+
+pk_isa_t pk_active_isa(void) {
+    pk_isa_t isa = atomic_load_explicit(&pk_isa, memory_order_acquire);
+    if (isa == PK_ISA_AUTO) {
+        isa = pk_detect();
+        atomic_store_explicit(&pk_isa, isa, memory_order_release);
+    }
+    return isa;
+}
+
+const char *pk_isa_name(pk_isa_t isa) {
+    switch (isa) {
+    case PK_ISA_SCALAR: return "scalar";
+    case PK_ISA_AVX2:   return "avx2";
+    case PK_ISA_AVX512: return "avx512";
+    case PK_ISA_NEON:   return "neon";
+    default:            return "auto";
+    }
+}
+
+/* Dispatch to the active ISA; pot may be NULL. */
+static void pk_dispatch(const double *x, const double *y, const double *z,
+                        const double *w, size_t n, size_t i0, size_t i1,
+                        double scale, double eps2,
+                        double *fx, double *fy, double *fz, double *pot) {
+    if (i1 > n) i1 = n;
+    if (i0 >= i1) return;
+
+    switch (pk_active_isa()) {
+#ifdef PK_HAVE_X86
+    case PK_ISA_AVX512:
+        pk_avx512(x, y, z, w, n, i0, i1, scale, eps2, fx, fy, fz, pot);
+        return;
+    case PK_ISA_AVX2:
+        pk_avx2(x, y, z, w, n, i0, i1, scale, eps2, fx, fy, fz, pot);
+        return;
+#endif
+#ifdef PK_HAVE_NEON
+    case PK_ISA_NEON:
+        pk_neon(x, y, z, w, n, i0, i1, scale, eps2, fx, fy, fz, pot);
+        return;
+#endif
+    default:
+        pk_scalar(x, y, z, w, n, i0, i1, scale, eps2, fx, fy, fz, pot);
+        return;
+    }
+}
+
+void pk_inverse_square(const double *x, const double *y, const double *z,
+                       const double *w, size_t n, size_t i0, size_t i1,
+                       double scale, double eps2,
+                       double *fx, double *fy, double *fz) {
+    pk_dispatch(x, y, z, w, n, i0, i1, scale, eps2, fx, fy, fz, NULL);
+}
+
+void pk_inverse_square_pot(const double *x, const double *y, const double *z,
+                           const double *w, size_t n, size_t i0, size_t i1,
+                           double scale, double eps2,
+                           double *fx, double *fy, double *fz, double *pot) {
+    pk_dispatch(x, y, z, w, n, i0, i1, scale, eps2, fx, fy, fz, pot);
+}
@@ -0,0 +1,85 @@
+/*
+   band_structure.c - Band structure module for HOLOS
+
+   k-point allocation for bs_system_t (see band_structure.h); the band
+   engine, the SCF driver and the k-point meshes have their own files.
+
+   Copyright (C) 2025 HOLOS Scientific Computing Project
+
+   This file is part of HOLOS.
+
+   HOLOS is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "core/phys/ss/band_structure.h"
+
+bs_kpoint_t *bs_kpoint_alloc(size_t dim) {
+	bs_kpoint_t *kpt;
+
+	if (dim == 0)
+		return NULL;
+	kpt = calloc(1, sizeof(*kpt));
+	if (!kpt)
+		return NULL;
+	kpt->kvec = gsl_vector_calloc(dim);
+	if (!kpt->kvec) {
+		free(kpt);
+		return NULL;
+	}
+	kpt->path_index = -1;
+	return kpt;
+}
+
+void bs_kpoint_free(bs_kpoint_t *kpt) {
+	if (!kpt)
+		return;
+	if (kpt->kvec)
+		gsl_vector_free(kpt->kvec);
+	free(kpt);
+}
+
+int bs_kpoint_batch_alloc(bs_kpoint_t **kpoints, size_t n, size_t dim, const double *kvecs, const double *weights, const char **labels, const int *path_indices) {
+	if (!kpoints || (n && !kvecs))
+		return -1;
+	for (size_t i = 0; i < n; i++) {
+		bs_kpoint_t *kpt = bs_kpoint_alloc(dim);
+		if (!kpt) {
+			bs_kpoint_batch_free(kpoints, i);
+			return -1;
+		}
+		for (size_t d = 0; d < dim; d++)
+			gsl_vector_set(kpt->kvec, d, kvecs[i * dim + d]);
+		kpt->weight = weights ? weights[i] : 1.0 / (double)n;
+		if (labels && labels[i]) {
+			strncpy(kpt->label, labels[i], sizeof(kpt->label) - 1);
+			kpt->label[sizeof(kpt->label) - 1] = '\0';
+		}
+		if (path_indices)
+			kpt->path_index = path_indices[i];
+		kpoints[i] = kpt;
+	}
+	return 0;
+}
+
+void bs_kpoint_batch_free(bs_kpoint_t **kpoints, size_t n) {
+	if (!kpoints)
+		return;
+	for (size_t i = 0; i < n; i++) {
+		bs_kpoint_free(kpoints[i]);
+		kpoints[i] = NULL;
+	}
+}
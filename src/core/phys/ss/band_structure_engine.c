@@ -0,0 +1,341 @@
+/*
+   band_structure_engine.c - Parallel k-point band engine for HOLOS
+
+   bs_step_band_calculation() over a bs_hamiltonian_t model (see
+   band_structure.h; bs_step_scf() is in band_structure_scf.c):
+   - The k-vectors and weights are packed once per step into flat arrays,
+     then the k-points are split over the threads; every k-point is one
+     independent diagonalization, and its bands go to its own row of the
+     n_kpoints x n_kept energy matrix (one writer per row)
+   - Each thread owns a workspace made on the first step: the H(k)
+     buffer, the eigenvalues and, with LAPACK, the zheevr work arrays
+     sized by a workspace query, so no solve allocates
+   - A window of bands is asked of zheevr as an index range (RANGE = 'I',
+     eigenvalues only), which skips the rest of the spectrum after the
+     tridiagonal reduction; the GSL fallback solves all and sorts
+
+   Copyright (C) 2025 HOLOS Scientific Computing Project
+
+   This file is part of HOLOS.
+
+   HOLOS is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifndef HAVE_LAPACK
+#include <gsl/gsl_eigen.h>
+#include <gsl/gsl_sort_vector.h>
+#endif
+
+#include "core/phys/ss/band_structure.h"
+
+#ifdef HAVE_LAPACK
+/* Fortran LAPACK (complex arrays as interleaved doubles) */
+extern void zheevr_(const char *jobz, const char *range, const char *uplo, const int *n,
+	double *a, const int *lda, const double *vl, const double *vu, const int *il, const int *iu,
+	const double *abstol, int *m, double *w, double *z, const int *ldz, int *isuppz,
+	double *work, const int *lwork, double *rwork, const int *lrwork, int *iwork, const int *liwork,
+	int *info);
+#endif
+
+/* One thread's buffers */
+typedef struct {
+	double *h;                      /* H(k), 2 n^2 */
+	double *w;                      /* Eigenvalues, n */
+#ifdef HAVE_LAPACK
+	double *work, *rwork, z[2];
+	int *iwork, *isuppz;
+	int lwork, lrwork, liwork;
+#else
+	gsl_matrix_complex *a;          /* Views h */
+	gsl_vector *eval;
+	gsl_eigen_herm_workspace *ws;
+#endif
+} bs_slot;
+
+typedef struct {
+	size_t n;
+	int nt;
+	bs_slot *slot;
+	double *k, *weight;             /* Packed k-vectors and weights */
+	size_t k_cap, w_cap;
+} bs_engine_work;
+
+static int bs_threads(int n_threads) {
+	if (n_threads < 0) {
+#ifdef _OPENMP
+		return omp_get_max_threads();
+#else
+		return 1;
+#endif
+	}
+	return n_threads > 0 ? n_threads : 1;
+}
+
+/* -------------------------------
+   Workspaces
+   ------------------------------- */
+
+static void bs_slot_free(bs_slot *s) {
+#ifdef HAVE_LAPACK
+	free(s->work);
+	free(s->rwork);
+	free(s->iwork);
+	free(s->isuppz);
+	free(s->h);
+#else
+	if (s->ws)
+		gsl_eigen_herm_free(s->ws);
+	if (s->eval)
+		gsl_vector_free(s->eval);
+	if (s->a)
+		gsl_matrix_complex_free(s->a);
+#endif
+	free(s->w);
+	memset(s, 0, sizeof(*s));
+}
+
+static int bs_slot_init(bs_slot *s, size_t n) {
+	memset(s, 0, sizeof(*s));
+	s->w = malloc(n * sizeof(double));
+	if (!s->w)
+		return -1;
+#ifdef HAVE_LAPACK
+	{
+		int in = (int)n, m = 0, info = 0, query = -1, il = 1, iu = 1, one = 1;
+		double vl = 0.0, vu = 0.0, abstol = 0.0, lw = 0.0, lrw = 0.0;
+		int liw = 0;
+
+		s->h = malloc(2 * n * n * sizeof(double));
+		s->isuppz = malloc(2 * n * sizeof(int));
+		if (!s->h || !s->isuppz)
+			return -1;
+		zheevr_("N", "A", "U", &in, s->h, &in, &vl, &vu, &il, &iu, &abstol, &m, s->w,
+			s->z, &one, s->isuppz, &lw, &query, &lrw, &query, &liw, &query, &info);
+		if (info != 0)
+			return -1;
+		s->lwork = (int)lw > 2 * in ? (int)lw : 2 * in;
+		s->lrwork = (int)lrw > 24 * in ? (int)lrw : 24 * in;
+		s->liwork = liw > 10 * in ? liw : 10 * in;
+		s->work = malloc(2 * (size_t)s->lwork * sizeof(double));
+		s->rwork = malloc((size_t)s->lrwork * sizeof(double));
+		s->iwork = malloc((size_t)s->liwork * sizeof(int));
+		if (!s->work || !s->rwork || !s->iwork)
+			return -1;
+	}
+#else
+	s->a = gsl_matrix_complex_alloc(n, n);
+	s->eval = gsl_vector_alloc(n);
+	s->ws = gsl_eigen_herm_alloc(n);
+	if (!s->a || !s->eval || !s->ws)
+		return -1;
+	s->h = s->a->data;
+#endif
+	return 0;
+}
+
+static void bs_work_free(bs_engine_work *wk) {
+	if (!wk)
+		return;
+	if (wk->slot) {
+		for (int t = 0; t < wk->nt; t++)
+			bs_slot_free(&wk->slot[t]);
+		free(wk->slot);
+	}
+	free(wk->k);
+	free(wk->weight);
+	free(wk);
+}
+
+/* Workspaces for n and nt threads, kept from the last step when they
+   match. */
+static bs_engine_work *bs_work_get(bs_hamiltonian_t *ham, int nt) {
+	bs_engine_work *wk = ham->work;
+
+	if (wk && wk->n == ham->n && wk->nt == nt)
+		return wk;
+	if (wk) {
+		for (int t = 0; t < wk->nt; t++)
+			bs_slot_free(&wk->slot[t]);
+		free(wk->slot);
+		wk->slot = NULL;
+		wk->nt = 0;
+	} else {
+		wk = calloc(1, sizeof(*wk));
+		if (!wk)
+			return NULL;
+		ham->work = wk;
+	}
+	wk->slot = calloc((size_t)nt, sizeof(bs_slot));
+	if (!wk->slot)
+		return NULL;
+	wk->n = ham->n;
+	for (wk->nt = 0; wk->nt < nt; wk->nt++) {
+		if (bs_slot_init(&wk->slot[wk->nt], ham->n) != 0) {
+			bs_slot_free(&wk->slot[wk->nt]);
+			wk->n = 0;
+			return NULL;
+		}
+	}
+	return wk;
+}
+
+bs_hamiltonian_t *bs_hamiltonian_alloc(size_t n, bs_hamiltonian_fn fn, void *params) {
+	bs_hamiltonian_t *ham;
+
+	if (n == 0 || !fn)
+		return NULL;
+	ham = calloc(1, sizeof(*ham));
+	if (!ham)
+		return NULL;
+	ham->n = n;
+	ham->fn = fn;
+	ham->params = params;
+	return ham;
+}
+
+void bs_hamiltonian_free(bs_hamiltonian_t *ham) {
+	if (!ham)
+		return;
+	bs_work_free(ham->work);
+	free(ham->energies);
+	free(ham);
+}
+
+/* -------------------------------
+   Solves
+   ------------------------------- */
+
+/* Bands first..first+m-1 of H(k) into row; the engine's only per-k work. */
+static int bs_solve(const bs_hamiltonian_t *ham, bs_slot *s, const double *k, size_t dim,
+	size_t first, size_t m, double *row) {
+	size_t n = ham->n;
+
+	memset(s->h, 0, 2 * n * n * sizeof(double));
+	if (ham->fn(k, dim, s->h, n, ham->params) != 0)
+		return -1;
+#ifdef HAVE_LAPACK
+	{
+		/* Row-major lower = column-major upper of the transpose, which
+		   has the same eigenvalues */
+		int in = (int)n, il = (int)first + 1, iu = (int)(first + m), found = 0, info = 0, one = 1;
+		double vl = 0.0, vu = 0.0, abstol = 0.0;
+
+		zheevr_("N", m == n ? "A" : "I", "U", &in, s->h, &in, &vl, &vu, &il, &iu, &abstol,
+			&found, s->w, s->z, &one, s->isuppz, s->work, &s->lwork, s->rwork, &s->lrwork,
+			s->iwork, &s->liwork, &info);
+		if (info != 0 || found != (int)m)
+			return -1;
+		memcpy(row, s->w, m * sizeof(double));
+	}
+#else
+	if (gsl_eigen_herm(s->a, s->eval, s->ws) != 0)
+		return -1;
+	gsl_sort_vector(s->eval);
+	for (size_t b = 0; b < m; b++)
+		row[b] = gsl_vector_get(s->eval, first + b);
+#endif
+	return 0;
+}
+
+int bs_step_band_calculation(bs_system_t *system) {
+	bs_hamiltonian_t *ham;
+	bs_engine_work *wk;
+	size_t nk, dim, first, m;
+	int nt, failed = 0;
+
+	if (!system || !system->hamiltonian || !system->kpoints || system->n_kpoints == 0)
+		return -1;
+	ham = system->hamiltonian;
+	nk = system->n_kpoints;
+	first = ham->band_first;
+	m = ham->n_bands ? ham->n_bands : (first < ham->n ? ham->n - first : 0);
+	if (m == 0 || first + m > ham->n)
+		return -1;
+	if (!system->kpoints[0] || !system->kpoints[0]->kvec)
+		return -1;
+	dim = system->kpoints[0]->kvec->size;
+
+	nt = bs_threads(ham->n_threads);
+	if ((size_t)nt > nk)
+		nt = (int)nk;
+	wk = bs_work_get(ham, nt);
+	if (!wk)
+		return -1;
+
+	/* Flat k-vectors and weights, and the energy matrix */
+	if (wk->k_cap < nk * dim) {
+		double *k = realloc(wk->k, nk * dim * sizeof(double));
+		if (!k)
+			return -1;
+		wk->k = k;
+		wk->k_cap = nk * dim;
+	}
+	if (wk->w_cap < nk) {
+		double *w = realloc(wk->weight, nk * sizeof(double));
+		if (!w)
+			return -1;
+		wk->weight = w;
+		wk->w_cap = nk;
+	}
+	for (size_t i = 0; i < nk; i++) {
+		const bs_kpoint_t *kp = system->kpoints[i];
+		if (!kp || !kp->kvec || kp->kvec->size != dim)
+			return -1;
+		for (size_t d = 0; d < dim; d++)
+			wk->k[i * dim + d] = gsl_vector_get(kp->kvec, d);
+		wk->weight[i] = kp->weight;
+	}
+	if (ham->n_kpoints * ham->n_kept != nk * m || !ham->energies) {
+		double *e = realloc(ham->energies, nk * m * sizeof(double));
+		if (!e)
+			return -1;
+		ham->energies = e;
+	}
+	ham->n_kpoints = nk;
+	ham->n_kept = m;
+
+	#pragma omp parallel for schedule(dynamic, 1) num_threads(nt) reduction(|:failed) if(nt > 1)
+	for (size_t i = 0; i < nk; i++) {
+#ifdef _OPENMP
+		bs_slot *s = &wk->slot[omp_get_thread_num()];
+#else
+		bs_slot *s = &wk->slot[0];
+#endif
+		if (bs_solve(ham, s, wk->k + i * dim, dim, first, m, ham->energies + i * m) != 0)
+			failed = 1;
+	}
+	ham->n_solves += nk;
+	if (failed)
+		return -1;
+
+	/* Bands laid out per k-point, for the callers of bs_band_t */
+	if (system->bands) {
+		for (size_t b = 0; b < system->n_bands && b < m; b++) {
+			bs_band_t *band = system->bands[b];
+			if (!band || !band->energies || band->n_kpoints != nk)
+				continue;
+			for (size_t i = 0; i < nk; i++)
+				band->energies[i] = ham->energies[i * m + b];
+		}
+	}
+	return 0;
+}
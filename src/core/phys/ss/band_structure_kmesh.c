@@ -0,0 +1,632 @@
+/*
+   band_structure_kmesh.c - k-point meshes and tetrahedra for HOLOS
+
+   Monkhorst-Pack meshes reduced by symmetry, and linear tetrahedron
+   integration over them (see band_structure.h):
+   - Mesh points are kept as integers q = 2 i + s on each axis (k =
+     q / 2n), so applying an operation is exact integer arithmetic; an
+     operation maps the mesh onto itself when every image lands on a
+     mesh point, and only those take part in the reduction
+   - Orbits are found in one pass over the mesh: the first point not yet
+     seen becomes a representative, and all of its images point to it
+   - Tetrahedra are never stored: each cell is split on the fly into the
+     six tetrahedra around its shortest diagonal (the same split for
+     every cell), with energies read from the wedge through the irr map
+   - Sums over cells are taken per fixed block of cells and added in
+     block order, so results do not depend on the thread count
+
+   Copyright (C) 2025 HOLOS Scientific Computing Project
+
+   This file is part of HOLOS.
+
+   HOLOS is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "core/phys/ss/band_structure.h"
+
+#define BS_TOL 1e-6                     /* Default relative tolerance of the metric test */
+#define BS_BLOCKS 64                    /* Fixed partial-sum blocks of the tetrahedron loops */
+#define BS_FERMI_ITER 200
+
+/* -------------------------------
+   Point group
+   ------------------------------- */
+
+static int bs_det3(const int *m) {
+	return m[0] * (m[4] * m[8] - m[5] * m[7]) - m[1] * (m[3] * m[8] - m[5] * m[6]) + m[2] * (m[3] * m[7] - m[4] * m[6]);
+}
+
+int bs_point_group(const cl_geometry_t *geom, double tol, bs_point_group_t *group) {
+	double G[9] = { 1, 0, 0, 0, 1, 0, 0, 0, 1 }, gmax = 0.0;
+	size_t dim, combos = 1;
+
+	if (!geom || !geom->vectors || !group || geom->dim == 0 || geom->dim > 3 || geom->vectors->size1 < geom->dim
+	    || geom->vectors->size2 < geom->dim)
+		return -1;
+	dim = geom->dim;
+	if (tol <= 0.0)
+		tol = BS_TOL;
+	for (size_t a = 0; a < dim; a++) {
+		for (size_t b = 0; b < dim; b++) {
+			double s = 0.0;
+			for (size_t c = 0; c < dim; c++)
+				s += gsl_matrix_get(geom->vectors, a, c) * gsl_matrix_get(geom->vectors, b, c);
+			G[a * 3 + b] = s;
+			if (fabs(s) > gmax)
+				gmax = fabs(s);
+		}
+	}
+	if (!(gmax > 0.0))
+		return -1;
+	for (size_t i = 0; i < dim * dim; i++)
+		combos *= 3;
+
+	group->n_ops = 0;
+	for (size_t code = 0; code < combos; code++) {
+		int W[9] = { 1, 0, 0, 0, 1, 0, 0, 0, 1 }, det, ok = 1;
+		size_t c = code;
+
+		for (size_t a = 0; a < dim; a++)
+			for (size_t b = 0; b < dim; b++, c /= 3)
+				W[a * 3 + b] = (int)(c % 3) - 1;
+		det = bs_det3(W);
+		if (det != 1 && det != -1)
+			continue;
+		/* W^T G W = G */
+		for (size_t a = 0; a < 3 && ok; a++) {
+			for (size_t b = 0; b < 3 && ok; b++) {
+				double s = 0.0;
+				for (size_t p = 0; p < 3; p++)
+					for (size_t q = 0; q < 3; q++)
+						s += W[p * 3 + a] * G[p * 3 + q] * W[q * 3 + b];
+				ok = fabs(s - G[a * 3 + b]) <= tol * gmax;
+			}
+		}
+		if (!ok)
+			continue;
+		if (group->n_ops == BS_MAX_OPS)
+			return -1;
+		/* k transforms with W^-T = adj(W)^T / det */
+		{
+			int *R = group->rot[group->n_ops++];
+			for (size_t a = 0; a < 3; a++) {
+				for (size_t b = 0; b < 3; b++) {
+					const size_t a1 = (a + 1) % 3, a2 = (a + 2) % 3, b1 = (b + 1) % 3, b2 = (b + 2) % 3;
+					R[a * 3 + b] = det * (W[a1 * 3 + b1] * W[a2 * 3 + b2] - W[a1 * 3 + b2] * W[a2 * 3 + b1]);
+				}
+			}
+		}
+	}
+	return group->n_ops ? 0 : -1;
+}
+
+/* -------------------------------
+   Mesh
+   ------------------------------- */
+
+static size_t bs_gcd(size_t a, size_t b) {
+	while (b) {
+		size_t t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+/* Image of point i under sign * R, or SIZE_MAX when it falls off the mesh */
+static size_t bs_mesh_image(const bs_kmesh_t *m, const int *R, int sign, size_t i, long long L) {
+	long long q[3], idx[3];
+	size_t r = i;
+
+	for (int a = 2; a >= 0; a--) {
+		q[a] = 2 * (long long)(r % m->n[a]) + m->shift[a];
+		r /= m->n[a];
+	}
+	for (int a = 0; a < 3; a++) {
+		long long P = 0, Q;
+		for (int b = 0; b < 3; b++)
+			P += (long long)R[a * 3 + b] * q[b] * (L / (long long)m->n[b]);
+		P *= sign * (long long)m->n[a];
+		if (P % L != 0)
+			return SIZE_MAX;
+		Q = P / L - m->shift[a];
+		if (Q % 2 != 0)
+			return SIZE_MAX;
+		Q /= 2;
+		Q %= (long long)m->n[a];
+		idx[a] = Q < 0 ? Q + (long long)m->n[a] : Q;
+	}
+	return ((size_t)idx[0] * m->n[1] + (size_t)idx[1]) * m->n[2] + (size_t)idx[2];
+}
+
+void bs_kmesh_point(const bs_kmesh_t *mesh, size_t i, double k[3]) {
+	for (int a = 2; a >= 0; a--) {
+		const size_t na = mesh->n[a];
+		double f = (double)(2 * (i % na) + (size_t)mesh->shift[a]) / (double)(2 * na);
+		k[a] = f >= 0.5 ? f - 1.0 : f;
+		i /= na;
+	}
+}
+
+void bs_kmesh_free(bs_kmesh_t *mesh) {
+	if (!mesh)
+		return;
+	free(mesh->k);
+	free(mesh->weight);
+	free(mesh->irr);
+	free(mesh->op);
+	free(mesh->full);
+	free(mesh);
+}
+
+bs_kmesh_t *bs_kmesh_alloc(size_t dim, const size_t n[3], const int shift[3], const bs_point_group_t *group) {
+	static const bs_point_group_t identity = { 1, { { 1, 0, 0, 0, 1, 0, 0, 0, 1 } } };
+	bs_kmesh_t *m;
+	long long L;
+	int valid[2 * BS_MAX_OPS];
+	size_t *count;
+
+	if (dim == 0 || dim > 3 || !n)
+		return NULL;
+	if (!group || group->n_ops == 0)
+		group = &identity;
+	if (group->n_ops > BS_MAX_OPS)
+		return NULL;
+	m = calloc(1, sizeof(*m));
+	if (!m)
+		return NULL;
+	m->dim = dim;
+	m->n_full = 1;
+	for (size_t a = 0; a < 3; a++) {
+		m->n[a] = a < dim ? n[a] : 1;
+		m->shift[a] = a < dim && shift && shift[a] ? 1 : 0;
+		if (m->n[a] == 0 || m->n[a] > (size_t)1 << 20) {
+			free(m);
+			return NULL;
+		}
+		m->n_full *= m->n[a];
+	}
+	L = (long long)(m->n[0] / bs_gcd(m->n[0], m->n[1]) * m->n[1]);
+	L = L / (long long)bs_gcd((size_t)L, m->n[2]) * (long long)m->n[2];
+
+	m->irr = malloc(m->n_full * sizeof(size_t));
+	m->op = malloc(m->n_full * sizeof(int));
+	m->full = malloc(m->n_full * sizeof(size_t));
+	count = malloc(m->n_full * sizeof(size_t));
+	if (!m->irr || !m->op || !m->full || !count) {
+		free(count);
+		bs_kmesh_free(m);
+		return NULL;
+	}
+
+	/* Ops (then with time reversal) that keep the mesh */
+	for (size_t o = 0; o < 2 * group->n_ops; o++) {
+		const int *R = group->rot[o % group->n_ops], sign = o < group->n_ops ? 1 : -1;
+		valid[o] = 1;
+		for (size_t i = 0; i < m->n_full && valid[o]; i++)
+			valid[o] = bs_mesh_image(m, R, sign, i, L) != SIZE_MAX;
+	}
+
+	for (size_t i = 0; i < m->n_full; i++)
+		m->irr[i] = SIZE_MAX;
+	for (size_t i = 0; i < m->n_full; i++) {
+		if (m->irr[i] != SIZE_MAX)
+			continue;
+		const size_t r = m->n_irr++;
+		m->full[r] = i;
+		count[r] = 0;
+		for (size_t o = 0; o < 2 * group->n_ops; o++) {
+			if (!valid[o])
+				continue;
+			const size_t j = bs_mesh_image(m, group->rot[o % group->n_ops], o < group->n_ops ? 1 : -1, i, L);
+			if (m->irr[j] == SIZE_MAX) {
+				m->irr[j] = r;
+				m->op[j] = o < group->n_ops ? (int)o : -(int)(o - group->n_ops) - 1;
+				count[r]++;
+			}
+		}
+		if (m->irr[i] == SIZE_MAX) {
+			/* Only when the identity itself fails, which it cannot */
+			m->irr[i] = r;
+			m->op[i] = 0;
+			count[r]++;
+		}
+	}
+
+	m->k = malloc(3 * m->n_irr * sizeof(double));
+	m->weight = malloc(m->n_irr * sizeof(double));
+	if (!m->k || !m->weight) {
+		free(count);
+		bs_kmesh_free(m);
+		return NULL;
+	}
+	for (size_t r = 0; r < m->n_irr; r++) {
+		bs_kmesh_point(m, m->full[r], m->k + 3 * r);
+		m->weight[r] = (double)count[r] / (double)m->n_full;
+	}
+	free(count);
+	return m;
+}
+
+int bs_kmesh_kpoints(const bs_kmesh_t *mesh, const gsl_matrix *recip, bs_kpoint_t **kpoints) {
+	const size_t dim = mesh ? mesh->dim : 0;
+	double *kv;
+	int rc;
+
+	if (!mesh || !kpoints || (recip && (recip->size1 < dim || recip->size2 < dim)))
+		return -1;
+	kv = malloc(mesh->n_irr * dim * sizeof(double));
+	if (!kv)
+		return -1;
+	for (size_t r = 0; r < mesh->n_irr; r++) {
+		const double *f = mesh->k + 3 * r;
+		for (size_t c = 0; c < dim; c++) {
+			double s = 0.0;
+			if (!recip)
+				s = f[c];
+			else
+				for (size_t a = 0; a < dim; a++)
+					s += f[a] * gsl_matrix_get(recip, a, c);
+			kv[r * dim + c] = s;
+		}
+	}
+	rc = bs_kpoint_batch_alloc(kpoints, mesh->n_irr, dim, kv, mesh->weight, NULL, NULL);
+	free(kv);
+	return rc;
+}
+
+int bs_kmesh_unfold(const bs_kmesh_t *mesh, const double *values, size_t width, double *full) {
+	if (!mesh || !values || !full || width == 0)
+		return -1;
+	for (size_t i = 0; i < mesh->n_full; i++)
+		memcpy(full + i * width, values + mesh->irr[i] * width, width * sizeof(double));
+	return 0;
+}
+
+/* -------------------------------
+   Tetrahedra
+   ------------------------------- */
+
+/* Corners (bits 0..2 = steps along axes 0..2) of the six tetrahedra of a
+   cell, and the geometry they share */
+typedef struct {
+	int corner[6][4];
+	double grad[6][9];              /* Maps corner energy differences to the Cartesian gradient */
+	double volume;                  /* Of one tetrahedron, as a fraction of the zone */
+	double zone;                    /* Zone volume (with recip) */
+} bs_tetra_t;
+
+static void bs_tetra_setup(const bs_kmesh_t *m, const gsl_matrix *recip, bs_tetra_t *tt) {
+	static const int perm[6][3] = { { 0, 1, 2 }, { 0, 2, 1 }, { 1, 0, 2 }, { 1, 2, 0 }, { 2, 0, 1 }, { 2, 1, 0 } };
+	double B[9] = { 1, 0, 0, 0, 1, 0, 0, 0, 1 }, best = INFINITY;
+	int flip = 0;
+
+	if (recip)
+		for (size_t a = 0; a < m->dim; a++)
+			for (size_t c = 0; c < m->dim; c++)
+				B[a * 3 + c] = gsl_matrix_get(recip, a, c);
+	/* Cell edges in Cartesian k */
+	for (size_t a = 0; a < 3; a++)
+		for (size_t c = 0; c < 3; c++)
+			B[a * 3 + c] /= (double)m->n[a];
+	/* Shortest of the four diagonals, from corner f to corner 7 ^ f */
+	for (int f = 0; f < 4; f++) {
+		double d2 = 0.0;
+		for (size_t c = 0; c < 3; c++) {
+			double s = 0.0;
+			for (size_t a = 0; a < 3; a++)
+				s += ((f >> a) & 1 ? -1.0 : 1.0) * B[a * 3 + c];
+			d2 += s * s;
+		}
+		if (d2 < best - 1e-12 * best) {
+			best = d2;
+			flip = f;
+		}
+	}
+	for (int t = 0; t < 6; t++) {
+		int c = 0;
+		double D[9], det;
+		tt->corner[t][0] = flip;
+		for (int s = 0; s < 3; s++) {
+			c |= 1 << perm[t][s];
+			tt->corner[t][s + 1] = c ^ flip;
+		}
+		/* Rows: corner s+1 minus corner 0, in Cartesian k */
+		for (int s = 0; s < 3; s++) {
+			for (size_t x = 0; x < 3; x++) {
+				double v = 0.0;
+				for (size_t a = 0; a < 3; a++)
+					v += (double)(((tt->corner[t][s + 1] >> a) & 1) - ((tt->corner[t][0] >> a) & 1)) * B[a * 3 + x];
+				D[s * 3 + x] = v;
+			}
+		}
+		det = D[0] * (D[4] * D[8] - D[5] * D[7]) - D[1] * (D[3] * D[8] - D[5] * D[6]) + D[2] * (D[3] * D[7] - D[4] * D[6]);
+		for (size_t a = 0; a < 3; a++) {
+			for (size_t b = 0; b < 3; b++) {
+				const size_t a1 = (a + 1) % 3, a2 = (a + 2) % 3, b1 = (b + 1) % 3, b2 = (b + 2) % 3;
+				/* inverse(D)[b][a] = cofactor(a, b) / det */
+				tt->grad[t][b * 3 + a] = (D[a1 * 3 + b1] * D[a2 * 3 + b2] - D[a1 * 3 + b2] * D[a2 * 3 + b1]) / det;
+			}
+		}
+		if (t == 0)
+			tt->zone = fabs(det) * (double)m->n_full;
+	}
+	tt->volume = 1.0 / (6.0 * (double)m->n_full);
+}
+
+/* Mesh indices of the eight corners of cell c */
+static void bs_cell_corners(const bs_kmesh_t *m, size_t c, size_t idx[8]) {
+	const size_t i2 = c % m->n[2], i1 = (c / m->n[2]) % m->n[1], i0 = c / (m->n[1] * m->n[2]);
+	for (int k = 0; k < 8; k++) {
+		const size_t j0 = (i0 + (k & 1)) % m->n[0], j1 = (i1 + ((k >> 1) & 1)) % m->n[1];
+		const size_t j2 = (i2 + ((k >> 2) & 1)) % m->n[2];
+		idx[k] = (j0 * m->n[1] + j1) * m->n[2] + j2;
+	}
+}
+
+static void bs_sort4(double *e) {
+	for (int i = 1; i < 4; i++) {
+		double v = e[i];
+		int j = i - 1;
+		while (j >= 0 && e[j] > v) {
+			e[j + 1] = e[j];
+			j--;
+		}
+		e[j + 1] = v;
+	}
+}
+
+/* Fraction of the tetrahedron (sorted corner energies e) below E, and
+   its derivative (per unit energy) */
+static void bs_tetra_weight(const double *e, double E, double *n, double *g) {
+	if (E <= e[0]) {
+		*n = 0.0;
+		*g = 0.0;
+	} else if (E >= e[3]) {
+		*n = 1.0;
+		*g = 0.0;
+	} else if (E < e[1]) {
+		const double d = E - e[0], den = (e[1] - e[0]) * (e[2] - e[0]) * (e[3] - e[0]);
+		*n = d * d * d / den;
+		*g = 3.0 * d * d / den;
+	} else if (E < e[2]) {
+		const double d = E - e[1], e21 = e[1] - e[0], a = (e[2] - e[0]) * (e[3] - e[0]);
+		const double b = (e[2] - e[0] + e[3] - e[1]) / ((e[2] - e[1]) * (e[3] - e[1]));
+		*n = (e21 * e21 + 3.0 * e21 * d + 3.0 * d * d - b * d * d * d) / a;
+		*g = (3.0 * e21 + 6.0 * d - 3.0 * b * d * d) / a;
+	} else {
+		const double d = e[3] - E, den = (e[3] - e[0]) * (e[3] - e[1]) * (e[3] - e[2]);
+		*n = 1.0 - d * d * d / den;
+		*g = 3.0 * d * d / den;
+	}
+}
+
+static int bs_tetra_args(const bs_kmesh_t *mesh, const double *energies, size_t n_bands) {
+	return mesh && energies && n_bands > 0 && mesh->n_irr > 0 ? 0 : -1;
+}
+
+/* Number of states per cell below E, summed per block */
+static double bs_tetra_count(const bs_kmesh_t *m, const bs_tetra_t *tt, const double *energies, size_t nb, double E) {
+	double part[BS_BLOCKS], sum = 0.0;
+	const size_t nc = m->n_full;
+
+	#pragma omp parallel for schedule(static)
+	for (int blk = 0; blk < BS_BLOCKS; blk++) {
+		const size_t c0 = nc * (size_t)blk / BS_BLOCKS, c1 = nc * (size_t)(blk + 1) / BS_BLOCKS;
+		double s = 0.0;
+		for (size_t c = c0; c < c1; c++) {
+			size_t idx[8];
+			bs_cell_corners(m, c, idx);
+			for (size_t b = 0; b < nb; b++) {
+				for (int t = 0; t < 6; t++) {
+					double e[4], n, g;
+					for (int v = 0; v < 4; v++)
+						e[v] = energies[m->irr[idx[tt->corner[t][v]]] * nb + b];
+					bs_sort4(e);
+					bs_tetra_weight(e, E, &n, &g);
+					s += n;
+				}
+			}
+		}
+		part[blk] = s;
+	}
+	for (int blk = 0; blk < BS_BLOCKS; blk++)
+		sum += part[blk];
+	return sum * tt->volume;
+}
+
+int bs_tetra_dos(const bs_kmesh_t *mesh, const gsl_matrix *recip, const double *energies, size_t n_bands,
+	double degeneracy, const double *E, size_t n_e, double *dos, double *idos) {
+	bs_tetra_t tt;
+	double *acc;
+	const size_t nc = mesh ? mesh->n_full : 0;
+
+	if (bs_tetra_args(mesh, energies, n_bands) != 0 || !E || n_e == 0 || (!dos && !idos))
+		return -1;
+	for (size_t i = 1; i < n_e; i++)
+		if (!(E[i] >= E[i - 1]))
+			return -1;
+	/* Per block: dos, idos inside the tetrahedra, and steps of idos above them */
+	acc = calloc((size_t)BS_BLOCKS * 3 * (n_e + 1), sizeof(double));
+	if (!acc)
+		return -1;
+	bs_tetra_setup(mesh, recip, &tt);
+
+	#pragma omp parallel for schedule(static)
+	for (int blk = 0; blk < BS_BLOCKS; blk++) {
+		const size_t c0 = nc * (size_t)blk / BS_BLOCKS, c1 = nc * (size_t)(blk + 1) / BS_BLOCKS;
+		double *d = acc + (size_t)blk * 3 * (n_e + 1), *in = d + n_e + 1, *step = in + n_e + 1;
+		for (size_t c = c0; c < c1; c++) {
+			size_t idx[8];
+			bs_cell_corners(mesh, c, idx);
+			for (size_t b = 0; b < n_bands; b++) {
+				for (int t = 0; t < 6; t++) {
+					double e[4];
+					size_t lo = 0, hi = n_e, i;
+					for (int v = 0; v < 4; v++)
+						e[v] = energies[mesh->irr[idx[tt.corner[t][v]]] * n_bands + b];
+					bs_sort4(e);
+					/* First E above e0; then E inside (e0, e3), and a unit
+					   step of idos from the first E at or above e3 */
+					while (lo < hi) {
+						const size_t mid = lo + (hi - lo) / 2;
+						if (E[mid] <= e[0])
+							lo = mid + 1;
+						else
+							hi = mid;
+					}
+					for (i = lo; i < n_e && E[i] < e[3]; i++) {
+						double n, g;
+						bs_tetra_weight(e, E[i], &n, &g);
+						d[i] += g;
+						in[i] += n;
+					}
+					step[i] += 1.0;
+				}
+			}
+		}
+	}
+	for (size_t i = 0; i < n_e; i++) {
+		double dv = 0.0, iv = 0.0;
+		for (int blk = 0; blk < BS_BLOCKS; blk++) {
+			const double *d = acc + (size_t)blk * 3 * (n_e + 1);
+			dv += d[i];
+			iv += d[n_e + 1 + i];
+		}
+		if (dos)
+			dos[i] = degeneracy * tt.volume * dv;
+		if (idos)
+			idos[i] = iv;
+	}
+	if (idos) {
+		double run = 0.0;
+		for (size_t i = 0; i < n_e; i++) {
+			for (int blk = 0; blk < BS_BLOCKS; blk++)
+				run += acc[(size_t)blk * 3 * (n_e + 1) + 2 * (n_e + 1) + i];
+			idos[i] = degeneracy * tt.volume * (idos[i] + run);
+		}
+	}
+	free(acc);
+	return 0;
+}
+
+int bs_tetra_fermi(const bs_kmesh_t *mesh, const double *energies, size_t n_bands, double degeneracy,
+	double n_electrons, double *fermi) {
+	bs_tetra_t tt;
+	double lo = INFINITY, hi = -INFINITY, target;
+
+	if (bs_tetra_args(mesh, energies, n_bands) != 0 || !fermi || !(degeneracy > 0.0) || !(n_electrons >= 0.0)
+	    || n_electrons > degeneracy * (double)n_bands)
+		return -1;
+	for (size_t i = 0; i < mesh->n_irr * n_bands; i++) {
+		if (energies[i] < lo)
+			lo = energies[i];
+		if (energies[i] > hi)
+			hi = energies[i];
+	}
+	if (!isfinite(lo) || !isfinite(hi))
+		return -1;
+	bs_tetra_setup(mesh, NULL, &tt);
+	target = n_electrons / degeneracy;
+	/* Bisection on the (monotone) band filling */
+	for (int it = 0; it < BS_FERMI_ITER && hi - lo > 1e-13 * (fabs(lo) + fabs(hi) + 1e-300); it++) {
+		const double mid = 0.5 * (lo + hi);
+		if (bs_tetra_count(mesh, &tt, energies, n_bands, mid) < target)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	*fermi = 0.5 * (lo + hi);
+	return 0;
+}
+
+double bs_tetra_fermi_area(const bs_kmesh_t *mesh, const gsl_matrix *recip, const double *energies, size_t n_bands,
+	double fermi) {
+	bs_tetra_t tt;
+	double part[BS_BLOCKS], sum = 0.0;
+	const size_t nc = mesh ? mesh->n_full : 0;
+
+	if (bs_tetra_args(mesh, energies, n_bands) != 0 || !recip || recip->size1 < mesh->dim || recip->size2 < mesh->dim
+	    || !isfinite(fermi))
+		return -1.0;
+	bs_tetra_setup(mesh, recip, &tt);
+
+	#pragma omp parallel for schedule(static)
+	for (int blk = 0; blk < BS_BLOCKS; blk++) {
+		const size_t c0 = nc * (size_t)blk / BS_BLOCKS, c1 = nc * (size_t)(blk + 1) / BS_BLOCKS;
+		double s = 0.0;
+		for (size_t c = c0; c < c1; c++) {
+			size_t idx[8];
+			bs_cell_corners(mesh, c, idx);
+			for (size_t b = 0; b < n_bands; b++) {
+				for (int t = 0; t < 6; t++) {
+					double e[4], de[3], gr[3] = { 0.0, 0.0, 0.0 }, n, g;
+					for (int v = 0; v < 4; v++)
+						e[v] = energies[mesh->irr[idx[tt.corner[t][v]]] * n_bands + b];
+					if (fermi <= fmin(fmin(e[0], e[1]), fmin(e[2], e[3])) || fermi >= fmax(fmax(e[0], e[1]), fmax(e[2], e[3])))
+						continue;
+					for (int v = 0; v < 3; v++)
+						de[v] = e[v + 1] - e[0];
+					for (int x = 0; x < 3; x++)
+						for (int v = 0; v < 3; v++)
+							gr[x] += tt.grad[t][x * 3 + v] * de[v];
+					bs_sort4(e);
+					bs_tetra_weight(e, fermi, &n, &g);
+					/* dV/dE = A / |grad E| */
+					s += g * sqrt(gr[0] * gr[0] + gr[1] * gr[1] + gr[2] * gr[2]);
+				}
+			}
+		}
+		part[blk] = s;
+	}
+	for (int blk = 0; blk < BS_BLOCKS; blk++)
+		sum += part[blk];
+	return sum * tt.volume * tt.zone;
+}
+
+/* -------------------------------
+   System
+   ------------------------------- */
+
+static int bs_system_bands(const bs_system_t *system) {
+	const bs_hamiltonian_t *ham = system ? system->hamiltonian : NULL;
+	return ham && system->kmesh && ham->energies && ham->n_kpoints == system->kmesh->n_irr && ham->n_kept > 0 ? 0 : -1;
+}
+
+double bs_fermi_energy(const bs_system_t *system) {
+	double ef;
+
+	if (bs_system_bands(system) != 0 || bs_tetra_fermi(system->kmesh, system->hamiltonian->energies,
+		system->hamiltonian->n_kept, 2.0, system->n_electrons, &ef) != 0)
+		return NAN;
+	return ef;
+}
+
+double bs_fermi_surface_area(const bs_system_t *system) {
+	double a;
+
+	if (bs_system_bands(system) != 0 || !system->reciprocal || !system->reciprocal->vectors)
+		return NAN;
+	a = bs_tetra_fermi_area(system->kmesh, system->reciprocal->vectors, system->hamiltonian->energies,
+		system->hamiltonian->n_kept, system->diagnostics.fermi_energy);
+	return a < 0.0 ? NAN : a;
+}
@@ -0,0 +1,406 @@
+/*
+   band_structure_scf.c - SCF driver with density mixing for HOLOS
+
+   bs_step_scf() over bs_hamiltonian_t (see band_structure.h). Each
+   iteration runs the band engine, asks the update for the output density
+   and mixes it into the next input, with F = out - in:
+   - Linear: in += alpha P F
+   - Pulay/Anderson: with the differences dx, dF of the last inputs and
+     residuals, gamma minimizes |F - sum gamma_j dF_j| (normal equations,
+     slightly regularized) and in += alpha P F - sum gamma_j (dx_j +
+     alpha P dF_j)
+   - Broyden (second method): H = alpha P + sum u_j v_j^T approximates
+     minus the inverse Jacobian; each step adds u = -dx - H dF and
+     v = dF / |dF|^2, and in += H F
+   Histories are rings of the last history pairs. P is the Kerker
+   factor g2 / (g2 + q0^2), which leaves the G = 0 element (the charge)
+   as it is. Checkpoints are written under a temporary name and renamed,
+   so an interrupted write leaves the previous one.
+
+   Copyright (C) 2025 HOLOS Scientific Computing Project
+
+   This file is part of HOLOS.
+
+   HOLOS is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "core/phys/ss/band_structure.h"
+#include "core/trace/trace.h"
+
+#define BS_SCF_ALPHA 0.3
+#define BS_SCF_HISTORY 8
+#define BS_SCF_EVERY 10
+#define BS_SCF_RIDGE 1e-12              /* Relative regularization of the Pulay normal equations */
+#define BS_SCF_MAGIC "HOLOSSCF"
+#define BS_SCF_VERSION 1u
+
+typedef struct {
+	bs_mix_t method;
+	size_t n, cap, count, head;     /* Ring of history pairs; head is the next slot */
+	double *a, *b;                  /* cap x n: Pulay dx and dF, Broyden u and v */
+	double *x_prev, *f_prev;
+	int have_prev;
+	double *out, *f, *t;
+	double *mat, *rhs;              /* Pulay normal equations, cap x cap */
+	uint64_t iteration;
+} bs_mixer;
+
+static void bs_mixer_free(bs_mixer *mx) {
+	if (!mx)
+		return;
+	free(mx->a);
+	free(mx->b);
+	free(mx->x_prev);
+	free(mx->f_prev);
+	free(mx->out);
+	free(mx->f);
+	free(mx->t);
+	free(mx->mat);
+	free(mx->rhs);
+	free(mx);
+}
+
+static bs_mixer *bs_mixer_alloc(bs_mix_t method, size_t n, size_t cap) {
+	bs_mixer *mx = calloc(1, sizeof(*mx));
+	if (!mx)
+		return NULL;
+	mx->method = method;
+	mx->n = n;
+	mx->cap = cap;
+	mx->a = malloc(cap * n * sizeof(double));
+	mx->b = malloc(cap * n * sizeof(double));
+	mx->x_prev = malloc(n * sizeof(double));
+	mx->f_prev = malloc(n * sizeof(double));
+	mx->out = malloc(n * sizeof(double));
+	mx->f = malloc(n * sizeof(double));
+	mx->t = malloc(n * sizeof(double));
+	mx->mat = malloc(cap * cap * sizeof(double));
+	mx->rhs = malloc(cap * sizeof(double));
+	if (!mx->a || !mx->b || !mx->x_prev || !mx->f_prev || !mx->out || !mx->f || !mx->t || !mx->mat || !mx->rhs) {
+		bs_mixer_free(mx);
+		return NULL;
+	}
+	return mx;
+}
+
+/* History pair j, 0 the oldest */
+static size_t bs_slot(const bs_mixer *mx, size_t j) {
+	return (mx->head + mx->cap - mx->count + j) % mx->cap;
+}
+
+static double bs_dot(const double *x, const double *y, size_t n) {
+	double s = 0.0;
+	for (size_t i = 0; i < n; i++)
+		s += x[i] * y[i];
+	return s;
+}
+
+/* y = alpha P x */
+static void bs_precondition(const bs_scf_params *prm, double alpha, const double *x, double *y, size_t n) {
+	const double q2 = prm->kerker_q0 * prm->kerker_q0;
+
+	if (prm->g2 && q2 > 0.0) {
+		for (size_t i = 0; i < n; i++)
+			y[i] = prm->g2[i] > 0.0 ? alpha * x[i] * prm->g2[i] / (prm->g2[i] + q2) : 0.0;
+	} else {
+		for (size_t i = 0; i < n; i++)
+			y[i] = alpha * x[i];
+	}
+}
+
+/* Gaussian elimination with partial pivoting on m x m; b becomes x. */
+static int bs_solve_dense(double *A, double *b, size_t m) {
+	for (size_t c = 0; c < m; c++) {
+		size_t p = c;
+		for (size_t r = c + 1; r < m; r++)
+			if (fabs(A[r * m + c]) > fabs(A[p * m + c]))
+				p = r;
+		if (A[p * m + c] == 0.0)
+			return -1;
+		if (p != c) {
+			for (size_t j = 0; j < m; j++) {
+				double t = A[c * m + j];
+				A[c * m + j] = A[p * m + j];
+				A[p * m + j] = t;
+			}
+			double t = b[c];
+			b[c] = b[p];
+			b[p] = t;
+		}
+		for (size_t r = c + 1; r < m; r++) {
+			double f = A[r * m + c] / A[c * m + c];
+			for (size_t j = c; j < m; j++)
+				A[r * m + j] -= f * A[c * m + j];
+			b[r] -= f * b[c];
+		}
+	}
+	for (size_t c = m; c-- > 0;) {
+		double s = b[c];
+		for (size_t j = c + 1; j < m; j++)
+			s -= A[c * m + j] * b[j];
+		b[c] = s / A[c * m + c];
+	}
+	return 0;
+}
+
+/* -------------------------------
+   Mixing
+   ------------------------------- */
+
+/* Broyden: t = H y */
+static void bs_broyden_apply(const bs_mixer *mx, const bs_scf_params *prm, double alpha, const double *y, double *t) {
+	bs_precondition(prm, alpha, y, t, mx->n);
+	for (size_t j = 0; j < mx->count; j++) {
+		const size_t s = bs_slot(mx, j);
+		const double c = bs_dot(mx->b + s * mx->n, y, mx->n);
+		const double *u = mx->a + s * mx->n;
+		for (size_t i = 0; i < mx->n; i++)
+			t[i] += c * u[i];
+	}
+}
+
+/* Records the step from the previous iteration, then overwrites x with
+   the next input from x and its residual mx->f. */
+static int bs_mix(bs_mixer *mx, const bs_scf_params *prm, double alpha, double *x) {
+	const size_t n = mx->n;
+	double *f = mx->f, *t = mx->t;
+
+	if (mx->have_prev && mx->method != BS_MIX_LINEAR) {
+		double *a = mx->a + mx->head * n, *b = mx->b + mx->head * n;
+
+		/* A full ring drops its oldest pair (the head slot) first */
+		if (mx->count == mx->cap)
+			mx->count--;
+		for (size_t i = 0; i < n; i++) {
+			a[i] = x[i] - mx->x_prev[i];
+			b[i] = f[i] - mx->f_prev[i];
+		}
+		const double df2 = bs_dot(b, b, n);
+		if (df2 > 0.0) {
+			if (mx->method == BS_MIX_BROYDEN) {
+				/* a = -dx - H dF with the history so far, b = dF / |dF|^2 */
+				bs_broyden_apply(mx, prm, alpha, b, t);
+				for (size_t i = 0; i < n; i++) {
+					a[i] = -a[i] - t[i];
+					b[i] /= df2;
+				}
+			}
+			mx->head = (mx->head + 1) % mx->cap;
+			mx->count++;
+		}
+	}
+	memcpy(mx->x_prev, x, n * sizeof(double));
+	memcpy(mx->f_prev, f, n * sizeof(double));
+	mx->have_prev = 1;
+
+	if (mx->method == BS_MIX_BROYDEN) {
+		bs_broyden_apply(mx, prm, alpha, f, t);
+		for (size_t i = 0; i < n; i++)
+			x[i] += t[i];
+	} else {
+		const size_t m = mx->method == BS_MIX_PULAY ? mx->count : 0;
+
+		bs_precondition(prm, alpha, f, t, n);
+		for (size_t i = 0; i < n; i++)
+			x[i] += t[i];
+		if (m > 0) {
+			double tr = 0.0;
+			for (size_t j = 0; j < m; j++) {
+				const double *bj = mx->b + bs_slot(mx, j) * n;
+				for (size_t l = 0; l <= j; l++) {
+					const double d = bs_dot(bj, mx->b + bs_slot(mx, l) * n, n);
+					mx->mat[j * m + l] = mx->mat[l * m + j] = d;
+				}
+				mx->rhs[j] = bs_dot(bj, f, n);
+				tr += mx->mat[j * m + j];
+			}
+			for (size_t j = 0; j < m; j++)
+				mx->mat[j * m + j] += BS_SCF_RIDGE * tr / (double)m;
+			if (bs_solve_dense(mx->mat, mx->rhs, m) != 0)
+				return -1;
+			for (size_t j = 0; j < m; j++) {
+				const size_t s = bs_slot(mx, j);
+				const double g = mx->rhs[j];
+				const double *dx = mx->a + s * n;
+				bs_precondition(prm, alpha, mx->b + s * n, t, n);
+				for (size_t i = 0; i < n; i++)
+					x[i] -= g * (dx[i] + t[i]);
+			}
+		}
+	}
+	return 0;
+}
+
+/* -------------------------------
+   Checkpoints
+   ------------------------------- */
+
+/* Layout: magic, version, method, then n, count, iteration, have_prev
+   (uint64), the input density, x_prev, f_prev and the history pairs from
+   the oldest. */
+static int bs_checkpoint_store(const char *path, const bs_mixer *mx, const double *x) {
+	const size_t len = strlen(path);
+	char *tmp = malloc(len + 5);
+	FILE *fp;
+	int ok;
+
+	if (!tmp)
+		return -1;
+	memcpy(tmp, path, len);
+	memcpy(tmp + len, ".tmp", 5);
+	fp = fopen(tmp, "wb");
+	if (!fp) {
+		free(tmp);
+		return -1;
+	}
+	{
+		const uint32_t version = BS_SCF_VERSION, method = (uint32_t)mx->method;
+		const uint64_t head[4] = { mx->n, mx->count, mx->iteration, (uint64_t)mx->have_prev };
+		const size_t n = mx->n;
+
+		ok = fwrite(BS_SCF_MAGIC, 1, 8, fp) == 8 && fwrite(&version, sizeof version, 1, fp) == 1
+		     && fwrite(&method, sizeof method, 1, fp) == 1 && fwrite(head, sizeof head[0], 4, fp) == 4
+		     && fwrite(x, sizeof *x, n, fp) == n && fwrite(mx->x_prev, sizeof *x, n, fp) == n
+		     && fwrite(mx->f_prev, sizeof *x, n, fp) == n;
+		for (size_t j = 0; ok && j < mx->count; j++) {
+			const size_t s = bs_slot(mx, j);
+			ok = fwrite(mx->a + s * n, sizeof *x, n, fp) == n && fwrite(mx->b + s * n, sizeof *x, n, fp) == n;
+		}
+	}
+	ok = fclose(fp) == 0 && ok;
+	if (!ok || rename(tmp, path) != 0) {
+		remove(tmp);
+		ok = 0;
+	}
+	free(tmp);
+	return ok ? 0 : -1;
+}
+
+/* Restores x and the mixer from path; the newest pairs are kept when the
+   history is shorter now. 0 if resumed, -1 (nothing changed) otherwise. */
+static int bs_checkpoint_load(const char *path, bs_mixer *mx, double *x) {
+	FILE *fp = fopen(path, "rb");
+	char magic[8];
+	uint32_t version, method;
+	uint64_t head[4];
+	int ok;
+
+	if (!fp)
+		return -1;
+	ok = fread(magic, 1, 8, fp) == 8 && memcmp(magic, BS_SCF_MAGIC, 8) == 0
+	     && fread(&version, sizeof version, 1, fp) == 1 && version == BS_SCF_VERSION
+	     && fread(&method, sizeof method, 1, fp) == 1 && method == (uint32_t)mx->method
+	     && fread(head, sizeof head[0], 4, fp) == 4 && head[0] == mx->n;
+	if (ok) {
+		const size_t n = mx->n, count = (size_t)head[1];
+		const size_t skip = count > mx->cap ? count - mx->cap : 0;
+		double *x0 = malloc(n * sizeof(double));
+
+		ok = x0 && fread(x0, sizeof *x0, n, fp) == n && fread(mx->x_prev, sizeof *x0, n, fp) == n
+		     && fread(mx->f_prev, sizeof *x0, n, fp) == n;
+		mx->count = mx->head = 0;
+		for (size_t j = 0; ok && j < count; j++) {
+			const size_t s = j < skip ? 0 : j - skip;
+			ok = fread(mx->a + s * n, sizeof *x0, n, fp) == n && fread(mx->b + s * n, sizeof *x0, n, fp) == n;
+		}
+		ok = ok && fgetc(fp) == EOF;
+		if (ok) {
+			memcpy(x, x0, n * sizeof(double));
+			mx->count = count - skip;
+			mx->head = mx->count % mx->cap;
+			mx->iteration = head[2];
+			mx->have_prev = head[3] != 0;
+		} else {
+			mx->count = mx->head = 0;
+			mx->have_prev = 0;
+		}
+		free(x0);
+	}
+	fclose(fp);
+	return ok ? 0 : -1;
+}
+
+/* -------------------------------
+   Driver
+   ------------------------------- */
+
+int bs_step_scf(bs_system_t *system, double tol, int max_iter) {
+    HOLOS_TRACE_ZONE("bs_step_scf");
+	bs_hamiltonian_t *ham;
+	const bs_scf_params *prm;
+	bs_mixer *mx;
+	double *weights, alpha;
+	size_t n, every;
+	int rc = -1;
+
+	if (!system || !system->hamiltonian || max_iter <= 0)
+		return -1;
+	ham = system->hamiltonian;
+	prm = &ham->scf;
+	n = ham->n_density;
+	ham->n_scf_iterations = 0;
+	if (!ham->update || n == 0 || !ham->density) {
+		if (bs_step_band_calculation(system) != 0)
+			return -1;
+		ham->n_scf_iterations = 1;
+		return 0;
+	}
+	if (prm->method != BS_MIX_LINEAR && prm->method != BS_MIX_PULAY && prm->method != BS_MIX_BROYDEN)
+		return -1;
+	alpha = prm->alpha > 0.0 ? prm->alpha : BS_SCF_ALPHA;
+	every = prm->checkpoint_every ? prm->checkpoint_every : BS_SCF_EVERY;
+
+	mx = bs_mixer_alloc(prm->method, n, prm->history ? prm->history : BS_SCF_HISTORY);
+	weights = malloc(system->n_kpoints * sizeof(double));
+	if (!mx || !weights)
+		goto done;
+	for (size_t i = 0; i < system->n_kpoints; i++)
+		weights[i] = system->kpoints[i] ? system->kpoints[i]->weight : 0.0;
+	if (prm->checkpoint && prm->restart)
+		bs_checkpoint_load(prm->checkpoint, mx, ham->density);
+
+	for (int it = 0; it < max_iter; it++) {
+		if (bs_step_band_calculation(system) != 0)
+			goto done;
+		if (ham->update(ham->energies, weights, ham->n_kpoints, ham->n_kept, ham->density, mx->out, n,
+			ham->params) != 0)
+			goto done;
+		for (size_t i = 0; i < n; i++)
+			mx->f[i] = mx->out[i] - ham->density[i];
+		mx->iteration++;
+		ham->n_scf_iterations = (size_t)mx->iteration;
+		ham->scf_residual = sqrt(bs_dot(mx->f, mx->f, n) / (double)n);
+		if (!isfinite(ham->scf_residual))
+			goto done;
+		if (ham->scf_residual < tol) {
+			rc = 0;
+			goto done;
+		}
+		if (bs_mix(mx, prm, alpha, ham->density) != 0)
+			goto done;
+		if (prm->checkpoint && (mx->iteration % every == 0 || it + 1 == max_iter))
+			bs_checkpoint_store(prm->checkpoint, mx, ham->density);
+	}
+
+done:
+	bs_mixer_free(mx);
+	free(weights);
+	return rc;
+}
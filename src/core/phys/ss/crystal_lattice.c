@@ -0,0 +1,61 @@
+/*
+   crystal_lattice.c - Crystal lattice module for HOLOS
+
+   Cell volume and diagnostics for cl_system_t (see crystal_lattice.h);
+   neighbor lists, virtual supercells and relaxation have their own
+   files.
+
+   Copyright (C) 2025 HOLOS Scientific Computing Project
+
+   This file is part of HOLOS.
+
+   HOLOS is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <math.h>
+
+#include "core/phys/ss/crystal_lattice.h"
+
+/* Length, area or volume spanned by the rows of geom->vectors */
+double cl_unit_cell_volume(const cl_geometry_t *geom) {
+	const gsl_matrix *A;
+
+	if (!geom || !geom->vectors || geom->dim == 0 || geom->dim > 3
+	    || geom->vectors->size1 < geom->dim || geom->vectors->size2 < geom->dim)
+		return 0.0;
+	A = geom->vectors;
+	switch (geom->dim) {
+	case 1:
+		return fabs(gsl_matrix_get(A, 0, 0));
+	case 2:
+		return fabs(gsl_matrix_get(A, 0, 0) * gsl_matrix_get(A, 1, 1) - gsl_matrix_get(A, 0, 1) * gsl_matrix_get(A, 1, 0));
+	default:
+		return fabs(gsl_matrix_get(A, 0, 0) * (gsl_matrix_get(A, 1, 1) * gsl_matrix_get(A, 2, 2) - gsl_matrix_get(A, 1, 2) * gsl_matrix_get(A, 2, 1))
+		            - gsl_matrix_get(A, 0, 1) * (gsl_matrix_get(A, 1, 0) * gsl_matrix_get(A, 2, 2) - gsl_matrix_get(A, 1, 2) * gsl_matrix_get(A, 2, 0))
+		            + gsl_matrix_get(A, 0, 2) * (gsl_matrix_get(A, 1, 0) * gsl_matrix_get(A, 2, 1) - gsl_matrix_get(A, 1, 1) * gsl_matrix_get(A, 2, 0)));
+	}
+}
+
+void cl_diagnostics_update(cl_system_t *system) {
+	if (!system)
+		return;
+	if (system->unit_cell && system->unit_cell->geometry)
+		system->diagnostics.volume = cl_unit_cell_volume(system->unit_cell->geometry);
+	if (system->relax) {
+		system->diagnostics.n_force_calls = system->relax->n_force_calls;
+		system->diagnostics.n_relax_steps = system->relax->n_iterations;
+		system->diagnostics.energy = system->relax->energy;
+		system->diagnostics.max_force = system->relax->max_force;
+	}
+}
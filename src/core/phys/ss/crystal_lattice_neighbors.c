@@ -0,0 +1,410 @@
+/*
+   crystal_lattice_neighbors.c - Periodic neighbor lists for HOLOS
+
+   Linked-cell pair search in a periodic (any triclinic) cell, see
+   crystal_lattice.h:
+   - Atoms are binned by their fractional coordinates, wrapped into the
+     cell; the bin count along each lattice vector comes from the plane
+     spacing 1 / |b_a|, so a bin is at least cutoff + skin thick in every
+     direction however skewed the cell
+   - Each atom scans the bins within that range, with the periodic image
+     of every visited bin; cells thinner than the range simply give more
+     offsets, each a distinct image
+   - Two passes over the atoms (count, then fill), each row written by
+     one thread in a fixed scan order: the list does not depend on the
+     thread count
+   - Images are stored against the unwrapped positions, so bond vectors
+     stay right while atoms drift within the skin
+
+   Copyright (C) 2025 HOLOS Scientific Computing Project
+
+   This file is part of HOLOS.
+
+   HOLOS is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "core/phys/ss/crystal_lattice.h"
+
+#define CL_NL_NONE ((size_t)-1)
+#define CL_NL_PARALLEL_MIN 1024         /* Fewer atoms stay serial */
+
+typedef struct {
+	size_t nb[3], n_bins, bin_cap;
+	int m[3];                       /* Bins scanned each way per axis */
+	size_t *head, *next, *bin;
+	double *w;                      /* Wrapped Cartesian positions (3 n) */
+	int *s;                         /* Cells removed by the wrap (3 n) */
+	size_t n_cap;
+} cl_nl_work;
+
+static int cl_threads(int n_threads) {
+	if (n_threads < 0) {
+#ifdef _OPENMP
+		return omp_get_max_threads();
+#else
+		return 1;
+#endif
+	}
+	return n_threads > 0 ? n_threads : 1;
+}
+
+static double cl_coord(const cl_basis_t *basis, size_t dim, size_t i, size_t a) {
+	return a < dim ? gsl_matrix_get(basis->positions, i, a) : 0.0;
+}
+
+/* Lattice vectors as rows of a 3 x 3 matrix; beyond dim, unit vectors of
+   an open axis. */
+static void cl_cell(const cl_geometry_t *geom, double A[9]) {
+	for (size_t a = 0; a < 3; a++)
+		for (size_t c = 0; c < 3; c++)
+			A[a * 3 + c] = a < geom->dim && c < geom->dim ? gsl_matrix_get(geom->vectors, a, c) : (a == c ? 1.0 : 0.0);
+}
+
+static int cl_invert3(const double *A, double *inv) {
+	const double det = A[0] * (A[4] * A[8] - A[5] * A[7]) - A[1] * (A[3] * A[8] - A[5] * A[6])
+	                   + A[2] * (A[3] * A[7] - A[4] * A[6]);
+	if (!(fabs(det) > 0.0) || !isfinite(det))
+		return -1;
+	for (size_t a = 0; a < 3; a++) {
+		for (size_t b = 0; b < 3; b++) {
+			const size_t a1 = (a + 1) % 3, a2 = (a + 2) % 3, b1 = (b + 1) % 3, b2 = (b + 2) % 3;
+			inv[b * 3 + a] = (A[a1 * 3 + b1] * A[a2 * 3 + b2] - A[a1 * 3 + b2] * A[a2 * 3 + b1]) / det;
+		}
+	}
+	return 0;
+}
+
+static int cl_nl_args(const cl_neighbor_list_t *nl, const cl_geometry_t *geom, const cl_basis_t *basis) {
+	if (!nl || !geom || !geom->vectors || !basis || geom->dim == 0 || geom->dim > 3
+	    || geom->vectors->size1 < geom->dim || geom->vectors->size2 < geom->dim)
+		return -1;
+	if (basis->n_atoms && (!basis->positions || basis->positions->size1 < basis->n_atoms
+	    || basis->positions->size2 < geom->dim))
+		return -1;
+	return 0;
+}
+
+cl_neighbor_list_t *cl_neighbor_list_alloc(double cutoff, double skin) {
+	cl_neighbor_list_t *nl;
+
+	if (!(cutoff > 0.0) || !(skin >= 0.0) || !isfinite(cutoff + skin))
+		return NULL;
+	nl = calloc(1, sizeof(*nl));
+	if (!nl)
+		return NULL;
+	nl->work = calloc(1, sizeof(cl_nl_work));
+	if (!nl->work) {
+		free(nl);
+		return NULL;
+	}
+	nl->cutoff = cutoff;
+	nl->skin = skin;
+	return nl;
+}
+
+void cl_neighbor_list_free(cl_neighbor_list_t *nl) {
+	cl_nl_work *wk;
+
+	if (!nl)
+		return;
+	wk = nl->work;
+	if (wk) {
+		free(wk->head);
+		free(wk->next);
+		free(wk->bin);
+		free(wk->w);
+		free(wk->s);
+		free(wk);
+	}
+	free(nl->offset);
+	free(nl->index);
+	free(nl->image);
+	free(nl->ref);
+	free(nl);
+}
+
+/* Row of atom i: counts entries, and stores them when index is set */
+static size_t cl_nl_row(const cl_neighbor_list_t *nl, const cl_nl_work *wk, const double *A, size_t i,
+	size_t *index, int *image) {
+	const double R2 = (nl->cutoff + nl->skin) * (nl->cutoff + nl->skin);
+	const double *wi = wk->w + 3 * i;
+	const size_t b = wk->bin[i];
+	const long c[3] = { (long)(b / (wk->nb[1] * wk->nb[2])), (long)((b / wk->nb[2]) % wk->nb[1]), (long)(b % wk->nb[2]) };
+	size_t count = 0;
+
+	for (int o0 = -wk->m[0]; o0 <= wk->m[0]; o0++) {
+		for (int o1 = -wk->m[1]; o1 <= wk->m[1]; o1++) {
+			for (int o2 = -wk->m[2]; o2 <= wk->m[2]; o2++) {
+				const int o[3] = { o0, o1, o2 };
+				long t[3], cb[3];
+				double T[3];
+				size_t bb;
+
+				/* Visited bin and the image it is seen at */
+				for (int a = 0; a < 3; a++) {
+					const long nb = (long)wk->nb[a], x = c[a] + o[a];
+					t[a] = x >= 0 ? x / nb : -((-x + nb - 1) / nb);
+					cb[a] = x - t[a] * nb;
+				}
+				for (int x = 0; x < 3; x++)
+					T[x] = (double)t[0] * A[x] + (double)t[1] * A[3 + x] + (double)t[2] * A[6 + x];
+				bb = ((size_t)cb[0] * wk->nb[1] + (size_t)cb[1]) * wk->nb[2] + (size_t)cb[2];
+				for (size_t j = wk->head[bb]; j != CL_NL_NONE; j = wk->next[j]) {
+					const double *wj = wk->w + 3 * j;
+					const double dx = wj[0] + T[0] - wi[0], dy = wj[1] + T[1] - wi[1], dz = wj[2] + T[2] - wi[2];
+					if (j == i && t[0] == 0 && t[1] == 0 && t[2] == 0)
+						continue;
+					if (dx * dx + dy * dy + dz * dz > R2)
+						continue;
+					if (index) {
+						int *im = image + 3 * count;
+						index[count] = j;
+						for (int a = 0; a < 3; a++)
+							im[a] = (int)t[a] - wk->s[3 * j + a] + wk->s[3 * i + a];
+					}
+					count++;
+				}
+			}
+		}
+	}
+	return count;
+}
+
+int cl_neighbor_list_build(cl_neighbor_list_t *nl, const cl_geometry_t *geom, const cl_basis_t *basis) {
+	cl_nl_work *wk;
+	double A[9], inv[9];
+	const double range = nl ? nl->cutoff + nl->skin : 0.0;
+	size_t n, dim;
+	int nt;
+
+	if (cl_nl_args(nl, geom, basis) != 0)
+		return -1;
+	wk = nl->work;
+	n = basis->n_atoms;
+	dim = geom->dim;
+	cl_cell(geom, A);
+	if (cl_invert3(A, inv) != 0)
+		return -1;
+
+	/* Per-atom arrays */
+	if (wk->n_cap < n || !nl->offset) {
+		const size_t cap = n ? n : 1;
+		size_t *offset = realloc(nl->offset, (cap + 1) * sizeof(size_t)), *next, *bin;
+		double *ref, *w;
+		int *s;
+		if (!offset)
+			return -1;
+		nl->offset = offset;
+		if (!(ref = realloc(nl->ref, 3 * cap * sizeof(double))))
+			return -1;
+		nl->ref = ref;
+		if (!(next = realloc(wk->next, cap * sizeof(size_t))))
+			return -1;
+		wk->next = next;
+		if (!(bin = realloc(wk->bin, cap * sizeof(size_t))))
+			return -1;
+		wk->bin = bin;
+		if (!(w = realloc(wk->w, 3 * cap * sizeof(double))))
+			return -1;
+		wk->w = w;
+		if (!(s = realloc(wk->s, 3 * cap * sizeof(int))))
+			return -1;
+		wk->s = s;
+		wk->n_cap = cap;
+	}
+
+	/* Bins at least range thick: plane spacing of axis a is 1 / |column a of inv| */
+	wk->n_bins = 1;
+	for (size_t a = 0; a < 3; a++) {
+		if (a < dim) {
+			const double d = 1.0 / sqrt(inv[a] * inv[a] + inv[3 + a] * inv[3 + a] + inv[6 + a] * inv[6 + a]);
+			double nb = floor(d / range);
+			if (nb < 1.0)
+				nb = 1.0;
+			if (nb > 1024.0)
+				nb = 1024.0;
+			wk->nb[a] = (size_t)nb;
+			wk->m[a] = (int)ceil(range / (d / nb) - 1e-12);
+		} else {
+			wk->nb[a] = 1;
+			wk->m[a] = 0;
+		}
+	}
+	/* No more bins than about two per atom */
+	while (wk->nb[0] * wk->nb[1] * wk->nb[2] > 2 * n + 27) {
+		size_t a = wk->nb[0] >= wk->nb[1] && wk->nb[0] >= wk->nb[2] ? 0 : (wk->nb[1] >= wk->nb[2] ? 1 : 2);
+		wk->nb[a] = (wk->nb[a] + 1) / 2;
+	}
+	for (size_t a = 0; a < dim; a++) {
+		const double d = 1.0 / sqrt(inv[a] * inv[a] + inv[3 + a] * inv[3 + a] + inv[6 + a] * inv[6 + a]);
+		wk->m[a] = (int)ceil(range / (d / (double)wk->nb[a]) - 1e-12);
+	}
+	wk->n_bins = wk->nb[0] * wk->nb[1] * wk->nb[2];
+	if (wk->bin_cap < wk->n_bins) {
+		size_t *head = realloc(wk->head, wk->n_bins * sizeof(size_t));
+		if (!head)
+			return -1;
+		wk->head = head;
+		wk->bin_cap = wk->n_bins;
+	}
+	for (size_t b = 0; b < wk->n_bins; b++)
+		wk->head[b] = CL_NL_NONE;
+
+	/* Wrap and bin; lists are pushed in reverse so they read in atom order */
+	for (size_t i = 0; i < n; i++) {
+		double p[3], f[3];
+		size_t c[3];
+		for (size_t a = 0; a < 3; a++)
+			p[a] = nl->ref[3 * i + a] = cl_coord(basis, dim, i, a);
+		for (size_t a = 0; a < 3; a++) {
+			f[a] = p[0] * inv[a] + p[1] * inv[3 + a] + p[2] * inv[6 + a];
+			if (a < dim) {
+				const double fl = floor(f[a]);
+				wk->s[3 * i + a] = (int)fl;
+				f[a] -= fl;
+				c[a] = (size_t)(f[a] * (double)wk->nb[a]);
+				if (c[a] >= wk->nb[a])
+					c[a] = wk->nb[a] - 1;
+			} else {
+				wk->s[3 * i + a] = 0;
+				c[a] = 0;
+			}
+		}
+		for (size_t x = 0; x < 3; x++)
+			wk->w[3 * i + x] = f[0] * A[x] + f[1] * A[3 + x] + f[2] * A[6 + x];
+		wk->bin[i] = (c[0] * wk->nb[1] + c[1]) * wk->nb[2] + c[2];
+	}
+	for (size_t i = n; i-- > 0;) {
+		wk->next[i] = wk->head[wk->bin[i]];
+		wk->head[wk->bin[i]] = i;
+	}
+
+	/* Count, prefix, fill */
+	nt = cl_threads(nl->n_threads);
+	nl->offset[0] = 0;
+	#pragma omp parallel for schedule(static) num_threads(nt) if(nt > 1 && n >= CL_NL_PARALLEL_MIN)
+	for (size_t i = 0; i < n; i++)
+		nl->offset[i + 1] = cl_nl_row(nl, wk, A, i, NULL, NULL);
+	for (size_t i = 0; i < n; i++)
+		nl->offset[i + 1] += nl->offset[i];
+	if (nl->cap < nl->offset[n] || !nl->index) {
+		const size_t cap = nl->offset[n] + nl->offset[n] / 4 + 16;
+		size_t *index = realloc(nl->index, cap * sizeof(size_t));
+		int *image;
+		if (!index)
+			return -1;
+		nl->index = index;
+		image = realloc(nl->image, 3 * cap * sizeof(int));
+		if (!image)
+			return -1;
+		nl->image = image;
+		nl->cap = cap;
+	}
+	#pragma omp parallel for schedule(static) num_threads(nt) if(nt > 1 && n >= CL_NL_PARALLEL_MIN)
+	for (size_t i = 0; i < n; i++)
+		cl_nl_row(nl, wk, A, i, nl->index + nl->offset[i], nl->image + 3 * nl->offset[i]);
+
+	memcpy(nl->cell, A, sizeof(nl->cell));
+	nl->n_atoms = n;
+	nl->n_builds++;
+	return 0;
+}
+
+/* The list built at cell A0 holds every pair that is now within cutoff
+   as long as (cutoff + 2 max |pos - ref M|) <= (cutoff + skin)(1 - |M - 1|),
+   M = A0^-1 A taking the old cell into the new one: bonds stretch by at
+   most |M - 1| (Frobenius) through the strain, and by the non-affine
+   moves of their two ends on top. */
+int cl_neighbor_list_update(cl_neighbor_list_t *nl, const cl_geometry_t *geom, const cl_basis_t *basis) {
+	double A[9], inv[9], M[9], strain = 0.0, d2max = 0.0;
+	int stale = 0;
+
+	if (cl_nl_args(nl, geom, basis) != 0)
+		return -1;
+	nl->n_updates++;
+	cl_cell(geom, A);
+	if (nl->n_builds == 0 || nl->n_atoms != basis->n_atoms || cl_invert3(nl->cell, inv) != 0)
+		stale = 1;
+	if (!stale && memcmp(A, nl->cell, sizeof(A)) != 0) {
+		for (size_t a = 0; a < 3; a++) {
+			for (size_t b = 0; b < 3; b++) {
+				const double m = inv[a * 3] * A[b] + inv[a * 3 + 1] * A[3 + b] + inv[a * 3 + 2] * A[6 + b];
+				M[a * 3 + b] = m;
+				strain += (m - (a == b)) * (m - (a == b));
+			}
+		}
+		strain = sqrt(strain);
+		stale = strain >= 1.0;
+	} else {
+		for (size_t a = 0; a < 9; a++)
+			M[a] = a % 4 == 0;
+	}
+	for (size_t i = 0; i < basis->n_atoms && !stale; i++) {
+		const double *ref = nl->ref + 3 * i;
+		double d2 = 0.0;
+		for (size_t a = 0; a < 3; a++) {
+			const double d = cl_coord(basis, geom->dim, i, a) - (ref[0] * M[a] + ref[1] * M[3 + a] + ref[2] * M[6 + a]);
+			d2 += d * d;
+		}
+		if (d2 > d2max)
+			d2max = d2;
+	}
+	if (!stale)
+		stale = nl->cutoff + 2.0 * sqrt(d2max) > (nl->cutoff + nl->skin) * (1.0 - strain);
+	if (!stale)
+		return 0;
+	return cl_neighbor_list_build(nl, geom, basis) == 0 ? 1 : -1;
+}
+
+void cl_neighbor_vector(const cl_neighbor_list_t *nl, const cl_geometry_t *geom, const cl_basis_t *basis, size_t i, size_t k, double r[3]) {
+	const size_t j = nl->index[k], dim = geom->dim;
+	const int *im = nl->image + 3 * k;
+
+	for (size_t x = 0; x < 3; x++) {
+		r[x] = cl_coord(basis, dim, j, x) - cl_coord(basis, dim, i, x);
+		if (x < dim)
+			for (size_t a = 0; a < dim; a++)
+				r[x] += (double)im[a] * gsl_matrix_get(geom->vectors, a, x);
+	}
+}
+
+int cl_system_enable_neighbor_list(cl_system_t *system, double cutoff, double skin) {
+	cl_neighbor_list_t *nl;
+
+	if (!system || !system->unit_cell)
+		return -1;
+	nl = cl_neighbor_list_alloc(cutoff, skin);
+	if (!nl)
+		return -1;
+	if (cl_neighbor_list_build(nl, system->unit_cell->geometry, system->unit_cell->basis) != 0) {
+		cl_neighbor_list_free(nl);
+		return -1;
+	}
+	cl_neighbor_list_free(system->neighbors);
+	system->neighbors = nl;
+	return 0;
+}
+
+int cl_system_update_neighbor_list(cl_system_t *system) {
+	if (!system || !system->unit_cell || !system->neighbors)
+		return -1;
+	return cl_neighbor_list_update(system->neighbors, system->unit_cell->geometry, system->unit_cell->basis) < 0 ? -1 : 0;
+}
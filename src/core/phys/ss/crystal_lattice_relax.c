@@ -0,0 +1,466 @@
+/*
+   crystal_lattice_relax.c - Structural relaxation for HOLOS
+
+   Minimizers behind cl_step_relaxation(), see crystal_lattice.h:
+   - One generalized coordinate vector: the atoms in the frame of the
+     starting cell, then (variable cell) the deformation gradient F of
+     the lattice vectors scaled by cell_factor, so that positions r = F u
+     and the cell A = A0 F^T move together and one step rule serves both
+   - FIRE (Bitzek et al., PRL 97, 170201): velocity Verlet-like dynamics
+     mixed toward the force, with adaptive time step
+   - L-BFGS two-loop recursion with a fixed initial curvature; no line
+     search: uphill directions reset the history, and a step that raised
+     the energy also halves the step cap until steps succeed again
+   - Every step is capped so no atom (or cell row) moves more than
+     max_step, and the neighbor list is only rebuilt when the skin is
+     used up
+
+   Copyright (C) 2025 HOLOS Scientific Computing Project
+
+   This file is part of HOLOS.
+
+   HOLOS is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "core/phys/ss/crystal_lattice.h"
+
+#define CL_FIRE_N_MIN 5
+#define CL_FIRE_F_INC 1.1
+#define CL_FIRE_F_DEC 0.5
+#define CL_FIRE_ALPHA 0.1
+#define CL_FIRE_F_ALPHA 0.99
+
+typedef struct {
+	size_t n_atoms, dim, n_dof, cap_dof, m;
+	int variable_cell;
+	double cf;                      /* Cell factor in use */
+	double A0[9], F[9];             /* Starting cell, deformation (dim x dim) */
+	double *x, *g, *dx;             /* Coordinates, gradient, step */
+	double *forces;                 /* Model forces (n_atoms x dim) */
+	double stress[9];
+	/* FIRE */
+	double *v, dt, alpha;
+	size_t n_pos;
+	/* L-BFGS */
+	double *s, *y, *rho, *a, *x_prev, *g_prev, e_prev;
+	double trust;                   /* Step cap, shrunk after uphill steps */
+	size_t head, count;
+	int have_prev;
+} cl_relax_work;
+
+cl_relax_t *cl_relax_alloc(cl_relax_method_t method, cl_force_fn force, void *params) {
+	cl_relax_t *relax;
+
+	if (!force || (method != CL_RELAX_FIRE && method != CL_RELAX_LBFGS))
+		return NULL;
+	relax = calloc(1, sizeof(*relax));
+	if (!relax)
+		return NULL;
+	relax->work = calloc(1, sizeof(cl_relax_work));
+	if (!relax->work) {
+		free(relax);
+		return NULL;
+	}
+	relax->method = method;
+	relax->force = force;
+	relax->params = params;
+	return relax;
+}
+
+static void cl_relax_work_release(cl_relax_work *wk) {
+	free(wk->x);
+	free(wk->g);
+	free(wk->dx);
+	free(wk->forces);
+	free(wk->v);
+	free(wk->s);
+	free(wk->y);
+	free(wk->rho);
+	free(wk->a);
+	free(wk->x_prev);
+	free(wk->g_prev);
+}
+
+void cl_relax_free(cl_relax_t *relax) {
+	if (!relax)
+		return;
+	if (relax->work) {
+		cl_relax_work_release(relax->work);
+		free(relax->work);
+	}
+	free(relax);
+}
+
+/* -------------------------------
+   Small matrices (dim x dim, row-major, stride 3)
+   ------------------------------- */
+
+static double cl_det(const double *M, size_t d) {
+	if (d == 1)
+		return M[0];
+	if (d == 2)
+		return M[0] * M[4] - M[1] * M[3];
+	return M[0] * (M[4] * M[8] - M[5] * M[7]) - M[1] * (M[3] * M[8] - M[5] * M[6]) + M[2] * (M[3] * M[7] - M[4] * M[6]);
+}
+
+/* inv_t = M^{-T} */
+static int cl_inverse_transpose(const double *M, size_t d, double *inv_t) {
+	const double det = cl_det(M, d);
+
+	if (!(fabs(det) > 0.0))
+		return -1;
+	memset(inv_t, 0, 9 * sizeof(double));
+	if (d == 1) {
+		inv_t[0] = 1.0 / det;
+	} else if (d == 2) {
+		inv_t[0] = M[4] / det;
+		inv_t[1] = -M[3] / det;
+		inv_t[3] = -M[1] / det;
+		inv_t[4] = M[0] / det;
+	} else {
+		/* Cofactor matrix over det */
+		for (size_t i = 0; i < 3; i++) {
+			for (size_t j = 0; j < 3; j++) {
+				const size_t i1 = (i + 1) % 3, i2 = (i + 2) % 3, j1 = (j + 1) % 3, j2 = (j + 2) % 3;
+				inv_t[i * 3 + j] = (M[i1 * 3 + j1] * M[i2 * 3 + j2] - M[i1 * 3 + j2] * M[i2 * 3 + j1]) / det;
+			}
+		}
+	}
+	return 0;
+}
+
+/* -------------------------------
+   State
+   ------------------------------- */
+
+static double cl_relax_max_step(const cl_relax_t *relax) {
+	return relax->max_step > 0.0 ? relax->max_step : 0.2;
+}
+
+static int cl_relax_setup(cl_relax_t *relax, cl_unit_cell_t *cell) {
+	cl_relax_work *wk = relax->work;
+	const cl_geometry_t *geom = cell->geometry;
+	const cl_basis_t *basis = cell->basis;
+	const size_t d = geom->dim, n = basis->n_atoms;
+	const size_t n_dof = n * d + (relax->variable_cell ? d * d : 0);
+	const size_t m = relax->history ? relax->history : 10;
+
+	if (n_dof == 0)
+		return -1;
+	if (wk->cap_dof < n_dof || wk->m != m || !wk->x) {
+		cl_relax_work_release(wk);
+		memset(wk, 0, sizeof(*wk));
+		wk->x = malloc(n_dof * sizeof(double));
+		wk->g = malloc(n_dof * sizeof(double));
+		wk->dx = malloc(n_dof * sizeof(double));
+		wk->forces = malloc((n ? n : 1) * d * sizeof(double));
+		wk->v = malloc(n_dof * sizeof(double));
+		wk->s = malloc(m * n_dof * sizeof(double));
+		wk->y = malloc(m * n_dof * sizeof(double));
+		wk->rho = malloc(m * sizeof(double));
+		wk->a = malloc(m * sizeof(double));
+		wk->x_prev = malloc(n_dof * sizeof(double));
+		wk->g_prev = malloc(n_dof * sizeof(double));
+		if (!wk->x || !wk->g || !wk->dx || !wk->forces || !wk->v || !wk->s || !wk->y || !wk->rho || !wk->a
+		    || !wk->x_prev || !wk->g_prev) {
+			cl_relax_work_release(wk);
+			memset(wk, 0, sizeof(*wk));
+			return -1;
+		}
+		wk->cap_dof = n_dof;
+		wk->m = m;
+	}
+	wk->n_atoms = n;
+	wk->dim = d;
+	wk->n_dof = n_dof;
+	wk->variable_cell = relax->variable_cell;
+	wk->cf = relax->cell_factor > 0.0 ? relax->cell_factor : (double)(n ? n : 1);
+
+	/* u = r in the starting frame, F = 1 */
+	memset(wk->A0, 0, sizeof(wk->A0));
+	memset(wk->F, 0, sizeof(wk->F));
+	for (size_t a = 0; a < d; a++) {
+		wk->F[a * 3 + a] = 1.0;
+		for (size_t b = 0; b < d; b++)
+			wk->A0[a * 3 + b] = gsl_matrix_get(geom->vectors, a, b);
+	}
+	for (size_t i = 0; i < n; i++)
+		for (size_t a = 0; a < d; a++)
+			wk->x[i * d + a] = gsl_matrix_get(basis->positions, i, a);
+	if (wk->variable_cell)
+		for (size_t a = 0; a < d; a++)
+			for (size_t b = 0; b < d; b++)
+				wk->x[n * d + a * d + b] = wk->cf * wk->F[a * 3 + b];
+
+	memset(wk->v, 0, n_dof * sizeof(double));
+	wk->dt = relax->dt > 0.0 ? relax->dt : 0.1;
+	wk->alpha = CL_FIRE_ALPHA;
+	wk->n_pos = 0;
+	wk->head = wk->count = 0;
+	wk->have_prev = 0;
+	wk->trust = cl_relax_max_step(relax);
+	return 0;
+}
+
+/* Writes x into the unit cell, calls the model, fills g and max_force */
+static int cl_relax_evaluate(cl_relax_t *relax, cl_system_t *system) {
+	cl_relax_work *wk = relax->work;
+	cl_geometry_t *geom = system->unit_cell->geometry;
+	cl_basis_t *basis = system->unit_cell->basis;
+	const size_t d = wk->dim, n = wk->n_atoms, na = n * d;
+	double energy = 0.0, fmax2 = 0.0;
+
+	if (wk->variable_cell) {
+		for (size_t a = 0; a < d; a++)
+			for (size_t b = 0; b < d; b++)
+				wk->F[a * 3 + b] = wk->x[na + a * d + b] / wk->cf;
+		for (size_t k = 0; k < d; k++) {
+			for (size_t a = 0; a < d; a++) {
+				double s = 0.0;
+				for (size_t b = 0; b < d; b++)
+					s += wk->F[a * 3 + b] * wk->A0[k * 3 + b];
+				gsl_matrix_set(geom->vectors, k, a, s);
+			}
+		}
+	}
+	for (size_t i = 0; i < n; i++) {
+		for (size_t a = 0; a < d; a++) {
+			double s = 0.0;
+			for (size_t b = 0; b < d; b++)
+				s += wk->F[a * 3 + b] * wk->x[i * d + b];
+			gsl_matrix_set(basis->positions, i, a, s);
+		}
+	}
+
+	if (system->neighbors && cl_system_update_neighbor_list(system) != 0)
+		return -1;
+	memset(wk->forces, 0, (n ? n : 1) * d * sizeof(double));
+	memset(wk->stress, 0, sizeof(wk->stress));
+	relax->n_force_calls++;
+	if (relax->force(geom, basis, system->neighbors, &energy, wk->forces, wk->variable_cell ? wk->stress : NULL, relax->params) != 0)
+		return -1;
+
+	/* Atoms: dE/du = F^T dE/dr */
+	for (size_t i = 0; i < n; i++) {
+		double f2 = 0.0;
+		for (size_t b = 0; b < d; b++) {
+			double s = 0.0;
+			for (size_t a = 0; a < d; a++)
+				s -= wk->F[a * 3 + b] * wk->forces[i * d + a];
+			wk->g[i * d + b] = s;
+			f2 += wk->forces[i * d + b] * wk->forces[i * d + b];
+		}
+		if (f2 > fmax2)
+			fmax2 = f2;
+	}
+
+	/* Cell: dH/dF = V (stress + p) F^{-T}, per unit of the scaled coordinate */
+	if (wk->variable_cell) {
+		double inv_t[9], W[9];
+		const double V = cl_unit_cell_volume(geom);
+		if (cl_inverse_transpose(wk->F, d, inv_t) != 0)
+			return -1;
+		for (size_t a = 0; a < d; a++)
+			for (size_t b = 0; b < d; b++)
+				W[a * 3 + b] = V * (wk->stress[a * d + b] + (a == b ? relax->pressure : 0.0));
+		for (size_t a = 0; a < d; a++) {
+			double f2 = 0.0;
+			for (size_t b = 0; b < d; b++) {
+				double s = 0.0;
+				for (size_t c = 0; c < d; c++)
+					s += W[a * 3 + c] * inv_t[c * 3 + b];
+				wk->g[na + a * d + b] = s / wk->cf;
+				f2 += wk->g[na + a * d + b] * wk->g[na + a * d + b];
+			}
+			if (f2 > fmax2)
+				fmax2 = f2;
+		}
+		energy += relax->pressure * V;
+	}
+	relax->energy = energy;
+	relax->max_force = sqrt(fmax2);
+	return 0;
+}
+
+/* Scales dx so no group of dim coordinates moves more than max_step */
+static void cl_relax_cap(cl_relax_work *wk, double max_step) {
+	const size_t d = wk->dim;
+	double big = 0.0;
+
+	for (size_t k = 0; k < wk->n_dof; k += d) {
+		double s2 = 0.0;
+		for (size_t a = 0; a < d; a++)
+			s2 += wk->dx[k + a] * wk->dx[k + a];
+		if (s2 > big)
+			big = s2;
+	}
+	big = sqrt(big);
+	if (big > max_step)
+		for (size_t k = 0; k < wk->n_dof; k++)
+			wk->dx[k] *= max_step / big;
+}
+
+/* -------------------------------
+   Steps
+   ------------------------------- */
+
+static void cl_fire_step(const cl_relax_t *relax, cl_relax_work *wk) {
+	const double dt_max = relax->dt_max > 0.0 ? relax->dt_max : 1.0;
+	double p = 0.0, vv = 0.0, ff = 0.0;
+
+	for (size_t k = 0; k < wk->n_dof; k++) {
+		p -= wk->g[k] * wk->v[k];
+		vv += wk->v[k] * wk->v[k];
+		ff += wk->g[k] * wk->g[k];
+	}
+	if (p > 0.0) {
+		const double mix = ff > 0.0 ? wk->alpha * sqrt(vv / ff) : 0.0;
+		for (size_t k = 0; k < wk->n_dof; k++)
+			wk->v[k] = (1.0 - wk->alpha) * wk->v[k] - mix * wk->g[k];
+		if (wk->n_pos > CL_FIRE_N_MIN) {
+			wk->dt = fmin(wk->dt * CL_FIRE_F_INC, dt_max);
+			wk->alpha *= CL_FIRE_F_ALPHA;
+		}
+		wk->n_pos++;
+	} else {
+		memset(wk->v, 0, wk->n_dof * sizeof(double));
+		wk->dt *= CL_FIRE_F_DEC;
+		wk->alpha = CL_FIRE_ALPHA;
+		wk->n_pos = 0;
+	}
+	for (size_t k = 0; k < wk->n_dof; k++) {
+		wk->v[k] -= wk->dt * wk->g[k];
+		wk->dx[k] = wk->dt * wk->v[k];
+	}
+	cl_relax_cap(wk, cl_relax_max_step(relax));
+}
+
+static void cl_lbfgs_step(const cl_relax_t *relax, cl_relax_work *wk) {
+	const size_t N = wk->n_dof, m = wk->m;
+	const double h0 = 1.0 / (relax->curvature > 0.0 ? relax->curvature : 70.0);
+	double *q = wk->dx, slope = 0.0;
+
+	/* New pair from the last step; a step that raised the energy went past
+	   the quadratic region, so the history is dropped and the cap halved */
+	if (wk->have_prev && relax->energy > wk->e_prev) {
+		wk->count = wk->head = 0;
+		wk->trust *= 0.5;
+	} else if (wk->have_prev) {
+		wk->trust = fmin(1.5 * wk->trust, cl_relax_max_step(relax));
+		double *s = wk->s + wk->head * N, *y = wk->y + wk->head * N, sy = 0.0;
+		for (size_t k = 0; k < N; k++) {
+			s[k] = wk->x[k] - wk->x_prev[k];
+			y[k] = wk->g[k] - wk->g_prev[k];
+			sy += s[k] * y[k];
+		}
+		if (sy > 1e-12) {
+			wk->rho[wk->head] = 1.0 / sy;
+			wk->head = (wk->head + 1) % m;
+			if (wk->count < m)
+				wk->count++;
+		}
+	}
+
+	/* Two-loop recursion, newest pair first */
+	memcpy(q, wk->g, N * sizeof(double));
+	for (size_t c = 0; c < wk->count; c++) {
+		const size_t j = (wk->head + m - 1 - c) % m;
+		const double *s = wk->s + j * N, *y = wk->y + j * N;
+		double a = 0.0;
+		for (size_t k = 0; k < N; k++)
+			a += s[k] * q[k];
+		a *= wk->rho[j];
+		wk->a[j] = a;
+		for (size_t k = 0; k < N; k++)
+			q[k] -= a * y[k];
+	}
+	for (size_t k = 0; k < N; k++)
+		q[k] *= h0;
+	for (size_t c = wk->count; c-- > 0;) {
+		const size_t j = (wk->head + m - 1 - c) % m;
+		const double *s = wk->s + j * N, *y = wk->y + j * N;
+		double b = 0.0;
+		for (size_t k = 0; k < N; k++)
+			b += y[k] * q[k];
+		b *= wk->rho[j];
+		for (size_t k = 0; k < N; k++)
+			q[k] += (wk->a[j] - b) * s[k];
+	}
+	for (size_t k = 0; k < N; k++) {
+		q[k] = -q[k];
+		slope += q[k] * wk->g[k];
+	}
+	if (!(slope < 0.0)) {
+		wk->count = wk->head = 0;
+		for (size_t k = 0; k < N; k++)
+			q[k] = -h0 * wk->g[k];
+	}
+	cl_relax_cap(wk, wk->trust);
+	memcpy(wk->x_prev, wk->x, N * sizeof(double));
+	memcpy(wk->g_prev, wk->g, N * sizeof(double));
+	wk->e_prev = relax->energy;
+	wk->have_prev = 1;
+}
+
+/* -------------------------------
+   Driver
+   ------------------------------- */
+
+int cl_step_relaxation(cl_system_t *system, double tol, int max_iter) {
+	cl_relax_t *relax;
+	cl_relax_work *wk;
+	const cl_unit_cell_t *cell;
+	int status = 1;
+
+	if (!system || !system->relax || !system->unit_cell || !(tol > 0.0) || max_iter < 0)
+		return -1;
+	relax = system->relax;
+	cell = system->unit_cell;
+	if (!cell->geometry || !cell->basis || !cell->geometry->vectors || cell->geometry->dim == 0 || cell->geometry->dim > 3
+	    || (cell->basis->n_atoms && !cell->basis->positions))
+		return -1;
+	if (cl_relax_setup(relax, system->unit_cell) != 0)
+		return -1;
+	wk = relax->work;
+
+	if (cl_relax_evaluate(relax, system) != 0) {
+		status = -1;
+	} else {
+		for (int it = 0; it <= max_iter; it++) {
+			if (relax->max_force < tol) {
+				status = 0;
+				break;
+			}
+			if (it == max_iter)
+				break;
+			if (relax->method == CL_RELAX_FIRE)
+				cl_fire_step(relax, wk);
+			else
+				cl_lbfgs_step(relax, wk);
+			for (size_t k = 0; k < wk->n_dof; k++)
+				wk->x[k] += wk->dx[k];
+			relax->n_iterations++;
+			if (cl_relax_evaluate(relax, system) != 0) {
+				status = -1;
+				break;
+			}
+		}
+	}
+	cl_diagnostics_update(system);
+	return status;
+}
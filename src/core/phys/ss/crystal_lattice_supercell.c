@@ -0,0 +1,378 @@
+/*
+   crystal_lattice_supercell.c - Virtual supercells for HOLOS
+
+   Supercells addressed as (basis atom, cell), see crystal_lattice.h:
+   - Positions are rebuilt on the fly from the lattice translation;
+     nothing is stored per atom except at the perturbed sites, a sorted
+     sparse array searched by bisection
+   - Neighbors reuse the unit-cell list, translated to the atom's cell
+   - The pair energy is the unit-cell energy times the cell count plus a
+     correction summed over the bonds of the perturbed sites, so its cost
+     does not grow with the supercell
+   cl_step_supercell() and cl_step_defect() drive the view for a system.
+
+   Copyright (C) 2025 HOLOS Scientific Computing Project
+
+   This file is part of HOLOS.
+
+   HOLOS is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "core/phys/ss/crystal_lattice.h"
+
+/* -------------------------------
+   View
+   ------------------------------- */
+
+cl_supercell_t *cl_supercell_alloc(const cl_unit_cell_t *cell, size_t nx, size_t ny, size_t nz) {
+	const size_t n[3] = { nx, ny, nz };
+	const cl_geometry_t *geom;
+	cl_supercell_t *sc;
+
+	if (!cell || !cell->geometry || !cell->basis || !cell->geometry->vectors)
+		return NULL;
+	geom = cell->geometry;
+	if (geom->dim == 0 || geom->dim > 3 || geom->vectors->size1 < geom->dim || geom->vectors->size2 < geom->dim)
+		return NULL;
+	if (cell->basis->n_atoms && (!cell->basis->positions || cell->basis->positions->size2 < geom->dim))
+		return NULL;
+	sc = calloc(1, sizeof(*sc));
+	if (!sc)
+		return NULL;
+	sc->cell = cell;
+	sc->dim = geom->dim;
+	sc->n_basis = cell->basis->n_atoms;
+	sc->n_cells = 1;
+	for (size_t a = 0; a < 3; a++) {
+		sc->n[a] = a < sc->dim ? n[a] : 1;
+		if (sc->n[a] == 0 || sc->n_cells > ((size_t)-1) / sc->n[a]) {
+			free(sc);
+			return NULL;
+		}
+		sc->n_cells *= sc->n[a];
+		for (size_t c = 0; c < 3; c++)
+			sc->vectors[a * 3 + c] = a < sc->dim && c < sc->dim ? gsl_matrix_get(geom->vectors, a, c) : 0.0;
+	}
+	if (sc->n_basis && sc->n_cells > ((size_t)-1) / sc->n_basis) {
+		free(sc);
+		return NULL;
+	}
+	sc->n_atoms = sc->n_cells * sc->n_basis;
+	return sc;
+}
+
+void cl_supercell_free(cl_supercell_t *sc) {
+	if (!sc)
+		return;
+	free(sc->sites);
+	free(sc);
+}
+
+size_t cl_supercell_atom(const cl_supercell_t *sc, size_t b, const size_t c[3]) {
+	return ((c[0] * sc->n[1] + c[1]) * sc->n[2] + c[2]) * sc->n_basis + b;
+}
+
+void cl_supercell_split(const cl_supercell_t *sc, size_t atom, size_t *b, size_t c[3]) {
+	const size_t cell = atom / sc->n_basis;
+
+	*b = atom % sc->n_basis;
+	c[2] = cell % sc->n[2];
+	c[1] = (cell / sc->n[2]) % sc->n[1];
+	c[0] = cell / (sc->n[1] * sc->n[2]);
+}
+
+/* -------------------------------
+   Perturbed sites
+   ------------------------------- */
+
+/* First site with atom >= key */
+static size_t cl_site_find(const cl_supercell_t *sc, size_t atom) {
+	size_t lo = 0, hi = sc->n_sites;
+
+	while (lo < hi) {
+		const size_t mid = lo + (hi - lo) / 2;
+		if (sc->sites[mid].atom < atom)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+const cl_site_t *cl_supercell_site(const cl_supercell_t *sc, size_t atom) {
+	size_t k;
+
+	if (!sc || sc->n_sites == 0)
+		return NULL;
+	k = cl_site_find(sc, atom);
+	return k < sc->n_sites && sc->sites[k].atom == atom ? &sc->sites[k] : NULL;
+}
+
+/* Site of atom, inserted as a perfect one if absent */
+static cl_site_t *cl_site_get(cl_supercell_t *sc, size_t atom) {
+	size_t k;
+
+	if (!sc || atom >= sc->n_atoms)
+		return NULL;
+	k = cl_site_find(sc, atom);
+	if (k < sc->n_sites && sc->sites[k].atom == atom)
+		return &sc->sites[k];
+	if (sc->n_sites == sc->cap_sites) {
+		const size_t cap = sc->cap_sites ? 2 * sc->cap_sites : 16;
+		cl_site_t *sites = realloc(sc->sites, cap * sizeof(*sites));
+		if (!sites)
+			return NULL;
+		sc->sites = sites;
+		sc->cap_sites = cap;
+	}
+	memmove(sc->sites + k + 1, sc->sites + k, (sc->n_sites - k) * sizeof(*sc->sites));
+	sc->n_sites++;
+	memset(&sc->sites[k], 0, sizeof(sc->sites[k]));
+	sc->sites[k].atom = atom;
+	return &sc->sites[k];
+}
+
+int cl_supercell_displace(cl_supercell_t *sc, size_t atom, const double u[3]) {
+	cl_site_t *site;
+
+	if (!u)
+		return -1;
+	site = cl_site_get(sc, atom);
+	if (!site)
+		return -1;
+	for (size_t a = 0; a < 3; a++)
+		site->u[a] = a < sc->dim ? u[a] : 0.0;
+	site->flags |= CL_SITE_DISPLACED;
+	return 0;
+}
+
+int cl_supercell_substitute(cl_supercell_t *sc, size_t atom, int atomic_number, double mass) {
+	cl_site_t *site;
+
+	if (!(mass > 0.0))
+		return -1;
+	site = cl_site_get(sc, atom);
+	if (!site)
+		return -1;
+	site->atomic_number = atomic_number;
+	site->mass = mass;
+	site->flags |= CL_SITE_SUBSTITUTED;
+	return 0;
+}
+
+int cl_supercell_vacate(cl_supercell_t *sc, size_t atom) {
+	cl_site_t *site = cl_site_get(sc, atom);
+
+	if (!site)
+		return -1;
+	site->flags |= CL_SITE_VACANCY;
+	return 0;
+}
+
+int cl_supercell_restore(cl_supercell_t *sc, size_t atom) {
+	size_t k;
+
+	if (!sc || atom >= sc->n_atoms)
+		return -1;
+	k = cl_site_find(sc, atom);
+	if (k < sc->n_sites && sc->sites[k].atom == atom) {
+		memmove(sc->sites + k, sc->sites + k + 1, (sc->n_sites - k - 1) * sizeof(*sc->sites));
+		sc->n_sites--;
+	}
+	return 0;
+}
+
+/* -------------------------------
+   Atoms
+   ------------------------------- */
+
+static void cl_lattice_site(const cl_supercell_t *sc, size_t atom, double r[3]) {
+	size_t b, c[3];
+
+	cl_supercell_split(sc, atom, &b, c);
+	for (size_t x = 0; x < 3; x++) {
+		r[x] = x < sc->dim ? gsl_matrix_get(sc->cell->basis->positions, b, x) : 0.0;
+		for (size_t a = 0; a < 3; a++)
+			r[x] += (double)c[a] * sc->vectors[a * 3 + x];
+	}
+}
+
+static int cl_basis_species(const cl_basis_t *basis, size_t b) {
+	return basis->atomic_numbers ? basis->atomic_numbers[b] : (int)b;
+}
+
+void cl_supercell_position(const cl_supercell_t *sc, size_t atom, double r[3]) {
+	const cl_site_t *site = cl_supercell_site(sc, atom);
+
+	cl_lattice_site(sc, atom, r);
+	if (site && (site->flags & CL_SITE_DISPLACED))
+		for (size_t x = 0; x < 3; x++)
+			r[x] += site->u[x];
+}
+
+double cl_supercell_mass(const cl_supercell_t *sc, size_t atom) {
+	const cl_site_t *site = cl_supercell_site(sc, atom);
+	const cl_basis_t *basis = sc->cell->basis;
+
+	if (site && (site->flags & CL_SITE_SUBSTITUTED))
+		return site->mass;
+	return basis->masses ? basis->masses[atom % sc->n_basis] : 0.0;
+}
+
+int cl_supercell_species(const cl_supercell_t *sc, size_t atom) {
+	const cl_site_t *site = cl_supercell_site(sc, atom);
+
+	if (site && (site->flags & CL_SITE_SUBSTITUTED))
+		return site->atomic_number;
+	return cl_basis_species(sc->cell->basis, atom % sc->n_basis);
+}
+
+int cl_supercell_vacant(const cl_supercell_t *sc, size_t atom) {
+	const cl_site_t *site = cl_supercell_site(sc, atom);
+
+	return site && (site->flags & CL_SITE_VACANCY);
+}
+
+/* -------------------------------
+   Neighbors
+   ------------------------------- */
+
+size_t cl_supercell_row(const cl_supercell_t *sc, const cl_neighbor_list_t *nl, size_t atom) {
+	const size_t b = atom % sc->n_basis;
+
+	return nl->offset[b + 1] - nl->offset[b];
+}
+
+/* Neighbor atom and lattice bond vector of entry k, without displacements */
+static size_t cl_supercell_bond(const cl_supercell_t *sc, const cl_neighbor_list_t *nl, size_t atom, size_t k, double r0[3]) {
+	const cl_unit_cell_t *cell = sc->cell;
+	size_t b, c[3], cj[3];
+	size_t e;
+	const int *im;
+
+	cl_supercell_split(sc, atom, &b, c);
+	e = nl->offset[b] + k;
+	im = nl->image + 3 * e;
+	cl_neighbor_vector(nl, cell->geometry, cell->basis, b, e, r0);
+	for (size_t a = 0; a < 3; a++) {
+		const long n = (long)sc->n[a];
+		const long x = ((long)c[a] + im[a]) % n;
+		cj[a] = (size_t)(x < 0 ? x + n : x);
+	}
+	return cl_supercell_atom(sc, nl->index[e], cj);
+}
+
+/* Adds the displacements of atoms i and j to bond vector r */
+static void cl_supercell_displace_bond(const cl_supercell_t *sc, size_t i, size_t j, double r[3]) {
+	const cl_site_t *si, *sj;
+
+	if (sc->n_sites == 0)
+		return;
+	si = cl_supercell_site(sc, i);
+	sj = cl_supercell_site(sc, j);
+	for (size_t x = 0; x < 3; x++) {
+		if (sj && (sj->flags & CL_SITE_DISPLACED))
+			r[x] += sj->u[x];
+		if (si && (si->flags & CL_SITE_DISPLACED))
+			r[x] -= si->u[x];
+	}
+}
+
+size_t cl_supercell_neighbor(const cl_supercell_t *sc, const cl_neighbor_list_t *nl, size_t atom, size_t k, double r[3]) {
+	const size_t j = cl_supercell_bond(sc, nl, atom, k, r);
+
+	cl_supercell_displace_bond(sc, atom, j, r);
+	return j;
+}
+
+/* -------------------------------
+   Pair energy
+   ------------------------------- */
+
+int cl_supercell_pair_energy(const cl_supercell_t *sc, const cl_neighbor_list_t *nl, cl_pair_fn fn, void *params, double *energy) {
+	const cl_basis_t *basis;
+	double cut2, perfect = 0.0, delta = 0.0;
+
+	if (!sc || !nl || !fn || !energy || nl->n_atoms != sc->n_basis || !nl->offset)
+		return -1;
+	basis = sc->cell->basis;
+	cut2 = nl->cutoff * nl->cutoff;
+
+	/* Perfect crystal: every cell alike, each bond seen from both ends */
+	for (size_t b = 0; b < sc->n_basis; b++) {
+		for (size_t e = nl->offset[b]; e < nl->offset[b + 1]; e++) {
+			double r[3], r2;
+			cl_neighbor_vector(nl, sc->cell->geometry, basis, b, e, r);
+			r2 = r[0] * r[0] + r[1] * r[1] + r[2] * r[2];
+			if (r2 <= cut2)
+				perfect += fn(cl_basis_species(basis, b), cl_basis_species(basis, nl->index[e]), sqrt(r2), params);
+		}
+	}
+	perfect *= 0.5 * (double)sc->n_cells;
+
+	/* Bonds touching a perturbed site: actual minus perfect, halved when
+	   both ends are perturbed since both rows visit them */
+	for (size_t s = 0; s < sc->n_sites; s++) {
+		const size_t i = sc->sites[s].atom, n_row = cl_supercell_row(sc, nl, i);
+		const size_t bi = i % sc->n_basis;
+		const int vi = cl_supercell_vacant(sc, i), zi = cl_supercell_species(sc, i);
+		for (size_t k = 0; k < n_row; k++) {
+			double r0[3], r[3], r02, r2, term = 0.0;
+			const size_t j = cl_supercell_bond(sc, nl, i, k, r0);
+			const double w = cl_supercell_site(sc, j) ? 0.5 : 1.0;
+			memcpy(r, r0, sizeof(r));
+			cl_supercell_displace_bond(sc, i, j, r);
+			r02 = r0[0] * r0[0] + r0[1] * r0[1] + r0[2] * r0[2];
+			r2 = r[0] * r[0] + r[1] * r[1] + r[2] * r[2];
+			if (!vi && !cl_supercell_vacant(sc, j) && r2 <= cut2)
+				term += fn(zi, cl_supercell_species(sc, j), sqrt(r2), params);
+			if (r02 <= cut2)
+				term -= fn(cl_basis_species(basis, bi), cl_basis_species(basis, j % sc->n_basis), sqrt(r02), params);
+			delta += w * term;
+		}
+	}
+	*energy = perfect + delta;
+	return 0;
+}
+
+/* -------------------------------
+   System steps
+   ------------------------------- */
+
+int cl_step_supercell(cl_system_t *system, size_t nx, size_t ny, size_t nz) {
+	cl_supercell_t *sc;
+
+	if (!system || !system->unit_cell)
+		return -1;
+	sc = cl_supercell_alloc(system->unit_cell, nx, ny, nz);
+	if (!sc)
+		return -1;
+	cl_supercell_free(system->supercell);
+	system->supercell = sc;
+	return 0;
+}
+
+/* Vacancy at supercell atom defect_index (a 1 x 1 x 1 view if the system
+   has no supercell yet). */
+int cl_step_defect(cl_system_t *system, int defect_index) {
+	if (!system || defect_index < 0)
+		return -1;
+	if (!system->supercell && cl_step_supercell(system, 1, 1, 1) != 0)
+		return -1;
+	return cl_supercell_vacate(system->supercell, (size_t)defect_index);
+}
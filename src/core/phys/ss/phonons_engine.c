@@ -0,0 +1,545 @@
+/*
+   phonons_engine.c - Fourier-interpolated phonon engine for HOLOS
+
+   Dispersions and group velocities from real-space force constants (see
+   phonons.h):
+   - The mass factors 1 / sqrt(m_i m_j) of the terms are taken once per
+     solve call, so D(q) is one pass over the terms with one complex
+     phase each
+   - q-points are split over the threads; each thread owns the D buffer,
+     eigenvalues, eigenvectors and solver work arrays, made on the first
+     solve and reused (zheevr sized by a workspace query)
+   - D is written so that its column-major reading is D itself; LAPACK
+     returns the eigenvectors as they are, the GSL fallback (which reads
+     row-major, i.e. the conjugate) has them conjugated back
+   - Velocities reuse the terms and the phases: for each mode,
+     d(lambda)/dq = sum over terms of -Im(c_t e_i^+ Phi e_j) r, with c_t
+     the mass-scaled phase; no finite differences, no extra solves
+
+   Copyright (C) 2025 HOLOS Scientific Computing Project
+
+   This file is part of HOLOS.
+
+   HOLOS is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifndef HAVE_LAPACK
+#include <gsl/gsl_eigen.h>
+#include <gsl/gsl_sort_vector.h>
+#endif
+
+#include "core/phys/ss/phonons.h"
+
+#define PH_THZ 15.633302               /* sqrt(eV / (A^2 u)) / (2 pi) in THz */
+#define PH_KMS 0.62831853071795865     /* THz A in km/s, times 2 pi */
+#define PH_DEGENERATE 1e-8             /* Relative eigenvalue gap below which modes are degenerate */
+
+#ifdef HAVE_LAPACK
+/* Fortran LAPACK (complex arrays as interleaved doubles) */
+extern void zheevr_(const char *jobz, const char *range, const char *uplo, const int *n,
+	double *a, const int *lda, const double *vl, const double *vu, const int *il, const int *iu,
+	const double *abstol, int *m, double *w, double *z, const int *ldz, int *isuppz,
+	double *work, const int *lwork, double *rwork, const int *lrwork, int *iwork, const int *liwork,
+	int *info);
+#endif
+
+/* One thread's buffers */
+typedef struct {
+	double *h;                      /* D(q), 2 n^2 */
+	double *w;                      /* Eigenvalues, n */
+	double *vec;                    /* Eigenvectors, mode-major, 2 n^2 */
+	double *dl;                     /* d(lambda)/dq per mode, 3 n */
+	double *phase;                  /* Mass-scaled phase per term, 2 n_terms */
+	size_t n_phase;
+#ifdef HAVE_LAPACK
+	double *work, *rwork;
+	int *iwork, *isuppz;
+	int lwork, lrwork, liwork;
+#else
+	gsl_matrix_complex *a, *evec;
+	gsl_vector *eval;
+	gsl_eigen_hermv_workspace *wsv;
+	gsl_eigen_herm_workspace *ws;
+#endif
+} ph_slot;
+
+typedef struct {
+	size_t n;
+	int nt;
+	ph_slot *slot;
+	double *scale;                  /* 1 / sqrt(m_i m_j) per term */
+	size_t n_scale;
+} ph_engine_work;
+
+static int ph_threads(int n_threads) {
+	if (n_threads < 0) {
+#ifdef _OPENMP
+		return omp_get_max_threads();
+#else
+		return 1;
+#endif
+	}
+	return n_threads > 0 ? n_threads : 1;
+}
+
+/* -------------------------------
+   Workspaces
+   ------------------------------- */
+
+static void ph_slot_free(ph_slot *s) {
+#ifdef HAVE_LAPACK
+	free(s->work);
+	free(s->rwork);
+	free(s->iwork);
+	free(s->isuppz);
+	free(s->h);
+#else
+	if (s->ws)
+		gsl_eigen_herm_free(s->ws);
+	if (s->wsv)
+		gsl_eigen_hermv_free(s->wsv);
+	if (s->eval)
+		gsl_vector_free(s->eval);
+	if (s->evec)
+		gsl_matrix_complex_free(s->evec);
+	if (s->a)
+		gsl_matrix_complex_free(s->a);
+#endif
+	free(s->w);
+	free(s->vec);
+	free(s->dl);
+	free(s->phase);
+	memset(s, 0, sizeof(*s));
+}
+
+static int ph_slot_init(ph_slot *s, size_t n) {
+	memset(s, 0, sizeof(*s));
+	s->w = malloc(n * sizeof(double));
+	s->vec = malloc(2 * n * n * sizeof(double));
+	s->dl = malloc(3 * n * sizeof(double));
+	if (!s->w || !s->vec || !s->dl)
+		return -1;
+#ifdef HAVE_LAPACK
+	{
+		int in = (int)n, m = 0, info = 0, query = -1, il = 1, iu = 1, liw = 0;
+		double vl = 0.0, vu = 0.0, abstol = 0.0, lw[2] = { 0.0, 0.0 }, lrw = 0.0;
+
+		s->h = malloc(2 * n * n * sizeof(double));
+		s->isuppz = malloc(2 * n * sizeof(int));
+		if (!s->h || !s->isuppz)
+			return -1;
+		zheevr_("V", "A", "L", &in, s->h, &in, &vl, &vu, &il, &iu, &abstol, &m, s->w,
+			s->vec, &in, s->isuppz, lw, &query, &lrw, &query, &liw, &query, &info);
+		if (info != 0)
+			return -1;
+		s->lwork = (int)lw[0] > 2 * in ? (int)lw[0] : 2 * in;
+		s->lrwork = (int)lrw > 24 * in ? (int)lrw : 24 * in;
+		s->liwork = liw > 10 * in ? liw : 10 * in;
+		s->work = malloc(2 * (size_t)s->lwork * sizeof(double));
+		s->rwork = malloc((size_t)s->lrwork * sizeof(double));
+		s->iwork = malloc((size_t)s->liwork * sizeof(int));
+		if (!s->work || !s->rwork || !s->iwork)
+			return -1;
+	}
+#else
+	s->a = gsl_matrix_complex_alloc(n, n);
+	s->evec = gsl_matrix_complex_alloc(n, n);
+	s->eval = gsl_vector_alloc(n);
+	s->ws = gsl_eigen_herm_alloc(n);
+	s->wsv = gsl_eigen_hermv_alloc(n);
+	if (!s->a || !s->evec || !s->eval || !s->ws || !s->wsv)
+		return -1;
+	s->h = s->a->data;
+#endif
+	return 0;
+}
+
+static void ph_work_free(ph_engine_work *wk) {
+	if (!wk)
+		return;
+	if (wk->slot) {
+		for (int t = 0; t < wk->nt; t++)
+			ph_slot_free(&wk->slot[t]);
+		free(wk->slot);
+	}
+	free(wk->scale);
+	free(wk);
+}
+
+/* Workspaces for the current size and nt threads */
+static ph_engine_work *ph_work_get(ph_engine_t *e, int nt) {
+	ph_engine_work *wk = e->work;
+	const size_t n = 3 * e->n_atoms;
+
+	if (!wk) {
+		wk = calloc(1, sizeof(*wk));
+		if (!wk)
+			return NULL;
+		e->work = wk;
+	}
+	if (wk->n != n || wk->nt != nt) {
+		for (int t = 0; t < wk->nt; t++)
+			ph_slot_free(&wk->slot[t]);
+		free(wk->slot);
+		wk->nt = 0;
+		wk->n = 0;
+		wk->slot = calloc((size_t)nt, sizeof(ph_slot));
+		if (!wk->slot)
+			return NULL;
+		for (; wk->nt < nt; wk->nt++) {
+			if (ph_slot_init(&wk->slot[wk->nt], n) != 0) {
+				ph_slot_free(&wk->slot[wk->nt]);
+				return NULL;
+			}
+		}
+		wk->n = n;
+	}
+	/* Per-term scales and phase buffers follow the term list */
+	if (wk->n_scale != e->n_terms) {
+		double *sc = realloc(wk->scale, (e->n_terms ? e->n_terms : 1) * sizeof(double));
+		if (!sc)
+			return NULL;
+		wk->scale = sc;
+		wk->n_scale = e->n_terms;
+	}
+	for (size_t t = 0; t < e->n_terms; t++)
+		wk->scale[t] = 1.0 / sqrt(e->masses[e->terms[t].i] * e->masses[e->terms[t].j]);
+	for (int t = 0; t < wk->nt; t++) {
+		ph_slot *s = &wk->slot[t];
+		if (s->n_phase < e->n_terms) {
+			double *p = realloc(s->phase, 2 * e->n_terms * sizeof(double));
+			if (!p)
+				return NULL;
+			s->phase = p;
+			s->n_phase = e->n_terms;
+		}
+	}
+	return wk;
+}
+
+/* -------------------------------
+   Force constants
+   ------------------------------- */
+
+ph_engine_t *ph_engine_alloc(size_t n_atoms, const double *masses) {
+	ph_engine_t *e;
+
+	if (n_atoms == 0 || !masses)
+		return NULL;
+	for (size_t i = 0; i < n_atoms; i++)
+		if (!(masses[i] > 0.0))
+			return NULL;
+	e = calloc(1, sizeof(*e));
+	if (!e)
+		return NULL;
+	e->masses = malloc(n_atoms * sizeof(double));
+	if (!e->masses) {
+		free(e);
+		return NULL;
+	}
+	memcpy(e->masses, masses, n_atoms * sizeof(double));
+	e->n_atoms = n_atoms;
+	return e;
+}
+
+void ph_engine_free(ph_engine_t *engine) {
+	if (!engine)
+		return;
+	ph_work_free(engine->work);
+	free(engine->masses);
+	free(engine->terms);
+	free(engine->frequencies);
+	free(engine->velocities);
+	free(engine);
+}
+
+static int ph_push(ph_engine_t *e, size_t i, size_t j, const double r[3], const double phi[9], int transpose) {
+	ph_fc_term_t *t;
+
+	if (e->n_terms == e->cap_terms) {
+		const size_t cap = e->cap_terms ? 2 * e->cap_terms : 64;
+		ph_fc_term_t *p = realloc(e->terms, cap * sizeof(*p));
+		if (!p)
+			return -1;
+		e->terms = p;
+		e->cap_terms = cap;
+	}
+	t = &e->terms[e->n_terms++];
+	t->i = i;
+	t->j = j;
+	for (int a = 0; a < 3; a++)
+		t->r[a] = transpose ? -r[a] : r[a];
+	for (int a = 0; a < 3; a++)
+		for (int b = 0; b < 3; b++)
+			t->phi[a * 3 + b] = transpose ? phi[b * 3 + a] : phi[a * 3 + b];
+	return 0;
+}
+
+int ph_engine_add_pair(ph_engine_t *engine, size_t i, size_t j, const double r[3], const double phi[9]) {
+	if (!engine || !r || !phi || i >= engine->n_atoms || j >= engine->n_atoms)
+		return -1;
+	if (ph_push(engine, i, j, r, phi, 0) != 0)
+		return -1;
+	if (i == j && r[0] == 0.0 && r[1] == 0.0 && r[2] == 0.0)
+		return 0;
+	if (ph_push(engine, j, i, r, phi, 1) != 0) {
+		engine->n_terms--;
+		return -1;
+	}
+	return 0;
+}
+
+int ph_engine_acoustic_sum_rule(ph_engine_t *engine) {
+	double *sum;
+	size_t kept = 0;
+
+	if (!engine)
+		return -1;
+	sum = calloc(9 * engine->n_atoms, sizeof(double));
+	if (!sum)
+		return -1;
+	/* Drop the old on-site blocks, sum the rest per atom */
+	for (size_t t = 0; t < engine->n_terms; t++) {
+		const ph_fc_term_t *ft = &engine->terms[t];
+		if (ft->i == ft->j && ft->r[0] == 0.0 && ft->r[1] == 0.0 && ft->r[2] == 0.0)
+			continue;
+		for (int a = 0; a < 9; a++)
+			sum[9 * ft->i + a] += ft->phi[a];
+		engine->terms[kept++] = *ft;
+	}
+	engine->n_terms = kept;
+	for (size_t i = 0; i < engine->n_atoms; i++) {
+		const double r0[3] = { 0.0, 0.0, 0.0 };
+		double phi[9];
+		/* Symmetric part, so the block stays Hermitian */
+		for (int a = 0; a < 3; a++)
+			for (int b = 0; b < 3; b++)
+				phi[a * 3 + b] = -0.5 * (sum[9 * i + a * 3 + b] + sum[9 * i + b * 3 + a]);
+		if (ph_push(engine, i, i, r0, phi, 0) != 0) {
+			free(sum);
+			return -1;
+		}
+	}
+	free(sum);
+	return 0;
+}
+
+/* -------------------------------
+   Solves
+   ------------------------------- */
+
+static double ph_thz(double lambda) {
+	return lambda >= 0.0 ? PH_THZ * sqrt(lambda) : -PH_THZ * sqrt(-lambda);
+}
+
+/* One q-point: frequencies into f (n), velocities into v (n x 3) if given */
+static int ph_solve_q(const ph_engine_t *e, const ph_engine_work *wk, ph_slot *s, const double *q, double *f, double *v) {
+	const size_t n = 3 * e->n_atoms;
+	const int vectors = v != NULL;
+
+	memset(s->h, 0, 2 * n * n * sizeof(double));
+	for (size_t t = 0; t < e->n_terms; t++) {
+		const ph_fc_term_t *ft = &e->terms[t];
+		const double arg = q[0] * ft->r[0] + q[1] * ft->r[1] + q[2] * ft->r[2];
+		const double c = wk->scale[t] * cos(arg), sn = wk->scale[t] * sin(arg);
+		s->phase[2 * t] = c;
+		s->phase[2 * t + 1] = sn;
+		/* Element (3i+a, 3j+b) at column-major position (3j+b) n + 3i+a */
+		for (int a = 0; a < 3; a++) {
+			for (int b = 0; b < 3; b++) {
+				double *h = s->h + 2 * ((3 * ft->j + (size_t)b) * n + 3 * ft->i + (size_t)a);
+				h[0] += ft->phi[a * 3 + b] * c;
+				h[1] += ft->phi[a * 3 + b] * sn;
+			}
+		}
+	}
+#ifdef HAVE_LAPACK
+	{
+		int in = (int)n, il = 1, iu = 1, found = 0, info = 0, one = 1;
+		double vl = 0.0, vu = 0.0, abstol = 0.0;
+
+		zheevr_(vectors ? "V" : "N", "A", "L", &in, s->h, &in, &vl, &vu, &il, &iu, &abstol, &found, s->w,
+			s->vec, vectors ? &in : &one, s->isuppz, s->work, &s->lwork, s->rwork, &s->lrwork, s->iwork,
+			&s->liwork, &info);
+		if (info != 0 || found != in)
+			return -1;
+	}
+#else
+	if (vectors) {
+		if (gsl_eigen_hermv(s->a, s->eval, s->evec, s->wsv) != 0)
+			return -1;
+		gsl_eigen_hermv_sort(s->eval, s->evec, GSL_EIGEN_SORT_VAL_ASC);
+		/* Columns of evec are eigenvectors of conj(D) */
+		for (size_t m = 0; m < n; m++) {
+			for (size_t i = 0; i < n; i++) {
+				const double *z = s->evec->data + 2 * (i * s->evec->tda + m);
+				s->vec[2 * (m * n + i)] = z[0];
+				s->vec[2 * (m * n + i) + 1] = -z[1];
+			}
+		}
+	} else {
+		if (gsl_eigen_herm(s->a, s->eval, s->ws) != 0)
+			return -1;
+		gsl_sort_vector(s->eval);
+	}
+	for (size_t m = 0; m < n; m++)
+		s->w[m] = gsl_vector_get(s->eval, m);
+#endif
+	for (size_t m = 0; m < n; m++)
+		f[m] = ph_thz(s->w[m]);
+	if (!vectors)
+		return 0;
+
+	/* d(lambda)/dq per mode: sum_t -Im(c_t e_i^+ Phi e_j) r_t */
+	memset(s->dl, 0, 3 * n * sizeof(double));
+	for (size_t m = 0; m < n; m++) {
+		const double *em = s->vec + 2 * m * n;
+		double *d = s->dl + 3 * m;
+		for (size_t t = 0; t < e->n_terms; t++) {
+			const ph_fc_term_t *ft = &e->terms[t];
+			const double *ei = em + 6 * ft->i, *ej = em + 6 * ft->j;
+			double sr = 0.0, si = 0.0, im;
+			for (int a = 0; a < 3; a++) {
+				double pr = 0.0, pi = 0.0;
+				for (int b = 0; b < 3; b++) {
+					pr += ft->phi[a * 3 + b] * ej[2 * b];
+					pi += ft->phi[a * 3 + b] * ej[2 * b + 1];
+				}
+				/* conj(e_ia) (pr + i pi) */
+				sr += ei[2 * a] * pr + ei[2 * a + 1] * pi;
+				si += ei[2 * a] * pi - ei[2 * a + 1] * pr;
+			}
+			im = s->phase[2 * t] * si + s->phase[2 * t + 1] * sr;
+			d[0] -= im * ft->r[0];
+			d[1] -= im * ft->r[1];
+			d[2] -= im * ft->r[2];
+		}
+	}
+	/* Average over degenerate groups, then v = d(lambda)/dq / (2 sqrt(lambda)) */
+	{
+		double scale = 0.0;
+		for (size_t m = 0; m < n; m++)
+			if (fabs(s->w[m]) > scale)
+				scale = fabs(s->w[m]);
+		for (size_t m0 = 0; m0 < n;) {
+			size_t m1 = m0 + 1;
+			double avg[3] = { s->dl[3 * m0], s->dl[3 * m0 + 1], s->dl[3 * m0 + 2] };
+			while (m1 < n && s->w[m1] - s->w[m1 - 1] <= PH_DEGENERATE * scale) {
+				for (int x = 0; x < 3; x++)
+					avg[x] += s->dl[3 * m1 + x];
+				m1++;
+			}
+			for (size_t m = m0; m < m1; m++) {
+				const double sq = sqrt(fabs(s->w[m]));
+				for (int x = 0; x < 3; x++)
+					v[3 * m + x] = sq > sqrt(PH_DEGENERATE * scale)
+					               ? PH_KMS * PH_THZ * avg[x] / (double)(m1 - m0) / (2.0 * sq) : 0.0;
+			}
+			m0 = m1;
+		}
+	}
+	return 0;
+}
+
+int ph_engine_solve(ph_engine_t *engine, const double *q, size_t n_q, double *frequencies, double *velocities) {
+	ph_engine_work *wk;
+	size_t n;
+	int nt, failed = 0;
+
+	if (!engine || !q || !frequencies || n_q == 0 || engine->n_terms == 0)
+		return -1;
+	n = 3 * engine->n_atoms;
+	nt = ph_threads(engine->n_threads);
+	if ((size_t)nt > n_q)
+		nt = (int)n_q;
+	wk = ph_work_get(engine, nt);
+	if (!wk)
+		return -1;
+
+	#pragma omp parallel for schedule(dynamic, 1) num_threads(nt) reduction(|:failed) if(nt > 1)
+	for (size_t k = 0; k < n_q; k++) {
+#ifdef _OPENMP
+		ph_slot *s = &wk->slot[omp_get_thread_num()];
+#else
+		ph_slot *s = &wk->slot[0];
+#endif
+		if (ph_solve_q(engine, wk, s, q + 3 * k, frequencies + k * n, velocities ? velocities + 3 * k * n : NULL) != 0)
+			failed = 1;
+	}
+	engine->n_solves += n_q;
+	return failed ? -1 : 0;
+}
+
+/* -------------------------------
+   Steps
+   ------------------------------- */
+
+static int ph_step(ph_system_t *system, int with_velocities) {
+	ph_engine_t *e;
+	size_t n, nq;
+
+	if (!system || !system->engine || !system->engine->qpoints || system->engine->n_qpoints == 0)
+		return -1;
+	e = system->engine;
+	n = 3 * e->n_atoms;
+	nq = e->n_qpoints;
+	{
+		double *f = realloc(e->frequencies, nq * n * sizeof(double));
+		if (!f)
+			return -1;
+		e->frequencies = f;
+	}
+	if (with_velocities) {
+		double *v = realloc(e->velocities, 3 * nq * n * sizeof(double));
+		if (!v)
+			return -1;
+		e->velocities = v;
+	}
+	if (ph_engine_solve(e, e->qpoints, nq, e->frequencies, with_velocities ? e->velocities : NULL) != 0)
+		return -1;
+
+	/* Branch-major copies for the callers of ph_dispersion_t */
+	for (size_t b = 0; system->dispersions && b < system->n_dispersions; b++) {
+		ph_dispersion_t *d = system->dispersions[b];
+		const size_t br = d ? (size_t)d->branch_index : 0;
+		if (!d || d->branch_index < 0 || br >= n || d->n_kpoints != nq)
+			continue;
+		for (size_t k = 0; k < nq; k++) {
+			if (d->frequencies)
+				d->frequencies[k] = e->frequencies[k * n + br];
+			if (with_velocities && d->velocities) {
+				const double *v = e->velocities + 3 * (k * n + br);
+				d->velocities[k] = sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+			}
+		}
+	}
+	return 0;
+}
+
+int ph_step_dispersion(ph_system_t *system) {
+	return ph_step(system, 0);
+}
+
+int ph_step_group_velocity(ph_system_t *system) {
+	return ph_step(system, 1);
+}
@@ -0,0 +1,146 @@
+/*
+   entropy.c - Entropy module for HOLOS
+
+   Entropy formulas, scalar and over columns of states (see entropy.h);
+   the logarithms go through td_log_n() of thermodynamics.c, and each
+   scalar form is its columnar kernel on one state.
+
+   Copyright (C) 2025 HOLOS Scientific Computing Project
+
+   This file is part of HOLOS.
+
+   HOLOS is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "core/phys/thermo/entropy.h"
+#include "core/phys/thermo/thermodynamics.h"
+
+#define ENT_R 8.314462618               /* Molar gas constant (J/mol/K) */
+#define ENT_BLOCK 1024                  /* Fractions per block of the mixing kernel */
+#define ENT_PARALLEL_MIN 16384          /* Fewer elements stay serial */
+
+static int ent_threads(int n_threads) {
+	if (n_threads < 0) {
+#ifdef _OPENMP
+		return omp_get_max_threads();
+#else
+		return 1;
+#endif
+	}
+	return n_threads > 0 ? n_threads : 1;
+}
+
+double ent_entropy_ideal_gas(double n, double V, double T) {
+	return td_ideal_gas_entropy(n, V, T);
+}
+
+double ent_entropy_mixing(const double *composition, size_t n_components) {
+	double S = 0.0;
+	if (ent_entropy_mixing_n(composition, n_components, &S, 1, 0) != 0)
+		return 0.0;
+	return S;
+}
+
+double ent_entropy_phase_change(double n, double L, double T) {
+	return n * L / T;
+}
+
+int ent_entropy_ideal_gas_n(const double *n, const double *V, const double *T, double *S, size_t count, int n_threads) {
+	return td_ideal_gas_entropy_n(n, V, T, S, count, n_threads);
+}
+
+/* Blocks of whole states, at most ENT_BLOCK fractions unless one row alone is longer. */
+int ent_entropy_mixing_n(const double *composition, size_t n_components, double *S, size_t count, int n_threads) {
+	if (count && (!S || (n_components && !composition)))
+		return -1;
+	const size_t nc = n_components;
+	const size_t per = nc && nc <= ENT_BLOCK ? ENT_BLOCK / nc : 1;
+	const size_t n_blocks = (count + per - 1) / per;
+	const int nt = ent_threads(n_threads);
+
+	#pragma omp parallel for schedule(static) num_threads(nt) if(nt > 1 && count * nc >= ENT_PARALLEL_MIN)
+	for (size_t c = 0; c < n_blocks; c++) {
+		const size_t i0 = c * per, ns = count - i0 < per ? count - i0 : per, ne = ns * nc;
+		const double *x = composition + i0 * nc;
+		double acc[ENT_BLOCK], lx[ENT_BLOCK];
+		for (size_t s = 0; s < ns; s++)
+			acc[s] = 0.0;
+		/* Terms in component order per state, so the sums do not depend on the blocking. */
+		size_t st = 0, cc = 0;
+		for (size_t e0 = 0; e0 < ne; e0 += ENT_BLOCK) {
+			const size_t len = ne - e0 < ENT_BLOCK ? ne - e0 : ENT_BLOCK;
+			td_log_n(x + e0, lx, len, 0);
+			for (size_t k = 0; k < len; k++) {
+				const double xe = x[e0 + k];
+				if (xe != 0.0)
+					acc[st] += xe * lx[k];
+				if (++cc == nc) {
+					cc = 0;
+					st++;
+				}
+			}
+		}
+		for (size_t s = 0; s < ns; s++)
+			S[i0 + s] = 0.0 - ENT_R * acc[s];
+	}
+	return 0;
+}
+
+int ent_entropy_phase_change_n(const double *n, const double *L, const double *T, double *S, size_t count,
+                               int n_threads) {
+	if (count && (!n || !L || !T || !S))
+		return -1;
+	const int nt = ent_threads(n_threads);
+	#pragma omp parallel for simd schedule(static) num_threads(nt) if(nt > 1 && count >= ENT_PARALLEL_MIN)
+	for (size_t i = 0; i < count; i++)
+		S[i] = n[i] * L[i] / T[i];
+	return 0;
+}
+
+/* -------------------------------
+   Diagnostics
+   ------------------------------- */
+
+int ent_diagnostics_stream(ent_system_t *system, obs_stream *stream, size_t decimate, obs_reduce_t reduce) {
+	if (!system)
+		return -1;
+	obs_binding *b = stream ? obs_binding_alloc(stream, "ent", decimate, reduce) : NULL;
+	if (stream && !b)
+		return -1;
+	obs_binding_free(system->diagnostics.stream);
+	system->diagnostics.stream = b;
+	return 0;
+}
+
+void ent_diagnostics_update(ent_system_t *system) {
+	if (!system || !system->diagnostics.stream)
+		return;
+	const ent_diagnostics_t *d = &system->diagnostics;
+	obs_binding *b = d->stream;
+	const double t = (double)b->n_updates;
+	obs_binding_push(b, 0, "total_entropy", t, &d->total_entropy, 1);
+	obs_binding_push(b, 1, "entropy_production", t, &d->entropy_production, 1);
+	if (d->entropy_profile)
+		obs_binding_push(b, 2, "entropy_profile", t, d->entropy_profile, d->n_profile);
+	if (d->entropy_flux_profile)
+		obs_binding_push(b, 3, "entropy_flux_profile", t, d->entropy_flux_profile, d->n_flux);
+	if (d->entropy_production_profile)
+		obs_binding_push(b, 4, "entropy_production_profile", t, d->entropy_production_profile, d->n_prod);
+	b->n_updates++;
+}
@@ -0,0 +1,54 @@
+/*
+   heat_transfer.c - Heat transfer module for HOLOS
+
+   Diagnostics of ht_system_t (see heat_transfer.h); updates go to an
+   obs_stream sink, so profiles are written while a run goes on instead
+   of kept whole.
+
+   Copyright (C) 2025 HOLOS Scientific Computing Project
+
+   This file is part of HOLOS.
+
+   HOLOS is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+
+#include "core/phys/thermo/heat_transfer.h"
+
+int ht_diagnostics_stream(ht_system_t *system, obs_stream *stream, size_t decimate, obs_reduce_t reduce) {
+	if (!system)
+		return -1;
+	obs_binding *b = stream ? obs_binding_alloc(stream, "ht", decimate, reduce) : NULL;
+	if (stream && !b)
+		return -1;
+	obs_binding_free(system->diagnostics.stream);
+	system->diagnostics.stream = b;
+	return 0;
+}
+
+void ht_diagnostics_update(ht_system_t *system) {
+	if (!system || !system->diagnostics.stream)
+		return;
+	const ht_diagnostics_t *d = &system->diagnostics;
+	obs_binding *b = d->stream;
+	const double t = system->state ? system->state->t : (double)b->n_updates;
+	obs_binding_push(b, 0, "total_heat", t, &d->total_heat, 1);
+	obs_binding_push(b, 1, "heat_flux", t, &d->heat_flux, 1);
+	if (d->temperature_profile)
+		obs_binding_push(b, 2, "temperature_profile", t, d->temperature_profile, d->n_profile);
+	if (d->heat_flux_profile)
+		obs_binding_push(b, 3, "heat_flux_profile", t, d->heat_flux_profile, d->n_flux);
+	b->n_updates++;
+}
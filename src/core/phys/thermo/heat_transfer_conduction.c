@@ -0,0 +1,727 @@
+/*
+   heat_transfer_conduction.c - Transient conduction for HOLOS
+
+   Finite-volume conduction on ht_mesh_t boxes (see heat_transfer.h):
+   - Face conductances (harmonic means across cells), boundary
+     conductances and fixed inflows computed once at alloc; radiative
+     faces are kept apart and linearized every step
+   - Crank-Nicolson: (C/dt + K/2) T' = (C/dt - K/2) T + f, written as
+     A T' = 2 (C/dt) T - A T + f so only A is ever stored
+   - A straight 1D problem in one Thomas sweep; otherwise CG with a
+     symmetric V-cycle as preconditioner: piecewise-constant 2x
+     aggregation, Galerkin coarse rows (sums of fine row sums and of the
+     fine faces between aggregates), equal damped Jacobi sweeps before
+     and after, dense Cholesky on the coarsest level
+   - Dot products summed per fixed block, so results do not depend on
+     the thread count
+
+   Copyright (C) 2025 HOLOS Scientific Computing Project
+
+   This file is part of HOLOS.
+
+   HOLOS is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "core/phys/thermo/heat_transfer.h"
+#include "core/trace/trace.h"
+
+#define HT_SIGMA 5.670374419e-8         /* Stefan-Boltzmann constant (W/m^2/K^4) */
+#define HT_COARSE 512                   /* Cells at most on the coarsest (dense) level */
+#define HT_SWEEPS 2                     /* Jacobi sweeps before and after each coarse correction */
+#define HT_DOT_BLOCK 4096               /* Cells per partial sum of the dot products */
+#define HT_PARALLEL_MIN 16384           /* Smaller levels stay serial */
+
+/* One level: A = diag - couplings, with g[a][c] between c and its +a
+   neighbour; on the last layer of a periodic axis g wraps to the first,
+   otherwise it is 0 there. s is the row sum of A. */
+typedef struct {
+	size_t n[3], st[3], nc;
+	double *s, *diag, *inv_diag, *g[3];
+	double *r, *x, *t;
+} ht_level;
+
+typedef struct {
+	double *cap;                    /* rho c V per cell (J/K) */
+	double *kb, *kf;                /* Fixed boundary conductance (W/K) and inflow (W) per cell */
+	double *kq;                     /* Source heat per cell (W) */
+	size_t n_rad;
+	size_t *rad_cell;
+	double *rad_g, *rad_area, *rad_eps, *rad_T;
+	double *bt, *ft;                /* Boundary terms of the current step (kb, kf without radiative faces) */
+	int periodic[3];
+	int line;                       /* Axis of a straight 1D problem, -1 otherwise */
+	ht_level *lv;
+	size_t n_levels;
+	double *chol;                   /* Cholesky factor of the coarsest level */
+	double dt;                      /* dt of the current hierarchy, 0 for none */
+	double *x, *r, *z, *p, *q;
+	double *part;
+	int nt;
+} ht_cond_work;
+
+static int ht_threads(int n_threads) {
+	if (n_threads < 0) {
+#ifdef _OPENMP
+		return omp_get_max_threads();
+#else
+		return 1;
+#endif
+	}
+	return n_threads > 0 ? n_threads : 1;
+}
+
+static double ht_series(double g1, double g2) {
+	return g1 + g2 > 0.0 ? g1 * g2 / (g1 + g2) : 0.0;
+}
+
+/* -------------------------------
+   Level kernels
+   ------------------------------- */
+
+/* y = A x, or y = r - A x with r. Axes of length 1 have g = 0, so every
+   cell takes the same seven-point form; the y and z neighbours of a line
+   are whole lines, and only its two ends wrap in x. */
+static void ht_apply(const ht_level *L, const double *r, const double *x, double *y, int nt) {
+	const size_t n0 = L->n[0], n1 = L->n[1], n2 = L->n[2], lines = n1 * n2;
+	#pragma omp parallel for schedule(static) num_threads(nt) if(nt > 1 && L->nc >= HT_PARALLEL_MIN)
+	for (size_t line = 0; line < lines; line++) {
+		const size_t j = line % n1, k = line / n1;
+		const size_t ju = j + 1 < n1 ? line + 1 : line - (n1 - 1), jd = j > 0 ? line - 1 : line + (n1 - 1);
+		const size_t ku = k + 1 < n2 ? line + n1 : line - (n2 - 1) * n1, kd = k > 0 ? line - n1 : line + (n2 - 1) * n1;
+		const size_t o = line * n0;
+		const double *x0 = x + o, *xju = x + ju * n0, *xjd = x + jd * n0, *xku = x + ku * n0, *xkd = x + kd * n0;
+		const double *d = L->diag + o, *gx = L->g[0] + o, *gy = L->g[1] + o, *gyd = L->g[1] + jd * n0;
+		const double *gz = L->g[2] + o, *gzd = L->g[2] + kd * n0;
+		const double *r0 = r ? r + o : NULL;
+		double *y0 = y + o;
+		const double yz0 = gy[0] * xju[0] + gyd[0] * xjd[0] + gz[0] * xku[0] + gzd[0] * xkd[0];
+		const double a0 = d[0] * x0[0] - gx[0] * x0[n0 > 1] - gx[n0 - 1] * x0[n0 - 1] - yz0;
+		y0[0] = r0 ? r0[0] - a0 : a0;
+		if (n0 < 2)
+			continue;
+		#pragma omp simd
+		for (size_t i = 1; i < n0 - 1; i++) {
+			const double a = d[i] * x0[i] - gx[i] * x0[i + 1] - gx[i - 1] * x0[i - 1] - gy[i] * xju[i] - gyd[i] * xjd[i]
+			                 - gz[i] * xku[i] - gzd[i] * xkd[i];
+			y0[i] = r0 ? r0[i] - a : a;
+		}
+		const size_t e = n0 - 1;
+		const double yze = gy[e] * xju[e] + gyd[e] * xjd[e] + gz[e] * xku[e] + gzd[e] * xkd[e];
+		const double ae = d[e] * x0[e] - gx[e] * x0[0] - gx[e - 1] * x0[e - 1] - yze;
+		y0[e] = r0 ? r0[e] - ae : ae;
+	}
+}
+
+/* Damped Jacobi, from x = 0 when zero. */
+static void ht_smooth(const ht_level *L, const double *r, double *x, int zero, int nt) {
+	int dim = 0;
+	for (int a = 0; a < 3; a++)
+		dim += L->n[a] > 1;
+	const double w = dim ? 2.0 * dim / (2.0 * dim + 1.0) : 1.0;
+	const size_t nc = L->nc;
+	for (int sweep = 0; sweep < HT_SWEEPS; sweep++) {
+		if (zero && sweep == 0) {
+			#pragma omp parallel for simd schedule(static) num_threads(nt) if(nt > 1 && nc >= HT_PARALLEL_MIN)
+			for (size_t c = 0; c < nc; c++)
+				x[c] = w * L->inv_diag[c] * r[c];
+			continue;
+		}
+		ht_apply(L, r, x, L->t, nt);
+		#pragma omp parallel for simd schedule(static) num_threads(nt) if(nt > 1 && nc >= HT_PARALLEL_MIN)
+		for (size_t c = 0; c < nc; c++)
+			x[c] += w * L->inv_diag[c] * L->t[c];
+	}
+}
+
+/* Fine index range of coarse index I on an axis of fine size n. */
+static void ht_agg(size_t n, size_t I, size_t *lo, size_t *hi) {
+	if (n < 2) {
+		*lo = *hi = I;
+		return;
+	}
+	*lo = 2 * I;
+	*hi = 2 * I + 1 < n ? 2 * I + 1 : n - 1;
+}
+
+static void ht_restrict(const ht_level *F, const double *t, ht_level *C, int nt) {
+	const size_t lines = C->n[1] * C->n[2];
+	#pragma omp parallel for schedule(static) num_threads(nt) if(nt > 1 && F->nc >= HT_PARALLEL_MIN)
+	for (size_t line = 0; line < lines; line++) {
+		const size_t J = line % C->n[1], K = line / C->n[1];
+		size_t j0, j1, k0, k1;
+		ht_agg(F->n[1], J, &j0, &j1);
+		ht_agg(F->n[2], K, &k0, &k1);
+		for (size_t I = 0; I < C->n[0]; I++) {
+			size_t i0, i1;
+			ht_agg(F->n[0], I, &i0, &i1);
+			double v = 0.0;
+			for (size_t k = k0; k <= k1; k++)
+				for (size_t j = j0; j <= j1; j++)
+					for (size_t i = i0; i <= i1; i++)
+						v += t[i + F->n[0] * (j + F->n[1] * k)];
+			C->r[line * C->n[0] + I] = v;
+		}
+	}
+}
+
+static void ht_prolong(const ht_level *F, double *x, const ht_level *C, int nt) {
+	const size_t n0 = F->n[0], n1 = F->n[1], lines = F->n[1] * F->n[2];
+	const size_t h0 = F->n[0] > 1, h1 = F->n[1] > 1, h2 = F->n[2] > 1;
+	#pragma omp parallel for schedule(static) num_threads(nt) if(nt > 1 && F->nc >= HT_PARALLEL_MIN)
+	for (size_t line = 0; line < lines; line++) {
+		const size_t J = (line % n1) >> h1, K = (line / n1) >> h2;
+		const double *xc = C->x + C->n[0] * (J + C->n[1] * K);
+		double *xf = x + line * n0;
+		for (size_t i = 0; i < n0; i++)
+			xf[i] += xc[i >> h0];
+	}
+}
+
+/* -------------------------------
+   Hierarchy
+   ------------------------------- */
+
+static void ht_level_diag(ht_level *L, int nt) {
+	const size_t n0 = L->n[0], n1 = L->n[1], lines = L->n[1] * L->n[2];
+	#pragma omp parallel for schedule(static) num_threads(nt) if(nt > 1 && L->nc >= HT_PARALLEL_MIN)
+	for (size_t line = 0; line < lines; line++) {
+		const size_t q[3] = { 0, line % n1, line / n1 };
+		for (size_t i = 0; i < n0; i++) {
+			const size_t c = line * n0 + i;
+			double d = L->s[c];
+			for (int a = 0; a < 3; a++) {
+				const size_t n = L->n[a], st = L->st[a], qa = a ? q[a] : i;
+				if (n >= 2)
+					d += L->g[a][c] + L->g[a][qa > 0 ? c - st : c + (n - 1) * st];
+			}
+			L->diag[c] = d;
+			L->inv_diag[c] = d > 0.0 ? 1.0 / d : 0.0;
+		}
+	}
+}
+
+/* Galerkin rows of C from F: row sums add up, and the coupling to the
+   next aggregate is the sum over the top fine layer of the aggregate. */
+static void ht_level_coarsen(const ht_level *F, ht_level *C, int nt) {
+	const size_t lines = C->n[1] * C->n[2];
+	#pragma omp parallel for schedule(static) num_threads(nt) if(nt > 1 && F->nc >= HT_PARALLEL_MIN)
+	for (size_t line = 0; line < lines; line++) {
+		const size_t Q[3] = { 0, line % C->n[1], line / C->n[1] };
+		size_t lo[3], hi[3];
+		ht_agg(F->n[1], Q[1], &lo[1], &hi[1]);
+		ht_agg(F->n[2], Q[2], &lo[2], &hi[2]);
+		for (size_t I = 0; I < C->n[0]; I++) {
+			const size_t c = line * C->n[0] + I;
+			ht_agg(F->n[0], I, &lo[0], &hi[0]);
+			double s = 0.0, g[3] = { 0.0, 0.0, 0.0 };
+			for (size_t k = lo[2]; k <= hi[2]; k++)
+				for (size_t j = lo[1]; j <= hi[1]; j++)
+					for (size_t i = lo[0]; i <= hi[0]; i++) {
+						const size_t f = i + F->n[0] * (j + F->n[1] * k), q[3] = { i, j, k };
+						s += F->s[f];
+						for (int a = 0; a < 3; a++)
+							if (C->n[a] >= 2 && q[a] == hi[a])
+								g[a] += F->g[a][f];
+					}
+			C->s[c] = s;
+			for (int a = 0; a < 3; a++)
+				C->g[a][c] = g[a];
+		}
+	}
+	ht_level_diag(C, nt);
+}
+
+/* Dense lower Cholesky factor of the level; -1 if not positive definite. */
+static int ht_level_cholesky(const ht_level *L, double *A) {
+	const size_t n = L->nc;
+	memset(A, 0, n * n * sizeof *A);
+	for (size_t c = 0; c < n; c++) {
+		const size_t q[3] = { c % L->n[0], (c / L->n[0]) % L->n[1], c / (L->n[0] * L->n[1]) };
+		A[c * n + c] += L->diag[c];
+		for (int a = 0; a < 3; a++) {
+			const size_t na = L->n[a], st = L->st[a];
+			if (na < 2)
+				continue;
+			const size_t up = q[a] + 1 < na ? c + st : c - (na - 1) * st;
+			A[c * n + up] -= L->g[a][c];
+			A[up * n + c] -= L->g[a][c];
+		}
+	}
+	for (size_t j = 0; j < n; j++) {
+		double d = A[j * n + j];
+		for (size_t k = 0; k < j; k++)
+			d -= A[j * n + k] * A[j * n + k];
+		if (!(d > 0.0))
+			return -1;
+		d = sqrt(d);
+		A[j * n + j] = d;
+		for (size_t i = j + 1; i < n; i++) {
+			double v = A[i * n + j];
+			for (size_t k = 0; k < j; k++)
+				v -= A[i * n + k] * A[j * n + k];
+			A[i * n + j] = v / d;
+		}
+	}
+	return 0;
+}
+
+static void ht_cholesky_solve(const double *A, size_t n, const double *b, double *x) {
+	for (size_t i = 0; i < n; i++) {
+		double v = b[i];
+		for (size_t k = 0; k < i; k++)
+			v -= A[i * n + k] * x[k];
+		x[i] = v / A[i * n + i];
+	}
+	for (size_t i = n; i-- > 0;) {
+		double v = x[i];
+		for (size_t k = i + 1; k < n; k++)
+			v -= A[k * n + i] * x[k];
+		x[i] = v / A[i * n + i];
+	}
+}
+
+/* Level 0 for step dt from the current boundary terms, then the rest. */
+static int ht_setup(ht_conduction_t *cond, ht_cond_work *w, double dt) {
+	ht_level *L = &w->lv[0];
+	const size_t nc = cond->n_cells;
+	const int nt = w->nt;
+	#pragma omp parallel for simd schedule(static) num_threads(nt) if(nt > 1 && nc >= HT_PARALLEL_MIN)
+	for (size_t c = 0; c < nc; c++)
+		L->s[c] = w->cap[c] / dt + 0.5 * w->bt[c];
+	ht_level_diag(L, nt);
+	for (size_t l = 1; l < w->n_levels; l++)
+		ht_level_coarsen(&w->lv[l - 1], &w->lv[l], nt);
+	if (w->line < 0 && ht_level_cholesky(&w->lv[w->n_levels - 1], w->chol) != 0)
+		return -1;
+	w->dt = dt;
+	cond->n_setups++;
+	return 0;
+}
+
+static void ht_vcycle(ht_cond_work *w, size_t l, const double *r, double *x) {
+	ht_level *L = &w->lv[l];
+	if (l + 1 == w->n_levels) {
+		ht_cholesky_solve(w->chol, L->nc, r, x);
+		return;
+	}
+	ht_level *C = &w->lv[l + 1];
+	ht_smooth(L, r, x, 1, w->nt);
+	ht_apply(L, r, x, L->t, w->nt);
+	ht_restrict(L, L->t, C, w->nt);
+	ht_vcycle(w, l + 1, C->r, C->x);
+	ht_prolong(L, x, C, w->nt);
+	ht_smooth(L, r, x, 0, w->nt);
+}
+
+/* -------------------------------
+   Solvers
+   ------------------------------- */
+
+static double ht_dot(ht_cond_work *w, const double *a, const double *b, size_t n) {
+	const size_t n_blocks = (n + HT_DOT_BLOCK - 1) / HT_DOT_BLOCK;
+	#pragma omp parallel for schedule(static) num_threads(w->nt) if(w->nt > 1 && n >= HT_PARALLEL_MIN)
+	for (size_t k = 0; k < n_blocks; k++) {
+		const size_t i1 = (k + 1) * HT_DOT_BLOCK < n ? (k + 1) * HT_DOT_BLOCK : n;
+		double v = 0.0;
+		for (size_t i = k * HT_DOT_BLOCK; i < i1; i++)
+			v += a[i] * b[i];
+		w->part[k] = v;
+	}
+	double v = 0.0;
+	for (size_t k = 0; k < n_blocks; k++)
+		v += w->part[k];
+	return v;
+}
+
+/* Straight line along axis a: r holds the right side, x the solution. */
+static void ht_thomas(const ht_level *L, int a, const double *r, double *x, double *cp) {
+	const size_t n = L->n[a], st = L->st[a];
+	const double *g = L->g[a];
+	double b = L->diag[0];
+	x[0] = r[0] / b;
+	for (size_t i = 1; i < n; i++) {
+		const size_t c = i * st, p = c - st;
+		cp[i - 1] = -g[p] / b;
+		b = L->diag[c] + g[p] * cp[i - 1];
+		x[c] = (r[c] + g[p] * x[p]) / b;
+	}
+	for (size_t i = n - 1; i-- > 0;)
+		x[i * st] -= cp[i] * x[(i + 1) * st];
+}
+
+/* Radiative faces linearized about T into bt, ft. */
+static void ht_radiative(ht_conduction_t *cond, ht_cond_work *w, const double *T) {
+	memcpy(w->bt, w->kb, cond->n_cells * sizeof *w->bt);
+	memcpy(w->ft, w->kf, cond->n_cells * sizeof *w->ft);
+	for (size_t f = 0; f < w->n_rad; f++) {
+		const size_t c = w->rad_cell[f];
+		const double Ts = T[c] > 0.0 ? T[c] : 0.0, Ti = w->rad_T[f];
+		const double hr = w->rad_eps[f] * (Ts * Ts + Ti * Ti) * (Ts + Ti);
+		const double G = ht_series(w->rad_g[f], hr * w->rad_area[f]);
+		w->bt[c] += G;
+		w->ft[c] += G * Ti;
+	}
+}
+
+/* -------------------------------
+   Public API
+   ------------------------------- */
+
+static void ht_work_free(ht_cond_work *w) {
+	if (!w)
+		return;
+	free(w->cap);
+	free(w->kb);
+	free(w->kf);
+	free(w->kq);
+	free(w->rad_cell);
+	free(w->rad_g);
+	free(w->rad_area);
+	free(w->rad_eps);
+	free(w->rad_T);
+	if (w->n_rad) {
+		free(w->bt);
+		free(w->ft);
+	}
+	for (size_t l = 0; w->lv && l < w->n_levels; l++) {
+		ht_level *L = &w->lv[l];
+		free(L->s);
+		free(L->diag);
+		free(L->inv_diag);
+		for (int a = 0; a < 3; a++)
+			free(L->g[a]);
+		if (l) {
+			free(L->r);
+			free(L->x);
+		}
+		free(L->t);
+	}
+	free(w->lv);
+	free(w->chol);
+	free(w->x);
+	free(w->r);
+	free(w->z);
+	free(w->p);
+	free(w->q);
+	free(w->part);
+	free(w);
+}
+
+static int ht_level_alloc(ht_level *L, const size_t n[3], int own_vectors) {
+	L->nc = n[0] * n[1] * n[2];
+	for (int a = 0; a < 3; a++) {
+		L->n[a] = n[a];
+		L->st[a] = a == 0 ? 1 : L->st[a - 1] * n[a - 1];
+		L->g[a] = calloc(L->nc, sizeof *L->g[a]);
+	}
+	L->s = malloc(L->nc * sizeof *L->s);
+	L->diag = malloc(L->nc * sizeof *L->diag);
+	L->inv_diag = malloc(L->nc * sizeof *L->inv_diag);
+	L->t = malloc(L->nc * sizeof *L->t);
+	if (own_vectors) {
+		L->r = malloc(L->nc * sizeof *L->r);
+		L->x = malloc(L->nc * sizeof *L->x);
+	}
+	return L->g[0] && L->g[1] && L->g[2] && L->s && L->diag && L->inv_diag && L->t
+	       && (!own_vectors || (L->r && L->x)) ? 0 : -1;
+}
+
+static const ht_material_t *ht_cell_material(const ht_system_t *system, const ht_mesh_t *mesh, size_t c) {
+	const size_t m = mesh->region ? mesh->region[c] : 0;
+	return m < system->n_materials ? system->materials[m] : NULL;
+}
+
+static double ht_material_k(const ht_material_t *mat, int a) {
+	return mat->anisotropy && mat->n_anisotropy > (size_t)a ? mat->anisotropy[a] : mat->conductivity;
+}
+
+/* Conductances and fixed boundary terms of level 0. */
+static int ht_assemble(ht_conduction_t *cond, ht_cond_work *w, const ht_system_t *system) {
+	const ht_mesh_t *mesh = &cond->mesh;
+	ht_level *L = &w->lv[0];
+	const size_t nc = cond->n_cells;
+	const double vol = mesh->d[0] * mesh->d[1] * mesh->d[2];
+	const double src = system->state ? system->state->heat_source : 0.0;
+	for (size_t c = 0; c < nc; c++) {
+		const ht_material_t *mat = ht_cell_material(system, mesh, c);
+		if (!mat)
+			return -1;
+		w->cap[c] = mat->density * mat->specific_heat * vol;
+		w->kq[c] = (mesh->heat_source ? mesh->heat_source[c] : src) * vol;
+		if (!(w->cap[c] >= 0.0) || !isfinite(w->cap[c]) || !isfinite(w->kq[c]))
+			return -1;
+		for (int a = 0; a < 3; a++)
+			if (!(ht_material_k(mat, a) >= 0.0))
+				return -1;
+	}
+
+	/* Faces: half the conductance, the Crank-Nicolson share of K. */
+	for (int a = 0; a < 3; a++) {
+		const size_t n = L->n[a], st = L->st[a];
+		const double area = vol / mesh->d[a], dx = mesh->d[a];
+		if (n < 2)
+			continue;
+		for (size_t c = 0; c < nc; c++) {
+			const size_t qa = (c / st) % n;
+			if (qa + 1 == n && !w->periodic[a])
+				continue;
+			const size_t up = qa + 1 < n ? c + st : c - (n - 1) * st;
+			const double k1 = ht_material_k(ht_cell_material(system, mesh, c), a);
+			const double k2 = ht_material_k(ht_cell_material(system, mesh, up), a);
+			L->g[a][c] = k1 + k2 > 0.0 ? 0.5 * 2.0 * area * k1 * k2 / (dx * (k1 + k2)) : 0.0;
+		}
+	}
+
+	/* Boundary faces; radiative ones counted, then recorded. */
+	for (int pass = 0; pass < 2; pass++) {
+		size_t n_rad = 0;
+		for (int a = 0; a < 3; a++) {
+			if (w->periodic[a])
+				continue;
+			const size_t n = L->n[a], st = L->st[a];
+			const double area = vol / mesh->d[a], dx = mesh->d[a];
+			for (int side = 0; side < 2; side++) {
+				const size_t b = 2 * (size_t)a + side;
+				const ht_boundary_t *bc = b < system->n_boundaries ? system->boundaries[b] : NULL;
+				if (!bc || bc->type == HT_BC_NONE)
+					continue;
+				if (bc->type == HT_BC_MOVING)
+					return -1;
+				for (size_t c = 0; c < nc; c++) {
+					if ((c / st) % n != (side ? n - 1 : 0))
+						continue;
+					const double gh = 2.0 * ht_material_k(ht_cell_material(system, mesh, c), a) * area / dx;
+					if (bc->type == HT_BC_RADIATIVE) {
+						if (pass) {
+							w->rad_cell[n_rad] = c;
+							w->rad_g[n_rad] = gh;
+							w->rad_area[n_rad] = area;
+							w->rad_eps[n_rad] = bc->emissivity * HT_SIGMA;
+							w->rad_T[n_rad] = bc->T_inf;
+						}
+						n_rad++;
+					} else if (pass == 0) {
+						double G = 0.0, Tb = 0.0;
+						switch (bc->type) {
+						case HT_BC_DIRICHLET:
+							G = gh;
+							Tb = bc->value;
+							break;
+						case HT_BC_NEUMANN:
+							w->kf[c] += bc->value * area;
+							break;
+						case HT_BC_ROBIN:
+						case HT_BC_CONVECTIVE:
+							G = ht_series(gh, bc->h * area);
+							Tb = bc->T_inf;
+							break;
+						default:
+							break;
+						}
+						w->kb[c] += G;
+						w->kf[c] += G * Tb;
+					}
+				}
+			}
+		}
+		if (pass == 0) {
+			w->n_rad = n_rad;
+			if (!n_rad)
+				break;
+			w->rad_cell = malloc(n_rad * sizeof *w->rad_cell);
+			w->rad_g = malloc(n_rad * sizeof *w->rad_g);
+			w->rad_area = malloc(n_rad * sizeof *w->rad_area);
+			w->rad_eps = malloc(n_rad * sizeof *w->rad_eps);
+			w->rad_T = malloc(n_rad * sizeof *w->rad_T);
+			w->bt = malloc(nc * sizeof *w->bt);
+			w->ft = malloc(nc * sizeof *w->ft);
+			if (!w->rad_cell || !w->rad_g || !w->rad_area || !w->rad_eps || !w->rad_T || !w->bt || !w->ft)
+				return -1;
+		}
+	}
+	if (!w->n_rad) {
+		w->bt = w->kb;
+		w->ft = w->kf;
+	}
+	return 0;
+}
+
+ht_conduction_t *ht_conduction_alloc(const ht_system_t *system, const ht_mesh_t *mesh, const ht_conduction_params *prm) {
+	if (!system || !mesh || (system->n_materials && !system->materials) || (system->n_boundaries && !system->boundaries))
+		return NULL;
+	size_t nc = 1;
+	for (int a = 0; a < 3; a++) {
+		if (!mesh->n[a] || !(mesh->d[a] > 0.0) || !isfinite(mesh->d[a]) || mesh->n[a] > SIZE_MAX / 16 / nc)
+			return NULL;
+		nc *= mesh->n[a];
+	}
+	ht_conduction_t *cond = calloc(1, sizeof *cond);
+	ht_cond_work *w = calloc(1, sizeof *w);
+	if (!cond || !w) {
+		free(cond);
+		free(w);
+		return NULL;
+	}
+	cond->mesh = *mesh;
+	cond->n_cells = nc;
+	if (prm)
+		cond->prm = *prm;
+	if (!(cond->prm.rtol > 0.0))
+		cond->prm.rtol = 1e-8;
+	if (!cond->prm.max_iter)
+		cond->prm.max_iter = 200;
+	cond->work = w;
+	w->nt = ht_threads(cond->prm.n_threads);
+
+	int axes = 0, axis = 0;
+	for (int a = 0; a < 3; a++) {
+		for (int side = 0; side < 2; side++) {
+			const size_t b = 2 * (size_t)a + side;
+			const ht_boundary_t *bc = b < system->n_boundaries ? system->boundaries[b] : NULL;
+			w->periodic[a] |= bc && bc->type == HT_BC_PERIODIC;
+		}
+		if (mesh->n[a] > 1) {
+			axes++;
+			axis = a;
+		}
+	}
+	w->line = axes <= 1 && !w->periodic[axis] ? axis : -1;
+
+	/* Levels: halve every axis longer than 1 until the dense size. */
+	size_t n_levels = 1, n[3] = { mesh->n[0], mesh->n[1], mesh->n[2] };
+	while (w->line < 0 && n[0] * n[1] * n[2] > HT_COARSE && (n[0] > 1 || n[1] > 1 || n[2] > 1)) {
+		for (int a = 0; a < 3; a++)
+			n[a] = (n[a] + 1) / 2;
+		n_levels++;
+	}
+	w->lv = calloc(n_levels, sizeof *w->lv);
+	w->cap = malloc(nc * sizeof *w->cap);
+	w->kb = calloc(nc, sizeof *w->kb);
+	w->kf = calloc(nc, sizeof *w->kf);
+	w->kq = malloc(nc * sizeof *w->kq);
+	w->x = malloc(nc * sizeof *w->x);
+	w->r = malloc(nc * sizeof *w->r);
+	w->z = malloc(nc * sizeof *w->z);
+	w->p = malloc(nc * sizeof *w->p);
+	w->q = malloc(nc * sizeof *w->q);
+	w->part = malloc(((nc + HT_DOT_BLOCK - 1) / HT_DOT_BLOCK) * sizeof *w->part);
+	int ok = w->lv && w->cap && w->kb && w->kf && w->kq && w->x && w->r && w->z && w->p && w->q && w->part;
+	if (ok) {
+		w->n_levels = n_levels;
+		for (int a = 0; a < 3; a++)
+			n[a] = mesh->n[a];
+		for (size_t l = 0; ok && l < n_levels; l++) {
+			ok = ht_level_alloc(&w->lv[l], n, l > 0) == 0;
+			for (int a = 0; a < 3; a++)
+				n[a] = (n[a] + 1) / 2;
+		}
+	}
+	if (ok && w->line < 0) {
+		const size_t m = w->lv[n_levels - 1].nc;
+		w->chol = malloc(m * m * sizeof *w->chol);
+		ok = w->chol != NULL;
+	}
+	if (!ok || ht_assemble(cond, w, system) != 0) {
+		ht_conduction_free(cond);
+		return NULL;
+	}
+	cond->mesh.region = NULL;
+	cond->mesh.heat_source = NULL;
+	return cond;
+}
+
+void ht_conduction_free(ht_conduction_t *cond) {
+	if (!cond)
+		return;
+	ht_work_free(cond->work);
+	free(cond);
+}
+
+int ht_conduction_step(ht_conduction_t *cond, double *T, double dt) {
+    HOLOS_TRACE_ZONE("ht_conduction_step");
+	if (!cond || !T || !(dt > 0.0) || !isfinite(dt))
+		return -1;
+	ht_cond_work *w = cond->work;
+	ht_level *L = &w->lv[0];
+	const size_t nc = cond->n_cells;
+	const int nt = w->nt;
+	if (w->n_rad)
+		ht_radiative(cond, w, T);
+	if ((w->n_rad || w->dt != dt) && ht_setup(cond, w, dt) != 0)
+		return -1;
+
+	/* q = A T; right side 2 (C/dt) T - A T + f into z, its residual at x = T into r. */
+	ht_apply(L, NULL, T, w->q, nt);
+	#pragma omp parallel for simd schedule(static) num_threads(nt) if(nt > 1 && nc >= HT_PARALLEL_MIN)
+	for (size_t c = 0; c < nc; c++) {
+		const double b = 2.0 * w->cap[c] / dt * T[c] - w->q[c] + w->ft[c] + w->kq[c];
+		w->z[c] = b;
+		w->r[c] = b - w->q[c];
+	}
+
+	if (w->line >= 0) {
+		ht_thomas(L, w->line, w->z, w->x, w->p);
+		cond->residual = 0.0;
+	} else {
+		const double bn = sqrt(ht_dot(w, w->z, w->z, nc));
+		const double tol = cond->prm.rtol * (bn > 0.0 ? bn : 1.0);
+		memcpy(w->x, T, nc * sizeof *w->x);
+		double rn = sqrt(ht_dot(w, w->r, w->r, nc)), rz = 0.0;
+		size_t it = 0;
+		while (rn > tol) {
+			if (it == cond->prm.max_iter) {
+				cond->n_iterations += it;
+				cond->residual = rn / (bn > 0.0 ? bn : 1.0);
+				return -1;
+			}
+			ht_vcycle(w, 0, w->r, w->z);
+			const double rz_new = ht_dot(w, w->r, w->z, nc);
+			const double beta = it ? rz_new / rz : 0.0;
+			rz = rz_new;
+			#pragma omp parallel for simd schedule(static) num_threads(nt) if(nt > 1 && nc >= HT_PARALLEL_MIN)
+			for (size_t c = 0; c < nc; c++)
+				w->p[c] = w->z[c] + beta * w->p[c];
+			ht_apply(L, NULL, w->p, w->q, nt);
+			const double alpha = rz / ht_dot(w, w->p, w->q, nc);
+			#pragma omp parallel for simd schedule(static) num_threads(nt) if(nt > 1 && nc >= HT_PARALLEL_MIN)
+			for (size_t c = 0; c < nc; c++) {
+				w->x[c] += alpha * w->p[c];
+				w->r[c] -= alpha * w->q[c];
+			}
+			rn = sqrt(ht_dot(w, w->r, w->r, nc));
+			it++;
+		}
+		cond->n_iterations += it;
+		cond->residual = rn / (bn > 0.0 ? bn : 1.0);
+	}
+	memcpy(T, w->x, nc * sizeof *T);
+
+	double heat = 0.0, flux = 0.0;
+	for (size_t c = 0; c < nc; c++) {
+		heat += w->cap[c] * T[c];
+		flux += w->ft[c] - w->bt[c] * T[c];
+	}
+	cond->heat = heat;
+	cond->boundary_flux = flux;
+	cond->n_steps++;
+	return 0;
+}
@@ -0,0 +1,325 @@
+/*
+   thermodynamics.c - Thermodynamics module for HOLOS
+
+   Closed-form state functions, scalar and over columns (see
+   thermodynamics.h). The columnar kernels are single loops that the
+   compiler vectorizes; the ones with logarithms run in blocks, with a
+   branch-free log on positive normal inputs and a scalar pass that hands
+   every other input to libm.
+
+   Copyright (C) 2025 HOLOS Scientific Computing Project
+
+   This file is part of HOLOS.
+
+   HOLOS is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "core/phys/thermo/thermodynamics.h"
+
+#define TD_R 8.314462618                /* Molar gas constant (J/mol/K) */
+#define TD_BLOCK 1024                   /* Elements per block of the log kernels */
+#define TD_PARALLEL_MIN 16384           /* Fewer elements stay serial */
+
+static int td_threads(int n_threads) {
+	if (n_threads < 0) {
+#ifdef _OPENMP
+		return omp_get_max_threads();
+#else
+		return 1;
+#endif
+	}
+	return n_threads > 0 ? n_threads : 1;
+}
+
+/* -------------------------------
+   Vector log
+   ------------------------------- */
+
+/* ln x for positive normal x: x = m 2^e with m in [sqrt(1/2), sqrt(2)),
+   then ln m = 2 atanh(s), s = (m - 1) / (m + 1), |s| < 0.172, to s^23.
+   Adding 2^52 - mantissa(sqrt 2) to the bits carries into the exponent
+   exactly when m >= sqrt(2), so the split needs no compare (SSE2 has no
+   64-bit ones) and the exponent reaches a double through the 2^52 bit
+   pattern (no vector int64 convert before AVX-512). */
+#pragma omp declare simd
+static inline double td_log_core(double x) {
+	uint64_t u;
+	memcpy(&u, &x, sizeof u);
+	const uint64_t kb = (u + UINT64_C(0x00095F619980C433)) >> 52;  /* Biased e */
+	const uint64_t mb = u - ((kb - UINT64_C(0x3FF)) << 52);
+	const uint64_t eb = UINT64_C(0x4330000000000000) | kb;
+	double m, ed;
+	memcpy(&m, &mb, sizeof m);
+	memcpy(&ed, &eb, sizeof ed);
+	ed -= 4503599627370496.0 + 1023.0;
+	const double s = (m - 1.0) / (m + 1.0), z = s * s;
+	double p = 1.0 / 23.0;
+	p = p * z + 1.0 / 21.0;
+	p = p * z + 1.0 / 19.0;
+	p = p * z + 1.0 / 17.0;
+	p = p * z + 1.0 / 15.0;
+	p = p * z + 1.0 / 13.0;
+	p = p * z + 1.0 / 11.0;
+	p = p * z + 1.0 / 9.0;
+	p = p * z + 1.0 / 7.0;
+	p = p * z + 1.0 / 5.0;
+	p = p * z + 1.0 / 3.0;
+	const double s2 = s + s;
+	return ed * 6.93147180369123816490e-01 + (s2 + (s2 * z * p + ed * 1.90821492927058770002e-10));
+}
+
+/* x > 0, normal and finite. */
+static inline int td_log_ok(double x) {
+	uint64_t u;
+	memcpy(&u, &x, sizeof u);
+	return u - UINT64_C(0x0010000000000000) < UINT64_C(0x7FE0000000000000);
+}
+
+static inline double td_log(double x) {
+	return td_log_ok(x) ? td_log_core(x) : log(x);
+}
+
+int td_log_n(const double *x, double *y, size_t count, int n_threads) {
+	if (count && (!x || !y))
+		return -1;
+	const int nt = td_threads(n_threads);
+	const size_t n_blocks = (count + TD_BLOCK - 1) / TD_BLOCK;
+
+	#pragma omp parallel for schedule(static) num_threads(nt) if(nt > 1 && count >= TD_PARALLEL_MIN)
+	for (size_t c = 0; c < n_blocks; c++) {
+		const size_t i0 = c * TD_BLOCK, len = count - i0 < TD_BLOCK ? count - i0 : TD_BLOCK;
+		double xb[TD_BLOCK];
+		memcpy(xb, x + i0, len * sizeof *xb);
+		#pragma omp simd
+		for (size_t i = 0; i < len; i++)
+			y[i0 + i] = td_log_core(xb[i]);
+		for (size_t i = 0; i < len; i++)
+			if (!td_log_ok(xb[i]))
+				y[i0 + i] = log(xb[i]);
+	}
+	return 0;
+}
+
+/* -------------------------------
+   Scalar state functions
+   ------------------------------- */
+
+double td_ideal_gas_pressure(double n, double T, double V) {
+	return n * TD_R * T / V;
+}
+
+double td_van_der_waals_pressure(double n, double T, double V, double a, double b) {
+	return n * TD_R * T / (V - n * b) - a * n * n / (V * V);
+}
+
+double td_ideal_gas_entropy(double n, double V, double T) {
+	return n * (1.5 * TD_R * td_log(T) + TD_R * td_log(V / n));
+}
+
+double td_gibbs_free_energy(double H, double T, double S) {
+	return H - T * S;
+}
+
+double td_helmholtz_free_energy(double U, double T, double S) {
+	return U - T * S;
+}
+
+double td_enthalpy(double U, double P, double V) {
+	return U + P * V;
+}
+
+/* -------------------------------
+   Columnar blocks
+   ------------------------------- */
+
+td_state_block *td_state_block_alloc(size_t n) {
+	td_state_block *b = calloc(1, sizeof *b);
+	double *col = calloc(9 * (n ? n : 1), sizeof *col);
+	if (!b || !col) {
+		free(b);
+		free(col);
+		return NULL;
+	}
+	b->n = n;
+	double **cols[] = { &b->T, &b->P, &b->V, &b->U, &b->S, &b->H, &b->G, &b->F, &b->n_moles };
+	for (size_t k = 0; k < sizeof cols / sizeof *cols; k++)
+		*cols[k] = col + k * n;
+	return b;
+}
+
+void td_state_block_free(td_state_block *block) {
+	if (!block)
+		return;
+	free(block->T);
+	free(block);
+}
+
+int td_state_block_load(td_state_block *block, td_state_t *const *states, size_t n) {
+	if (!block || n > block->n || (n && !states))
+		return -1;
+	for (size_t i = 0; i < n; i++) {
+		const td_state_t *s = states[i];
+		if (!s)
+			continue;
+		block->T[i] = s->T;
+		block->P[i] = s->P;
+		block->V[i] = s->V;
+		block->U[i] = s->U;
+		block->S[i] = s->S;
+		block->H[i] = s->H;
+		block->G[i] = s->G;
+		block->F[i] = s->F;
+		block->n_moles[i] = s->n;
+	}
+	return 0;
+}
+
+int td_state_block_store(const td_state_block *block, td_state_t **states, size_t n) {
+	if (!block || n > block->n || (n && !states))
+		return -1;
+	for (size_t i = 0; i < n; i++) {
+		td_state_t *s = states[i];
+		if (!s)
+			continue;
+		s->T = block->T[i];
+		s->P = block->P[i];
+		s->V = block->V[i];
+		s->U = block->U[i];
+		s->S = block->S[i];
+		s->H = block->H[i];
+		s->G = block->G[i];
+		s->F = block->F[i];
+		s->n = block->n_moles[i];
+	}
+	return 0;
+}
+
+/* -------------------------------
+   Columnar kernels
+   ------------------------------- */
+
+int td_ideal_gas_pressure_n(const double *n, const double *T, const double *V, double *P, size_t count, int n_threads) {
+	if (count && (!n || !T || !V || !P))
+		return -1;
+	const int nt = td_threads(n_threads);
+	#pragma omp parallel for simd schedule(static) num_threads(nt) if(nt > 1 && count >= TD_PARALLEL_MIN)
+	for (size_t i = 0; i < count; i++)
+		P[i] = n[i] * TD_R * T[i] / V[i];
+	return 0;
+}
+
+int td_van_der_waals_pressure_n(const double *n, const double *T, const double *V, double a, double b, double *P,
+                                size_t count, int n_threads) {
+	if (count && (!n || !T || !V || !P))
+		return -1;
+	const int nt = td_threads(n_threads);
+	#pragma omp parallel for simd schedule(static) num_threads(nt) if(nt > 1 && count >= TD_PARALLEL_MIN)
+	for (size_t i = 0; i < count; i++)
+		P[i] = n[i] * TD_R * T[i] / (V[i] - n[i] * b) - a * n[i] * n[i] / (V[i] * V[i]);
+	return 0;
+}
+
+int td_ideal_gas_entropy_n(const double *n, const double *V, const double *T, double *S, size_t count, int n_threads) {
+	if (count && (!n || !V || !T || !S))
+		return -1;
+	const int nt = td_threads(n_threads);
+	const size_t n_blocks = (count + TD_BLOCK - 1) / TD_BLOCK;
+
+	#pragma omp parallel for schedule(static) num_threads(nt) if(nt > 1 && count >= TD_PARALLEL_MIN)
+	for (size_t c = 0; c < n_blocks; c++) {
+		const size_t i0 = c * TD_BLOCK, len = count - i0 < TD_BLOCK ? count - i0 : TD_BLOCK;
+		double lt[TD_BLOCK], lv[TD_BLOCK], nb[TD_BLOCK];
+		memcpy(nb, n + i0, len * sizeof *nb);
+		#pragma omp simd
+		for (size_t i = 0; i < len; i++)
+			lv[i] = V[i0 + i] / nb[i];
+		td_log_n(T + i0, lt, len, 0);
+		td_log_n(lv, lv, len, 0);
+		#pragma omp simd
+		for (size_t i = 0; i < len; i++)
+			S[i0 + i] = nb[i] * (1.5 * TD_R * lt[i] + TD_R * lv[i]);
+	}
+	return 0;
+}
+
+int td_gibbs_free_energy_n(const double *H, const double *T, const double *S, double *G, size_t count, int n_threads) {
+	if (count && (!H || !T || !S || !G))
+		return -1;
+	const int nt = td_threads(n_threads);
+	#pragma omp parallel for simd schedule(static) num_threads(nt) if(nt > 1 && count >= TD_PARALLEL_MIN)
+	for (size_t i = 0; i < count; i++)
+		G[i] = H[i] - T[i] * S[i];
+	return 0;
+}
+
+int td_helmholtz_free_energy_n(const double *U, const double *T, const double *S, double *F, size_t count,
+                               int n_threads) {
+	if (count && (!U || !T || !S || !F))
+		return -1;
+	const int nt = td_threads(n_threads);
+	#pragma omp parallel for simd schedule(static) num_threads(nt) if(nt > 1 && count >= TD_PARALLEL_MIN)
+	for (size_t i = 0; i < count; i++)
+		F[i] = U[i] - T[i] * S[i];
+	return 0;
+}
+
+int td_enthalpy_n(const double *U, const double *P, const double *V, double *H, size_t count, int n_threads) {
+	if (count && (!U || !P || !V || !H))
+		return -1;
+	const int nt = td_threads(n_threads);
+	#pragma omp parallel for simd schedule(static) num_threads(nt) if(nt > 1 && count >= TD_PARALLEL_MIN)
+	for (size_t i = 0; i < count; i++)
+		H[i] = U[i] + P[i] * V[i];
+	return 0;
+}
+
+/* -------------------------------
+   Diagnostics
+   ------------------------------- */
+
+int td_diagnostics_stream(td_system_t *system, obs_stream *stream, size_t decimate, obs_reduce_t reduce) {
+	if (!system)
+		return -1;
+	obs_binding *b = stream ? obs_binding_alloc(stream, "td", decimate, reduce) : NULL;
+	if (stream && !b)
+		return -1;
+	obs_binding_free(system->diagnostics.stream);
+	system->diagnostics.stream = b;
+	return 0;
+}
+
+void td_diagnostics_update(td_system_t *system) {
+	if (!system || !system->diagnostics.stream)
+		return;
+	const td_diagnostics_t *d = &system->diagnostics;
+	obs_binding *b = d->stream;
+	const double t = (double)b->n_updates;
+	if (d->property_profile)
+		obs_binding_push(b, 0, "property_profile", t, d->property_profile, d->n_profile);
+	if (d->response_functions)
+		obs_binding_push(b, 1, "response_functions", t, d->response_functions, d->n_response);
+	if (d->electric_field_profile)
+		obs_binding_push(b, 2, "electric_field_profile", t, d->electric_field_profile, d->n_field_profile);
+	if (d->magnetic_field_profile)
+		obs_binding_push(b, 3, "magnetic_field_profile", t, d->magnetic_field_profile, d->n_field_profile);
+	b->n_updates++;
+}
@@ -0,0 +1,709 @@
+/*
+   thermodynamics_eos.c - Tabulated equations of state for HOLOS
+
+   Interpolation tables over eos_fn (see thermodynamics.h):
+   - Rectilinear grid refined by splitting the intervals whose midpoint
+     rows or columns, or cell centers, miss the current interpolant; the
+     midpoint samples become the new nodes, so each eos_fn call is used once
+   - Equal-width bins over each graded axis for O(1) cell lookup
+   - PCHIP node derivatives per axis (f_xT as PCHIP of f_x along T) and a
+     bicubic Hermite patch per cell
+   - A binary cache file, written under a temporary name and renamed, and
+     accepted on load only if its magic, key and sizes all match
+
+   Copyright (C) 2025 HOLOS Scientific Computing Project
+
+   This file is part of HOLOS.
+
+   HOLOS is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS; if not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "core/phys/thermo/thermodynamics.h"
+
+#define TD_EOS_INTERVALS 32             /* Default initial intervals per axis */
+#define TD_EOS_MAX_NODES 1025           /* Default node cap per axis */
+#define TD_EOS_MAGIC "HOLOSEOS"
+#define TD_EOS_VERSION 1u
+#define TD_EOS_DIFF_STEP 6e-6           /* Relative step of the central differences, ~cbrt(eps) */
+
+/* Equal bins over a graded axis: bin[b] is the last node at or below the
+   lower edge of bin b, so a lookup is one bin and a short forward scan. */
+typedef struct {
+	size_t n;
+	double a0, inv_da;
+	size_t *bin;
+} td_eos_bins;
+
+/* Nodes on u (x or ln x) by y (T); node[(i * ny + j) * 4 + k] holds f,
+   df/du, df/dy, d2f/dudy. */
+typedef struct {
+	td_eos_axes_t axes;
+	int log_x;
+	size_t nu, ny;
+	double *u, *y;
+	double *node;
+	td_eos_bins bu, by;
+} td_eos_table;
+
+static void td_eos_table_free(td_eos_table *t) {
+	if (!t)
+		return;
+	free(t->u);
+	free(t->y);
+	free(t->node);
+	free(t->bu.bin);
+	free(t->by.bin);
+	free(t);
+}
+
+static double td_eos_sample(const td_eos_t *eos, td_eos_axes_t axes, double x, double T) {
+	td_state_t st;
+	memset(&st, 0, sizeof st);
+	st.T = T;
+	st.n = 1.0;
+	if (axes == TD_EOS_RHO_T)
+		st.V = 1.0 / x;
+	else
+		st.P = x;
+	return eos->eos_fn(&st, eos->params);
+}
+
+/* -------------------------------
+   Interpolant
+   ------------------------------- */
+
+static double td_pchip_end(double h0, double h1, double d0, double d1) {
+	double d = ((2.0 * h0 + h1) * d0 - h0 * d1) / (h0 + h1);
+	if ((d > 0.0) != (d0 > 0.0) || d0 == 0.0)
+		d = 0.0;
+	else if ((d0 > 0.0) != (d1 > 0.0) && fabs(d) > fabs(3.0 * d0))
+		d = 3.0 * d0;
+	return d;
+}
+
+/* Shape-preserving derivatives of f (stride sf) on nodes x[0..n-1] into d (stride sd). */
+static void td_pchip(const double *x, size_t n, const double *f, size_t sf, double *d, size_t sd) {
+	if (n < 2) {
+		if (n)
+			d[0] = 0.0;
+		return;
+	}
+	if (n == 2) {
+		d[0] = d[sd] = (f[sf] - f[0]) / (x[1] - x[0]);
+		return;
+	}
+	for (size_t k = 1; k + 1 < n; k++) {
+		const double h0 = x[k] - x[k - 1], h1 = x[k + 1] - x[k];
+		const double d0 = (f[k * sf] - f[(k - 1) * sf]) / h0, d1 = (f[(k + 1) * sf] - f[k * sf]) / h1;
+		if (d0 * d1 <= 0.0) {
+			d[k * sd] = 0.0;
+			continue;
+		}
+		const double w1 = 2.0 * h1 + h0, w2 = h1 + 2.0 * h0;
+		d[k * sd] = (w1 + w2) / (w1 / d0 + w2 / d1);
+	}
+	const double h0 = x[1] - x[0], h1 = x[2] - x[1];
+	d[0] = td_pchip_end(h0, h1, (f[sf] - f[0]) / h0, (f[2 * sf] - f[sf]) / h1);
+	const double g0 = x[n - 1] - x[n - 2], g1 = x[n - 2] - x[n - 3];
+	d[(n - 1) * sd] = td_pchip_end(g0, g1, (f[(n - 1) * sf] - f[(n - 2) * sf]) / g0,
+	                               (f[(n - 2) * sf] - f[(n - 3) * sf]) / g1);
+}
+
+static void td_eos_derivatives(td_eos_table *t) {
+	const size_t nu = t->nu, ny = t->ny;
+	double *nd = t->node;
+	for (size_t j = 0; j < ny; j++)
+		td_pchip(t->u, nu, nd + 4 * j, 4 * ny, nd + 4 * j + 1, 4 * ny);
+	for (size_t i = 0; i < nu; i++) {
+		td_pchip(t->y, ny, nd + 4 * i * ny, 4, nd + 4 * i * ny + 2, 4);
+		td_pchip(t->y, ny, nd + 4 * i * ny + 1, 4, nd + 4 * i * ny + 3, 4);
+	}
+}
+
+static int td_eos_bins_build(td_eos_bins *b, const double *a, size_t n) {
+	b->n = 2 * n;
+	b->bin = malloc(b->n * sizeof *b->bin);
+	if (!b->bin)
+		return -1;
+	b->a0 = a[0];
+	const double da = (a[n - 1] - a[0]) / (double)b->n;
+	b->inv_da = 1.0 / da;
+	size_t k = 0;
+	for (size_t q = 0; q < b->n; q++) {
+		const double edge = a[0] + (double)q * da;
+		while (k + 2 < n && a[k + 1] <= edge)
+			k++;
+		b->bin[q] = k;
+	}
+	return 0;
+}
+
+static int td_eos_index(td_eos_table *t) {
+	free(t->bu.bin);
+	free(t->by.bin);
+	t->bu.bin = t->by.bin = NULL;
+	return td_eos_bins_build(&t->bu, t->u, t->nu) == 0 && td_eos_bins_build(&t->by, t->y, t->ny) == 0 ? 0 : -1;
+}
+
+/* Interval of v in [a[0], a[n - 1]]. */
+static size_t td_eos_locate(const double *a, size_t n, const td_eos_bins *b, double v) {
+	const double x = (v - b->a0) * b->inv_da;
+	size_t q = x > 0.0 ? (size_t)x : 0;
+	q = q < b->n ? q : b->n - 1;
+	size_t k = b->bin[q];
+	while (k > 0 && a[k] > v)
+		k--;
+	while (k + 2 < n && a[k + 1] <= v)
+		k++;
+	return k;
+}
+
+/* Bicubic Hermite value (and partials) in cell (i, j). */
+static double td_eos_patch(const td_eos_table *t, size_t i, size_t j, double u, double y, double *dfdu, double *dfdy) {
+	const double hu = t->u[i + 1] - t->u[i], hy = t->y[j + 1] - t->y[j];
+	const double a = (u - t->u[i]) / hu, b = (y - t->y[j]) / hy;
+	/* Hermite basis (values, derivatives) at the left and right node. */
+	const double ab = 1.0 - a, bb = 1.0 - b;
+	const double A[4] = { (1.0 + 2.0 * a) * ab * ab, hu * a * ab * ab, a * a * (3.0 - 2.0 * a), hu * a * a * (a - 1.0) };
+	const double B[4] = { (1.0 + 2.0 * b) * bb * bb, hy * b * bb * bb, b * b * (3.0 - 2.0 * b), hy * b * b * (b - 1.0) };
+	const double dA[4] = { 6.0 * a * (a - 1.0) / hu, 3.0 * a * a - 4.0 * a + 1.0, 6.0 * a * (1.0 - a) / hu,
+	                       3.0 * a * a - 2.0 * a };
+	const double dB[4] = { 6.0 * b * (b - 1.0) / hy, 3.0 * b * b - 4.0 * b + 1.0, 6.0 * b * (1.0 - b) / hy,
+	                       3.0 * b * b - 2.0 * b };
+	double f = 0.0, fu = 0.0, fy = 0.0;
+	for (int ci = 0; ci < 2; ci++)
+		for (int cj = 0; cj < 2; cj++) {
+			const double *n = t->node + 4 * ((i + ci) * t->ny + j + cj);
+			const double *Au = A + 2 * ci, *Bu = B + 2 * cj, *dAu = dA + 2 * ci, *dBu = dB + 2 * cj;
+			f += n[0] * Au[0] * Bu[0] + n[1] * Au[1] * Bu[0] + n[2] * Au[0] * Bu[1] + n[3] * Au[1] * Bu[1];
+			fu += n[0] * dAu[0] * Bu[0] + n[1] * dAu[1] * Bu[0] + n[2] * dAu[0] * Bu[1] + n[3] * dAu[1] * Bu[1];
+			fy += n[0] * Au[0] * dBu[0] + n[1] * Au[1] * dBu[0] + n[2] * Au[0] * dBu[1] + n[3] * Au[1] * dBu[1];
+		}
+	if (dfdu)
+		*dfdu = fu;
+	if (dfdy)
+		*dfdy = fy;
+	return f;
+}
+
+/* -------------------------------
+   Refinement
+   ------------------------------- */
+
+/* Midpoint of a Hermite interval from its end values and derivatives. */
+static double td_hermite_mid(double f0, double f1, double d0, double d1, double h) {
+	return 0.5 * (f0 + f1) + 0.125 * h * (d0 - d1);
+}
+
+/* Keep at most budget of the flagged intervals, those with the largest errors. */
+static size_t td_eos_budget(unsigned char *split, const double *err, size_t n, size_t budget) {
+	size_t count = 0;
+	for (size_t i = 0; i < n; i++)
+		count += split[i];
+	while (count > budget) {
+		size_t least = n;
+		for (size_t i = 0; i < n; i++)
+			if (split[i] && (least == n || err[i] < err[least]))
+				least = i;
+		split[least] = 0;
+		count--;
+	}
+	return count;
+}
+
+/* One refinement pass: midpoint samples and verdicts of both axes. */
+typedef struct {
+	double *col;                    /* [nu - 1][ny]: f at u midpoints, node y */
+	double *row;                    /* [nu][ny - 1]: f at node u, y midpoints */
+	double *cen;                    /* [nu - 1][ny - 1]: f at cell centers, NaN if not sampled */
+	double *err_c;                  /* Error / tolerance per cell center */
+	double *err_u, *err_y;          /* Worst error / tolerance per interval */
+	unsigned char *split_u, *split_y;
+} td_eos_pass;
+
+static void td_eos_pass_free(td_eos_pass *p) {
+	free(p->col);
+	free(p->row);
+	free(p->cen);
+	free(p->err_c);
+	free(p->err_u);
+	free(p->err_y);
+	free(p->split_u);
+	free(p->split_y);
+}
+
+static int td_eos_pass_alloc(td_eos_pass *p, size_t nu, size_t ny) {
+	p->col = malloc((nu - 1) * ny * sizeof *p->col);
+	p->row = malloc(nu * (ny - 1) * sizeof *p->row);
+	p->cen = malloc((nu - 1) * (ny - 1) * sizeof *p->cen);
+	p->err_c = calloc((nu - 1) * (ny - 1), sizeof *p->err_c);
+	p->err_u = calloc(nu - 1, sizeof *p->err_u);
+	p->err_y = calloc(ny - 1, sizeof *p->err_y);
+	p->split_u = calloc(nu - 1, 1);
+	p->split_y = calloc(ny - 1, 1);
+	if (p->col && p->row && p->cen && p->err_c && p->err_u && p->err_y && p->split_u && p->split_y)
+		return 0;
+	td_eos_pass_free(p);
+	return -1;
+}
+
+static double td_eos_x(const td_eos_table *t, double u) {
+	return t->log_x ? exp(u) : u;
+}
+
+/* Samples the midpoints of the intervals not yet accepted, and the centers
+   of the cells with one; a center off the patch splits its cell both ways,
+   which catches what edges alone miss (a boundary crossing the cell).
+   1 if eos_fn returned a non-finite value. */
+static int td_eos_test(const td_eos_t *eos, const td_eos_table_params *prm, const td_eos_table *t,
+                       const unsigned char *ok_u, const unsigned char *ok_y, td_eos_pass *p, int nt) {
+	const size_t nu = t->nu, ny = t->ny;
+	int bad = 0;
+	#pragma omp parallel for schedule(dynamic) num_threads(nt) if(nt > 1) reduction(|:bad)
+	for (size_t i = 0; i < nu - 1; i++) {
+		if (ok_u[i])
+			continue;
+		const double um = 0.5 * (t->u[i] + t->u[i + 1]), hu = t->u[i + 1] - t->u[i];
+		double e = 0.0;
+		for (size_t j = 0; j < ny; j++) {
+			const double *n0 = t->node + 4 * (i * ny + j), *n1 = n0 + 4 * ny;
+			const double v = td_eos_sample(eos, prm->axes, td_eos_x(t, um), t->y[j]);
+			const double d = fabs(v - td_hermite_mid(n0[0], n1[0], n0[1], n1[1], hu)) / (prm->rtol * fabs(v) + prm->atol);
+			bad |= !isfinite(v);
+			p->col[i * ny + j] = v;
+			e = d > e ? d : e;
+		}
+		p->err_u[i] = e;
+		p->split_u[i] = e > 1.0;
+	}
+	#pragma omp parallel for schedule(dynamic) num_threads(nt) if(nt > 1) reduction(|:bad)
+	for (size_t j = 0; j < ny - 1; j++) {
+		if (ok_y[j])
+			continue;
+		const double ym = 0.5 * (t->y[j] + t->y[j + 1]), hy = t->y[j + 1] - t->y[j];
+		double e = 0.0;
+		for (size_t i = 0; i < nu; i++) {
+			const double *n0 = t->node + 4 * (i * ny + j), *n1 = n0 + 4;
+			const double v = td_eos_sample(eos, prm->axes, td_eos_x(t, t->u[i]), ym);
+			const double d = fabs(v - td_hermite_mid(n0[0], n1[0], n0[2], n1[2], hy)) / (prm->rtol * fabs(v) + prm->atol);
+			bad |= !isfinite(v);
+			p->row[i * (ny - 1) + j] = v;
+			e = d > e ? d : e;
+		}
+		p->err_y[j] = e;
+		p->split_y[j] = e > 1.0;
+	}
+	#pragma omp parallel for schedule(dynamic) num_threads(nt) if(nt > 1) reduction(|:bad)
+	for (size_t i = 0; i < nu - 1; i++) {
+		const double um = 0.5 * (t->u[i] + t->u[i + 1]);
+		for (size_t j = 0; j < ny - 1; j++) {
+			const size_t c = i * (ny - 1) + j;
+			p->cen[c] = NAN;
+			p->err_c[c] = 0.0;
+			if (ok_u[i] && ok_y[j])
+				continue;
+			const double ym = 0.5 * (t->y[j] + t->y[j + 1]);
+			const double v = td_eos_sample(eos, prm->axes, td_eos_x(t, um), ym);
+			bad |= !isfinite(v);
+			p->cen[c] = v;
+			p->err_c[c] = fabs(v - td_eos_patch(t, i, j, um, ym, NULL, NULL)) / (prm->rtol * fabs(v) + prm->atol);
+		}
+	}
+	for (size_t i = 0; i < nu - 1; i++)
+		for (size_t j = 0; j < ny - 1; j++) {
+			const double e = p->err_c[i * (ny - 1) + j];
+			if (e <= 1.0)
+				continue;
+			p->split_u[i] = p->split_y[j] = 1;
+			p->err_u[i] = e > p->err_u[i] ? e : p->err_u[i];
+			p->err_y[j] = e > p->err_y[j] ? e : p->err_y[j];
+		}
+	/* Accepted intervals split by a center still need their midpoint samples. */
+	#pragma omp parallel for schedule(dynamic) num_threads(nt) if(nt > 1) reduction(|:bad)
+	for (size_t i = 0; i < nu - 1; i++) {
+		if (!ok_u[i] || !p->split_u[i])
+			continue;
+		const double xm = td_eos_x(t, 0.5 * (t->u[i] + t->u[i + 1]));
+		for (size_t j = 0; j < ny; j++) {
+			const double v = td_eos_sample(eos, prm->axes, xm, t->y[j]);
+			bad |= !isfinite(v);
+			p->col[i * ny + j] = v;
+		}
+	}
+	#pragma omp parallel for schedule(dynamic) num_threads(nt) if(nt > 1) reduction(|:bad)
+	for (size_t j = 0; j < ny - 1; j++) {
+		if (!ok_y[j] || !p->split_y[j])
+			continue;
+		const double ym = 0.5 * (t->y[j] + t->y[j + 1]);
+		for (size_t i = 0; i < nu; i++) {
+			const double v = td_eos_sample(eos, prm->axes, td_eos_x(t, t->u[i]), ym);
+			bad |= !isfinite(v);
+			p->row[i * (ny - 1) + j] = v;
+		}
+	}
+	return bad;
+}
+
+/* New axis with the split midpoints; pos[i] is the new index of node i,
+   and the sub-intervals of an accepted, unsplit interval stay accepted. */
+static double *td_eos_axis_split(const double *a, size_t n, const unsigned char *split, const unsigned char *ok,
+                                 const double *err, size_t m, size_t *pos, unsigned char **ok_out) {
+	double *a2 = malloc(m * sizeof *a2);
+	unsigned char *ok2 = calloc(m - 1, 1);
+	if (!a2 || !ok2) {
+		free(a2);
+		free(ok2);
+		return NULL;
+	}
+	size_t k = 0;
+	for (size_t i = 0; i < n; i++) {
+		pos[i] = k;
+		a2[k++] = a[i];
+		if (i + 1 < n && split[i])
+			a2[k++] = 0.5 * (a[i] + a[i + 1]);
+	}
+	for (size_t i = 0; i + 1 < n; i++)
+		for (size_t q = pos[i]; q < pos[i + 1]; q++)
+			ok2[q] = !split[i] && (ok[i] || err[i] <= 1.0);
+	*ok_out = ok2;
+	return a2;
+}
+
+/* Grid with the split columns and rows, their samples reused and their
+   crossings taken from the centers or sampled; 1 on a non-finite sample, -1 on allocation failure. */
+static int td_eos_insert(const td_eos_t *eos, const td_eos_table_params *prm, td_eos_table *t, const td_eos_pass *p,
+                         size_t mu, size_t my, unsigned char **ok_u, unsigned char **ok_y, int nt) {
+	const size_t nu = t->nu, ny = t->ny;
+	size_t *pu = malloc(nu * sizeof *pu), *py = malloc(ny * sizeof *py);
+	double *node = malloc(4 * mu * my * sizeof *node);
+	unsigned char *ok_u2 = NULL, *ok_y2 = NULL;
+	double *u2 = pu ? td_eos_axis_split(t->u, nu, p->split_u, *ok_u, p->err_u, mu, pu, &ok_u2) : NULL;
+	double *y2 = py ? td_eos_axis_split(t->y, ny, p->split_y, *ok_y, p->err_y, my, py, &ok_y2) : NULL;
+	if (!node || !u2 || !y2) {
+		free(pu);
+		free(py);
+		free(node);
+		free(u2);
+		free(y2);
+		free(ok_u2);
+		free(ok_y2);
+		return -1;
+	}
+	for (size_t i = 0; i < nu; i++)
+		for (size_t j = 0; j < ny; j++) {
+			node[4 * (pu[i] * my + py[j])] = t->node[4 * (i * ny + j)];
+			if (j + 1 < ny && p->split_y[j])
+				node[4 * (pu[i] * my + py[j] + 1)] = p->row[i * (ny - 1) + j];
+			if (i + 1 < nu && p->split_u[i])
+				node[4 * ((pu[i] + 1) * my + py[j])] = p->col[i * ny + j];
+		}
+	int bad = 0;
+	#pragma omp parallel for schedule(dynamic) num_threads(nt) if(nt > 1) reduction(|:bad)
+	for (size_t i = 0; i < nu - 1; i++) {
+		if (!p->split_u[i])
+			continue;
+		for (size_t j = 0; j + 1 < ny; j++)
+			if (p->split_y[j]) {
+				double v = p->cen[i * (ny - 1) + j];
+				if (isnan(v)) {
+					v = td_eos_sample(eos, prm->axes, td_eos_x(t, u2[pu[i] + 1]), y2[py[j] + 1]);
+					bad |= !isfinite(v);
+				}
+				node[4 * ((pu[i] + 1) * my + py[j] + 1)] = v;
+			}
+	}
+	free(pu);
+	free(py);
+	free(t->u);
+	free(t->y);
+	free(t->node);
+	free(*ok_u);
+	free(*ok_y);
+	t->u = u2;
+	t->y = y2;
+	t->node = node;
+	t->nu = mu;
+	t->ny = my;
+	*ok_u = ok_u2;
+	*ok_y = ok_y2;
+	return bad;
+}
+
+static int td_eos_refine(const td_eos_t *eos, const td_eos_table_params *prm, td_eos_table *t, size_t max_nodes,
+                         int nt) {
+	unsigned char *ok_u = calloc(t->nu - 1, 1), *ok_y = calloc(t->ny - 1, 1);
+	int rc = ok_u && ok_y ? 0 : -1;
+	while (rc == 0) {
+		td_eos_derivatives(t);
+		td_eos_pass p;
+		if (td_eos_pass_alloc(&p, t->nu, t->ny) != 0) {
+			rc = -1;
+			break;
+		}
+		if (td_eos_test(eos, prm, t, ok_u, ok_y, &p, nt)) {
+			td_eos_pass_free(&p);
+			rc = -1;
+			break;
+		}
+		const size_t su = td_eos_budget(p.split_u, p.err_u, t->nu - 1, max_nodes - t->nu);
+		const size_t sy = td_eos_budget(p.split_y, p.err_y, t->ny - 1, max_nodes - t->ny);
+		if (su || sy)
+			rc = td_eos_insert(eos, prm, t, &p, t->nu + su, t->ny + sy, &ok_u, &ok_y, nt) ? -1 : 0;
+		td_eos_pass_free(&p);
+		if (!su && !sy)
+			break;
+	}
+	free(ok_u);
+	free(ok_y);
+	return rc;
+}
+
+/* -------------------------------
+   Cache file
+   ------------------------------- */
+
+static uint64_t td_fnv(uint64_t h, const void *data, size_t n) {
+	const unsigned char *p = data;
+	for (size_t k = 0; k < n; k++) {
+		h ^= p[k];
+		h *= UINT64_C(0x100000001B3);
+	}
+	return h;
+}
+
+static uint64_t td_eos_key(const td_eos_t *eos, const td_eos_table_params *prm) {
+	uint64_t h = UINT64_C(0xCBF29CE484222325);
+	const uint32_t version = TD_EOS_VERSION, axes = (uint32_t)prm->axes, log_x = (uint32_t)(prm->log_x != 0);
+	const uint64_t sizes[3] = { prm->nx, prm->nT, prm->max_nodes };
+	const double dom[6] = { prm->x_min, prm->x_max, prm->T_min, prm->T_max, prm->rtol, prm->atol };
+	h = td_fnv(h, &version, sizeof version);
+	if (eos->name)
+		h = td_fnv(h, eos->name, strlen(eos->name) + 1);
+	if (prm->params_size && eos->params)
+		h = td_fnv(h, eos->params, prm->params_size);
+	h = td_fnv(h, &axes, sizeof axes);
+	h = td_fnv(h, &log_x, sizeof log_x);
+	h = td_fnv(h, sizes, sizeof sizes);
+	return td_fnv(h, dom, sizeof dom);
+}
+
+static char *td_eos_cache_path(const char *dir, uint64_t key, const char *suffix) {
+	const size_t len = strlen(dir) + 64;
+	char *path = malloc(len);
+	if (path)
+		snprintf(path, len, "%s/td_eos_%016llx.bin%s", dir, (unsigned long long)key, suffix);
+	return path;
+}
+
+static td_eos_table *td_eos_cache_load(const char *path, uint64_t key, td_eos_axes_t axes, int log_x) {
+	FILE *fp = fopen(path, "rb");
+	if (!fp)
+		return NULL;
+	char magic[8];
+	uint32_t version, ax, lx;
+	uint64_t k, nu, ny;
+	td_eos_table *t = NULL;
+	if (fread(magic, 1, 8, fp) == 8 && memcmp(magic, TD_EOS_MAGIC, 8) == 0 && fread(&version, sizeof version, 1, fp) == 1
+	    && version == TD_EOS_VERSION && fread(&ax, sizeof ax, 1, fp) == 1 && ax == (uint32_t)axes
+	    && fread(&lx, sizeof lx, 1, fp) == 1 && lx == (uint32_t)(log_x != 0) && fread(&k, sizeof k, 1, fp) == 1
+	    && k == key && fread(&nu, sizeof nu, 1, fp) == 1 && fread(&ny, sizeof ny, 1, fp) == 1 && nu >= 2 && ny >= 2
+	    && nu <= SIZE_MAX / 4 / ny / sizeof(double) && (t = calloc(1, sizeof *t))) {
+		t->axes = axes;
+		t->log_x = log_x != 0;
+		t->nu = (size_t)nu;
+		t->ny = (size_t)ny;
+		t->u = malloc(t->nu * sizeof *t->u);
+		t->y = malloc(t->ny * sizeof *t->y);
+		t->node = malloc(4 * t->nu * t->ny * sizeof *t->node);
+		if (!t->u || !t->y || !t->node || fread(t->u, sizeof *t->u, t->nu, fp) != t->nu
+		    || fread(t->y, sizeof *t->y, t->ny, fp) != t->ny
+		    || fread(t->node, sizeof *t->node, 4 * t->nu * t->ny, fp) != 4 * t->nu * t->ny || fgetc(fp) != EOF) {
+			td_eos_table_free(t);
+			t = NULL;
+		}
+	}
+	fclose(fp);
+	return t;
+}
+
+/* Best effort: a failed write leaves no file behind and the table in use. */
+static void td_eos_cache_store(const char *dir, uint64_t key, const td_eos_table *t) {
+	char *path = td_eos_cache_path(dir, key, ""), *tmp = td_eos_cache_path(dir, key, ".tmp");
+	FILE *fp = path && tmp ? fopen(tmp, "wb") : NULL;
+	if (fp) {
+		const uint32_t version = TD_EOS_VERSION, ax = (uint32_t)t->axes, lx = (uint32_t)t->log_x;
+		const uint64_t nu = t->nu, ny = t->ny;
+		int ok = fwrite(TD_EOS_MAGIC, 1, 8, fp) == 8 && fwrite(&version, sizeof version, 1, fp) == 1
+		         && fwrite(&ax, sizeof ax, 1, fp) == 1 && fwrite(&lx, sizeof lx, 1, fp) == 1
+		         && fwrite(&key, sizeof key, 1, fp) == 1 && fwrite(&nu, sizeof nu, 1, fp) == 1
+		         && fwrite(&ny, sizeof ny, 1, fp) == 1 && fwrite(t->u, sizeof *t->u, t->nu, fp) == t->nu
+		         && fwrite(t->y, sizeof *t->y, t->ny, fp) == t->ny
+		         && fwrite(t->node, sizeof *t->node, 4 * t->nu * t->ny, fp) == 4 * t->nu * t->ny;
+		ok = fclose(fp) == 0 && ok;
+		if (!ok || rename(tmp, path) != 0)
+			remove(tmp);
+	}
+	free(path);
+	free(tmp);
+}
+
+/* -------------------------------
+   Public API
+   ------------------------------- */
+
+int td_eos_tabulate(td_eos_t *eos, const td_eos_table_params *prm) {
+	if (!eos || !eos->eos_fn || !prm || (prm->axes != TD_EOS_RHO_T && prm->axes != TD_EOS_P_T)
+	    || !isfinite(prm->x_min) || !isfinite(prm->x_max) || !(prm->x_max > prm->x_min) || !isfinite(prm->T_min)
+	    || !isfinite(prm->T_max) || !(prm->T_max > prm->T_min) || (prm->log_x && !(prm->x_min > 0.0))
+	    || (prm->axes == TD_EOS_RHO_T && !(prm->x_min > 0.0)) || !(prm->rtol >= 0.0) || !(prm->atol >= 0.0)
+	    || !(prm->rtol + prm->atol > 0.0) || (prm->params_size && !eos->params))
+		return -1;
+	const size_t max_nodes = prm->max_nodes ? prm->max_nodes : TD_EOS_MAX_NODES;
+	const size_t nx = prm->nx ? prm->nx : TD_EOS_INTERVALS, nT = prm->nT ? prm->nT : TD_EOS_INTERVALS;
+	if (nx + 1 > max_nodes || nT + 1 > max_nodes)
+		return -1;
+	int n_threads = prm->n_threads;
+	if (n_threads < 0) {
+#ifdef _OPENMP
+		n_threads = omp_get_max_threads();
+#else
+		n_threads = 1;
+#endif
+	}
+	const int nt = n_threads > 0 ? n_threads : 1;
+
+	const uint64_t key = td_eos_key(eos, prm);
+	td_eos_table *t = NULL;
+	if (prm->cache_dir) {
+		char *path = td_eos_cache_path(prm->cache_dir, key, "");
+		if (path)
+			t = td_eos_cache_load(path, key, prm->axes, prm->log_x);
+		free(path);
+	}
+	if (!t) {
+		t = calloc(1, sizeof *t);
+		if (!t)
+			return -1;
+		t->axes = prm->axes;
+		t->log_x = prm->log_x != 0;
+		t->nu = nx + 1;
+		t->ny = nT + 1;
+		t->u = malloc(t->nu * sizeof *t->u);
+		t->y = malloc(t->ny * sizeof *t->y);
+		t->node = malloc(4 * t->nu * t->ny * sizeof *t->node);
+		if (!t->u || !t->y || !t->node) {
+			td_eos_table_free(t);
+			return -1;
+		}
+		const double u0 = t->log_x ? log(prm->x_min) : prm->x_min, u1 = t->log_x ? log(prm->x_max) : prm->x_max;
+		for (size_t i = 0; i < t->nu; i++)
+			t->u[i] = i == nx ? u1 : u0 + (u1 - u0) * (double)i / (double)nx;
+		for (size_t j = 0; j < t->ny; j++)
+			t->y[j] = j == nT ? prm->T_max : prm->T_min + (prm->T_max - prm->T_min) * (double)j / (double)nT;
+		int bad = 0;
+		#pragma omp parallel for schedule(dynamic) num_threads(nt) if(nt > 1) reduction(|:bad)
+		for (size_t i = 0; i < t->nu; i++)
+			for (size_t j = 0; j < t->ny; j++) {
+				const double v = td_eos_sample(eos, prm->axes, t->log_x ? exp(t->u[i]) : t->u[i], t->y[j]);
+				bad |= !isfinite(v);
+				t->node[4 * (i * t->ny + j)] = v;
+			}
+		if (bad || td_eos_refine(eos, prm, t, max_nodes, nt) != 0) {
+			td_eos_table_free(t);
+			return -1;
+		}
+		td_eos_derivatives(t);
+		if (prm->cache_dir)
+			td_eos_cache_store(prm->cache_dir, key, t);
+	}
+	if (td_eos_index(t) != 0) {
+		td_eos_table_free(t);
+		return -1;
+	}
+	td_eos_untabulate(eos);
+	eos->table = t;
+	return 0;
+}
+
+void td_eos_untabulate(td_eos_t *eos) {
+	if (!eos)
+		return;
+	td_eos_table_free(eos->table);
+	eos->table = NULL;
+}
+
+double td_eos_eval_xt(const td_eos_t *eos, double x, double T, double *dfdx, double *dfdT) {
+	if (!eos)
+		return 0.0;
+	const td_eos_table *t = eos->table;
+	if (t) {
+		const double u = t->log_x ? (x > 0.0 ? log(x) : -HUGE_VAL) : x;
+		if (u >= t->u[0] && u <= t->u[t->nu - 1] && T >= t->y[0] && T <= t->y[t->ny - 1]) {
+			double fu;
+			const size_t i = td_eos_locate(t->u, t->nu, &t->bu, u), j = td_eos_locate(t->y, t->ny, &t->by, T);
+			const double f = td_eos_patch(t, i, j, u, T, dfdx ? &fu : NULL, dfdT);
+			if (dfdx)
+				*dfdx = t->log_x ? fu / x : fu;
+			return f;
+		}
+	}
+	if (!eos->eos_fn)
+		return 0.0;
+	const td_eos_axes_t axes = t ? t->axes : TD_EOS_RHO_T;
+	if (dfdx) {
+		const double d = TD_EOS_DIFF_STEP * (fabs(x) > 1.0 ? fabs(x) : 1.0);
+		*dfdx = (td_eos_sample(eos, axes, x + d, T) - td_eos_sample(eos, axes, x - d, T)) / (2.0 * d);
+	}
+	if (dfdT) {
+		const double d = TD_EOS_DIFF_STEP * (fabs(T) > 1.0 ? fabs(T) : 1.0);
+		*dfdT = (td_eos_sample(eos, axes, x, T + d) - td_eos_sample(eos, axes, x, T - d)) / (2.0 * d);
+	}
+	return td_eos_sample(eos, axes, x, T);
+}
+
+double td_eos_eval(const td_eos_t *eos, const td_state_t *state) {
+	if (!eos || !state)
+		return 0.0;
+	const td_eos_table *t = eos->table;
+	if (!t)
+		return eos->eos_fn ? eos->eos_fn(state, eos->params) : 0.0;
+	const double x = t->axes == TD_EOS_RHO_T ? (state->n > 0.0 ? state->n : 1.0) / state->V : state->P;
+	return td_eos_eval_xt(eos, x, state->T, NULL, NULL);
+}
+
+int td_eos_eval_n(const td_eos_t *eos, const double *x, const double *T, double *f, size_t count, int n_threads) {
+	if (!eos || (count && (!x || !T || !f)))
+		return -1;
+	if (n_threads < 0) {
+#ifdef _OPENMP
+		n_threads = omp_get_max_threads();
+#else
+		n_threads = 1;
+#endif
+	}
+	const int nt = n_threads > 0 ? n_threads : 1;
+	#pragma omp parallel for schedule(static) num_threads(nt) if(nt > 1)
+	for (size_t i = 0; i < count; i++)
+		f[i] = td_eos_eval_xt(eos, x[i], T[i], NULL, NULL);
+	return 0;
+}
@@ -0,0 +1,156 @@
+/* tech.c - Technology records of HOLOS
+    Copyright (C) 2025  4137314 <holos@mail.com>
+
+    This file is part of HOLOS.
+
+    HOLOS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    HOLOS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+    ----------------------------------------------------------------------
+    A technology of its own: each field malloc'd, freed by
+    holos_tech_free. Those of a catalog are in tech_catalog.c.
+
+    IDs are 64-bit numbers in hex: a random start, drawn once, and a
+    counter mixed by splitmix64, so that they do not repeat within a
+    process and are unlikely to across processes.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#include "core/tech/tech.h"
+#include "tech_work.h"
+
+static atomic_uint_fast64_t g_id_next;
+static atomic_int g_id_seeded;
+
+static uint64_t tech_mix(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9u;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebu;
+    return x ^ (x >> 31);
+}
+
+void tech_make_id(char *out) {
+    uint64_t n;
+    if (!atomic_load(&g_id_seeded)) {
+        uint64_t seed = (uint64_t)time(NULL) ^ (uint64_t)(uintptr_t)&seed;
+        FILE *rnd = fopen("/dev/urandom", "rb");
+        if (rnd) {
+            if (fread(&seed, sizeof(seed), 1, rnd) != 1) seed ^= (uint64_t)clock();
+            fclose(rnd);
+        }
+        if (!atomic_exchange(&g_id_seeded, 1)) atomic_store(&g_id_next, seed);
+    }
+    n = atomic_fetch_add(&g_id_next, 0x9e3779b97f4a7c15u);
+    snprintf(out, TECH_ID_LEN + 1, "%016llx", (unsigned long long)tech_mix(n));
+}
+
+static char *tech_strdup(const char *s) {
+    return s ? strdup(s) : NULL;
+}
+
+struct holos_technology *holos_tech_create(const char *name, const char *description, const char *category,
+                                           const char *physics_model, const char *creator,
+                                           const char *lifecycle_stage) {
+    struct holos_technology *tech;
+    char id[TECH_ID_LEN + 1];
+    if (!name) return NULL;
+    if (!(tech = calloc(1, sizeof(*tech)))) return NULL;
+    tech_make_id(id);
+    tech->id = strdup(id);
+    tech->name = strdup(name);
+    tech->description = tech_strdup(description);
+    tech->category = tech_strdup(category);
+    tech->physics_model = tech_strdup(physics_model);
+    tech->creator = tech_strdup(creator);
+    tech->lifecycle_stage = tech_strdup(lifecycle_stage);
+    if (!tech->id || !tech->name || (description && !tech->description) || (category && !tech->category) ||
+        (physics_model && !tech->physics_model) || (creator && !tech->creator) ||
+        (lifecycle_stage && !tech->lifecycle_stage)) {
+        holos_tech_free(tech);
+        return NULL;
+    }
+    return tech;
+}
+
+static void tech_free_list(char **list, int n) {
+    for (int i = 0; list && i < n; i++) free(list[i]);
+    free(list);
+}
+
+void holos_tech_free(struct holos_technology *tech) {
+    if (!tech) return;
+    free(tech->id);
+    free(tech->name);
+    free(tech->description);
+    free(tech->category);
+    free(tech->physics_model);
+    free(tech->creator);
+    tech_free_list(tech->patents, tech->n_patents);
+    free(tech->digital_twin);
+    tech_free_list(tech->tags, tech->n_tags);
+    free(tech->lifecycle_stage);
+    tech_free_list(tech->regulatory_certifications, tech->n_certifications);
+    tech_free_list(tech->supply_chain_sources, tech->n_supply_sources);
+    free(tech->digital_certification);
+    free(tech->ai_explainability);
+    free(tech->interoperability);
+    free(tech->provenance);
+    free(tech->version);
+    free(tech->cybersecurity);
+    free(tech->ethics);
+    free(tech->localization);
+    free(tech->accessibility);
+    free(tech);
+}
+
+/* ---------------- Search ---------------- */
+
+static int tech_listed(char *const *list, int n, const char *key) {
+    for (int i = 0; list && i < n; i++)
+        if (list[i] && strcmp(list[i], key) == 0) return 1;
+    return 0;
+}
+
+struct holos_technology *holos_tech_find_by_tag(struct holos_technology **techs, int n, const char *tag) {
+    for (int i = 0; techs && tag && i < n; i++)
+        if (techs[i] && tech_listed(techs[i]->tags, techs[i]->n_tags, tag)) return techs[i];
+    return NULL;
+}
+
+struct holos_technology *holos_tech_find_by_certification(struct holos_technology **techs, int n,
+                                                          const char *certification) {
+    for (int i = 0; techs && certification && i < n; i++)
+        if (techs[i] &&
+            tech_listed(techs[i]->regulatory_certifications, techs[i]->n_certifications, certification))
+            return techs[i];
+    return NULL;
+}
+
+struct holos_technology *holos_tech_find_by_category(struct holos_technology **techs, int n, const char *category) {
+    for (int i = 0; techs && category && i < n; i++)
+        if (techs[i] && techs[i]->category && strcmp(techs[i]->category, category) == 0) return techs[i];
+    return NULL;
+}
+
+struct holos_technology *holos_tech_find_by_lifecycle(struct holos_technology **techs, int n,
+                                                      const char *lifecycle_stage) {
+    for (int i = 0; techs && lifecycle_stage && i < n; i++)
+        if (techs[i] && techs[i]->lifecycle_stage && strcmp(techs[i]->lifecycle_stage, lifecycle_stage) == 0)
+            return techs[i];
+    return NULL;
+}
@@ -0,0 +1,361 @@
+/* tech_arrow.c - Arrow IPC files of technology snapshots of HOLOS
+    Copyright (C) 2025  4137314 <holos@mail.com>
+
+    This file is part of HOLOS.
+
+    HOLOS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    HOLOS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+    ----------------------------------------------------------------------
+    The file format of Arrow IPC (columnar format 1.0, metadata V5):
+
+        "ARROW1" 00 00
+        schema message
+        record batch message, then its body: the column buffers
+        end of stream: ffffffff 00000000
+        footer, its size (int32), "ARROW1"
+
+    A message is ffffffff, the size of its metadata (int32) and the
+    metadata, a flatbuffer padded to 8 bytes. The flatbuffers are built
+    here front to back, with no library: a table is its vtable then its
+    fields, the larger first, and what it refers to comes after it, so
+    that every offset is forward as flatbuffers want; offsets are
+    patched in once their target is written. The metadata is little
+    endian; the body is the snapshot's buffers as they are, of the
+    host's order, which the schema says.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+
+#include "core/tech/tech.h"
+#include "tech_work.h"
+
+#define ARROW_V5 4                      /* MetadataVersion */
+#define ARROW_ALIGN 8
+
+enum {                                  /* MessageHeader */
+    ARROW_SCHEMA = 1,
+    ARROW_RECORD_BATCH = 3
+};
+
+enum {                                  /* Type */
+    ARROW_INT = 2,
+    ARROW_FLOATING_POINT = 3,
+    ARROW_UTF8 = 5
+};
+
+/* ---------------- Flatbuffers ---------------- */
+
+struct fb {
+    unsigned char *buf;
+    size_t n, cap;
+    int failed;
+};
+
+struct fb_field {
+    int size;                           /* 1, 2, 4, 8 bytes; FB_OFFSET; 0 absent */
+    uint64_t value;
+    size_t at;                          /* Where an offset is, to patch */
+};
+
+#define FB_OFFSET (-4)
+
+static void fb_put(struct fb *fb, const void *p, size_t n) {
+    if (fb->n + n > fb->cap) {
+        size_t cap = fb->cap ? fb->cap : 4096;
+        unsigned char *grown;
+        while (cap < fb->n + n) cap *= 2;
+        if (!(grown = realloc(fb->buf, cap))) {
+            fb->failed = 1;
+            return;
+        }
+        fb->buf = grown;
+        fb->cap = cap;
+    }
+    if (p) memcpy(fb->buf + fb->n, p, n);
+    else memset(fb->buf + fb->n, 0, n);
+    fb->n += n;
+}
+
+static void fb_le(unsigned char *out, uint64_t v, int bytes) {
+    for (int i = 0; i < bytes; i++) out[i] = (unsigned char)(v >> (8 * i));
+}
+
+static void fb_scalar(struct fb *fb, uint64_t v, int bytes) {
+    unsigned char b[8];
+    fb_le(b, v, bytes);
+    fb_put(fb, b, (size_t)bytes);
+}
+
+/* Pads to a position of phase modulo align */
+static void fb_align(struct fb *fb, size_t align, size_t phase) {
+    while (fb->n % align != phase) fb_put(fb, NULL, 1);
+}
+
+/* The offset at at, to what is at target */
+static void fb_patch(struct fb *fb, size_t at, size_t target) {
+    if (!fb->failed) fb_le(fb->buf + at, target - at, 4);
+}
+
+/* A table of n fields, its position; it starts 4 past a multiple of 8,
+   so that a field at 8k + 4 of it is aligned */
+static size_t fb_table(struct fb *fb, struct fb_field *f, int n) {
+    size_t off = 4, place[16], start, vtable;
+    unsigned char inline_[128];
+    for (int size = 8; size >= 1; size /= 2)
+        for (int i = 0; i < n; i++) {
+            const int sz = f[i].size == FB_OFFSET ? 4 : f[i].size;
+            if (sz != size) continue;
+            while ((4 + off) % (size_t)size) off++;
+            place[i] = off;
+            off += (size_t)size;
+        }
+    off = (off + 3) & ~(size_t)3;
+    fb_align(fb, 2, 0);
+    vtable = fb->n;
+    fb_scalar(fb, 4 + 2 * (uint64_t)n, 2);
+    fb_scalar(fb, off, 2);
+    for (int i = 0; i < n; i++) fb_scalar(fb, f[i].size ? place[i] : 0, 2);
+    fb_align(fb, 8, 4);
+    start = fb->n;
+    memset(inline_, 0, off);
+    fb_le(inline_, start - vtable, 4);
+    for (int i = 0; i < n; i++) {
+        if (f[i].size == FB_OFFSET) f[i].at = start + place[i];
+        else if (f[i].size) fb_le(inline_ + place[i], f[i].value, f[i].size);
+    }
+    fb_put(fb, inline_, off);
+    return start;
+}
+
+/* A vector of n elements of size bytes (zeroed, to fill in), its
+   position; elements of 8 bytes or more are aligned to 8 */
+static size_t fb_vector(struct fb *fb, size_t n, size_t size) {
+    size_t at;
+    if (size >= 8) fb_align(fb, 8, 4);
+    else fb_align(fb, 4, 0);
+    at = fb->n;
+    fb_scalar(fb, n, 4);
+    fb_put(fb, NULL, n * size);
+    return at;
+}
+
+static size_t fb_string(struct fb *fb, const char *s) {
+    const size_t n = strlen(s);
+    size_t at;
+    fb_align(fb, 4, 0);
+    at = fb->n;
+    fb_scalar(fb, n, 4);
+    fb_put(fb, s, n + 1);
+    return at;
+}
+
+/* ---------------- Metadata ---------------- */
+
+static int host_big_endian(void) {
+    const uint16_t one = 1;
+    return *(const unsigned char *)&one == 0;
+}
+
+static size_t arrow_type(struct fb *fb, int type) {
+    if (type == TECH_INT32) {
+        struct fb_field f[] = {{4, 32, 0}, {1, 1, 0}};          /* bitWidth, is_signed */
+        return fb_table(fb, f, 2);
+    }
+    if (type == TECH_FLOAT64) {
+        struct fb_field f[] = {{2, 2, 0}};                      /* precision: DOUBLE */
+        return fb_table(fb, f, 1);
+    }
+    return fb_table(fb, NULL, 0);
+}
+
+static size_t arrow_schema(struct fb *fb, const struct tech_column *cols) {
+    struct fb_field schema[] = {{2, (uint64_t)host_big_endian(), 0}, {FB_OFFSET, 0, 0}};
+    const size_t at = fb_table(fb, schema, 2), fields = fb_vector(fb, TECH_COLUMNS, 4);
+    fb_patch(fb, schema[1].at, fields);
+    for (int c = 0; c < TECH_COLUMNS; c++) {
+        const int type = cols[c].type == TECH_UTF8 ? ARROW_UTF8 : cols[c].type == TECH_INT32 ? ARROW_INT
+                                                                                              : ARROW_FLOATING_POINT;
+        struct fb_field field[] = {{FB_OFFSET, 0, 0},
+                                   {1, cols[c].type == TECH_UTF8, 0},
+                                   {1, (uint64_t)type, 0},
+                                   {FB_OFFSET, 0, 0},
+                                   {0, 0, 0},
+                                   {FB_OFFSET, 0, 0}};
+        const size_t t = fb_table(fb, field, 6);
+        fb_patch(fb, fields + 4 + 4 * (size_t)c, t);
+        fb_patch(fb, field[0].at, fb_string(fb, cols[c].name));
+        fb_patch(fb, field[3].at, arrow_type(fb, cols[c].type));
+        fb_patch(fb, field[5].at, fb_vector(fb, 0, 4));
+    }
+    return at;
+}
+
+/* The buffers of column c: their pointers and lengths, and how many */
+static int arrow_buffers(const struct tech_column *col, size_t rows, const void **p, size_t *len) {
+    p[0] = col->validity;
+    len[0] = col->validity ? (rows + 7) / 8 : 0;
+    if (col->type != TECH_UTF8) {
+        p[1] = col->data;
+        len[1] = col->data_bytes;
+        return 2;
+    }
+    p[1] = col->offsets;
+    len[1] = (rows + 1) * sizeof(int32_t);
+    p[2] = col->data;
+    len[2] = col->data_bytes;
+    return 3;
+}
+
+static size_t arrow_padded(size_t n) {
+    return (n + ARROW_ALIGN - 1) & ~(size_t)(ARROW_ALIGN - 1);
+}
+
+/* The record batch message; its body's size into body */
+static void arrow_batch(struct fb *fb, const struct tech_column *cols, size_t rows, size_t *body) {
+    struct fb_field message[] = {{2, ARROW_V5, 0}, {1, ARROW_RECORD_BATCH, 0}, {FB_OFFSET, 0, 0}, {8, 0, 0}};
+    struct fb_field batch[] = {{8, rows, 0}, {FB_OFFSET, 0, 0}, {FB_OFFSET, 0, 0}};
+    size_t n_buffers = 0, nodes, buffers, message_at, batch_at, k = 0;
+    for (int c = 0; c < TECH_COLUMNS; c++) n_buffers += cols[c].type == TECH_UTF8 ? 3 : 2;
+    *body = 0;
+    for (int c = 0; c < TECH_COLUMNS; c++) {
+        const void *p[3];
+        size_t len[3];
+        const int n = arrow_buffers(&cols[c], rows, p, len);
+        for (int b = 0; b < n; b++) *body += arrow_padded(len[b]);
+    }
+    message[3].value = *body;
+    fb_scalar(fb, 0, 4);                /* Root */
+    message_at = fb_table(fb, message, 4);
+    fb_patch(fb, 0, message_at);
+    batch_at = fb_table(fb, batch, 3);
+    fb_patch(fb, message[2].at, batch_at);
+    nodes = fb_vector(fb, TECH_COLUMNS, 16);
+    fb_patch(fb, batch[1].at, nodes);
+    buffers = fb_vector(fb, n_buffers, 16);
+    fb_patch(fb, batch[2].at, buffers);
+    if (fb->failed) return;
+    *body = 0;
+    for (int c = 0; c < TECH_COLUMNS; c++) {
+        const void *p[3];
+        size_t len[3];
+        const int n = arrow_buffers(&cols[c], rows, p, len);
+        fb_le(fb->buf + nodes + 4 + 16 * (size_t)c, rows, 8);
+        fb_le(fb->buf + nodes + 12 + 16 * (size_t)c, cols[c].null_count, 8);
+        for (int b = 0; b < n; b++, k++) {
+            fb_le(fb->buf + buffers + 4 + 16 * k, *body, 8);
+            fb_le(fb->buf + buffers + 12 + 16 * k, len[b], 8);
+            *body += arrow_padded(len[b]);
+        }
+    }
+}
+
+/* ---------------- File ---------------- */
+
+static int arrow_write(FILE *f, const void *p, size_t n) {
+    static const unsigned char zeros[ARROW_ALIGN];
+    return fwrite(p ? p : zeros, 1, n, f) == n ? 0 : -1;
+}
+
+/* A message: its metadata fb, padded, then its body (if cols) */
+static int arrow_message(FILE *f, const struct fb *fb, const struct tech_column *cols, size_t rows, size_t *size) {
+    const size_t padded = arrow_padded(fb->n);
+    unsigned char prefix[8];
+    int rc;
+    fb_le(prefix, 0xffffffffu, 4);
+    fb_le(prefix + 4, padded, 4);
+    rc = arrow_write(f, prefix, 8) | arrow_write(f, fb->buf, fb->n) | arrow_write(f, NULL, padded - fb->n);
+    *size = 8 + padded;
+    for (int c = 0; cols && c < TECH_COLUMNS; c++) {
+        const void *p[3];
+        size_t len[3];
+        const int n = arrow_buffers(&cols[c], rows, p, len);
+        for (int b = 0; b < n; b++)
+            rc |= (len[b] ? arrow_write(f, p[b], len[b]) : 0) | arrow_write(f, NULL, arrow_padded(len[b]) - len[b]);
+    }
+    return rc;
+}
+
+int holos_tech_columns_write_arrow(const struct holos_tech_columns *columns, const char *path) {
+    struct fb schema = {0}, batch = {0}, footer = {0};
+    const struct tech_column *cols;
+    size_t rows, body, schema_size, batch_size, tmp_len, blocks;
+    char *tmp;
+    FILE *f = NULL;
+    int rc = -1;
+    if (!columns || !path) return -1;
+    cols = tech_columns_all(columns, &rows);
+    tmp_len = strlen(path) + 6;
+    if (!(tmp = malloc(tmp_len))) return -1;
+    snprintf(tmp, tmp_len, "%s.part", path);
+
+    {
+        struct fb_field message[] = {{2, ARROW_V5, 0}, {1, ARROW_SCHEMA, 0}, {FB_OFFSET, 0, 0}, {8, 0, 0}};
+        fb_scalar(&schema, 0, 4);
+        fb_patch(&schema, 0, fb_table(&schema, message, 4));
+        fb_patch(&schema, message[2].at, arrow_schema(&schema, cols));
+    }
+    arrow_batch(&batch, cols, rows, &body);
+    {
+        struct fb_field foot[] = {{2, ARROW_V5, 0}, {FB_OFFSET, 0, 0}, {FB_OFFSET, 0, 0}, {FB_OFFSET, 0, 0}};
+        fb_scalar(&footer, 0, 4);
+        fb_patch(&footer, 0, fb_table(&footer, foot, 4));
+        fb_patch(&footer, foot[1].at, arrow_schema(&footer, cols));
+        fb_patch(&footer, foot[2].at, fb_vector(&footer, 0, 24));
+        blocks = fb_vector(&footer, 1, 24);
+        fb_patch(&footer, foot[3].at, blocks);
+    }
+    if (schema.failed || batch.failed || footer.failed) {
+        fprintf(stderr, "[tech] %s: out of memory\n", path);
+        goto out;
+    }
+    if (!(f = fopen(tmp, "wb"))) {
+        fprintf(stderr, "[tech] %s: %s\n", tmp, strerror(errno));
+        goto out;
+    }
+    if (arrow_write(f, "ARROW1\0\0", 8) != 0 || arrow_message(f, &schema, NULL, 0, &schema_size) != 0 ||
+        arrow_message(f, &batch, cols, rows, &batch_size) != 0)
+        goto failed;
+    fb_le(footer.buf + blocks + 4, 8 + schema_size, 8);          /* Block: offset, metaDataLength, bodyLength */
+    fb_le(footer.buf + blocks + 12, batch_size, 4);
+    fb_le(footer.buf + blocks + 20, body, 8);
+    {
+        unsigned char tail[4];
+        fb_le(tail, footer.n, 4);
+        if (arrow_write(f, "\xff\xff\xff\xff\0\0\0\0", 8) != 0 || arrow_write(f, footer.buf, footer.n) != 0 ||
+            arrow_write(f, tail, 4) != 0 || arrow_write(f, "ARROW1", 6) != 0)
+            goto failed;
+    }
+    if (fclose(f) != 0) {
+        f = NULL;
+        goto failed;
+    }
+    f = NULL;
+    if (rename(tmp, path) != 0) goto failed;
+    rc = 0;
+    goto out;
+failed:
+    fprintf(stderr, "[tech] %s: %s\n", path, strerror(errno));
+    if (f) fclose(f);
+    remove(tmp);
+out:
+    free(schema.buf);
+    free(batch.buf);
+    free(footer.buf);
+    free(tmp);
+    return rc;
+}
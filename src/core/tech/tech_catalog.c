@@ -0,0 +1,362 @@
+/* tech_catalog.c - Arena-backed technology catalogs of HOLOS
+    Copyright (C) 2025  4137314 <holos@mail.com>
+
+    This file is part of HOLOS.
+
+    HOLOS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    HOLOS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+    ----------------------------------------------------------------------
+    A catalog (see tech.h) allocates everything of its technologies, the
+    records, their strings and their lists, from an arena: blocks taken
+    by bumping a pointer, from 64 KiB doubling to 8 MiB, and only freed
+    with the catalog, a handful of free() calls for any number of
+    technologies. A technology changed is copied anew: the old copy
+    stays until then.
+
+    Interned strings are in the arena too, each after its number (u32,
+    unaligned), and found by an open-addressing table of (hash, string)
+    kept at most 3/4 full; the numbers index an array of the strings.
+    A catalog is not locked: one thread at a time.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core/tech/tech.h"
+#include "tech_work.h"
+
+#define TECH_BLOCK_MIN (64u << 10)
+#define TECH_BLOCK_MAX (8u << 20)
+
+struct tech_block {
+    struct tech_block *next;
+    size_t size, used;
+    unsigned char data[];
+};
+
+struct tech_slot {
+    uint64_t hash;
+    const char *s;                      /* NULL: empty */
+};
+
+struct holos_tech_catalog {
+    struct tech_block *blocks;          /* Newest first */
+    size_t block_size, bytes;
+    struct tech_slot *table;
+    size_t table_cap;                   /* Power of two */
+    const char **strings;               /* By number; [0] unused */
+    uint32_t n_strings, cap_strings;
+    struct holos_technology **techs;
+    size_t n_techs, cap_techs;
+    struct holos_tech_index *indexes;   /* Told of every change */
+};
+
+/* ---------------- Arena ---------------- */
+
+static void *tech_alloc(struct holos_tech_catalog *cat, size_t size, size_t align) {
+    struct tech_block *b = cat->blocks;
+    size_t at = b ? (b->used + align - 1) & ~(align - 1) : 0;
+    if (!b || at + size > b->size) {
+        size_t want = cat->block_size;
+        if (want < TECH_BLOCK_MAX && cat->blocks) want *= 2;
+        cat->block_size = want;
+        if (size + align > want) want = size + align;   /* A block of its own */
+        if (!(b = malloc(sizeof(*b) + want))) return NULL;
+        b->size = want;
+        b->used = 0;
+        b->next = cat->blocks;
+        cat->blocks = b;
+        cat->bytes += sizeof(*b) + want;
+        at = 0;
+    }
+    b->used = at + size;
+    return b->data + at;
+}
+
+static char *tech_copy(struct holos_tech_catalog *cat, const char *s) {
+    size_t n;
+    char *copy;
+    if (!s) return NULL;
+    n = strlen(s) + 1;
+    if ((copy = tech_alloc(cat, n, 1))) memcpy(copy, s, n);
+    return copy;
+}
+
+/* ---------------- Interned strings ---------------- */
+
+static uint64_t tech_hash(const char *s) {
+    uint64_t h = 0xcbf29ce484222325u;
+    for (; *s; s++) h = (h ^ (unsigned char)*s) * 0x100000001b3u;
+    return h;
+}
+
+uint32_t tech_interned_id(const char *interned) {
+    uint32_t id;
+    memcpy(&id, interned - sizeof(id), sizeof(id));
+    return id;
+}
+
+static struct tech_slot *tech_slot_find(const struct holos_tech_catalog *cat, const char *s, uint64_t hash) {
+    size_t i;
+    if (!cat->table_cap) return NULL;
+    for (i = hash & (cat->table_cap - 1);; i = (i + 1) & (cat->table_cap - 1)) {
+        struct tech_slot *slot = &cat->table[i];
+        if (!slot->s || (slot->hash == hash && strcmp(slot->s, s) == 0)) return slot;
+    }
+}
+
+static int tech_table_grow(struct holos_tech_catalog *cat) {
+    const size_t cap = cat->table_cap ? 2 * cat->table_cap : 1024;
+    struct tech_slot *old = cat->table, *table = calloc(cap, sizeof(*table));
+    const size_t old_cap = cat->table_cap;
+    if (!table) return -1;
+    cat->table = table;
+    cat->table_cap = cap;
+    for (size_t i = 0; i < old_cap; i++)
+        if (old[i].s) *tech_slot_find(cat, old[i].s, old[i].hash) = old[i];
+    free(old);
+    cat->bytes += (cap - old_cap) * sizeof(*table);
+    return 0;
+}
+
+/* The interned copy of s, NULL for NULL or out of memory */
+static const char *tech_intern_str(struct holos_tech_catalog *cat, const char *s) {
+    struct tech_slot *slot;
+    uint64_t hash;
+    unsigned char *at;
+    size_t n;
+    if (!s) return NULL;
+    hash = tech_hash(s);
+    if ((slot = tech_slot_find(cat, s, hash)) && slot->s) return slot->s;
+    if (((size_t)cat->n_strings + 1) * 4 >= cat->table_cap * 3) {
+        if (tech_table_grow(cat) != 0) return NULL;
+        slot = tech_slot_find(cat, s, hash);
+    }
+    if (cat->n_strings + 1 >= cat->cap_strings) {
+        const uint32_t cap = cat->cap_strings ? 2 * cat->cap_strings : 1024;
+        const char **grown = realloc(cat->strings, cap * sizeof(*grown));
+        if (!grown) return NULL;
+        cat->strings = grown;
+        cat->bytes += (cap - cat->cap_strings) * sizeof(*grown);
+        cat->cap_strings = cap;
+    }
+    n = strlen(s) + 1;
+    if (!(at = tech_alloc(cat, sizeof(uint32_t) + n, 1))) return NULL;
+    cat->n_strings++;
+    memcpy(at, &cat->n_strings, sizeof(uint32_t));
+    memcpy(at + sizeof(uint32_t), s, n);
+    slot->hash = hash;
+    slot->s = (const char *)at + sizeof(uint32_t);
+    cat->strings[cat->n_strings] = slot->s;
+    return slot->s;
+}
+
+uint32_t holos_tech_intern(struct holos_tech_catalog *catalog, const char *s) {
+    const char *interned = catalog ? tech_intern_str(catalog, s) : NULL;
+    return interned ? tech_interned_id(interned) : 0;
+}
+
+uint32_t holos_tech_string_id(const struct holos_tech_catalog *catalog, const char *s) {
+    const struct tech_slot *slot;
+    if (!catalog || !s || !(slot = tech_slot_find(catalog, s, tech_hash(s))) || !slot->s) return 0;
+    return tech_interned_id(slot->s);
+}
+
+const char *holos_tech_string(const struct holos_tech_catalog *catalog, uint32_t id) {
+    return catalog && id && id <= catalog->n_strings ? catalog->strings[id] : NULL;
+}
+
+uint32_t holos_tech_string_count(const struct holos_tech_catalog *catalog) {
+    return catalog ? catalog->n_strings : 0;
+}
+
+/* ---------------- Catalog ---------------- */
+
+struct holos_tech_catalog *holos_tech_catalog_new(void) {
+    struct holos_tech_catalog *cat = calloc(1, sizeof(*cat));
+    if (cat) {
+        cat->block_size = TECH_BLOCK_MIN;
+        cat->bytes = sizeof(*cat);
+    }
+    return cat;
+}
+
+struct holos_tech_index **tech_catalog_indexes(struct holos_tech_catalog *catalog) {
+    return &catalog->indexes;
+}
+
+void holos_tech_catalog_free(struct holos_tech_catalog *catalog) {
+    if (!catalog) return;
+    while (catalog->indexes) {
+        struct holos_tech_index *index = catalog->indexes;
+        catalog->indexes = tech_index_next(index);
+        tech_index_detach(index);
+    }
+    while (catalog->blocks) {
+        struct tech_block *b = catalog->blocks;
+        catalog->blocks = b->next;
+        free(b);
+    }
+    free(catalog->table);
+    free(catalog->strings);
+    free(catalog->techs);
+    free(catalog);
+}
+
+size_t holos_tech_catalog_count(const struct holos_tech_catalog *catalog) {
+    return catalog ? catalog->n_techs : 0;
+}
+
+struct holos_technology *holos_tech_catalog_get(const struct holos_tech_catalog *catalog, size_t i) {
+    return catalog && i < catalog->n_techs ? catalog->techs[i] : NULL;
+}
+
+size_t holos_tech_catalog_memory(const struct holos_tech_catalog *catalog) {
+    return catalog ? catalog->bytes : 0;
+}
+
+/* A copy of a list in the arena, each string interned or copied; 0 or -1 */
+static int tech_list(struct holos_tech_catalog *cat, char ***list, int n, int intern) {
+    char **copy;
+    if (!*list || n <= 0) {
+        *list = NULL;
+        return 0;
+    }
+    if (!(copy = tech_alloc(cat, (size_t)n * sizeof(*copy), sizeof(void *)))) return -1;
+    for (int i = 0; i < n; i++) {
+        const char *s = (*list)[i];
+        copy[i] = intern ? (char *)tech_intern_str(cat, s) : tech_copy(cat, s);
+        if (s && !copy[i]) return -1;
+    }
+    *list = copy;
+    return 0;
+}
+
+/* The interned fields, and the copied ones */
+#define TECH_INTERNED(X) X(category) X(physics_model) X(creator) X(lifecycle_stage) X(version) X(localization)
+#define TECH_COPIED(X)                                                                                              \
+    X(id) X(name) X(description) X(digital_twin) X(digital_certification) X(ai_explainability) X(interoperability) \
+        X(provenance) X(cybersecurity) X(ethics) X(accessibility)
+
+/* A copy of tech in the arena */
+static struct holos_technology *tech_record(struct holos_tech_catalog *catalog, const struct holos_technology *tech) {
+    struct holos_technology *t;
+    char id[TECH_ID_LEN + 1];
+    int failed = 0;
+    if (!(t = tech_alloc(catalog, sizeof(*t), sizeof(double)))) return NULL;
+    *t = *tech;
+    if (!t->id) {
+        tech_make_id(id);
+        t->id = id;
+    }
+#define TECH_INTERN(f) if (t->f && !(t->f = (char *)tech_intern_str(catalog, t->f))) failed = 1;
+#define TECH_COPY(f) if (t->f && !(t->f = tech_copy(catalog, t->f))) failed = 1;
+    TECH_INTERNED(TECH_INTERN)
+    TECH_COPIED(TECH_COPY)
+#undef TECH_INTERN
+#undef TECH_COPY
+    if (failed || tech_list(catalog, &t->patents, t->n_patents, 0) != 0 ||
+        tech_list(catalog, &t->tags, t->n_tags, 1) != 0 ||
+        tech_list(catalog, &t->regulatory_certifications, t->n_certifications, 1) != 0 ||
+        tech_list(catalog, &t->supply_chain_sources, t->n_supply_sources, 1) != 0)
+        return NULL;                    /* What it took stays in the arena */
+    return t;
+}
+
+static void tech_changed(struct holos_tech_catalog *catalog, size_t i, const struct holos_technology *old) {
+    for (struct holos_tech_index *index = catalog->indexes; index; index = tech_index_next(index))
+        tech_index_changed(index, i, old, catalog->techs[i]);
+}
+
+struct holos_technology *holos_tech_catalog_add(struct holos_tech_catalog *catalog, const struct holos_technology *tech) {
+    struct holos_technology *t;
+    if (!catalog || !tech) return NULL;
+    if (catalog->n_techs == catalog->cap_techs) {
+        const size_t cap = catalog->cap_techs ? 2 * catalog->cap_techs : 1024;
+        struct holos_technology **grown = realloc(catalog->techs, cap * sizeof(*grown));
+        if (!grown) return NULL;
+        catalog->techs = grown;
+        catalog->bytes += (cap - catalog->cap_techs) * sizeof(*grown);
+        catalog->cap_techs = cap;
+    }
+    if (!(t = tech_record(catalog, tech))) return NULL;
+    catalog->techs[catalog->n_techs] = t;
+    tech_changed(catalog, catalog->n_techs++, NULL);
+    return t;
+}
+
+struct holos_technology *holos_tech_catalog_set(struct holos_tech_catalog *catalog, size_t i,
+                                                const struct holos_technology *tech) {
+    struct holos_technology *t, *old;
+    if (!catalog || !tech || i >= catalog->n_techs || !(t = tech_record(catalog, tech))) return NULL;
+    old = catalog->techs[i];
+    catalog->techs[i] = t;
+    tech_changed(catalog, i, old);
+    return t;
+}
+
+struct holos_technology *holos_tech_catalog_create(struct holos_tech_catalog *catalog, const char *name,
+                                                   const char *description, const char *category,
+                                                   const char *physics_model, const char *creator,
+                                                   const char *lifecycle_stage) {
+    struct holos_technology tech;
+    if (!name) return NULL;
+    memset(&tech, 0, sizeof(tech));
+    tech.name = (char *)name;
+    tech.description = (char *)description;
+    tech.category = (char *)category;
+    tech.physics_model = (char *)physics_model;
+    tech.creator = (char *)creator;
+    tech.lifecycle_stage = (char *)lifecycle_stage;
+    return holos_tech_catalog_add(catalog, &tech);
+}
+
+/* ---------------- Batches ---------------- */
+
+/* A batch is a catalog, found again from the array it returns */
+struct tech_batch {
+    struct holos_tech_catalog *catalog;
+    struct holos_technology *techs[];
+};
+
+struct holos_technology **holos_tech_batch_create(const char **names, const char **descriptions,
+                                                  const char **categories, const char **physics_models,
+                                                  const char **creators, int n) {
+    struct holos_tech_catalog *cat;
+    struct tech_batch *batch;
+    if (!names || n <= 0 || !(cat = holos_tech_catalog_new())) return NULL;
+    if (!(batch = tech_alloc(cat, sizeof(*batch) + (size_t)n * sizeof(batch->techs[0]), sizeof(void *)))) {
+        holos_tech_catalog_free(cat);
+        return NULL;
+    }
+    batch->catalog = cat;
+    for (int i = 0; i < n; i++)
+        if (!(batch->techs[i] = holos_tech_catalog_create(cat, names[i], descriptions ? descriptions[i] : NULL,
+                                                       categories ? categories[i] : NULL,
+                                                       physics_models ? physics_models[i] : NULL,
+                                                       creators ? creators[i] : NULL, NULL))) {
+            holos_tech_catalog_free(cat);
+            return NULL;
+        }
+    return batch->techs;
+}
+
+void holos_tech_batch_free(struct holos_technology **techs, int n) {
+    (void)n;
+    if (techs)
+        holos_tech_catalog_free(((struct tech_batch *)((char *)techs - offsetof(struct tech_batch, techs)))->catalog);
+}
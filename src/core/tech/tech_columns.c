@@ -0,0 +1,428 @@
+/* tech_columns.c - Columnar snapshots of technology catalogs of HOLOS
+    Copyright (C) 2025  4137314 <holos@mail.com>
+
+    This file is part of HOLOS.
+
+    HOLOS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    HOLOS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+    ----------------------------------------------------------------------
+    A snapshot holds each column in the layout of Arrow: 64-byte aligned
+    buffers, a validity bitmap (least significant bit first, only where
+    a string may be NULL), int32 offsets and the bytes for strings, the
+    values for numbers. The same buffers are handed out by pointer,
+    through the C data interface of Arrow, and written into IPC files
+    (tech_arrow.c): no copy is made of them.
+
+    Category and lifecycle stage are also kept as codes, dictionary
+    positions numbered from 1 (0 for NULL). Grouping adds up into an
+    array indexed by code, and filtering writes every row and steps
+    past it if it fails, so that neither loop branches on the data.
+
+    Snapshots are counted references: one for the caller and one for
+    each export not yet released, which a consumer may release from any
+    thread.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <math.h>
+
+#include "core/tech/tech.h"
+#include "tech_work.h"
+
+#define TECH_ALIGN 64
+
+struct holos_tech_columns {
+    atomic_int refs;
+    size_t rows;
+    struct tech_column columns[TECH_COLUMNS];
+    uint32_t *codes[2];                 /* Category, lifecycle stage */
+    char **dict[2];                     /* [1..n_dict] */
+    uint32_t n_dict[2];
+};
+
+/* In the order of enum holos_tech_measure */
+static const char *const g_measures[HOLOS_TECH_MEASURES] = {
+    "efficiency", "cost", "impact", "sustainability", "risk_score", "ai_bias_score", "carbon_footprint",
+    "water_usage", "cyber_risk_score", "ethics_score", "circularity_index", "accessibility_score"};
+
+static double tech_measure(const struct holos_technology *t, enum holos_tech_measure m) {
+    switch (m) {
+    case HOLOS_TECH_EFFICIENCY: return t->efficiency;
+    case HOLOS_TECH_COST: return t->cost;
+    case HOLOS_TECH_IMPACT: return t->impact;
+    case HOLOS_TECH_SUSTAINABILITY: return t->sustainability;
+    case HOLOS_TECH_RISK: return t->risk_score;
+    case HOLOS_TECH_AI_BIAS: return t->ai_bias_score;
+    case HOLOS_TECH_CARBON: return t->carbon_footprint;
+    case HOLOS_TECH_WATER: return t->water_usage;
+    case HOLOS_TECH_CYBER_RISK: return t->cyber_risk_score;
+    case HOLOS_TECH_ETHICS: return t->ethics_score;
+    case HOLOS_TECH_CIRCULARITY: return t->circularity_index;
+    default: return t->accessibility_score;
+    }
+}
+
+/* ---------------- Snapshot ---------------- */
+
+static void *tech_buffer(size_t bytes) {
+    void *p = NULL;
+    bytes = (bytes + TECH_ALIGN - 1) & ~(size_t)(TECH_ALIGN - 1);
+    if (posix_memalign(&p, TECH_ALIGN, bytes ? bytes : TECH_ALIGN) != 0) return NULL;
+    memset(p, 0, bytes ? bytes : TECH_ALIGN);
+    return p;
+}
+
+/* A string column of field f of each technology */
+static int tech_strings(struct tech_column *col, const struct holos_tech_catalog *catalog, size_t rows,
+                        size_t field) {
+    int32_t *offsets;
+    size_t total = 0;
+    unsigned char *validity;
+    for (size_t i = 0; i < rows; i++) {
+        const char *s = *(char *const *)((const char *)holos_tech_catalog_get(catalog, i) + field);
+        total += s ? strlen(s) : 0;
+    }
+    if (total > INT32_MAX) {
+        fprintf(stderr, "[tech] columns: %s over 2 GiB\n", col->name);
+        return -1;
+    }
+    col->type = TECH_UTF8;
+    if (!(col->offsets = offsets = tech_buffer((rows + 1) * sizeof(int32_t))) ||
+        !(col->validity = validity = tech_buffer((rows + 7) / 8)) || !(col->data = tech_buffer(total)))
+        return -1;
+    col->data_bytes = total;
+    total = 0;
+    for (size_t i = 0; i < rows; i++) {
+        const char *s = *(char *const *)((const char *)holos_tech_catalog_get(catalog, i) + field);
+        const size_t n = s ? strlen(s) : 0;
+        offsets[i] = (int32_t)total;
+        if (s) validity[i / 8] |= (unsigned char)(1u << (i % 8));
+        else col->null_count++;
+        memcpy((char *)col->data + total, s ? s : "", n);
+        total += n;
+    }
+    offsets[rows] = (int32_t)total;
+    if (!col->null_count) {             /* Arrow lets it go */
+        free(col->validity);
+        col->validity = NULL;
+    }
+    return 0;
+}
+
+/* Codes of field f in cols->codes[k], its strings in cols->dict[k] */
+static int tech_codes(struct holos_tech_columns *cols, const struct holos_tech_catalog *catalog, int k, size_t field) {
+    const uint32_t n_strings = holos_tech_string_count(catalog);
+    uint32_t *code_of = calloc((size_t)n_strings + 1, sizeof(*code_of));
+    int rc = -1;
+    if (!code_of || !(cols->codes[k] = tech_buffer(cols->rows * sizeof(uint32_t)))) goto out;
+    for (size_t i = 0; i < cols->rows; i++) {
+        const char *s = *(char *const *)((const char *)holos_tech_catalog_get(catalog, i) + field);
+        uint32_t id;
+        if (!s) continue;
+        if (!code_of[id = tech_interned_id(s)]) {
+            char **grown = realloc(cols->dict[k], ((size_t)cols->n_dict[k] + 2) * sizeof(*grown));
+            if (!grown) goto out;
+            cols->dict[k] = grown;
+            if (!(grown[cols->n_dict[k] + 1] = strdup(s))) goto out;
+            code_of[id] = ++cols->n_dict[k];
+        }
+        cols->codes[k][i] = code_of[id];
+    }
+    rc = 0;
+out:
+    free(code_of);
+    return rc;
+}
+
+struct holos_tech_columns *holos_tech_columns_new(const struct holos_tech_catalog *catalog) {
+    static const struct {
+        const char *name;
+        size_t field;
+    } strings[] = {
+        {"id", offsetof(struct holos_technology, id)},
+        {"name", offsetof(struct holos_technology, name)},
+        {"category", offsetof(struct holos_technology, category)},
+        {"creator", offsetof(struct holos_technology, creator)},
+        {"lifecycle_stage", offsetof(struct holos_technology, lifecycle_stage)},
+    };
+    struct holos_tech_columns *cols;
+    struct tech_column *col;
+    size_t c = 0;
+    if (!catalog || !(cols = calloc(1, sizeof(*cols)))) return NULL;
+    atomic_init(&cols->refs, 1);
+    cols->rows = holos_tech_catalog_count(catalog);
+    for (; c < sizeof(strings) / sizeof(strings[0]); c++) {
+        cols->columns[c].name = strings[c].name;
+        if (tech_strings(&cols->columns[c], catalog, cols->rows, strings[c].field) != 0) goto fail;
+    }
+    col = &cols->columns[c++];
+    col->name = "trl";
+    col->type = TECH_INT32;
+    if (!(col->data = tech_buffer(cols->rows * sizeof(int32_t)))) goto fail;
+    col->data_bytes = cols->rows * sizeof(int32_t);
+    for (size_t i = 0; i < cols->rows; i++) ((int32_t *)col->data)[i] = holos_tech_catalog_get(catalog, i)->trl;
+    for (int m = 0; m < HOLOS_TECH_MEASURES; m++) {
+        double *v;
+        col = &cols->columns[c++];
+        col->name = g_measures[m];
+        col->type = TECH_FLOAT64;
+        if (!(col->data = v = tech_buffer(cols->rows * sizeof(double)))) goto fail;
+        col->data_bytes = cols->rows * sizeof(double);
+        for (size_t i = 0; i < cols->rows; i++) v[i] = tech_measure(holos_tech_catalog_get(catalog, i), m);
+    }
+    if (tech_codes(cols, catalog, 0, offsetof(struct holos_technology, category)) != 0 ||
+        tech_codes(cols, catalog, 1, offsetof(struct holos_technology, lifecycle_stage)) != 0)
+        goto fail;
+    return cols;
+fail:
+    fprintf(stderr, "[tech] columns: out of memory\n");
+    holos_tech_columns_free(cols);
+    return NULL;
+}
+
+void holos_tech_columns_free(struct holos_tech_columns *columns) {
+    if (!columns || atomic_fetch_sub(&columns->refs, 1) != 1) return;
+    for (int c = 0; c < TECH_COLUMNS; c++) {
+        free(columns->columns[c].validity);
+        free(columns->columns[c].offsets);
+        free(columns->columns[c].data);
+    }
+    for (int k = 0; k < 2; k++) {
+        for (uint32_t d = 1; columns->dict[k] && d <= columns->n_dict[k]; d++) free(columns->dict[k][d]);
+        free(columns->dict[k]);
+        free(columns->codes[k]);
+    }
+    free(columns);
+}
+
+size_t holos_tech_columns_rows(const struct holos_tech_columns *columns) {
+    return columns ? columns->rows : 0;
+}
+
+const double *holos_tech_columns_measure(const struct holos_tech_columns *columns, enum holos_tech_measure m) {
+    if (!columns || m < 0 || m >= HOLOS_TECH_MEASURES) return NULL;
+    return columns->columns[TECH_COLUMNS - HOLOS_TECH_MEASURES + m].data;
+}
+
+const struct tech_column *tech_columns_all(const struct holos_tech_columns *columns, size_t *rows) {
+    *rows = columns->rows;
+    return columns->columns;
+}
+
+/* ---------------- Filter, aggregate, group ---------------- */
+
+size_t holos_tech_columns_filter(const struct holos_tech_columns *columns, enum holos_tech_measure m, double lo,
+                                 double hi, const uint32_t *rows, size_t n, uint32_t *out) {
+    const double *v = holos_tech_columns_measure(columns, m);
+    size_t k = 0;
+    if (!v || !out) return 0;
+    if (!rows) {
+        n = columns->rows;
+        for (size_t i = 0; i < n; i++) {
+            out[k] = (uint32_t)i;
+            k += (v[i] >= lo) & (v[i] <= hi);
+        }
+    } else {
+        for (size_t i = 0; i < n; i++) {
+            const uint32_t r = rows[i];
+            out[k] = r;
+            k += (v[r] >= lo) & (v[r] <= hi);
+        }
+    }
+    return k;
+}
+
+static void tech_aggregate_init(struct holos_tech_aggregate *a) {
+    memset(a, 0, sizeof(*a));
+    a->min = INFINITY;
+    a->max = -INFINITY;
+}
+
+static void tech_aggregate_done(struct holos_tech_aggregate *a) {
+    if (a->count) {
+        a->mean = a->sum / (double)a->count;
+    } else {
+        a->min = a->max = a->mean = NAN;
+    }
+}
+
+int holos_tech_columns_aggregate(const struct holos_tech_columns *columns, enum holos_tech_measure m,
+                                 const uint32_t *rows, size_t n, struct holos_tech_aggregate *out) {
+    const double *v = holos_tech_columns_measure(columns, m);
+    double sum = 0, lo = INFINITY, hi = -INFINITY;
+    if (!v || !out) return -1;
+    tech_aggregate_init(out);
+    if (!rows) n = columns->rows;
+    for (size_t i = 0; i < n; i++) {
+        const double x = v[rows ? rows[i] : i];
+        sum += x;
+        lo = x < lo ? x : lo;
+        hi = x > hi ? x : hi;
+    }
+    out->count = n;
+    out->sum = sum;
+    out->min = lo;
+    out->max = hi;
+    tech_aggregate_done(out);
+    return 0;
+}
+
+long holos_tech_columns_group(const struct holos_tech_columns *columns, enum holos_tech_key by,
+                              enum holos_tech_measure m, const uint32_t *rows, size_t n,
+                              struct holos_tech_aggregate *out, size_t max) {
+    const double *v = holos_tech_columns_measure(columns, m);
+    const int k = by == HOLOS_TECH_CATEGORY ? 0 : by == HOLOS_TECH_LIFECYCLE ? 1 : -1;
+    struct holos_tech_aggregate *acc;
+    const uint32_t *codes;
+    long groups = 0;
+    if (!v || k < 0) return -1;
+    codes = columns->codes[k];
+    if (!(acc = malloc(((size_t)columns->n_dict[k] + 1) * sizeof(*acc)))) return -1;
+    for (uint32_t d = 0; d <= columns->n_dict[k]; d++) tech_aggregate_init(&acc[d]);
+    if (!rows) n = columns->rows;
+    for (size_t i = 0; i < n; i++) {
+        const size_t r = rows ? rows[i] : i;
+        struct holos_tech_aggregate *a = &acc[codes[r]];
+        const double x = v[r];
+        a->count++;
+        a->sum += x;
+        a->min = x < a->min ? x : a->min;
+        a->max = x > a->max ? x : a->max;
+    }
+    for (uint32_t g = 1; g <= columns->n_dict[k] + 1; g++) {   /* NULL last */
+        const uint32_t d = g % (columns->n_dict[k] + 1);
+        if (!acc[d].count) continue;
+        tech_aggregate_done(&acc[d]);
+        acc[d].value = d ? columns->dict[k][d] : NULL;
+        if (out && (size_t)groups < max) out[groups] = acc[d];
+        groups++;
+    }
+    free(acc);
+    return groups;
+}
+
+/* ---------------- C data interface ---------------- */
+
+static const char *tech_format(int type) {
+    return type == TECH_UTF8 ? "u" : type == TECH_INT32 ? "i" : "g";
+}
+
+struct tech_schema {
+    struct ArrowSchema *children[TECH_COLUMNS];
+    struct ArrowSchema child[TECH_COLUMNS];
+};
+
+/* A column array holds a reference of its own, so that a consumer may
+   move it out of its parent */
+struct tech_child {
+    struct holos_tech_columns *columns;
+    const void *buffers[3];
+};
+
+struct tech_array {
+    struct holos_tech_columns *columns;
+    struct ArrowArray *children[TECH_COLUMNS];
+    struct ArrowArray child[TECH_COLUMNS];
+    const void *validity[1];
+};
+
+/* Schema children have nothing of their own to free */
+static void tech_release_child_schema(struct ArrowSchema *schema) {
+    schema->release = NULL;
+}
+
+static void tech_release_schema(struct ArrowSchema *schema) {
+    free(schema->private_data);
+    schema->release = NULL;
+}
+
+static void tech_release_child_array(struct ArrowArray *array) {
+    struct tech_child *priv = array->private_data;
+    holos_tech_columns_free(priv->columns);
+    free(priv);
+    array->release = NULL;
+}
+
+static void tech_release_array(struct ArrowArray *array) {
+    struct tech_array *priv = array->private_data;
+    for (int c = 0; c < TECH_COLUMNS; c++)
+        if (priv->child[c].release) priv->child[c].release(&priv->child[c]);
+    holos_tech_columns_free(priv->columns);
+    free(priv);
+    array->release = NULL;
+}
+
+int holos_tech_columns_export(struct holos_tech_columns *columns, struct ArrowSchema *schema,
+                              struct ArrowArray *array) {
+    struct tech_schema *s;
+    struct tech_array *a;
+    if (!columns || !schema || !array) return -1;
+    s = calloc(1, sizeof(*s));
+    a = calloc(1, sizeof(*a));
+    if (!s || !a) {
+        free(s);
+        free(a);
+        return -1;
+    }
+    for (int c = 0; c < TECH_COLUMNS; c++) {
+        const struct tech_column *col = &columns->columns[c];
+        struct ArrowSchema *cs = &s->child[c];
+        struct ArrowArray *ca = &a->child[c];
+        struct tech_child *priv = malloc(sizeof(*priv));
+        if (!priv) {
+            for (int d = 0; d < c; d++) a->child[d].release(&a->child[d]);
+            free(s);
+            free(a);
+            return -1;
+        }
+        cs->format = tech_format(col->type);
+        cs->name = col->name;
+        cs->flags = col->type == TECH_UTF8 ? ARROW_FLAG_NULLABLE : 0;
+        cs->release = tech_release_child_schema;
+        s->children[c] = cs;
+        atomic_fetch_add(&columns->refs, 1);
+        priv->columns = columns;
+        priv->buffers[0] = col->validity;
+        priv->buffers[1] = col->type == TECH_UTF8 ? col->offsets : col->data;
+        priv->buffers[2] = col->data;
+        ca->length = (int64_t)columns->rows;
+        ca->null_count = (int64_t)col->null_count;
+        ca->n_buffers = col->type == TECH_UTF8 ? 3 : 2;
+        ca->buffers = priv->buffers;
+        ca->release = tech_release_child_array;
+        ca->private_data = priv;
+        a->children[c] = ca;
+    }
+    memset(schema, 0, sizeof(*schema));
+    schema->format = "+s";
+    schema->n_children = TECH_COLUMNS;
+    schema->children = s->children;
+    schema->release = tech_release_schema;
+    schema->private_data = s;
+    atomic_fetch_add(&columns->refs, 1);
+    a->columns = columns;
+    memset(array, 0, sizeof(*array));
+    array->length = (int64_t)columns->rows;
+    array->n_buffers = 1;
+    array->buffers = a->validity;
+    array->n_children = TECH_COLUMNS;
+    array->children = a->children;
+    array->release = tech_release_array;
+    array->private_data = a;
+    return 0;
+}
@@ -0,0 +1,275 @@
+/* tech_index.c - Inverted indexes over technology catalogs of HOLOS
+    Copyright (C) 2025  4137314 <holos@mail.com>
+
+    This file is part of HOLOS.
+
+    HOLOS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    HOLOS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+    ----------------------------------------------------------------------
+    The keys of an index are (what, number of the interned string): the
+    values of a catalog's technologies are interned, so a key is taken
+    from the pointer and a lookup compares no strings. Each key has a
+    posting list, the positions in the catalog of the technologies with
+    it, sorted: an added technology goes at the end, a changed one is
+    taken out of the lists of its old values by binary search and put
+    into those of the new.
+
+    A query of all its terms walks the shortest list, finding each
+    position in the others by galloping from where the last was found;
+    a query of any merges the lists. Like its catalog, an index is not
+    locked.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "core/tech/tech.h"
+#include "tech_work.h"
+
+struct tech_posting {
+    uint64_t key;                       /* 0: empty */
+    uint32_t *at;                       /* Catalog positions, ascending */
+    uint32_t n, cap;
+};
+
+struct holos_tech_index {
+    struct holos_tech_catalog *catalog; /* NULL once freed */
+    struct holos_tech_index *next;      /* Of the catalog's */
+    struct tech_posting *table;
+    size_t cap, used;                   /* cap a power of two */
+};
+
+static uint64_t tech_key(enum holos_tech_key what, uint32_t id) {
+    return (uint64_t)(what + 1) << 32 | id;
+}
+
+/* ---------------- Postings ---------------- */
+
+static struct tech_posting *tech_posting_find(const struct holos_tech_index *index, uint64_t key) {
+    size_t i;
+    if (!index->cap) return NULL;
+    for (i = (key * 0x9e3779b97f4a7c15u) >> 20 & (index->cap - 1);; i = (i + 1) & (index->cap - 1))
+        if (index->table[i].key == key || !index->table[i].key) return &index->table[i];
+}
+
+static int tech_table_grow(struct holos_tech_index *index) {
+    const size_t cap = index->cap ? 2 * index->cap : 256, old_cap = index->cap;
+    struct tech_posting *old = index->table, *table = calloc(cap, sizeof(*table));
+    if (!table) return -1;
+    index->table = table;
+    index->cap = cap;
+    for (size_t i = 0; i < old_cap; i++)
+        if (old[i].key) *tech_posting_find(index, old[i].key) = old[i];
+    free(old);
+    return 0;
+}
+
+/* Position of the first at or past pos in p, from the lower bound lo */
+static uint32_t tech_lower(const struct tech_posting *p, uint32_t lo, uint32_t pos) {
+    uint32_t hi = p->n;
+    while (lo < hi) {
+        const uint32_t mid = lo + (hi - lo) / 2;
+        if (p->at[mid] < pos) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static int tech_post(struct holos_tech_index *index, uint64_t key, uint32_t pos) {
+    struct tech_posting *p;
+    uint32_t i;
+    if ((index->used + 1) * 4 > index->cap * 3 && tech_table_grow(index) != 0) return -1;
+    if (!(p = tech_posting_find(index, key))->key) {
+        p->key = key;
+        index->used++;
+    }
+    i = p->n && p->at[p->n - 1] < pos ? p->n : tech_lower(p, 0, pos);
+    if (i < p->n && p->at[i] == pos) return 0;      /* Twice in a list */
+    if (p->n == p->cap) {
+        const uint32_t cap = p->cap ? 2 * p->cap : 4;
+        uint32_t *grown = realloc(p->at, cap * sizeof(*grown));
+        if (!grown) return -1;
+        p->at = grown;
+        p->cap = cap;
+    }
+    memmove(p->at + i + 1, p->at + i, (p->n - i) * sizeof(*p->at));
+    p->at[i] = pos;
+    p->n++;
+    return 0;
+}
+
+/* An emptied list is kept, its key holding its slot */
+static void tech_unpost(struct holos_tech_index *index, uint64_t key, uint32_t pos) {
+    struct tech_posting *p = tech_posting_find(index, key);
+    uint32_t i;
+    if (!p || !p->key || (i = tech_lower(p, 0, pos)) == p->n || p->at[i] != pos) return;
+    memmove(p->at + i, p->at + i + 1, (p->n - i - 1) * sizeof(*p->at));
+    p->n--;
+}
+
+/* Posts (or unposts) tech at pos under each of its values */
+static int tech_index_tech(struct holos_tech_index *index, size_t pos, const struct holos_technology *tech,
+                           int post) {
+    int failed = 0;
+#define TECH_EACH(what, s)                                                                   \
+    if (s) {                                                                                 \
+        const uint64_t key = tech_key(what, tech_interned_id(s));                            \
+        if (post) failed |= tech_post(index, key, (uint32_t)pos);                            \
+        else tech_unpost(index, key, (uint32_t)pos);                                         \
+    }
+    TECH_EACH(HOLOS_TECH_CATEGORY, tech->category)
+    TECH_EACH(HOLOS_TECH_LIFECYCLE, tech->lifecycle_stage)
+    for (int i = 0; tech->tags && i < tech->n_tags; i++) TECH_EACH(HOLOS_TECH_TAG, tech->tags[i])
+    for (int i = 0; tech->regulatory_certifications && i < tech->n_certifications; i++)
+        TECH_EACH(HOLOS_TECH_CERTIFICATION, tech->regulatory_certifications[i])
+#undef TECH_EACH
+    return failed;
+}
+
+void tech_index_changed(struct holos_tech_index *index, size_t i, const struct holos_technology *old,
+                        const struct holos_technology *tech) {
+    if (old) tech_index_tech(index, i, old, 0);
+    if (tech_index_tech(index, i, tech, 1) != 0)
+        fprintf(stderr, "[tech] index: out of memory, technology %zu missing\n", i);
+}
+
+void tech_index_detach(struct holos_tech_index *index) {
+    index->catalog = NULL;
+    index->next = NULL;
+}
+
+struct holos_tech_index *tech_index_next(const struct holos_tech_index *index) {
+    return index->next;
+}
+
+/* ---------------- Index ---------------- */
+
+struct holos_tech_index *holos_tech_index_new(struct holos_tech_catalog *catalog) {
+    struct holos_tech_index *index, **head;
+    const size_t n = holos_tech_catalog_count(catalog);
+    if (!catalog || n > UINT32_MAX || !(index = calloc(1, sizeof(*index)))) return NULL;
+    index->catalog = catalog;
+    for (size_t i = 0; i < n; i++)
+        if (tech_index_tech(index, i, holos_tech_catalog_get(catalog, i), 1) != 0) {
+            holos_tech_index_free(index);
+            return NULL;
+        }
+    head = tech_catalog_indexes(catalog);
+    index->next = *head;
+    *head = index;
+    return index;
+}
+
+void holos_tech_index_free(struct holos_tech_index *index) {
+    if (!index) return;
+    if (index->catalog)
+        for (struct holos_tech_index **at = tech_catalog_indexes(index->catalog); *at; at = &(*at)->next)
+            if (*at == index) {
+                *at = index->next;
+                break;
+            }
+    for (size_t i = 0; i < index->cap; i++) free(index->table[i].at);
+    free(index->table);
+    free(index);
+}
+
+/* The list of a term, NULL if it has none */
+static const struct tech_posting *tech_term(const struct holos_tech_index *index, enum holos_tech_key what,
+                                            const char *value) {
+    const struct tech_posting *p;
+    uint32_t id;
+    if (!index->catalog || !(id = holos_tech_string_id(index->catalog, value))) return NULL;
+    p = tech_posting_find(index, tech_key(what, id));
+    return p && p->key && p->n ? p : NULL;
+}
+
+static void tech_emit(const struct holos_tech_index *index, uint32_t pos, struct holos_technology **out, size_t max,
+                      long *count) {
+    if (out && (size_t)*count < max) out[*count] = holos_tech_catalog_get(index->catalog, pos);
+    ++*count;
+}
+
+long holos_tech_index_find(const struct holos_tech_index *index, enum holos_tech_key key, const char *value,
+                           struct holos_technology **out, size_t max) {
+    const struct tech_posting *p;
+    long count = 0;
+    if (!index || !value || key > HOLOS_TECH_CERTIFICATION) return -1;
+    if (!(p = tech_term(index, key, value))) return 0;
+    for (uint32_t i = 0; i < p->n; i++) tech_emit(index, p->at[i], out, max, &count);
+    return count;
+}
+
+/* Position of the first at or past pos in p from lo on, galloping:
+   steps doubling until past, then a binary search of the last step */
+static uint32_t tech_gallop(const struct tech_posting *p, uint32_t lo, uint32_t pos) {
+    uint32_t step = 1, hi = lo;
+    while (hi < p->n && p->at[hi] < pos) {
+        lo = hi + 1;
+        hi = p->n - hi > step ? hi + step : p->n;
+        step *= 2;
+    }
+    while (lo < hi) {
+        const uint32_t mid = lo + (hi - lo) / 2;
+        if (p->at[mid] < pos) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+long holos_tech_index_query(const struct holos_tech_index *index, const struct holos_tech_term *terms, size_t n,
+                            int any, struct holos_technology **out, size_t max) {
+    const struct tech_posting *lists[HOLOS_TECH_QUERY_MAX];
+    uint32_t at[HOLOS_TECH_QUERY_MAX] = {0};
+    size_t k = 0;
+    long count = 0;
+    if (!index || !terms || n == 0 || n > HOLOS_TECH_QUERY_MAX) return -1;
+    for (size_t i = 0; i < n; i++) {
+        const struct tech_posting *p;
+        if (!terms[i].value || terms[i].key > HOLOS_TECH_CERTIFICATION) return -1;
+        if ((p = tech_term(index, terms[i].key, terms[i].value))) {
+            size_t j = k++;
+            for (; j > 0 && lists[j - 1]->n > p->n; j--) lists[j] = lists[j - 1];
+            lists[j] = p;                                   /* Shortest first */
+        } else if (!any) {
+            return 0;
+        }
+    }
+    if (!any) {
+        for (uint32_t i = 0; i < lists[0]->n; i++) {
+            const uint32_t pos = lists[0]->at[i];
+            size_t j;
+            for (j = 1; j < k; j++) {
+                if ((at[j] = tech_gallop(lists[j], at[j], pos)) == lists[j]->n) return count;
+                if (lists[j]->at[at[j]] != pos) break;
+            }
+            if (j == k) tech_emit(index, pos, out, max, &count);
+        }
+        return count;
+    }
+    for (;;) {
+        uint32_t pos = UINT32_MAX;
+        int left = 0;
+        for (size_t j = 0; j < k; j++)
+            if (at[j] < lists[j]->n && lists[j]->at[at[j]] <= pos) {
+                pos = lists[j]->at[at[j]];
+                left = 1;
+            }
+        if (!left) return count;
+        tech_emit(index, pos, out, max, &count);
+        for (size_t j = 0; j < k; j++)
+            if (at[j] < lists[j]->n && lists[j]->at[at[j]] == pos) at[j]++;
+    }
+}
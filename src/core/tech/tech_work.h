@@ -0,0 +1,72 @@
+/* tech_work.h - Shared by the technology modules of HOLOS
+    Copyright (C) 2025  4137314 <holos@mail.com>
+
+    This file is part of HOLOS.
+
+    HOLOS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    HOLOS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+    ----------------------------------------------------------------------
+    Private to src/core/tech.
+*/
+
+#ifndef HOLOS_TECH_WORK_H
+#define HOLOS_TECH_WORK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core/tech/tech.h"
+
+#define TECH_ID_LEN 16                  /* Hex digits of a made ID */
+
+/* A new technology ID into out (TECH_ID_LEN + 1 bytes) (tech.c) */
+void tech_make_id(char *out);
+
+/* The number of a string interned in a catalog, from the pointer alone:
+   only for the interned fields of its technologies (tech_catalog.c) */
+uint32_t tech_interned_id(const char *interned);
+
+/* The indexes of a catalog, a list through their next (tech_catalog.c) */
+struct holos_tech_index **tech_catalog_indexes(struct holos_tech_catalog *catalog);
+
+/* The columns of a snapshot: the strings, trl, then the measures in
+   their order (tech_columns.c) */
+#define TECH_COLUMNS (5 + 1 + HOLOS_TECH_MEASURES)
+
+enum {
+    TECH_UTF8,
+    TECH_INT32,
+    TECH_FLOAT64
+};
+
+struct tech_column {
+    const char *name;
+    int type;
+    size_t null_count;
+    void *validity;                     /* NULL without nulls */
+    int32_t *offsets;                   /* rows + 1, of TECH_UTF8 */
+    void *data;
+    size_t data_bytes;
+};
+
+const struct tech_column *tech_columns_all(const struct holos_tech_columns *columns, size_t *rows);
+
+/* Technology i of its catalog added (old NULL) or changed from old; and
+   the catalog freed, the index then left empty (tech_index.c) */
+void tech_index_changed(struct holos_tech_index *index, size_t i, const struct holos_technology *old,
+                        const struct holos_technology *tech);
+void tech_index_detach(struct holos_tech_index *index);
+struct holos_tech_index *tech_index_next(const struct holos_tech_index *index);
+
+#endif /* HOLOS_TECH_WORK_H */
@@ -0,0 +1,429 @@
+/* trace.c - Zones of the hot paths of HOLOS, timed while profiling
+    Copyright (C) 2025  4137314 <holos@mail.com>
+
+    This file is part of HOLOS.
+
+    HOLOS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    HOLOS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+    ----------------------------------------------------------------------
+    A zone is recorded when it ends, as one event (site, start, length,
+    depth) in the ring of its thread: a store and a release of the
+    ring's head, which a report reads with acquire. Rings are made on a
+    thread's first zone, listed under a lock taken only then and by the
+    reports, and kept for the life of the process, since a thread may
+    still hold its own.
+
+    The call tree is put back together from the events: sorted by start
+    (the outer first at equal starts), a zone's parent is the open zone
+    one level up, if that one contains it; a zone whose parent was
+    overwritten in the ring is shown at the top.
+
+    Counters are perf events of the thread, user space only. Where the
+    kernel maps them readable (x86 with rdpmc allowed), a read is the
+    seqlock of the mapped page around rdpmc, without a system call;
+    else a read(2).
+*/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE                     /* syscall() */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "core/trace/trace.h"
+
+#define TRACE_DEPTH_MAX 256
+
+struct trace_event {
+    const struct holos_trace_site *site;
+    uint64_t start_ns, dur_ns;
+    uint64_t counters[2];
+    uint32_t depth;
+};
+
+struct trace_ring {
+    struct trace_ring *next;
+    long tid;
+    size_t cap;
+    atomic_size_t head;                 /* Events written, ever */
+    int counting;
+    int fd[2];
+#ifdef __linux__
+    struct perf_event_mmap_page *page[2];
+#endif
+    struct trace_event events[];
+};
+
+int holos_trace_on = 0;
+static unsigned g_flags = 0;
+static size_t g_ring_zones = HOLOS_TRACE_RING;
+static int g_counters_failed = 0;
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct trace_ring *g_rings = NULL;
+
+static _Thread_local struct trace_ring *t_ring = NULL;
+static _Thread_local uint32_t t_depth = 0;
+
+static uint64_t trace_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/* ---------------- Counters ---------------- */
+
+#ifdef __linux__
+static int trace_perf_open(struct trace_ring *r, int i, uint64_t config) {
+    struct perf_event_attr attr;
+    void *page;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    if ((r->fd[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0)) < 0) return -1;
+    page = mmap(NULL, (size_t)sysconf(_SC_PAGESIZE), PROT_READ, MAP_SHARED, r->fd[i], 0);
+    r->page[i] = page == MAP_FAILED ? NULL : page;
+    return 0;
+}
+
+static uint64_t trace_perf_read(const struct trace_ring *r, int i) {
+    uint64_t value = 0;
+#if defined(__x86_64__) || defined(__i386__)
+    const struct perf_event_mmap_page *pc = r->page[i];
+    if (pc && pc->cap_user_rdpmc) {
+        uint32_t seq, idx;
+        do {
+            seq = pc->lock;
+            atomic_signal_fence(memory_order_acquire);
+            idx = pc->index;
+            value = (uint64_t)pc->offset;
+            if (idx) {
+                uint32_t lo, hi;
+                int64_t pmc;
+                __asm__ volatile("rdpmc" : "=a"(lo), "=d"(hi) : "c"(idx - 1));
+                pmc = (int64_t)((uint64_t)hi << 32 | lo);
+                pmc = (int64_t)((uint64_t)pmc << (64 - pc->pmc_width)) >> (64 - pc->pmc_width);
+                value += (uint64_t)pmc;
+            }
+            atomic_signal_fence(memory_order_acquire);
+        } while (pc->lock != seq);
+        if (idx) return value;
+    }
+#endif
+    if (read(r->fd[i], &value, sizeof(value)) != sizeof(value)) value = 0;
+    return value;
+}
+#endif
+
+static void trace_counters_open(struct trace_ring *r) {
+    r->fd[0] = r->fd[1] = -1;
+#ifdef __linux__
+    if (trace_perf_open(r, 0, PERF_COUNT_HW_INSTRUCTIONS) == 0 && trace_perf_open(r, 1, PERF_COUNT_HW_CPU_CYCLES) == 0) {
+        r->counting = 1;
+        return;
+    }
+#endif
+    if (!g_counters_failed) fprintf(stderr, "[trace] hardware counters: %s\n", strerror(errno ? errno : ENOSYS));
+    g_counters_failed = 1;
+}
+
+static void trace_counters_read(const struct trace_ring *r, uint64_t *out) {
+#ifdef __linux__
+    out[0] = trace_perf_read(r, 0);
+    out[1] = trace_perf_read(r, 1);
+#else
+    (void)r;
+    out[0] = out[1] = 0;
+#endif
+}
+
+/* ---------------- Recording ---------------- */
+
+static struct trace_ring *trace_ring_new(void) {
+    const size_t cap = g_ring_zones;
+    struct trace_ring *r = malloc(sizeof(*r) + cap * sizeof(r->events[0]));
+#ifndef __linux__
+    static long next_tid = 0;
+#endif
+    if (!r) return NULL;
+    memset(r, 0, sizeof(*r));
+    r->cap = cap;
+    atomic_init(&r->head, 0);
+    pthread_mutex_lock(&g_lock);
+#ifdef __linux__
+    r->tid = (long)syscall(SYS_gettid);
+#else
+    r->tid = ++next_tid;
+#endif
+    if (g_flags & HOLOS_TRACE_COUNTERS) trace_counters_open(r);
+    else r->fd[0] = r->fd[1] = -1;
+    r->next = g_rings;
+    g_rings = r;
+    pthread_mutex_unlock(&g_lock);
+    return t_ring = r;
+}
+
+struct holos_trace_scope holos_trace_open(const struct holos_trace_site *site) {
+    struct holos_trace_scope scope = {NULL, 0, {0, 0}};
+    struct trace_ring *r;
+    if (!(r = t_ring) && !(r = trace_ring_new())) return scope;
+    scope.site = site;
+    t_depth++;
+    if (r->counting) trace_counters_read(r, scope.counters);
+    scope.start_ns = trace_now();
+    return scope;
+}
+
+void holos_trace_close(struct holos_trace_scope *scope) {
+    struct trace_ring *r = t_ring;
+    struct trace_event *e;
+    size_t head;
+    uint64_t end;
+    end = trace_now();
+    head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    e = &r->events[head % r->cap];
+    e->site = scope->site;
+    e->start_ns = scope->start_ns;
+    e->dur_ns = end - scope->start_ns;
+    e->depth = --t_depth;
+    if (r->counting) {
+        uint64_t now[2];
+        trace_counters_read(r, now);
+        e->counters[0] = now[0] - scope->counters[0];
+        e->counters[1] = now[1] - scope->counters[1];
+    } else {
+        e->counters[0] = e->counters[1] = 0;
+    }
+    atomic_store_explicit(&r->head, head + 1, memory_order_release);
+}
+
+int holos_trace_start(unsigned flags, size_t ring_zones) {
+    pthread_mutex_lock(&g_lock);
+    g_flags = flags;
+    g_ring_zones = ring_zones ? ring_zones : HOLOS_TRACE_RING;
+    g_counters_failed = 0;
+    for (struct trace_ring *r = g_rings; r; r = r->next)
+        if ((flags & HOLOS_TRACE_COUNTERS) && !r->counting && r->fd[0] < 0) trace_counters_open(r);
+    pthread_mutex_unlock(&g_lock);
+    __atomic_store_n(&holos_trace_on, 1, __ATOMIC_SEQ_CST);
+    return 0;
+}
+
+void holos_trace_stop(void) {
+    __atomic_store_n(&holos_trace_on, 0, __ATOMIC_SEQ_CST);
+}
+
+void holos_trace_reset(void) {
+    pthread_mutex_lock(&g_lock);
+    for (struct trace_ring *r = g_rings; r; r = r->next) atomic_store(&r->head, 0);
+    pthread_mutex_unlock(&g_lock);
+}
+
+int holos_trace_counters(void) {
+    return (g_flags & HOLOS_TRACE_COUNTERS) && !g_counters_failed;
+}
+
+/* ---------------- Call tree ---------------- */
+
+struct trace_node {
+    const struct holos_trace_site *site;  /* NULL: the root */
+    size_t child, sibling;              /* 0: none */
+    uint64_t calls, total_ns, self_ns;
+    uint64_t counters[2];
+};
+
+struct trace_tree {
+    struct trace_node *nodes;
+    size_t n, cap;
+    uint64_t zones, dropped;
+    size_t threads;
+};
+
+/* The node of site under parent, made if new; 0 if out of memory */
+static size_t trace_child(struct trace_tree *t, size_t parent, const struct holos_trace_site *site) {
+    size_t c;
+    for (c = t->nodes[parent].child; c; c = t->nodes[c].sibling)
+        if (t->nodes[c].site == site) return c;
+    if (t->n == t->cap) {
+        const size_t cap = 2 * t->cap;
+        struct trace_node *grown = realloc(t->nodes, cap * sizeof(*grown));
+        if (!grown) return 0;
+        t->nodes = grown;
+        t->cap = cap;
+    }
+    c = t->n++;
+    memset(&t->nodes[c], 0, sizeof(t->nodes[c]));
+    t->nodes[c].site = site;
+    t->nodes[c].sibling = t->nodes[parent].child;
+    t->nodes[parent].child = c;
+    return c;
+}
+
+static int trace_by_start(const void *a, const void *b) {
+    const struct trace_event *x = a, *y = b;
+    if (x->start_ns != y->start_ns) return x->start_ns < y->start_ns ? -1 : 1;
+    return (x->depth > y->depth) - (x->depth < y->depth);
+}
+
+/* The events of r, oldest first, in a copy; their number into n */
+static struct trace_event *trace_events(struct trace_ring *r, size_t *n) {
+    const size_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+    struct trace_event *copy;
+    *n = head < r->cap ? head : r->cap;
+    if (!(copy = malloc((*n + 1) * sizeof(*copy)))) return NULL;
+    for (size_t i = 0; i < *n; i++) copy[i] = r->events[(head - *n + i) % r->cap];
+    return copy;
+}
+
+static int trace_tree_build(struct trace_tree *t) {
+    memset(t, 0, sizeof(*t));
+    if (!(t->nodes = calloc(t->cap = 64, sizeof(*t->nodes)))) return -1;
+    t->n = 1;
+    pthread_mutex_lock(&g_lock);
+    for (struct trace_ring *r = g_rings; r; r = r->next) {
+        size_t node[TRACE_DEPTH_MAX] = {0}, n;
+        uint64_t end[TRACE_DEPTH_MAX] = {0};
+        struct trace_event *ev = trace_events(r, &n);
+        const size_t head = atomic_load(&r->head);
+        if (!ev) continue;
+        if (n) t->threads++;
+        t->zones += n;
+        t->dropped += head - n;
+        qsort(ev, n, sizeof(*ev), trace_by_start);
+        for (size_t i = 0; i < n; i++) {
+            const uint32_t d = ev[i].depth < TRACE_DEPTH_MAX ? ev[i].depth : TRACE_DEPTH_MAX - 1;
+            size_t parent = 0, c;
+            if (d > 0 && node[d - 1] && end[d - 1] >= ev[i].start_ns + ev[i].dur_ns) parent = node[d - 1];
+            if (!(c = trace_child(t, parent, ev[i].site))) break;
+            t->nodes[c].calls++;
+            t->nodes[c].total_ns += ev[i].dur_ns;
+            t->nodes[c].counters[0] += ev[i].counters[0];
+            t->nodes[c].counters[1] += ev[i].counters[1];
+            node[d] = c;
+            end[d] = ev[i].start_ns + ev[i].dur_ns;
+            if (d + 1 < TRACE_DEPTH_MAX) node[d + 1] = 0;
+        }
+        free(ev);
+    }
+    pthread_mutex_unlock(&g_lock);
+    for (size_t i = 1; i < t->n; i++) {
+        uint64_t children = 0;
+        for (size_t c = t->nodes[i].child; c; c = t->nodes[c].sibling) children += t->nodes[c].total_ns;
+        t->nodes[i].self_ns = t->nodes[i].total_ns > children ? t->nodes[i].total_ns - children : 0;
+    }
+    for (size_t c = t->nodes[0].child; c; c = t->nodes[c].sibling) t->nodes[0].total_ns += t->nodes[c].total_ns;
+    return 0;
+}
+
+static void trace_print_node(FILE *out, struct trace_tree *t, size_t i, int level, int counters) {
+    const struct trace_node *n = &t->nodes[i];
+    size_t kids[64], k = 0;
+    if (i) {
+        const double all = t->nodes[0].total_ns ? (double)t->nodes[0].total_ns : 1;
+        fprintf(out, "%*s%-*.*s %10llu %12.3f %12.3f %6.1f", 2 * level, "", 40 - 2 * level, 40 - 2 * level,
+                n->site->name, (unsigned long long)n->calls, (double)n->total_ns / 1e6, (double)n->self_ns / 1e6,
+                100.0 * (double)n->total_ns / all);
+        if (counters)
+            fprintf(out, " %14llu %6.2f", (unsigned long long)n->counters[0],
+                    n->counters[1] ? (double)n->counters[0] / (double)n->counters[1] : 0.0);
+        fputc('\n', out);
+    }
+    for (size_t c = n->child; c && k < sizeof(kids) / sizeof(kids[0]); c = t->nodes[c].sibling) kids[k++] = c;
+    /* Longest first; a node has few children */
+    for (size_t a = 1; a < k; a++)
+        for (size_t b = a; b > 0 && t->nodes[kids[b - 1]].total_ns < t->nodes[kids[b]].total_ns; b--) {
+            const size_t tmp = kids[b];
+            kids[b] = kids[b - 1];
+            kids[b - 1] = tmp;
+        }
+    for (size_t a = 0; a < k; a++) trace_print_node(out, t, kids[a], i ? level + 1 : 0, counters);
+}
+
+void holos_trace_print(FILE *out) {
+    struct trace_tree t;
+    const int counters = holos_trace_counters();
+    if (trace_tree_build(&t) != 0) return;
+    fprintf(out, "%-40s %10s %12s %12s %6s%s\n", "zone", "calls", "total ms", "self ms", "%",
+            counters ? "   instructions    IPC" : "");
+    trace_print_node(out, &t, 0, 0, counters);
+    fprintf(out, "%llu zones on %zu threads", (unsigned long long)t.zones, t.threads);
+    if (t.dropped) fprintf(out, ", %llu older dropped (ring full)", (unsigned long long)t.dropped);
+    fputc('\n', out);
+    free(t.nodes);
+}
+
+/* ---------------- Chrome trace ---------------- */
+
+static void trace_json_string(FILE *out, const char *s) {
+    fputc('"', out);
+    for (; s && *s; s++) {
+        if (*s == '"' || *s == '\\') fprintf(out, "\\%c", *s);
+        else if ((unsigned char)*s < 0x20) fprintf(out, "\\u%04x", (unsigned char)*s);
+        else fputc(*s, out);
+    }
+    fputc('"', out);
+}
+
+int holos_trace_dump(FILE *out) {
+    uint64_t origin = UINT64_MAX;
+    const long pid = (long)getpid();
+    const int counters = holos_trace_counters();
+    int first = 1;
+    pthread_mutex_lock(&g_lock);
+    for (struct trace_ring *r = g_rings; r; r = r->next) {
+        size_t n;
+        struct trace_event *ev = trace_events(r, &n);
+        for (size_t i = 0; ev && i < n; i++)
+            if (ev[i].start_ns < origin) origin = ev[i].start_ns;
+        free(ev);
+    }
+    fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    for (struct trace_ring *r = g_rings; r; r = r->next) {
+        size_t n;
+        struct trace_event *ev = trace_events(r, &n);
+        if (!ev) continue;
+        for (size_t i = 0; i < n; i++) {
+            fprintf(out, "%s\n{\"name\":", first ? "" : ",");
+            trace_json_string(out, ev[i].site->name);
+            fprintf(out, ",\"cat\":\"holos\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%ld,\"tid\":%ld,\"args\":{\"at\":",
+                    (double)(ev[i].start_ns - origin) / 1e3, (double)ev[i].dur_ns / 1e3, pid, r->tid);
+            fprintf(out, "\"%s:%d\"", ev[i].site->file, ev[i].site->line);
+            if (counters)
+                fprintf(out, ",\"instructions\":%llu,\"cycles\":%llu", (unsigned long long)ev[i].counters[0],
+                        (unsigned long long)ev[i].counters[1]);
+            fprintf(out, "}}");
+            first = 0;
+        }
+        free(ev);
+    }
+    pthread_mutex_unlock(&g_lock);
+    fprintf(out, "\n]}\n");
+    return ferror(out) ? -1 : 0;
+}
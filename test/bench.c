@@ -0,0 +1,438 @@
+/* bench.c - Benchmark harness of HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+   ----------------------------------------------------------------------
+   holos-bench [OPTION]...: runs the cases of every suite (see bench.h)
+   and writes their results as JSON; with --compare, also checks them
+   against a baseline written before and exits 1 on a regression.
+
+   A case runs batches of 1, 2, 4, ... iterations for the warmup time,
+   then samples batches of as many iterations as fill the minimum
+   sample time (at least one). The statistics are over the samples,
+   in ns per iteration: median and MAD (scaled by 1.4826, the standard
+   deviation for normal noise) are what count, min, mean and max are
+   reported besides.
+
+   A case is slower than its baseline when its median is over it by
+   more than the threshold and by more than three times their MADs
+   combined: a noisy case must move further to count. The baseline is
+   read back with a scan for the "name", "median_ns" and "mad_ns" of
+   each result, which is all the format of this file needs.
+
+   JSON: {"holos_bench": 1, "version", "cpus", "threads", "results":
+   [{"name", "unit", "work", "samples", "iterations", "median_ns",
+   "mad_ns", "min_ns", "mean_ns", "max_ns", "rate"[, "baseline_ns",
+   "change", "verdict"]}, ...]}
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+
+#include "config.h"
+#include "core/exec/exec.h"
+#include "bench.h"
+
+#define BENCH_SAMPLES_MAX 1000
+#define BENCH_CASE_BUDGET_NS 20e9           /* A case stops sampling after, with 5 samples at least */
+
+enum { BENCH_IDLE, BENCH_WARMUP, BENCH_SAMPLE };
+
+struct bench_result {
+    char name[160];
+    char unit[24];
+    double work;
+    size_t samples, iterations;
+    double median, mad, min, mean, max;     /* ns per iteration */
+    double base, base_mad;                  /* Baseline median and MAD, NaN if none */
+    const char *verdict;
+};
+
+struct bench {
+    /* Options */
+    size_t samples;
+    double warmup_ns, sample_ns;
+    const char *filter;
+    unsigned threads;
+    int quick, list;
+    /* The case running */
+    int phase;
+    struct bench_result cur;
+    size_t batch, left;
+    double t0, warm, spent;
+    double times[BENCH_SAMPLES_MAX];
+    size_t n_times;
+    /* Done */
+    struct bench_result *results;
+    size_t n_results, cap_results;
+};
+
+static double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int bench_cmp(const void *a, const void *b) {
+    const double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+/* Median of v[0 .. n), sorted in place */
+static double bench_median(double *v, size_t n) {
+    qsort(v, n, sizeof(*v), bench_cmp);
+    return n % 2 ? v[n / 2] : 0.5 * (v[n / 2 - 1] + v[n / 2]);
+}
+
+/* ---------------- Cases ---------------- */
+
+int bench_begin(struct bench *b, double work, const char *unit, const char *fmt, ...) {
+    va_list ap;
+    memset(&b->cur, 0, sizeof(b->cur));
+    va_start(ap, fmt);
+    vsnprintf(b->cur.name, sizeof(b->cur.name), fmt, ap);
+    va_end(ap);
+    snprintf(b->cur.unit, sizeof(b->cur.unit), "%s", unit);
+    b->cur.work = work;
+    b->cur.base = b->cur.base_mad = NAN;
+    b->phase = BENCH_IDLE;
+    if (b->filter && !strstr(b->cur.name, b->filter)) return 1;
+    if (b->list) {
+        printf("%s\n", b->cur.name);
+        return 1;
+    }
+    return 0;
+}
+
+void bench_skip(struct bench *b, const char *why) {
+    fprintf(stderr, "[bench] %s: skipped: %s\n", b->cur.name, why);
+    b->phase = BENCH_IDLE;
+}
+
+unsigned bench_threads(const struct bench *b) {
+    return b->threads;
+}
+
+int bench_quick(const struct bench *b) {
+    return b->quick;
+}
+
+static void bench_end(struct bench *b) {
+    struct bench_result *r = &b->cur;
+    double dev[BENCH_SAMPLES_MAX], sum = 0;
+    const size_t n = b->n_times;
+    r->samples = n;
+    r->iterations = b->batch;
+    r->min = r->max = b->times[0];
+    for (size_t i = 0; i < n; i++) {
+        sum += b->times[i];
+        if (b->times[i] < r->min) r->min = b->times[i];
+        if (b->times[i] > r->max) r->max = b->times[i];
+    }
+    r->mean = sum / n;
+    r->median = bench_median(b->times, n);
+    for (size_t i = 0; i < n; i++) dev[i] = fabs(b->times[i] - r->median);
+    r->mad = 1.4826 * bench_median(dev, n);
+    fprintf(stderr, "%-48s %12.0f ns +- %4.1f%%  %12.4g %s\n", r->name, r->median,
+            r->median > 0 ? 100 * r->mad / r->median : 0.0, r->median > 0 ? r->work * 1e9 / r->median : 0.0,
+            r->unit);
+    if (b->n_results == b->cap_results) {
+        const size_t cap = b->cap_results ? 2 * b->cap_results : 32;
+        struct bench_result *results = realloc(b->results, cap * sizeof(*results));
+        if (!results) {
+            fprintf(stderr, "[bench] out of memory\n");
+            exit(2);
+        }
+        b->results = results;
+        b->cap_results = cap;
+    }
+    b->results[b->n_results++] = *r;
+    b->phase = BENCH_IDLE;
+}
+
+int bench_next(struct bench *b) {
+    double now, t;
+    if (b->left) {
+        b->left--;
+        return 1;
+    }
+    now = bench_now();
+    switch (b->phase) {
+    case BENCH_IDLE:                        /* The first iteration */
+        b->phase = BENCH_WARMUP;
+        b->batch = 1;
+        b->warm = b->spent = 0;
+        b->n_times = 0;
+        break;
+    case BENCH_WARMUP:
+        t = now - b->t0;
+        b->warm += t;
+        if (b->warm < b->warmup_ns) {
+            b->batch *= 2;
+            break;
+        }
+        b->phase = BENCH_SAMPLE;
+        t /= b->batch;                      /* Per iteration, warm */
+        b->batch = t > 0 ? (size_t)ceil(b->sample_ns / t) : 1;
+        if (b->batch < 1) b->batch = 1;
+        break;
+    case BENCH_SAMPLE:
+        t = now - b->t0;
+        b->spent += t;
+        b->times[b->n_times++] = t / b->batch;
+        if (b->n_times == b->samples || b->n_times == BENCH_SAMPLES_MAX ||
+            (b->spent > BENCH_CASE_BUDGET_NS && b->n_times >= 5)) {
+            bench_end(b);
+            return 0;
+        }
+        break;
+    }
+    b->left = b->batch - 1;
+    b->t0 = bench_now();
+    return 1;
+}
+
+/* ---------------- Baseline ---------------- */
+
+/* The string after key from p, into out: past it, or NULL */
+static const char *bench_scan_string(const char *p, const char *key, char *out, size_t size) {
+    size_t n = 0;
+    if (!(p = strstr(p, key))) return NULL;
+    p += strlen(key);
+    while (*p == ' ' || *p == ':') p++;
+    if (*p++ != '"') return NULL;
+    while (*p && *p != '"') {
+        if (*p == '\\' && p[1]) p++;
+        if (n + 1 < size) out[n++] = *p;
+        p++;
+    }
+    out[n] = '\0';
+    return *p ? p + 1 : NULL;
+}
+
+static double bench_scan_number(const char *p, const char *limit, const char *key) {
+    const char *at = strstr(p, key);
+    if (!at || (limit && at > limit)) return NAN;
+    at += strlen(key);
+    while (*at == ' ' || *at == ':') at++;
+    return strtod(at, NULL);
+}
+
+/* Sets base and base_mad of the results the baseline has; -1 if it
+   cannot be read */
+static int bench_load_baseline(struct bench *b, const char *path) {
+    FILE *f = fopen(path, "rb");
+    char *text, name[160];
+    const char *p;
+    long size;
+    if (!f) {
+        fprintf(stderr, "[bench] %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    rewind(f);
+    if (size < 0 || !(text = malloc((size_t)size + 1)) || fread(text, 1, (size_t)size, f) != (size_t)size) {
+        fprintf(stderr, "[bench] %s: cannot read\n", path);
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+    text[size] = '\0';
+    if (!strstr(text, "\"holos_bench\"")) {
+        fprintf(stderr, "[bench] %s: not a holos-bench file\n", path);
+        free(text);
+        return -1;
+    }
+    for (p = text; (p = bench_scan_string(p, "\"name\"", name, sizeof(name)));) {
+        const char *next = strstr(p, "\"name\"");
+        for (size_t i = 0; i < b->n_results; i++)
+            if (strcmp(b->results[i].name, name) == 0) {
+                b->results[i].base = bench_scan_number(p, next, "\"median_ns\"");
+                b->results[i].base_mad = bench_scan_number(p, next, "\"mad_ns\"");
+            }
+    }
+    free(text);
+    return 0;
+}
+
+/* Verdicts against the baseline: the number of regressions */
+static int bench_compare(struct bench *b, double threshold) {
+    int slower = 0;
+    fprintf(stderr, "\n%-48s %12s %12s %8s\n", "case", "baseline ns", "now ns", "change");
+    for (size_t i = 0; i < b->n_results; i++) {
+        struct bench_result *r = &b->results[i];
+        double diff, noise;
+        if (!(r->base > 0)) {
+            r->verdict = "new";
+            fprintf(stderr, "%-48s %12s %12.0f %8s  new\n", r->name, "-", r->median, "");
+            continue;
+        }
+        diff = r->median - r->base;
+        noise = 3 * sqrt(r->mad * r->mad + (r->base_mad > 0 ? r->base_mad * r->base_mad : 0));
+        if (diff > threshold * r->base && diff > noise) {
+            r->verdict = "slower";
+            slower++;
+        } else if (-diff > threshold * r->base && -diff > noise) {
+            r->verdict = "faster";
+        } else {
+            r->verdict = "same";
+        }
+        fprintf(stderr, "%-48s %12.0f %12.0f %+7.1f%%  %s\n", r->name, r->base, r->median, 100 * diff / r->base,
+                r->verdict);
+    }
+    return slower;
+}
+
+/* ---------------- Output ---------------- */
+
+static void bench_json_string(FILE *out, const char *s) {
+    fputc('"', out);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') fputc('\\', out);
+        if ((unsigned char)*s >= 0x20) fputc(*s, out);
+    }
+    fputc('"', out);
+}
+
+static int bench_write(const struct bench *b, FILE *out) {
+    fprintf(out, "{\n  \"holos_bench\": 1,\n  \"version\": ");
+    bench_json_string(out, PACKAGE_VERSION);
+    fprintf(out, ",\n  \"cpus\": %ld,\n  \"threads\": %u,\n  \"results\": [", sysconf(_SC_NPROCESSORS_ONLN),
+            b->threads);
+    for (size_t i = 0; i < b->n_results; i++) {
+        const struct bench_result *r = &b->results[i];
+        fprintf(out, "%s\n    {\"name\": ", i ? "," : "");
+        bench_json_string(out, r->name);
+        fprintf(out, ", \"unit\": ");
+        bench_json_string(out, r->unit);
+        fprintf(out,
+                ", \"work\": %.17g, \"samples\": %zu, \"iterations\": %zu,\n"
+                "     \"median_ns\": %.6g, \"mad_ns\": %.6g, \"min_ns\": %.6g, \"mean_ns\": %.6g, \"max_ns\": %.6g,\n"
+                "     \"rate\": %.6g",
+                r->work, r->samples, r->iterations, r->median, r->mad, r->min, r->mean, r->max,
+                r->median > 0 ? r->work * 1e9 / r->median : 0.0);
+        if (r->verdict) {
+            if (r->base > 0) fprintf(out, ", \"baseline_ns\": %.6g, \"change\": %.4f", r->base, r->median / r->base - 1);
+            fprintf(out, ", \"verdict\": \"%s\"", r->verdict);
+        }
+        fputc('}', out);
+    }
+    fprintf(out, "\n  ]\n}\n");
+    return ferror(out) ? -1 : 0;
+}
+
+static void bench_usage(FILE *out) {
+    fprintf(out,
+            "Usage: holos-bench [OPTION]...\n"
+            "Runs the HOLOS benchmarks and writes their results as JSON.\n\n"
+            "  -o, --output FILE     write the JSON to FILE (default: standard output)\n"
+            "  -c, --compare FILE    compare with the results of FILE; exit 1 if one is slower\n"
+            "  -t, --threshold PCT   change below which a case is the same (default 5)\n"
+            "  -f, --filter TEXT     run the cases whose name contains TEXT\n"
+            "  -r, --samples N       samples per case (default 15)\n"
+            "  -w, --warmup MS       warmup per case (default 200)\n"
+            "  -s, --sample-time MS  minimum time of a sample (default 20)\n"
+            "  -j, --threads N       threads the scaling cases go up to (default: the pool's)\n"
+            "  -q, --quick           small sizes, 5 samples, 50 ms warmup\n"
+            "  -l, --list            list the cases and exit\n"
+            "  -h, --help            show this help and exit\n");
+}
+
+static int bench_number(const char *arg, const char *what, double lo, double hi, double *out) {
+    char *end;
+    const double v = strtod(arg, &end);
+    if (*end || !(v >= lo && v <= hi)) {
+        fprintf(stderr, "[bench] %s: not a valid value: %s\n", what, arg);
+        return -1;
+    }
+    *out = v;
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    static const struct option longopts[] = {
+        {"output", required_argument, NULL, 'o'},    {"compare", required_argument, NULL, 'c'},
+        {"threshold", required_argument, NULL, 't'}, {"filter", required_argument, NULL, 'f'},
+        {"samples", required_argument, NULL, 'r'},   {"warmup", required_argument, NULL, 'w'},
+        {"sample-time", required_argument, NULL, 's'}, {"threads", required_argument, NULL, 'j'},
+        {"quick", no_argument, NULL, 'q'},           {"list", no_argument, NULL, 'l'},
+        {"help", no_argument, NULL, 'h'},            {NULL, 0, NULL, 0}};
+    struct bench *b = calloc(1, sizeof(struct bench));
+    const char *output = NULL, *baseline = NULL;
+    double threshold = 5, samples = 15, warmup = 200, sample_ms = 20, threads = 0;
+    int c, rc = 0, quick = 0;
+    FILE *out = stdout;
+    if (!b) return 2;
+    while ((c = getopt_long(argc, argv, "o:c:t:f:r:w:s:j:qlh", longopts, NULL)) != -1) {
+        switch (c) {
+        case 'o': output = optarg; break;
+        case 'c': baseline = optarg; break;
+        case 't': if (bench_number(optarg, "--threshold", 0, 1000, &threshold)) return 2; break;
+        case 'f': b->filter = optarg; break;
+        case 'r': if (bench_number(optarg, "--samples", 1, BENCH_SAMPLES_MAX, &samples)) return 2; break;
+        case 'w': if (bench_number(optarg, "--warmup", 0, 1e6, &warmup)) return 2; break;
+        case 's': if (bench_number(optarg, "--sample-time", 0, 1e6, &sample_ms)) return 2; break;
+        case 'j': if (bench_number(optarg, "--threads", 1, HOLOS_EXEC_THREADS_MAX, &threads)) return 2; break;
+        case 'q': quick = 1; break;
+        case 'l': b->list = 1; break;
+        case 'h': bench_usage(stdout); return 0;
+        default: bench_usage(stderr); return 2;
+        }
+    }
+    if (optind < argc) {
+        bench_usage(stderr);
+        return 2;
+    }
+    if (quick) {
+        samples = samples < 5 ? samples : 5;
+        warmup = warmup < 50 ? warmup : 50;
+    }
+    b->samples = (size_t)samples;
+    b->warmup_ns = warmup * 1e6;
+    b->sample_ns = sample_ms * 1e6;
+    b->quick = quick;
+    if (threads) holos_exec_setup((unsigned)threads, -1);
+    b->threads = holos_exec_threads();
+
+    for (const struct bench_suite *s = bench_suites; s->name; s++) s->run(b);
+    if (b->list) return 0;
+
+    if (baseline) {
+        if (bench_load_baseline(b, baseline) != 0) return 2;
+        if (bench_compare(b, threshold / 100) > 0) rc = 1;
+    }
+    if (output && !(out = fopen(output, "w"))) {
+        fprintf(stderr, "[bench] %s: %s\n", output, strerror(errno));
+        return 2;
+    }
+    if (bench_write(b, out) != 0 || (out != stdout && fclose(out) != 0)) {
+        fprintf(stderr, "[bench] %s: write failed\n", output ? output : "stdout");
+        rc = 2;
+    }
+    holos_exec_shutdown();
+    free(b->results);
+    free(b);
+    return rc;
+}
@@ -0,0 +1,66 @@
+/* bench.h - Benchmark harness of HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+    A case measures one operation, set up once:
+
+        if (bench_begin(b, n_cells, "cells/s", "wave_engine_step/n=%zu", n) == 0) {
+            ... set up, or bench_skip(b, "why") ...
+            while (bench_next(b)) wave_engine_step(e, 1);
+        }
+
+    bench_next() runs the body through a warmup, sizes batches of
+    iterations to a minimum time each, and times a batch per sample; the
+    case is reported by the median time per iteration, its median
+    absolute deviation, and work / median in the unit given.
+    A suite is a function running cases of one module (bench_cases.c).
+*/
+
+#ifndef HOLOS_BENCH_H
+#define HOLOS_BENCH_H
+
+#include <stddef.h>
+
+struct bench;
+
+/* Starts case fmt, of work units per iteration: 0 to run it, nonzero if
+   it is filtered out (or only listed). */
+int bench_begin(struct bench *b, double work, const char *unit, const char *fmt, ...)
+    __attribute__((format(printf, 4, 5)));
+
+/* Nonzero while the case wants another iteration of its body */
+int bench_next(struct bench *b);
+
+/* Ends the case begun without measuring it */
+void bench_skip(struct bench *b, const char *why);
+
+/* Threads the scaling cases go up to */
+unsigned bench_threads(const struct bench *b);
+
+/* Nonzero for a quick run: the small sizes only */
+int bench_quick(const struct bench *b);
+
+struct bench_suite {
+    const char *name;
+    void (*run)(struct bench *b);
+};
+
+extern const struct bench_suite bench_suites[];
+
+#endif /* HOLOS_BENCH_H */
@@ -0,0 +1,477 @@
+/* bench_cases.c - Benchmark cases of HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+   ----------------------------------------------------------------------
+   The hot paths, each at a few sizes and, where it threads, at 1, 2,
+   4, ... threads up to bench_threads(): a case is named
+   stepper/size[/threads=T], and its names must stay the same for the
+   baselines to compare. Every input is drawn from a fixed seed.
+
+   The decay network has no constructor in nuclear_decay.h, so the
+   system is put together here: a chain of nuclides, each decaying to
+   the next two, with half-lives spread from a millisecond to 30 years
+   (a stiff network, as burnup ones are).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <gsl/gsl_vector.h>
+#include <gsl/gsl_matrix.h>
+
+#include "config.h"
+#include "core/phys/mech/classical/dynamics.h"
+#include "core/phys/em/maxwell.h"
+#include "core/phys/em/wave_equations.h"
+#include "core/phys/em/circuit_analysis.h"
+#include "core/phys/nuclear/nuclear_decay.h"
+#include "core/ai/mlp.h"
+#include "core/ai/transformer.h"
+#include "core/p2p/p2p.h"
+#include "bench.h"
+
+#define BENCH_SEED 0x484f4c4f53ull      /* "HOLOS" */
+
+static uint64_t g_rand = BENCH_SEED;
+
+static void bench_seed(void) {
+    g_rand = BENCH_SEED;
+}
+
+/* Uniform in [-1, 1) */
+static double bench_random(void) {
+    g_rand ^= g_rand << 13;
+    g_rand ^= g_rand >> 7;
+    g_rand ^= g_rand << 17;
+    return (double)(g_rand >> 11) * 0x1.0p-52 - 1.0;
+}
+
+static void bench_fill(double *v, size_t n, double scale) {
+    for (size_t i = 0; i < n; i++) v[i] = scale * bench_random();
+}
+
+/* 1, 2, 4, ... up to the scaling limit, and the limit; 1 and the limit
+   when quick. The count. */
+static size_t bench_thread_counts(const struct bench *b, int *out, size_t max) {
+    const int top = (int)bench_threads(b);
+    size_t n = 0;
+    out[n++] = 1;
+    for (int t = 2; t < top && n + 1 < max; t *= 2)
+        if (!bench_quick(b)) out[n++] = t;
+    if (top > 1 && n < max) out[n++] = top;
+    return n;
+}
+
+/* ---------------- Dynamics ---------------- */
+
+static dyn_system_t *bench_dyn_system(size_t N) {
+    dyn_system_t *sys = dyn_system_alloc(N);
+    if (!sys) return NULL;
+    bench_seed();
+    dyn_system_set_gravity(sys, 1.0);
+    dyn_system_set_softening(sys, true, 1e-2);
+    for (size_t i = 0; i < N; i++) {
+        gsl_vector_view pos = dyn_system_particle_vector(sys, DYN_FIELD_POS, i);
+        gsl_vector_view vel = dyn_system_particle_vector(sys, DYN_FIELD_VEL, i);
+        for (size_t a = 0; a < 3; a++) {
+            *gsl_vector_ptr(&pos.vector, a) = bench_random();
+            *gsl_vector_ptr(&vel.vector, a) = 0.1 * bench_random();
+        }
+        sys->particles[i].mass = 1.0 / N;
+    }
+    dyn_system_sync_masses(sys);
+    return sys;
+}
+
+static void bench_dynamics(struct bench *b) {
+    static const size_t sizes[] = {256, 1024, 4096};
+    const size_t n_sizes = bench_quick(b) ? 1 : 3;
+    int threads[16];
+    const size_t n_threads = bench_thread_counts(b, threads, 16);
+    for (size_t s = 0; s < n_sizes; s++)
+        for (size_t k = 0; k < n_threads; k++) {
+            const size_t N = sizes[s];
+            dyn_system_t *sys;
+            if (bench_begin(b, (double)N, "particles/s", "dyn_system_step/N=%zu/threads=%d", N, threads[k])) continue;
+            if (!(sys = bench_dyn_system(N))) {
+                bench_skip(b, "out of memory");
+                continue;
+            }
+            dyn_system_set_threads(sys, threads[k] > 1 ? threads[k] : 0);
+            while (bench_next(b)) dyn_system_step(sys, 1e-3, DYN_INT_VERLET);
+            dyn_system_free(sys);
+        }
+    {
+        const size_t N = bench_quick(b) ? 4096 : 32768;
+        const int t = (int)bench_threads(b);
+        dyn_system_t *sys;
+        if (bench_begin(b, (double)N, "particles/s", "dyn_system_step/N=%zu/barnes_hut/threads=%d", N, t) == 0) {
+            if (!(sys = bench_dyn_system(N)) || dyn_system_set_gravity_solver(sys, DYN_GRAVITY_BARNES_HUT, 0.5) != 0) {
+                bench_skip(b, "no Barnes-Hut solver");
+            } else {
+                dyn_system_set_threads(sys, t > 1 ? t : 0);
+                while (bench_next(b)) dyn_system_step(sys, 1e-3, DYN_INT_VERLET);
+            }
+            dyn_system_free(sys);
+        }
+    }
+}
+
+/* ---------------- FDTD ---------------- */
+
+static void bench_fdtd(struct bench *b) {
+    static const size_t sizes[] = {32, 64, 96}, wave_sizes[] = {64, 128, 192};
+    const size_t n_sizes = bench_quick(b) ? 1 : 3;
+    int threads[16];
+    const size_t n_threads = bench_thread_counts(b, threads, 16);
+    for (size_t s = 0; s < n_sizes; s++)
+        for (size_t k = 0; k < n_threads; k++) {
+            const size_t n = sizes[s];
+            maxwell_field_grid *grid;
+            maxwell_yee_grid *g;
+            double dt;
+            if (bench_begin(b, (double)(n * n * n), "cells/s", "maxwell_grid_fdtd_step/n=%zu^3/threads=%d", n,
+                            threads[k]))
+                continue;
+            if (!(grid = maxwell_field_grid_alloc_yee(n, n, n, 1e-3, 1e-3, 1e-3))) {
+                bench_skip(b, "out of memory");
+                continue;
+            }
+            g = grid->yee;
+            bench_seed();
+            bench_fill(g->E, 3 * g->n, 1.0);
+            maxwell_yee_set_threads(g, threads[k] > 1 ? threads[k] : 0);
+            dt = 0.5 * maxwell_yee_max_dt(g);
+            while (bench_next(b)) maxwell_grid_fdtd_step(grid, dt);
+            maxwell_field_grid_free(grid);
+        }
+    for (size_t s = 0; s < n_sizes; s++)
+        for (size_t k = 0; k < n_threads; k++) {
+            const size_t n = wave_sizes[s];
+            wave_engine *e;
+            if (bench_begin(b, (double)(n * n * n), "cells/s", "wave_engine_step/n=%zu^3/threads=%d", n, threads[k]))
+                continue;
+            if (!(e = wave_engine_alloc(n, n, n, 1.0, 1.0, 1.0, 1.0, 0.4))) {
+                bench_skip(b, "out of memory");
+                continue;
+            }
+            bench_seed();
+            bench_fill(wave_engine_u(e), n * n * n, 1.0);
+            memcpy(wave_engine_u_prev(e), wave_engine_u(e), n * n * n * sizeof(double));
+            wave_engine_set_threads(e, threads[k] > 1 ? threads[k] : 0);
+            while (bench_next(b)) wave_engine_step(e, 1);
+            wave_engine_free(e);
+        }
+}
+
+/* ---------------- Circuits ---------------- */
+
+/* A k x k mesh of resistors, node 1 driven at 1 V, the far corner
+   grounded: k^2 + 1 nodes, ground included */
+static circuit_netlist *bench_mesh(size_t k) {
+    circuit_netlist *net = circuit_netlist_alloc(0, k * k + 1);
+    circuit_element el;
+    int ok = net != NULL;
+    memset(&el, 0, sizeof(el));
+    el.type = CIRCUIT_VOLTAGE_SOURCE;
+    el.node1 = 1;
+    el.value = 1.0;
+    ok = ok && circuit_netlist_add_element(net, &el) >= 0;
+    el.type = CIRCUIT_RESISTOR;
+    bench_seed();
+    for (size_t y = 0; y < k && ok; y++)
+        for (size_t x = 0; x < k && ok; x++) {
+            const int at = (int)(1 + y * k + x);
+            el.node1 = at;
+            el.value = 1e3 * (1.5 + 0.5 * bench_random());
+            if (x + 1 < k) {
+                el.node2 = at + 1;
+                ok = circuit_netlist_add_element(net, &el) >= 0;
+            }
+            if (y + 1 < k && ok) {
+                el.node2 = at + (int)k;
+                ok = circuit_netlist_add_element(net, &el) >= 0;
+            }
+        }
+    el.node1 = (int)(k * k);
+    el.node2 = 0;
+    el.value = 50;
+    if (ok && circuit_netlist_add_element(net, &el) >= 0) return net;
+    circuit_netlist_free(net);
+    return NULL;
+}
+
+static void bench_circuits(struct bench *b) {
+    static const size_t sizes[] = {16, 32, 64};
+    const size_t n_sizes = bench_quick(b) ? 1 : 3;
+    int threads[16];
+    const size_t n_threads = bench_thread_counts(b, threads, 16);
+    for (size_t s = 0; s < n_sizes; s++) {
+        const size_t k = sizes[s];
+        circuit_netlist *net;
+        gsl_vector *v;
+        if (bench_begin(b, 1, "solves/s", "circuit_dc_analysis/mesh=%zux%zu", k, k)) continue;
+        if (!(net = bench_mesh(k)) || !(v = gsl_vector_alloc(net->n_nodes))) {
+            circuit_netlist_free(net);
+            bench_skip(b, "out of memory");
+            continue;
+        }
+        while (bench_next(b)) circuit_dc_analysis(net, v);
+        gsl_vector_free(v);
+        circuit_netlist_free(net);
+    }
+    for (size_t k = 0; k < n_threads; k++) {
+        const size_t runs = 256;
+        circuit_mc_options opt = {BENCH_SEED, CIRCUIT_MC_SIGMA, threads[k] > 1 ? threads[k] : 0};
+        circuit_netlist *net;
+        gsl_matrix *results;
+        if (bench_begin(b, (double)runs, "runs/s", "circuit_monte_carlo_run/mesh=16x16/threads=%d", threads[k]))
+            continue;
+        if (!(net = bench_mesh(16)) || !(results = gsl_matrix_alloc(runs, net->n_nodes))) {
+            circuit_netlist_free(net);
+            bench_skip(b, "out of memory");
+            continue;
+        }
+        while (bench_next(b)) circuit_monte_carlo_run(net, runs, &opt, results);
+        gsl_matrix_free(results);
+        circuit_netlist_free(net);
+    }
+}
+
+/* ---------------- Decay ---------------- */
+
+struct bench_network {
+    nd_system_t system;
+    nd_nucleus_t *nuclei;
+    nd_decay_chain_t *chains;
+    nd_decay_branch_t *branches;
+    nd_decay_chain_t **chain_list;
+    nd_decay_branch_t **branch_list;
+    nd_nucleus_t **nucleus_list;
+};
+
+static void bench_network_free(struct bench_network *w) {
+    if (!w) return;
+    free(w->nuclei);
+    free(w->chains);
+    free(w->branches);
+    free(w->chain_list);
+    free(w->branch_list);
+    free(w->nucleus_list);
+    free(w);
+}
+
+static struct bench_network *bench_network(size_t n) {
+    struct bench_network *w = calloc(1, sizeof(*w));
+    const size_t n_chains = n > 1 ? n - 1 : 0;
+    if (!w) return NULL;
+    w->nuclei = calloc(n, sizeof(*w->nuclei));
+    w->nucleus_list = calloc(n, sizeof(*w->nucleus_list));
+    w->chains = calloc(n_chains ? n_chains : 1, sizeof(*w->chains));
+    w->chain_list = calloc(n_chains ? n_chains : 1, sizeof(*w->chain_list));
+    w->branches = calloc(2 * n, sizeof(*w->branches));
+    w->branch_list = calloc(2 * n, sizeof(*w->branch_list));
+    if (!w->nuclei || !w->nucleus_list || !w->chains || !w->chain_list || !w->branches || !w->branch_list) {
+        bench_network_free(w);
+        return NULL;
+    }
+    for (size_t i = 0; i < n; i++) {
+        nd_nucleus_t *nu = &w->nuclei[i];
+        snprintf(nu->symbol, sizeof(nu->symbol), "X%zu", i % 1000);
+        nu->Z = 80 + (int)(i % 20);
+        nu->N = 120 + (int)i;
+        w->nucleus_list[i] = nu;
+    }
+    for (size_t i = 0; i < n_chains; i++) {
+        nd_decay_chain_t *c = &w->chains[i];
+        const double half_life = pow(10.0, -3.0 + 12.0 * (double)i / (double)n_chains);
+        const size_t n_branches = i + 2 < n ? 2 : 1;
+        c->parent = &w->nuclei[i];
+        c->branches = &w->branch_list[2 * i];
+        c->n_branches = n_branches;
+        for (size_t k = 0; k < n_branches; k++) {
+            nd_decay_branch_t *br = &w->branches[2 * i + k];
+            br->mode = k ? ND_DECAY_ALPHA : ND_DECAY_BETA_MINUS;
+            br->branching_ratio = n_branches == 1 ? 1.0 : k ? 0.3 : 0.7;
+            br->half_life = half_life;
+            br->daughter = &w->nuclei[i + 1 + k];
+            c->branches[k] = br;
+        }
+        w->chain_list[i] = c;
+    }
+    w->system.nuclei = w->nucleus_list;
+    w->system.n_nuclei = n;
+    w->system.chains = w->chain_list;
+    w->system.n_chains = n_chains;
+    return w;
+}
+
+static void bench_decay(struct bench *b) {
+    static const size_t sizes[] = {64, 512, 4096};
+    const size_t n_sizes = bench_quick(b) ? 1 : 3;
+    const int top = (int)bench_threads(b);
+    for (size_t s = 0; s < n_sizes; s++)
+        for (int refactor = 0; refactor < 2; refactor++)
+            for (int t = 1; t <= top; t = t == top ? top + 1 : top) {   /* 1, then top */
+                const size_t n = sizes[s];
+                struct bench_network *w;
+                nd_depletion_t *dep = NULL;
+                double *x, dt = 3600;
+                if (bench_begin(b, (double)n, "nuclides/s", "nd_depletion_step/n=%zu%s/threads=%d", n,
+                                refactor ? "/new_dt" : "", t))
+                    continue;
+                if (!(w = bench_network(n)) || !(dep = nd_depletion_alloc(&w->system)) ||
+                    !(x = calloc(n, sizeof(double)))) {
+                    nd_depletion_free(dep);
+                    bench_network_free(w);
+                    bench_skip(b, "out of memory");
+                    continue;
+                }
+                nd_depletion_set_threads(dep, t > 1 ? t : 0);
+                x[0] = 1e20;
+                while (bench_next(b)) {
+                    if (refactor) dt = dt == 3600 ? 3601 : 3600;   /* The factors go each step */
+                    nd_depletion_step(dep, dt, x, x);
+                    if (!(x[n - 1] < 1e30)) x[0] = 1e20;
+                }
+                free(x);
+                nd_depletion_free(dep);
+                bench_network_free(w);
+            }
+}
+
+/* ---------------- Models ---------------- */
+
+static void bench_models(struct bench *b) {
+    static const size_t layers[] = {64, 256, 256, 16};
+    static const size_t seq_lens[] = {32, 128};
+    const size_t batch = 64;
+    int threads[16];
+    const size_t n_threads = bench_thread_counts(b, threads, 16);
+    mlp_t *mlp;
+    double *in, *out;
+    if (!(in = malloc(batch * 128 * 64 * sizeof(double))) || !(out = malloc(batch * 128 * 64 * sizeof(double)))) {
+        free(in);
+        return;
+    }
+    bench_seed();
+    bench_fill(in, batch * 128 * 64, 1.0);
+    if (!bench_begin(b, 1, "samples/s", "mlp_forward/64-256-256-16")) {
+        if (!(mlp = mlp_alloc(layers, 3))) {
+            bench_skip(b, "out of memory");
+        } else {
+            while (bench_next(b)) mlp_forward(mlp, in, out);
+            mlp_free(mlp);
+        }
+    }
+    if (!bench_begin(b, (double)batch, "samples/s", "mlp_forward_batch/64-256-256-16/batch=%zu", batch)) {
+        if (!(mlp = mlp_alloc(layers, 3))) {
+            bench_skip(b, "out of memory");
+        } else {
+            while (bench_next(b)) mlp_forward_batch(mlp, in, batch, out);
+            mlp_free(mlp);
+        }
+    }
+    for (size_t s = 0; s < 2; s++)
+        for (size_t k = 0; k < n_threads; k++) {
+            static const size_t d_models[] = {64, 64}, heads[] = {4, 4}, d_ffs[] = {256, 256};
+            const size_t len = seq_lens[s];
+            transformer_t *tr;
+            if (bench_begin(b, (double)len, "tokens/s", "transformer_forward/d=64/layers=2/seq=%zu/threads=%d", len,
+                            threads[k]))
+                continue;
+            if (!(tr = transformer_alloc(d_models, heads, d_ffs, 2))) {
+                bench_skip(b, "out of memory");
+                continue;
+            }
+            tr->n_threads = threads[k] > 1 ? threads[k] : 0;
+            while (bench_next(b)) transformer_forward(tr, in, len, out);
+            transformer_free(tr);
+        }
+    free(in);
+    free(out);
+}
+
+/* ---------------- P2P ---------------- */
+
+/*
+    The message path end to end: holos_p2p_send_message on a loopback
+    link (HOLOS_P2P_ERR_AGAIN drained by a poll), holos_p2p_poll
+    coalescing the records into frames, parsing them back and handing
+    each message to the callback. Loopback links exist only without
+    GNUnet, so a GNUnet build skips the case.
+*/
+
+#define BENCH_PEER "bench-peer"
+
+static void bench_on_message(const struct holos_p2p_message_view *msg, void *cls) {
+    (void)msg;
+    (*(size_t *)cls)++;
+}
+
+static void bench_p2p(struct bench *b) {
+    static const size_t payloads[] = {64, 1024};
+    const size_t burst = 1024;
+    unsigned char payload[1024];
+    memset(payload, 0x5a, sizeof(payload));
+    for (size_t s = 0; s < 2; s++) {
+        struct holos_p2p_message msg;
+        size_t sent = 0, delivered = 0;
+        int failed = 0;
+        if (bench_begin(b, (double)burst, "messages/s", "p2p/send_message/payload=%zu", payloads[s])) continue;
+#ifdef HAVE_GNUNET
+        bench_skip(b, "GNUnet build: no loopback links");
+        continue;
+#endif
+        if (holos_p2p_init() != 0 || holos_p2p_connect(BENCH_PEER) != HOLOS_P2P_OK) {
+            bench_skip(b, "no loopback link");
+            holos_p2p_finalize();
+            continue;
+        }
+        holos_p2p_on_message(bench_on_message, &delivered);
+        while (holos_p2p_poll() > 0) { }        /* The link's announcements */
+        memset(&msg, 0, sizeof(msg));
+        msg.type = HOLOS_P2P_MSG_DATA;
+        msg.payload = payload;
+        msg.size = payloads[s];
+        delivered = 0;
+        while (!failed && bench_next(b)) {
+            for (size_t i = 0; i < burst && !failed; i++) {
+                int rc;
+                while ((rc = holos_p2p_send_message(BENCH_PEER, &msg)) == HOLOS_P2P_ERR_AGAIN) holos_p2p_poll();
+                failed = rc != HOLOS_P2P_OK;
+            }
+            sent += burst;
+            while (!failed && delivered < sent) failed = holos_p2p_poll() <= 0 && delivered < sent;
+        }
+        if (failed) bench_skip(b, "a message was refused or lost on the loopback link");
+        holos_p2p_finalize();
+    }
+}
+
+const struct bench_suite bench_suites[] = {
+    {"dynamics", bench_dynamics},
+    {"fdtd", bench_fdtd},
+    {"circuits", bench_circuits},
+    {"decay", bench_decay},
+    {"models", bench_models},
+    {"p2p", bench_p2p},
+    {NULL, NULL}
+};
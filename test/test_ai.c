@@ -0,0 +1,1210 @@
+/* test_ai.c - Tests of the neural networks of HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+   ----------------------------------------------------------------------
+   A batch is held to its rows one at a time, forward and in the
+   optimizer step, and both convolution engines to a direct convolution
+   written out here. An RNN batch is held to its sequences, and a
+   truncated BPTT window to the same window replayed on its own. The
+   tiled attention is held to a whole causal softmax written out here,
+   forward and by finite differences, on any number of threads; session
+   steps to the rows of a forward over the positions still cached. Data-
+   parallel GAN training is held to the serial one, and to itself summed
+   across identical peers. Models planned in one arena are held to
+   unplanned ones, with the arena left as large as the largest pass.
+   Model files are held to what was written, mapped and private, and
+   loaded models to the saved ones, version 1 MLP streams included. An
+   INT8 map is held to the rounding bound of its weights and inputs on
+   every instruction set this CPU has, and quantized models to the FP64
+   ones and to their files. FP32 and BF16 models are held to the FP64
+   one allocated from the same seed, forward and in training; files keep
+   the precision they were saved in, and loading into another precision
+   converts.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "core/ai/ai_int8.h"
+#include "core/ai/ai_model.h"
+#include "core/ai/cnn.h"
+#include "core/ai/gan.h"
+#include "core/ai/mlp.h"
+#include "core/ai/rnn.h"
+#include "core/ai/transformer.h"
+#include "tests.h"
+
+static double test_max_diff(const double *a, const double *b, size_t n) {
+    double m = 0.0;
+    for (size_t k = 0; k < n; k++)
+        if (fabs(a[k] - b[k]) > m) m = fabs(a[k] - b[k]);
+    return m;
+}
+
+/* The same relative to the largest |b| */
+static double test_rel_diff(const double *a, const double *b, size_t n) {
+    double m = 0.0;
+    for (size_t k = 0; k < n; k++)
+        if (fabs(b[k]) > m) m = fabs(b[k]);
+    return test_max_diff(a, b, n) / (m > 0.0 ? m : 1.0);
+}
+
+/* ---------------- MLP ---------------- */
+
+#define TEST_MLP_B 16
+
+void test_mlp_batch(struct test *t) {
+    const size_t sizes[4] = { 4, 7, 5, 3 };
+    static double x[TEST_MLP_B * 4], tg[TEST_MLP_B * 3], y[TEST_MLP_B * 3], row[3], rows[TEST_MLP_B * 4];
+    mlp_t *a = mlp_alloc(sizes, 3), *b = mlp_alloc(sizes, 3);
+    double loss = 0.0, want = 0.0, moved = 0.0, w0[4 * 7];
+    for (size_t k = 0; k < TEST_MLP_B * 4; k++) x[k] = sin(0.7 * (double)k);
+    for (size_t k = 0; k < TEST_MLP_B * 3; k++) tg[k] = 0.4 * cos(0.3 * (double)k);
+    if (!a || !b) {
+        TEST_CHECK(t, 0, "cannot allocate the models");
+        mlp_free(a);
+        mlp_free(b);
+        return;
+    }
+
+    /* One GEMM over the batch is the rows one at a time */
+    TEST_CHECK(t, mlp_forward_batch(a, x, TEST_MLP_B, y) == 0, "batch forward");
+    for (size_t r = 0; r < TEST_MLP_B; r++) {
+        mlp_forward(a, x + r * 4, row);
+        TEST_CHECK(t, test_max_diff(row, y + r * 3, 3) < 1e-14, "row %zu off the batch by %g", r,
+                   test_max_diff(row, y + r * 3, 3));
+        for (size_t j = 0; j < 3; j++) want += 0.5 * (y[r * 3 + j] - tg[r * 3 + j]) * (y[r * 3 + j] - tg[r * 3 + j]);
+    }
+
+    /* The loss is that of the batch before the step */
+    TEST_CHECK(t, mlp_train_batch(a, x, tg, TEST_MLP_B, 0.1, &loss) == 0, "batch training");
+    TEST_CHECK(t, fabs(loss - want / TEST_MLP_B) < 1e-12, "loss %.17g, want %.17g", loss, want / TEST_MLP_B);
+
+    /* A batch of one example repeated averages to the step on it alone */
+    for (size_t r = 0; r < TEST_MLP_B; r++) memcpy(rows + r * 4, x, 4 * sizeof(double));
+    for (size_t r = 0; r < TEST_MLP_B; r++) memcpy(y + r * 3, tg, 3 * sizeof(double));
+    mlp_free(a);
+    a = mlp_alloc(sizes, 3);
+    if (!a) {
+        TEST_CHECK(t, 0, "cannot allocate the model");
+        mlp_free(b);
+        return;
+    }
+    mlp_train_batch(a, rows, y, TEST_MLP_B, 0.1, NULL);
+    mlp_train(b, x, tg, 0.1);
+    for (size_t l = 0; l < 3; l++)
+        TEST_CHECK(t, test_max_diff(a->layers[l].weights, b->layers[l].weights, sizes[l] * sizes[l + 1]) < 1e-14,
+                   "layer %zu of the repeated batch off the single step by %g", l,
+                   test_max_diff(a->layers[l].weights, b->layers[l].weights, sizes[l] * sizes[l + 1]));
+
+    /* Adam's first step moves every weight with a gradient by lr */
+    mlp_free(b);
+    b = mlp_alloc(sizes, 3);
+    if (!b || mlp_set_optimizer(b, MLP_OPT_ADAM, 0.9, 0.999, 1e-12) != 0) {
+        TEST_CHECK(t, 0, "cannot set up Adam");
+        mlp_free(a);
+        mlp_free(b);
+        return;
+    }
+    memcpy(w0, b->layers[0].weights, sizeof(w0));
+    mlp_train_batch(b, x, tg, TEST_MLP_B, 1e-3, NULL);
+    for (size_t k = 0; k < 4 * 7; k++)
+        if (fabs(fabs(b->layers[0].weights[k] - w0[k]) - 1e-3) > moved)
+            moved = fabs(fabs(b->layers[0].weights[k] - w0[k]) - 1e-3);
+    TEST_CHECK(t, b->step == 1 && moved < 1e-6, "Adam step %zu, |dw| off lr by %g", b->step, moved);
+
+    /* And every optimizer learns the batch */
+    for (int o = MLP_OPT_SGD; o <= MLP_OPT_ADAM; o++) {
+        mlp_t *m = mlp_alloc(sizes, 3);
+        double first = 0.0, last = 0.0;
+        if (!m || mlp_set_optimizer(m, (mlp_optimizer_t)o, 0.9, 0.999, 1e-8) != 0) {
+            TEST_CHECK(t, 0, "cannot set up optimizer %d", o);
+            mlp_free(m);
+            continue;
+        }
+        for (int e = 0; e < 200; e++) mlp_train_batch(m, x, tg, TEST_MLP_B, o == MLP_OPT_ADAM ? 0.01 : 0.05, e ? &last : &first);
+        TEST_CHECK(t, last < 0.5 * first, "optimizer %d: loss %g -> %g", o, first, last);
+        mlp_free(m);
+    }
+    mlp_free(a);
+    mlp_free(b);
+}
+
+/* ---------------- CNN ---------------- */
+
+/* y = conv(x) + b at the layer's extent, zero "same" padding */
+static void test_conv(const cnn_layer_t *ly, size_t h, size_t w, const double *x, double *y) {
+    const size_t k = ly->kernel_size, r = k / 2;
+    for (size_t o = 0; o < ly->output_channels; o++)
+        for (size_t i = 0; i < h; i++)
+            for (size_t j = 0; j < w; j++) {
+                double sum = ly->biases[o];
+                for (size_t c = 0; c < ly->input_channels; c++)
+                    for (size_t u = 0; u < k; u++)
+                        for (size_t v = 0; v < k; v++) {
+                            const long ii = (long)(i + u) - (long)r, jj = (long)(j + v) - (long)r;
+                            if (ii < 0 || jj < 0 || ii >= (long)h || jj >= (long)w) continue;
+                            sum += ly->kernels[((o * ly->input_channels + c) * k + u) * k + v]
+                                   * x[(c * h + (size_t)ii) * w + (size_t)jj];
+                        }
+                y[(o * h + i) * w + j] = sum;
+            }
+}
+
+#define TEST_CNN_H 7                        /* Odd, so the Winograd tiles overhang */
+#define TEST_CNN_W 9
+
+void test_cnn_engines(struct test *t) {
+    const size_t cin[3] = { 2, 4, 3 }, cout[3] = { 4, 3, 2 }, ks[3] = { 3, 5, 3 };
+    const size_t hw = TEST_CNN_H * TEST_CNN_W;
+    static double x[2 * TEST_CNN_H * TEST_CNN_W], tg[2 * TEST_CNN_H * TEST_CNN_W];
+    static double a[4 * TEST_CNN_H * TEST_CNN_W], b[4 * TEST_CNN_H * TEST_CNN_W], y[2][2 * TEST_CNN_H * TEST_CNN_W];
+    cnn_t *cnn[2];
+    for (size_t k = 0; k < 2 * hw; k++) {
+        x[k] = sin(0.41 * (double)k);
+        tg[k] = 0.3 * cos(0.17 * (double)k);
+    }
+
+    /* The two engines against the direct form */
+    memcpy(a, x, sizeof(x));
+    for (int e = 0; e < 2; e++) {
+        cnn[e] = cnn_alloc(cin, cout, ks, 3);
+        if (!cnn[e] || cnn_set_input(cnn[e], TEST_CNN_H, TEST_CNN_W) != 0) {
+            TEST_CHECK(t, 0, "cannot set up the CNN");
+            cnn_free(cnn[e]);
+            if (e) cnn_free(cnn[0]);
+            return;
+        }
+        cnn[e]->winograd = e == 0;
+        /* Biases of their own, so that they are checked too */
+        for (size_t l = 0; l < 3; l++)
+            for (size_t o = 0; o < cout[l]; o++) cnn[e]->layers[l].biases[o] = 0.05 * (double)(o + l);
+        cnn_forward(cnn[e], x, y[e]);
+    }
+    for (size_t l = 0; l < 3; l++) {
+        test_conv(&cnn[0]->layers[l], TEST_CNN_H, TEST_CNN_W, a, b);
+        if (l < 2)
+            for (size_t k = 0; k < cout[l] * hw; k++) b[k] = tanh(b[k]);
+        memcpy(a, b, cout[l] * hw * sizeof(double));
+    }
+    TEST_CHECK(t, test_max_diff(y[0], a, 2 * hw) < 1e-12, "Winograd off the direct form by %g", test_max_diff(y[0], a, 2 * hw));
+    TEST_CHECK(t, test_max_diff(y[1], a, 2 * hw) < 1e-12, "im2col off the direct form by %g", test_max_diff(y[1], a, 2 * hw));
+
+    /* Training takes the same steps with either engine, and learns */
+    for (int s = 0; s < 20; s++)
+        for (int e = 0; e < 2; e++) cnn_train(cnn[e], x, tg, 1e-3);
+    for (size_t l = 0; l < 3; l++) {
+        const size_t n = cout[l] * cin[l] * ks[l] * ks[l];
+        TEST_CHECK(t, test_max_diff(cnn[0]->layers[l].kernels, cnn[1]->layers[l].kernels, n) < 1e-10,
+                   "layer %zu: the engines trained apart by %g", l,
+                   test_max_diff(cnn[0]->layers[l].kernels, cnn[1]->layers[l].kernels, n));
+    }
+    cnn_forward(cnn[1], x, y[1]);
+    TEST_CHECK(t, test_max_diff(y[1], tg, 2 * hw) < test_max_diff(a, tg, 2 * hw), "training did not learn: %g -> %g",
+               test_max_diff(a, tg, 2 * hw), test_max_diff(y[1], tg, 2 * hw));
+    cnn_free(cnn[0]);
+    cnn_free(cnn[1]);
+}
+
+/* ---------------- RNN ---------------- */
+
+/* Every parameter of an FP64 model, layer after layer */
+static size_t test_rnn_params(const rnn_t *rnn, double *out) {
+    size_t n = 0;
+    for (size_t l = 0; l < rnn->num_layers; l++) {
+        const rnn_layer_t *ly = &rnn->layers[l];
+        const size_t in = ly->input_size, h = ly->hidden_size, o = ly->output_size;
+        const double *src[5] = { ly->Wxh, ly->Whh, ly->Why, ly->bh, ly->by };
+        const size_t len[5] = { h * in, h * h, o * h, h, o };
+        for (int k = 0; k < 5; k++) {
+            memcpy(out + n, src[k], len[k] * sizeof(double));
+            n += len[k];
+        }
+    }
+    return n;
+}
+
+#define TEST_BPTT_T 8
+#define TEST_BPTT_B 3
+
+void test_rnn_batch(struct test *t) {
+    const size_t in[3] = { 3, 5, 2 }, hid[2] = { 6, 4 }, T = TEST_BPTT_T, B = TEST_BPTT_B;
+    static double x[TEST_BPTT_T * TEST_BPTT_B * 3], tg[TEST_BPTT_T * TEST_BPTT_B * 2], y[TEST_BPTT_T * TEST_BPTT_B * 2];
+    static double seq[TEST_BPTT_T * 3], tseq[TEST_BPTT_T * 2], row[TEST_BPTT_T * 2];
+    static double p0[256], p1[256], step[256];
+    rnn_t *a = rnn_alloc(in, hid, 2), *b;
+    double err = 0.0;
+    size_t np;
+    ai_arena_t *arena;
+    void *base;
+    TEST_CHECK(t, a != NULL, "cannot allocate the model");
+    if (!a) return;
+    for (size_t k = 0; k < T * B * 3; k++) x[k] = sin(0.29 * (double)k);
+    for (size_t k = 0; k < T * B * 2; k++) tg[k] = 0.4 * cos(0.13 * (double)k);
+
+    /* A time-major batch forward against every sequence on its own */
+    TEST_CHECK(t, rnn_forward_batch(a, x, B, T, y) == 0, "batch forward");
+    for (size_t s = 0; s < B; s++) {
+        for (size_t i = 0; i < T; i++) memcpy(seq + i * 3, x + (i * B + s) * 3, 3 * sizeof(double));
+        rnn_forward(a, seq, T, row);
+        for (size_t i = 0; i < T * 2; i++)
+            if (fabs(row[i] - y[(i / 2 * B + s) * 2 + i % 2]) > err) err = fabs(row[i] - y[(i / 2 * B + s) * 2 + i % 2]);
+    }
+    TEST_CHECK(t, err < 1e-14, "batch forward off the sequences by %g", err);
+
+    /* One step on the batch is the mean of the steps on its sequences */
+    np = test_rnn_params(a, p0);
+    memset(step, 0, sizeof(step));
+    for (size_t s = 0; s < B; s++) {
+        b = rnn_alloc(in, hid, 2);
+        if (!b) continue;
+        for (size_t i = 0; i < T; i++) {
+            memcpy(seq + i * 3, x + (i * B + s) * 3, 3 * sizeof(double));
+            memcpy(tseq + i * 2, tg + (i * B + s) * 2, 2 * sizeof(double));
+        }
+        rnn_train(b, seq, tseq, T, 0.05);
+        test_rnn_params(b, p1);
+        for (size_t k = 0; k < np; k++) step[k] += (p1[k] - p0[k]) / (double)B;
+        rnn_free(b);
+    }
+    TEST_CHECK(t, rnn_train_batch(a, x, tg, B, T, 0.05, NULL) == 0, "batch training");
+    test_rnn_params(a, p1);
+    err = 0.0;
+    for (size_t k = 0; k < np; k++)
+        if (fabs(p1[k] - p0[k] - step[k]) > err) err = fabs(p1[k] - p0[k] - step[k]);
+    TEST_CHECK(t, err < 1e-14, "batch step off the mean step by %g", err);
+
+    /* The BPTT buffers stay with the model for calls of the same size or smaller */
+    TEST_CHECK(t, a->plan && a->plan->batch >= B && a->plan->length >= T, "no plan kept after training");
+    if (a->plan) {
+        arena = a->plan->arena;
+        base = arena->base;
+        rnn_train_batch(a, x, tg, B - 1, T - 2, 0.05, NULL);
+        TEST_CHECK(t, a->plan->arena == arena && arena->base == base, "smaller call reallocated the buffers");
+    }
+    rnn_free(a);
+}
+
+/* With Why = I and by = 0 a single layer outputs its hidden state, so
+   a window of truncated BPTT can be replayed as a sequence of its own
+   starting from the state the previous window ended in. */
+void test_rnn_bptt(struct test *t) {
+    const size_t in[2] = { 3, 4 }, hid = 4, T = TEST_BPTT_T, W = TEST_BPTT_T / 2;
+    double x[TEST_BPTT_T * 3], tg[TEST_BPTT_T * 4], y[TEST_BPTT_T * 4], p[3][256];
+    rnn_t *m[3];
+    size_t np = 0;
+    double err = 0.0, loss;
+    for (int k = 0; k < 3; k++) {
+        m[k] = rnn_alloc(in, &hid, 1);
+        if (!m[k]) continue;
+        for (size_t i = 0; i < hid * hid; i++) m[k]->layers[0].Why[i] = i % (hid + 1) == 0 ? 1.0 : 0.0;
+        memset(m[k]->layers[0].by, 0, hid * sizeof(double));
+    }
+    TEST_CHECK(t, m[0] && m[1] && m[2], "cannot allocate the models");
+    if (!m[0] || !m[1] || !m[2]) goto out;
+    for (size_t k = 0; k < T * 3; k++) x[k] = sin(0.47 * (double)k);
+
+    /* Error only in the second window: the first takes no step */
+    rnn_forward(m[0], x, T, y);
+    memcpy(tg, y, W * 4 * sizeof(double));
+    for (size_t k = W * 4; k < T * 4; k++) tg[k] = y[k] + 0.2 * cos(0.7 * (double)k);
+
+    m[0]->bptt_window = W;
+    TEST_CHECK(t, rnn_train_batch(m[0], x, tg, 1, T, 0.1, &loss) == 0, "windowed training");
+    memcpy(m[1]->hidden_state, y + (W - 1) * 4, hid * sizeof(double));
+    rnn_train(m[1], x + W * 3, tg + W * 4, T - W, 0.1);
+    rnn_train(m[2], x, tg, T, 0.1);
+    for (int k = 0; k < 3; k++) np = test_rnn_params(m[k], p[k]);
+    for (size_t k = 0; k < np; k++)
+        if (fabs(p[0][k] - p[1][k]) > err) err = fabs(p[0][k] - p[1][k]);
+    TEST_CHECK(t, err < 1e-14, "windowed step off the replayed window by %g", err);
+    TEST_CHECK(t, memcmp(p[0], p[2], np * sizeof(double)) != 0, "window did not cut the gradient");
+out:
+    for (int k = 0; k < 3; k++) rnn_free(m[k]);
+}
+
+/* ---------------- Transformer ---------------- */
+
+#define TEST_KV_N 20
+#define TEST_KV_W 6
+
+void test_transformer_session(struct test *t) {
+    const size_t d_models[2] = { 4, 4 }, heads[2] = { 2, 1 }, d_ffs[2] = { 8, 6 };
+    double x[TEST_KV_N * 4], y[TEST_KV_N * 4], z[TEST_KV_W * 4], row[4], last[4];
+    transformer_t *tr = transformer_alloc(d_models, heads, d_ffs, 2), *one = transformer_alloc(d_models, heads, d_ffs, 1);
+    transformer_session_t *s = transformer_session_alloc(tr, TEST_KV_N), *w = transformer_session_alloc(one, TEST_KV_W);
+    double err = 0.0;
+    TEST_CHECK(t, tr && one && s && w, "cannot allocate the models and sessions");
+    if (!tr || !one || !s || !w) goto out;
+    for (size_t k = 0; k < TEST_KV_N * 4; k++) x[k] = sin(0.53 * (double)k);
+
+    /* A cache as long as the sequence: every step is a row of the forward */
+    transformer_forward(tr, x, TEST_KV_N, y);
+    for (size_t i = 0; i < TEST_KV_N; i++) {
+        TEST_CHECK(t, transformer_session_step(s, x + 4 * i, row) == 0, "step %zu", i);
+        if (test_max_diff(row, y + 4 * i, 4) > err) err = test_max_diff(row, y + 4 * i, 4);
+    }
+    TEST_CHECK(t, err < 1e-12, "steps off the forward by %g", err);
+    TEST_CHECK(t, s->length == TEST_KV_N && s->position == TEST_KV_N, "cache %zu/%zu after %d steps", s->length,
+               s->position, TEST_KV_N);
+    transformer_session_reset(s);
+    transformer_session_step(s, x, row);
+    TEST_CHECK(t, test_max_diff(row, y, 4) < 1e-12 && s->length == 1, "reset kept the cache");
+
+    /* Past the window the oldest position is evicted: with one layer a
+       step equals the last row of a forward over the window */
+    err = 0.0;
+    for (size_t i = 0; i < TEST_KV_N; i++) {
+        size_t n = i + 1 < TEST_KV_W ? i + 1 : TEST_KV_W;
+        transformer_session_step(w, x + 4 * i, row);
+        transformer_forward(one, x + 4 * (i + 1 - n), n, y);
+        if (test_max_diff(row, y + 4 * (n - 1), 4) > err) err = test_max_diff(row, y + 4 * (n - 1), 4);
+    }
+    TEST_CHECK(t, err < 1e-12, "sliding window off the forward by %g", err);
+    TEST_CHECK(t, w->length == TEST_KV_W && w->position == TEST_KV_N, "cache %zu/%zu after %d steps", w->length,
+               w->position, TEST_KV_N);
+
+    /* An explicit eviction drops the oldest positions the same way */
+    transformer_session_evict(w, 4);
+    TEST_CHECK(t, w->length == TEST_KV_W - 4, "evicted cache holds %zu", w->length);
+    transformer_session_step(w, x, last);
+    memcpy(z, x + 4 * (TEST_KV_N - TEST_KV_W + 4), 4 * (TEST_KV_W - 4) * sizeof(double));
+    memcpy(z + 4 * (TEST_KV_W - 4), x, 4 * sizeof(double));
+    transformer_forward(one, z, TEST_KV_W - 3, y);
+    TEST_CHECK(t, test_max_diff(last, y + 4 * (TEST_KV_W - 4), 4) < 1e-12, "step after eviction off by %g",
+               test_max_diff(last, y + 4 * (TEST_KV_W - 4), 4));
+out:
+    transformer_session_free(s);
+    transformer_session_free(w);
+    transformer_free(tr);
+    transformer_free(one);
+}
+
+#define TEST_TR_N 70                        /* Over one attention tile */
+#define TEST_TR_D 8
+
+/* y = W x + b, W rows x cols (output x input) */
+static void test_linear(const double *W, const double *b, size_t rows, size_t cols, const double *x, double *y) {
+    for (size_t o = 0; o < rows; o++) {
+        y[o] = b[o];
+        for (size_t i = 0; i < cols; i++) y[o] += W[o * cols + i] * x[i];
+    }
+}
+
+/* One layer as transformer.h writes it, with the causal softmax of
+   every head taken whole */
+static void test_tr_layer(const transformer_layer_t *ly, const double *x, size_t n, double *y) {
+    const size_t d = ly->d_model, f = ly->d_ff, dh = d / ly->num_heads;
+    double *q = malloc(3 * n * d * sizeof(double)), *k = q + n * d, *v = k + n * d;
+    double *p = malloc(n * sizeof(double)), a[TEST_TR_D], x1[TEST_TR_D], z[32], r[TEST_TR_D];
+    for (size_t i = 0; i < n; i++) {
+        test_linear(ly->Wq, ly->bq, d, d, x + i * d, q + i * d);
+        test_linear(ly->Wk, ly->bk, d, d, x + i * d, k + i * d);
+        test_linear(ly->Wv, ly->bv, d, d, x + i * d, v + i * d);
+    }
+    for (size_t i = 0; i < n; i++) {
+        for (size_t h = 0; h < d; h += dh) {
+            double mx = -INFINITY, sum = 0.0;
+            for (size_t j = 0; j <= i; j++) {
+                p[j] = 0.0;
+                for (size_t c = h; c < h + dh; c++) p[j] += q[i * d + c] * k[j * d + c];
+                p[j] /= sqrt((double)dh);
+                if (p[j] > mx) mx = p[j];
+            }
+            for (size_t j = 0; j <= i; j++) sum += p[j] = exp(p[j] - mx);
+            for (size_t c = h; c < h + dh; c++) {
+                a[c] = 0.0;
+                for (size_t j = 0; j <= i; j++) a[c] += p[j] / sum * v[j * d + c];
+            }
+        }
+        test_linear(ly->Wo, ly->bo, d, d, a, x1);
+        for (size_t c = 0; c < d; c++) x1[c] += x[i * d + c];
+        test_linear(ly->Wff1, ly->bff1, f, d, x1, z);
+        for (size_t c = 0; c < f; c++) z[c] = z[c] > 0.0 ? z[c] : 0.0;
+        test_linear(ly->Wff2, ly->bff2, d, f, z, r);
+        for (size_t c = 0; c < d; c++) y[i * d + c] = x1[c] + r[c];
+    }
+    free(q);
+    free(p);
+}
+
+static double test_tr_loss(const transformer_layer_t *ly, const double *x, const double *tg, size_t n, double *y) {
+    double loss = 0.0;
+    test_tr_layer(ly, x, n, y);
+    for (size_t k = 0; k < n * ly->d_model; k++) loss += 0.5 * (y[k] - tg[k]) * (y[k] - tg[k]);
+    return loss;
+}
+
+void test_transformer_attention(struct test *t) {
+    const size_t d_model = TEST_TR_D, heads = 2, d_ff = 12, n = TEST_TR_N * TEST_TR_D;
+    static double x[3 * TEST_TR_N * TEST_TR_D], tg[TEST_TR_N * TEST_TR_D], y[3 * TEST_TR_N * TEST_TR_D];
+    static double ref[TEST_TR_N * TEST_TR_D], y2[3 * TEST_TR_N * TEST_TR_D];
+    transformer_t *a = transformer_alloc(&d_model, &heads, &d_ff, 1), *b = transformer_alloc(&d_model, &heads, &d_ff, 1);
+    double err = 0.0, *W[3];
+    TEST_CHECK(t, a && b, "cannot allocate the models");
+    if (!a || !b) goto out;
+    for (size_t k = 0; k < 3 * n; k++) x[k] = sin(0.37 * (double)k);
+    for (size_t k = 0; k < n; k++) tg[k] = 0.3 * cos(0.11 * (double)k);
+
+    /* The tiled online softmax against the whole one, every sequence */
+    a->n_threads = 0;
+    b->n_threads = 4;
+    TEST_CHECK(t, transformer_forward_batch(a, x, 3, TEST_TR_N, y) == 0, "serial forward");
+    for (size_t s = 0; s < 3; s++) {
+        test_tr_layer(&a->layers[0], x + s * n, TEST_TR_N, ref);
+        if (test_max_diff(y + s * n, ref, n) > err) err = test_max_diff(y + s * n, ref, n);
+    }
+    TEST_CHECK(t, err < 1e-12, "fused attention off the reference by %g", err);
+    TEST_CHECK(t, transformer_forward_batch(b, x, 3, TEST_TR_N, y2) == 0, "threaded forward");
+    TEST_CHECK(t, memcmp(y, y2, sizeof(y)) == 0, "forward depends on the thread count");
+
+    /* One SGD step of a single layer moves each weight by lr times its
+       gradient; the attention weights go through the tiled backward */
+    W[0] = a->layers[0].Wq;
+    W[1] = a->layers[0].Wk;
+    W[2] = a->layers[0].Wv;
+    err = 0.0;
+    for (int m = 0; m < 3; m++)
+        for (size_t k = 1; k < d_model * d_model; k += 7) {
+            const double w = W[m][k], h = 1e-5;
+            double lp, lm, g;
+            transformer_t *c = transformer_alloc(&d_model, &heads, &d_ff, 1);
+            if (!c) continue;
+            W[m][k] = w + h;
+            lp = test_tr_loss(&a->layers[0], x, tg, TEST_TR_N, y2);
+            W[m][k] = w - h;
+            lm = test_tr_loss(&a->layers[0], x, tg, TEST_TR_N, y2);
+            W[m][k] = w;
+            transformer_train(c, x, tg, TEST_TR_N, 1e-3);
+            g = (w - (m == 0 ? c->layers[0].Wq : m == 1 ? c->layers[0].Wk : c->layers[0].Wv)[k]) / 1e-3;
+            if (fabs(g - (lp - lm) / (2 * h)) > err) err = fabs(g - (lp - lm) / (2 * h));
+            transformer_free(c);
+        }
+    TEST_CHECK(t, err < 1e-6, "attention gradient off the finite difference by %g", err);
+
+    /* Training takes the same steps on any number of threads */
+    for (int e = 0; e < 5; e++) {
+        transformer_train(a, x, tg, TEST_TR_N, 1e-3);
+        transformer_train(b, x, tg, TEST_TR_N, 1e-3);
+    }
+    TEST_CHECK(t, memcmp(a->layers[0].Wq, b->layers[0].Wq, d_model * d_model * sizeof(double)) == 0 &&
+                  memcmp(a->layers[0].Wv, b->layers[0].Wv, d_model * d_model * sizeof(double)) == 0,
+               "training depends on the thread count");
+out:
+    transformer_free(a);
+    transformer_free(b);
+}
+
+/* ---------------- GAN ---------------- */
+
+static gan_t *test_gan(int n_threads) {
+    const size_t gs[3] = { 3, 8, 4 }, ds[3] = { 4, 6, 1 };
+    mlp_t *g = mlp_alloc(gs, 2), *d = mlp_alloc(ds, 2);
+    gan_t *gan = g && d ? gan_alloc(g, d) : NULL;
+    if (!gan) {
+        mlp_free(g);
+        mlp_free(d);
+        return NULL;
+    }
+    gan->n_threads = n_threads;
+    return gan;
+}
+
+/* Two identical peers: the sum across them is twice the local one */
+static int test_gan_twice(void *ctx, double *grad, size_t n) {
+    (*(int *)ctx)++;
+    for (size_t k = 0; k < n; k++) grad[k] *= 2.0;
+    return 0;
+}
+
+static int test_gan_fail(void *ctx, double *grad, size_t n) {
+    (void)ctx;
+    (void)grad;
+    (void)n;
+    return -1;
+}
+
+#define TEST_GAN_B 13                       /* Uneven shards on 2 and 4 threads */
+
+void test_gan_train(struct test *t) {
+    static const int threads[4] = { 0, 2, 4, 4 };
+    double real[TEST_GAN_B * 4], z[5 * 3], y[5][5 * 4], loss[5][2];
+    gan_t *gan[5] = { NULL };
+    int calls = 0;
+    for (size_t k = 0; k < TEST_GAN_B * 4; k++) real[k] = 0.5 + 0.3 * sin(0.9 * (double)k);
+    for (size_t k = 0; k < 5 * 3; k++) z[k] = cos(1.3 * (double)k);
+    for (int m = 0; m < 5; m++) {
+        gan[m] = test_gan(m < 4 ? threads[m] : 0);
+        if (!gan[m]) {
+            TEST_CHECK(t, 0, "cannot allocate the GANs");
+            goto out;
+        }
+    }
+    gan[4]->reduce = test_gan_twice;
+    gan[4]->reduce_ctx = &calls;
+
+    for (int m = 0; m < 5; m++) {
+        for (int e = 0; e < 5; e++) TEST_CHECK(t, gan_train(gan[m], real, TEST_GAN_B, 0.05) == 0, "GAN %d step %d", m, e);
+        gan_generate_batch(gan[m], z, 5, y[m]);
+        loss[m][0] = gan[m]->d_loss;
+        loss[m][1] = gan[m]->g_loss;
+    }
+
+    /* The sharding changes the order of the sums only */
+    for (int m = 1; m < 3; m++)
+        TEST_CHECK(t, test_max_diff(y[m], y[0], 5 * 4) < 1e-12 && fabs(loss[m][0] - loss[0][0]) < 1e-12 &&
+                      fabs(loss[m][1] - loss[0][1]) < 1e-12 && gan[m]->seed == gan[0]->seed,
+                   "%d threads off serial training by %g", threads[m], test_max_diff(y[m], y[0], 5 * 4));
+    TEST_CHECK(t, memcmp(y[3], y[2], sizeof(y[2])) == 0, "training on 4 threads not reproducible");
+    TEST_CHECK(t, isfinite(loss[0][0]) && loss[0][0] > 0.0 && loss[0][1] > 0.0, "losses %g %g", loss[0][0],
+               loss[0][1]);
+
+    /* Identical peers take the step of one alone; a failed reduction takes none */
+    TEST_CHECK(t, calls == 10 && memcmp(y[4], y[0], sizeof(y[0])) == 0, "peer sum off training alone (%d calls)",
+               calls);
+    gan[4]->reduce = test_gan_fail;
+    TEST_CHECK(t, gan_train(gan[4], real, TEST_GAN_B, 0.05) == -1, "failed reduction not reported");
+    gan_generate_batch(gan[4], z, 5, y[4]);
+    TEST_CHECK(t, memcmp(y[4], y[0], sizeof(y[0])) == 0, "failed reduction still stepped");
+
+    /* The file keeps the weights and the noise stream */
+    TEST_CHECK(t, gan_save(gan[0], test_path(t, "gan.bin")) == 0, "cannot save the GAN");
+    gan_free(gan[4]);
+    gan[4] = gan_load(test_path(t, "gan.bin"));
+    TEST_CHECK(t, gan[4] != NULL, "cannot load the GAN");
+    if (gan[4]) {
+        gan_generate(gan[0], y[0]);
+        gan_generate(gan[4], y[4]);
+        TEST_CHECK(t, memcmp(y[4], y[0], 4 * sizeof(double)) == 0, "loaded GAN generates another sample");
+    }
+out:
+    for (int m = 0; m < 5; m++) gan_free(gan[m]);
+}
+
+/* ---------------- Plans ---------------- */
+
+void test_ai_plan_pack(struct test *t) {
+    static const size_t bytes[6] = { 100, 1000, 64, 300, 1, 500 };
+    static const size_t first[6] = { 0, 2, 0, 1, 3, 4 }, last[6] = { 1, 3, 4, 2, 5, 5 };
+    ai_plan_t plan;
+    int overlap = 0;
+    ai_plan_init(&plan);
+    for (int k = 0; k < 6; k++) ai_plan_add(&plan, bytes[k], first[k], last[k]);
+    TEST_CHECK(t, ai_plan_add(&plan, 10, 3, 2) == -1, "tensor dead before it is live added");
+    TEST_CHECK(t, ai_plan_pack(&plan) == 0, "cannot pack the plan");
+
+    /* Aligned sizes and offsets, disjoint bytes for tensors live at once */
+    for (size_t i = 0; i < plan.count; i++) {
+        const ai_tensor_t *a = &plan.tensors[i];
+        TEST_CHECK(t, a->bytes % AI_PLAN_ALIGN == 0 && a->offset % AI_PLAN_ALIGN == 0 && a->bytes >= bytes[i],
+                   "tensor %zu: %zu bytes at %zu", i, a->bytes, a->offset);
+        TEST_CHECK(t, a->offset + a->bytes <= plan.bytes, "tensor %zu past the block", i);
+        for (size_t j = 0; j < i; j++) {
+            const ai_tensor_t *b = &plan.tensors[j];
+            if (a->first <= b->last && b->first <= a->last && a->offset < b->offset + b->bytes &&
+                b->offset < a->offset + a->bytes)
+                overlap = 1;
+        }
+    }
+    TEST_CHECK(t, !overlap, "tensors live at once share bytes");
+    /* Here the greedy packing is optimal: the block is the largest set
+       live at once, tensors 1, 3 and 2 at step 2 */
+    TEST_CHECK(t, plan.bytes == 1024 + 320 + 64, "block of %zu bytes", plan.bytes);
+    ai_plan_free(&plan);
+}
+
+/* Models planned in one arena run every pass in it, and each planned
+   model trains the same as an unplanned one from the same seed. */
+void test_ai_arena(struct test *t) {
+    const size_t sizes[3] = { 5, 9, 4 }, cin[2] = { 2, 3 }, cout[2] = { 3, 2 }, ks[2] = { 3, 3 };
+    const size_t rin[2] = { 3, 2 }, rhid = 5, d = 8, heads = 2, d_ff = 12;
+    static double x[2 * TEST_TR_N * TEST_TR_D], tg[2 * TEST_TR_N * TEST_TR_D], y[2][3 * TEST_TR_N * TEST_TR_D];
+    mlp_t *mlp[2] = { mlp_alloc(sizes, 2), mlp_alloc(sizes, 2) };
+    cnn_t *cnn[2] = { cnn_alloc(cin, cout, ks, 2), cnn_alloc(cin, cout, ks, 2) };
+    rnn_t *rnn[2] = { rnn_alloc(rin, &rhid, 1), rnn_alloc(rin, &rhid, 1) };
+    transformer_t *tr[2] = { transformer_alloc(&d, &heads, &d_ff, 1), transformer_alloc(&d, &heads, &d_ff, 1) };
+    ai_exec_plan_t *plans[4];
+    ai_arena_t arena;
+    size_t most = 0;
+    void *base;
+    ai_arena_init(&arena);
+    for (size_t k = 0; k < 2 * TEST_TR_N * TEST_TR_D; k++) {
+        x[k] = sin(0.31 * (double)k);
+        tg[k] = 0.3 * cos(0.23 * (double)k);
+    }
+    for (int m = 0; m < 2; m++)
+        if (!mlp[m] || !cnn[m] || !rnn[m] || !tr[m] || cnn_set_input(cnn[m], 6, 5) != 0) {
+            TEST_CHECK(t, 0, "cannot allocate the models");
+            goto out;
+        }
+
+    TEST_CHECK(t, mlp_plan(mlp[0], &arena, 8) == 0 && cnn_plan(cnn[0], &arena) == 0 &&
+                  rnn_plan(rnn[0], &arena, 3, 10) == 0 && transformer_plan(tr[0], &arena, 2, TEST_TR_N) == 0,
+               "cannot plan the models");
+    plans[0] = mlp[0]->plan;
+    plans[1] = cnn[0]->plan;
+    plans[2] = rnn[0]->plan;
+    plans[3] = tr[0]->plan;
+    for (int m = 0; m < 4; m++) {
+        TEST_CHECK(t, plans[m] && plans[m]->arena == &arena, "model %d not planned in the shared arena", m);
+        if (!plans[m]) goto out;
+        for (int p = 0; p < AI_PASS_COUNT; p++)
+            if (plans[m]->pass[p].bytes > most) most = plans[m]->pass[p].bytes;
+    }
+    TEST_CHECK(t, arena.size == most, "arena of %zu bytes for a largest pass of %zu", arena.size, most);
+    base = arena.base;
+
+    /* Every pass at the planned sizes or smaller, planned and not */
+    for (int m = 0; m < 2; m++) {
+        double *o = y[m];
+        for (int e = 0; e < 3; e++) {
+            mlp_train_batch(mlp[m], x, tg, e ? 5 : 8, 0.05, NULL);
+            cnn_train(cnn[m], x, tg, 1e-3);
+            rnn_train_batch(rnn[m], x, tg, 3, e ? 7 : 10, 0.05, NULL);
+            transformer_train(tr[m], x, tg, e ? 40 : TEST_TR_N, 1e-3);
+        }
+        mlp_forward_batch(mlp[m], x, 8, o);
+        cnn_forward(cnn[m], x, o + 8 * 4);
+        rnn_forward_batch(rnn[m], x, 3, 10, o + 8 * 4 + 2 * 30);
+        transformer_forward_batch(tr[m], x, 2, TEST_TR_N, o + 8 * 4 + 2 * 30 + 3 * 10 * 2);
+    }
+    TEST_CHECK(t, arena.base == base && arena.size == most, "planned passes grew the arena");
+    TEST_CHECK(t, mlp[0]->plan == plans[0] && cnn[0]->plan == plans[1] && rnn[0]->plan == plans[2] &&
+                  tr[0]->plan == plans[3], "planned passes replanned");
+    TEST_CHECK(t, memcmp(y[0], y[1], sizeof(y[0])) == 0, "planned models off the unplanned ones by %g",
+               test_max_diff(y[0], y[1], 3 * TEST_TR_N * TEST_TR_D));
+out:
+    for (int m = 0; m < 2; m++) {
+        mlp_free(mlp[m]);
+        cnn_free(cnn[m]);
+        rnn_free(rnn[m]);
+        transformer_free(tr[m]);
+    }
+    ai_arena_free(&arena);
+}
+
+/* ---------------- Files ---------------- */
+
+void test_ai_model(struct test *t) {
+    const uint64_t meta[3] = { 7, 1u << 20, 3 };
+    const double w[6] = { 1.5, -2.0, 0.25, 4.0, 5.0, -6.5 };
+    const int8_t q[5] = { -128, 0, 1, 2, 127 };
+    const ai_blob_t blobs[2] = { { AI_DTYPE_F64, 2, { 2, 3 }, w }, { AI_DTYPE_I8, 1, { 5 }, q } };
+    const char *path = test_path(t, "model.bin");
+    size_t shape[AI_MODEL_RANK];
+    ai_model_t *m;
+    double *mw;
+    int8_t *mq;
+    TEST_CHECK(t, ai_model_write(path, "HOLOSTST", 4, meta, 3, blobs, 2) == 0, "cannot write the file");
+    m = ai_model_open(path, "HOLOSTST");
+    TEST_CHECK(t, m != NULL, "cannot map the file");
+    if (!m) return;
+    TEST_CHECK(t, m->version == 4 && m->n_meta == 3 && memcmp(m->meta, meta, sizeof(meta)) == 0 && m->count == 2,
+               "header or meta changed by the file");
+    mw = ai_model_tensor(m, 0, AI_DTYPE_F64, 6);
+    mq = ai_model_tensor(m, 1, AI_DTYPE_I8, 5);
+    TEST_CHECK(t, mw && memcmp(mw, w, sizeof(w)) == 0 && mq && memcmp(mq, q, sizeof(q)) == 0,
+               "tensors changed by the file");
+    TEST_CHECK(t, mw && mq && (size_t)((unsigned char *)mw - m->map) % AI_MODEL_ALIGN == 0 &&
+                  (size_t)((unsigned char *)mq - m->map) % AI_MODEL_ALIGN == 0, "tensors not aligned in the file");
+    TEST_CHECK(t, ai_model_shape(m, 0, shape) == 2 && shape[0] == 2 && shape[1] == 3, "shape of tensor 0");
+    TEST_CHECK(t, ai_model_shape(m, 2, shape) == 0, "shape of a tensor past the table");
+    TEST_CHECK(t, ai_model_tensor(m, 0, AI_DTYPE_F32, 6) == NULL && ai_model_tensor(m, 1, AI_DTYPE_I8, 6) == NULL,
+               "tensor of the wrong type or size handed out");
+
+    /* The mapping is private: writing to it leaves the file alone */
+    if (mw) mw[0] = 99.0;
+    ai_model_close(m);
+    m = ai_model_open(path, "HOLOSTST");
+    mw = ai_model_tensor(m, 0, AI_DTYPE_F64, 6);
+    TEST_CHECK(t, mw && mw[0] == 1.5, "write to the mapping reached the file");
+    ai_model_close(m);
+
+    TEST_CHECK(t, ai_model_open(path, "HOLOSXXX") == NULL, "file opened under another magic");
+    TEST_CHECK(t, truncate(path, 100) == 0 && ai_model_open(path, "HOLOSTST") == NULL, "truncated file opened");
+}
+
+/* Version 1 of the MLP file: magic, u32 version, u64 layers, u64
+   sizes, then the weights and biases of each layer */
+static int test_mlp_stream(const mlp_t *mlp, const char *path) {
+    const uint32_t version = 1;
+    const uint64_t layers = mlp->num_layers;
+    FILE *fp = fopen(path, "wb");
+    int ok;
+    if (!fp) return -1;
+    ok = fwrite("HOLOSMLP", 1, 8, fp) == 8 && fwrite(&version, sizeof version, 1, fp) == 1 &&
+         fwrite(&layers, sizeof layers, 1, fp) == 1;
+    for (size_t l = 0; ok && l <= mlp->num_layers; l++) {
+        const uint64_t size = l < mlp->num_layers ? mlp->layers[l].input_size : mlp->layers[l - 1].output_size;
+        ok = fwrite(&size, sizeof size, 1, fp) == 1;
+    }
+    for (size_t l = 0; ok && l < mlp->num_layers; l++) {
+        const mlp_layer_t *ly = &mlp->layers[l];
+        ok = fwrite(ly->weights, sizeof(double), ly->input_size * ly->output_size, fp) ==
+                 ly->input_size * ly->output_size &&
+             fwrite(ly->biases, sizeof(double), ly->output_size, fp) == ly->output_size;
+    }
+    return fclose(fp) == 0 && ok ? 0 : -1;
+}
+
+static int test_mapped(const ai_model_t *file, const void *p) {
+    return file && (const unsigned char *)p >= file->map && (const unsigned char *)p < file->map + file->size;
+}
+
+void test_ai_model_files(struct test *t) {
+    const size_t sizes[3] = { 4, 6, 3 }, cin[2] = { 2, 3 }, cout[2] = { 3, 2 }, ks[2] = { 3, 3 };
+    const size_t d = TEST_TR_D, heads = 2, d_ff = 12;
+    static double x[TEST_TR_N * TEST_TR_D], tg[TEST_TR_N * TEST_TR_D], y[TEST_TR_N * TEST_TR_D], y2[TEST_TR_N * TEST_TR_D];
+    mlp_t *mlp = mlp_alloc(sizes, 2), *mb;
+    cnn_t *cnn = cnn_alloc(cin, cout, ks, 2), *cb;
+    transformer_t *tr = transformer_alloc(&d, &heads, &d_ff, 1), *tb;
+    for (size_t k = 0; k < TEST_TR_N * TEST_TR_D; k++) {
+        x[k] = sin(0.43 * (double)k);
+        tg[k] = 0.2 * cos(0.19 * (double)k);
+    }
+    TEST_CHECK(t, mlp && cnn && tr && cnn_set_input(cnn, 5, 4) == 0, "cannot allocate the models");
+    if (!mlp || !cnn || !tr) goto out;
+
+    /* Loaded models compute on the mapped arrays, and train on private copies of them */
+    mlp_forward_batch(mlp, x, 5, y);
+    TEST_CHECK(t, mlp_save(mlp, test_path(t, "mlp.bin")) == 0, "cannot save the MLP");
+    mb = mlp_load(test_path(t, "mlp.bin"));
+    TEST_CHECK(t, mb && test_mapped(mb->file, mb->layers[1].weights), "MLP not run from the mapped file");
+    if (mb) {
+        mlp_forward_batch(mb, x, 5, y2);
+        TEST_CHECK(t, memcmp(y, y2, 5 * 3 * sizeof(double)) == 0, "MLP changed by the file");
+        mlp_train_batch(mb, x, tg, 5, 0.1, NULL);
+        mlp_free(mb);
+    }
+    mb = mlp_load(test_path(t, "mlp.bin"));
+    if (mb) mlp_forward_batch(mb, x, 5, y2);
+    TEST_CHECK(t, mb && memcmp(y, y2, 5 * 3 * sizeof(double)) == 0, "training a loaded MLP changed its file");
+
+    /* A save over a mapped file leaves the model mapped from it alone */
+    mlp_train_batch(mlp, x, tg, 5, 0.1, NULL);
+    TEST_CHECK(t, mlp_save(mlp, test_path(t, "mlp.bin")) == 0, "cannot save over the mapped file");
+    if (mb) mlp_forward_batch(mb, x, 5, y2);
+    TEST_CHECK(t, mb && memcmp(y, y2, 5 * 3 * sizeof(double)) == 0, "save changed a model mapped from the old file");
+    mlp_free(mb);
+
+    /* Version 1 streams are still read */
+    mlp_forward_batch(mlp, x, 5, y);
+    TEST_CHECK(t, test_mlp_stream(mlp, test_path(t, "mlp1.bin")) == 0, "cannot write the version 1 file");
+    mb = mlp_load(test_path(t, "mlp1.bin"));
+    TEST_CHECK(t, mb && mb->file == NULL, "version 1 MLP not read");
+    if (mb) {
+        mlp_forward_batch(mb, x, 5, y2);
+        TEST_CHECK(t, memcmp(y, y2, 5 * 3 * sizeof(double)) == 0, "version 1 MLP changed by the file");
+        mlp_free(mb);
+    }
+
+    cnn_forward(cnn, x, y);
+    TEST_CHECK(t, cnn_save(cnn, test_path(t, "cnn.bin")) == 0, "cannot save the CNN");
+    cb = cnn_load(test_path(t, "cnn.bin"));
+    TEST_CHECK(t, cb && test_mapped(cb->file, cb->layers[0].kernels), "CNN not run from the mapped file");
+    if (cb) {
+        cnn_forward(cb, x, y2);
+        TEST_CHECK(t, cb->height == 5 && cb->width == 4 && memcmp(y, y2, 2 * 5 * 4 * sizeof(double)) == 0,
+                   "CNN changed by the file");
+        cnn_free(cb);
+    }
+
+    transformer_forward(tr, x, TEST_TR_N, y);
+    TEST_CHECK(t, transformer_save(tr, test_path(t, "tr.bin")) == 0, "cannot save the transformer");
+    tb = transformer_load(test_path(t, "tr.bin"));
+    TEST_CHECK(t, tb && test_mapped(tb->file, tb->layers[0].Wff2), "transformer not run from the mapped file");
+    if (tb) {
+        transformer_forward(tb, x, TEST_TR_N, y2);
+        TEST_CHECK(t, memcmp(y, y2, sizeof(y)) == 0, "transformer changed by the file");
+        transformer_free(tb);
+    }
+    TEST_CHECK(t, mlp_load(test_path(t, "tr.bin")) == NULL, "transformer file read as an MLP");
+out:
+    mlp_free(mlp);
+    cnn_free(cnn);
+    transformer_free(tr);
+}
+
+/* ---------------- INT8 ---------------- */
+
+#define TEST_I8_IN 70                       /* Over one AI_I8_PAD row */
+#define TEST_I8_OUT 9
+#define TEST_I8_ROWS 5
+
+void test_ai_int8(struct test *t) {
+    static const ai_i8_isa_t isas[3] = { AI_I8_ISA_AVX2, AI_I8_ISA_AVX512_VNNI, AI_I8_ISA_NEON_DOT };
+    static double w[TEST_I8_OUT * TEST_I8_IN], b[TEST_I8_OUT], x[TEST_I8_ROWS * TEST_I8_IN];
+    static double y[TEST_I8_ROWS * TEST_I8_OUT], yq[TEST_I8_ROWS * TEST_I8_OUT], yv[TEST_I8_ROWS * TEST_I8_OUT];
+    static uint8_t xq[TEST_I8_ROWS * 2 * AI_I8_PAD];    /* Rows of ai_i8_stride(TEST_I8_IN) */
+    const ai_i8_isa_t saved = ai_i8_active_isa();
+    ai_i8_linear_t lin;
+    ai_u8_quant_t q = ai_u8_range(-1.0, 1.5), none = { 1.0f, 0 };
+    double over = 0.0;
+    uint8_t zq;
+    for (size_t k = 0; k < TEST_I8_OUT * TEST_I8_IN; k++) w[k] = 0.3 * sin(0.77 * (double)k) * (1.0 + (double)(k / TEST_I8_IN));
+    for (size_t k = 0; k < TEST_I8_OUT; k++) b[k] = 0.1 * (double)k - 0.4;
+    for (size_t k = 0; k < TEST_I8_ROWS * TEST_I8_IN; k++) x[k] = -1.0 + 2.5 * fabs(sin(1.7 * (double)k));
+
+    /* Zero is exact in every activation range */
+    ai_u8_quantize((const double[]){ 0.0 }, 1, q, &zq);
+    TEST_CHECK(t, zq == q.zero && q.scale * (float)(zq - q.zero) == 0.0f, "0 quantized to %d (zero %d)", zq, q.zero);
+    TEST_CHECK(t, ai_u8_range(0.0, 0.0).scale == 1.0f && ai_u8_range(0.5, 2.0).zero == 0, "degenerate ranges");
+
+    /* Every output within the rounding of its weights and inputs */
+    TEST_CHECK(t, ai_i8_linear_init(&lin, TEST_I8_OUT, TEST_I8_IN, w, NULL, b, NULL) == 0, "cannot quantize the map");
+    memset(xq, 0, sizeof(xq));
+    for (size_t r = 0; r < TEST_I8_ROWS; r++) {
+        ai_u8_quantize(x + r * TEST_I8_IN, TEST_I8_IN, q, xq + r * lin.stride);
+        test_linear(w, b, TEST_I8_OUT, TEST_I8_IN, x + r * TEST_I8_IN, y + r * TEST_I8_OUT);
+    }
+    ai_i8_set_isa(AI_I8_ISA_SCALAR);
+    ai_i8_linear_forward(&lin, xq, TEST_I8_ROWS, q, AI_I8_LINEAR, none, NULL, 0, yq, 0);
+    for (size_t r = 0; r < TEST_I8_ROWS; r++)
+        for (size_t o = 0; o < TEST_I8_OUT; o++) {
+            double bound = 1e-5 * (1.0 + fabs(y[r * TEST_I8_OUT + o]));
+            for (size_t k = 0; k < TEST_I8_IN; k++)
+                bound += fabs(w[o * TEST_I8_IN + k]) * q.scale / 2 + fabs(x[r * TEST_I8_IN + k]) * lin.scale[o] / 2 +
+                         q.scale * lin.scale[o] / 4;
+            if (fabs(yq[r * TEST_I8_OUT + o] - y[r * TEST_I8_OUT + o]) - bound > over)
+                over = fabs(yq[r * TEST_I8_OUT + o] - y[r * TEST_I8_OUT + o]) - bound;
+        }
+    TEST_CHECK(t, over == 0.0, "int8 map over its error bound by %g", over);
+
+    /* The SIMD paths this CPU has agree with the portable one */
+    for (int i = 0; i < 3; i++) {
+        ai_i8_set_isa(isas[i]);
+        if (ai_i8_active_isa() != isas[i]) continue;
+        ai_i8_linear_forward(&lin, xq, TEST_I8_ROWS, q, AI_I8_LINEAR, none, NULL, 0, yv, 0);
+        TEST_CHECK(t, memcmp(yv, yq, sizeof(yv)) == 0, "%s off scalar by %g", ai_i8_isa_name(isas[i]),
+                   test_max_diff(yv, yq, TEST_I8_ROWS * TEST_I8_OUT));
+    }
+    ai_i8_set_isa(saved);
+    ai_i8_linear_free(&lin);
+}
+
+void test_mlp_q8(struct test *t) {
+    const size_t sizes[4] = { 6, 40, 20, 3 };
+    static double x[64 * 6], y[64 * 3], yq[64 * 3], y2[64 * 3];
+    mlp_t *mlp = mlp_alloc(sizes, 3);
+    mlp_q8_t *q = NULL, *back;
+    void *work;
+    TEST_CHECK(t, mlp != NULL, "cannot allocate the model");
+    if (!mlp) return;
+    for (size_t k = 0; k < 64 * 6; k++) x[k] = sin(0.61 * (double)k);
+
+    /* Calibrated on the first 48 rows, run on all 64 */
+    q = mlp_quantize(mlp, x, 48);
+    TEST_CHECK(t, q != NULL && q->num_layers == 3, "cannot quantize the model");
+    if (!q) goto out;
+    mlp_forward_batch(mlp, x, 64, y);
+    TEST_CHECK(t, mlp_q8_forward_batch(q, x, 64, yq, NULL) == 0, "int8 forward");
+    TEST_CHECK(t, test_rel_diff(yq, y, 64 * 3) < 3e-2, "int8 forward off FP64 by %g", test_rel_diff(yq, y, 64 * 3));
+    work = malloc(mlp_q8_work_size(q, 64));
+    if (work) {
+        mlp_q8_forward_batch(q, x, 64, y2, work);
+        TEST_CHECK(t, memcmp(y2, yq, sizeof(y2)) == 0, "int8 forward depends on its work memory");
+        free(work);
+    }
+
+    TEST_CHECK(t, mlp_q8_save(q, test_path(t, "mlp.q8")) == 0, "cannot save the int8 model");
+    back = mlp_q8_load(test_path(t, "mlp.q8"));
+    TEST_CHECK(t, back && back->file && (unsigned char *)back->layers[1].w >= back->file->map &&
+                  (unsigned char *)back->layers[1].w < back->file->map + back->file->size,
+               "int8 model not run from the mapped file");
+    if (back) {
+        mlp_q8_forward_batch(back, x, 64, y2, NULL);
+        TEST_CHECK(t, memcmp(y2, yq, sizeof(y2)) == 0, "int8 model changed by the file");
+        mlp_q8_free(back);
+    }
+    TEST_CHECK(t, mlp_q8_load(test_path(t, "missing.q8")) == NULL, "missing file loaded");
+out:
+    mlp_q8_free(q);
+    mlp_free(mlp);
+}
+
+void test_cnn_q8(struct test *t) {
+    const size_t cin[2] = { 2, 6 }, cout[2] = { 6, 2 }, ks[2] = { 3, 3 }, n = 2 * TEST_CNN_H * TEST_CNN_W;
+    static double x[4 * 2 * TEST_CNN_H * TEST_CNN_W], y[2 * TEST_CNN_H * TEST_CNN_W];
+    static double yq[2 * TEST_CNN_H * TEST_CNN_W], y2[2 * TEST_CNN_H * TEST_CNN_W];
+    cnn_t *cnn = cnn_alloc(cin, cout, ks, 2);
+    cnn_q8_t *q = NULL, *back;
+    double err = 0.0;
+    TEST_CHECK(t, cnn && cnn_set_input(cnn, TEST_CNN_H, TEST_CNN_W) == 0, "cannot allocate the model");
+    if (!cnn) return;
+    for (size_t k = 0; k < 4 * n; k++) x[k] = sin(0.37 * (double)k) + 0.2 * cos(2.1 * (double)k);
+
+    q = cnn_quantize(cnn, x, 3);
+    TEST_CHECK(t, q && q->height == TEST_CNN_H && q->width == TEST_CNN_W, "cannot quantize the model");
+    if (!q) goto out;
+    for (size_t m = 0; m < 4; m++) {
+        cnn_forward(cnn, x + m * n, y);
+        TEST_CHECK(t, cnn_q8_forward(q, x + m * n, yq, NULL) == 0, "int8 forward of map %zu", m);
+        if (test_rel_diff(yq, y, n) > err) err = test_rel_diff(yq, y, n);
+    }
+    TEST_CHECK(t, err < 3e-2, "int8 forward off FP64 by %g", err);
+
+    TEST_CHECK(t, cnn_q8_save(q, test_path(t, "cnn.q8")) == 0, "cannot save the int8 model");
+    back = cnn_q8_load(test_path(t, "cnn.q8"));
+    TEST_CHECK(t, back && back->file && back->height == TEST_CNN_H && back->width == TEST_CNN_W,
+               "int8 model not mapped with its extent");
+    if (back) {
+        cnn_q8_forward(back, x + 3 * n, y2, NULL);
+        TEST_CHECK(t, memcmp(y2, yq, sizeof(y2)) == 0, "int8 model changed by the file");
+        cnn_q8_free(back);
+    }
+out:
+    cnn_q8_free(q);
+    cnn_free(cnn);
+}
+
+/* ---------------- Precision ---------------- */
+
+/* Largest error of an FP32 and a BF16 forward against FP64, relative
+   to the largest output */
+static const double test_tolerance[3] = { 0.0, 1e-5, 5e-2 };
+static const char *const test_precision_name[3] = { "FP64", "FP32", "BF16" };
+
+void test_mlp_precision(struct test *t) {
+    const size_t sizes[4] = { 4, 7, 5, 3 }, n = TEST_MLP_B * 3;
+    static double x[TEST_MLP_B * 4], tg[TEST_MLP_B * 3], y0[3][TEST_MLP_B * 3], y[TEST_MLP_B * 3], y2[TEST_MLP_B * 3];
+    for (size_t k = 0; k < TEST_MLP_B * 4; k++) x[k] = sin(0.7 * (double)k);
+    for (size_t k = 0; k < n; k++) tg[k] = 0.4 * cos(0.3 * (double)k);
+
+    for (int p = 0; p < 3; p++) {
+        mlp_t *mlp = mlp_alloc_precision(sizes, 3, (ai_precision_t)p), *back;
+        double first = 0.0, last = 0.0;
+        if (!mlp) {
+            TEST_CHECK(t, 0, "cannot allocate the %s model", test_precision_name[p]);
+            continue;
+        }
+        TEST_CHECK(t, mlp_forward_batch(mlp, x, TEST_MLP_B, y0[p]) == 0, "%s forward", test_precision_name[p]);
+        if (p > 0)
+            TEST_CHECK(t, test_rel_diff(y0[p], y0[0], n) < test_tolerance[p], "%s forward off FP64 by %g",
+                       test_precision_name[p], test_rel_diff(y0[p], y0[0], n));
+        TEST_CHECK(t, p < 2 || memcmp(y0[2], y0[1], sizeof(y0[2])) != 0, "BF16 forward not rounded");
+
+        for (int e = 0; e < 100; e++) mlp_train_batch(mlp, x, tg, TEST_MLP_B, 0.05, e ? &last : &first);
+        TEST_CHECK(t, last < 0.5 * first, "%s loss %g -> %g", test_precision_name[p], first, last);
+
+        mlp_forward_batch(mlp, x, TEST_MLP_B, y);
+        TEST_CHECK(t, mlp_save(mlp, test_path(t, "mlp.bin")) == 0, "cannot save the %s model", test_precision_name[p]);
+        back = mlp_load(test_path(t, "mlp.bin"));
+        TEST_CHECK(t, back && back->precision == (ai_precision_t)p, "%s model not loaded in its precision",
+                   test_precision_name[p]);
+        if (back) {
+            mlp_forward_batch(back, x, TEST_MLP_B, y2);
+            TEST_CHECK(t, memcmp(y2, y, sizeof(y2)) == 0, "%s model changed by the file", test_precision_name[p]);
+            mlp_free(back);
+        }
+        back = mlp_load_precision(test_path(t, "mlp.bin"), p ? AI_PRECISION_FP64 : AI_PRECISION_FP32);
+        TEST_CHECK(t, back && back->precision == (p ? AI_PRECISION_FP64 : AI_PRECISION_FP32), "%s model not converted",
+                   test_precision_name[p]);
+        if (back) {
+            mlp_forward_batch(back, x, TEST_MLP_B, y2);
+            TEST_CHECK(t, test_rel_diff(y2, y, n) < test_tolerance[p ? p : 1], "converted %s model off by %g",
+                       test_precision_name[p], test_rel_diff(y2, y, n));
+            mlp_free(back);
+        }
+        mlp_free(mlp);
+    }
+}
+
+void test_cnn_precision(struct test *t) {
+    const size_t cin[2] = { 2, 4 }, cout[2] = { 4, 2 }, ks[2] = { 3, 5 }, n = 2 * TEST_CNN_H * TEST_CNN_W;
+    static double x[2 * TEST_CNN_H * TEST_CNN_W], tg[2 * TEST_CNN_H * TEST_CNN_W];
+    static double y0[3][2 * TEST_CNN_H * TEST_CNN_W], y[2 * TEST_CNN_H * TEST_CNN_W], y2[2 * TEST_CNN_H * TEST_CNN_W];
+    for (size_t k = 0; k < n; k++) {
+        x[k] = sin(0.41 * (double)k);
+        tg[k] = 0.3 * cos(0.17 * (double)k);
+    }
+
+    for (int p = 0; p < 3; p++) {
+        cnn_t *cnn = cnn_alloc_precision(cin, cout, ks, 2, (ai_precision_t)p), *back;
+        if (!cnn || cnn_set_input(cnn, TEST_CNN_H, TEST_CNN_W) != 0) {
+            TEST_CHECK(t, 0, "cannot set up the %s model", test_precision_name[p]);
+            cnn_free(cnn);
+            continue;
+        }
+        cnn_forward(cnn, x, y0[p]);
+        if (p > 0)
+            TEST_CHECK(t, test_rel_diff(y0[p], y0[0], n) < test_tolerance[p], "%s forward off FP64 by %g",
+                       test_precision_name[p], test_rel_diff(y0[p], y0[0], n));
+        TEST_CHECK(t, p < 2 || memcmp(y0[2], y0[1], sizeof(y0[2])) != 0, "BF16 forward not rounded");
+
+        for (int e = 0; e < 20; e++) cnn_train(cnn, x, tg, 1e-3);
+        cnn_forward(cnn, x, y);
+        TEST_CHECK(t, test_max_diff(y, tg, n) < test_max_diff(y0[p], tg, n), "%s error %g -> %g", test_precision_name[p],
+                   test_max_diff(y0[p], tg, n), test_max_diff(y, tg, n));
+
+        TEST_CHECK(t, cnn_save(cnn, test_path(t, "cnn.bin")) == 0, "cannot save the %s model", test_precision_name[p]);
+        back = cnn_load(test_path(t, "cnn.bin"));
+        TEST_CHECK(t, back && back->precision == (ai_precision_t)p, "%s model not loaded in its precision",
+                   test_precision_name[p]);
+        if (back) {
+            cnn_forward(back, x, y2);
+            TEST_CHECK(t, memcmp(y2, y, sizeof(y2)) == 0, "%s model changed by the file", test_precision_name[p]);
+            cnn_free(back);
+        }
+        back = cnn_load_precision(test_path(t, "cnn.bin"), p ? AI_PRECISION_FP64 : AI_PRECISION_FP32);
+        TEST_CHECK(t, back && back->precision == (p ? AI_PRECISION_FP64 : AI_PRECISION_FP32), "%s model not converted",
+                   test_precision_name[p]);
+        if (back) {
+            cnn_forward(back, x, y2);
+            TEST_CHECK(t, test_rel_diff(y2, y, n) < test_tolerance[p ? p : 1], "converted %s model off by %g",
+                       test_precision_name[p], test_rel_diff(y2, y, n));
+            cnn_free(back);
+        }
+        cnn_free(cnn);
+    }
+}
+
+#define TEST_RNN_T 12
+#define TEST_RNN_B 3
+
+void test_rnn_precision(struct test *t) {
+    const size_t in[3] = { 3, 5, 2 }, hid[2] = { 6, 4 }, n_out = TEST_RNN_T * TEST_RNN_B * 2;
+    static double x[TEST_RNN_T * TEST_RNN_B * 3], tg[TEST_RNN_T * TEST_RNN_B * 2];
+    static double y0[3][TEST_RNN_T * TEST_RNN_B * 2], y[TEST_RNN_T * TEST_RNN_B * 2], y2[TEST_RNN_T * TEST_RNN_B * 2];
+    for (size_t k = 0; k < sizeof(x) / sizeof(x[0]); k++) x[k] = sin(0.3 * (double)k);
+    for (size_t k = 0; k < n_out; k++) tg[k] = 0.5 * cos(0.2 * (double)k);
+
+    for (int p = 0; p < 3; p++) {
+        rnn_t *rnn = rnn_alloc_precision(in, hid, 2, (ai_precision_t)p), *back;
+        double first = 0.0, last = 0.0;
+        if (!rnn) {
+            TEST_CHECK(t, 0, "cannot allocate the %s model", test_precision_name[p]);
+            continue;
+        }
+        TEST_CHECK(t, rnn_forward_batch(rnn, x, TEST_RNN_B, TEST_RNN_T, y0[p]) == 0, "%s forward", test_precision_name[p]);
+        if (p > 0)
+            TEST_CHECK(t, test_rel_diff(y0[p], y0[0], n_out) < test_tolerance[p], "%s forward off FP64 by %g",
+                       test_precision_name[p], test_rel_diff(y0[p], y0[0], n_out));
+        TEST_CHECK(t, p < 2 || memcmp(y0[2], y0[1], sizeof(y0[2])) != 0, "BF16 forward not rounded");
+
+        /* Training in every precision, BPTT windows of 4 steps */
+        rnn->bptt_window = 4;
+        for (int e = 0; e < 60; e++) {
+            double loss = 0.0;
+            TEST_CHECK(t, rnn_train_batch(rnn, x, tg, TEST_RNN_B, TEST_RNN_T, 0.05, &loss) == 0, "%s training",
+                       test_precision_name[p]);
+            if (e == 0) first = loss;
+            last = loss;
+        }
+        TEST_CHECK(t, last < 0.5 * first, "%s loss %g -> %g", test_precision_name[p], first, last);
+
+        /* Saved in its precision, and loaded back into it or into FP64 */
+        rnn_forward_batch(rnn, x, TEST_RNN_B, TEST_RNN_T, y);
+        TEST_CHECK(t, rnn_save(rnn, test_path(t, "rnn.bin")) == 0, "cannot save the %s model", test_precision_name[p]);
+        back = rnn_load(test_path(t, "rnn.bin"));
+        TEST_CHECK(t, back && back->precision == (ai_precision_t)p, "%s model not loaded in its precision",
+                   test_precision_name[p]);
+        if (back) {
+            rnn_forward_batch(back, x, TEST_RNN_B, TEST_RNN_T, y2);
+            TEST_CHECK(t, memcmp(y2, y, sizeof(y2)) == 0, "%s model changed by the file", test_precision_name[p]);
+            TEST_CHECK(t, rnn_set_precision(back, p ? AI_PRECISION_FP64 : AI_PRECISION_FP32) == 0 && back->file == NULL,
+                       "mapped %s model not converted", test_precision_name[p]);
+            rnn_free(back);
+        }
+        back = rnn_load_precision(test_path(t, "rnn.bin"), p ? AI_PRECISION_FP64 : AI_PRECISION_FP32);
+        TEST_CHECK(t, back && back->precision == (p ? AI_PRECISION_FP64 : AI_PRECISION_FP32), "%s model not converted",
+                   test_precision_name[p]);
+        if (back) {
+            rnn_forward_batch(back, x, TEST_RNN_B, TEST_RNN_T, y2);
+            TEST_CHECK(t, test_rel_diff(y2, y, n_out) < test_tolerance[p ? p : 1], "converted %s model off by %g",
+                       test_precision_name[p], test_rel_diff(y2, y, n_out));
+            rnn_free(back);
+        }
+        rnn_free(rnn);
+    }
+}
+
+void test_transformer_precision(struct test *t) {
+    const size_t d_models[2] = { TEST_TR_D, TEST_TR_D }, heads[2] = { 2, 4 }, d_ffs[2] = { 16, 12 };
+    const size_t n = TEST_TR_N * TEST_TR_D;
+    static double x[TEST_TR_N * TEST_TR_D], tg[TEST_TR_N * TEST_TR_D];
+    static double y0[3][TEST_TR_N * TEST_TR_D], y[TEST_TR_N * TEST_TR_D], y2[TEST_TR_N * TEST_TR_D];
+    for (size_t k = 0; k < n; k++) {
+        x[k] = sin(0.37 * (double)k);
+        tg[k] = 0.3 * cos(0.11 * (double)k);
+    }
+
+    for (int p = 0; p < 3; p++) {
+        transformer_t *tr = transformer_alloc_precision(d_models, heads, d_ffs, 2, (ai_precision_t)p), *back;
+        transformer_session_t *s;
+        double first, last, row[TEST_TR_D];
+        if (!tr) {
+            TEST_CHECK(t, 0, "cannot allocate the %s model", test_precision_name[p]);
+            continue;
+        }
+        tr->n_threads = 2;
+        TEST_CHECK(t, transformer_forward_batch(tr, x, 1, TEST_TR_N, y0[p]) == 0, "%s forward", test_precision_name[p]);
+        if (p > 0)
+            TEST_CHECK(t, test_rel_diff(y0[p], y0[0], n) < test_tolerance[p], "%s forward off FP64 by %g",
+                       test_precision_name[p], test_rel_diff(y0[p], y0[0], n));
+        TEST_CHECK(t, p < 2 || memcmp(y0[2], y0[1], sizeof(y0[2])) != 0, "BF16 forward not rounded");
+
+        first = test_max_diff(y0[p], tg, n);
+        for (int e = 0; e < 40; e++) transformer_train(tr, x, tg, TEST_TR_N, 5e-4);
+        transformer_forward(tr, x, TEST_TR_N, y);
+        last = test_max_diff(y, tg, n);
+        TEST_CHECK(t, last < first, "%s error %g -> %g", test_precision_name[p], first, last);
+
+        /* A session computes in the model's precision too */
+        s = transformer_session_alloc(tr, TEST_TR_N);
+        TEST_CHECK(t, s != NULL, "cannot allocate a %s session", test_precision_name[p]);
+        for (size_t i = 0; s && i < TEST_TR_N; i++) {
+            const double *want = y + i * TEST_TR_D;
+            TEST_CHECK(t, transformer_session_step(s, x + i * TEST_TR_D, row) == 0, "%s step %zu", test_precision_name[p], i);
+            TEST_CHECK(t, test_rel_diff(row, want, TEST_TR_D) < test_tolerance[p ? p : 1], "%s step %zu off by %g",
+                       test_precision_name[p], i, test_rel_diff(row, want, TEST_TR_D));
+        }
+
+        TEST_CHECK(t, transformer_save(tr, test_path(t, "tr.bin")) == 0, "cannot save the %s model", test_precision_name[p]);
+        back = transformer_load(test_path(t, "tr.bin"));
+        TEST_CHECK(t, back && back->precision == (ai_precision_t)p, "%s model not loaded in its precision",
+                   test_precision_name[p]);
+        if (back) {
+            transformer_forward(back, x, TEST_TR_N, y2);
+            TEST_CHECK(t, memcmp(y2, y, sizeof(y2)) == 0, "%s model changed by the file", test_precision_name[p]);
+            transformer_free(back);
+        }
+        back = transformer_load_precision(test_path(t, "tr.bin"), p ? AI_PRECISION_FP64 : AI_PRECISION_FP32);
+        TEST_CHECK(t, back && back->precision == (p ? AI_PRECISION_FP64 : AI_PRECISION_FP32), "%s model not converted",
+                   test_precision_name[p]);
+        if (back) {
+            transformer_forward(back, x, TEST_TR_N, y2);
+            TEST_CHECK(t, test_rel_diff(y2, y, n) < test_tolerance[p ? p : 1], "converted %s model off by %g",
+                       test_precision_name[p], test_rel_diff(y2, y, n));
+            transformer_free(back);
+        }
+
+        /* A session of the old precision refuses to step */
+        if (s && p > 0) {
+            TEST_CHECK(t, transformer_set_precision(tr, AI_PRECISION_FP64) == 0, "%s model not converted",
+                       test_precision_name[p]);
+            TEST_CHECK(t, transformer_session_step(s, x, row) != 0, "stale %s session stepped", test_precision_name[p]);
+        }
+        transformer_session_free(s);
+        transformer_free(tr);
+    }
+}
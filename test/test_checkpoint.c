@@ -0,0 +1,404 @@
+/* test_checkpoint.c - Tests of the checkpoints of HOLOS runs
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+   ----------------------------------------------------------------------
+   The state of each snapshot follows from its number, and is changed
+   as soon as ckpt_snapshot() returns: what is restored must be the
+   state when the snapshot was taken. Checkpoints are then torn or
+   dropped on disk, as a crash would leave them, and restore must fall
+   back to the newest whole one. A run restarted from a checkpoint must
+   go on bit for bit as the run that took it.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <gsl/gsl_vector.h>
+
+#include "core/phys/checkpoint.h"
+#include "core/phys/mech/classical/dynamics.h"
+#include "tests.h"
+
+#define TEST_CKPT_PATH 4096
+#define TEST_CKPT_N 1000
+
+/* A state of a size of its own, as a walker sees it */
+struct test_state {
+    uint64_t n;
+    double *x;
+    int restored;                       /* Set by the walk after a restore */
+};
+
+static int test_walk(void *state, ckpt_cursor *c) {
+    struct test_state *s = state;
+    ckpt_io(c, &s->n, sizeof(s->n));
+    ckpt_io(c, s->x, s->n * sizeof(double));
+    if (ckpt_restoring(c)) s->restored = 1;
+    return 0;
+}
+
+/* The state of snapshot k; k = 0 for one no snapshot had */
+static void test_fill(double *a, struct test_state *s, uint64_t *count, int k) {
+    for (size_t i = 0; i < TEST_CKPT_N; i++) a[i] = k ? 1000.0 * k + (double)i : -1.0;
+    for (size_t i = 0; i < s->n; i++) s->x[i] = k ? -k - 0.5 * (double)i : 0.0;
+    *count = (uint64_t)k;
+}
+
+/* Whether the state is that of snapshot k */
+static int test_filled(const double *a, const struct test_state *s, uint64_t count, int k) {
+    for (size_t i = 0; i < TEST_CKPT_N; i++)
+        if (a[i] != 1000.0 * k + (double)i) return 0;
+    for (size_t i = 0; i < s->n; i++)
+        if (s->x[i] != -k - 0.5 * (double)i) return 0;
+    return count == (uint64_t)k;
+}
+
+/* Files of dir whose names end in suffix */
+static int test_files(const char *dir, const char *suffix) {
+    DIR *d = opendir(dir);
+    struct dirent *e;
+    int n = 0;
+    if (!d) return -1;
+    while ((e = readdir(d))) {
+        const size_t len = strlen(e->d_name), k = strlen(suffix);
+        n += len > k && strcmp(e->d_name + len - k, suffix) == 0;
+    }
+    closedir(d);
+    return n;
+}
+
+/* dir/ckpt-<seq><suffix> into path */
+static const char *test_ckpt_file(char *path, const char *dir, uint64_t seq, const char *suffix) {
+    snprintf(path, TEST_CKPT_PATH + 64, "%s/ckpt-%016llu%s", dir, (unsigned long long)seq, suffix);
+    return path;
+}
+
+/* Registers the sections of test_fill; 0 or -1 */
+static int test_sections(ckpt_store *s, double *a, struct test_state *st, uint64_t *count) {
+    if (ckpt_add(s, "a", a, TEST_CKPT_N * sizeof(double)) != 0) return -1;
+    if (ckpt_add_state(s, "walked", st, test_walk) != 0) return -1;
+    return ckpt_add(s, "count", count, sizeof(*count));
+}
+
+/* ---------------- Snapshots ---------------- */
+
+void test_ckpt_snapshot(struct test *t) {
+    static double a[TEST_CKPT_N];
+    double x[100];
+    struct test_state st = {100, x, 0};
+    char dir[TEST_CKPT_PATH], name[80];
+    uint64_t count = 0, seq = 0, step = 0;
+    double at = 0;
+    ckpt_store *s;
+    snprintf(dir, sizeof(dir), "%s", test_path(t, "ckpt"));
+    if (!(s = ckpt_open(dir, &(ckpt_params){3, 0}))) {
+        TEST_CHECK(t, 0, "cannot open a store in %s", dir);
+        return;
+    }
+    TEST_CHECK(t, s->seq == 0 && s->seq_written == 0, "new store at checkpoint %llu", (unsigned long long)s->seq);
+
+    /* Sections: names of printable characters, each named once */
+    TEST_CHECK(t, test_sections(s, a, &st, &count) == 0 && s->n_sections == 3, "sections refused");
+    memset(name, 'n', 64);
+    name[64] = '\0';
+    TEST_CHECK(t, ckpt_add(s, "", a, 8) != 0 && ckpt_add(s, "a b", a, 8) != 0 && ckpt_add(s, name, a, 8) != 0,
+               "a bad section name taken");
+    TEST_CHECK(t, ckpt_add(s, "a", a, 8) != 0 && ckpt_add(s, "walked", a, 8) != 0, "a section named twice");
+    TEST_CHECK(t, ckpt_add(s, "null", NULL, 8) != 0 && ckpt_add_state(s, "nowalk", &st, NULL) != 0,
+               "a section of nothing taken");
+    TEST_CHECK(t, s->n_sections == 3, "%zu sections, not 3", s->n_sections);
+
+    /* The state as it was when each snapshot returned, not later */
+    for (int k = 1; k <= 5; k++) {
+        int rc;
+        test_fill(a, &st, &count, k);
+        rc = ckpt_snapshot(s, 0.5 * k, 10u * (unsigned)k);
+        test_fill(a, &st, &count, 0);
+        TEST_CHECK(t, rc == 0 && s->seq == (uint64_t)k, "snapshot %d: %d, at checkpoint %llu", k, rc,
+                   (unsigned long long)s->seq);
+    }
+    TEST_CHECK(t, ckpt_wait(s) == 0, "a checkpoint not written");
+    TEST_CHECK(t, s->seq_written == 5 && s->n_written == 5 && s->n_skipped == 0, "%llu written (%zu), %zu skipped",
+               (unsigned long long)s->seq_written, s->n_written, s->n_skipped);
+    TEST_CHECK(t, s->bytes % 5 == 0 && s->bytes / 5 >= sizeof(a) + sizeof(x) + 16, "%zu bytes written", s->bytes);
+    TEST_CHECK(t, test_files(dir, ".dat") == 3 && test_files(dir, ".manifest") == 3 && test_files(dir, ".tmp") == 0,
+               "%d data files and %d manifests, not the last 3", test_files(dir, ".dat"), test_files(dir, ".manifest"));
+    TEST_CHECK(t, ckpt_restore(s, &seq, &at, &step) == 0, "no checkpoint to restore");
+    TEST_CHECK(t, seq == 5 && at == 2.5 && step == 50, "restored checkpoint %llu, t %g, step %llu",
+               (unsigned long long)seq, at, (unsigned long long)step);
+    TEST_CHECK(t, test_filled(a, &st, count, 5) && st.restored, "not the state of snapshot 5");
+    TEST_CHECK(t, ckpt_close(s) == 0, "closing failed");
+
+    /* Numbered after those on disk, the last two kept by default */
+    if (!(s = ckpt_open(dir, NULL))) {
+        TEST_CHECK(t, 0, "cannot open %s again", dir);
+        return;
+    }
+    TEST_CHECK(t, s->seq == 5 && s->seq_written == 5, "opened again at checkpoint %llu", (unsigned long long)s->seq);
+    TEST_CHECK(t, test_sections(s, a, &st, &count) == 0, "sections refused");
+    test_fill(a, &st, &count, 6);
+    TEST_CHECK(t, ckpt_snapshot(s, 3.0, 60) == 0 && ckpt_wait(s) == 0 && s->seq_written == 6, "checkpoint 6 not taken");
+    TEST_CHECK(t, test_files(dir, ".dat") == 2 && test_files(dir, ".manifest") == 2, "%d checkpoints left, not 2",
+               test_files(dir, ".manifest"));
+    test_fill(a, &st, &count, 0);
+    TEST_CHECK(t, ckpt_restore(s, &seq, NULL, NULL) == 0 && seq == 6 && test_filled(a, &st, count, 6),
+               "checkpoint 6 not restored");
+    TEST_CHECK(t, ckpt_close(s) == 0, "closing failed");
+}
+
+/*
+    With skip, a snapshot while both buffers are being written is not
+    taken: of large snapshots in a row, those taken and those skipped
+    must add up, and each taken be on disk.
+*/
+void test_ckpt_skip(struct test *t) {
+    const size_t n = (size_t)1 << 19;
+    double *big = calloc(n, sizeof(double));
+    char dir[TEST_CKPT_PATH], path[TEST_CKPT_PATH + 64];
+    uint64_t seq = 0;
+    int taken = 0, skipped = 0, failed = 0;
+    ckpt_store *s = NULL;
+    snprintf(dir, sizeof(dir), "%s", test_path(t, "ckpt"));
+    if (!big || !(s = ckpt_open(dir, &(ckpt_params){64, 1})) || ckpt_add(s, "big", big, n * sizeof(double)) != 0) {
+        TEST_CHECK(t, 0, "cannot set the store up");
+        goto out;
+    }
+    for (int k = 0; k < 16; k++) {
+        const int rc = ckpt_snapshot(s, k, (uint64_t)k);
+        taken += rc == 0;
+        skipped += rc == 1;
+        failed += rc < 0;
+        big[k] = k + 1;
+    }
+    TEST_CHECK(t, ckpt_wait(s) == 0 && !failed, "%d snapshots failed", failed);
+    TEST_CHECK(t, s->seq == (uint64_t)taken && s->n_written == (size_t)taken && s->n_skipped == (size_t)skipped,
+               "%d taken and %d skipped, against %llu, %zu written and %zu skipped", taken, skipped,
+               (unsigned long long)s->seq, s->n_written, s->n_skipped);
+    TEST_CHECK(t, taken + skipped == 16 && taken >= 1, "%d taken and %d skipped of 16", taken, skipped);
+    TEST_CHECK(t, test_files(dir, ".manifest") == taken, "%d on disk, %d taken", test_files(dir, ".manifest"), taken);
+    TEST_CHECK(t, ckpt_restore(s, &seq, NULL, NULL) == 0 && seq == (uint64_t)taken, "checkpoint %llu restored",
+               (unsigned long long)seq);
+    TEST_CHECK(t, ckpt_close(s) == 0, "closing failed");
+    s = NULL;
+
+    /* A directory gone under the store: the write fails, and says so */
+    snprintf(dir, sizeof(dir), "%s", test_path(t, "gone"));
+    if (!(s = ckpt_open(dir, NULL)) || ckpt_add(s, "big", big, 64) != 0) {
+        TEST_CHECK(t, 0, "cannot open a store in %s", dir);
+        goto out;
+    }
+    TEST_CHECK(t, rmdir(dir) == 0, "cannot remove %s", dir);
+    TEST_CHECK(t, ckpt_snapshot(s, 0, 0) == 0, "snapshot not taken");
+    TEST_CHECK(t, ckpt_wait(s) != 0 && s->n_written == 0, "a write into no directory succeeded");
+    TEST_CHECK(t, ckpt_snapshot(s, 1, 1) < 0, "snapshot taken after a failed write");
+    TEST_CHECK(t, ckpt_close(s) != 0, "closing after a failed write gave 0");
+    s = NULL;
+    snprintf(path, sizeof(path), "%s", test_path(t, "file"));
+    {
+        FILE *f = fopen(path, "w");
+        if (f) fclose(f);
+    }
+    TEST_CHECK(t, ckpt_open(path, NULL) == NULL && ckpt_open(NULL, NULL) == NULL, "a store opened on no directory");
+out:
+    if (s) ckpt_close(s);
+    free(big);
+}
+
+/* ---------------- Restart ---------------- */
+
+/* Flips one byte of path at offset */
+static int test_flip(const char *path, long offset) {
+    FILE *f = fopen(path, "r+b");
+    int c, rc = -1;
+    if (!f) return -1;
+    if (fseek(f, offset, SEEK_SET) == 0 && (c = fgetc(f)) != EOF && fseek(f, offset, SEEK_SET) == 0 &&
+        fputc(c ^ 0x20, f) != EOF)
+        rc = 0;
+    return fclose(f) == 0 ? rc : -1;
+}
+
+void test_ckpt_restore(struct test *t) {
+    static double a[TEST_CKPT_N];
+    double x[10], other[TEST_CKPT_N / 2];
+    struct test_state st = {10, x, 0};
+    char dir[TEST_CKPT_PATH], path[TEST_CKPT_PATH + 64];
+    uint64_t count = 0, seq = 0;
+    ckpt_store *s;
+    FILE *f;
+    snprintf(dir, sizeof(dir), "%s", test_path(t, "ckpt"));
+    if (!(s = ckpt_open(dir, &(ckpt_params){8, 0}))) {
+        TEST_CHECK(t, 0, "cannot open a store in %s", dir);
+        return;
+    }
+    TEST_CHECK(t, ckpt_restore(s, &seq, NULL, NULL) != 0, "a checkpoint restored from an empty directory");
+    TEST_CHECK(t, test_sections(s, a, &st, &count) == 0, "sections refused");
+    for (int k = 1; k <= 4; k++) {
+        test_fill(a, &st, &count, k);
+        TEST_CHECK(t, ckpt_snapshot(s, k, (uint64_t)k) == 0, "snapshot %d not taken", k);
+    }
+    TEST_CHECK(t, ckpt_close(s) == 0, "closing failed");
+
+    /* Torn as a crash leaves them: newer ones skipped, older kept */
+    TEST_CHECK(t, test_flip(test_ckpt_file(path, dir, 4, ".dat"), 24 + 8 * 10) == 0, "cannot change checkpoint 4");
+    TEST_CHECK(t, truncate(test_ckpt_file(path, dir, 3, ".dat"), 100) == 0, "cannot cut checkpoint 3");
+    TEST_CHECK(t, unlink(test_ckpt_file(path, dir, 2, ".manifest")) == 0, "cannot remove manifest 2");
+    if ((f = fopen(test_ckpt_file(path, dir, 9, ".manifest"), "w"))) {
+        fputs("HOLOSCKP 1\nseq 9\n", f);
+        fclose(f);
+    }
+    if ((f = fopen(test_ckpt_file(path, dir, 10, ".manifest.tmp"), "w"))) fclose(f);
+    if (!(s = ckpt_open(dir, NULL)) || test_sections(s, a, &st, &count) != 0) {
+        TEST_CHECK(t, 0, "cannot open %s again", dir);
+        if (s) ckpt_close(s);
+        return;
+    }
+    test_fill(a, &st, &count, 0);
+    st.restored = 0;
+    TEST_CHECK(t, ckpt_restore(s, &seq, NULL, NULL) == 0 && seq == 1, "checkpoint %llu restored, not 1",
+               (unsigned long long)seq);
+    TEST_CHECK(t, test_filled(a, &st, count, 1) && st.restored, "not the state of snapshot 1");
+    TEST_CHECK(t, ckpt_close(s) == 0, "closing failed");
+
+    /* Sections that no checkpoint has, or not of that size: nothing
+       restored, nothing changed */
+    if (!(s = ckpt_open(dir, NULL))) {
+        TEST_CHECK(t, 0, "cannot open %s again", dir);
+        return;
+    }
+    for (size_t i = 0; i < TEST_CKPT_N / 2; i++) other[i] = (double)i;
+    TEST_CHECK(t, ckpt_add(s, "a", other, sizeof(other)) == 0, "section refused");
+    TEST_CHECK(t, ckpt_restore(s, NULL, NULL, NULL) != 0, "a section restored at another size");
+    ckpt_close(s);
+    if (!(s = ckpt_open(dir, NULL))) {
+        TEST_CHECK(t, 0, "cannot open %s again", dir);
+        return;
+    }
+    test_fill(a, &st, &count, 0);
+    TEST_CHECK(t, test_sections(s, a, &st, &count) == 0 && ckpt_add(s, "new", other, sizeof(other)) == 0,
+               "sections refused");
+    TEST_CHECK(t, ckpt_restore(s, NULL, NULL, NULL) != 0, "restored without the section \"new\"");
+    TEST_CHECK(t, other[1] == 1.0 && other[TEST_CKPT_N / 2 - 1] == TEST_CKPT_N / 2 - 1 && a[0] == -1.0 && count == 0,
+               "state changed by a failed restore");
+    ckpt_close(s);
+}
+
+#define TEST_DYN_N 12
+
+static uint64_t g_rand;
+
+/* Uniform in [-1, 1) from a fixed seed */
+static double test_random(void) {
+    g_rand ^= g_rand << 13;
+    g_rand ^= g_rand >> 7;
+    g_rand ^= g_rand << 17;
+    return (double)(g_rand >> 11) * 0x1.0p-52 - 1.0;
+}
+
+/* A binary among field particles, on block time steps, as set up anew */
+static dyn_system_t *test_dyn_system(void) {
+    dyn_system_t *sys = dyn_system_alloc(TEST_DYN_N);
+    if (!sys) return NULL;
+    g_rand = 0x636b7074ull;
+    dyn_system_set_gravity(sys, 1.0);
+    for (size_t i = 0; i < TEST_DYN_N; i++) {
+        gsl_vector_view pos = dyn_system_particle_vector(sys, DYN_FIELD_POS, i);
+        gsl_vector_view vel = dyn_system_particle_vector(sys, DYN_FIELD_VEL, i);
+        for (size_t a = 0; a < 3; a++) {
+            *gsl_vector_ptr(&pos.vector, a) = i < 2 ? (a == 0 ? (i ? 0.01 : -0.01) : 0) : 0.5 * test_random();
+            *gsl_vector_ptr(&vel.vector, a) = i < 2 ? (a == 1 ? (i ? 3.5 : -3.5) : 0) : 0.1 * test_random();
+        }
+        sys->particles[i].mass = i < 2 ? 0.5 : 1e-3;
+    }
+    dyn_system_sync_masses(sys);
+    if (dyn_system_set_block_timesteps(sys, 8, 0.02) != 0) {
+        dyn_system_free(sys);
+        return NULL;
+    }
+    return sys;
+}
+
+static int test_dyn_steps(dyn_system_t *sys, int n) {
+    for (int s = 0; s < n; s++)
+        if (dyn_system_step(sys, 0.01, DYN_INT_LEAPFROG) != 0) return -1;
+    return 0;
+}
+
+/* Positions and velocities, 6 per particle, into out */
+static void test_dyn_state(const dyn_system_t *sys, double *out) {
+    for (size_t i = 0; i < TEST_DYN_N; i++)
+        for (size_t a = 0; a < 3; a++) {
+            out[6 * i + a] = gsl_vector_get(sys->particles[i].pos, a);
+            out[6 * i + 3 + a] = gsl_vector_get(sys->particles[i].vel, a);
+        }
+}
+
+/*
+    A run checkpointed halfway, then restarted: a system set up anew and
+    restored must take the second half of the steps bit for bit as the
+    first run did, its levels and last accelerations restored.
+*/
+void test_ckpt_restart(struct test *t) {
+    double first[6 * TEST_DYN_N], again[6 * TEST_DYN_N], at = 0;
+    char dir[TEST_CKPT_PATH];
+    dyn_system_t *sys = test_dyn_system(), *re = test_dyn_system();
+    ckpt_store *s = NULL;
+    uint64_t step = 0;
+    int half_step = 0, differ = 0;
+    double half = 0;
+    snprintf(dir, sizeof(dir), "%s", test_path(t, "ckpt"));
+    if (!sys || !re || !(s = ckpt_open(dir, NULL)) || ckpt_add_state(s, "dyn", sys, ckpt_walk_dyn_system) != 0) {
+        TEST_CHECK(t, 0, "cannot set the run up");
+        goto out;
+    }
+    TEST_CHECK(t, test_dyn_steps(sys, 10) == 0, "a step failed");
+    half = sys->t;
+    half_step = sys->step_count;
+    TEST_CHECK(t, ckpt_snapshot(s, sys->t, (uint64_t)sys->step_count) == 0, "snapshot not taken");
+    TEST_CHECK(t, test_dyn_steps(sys, 10) == 0, "a step failed");
+    test_dyn_state(sys, first);
+    TEST_CHECK(t, ckpt_close(s) == 0, "checkpoint not written");
+
+    /* The restart: the same setup, then the checkpoint */
+    if (!(s = ckpt_open(dir, NULL)) || ckpt_add_state(s, "dyn", re, ckpt_walk_dyn_system) != 0) {
+        TEST_CHECK(t, 0, "cannot open %s again", dir);
+        goto out;
+    }
+    TEST_CHECK(t, ckpt_restore(s, NULL, &at, &step) == 0, "no checkpoint to restore");
+    TEST_CHECK(t, at == half && step == (uint64_t)half_step && re->t == half && re->step_count == half_step,
+               "restored at t %g, step %llu (system %g, %d), not %g, %d", at, (unsigned long long)step, re->t,
+               re->step_count, half, half_step);
+    TEST_CHECK(t, test_dyn_steps(re, 10) == 0, "a step failed");
+    test_dyn_state(re, again);
+    for (size_t i = 0; i < 6 * TEST_DYN_N; i++) differ += memcmp(&first[i], &again[i], sizeof(double)) != 0;
+    TEST_CHECK(t, differ == 0 && re->t == sys->t && re->step_count == sys->step_count,
+               "%d of %d coordinates differ after the restart, t %.17g against %.17g", differ, 6 * TEST_DYN_N, re->t,
+               sys->t);
+    for (size_t i = 0; i < TEST_DYN_N; i++)
+        differ += dyn_system_particle_level(re, i) != dyn_system_particle_level(sys, i);
+    TEST_CHECK(t, differ == 0, "levels differ after the restart");
+out:
+    if (s) ckpt_close(s);
+    dyn_system_free(sys);
+    dyn_system_free(re);
+}
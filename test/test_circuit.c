@@ -0,0 +1,390 @@
+/* test_circuit.c - Tests of the circuit analysis of HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+   ----------------------------------------------------------------------
+   Networks small enough to solve by hand, so the engines can be held to
+   the exact answer: the sparse MNA engine on a resistor ladder, a diode
+   and an RC step, and the Philox stream under the Monte Carlo runs.
+   The AC sweep of a series RLC is held to its transfer function.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <complex.h>
+#include <gsl/gsl_vector.h>
+#include <gsl/gsl_matrix.h>
+#include <gsl/gsl_matrix_complex.h>
+
+#include "core/phys/philox.h"
+#include "core/phys/em/circuit_analysis.h"
+#include "tests.h"
+
+/* ---------------- Sparse MNA ---------------- */
+
+#define TEST_VT 0.025852                /* CIRCUIT_VT, private to the engine */
+#define TEST_LADDER_MAX 64
+
+/* A ladder on nodes 1..n - 1: 1 V on node 1, a resistor of rs[k] from node
+   k to k + 1 and one of rp[k] from node k to ground (k >= 2) */
+static circuit_netlist *test_ladder(size_t n, const double *rs, const double *rp) {
+    circuit_netlist *net = circuit_netlist_alloc(0, n);
+    circuit_element el;
+    int ok = net != NULL;
+    memset(&el, 0, sizeof(el));
+    el.type = CIRCUIT_VOLTAGE_SOURCE;
+    el.node1 = 1;
+    el.value = 1.0;
+    ok = ok && circuit_netlist_add_element(net, &el) >= 0;
+    el.type = CIRCUIT_RESISTOR;
+    for (size_t k = 1; ok && k + 1 < n; k++) {
+        el.node1 = (int)k;
+        el.node2 = (int)k + 1;
+        el.value = rs[k];
+        ok = circuit_netlist_add_element(net, &el) >= 0;
+        el.node1 = (int)k + 1;
+        el.node2 = 0;
+        el.value = rp[k + 1];
+        ok = ok && circuit_netlist_add_element(net, &el) >= 0;
+    }
+    if (ok) return net;
+    circuit_netlist_free(net);
+    return NULL;
+}
+
+/* The ladder by the tridiagonal (Thomas) elimination of nodes 2..n - 1 */
+static void test_ladder_solve(size_t n, const double *rs, const double *rp, double *v) {
+    double c[TEST_LADDER_MAX], d[TEST_LADDER_MAX];
+    v[0] = 0.0;
+    v[1] = 1.0;
+    for (size_t k = 2; k < n; k++) {
+        const double lo = 1.0 / rs[k - 1], up = k + 1 < n ? 1.0 / rs[k] : 0.0;
+        const double diag = lo + up + 1.0 / rp[k] - (k > 2 ? lo * c[k - 1] : 0.0);
+        c[k] = up / diag;
+        d[k] = (k > 2 ? lo * d[k - 1] : lo) / diag;
+    }
+    for (size_t k = n - 1; k >= 2; k--) v[k] = d[k] + (k + 1 < n ? c[k] * v[k + 1] : 0.0);
+}
+
+static double test_max_diff(const gsl_vector *x, const double *v, size_t n) {
+    double err = 0.0;
+    for (size_t i = 0; i < n; i++) err = fmax(err, fabs(gsl_vector_get(x, i) - v[i]));
+    return err;
+}
+
+/*
+    A ladder of 40 nodes against its elimination by hand, solved again
+    with two resistors changed (a numeric refactorization, not another
+    pivoting one) and by a clone (refactorizing from the first); a diode
+    to its exponential law; an RC step to the backward-Euler recursion
+    v_k = (v_(k-1) + a) / (1 + a), a = dt / RC; unsupported elements and
+    bad nodes refused.
+*/
+void test_circuit_mna(struct test *t) {
+    enum { N = 40 };
+    double rs[N], rp[N], want[N];
+    circuit_netlist *net, *copy = NULL, *other = NULL;
+    circuit_mna *m = NULL, *mc = NULL, *mo = NULL;
+    gsl_vector *x = gsl_vector_alloc(N), *y = gsl_vector_alloc(N);
+    gsl_matrix *run = NULL;
+    circuit_element el;
+    for (size_t k = 0; k < N; k++) {
+        rs[k] = 100.0 * (1 + k % 7);
+        rp[k] = 1e3 * (1 + k % 5);
+    }
+    net = test_ladder(N, rs, rp);
+    if (!net || !x || !y || !(m = circuit_mna_alloc(net))) {
+        TEST_CHECK(t, 0, "out of memory");
+        goto done;
+    }
+    test_ladder_solve(N, rs, rp, want);
+    TEST_CHECK(t, circuit_mna_dc(m, x) == CIRCUIT_OK, "ladder DC");
+    TEST_CHECK(t, test_max_diff(x, want, N) < 1e-12, "ladder off its elimination by %g", test_max_diff(x, want, N));
+    TEST_CHECK(t, m->n_factor == 1 && m->n_refactor == 0, "%zu factorizations, %zu refactorizations", m->n_factor,
+               m->n_refactor);
+    /* Element 2 k - 1 is rs[k], element 2 k is rp[k + 1] */
+    rs[N / 3] *= 3.0;
+    rp[N / 4 + 1] /= 7.0;
+    net->elements[2 * (N / 3) - 1].value = rs[N / 3];
+    net->elements[2 * (N / 4)].value = rp[N / 4 + 1];
+    test_ladder_solve(N, rs, rp, want);
+    TEST_CHECK(t, circuit_mna_dc(m, x) == CIRCUIT_OK, "ladder DC, changed");
+    TEST_CHECK(t, test_max_diff(x, want, N) < 1e-12, "changed ladder off by %g", test_max_diff(x, want, N));
+    TEST_CHECK(t, m->n_factor == 1 && m->n_refactor == 1, "changed: %zu factorizations, %zu refactorizations",
+               m->n_factor, m->n_refactor);
+    copy = circuit_netlist_clone(net);
+    mc = copy ? circuit_mna_clone(m, copy) : NULL;
+    TEST_CHECK(t, mc != NULL, "no clone");
+    if (mc) {
+        TEST_CHECK(t, circuit_mna_dc(mc, y) == CIRCUIT_OK && memcmp(x->data, y->data, N * sizeof(double)) == 0,
+                   "the clone solves otherwise");
+        TEST_CHECK(t, mc->n_factor == 0 && mc->n_refactor == 1, "clone: %zu factorizations, %zu refactorizations",
+                   mc->n_factor, mc->n_refactor);
+    }
+    circuit_mna_free(m);
+    circuit_netlist_free(net);
+    m = NULL;
+
+    /* 1 V, 1 kOhm and a diode (Is 1e-14 A, n 1.5): one current through both */
+    rs[1] = rp[2] = 1e3;
+    net = test_ladder(3, rs, rp);
+    if (!net) {
+        TEST_CHECK(t, 0, "out of memory");
+        goto done;
+    }
+    net->elements[2].type = CIRCUIT_DIODE;
+    net->elements[2].value = 1e-14;
+    net->elements[2].value2 = 1.5;
+    m = circuit_mna_alloc(net);
+    TEST_CHECK(t, m && circuit_mna_dc(m, x) == CIRCUIT_OK, "diode DC");
+    if (m) {
+        const double vd = gsl_vector_get(x, 2), ir = (1.0 - vd) / 1e3;
+        const double id = 1e-14 * expm1(vd / (1.5 * TEST_VT));
+        TEST_CHECK(t, vd > 0.5 && vd < 1.0 && fabs(id - ir) < 1e-6 * ir, "diode at %.9g V: %.9g A against %.9g A", vd,
+                   id, ir);
+        TEST_CHECK(t, m->n_newton > 1, "%zu Newton iterations", m->n_newton);
+    }
+    circuit_mna_free(m);
+    m = NULL;
+
+    /* 1 V into 1 kOhm and 1 uF: tau 1 ms, 50 steps of 0.1 ms */
+    net->elements[2].type = CIRCUIT_CAPACITOR;
+    net->elements[2].value = 1e-6;
+    net->elements[2].value2 = 0.0;
+    m = circuit_mna_alloc(net);
+    run = gsl_matrix_alloc(51, 3);
+    if (!m || !run) {
+        TEST_CHECK(t, 0, "out of memory");
+        goto done;
+    }
+    TEST_CHECK(t, circuit_mna_transient(m, 0.0, 5e-3, 1e-4, run) == CIRCUIT_OK, "RC transient");
+    {
+        const double a = 1e-4 / (1e3 * 1e-6);
+        double v = 0.0, err = fabs(gsl_matrix_get(run, 0, 2));
+        for (size_t k = 1; k < 51; k++) {
+            v = (v + a) / (1.0 + a);
+            err = fmax(err, fabs(gsl_matrix_get(run, k, 2) - v));
+            err = fmax(err, fabs(gsl_matrix_get(run, k, 1) - 1.0));
+        }
+        TEST_CHECK(t, err < 1e-12, "RC step off the recursion by %g", err);
+    }
+    TEST_CHECK(t, circuit_mna_transient(m, 0.0, 5.05e-3, 1e-4, run) == CIRCUIT_ERR_INVALID,
+               "a transient into too few rows");
+
+    /* Unsupported elements and nodes out of range */
+    other = circuit_netlist_alloc(0, 3);
+    memset(&el, 0, sizeof(el));
+    el.type = CIRCUIT_BJT;
+    el.node1 = 1;
+    el.node2 = 2;
+    el.value = 100.0;
+    if (!other || circuit_netlist_add_element(other, &el) < 0) {
+        TEST_CHECK(t, 0, "out of memory");
+        goto done;
+    }
+    TEST_CHECK(t, (mo = circuit_mna_alloc(other)) == NULL, "a BJT accepted");
+    other->elements[0].type = CIRCUIT_RESISTOR;
+    other->elements[0].node2 = 3;
+    TEST_CHECK(t, (mo = circuit_mna_alloc(other)) == NULL, "node 3 of 3 accepted");
+    other->elements[0].node2 = 2;
+    TEST_CHECK(t, (mo = circuit_mna_alloc(other)) != NULL, "a resistor refused");
+done:
+    circuit_mna_free(m);
+    circuit_mna_free(mc);
+    circuit_mna_free(mo);
+    circuit_netlist_free(net);
+    circuit_netlist_free(copy);
+    circuit_netlist_free(other);
+    if (x) gsl_vector_free(x);
+    if (y) gsl_vector_free(y);
+    if (run) gsl_matrix_free(run);
+}
+
+/* ---------------- Philox ---------------- */
+
+void test_philox(struct test *t) {
+    /* Philox4x32-10 known answers of Random123 (kat_vectors) */
+    static const uint32_t ctr[3][4] = {
+        {0, 0, 0, 0},
+        {0xffffffffu, 0xffffffffu, 0xffffffffu, 0xffffffffu},
+        {0x243f6a88u, 0x85a308d3u, 0x13198a2eu, 0x03707344u}};
+    static const uint32_t key[3][2] = {{0, 0}, {0xffffffffu, 0xffffffffu}, {0xa4093822u, 0x299f31d0u}};
+    static const uint32_t want[3][4] = {
+        {0x6627e8d5u, 0xe169c58du, 0xbc57ac4cu, 0x9b00dbd8u},
+        {0x408f276du, 0x41c83b0eu, 0xa20bc7c6u, 0x6d5451fdu},
+        {0xd16cfe09u, 0x94fdccebu, 0x5001e420u, 0x24126ea1u}};
+    double u0[1000], u1[1000];
+    for (int v = 0; v < 3; v++) {
+        uint32_t out[4];
+        philox4x32(ctr[v], key[v], out);
+        for (int i = 0; i < 4; i++)
+            TEST_CHECK(t, out[i] == want[v][i], "vector %d word %d: %08x, not %08x", v, i, out[i], want[v][i]);
+    }
+    /* The vectorized form draws the same numbers as the scalar one */
+    philox_uniform2_n(0x123456789abcdefull, 7, (1ull << 32) - 500, 1000, u0, u1);
+    for (size_t k = 0; k < 1000; k++) {
+        double u[2];
+        philox_uniform2(0x123456789abcdefull, 7, (1ull << 32) - 500 + k, u);
+        TEST_CHECK(t, u[0] == u0[k] && u[1] == u1[k], "draw %zu: (%.17g, %.17g) against (%.17g, %.17g)", k, u0[k],
+                   u1[k], u[0], u[1]);
+        TEST_CHECK(t, u[0] > 0 && u[0] < 1 && u[1] > 0 && u[1] < 1, "draw %zu outside (0, 1)", k);
+    }
+}
+
+/* ---------------- Monte Carlo ---------------- */
+
+/* 1 V across two resistors of r1 and r2: node 2 sits at r2 / (r1 + r2) */
+static circuit_netlist *test_divider(double r1, double r2) {
+    circuit_netlist *net = circuit_netlist_alloc(0, 3);
+    circuit_element el;
+    int ok = net != NULL;
+    memset(&el, 0, sizeof(el));
+    el.type = CIRCUIT_VOLTAGE_SOURCE;
+    el.node1 = 1;
+    el.value = 1.0;
+    ok = ok && circuit_netlist_add_element(net, &el) >= 0;
+    el.type = CIRCUIT_RESISTOR;
+    el.node2 = 2;
+    el.value = r1;
+    ok = ok && circuit_netlist_add_element(net, &el) >= 0;
+    el.node1 = 2;
+    el.node2 = 0;
+    el.value = r2;
+    if (ok && circuit_netlist_add_element(net, &el) >= 0) return net;
+    circuit_netlist_free(net);
+    return NULL;
+}
+
+/*
+    With both resistors off by 1 + sigma z, node 2 moves by about
+    sigma (z2 - z1) / 4: a spread of sigma sqrt(2) / 4 around 1/2.
+*/
+void test_circuit_monte_carlo(struct test *t) {
+    enum { N_RUNS = 4000 };
+    static const int threads[] = {1, 4, -1};
+    circuit_netlist *net = test_divider(1e3, 1e3);
+    gsl_matrix *serial = gsl_matrix_alloc(N_RUNS, 3), *other = gsl_matrix_alloc(N_RUNS, 3);
+    circuit_mc_options opt = {0x484f4c4fu, 0.05, 0};
+    double mean = 0, var = 0;
+    if (!net || !serial || !other) {
+        TEST_CHECK(t, 0, "out of memory");
+        goto done;
+    }
+    TEST_CHECK(t, circuit_monte_carlo_run(net, N_RUNS, &opt, serial) == CIRCUIT_OK, "serial runs");
+    for (size_t r = 0; r < N_RUNS; r++) mean += gsl_matrix_get(serial, r, 2) / N_RUNS;
+    for (size_t r = 0; r < N_RUNS; r++) var += pow(gsl_matrix_get(serial, r, 2) - mean, 2) / (N_RUNS - 1);
+    TEST_CHECK(t, fabs(mean - 0.5) < 5 * 0.05 * M_SQRT2 / 4 / sqrt(N_RUNS), "mean %.6g, not 1/2", mean);
+    TEST_CHECK(t, fabs(sqrt(var) / (0.05 * M_SQRT2 / 4) - 1) < 0.1, "spread %.4g, not %.4g", sqrt(var),
+               0.05 * M_SQRT2 / 4);
+    for (size_t k = 0; k < sizeof(threads) / sizeof(threads[0]); k++) {
+        opt.n_threads = threads[k];
+        TEST_CHECK(t, circuit_monte_carlo_run(net, N_RUNS, &opt, other) == CIRCUIT_OK, "runs on %d threads",
+                   threads[k]);
+        TEST_CHECK(t, memcmp(serial->data, other->data, N_RUNS * 3 * sizeof(double)) == 0,
+                   "%d threads: the runs differ from the serial ones", threads[k]);
+    }
+    /* Another seed is another sample */
+    opt.seed++;
+    TEST_CHECK(t, circuit_monte_carlo_run(net, N_RUNS, &opt, other) == CIRCUIT_OK &&
+                      gsl_matrix_get(other, 0, 2) != gsl_matrix_get(serial, 0, 2),
+               "the seed does not change the runs");
+done:
+    circuit_netlist_free(net);
+    if (serial) gsl_matrix_free(serial);
+    if (other) gsl_matrix_free(other);
+}
+
+/* ---------------- AC Sweep ---------------- */
+
+/* 1 V into r, l and c in series: node 3 across the capacitor */
+static circuit_netlist *test_rlc(double r, double l, double c) {
+    static const circuit_element_type types[] = {CIRCUIT_VOLTAGE_SOURCE, CIRCUIT_RESISTOR, CIRCUIT_INDUCTOR,
+                                                 CIRCUIT_CAPACITOR};
+    const double values[] = {1.0, r, l, c};
+    circuit_netlist *net = circuit_netlist_alloc(0, 4);
+    circuit_element el;
+    memset(&el, 0, sizeof(el));
+    for (int k = 0; net && k < 4; k++) {
+        el.type = types[k];
+        el.node1 = k ? k : 1;
+        el.node2 = k == 0 || k == 3 ? 0 : k + 1;
+        el.value = values[k];
+        if (circuit_netlist_add_element(net, &el) < 0) {
+            circuit_netlist_free(net);
+            return NULL;
+        }
+    }
+    return net;
+}
+
+/*
+    V3 = 1 / (1 - w^2 LC + jwRC) and V2 = 1 - jwRC / (1 - w^2 LC + jwRC)
+    over two decades around the resonance (Q about 3), the ground column
+    0; the same phasors on any thread count, their magnitudes those of
+    circuit_ac_analysis().
+*/
+void test_circuit_ac_sweep(struct test *t) {
+    enum { N_OMEGA = 201 };
+    static const int threads[] = {1, 4, -1};
+    const double r = 10.0, l = 1e-3, c = 1e-6, w0 = 1.0 / sqrt(l * c);
+    circuit_netlist *net = test_rlc(r, l, c);
+    gsl_matrix_complex *serial = gsl_matrix_complex_alloc(N_OMEGA, 4), *other = gsl_matrix_complex_alloc(N_OMEGA, 4);
+    gsl_vector *mag = gsl_vector_alloc(4);
+    double omega[N_OMEGA], err = 0.0, merr = 0.0;
+    if (!net || !serial || !other || !mag) {
+        TEST_CHECK(t, 0, "out of memory");
+        goto done;
+    }
+    for (size_t k = 0; k < N_OMEGA; k++) omega[k] = w0 * pow(10.0, (double)k / 100.0 - 1.0);
+    TEST_CHECK(t, circuit_ac_sweep(net, omega, N_OMEGA, 0, serial) == CIRCUIT_OK, "serial sweep");
+    for (size_t k = 0; k < N_OMEGA; k++) {
+        const double w = omega[k];
+        const double complex den = 1.0 - w * w * l * c + I * w * r * c;
+        const double complex want[4] = {0.0, 1.0, 1.0 - I * w * r * c / den, 1.0 / den};
+        const double *row = serial->data + 2 * k * serial->tda;
+        for (size_t i = 0; i < 4; i++)
+            err = fmax(err, cabs(row[2 * i] + I * row[2 * i + 1] - want[i]) / (i ? cabs(want[i]) : 1.0));
+    }
+    TEST_CHECK(t, err < 1e-9, "phasors off the transfer function by %g", err);
+    for (size_t k = 0; k < N_OMEGA; k += 50) {
+        const double *row = serial->data + 2 * k * serial->tda;
+        TEST_CHECK(t, circuit_ac_analysis(net, omega[k], mag) == 0, "AC analysis at %g rad/s", omega[k]);
+        for (size_t i = 0; i < 4; i++)
+            merr = fmax(merr, fabs(gsl_vector_get(mag, i) - hypot(row[2 * i], row[2 * i + 1])));
+    }
+    TEST_CHECK(t, merr < 1e-12, "magnitudes off the sweep by %g", merr);
+    for (size_t k = 0; k < sizeof(threads) / sizeof(threads[0]); k++) {
+        TEST_CHECK(t, circuit_ac_sweep(net, omega, N_OMEGA, threads[k], other) == CIRCUIT_OK, "sweep on %d threads",
+                   threads[k]);
+        TEST_CHECK(t, memcmp(serial->data, other->data, 2 * N_OMEGA * 4 * sizeof(double)) == 0,
+                   "%d threads: the phasors differ from the serial ones", threads[k]);
+    }
+    TEST_CHECK(t, circuit_ac_sweep(net, omega, 0, 0, other) == CIRCUIT_OK, "an empty sweep failed");
+    TEST_CHECK(t, circuit_ac_sweep(net, omega, N_OMEGA + 1, 0, serial) == CIRCUIT_ERR_INVALID &&
+                      circuit_ac_sweep(net, NULL, 3, 0, serial) == CIRCUIT_ERR_INVALID,
+               "a sweep into too few rows, or of no frequencies");
+done:
+    circuit_netlist_free(net);
+    if (serial) gsl_matrix_complex_free(serial);
+    if (other) gsl_matrix_complex_free(other);
+    if (mag) gsl_vector_free(mag);
+}
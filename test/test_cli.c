@@ -0,0 +1,431 @@
+/* test_cli.c - Tests of the holos command line
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+   ----------------------------------------------------------------------
+   The holos built beside tests ($HOLOS_TEST_CLI) is run on scripts of
+   the commands of its physics module ($HOLOS_TEST_PLUGIN), named in one
+   manifest of the scratch directory; make check sets both, and the
+   cases skip without them. Their output, reports and exit status are
+   held to what the script asked for; "p2p stats" to the records a
+   loopback link carried. The module loader, built into tests, is held
+   to manifests of the scratch directory: what it reads, skips and keeps
+   when a name repeats, and that a library opens at its first command
+   run and closes with cli_plugins_free.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dlfcn.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "cli_plugin.h"
+#include "tests.h"
+
+#define TEST_CLI_PATH 4096
+
+/* The commands of phys.so, as test_cli_manifest names them */
+static const char *const test_phys[] = {"nuclear_decay", "fission_fusion", "nuclear_forces",
+                                        "entropy",       "heat_transfer",  "thermodynamics",
+                                        "band_structure", "crystal_lattice", "phonons"};
+#define TEST_PHYS (sizeof(test_phys) / sizeof(test_phys[0]))
+
+/* ---------------- Running holos ---------------- */
+
+struct test_cli {
+    const char *holos;
+    char plugins[TEST_CLI_PATH];        /* HOLOS_PLUGIN_PATH of the runs */
+    char out[TEST_CLI_PATH], err[TEST_CLI_PATH];
+};
+
+/* Writes dir/phys.manifest, naming every command of the library; 0 or -1 */
+static int test_cli_manifest(const char *dir, const char *library) {
+    char path[TEST_CLI_PATH + 16];
+    FILE *f;
+    snprintf(path, sizeof(path), "%s/phys.manifest", dir);
+    if (!(f = fopen(path, "w"))) return -1;
+    fprintf(f, "# the physics module, for the tests\nlibrary %s\n", library);
+    for (size_t i = 0; i < TEST_PHYS; i++) fprintf(f, "command %s run_%s Runs %s\n", test_phys[i], test_phys[i], test_phys[i]);
+    return fclose(f) == 0 ? 0 : -1;
+}
+
+static int test_write(const char *path, const char *text) {
+    FILE *f = fopen(path, "w");
+    if (!f) return -1;
+    fputs(text, f);
+    return fclose(f) == 0 ? 0 : -1;
+}
+
+/* The contents of path, NUL-terminated (malloc'd), or NULL */
+static char *test_slurp(const char *path) {
+    FILE *f = fopen(path, "r");
+    char *text = NULL;
+    long n;
+    if (!f) return NULL;
+    if (fseek(f, 0, SEEK_END) == 0 && (n = ftell(f)) >= 0 && fseek(f, 0, SEEK_SET) == 0 && (text = malloc((size_t)n + 1))) {
+        if (fread(text, 1, (size_t)n, f) != (size_t)n) {
+            free(text);
+            text = NULL;
+        } else {
+            text[n] = '\0';
+        }
+    }
+    fclose(f);
+    return text;
+}
+
+/* Sets cli up for the case, or skips it: 0 to go on */
+static int test_cli_setup(struct test *t, struct test_cli *cli) {
+    const char *library = getenv("HOLOS_TEST_PLUGIN");
+    cli->holos = getenv("HOLOS_TEST_CLI");
+    if (!cli->holos || !*cli->holos || !library || !*library || access(cli->holos, X_OK) != 0 ||
+        access(library, R_OK) != 0) {
+        test_skip(t, "no holos to run: see HOLOS_TEST_CLI and HOLOS_TEST_PLUGIN");
+        return -1;
+    }
+    snprintf(cli->plugins, sizeof(cli->plugins), "%s", test_path(t, "plugins"));
+    snprintf(cli->out, sizeof(cli->out), "%s", test_path(t, "stdout"));
+    snprintf(cli->err, sizeof(cli->err), "%s", test_path(t, "stderr"));
+    if (mkdir(cli->plugins, 0755) != 0 || test_cli_manifest(cli->plugins, library) != 0) {
+        TEST_CHECK(t, 0, "cannot write the manifest in %s", cli->plugins);
+        return -1;
+    }
+    return 0;
+}
+
+/* Runs holos with args (NULL-terminated) and stdin from in (/dev/null if
+   NULL), its output into cli->out and cli->err; its exit status, or -1 */
+static int test_holos(const struct test_cli *cli, const char *in, const char *const *args) {
+    const char *argv[16] = {"holos"};
+    int status, n = 1;
+    pid_t pid;
+    while (args[n - 1] && n < 15) {
+        argv[n] = args[n - 1];
+        n++;
+    }
+    argv[n] = NULL;
+    fflush(stdout);
+    fflush(stderr);
+    if ((pid = fork()) < 0) return -1;
+    if (pid == 0) {
+        int fd0 = open(in ? in : "/dev/null", O_RDONLY);
+        int fd1 = open(cli->out, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        int fd2 = open(cli->err, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd0 < 0 || fd1 < 0 || fd2 < 0 || dup2(fd0, STDIN_FILENO) < 0 || dup2(fd1, STDOUT_FILENO) < 0 ||
+            dup2(fd2, STDERR_FILENO) < 0)
+            _exit(126);
+        setenv("HOLOS_PLUGIN_PATH", cli->plugins, 1);
+        execv(cli->holos, (char *const *)argv);
+        _exit(126);
+    }
+    while (waitpid(pid, &status, 0) < 0)
+        if (errno != EINTR) return -1;
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+/* Occurrences of needle in text */
+static int test_count(const char *text, const char *needle) {
+    int n = 0;
+    for (const char *p = text; (p = strstr(p, needle)); p += strlen(needle)) n++;
+    return n;
+}
+
+/* ---------------- Scripts and jobs ---------------- */
+
+/* The output of "profile NAME": the command's line, then trace's table
+   of one zone, header first; the end of the block, or NULL if other */
+static const char *test_profile_block(const char *p, char *name, size_t size) {
+    const char *end;
+    size_t n;
+    if (strncmp(p, "Running ", 8) != 0 || !(end = strstr(p, "...\n"))) return NULL;
+    n = (size_t)(end - p - 8);
+    if (n + 1 > size || memchr(p + 8, '\n', n)) return NULL;
+    memcpy(name, p + 8, n);
+    name[n] = '\0';
+    p = end + 4;
+    if (strncmp(p, "zone ", 5) != 0 || !(p = strchr(p, '\n'))) return NULL;
+    p++;
+    if (strncmp(p, name, n) != 0 || p[n] != ' ' || !(p = strchr(p, '\n'))) return NULL;
+    p++;
+    if (strncmp(p, "1 zones on ", 11) != 0 || !(p = strchr(p, '\n'))) return NULL;
+    return p + 1;
+}
+
+void test_cli_batch(struct test *t) {
+    struct test_cli cli;
+    char script[TEST_CLI_PATH], text[4096], name[64], line[TEST_CLI_PATH + 64];
+    char *out = NULL, *err = NULL;
+    const char *p;
+    size_t n = 0;
+    int rc, seen[TEST_PHYS] = {0};
+    if (test_cli_setup(t, &cli) != 0) return;
+    snprintf(script, sizeof(script), "%s", test_path(t, "script"));
+
+    /* Jobs at once: each one's output whole, each reported, 0 */
+    n += (size_t)snprintf(text + n, sizeof(text) - n, "# every command, profiled\n\n");
+    for (size_t i = 0; i < TEST_PHYS; i++) n += (size_t)snprintf(text + n, sizeof(text) - n, "  profile %s\t\n", test_phys[i]);
+    TEST_CHECK(t, test_write(script, text) == 0, "cannot write %s", script);
+    rc = test_holos(&cli, NULL, (const char *[]){"-j", "4", "--batch", script, NULL});
+    out = test_slurp(cli.out);
+    err = test_slurp(cli.err);
+    TEST_CHECK(t, rc == 0, "-j 4 --batch: exit %d", rc);
+    TEST_CHECK(t, out && err, "no output of holos");
+    if (!out || !err) goto out;
+    for (p = out; *p;) {
+        const char *next = test_profile_block(p, name, sizeof(name));
+        size_t i;
+        if (!next) break;
+        for (i = 0; i < TEST_PHYS && strcmp(name, test_phys[i]) != 0; i++)
+            ;
+        TEST_CHECK(t, i < TEST_PHYS && !seen[i]++, "-j 4: %s run again or not asked for", name);
+        p = next;
+    }
+    TEST_CHECK(t, !*p, "-j 4: output not of whole jobs at: %.80s", p);
+    for (size_t i = 0; i < TEST_PHYS; i++) {
+        snprintf(line, sizeof(line), "%s:%zu: profile %s: exit 0, ", script, i + 3, test_phys[i]);
+        TEST_CHECK(t, seen[i] == 1, "-j 4: %s run %d times", test_phys[i], seen[i]);
+        TEST_CHECK(t, test_count(err, line) == 1, "-j 4: no report \"%s\"", line);
+    }
+    snprintf(line, sizeof(line), "[cli] %s: %zu jobs, 0 failed, ", script, TEST_PHYS);
+    TEST_CHECK(t, strstr(err, line) != NULL, "-j 4: no summary \"%s\" in %s", line, err);
+    free(out);
+    free(err);
+
+    /* From stdin, serial: in order, "wait" and help after the commands
+       before them, a failure reported alone and the run 1 */
+    TEST_CHECK(t, test_write(script, "phonons\nentropy\nwait\nhelp\nno_such_command\nquit\nphonons\n") == 0,
+               "cannot write %s", script);
+    rc = test_holos(&cli, script, (const char *[]){NULL});
+    out = test_slurp(cli.out);
+    err = test_slurp(cli.err);
+    TEST_CHECK(t, rc == 1, "stdin: exit %d, not 1 for a failed command", rc);
+    TEST_CHECK(t, out && err, "no output of holos");
+    if (!out || !err) goto out;
+    p = strstr(out, "Running phonons...\nRunning entropy...\nAvailable commands:\n");
+    TEST_CHECK(t, p == out, "stdin: not run in order: %s", out);
+    TEST_CHECK(t, test_count(out, "Running phonons...") == 1, "stdin: ran past quit: %s", out);
+    TEST_CHECK(t, strstr(out, "Unknown command: no_such_command\n") != NULL, "stdin: unknown command not said");
+    TEST_CHECK(t, test_count(err, "[cli] stdin:") == 2, "stdin: not only the failure and summary reported: %s", err);
+    TEST_CHECK(t, strstr(err, "[cli] stdin:5: no_such_command: exit 127, ") != NULL, "stdin: failure not reported");
+    TEST_CHECK(t, strstr(err, "[cli] stdin: 4 jobs, 1 failed, ") != NULL, "stdin: no summary in %s", err);
+    free(out);
+    free(err);
+    out = err = NULL;
+
+    /* One command, and usage errors */
+    rc = test_holos(&cli, NULL, (const char *[]){"phonons", NULL});
+    out = test_slurp(cli.out);
+    TEST_CHECK(t, rc == 0 && out && strcmp(out, "Running phonons...\n") == 0, "holos phonons: exit %d, %s", rc,
+               out ? out : "no output");
+    rc = test_holos(&cli, NULL, (const char *[]){"no_such_command", NULL});
+    TEST_CHECK(t, rc == 127, "holos no_such_command: exit %d", rc);
+    rc = test_holos(&cli, NULL, (const char *[]){"-j", "x", NULL});
+    TEST_CHECK(t, rc == 2, "-j x: exit %d", rc);
+    rc = test_holos(&cli, NULL, (const char *[]){"-j", "1025", NULL});
+    TEST_CHECK(t, rc == 2, "-j 1025: exit %d", rc);
+    rc = test_holos(&cli, NULL, (const char *[]){"--batch", script, "phonons", NULL});
+    TEST_CHECK(t, rc == 2, "--batch with a command: exit %d", rc);
+    rc = test_holos(&cli, NULL, (const char *[]){"--batch", test_path(t, "missing"), NULL});
+    TEST_CHECK(t, rc == 2, "--batch of a missing script: exit %d", rc);
+out:
+    free(out);
+    free(err);
+}
+
+/* ---------------- P2P Metrics ---------------- */
+
+/* Fields of the row of name in the table of "p2p stats": 0 if none */
+static int test_stats_row(const char *text, const char *name, unsigned long long v[4]) {
+    char row[64];
+    const char *p;
+    snprintf(row, sizeof(row), "\n%s ", name);
+    if (!(p = strstr(text, row))) return 0;
+    return sscanf(p + strlen(row), "%llu %llu %llu %llu", &v[0], &v[1], &v[2], &v[3]) == 4;
+}
+
+/*
+    "p2p stats" of holos over a loopback link: a topic published to the
+    peer counted once out and once in, in the table of records; "reset"
+    zeroes it, as "json" shows, and another argument prints the usage.
+    A GNUnet build has no loopback link, and skips.
+*/
+void test_cli_p2p_stats(struct test *t) {
+#ifndef HAVE_GNUNET
+    struct test_cli cli;
+    char script[TEST_CLI_PATH];
+    char *out = NULL;
+    unsigned long long pub[4] = {0}, peer[4] = {0};
+    const char *json;
+    int rc;
+    if (test_cli_setup(t, &cli) != 0) return;
+    snprintf(script, sizeof(script), "%s", test_path(t, "script"));
+    TEST_CHECK(t,
+               test_write(script, "p2p connect test-peer\np2p subscribe t\np2p publish t hello\np2p stats\n"
+                                  "p2p stats reset\np2p stats json\np2p stats bogus\n") == 0,
+               "cannot write %s", script);
+    rc = test_holos(&cli, script, (const char *[]){NULL});
+    out = test_slurp(cli.out);
+    TEST_CHECK(t, rc == 0 && out, "p2p stats: exit %d", rc);
+    if (!out) return;
+    TEST_CHECK(t, strstr(out, "[t] test-peer: hello\n") != NULL, "not published over the link: %s", out);
+    TEST_CHECK(t, test_stats_row(out, "publish", pub) && pub[0] == pub[1] && pub[0] > 5 && pub[2] == 1 && pub[3] == 1,
+               "publish: %llu bytes out, %llu in, %llu out, %llu in", pub[0], pub[1], pub[2], pub[3]);
+    TEST_CHECK(t, test_stats_row(out, "test-peer", peer) && peer[0] == peer[1] && peer[0] >= pub[0],
+               "test-peer: %llu bytes out, %llu in", peer[0], peer[1]);
+    TEST_CHECK(t, strstr(out, "\nround trips:\n") && strstr(out, "\nretries: refused 0 "), "no round trips or retries");
+    json = strstr(out, "{\"peers\":[");
+    TEST_CHECK(t, json && strstr(json, "{\"id\":\"test-peer\",\"bytes_sent\":0,") && strstr(json, "\"records\":{}"),
+               "json after the reset: %.200s", json ? json : out);
+    TEST_CHECK(t, strstr(out, "Usage: p2p stats [json | reset]\n") != NULL, "bogus: no usage");
+    free(out);
+#else
+    test_skip(t, "GNUnet build: no loopback links");
+#endif
+}
+
+/* ---------------- Modules ---------------- */
+
+/* Writes dir/name with text; 0 or -1 */
+static int test_write_in(const char *dir, const char *name, const char *text) {
+    char path[TEST_CLI_PATH + 64];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    return test_write(path, text);
+}
+
+void test_cli_plugins(struct test *t) {
+    static const char *const names[] = {"one", "two", "three"};
+    static const char *const descriptions[] = {"The first", "", "The third"};
+    char a[TEST_CLI_PATH], b[TEST_CLI_PATH], path[3 * TEST_CLI_PATH];
+    size_t n;
+    snprintf(a, sizeof(a), "%s", test_path(t, "a"));
+    snprintf(b, sizeof(b), "%s", test_path(t, "b"));
+    if (mkdir(a, 0755) != 0 || mkdir(b, 0755) != 0) {
+        TEST_CHECK(t, 0, "cannot make the module directories");
+        return;
+    }
+
+    /* Manifests in name order, directories in path order, the first of
+       a name kept; lines out of place skipped; libraries not opened */
+    TEST_CHECK(t,
+               test_write_in(a, "b.manifest", "library lib2.so\ncommand two run_two\ncommand one run_again Again\n") == 0 &&
+                   test_write_in(a, "a.manifest",
+                                 "# first\ncommand early run_early Before a library\nlibrary lib1.so\n"
+                                 "command one run_one \t The first\nnot a line\ncommand\n") == 0 &&
+                   test_write_in(a, "notes.txt", "library lib4.so\ncommand four run_four\n") == 0 &&
+                   test_write_in(a, ".manifest", "library lib5.so\ncommand five run_five\n") == 0 &&
+                   test_write_in(b, "c.manifest", "library lib3.so\r\ncommand three run_three The third\r\n"
+                                                  "command two run_two_again\r\n") == 0,
+               "cannot write the manifests");
+    snprintf(path, sizeof(path), "%s:%s:%s", a, test_path(t, "missing"), b);
+    n = cli_plugins_load(path);
+    TEST_CHECK(t, n == 3 && cli_plugin_count() == 3, "%zu commands, not 3", n);
+    for (size_t i = 0; i < 3 && i < cli_plugin_count(); i++) {
+        TEST_CHECK(t, strcmp(cli_plugin_name(i), names[i]) == 0, "command %zu: %s, not %s", i, cli_plugin_name(i), names[i]);
+        TEST_CHECK(t, strcmp(cli_plugin_description(i), descriptions[i]) == 0, "%s: \"%s\", not \"%s\"", names[i],
+                   cli_plugin_description(i), descriptions[i]);
+    }
+    TEST_CHECK(t, !cli_plugin_name(3) && !cli_plugin_description(3), "a command past the last");
+
+    /* A module that does not open: none of its commands, asked twice */
+    TEST_CHECK(t, !cli_plugin_find("one") && !cli_plugin_find("one"), "one: a function of a missing library");
+    TEST_CHECK(t, !cli_plugin_find("four") && !cli_plugin_find("five") && !cli_plugin_find("early"), "a command skipped found");
+    TEST_CHECK(t, !cli_plugin_find("") && !cli_plugin_find(NULL) && !cli_plugin_find("on"), "a command never named found");
+    cli_plugins_free();
+    TEST_CHECK(t, cli_plugin_count() == 0 && !cli_plugin_find("one"), "commands left after cli_plugins_free");
+
+    /* Loaded anew, and from no manifest */
+    n = cli_plugins_load(b);
+    TEST_CHECK(t, n == 2 && strcmp(cli_plugin_name(1), "two") == 0, "%s alone: %zu commands", b, n);
+    cli_plugins_free();
+    n = cli_plugins_load(test_path(t, "missing"));
+    TEST_CHECK(t, n == 0 && !cli_plugin_find("three"), "%zu commands of no manifest", n);
+    cli_plugins_free();
+}
+
+#define TEST_COMMANDS 2000
+
+void test_cli_plugin_open(struct test *t) {
+    const char *library = getenv("HOLOS_TEST_PLUGIN");
+    char dir[TEST_CLI_PATH], path[TEST_CLI_PATH + 64], name[32];
+    void *handle = NULL, *sym;
+    phys_func_t func;
+    FILE *f[2];
+    size_t n;
+    int wrong = 0;
+    if (!library || !*library || access(library, R_OK) != 0) {
+        test_skip(t, "no module to open: see HOLOS_TEST_PLUGIN");
+        return;
+    }
+    snprintf(dir, sizeof(dir), "%s", test_path(t, "plugins"));
+    if (mkdir(dir, 0755) != 0) {
+        TEST_CHECK(t, 0, "cannot make %s", dir);
+        return;
+    }
+
+    /* Many commands on the nine functions of the module, some named
+       again by a later manifest, and one of a function it lacks */
+    snprintf(path, sizeof(path), "%s/a.manifest", dir);
+    f[0] = fopen(path, "w");
+    snprintf(path, sizeof(path), "%s/b.manifest", dir);
+    f[1] = fopen(path, "w");
+    TEST_CHECK(t, f[0] && f[1], "cannot write the manifests");
+    if (!f[0] || !f[1]) {
+        if (f[0]) fclose(f[0]);
+        if (f[1]) fclose(f[1]);
+        return;
+    }
+    for (int k = 0; k < 2; k++) fprintf(f[k], "library %s\n", library);
+    for (size_t i = 0; i < TEST_COMMANDS; i++) {
+        fprintf(f[0], "command c%zu run_%s\n", i, test_phys[i % TEST_PHYS]);
+        if (i % 100 == 0) fprintf(f[1], "command c%zu run_%s\n", i, test_phys[(i + 1) % TEST_PHYS]);
+    }
+    fprintf(f[0], "command broken run_no_such_function\n");
+    TEST_CHECK(t, fclose(f[0]) == 0 && fclose(f[1]) == 0, "cannot write the manifests");
+
+    n = cli_plugins_load(dir);
+    TEST_CHECK(t, n == TEST_COMMANDS + 1, "%zu commands, not %d", n, TEST_COMMANDS + 1);
+    TEST_CHECK(t, !dlopen(library, RTLD_NOW | RTLD_NOLOAD), "%s open before a command ran", library);
+
+    /* Opened at the first command: each the function named first */
+    TEST_CHECK(t, !cli_plugin_find("broken"), "broken: a function the module lacks");
+    for (size_t i = 0; i < TEST_COMMANDS; i++) {
+        snprintf(name, sizeof(name), "c%zu", i);
+        func = cli_plugin_find(name);
+        if (!handle) {
+            handle = dlopen(library, RTLD_NOW | RTLD_NOLOAD);
+            TEST_CHECK(t, handle != NULL, "%s not open after %s", library, name);
+            if (!handle) break;
+        }
+        snprintf(path, sizeof(path), "run_%s", test_phys[i % TEST_PHYS]);
+        sym = dlsym(handle, path);
+        wrong += !func || memcmp(&func, &sym, sizeof(sym)) != 0 || cli_plugin_find(name) != func;
+    }
+    TEST_CHECK(t, wrong == 0, "%d of %d commands not their first function", wrong, TEST_COMMANDS);
+    snprintf(name, sizeof(name), "c%d", TEST_COMMANDS);
+    TEST_CHECK(t, !cli_plugin_find(name) && !cli_plugin_find("c") && !cli_plugin_find("c01"), "a command never named found");
+    if (handle) dlclose(handle);
+    cli_plugins_free();
+    TEST_CHECK(t, !(handle = dlopen(library, RTLD_NOW | RTLD_NOLOAD)), "%s open after cli_plugins_free", library);
+    if (handle) dlclose(handle);
+}
@@ -0,0 +1,1018 @@
+/* test_dynamics.c - Tests of the classical dynamics of HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+   ----------------------------------------------------------------------
+   Small systems whose energy must hold, or whose forces are known from
+   a plain double loop; integrators must step through a workspace of the
+   caller's as through the system's own, and the diagnostics they fuse
+   are held to plain loops. Claims of determinism are checked bit for
+   bit, on other thread counts. Tree forces are held to the direct
+   sums, to errors that must shrink with the opening angle and with the
+   quadrupoles. The pair kernel is run on each instruction set the CPU
+   has against a long double loop, and the neighbor lists against every
+   pair. Trajectory frames must read back as they were written. A GPU
+   must follow the host steps; without one, the offload case skips.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <gsl/gsl_vector.h>
+
+#include "core/phys/mech/classical/kinematics.h"
+#include "core/phys/mech/classical/dynamics.h"
+#include "core/phys/mech/classical/dynamics_gpu.h"
+#include "core/phys/mech/classical/trajectory.h"
+#include "core/phys/pair_kernel.h"
+#include "tests.h"
+
+static uint64_t g_rand;
+
+/* Uniform in [-1, 1) from a fixed seed */
+static double test_random(void) {
+    g_rand ^= g_rand << 13;
+    g_rand ^= g_rand >> 7;
+    g_rand ^= g_rand << 17;
+    return (double)(g_rand >> 11) * 0x1.0p-52 - 1.0;
+}
+
+/* ---------------- Integrators ---------------- */
+
+/* A circular binary of unit separation, masses 1/2: period 2 pi */
+static dyn_system_t *test_binary(void) {
+    dyn_system_t *sys = dyn_system_alloc(2);
+    if (!sys) return NULL;
+    dyn_system_set_gravity(sys, 1.0);
+    for (size_t i = 0; i < 2; i++) {
+        gsl_vector_set(sys->particles[i].pos, 0, i ? 0.5 : -0.5);
+        gsl_vector_set(sys->particles[i].vel, 1, i ? 0.5 : -0.5);
+        sys->particles[i].mass = 0.5;
+    }
+    dyn_system_sync_masses(sys);
+    return sys;
+}
+
+/*
+    One period of the binary with each integrator, through the system's
+    own workspace and through one of the caller's that has to grow: both
+    must give the same bits, the system keeping the workspace it made.
+    RK4 must close the orbit, Verlet and leapfrog keep the energy, and
+    Verlet leave behind the forces of its last positions.
+*/
+void test_integrators(struct test *t) {
+    enum { STEPS = 1000 };
+    static const dyn_integrator_t ints[] = {DYN_INT_EULER, DYN_INT_VERLET, DYN_INT_LEAPFROG, DYN_INT_RK4};
+    static const char *names[] = {"Euler", "Verlet", "leapfrog", "RK4"};
+    const double dt = 2.0 * M_PI / STEPS;
+    gsl_vector *pos = gsl_vector_alloc(3), *vel = gsl_vector_alloc(3), *acc = gsl_vector_calloc(3);
+
+    /* euler_step in place: v += a dt, then x += v dt */
+    if (!pos || !vel || !acc) {
+        TEST_CHECK(t, 0, "out of memory");
+        goto done;
+    }
+    for (size_t a = 0; a < 3; a++) {
+        gsl_vector_set(pos, a, 1.0 + (double)a);
+        gsl_vector_set(vel, a, a == 0 ? 1.0 : 0.0);
+    }
+    gsl_vector_set(acc, 1, 2.0);
+    euler_step(pos, vel, acc, 0.5);
+    TEST_CHECK(t, gsl_vector_get(pos, 0) == 1.5 && gsl_vector_get(pos, 1) == 2.5 && gsl_vector_get(pos, 2) == 3.0 &&
+                      gsl_vector_get(vel, 0) == 1.0 && gsl_vector_get(vel, 1) == 1.0 && gsl_vector_get(vel, 2) == 0.0,
+               "euler_step: x (%g %g %g), v (%g %g %g)", gsl_vector_get(pos, 0), gsl_vector_get(pos, 1),
+               gsl_vector_get(pos, 2), gsl_vector_get(vel, 0), gsl_vector_get(vel, 1), gsl_vector_get(vel, 2));
+
+    for (size_t k = 0; k < sizeof(ints) / sizeof(ints[0]); k++) {
+        dyn_system_t *a = test_binary(), *b = test_binary();
+        dyn_workspace_t *ws = dyn_workspace_alloc(1), *own = NULL;
+        double e0, e1, f[3];
+        int same = 1;
+        if (!a || !b || !ws) {
+            TEST_CHECK(t, 0, "%s: out of memory", names[k]);
+            goto next;
+        }
+        e0 = dyn_system_total_energy(a);
+        for (int s = 0; s < STEPS; s++) {
+            if (dyn_system_step(a, dt, ints[k]) != 0 || dyn_system_step_ws(b, dt, ints[k], ws) != 0) {
+                TEST_CHECK(t, 0, "%s: step %d failed", names[k], s);
+                goto next;
+            }
+            if (s == 0) own = a->workspace;
+            TEST_CHECK(t, a->workspace == own, "%s: step %d replaced the workspace", names[k], s);
+            if (a->workspace != own) goto next;
+        }
+        for (size_t i = 0; i < 2; i++)
+            for (size_t c = 0; c < 3; c++)
+                if (memcmp(gsl_vector_ptr(a->particles[i].pos, c), gsl_vector_ptr(b->particles[i].pos, c),
+                           sizeof(double)) != 0 ||
+                    memcmp(gsl_vector_ptr(a->particles[i].vel, c), gsl_vector_ptr(b->particles[i].vel, c),
+                           sizeof(double)) != 0)
+                    same = 0;
+        TEST_CHECK(t, same, "%s: the caller's workspace does not give the bits of the system's", names[k]);
+        TEST_CHECK(t, own && own->capacity >= 2 && ws->capacity >= 2, "%s: workspaces of %zu and %zu particles",
+                   names[k], own ? own->capacity : 0, ws->capacity);
+        e1 = dyn_system_total_energy(a);
+        if (ints[k] == DYN_INT_RK4) {
+            const double dx = gsl_vector_get(a->particles[0].pos, 0) + 0.5, dy = gsl_vector_get(a->particles[0].pos, 1);
+            TEST_CHECK(t, hypot(dx, dy) < 1e-6, "RK4: the orbit closes %g off", hypot(dx, dy));
+        }
+        if (ints[k] == DYN_INT_VERLET || ints[k] == DYN_INT_LEAPFROG)
+            TEST_CHECK(t, fabs((e1 - e0) / e0) < 1e-4, "%s: relative energy error %g", names[k], (e1 - e0) / e0);
+        if (ints[k] == DYN_INT_VERLET) {
+            TEST_CHECK(t, a->forces_valid, "Verlet: forces not kept");
+            for (size_t c = 0; c < 3; c++) f[c] = gsl_vector_get(a->particles[0].force, c);
+            a->forces_valid = 0;
+            dyn_system_compute_forces(a);
+            for (size_t c = 0; c < 3; c++)
+                TEST_CHECK(t, f[c] == gsl_vector_get(a->particles[0].force, c), "Verlet: force %zu %g, not %g", c,
+                           f[c], gsl_vector_get(a->particles[0].force, c));
+        }
+    next:
+        dyn_workspace_free(ws);
+        dyn_system_free(a);
+        dyn_system_free(b);
+    }
+done:
+    gsl_vector_free(pos);
+    gsl_vector_free(vel);
+    gsl_vector_free(acc);
+}
+
+/* ---------------- Diagnostics ---------------- */
+
+/* The record of the current state of sys, by plain loops */
+static void test_diag_ref(const dyn_system_t *sys, dyn_diagnostics_t *d) {
+    const double eps2 = sys->softening_eps * sys->softening_eps;
+    memset(d, 0, sizeof(*d));
+    for (size_t i = 0; i < sys->N; i++) {
+        const double m = sys->particles[i].mass;
+        double x[3], v[3];
+        for (size_t a = 0; a < 3; a++) {
+            x[a] = gsl_vector_get(sys->particles[i].pos, a);
+            v[a] = gsl_vector_get(sys->particles[i].vel, a);
+        }
+        d->total_mass += m;
+        d->kinetic += 0.5 * m * (v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+        for (size_t a = 0; a < 3; a++) {
+            d->momentum[a] += m * v[a];
+            d->angular[a] += m * (x[(a + 1) % 3] * v[(a + 2) % 3] - x[(a + 2) % 3] * v[(a + 1) % 3]);
+            d->com[a] += m * x[a];
+        }
+        for (size_t j = i + 1; j < sys->N; j++) {
+            double r2 = eps2;
+            for (size_t a = 0; a < 3; a++) {
+                const double dx = gsl_vector_get(sys->particles[j].pos, a) - x[a];
+                r2 += dx * dx;
+            }
+            d->potential -= sys->G * m * sys->particles[j].mass / sqrt(r2);
+        }
+    }
+    for (size_t a = 0; a < 3; a++) {
+        d->com[a] /= d->total_mass;
+        d->com_vel[a] = d->momentum[a] / d->total_mass;
+    }
+    d->energy = d->kinetic + d->potential;
+}
+
+/* Largest relative difference of the fields of d to ref */
+static double test_diag_err(const dyn_diagnostics_t *d, const dyn_diagnostics_t *ref, int with_pot) {
+    double err = fabs(d->kinetic - ref->kinetic) / ref->kinetic;
+    double pscale = 0.0, lscale = 0.0, xscale = 0.0, vscale = 0.0;
+    for (size_t a = 0; a < 3; a++) {
+        pscale = fmax(pscale, fabs(ref->momentum[a]));
+        lscale = fmax(lscale, fabs(ref->angular[a]));
+        xscale = fmax(xscale, fabs(ref->com[a]));
+        vscale = fmax(vscale, fabs(ref->com_vel[a]));
+    }
+    for (size_t a = 0; a < 3; a++) {
+        err = fmax(err, fabs(d->momentum[a] - ref->momentum[a]) / pscale);
+        err = fmax(err, fabs(d->angular[a] - ref->angular[a]) / lscale);
+        err = fmax(err, fabs(d->com[a] - ref->com[a]) / xscale);
+        err = fmax(err, fabs(d->com_vel[a] - ref->com_vel[a]) / vscale);
+    }
+    err = fmax(err, fabs(d->total_mass - ref->total_mass) / ref->total_mass);
+    if (with_pot) {
+        err = fmax(err, fabs(d->potential - ref->potential) / fabs(ref->potential));
+        err = fmax(err, fabs(d->energy - ref->energy) / fabs(ref->energy));
+    }
+    return err;
+}
+
+/*
+    A softened cluster stepped with diagnostics on: the record velocity
+    Verlet fuses into its steps must be that of plain loops over the
+    state it reached, the potential included; leapfrog, whose forces
+    are those of the half step, must leave the potential out. Energy
+    and momentum hold against the reference, and stop holding when a
+    particle is kicked by hand.
+*/
+void test_diagnostics(struct test *t) {
+    enum { N = 64, STEPS = 20 };
+    dyn_system_t *sys = dyn_system_alloc(N);
+    const dyn_diagnostics_t *d;
+    dyn_diagnostics_t ref;
+    if (!sys) {
+        TEST_CHECK(t, 0, "out of memory");
+        return;
+    }
+    g_rand = 0x64696167ull;
+    dyn_system_set_gravity(sys, 1.0);
+    dyn_system_set_softening(sys, true, 0.1);
+    for (size_t i = 0; i < N; i++) {
+        for (size_t a = 0; a < 3; a++) {
+            gsl_vector_set(sys->particles[i].pos, a, test_random());
+            gsl_vector_set(sys->particles[i].vel, a, 0.3 * test_random());
+        }
+        sys->particles[i].mass = 1.0 + 0.5 * test_random();
+    }
+    dyn_system_sync_masses(sys);
+    TEST_CHECK(t, dyn_system_set_diagnostics(sys, DYN_DIAG_ALL) == 0, "diagnostics refused");
+    d = dyn_system_diagnostics(sys);
+    TEST_CHECK(t, d->mask == 0, "a record (mask %#x) before any step", d->mask);
+    TEST_CHECK(t, dyn_system_check_conservation(sys, 1e-12) == 0, "the reference does not hold at once");
+
+    for (int s = 0; s < STEPS; s++)
+        if (dyn_system_step(sys, 1e-3, DYN_INT_VERLET) != 0) {
+            TEST_CHECK(t, 0, "Verlet step %d failed", s);
+            goto done;
+        }
+    test_diag_ref(sys, &ref);
+    TEST_CHECK(t, d->mask == DYN_DIAG_ALL && d->step == STEPS && d->t == sys->t, "Verlet: mask %#x, step %d, t %g",
+               d->mask, d->step, d->t);
+    TEST_CHECK(t, test_diag_err(d, &ref, 1) < 1e-12, "Verlet: record off the loops by %g", test_diag_err(d, &ref, 1));
+    TEST_CHECK(t, dyn_system_total_potential(sys) == d->potential, "the potential is not taken from the record");
+    TEST_CHECK(t, dyn_system_check_conservation(sys, 1e-4) == 0, "Verlet: energy or momentum lost");
+
+    TEST_CHECK(t, dyn_system_step(sys, 1e-3, DYN_INT_LEAPFROG) == 0, "leapfrog step failed");
+    test_diag_ref(sys, &ref);
+    TEST_CHECK(t, d->mask == (DYN_DIAG_ALL & ~DYN_DIAG_POTENTIAL) && d->step == STEPS + 1,
+               "leapfrog: mask %#x, step %d", d->mask, d->step);
+    TEST_CHECK(t, test_diag_err(d, &ref, 0) < 1e-12, "leapfrog: record off the loops by %g", test_diag_err(d, &ref, 0));
+    TEST_CHECK(t, fabs(dyn_system_total_potential(sys) - ref.potential) < 1e-12 * fabs(ref.potential),
+               "potential of a dedicated pass %g, not %g", dyn_system_total_potential(sys), ref.potential);
+
+    *gsl_vector_ptr(sys->particles[0].vel, 0) += 1.0;
+    sys->forces_valid = 0;
+    TEST_CHECK(t, dyn_system_check_conservation(sys, 1e-4) == 1, "a kick by hand went unnoticed");
+done:
+    dyn_system_free(sys);
+}
+
+/* ---------------- Block Time-Stepping ---------------- */
+
+/*
+    A hard binary (separation 0.01, period 2 pi 10^-3) among light field
+    particles a distance 1 away: the binary needs steps a hundred times
+    finer than the field, so its particles must sit on finer levels and
+    the step must take far fewer force evaluations than the global
+    finest step would, while keeping the energy.
+*/
+void test_block_timesteps(struct test *t) {
+    enum { N_FIELD = 30, N_STEPS = 20, MAX_LEVEL = 10 };
+    const size_t N = N_FIELD + 2;
+    dyn_system_t *sys = dyn_system_alloc(N);
+    double e0, e1;
+    int field_level = 0, binary_level[2];
+    if (!sys) {
+        TEST_CHECK(t, 0, "out of memory");
+        return;
+    }
+    g_rand = 0x484f4c4f53ull;
+    dyn_system_set_gravity(sys, 1.0);
+    for (size_t i = 0; i < N; i++) {
+        gsl_vector_view pos = dyn_system_particle_vector(sys, DYN_FIELD_POS, i);
+        gsl_vector_view vel = dyn_system_particle_vector(sys, DYN_FIELD_VEL, i);
+        for (size_t a = 0; a < 3; a++) {
+            double x = 0, v = 0;
+            if (i < 2) {
+                x = a == 0 ? (i ? 0.005 : -0.005) : 0;
+                v = a == 1 ? (i ? 5.0 : -5.0) : 0;
+            } else {
+                x = (a == 0 ? 1.0 : 0.0) + 0.3 * test_random();
+                v = 0.1 * test_random();
+            }
+            *gsl_vector_ptr(&pos.vector, a) = x;
+            *gsl_vector_ptr(&vel.vector, a) = v;
+        }
+        sys->particles[i].mass = i < 2 ? 0.5 : 1e-4;
+    }
+    dyn_system_sync_masses(sys);
+    TEST_CHECK(t, dyn_system_set_block_timesteps(sys, MAX_LEVEL, 0.02) == 0, "block time-stepping refused");
+    e0 = dyn_system_total_energy(sys);
+    for (int s = 0; s < N_STEPS; s++) {
+        if (dyn_system_step(sys, 0.01, DYN_INT_LEAPFROG) != 0) {
+            TEST_CHECK(t, 0, "step %d failed", s);
+            break;
+        }
+    }
+    e1 = dyn_system_total_energy(sys);
+    TEST_CHECK(t, fabs((e1 - e0) / e0) < 1e-6, "relative energy error %g", (e1 - e0) / e0);
+    for (size_t i = 2; i < N; i++)
+        if (dyn_system_particle_level(sys, i) > field_level) field_level = dyn_system_particle_level(sys, i);
+    binary_level[0] = dyn_system_particle_level(sys, 0);
+    binary_level[1] = dyn_system_particle_level(sys, 1);
+    TEST_CHECK(t, binary_level[0] > field_level + 3 && binary_level[1] > field_level + 3,
+               "binary on levels %d and %d, field up to %d", binary_level[0], binary_level[1], field_level);
+    TEST_CHECK(t, sys->blocks->n_force_evals * 20 < (size_t)N * N_STEPS << MAX_LEVEL,
+               "%zu force evaluations, against %zu at the finest global step", sys->blocks->n_force_evals,
+               (size_t)N * N_STEPS << MAX_LEVEL);
+    dyn_system_free(sys);
+}
+
+/* ---------------- Parallel Forces ---------------- */
+
+/* Forces of a random cluster on n_threads, into f (3 N), and its potential */
+static int test_gravity_run(dyn_layout_t layout, int n_threads, size_t N, double *f, double *u) {
+    dyn_system_t *sys = dyn_system_alloc(N);
+    int rc = -1;
+    if (!sys) return -1;
+    g_rand = 0x67726176ull;
+    dyn_system_set_gravity(sys, 1.0);
+    dyn_system_set_softening(sys, true, 1e-3);
+    for (size_t i = 0; i < N; i++) {
+        for (size_t a = 0; a < 3; a++) gsl_vector_set(sys->particles[i].pos, a, test_random());
+        sys->particles[i].mass = 1.0 + 0.5 * test_random();
+    }
+    if (dyn_system_set_layout(sys, layout) == 0 && dyn_system_set_diagnostics(sys, DYN_DIAG_POTENTIAL) == 0) {
+        dyn_system_set_threads(sys, n_threads);
+        if (dyn_system_compute_forces(sys) == 0) {
+            for (size_t i = 0; i < N; i++)
+                for (size_t a = 0; a < 3; a++) f[3 * i + a] = gsl_vector_get(sys->particles[i].force, a);
+            *u = sys->diag.potential;
+            rc = 0;
+        }
+    }
+    dyn_system_free(sys);
+    return rc;
+}
+
+/*
+    Direct gravity sums every force in index order whatever the thread
+    count, the default 0 included: the forces and potential of 0 to 4
+    threads must agree bit for bit, and with a plain double loop.
+*/
+void test_gravity_threads(struct test *t) {
+    enum { N = 300 };
+    static const char *names[] = {"AoS", "SoA"};
+    double *ref = malloc(3 * N * sizeof(*ref)), *f = malloc(3 * N * sizeof(*f)), u0, u;
+    if (!ref || !f) {
+        TEST_CHECK(t, 0, "out of memory");
+        goto done;
+    }
+    for (int l = 0; l < 2; l++) {
+        const dyn_layout_t layout = l ? DYN_LAYOUT_SOA : DYN_LAYOUT_AOS;
+        if (test_gravity_run(layout, 0, N, ref, &u0) != 0) {
+            TEST_CHECK(t, 0, "%s: forces failed", names[l]);
+            continue;
+        }
+        for (int nt = 1; nt <= 4; nt++) {
+            if (test_gravity_run(layout, nt, N, f, &u) != 0) {
+                TEST_CHECK(t, 0, "%s, %d threads: forces failed", names[l], nt);
+                continue;
+            }
+            TEST_CHECK(t, memcmp(ref, f, 3 * N * sizeof(*f)) == 0 && memcmp(&u0, &u, sizeof(u)) == 0,
+                       "%s: %d threads do not give the bits of the default", names[l], nt);
+        }
+        /* The same sums, in any order, within rounding */
+        g_rand = 0x67726176ull;
+        {
+            double x[N][3], m[N], err = 0.0, scale = 0.0;
+            for (size_t i = 0; i < N; i++) {
+                for (size_t a = 0; a < 3; a++) x[i][a] = test_random();
+                m[i] = 1.0 + 0.5 * test_random();
+            }
+            for (size_t i = 0; i < N; i++)
+                for (size_t a = 0; a < 3; a++) {
+                    double want = 0.0;
+                    for (size_t j = 0; j < N; j++) {
+                        const double dx = x[j][0] - x[i][0], dy = x[j][1] - x[i][1], dz = x[j][2] - x[i][2];
+                        const double r2 = dx * dx + dy * dy + dz * dz + 1e-6;
+                        if (j != i) want += m[i] * m[j] * (a == 0 ? dx : a == 1 ? dy : dz) / (r2 * sqrt(r2));
+                    }
+                    err = fmax(err, fabs(ref[3 * i + a] - want));
+                    scale = fmax(scale, fabs(want));
+                }
+            TEST_CHECK(t, err < 1e-10 * scale, "%s: force off the double loop by %g of %g", names[l], err, scale);
+        }
+    }
+done:
+    free(ref);
+    free(f);
+}
+
+/* ---------------- Pair Kernel ---------------- */
+
+/*
+    Every instruction set the CPU has, against a long double loop: the
+    forces and potentials of a subrange of targets, added to what was
+    there, with lanes left over at the end of the sources and a pair of
+    coincident particles without softening. The error is taken relative
+    to the sum of the magnitudes of the terms, as the refined reciprocal
+    square root is good to about 1e-14 a pair, not after cancellation.
+*/
+void test_pair_kernel(struct test *t) {
+    enum { N = 37, I0 = 3, I1 = 30 };
+    static const pk_isa_t isas[] = {PK_ISA_SCALAR, PK_ISA_AVX2, PK_ISA_AVX512, PK_ISA_NEON};
+    double x[N], y[N], z[N], w[N], want[4][N], scale[N];
+    int ran = 0;
+    g_rand = 0x706b6e6cull;
+    for (size_t i = 0; i < N; i++) {
+        x[i] = test_random();
+        y[i] = test_random();
+        z[i] = test_random();
+        w[i] = 1.0 + 0.5 * test_random();
+    }
+    x[N - 1] = x[N - 2];                /* Coincident: r = 0 */
+    y[N - 1] = y[N - 2];
+    z[N - 1] = z[N - 2];
+    for (int e = 0; e < 2; e++) {
+        const double eps2 = e ? 1e-4 : 0.0;
+        for (size_t i = 0; i < N; i++) {
+            long double acc[4] = {0, 0, 0, 0}, sum = 0;
+            for (size_t j = 0; j < N; j++) {
+                const long double dx = x[j] - x[i], dy = y[j] - y[i], dz = z[j] - z[i];
+                const long double r2 = dx * dx + dy * dy + dz * dz + eps2;
+                if (j == i || r2 == 0) continue;
+                acc[0] += w[j] * dx / (r2 * sqrtl(r2));
+                acc[1] += w[j] * dy / (r2 * sqrtl(r2));
+                acc[2] += w[j] * dz / (r2 * sqrtl(r2));
+                acc[3] += w[j] / sqrtl(r2);
+                sum += w[j] / r2 + w[j] / sqrtl(r2);
+            }
+            for (int a = 0; a < 4; a++) want[a][i] = (double)(1.5L * w[i] * acc[a]) + 1.0;
+            scale[i] = (double)(1.5L * w[i] * sum) + 1.0;  /* What the terms add to, before they cancel */
+        }
+        for (size_t k = 0; k < sizeof(isas) / sizeof(isas[0]); k++) {
+            double f[4][N], err = 0.0;
+            pk_set_isa(isas[k]);
+            if (pk_active_isa() != isas[k]) {
+                TEST_CHECK(t, pk_active_isa() == PK_ISA_SCALAR, "%s missing, not scalar: %s", pk_isa_name(isas[k]),
+                           pk_isa_name(pk_active_isa()));
+                continue;
+            }
+            ran += !e;
+            for (int a = 0; a < 4; a++)
+                for (size_t i = 0; i < N; i++) f[a][i] = 1.0;
+            pk_inverse_square_pot(x, y, z, w, N, I0, I1, 1.5, eps2, f[0], f[1], f[2], f[3]);
+            for (int a = 0; a < 4; a++)
+                for (size_t i = 0; i < N; i++) {
+                    if (i < I0 || i >= I1) {
+                        TEST_CHECK(t, f[a][i] == 1.0, "%s: target %zu out of range changed", pk_isa_name(isas[k]), i);
+                        continue;
+                    }
+                    err = fmax(err, fabs(f[a][i] - want[a][i]) / scale[i]);
+                }
+            TEST_CHECK(t, err < 1e-13, "%s, eps2 %g: off the long double loop by %g", pk_isa_name(isas[k]), eps2, err);
+            for (int a = 0; a < 3; a++)
+                for (size_t i = 0; i < N; i++) f[a][i] = 1.0;
+            pk_inverse_square(x, y, z, w, N, 0, N + 5, 1.5, eps2, f[0], f[1], f[2]);
+            err = 0.0;
+            for (int a = 0; a < 3; a++)
+                for (size_t i = 0; i < N; i++) err = fmax(err, fabs(f[a][i] - want[a][i]) / scale[i]);
+            TEST_CHECK(t, err < 1e-13, "%s, eps2 %g, every target: off by %g", pk_isa_name(isas[k]), eps2, err);
+        }
+    }
+    TEST_CHECK(t, ran >= 1, "no instruction set ran");
+    pk_set_isa(PK_ISA_AUTO);
+    TEST_CHECK(t, pk_active_isa() != PK_ISA_AUTO, "auto not resolved");
+}
+
+/* ---------------- Tree Gravity ---------------- */
+
+/* A cluster of N of the seed's random particles, softened */
+static dyn_system_t *test_cluster(size_t N, uint64_t seed) {
+    dyn_system_t *sys = dyn_system_alloc(N);
+    if (!sys) return NULL;
+    g_rand = seed;
+    dyn_system_set_gravity(sys, 1.0);
+    dyn_system_set_softening(sys, true, 1e-3);
+    for (size_t i = 0; i < N; i++) {
+        for (size_t a = 0; a < 3; a++) gsl_vector_set(sys->particles[i].pos, a, test_random());
+        sys->particles[i].mass = 1.0 + 0.5 * test_random();
+    }
+    dyn_system_sync_masses(sys);
+    return sys;
+}
+
+static void test_forces(const dyn_system_t *sys, double *f) {
+    for (size_t i = 0; i < sys->N; i++)
+        for (size_t a = 0; a < 3; a++) f[3 * i + a] = gsl_vector_get(sys->particles[i].force, a);
+}
+
+/* RMS over particles of |f - ref| / |ref| */
+static double test_force_error(const double *f, const double *ref, size_t N) {
+    double sum = 0.0;
+    for (size_t i = 0; i < N; i++) {
+        double d2 = 0.0, r2 = 0.0;
+        for (size_t a = 0; a < 3; a++) {
+            d2 += (f[3 * i + a] - ref[3 * i + a]) * (f[3 * i + a] - ref[3 * i + a]);
+            r2 += ref[3 * i + a] * ref[3 * i + a];
+        }
+        sum += d2 / r2;
+    }
+    return sqrt(sum / (double)N);
+}
+
+/*
+    The octree against direct sums: its error must shrink with theta and
+    with the quadrupoles, stay so on a reused topology after a drift,
+    and not depend on the threads; the forces of an active subset must
+    be those of the whole walk, the others left alone.
+*/
+void test_tree_gravity(struct test *t) {
+    enum { N = 2000 };
+    static const size_t active[] = {0, 7, 500, 1999};
+    dyn_system_t *sys = test_cluster(N, 0x74726565ull);
+    double *ref = malloc(3 * N * sizeof(*ref)), *f = malloc(3 * N * sizeof(*f)), *g = malloc(3 * N * sizeof(*g));
+    double mono, quad, fine, moved;
+    if (!sys || !ref || !f || !g) {
+        TEST_CHECK(t, 0, "out of memory");
+        goto done;
+    }
+    TEST_CHECK(t, dyn_system_compute_forces(sys) == 0, "direct forces failed");
+    test_forces(sys, ref);
+    TEST_CHECK(t, dyn_system_set_gravity_solver(sys, DYN_GRAVITY_BARNES_HUT, 0.0) != 0, "theta 0 taken");
+
+    dyn_system_set_gravity_solver(sys, DYN_GRAVITY_BARNES_HUT, 0.5);
+    TEST_CHECK(t, dyn_system_compute_forces(sys) == 0, "tree forces failed");
+    test_forces(sys, f);
+    mono = test_force_error(f, ref, N);
+    dyn_system_set_gravity_solver(sys, DYN_GRAVITY_BARNES_HUT_QUAD, 0.5);
+    dyn_system_compute_forces(sys);
+    test_forces(sys, f);
+    quad = test_force_error(f, ref, N);
+    dyn_system_set_gravity_solver(sys, DYN_GRAVITY_BARNES_HUT, 0.1);
+    dyn_system_compute_forces(sys);
+    test_forces(sys, f);
+    fine = test_force_error(f, ref, N);
+    TEST_CHECK(t, mono < 1e-2 && quad < 0.5 * mono && fine < 0.05 * mono,
+               "RMS force errors: %g at theta 0.5, %g with quadrupoles, %g at theta 0.1", mono, quad, fine);
+
+    /* The same walk on 4 threads, and for a few targets */
+    dyn_system_set_gravity_solver(sys, DYN_GRAVITY_BARNES_HUT_QUAD, 0.5);
+    dyn_system_set_threads(sys, 1);
+    dyn_system_compute_forces(sys);
+    test_forces(sys, f);
+    dyn_system_set_threads(sys, 4);
+    dyn_system_compute_forces(sys);
+    test_forces(sys, g);
+    TEST_CHECK(t, memcmp(f, g, 3 * N * sizeof(*f)) == 0, "tree forces differ on 4 threads");
+    for (size_t i = 0; i < N; i++)
+        for (size_t a = 0; a < 3; a++) gsl_vector_set(sys->particles[i].force, a, -1.0);
+    TEST_CHECK(t, dyn_system_compute_tree_gravity_active(sys, active, 4) == 0, "active forces failed");
+    test_forces(sys, g);
+    for (size_t i = 0, k = 0; i < N; i++) {
+        const int on = k < 4 && active[k] == i;
+        for (size_t a = 0; a < 3; a++)
+            TEST_CHECK(t, on ? g[3 * i + a] == f[3 * i + a] : g[3 * i + a] == -1.0, "particle %zu%s: force %g",
+                       i, on ? " (active)" : "", g[3 * i + a]);
+        k += on;
+    }
+
+    /* A drift under the tolerance: moments refitted on the old cells */
+    dyn_system_set_tree_rebuild_tolerance(sys, 0.5);
+    dyn_system_compute_forces(sys);
+    for (size_t i = 0; i < N; i++)
+        for (size_t a = 0; a < 3; a++) *gsl_vector_ptr(sys->particles[i].pos, a) += 1e-4 * test_random();
+    dyn_system_compute_forces(sys);
+    test_forces(sys, f);
+    dyn_system_set_gravity_solver(sys, DYN_GRAVITY_DIRECT, 0.0);
+    dyn_system_compute_forces(sys);
+    test_forces(sys, ref);
+    moved = test_force_error(f, ref, N);
+    TEST_CHECK(t, moved < 1.5 * quad, "RMS force error %g on a reused tree, %g built anew", moved, quad);
+done:
+    dyn_system_free(sys);
+    free(ref);
+    free(f);
+    free(g);
+}
+
+/* ---------------- Neighbor Lists ---------------- */
+
+static double test_distance(const dyn_system_t *sys, size_t i, size_t j) {
+    double d2 = 0.0;
+    for (size_t a = 0; a < 3; a++) {
+        const double d = gsl_vector_get(sys->particles[j].pos, a) - gsl_vector_get(sys->particles[i].pos, a);
+        d2 += d * d;
+    }
+    return sqrt(d2);
+}
+
+/* Pairs nearer than near missing from the list, plus pairs in it twice,
+   out of order (j <= i) or as far as far; seen is N * N scratch */
+static size_t test_neighbor_errors(const dyn_system_t *sys, double near, double far, unsigned char *seen) {
+    const size_t N = sys->N;
+    size_t bad = 0;
+    memset(seen, 0, N * N);
+    for (size_t i = 0; i < N; i++) {
+        size_t count;
+        const size_t *nb = dyn_system_neighbors(sys, i, &count);
+        for (size_t k = 0; k < count; k++) {
+            const size_t j = nb[k];
+            if (j <= i || j >= N || seen[i * N + j]) {
+                bad++;
+                continue;
+            }
+            seen[i * N + j] = 1;
+            bad += test_distance(sys, i, j) >= far;
+        }
+    }
+    for (size_t i = 0; i < N; i++)
+        for (size_t j = i + 1; j < N; j++) bad += !seen[i * N + j] && test_distance(sys, i, j) < near;
+    return bad;
+}
+
+struct test_contacts {
+    long calls, bad;
+};
+
+static void test_contact(dyn_system_t *sys, size_t i, size_t j, double overlap, void *userdata) {
+    struct test_contacts *c = userdata;
+    const double want = sys->particles[i].radius + sys->particles[j].radius - test_distance(sys, i, j);
+    c->calls++;
+    c->bad += !(i < j && overlap > 0.0 && fabs(overlap - want) < 1e-12);
+}
+
+/*
+    The list against every pair: exact when built, still holding each
+    pair inside the cutoff while the drift is under half the skin, and
+    rebuilt once one particle goes further; with cells too small for a
+    particle each, and on a flat system. The contacts of the list must
+    be those of the pairs.
+*/
+void test_neighbor_list(struct test *t) {
+    enum { N = 1000 };
+    const double cutoff = 0.2, skin = 0.05;
+    dyn_system_t *sys = test_cluster(N, 0x6e6c6973ull);
+    unsigned char *seen = malloc(N * N);
+    struct test_contacts c = {0, 0};
+    long contacts = 0;
+    size_t bad;
+    if (!sys || !seen) {
+        TEST_CHECK(t, 0, "out of memory");
+        goto done;
+    }
+    TEST_CHECK(t, dyn_system_neighbors(sys, 0, NULL) == NULL && dyn_system_update_neighbor_list(sys) == -1,
+               "a list before one was enabled");
+    TEST_CHECK(t, dyn_system_enable_neighbor_list(sys, cutoff, -1.0) == -1, "negative skin taken");
+    TEST_CHECK(t, dyn_system_enable_neighbor_list(sys, cutoff, skin) == 0, "list not built");
+    bad = test_neighbor_errors(sys, cutoff + skin, cutoff + skin, seen);
+    TEST_CHECK(t, bad == 0, "%zu pairs wrong in a fresh list", bad);
+    TEST_CHECK(t, dyn_system_update_neighbor_list(sys) == 0 && sys->neighbors->n_builds == 1, "rebuilt unmoved");
+
+    /* Under skin / 2 each: reused, and still covering the cutoff */
+    for (size_t i = 0; i < N; i++)
+        for (size_t a = 0; a < 3; a++) *gsl_vector_ptr(sys->particles[i].pos, a) += 0.01 * test_random();
+    TEST_CHECK(t, dyn_system_update_neighbor_list(sys) == 0, "rebuilt under skin / 2");
+    bad = test_neighbor_errors(sys, cutoff, cutoff + 2.0 * skin, seen);
+    TEST_CHECK(t, bad == 0, "%zu pairs wrong in a reused list", bad);
+    *gsl_vector_ptr(sys->particles[N / 2].pos, 0) += 0.6 * skin;
+    TEST_CHECK(t, dyn_system_update_neighbor_list(sys) == 1 && sys->neighbors->n_builds == 2,
+               "not rebuilt past skin / 2");
+    bad = test_neighbor_errors(sys, cutoff + skin, cutoff + skin, seen);
+    TEST_CHECK(t, bad == 0, "%zu pairs wrong in a rebuilt list", bad);
+
+    /* Contacts at radius 0.05, within the cutoff */
+    for (size_t i = 0; i < N; i++) sys->particles[i].radius = 0.05;
+    for (size_t i = 0; i < N; i++)
+        for (size_t j = i + 1; j < N; j++) contacts += test_distance(sys, i, j) < 0.1;
+    TEST_CHECK(t, dyn_system_find_contacts(sys, test_contact, &c) == contacts && c.calls == contacts && c.bad == 0,
+               "%ld contacts reported, %ld wrong, %ld by the pairs", c.calls, c.bad, contacts);
+
+    /* More cells than particles allow, then all in one plane */
+    TEST_CHECK(t, dyn_system_enable_neighbor_list(sys, 1e-3, 0.0) == 0, "fine list not built");
+    bad = test_neighbor_errors(sys, 1e-3, 1e-3, seen);
+    TEST_CHECK(t, bad == 0, "%zu pairs wrong at cutoff 1e-3", bad);
+    for (size_t i = 0; i < N; i++) gsl_vector_set(sys->particles[i].pos, 2, 0.0);
+    TEST_CHECK(t, dyn_system_enable_neighbor_list(sys, cutoff, skin) == 0, "flat list not built");
+    bad = test_neighbor_errors(sys, cutoff + skin, cutoff + skin, seen);
+    TEST_CHECK(t, bad == 0, "%zu pairs wrong in a plane", bad);
+
+    TEST_CHECK(t, dyn_system_enable_neighbor_list(sys, 0.0, 0.0) == 0 && !sys->neighbors, "list not disabled");
+done:
+    dyn_system_free(sys);
+    free(seen);
+}
+
+/* ---------------- Trajectories ---------------- */
+
+static double test_field(dyn_system_t *sys, dyn_field_t field, size_t i, size_t a) {
+    gsl_vector_view v = dyn_system_particle_vector(sys, field, i);
+    return gsl_vector_get(&v.vector, a);
+}
+
+/*
+    Frames appended every other step in chunks of 4, read back bit for
+    bit from either layout: only whole chunks visible before a flush, a
+    truncated copy missing its last frame, a particle's path as a view
+    into the mapping and a snapshot through dyn_system_save/load.
+*/
+void test_trajectory(struct test *t) {
+    enum { N = 50, STEPS = 21, FRAMES = STEPS / 2 };
+    static const dyn_field_t fields[3] = {DYN_FIELD_POS, DYN_FIELD_VEL, DYN_FIELD_FORCE};
+    double *want = malloc(FRAMES * 9 * N * sizeof(*want)), times[FRAMES];
+    char path[512], snap[512];
+    dyn_system_t *sys = NULL, *copy = NULL;
+    dyn_traj_t *tr = NULL, *rd = NULL;
+    kin_trajectory *view = NULL;
+    if (!want) {
+        TEST_CHECK(t, 0, "out of memory");
+        return;
+    }
+    snprintf(path, sizeof(path), "%s", test_path(t, "traj.bin"));
+    snprintf(snap, sizeof(snap), "%s", test_path(t, "snap.bin"));
+    for (int layout = 0; layout < 2; layout++) {
+        const char *name = layout ? "SoA" : "AoS";
+        size_t k = 0, bad = 0;
+        dyn_traj_frame_t fr;
+        if (!(sys = test_cluster(N, 0x7472616aull)) || !(copy = dyn_system_alloc(N))) {
+            TEST_CHECK(t, 0, "out of memory");
+            goto out;
+        }
+        for (size_t i = 0; i < N; i++)
+            for (size_t a = 0; a < 3; a++) gsl_vector_set(sys->particles[i].vel, a, 0.1 * test_random());
+        if (layout) dyn_system_set_layout(sys, DYN_LAYOUT_SOA);
+        tr = dyn_traj_create(path, sys, DYN_TRAJ_VEL | DYN_TRAJ_FORCE, 4);
+        TEST_CHECK(t, tr != NULL, "%s: no trajectory created", name);
+        if (!tr) goto out;
+        dyn_system_attach_trajectory(sys, tr, 2);
+        for (int s = 1; s <= STEPS; s++) {
+            TEST_CHECK(t, dyn_system_step(sys, 1e-3, DYN_INT_LEAPFROG) == 0, "%s: step %d failed", name, s);
+            if (s % 2) continue;
+            for (size_t f = 0; f < 3; f++)
+                for (size_t a = 0; a < 3; a++)
+                    for (size_t i = 0; i < N; i++)
+                        want[((k * 3 + f) * 3 + a) * N + i] = test_field(sys, fields[f], i, a);
+            times[k++] = sys->t;
+            if (s == 10) {
+                rd = dyn_traj_open(path);
+                TEST_CHECK(t, rd && dyn_traj_frames(rd) == 4, "%s: %zu frames seen of 5 unflushed", name,
+                           dyn_traj_frames(rd));
+                dyn_traj_close(rd);
+                rd = NULL;
+            }
+        }
+        dyn_system_attach_trajectory(sys, NULL, 0);
+        TEST_CHECK(t, dyn_traj_close(tr) == 0, "%s: close failed", name);
+        tr = NULL;
+
+        rd = dyn_traj_open(path);
+        TEST_CHECK(t, rd && dyn_traj_frames(rd) == FRAMES, "%s: %zu frames of %d", name, dyn_traj_frames(rd), FRAMES);
+        if (!rd) goto out;
+        for (size_t i = 0; i < N; i++) bad += dyn_traj_masses(rd)[i] != sys->particles[i].mass;
+        for (k = 0; k < FRAMES && dyn_traj_frame(rd, k, &fr) == 0; k++) {
+            bad += fr.t != times[k] || fr.step != (int64_t)(2 * k + 2) || fr.n != N;
+            for (size_t a = 0; a < 3; a++) {
+                const double *got[3] = {fr.pos[a], fr.vel[a], fr.force[a]};
+                for (size_t f = 0; f < 3; f++)
+                    bad += memcmp(got[f], &want[((k * 3 + f) * 3 + a) * N], N * sizeof(double)) != 0;
+            }
+        }
+        TEST_CHECK(t, k == FRAMES && bad == 0, "%s: %zu of %d frames read, %zu differ", name, k, FRAMES, bad);
+        TEST_CHECK(t, dyn_traj_frame(rd, FRAMES, &fr) != 0, "%s: frame past the end resolved", name);
+
+        /* Frame 3 loaded; particle 17's path over frames 2..6 */
+        TEST_CHECK(t, dyn_traj_load_frame(rd, 3, copy) == 0, "%s: frame 3 not loaded", name);
+        bad = copy->t != times[3] || copy->step_count != 8;
+        for (size_t f = 0; f < 3; f++)
+            for (size_t a = 0; a < 3; a++)
+                for (size_t i = 0; i < N; i++)
+                    bad += test_field(copy, fields[f], i, a) != want[((3 * 3 + f) * 3 + a) * N + i];
+        TEST_CHECK(t, bad == 0, "%s: %zu values of frame 3 differ", name, bad);
+        view = dyn_traj_particle_view(rd, 17, 2, 5);
+        TEST_CHECK(t, view && view->n == 5, "%s: no view of particle 17", name);
+        for (k = 0, bad = 0; view && k < 5; k++) {
+            bad += view->states[k].t != times[k + 2] || view->states[k].acc != NULL;
+            for (size_t a = 0; a < 3; a++)
+                bad += gsl_vector_get(view->states[k].pos, a) != want[(((k + 2) * 3 + 0) * 3 + a) * N + 17] ||
+                       gsl_vector_get(view->states[k].vel, a) != want[(((k + 2) * 3 + 1) * 3 + a) * N + 17];
+        }
+        TEST_CHECK(t, bad == 0, "%s: %zu values of the view differ", name, bad);
+        TEST_CHECK(t, !dyn_traj_particle_view(rd, N, 0, 1) && !dyn_traj_particle_view(rd, 0, 8, 3),
+                   "%s: a view out of range", name);
+        dyn_traj_view_free(view);
+        view = NULL;
+        dyn_traj_close(rd);
+        rd = NULL;
+
+        /* The last frame cut short: not visible */
+        {
+            struct stat st;
+            if (stat(path, &st) == 0 && truncate(path, st.st_size - 8) == 0) {
+                rd = dyn_traj_open(path);
+                TEST_CHECK(t, rd && dyn_traj_frames(rd) == FRAMES - 1, "%s: %zu frames in a truncated file", name,
+                           dyn_traj_frames(rd));
+                dyn_traj_close(rd);
+                rd = NULL;
+            }
+        }
+
+        /* A snapshot: positions, velocities, masses and time */
+        TEST_CHECK(t, dyn_system_save(sys, snap) == 0, "%s: not saved", name);
+        dyn_system_free(copy);
+        copy = dyn_system_load(snap);
+        TEST_CHECK(t, copy && copy->N == N, "%s: not loaded", name);
+        if (!copy) goto out;
+        bad = copy->t != sys->t || copy->step_count != sys->step_count;
+        for (size_t i = 0; i < N; i++) {
+            bad += copy->particles[i].mass != sys->particles[i].mass;
+            for (size_t f = 0; f < 2; f++)
+                for (size_t a = 0; a < 3; a++)
+                    bad += test_field(copy, fields[f], i, a) != test_field(sys, fields[f], i, a);
+        }
+        TEST_CHECK(t, bad == 0, "%s: %zu values of the snapshot differ", name, bad);
+        dyn_system_free(sys);
+        dyn_system_free(copy);
+        sys = copy = NULL;
+    }
+
+    /* Not a trajectory */
+    {
+        FILE *f = fopen(path, "w");
+        if (f) {
+            fputs("HOLOSTRX and some more bytes than a header has, to be sure of it; and more, and more", f);
+            fclose(f);
+        }
+        TEST_CHECK(t, !dyn_traj_open(path) && !dyn_system_load(path), "a bad magic opened");
+    }
+out:
+    dyn_traj_view_free(view);
+    if (rd) dyn_traj_close(rd);
+    if (tr) dyn_traj_close(tr);
+    dyn_system_free(sys);
+    dyn_system_free(copy);
+    free(want);
+}
+
+/* ---------------- GPU Offload ---------------- */
+
+/* The tree cluster, softened further and set moving */
+static dyn_system_t *test_moving_cluster(size_t N) {
+    dyn_system_t *sys = test_cluster(N, 0x677075ull);
+    if (!sys) return NULL;
+    dyn_system_set_softening(sys, true, 0.1);
+    for (size_t i = 0; i < N; i++)
+        for (size_t a = 0; a < 3; a++) gsl_vector_set(sys->particles[i].vel, a, 0.3 * test_random());
+    return sys;
+}
+
+/* Largest difference of the positions and velocities of a and b */
+static double test_state_diff(const dyn_system_t *a, const dyn_system_t *b) {
+    double err = 0.0;
+    for (size_t i = 0; i < a->N; i++)
+        for (size_t c = 0; c < 3; c++) {
+            err = fmax(err, fabs(gsl_vector_get(a->particles[i].pos, c) - gsl_vector_get(b->particles[i].pos, c)));
+            err = fmax(err, fabs(gsl_vector_get(a->particles[i].vel, c) - gsl_vector_get(b->particles[i].vel, c)));
+        }
+    return err;
+}
+
+/*
+    A device that does not exist is refused, leaving the system on the
+    host. On a device, velocity Verlet must follow the host steps to
+    rounding without moving anything across the bus between steps, pick
+    up a velocity edited by hand once told, and hand the state back when
+    detached. Without a device the case skips after the refusal.
+*/
+void test_gpu_offload(struct test *t) {
+    enum { N = 256, STEPS = 10 };
+    const int devices = dyn_gpu_device_count();
+    dyn_system_t *host = test_moving_cluster(N), *dev = test_moving_cluster(N);
+    const dyn_gpu_t *g;
+    size_t up, down;
+    if (!host || !dev) {
+        TEST_CHECK(t, 0, "out of memory");
+        goto done;
+    }
+    TEST_CHECK(t, dyn_system_enable_gpu(dev, devices) == -1 && dev->gpu == NULL, "device %d of %d taken", devices,
+               devices);
+    TEST_CHECK(t, dyn_system_enable_gpu(dev, -1) == 0 && dev->gpu == NULL, "detaching a host system failed");
+    if (devices == 0) {
+        test_skip(t, "no GPU device");
+        goto done;
+    }
+
+    if (dyn_system_enable_gpu(dev, 0) != 0 || !dev->gpu) {
+        TEST_CHECK(t, 0, "device 0 refused");
+        goto done;
+    }
+    g = dev->gpu;
+    for (int s = 0; s < 2; s++) {
+        TEST_CHECK(t, dyn_system_step(host, 1e-3, DYN_INT_VERLET) == 0, "host step %d failed", s);
+        TEST_CHECK(t, dyn_system_step(dev, 1e-3, DYN_INT_VERLET) == 0, "device step %d failed", s);
+    }
+    up = g->n_uploads;
+    down = g->n_downloads;
+    for (int s = 0; s < STEPS; s++) {
+        dyn_system_step(host, 1e-3, DYN_INT_VERLET);
+        dyn_system_step(dev, 1e-3, DYN_INT_VERLET);
+    }
+    TEST_CHECK(t, g->n_uploads == up && g->n_downloads == down, "%zu uploads, %zu downloads over %d steps",
+               g->n_uploads - up, g->n_downloads - down, STEPS);
+    TEST_CHECK(t, dyn_system_sync_host(dev) == 0, "no state back from the device");
+    TEST_CHECK(t, test_state_diff(host, dev) < 1e-10, "device off the host steps by %g", test_state_diff(host, dev));
+
+    /* An edit by hand, then detached */
+    *gsl_vector_ptr(host->particles[0].vel, 0) += 0.5;
+    *gsl_vector_ptr(dev->particles[0].vel, 0) += 0.5;
+    host->forces_valid = dev->forces_valid = 0;
+    dyn_system_invalidate_gpu(dev);
+    for (int s = 0; s < STEPS; s++) {
+        dyn_system_step(host, 1e-3, DYN_INT_VERLET);
+        dyn_system_step(dev, 1e-3, DYN_INT_VERLET);
+    }
+    TEST_CHECK(t, dyn_system_enable_gpu(dev, -1) == 0 && dev->gpu == NULL, "not detached");
+    TEST_CHECK(t, test_state_diff(host, dev) < 1e-10, "after an edit, device off the host by %g",
+               test_state_diff(host, dev));
+done:
+    dyn_system_free(host);
+    dyn_system_free(dev);
+}
+
+/* ---------------- Particle Storage ---------------- */
+
+/* Position (f = 0) and velocity (f = 1) of particle k, as given to it */
+static double test_state(size_t k, int f, size_t a) {
+    return (double)(k + 1) * (f ? -0.25 : 1.0) + 0.125 * (double)a;
+}
+
+/*
+    Particles go into SoA blocks that grow several times and out again,
+    through remove and back to AoS: every particle must keep its state,
+    and its views must see the blocks of the moment.
+*/
+void test_soa_layout(struct test *t) {
+    enum { N0 = 5, N_ADD = 40 };
+    dyn_system_t *sys = dyn_system_alloc(N0);
+    if (!sys) {
+        TEST_CHECK(t, 0, "out of memory");
+        return;
+    }
+    for (size_t i = 0; i < N0; i++) {
+        for (size_t a = 0; a < 3; a++) {
+            gsl_vector_set(sys->particles[i].pos, a, test_state(i, 0, a));
+            gsl_vector_set(sys->particles[i].vel, a, test_state(i, 1, a));
+        }
+        sys->particles[i].mass = (double)(i + 1);
+    }
+    TEST_CHECK(t, dyn_system_set_layout(sys, DYN_LAYOUT_SOA) == 0, "no SoA layout");
+    for (size_t k = N0; k < N0 + N_ADD; k++) {
+        gsl_vector *pos = gsl_vector_alloc(3), *vel = gsl_vector_alloc(3);
+        dyn_particle_t p;
+        memset(&p, 0, sizeof(p));
+        for (size_t a = 0; a < 3; a++) {
+            gsl_vector_set(pos, a, test_state(k, 0, a));
+            gsl_vector_set(vel, a, test_state(k, 1, a));
+        }
+        p.mass = (double)(k + 1);
+        p.pos = pos;
+        p.vel = vel;
+        p.id = (int)k;
+        TEST_CHECK(t, dyn_system_add_particle(sys, &p) == (int)k, "particle %zu not added", k);
+        gsl_vector_free(pos);
+        gsl_vector_free(vel);
+    }
+    TEST_CHECK(t, sys->soa->capacity >= N0 + N_ADD, "room for %zu particles", sys->soa->capacity);
+    TEST_CHECK(t, dyn_system_remove_particle(sys, 3) == 0, "particle 3 not removed");
+    for (int layout = 0; layout < 2; layout++) {
+        if (sys->N != N0 + N_ADD - 1) {
+            TEST_CHECK(t, 0, "%zu particles", sys->N);
+            break;
+        }
+        for (size_t i = 0; i < sys->N; i++) {
+            const size_t k = i < 3 ? i : i + 1;
+            gsl_vector_view v = dyn_system_particle_vector(sys, DYN_FIELD_VEL, i);
+            for (size_t a = 0; a < 3; a++) {
+                TEST_CHECK(t, gsl_vector_get(sys->particles[i].pos, a) == test_state(k, 0, a) &&
+                                  gsl_vector_get(&v.vector, a) == test_state(k, 1, a),
+                           "%s: particle %zu lost its state on axis %zu", layout ? "AoS" : "SoA", i, a);
+            }
+            TEST_CHECK(t, sys->particles[i].mass == (double)(k + 1), "%s: particle %zu has mass %g",
+                       layout ? "AoS" : "SoA", i, sys->particles[i].mass);
+        }
+        if (!layout) TEST_CHECK(t, dyn_system_set_layout(sys, DYN_LAYOUT_AOS) == 0, "no AoS layout again");
+    }
+    dyn_system_free(sys);
+}
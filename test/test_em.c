@@ -0,0 +1,817 @@
+/* test_em.c - Tests of the field solvers of HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+   ----------------------------------------------------------------------
+   Yee grids must keep their cells where their index says, and their
+   point views in place; their stepper must follow the discrete
+   dispersion relation on any thread count. The wave engine must give
+   the bits of plain steps however it tiles them, and the compiled
+   Laplacian of a quadratic the exact one. The grid engines are held to
+   each other: a distributed run to the serial one, bit for bit, and a
+   lossless box to its energy. Field files must read back exactly what
+   was written, frame by frame. make check runs one rank;
+   'mpiexec -n 4 ./tests grid_mpi' runs a real decomposition. The
+   particle pushers are held to motions known in closed form, and to
+   the same fields read off a Yee grid.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "core/phys/em/maxwell.h"
+#include "core/phys/em/wave_equations.h"
+#include "core/phys/em/field_h5.h"
+#include "core/phys/em/lorentz_forces.h"
+#ifdef HAVE_MPI
+#include "core/phys/em/grid_mpi.h"
+#endif
+#include "tests.h"
+
+/* ---------------- Yee Grids ---------------- */
+
+#define TEST_EPSILON0 8.8541878128e-12  /* Vacuum, as maxwell.c has it */
+#define TEST_MU0 1.25663706212e-6
+
+/*
+    Components of a cell lie n apart in their field blocks, cells x
+    first: a point view must read and write the blocks in place, with B
+    and D from its cell's material. Materials fill boxes clipped to the
+    grid and the table holds MAXWELL_YEE_MAX_MATERIALS, vacuum first.
+*/
+void test_yee_grid(struct test *t) {
+    const size_t nx = 5, ny = 4, nz = 3;
+    maxwell_field_grid *grid = maxwell_field_grid_alloc_yee(nx, ny, nz, 1e-3, 2e-3, 3e-3);
+    maxwell_material glass = {"glass", 4.0 * TEST_EPSILON0, TEST_MU0, 0.0, NULL};
+    maxwell_material bad = {"bad", -1.0, TEST_MU0, 0.0, NULL};
+    maxwell_yee_grid *g;
+    maxwell_yee_view view;
+    maxwell_field_point *pt;
+    size_t idx, in_box = 0;
+    int m, n_added = 0;
+    TEST_CHECK(t, maxwell_yee_grid_alloc(0, 1, 1, 1e-3, 1e-3, 1e-3) == NULL, "a grid with no cells");
+    TEST_CHECK(t, maxwell_yee_grid_alloc(1, 1, 1, 1e-3, 0.0, 1e-3) == NULL, "a grid of zero spacing");
+    if (!grid || !grid->yee) {
+        TEST_CHECK(t, 0, "no Yee grid");
+        goto done;
+    }
+    g = grid->yee;
+    TEST_CHECK(t, grid->n == 60 && g->n == 60 && grid->pts == NULL && grid->dim == 3, "n %zu, dim %d", grid->n,
+               grid->dim);
+    TEST_CHECK(t, maxwell_yee_index(g, 1, 0, 0) == 1 && maxwell_yee_index(g, 0, 1, 0) == nx &&
+                      maxwell_yee_index(g, 0, 0, 1) == nx * ny,
+               "index strides %zu, %zu, %zu", maxwell_yee_index(g, 1, 0, 0), maxwell_yee_index(g, 0, 1, 0),
+               maxwell_yee_index(g, 0, 0, 1));
+    TEST_CHECK(t, g->n_materials == 1 && g->materials[0].epsilon == TEST_EPSILON0 && g->material[59] == 0,
+               "%zu materials, the first not vacuum", g->n_materials);
+
+    /* Glass in x >= 3, y in [1, 3), all z; the box runs past the grid */
+    m = maxwell_yee_add_material(g, &glass);
+    TEST_CHECK(t, m == 1 && strcmp(g->materials[1].name, "glass") == 0, "glass added as %d", m);
+    TEST_CHECK(t, maxwell_yee_add_material(g, &bad) == -1, "a negative permittivity taken");
+    TEST_CHECK(t, maxwell_yee_set_material_box(g, 3, 99, 1, 3, 0, 99, 1) == 0, "box refused");
+    TEST_CHECK(t, maxwell_yee_set_material_box(g, 0, 1, 0, 1, 0, 1, 7) == -1, "material 7 of 2 set");
+    for (size_t k = 0; k < nz; k++)
+        for (size_t j = 0; j < ny; j++)
+            for (size_t i = 0; i < nx; i++) {
+                const int want = i >= 3 && j >= 1 && j < 3;
+                in_box += want;
+                TEST_CHECK(t, g->material[maxwell_yee_index(g, i, j, k)] == want, "cell (%zu, %zu, %zu) is %d", i, j, k,
+                           g->material[maxwell_yee_index(g, i, j, k)]);
+            }
+    TEST_CHECK(t, in_box == 12, "%zu cells in the box", in_box);
+
+    /* A view of a glass cell, in place */
+    idx = maxwell_yee_index(g, 4, 2, 1);
+    for (size_t a = 0; a < 3; a++) {
+        g->E[a * g->n + idx] = 1.0 + (double)a;
+        g->H[a * g->n + idx] = 0.5 * (double)a;
+    }
+    pt = maxwell_field_grid_point(grid, idx, &view);
+    if (!pt) {
+        TEST_CHECK(t, 0, "no view of cell %zu", idx);
+        goto done;
+    }
+    TEST_CHECK(t, pt->epsilon == glass.epsilon && pt->mu == glass.mu && strcmp(pt->material, "glass") == 0,
+               "the view has material %s", pt->material ? pt->material : "(none)");
+    for (size_t a = 0; a < 3; a++) {
+        TEST_CHECK(t, gsl_vector_get(pt->E, a) == 1.0 + (double)a && gsl_vector_get(pt->H, a) == 0.5 * (double)a,
+                   "component %zu of the view", a);
+        TEST_CHECK(t, gsl_vector_get(pt->D, a) == glass.epsilon * (1.0 + (double)a) &&
+                          gsl_vector_get(pt->B, a) == glass.mu * 0.5 * (double)a,
+                   "D or B %zu not of glass", a);
+    }
+    gsl_vector_set(pt->E, 2, -7.0);
+    gsl_vector_set(pt->J, 1, 3.0);
+    TEST_CHECK(t, g->E[2 * g->n + idx] == -7.0 && g->J[g->n + idx] == 3.0, "writes through the view are lost");
+    TEST_CHECK(t, maxwell_field_grid_point(grid, grid->n, &view) == NULL, "a view past the grid");
+
+    /* The table fills */
+    for (size_t k = g->n_materials; k < MAXWELL_YEE_MAX_MATERIALS; k++)
+        n_added += maxwell_yee_add_material(g, &glass) >= 0;
+    TEST_CHECK(t, g->n_materials == MAXWELL_YEE_MAX_MATERIALS && maxwell_yee_add_material(g, &glass) == -1,
+               "%zu materials, %d added", g->n_materials, n_added);
+done:
+    if (grid) maxwell_field_grid_free(grid);
+}
+
+/* A Gaussian pulse of width 20 ps at 60 ps */
+static double test_pulse(double t, void *userdata) {
+    const double x = (t - 60e-12) / 20e-12;
+    (void)userdata;
+    return *(const double *)userdata * exp(-x * x);
+}
+
+/* A 12 x 10 x 8 PEC box with a lossy slab, driven by a soft and a hard
+   source, stepped 40 times on n_threads; NULL if it failed */
+static maxwell_field_grid *test_yee_box(int n_threads, const double *amp) {
+    const maxwell_material tissue = {"tissue", 2.0 * TEST_EPSILON0, TEST_MU0, 0.5, NULL};
+    maxwell_field_grid *grid = maxwell_field_grid_alloc_yee(12, 10, 8, 1e-3, 1e-3, 1e-3);
+    maxwell_yee_grid *g = grid ? grid->yee : NULL;
+    maxwell_yee_source soft = {0, 2, 0, test_pulse, (void *)amp}, hard = {0, 1, 1, test_pulse, (void *)amp};
+    double dt;
+    if (!g) return NULL;
+    soft.idx = maxwell_yee_index(g, 6, 5, 4);
+    hard.idx = maxwell_yee_index(g, 3, 3, 3);
+    if (maxwell_yee_add_material(g, &tissue) != 1 || maxwell_yee_set_material_box(g, 8, 12, 0, 10, 0, 8, 1) != 0 ||
+        maxwell_yee_add_source(g, &soft) != 0 || maxwell_yee_add_source(g, &hard) != 0)
+        goto fail;
+    maxwell_yee_set_threads(g, n_threads);
+    dt = 0.9 * maxwell_yee_max_dt(g);
+    for (int s = 0; s < 40; s++)
+        if (maxwell_grid_fdtd_step(grid, dt) != 0) goto fail;
+    return grid;
+fail:
+    maxwell_field_grid_free(grid);
+    return NULL;
+}
+
+/*
+    A plane standing wave sin(k x) in Ey along a periodic x: the Yee
+    update keeps Ey that shape, with amplitudes a_n that must obey
+    a_{n+1} = 2 cos(w dt) a_n - a_{n-1}, cos(w dt) from the discrete
+    dispersion relation. A uniform Ex in a periodic conductor decays by
+    (1 - s) / (1 + s) a step. A driven PEC box with a lossy slab gives
+    the same bits on any thread count, keeps its walls and its hard
+    source; a step past the Courant limit, or of a point grid, fails.
+*/
+void test_yee_fdtd(struct test *t) {
+    enum { NX = 64, STEPS = 200 };
+    const double h = 1e-3, amp = 1.0, c = 1.0 / sqrt(TEST_EPSILON0 * TEST_MU0);
+    const double k = 2.0 * M_PI * 3.0 / (NX * h);
+    maxwell_field_grid *grid = maxwell_field_grid_alloc_yee(NX, 1, 1, h, h, h), *ref = NULL, *box = NULL;
+    maxwell_field_grid *points = maxwell_field_grid_alloc(4);
+    maxwell_yee_grid *g;
+    double a[STEPS + 1], dt, r, cw, err = 0.0, shape = 0.0;
+    if (!grid || !points) {
+        TEST_CHECK(t, 0, "no grids");
+        goto done;
+    }
+    g = grid->yee;
+    maxwell_yee_set_boundary(g, 0, MAXWELL_YEE_PERIODIC);
+    TEST_CHECK(t, fabs(maxwell_yee_max_dt(g) * c / h - 1.0) < 1e-12, "Courant limit %g, not h / c",
+               maxwell_yee_max_dt(g));
+    dt = 0.8 * maxwell_yee_max_dt(g);
+    TEST_CHECK(t, maxwell_grid_fdtd_step(grid, 1.01 * maxwell_yee_max_dt(g)) == -1, "a step past the Courant limit");
+    TEST_CHECK(t, maxwell_grid_fdtd_step(points, dt) == -1, "a Yee step of a point grid");
+    r = c * dt / h;
+    cw = 1.0 - 2.0 * r * r * sin(0.5 * k * h) * sin(0.5 * k * h);
+    for (size_t i = 0; i < NX; i++) g->E[g->n + i] = sin(k * h * (double)i);
+    a[0] = 1.0;
+    for (int n = 1; n <= STEPS; n++) {
+        double dot = 0.0, norm = 0.0;
+        if (maxwell_grid_fdtd_step(grid, dt) != 0) {
+            TEST_CHECK(t, 0, "step %d failed", n);
+            goto done;
+        }
+        for (size_t i = 0; i < NX; i++) {
+            dot += g->E[g->n + i] * sin(k * h * (double)i);
+            norm += sin(k * h * (double)i) * sin(k * h * (double)i);
+        }
+        a[n] = dot / norm;
+        for (size_t i = 0; i < NX; i++) shape = fmax(shape, fabs(g->E[g->n + i] - a[n] * sin(k * h * (double)i)));
+        if (n >= 2) err = fmax(err, fabs(a[n] - (2.0 * cw * a[n - 1] - a[n - 2])));
+    }
+    TEST_CHECK(t, shape < 1e-12, "Ey left sin(k x) by %g", shape);
+    TEST_CHECK(t, err < 1e-12, "amplitudes off the discrete dispersion relation by %g", err);
+    TEST_CHECK(t, fabs(grid->t - STEPS * dt) < 1e-9 * dt, "time %g after %d steps of %g", grid->t, STEPS, dt);
+    maxwell_field_grid_free(grid);
+
+    /* A periodic conductor */
+    {
+        const maxwell_material metal = {"metal", TEST_EPSILON0, TEST_MU0, 10.0, NULL};
+        double s, decay, e = 1.0;
+        grid = maxwell_field_grid_alloc_yee(4, 4, 4, h, h, h);
+        if (!grid) goto done;
+        g = grid->yee;
+        for (size_t axis = 0; axis < 3; axis++) maxwell_yee_set_boundary(g, axis, MAXWELL_YEE_PERIODIC);
+        maxwell_yee_add_material(g, &metal);
+        maxwell_yee_set_material_box(g, 0, 4, 0, 4, 0, 4, 1);
+        for (size_t i = 0; i < g->n; i++) g->E[i] = 1.0;
+        dt = 0.5 * maxwell_yee_max_dt(g);
+        s = metal.sigma * dt / (2.0 * metal.epsilon);
+        decay = (1.0 - s) / (1.0 + s);
+        for (int n = 0; n < 10; n++) {
+            maxwell_grid_fdtd_step(grid, dt);
+            e *= decay;
+        }
+        TEST_CHECK(t, fabs(g->E[g->n - 1] - e) < 1e-12 && fabs(g->E[0] - e) < 1e-12 && g->H[2 * g->n] == 0.0,
+                   "Ex %g after 10 steps, not %g", g->E[0], e);
+    }
+
+    /* A driven box, on 0 and 4 threads */
+    ref = test_yee_box(0, &amp);
+    box = test_yee_box(4, &amp);
+    if (!ref || !box) {
+        TEST_CHECK(t, 0, "driven box failed");
+        goto done;
+    }
+    g = ref->yee;
+    {
+        const maxwell_yee_grid *g4 = box->yee;
+        double wall = 0.0, inside = 0.0, v;
+        TEST_CHECK(t, memcmp(g->E, g4->E, 3 * g->n * sizeof(double)) == 0 &&
+                          memcmp(g->H, g4->H, 3 * g->n * sizeof(double)) == 0,
+                   "4 threads do not give the bits of one");
+        for (size_t kk = 0; kk < g->nz; kk++)
+            for (size_t j = 0; j < g->ny; j++) {
+                const size_t base = maxwell_yee_index(g, 0, j, kk);
+                wall = fmax(wall, fmax(fabs(g->E[g->n + base]), fabs(g->E[2 * g->n + base])));
+            }
+        for (size_t i = 0; i < g->n; i++) inside = fmax(inside, fabs(g->E[2 * g->n + i]));
+        TEST_CHECK(t, wall == 0.0 && inside > 0.0, "tangential E %g on the x = 0 wall, %g inside", wall, inside);
+        v = g->E[g->n + maxwell_yee_index(g, 3, 3, 3)];
+        TEST_CHECK(t, v == test_pulse(ref->t, (void *)&amp), "hard source holds %g, not %g", v,
+                   test_pulse(ref->t, (void *)&amp));
+    }
+done:
+    if (grid) maxwell_field_grid_free(grid);
+    if (ref) maxwell_field_grid_free(ref);
+    if (box) maxwell_field_grid_free(box);
+    if (points) maxwell_field_grid_free(points);
+}
+
+/* ---------------- Wave Engine ---------------- */
+
+enum { TEST_WX = 23, TEST_WY = 17, TEST_WZ = 19, TEST_WN = TEST_WX * TEST_WY * TEST_WZ };
+
+/* Interior point (i, j, k) of the wave start; the boundary stays 0 */
+static double test_wave_start(size_t i, size_t j, size_t k, int prev) {
+    return sin(0.3 * (double)i + 0.2 * (double)j) * cos(0.25 * (double)k) * (prev ? 0.99 : 1.0);
+}
+
+/* 13 steps of the wave start with the given tiles, time tile and threads, into out; -1 if it failed */
+static int test_wave_run(size_t by, size_t bz, size_t tt, int nt, const double *speed, double *out) {
+    const double h = 0.1, c = 1.0, dt = 0.5 * h / sqrt(3.0);
+    wave_engine *e = wave_engine_alloc(TEST_WX, TEST_WY, TEST_WZ, h, h, h, c, dt);
+    int rc = -1;
+    if (!e) return -1;
+    for (size_t k = 1; k + 1 < TEST_WZ; k++)
+        for (size_t j = 1; j + 1 < TEST_WY; j++)
+            for (size_t i = 1; i + 1 < TEST_WX; i++) {
+                wave_engine_u(e)[(k * TEST_WY + j) * TEST_WX + i] = test_wave_start(i, j, k, 0);
+                wave_engine_u_prev(e)[(k * TEST_WY + j) * TEST_WX + i] = test_wave_start(i, j, k, 1);
+            }
+    if ((!speed || wave_engine_set_speed(e, speed) == 0) && wave_engine_set_blocking(e, by, bz, tt) == 0) {
+        wave_engine_set_threads(e, nt);
+        if (wave_engine_step(e, 13) == 0) {
+            memcpy(out, wave_engine_u(e), TEST_WN * sizeof(double));
+            rc = 0;
+        }
+    }
+    wave_engine_free(e);
+    return rc;
+}
+
+/*
+    The same 13 steps with automatic tiles, with tiles of 3 rows and 2
+    planes, with time tiles of 4 and 5 (neither dividing 13), and on 4
+    threads must all give the same bits, as they must with a speed per
+    point. The field is held to a plain loop over the leapfrog update,
+    one step at a time, with its Dirichlet layer left as it was. A dt
+    past the CFL limit is refused, for the grid and for a point.
+*/
+void test_wave_engine(struct test *t) {
+    static const size_t tiles[][3] = {{3, 2, 1}, {0, 0, 4}, {3, 2, 5}, {0, 0, 4}};
+    const double h = 0.1, dt = 0.5 * h / sqrt(3.0), kc = dt * dt;
+    double *ref = malloc(TEST_WN * sizeof(*ref)), *out = malloc(TEST_WN * sizeof(*out));
+    double *speed = malloc(TEST_WN * sizeof(*speed));
+    wave_engine *e = NULL;
+    if (!ref || !out || !speed) {
+        TEST_CHECK(t, 0, "out of memory");
+        goto done;
+    }
+    TEST_CHECK(t, wave_engine_alloc(8, 8, 8, h, h, h, 1.0, 1.01 * h / sqrt(3.0)) == NULL, "a dt past the CFL limit");
+    if (test_wave_run(0, 0, 1, 0, NULL, ref) != 0) {
+        TEST_CHECK(t, 0, "wave steps failed");
+        goto done;
+    }
+    for (size_t m = 0; m < sizeof(tiles) / sizeof(tiles[0]); m++) {
+        const int nt = m == 3 ? 4 : 0;
+        TEST_CHECK(t, test_wave_run(tiles[m][0], tiles[m][1], tiles[m][2], nt, NULL, out) == 0 &&
+                          memcmp(ref, out, TEST_WN * sizeof(double)) == 0,
+                   "tiles %zu x %zu, time tile %zu, %d threads: not the bits of plain steps", tiles[m][0], tiles[m][1],
+                   tiles[m][2], nt);
+    }
+    for (size_t i = 0; i < TEST_WN; i++) speed[i] = 0.5 + 0.5 * (double)(i % 7) / 6.0;
+    TEST_CHECK(t, test_wave_run(0, 0, 1, 0, speed, ref) == 0 && test_wave_run(3, 2, 5, 4, speed, out) == 0 &&
+                      memcmp(ref, out, TEST_WN * sizeof(double)) == 0,
+               "speed per point: time tiles on 4 threads not the bits of plain steps");
+
+    /* Against a plain loop */
+    if (!(e = wave_engine_alloc(TEST_WX, TEST_WY, TEST_WZ, h, h, h, 1.0, dt))) {
+        TEST_CHECK(t, 0, "no wave engine");
+        goto done;
+    }
+    speed[0] = 3.0;
+    TEST_CHECK(t, wave_engine_set_speed(e, speed) == -1 && e->k2 == NULL, "a point past the CFL limit");
+    for (size_t k = 1; k + 1 < TEST_WZ; k++)
+        for (size_t j = 1; j + 1 < TEST_WY; j++)
+            for (size_t i = 1; i + 1 < TEST_WX; i++) {
+                wave_engine_u(e)[(k * TEST_WY + j) * TEST_WX + i] = test_wave_start(i, j, k, 0);
+                wave_engine_u_prev(e)[(k * TEST_WY + j) * TEST_WX + i] = test_wave_start(i, j, k, 1);
+            }
+    for (int s = 0; s < 3; s++) {
+        const double *u = wave_engine_u(e), *up = wave_engine_u_prev(e);
+        double err = 0.0, scale = 0.0, edge = 0.0;
+        for (size_t i = 0; i < TEST_WN; i++) {
+            const size_t x = i % TEST_WX, y = i / TEST_WX % TEST_WY, z = i / (TEST_WX * TEST_WY);
+            if (x == 0 || y == 0 || z == 0 || x == TEST_WX - 1 || y == TEST_WY - 1 || z == TEST_WZ - 1) {
+                out[i] = 0.0;
+                continue;
+            }
+            out[i] = 2.0 * u[i] - up[i] +
+                     kc / (h * h) *
+                         (u[i - 1] + u[i + 1] + u[i - TEST_WX] + u[i + TEST_WX] + u[i - TEST_WX * TEST_WY] +
+                          u[i + TEST_WX * TEST_WY] - 6.0 * u[i]);
+        }
+        memcpy(ref, u, TEST_WN * sizeof(double));
+        if (wave_engine_step(e, 1) != 0) {
+            TEST_CHECK(t, 0, "step %d failed", s);
+            goto done;
+        }
+        for (size_t i = 0; i < TEST_WN; i++) {
+            err = fmax(err, fabs(wave_engine_u(e)[i] - out[i]));
+            scale = fmax(scale, fabs(out[i]));
+            if (out[i] == 0.0) edge = fmax(edge, fabs(wave_engine_u(e)[i]));
+        }
+        TEST_CHECK(t, err < 1e-13 * scale && edge == 0.0, "step %d: off the plain loop by %g, boundary moved %g", s,
+                   err, edge);
+        TEST_CHECK(t, memcmp(wave_engine_u_prev(e), ref, TEST_WN * sizeof(double)) == 0,
+                   "step %d: the previous level is not the field before it", s);
+    }
+    TEST_CHECK(t, fabs(e->t - 3.0 * dt) < 1e-15, "time %g after 3 steps", e->t);
+done:
+    wave_engine_free(e);
+    free(ref);
+    free(out);
+    free(speed);
+}
+
+/* ---------------- Compiled Stencils ---------------- */
+
+/*
+    A 5 x 4 grid of uneven spacing, its points shuffled: the compiled
+    Laplacian of x^2 + 3 y^2 must be 8 inside, the one axis along which
+    a point has both neighbors on the edges (2 or 6) and 0 on corners,
+    as exact as the three-point weights are for a quadratic. The search
+    without a stencil gives the same bits; the stencil is cached until a
+    point is added, and the grid step is the leapfrog update of it.
+*/
+void test_wave_stencil(struct test *t) {
+    static const double xs[5] = {0.0, 0.1, 0.25, 0.45, 0.7}, ys[4] = {0.0, 0.2, 0.3, 0.5};
+    enum { N = 20 };
+    wave_field_grid *grid = wave_field_grid_alloc(N), *prev = NULL;
+    double search[N], lap[N], u[N], u0[N];
+    const wave_stencil *st;
+    wave_field_point extra;
+    if (!grid || !(grid->coords = gsl_matrix_calloc(N, 2))) {
+        TEST_CHECK(t, 0, "no grid");
+        goto done;
+    }
+    grid->dim = 2;
+    for (size_t q = 0; q < N; q++) {
+        const size_t p = 7 * q % N;
+        const double x = xs[q % 5], y = ys[q / 5];
+        gsl_matrix_set(grid->coords, p, 0, x);
+        gsl_matrix_set(grid->coords, p, 1, y);
+        grid->pts[p].u = u[p] = x * x + 3.0 * y * y;
+    }
+    for (size_t i = 0; i < N; i++) search[i] = wave_laplacian(grid, i);
+    TEST_CHECK(t, grid->stencil == NULL, "wave_laplacian compiled the grid");
+    if (!(st = wave_field_grid_compile(grid))) {
+        TEST_CHECK(t, 0, "no stencil");
+        goto done;
+    }
+    TEST_CHECK(t, wave_field_grid_compile(grid) == st, "the stencil is not cached");
+    TEST_CHECK(t, st->n == N && st->row_ptr[N] == st->nnz, "%zu rows, %zu entries", st->n, st->nnz);
+    wave_stencil_apply(st, u, lap);
+    for (size_t q = 0; q < N; q++) {
+        const size_t p = 7 * q % N, i = q % 5, j = q / 5;
+        const double want = (i > 0 && i < 4 ? 2.0 : 0.0) + (j > 0 && j < 3 ? 6.0 : 0.0);
+        TEST_CHECK(t, fabs(lap[p] - want) < 1e-11, "(%g, %g): Laplacian %.15g, not %g", xs[i], ys[j], lap[p], want);
+        TEST_CHECK(t, memcmp(&lap[p], &search[p], sizeof(double)) == 0 && wave_laplacian(grid, p) == lap[p],
+                   "(%g, %g): the search gives %.17g, the stencil %.17g", xs[i], ys[j], search[p], lap[p]);
+        TEST_CHECK(t, st->col[st->row_ptr[p]] == p, "row %zu does not start on its diagonal", p);
+    }
+
+    /* One leapfrog step from u(t - dt) = 0.5 u */
+    if (!(prev = wave_field_grid_clone(grid))) {
+        TEST_CHECK(t, 0, "no clone");
+        goto done;
+    }
+    for (size_t i = 0; i < N; i++) prev->pts[i].u = u0[i] = 0.5 * u[i];
+    wave_grid_fdtd_step(grid, prev, 2.0, 0.01);
+    for (size_t i = 0; i < N; i++)
+        TEST_CHECK(t, fabs(grid->pts[i].u - (2.0 * u[i] - u0[i] + 4e-4 * lap[i])) < 1e-15, "step of point %zu", i);
+    TEST_CHECK(t, fabs(grid->t - 0.01) < 1e-15, "time %g", grid->t);
+
+    /* A point added drops the stencil */
+    memset(&extra, 0, sizeof(extra));
+    TEST_CHECK(t, wave_field_grid_add_point(grid, &extra) == 0 && grid->stencil == NULL, "stencil kept");
+    gsl_matrix_set(grid->coords, N, 0, 1.0);
+    gsl_matrix_set(grid->coords, N, 1, 0.5);
+    st = wave_field_grid_compile(grid);
+    TEST_CHECK(t, st && st->n == N + 1, "recompiled for %zu points", st ? st->n : 0);
+    gsl_matrix_free(grid->coords);
+    grid->coords = NULL;
+    wave_field_grid_invalidate(grid);
+    TEST_CHECK(t, wave_field_grid_compile(grid) == NULL, "a stencil without coords");
+done:
+    wave_field_grid_free(grid);
+    wave_field_grid_free(prev);
+}
+
+/* ---------------- Distributed Grids ---------------- */
+
+#ifdef HAVE_MPI
+/* Smooth start, periodic along z */
+static double test_grid_start(size_t i, size_t j, size_t k, const size_t *n) {
+    const double x = (double)i - 0.5 * (double)n[0], y = (double)j - 0.5 * (double)n[1];
+    return exp(-(x * x + y * y) / 4.0) * (1.0 + cos(6.283185307179586 * (double)k / (double)n[2]));
+}
+
+static void test_grid_wave(struct test *t) {
+    const size_t n[3] = {12, 10, 14};
+    const double h = 0.1, c = 1.0, dt = 0.04;
+    wave_engine *ref = wave_engine_alloc(n[0], n[1], n[2], h, h, h, c, dt);
+    wave_mpi_engine *w = wave_mpi_engine_alloc(MPI_COMM_WORLD, n[0], n[1], n[2], h, h, h, c, dt);
+    size_t bad = 0;
+    if (!ref || !w) {
+        TEST_CHECK(t, 0, "no wave engines");
+        wave_engine_free(ref);
+        if (w) wave_mpi_engine_free(w);
+        return;
+    }
+    for (size_t k = 1; k + 1 < n[2]; k++)
+        for (size_t j = 1; j + 1 < n[1]; j++)
+            for (size_t i = 1; i + 1 < n[0]; i++) {
+                const double v = test_grid_start(i, j, k, n);
+                size_t idx;
+                wave_engine_u(ref)[(k * n[1] + j) * n[0] + i] = wave_engine_u_prev(ref)[(k * n[1] + j) * n[0] + i] = v;
+                if (grid_mpi_local_index(&w->d, i, j, k, &idx))
+                    wave_engine_u(w->engine)[idx] = wave_engine_u_prev(w->engine)[idx] = v;
+            }
+    TEST_CHECK(t, wave_engine_step(ref, 25) == 0 && wave_mpi_engine_step(w, 25) == 0, "wave steps");
+    for (size_t k = 0; k < n[2]; k++)
+        for (size_t j = 0; j < n[1]; j++)
+            for (size_t i = 0; i < n[0]; i++) {
+                size_t idx;
+                if (grid_mpi_local_index(&w->d, i, j, k, &idx) &&
+                    wave_engine_u(w->engine)[idx] != wave_engine_u(ref)[(k * n[1] + j) * n[0] + i])
+                    bad++;
+            }
+    TEST_CHECK(t, bad == 0, "wave: %zu points differ from one rank's run (%d ranks)", bad, w->d.size);
+    wave_engine_free(ref);
+    wave_mpi_engine_free(w);
+}
+
+static void test_grid_maxwell(struct test *t) {
+    const size_t n[3] = {8, 6, 10};
+    const maxwell_yee_boundary_t boundary[3] = {MAXWELL_YEE_PEC, MAXWELL_YEE_PEC, MAXWELL_YEE_PERIODIC};
+    const double h = 1e-3;
+    maxwell_field_grid *ref = maxwell_field_grid_alloc_yee(n[0], n[1], n[2], h, h, h);
+    maxwell_mpi_grid *m = maxwell_mpi_grid_alloc(MPI_COMM_WORLD, n[0], n[1], n[2], h, h, h, boundary);
+    maxwell_yee_grid *g, *lg;
+    size_t bad = 0;
+    double dt, energy;
+    if (!ref || !m) {
+        TEST_CHECK(t, 0, "no Yee grids");
+        goto done;
+    }
+    g = ref->yee;
+    lg = m->grid->yee;
+    maxwell_yee_set_boundary(g, 2, MAXWELL_YEE_PERIODIC);
+    dt = 0.5 * maxwell_yee_max_dt(g);
+    for (size_t k = 0; k < n[2]; k++)
+        for (size_t j = 0; j < n[1]; j++)
+            for (size_t i = 0; i < n[0]; i++) {
+                const double v = test_grid_start(i, j, k, n);
+                size_t idx;
+                g->E[2 * g->n + maxwell_yee_index(g, i, j, k)] = v;
+                g->H[maxwell_yee_index(g, i, j, k)] = 1e-3 * v;
+                if (grid_mpi_local_index(&m->d, i, j, k, &idx)) {
+                    lg->E[2 * lg->n + idx] = v;
+                    lg->H[idx] = 1e-3 * v;
+                }
+            }
+    energy = maxwell_mpi_grid_total_energy(m);
+    for (int s = 0; s < 20; s++)
+        if (maxwell_grid_fdtd_step(ref, dt) != 0 || maxwell_mpi_grid_step(m, dt) != 0) {
+            TEST_CHECK(t, 0, "Maxwell step %d", s);
+            goto done;
+        }
+    for (size_t k = 0; k < n[2]; k++)
+        for (size_t j = 0; j < n[1]; j++)
+            for (size_t i = 0; i < n[0]; i++) {
+                size_t idx;
+                if (!grid_mpi_local_index(&m->d, i, j, k, &idx)) continue;
+                for (int c = 0; c < 3; c++)
+                    if (lg->E[c * lg->n + idx] != g->E[c * g->n + maxwell_yee_index(g, i, j, k)] ||
+                        lg->H[c * lg->n + idx] != g->H[c * g->n + maxwell_yee_index(g, i, j, k)])
+                        bad++;
+            }
+    TEST_CHECK(t, bad == 0, "Maxwell: %zu components differ from one rank's run (%d ranks)", bad, m->d.size);
+    /* A lossless box keeps its energy, to the O(dt^2) wobble of leapfrog */
+    energy = fabs(maxwell_mpi_grid_total_energy(m) / energy - 1.0);
+    TEST_CHECK(t, energy < 0.05, "Maxwell: the energy moved by %.3g", energy);
+done:
+    if (ref) maxwell_field_grid_free(ref);
+    if (m) maxwell_mpi_grid_free(m);
+}
+#endif
+
+/* Collective: every rank of MPI_COMM_WORLD runs it. */
+void test_grid_mpi(struct test *t) {
+#ifdef HAVE_MPI
+    test_grid_wave(t);
+    test_grid_maxwell(t);
+#else
+    test_skip(t, "built without MPI");
+#endif
+}
+
+/* ---------------- Field Files ---------------- */
+
+void test_field_h5(struct test *t) {
+#ifdef HAVE_HDF5
+    const size_t dims[3] = {6, 5, 4}, n = 6 * 5 * 4;
+    const double spacing[3] = {0.1, 0.2, 0.3};
+    const size_t lo[3] = {1, 2, 0}, count[3] = {4, 2, 3};
+    double a[6 * 5 * 4], b[6 * 5 * 4], out[4 * 2 * 3];
+    const char *path = test_path(t, "fields.h5");
+    field_h5_params prm = {{3, 2, 2}, 4};
+    field_h5 *f = field_h5_create(path, dims, spacing, &prm);
+    for (size_t i = 0; i < n; i++) {
+        a[i] = sin(0.1 * (double)i);
+        b[i] = (double)i;
+    }
+    if (!f) {
+        TEST_CHECK(t, 0, "cannot create %s", path);
+        return;
+    }
+    TEST_CHECK(t, field_h5_frame(f, 0.5) == 0 && field_h5_write(f, "u", a) == 0, "frame 0");
+    TEST_CHECK(t, field_h5_frame(f, 1.5) == 0 && field_h5_write(f, "u", b) == 0 && field_h5_write(f, "v", a) == 0,
+               "frame 1");
+    TEST_CHECK(t, field_h5_close(f) == 0, "close after writing");
+
+    if (!(f = field_h5_open(path, 0))) {
+        TEST_CHECK(t, 0, "cannot open %s again", path);
+        return;
+    }
+    TEST_CHECK(t, f->n_frames == 2, "%zu frames", f->n_frames);
+    TEST_CHECK(t, f->dims[0] == 6 && f->dims[1] == 5 && f->dims[2] == 4, "dims %zu x %zu x %zu", f->dims[0], f->dims[1],
+               f->dims[2]);
+    TEST_CHECK(t, f->spacing[1] == 0.2, "spacing %g", f->spacing[1]);
+    TEST_CHECK(t, field_h5_time(f, 0) == 0.5 && field_h5_time(f, 1) == 1.5, "times %g, %g", field_h5_time(f, 0),
+               field_h5_time(f, 1));
+    TEST_CHECK(t, isnan(field_h5_time(f, 2)), "a time for frame 2");
+    /* A hyperslab across chunks, of each frame */
+    for (size_t frame = 0; frame < 2; frame++) {
+        const double *src = frame ? b : a;
+        TEST_CHECK(t, field_h5_read(f, "u", frame, lo, count, out) == 0, "read u of frame %zu", frame);
+        for (size_t k = 0; k < count[2]; k++)
+            for (size_t j = 0; j < count[1]; j++)
+                for (size_t i = 0; i < count[0]; i++) {
+                    const double want = src[((lo[2] + k) * dims[1] + lo[1] + j) * dims[0] + lo[0] + i];
+                    const double got = out[(k * count[1] + j) * count[0] + i];
+                    TEST_CHECK(t, got == want, "frame %zu (%zu, %zu, %zu): %.17g, not %.17g", frame, i, j, k, got,
+                               want);
+                }
+    }
+    /* A component the frame missed reads as NaN */
+    TEST_CHECK(t, field_h5_read(f, "v", 0, lo, count, out) == 0 && isnan(out[0]) && isnan(out[23]),
+               "v of frame 0 is not NaN");
+    TEST_CHECK(t, field_h5_read(f, "v", 1, lo, count, out) == 0 && out[0] == a[(2 * 6) + 1], "v of frame 1");
+    field_h5_close(f);
+#else
+    test_skip(t, "built without HDF5");
+#endif
+}
+
+/* ---------------- Particle Pushers ---------------- */
+
+/* Particle i of s at x with proper velocity u and charge to mass qm */
+static void test_soa_set(lorentz_soa *s, size_t i, const double x[3], const double u[3], double qm) {
+    s->x[i] = x[0];
+    s->y[i] = x[1];
+    s->z[i] = x[2];
+    s->ux[i] = u[0];
+    s->uy[i] = u[1];
+    s->uz[i] = u[2];
+    s->qm[i] = qm;
+    s->gamma[i] = sqrt(1.0 + (u[0] * u[0] + u[1] * u[1] + u[2] * u[2]) / (LORENTZ_C * LORENTZ_C));
+}
+
+static double test_soa_speed(const lorentz_soa *s, size_t i) {
+    return sqrt(s->ux[i] * s->ux[i] + s->uy[i] * s->uy[i] + s->uz[i] * s->uz[i]);
+}
+
+/*
+    Both pushers: a kick of k steps in a pure E field, a gyration that
+    keeps |u| and comes back after a period, and for Vay a particle at
+    the relativistic E x B drift velocity that keeps it. Threads change
+    nothing; a Yee grid of uniform fields acts as E0 and B0 do, and a
+    ramp of Ex in x is read at the particle, not half a cell off.
+*/
+void test_lorentz_push(struct test *t) {
+    enum { N = 1001, STEPS = 200 };
+    static const lorentz_pusher_t pushers[] = {LORENTZ_PUSH_BORIS, LORENTZ_PUSH_VAY};
+    static const double origin[3] = {0, 0, 0};
+    lorentz_soa *s = lorentz_soa_alloc(N), *p = lorentz_soa_alloc(N);
+    maxwell_field_grid *grid = maxwell_field_grid_alloc_yee(8, 8, 8, 1.0, 1.0, 1.0);
+    if (!s || !p || !grid || !grid->yee) {
+        TEST_CHECK(t, 0, "out of memory");
+        goto done;
+    }
+    for (size_t k = 0; k < 2; k++) {
+        const char *name = k ? "Vay" : "Boris";
+        const double E[3] = {1e-3, 0, 0}, B[3] = {0, 0, 1}, u0[3] = {1e3, 0, 0};
+        const double dt = 2.0 * M_PI / STEPS, r = 1e3;
+        double err = 0.0;
+
+        /* u = k qm E dt after k steps without B */
+        for (size_t i = 0; i < N; i++) test_soa_set(s, i, origin, origin, 1.0 + (double)i);
+        for (int n = 0; n < STEPS; n++) lorentz_soa_push(s, NULL, E, NULL, pushers[k], dt);
+        for (size_t i = 0; i < N; i++)
+            err = fmax(err, fabs(s->ux[i] / ((1.0 + (double)i) * E[0] * dt * STEPS) - 1.0) + fabs(s->uy[i]));
+        TEST_CHECK(t, err < 1e-12, "%s: kick off by %g", name, err);
+
+        /* A gyration of radius 1e3 m at qm 1, B 1 T: one period */
+        for (size_t i = 0; i < N; i++) {
+            const double x[3] = {0, -r, (double)i};
+            test_soa_set(s, i, x, u0, 1.0);
+        }
+        for (int n = 0; n < STEPS; n++) lorentz_soa_push(s, NULL, NULL, B, pushers[k], dt);
+        err = 0.0;
+        for (size_t i = 0; i < N; i++) err = fmax(err, fabs(test_soa_speed(s, i) / u0[0] - 1.0));
+        TEST_CHECK(t, err < 1e-12, "%s: |u| off by %g in a magnetic field", name, err);
+        TEST_CHECK(t, hypot(s->x[0], s->y[0] + r) < 1e-3 * r && s->z[0] == 0.0 && s->z[N - 1] == (double)(N - 1),
+                   "%s: (%g, %g, %g) after a period", name, s->x[0], s->y[0], s->z[0]);
+
+        /* The same on 4 threads and all cores, bit for bit */
+        for (int nt = 4; nt >= -1; nt -= 5) {
+            for (size_t i = 0; i < N; i++) {
+                const double x[3] = {0.01 * (double)i, 0, 0}, u[3] = {1e7 * sin((double)i), 2e7, 0};
+                test_soa_set(s, i, x, u, 1e7 * cos((double)i));
+                test_soa_set(p, i, x, u, 1e7 * cos((double)i));
+            }
+            lorentz_soa_set_threads(p, nt);
+            for (int n = 0; n < 10; n++) {
+                lorentz_soa_push(s, NULL, E, B, pushers[k], 1e-9);
+                lorentz_soa_push(p, NULL, E, B, pushers[k], 1e-9);
+            }
+            lorentz_soa_set_threads(p, 0);
+            TEST_CHECK(t, memcmp(s->x, p->x, N * sizeof(double)) == 0 &&
+                              memcmp(s->uy, p->uy, N * sizeof(double)) == 0 &&
+                              memcmp(s->gamma, p->gamma, N * sizeof(double)) == 0,
+                       "%s: %d threads push otherwise", name, nt);
+        }
+    }
+
+    /* E x B drift at c / 2: Vay keeps the particle on it */
+    {
+        const double E[3] = {0.5 * LORENTZ_C, 0, 0}, B[3] = {0, 0, 1};
+        const double ud[3] = {0, -0.5 * LORENTZ_C / sqrt(0.75), 0};
+        double err = 0.0;
+        test_soa_set(s, 0, origin, ud, 1e3);
+        for (int n = 0; n < 1000; n++) lorentz_soa_push(s, NULL, E, B, LORENTZ_PUSH_VAY, 1e-4);
+        err = hypot(s->ux[0], s->uy[0] - ud[1]) / -ud[1];
+        TEST_CHECK(t, err < 1e-9, "Vay: drift velocity off by %g", err);
+    }
+
+    /* Uniform fields on the grid: those of E0 and B0 */
+    {
+        maxwell_yee_grid *g = grid->yee;
+        const double E[3] = {1e5, -2e5, 3e5}, B[3] = {0.1, 0.2, -0.3};
+        double err = 0.0;
+        for (size_t a = 0; a < 3; a++) {
+            maxwell_yee_set_boundary(g, a, MAXWELL_YEE_PERIODIC);
+            for (size_t i = 0; i < g->n; i++) {
+                g->E[a * g->n + i] = E[a];
+                g->H[a * g->n + i] = B[a] / g->materials[0].mu;
+            }
+        }
+        for (size_t i = 0; i < N; i++) {
+            const double x[3] = {fmod(0.37 * (double)i, 8.0), fmod(0.11 * (double)i, 8.0), 4.0}, u[3] = {1e5, 0, 1e5};
+            test_soa_set(s, i, x, u, 1e4);
+            test_soa_set(p, i, x, u, 1e4);
+        }
+        for (int n = 0; n < 20; n++) {
+            lorentz_soa_push(s, NULL, E, B, LORENTZ_PUSH_BORIS, 1e-7);
+            lorentz_soa_push(p, grid, NULL, NULL, LORENTZ_PUSH_BORIS, 1e-7);
+        }
+        for (size_t i = 0; i < N; i++) err = fmax(err, fabs(s->ux[i] - p->ux[i]) + fabs(s->uz[i] - p->uz[i]));
+        TEST_CHECK(t, err < 1e-6, "grid fields push otherwise, by %g m/s", err);
+
+        /* Ex = x on PEC walls: a particle at rest at x feels x */
+        for (size_t a = 0; a < 3; a++) maxwell_yee_set_boundary(g, a, MAXWELL_YEE_PEC);
+        memset(g->E, 0, 3 * g->n * sizeof(double));
+        memset(g->H, 0, 3 * g->n * sizeof(double));
+        for (size_t k = 0; k < 8; k++)
+            for (size_t j = 0; j < 8; j++)
+                for (size_t i = 0; i < 8; i++) g->E[maxwell_yee_index(g, i, j, k)] = (double)i + 0.5;
+        err = 0.0;
+        for (size_t i = 0; i < 50; i++) {
+            const double x[3] = {1.0 + 0.1 * (double)i, 3.3, 2.7};
+            test_soa_set(p, 0, x, origin, 1.0);
+            lorentz_soa_push(p, grid, NULL, NULL, LORENTZ_PUSH_BORIS, 1e-6);
+            err = fmax(err, fabs(p->ux[0] / 1e-6 - x[0]));
+        }
+        TEST_CHECK(t, err < 1e-6, "Ex off the ramp by %g", err);
+    }
+
+    TEST_CHECK(t, lorentz_soa_push(s, NULL, NULL, NULL, (lorentz_pusher_t)7, 1.0) != 0, "an unknown pusher ran");
+done:
+    lorentz_soa_free(s);
+    lorentz_soa_free(p);
+    maxwell_field_grid_free(grid);
+}
+
+/* Positions, velocities and q/m across lorentz_system, gamma and energy back */
+void test_lorentz_soa(struct test *t) {
+    lorentz_particle parts[2];
+    lorentz_system sys;
+    lorentz_soa *s = lorentz_soa_alloc(2);
+    memset(parts, 0, sizeof(parts));
+    memset(&sys, 0, sizeof(sys));
+    sys.n = 2;
+    sys.particles = parts;
+    for (size_t i = 0; i < 2; i++) {
+        parts[i].pos = gsl_vector_alloc(3);
+        parts[i].vel = gsl_vector_alloc(3);
+        parts[i].q = 2.0;
+        parts[i].m = 4.0;
+        for (size_t a = 0; a < 3; a++) {
+            gsl_vector_set(parts[i].pos, a, (double)(i + a));
+            gsl_vector_set(parts[i].vel, a, i ? 0.5 * LORENTZ_C * (a == 1) : 10.0 * (double)a);
+        }
+    }
+    if (!s || !parts[1].vel) {
+        TEST_CHECK(t, 0, "out of memory");
+        goto done;
+    }
+    TEST_CHECK(t, lorentz_soa_gather(s, &sys) == 0, "not gathered");
+    TEST_CHECK(t, s->qm[0] == 0.5 && s->y[1] == 2.0 && fabs(s->uz[0] - 20.0) < 1e-12, "q/m %g, y %g, uz %g", s->qm[0],
+               s->y[1], s->uz[0]);
+    TEST_CHECK(t, fabs(s->gamma[1] * sqrt(0.75) - 1.0) < 1e-15 &&
+                      fabs(s->uy[1] / (0.5 * LORENTZ_C * s->gamma[1]) - 1.0) < 1e-15,
+               "gamma %.17g, uy %.17g at c / 2", s->gamma[1], s->uy[1]);
+    gsl_vector_set(parts[1].vel, 1, 0.0);
+    TEST_CHECK(t, lorentz_soa_scatter(s, &sys) == 0, "not scattered");
+    TEST_CHECK(t, fabs(gsl_vector_get(parts[1].vel, 1) / (0.5 * LORENTZ_C) - 1.0) < 1e-15 &&
+                      parts[1].gamma == s->gamma[1],
+               "velocity %.17g, gamma %g back", gsl_vector_get(parts[1].vel, 1), parts[1].gamma);
+    TEST_CHECK(t, parts[1].energy == s->gamma[1] * 4.0 * LORENTZ_C * LORENTZ_C, "energy %g", parts[1].energy);
+    gsl_vector_set(parts[1].vel, 0, LORENTZ_C);
+    TEST_CHECK(t, lorentz_soa_gather(s, &sys) == -1, "faster than light gathered");
+    gsl_vector_set(parts[1].vel, 0, 0.0);
+    parts[0].m = 0.0;
+    TEST_CHECK(t, lorentz_soa_gather(s, &sys) == -1, "massless gathered");
+    sys.n = 1;
+    TEST_CHECK(t, lorentz_soa_gather(s, &sys) == -1 && lorentz_soa_scatter(s, &sys) == -1, "1 particle into 2");
+done:
+    for (size_t i = 0; i < 2; i++) {
+        if (parts[i].pos) gsl_vector_free(parts[i].pos);
+        if (parts[i].vel) gsl_vector_free(parts[i].vel);
+    }
+    lorentz_soa_free(s);
+}
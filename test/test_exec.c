@@ -0,0 +1,115 @@
+/* test_exec.c - Tests of the executor of HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+   ----------------------------------------------------------------------
+   The executor promises reductions whose blocks and tree depend on the
+   size and grain alone, so they are compared bit for bit across thread
+   counts, and loops that run every index once with a slot no other
+   thread holds at the same time.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <math.h>
+
+#include "core/exec/exec.h"
+#include "tests.h"
+
+/* ---------------- Executor ---------------- */
+
+static void test_sum(size_t lo, size_t hi, void *acc, void *cls) {
+    double *s = acc;
+    (void)cls;
+    for (size_t i = lo; i < hi; i++) *s += 1.0 / (double)(i + 1) * (i % 3 ? 1.0 : -1.0);
+}
+
+static void test_sum_combine(void *acc, const void *other, void *cls) {
+    (void)cls;
+    *(double *)acc += *(const double *)other;
+}
+
+void test_exec_reduce(struct test *t) {
+    static const size_t sizes[] = {1, 1000, 100003}, grains[] = {0, 1, 7, 4096};
+    static const unsigned threads[] = {1, 2, 3, 4};
+    for (size_t s = 0; s < 3; s++)
+        for (size_t g = 0; g < 4; g++) {
+            const double zero = 0.0;
+            double want = 0.0, first = 0.0;
+            test_sum(0, sizes[s], &want, NULL);
+            for (size_t k = 0; k < 4; k++) {
+                double r = -1.0;
+                holos_exec_setup(threads[k], 0);
+                TEST_CHECK(t, holos_exec_reduce(sizes[s], grains[g], &zero, sizeof(zero), test_sum, test_sum_combine,
+                                                &r, NULL) == 0,
+                           "n %zu grain %zu: reduce failed", sizes[s], grains[g]);
+                if (k == 0) first = r;
+                /* The blocks and their tree depend on n and grain only */
+                TEST_CHECK(t, memcmp(&r, &first, sizeof(r)) == 0, "n %zu grain %zu threads %u: %.17g, not %.17g",
+                           sizes[s], grains[g], threads[k], r, first);
+                TEST_CHECK(t, fabs(r - want) < 1e-12, "n %zu grain %zu: %.17g, the sum is %.17g", sizes[s], grains[g],
+                           r, want);
+            }
+        }
+    holos_exec_setup(0, -1);
+}
+
+struct test_for {
+    unsigned char *hits;
+    atomic_int *busy;                   /* Per slot: a range runs with it */
+    unsigned slots;
+    atomic_int bad_slot;
+};
+
+static void test_for_range(size_t lo, size_t hi, unsigned slot, void *cls) {
+    struct test_for *f = cls;
+    if (slot >= f->slots || atomic_exchange(&f->busy[slot], 1)) {
+        atomic_store(&f->bad_slot, 1);
+        return;
+    }
+    for (size_t i = lo; i < hi; i++) f->hits[i]++;
+    atomic_store(&f->busy[slot], 0);
+}
+
+void test_exec_for(struct test *t) {
+    enum { N = 100003 };
+    struct test_for f;
+    holos_exec_setup(4, 0);
+    f.slots = holos_exec_slots(3);
+    f.hits = calloc(N, 1);
+    f.busy = calloc(f.slots ? f.slots : 1, sizeof(*f.busy));
+    atomic_init(&f.bad_slot, 0);
+    if (!f.hits || !f.busy) {
+        TEST_CHECK(t, 0, "out of memory");
+    } else {
+        for (unsigned s = 0; s < f.slots; s++) atomic_init(&f.busy[s], 0);
+        TEST_CHECK(t, holos_exec_for(N, 13, 3, test_for_range, &f) == 0, "loop failed");
+        for (size_t i = 0; i < N; i++)
+            if (f.hits[i] != 1) {
+                TEST_CHECK(t, 0, "index %zu ran %d times", i, f.hits[i]);
+                break;
+            }
+        TEST_CHECK(t, !atomic_load(&f.bad_slot), "a slot out of range, or shared by two threads at once");
+    }
+    free(f.hits);
+    free(f.busy);
+    holos_exec_setup(0, -1);
+}
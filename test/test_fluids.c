@@ -0,0 +1,178 @@
+/* test_fluids.c - Tests of the fluid mechanics of HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+   ----------------------------------------------------------------------
+   The SPH sums through the spatial hash are held to sums over every
+   pair, over two blocks far enough apart for their cells to share
+   buckets; the pair forces must leave the momentum of a free block as
+   it was. Steps must give the serial bits on any thread count, and never
+   move a boundary particle.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <gsl/gsl_vector.h>
+
+#include "core/phys/mech/classical/fluids.h"
+#include "tests.h"
+
+/* ---------------- SPH ---------------- */
+
+#define TEST_SIDE 6                     /* Particles along a block edge */
+#define TEST_N (2 * TEST_SIDE * TEST_SIDE * TEST_SIDE)
+#define TEST_DX 0.01
+
+/* Two jittered blocks of water, the second 40 m off towards negative
+   coordinates; pos[3 i + a] for element i */
+static fluid_system *test_blocks(double *pos) {
+    fluid_system *sys = calloc(1, sizeof(*sys));
+    if (!sys || !(sys->elems = calloc(TEST_N, sizeof(*sys->elems)))) {
+        free(sys);
+        return NULL;
+    }
+    sys->n = TEST_N;
+    for (size_t i = 0; i < TEST_N; i++) {
+        const size_t b = i / (TEST_N / 2), k = i % (TEST_N / 2);
+        const size_t ix = k % TEST_SIDE, iy = k / TEST_SIDE % TEST_SIDE, iz = k / (TEST_SIDE * TEST_SIDE);
+        fluid_element *e = &sys->elems[i];
+        pos[3 * i] = (ix + 0.1 * sin(1.7 * i)) * TEST_DX - 40.0 * b;
+        pos[3 * i + 1] = (iy + 0.1 * sin(2.3 * i + 1)) * TEST_DX - 25.0 * b;
+        pos[3 * i + 2] = (iz + 0.1 * sin(3.1 * i + 2)) * TEST_DX;
+        e->rho = 1000.0;
+        e->mu = 1e-3;
+        if (!(e->v = gsl_vector_calloc(3))) return sys;
+        for (size_t a = 0; a < 3; a++) gsl_vector_set(e->v, a, 0.05 * cos(0.7 * i + a));
+    }
+    return sys;
+}
+
+static void test_blocks_free(fluid_system *sys) {
+    if (!sys) return;
+    for (size_t i = 0; i < sys->n; i++)
+        if (sys->elems[i].v) gsl_vector_free(sys->elems[i].v);
+    free(sys->elems);
+    free(sys);
+}
+
+/* The cubic spline W(r, h), 1 / (pi h^3) normalized */
+static double test_kernel(double r, double h) {
+    const double q = r / h;
+    const double w = q < 1.0 ? 1.0 - 1.5 * q * q + 0.75 * q * q * q : q < 2.0 ? 0.25 * pow(2.0 - q, 3) : 0.0;
+    return w / (M_PI * h * h * h);
+}
+
+/*
+    Density and Tait pressure of every slot against a sum over every
+    particle, and the neighbor count against every pair within 2h; the
+    net force m a of both blocks, with viscosity and no gravity, against
+    the sum of its magnitudes. Then the bottom layers fixed, under
+    gravity: ten steps on 1, 4 and all threads the same bits, the fixed
+    particles where they started, and the others fallen.
+*/
+void test_fluid_sph(struct test *t) {
+    static const int threads[] = {4, -1};
+    fluid_sph_params prm = {1.3 * TEST_DX, TEST_DX * TEST_DX * TEST_DX, 1000.0, 20.0, 7.0, {0.0, 0.0, 0.0}};
+    double *pos = malloc(3 * TEST_N * sizeof(double)), *out = malloc(3 * TEST_N * sizeof(double));
+    fluid_system *sys = pos ? test_blocks(pos) : NULL;
+    fluid_sph *s = NULL, *other = NULL;
+    double err = 0.0, perr = 0.0, net[3] = {0.0, 0.0, 0.0}, mag = 0.0, dt;
+    size_t pairs = 0;
+    int seen[TEST_N] = {0}, perm = 1, ok;
+    if (!sys || !out || !(s = fluid_sph_alloc(TEST_N, &prm))) {
+        TEST_CHECK(t, 0, "out of memory");
+        goto done;
+    }
+    TEST_CHECK(t, fluid_sph_gather(s, sys, pos) == 0 && fluid_sph_update(s) == 0, "gather and update");
+    const double B = prm.rho0 * prm.c0 * prm.c0 / prm.gamma;
+    for (size_t k = 0; k < TEST_N; k++) {
+        double rho = 0.0;
+        for (size_t j = 0; j < TEST_N; j++) {
+            const double r = sqrt(pow(s->x[k] - s->x[j], 2) + pow(s->y[k] - s->y[j], 2) + pow(s->z[k] - s->z[j], 2));
+            rho += s->m[j] * test_kernel(r, prm.h);
+            pairs += j != k && r < 2.0 * prm.h;
+        }
+        err = fmax(err, fabs(s->rho[k] - rho) / rho);
+        perr = fmax(perr, fabs(s->p[k] - fmax(B * (pow(rho / prm.rho0, prm.gamma) - 1.0), 0.0)) / B);
+        if (s->id[k] >= TEST_N || seen[s->id[k]]++) perm = 0;
+        net[0] += s->m[k] * s->ax[k];
+        net[1] += s->m[k] * s->ay[k];
+        net[2] += s->m[k] * s->az[k];
+        mag += s->m[k] * sqrt(s->ax[k] * s->ax[k] + s->ay[k] * s->ay[k] + s->az[k] * s->az[k]);
+    }
+    TEST_CHECK(t, perm, "the slots do not hold each element once");
+    TEST_CHECK(t, err < 1e-12, "densities off the sums over every particle by %g", err);
+    TEST_CHECK(t, perr < 1e-9, "pressures off the Tait equation by %g B", perr);
+    TEST_CHECK(t, s->n_pairs == pairs, "%zu neighbor pairs, not %zu", s->n_pairs, pairs);
+    TEST_CHECK(t, mag > 0.0 && sqrt(net[0] * net[0] + net[1] * net[1] + net[2] * net[2]) < 1e-12 * mag,
+               "net force (%g, %g, %g) out of %g", net[0], net[1], net[2], mag);
+    TEST_CHECK(t, fluid_sph_scatter(s, sys, out) == 0 && memcmp(pos, out, 3 * TEST_N * sizeof(double)) == 0,
+               "positions scattered otherwise than gathered");
+    fluid_sph_free(s);
+    s = NULL;
+
+    /* The two lowest layers of each block hold, under gravity */
+    prm.g[2] = -9.81;
+    for (size_t i = 0; i < TEST_N; i++) sys->elems[i].fixed = i % (TEST_N / 2) < 2 * TEST_SIDE * TEST_SIDE;
+    if (!(s = fluid_sph_alloc(TEST_N, &prm)) || !(other = fluid_sph_alloc(TEST_N, &prm))) {
+        TEST_CHECK(t, 0, "out of memory");
+        goto done;
+    }
+    fluid_sph_gather(s, sys, pos);
+    fluid_sph_update(s);
+    dt = fluid_sph_max_dt(s);
+    TEST_CHECK(t, dt > 0.0 && dt <= 0.25 * prm.h / prm.c0, "timestep %g, above the acoustic limit %g", dt,
+               0.25 * prm.h / prm.c0);
+    for (int k = 0; k < 10; k++) fluid_sph_step(s, dt);
+    for (size_t r = 0; r < sizeof(threads) / sizeof(threads[0]); r++) {
+        fluid_sph_gather(other, sys, pos);
+        fluid_sph_set_threads(other, threads[r]);
+        for (int k = 0; k < 10; k++) fluid_sph_step(other, dt);
+        ok = memcmp(s->id, other->id, TEST_N * sizeof(size_t)) == 0;
+        ok = ok && memcmp(s->x, other->x, TEST_N * sizeof(double)) == 0;
+        ok = ok && memcmp(s->y, other->y, TEST_N * sizeof(double)) == 0;
+        ok = ok && memcmp(s->z, other->z, TEST_N * sizeof(double)) == 0;
+        ok = ok && memcmp(s->vz, other->vz, TEST_N * sizeof(double)) == 0;
+        ok = ok && memcmp(s->rho, other->rho, TEST_N * sizeof(double)) == 0;
+        TEST_CHECK(t, ok, "%d threads: the steps differ from the serial ones", threads[r]);
+    }
+    fluid_sph_scatter(s, sys, out);
+    ok = 1;
+    for (size_t i = 0; i < TEST_N; i++) {
+        const int same = memcmp(pos + 3 * i, out + 3 * i, 3 * sizeof(double)) == 0;
+        if (sys->elems[i].fixed ? !same : same) ok = 0;
+    }
+    TEST_CHECK(t, ok, "a boundary particle moved, or a fluid one did not");
+
+    /* Bad parameters and systems of another size are refused */
+    prm.h = 0.0;
+    TEST_CHECK(t, fluid_sph_alloc(TEST_N, &prm) == NULL, "h = 0 accepted");
+    sys->n--;
+    TEST_CHECK(t, fluid_sph_gather(s, sys, pos) != 0, "a system of %zu elements into %d particles", sys->n,
+               TEST_N);
+    sys->n++;
+done:
+    fluid_sph_free(s);
+    fluid_sph_free(other);
+    test_blocks_free(sys);
+    free(pos);
+    free(out);
+}
@@ -0,0 +1,221 @@
+/* test_forge.c - Tests of the project forge of HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+   ----------------------------------------------------------------------
+   Each case opens its own store in the scratch directory of the run, so
+   the projects it counts are the ones it saved. Batches run on projects
+   in memory, whose linked files are scratch files there or missing,
+   with one callback for every project counting its calls.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "core/forge/forge.h"
+#include "tests.h"
+
+/* ---------------- Forge ---------------- */
+
+static size_t test_count(struct test *t, const char *filter) {
+    struct holos_project **list;
+    size_t n;
+    if (holos_project_list(filter, &list, &n) != 0) {
+        TEST_CHECK(t, 0, "list \"%s\" failed", filter);
+        return (size_t)-1;
+    }
+    for (size_t i = 0; i < n; i++) holos_project_free(list[i]);
+    free(list);
+    return n;
+}
+
+static int test_streq(const char *a, const char *b) {
+    return a && b && strcmp(a, b) == 0;
+}
+
+void test_forge_store(struct test *t) {
+    static const char *names[] = {"a%b", "abc", "x_y", "xzy", "back\\slash"};
+    struct holos_project **list = NULL, *p, tmp;
+    char first[256] = "";
+    size_t n = 0;
+    TEST_CHECK(t, holos_project_store(test_path(t, "forge.db")) == 0, "cannot open the store");
+    for (size_t i = 0; i < 5; i++) {
+        if (!(p = holos_project_create(names[i], "desc"))) {
+            TEST_CHECK(t, 0, "cannot create %s", names[i]);
+            continue;
+        }
+        p->physics_file = strdup("phys.json");
+        p->tags = strdup("alpha,beta");
+        TEST_CHECK(t, holos_project_save(p) == 0, "cannot save %s", names[i]);
+        if (i == 0) snprintf(first, sizeof(first), "%s", p->id);
+        holos_project_free(p);
+    }
+
+    /* Round trip of the summary and the details */
+    p = holos_project_load(first);
+    TEST_CHECK(t, p && test_streq(p->name, "a%b") && test_streq(p->description, "desc") &&
+                      test_streq(p->physics_file, "phys.json") && test_streq(p->tags, "alpha,beta"),
+               "project %s does not load back as saved", first);
+    TEST_CHECK(t, p && p->created_at && p->updated_at, "no timestamps on a saved project");
+    holos_project_free(p);
+
+    /* A bare word is matched literally: % _ and \ are not wildcards */
+    TEST_CHECK(t, test_count(t, "") == 5, "%zu projects in all", test_count(t, ""));
+    TEST_CHECK(t, test_count(t, "%") == 1, "\"%%\" matches %zu projects", test_count(t, "%"));
+    TEST_CHECK(t, test_count(t, "_") == 1, "\"_\" matches %zu projects", test_count(t, "_"));
+    TEST_CHECK(t, test_count(t, "x_") == 1, "\"x_\" matches %zu projects", test_count(t, "x_"));
+    TEST_CHECK(t, test_count(t, "\\") == 1, "\"\\\" matches %zu projects", test_count(t, "\\"));
+    TEST_CHECK(t, test_count(t, "a") == 3, "\"a\" matches %zu projects", test_count(t, "a"));
+    TEST_CHECK(t, test_count(t, "tag:beta b") == 3, "\"tag:beta b\" matches %zu projects", test_count(t, "tag:beta b"));
+
+    /* A listed project has its summary only; a clone copies the stored details */
+    if (holos_project_list("abc", &list, &n) != 0 || n != 1) {
+        TEST_CHECK(t, 0, "\"abc\" lists %zu projects", n);
+    } else {
+        TEST_CHECK(t, holos_project_clone(list[0], "clone1") == 0, "clone of a listed project");
+        p = holos_project_load("clone1");
+        TEST_CHECK(t, p && test_streq(p->name, "abc") && test_streq(p->physics_file, "phys.json"),
+                   "clone1 lost the details of abc");
+        holos_project_free(p);
+        /* Details in memory win over the stored ones */
+        TEST_CHECK(t, holos_project_load_details(list[0]) == 0, "details of abc");
+        free(list[0]->physics_file);
+        list[0]->physics_file = strdup("edited.json");
+        TEST_CHECK(t, holos_project_clone(list[0], "clone2") == 0, "clone of an edited project");
+        p = holos_project_load("clone2");
+        TEST_CHECK(t, p && test_streq(p->physics_file, "edited.json"), "clone2 has physics_file %s",
+                   p && p->physics_file ? p->physics_file : "(none)");
+        holos_project_free(p);
+    }
+    for (size_t i = 0; i < n; i++) holos_project_free(list[i]);
+    free(list);
+    /* A source never saved is cloned from memory alone */
+    memset(&tmp, 0, sizeof(tmp));
+    tmp.id = "unsaved";
+    tmp.name = "fresh";
+    tmp.description = "mem";
+    TEST_CHECK(t, holos_project_clone(&tmp, "clone3") == 0, "clone of an unsaved project");
+    p = holos_project_load("clone3");
+    TEST_CHECK(t, p && test_streq(p->name, "fresh") && test_streq(p->description, "mem"), "clone3 is not its source");
+    holos_project_free(p);
+
+    TEST_CHECK(t, holos_project_delete("clone3") == 0 && holos_project_load("clone3") == NULL,
+               "clone3 still loads after delete");
+    TEST_CHECK(t, test_count(t, "") == 7, "%zu projects after the clones", test_count(t, ""));
+    holos_project_store_close();
+}
+
+/* ---------------- Batches ---------------- */
+
+#define TEST_BATCH 24
+
+struct test_calls {
+    int count[TEST_BATCH];              /* Calls per project */
+    int busy, overlap;                  /* Callbacks running at once */
+    int cancel_after;                   /* Calls before cancelling, 0 never */
+    int total;
+    struct holos_project **projects;
+};
+
+static int test_forge_event(struct holos_project *project, holos_project_event_type event, void *user_data) {
+    struct test_calls *c = user_data;
+    (void)event;
+    if (c->busy++) c->overlap = 1;
+    for (int i = 0; i < TEST_BATCH; i++)
+        if (c->projects[i] == project) c->count[i]++;
+    c->busy--;
+    return c->cancel_after && ++c->total >= c->cancel_after;
+}
+
+static int test_contains(const char *path, const char *text) {
+    char buf[4096];
+    size_t n;
+    FILE *f = fopen(path, "r");
+    if (!f) return 0;
+    n = fread(buf, 1, sizeof(buf) - 1, f);
+    fclose(f);
+    buf[n] = '\0';
+    return strstr(buf, text) != NULL;
+}
+
+void test_forge_batch(struct test *t) {
+    struct holos_project *p[TEST_BATCH] = {NULL};
+    struct test_calls calls;
+    char path[512];
+    FILE *f;
+    int ok = 1, rc;
+    memset(&calls, 0, sizeof(calls));
+    calls.projects = p;
+    f = fopen(test_path(t, "report.pdf"), "w");
+    if (f) fclose(f);
+
+    /* Every third project is missing its physics file, every fourth its owner */
+    for (int i = 0; i < TEST_BATCH; i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "batch%d", i);
+        if (!(p[i] = holos_project_create(name, "batch"))) {
+            TEST_CHECK(t, 0, "cannot create %s", name);
+            ok = 0;
+            continue;
+        }
+        p[i]->physics_file = strdup(test_path(t, i % 3 ? "report.pdf" : "missing.json"));
+        p[i]->owner = strdup(i % 4 ? "owner" : "");
+        p[i]->compliance = strdup("ISO 9001");
+        p[i]->compliance_report_path = strdup(test_path(t, "report.pdf"));
+    }
+    if (!ok) goto out;
+    TEST_CHECK(t, holos_project_batch_limits(65, 0, 0) == -1, "more threads than the batch takes accepted");
+    TEST_CHECK(t, holos_project_register_event_callback(NULL, test_forge_event, &calls) == 0, "cannot register");
+
+    TEST_CHECK(t, (rc = holos_project_batch_run_diagnostics(p, TEST_BATCH)) == 0, "diagnostics returned %d", rc);
+    for (int i = 0; i < TEST_BATCH; i++)
+        TEST_CHECK(t, p[i]->diagnostics && strcmp(p[i]->diagnostics, i % 3 ? "ok" : "missing: physics_file") == 0 &&
+                          calls.count[i] == 1,
+                   "project %d: diagnostics \"%s\", %d calls", i, p[i]->diagnostics ? p[i]->diagnostics : "(none)",
+                   calls.count[i]);
+
+    /* Failed projects do not stop the others, and are counted */
+    rc = holos_project_batch_check_compliance(p, TEST_BATCH);
+    TEST_CHECK(t, rc == -TEST_BATCH / 4, "compliance returned %d for %d owners missing", rc, TEST_BATCH / 4);
+    snprintf(path, sizeof(path), "%s", test_path(t, "reports"));
+    rc = holos_project_batch_generate_reports(p, TEST_BATCH, path);
+    TEST_CHECK(t, rc == 0, "reports returned %d", rc);
+    for (int i = 0; i < TEST_BATCH; i++) {
+        char file[600];
+        snprintf(file, sizeof(file), "%s/%s.txt", path, p[i]->id);
+        TEST_CHECK(t, test_contains(file, i % 4 ? "yes" : "no") && test_contains(file, p[i]->name),
+                   "report of project %d", i);
+        TEST_CHECK(t, calls.count[i] == 3, "project %d: %d calls after three batches", i, calls.count[i]);
+    }
+    TEST_CHECK(t, !calls.overlap, "callbacks ran at once");
+    TEST_CHECK(t, holos_project_batch_run_diagnostics(NULL, 0) == 0 && holos_project_batch_run_diagnostics(NULL, 3) == -1,
+               "empty batches");
+
+    /* One project at a time, a callback cancelling after five */
+    calls.cancel_after = 5;
+    holos_project_batch_limits(1, 0, 0);
+    rc = holos_project_batch_run_diagnostics(p, TEST_BATCH);
+    TEST_CHECK(t, rc == -(TEST_BATCH - 5) && calls.total == 5, "cancelled batch returned %d after %d calls", rc,
+               calls.total);
+    holos_project_batch_limits(64, 0, 0);
+    TEST_CHECK(t, holos_project_unregister_event_callback(NULL, test_forge_event) == 0, "cannot unregister");
+out:
+    for (int i = 0; i < TEST_BATCH; i++) holos_project_free(p[i]);
+}
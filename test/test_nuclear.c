@@ -0,0 +1,647 @@
+/* test_nuclear.c - Tests of the nuclear physics of HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+   ----------------------------------------------------------------------
+   Linear decay chains have closed-form Bateman solutions: the engines
+   are held to them over twenty decades of time. Sampled spectra are
+   checked by their frequencies, and bit for bit across threads.
+   Cross-section tables are held to a plain lin-lin search of their own
+   points, and a flat cross section to its closed-form reactivity. The
+   implicit reaction network is held to Robertson's stiff kinetics, to
+   its published solution and to the conservation of its abundances.
+   Tabulated potentials are held to their callbacks, within the
+   tolerance they were tabulated to.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "core/phys/alias_table.h"
+#include "core/phys/nuclear/nuclear_decay.h"
+#include "core/phys/nuclear/fission_fusion.h"
+#include "core/phys/nuclear/nuclear_forces.h"
+#include "tests.h"
+
+#define TEST_LN2 0.69314718055994530942
+
+/* ---------------- Decay ---------------- */
+
+/* A linear chain of n nuclides, member k decaying to k + 1 with
+   half_life[k] and branching ratio ratio[k]; the last is stable. */
+struct test_chain {
+    nd_nucleus_t nuclei[4];
+    nd_decay_branch_t branches[3];
+    nd_decay_branch_t *branch_list[3];
+    nd_decay_chain_t chains[3];
+    nd_decay_chain_t *chain_list[3];
+    nd_nucleus_t *nucleus_list[4];
+    nd_system_t system;
+    nd_decay_chain_t linear;                /* The whole chain, as nd_bateman_chain_batch() reads it */
+};
+
+static void test_chain_build(struct test_chain *c, size_t n, const double *half_life, const double *ratio) {
+    memset(c, 0, sizeof(*c));
+    for (size_t k = 0; k < n; k++) {
+        c->nuclei[k].symbol[0] = 'X';
+        c->nuclei[k].symbol[1] = (char)('0' + k);
+        c->nuclei[k].Z = 90 - (int)k;
+        c->nuclei[k].N = 140;
+        c->nucleus_list[k] = &c->nuclei[k];
+    }
+    for (size_t k = 0; k + 1 < n; k++) {
+        c->branches[k].mode = ND_DECAY_BETA_MINUS;
+        c->branches[k].branching_ratio = ratio[k];
+        c->branches[k].half_life = half_life[k];
+        c->branches[k].daughter = &c->nuclei[k + 1];
+        c->branch_list[k] = &c->branches[k];
+        c->chains[k].parent = &c->nuclei[k];
+        c->chains[k].branches = &c->branch_list[k];
+        c->chains[k].n_branches = 1;
+        c->chain_list[k] = &c->chains[k];
+    }
+    c->system.nuclei = c->nucleus_list;
+    c->system.n_nuclei = n;
+    c->system.chains = c->chain_list;
+    c->system.n_chains = n - 1;
+    c->linear.parent = &c->nuclei[0];
+    c->linear.branches = c->branch_list;
+    c->linear.n_branches = n - 1;
+}
+
+/* Closed-form Bateman: member m of the chain at t, from 1 of the parent */
+static double test_bateman(size_t m, const double *half_life, const double *ratio, size_t n, double t) {
+    double lambda[4], prod = 1, sum = 0;
+    for (size_t k = 0; k < n; k++) lambda[k] = k + 1 < n ? TEST_LN2 / half_life[k] : 0;
+    for (size_t k = 0; k < m; k++) prod *= ratio[k] * lambda[k];
+    for (size_t i = 0; i <= m; i++) {
+        double d = 1;
+        for (size_t j = 0; j <= m; j++)
+            if (j != i) d *= lambda[j] - lambda[i];
+        sum += exp(-lambda[i] * t) / d;
+    }
+    return prod * sum;
+}
+
+void test_depletion(struct test *t) {
+    /* 1 us, 1 y and 1e9 y to a stable end */
+    static const double half_life[] = {1e-6, 3.15576e7, 3.15576e16}, ratio[] = {1, 1, 1};
+    static const double dts[] = {1e-6, 1e-3, 1, 1e5, 3e7, 1e12, 1e16};
+    struct test_chain c;
+    nd_depletion_t *dep;
+    test_chain_build(&c, 4, half_life, ratio);
+    if (!(dep = nd_depletion_alloc(&c.system))) {
+        TEST_CHECK(t, 0, "no engine for the chain");
+        return;
+    }
+    for (size_t s = 0; s < sizeof(dts) / sizeof(dts[0]); s++) {
+        const double n0[4] = {1, 0, 0, 0};
+        double n1[4], n2[4];
+        nd_depletion_set_threads(dep, 0);
+        TEST_CHECK(t, nd_depletion_step(dep, dts[s], n0, n1) == 0, "step of %g s", dts[s]);
+        for (size_t m = 0; m < 4; m++) {
+            const double exact = test_bateman(m, half_life, ratio, 4, dts[s]);
+            TEST_CHECK(t, fabs(n1[m] - exact) < 1e-13, "N%zu(%g s) = %.17g, not %.17g", m, dts[s], n1[m], exact);
+        }
+        /* The poles split across threads sum in their order */
+        nd_depletion_set_threads(dep, 3);
+        TEST_CHECK(t, nd_depletion_step(dep, dts[s], n0, n2) == 0 && memcmp(n1, n2, sizeof(n1)) == 0,
+                   "%g s: threads change the result", dts[s]);
+    }
+    nd_depletion_free(dep);
+}
+
+/* Steps of 0.5 s then 1 s take the abundances to the Bateman solution at
+   the total time, the activity with them. */
+void test_decay_step(struct test *t) {
+    static const double half_life[] = {1.0, 3.0, 7.0}, ratio[] = {1, 1, 1};
+    double n[4] = {2, 0, 0, 0}, time = 0;
+    struct test_chain c;
+    test_chain_build(&c, 4, half_life, ratio);
+    TEST_CHECK(t, nd_step_decay(&c.system, 0.5) != 0, "a step without abundances");
+    c.system.abundances = n;
+    for (int s = 0; s < 8; s++) {
+        const double dt = s < 4 ? 0.5 : 1.0;
+        double activity = 0;
+        if (nd_step_decay(&c.system, dt) != 0) {
+            TEST_CHECK(t, 0, "step %d failed", s);
+            break;
+        }
+        time += dt;
+        for (size_t m = 0; m < 4; m++) {
+            const double exact = 2 * test_bateman(m, half_life, ratio, 4, time);
+            TEST_CHECK(t, fabs(n[m] - exact) < 1e-12, "N%zu(%g s) = %.17g, not %.17g", m, time, n[m], exact);
+            if (m < 3) activity += TEST_LN2 / half_life[m] * exact;
+        }
+        TEST_CHECK(t, fabs(c.system.diagnostics.total_activity - activity) < 1e-12 * activity,
+                   "activity %.17g Bq at %g s, not %.17g", c.system.diagnostics.total_activity, time, activity);
+    }
+    TEST_CHECK(t, c.system.depletion != NULL, "no engine kept on the system");
+    nd_step_decay_release(&c.system);
+    TEST_CHECK(t, c.system.depletion == NULL, "engine kept after release");
+}
+
+void test_bateman_batch(struct test *t) {
+    double half_life[] = {1.0, 3.0, 7.0}, ratio[] = {1.0, 0.6, 1.0};
+    enum { N_T = 1000 };
+    double times[N_T], n0[N_T], out[N_T], act[N_T];
+    struct test_chain c;
+    for (size_t i = 0; i < N_T; i++) {
+        times[i] = 0.05 * (double)i;
+        n0[i] = 1.0 + (double)(i % 7);
+    }
+    test_chain_build(&c, 4, half_life, ratio);
+    for (int pass = 0; pass < 2; pass++) {
+        TEST_CHECK(t, nd_bateman_chain_batch(&c.linear, times, n0, N_T, out) == 0, "batch of %d times", N_T);
+        TEST_CHECK(t, nd_chain_activity_batch(&c.linear, times, n0, N_T, act) == 0, "activity batch");
+        for (size_t i = 0; i < N_T; i++) {
+            const double exact = n0[i] * test_bateman(3, half_life, ratio, 4, times[i]);
+            double a = 0, scalar;
+            for (size_t m = 0; m < 3; m++)
+                a += TEST_LN2 / half_life[m] * n0[i] * test_bateman(m, half_life, ratio, 4, times[i]);
+            TEST_CHECK(t, fabs(out[i] - exact) <= 1e-12 * n0[i], "pass %d: N(%g) = %.17g, not %.17g", pass, times[i],
+                       out[i], exact);
+            TEST_CHECK(t, fabs(act[i] - a) <= 1e-12 * a + 1e-300, "pass %d: A(%g) = %.17g, not %.17g", pass, times[i],
+                       act[i], a);
+            if (i % 97) continue;
+            scalar = nd_bateman_chain(&c.linear, times[i], n0[i]);
+            TEST_CHECK(t, fabs(scalar - out[i]) <= 1e-13 * n0[i], "scalar N(%g) = %.17g, batch %.17g", times[i], scalar,
+                       out[i]);
+        }
+        /* The cached coefficients must follow an edited half-life */
+        half_life[1] = 2.0;
+        c.branches[1].half_life = 2.0;
+    }
+    nd_bateman_chain_release(&c.linear);
+    TEST_CHECK(t, c.linear.bateman == NULL, "coefficients kept after release");
+}
+
+/* ---------------- Alias Tables ---------------- */
+
+void test_alias_table(struct test *t) {
+    static const double w[] = {1, 2, 3, 4, 0};
+    enum { N_DRAWS = 400000 };
+    size_t *serial = malloc(N_DRAWS * sizeof(*serial)), *threaded = malloc(N_DRAWS * sizeof(*threaded));
+    double *e0 = malloc(N_DRAWS * sizeof(*e0)), *e1 = malloc(N_DRAWS * sizeof(*e1));
+    double spectrum[] = {1, 1, 2}, mean = 0;
+    double lines[] = {0.5, 1.0, 2.0}, line_weights[] = {1, 0, 3};
+    size_t count[5] = {0}, n_lines[3] = {0};
+    nd_decay_branch_t branch;
+    ff_reaction_t reaction;
+    alias_table *a = alias_table_alloc(w, 5);
+
+    TEST_CHECK(t, alias_table_alloc(w + 4, 1) == NULL, "a table of zero weights");
+    if (!a || !serial || !threaded || !e0 || !e1) {
+        TEST_CHECK(t, 0, "out of memory");
+        goto done;
+    }
+    TEST_CHECK(t, alias_table_sample(a, 42, 3, 1000, N_DRAWS, serial, NULL, 0) == 0, "serial draws");
+    TEST_CHECK(t, alias_table_sample(a, 42, 3, 1000, N_DRAWS, threaded, NULL, 4) == 0, "threaded draws");
+    TEST_CHECK(t, memcmp(serial, threaded, N_DRAWS * sizeof(*serial)) == 0, "draws depend on the threads");
+    for (size_t k = 0; k < N_DRAWS; k++) count[serial[k] < 5 ? serial[k] : 4]++;
+    TEST_CHECK(t, count[4] == 0, "an outcome of weight 0 drawn %zu times", count[4]);
+    for (int i = 0; i < 4; i++) {
+        const double p = w[i] / 10, sigma = sqrt(N_DRAWS * p * (1 - p));
+        TEST_CHECK(t, fabs((double)count[i] - N_DRAWS * p) < 5 * sigma, "outcome %d: %zu of %d draws, p = %g", i,
+                   count[i], N_DRAWS, p);
+    }
+    /* A draw is a function of its index: a later start sees the same */
+    TEST_CHECK(t, alias_table_sample(a, 42, 3, 1500, 100, threaded, NULL, 0) == 0 &&
+                      memcmp(threaded, serial + 500, 100 * sizeof(*serial)) == 0,
+               "draws 500..599 differ when drawn from 500");
+
+    /* Decay spectra: bins of [0, Q], sampled the same on any threads */
+    memset(&branch, 0, sizeof(branch));
+    branch.Q_value = 3.0;
+    branch.emission_spectrum = spectrum;
+    branch.n_spectrum = 3;
+    TEST_CHECK(t, nd_decay_branch_sample(&branch, 9, 0, 0, e0, N_DRAWS, 0) == 0, "serial spectrum draws");
+    TEST_CHECK(t, nd_decay_branch_sample(&branch, 9, 0, 0, e1, N_DRAWS, -1) == 0, "threaded spectrum draws");
+    TEST_CHECK(t, memcmp(e0, e1, N_DRAWS * sizeof(*e0)) == 0, "spectrum draws depend on the threads");
+    for (size_t k = 0; k < N_DRAWS; k++) {
+        if (!(e0[k] >= 0 && e0[k] <= 3)) {
+            TEST_CHECK(t, 0, "energy %.17g outside [0, Q]", e0[k]);
+            break;
+        }
+        mean += e0[k] / N_DRAWS;
+    }
+    TEST_CHECK(t, fabs(mean - 1.75) < 0.01, "mean energy %g, not 1.75", mean);
+    nd_decay_branch_reset_sampler(&branch);
+
+    /* Reaction lines: only the energies given, in their weights */
+    memset(&reaction, 0, sizeof(reaction));
+    reaction.n_neutrons_emitted = 3;
+    reaction.neutron_energies = lines;
+    reaction.neutron_weights = line_weights;
+    TEST_CHECK(t, ff_reaction_sample_neutrons(&reaction, 5, 1, 0, e0, N_DRAWS, 0) == 0, "serial neutron draws");
+    TEST_CHECK(t, ff_reaction_sample_neutrons(&reaction, 5, 1, 0, e1, N_DRAWS, 3) == 0, "threaded neutron draws");
+    TEST_CHECK(t, memcmp(e0, e1, N_DRAWS * sizeof(*e0)) == 0, "neutron draws depend on the threads");
+    for (size_t k = 0; k < N_DRAWS; k++) {
+        size_t l = 0;
+        while (l < 3 && e0[k] != lines[l]) l++;
+        if (l == 3) {
+            TEST_CHECK(t, 0, "neutron energy %.17g is no line", e0[k]);
+            break;
+        }
+        n_lines[l]++;
+    }
+    TEST_CHECK(t, n_lines[1] == 0, "a line of weight 0 drawn %zu times", n_lines[1]);
+    TEST_CHECK(t, fabs((double)n_lines[2] / N_DRAWS - 0.75) < 5 * sqrt(0.75 * 0.25 / N_DRAWS),
+               "%zu of %d draws on the line of weight 3/4", n_lines[2], N_DRAWS);
+    ff_reaction_reset_samplers(&reaction);
+
+done:
+    alias_table_free(a);
+    free(serial);
+    free(threaded);
+    free(e0);
+    free(e1);
+}
+
+/* ---------------- Cross-Section Tables ---------------- */
+
+/* Three reactions, each by ascending energy; D+T has a step at 0.1 MeV */
+static const struct {
+    const char *label;
+    size_t n;
+    double e[8], v[8];
+} test_xs[] = {
+    {"U235(n,f)", 7, {1e-8, 1e-6, 1e-3, 0.1, 1.0, 2.0, 14.0}, {600.0, 60.0, 20.0, 1.5, 1.2, 1.3, 2.1}},
+    {"D+T", 6, {0.01, 0.05, 0.1, 0.1, 1.0, 20.0}, {0.01, 2.0, 4.5, 3.0, 0.8, 0.05}},
+    {"B11(n,g)", 2, {0.0, 30.0}, {0.25, 0.25}},
+};
+
+static uint64_t g_xs_rand;
+
+/* Uniform in [0, 1) from g_xs_rand */
+static double test_xs_uniform(void) {
+    g_xs_rand ^= g_xs_rand << 13;
+    g_xs_rand ^= g_xs_rand >> 7;
+    g_xs_rand ^= g_xs_rand << 17;
+    return (double)(g_xs_rand >> 11) * 0x1.0p-53;
+}
+
+/* sigma of test_xs[r] at E: lin-lin from the last point at or below E */
+static double test_xs_ref(size_t r, double E) {
+    const double *e = test_xs[r].e, *v = test_xs[r].v;
+    const size_t n = test_xs[r].n;
+    size_t j = 0;
+    if (E <= e[0]) return v[0];
+    if (E >= e[n - 1]) return v[n - 1];
+    while (j + 1 < n && e[j + 1] <= E) j++;
+    return v[j] + (E - e[j]) * (v[j + 1] - v[j]) / (e[j + 1] - e[j]);
+}
+
+/*
+    The points handed over out of order (but a step in its own order),
+    with a NULL among them: every energy of the grid, energies between
+    and beyond, and random ones evaluate as the plain search does, the
+    batch as one by one on any threads. A flat 0.25 b, from 0 to 30 MeV
+    = 300 kT, has <sigma v> = sigma sqrt(8 kT / (pi mu c^2)) c.
+*/
+void test_xs_table(struct test *t) {
+    enum { N_E = 5000 };
+    static const int threads[] = {0, 4, -1};
+    ff_cross_section_t cs[16];
+    const ff_cross_section_t *ptr[17];
+    double *E = malloc(N_E * sizeof(*E)), *one = malloc(N_E * sizeof(*one)), *out = malloc(N_E * sizeof(*out));
+    ff_xs_table_t *tab = NULL;
+    ff_nucleus_t u235, d, tr;
+    size_t n = 0;
+    if (!E || !one || !out) {
+        TEST_CHECK(t, 0, "out of memory");
+        goto done;
+    }
+    memset(cs, 0, sizeof(cs));
+    for (size_t k = 0; k < 8; k++)          /* Round robin over the reactions, last point first */
+        for (size_t r = 0; r < 3; r++)
+            if (k < test_xs[r].n) {
+                const size_t j = k ? k - 1 : test_xs[r].n - 1;
+                snprintf(cs[n].label, sizeof(cs[n].label), "%s", test_xs[r].label);
+                cs[n].energy = test_xs[r].e[j];
+                cs[n].value = test_xs[r].v[j];
+                n++;
+            }
+    for (size_t k = 0, m = 0; k < n; k++) {
+        if (k == 4) ptr[m++] = NULL;
+        ptr[m++] = &cs[k];
+    }
+    TEST_CHECK(t, ff_xs_table_alloc(ptr, 0, 0) == NULL, "a table of no points");
+    cs[3].energy = NAN;
+    TEST_CHECK(t, ff_xs_table_alloc(ptr, n + 1, 0) == NULL, "a table with a NaN energy");
+    cs[3].energy = test_xs[0].e[0];
+    tab = ff_xs_table_alloc(ptr, n + 1, 0);
+    TEST_CHECK(t, tab != NULL, "no table");
+    if (!tab) goto done;
+    TEST_CHECK(t, tab->n_reactions == 3 && strcmp(tab->labels[0], "B11(n,g)") == 0 &&
+                      strcmp(tab->labels[2], "U235(n,f)") == 0,
+               "%zu reactions, first %s", tab->n_reactions, tab->labels[0]);
+    TEST_CHECK(t, tab->n_union == 12, "%zu grid energies, not 12", tab->n_union);
+    TEST_CHECK(t, ff_xs_table_find(tab, "D+T") >= 0 && ff_xs_table_find(tab, "T+D") == -1, "find D+T");
+
+    for (size_t r = 0; r < 3; r++) {
+        const long id = ff_xs_table_find(tab, test_xs[r].label);
+        size_t bad = 0, k = 0;
+        g_xs_rand = 0x78737462ull + r;
+        for (size_t u = 0; u < tab->n_union; u++) {
+            E[k++] = tab->grid[u];
+            E[k++] = u + 1 < tab->n_union ? 0.5 * (tab->grid[u] + tab->grid[u + 1]) : 2.0 * tab->grid[u];
+        }
+        E[k++] = -1.0;
+        E[k++] = 1e-12;
+        E[k++] = 100.0;
+        while (k < N_E) E[k++] = pow(10.0, -9.0 + 11.0 * test_xs_uniform());
+        for (k = 0; k < N_E; k++) {
+            const double want = test_xs_ref(r, E[k]);
+            one[k] = ff_xs_eval(tab, (size_t)id, E[k]);
+            if (fabs(one[k] - want) > 1e-12 * fabs(want)) {
+                if (!bad++)
+                    TEST_CHECK(t, 0, "%s at %.17g MeV: %.17g, not %.17g", test_xs[r].label, E[k], one[k], want);
+            }
+        }
+        TEST_CHECK(t, bad == 0, "%s: %zu of %d energies off", test_xs[r].label, bad, N_E);
+        for (size_t i = 0; i < sizeof(threads) / sizeof(threads[0]); i++) {
+            memset(out, 0, N_E * sizeof(*out));
+            TEST_CHECK(t, ff_xs_eval_batch(tab, (size_t)id, E, out, N_E, threads[i]) == 0 &&
+                              memcmp(out, one, N_E * sizeof(*out)) == 0,
+                       "%s: the batch on %d threads is not ff_xs_eval", test_xs[r].label, threads[i]);
+        }
+    }
+    TEST_CHECK(t, ff_xs_eval_batch(tab, 3, E, out, 1, 0) == -1 && ff_xs_eval(tab, 3, 1.0) == 0.0, "reaction 3 of 3");
+
+    /* Flat sigma; and the same through the default table */
+    {
+        const double kT = 0.1, mu = 2.0 * 3.0 / 5.0, c = 2.99792458e10;
+        const double want = 0.25e-24 * c * sqrt(8.0 * kT / (M_PI * mu * 931.49410242));
+        const double got = ff_xs_reactivity(tab, (size_t)ff_xs_table_find(tab, "B11(n,g)"), mu, kT);
+        TEST_CHECK(t, fabs(got / want - 1.0) < 1e-12, "<sigma v> %.17g, not %.17g", got, want);
+        TEST_CHECK(t, ff_xs_reactivity(tab, 0, mu, 0.0) == 0.0 && ff_xs_reactivity(tab, 0, -1.0, kT) == 0.0,
+                   "a reactivity at kT 0 or mu < 0");
+        memset(&u235, 0, sizeof(u235));
+        memset(&d, 0, sizeof(d));
+        memset(&tr, 0, sizeof(tr));
+        snprintf(u235.symbol, sizeof(u235.symbol), "U235");
+        snprintf(d.symbol, sizeof(d.symbol), "D");
+        snprintf(tr.symbol, sizeof(tr.symbol), "T");
+        d.Z = d.N = 1;
+        tr.Z = 1;
+        tr.N = 2;
+        ff_xs_set_default(tab);
+        TEST_CHECK(t, ff_fission_yield(&u235, 1.5) == ff_xs_eval(tab, 2, 1.5) && ff_fission_yield(&d, 1.5) == 0.0,
+                   "fission yield %g", ff_fission_yield(&u235, 1.5));
+        TEST_CHECK(t, ff_fusion_rate(&tr, &d, kT) == ff_xs_reactivity(tab, 1, 6.0 / 5.0, kT) &&
+                          ff_fusion_rate(&tr, &d, kT) > 0,
+                   "fusion rate of T and D %g", ff_fusion_rate(&tr, &d, kT));
+        ff_xs_set_default(NULL);
+        TEST_CHECK(t, ff_fission_yield(&u235, 1.5) == 0.0, "a yield with no table");
+    }
+done:
+    ff_xs_table_free(tab);
+    free(E);
+    free(one);
+    free(out);
+}
+
+/* ---------------- Reaction Networks ---------------- */
+
+/* A network over nuclei of the caller, one reactant list and one product
+   list per reaction, rates given */
+struct test_network {
+    ff_nucleus_t nuclei[3], *nucleus_list[3];
+    ff_reaction_t reactions[3], *reaction_list[3];
+    ff_nucleus_t *in[3][2], *out[3][2];
+    ff_system_t system;
+};
+
+static void test_network_add(struct test_network *w, double rate, const char *in, const char *out) {
+    const size_t k = w->system.n_reactions++;
+    ff_reaction_t *r = &w->reactions[k];
+    memset(r, 0, sizeof(*r));
+    r->rate = rate;
+    r->reactants = w->in[k];
+    r->products = w->out[k];
+    for (; *in; in++) w->in[k][r->n_reactants++] = &w->nuclei[*in - 'A'];
+    for (; *out; out++) w->out[k][r->n_products++] = &w->nuclei[*out - 'A'];
+    w->reaction_list[k] = r;
+}
+
+static void test_network_init(struct test_network *w) {
+    memset(w, 0, sizeof(*w));
+    for (int i = 0; i < 3; i++) {
+        w->nuclei[i].symbol[0] = (char)('A' + i);
+        w->nuclei[i].Z = i + 1;
+        w->nuclei[i].N = i;
+        w->nucleus_list[i] = &w->nuclei[i];
+    }
+    w->system.nuclei = w->nucleus_list;
+    w->system.n_nuclei = 3;
+    w->system.reactions = w->reaction_list;
+}
+
+/*
+    Robertson's stiff kinetics, A -> B at 0.04/s, B + B -> B + C at
+    3e7/s and B + C -> A + C at 1e4/s: the rates as written out, the
+    abundances at 40 s those of Hairer and Wanner's reference to 1e-5,
+    their sum 1 out to 4e10 s, on far fewer Jacobians and factorizations
+    than steps. A -> B -> C, decaying at 1e6/s and 1e-3/s, to the Bateman
+    solution at 1000 s; a call held to a few steps stopped at its last
+    accepted state.
+*/
+void test_ff_network(struct test *t) {
+    static const double ref[3] = {0.7158270687193, 9.185534764557e-6, 0.2841637457};
+    const ff_network_params prm = {1e-8, 1e-20, 0.0, 0.0, 0};
+    struct test_network w;
+    ff_network_t *net = NULL;
+    double Y[3] = {0.3, 2e-5, 0.7 - 2e-5}, dY[3], want[3], err = 0.0;
+
+    test_network_init(&w);
+    test_network_add(&w, 0.04, "A", "B");
+    test_network_add(&w, 3e7, "BB", "BC");
+    test_network_add(&w, 1e4, "BC", "AC");
+    if (!(net = ff_network_alloc(&w.system, &prm))) {
+        TEST_CHECK(t, 0, "out of memory");
+        return;
+    }
+    TEST_CHECK(t, net->n == 3 && net->n_reactions == 3, "%zu species, %zu reactions", net->n, net->n_reactions);
+    want[0] = -0.04 * Y[0] + 1e4 * Y[1] * Y[2];
+    want[2] = 3e7 * Y[1] * Y[1];
+    want[1] = -want[0] - want[2];
+    TEST_CHECK(t, ff_network_rates(net, Y, dY) == 0, "rates");
+    for (int i = 0; i < 3; i++) err = fmax(err, fabs(dY[i] - want[i]) / fabs(want[i]));
+    TEST_CHECK(t, err < 1e-14, "rates off Robertson's by %g", err);
+
+    Y[0] = 1.0;
+    Y[1] = Y[2] = 0.0;
+    TEST_CHECK(t, ff_network_integrate(net, Y, 0.4) == 0 && ff_network_integrate(net, Y, 39.6) == 0, "to 40 s");
+    for (int i = 0; i < 3; i++)
+        TEST_CHECK(t, fabs(Y[i] - ref[i]) < 1e-5 * ref[i], "Y%d(40 s) = %.12g, not %.12g", i, Y[i], ref[i]);
+    TEST_CHECK(t, net->n_jacobians < net->n_steps / 10 && net->n_factorizations < net->n_steps / 4,
+               "%zu Jacobians and %zu factorizations over %zu steps", net->n_jacobians, net->n_factorizations,
+               net->n_steps);
+    ff_network_free(net);
+
+    /* At the default tolerances, out to 4e10 s */
+    net = ff_network_alloc(&w.system, NULL);
+    Y[0] = 1.0;
+    Y[1] = Y[2] = 0.0;
+    TEST_CHECK(t, net && ff_network_integrate(net, Y, 4e10) == 0, "to 4e10 s");
+    TEST_CHECK(t, fabs(Y[0] + Y[1] + Y[2] - 1.0) < 1e-12 && Y[0] < 1e-7 && Y[2] > 1.0 - 1e-7,
+               "Y(4e10 s) = (%.6g, %.6g, %.6g)", Y[0], Y[1], Y[2]);
+    ff_network_free(net);
+
+    /* A fast and a slow decay */
+    test_network_init(&w);
+    test_network_add(&w, 1e6, "A", "B");
+    test_network_add(&w, 1e-3, "B", "C");
+    test_network_add(&w, 0.0, "C", "A");
+    net = ff_network_alloc(&w.system, &prm);
+    Y[0] = 1.0;
+    Y[1] = Y[2] = 0.0;
+    TEST_CHECK(t, net && net->n_reactions == 2, "a reaction of rate 0 compiled");
+    TEST_CHECK(t, net && ff_network_integrate(net, Y, 1000.0) == 0, "chain to 1000 s");
+    {
+        const double b = 1e6 / (1e-3 - 1e6) * (exp(-1e6 * 1000.0) - exp(-1e-3 * 1000.0));
+        TEST_CHECK(t, fabs(Y[1] - b) < 1e-5 * b && fabs(Y[0] + Y[1] + Y[2] - 1.0) < 1e-12,
+                   "Y(1000 s) = (%.6g, %.12g, %.12g), not B = %.12g", Y[0], Y[1], Y[2], b);
+    }
+    ff_network_free(net);
+
+    /* Five steps are not enough for 1000 s */
+    {
+        const ff_network_params few = {1e-8, 1e-20, 0.0, 0.0, 5};
+        net = ff_network_alloc(&w.system, &few);
+        Y[0] = 1.0;
+        Y[1] = Y[2] = 0.0;
+        TEST_CHECK(t, net && ff_network_integrate(net, Y, 1000.0) == -1, "1000 s in five steps");
+        TEST_CHECK(t, net && net->n_steps == 5 && Y[0] < 1.0 && fabs(Y[0] + Y[1] + Y[2] - 1.0) < 1e-12,
+                   "%zu steps, Y = (%.6g, %.6g, %.6g)", net ? net->n_steps : 0, Y[0], Y[1], Y[2]);
+        ff_network_free(net);
+    }
+}
+
+/* ---------------- Tabulated Potentials ---------------- */
+
+static double test_yukawa(double r, void *params) {
+    (void)params;
+    return -50.0 * exp(-r / 1.4) / r;
+}
+
+static double test_woods_saxon(double r, void *params) {
+    return -*(const double *)params / (1.0 + exp((r - 3.0) / 0.65));
+}
+
+static double test_nan(double r, void *params) {
+    (void)params;
+    return r > 2.0 ? NAN : 1.0 / r;
+}
+
+/*
+    A Yukawa and a Woods-Saxon tensor term, tabulated over [0.1, 60] fm
+    to 1e-8: the spline within its tolerance of both and of dV/dr inside
+    the range, the callbacks themselves outside it and once untabulated,
+    batches the values one at a time. The binding energy of 60 nucleons
+    is the sum over their pairs, with the coupling constant; a callback
+    that is not finite cannot be tabulated.
+*/
+void test_nf_potential(struct test *t) {
+    enum { N = 60 };
+    double depth = 50.0, r[64], v[64], dv[64], err = 0.0, derr = 0.0, terr = 0.0, berr = 0.0, sum = 0.0;
+    nf_potential_t pot, bad;
+    nf_nucleon_t nucleons[N], *list[N];
+    nf_force_model_t model, *models[1] = {&model};
+    nf_system_t sys;
+
+    memset(&pot, 0, sizeof(pot));
+    pot.potential_fn = test_yukawa;
+    pot.tensor_fn = test_woods_saxon;
+    pot.params = &depth;
+    TEST_CHECK(t, nf_potential_tabulate(&pot, 0.1, 60.0, 1e-8, 1e-10) == 0 && pot.table, "tabulation");
+    for (int k = 0; k <= 20000; k++) {
+        const double x = 0.1 + 59.9 * k / 20000.0, e = test_yukawa(x, NULL), ws = test_woods_saxon(x, &depth);
+        const double de = 50.0 * exp(-x / 1.4) * (1.0 / (1.4 * x) + 1.0 / (x * x));
+        double d;
+        err = fmax(err, fabs(nf_potential_eval(&pot, x, &d) - e) / (1e-8 * fabs(e) + 1e-10));
+        if (x < 20.0) derr = fmax(derr, fabs(d - de) / fabs(de));
+        terr = fmax(terr, fabs(nf_potential_eval_tensor(&pot, x, NULL) - ws) / (1e-8 * fabs(ws) + 1e-10));
+    }
+    TEST_CHECK(t, err <= 1.0, "V off the Yukawa by %g of the tolerance", err);
+    TEST_CHECK(t, derr < 1e-5, "dV/dr off the Yukawa by %g", derr);
+    TEST_CHECK(t, terr <= 1.0, "tensor term off the Woods-Saxon by %g of the tolerance", terr);
+    TEST_CHECK(t, nf_potential_eval(&pot, 70.0, NULL) == test_yukawa(70.0, NULL) &&
+                      nf_potential_eval(&pot, 0.05, NULL) == test_yukawa(0.05, NULL),
+               "outside the table, not the callback");
+
+    /* A batch across the ends of the table */
+    for (int k = 0; k < 64; k++) r[k] = 0.02 + 1.1 * k;
+    TEST_CHECK(t, nf_potential_eval_batch(&pot, r, v, dv, 64) == 0, "batch");
+    err = 0.0;
+    for (int k = 0; k < 64; k++) {
+        double d;
+        const double e = nf_potential_eval(&pot, r[k], &d);
+        err = fmax(err, fmax(fabs(v[k] - e) / fabs(e), fabs(dv[k] - d) / fabs(d)));
+    }
+    TEST_CHECK(t, err < 1e-14, "batch off the single evaluations by %g", err);
+
+    /* 60 nucleons in a box of 12 fm, a coupling of 2 */
+    memset(nucleons, 0, sizeof(nucleons));
+    memset(&model, 0, sizeof(model));
+    memset(&sys, 0, sizeof(sys));
+    model.potential = &pot;
+    model.coupling_constant = 2.0;
+    sys.nucleons = list;
+    sys.n_nucleons = N;
+    sys.force_models = models;
+    sys.n_force_models = 1;
+    for (int i = 0; i < N; i++) {
+        list[i] = &nucleons[i];
+        if (!(nucleons[i].position = gsl_vector_alloc(3))) {
+            TEST_CHECK(t, 0, "out of memory");
+            goto done;
+        }
+        for (size_t a = 0; a < 3; a++) gsl_vector_set(nucleons[i].position, a, 6.0 + 5.5 * sin(1.3 * i + 2.1 * a));
+    }
+    for (int i = 0; i < N; i++)
+        for (int j = i + 1; j < N; j++) {
+            double d2 = 0.0;
+            for (size_t a = 0; a < 3; a++)
+                d2 += pow(gsl_vector_get(list[i]->position, a) - gsl_vector_get(list[j]->position, a), 2);
+            sum -= 2.0 * test_yukawa(sqrt(d2), NULL);
+        }
+    berr = fabs(nf_binding_energy(&sys) - sum) / fabs(sum);
+    TEST_CHECK(t, berr < 1e-8, "binding energy %.12g, not %.12g", nf_binding_energy(&sys), sum);
+    gsl_vector_free(nucleons[1].position);
+    nucleons[1].position = NULL;
+    TEST_CHECK(t, nf_pair_potential(list[0], list[1], &pot) == 0.0, "a pair without a position");
+
+    /* Direct again, and a callback that is not finite */
+    nf_potential_untabulate(&pot);
+    TEST_CHECK(t, pot.table == NULL && nf_potential_eval(&pot, 2.5, NULL) == test_yukawa(2.5, NULL),
+               "untabulated, not the callback");
+    memset(&bad, 0, sizeof(bad));
+    bad.potential_fn = test_nan;
+    TEST_CHECK(t, nf_potential_tabulate(&bad, 0.5, 5.0, 1e-8, 1e-10) == -1, "a NaN tabulated");
+    nf_potential_untabulate(&bad);
+done:
+    nf_potential_untabulate(&pot);
+    for (int i = 0; i < N; i++)
+        if (nucleons[i].position) gsl_vector_free(nucleons[i].position);
+}
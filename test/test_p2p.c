@@ -0,0 +1,953 @@
+/* test_p2p.c - Tests of the P2P layer of HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+   ----------------------------------------------------------------------
+   The P2P cases run over loopback links, which exist only without
+   GNUnet: a frame sent to a connected "peer" comes back to this
+   process, which serves its own requests. A GNUnet build skips them.
+   Chunked fetches are judged by the bytes they send: none for chunks
+   already in the store, and nothing twice across a stopped fetch. A job
+   stolen by this peer from itself must still end each task once, with
+   the link up or lost. The peer table must hold a peer gone offline for
+   its TTL and no longer, and rank the online ones by what 64 KiB costs
+   to each. The metrics must count each record once each way, and a
+   refusal once. The wire case looks at what a message carries as its
+   view gives it: the binary identities of sender and receiver around
+   the payload.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <math.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "core/p2p/p2p.h"
+#include "core/p2p/p2p_chunk.h"
+#include "core/p2p/p2p_stats.h"
+#include "core/p2p/p2p_task.h"
+#include "tests.h"
+
+#define TEST_PEER "test-peer"
+#define TEST_POLLS 100000               /* Polls after which a loopback exchange is stuck */
+
+/* ---------------- Events ---------------- */
+
+#ifndef HAVE_GNUNET
+static void test_no_message(const struct holos_p2p_message_view *msg, void *cls) {
+    (void)msg;
+    (void)cls;
+}
+
+enum { TEST_EVENTS = 2000 };
+static uint32_t g_events[TEST_EVENTS];
+static atomic_size_t g_n_events;
+
+static void test_on_event(const struct holos_p2p_event *ev) {
+    const struct holos_p2p_message *msg = ev->event_data;
+    size_t n;
+    uint32_t v;
+    if (strcmp(ev->event_type, "message") != 0 || msg->size != sizeof(v)) return;
+    memcpy(&v, msg->payload, sizeof(v));
+    n = atomic_fetch_add(&g_n_events, 1);
+    if (n < TEST_EVENTS) g_events[n] = v;
+}
+#endif
+
+/* One dispatcher delivers the events of a priority in the order raised. */
+void test_p2p_event_order(struct test *t) {
+#ifndef HAVE_GNUNET
+    struct holos_p2p_event_stats st;
+    struct holos_p2p_message msg;
+    uint32_t v;
+    size_t n;
+    atomic_init(&g_n_events, 0);
+    if (holos_p2p_init() != 0 || holos_p2p_connect(TEST_PEER) != HOLOS_P2P_OK) {
+        TEST_CHECK(t, 0, "no loopback link");
+        holos_p2p_finalize();
+        return;
+    }
+    holos_p2p_on_message(test_no_message, NULL);
+    holos_p2p_register_event_callback(test_on_event);
+    TEST_CHECK(t, holos_p2p_event_dispatch(1, 2 * TEST_EVENTS) == HOLOS_P2P_OK, "no dispatcher thread");
+    memset(&msg, 0, sizeof(msg));
+    msg.type = HOLOS_P2P_MSG_DATA;
+    msg.payload = &v;
+    msg.size = sizeof(v);
+    for (v = 0; v < TEST_EVENTS; v++) {
+        int rc, polls = 0;
+        while ((rc = holos_p2p_send_message(TEST_PEER, &msg)) == HOLOS_P2P_ERR_AGAIN && polls++ < TEST_POLLS)
+            holos_p2p_poll();
+        if (rc != HOLOS_P2P_OK) {
+            TEST_CHECK(t, 0, "message %u not sent: %d", v, rc);
+            break;
+        }
+        if (v % 64 == 63) holos_p2p_poll();
+    }
+    for (int i = 0; i < TEST_POLLS && holos_p2p_poll() > 0; i++) { }
+    holos_p2p_event_dispatch(0, 0);             /* Returns once the queued events ran */
+    holos_p2p_event_stats(&st);
+    n = atomic_load(&g_n_events);
+    TEST_CHECK(t, n == TEST_EVENTS, "%zu message events of %d (%llu dropped)", n, TEST_EVENTS,
+               (unsigned long long)st.dropped);
+    for (size_t i = 0; i < n && i < TEST_EVENTS; i++)
+        if (g_events[i] != i) {
+            TEST_CHECK(t, 0, "event %zu is message %u", i, g_events[i]);
+            break;
+        }
+    holos_p2p_finalize();
+#else
+    test_skip(t, "GNUnet build: no loopback links");
+#endif
+}
+
+/* ---------------- Deltas ---------------- */
+
+#ifndef HAVE_GNUNET
+/* Polls until *flag is set; 0, or -1 if the exchange stopped first */
+static int test_p2p_until(const int *flag) {
+    for (int i = 0; i < TEST_POLLS && !*flag; i++) holos_p2p_poll();
+    return *flag ? 0 : -1;
+}
+
+static void test_fetch_done(struct holos_p2p_fetch *fetch, int status, void *cls) {
+    int *done = cls;
+    (void)fetch;
+    *done = status == HOLOS_P2P_OK ? 1 : -1;
+}
+
+static int test_write_file(const char *path, const void *data, size_t n) {
+    FILE *f = fopen(path, "wb");
+    int rc = f && fwrite(data, 1, n, f) == n ? 0 : -1;
+    if (f && fclose(f) != 0) rc = -1;
+    return rc;
+}
+
+/* Makes dir in the scratch directory and writes the n bytes of data to
+   file there */
+static int test_write_version(struct test *t, const char *dir, const char *file, const void *data, size_t n) {
+    if (mkdir(test_path(t, dir), 0700) != 0 || test_write_file(test_path(t, file), data, n) != 0) {
+        TEST_CHECK(t, 0, "cannot write %s", file);
+        return -1;
+    }
+    return 0;
+}
+
+/* Whether path holds the n bytes of data */
+static int test_same_file(const char *path, const void *data, size_t n) {
+    unsigned char *buf = malloc(n + 1);
+    FILE *f = fopen(path, "rb");
+    int same = buf && f && fread(buf, 1, n + 1, f) == n && memcmp(buf, data, n) == 0;
+    if (f) fclose(f);
+    free(buf);
+    return same;
+}
+
+/* Bytes sent to the loopback peer so far */
+static uint64_t test_bytes_sent(void) {
+    struct holos_p2p_peer_stats peers[8];
+    const size_t n = holos_p2p_stats_peers(peers, 8);
+    uint64_t sent = 0;
+    for (size_t i = 0; i < n && i < 8; i++)
+        if (strcmp(peers[i].id, TEST_PEER) == 0) sent += peers[i].bytes_sent;
+    return sent;
+}
+
+/* Fetches id, based on base if not NULL, from the loopback peer into dir */
+static int test_fetch(struct test *t, const holos_p2p_hash_t *id, const holos_p2p_hash_t *base, const char *dir) {
+    const char *peers[] = {TEST_PEER};
+    int done = 0;
+    struct holos_p2p_fetch *f = holos_p2p_fetch(id, peers, 1, dir, test_fetch_done, &done);
+    if (!f) return -1;
+    if (base) TEST_CHECK(t, holos_p2p_fetch_base(f, base) == HOLOS_P2P_OK, "fetch refused its base");
+    if (test_p2p_until(&done) != 0) done = -1;
+    holos_p2p_fetch_free(f);
+    return done == 1 ? 0 : -1;
+}
+#endif
+
+/*
+    A project of 4 MiB of doubles is fetched, then a version of it with
+    1% of the doubles changed in their last bits, based on the first:
+    the second fetch must rebuild the files exactly while sending a
+    fraction of them, the changed chunks going as deltas.
+*/
+void test_p2p_delta(struct test *t) {
+#ifndef HAVE_GNUNET
+    enum { N = 4 * 1024 * 1024 / 8 };
+    double *v1 = malloc(N * sizeof(*v1)), *v2 = malloc(N * sizeof(*v2));
+    holos_p2p_hash_t id1, id2;
+    uint64_t sent;
+    if (!v1 || !v2) {
+        TEST_CHECK(t, 0, "out of memory");
+        goto done;
+    }
+    for (size_t i = 0; i < N; i++) v1[i] = v2[i] = sin(1e-3 * (double)i) * 300.0;
+    for (size_t i = 0; i < N; i += 100) {
+        uint64_t bits;
+        memcpy(&bits, &v2[i], sizeof(bits));
+        bits ^= 0x15 + (i & 0xff);
+        memcpy(&v2[i], &bits, sizeof(bits));
+    }
+    if (test_write_version(t, "v1", "v1/fields.bin", v1, N * sizeof(*v1)) != 0 ||
+        test_write_version(t, "v2", "v2/fields.bin", v2, N * sizeof(*v2)) != 0)
+        goto done;
+    if (holos_p2p_init() != 0 || holos_p2p_connect(TEST_PEER) != HOLOS_P2P_OK) {
+        TEST_CHECK(t, 0, "no loopback link");
+        goto stop;
+    }
+    holos_p2p_chunk_store(test_path(t, "store"));
+    TEST_CHECK(t, holos_p2p_share_path(test_path(t, "v1"), &id1) == HOLOS_P2P_OK, "cannot share v1");
+    TEST_CHECK(t, holos_p2p_share_path(test_path(t, "v2"), &id2) == HOLOS_P2P_OK, "cannot share v2");
+    if (test_fetch(t, &id1, NULL, test_path(t, "out1")) != 0) {
+        TEST_CHECK(t, 0, "first fetch failed");
+        goto stop;
+    }
+    TEST_CHECK(t, test_same_file(test_path(t, "out1/fields.bin"), v1, N * sizeof(*v1)),
+               "out1 is not the first version");
+
+    sent = test_bytes_sent();
+    if (test_fetch(t, &id2, &id1, test_path(t, "out2")) != 0) {
+        TEST_CHECK(t, 0, "fetch of the second version failed");
+        goto stop;
+    }
+    sent = test_bytes_sent() - sent;
+    TEST_CHECK(t, test_same_file(test_path(t, "out2/fields.bin"), v2, N * sizeof(*v2)),
+               "out2 is not the second version");
+    TEST_CHECK(t, sent < N * sizeof(*v2) / 4, "the update sent %llu bytes for a file of %zu",
+               (unsigned long long)sent, N * sizeof(*v2));
+    TEST_CHECK(t, holos_p2p_stats_retries(HOLOS_P2P_RETRY_DELTA) == 0, "%llu deltas asked again as bytes",
+               (unsigned long long)holos_p2p_stats_retries(HOLOS_P2P_RETRY_DELTA));
+stop:
+    holos_p2p_finalize();
+done:
+    free(v1);
+    free(v2);
+#else
+    test_skip(t, "GNUnet build: no loopback links");
+#endif
+}
+
+/* ---------------- Chunked Transfer ---------------- */
+
+#ifndef HAVE_GNUNET
+static uint64_t g_chunk_rand;
+
+/* n pseudo-random bytes, which no chunking can shrink */
+static void test_random_bytes(unsigned char *p, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        g_chunk_rand = g_chunk_rand * 6364136223846793005ull + 1442695040888963407ull;
+        p[i] = (unsigned char)(g_chunk_rand >> 56);
+    }
+}
+#endif
+
+/*
+    A tree of a file of 3.5 chunks, a small one in a subdirectory and an
+    empty one is fetched whole, then again with every chunk in the store
+    (next to nothing sent). A second object, fetched until a chunk of it
+    is in and then stopped, must on the next fetch send only what it
+    still lacked. Unknown objects and paths are refused.
+*/
+void test_p2p_chunks(struct test *t) {
+#ifndef HAVE_GNUNET
+    enum { BIG = 7 * HOLOS_P2P_CHUNK_SIZE / 2, SMALL = 1000 };
+    unsigned char *big = malloc(BIG), *other = malloc(4 * HOLOS_P2P_CHUNK_SIZE), small[SMALL];
+    const char *peers[] = {TEST_PEER};
+    holos_p2p_hash_t id, id2, parsed, unknown;
+    struct holos_p2p_fetch *f = NULL;
+    uint64_t sent, have = 0, total = 0;
+    char hex[65], dir[4096];
+    int done;
+    if (!big || !other) {
+        TEST_CHECK(t, 0, "out of memory");
+        goto done;
+    }
+    g_chunk_rand = 0x63686b;
+    test_random_bytes(big, BIG);
+    test_random_bytes(small, SMALL);
+    test_random_bytes(other, 4 * HOLOS_P2P_CHUNK_SIZE);
+    if (test_write_version(t, "tree", "tree/big.bin", big, BIG) != 0 ||
+        test_write_version(t, "tree/sub", "tree/sub/small.txt", small, SMALL) != 0 ||
+        test_write_file(test_path(t, "tree/empty"), "", 0) != 0 ||
+        test_write_version(t, "other", "other/fields.bin", other, 4 * HOLOS_P2P_CHUNK_SIZE) != 0)
+        goto done;
+    if (holos_p2p_init() != 0 || holos_p2p_connect(TEST_PEER) != HOLOS_P2P_OK) {
+        TEST_CHECK(t, 0, "no loopback link");
+        goto stop;
+    }
+    holos_p2p_chunk_store(test_path(t, "store"));
+    TEST_CHECK(t, holos_p2p_share_path(test_path(t, "tree"), &id) == HOLOS_P2P_OK &&
+                      holos_p2p_share_path(test_path(t, "other"), &id2) == HOLOS_P2P_OK,
+               "cannot share the trees");
+    holos_p2p_hash_hex(&id, hex);
+    TEST_CHECK(t, strlen(hex) == 64 && holos_p2p_hash_parse(hex, &parsed) == HOLOS_P2P_OK &&
+                      memcmp(&parsed, &id, sizeof(id)) == 0,
+               "object name %s not parsed back", hex);
+    TEST_CHECK(t, holos_p2p_hash_parse("12ab", &parsed) != HOLOS_P2P_OK, "a name of 4 digits parsed");
+
+    /* Whole, then from the store */
+    sent = test_bytes_sent();
+    TEST_CHECK(t, test_fetch(t, &id, NULL, test_path(t, "out1")) == 0, "first fetch failed");
+    sent = test_bytes_sent() - sent;
+    TEST_CHECK(t, test_same_file(test_path(t, "out1/big.bin"), big, BIG) &&
+                      test_same_file(test_path(t, "out1/sub/small.txt"), small, SMALL) &&
+                      test_same_file(test_path(t, "out1/empty"), "", 0),
+               "out1 is not the tree");
+    TEST_CHECK(t, sent >= BIG + SMALL && sent < BIG + SMALL + HOLOS_P2P_CHUNK_SIZE / 8,
+               "%llu bytes sent for a tree of %d", (unsigned long long)sent, BIG + SMALL);
+    sent = test_bytes_sent();
+    TEST_CHECK(t, test_fetch(t, &id, NULL, test_path(t, "out2")) == 0, "second fetch failed");
+    sent = test_bytes_sent() - sent;
+    TEST_CHECK(t, test_same_file(test_path(t, "out2/big.bin"), big, BIG) && sent < HOLOS_P2P_CHUNK_SIZE / 8,
+               "%llu bytes sent for a tree in the store", (unsigned long long)sent);
+
+    /* Stopped with a chunk in, then fetched again */
+    snprintf(dir, sizeof(dir), "%s", test_path(t, "out3"));
+    done = 0;
+    if (!(f = holos_p2p_fetch(&id2, peers, 1, dir, test_fetch_done, &done))) {
+        TEST_CHECK(t, 0, "fetch of the second object refused");
+        goto stop;
+    }
+    for (int i = 0; i < TEST_POLLS && !done && have < HOLOS_P2P_CHUNK_SIZE; i++) {
+        holos_p2p_poll();
+        holos_p2p_fetch_progress(f, &have, &total);
+    }
+    TEST_CHECK(t, !done && total == 4 * HOLOS_P2P_CHUNK_SIZE && have >= HOLOS_P2P_CHUNK_SIZE && have < total,
+               "stopped at %llu of %llu bytes", (unsigned long long)have, (unsigned long long)total);
+    holos_p2p_fetch_free(f);
+    for (int i = 0; i < TEST_POLLS && holos_p2p_poll() > 0; i++) { }
+    sent = test_bytes_sent();
+    TEST_CHECK(t, test_fetch(t, &id2, NULL, dir) == 0, "fetch started again failed");
+    sent = test_bytes_sent() - sent;
+    TEST_CHECK(t, test_same_file(test_path(t, "out3/fields.bin"), other, 4 * HOLOS_P2P_CHUNK_SIZE) &&
+                      sent <= total - HOLOS_P2P_CHUNK_SIZE + HOLOS_P2P_CHUNK_SIZE / 8,
+               "%llu bytes sent again, %llu were in", (unsigned long long)sent, (unsigned long long)have);
+
+    /* Refused */
+    memset(&unknown, 0x5a, sizeof(unknown));
+    TEST_CHECK(t, test_fetch(t, &unknown, NULL, test_path(t, "out4")) != 0, "an unknown object fetched");
+    TEST_CHECK(t, holos_p2p_share_path(test_path(t, "no-such-tree"), &parsed) != HOLOS_P2P_OK,
+               "a path that does not exist shared");
+stop:
+    holos_p2p_finalize();
+done:
+    free(big);
+    free(other);
+#else
+    test_skip(t, "GNUnet build: no loopback links");
+#endif
+}
+
+/* ---------------- Work Stealing ---------------- */
+
+#ifndef HAVE_GNUNET
+#define TEST_TASKS 200
+#define TEST_STEAL_MAX 32               /* P2P_STEAL_MAX of p2p_task.c */
+
+/* Sum of the squares of a point of 3, or status 7 for its first
+   coordinate a multiple of 50 */
+static int test_task_square(const void *input, size_t size, void **output, size_t *output_size, void *cls) {
+    double p[3], *s;
+    (void)cls;
+    if (holos_p2p_sweep_point(input, size, p, 3) != HOLOS_P2P_OK) return HOLOS_P2P_ERR_GENERIC;
+    if ((int)p[0] % 50 == 0) return 7;
+    if (!(s = malloc(sizeof(*s)))) return HOLOS_P2P_ERR_GENERIC;
+    *s = p[0] * p[0] + p[1] * p[1] + p[2] * p[2];
+    *output = s;
+    *output_size = sizeof(*s);
+    return 0;
+}
+
+struct test_results {
+    int count[TEST_TASKS];
+    int wrong;
+    const double *points;
+};
+
+static void test_on_result(struct holos_p2p_job *job, size_t task, int status, const void *output, size_t size,
+                           void *cls) {
+    struct test_results *r = cls;
+    double s;
+    (void)job;
+    if (task >= TEST_TASKS) {
+        r->wrong++;
+        return;
+    }
+    r->count[task]++;
+    if ((int)r->points[3 * task] % 50 == 0) {
+        r->wrong += status != 7 || size != 0;
+        return;
+    }
+    if (status != 0 || size != sizeof(s)) {
+        r->wrong++;
+        return;
+    }
+    memcpy(&s, output, sizeof(s));
+    r->wrong += s != r->points[3 * task] * r->points[3 * task] + r->points[3 * task + 1] * r->points[3 * task + 1] +
+                         r->points[3 * task + 2] * r->points[3 * task + 2];
+}
+
+/* Tasks of r whose result came other than once */
+static size_t test_results_bad(const struct test_results *r) {
+    size_t bad = (size_t)r->wrong;
+    for (size_t i = 0; i < TEST_TASKS; i++) bad += r->count[i] != 1;
+    return bad;
+}
+
+/* Runs the job out; -1 if it stopped with results still to come */
+static int test_job_run(struct holos_p2p_job *job) {
+    for (int i = 0; i < TEST_POLLS && holos_p2p_job_pending(job); i++) {
+        holos_p2p_poll();
+        holos_p2p_task_run(8);
+    }
+    return holos_p2p_job_pending(job) ? -1 : 0;
+}
+#endif
+
+/*
+    A sweep of 200 points, a steal already on its way from this peer to
+    the loopback one, which is this peer again: the steal must lend half
+    of them (at most a steal's worth) over the link and every result
+    must come back once and right, the failed tasks with their status.
+    Then the link goes down while tasks are lent on it: they are taken
+    back and run here, each result still once.
+*/
+void test_p2p_tasks(struct test *t) {
+#ifndef HAVE_GNUNET
+    double *points = malloc(3 * TEST_TASKS * sizeof(double));
+    struct test_results *res = calloc(1, sizeof(*res));
+    struct holos_p2p_job *job = NULL;
+    struct holos_p2p_histogram hist;
+    uint64_t retried;
+    if (!points || !res) {
+        TEST_CHECK(t, 0, "out of memory");
+        goto done;
+    }
+    for (size_t i = 0; i < TEST_TASKS; i++) {
+        points[3 * i] = (double)i;
+        points[3 * i + 1] = 0.5 * (double)i;
+        points[3 * i + 2] = -1.0;
+    }
+    res->points = points;
+    if (holos_p2p_init() != 0 || holos_p2p_connect(TEST_PEER) != HOLOS_P2P_OK) {
+        TEST_CHECK(t, 0, "no loopback link");
+        goto stop;
+    }
+    TEST_CHECK(t, holos_p2p_task_register("square", test_task_square, NULL) == HOLOS_P2P_OK, "not registered");
+    TEST_CHECK(t, holos_p2p_task_register("", test_task_square, NULL) != HOLOS_P2P_OK, "a kind of no name");
+
+    /* Nothing held: the steal goes out before the job comes in */
+    holos_p2p_stats_reset();
+    holos_p2p_task_run(0);
+    if (!(job = holos_p2p_job_sweep("square", points, TEST_TASKS, 3, test_on_result, res))) {
+        TEST_CHECK(t, 0, "sweep not submitted");
+        goto stop;
+    }
+    TEST_CHECK(t, holos_p2p_job_pending(job) == TEST_TASKS, "%zu tasks pending", holos_p2p_job_pending(job));
+    TEST_CHECK(t, test_job_run(job) == 0, "%zu tasks still pending", holos_p2p_job_pending(job));
+    TEST_CHECK(t, test_results_bad(res) == 0, "%zu results wrong, missing or twice", test_results_bad(res));
+    holos_p2p_stats_rtt(HOLOS_P2P_RTT_TASK, &hist);
+    TEST_CHECK(t, hist.count == TEST_STEAL_MAX, "%llu tasks went over the link, not %d",
+               (unsigned long long)hist.count, TEST_STEAL_MAX);
+    holos_p2p_job_free(job);
+    job = NULL;
+
+    /* Lent, then the link lost; started again for a steal without backoff */
+    memset(res->count, 0, sizeof(res->count));
+    res->wrong = 0;
+    holos_p2p_finalize();
+    if (holos_p2p_init() != 0 || holos_p2p_connect(TEST_PEER) != HOLOS_P2P_OK) {
+        TEST_CHECK(t, 0, "no loopback link the second time");
+        goto stop;
+    }
+    holos_p2p_task_run(0);
+    if (!(job = holos_p2p_job_sweep("square", points, TEST_TASKS, 3, test_on_result, res))) {
+        TEST_CHECK(t, 0, "sweep not submitted");
+        goto stop;
+    }
+    retried = holos_p2p_stats_retries(HOLOS_P2P_RETRY_TASK);
+    holos_p2p_poll();
+    holos_p2p_disconnect(TEST_PEER);
+    TEST_CHECK(t, holos_p2p_stats_retries(HOLOS_P2P_RETRY_TASK) > retried, "no lent task taken back");
+    TEST_CHECK(t, test_job_run(job) == 0, "%zu tasks still pending without the link", holos_p2p_job_pending(job));
+    TEST_CHECK(t, test_results_bad(res) == 0, "without the link: %zu results wrong, missing or twice",
+               test_results_bad(res));
+    TEST_CHECK(t, !holos_p2p_job_sweep("square", points, 2, 0, test_on_result, res), "a sweep of points of 0");
+stop:
+    holos_p2p_job_free(job);
+    holos_p2p_finalize();
+done:
+    free(points);
+    free(res);
+#else
+    test_skip(t, "GNUnet build: no loopback links");
+#endif
+}
+
+/* ---------------- Peer Table ---------------- */
+
+#ifndef HAVE_GNUNET
+#define TEST_PEER_OTHER "test-peer-2"
+#define TEST_COST_BYTES 65536.0         /* P2P_COST_BYTES of p2p_peers.c */
+#define TEST_PEER_TTL 600               /* P2P_PEER_TTL of p2p_peers.c, s */
+#define TEST_TICK_MS 100                /* P2P_TICK_MS of p2p_link.h */
+
+/* Cost p2p_peers.c takes a peer on: round trip and 64 KiB at its rate */
+static double test_peer_cost(const struct holos_p2p_peer *p) {
+    double cost = p->latency_ms > 0 ? p->latency_ms : 1000.0;
+    if (p->bandwidth > 0) cost += 1000.0 * TEST_COST_BYTES / p->bandwidth;
+    return cost;
+}
+
+/* Polls (across ticks) until both peers have a round trip */
+static int test_peers_measured(void) {
+    const struct timespec pause = {0, 20000};
+    for (int i = 0; i < TEST_POLLS; i++) {
+        const struct holos_p2p_peer *a = holos_p2p_peer_find(TEST_PEER), *b = holos_p2p_peer_find(TEST_PEER_OTHER);
+        if (a && b && a->latency_ms > 0 && b->latency_ms > 0) return 0;
+        holos_p2p_poll();
+        nanosleep(&pause, NULL);
+    }
+    return -1;
+}
+#endif
+
+/*
+    Two loopback links: both peers in the table, online, found by ID and
+    listed, and measured by PING and PONG; discover_peers and get_peer
+    copies of the entries, nearest the online peers cheapest first. A
+    peer gone offline stays listed as such until the TTL runs out; then
+    it is not found, and the next tick drops its entry. The TTL is left
+    at its default.
+*/
+void test_p2p_peers(struct test *t) {
+#ifndef HAVE_GNUNET
+    const struct holos_p2p_peer *view[4] = {NULL}, *p;
+    struct holos_p2p_peer *copies = NULL, one = {0};
+    const char *ids[2] = {NULL, NULL};
+    size_t n = 0;
+    time_t gone;
+    if (holos_p2p_init() != 0 || holos_p2p_connect(TEST_PEER) != HOLOS_P2P_OK ||
+        holos_p2p_connect(TEST_PEER_OTHER) != HOLOS_P2P_OK) {
+        TEST_CHECK(t, 0, "no loopback links");
+        goto done;
+    }
+    p = holos_p2p_peer_find(TEST_PEER);
+    TEST_CHECK(t, p && p->online && strcmp(p->id, TEST_PEER) == 0, "%s not found online", TEST_PEER);
+    TEST_CHECK(t, holos_p2p_peer_find("no-such-peer") == NULL, "a peer never heard of found");
+    TEST_CHECK(t, holos_p2p_peer_list(view, 4, 1) == 2 && view[0] && view[1] && view[0] != view[1],
+               "%zu online peers listed", holos_p2p_peer_list(NULL, 0, 1));
+    TEST_CHECK(t, holos_p2p_peer_list(view, 1, 0) == 2, "a list of 1 not told of 2 peers");
+    TEST_CHECK(t, test_peers_measured() == 0, "no round trip to the loopback peers");
+
+    /* Copies, not the entries */
+    TEST_CHECK(t, holos_p2p_discover_peers(&copies, &n) == HOLOS_P2P_OK && n == 2, "%zu peers discovered", n);
+    for (size_t i = 0; copies && i < n; i++) {
+        const struct holos_p2p_peer *e = holos_p2p_peer_find(copies[i].id);
+        TEST_CHECK(t, e && e->id != copies[i].id && e->online == copies[i].online &&
+                          e->latency_ms == copies[i].latency_ms,
+                   "discovered %s not a copy of its entry", copies[i].id);
+    }
+    TEST_CHECK(t, holos_p2p_get_peer(TEST_PEER_OTHER, &one) == HOLOS_P2P_OK && one.id &&
+                      strcmp(one.id, TEST_PEER_OTHER) == 0 && one.id != holos_p2p_peer_find(TEST_PEER_OTHER)->id,
+               "get_peer not a copy of %s", TEST_PEER_OTHER);
+    TEST_CHECK(t, holos_p2p_get_peer("no-such-peer", &one) == HOLOS_P2P_ERR_PEER_NOT_FOUND, "get_peer of no peer");
+
+    /* Cheapest first; a short array still told of both */
+    TEST_CHECK(t, holos_p2p_peer_nearest(ids, 2) == 2 && ids[0] && ids[1] && strcmp(ids[0], ids[1]) != 0,
+               "nearest: not both online peers");
+    if (ids[0] && ids[1])
+        TEST_CHECK(t, test_peer_cost(holos_p2p_peer_find(ids[0])) <= test_peer_cost(holos_p2p_peer_find(ids[1])),
+                   "nearest: %s (%g) before %s (%g)", ids[0], test_peer_cost(holos_p2p_peer_find(ids[0])), ids[1],
+                   test_peer_cost(holos_p2p_peer_find(ids[1])));
+    TEST_CHECK(t, holos_p2p_peer_nearest(ids + 1, 1) == 2 && ids[1] == ids[0], "nearest of 1 not the cheapest");
+
+    /* Offline, kept while within the TTL of 0 s, then dropped */
+    holos_p2p_peer_ttl(0);
+    holos_p2p_disconnect(TEST_PEER);
+    p = holos_p2p_peer_find(TEST_PEER);
+    TEST_CHECK(t, p && !p->online, "%s not kept offline", TEST_PEER);
+    TEST_CHECK(t, holos_p2p_peer_list(NULL, 0, 1) == 1 && holos_p2p_peer_list(NULL, 0, 0) == 2,
+               "%zu of %zu peers online", holos_p2p_peer_list(NULL, 0, 1), holos_p2p_peer_list(NULL, 0, 0));
+    TEST_CHECK(t, holos_p2p_peer_nearest(ids, 2) == 1 && strcmp(ids[0], TEST_PEER_OTHER) == 0,
+               "nearest: an offline peer");
+    gone = p ? p->last_seen : time(NULL);
+    while (time(NULL) <= gone) {
+        const struct timespec pause = {0, 10000000};
+        nanosleep(&pause, NULL);
+    }
+    TEST_CHECK(t, holos_p2p_peer_find(TEST_PEER) == NULL && holos_p2p_peer_list(NULL, 0, 0) == 1,
+               "%s found past its TTL", TEST_PEER);
+    TEST_CHECK(t, holos_p2p_peer_find(TEST_PEER_OTHER) != NULL, "an online peer dropped");
+    {
+        const struct timespec tick = {0, 1000000L * (TEST_TICK_MS + 10)};
+        holos_p2p_poll();
+        nanosleep(&tick, NULL);
+        holos_p2p_poll();
+    }
+    holos_p2p_peer_ttl(TEST_PEER_TTL);
+    TEST_CHECK(t, holos_p2p_peer_find(TEST_PEER) == NULL, "%s past its TTL not dropped on a tick", TEST_PEER);
+done:
+    holos_p2p_peer_ttl(TEST_PEER_TTL);
+    holos_p2p_free_peer(&one);
+    for (size_t i = 0; copies && i < n; i++) holos_p2p_free_peer(&copies[i]);
+    free(copies);
+    holos_p2p_finalize();
+#else
+    test_skip(t, "GNUnet build: no loopback links");
+#endif
+}
+
+/* ---------------- Metrics ---------------- */
+
+#ifndef HAVE_GNUNET
+#define TEST_STAT_MSGS 10
+#define TEST_STAT_SIZE 100
+#define TEST_STAT_BIG 16384             /* Payload of the messages that fill the link */
+#define TEST_RECORD_HEAD 8              /* P2P_RECORD_HEAD of p2p_link.h */
+
+/* Counters of the peer id, 0 if it has none */
+static int test_stat_peer(const char *id, struct holos_p2p_peer_stats *out) {
+    struct holos_p2p_peer_stats peers[16];
+    const size_t n = holos_p2p_stats_peers(peers, 16);
+    for (size_t i = 0; i < n && i < 16; i++)
+        if (strcmp(peers[i].id, id) == 0) {
+            *out = peers[i];
+            return 1;
+        }
+    return 0;
+}
+
+/* Counters of the record kind, zero if never seen */
+static void test_stat_kind(const char *name, struct holos_p2p_kind_stats *out) {
+    struct holos_p2p_kind_stats kinds[HOLOS_P2P_STATS_KINDS];
+    const size_t n = holos_p2p_stats_kinds(kinds, HOLOS_P2P_STATS_KINDS);
+    memset(out, 0, sizeof(*out));
+    for (size_t i = 0; i < n && i < HOLOS_P2P_STATS_KINDS; i++)
+        if (strcmp(kinds[i].name, name) == 0) *out = kinds[i];
+}
+
+/* What holos_p2p_stats_print or _dump writes, malloc'd (or NULL) */
+static char *test_stat_text(struct test *t, int json) {
+    FILE *f = fopen(test_path(t, json ? "stats.json" : "stats.txt"), "w+");
+    char *text = NULL;
+    long n;
+    if (!f) return NULL;
+    if (json) holos_p2p_stats_dump(f);
+    else holos_p2p_stats_print(f);
+    if ((n = ftell(f)) >= 0 && fseek(f, 0, SEEK_SET) == 0 && (text = malloc((size_t)n + 1))) {
+        if (fread(text, 1, (size_t)n, f) != (size_t)n) {
+            free(text);
+            text = NULL;
+        } else {
+            text[n] = '\0';
+        }
+    }
+    fclose(f);
+    return text;
+}
+#endif
+
+/*
+    Messages over the loopback link, counted once each way: as many
+    bytes, frames and records in as out, and the message kind with its
+    records and their bytes. The PING round trips of the peer table fill
+    their histogram, whose quantiles lie between its least and greatest
+    sample; on exact buckets, a quantile is the sample. A link filled
+    without a poll refuses records, counted as retries of the peer and
+    of the layer. Both outputs show the counters, and a reset zeroes
+    them.
+*/
+void test_p2p_stats(struct test *t) {
+#ifndef HAVE_GNUNET
+    static struct holos_p2p_histogram hist;
+    static unsigned char big[TEST_STAT_BIG];
+    unsigned char small[TEST_STAT_SIZE];
+    struct holos_p2p_peer_stats ps;
+    struct holos_p2p_kind_stats ks;
+    struct holos_p2p_message msg;
+    const struct holos_p2p_peer *p;
+    char *text = NULL, want[160];
+    uint64_t refused;
+    int rc = HOLOS_P2P_OK;
+    if (holos_p2p_init() != 0 || holos_p2p_connect(TEST_PEER) != HOLOS_P2P_OK) {
+        TEST_CHECK(t, 0, "no loopback link");
+        goto done;
+    }
+    holos_p2p_on_message(test_no_message, NULL);
+    holos_p2p_stats_reset();
+    TEST_CHECK(t, test_stat_peer(TEST_PEER, &ps) && ps.linked && ps.bytes_sent == 0 && ps.records_received == 0,
+               "%s not linked, or counted before the reset", TEST_PEER);
+    TEST_CHECK(t, holos_p2p_stats_kinds(NULL, 0) == 0, "%zu record kinds seen after the reset",
+               holos_p2p_stats_kinds(NULL, 0));
+
+    /* Each way once */
+    memset(small, 0x5a, sizeof(small));
+    memset(&msg, 0, sizeof(msg));
+    msg.type = HOLOS_P2P_MSG_DATA;
+    msg.payload = small;
+    msg.size = sizeof(small);
+    for (int i = 0; i < TEST_STAT_MSGS; i++)
+        TEST_CHECK(t, holos_p2p_send_message(TEST_PEER, &msg) == HOLOS_P2P_OK, "message %d not sent", i);
+    for (int i = 0; i < TEST_POLLS && holos_p2p_poll() > 0; i++) { }
+    test_stat_peer(TEST_PEER, &ps);
+    TEST_CHECK(t, ps.bytes_sent > 0 && ps.bytes_sent == ps.bytes_received && ps.frames_sent > 0 &&
+                      ps.frames_sent == ps.frames_received && ps.records_sent >= TEST_STAT_MSGS &&
+                      ps.records_sent == ps.records_received,
+               "out %llu bytes, %llu frames, %llu records; in %llu, %llu, %llu", (unsigned long long)ps.bytes_sent,
+               (unsigned long long)ps.frames_sent, (unsigned long long)ps.records_sent,
+               (unsigned long long)ps.bytes_received, (unsigned long long)ps.frames_received,
+               (unsigned long long)ps.records_received);
+    TEST_CHECK(t, ps.queued == 0 && ps.frames_queued == 0, "%zu bytes, %zu frames queued once drained", ps.queued,
+               ps.frames_queued);
+    test_stat_kind("message", &ks);
+    TEST_CHECK(t, ks.sent == TEST_STAT_MSGS && ks.received == TEST_STAT_MSGS && ks.bytes_sent == ks.bytes_received &&
+                      ks.bytes_sent >= TEST_STAT_MSGS * (TEST_RECORD_HEAD + TEST_STAT_SIZE),
+               "messages: %llu out, %llu in, %llu bytes out, %llu in", (unsigned long long)ks.sent,
+               (unsigned long long)ks.received, (unsigned long long)ks.bytes_sent,
+               (unsigned long long)ks.bytes_received);
+
+    /* Round trips of the PINGs, across ticks */
+    for (int i = 0; i < TEST_POLLS && !((p = holos_p2p_peer_find(TEST_PEER)) && p->latency_ms > 0); i++) {
+        const struct timespec pause = {0, 20000};
+        holos_p2p_poll();
+        nanosleep(&pause, NULL);
+    }
+    holos_p2p_stats_rtt(HOLOS_P2P_RTT_PING, &hist);
+    TEST_CHECK(t, hist.count > 0 && hist.min_us > 0 && hist.min_us <= hist.max_us &&
+                      hist.sum_us >= hist.count * hist.min_us && hist.sum_us <= hist.count * hist.max_us,
+               "%llu round trips, %llu to %llu us, %llu in all", (unsigned long long)hist.count,
+               (unsigned long long)hist.min_us, (unsigned long long)hist.max_us, (unsigned long long)hist.sum_us);
+    TEST_CHECK(t, holos_p2p_histogram_quantile(&hist, 0) == (double)hist.min_us &&
+                      holos_p2p_histogram_quantile(&hist, 1) == (double)hist.max_us &&
+                      holos_p2p_histogram_quantile(&hist, 0.5) >= (double)hist.min_us &&
+                      holos_p2p_histogram_quantile(&hist, 0.5) <= holos_p2p_histogram_quantile(&hist, 0.9) &&
+                      holos_p2p_histogram_quantile(&hist, 0.9) <= (double)hist.max_us,
+               "quantiles out of order or range");
+    test_stat_peer(TEST_PEER, &ps);
+    TEST_CHECK(t, p && ps.rtt_ms == p->latency_ms, "rtt %g ms, the peer table's %g", ps.rtt_ms,
+               p ? p->latency_ms : 0.0);
+    memset(&hist, 0, sizeof(hist));
+    hist.buckets[3] = hist.buckets[10] = 2;
+    hist.count = 4;
+    hist.min_us = 3;
+    hist.max_us = 10;
+    TEST_CHECK(t, holos_p2p_histogram_quantile(&hist, 0.5) == 3 && holos_p2p_histogram_quantile(&hist, 0.75) == 10,
+               "exact buckets: median %g, third quartile %g", holos_p2p_histogram_quantile(&hist, 0.5),
+               holos_p2p_histogram_quantile(&hist, 0.75));
+
+    /* Filled without a poll: refused, and counted */
+    refused = holos_p2p_stats_retries(HOLOS_P2P_RETRY_REFUSED);
+    msg.payload = big;
+    msg.size = sizeof(big);
+    for (int i = 0; i < TEST_POLLS && (rc = holos_p2p_send_message(TEST_PEER, &msg)) == HOLOS_P2P_OK; i++) { }
+    test_stat_peer(TEST_PEER, &ps);
+    TEST_CHECK(t, rc == HOLOS_P2P_ERR_AGAIN, "a full link: %d", rc);
+    TEST_CHECK(t, holos_p2p_stats_retries(HOLOS_P2P_RETRY_REFUSED) == refused + 1 && ps.refused == refused + 1,
+               "refusals: %llu of the layer, %llu of the peer, not %llu",
+               (unsigned long long)holos_p2p_stats_retries(HOLOS_P2P_RETRY_REFUSED), (unsigned long long)ps.refused,
+               (unsigned long long)refused + 1);
+    TEST_CHECK(t, ps.queued > 0, "nothing queued on a full link");
+    for (int i = 0; i < TEST_POLLS && holos_p2p_poll() > 0; i++) { }
+
+    /* The table and the JSON say the same */
+    test_stat_kind("message", &ks);
+    text = test_stat_text(t, 0);
+    snprintf(want, sizeof(want), "\n%-20s %12llu %12llu %9llu %9llu\n", "message",
+             (unsigned long long)ks.bytes_sent, (unsigned long long)ks.bytes_received, (unsigned long long)ks.sent,
+             (unsigned long long)ks.received);
+    TEST_CHECK(t, text && strstr(text, want), "no \"%s\" in the table", want + 1);
+    snprintf(want, sizeof(want), "\nretries: refused %llu ",
+             (unsigned long long)holos_p2p_stats_retries(HOLOS_P2P_RETRY_REFUSED));
+    TEST_CHECK(t, text && strstr(text, want) && strstr(text, "\n" TEST_PEER " "), "no retries or %s in: %s",
+               TEST_PEER, text ? text : "");
+    free(text);
+    text = test_stat_text(t, 1);
+    snprintf(want, sizeof(want), "\"message\":{\"sent\":%llu,\"received\":%llu,\"bytes_sent\":%llu,",
+             (unsigned long long)ks.sent, (unsigned long long)ks.received, (unsigned long long)ks.bytes_sent);
+    TEST_CHECK(t, text && strncmp(text, "{\"peers\":[", 10) == 0 && strstr(text, want) &&
+                      strstr(text, "{\"id\":\"" TEST_PEER "\",") && strlen(text) > 3 &&
+                      strcmp(text + strlen(text) - 3, "}}\n") == 0,
+               "JSON: %.200s", text ? text : "");
+    free(text);
+    text = NULL;
+
+    /* Zeroed */
+    holos_p2p_stats_reset();
+    holos_p2p_stats_rtt(HOLOS_P2P_RTT_PING, &hist);
+    test_stat_peer(TEST_PEER, &ps);
+    TEST_CHECK(t, holos_p2p_stats_kinds(NULL, 0) == 0 && hist.count == 0 && hist.max_us == 0 &&
+                      holos_p2p_stats_retries(HOLOS_P2P_RETRY_REFUSED) == 0 && ps.bytes_sent == 0 &&
+                      ps.refused == 0,
+               "counters left by the reset");
+done:
+    free(text);
+    holos_p2p_finalize();
+#else
+    test_skip(t, "GNUnet build: no loopback links");
+#endif
+}
+
+/* ---------------- Wire Format ---------------- */
+
+#ifndef HAVE_GNUNET
+/* What the view of the last message held, copied out of the callback */
+struct test_wire {
+    int got;
+    enum holos_p2p_message_type type;
+    holos_p2p_peer_id_t sender, receiver;
+    char peer[64];
+    unsigned char payload[2048];
+    size_t size;
+};
+
+static void test_on_wire(const struct holos_p2p_message_view *msg, void *cls) {
+    struct test_wire *w = cls;
+    w->type = msg->type;
+    w->sender = *msg->sender;
+    w->receiver = *msg->receiver;
+    snprintf(w->peer, sizeof(w->peer), "%s", msg->peer_id);
+    w->size = msg->size;
+    if (msg->size && msg->size <= sizeof(w->payload)) memcpy(w->payload, msg->payload, msg->size);
+    w->got = 1;
+}
+#endif
+
+/*
+    Peer IDs go to their binary identity and back. A message gathered
+    from pieces, one of them empty, must come back as their bytes with
+    this peer as sender and the link as receiver (all zero broadcast);
+    the pieces, size and peer are checked before anything is sent. With
+    no callback the message waits for holos_p2p_receive_message.
+*/
+void test_p2p_wire(struct test *t) {
+#ifndef HAVE_GNUNET
+    static const char name32[] = "0123456789abcdef0123456789abcdef";
+    struct holos_p2p_iovec iov[18];
+    struct holos_p2p_message msg;
+    struct test_wire w;
+    holos_p2p_peer_id_t id, self, zero;
+    unsigned char data[1000], *big = NULL;
+    char text[128], peer[128];
+
+    TEST_CHECK(t, holos_p2p_peer_id_parse(TEST_PEER, &id) == HOLOS_P2P_OK, "cannot parse %s", TEST_PEER);
+    TEST_CHECK(t, holos_p2p_peer_id_format(&id, text, sizeof(text)) == HOLOS_P2P_OK && strcmp(text, TEST_PEER) == 0,
+               "%s formatted back as %s", TEST_PEER, text);
+    TEST_CHECK(t, holos_p2p_peer_id_format(&id, text, strlen(TEST_PEER)) != HOLOS_P2P_OK,
+               "formatted into a buffer with no room for the terminator");
+    TEST_CHECK(t, holos_p2p_peer_id_parse(name32, &id) == HOLOS_P2P_OK &&
+                      holos_p2p_peer_id_format(&id, text, sizeof(text)) == HOLOS_P2P_OK && strcmp(text, name32) == 0,
+               "a name of %d bytes formatted back as %s", HOLOS_P2P_PEER_ID_SIZE, text);
+    TEST_CHECK(t, holos_p2p_peer_id_parse("", &id) != HOLOS_P2P_OK, "an empty peer ID parsed");
+    memset(text, 'x', HOLOS_P2P_PEER_ID_SIZE + 1);
+    text[HOLOS_P2P_PEER_ID_SIZE + 1] = '\0';
+    TEST_CHECK(t, holos_p2p_peer_id_parse(text, &id) != HOLOS_P2P_OK, "a peer ID of %d bytes parsed",
+               HOLOS_P2P_PEER_ID_SIZE + 1);
+
+    if (holos_p2p_init() != 0 || holos_p2p_connect(TEST_PEER) != HOLOS_P2P_OK) {
+        TEST_CHECK(t, 0, "no loopback link");
+        goto stop;
+    }
+    holos_p2p_self(&self);
+    TEST_CHECK(t, holos_p2p_peer_id_format(&self, text, sizeof(text)) == HOLOS_P2P_OK && strcmp(text, "local") == 0,
+               "this peer is %s", text);
+    memset(&zero, 0, sizeof(zero));
+    for (size_t i = 0; i < sizeof(data); i++) data[i] = (unsigned char)(i * 7 + 3);
+
+    /* Sent: "abc", nothing, 1000 bytes, "xyz" */
+    memset(&w, 0, sizeof(w));
+    holos_p2p_on_message(test_on_wire, &w);
+    iov[0] = (struct holos_p2p_iovec){"abc", 3};
+    iov[1] = (struct holos_p2p_iovec){NULL, 0};
+    iov[2] = (struct holos_p2p_iovec){data, sizeof(data)};
+    iov[3] = (struct holos_p2p_iovec){"xyz", 3};
+    TEST_CHECK(t, holos_p2p_send_messagev(TEST_PEER, HOLOS_P2P_MSG_STATUS, iov, 4) == HOLOS_P2P_OK, "not sent");
+    if (test_p2p_until(&w.got) != 0) {
+        TEST_CHECK(t, 0, "the message did not come back");
+        goto stop;
+    }
+    holos_p2p_peer_id_parse(TEST_PEER, &id);
+    TEST_CHECK(t, w.type == HOLOS_P2P_MSG_STATUS, "type %d", (int)w.type);
+    TEST_CHECK(t, w.size == 1006 && memcmp(w.payload, "abc", 3) == 0 &&
+                      memcmp(w.payload + 3, data, sizeof(data)) == 0 && memcmp(w.payload + 1003, "xyz", 3) == 0,
+               "payload of %zu bytes is not the pieces", w.size);
+    TEST_CHECK(t, memcmp(&w.sender, &self, sizeof(self)) == 0, "sender is not this peer");
+    TEST_CHECK(t, memcmp(&w.receiver, &id, sizeof(id)) == 0, "receiver is not %s", TEST_PEER);
+    TEST_CHECK(t, strcmp(w.peer, TEST_PEER) == 0, "came over the link %s", w.peer);
+
+    /* Broadcast, and a message of no pieces */
+    memset(&w, 0, sizeof(w));
+    TEST_CHECK(t, holos_p2p_broadcast_messagev(HOLOS_P2P_MSG_DATA, iov, 1) == HOLOS_P2P_OK, "not broadcast");
+    TEST_CHECK(t, test_p2p_until(&w.got) == 0 && w.size == 3 && memcmp(&w.receiver, &zero, sizeof(zero)) == 0,
+               "broadcast came back with %zu bytes, to a receiver", w.size);
+    memset(&w, 0, sizeof(w));
+    TEST_CHECK(t, holos_p2p_send_messagev(TEST_PEER, HOLOS_P2P_MSG_REQUEST, NULL, 0) == HOLOS_P2P_OK, "empty not sent");
+    TEST_CHECK(t, test_p2p_until(&w.got) == 0 && w.size == 0 && w.type == HOLOS_P2P_MSG_REQUEST,
+               "empty message came back with %zu bytes", w.size);
+
+    /* Refused before sending */
+    for (size_t i = 0; i < 18; i++) iov[i] = (struct holos_p2p_iovec){"p", 1};
+    TEST_CHECK(t, holos_p2p_send_messagev(TEST_PEER, HOLOS_P2P_MSG_DATA, iov, 16) == HOLOS_P2P_OK,
+               "16 pieces refused");
+    TEST_CHECK(t, holos_p2p_send_messagev(TEST_PEER, HOLOS_P2P_MSG_DATA, iov, 17) == HOLOS_P2P_ERR_GENERIC,
+               "17 pieces taken");
+    TEST_CHECK(t, holos_p2p_broadcast_messagev(HOLOS_P2P_MSG_DATA, iov, 17) == HOLOS_P2P_ERR_GENERIC,
+               "17 pieces broadcast");
+    iov[0] = (struct holos_p2p_iovec){NULL, 5};
+    TEST_CHECK(t, holos_p2p_send_messagev(TEST_PEER, HOLOS_P2P_MSG_DATA, iov, 1) == HOLOS_P2P_ERR_GENERIC,
+               "a NULL piece of 5 bytes taken");
+    if ((big = calloc(1, 64 * 1024))) {
+        iov[0] = (struct holos_p2p_iovec){big, 64 * 1024};
+        TEST_CHECK(t, holos_p2p_send_messagev(TEST_PEER, HOLOS_P2P_MSG_DATA, iov, 1) == HOLOS_P2P_ERR_GENERIC,
+                   "a message of 64 KiB taken");
+    }
+    iov[0] = (struct holos_p2p_iovec){"p", 1};
+    TEST_CHECK(t, holos_p2p_send_messagev("no-such-peer", HOLOS_P2P_MSG_DATA, iov, 1) == HOLOS_P2P_ERR_PEER_NOT_FOUND,
+               "sent to an unknown peer");
+    w.got = 0;
+    test_p2p_until(&w.got);                     /* The 16 pieces */
+
+    /* No callback: the inbox */
+    holos_p2p_on_message(NULL, NULL);
+    memset(&msg, 0, sizeof(msg));
+    msg.type = HOLOS_P2P_MSG_DATA;
+    msg.payload = data;
+    msg.size = sizeof(data);
+    TEST_CHECK(t, holos_p2p_send_message(TEST_PEER, &msg) == HOLOS_P2P_OK, "not sent to the inbox");
+    for (int i = 0; i < TEST_POLLS && holos_p2p_poll() > 0; i++) { }
+    memset(&msg, 0, sizeof(msg));
+    TEST_CHECK(t, holos_p2p_receive_message(peer, &msg) == HOLOS_P2P_OK, "nothing in the inbox");
+    TEST_CHECK(t, msg.size == sizeof(data) && msg.payload && memcmp(msg.payload, data, sizeof(data)) == 0 &&
+                      strcmp(peer, TEST_PEER) == 0,
+               "inbox held %zu bytes from %s", msg.size, peer);
+    holos_p2p_free_message(&msg);
+    TEST_CHECK(t, holos_p2p_receive_message(NULL, &msg) == HOLOS_P2P_ERR_AGAIN, "a second message in the inbox");
+stop:
+    holos_p2p_on_message(NULL, NULL);
+    holos_p2p_finalize();
+    free(big);
+#else
+    test_skip(t, "GNUnet build: no loopback links");
+#endif
+}
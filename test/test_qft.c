@@ -0,0 +1,265 @@
+/* test_qft.c - Tests of the lattice field theory of HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+   ----------------------------------------------------------------------
+   The phi^4 lattice must not depend on how its sweeps are split: every
+   draw is keyed by site and sweep and the sums are added by row, so any
+   thread count gives the serial field to the bit. Diagram topologies
+   must not depend on how a diagram is labelled, and their reductions
+   are made once and served from the cache.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "core/phys/fields/qft.h"
+#include "tests.h"
+
+/* ---------------- Lattice Monte Carlo ---------------- */
+
+static int test_lattice_run(qft_lattice_update_t update, int n_threads, size_t sweeps, double *phi, double *action,
+                            double *acceptance) {
+    const size_t L[2] = {8, 12};
+    qft_lattice_t *lat = qft_lattice_alloc(2, L);
+    if (!lat) return -1;
+    lat->mass2 = 0.5;
+    lat->lambda = 0.25;
+    lat->update = update;
+    lat->delta = 1.0;
+    lat->seed = 1234;
+    lat->n_threads = n_threads;
+    for (size_t s = 0; s < sweeps; s++)
+        if (qft_lattice_sweep(lat) != 0) {
+            qft_lattice_free(lat);
+            return -1;
+        }
+    memcpy(phi, lat->phi, lat->volume * sizeof(*phi));
+    *action = lat->action;
+    *acceptance = lat->n_proposed ? (double)lat->n_accepted / (double)lat->n_proposed : 0;
+    qft_lattice_free(lat);
+    return 0;
+}
+
+void test_lattice(struct test *t) {
+    static const char *names[] = {"Metropolis", "heat bath", "HMC"};
+    static const qft_lattice_update_t updates[] = {QFT_LATTICE_METROPOLIS, QFT_LATTICE_HEATBATH, QFT_LATTICE_HMC};
+    double serial[8 * 12], threaded[8 * 12];
+    for (int u = 0; u < 3; u++) {
+        double s0, s1, acc0, acc1;
+        if (test_lattice_run(updates[u], 0, 20, serial, &s0, &acc0) != 0 ||
+            test_lattice_run(updates[u], 4, 20, threaded, &s1, &acc1) != 0) {
+            TEST_CHECK(t, 0, "%s: sweeps failed", names[u]);
+            continue;
+        }
+        /* Draws are keyed by site and sweep, the sums added by row */
+        TEST_CHECK(t, memcmp(serial, threaded, sizeof(serial)) == 0, "%s: the field depends on the threads", names[u]);
+        TEST_CHECK(t, s0 == s1 && acc0 == acc1, "%s: action %.17g against %.17g", names[u], s0, s1);
+        TEST_CHECK(t, acc0 > 0.05 && acc0 <= 1.0, "%s: acceptance %g", names[u], acc0);
+        TEST_CHECK(t, isfinite(s0), "%s: action %g", names[u], s0);
+    }
+}
+
+/* ---------------- Diagram Topologies ---------------- */
+
+#define TEST_MAX_VERTICES 6
+#define TEST_MAX_LINES 12
+
+/* A diagram of stack objects: line e joins vertices u[e] and v[e] (both
+   the same for a tadpole), legs[i] external legs hang on vertex i; the
+   vertices are stored in the order perm gives, their fields reversed
+   when flip is set */
+struct test_graph {
+    qft_field_t lines[TEST_MAX_LINES + TEST_MAX_VERTICES * 2];
+    qft_field_t *slots[TEST_MAX_VERTICES][TEST_MAX_LINES];
+    qft_interaction_t vx[TEST_MAX_VERTICES];
+    qft_interaction_t *vp[TEST_MAX_VERTICES];
+    qft_feynman_diagram_t d;
+};
+
+static void test_graph_init(struct test_graph *g, size_t n, const size_t (*uv)[2], const double *masses, size_t ne,
+                            const size_t *legs, const size_t *perm, int flip, double coupling) {
+    size_t n_lines = ne;
+    memset(g, 0, sizeof(*g));
+    for (size_t i = 0; i < n; i++) {
+        g->vx[i].fields = g->slots[i];
+        g->vx[i].coupling = coupling * (double)(i + 1);
+        g->vp[perm ? perm[i] : i] = &g->vx[i];
+    }
+    for (size_t e = 0; e < ne; e++) {
+        g->lines[e].mass = masses[e];
+        g->vx[uv[e][0]].fields[g->vx[uv[e][0]].n_fields++] = &g->lines[e];
+        g->vx[uv[e][1]].fields[g->vx[uv[e][1]].n_fields++] = &g->lines[e];
+    }
+    for (size_t i = 0; i < n; i++)
+        for (size_t k = 0; k < legs[i]; k++) g->vx[i].fields[g->vx[i].n_fields++] = &g->lines[n_lines++];
+    if (flip)
+        for (size_t i = 0; i < n; i++)
+            for (size_t a = 0, b = g->vx[i].n_fields; a + 1 < b; a++, b--) {
+                qft_field_t *f = g->vx[i].fields[a];
+                g->vx[i].fields[a] = g->vx[i].fields[b - 1];
+                g->vx[i].fields[b - 1] = f;
+            }
+    g->d.n_vertices = n;
+    g->d.vertices = g->vp;
+}
+
+/* Coefficients from the topology and kinematics alone */
+static int test_reduce(const qft_topology_t *topo, const double *kin, size_t n_kin, double *coeffs, size_t n_coeffs,
+                       void *params) {
+    (void)params;
+    for (size_t c = 0; c < n_coeffs; c++) {
+        coeffs[c] = (double)(topo->n_edges + c * topo->n_vertices);
+        for (size_t k = 0; k < n_kin; k++) coeffs[c] += kin[k] * (double)(k + c + 1);
+    }
+    return 0;
+}
+
+static double test_master(const qft_topology_t *topo, const double *kin, size_t n_kin, const double *coeffs,
+                          size_t n_coeffs, double mu, void *params) {
+    (void)topo;
+    (void)kin;
+    (void)n_kin;
+    (void)params;
+    return coeffs[0] + coeffs[n_coeffs - 1] * log(mu);
+}
+
+/* The value the engine should give d: couplings times the master at the
+   coefficients of its own, uncached reduction */
+static double test_value(const qft_feynman_diagram_t *d, const double *inv, size_t n_inv, double mu) {
+    qft_topology_t *topo = qft_topology_alloc(d);
+    double kin[2 + TEST_MAX_LINES], coeffs[2], value = NAN;
+    if (!topo) return NAN;
+    memcpy(kin, inv, n_inv * sizeof(double));
+    memcpy(kin + n_inv, topo->masses, topo->n_edges * sizeof(double));
+    if (test_reduce(topo, kin, n_inv + topo->n_edges, coeffs, 2, NULL) == 0) {
+        value = test_master(topo, kin, n_inv + topo->n_edges, coeffs, 2, mu, NULL);
+        for (size_t v = 0; v < d->n_vertices; v++) value *= d->vertices[v]->coupling;
+    }
+    qft_topology_free(topo);
+    return value;
+}
+
+/*
+    Bubbles of lines of mass 1 and 2, relabelled and with their lines
+    swapped, must share a topology that another mass, a triangle, a
+    sunset and a tadpole do not; so must K3,3 relabelled, which colour
+    refinement alone cannot tell from the prism. Evaluations reduce once
+    per topology and kinematics, then serve scans over couplings and mu
+    from the cache, on any thread count, and from a saved cache.
+*/
+void test_qft_topology(struct test *t) {
+    static const size_t bubble[2][2] = {{0, 1}, {0, 1}}, triangle[3][2] = {{0, 1}, {1, 2}, {0, 2}};
+    static const size_t sunset[3][2] = {{0, 1}, {0, 1}, {0, 1}}, tadpole[1][2] = {{0, 0}};
+    static const size_t k33[9][2] = {{0, 3}, {0, 4}, {0, 5}, {1, 3}, {1, 4}, {1, 5}, {2, 3}, {2, 4}, {2, 5}};
+    static const size_t prism[9][2] = {{0, 1}, {1, 2}, {0, 2}, {3, 4}, {4, 5}, {3, 5}, {0, 3}, {1, 4}, {2, 5}};
+    static const double m12[3] = {1.0, 2.0, 3.0}, m21[2] = {2.0, 1.0}, m13[2] = {1.0, 3.0};
+    static const double ones[9] = {1, 1, 1, 1, 1, 1, 1, 1, 1};
+    static const size_t legs2[2] = {1, 1}, legs3[3] = {1, 1, 1}, legs1[1] = {2}, none[6] = {0};
+    static const size_t swap[2] = {1, 0}, scramble[6] = {4, 2, 5, 0, 3, 1};
+    const double inv[2] = {1.5, -0.25}, inv2[2] = {2.5, -0.25};
+    enum { A, A_RELABELLED, A_SWAPPED, A_MASS, TRIANGLE, SUNSET, TADPOLE, K33, K33_RELABELLED, PRISM, N_GRAPHS };
+    struct test_graph *g = calloc(N_GRAPHS, sizeof(*g));
+    qft_topology_t *topo[N_GRAPHS] = {NULL};
+    qft_feynman_diagram_t *batch[N_GRAPHS + 1];
+    qft_diagram_engine_t *eng = NULL, *par = NULL, *loaded = NULL;
+    double values[N_GRAPHS + 1], again[N_GRAPHS + 1], err = 0.0;
+    char path[4096];
+    int ok = 1;
+    snprintf(path, sizeof(path), "%s", test_path(t, "diagrams.fdc"));
+    if (!g) {
+        TEST_CHECK(t, 0, "out of memory");
+        return;
+    }
+    test_graph_init(&g[A], 2, bubble, m12, 2, legs2, NULL, 0, 0.5);
+    test_graph_init(&g[A_RELABELLED], 2, bubble, m12, 2, legs2, swap, 1, 0.5);
+    test_graph_init(&g[A_SWAPPED], 2, bubble, m21, 2, legs2, NULL, 0, 0.5);
+    test_graph_init(&g[A_MASS], 2, bubble, m13, 2, legs2, NULL, 0, 0.5);
+    test_graph_init(&g[TRIANGLE], 3, triangle, m12, 3, legs3, NULL, 0, 0.5);
+    test_graph_init(&g[SUNSET], 2, sunset, m12, 3, legs2, NULL, 0, 0.5);
+    test_graph_init(&g[TADPOLE], 1, tadpole, m12, 1, legs1, NULL, 0, 0.5);
+    test_graph_init(&g[K33], 6, k33, ones, 9, none, NULL, 0, 0.5);
+    test_graph_init(&g[K33_RELABELLED], 6, k33, ones, 9, none, scramble, 1, 0.5);
+    test_graph_init(&g[PRISM], 6, prism, ones, 9, none, NULL, 0, 0.5);
+    for (int i = 0; i < N_GRAPHS; i++) ok = ok && (topo[i] = qft_topology_alloc(&g[i].d)) != NULL;
+    TEST_CHECK(t, ok, "a topology not made");
+    if (!ok) goto done;
+    TEST_CHECK(t, qft_topology_equal(topo[A], topo[A_RELABELLED]) && qft_topology_equal(topo[A], topo[A_SWAPPED]),
+               "a bubble, relabelled or its lines swapped, is another topology");
+    TEST_CHECK(t, topo[A]->n_edges == 2 && topo[A]->masses[0] <= topo[A]->masses[1] && topo[TADPOLE]->n_edges == 1 &&
+                      topo[TADPOLE]->edges[0] == 0 && topo[TADPOLE]->edges[1] == 0 && topo[TADPOLE]->legs[0] == 2,
+               "lines or legs counted wrong");
+    for (int i = A_MASS; i <= TADPOLE; i++)
+        TEST_CHECK(t, !qft_topology_equal(topo[A], topo[i]), "graph %d the topology of the bubble", i);
+    TEST_CHECK(t, qft_topology_equal(topo[K33], topo[K33_RELABELLED]), "K3,3 relabelled is another topology");
+    TEST_CHECK(t, !qft_topology_equal(topo[K33], topo[PRISM]), "K3,3 the topology of the prism");
+
+    /* Every graph and the bubble again: 7 topologies, 7 reductions */
+    if (!(eng = qft_diagram_engine_alloc(test_reduce, test_master, 2, NULL)) ||
+        !(par = qft_diagram_engine_alloc(test_reduce, test_master, 2, NULL)) ||
+        !(loaded = qft_diagram_engine_alloc(test_reduce, test_master, 2, NULL))) {
+        TEST_CHECK(t, 0, "out of memory");
+        goto done;
+    }
+    for (int i = 0; i < N_GRAPHS; i++) batch[i] = &g[i].d;
+    batch[N_GRAPHS] = &g[A].d;
+    TEST_CHECK(t, qft_diagram_engine_evaluate(eng, batch, N_GRAPHS + 1, inv, 2, 3.0, values) == 0, "not evaluated");
+    TEST_CHECK(t, eng->n_reductions == 7 && eng->n_hits == 0, "%zu reductions, %zu hits", eng->n_reductions,
+               eng->n_hits);
+    for (int i = 0; i <= N_GRAPHS; i++) err = fmax(err, fabs(values[i] / test_value(batch[i], inv, 2, 3.0) - 1.0));
+    TEST_CHECK(t, err < 1e-12, "values off their own reductions by %g relative", err);
+
+    /* Couplings and mu scanned: no reduction; new invariants: 7 more */
+    for (int i = 0; i < N_GRAPHS; i++)
+        for (size_t v = 0; v < g[i].d.n_vertices; v++) g[i].vx[v].coupling *= 1.5;
+    TEST_CHECK(t, qft_diagram_engine_evaluate(eng, batch, N_GRAPHS + 1, inv, 2, 7.0, values) == 0 &&
+                      eng->n_reductions == 7 && eng->n_hits == N_GRAPHS + 1,
+               "a scan: %zu reductions, %zu hits", eng->n_reductions, eng->n_hits);
+    err = 0.0;
+    for (int i = 0; i <= N_GRAPHS; i++) err = fmax(err, fabs(values[i] / test_value(batch[i], inv, 2, 7.0) - 1.0));
+    TEST_CHECK(t, err < 1e-12, "scanned values off by %g relative", err);
+    TEST_CHECK(t, qft_diagram_engine_evaluate(eng, batch, N_GRAPHS + 1, inv2, 2, 7.0, again) == 0 &&
+                      eng->n_reductions == 14,
+               "other invariants: %zu reductions", eng->n_reductions);
+
+    /* On 4 threads, and from the saved cache: the same bits */
+    par->n_threads = 4;
+    TEST_CHECK(t, qft_diagram_engine_evaluate(par, batch, N_GRAPHS + 1, inv, 2, 7.0, again) == 0 &&
+                      memcmp(values, again, sizeof(values)) == 0,
+               "other values on 4 threads");
+    TEST_CHECK(t, qft_diagram_engine_save(eng, path) == 0 && qft_diagram_engine_load(loaded, path) == 0,
+               "cache not saved and loaded");
+    TEST_CHECK(t, qft_diagram_engine_evaluate(loaded, batch, N_GRAPHS + 1, inv, 2, 7.0, again) == 0 &&
+                      loaded->n_reductions == 0 && memcmp(values, again, sizeof(values)) == 0,
+               "from the saved cache: %zu reductions", loaded->n_reductions);
+
+    /* A line on three vertices */
+    g[TRIANGLE].vx[2].fields[0] = &g[TRIANGLE].lines[0];
+    TEST_CHECK(t, qft_topology_alloc(&g[TRIANGLE].d) == NULL && qft_diagram_engine_evaluate(eng, batch, 5, inv, 2, 1.0,
+                                                                                            values) != 0,
+               "a line on three vertices accepted");
+done:
+    for (int i = 0; i < N_GRAPHS; i++) qft_topology_free(topo[i]);
+    qft_diagram_engine_free(eng);
+    qft_diagram_engine_free(par);
+    qft_diagram_engine_free(loaded);
+    free(g);
+}
@@ -0,0 +1,1018 @@
+/* test_ss.c - Tests of the solid-state physics of HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+   ----------------------------------------------------------------------
+   Crystals simple enough to solve by hand: a simple cubic lattice with
+   springs along its bonds has the dispersion of three linear chains.
+   Neighbor lists are held to a search over every periodic image, and a
+   virtual supercell to the one it stands for, stored out. Relaxations
+   end at minima known by hand. The band engine solves a ring threaded
+   by a flux, whose bands are known in closed form, in full and in a
+   window of them. The SCF mixers must agree on the fixed point of a
+   contraction, and a run resumed from its checkpoint must end where an
+   uninterrupted one does. k-point wedges have the sizes their orbits
+   give, and tetrahedra fill bands whose filling or Fermi sphere is
+   known.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "core/phys/ss/phonons.h"
+#include "core/phys/ss/crystal_lattice.h"
+#include "core/phys/ss/band_structure.h"
+#include "tests.h"
+
+/* ---------------- Phonons ---------------- */
+
+/*
+    One atom of mass 1 u on a simple cubic lattice (a = 1 A) with springs
+    of 1 eV/A^2 to its six neighbors along the bonds only: D(q) is
+    diagonal, each axis a chain, omega_a^2 = 2 k (1 - cos q_a) / m, and
+    the velocity of mode a is d omega_a / dq along a alone.
+*/
+void test_phonons(struct test *t) {
+    static const double q[2][3] = {{0.3, 0.7, 1.1}, {-1.2, 0.2, 2.5}};
+    const double mass = 1.0, thz = 15.633302, kms = 0.62831853071795865;
+    double freq[2 * 3], vel[2 * 3 * 3], pfreq[2 * 3], pvel[2 * 3 * 3];
+    ph_engine_t *e = ph_engine_alloc(1, &mass);
+    if (!e) {
+        TEST_CHECK(t, 0, "out of memory");
+        return;
+    }
+    for (int a = 0; a < 3; a++) {
+        double r[3] = {0, 0, 0}, phi[9] = {0};
+        r[a] = 1.0;
+        phi[4 * a] = -1.0;
+        TEST_CHECK(t, ph_engine_add_pair(e, 0, 0, r, phi) == 0, "bond along %d", a);
+    }
+    TEST_CHECK(t, ph_engine_acoustic_sum_rule(e) == 0, "acoustic sum rule");
+    TEST_CHECK(t, ph_engine_solve(e, &q[0][0], 2, freq, vel) == 0, "solve");
+    for (size_t s = 0; s < 2; s++) {
+        double nu[3], v[3];
+        int order[3] = {0, 1, 2};
+        for (int a = 0; a < 3; a++) {
+            const double w2 = 2.0 * (1.0 - cos(q[s][a])) / mass;
+            nu[a] = thz * sqrt(w2);
+            v[a] = kms * thz * sin(q[s][a]) / (mass * sqrt(w2));
+        }
+        for (int i = 0; i < 3; i++)             /* Modes come by ascending frequency */
+            for (int j = i + 1; j < 3; j++)
+                if (nu[order[j]] < nu[order[i]]) {
+                    int x = order[i];
+                    order[i] = order[j];
+                    order[j] = x;
+                }
+        for (int m = 0; m < 3; m++) {
+            const int a = order[m];
+            TEST_CHECK(t, fabs(freq[3 * s + m] - nu[a]) < 1e-9 * nu[a], "q %zu mode %d: %.12g THz, not %.12g", s, m,
+                       freq[3 * s + m], nu[a]);
+            for (int x = 0; x < 3; x++) {
+                const double want = x == a ? v[a] : 0.0, got = vel[9 * s + 3 * m + x];
+                TEST_CHECK(t, fabs(got - want) < 1e-8 * (fabs(v[a]) + 1), "q %zu mode %d: v_%d = %.12g, not %.12g", s,
+                           m, x, got, want);
+            }
+        }
+    }
+    e->n_threads = 2;                           /* One q-point per thread, same bits */
+    TEST_CHECK(t, ph_engine_solve(e, &q[0][0], 2, pfreq, pvel) == 0, "solve on 2 threads");
+    TEST_CHECK(t, !memcmp(freq, pfreq, sizeof freq) && !memcmp(vel, pvel, sizeof vel),
+               "2 threads change the modes");
+    ph_engine_free(e);
+}
+
+/* ---------------- Neighbor Lists ---------------- */
+
+#define TEST_IMAGES 8                   /* Most images a key holds each way */
+
+static uint64_t g_nl_rand;
+
+/* Uniform in [0, 1) from g_nl_rand */
+static double test_nl_uniform(void) {
+    g_nl_rand ^= g_nl_rand << 13;
+    g_nl_rand ^= g_nl_rand >> 7;
+    g_nl_rand ^= g_nl_rand << 17;
+    return (double)(g_nl_rand >> 11) * 0.5 / (double)(1ull << 52);
+}
+
+/* Neighbor j of a row at cell shift im, as one sortable key */
+static uint64_t test_nl_key(size_t j, const int im[3]) {
+    const uint64_t k = 2 * TEST_IMAGES + 1;
+    return (((uint64_t)j * k + (uint64_t)(im[0] + TEST_IMAGES)) * k + (uint64_t)(im[1] + TEST_IMAGES)) * k +
+           (uint64_t)(im[2] + TEST_IMAGES);
+}
+
+static int test_nl_cmp(const void *a, const void *b) {
+    const uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+/*
+    Entries of nl wrong against every image within m cells: one twice,
+    one as far as far or with a bond vector that is not its own, and a
+    pair nearer than near missing (both with a rounding margin). keys
+    holds at least the longest row.
+*/
+static size_t test_nl_errors(const cl_neighbor_list_t *nl, const cl_geometry_t *geom, const cl_basis_t *basis,
+                             double near, double far, int m, uint64_t *keys) {
+    const size_t n = basis->n_atoms, dim = geom->dim;
+    size_t bad = nl->n_atoms != n;
+    for (size_t i = 0; i < n && !bad; i++) {
+        const size_t row = nl->offset[i + 1] - nl->offset[i];
+        for (size_t k = 0; k < row; k++) {
+            const size_t e = nl->offset[i] + k, j = nl->index[e];
+            const int *im = nl->image + 3 * e;
+            double r[3], d2 = 0.0, w2 = 0.0;
+            cl_neighbor_vector(nl, geom, basis, i, e, r);
+            for (size_t x = 0; x < 3; x++) {
+                double w = 0.0;
+                if (x < dim) {
+                    w = gsl_matrix_get(basis->positions, j, x) - gsl_matrix_get(basis->positions, i, x);
+                    for (size_t a = 0; a < dim; a++) w += im[a] * gsl_matrix_get(geom->vectors, a, x);
+                }
+                d2 += r[x] * r[x];
+                w2 += (r[x] - w) * (r[x] - w);
+            }
+            bad += sqrt(d2) > far + 1e-9 || w2 > 1e-20 || j >= n;
+            keys[k] = test_nl_key(j, im);
+        }
+        qsort(keys, row, sizeof(*keys), test_nl_cmp);
+        for (size_t k = 1; k < row; k++) bad += keys[k] == keys[k - 1];
+        for (size_t j = 0; j < n; j++)
+            for (int t0 = -m; t0 <= m; t0++)
+                for (int t1 = dim > 1 ? -m : 0; t1 <= (dim > 1 ? m : 0); t1++)
+                    for (int t2 = dim > 2 ? -m : 0; t2 <= (dim > 2 ? m : 0); t2++) {
+                        const int im[3] = {t0, t1, t2};
+                        double d2 = 0.0;
+                        uint64_t key;
+                        if (j == i && !t0 && !t1 && !t2) continue;
+                        for (size_t x = 0; x < dim; x++) {
+                            double d = gsl_matrix_get(basis->positions, j, x) - gsl_matrix_get(basis->positions, i, x);
+                            for (size_t a = 0; a < dim; a++) d += im[a] * gsl_matrix_get(geom->vectors, a, x);
+                            d2 += d * d;
+                        }
+                        if (sqrt(d2) >= near - 1e-9) continue;
+                        key = test_nl_key(j, im);
+                        bad += !bsearch(&key, keys, row, sizeof(*keys), test_nl_cmp);
+                    }
+    }
+    return bad;
+}
+
+/* n random atoms in the cell of rows A (dim x dim) */
+static int test_nl_cell(cl_geometry_t *geom, cl_basis_t *basis, size_t dim, const double *A, size_t n, uint64_t seed) {
+    memset(geom, 0, sizeof(*geom));
+    memset(basis, 0, sizeof(*basis));
+    geom->dim = dim;
+    geom->vectors = gsl_matrix_alloc(dim, dim);
+    basis->positions = gsl_matrix_alloc(n, dim);
+    basis->n_atoms = n;
+    if (!geom->vectors || !basis->positions) return -1;
+    for (size_t a = 0; a < dim; a++)
+        for (size_t x = 0; x < dim; x++) gsl_matrix_set(geom->vectors, a, x, A[a * dim + x]);
+    g_nl_rand = seed;
+    for (size_t i = 0; i < n; i++) {
+        double f[3];
+        for (size_t a = 0; a < dim; a++) f[a] = test_nl_uniform();
+        for (size_t x = 0; x < dim; x++) {
+            double r = 0.0;
+            for (size_t a = 0; a < dim; a++) r += f[a] * A[a * dim + x];
+            gsl_matrix_set(basis->positions, i, x, r);
+        }
+    }
+    return 0;
+}
+
+static void test_nl_cell_free(cl_geometry_t *geom, cl_basis_t *basis) {
+    if (geom->vectors) gsl_matrix_free(geom->vectors);
+    if (basis->positions) gsl_matrix_free(basis->positions);
+}
+
+/*
+    A triclinic cell of 300 atoms, a cell smaller than the range (so an
+    atom meets its own images), and a slab periodic in x and y only;
+    then moves under and over skin / 2, an atom that left the cell, a
+    small strain and 2000 atoms on 4 threads.
+*/
+void test_cl_neighbors(struct test *t) {
+    static const double tri[9] = {6.0, 0.0, 0.0, 1.5, 5.5, 0.0, -1.0, 0.8, 5.0};
+    static const double tiny[9] = {1.2, 0.0, 0.0, 0.3, 1.1, 0.0, 0.2, -0.1, 1.3};
+    static const double slab[4] = {5.0, 0.0, 2.0, 4.0};
+    static const struct {
+        const char *name;
+        size_t dim, n;
+        const double *A;
+        double cutoff, skin;
+        int images;                     /* Enough to reach the range, and a cell more */
+    } cases[] = {
+        {"triclinic", 3, 300, tri, 1.4, 0.3, 2},
+        {"small cell", 3, 3, tiny, 2.5, 0.2, 5},
+        {"slab", 2, 120, slab, 1.1, 0.2, 2},
+    };
+    uint64_t *keys = malloc(20000 * sizeof(*keys));
+    cl_neighbor_list_t *nl = NULL, *par = NULL;
+    cl_geometry_t geom;
+    cl_basis_t basis;
+    double range;
+    size_t bad;
+    memset(&geom, 0, sizeof(geom));
+    memset(&basis, 0, sizeof(basis));
+    TEST_CHECK(t, !cl_neighbor_list_alloc(0.0, 0.1) && !cl_neighbor_list_alloc(1.0, -0.1), "a list of no range");
+    if (!keys) {
+        TEST_CHECK(t, 0, "out of memory");
+        return;
+    }
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        if (test_nl_cell(&geom, &basis, cases[c].dim, cases[c].A, cases[c].n, 0x636c6e6cull + c) != 0 ||
+            !(nl = cl_neighbor_list_alloc(cases[c].cutoff, cases[c].skin))) {
+            TEST_CHECK(t, 0, "out of memory");
+            goto done;
+        }
+        range = cases[c].cutoff + cases[c].skin;
+        TEST_CHECK(t, cl_neighbor_list_build(nl, &geom, &basis) == 0, "%s: not built", cases[c].name);
+        bad = test_nl_errors(nl, &geom, &basis, range, range, cases[c].images, keys);
+        TEST_CHECK(t, bad == 0 && nl->offset[cases[c].n] > 0, "%s: %zu entries wrong of %zu", cases[c].name, bad,
+                   nl->offset[cases[c].n]);
+        if (c == 0) {
+            double shift[3];
+
+            /* Under skin / 2: kept, and all within the cutoff still there */
+            for (size_t i = 0; i < basis.n_atoms; i++)
+                for (size_t x = 0; x < 3; x++)
+                    *gsl_matrix_ptr(basis.positions, i, x) += 0.08 * (test_nl_uniform() - 0.5);
+            TEST_CHECK(t, cl_neighbor_list_update(nl, &geom, &basis) == 0, "triclinic: rebuilt under skin / 2");
+            bad = test_nl_errors(nl, &geom, &basis, nl->cutoff, nl->cutoff + 2.0 * nl->skin, 2, keys);
+            TEST_CHECK(t, bad == 0, "triclinic: %zu entries wrong after a small move", bad);
+
+            /* An atom a cell over: the same bonds, the images shifted */
+            for (size_t x = 0; x < 3; x++) {
+                shift[x] = gsl_matrix_get(geom.vectors, 1, x);
+                *gsl_matrix_ptr(basis.positions, 7, x) += shift[x];
+            }
+            TEST_CHECK(t, cl_neighbor_list_update(nl, &geom, &basis) == 1 && nl->n_builds == 2,
+                       "triclinic: not rebuilt for an atom a cell away");
+            bad = test_nl_errors(nl, &geom, &basis, range, range, cases[c].images, keys);
+            TEST_CHECK(t, bad == 0, "triclinic: %zu entries wrong with an atom out of the cell", bad);
+            for (size_t x = 0; x < 3; x++) *gsl_matrix_ptr(basis.positions, 7, x) -= shift[x];
+            cl_neighbor_list_build(nl, &geom, &basis);
+
+            /* A strain of 1e-3: kept; of 10 %: rebuilt */
+            *gsl_matrix_ptr(geom.vectors, 0, 0) *= 1.001;
+            TEST_CHECK(t, cl_neighbor_list_update(nl, &geom, &basis) == 0, "triclinic: rebuilt for a strain of 1e-3");
+            *gsl_matrix_ptr(geom.vectors, 0, 0) *= 1.1;
+            TEST_CHECK(t, cl_neighbor_list_update(nl, &geom, &basis) == 1, "triclinic: kept for a strain of 10 %%");
+            bad = test_nl_errors(nl, &geom, &basis, range, range, cases[c].images, keys);
+            TEST_CHECK(t, bad == 0, "triclinic: %zu entries wrong after the strain", bad);
+        }
+        cl_neighbor_list_free(nl);
+        nl = NULL;
+        test_nl_cell_free(&geom, &basis);
+        memset(&geom, 0, sizeof(geom));
+        memset(&basis, 0, sizeof(basis));
+    }
+
+    /* 2000 atoms, rows on threads: the same list */
+    {
+        static const double big[9] = {14.0, 0.0, 0.0, 2.0, 13.0, 0.0, 1.0, -1.5, 12.0};
+        if (test_nl_cell(&geom, &basis, 3, big, 2000, 0x706172ull) != 0 || !(nl = cl_neighbor_list_alloc(1.5, 0.3)) ||
+            !(par = cl_neighbor_list_alloc(1.5, 0.3))) {
+            TEST_CHECK(t, 0, "out of memory");
+            goto done;
+        }
+        par->n_threads = 4;
+        TEST_CHECK(t, cl_neighbor_list_build(nl, &geom, &basis) == 0 && cl_neighbor_list_build(par, &geom, &basis) == 0,
+                   "2000 atoms: not built");
+        TEST_CHECK(t, memcmp(nl->offset, par->offset, 2001 * sizeof(size_t)) == 0 &&
+                          memcmp(nl->index, par->index, nl->offset[2000] * sizeof(size_t)) == 0 &&
+                          memcmp(nl->image, par->image, 3 * nl->offset[2000] * sizeof(int)) == 0,
+                   "2000 atoms: another list on 4 threads");
+    }
+done:
+    cl_neighbor_list_free(nl);
+    cl_neighbor_list_free(par);
+    test_nl_cell_free(&geom, &basis);
+    free(keys);
+}
+
+/* ---------------- Supercells ---------------- */
+
+#define TEST_SC_CUTOFF 2.0
+#define TEST_SC_SKIN 0.4
+
+/* A screened pair term, species-dependent so substitutions show */
+static double test_sc_pair(int zi, int zj, double r, void *params) {
+    (void)params;
+    return (double)(zi * zj) * exp(-r) / r;
+}
+
+/* The pair energy of sc stored out: every pair of occupied atoms and
+   images of the supercell within the cutoff, from their positions */
+static double test_sc_energy(const cl_supercell_t *sc) {
+    double energy = 0.0;
+    for (size_t i = 0; i < sc->n_atoms; i++) {
+        double ri[3];
+        if (cl_supercell_vacant(sc, i)) continue;
+        cl_supercell_position(sc, i, ri);
+        for (size_t j = 0; j < sc->n_atoms; j++) {
+            double rj[3];
+            if (cl_supercell_vacant(sc, j)) continue;
+            cl_supercell_position(sc, j, rj);
+            for (int m = 0; m < 27; m++) {
+                const int im[3] = {m / 9 - 1, m / 3 % 3 - 1, m % 3 - 1};
+                double r2 = 0.0;
+                if (i == j && m == 13) continue;
+                for (size_t x = 0; x < 3; x++) {
+                    double d = rj[x] - ri[x];
+                    for (size_t a = 0; a < 3; a++) d += (double)(im[a] * (int)sc->n[a]) * sc->vectors[3 * a + x];
+                    r2 += d * d;
+                }
+                if (r2 <= TEST_SC_CUTOFF * TEST_SC_CUTOFF)
+                    energy += 0.5 * test_sc_pair(cl_supercell_species(sc, i), cl_supercell_species(sc, j), sqrt(r2),
+                                                 NULL);
+            }
+        }
+    }
+    return energy;
+}
+
+/* Rows of sc wrong: an entry whose bond is not a supercell translation
+   from one position to the other, or out of range, or a row of another
+   length than the atoms and images within range */
+static size_t test_sc_rows(const cl_supercell_t *sc, const cl_neighbor_list_t *nl) {
+    const double range = TEST_SC_CUTOFF + TEST_SC_SKIN;
+    size_t bad = 0;
+    for (size_t i = 0; i < sc->n_atoms; i++) {
+        const size_t n_row = cl_supercell_row(sc, nl, i);
+        size_t count = 0;
+        double ri[3];
+        cl_supercell_position(sc, i, ri);
+        for (size_t k = 0; k < n_row; k++) {
+            double r[3], rj[3], len = 0.0;
+            const size_t j = cl_supercell_neighbor(sc, nl, i, k, r);
+            int lattice = j < sc->n_atoms;
+            if (!lattice) {
+                bad++;
+                continue;
+            }
+            cl_supercell_position(sc, j, rj);
+            for (size_t x = 0; x < 3; x++) {
+                /* ri + r - rj in supercell steps of the diagonal cell */
+                const double s = (ri[x] + r[x] - rj[x]) / (sc->vectors[4 * x] * (double)sc->n[x]);
+                lattice = lattice && fabs(s - nearbyint(s)) < 1e-9;
+                len += r[x] * r[x];
+            }
+            bad += !lattice || sqrt(len) > range + 1e-9;
+        }
+        for (size_t j = 0; j < sc->n_atoms; j++) {
+            double rj[3];
+            cl_supercell_position(sc, j, rj);
+            for (int m = 0; m < 27; m++) {
+                double r2 = 0.0;
+                if (i == j && m == 13) continue;
+                for (size_t x = 0; x < 3; x++) {
+                    const int im = x == 0 ? m / 9 - 1 : x == 1 ? m / 3 % 3 - 1 : m % 3 - 1;
+                    const double d = rj[x] - ri[x] + (double)(im * (int)sc->n[x]) * sc->vectors[4 * x];
+                    r2 += d * d;
+                }
+                count += r2 <= range * range;
+            }
+        }
+        bad += count != n_row;
+    }
+    return bad;
+}
+
+/*
+    Four atoms in an orthorhombic cell, 3 x 2 x 2 times over: indices
+    split and rejoined, rows that are the bonds of the stored supercell,
+    and the pair energy against the sum over its pairs, perfect, then
+    with a displaced atom, a displaced and substituted neighbor of it and
+    a vacant one, then restored.
+*/
+void test_cl_supercell(struct test *t) {
+    static const double ortho[9] = {3.0, 0.0, 0.0, 0.0, 3.3, 0.0, 0.0, 0.0, 3.6};
+    static const double u[3] = {0.12, -0.08, 0.15};
+    int z[4] = {1, 2, 3, 4};
+    cl_geometry_t geom;
+    cl_basis_t basis;
+    cl_unit_cell_t cell;
+    cl_supercell_t *sc = NULL;
+    cl_neighbor_list_t *nl = NULL;
+    double energy, ref, r[3];
+    size_t b, c[3], near, vac, bad = 0;
+    memset(&cell, 0, sizeof(cell));
+    if (test_nl_cell(&geom, &basis, 3, ortho, 4, 0x7363ull) != 0 ||
+        !(nl = cl_neighbor_list_alloc(TEST_SC_CUTOFF, TEST_SC_SKIN))) {
+        TEST_CHECK(t, 0, "out of memory");
+        goto done;
+    }
+    basis.atomic_numbers = z;
+    cell.geometry = &geom;
+    cell.basis = &basis;
+    if (!(sc = cl_supercell_alloc(&cell, 3, 2, 2)) || cl_neighbor_list_build(nl, &geom, &basis) != 0) {
+        TEST_CHECK(t, 0, "no supercell");
+        goto done;
+    }
+    TEST_CHECK(t, sc->n_atoms == 48 && sc->n_cells == 12 && sc->n_sites == 0, "%zu atoms in %zu cells",
+               sc->n_atoms, sc->n_cells);
+    for (size_t a = 0; a < sc->n_atoms; a++) {
+        cl_supercell_split(sc, a, &b, c);
+        cl_supercell_position(sc, a, r);
+        bad += cl_supercell_atom(sc, b, c) != a || c[0] >= 3 || c[1] >= 2 || c[2] >= 2;
+        for (size_t x = 0; x < 3; x++)
+            bad += fabs(r[x] - gsl_matrix_get(basis.positions, b, x) - (double)c[x] * ortho[4 * x]) > 1e-12;
+        bad += cl_supercell_species(sc, a) != z[b];
+    }
+    TEST_CHECK(t, bad == 0, "%zu atoms split or placed wrong", bad);
+    bad = test_sc_rows(sc, nl);
+    TEST_CHECK(t, bad == 0 && nl->offset[4] > 0, "perfect: %zu rows wrong of %zu", bad, 48 / 4 * nl->offset[4]);
+    ref = test_sc_energy(sc);
+    TEST_CHECK(t, cl_supercell_pair_energy(sc, nl, test_sc_pair, NULL, &energy) == 0 &&
+                      fabs(energy - ref) < 1e-12 * fabs(ref),
+               "perfect: pair energy %.15g, not %.15g", energy, ref);
+
+    /* Defects, one of them two, at neighbors of atom 5 */
+    TEST_CHECK(t, cl_supercell_row(sc, nl, 5) >= 2, "atom 5 of %zu neighbors", cl_supercell_row(sc, nl, 5));
+    if (cl_supercell_row(sc, nl, 5) < 2) goto done;
+    near = cl_supercell_neighbor(sc, nl, 5, 0, r);
+    vac = cl_supercell_neighbor(sc, nl, 5, 1, r);
+    TEST_CHECK(t, cl_supercell_displace(sc, 5, u) == 0 && cl_supercell_displace(sc, near, u) == 0 &&
+                      cl_supercell_substitute(sc, near, 7, 14.0) == 0 && cl_supercell_vacate(sc, vac) == 0,
+               "defects refused");
+    TEST_CHECK(t, cl_supercell_site(sc, near) &&
+                      cl_supercell_site(sc, near)->flags == (CL_SITE_DISPLACED | CL_SITE_SUBSTITUTED) &&
+                      cl_supercell_species(sc, near) == 7 && cl_supercell_mass(sc, near) == 14.0 &&
+                      cl_supercell_vacant(sc, vac) && !cl_supercell_site(sc, 47),
+               "%zu perturbed sites", sc->n_sites);
+    bad = test_sc_rows(sc, nl);
+    TEST_CHECK(t, bad == 0, "with defects: %zu rows wrong", bad);
+    ref = test_sc_energy(sc);
+    TEST_CHECK(t, cl_supercell_pair_energy(sc, nl, test_sc_pair, NULL, &energy) == 0 &&
+                      fabs(energy - ref) < 1e-12 * fabs(ref),
+               "with defects: pair energy %.15g, not %.15g", energy, ref);
+    cl_supercell_restore(sc, 5);
+    cl_supercell_restore(sc, near);
+    cl_supercell_restore(sc, vac);
+    ref = test_sc_energy(sc);
+    TEST_CHECK(t, sc->n_sites == 0 && cl_supercell_pair_energy(sc, nl, test_sc_pair, NULL, &energy) == 0 &&
+                      fabs(energy - ref) < 1e-12 * fabs(ref),
+               "restored: %zu sites, pair energy %.15g, not %.15g", sc->n_sites, energy, ref);
+    TEST_CHECK(t, cl_supercell_vacate(sc, 48) != 0 && cl_supercell_substitute(sc, 0, 7, 0.0) != 0,
+               "an atom past the supercell, or of no mass");
+    TEST_CHECK(t, !cl_supercell_alloc(&cell, 3, 0, 2), "a supercell of no cells");
+done:
+    cl_supercell_free(sc);
+    cl_neighbor_list_free(nl);
+    basis.atomic_numbers = NULL;
+    test_nl_cell_free(&geom, &basis);
+}
+
+/* ---------------- Relaxation ---------------- */
+
+/* Lennard-Jones, epsilon = sigma = 1, between every pair of atoms in the
+   cell (no images): four of them end as a tetrahedron of edge 2^(1/6)
+   and energy -6 */
+static int test_lj_cluster(const cl_geometry_t *geom, const cl_basis_t *basis, const cl_neighbor_list_t *nl,
+                           double *energy, double *forces, double *stress, void *params) {
+    (void)geom;
+    (void)nl;
+    (void)stress;
+    (void)params;
+    *energy = 0.0;
+    for (size_t i = 0; i < basis->n_atoms; i++)
+        for (size_t j = i + 1; j < basis->n_atoms; j++) {
+            double r[3], r2 = 0.0;
+            for (size_t x = 0; x < 3; x++) {
+                r[x] = gsl_matrix_get(basis->positions, j, x) - gsl_matrix_get(basis->positions, i, x);
+                r2 += r[x] * r[x];
+            }
+            const double s6 = 1.0 / (r2 * r2 * r2), f = 24.0 * (2.0 * s6 * s6 - s6) / r2;
+            *energy += 4.0 * (s6 * s6 - s6);
+            for (size_t x = 0; x < 3; x++) {
+                forces[3 * i + x] -= f * r[x];
+                forces[3 * j + x] += f * r[x];
+            }
+        }
+    return 0;
+}
+
+/* Springs of 1 eV/A^2 on the lengths of the lattice vectors, rest length
+   1 A; the atoms feel nothing. stress = dE/d(strain) / V */
+static int test_cell_springs(const cl_geometry_t *geom, const cl_basis_t *basis, const cl_neighbor_list_t *nl,
+                             double *energy, double *forces, double *stress, void *params) {
+    const double V = cl_unit_cell_volume(geom);
+    (void)basis;
+    (void)nl;
+    (void)forces;
+    (void)params;
+    *energy = 0.0;
+    for (size_t k = 0; k < 3; k++) {
+        double a[3], l = 0.0;
+        for (size_t x = 0; x < 3; x++) {
+            a[x] = gsl_matrix_get(geom->vectors, k, x);
+            l += a[x] * a[x];
+        }
+        l = sqrt(l);
+        *energy += 0.5 * (l - 1.0) * (l - 1.0);
+        if (stress)
+            for (size_t x = 0; x < 3; x++)
+                for (size_t y = 0; y < 3; y++) stress[3 * x + y] += (l - 1.0) * a[x] * a[y] / (l * V);
+    }
+    return 0;
+}
+
+/*
+    A distorted tetrahedron of Lennard-Jones atoms relaxed by FIRE and by
+    L-BFGS: every edge at 2^(1/6), energy -6 and forces under tol, with
+    the counters and diagnostics of the run; L-BFGS in fewer calls. Then
+    an orthorhombic cell of springs on its vectors under pressure p: the
+    cube of edge l with l - 1 = -p l^2. Steps cut short return 1.
+*/
+void test_cl_relax(struct test *t) {
+    static const double start[12] = {0.0, 0.0, 0.0, 1.2, 0.1, 0.0, 0.5, 1.0, -0.1, 0.6, 0.4, 0.9};
+    static const double box[9] = {20.0, 0.0, 0.0, 0.0, 20.0, 0.0, 0.0, 0.0, 20.0};
+    static const double ortho[9] = {1.1, 0.0, 0.0, 0.0, 0.95, 0.0, 0.0, 0.0, 1.0};
+    static const char *names[] = {"FIRE", "L-BFGS"};
+    const double edge = pow(2.0, 1.0 / 6.0), p = 0.1, l = (sqrt(1.0 + 4.0 * p) - 1.0) / (2.0 * p);
+    size_t calls[2] = {0, 0};
+    cl_geometry_t geom;
+    cl_basis_t basis;
+    cl_unit_cell_t cell;
+    cl_system_t sys;
+    double err;
+    int rc;
+    memset(&cell, 0, sizeof(cell));
+    memset(&sys, 0, sizeof(sys));
+    if (test_nl_cell(&geom, &basis, 3, box, 4, 1) != 0) {
+        TEST_CHECK(t, 0, "out of memory");
+        goto done;
+    }
+    cell.geometry = &geom;
+    cell.basis = &basis;
+    sys.unit_cell = &cell;
+    for (int m = CL_RELAX_FIRE; m <= CL_RELAX_LBFGS; m++) {
+        for (size_t i = 0; i < 12; i++) gsl_matrix_set(basis.positions, i / 3, i % 3, start[i]);
+        if (!(sys.relax = cl_relax_alloc((cl_relax_method_t)m, test_lj_cluster, NULL))) {
+            TEST_CHECK(t, 0, "out of memory");
+            goto done;
+        }
+        rc = cl_step_relaxation(&sys, 1e-6, 2000);
+        err = 0.0;
+        for (size_t i = 0; i < 4; i++)
+            for (size_t j = i + 1; j < 4; j++) {
+                double r2 = 0.0;
+                for (size_t x = 0; x < 3; x++)
+                    r2 += pow(gsl_matrix_get(basis.positions, j, x) - gsl_matrix_get(basis.positions, i, x), 2);
+                err = fmax(err, fabs(sqrt(r2) - edge));
+            }
+        TEST_CHECK(t, rc == 0 && sys.relax->max_force < 1e-6, "%s: status %d, force %g after %zu steps", names[m], rc,
+                   sys.relax->max_force, sys.relax->n_iterations);
+        TEST_CHECK(t, err < 1e-6 && fabs(sys.relax->energy + 6.0) < 1e-10, "%s: edges off by %g, energy %.12g",
+                   names[m], err, sys.relax->energy);
+        TEST_CHECK(t, sys.diagnostics.n_force_calls == sys.relax->n_force_calls &&
+                          sys.relax->n_force_calls == sys.relax->n_iterations + 1 &&
+                          sys.diagnostics.energy == sys.relax->energy,
+                   "%s: %zu calls for %zu steps", names[m], sys.relax->n_force_calls, sys.relax->n_iterations);
+        calls[m] = sys.relax->n_force_calls;
+        for (size_t i = 0; i < 12; i++) gsl_matrix_set(basis.positions, i / 3, i % 3, start[i]);
+        TEST_CHECK(t, cl_step_relaxation(&sys, 1e-6, 3) == 1, "%s: converged in 3 steps", names[m]);
+        cl_relax_free(sys.relax);
+        sys.relax = NULL;
+    }
+    TEST_CHECK(t, calls[CL_RELAX_LBFGS] < calls[CL_RELAX_FIRE], "L-BFGS in %zu calls, FIRE in %zu",
+               calls[CL_RELAX_LBFGS], calls[CL_RELAX_FIRE]);
+
+    /* The cell under pressure */
+    for (int m = CL_RELAX_FIRE; m <= CL_RELAX_LBFGS; m++) {
+        for (size_t i = 0; i < 9; i++) gsl_matrix_set(geom.vectors, i / 3, i % 3, ortho[i]);
+        if (!(sys.relax = cl_relax_alloc((cl_relax_method_t)m, test_cell_springs, NULL))) {
+            TEST_CHECK(t, 0, "out of memory");
+            goto done;
+        }
+        sys.relax->variable_cell = 1;
+        sys.relax->pressure = p;
+        rc = cl_step_relaxation(&sys, 1e-8, 5000);
+        err = 0.0;
+        for (size_t i = 0; i < 9; i++)
+            err = fmax(err, fabs(gsl_matrix_get(geom.vectors, i / 3, i % 3) - (i % 4 == 0 ? l : 0.0)));
+        TEST_CHECK(t, rc == 0 && err < 1e-6, "%s, variable cell: status %d, cell off the cube of %.10g by %g",
+                   names[m], rc, l, err);
+        TEST_CHECK(t, fabs(sys.diagnostics.volume - l * l * l) < 1e-5, "%s, variable cell: volume %g, not %g",
+                   names[m], sys.diagnostics.volume, l * l * l);
+        cl_relax_free(sys.relax);
+        sys.relax = NULL;
+    }
+    TEST_CHECK(t, !cl_relax_alloc((cl_relax_method_t)2, test_lj_cluster, NULL) &&
+                      !cl_relax_alloc(CL_RELAX_FIRE, NULL, NULL),
+               "a relaxation of no method, or no model");
+done:
+    cl_relax_free(sys.relax);
+    test_nl_cell_free(&geom, &basis);
+}
+
+/* ---------------- Band Structure ---------------- */
+
+/* A ring of n sites, hopping -1, threaded by a flux k: the bond from the
+   last site to the first carries e^{ik}, and E_j = -2 cos((k + 2 pi j) / n) */
+static int test_ring(const double *k, size_t dim, double *h, size_t n, void *params) {
+    (void)dim;
+    (void)params;
+    for (size_t i = 0; i + 1 < n; i++) h[2 * ((i + 1) * n + i)] = -1.0;
+    h[2 * (n - 1) * n] += -cos(k[0]);
+    h[2 * (n - 1) * n + 1] += sin(k[0]);
+    return 0;
+}
+
+static int test_double_cmp(const void *a, const void *b) {
+    const double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+#define TEST_SITES 12
+#define TEST_KPOINTS 64
+
+/*
+    The ring over 64 fluxes, every band, then the three from the middle
+    of the spectrum: the energies against the closed form, ascending, and
+    on 4 threads the serial bits. A window past the last band is refused.
+*/
+void test_band_engine(struct test *t) {
+    double kvec[TEST_KPOINTS], e[TEST_SITES], *serial = NULL, err;
+    bs_kpoint_t *kpoints[TEST_KPOINTS];
+    bs_system_t sys;
+    bs_hamiltonian_t *ham = NULL;
+    int sorted;
+    memset(&sys, 0, sizeof(sys));
+    for (size_t i = 0; i < TEST_KPOINTS; i++) kvec[i] = 2.0 * M_PI * i / TEST_KPOINTS - M_PI;
+    if (bs_kpoint_batch_alloc(kpoints, TEST_KPOINTS, 1, kvec, NULL, NULL, NULL) != 0) {
+        TEST_CHECK(t, 0, "out of memory");
+        return;
+    }
+    sys.kpoints = kpoints;
+    sys.n_kpoints = TEST_KPOINTS;
+    if (!(ham = bs_hamiltonian_alloc(TEST_SITES, test_ring, NULL)) ||
+        !(serial = malloc(TEST_KPOINTS * TEST_SITES * sizeof(double)))) {
+        TEST_CHECK(t, 0, "out of memory");
+        goto done;
+    }
+    sys.hamiltonian = ham;
+    for (int pass = 0; pass < 2; pass++) {
+        ham->band_first = pass ? TEST_SITES / 2 - 1 : 0;
+        ham->n_bands = pass ? 3 : 0;
+        ham->n_threads = 0;
+        TEST_CHECK(t, bs_step_band_calculation(&sys) == 0, "window %zu + %zu: not solved", ham->band_first,
+                   ham->n_bands);
+        TEST_CHECK(t, ham->n_kpoints == TEST_KPOINTS && ham->n_kept == (pass ? 3 : TEST_SITES),
+                   "window %zu + %zu: %zu x %zu energies", ham->band_first, ham->n_bands, ham->n_kpoints,
+                   ham->n_kept);
+        if (ham->n_kpoints * ham->n_kept > TEST_KPOINTS * TEST_SITES) goto done;
+        err = 0.0;
+        sorted = 1;
+        for (size_t i = 0; i < TEST_KPOINTS; i++) {
+            const double *row = ham->energies + i * ham->n_kept;
+            for (size_t j = 0; j < TEST_SITES; j++) e[j] = -2.0 * cos((kvec[i] + 2.0 * M_PI * j) / TEST_SITES);
+            qsort(e, TEST_SITES, sizeof(double), test_double_cmp);
+            for (size_t b = 0; b < ham->n_kept; b++) {
+                err = fmax(err, fabs(row[b] - e[ham->band_first + b]));
+                if (b && row[b] < row[b - 1]) sorted = 0;
+            }
+        }
+        TEST_CHECK(t, err < 1e-12, "window %zu + %zu: energies off the closed form by %g", ham->band_first,
+                   ham->n_bands, err);
+        TEST_CHECK(t, sorted, "window %zu + %zu: bands out of order", ham->band_first, ham->n_bands);
+        memcpy(serial, ham->energies, ham->n_kpoints * ham->n_kept * sizeof(double));
+        ham->n_threads = 4;
+        TEST_CHECK(t, bs_step_band_calculation(&sys) == 0 &&
+                          memcmp(serial, ham->energies, ham->n_kpoints * ham->n_kept * sizeof(double)) == 0,
+                   "window %zu + %zu: other bits on 4 threads", ham->band_first, ham->n_bands);
+    }
+    TEST_CHECK(t, ham->n_solves == 4 * TEST_KPOINTS, "%zu diagonalizations, not %d", ham->n_solves,
+               4 * TEST_KPOINTS);
+    ham->band_first = TEST_SITES - 2;
+    ham->n_bands = 3;
+    TEST_CHECK(t, bs_step_band_calculation(&sys) != 0, "bands %zu to %zu of %d", ham->band_first,
+               ham->band_first + ham->n_bands, TEST_SITES);
+done:
+    bs_hamiltonian_free(ham);
+    bs_kpoint_batch_free(kpoints, TEST_KPOINTS);
+    free(serial);
+}
+
+/* A density of TEST_DENSITY values, the first TEST_BASIS of which shift
+   the sites of a chain; out = c + beta tanh(M in) + the mean of the
+   lowest band, a contraction with one fixed point */
+#define TEST_DENSITY 64
+#define TEST_BASIS 6
+
+struct test_scf {
+    const double *density;
+    double m[TEST_DENSITY * TEST_DENSITY], c[TEST_DENSITY];
+};
+
+static int test_scf_chain(const double *k, size_t dim, double *h, size_t n, void *params) {
+    const struct test_scf *w = params;
+    (void)dim;
+    for (size_t i = 0; i < n; i++) h[2 * (i * n + i)] = w->density[i] + k[0];
+    for (size_t i = 0; i + 1 < n; i++) h[2 * ((i + 1) * n + i)] = -1.0;
+    return 0;
+}
+
+static int test_scf_update(const double *energies, const double *weights, size_t n_kpoints, size_t n_bands,
+                           const double *in, double *out, size_t n, void *params) {
+    const struct test_scf *w = params;
+    double band = 0.0;
+    for (size_t i = 0; i < n_kpoints; i++) band += weights[i] * energies[i * n_bands];
+    for (size_t i = 0; i < n; i++) {
+        double s = 0.0;
+        for (size_t j = 0; j < n; j++) s += w->m[i * n + j] * in[j];
+        out[i] = w->c[i] + 0.95 * tanh(s) + 0.05 * band;
+    }
+    return 0;
+}
+
+/*
+    Every mixer, with and without Kerker's factor, from a zero density:
+    converged, to the same density, Pulay and Broyden in fewer iterations
+    than linear mixing. A run stopped after 7 iterations and resumed from
+    its checkpoint must end as an uninterrupted one, bit for bit.
+*/
+void test_bs_scf(struct test *t) {
+    static const char *names[] = {"linear", "Pulay", "Broyden"};
+    double kvec[4] = {0.0, 0.1, 0.2, 0.3}, x[TEST_DENSITY], first[TEST_DENSITY], ref[TEST_DENSITY];
+    double g2[TEST_DENSITY], diff;
+    size_t iters[3] = {0, 0, 0}, n_ref;
+    char ck[4096];
+    bs_kpoint_t *kpoints[4];
+    struct test_scf *w = malloc(sizeof(*w));
+    bs_hamiltonian_t *ham = NULL;
+    bs_system_t sys;
+    int rc;
+    memset(&sys, 0, sizeof(sys));
+    snprintf(ck, sizeof(ck), "%s", test_path(t, "scf.ck"));
+    if (!w || bs_kpoint_batch_alloc(kpoints, 4, 1, kvec, NULL, NULL, NULL) != 0) {
+        TEST_CHECK(t, 0, "out of memory");
+        free(w);
+        return;
+    }
+    for (size_t i = 0; i < TEST_DENSITY; i++) {
+        w->c[i] = sin((double)i);
+        g2[i] = 0.1 * (i + 1);          /* No G = 0 element, which Kerker leaves unmixed */
+        for (size_t j = 0; j < TEST_DENSITY; j++)
+            w->m[i * TEST_DENSITY + j] = (i == j ? -3.0 : 0.0) + 1.5 * cos(0.37 * i * j) / sqrt(TEST_DENSITY);
+    }
+    w->density = x;
+    sys.kpoints = kpoints;
+    sys.n_kpoints = 4;
+    if (!(ham = bs_hamiltonian_alloc(TEST_BASIS, test_scf_chain, w))) {
+        TEST_CHECK(t, 0, "out of memory");
+        goto done;
+    }
+    sys.hamiltonian = ham;
+    ham->update = test_scf_update;
+    ham->density = x;
+    ham->n_density = TEST_DENSITY;
+    ham->scf.alpha = 0.2;
+    for (int kerker = 0; kerker < 2; kerker++) {
+        for (int m = BS_MIX_LINEAR; m <= BS_MIX_BROYDEN; m++) {
+            memset(x, 0, sizeof(x));
+            ham->scf.method = (bs_mix_t)m;
+            ham->scf.kerker_q0 = kerker ? 0.5 : 0.0;
+            ham->scf.g2 = kerker ? g2 : NULL;
+            rc = bs_step_scf(&sys, 1e-10, 2000);
+            TEST_CHECK(t, rc == 0 && ham->scf_residual < 1e-10, "%s%s: residual %g after %zu iterations", names[m],
+                       kerker ? " with Kerker" : "", ham->scf_residual, ham->n_scf_iterations);
+            if (kerker == 0) iters[m] = ham->n_scf_iterations;
+            if (kerker == 0 && m == BS_MIX_LINEAR) memcpy(first, x, sizeof(x));
+            diff = 0.0;
+            for (size_t i = 0; i < TEST_DENSITY; i++) diff = fmax(diff, fabs(x[i] - first[i]));
+            TEST_CHECK(t, diff < 1e-8, "%s%s: %g off the linear density", names[m], kerker ? " with Kerker" : "",
+                       diff);
+        }
+    }
+    TEST_CHECK(t, iters[BS_MIX_PULAY] < iters[BS_MIX_LINEAR] && iters[BS_MIX_BROYDEN] < iters[BS_MIX_LINEAR],
+               "iterations: linear %zu, Pulay %zu, Broyden %zu", iters[0], iters[1], iters[2]);
+
+    /* Stopped and resumed: the uninterrupted run */
+    ham->scf.kerker_q0 = 0.0;
+    ham->scf.g2 = NULL;
+    ham->scf.history = 8;
+    for (int m = BS_MIX_PULAY; m <= BS_MIX_BROYDEN; m++) {
+        ham->scf.method = (bs_mix_t)m;
+        ham->scf.checkpoint = NULL;
+        ham->scf.restart = 0;
+        memset(x, 0, sizeof(x));
+        bs_step_scf(&sys, 1e-10, 2000);
+        memcpy(ref, x, sizeof(x));
+        n_ref = ham->n_scf_iterations;
+        remove(ck);
+        ham->scf.checkpoint = ck;
+        ham->scf.checkpoint_every = 3;
+        ham->scf.restart = 1;
+        memset(x, 0, sizeof(x));
+        TEST_CHECK(t, bs_step_scf(&sys, 1e-10, 7) == -1 && ham->n_scf_iterations == 7, "%s: not stopped at 7",
+                   names[m]);
+        for (size_t i = 0; i < TEST_DENSITY; i++) x[i] = 123.0;
+        rc = bs_step_scf(&sys, 1e-10, 2000);
+        TEST_CHECK(t, rc == 0 && ham->n_scf_iterations == n_ref && memcmp(x, ref, sizeof(x)) == 0,
+                   "%s: resumed in %zu iterations, not %zu, or elsewhere", names[m], ham->n_scf_iterations, n_ref);
+    }
+    ham->scf.checkpoint = NULL;
+    ham->scf.method = (bs_mix_t)7;
+    TEST_CHECK(t, bs_step_scf(&sys, 1e-10, 10) != 0, "an unknown mixer accepted");
+    remove(ck);
+done:
+    bs_hamiltonian_free(ham);
+    bs_kpoint_batch_free(kpoints, 4);
+    free(w);
+}
+
+/* Nearest-neighbor tight binding on the simple cubic lattice, hopping 1,
+   at fractional k */
+static double test_sc_band(const double *f) {
+    return -2.0 * (cos(2.0 * M_PI * f[0]) + cos(2.0 * M_PI * f[1]) + cos(2.0 * M_PI * f[2]));
+}
+
+/* Free electrons on the simple cubic lattice, a = 1: |k|^2 in the first
+   zone, at fractional k */
+static double test_free_band(const double *f) {
+    double best = HUGE_VAL;
+    for (int a = -1; a <= 1; a++)
+        for (int b = -1; b <= 1; b++)
+            for (int c = -1; c <= 1; c++) {
+                const double x = 2.0 * M_PI * (f[0] + a), y = 2.0 * M_PI * (f[1] + b), z = 2.0 * M_PI * (f[2] + c);
+                best = fmin(best, x * x + y * y + z * z);
+            }
+    return best;
+}
+
+/* A band that group (NULL: the identity) and time reversal leave as it
+   is: cosines of k . v, with v of the reciprocal lattice (so periodic),
+   summed over the rotated k */
+static double test_group_band(const bs_point_group_t *group, const double *f) {
+    static const double v[3] = {1.0, 2.0, 3.0};
+    const size_t n = group ? group->n_ops : 1;
+    double e = 0.0;
+    for (size_t o = 0; o < n; o++) {
+        double phase = 0.0;
+        for (size_t i = 0; i < 3; i++)
+            for (size_t j = 0; j < 3; j++)
+                phase += v[i] * (group ? group->rot[o][3 * i + j] : i == j) * f[j];
+        e += cos(2.0 * M_PI * phase);
+    }
+    return e;
+}
+
+/* The point group of the lattice of rows A (dim x dim), n_ops 0 on failure */
+static void test_point_group(size_t dim, const double *A, bs_point_group_t *group) {
+    cl_geometry_t geom;
+    memset(&geom, 0, sizeof(geom));
+    group->n_ops = 0;
+    geom.dim = dim;
+    if (!(geom.vectors = gsl_matrix_alloc(dim, dim))) return;
+    for (size_t i = 0; i < dim * dim; i++) gsl_matrix_set(geom.vectors, i / dim, i % dim, A[i]);
+    if (bs_point_group(&geom, 0.0, group) != 0) group->n_ops = 0;
+    gsl_matrix_free(geom.vectors);
+}
+
+/*
+    Holohedries of five lattices by their order, and irreducible wedges
+    of the sizes the orbit counts give (35 and 20 for 8^3 simple cubic,
+    (512 + 8) / 2 with time reversal alone), weights summing to 1 and a
+    band of the symmetry of the lattice unfolded to its value on the
+    full mesh. Tetrahedra: the
+    tight-binding band empty below -6, full above 6, half full at 0,
+    its DOS integrating to the IDOS; free electrons on 16^3 to a Fermi
+    sphere within a few percent of its energy and 1 % of its area.
+*/
+void test_bs_kmesh(struct test *t) {
+    static const double sc[9] = {1, 0, 0, 0, 1, 0, 0, 0, 1}, fcc[9] = {0, 0.5, 0.5, 0.5, 0, 0.5, 0.5, 0.5, 0};
+    static const double ortho[9] = {1, 0, 0, 0, 1.3, 0, 0, 0, 1.7}, tri[9] = {1, 0, 0, 0.3, 1.1, 0, 0.2, -0.1, 1.3};
+    static const double hex[4] = {1, 0, -0.5, 0.86602540378443865};
+    static const size_t n8[3] = {8, 8, 8}, n12[3] = {12, 12, 1}, n16[3] = {16, 16, 16}, none[3] = {8, 0, 8};
+    static const int gamma[3] = {0, 0, 0}, half[3] = {1, 1, 1};
+    bs_point_group_t oh, group;
+    bs_kmesh_t *mesh = NULL;
+    gsl_matrix *recip = NULL;
+    double *e = NULL, *full = NULL, err, sum, fermi, area, E[121], dos[121], idos[121];
+    const double kf = cbrt(3.0 * M_PI * M_PI * 0.1);    /* 0.1 electrons in a sphere of 2 per state */
+    static const struct {
+        const char *name;
+        size_t dim;
+        const double *A;
+        size_t n_ops;
+    } lattices[] = {
+        {"cubic", 3, sc, 48}, {"fcc", 3, fcc, 48}, {"orthorhombic", 3, ortho, 8}, {"triclinic", 3, tri, 2},
+        {"hexagonal", 2, hex, 12},
+    };
+    for (size_t l = 0; l < sizeof(lattices) / sizeof(lattices[0]); l++) {
+        test_point_group(lattices[l].dim, lattices[l].A, &group);
+        TEST_CHECK(t, group.n_ops == lattices[l].n_ops, "%s: %zu operations, not %zu", lattices[l].name, group.n_ops,
+                   lattices[l].n_ops);
+    }
+    test_point_group(3, sc, &oh);
+
+    /* Wedges, and what unfolds from them */
+    static const struct {
+        const char *name;
+        size_t dim;
+        const size_t *n;
+        const int *shift;
+        const double *A;                /* NULL for time reversal alone */
+        size_t n_irr;
+    } meshes[] = {
+        {"cubic 8^3", 3, n8, gamma, sc, 35}, {"cubic 8^3 shifted", 3, n8, half, sc, 20},
+        {"fcc 8^3", 3, n8, gamma, fcc, 29}, {"hexagonal 12^2", 2, n12, gamma, hex, 19},
+        {"8^3 without symmetry", 3, n8, gamma, NULL, 260},
+    };
+    for (size_t c = 0; c < sizeof(meshes) / sizeof(meshes[0]); c++) {
+        if (meshes[c].A) test_point_group(meshes[c].dim, meshes[c].A, &group);
+        mesh = bs_kmesh_alloc(meshes[c].dim, meshes[c].n, meshes[c].shift, meshes[c].A ? &group : NULL);
+        if (!mesh || !(e = malloc(mesh->n_irr * sizeof(double))) || !(full = malloc(mesh->n_full * sizeof(double)))) {
+            TEST_CHECK(t, 0, "%s: no mesh", meshes[c].name);
+            goto done;
+        }
+        TEST_CHECK(t, mesh->n_irr == meshes[c].n_irr, "%s: %zu irreducible points, not %zu", meshes[c].name,
+                   mesh->n_irr, meshes[c].n_irr);
+        sum = 0.0;
+        for (size_t r = 0; r < mesh->n_irr; r++) {
+            double k[3];
+            sum += mesh->weight[r];
+            e[r] = test_group_band(meshes[c].A ? &group : NULL, mesh->k + 3 * r);
+            bs_kmesh_point(mesh, mesh->full[r], k);
+            TEST_CHECK(t, mesh->irr[mesh->full[r]] == r && memcmp(k, mesh->k + 3 * r, sizeof(k)) == 0,
+                       "%s: representative %zu not its own", meshes[c].name, r);
+        }
+        TEST_CHECK(t, fabs(sum - 1.0) < 1e-12, "%s: weights summing to %.15g", meshes[c].name, sum);
+        err = bs_kmesh_unfold(mesh, e, 1, full) == 0 ? 0.0 : HUGE_VAL;
+        for (size_t i = 0; i < mesh->n_full; i++) {
+            double k[3];
+            bs_kmesh_point(mesh, i, k);
+            err = fmax(err, fabs(full[i] - test_group_band(meshes[c].A ? &group : NULL, k)));
+        }
+        TEST_CHECK(t, err < 1e-12, "%s: unfolded bands off by %g", meshes[c].name, err);
+        bs_kmesh_free(mesh);
+        mesh = NULL;
+        free(e);
+        free(full);
+        e = full = NULL;
+    }
+    TEST_CHECK(t, bs_kmesh_alloc(0, n8, gamma, NULL) == NULL && bs_kmesh_alloc(3, none, gamma, NULL) == NULL,
+               "a mesh of no points");
+
+    /* Tetrahedra over the tight-binding band */
+    if (!(mesh = bs_kmesh_alloc(3, n16, gamma, &oh)) || !(e = malloc(mesh->n_irr * sizeof(double))) ||
+        !(recip = gsl_matrix_alloc(3, 3))) {
+        TEST_CHECK(t, 0, "out of memory");
+        goto done;
+    }
+    for (size_t r = 0; r < mesh->n_irr; r++) e[r] = test_sc_band(mesh->k + 3 * r);
+    for (int i = 0; i <= 120; i++) E[i] = -6.6 + 0.11 * i;
+    TEST_CHECK(t, bs_tetra_dos(mesh, NULL, e, 1, 2.0, E, 121, dos, idos) == 0, "no DOS");
+    TEST_CHECK(t, idos[0] == 0.0 && fabs(idos[60] - 1.0) < 1e-12 && fabs(idos[120] - 2.0) < 1e-12,
+               "IDOS %g, %g, %g at -6.6, 0 and 6.6", idos[0], idos[60], idos[120]);
+    err = 0.0;
+    sum = 0.0;
+    for (int i = 1; i <= 120; i++) {
+        sum += 0.5 * 0.11 * (dos[i - 1] + dos[i]);
+        err = fmax(err, fabs(sum - idos[i]));
+    }
+    TEST_CHECK(t, err < 0.02, "the DOS integrates %g off the IDOS", err);
+    TEST_CHECK(t, bs_tetra_fermi(mesh, e, 1, 2.0, 1.0, &fermi) == 0 && fabs(fermi) < 1e-9,
+               "Fermi energy %g at half filling", fermi);
+    TEST_CHECK(t, bs_tetra_fermi(mesh, e, 1, 2.0, 2.5, &fermi) != 0, "2.5 electrons in a band of 2");
+
+    /* A Fermi sphere */
+    for (size_t r = 0; r < mesh->n_irr; r++) e[r] = test_free_band(mesh->k + 3 * r);
+    for (size_t i = 0; i < 9; i++) gsl_matrix_set(recip, i / 3, i % 3, 2.0 * M_PI * sc[i]);
+    TEST_CHECK(t, bs_tetra_fermi(mesh, e, 1, 2.0, 0.1, &fermi) == 0 && fabs(fermi - kf * kf) < 0.05 * kf * kf,
+               "Fermi energy %g of free electrons, not %g", fermi, kf * kf);
+    area = bs_tetra_fermi_area(mesh, recip, e, 1, fermi);
+    TEST_CHECK(t, fabs(area - 4.0 * M_PI * kf * kf) < 0.01 * 4.0 * M_PI * kf * kf, "Fermi area %g, not %g", area,
+               4.0 * M_PI * kf * kf);
+    TEST_CHECK(t, bs_tetra_fermi_area(mesh, NULL, e, 1, fermi) < 0.0, "an area without reciprocal vectors");
+done:
+    bs_kmesh_free(mesh);
+    if (recip) gsl_matrix_free(recip);
+    free(e);
+    free(full);
+}
@@ -0,0 +1,353 @@
+/* test_tech.c - Tests of the technology catalogs of HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+   ----------------------------------------------------------------------
+   A catalog is filled from technologies built on the stack, numbered so
+   that the category, lifecycle stage and tags of technology i follow
+   from i, and held to them after the stack copies are changed. Index
+   finds and queries are held to a scan of the catalog. Columnar
+   snapshots are held to the same scan, and to what they were when taken
+   once the catalog changes.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "core/tech/tech.h"
+#include "tests.h"
+
+/* ---------------- Catalogs ---------------- */
+
+#define TEST_TECHS 3000                     /* Over one 64 KiB block of the arena */
+
+static const char *test_categories[4] = {"energy", "bio", "AI", "materials"};
+static const char *test_stages[3] = {"R&D", "pilot", "deployment"};
+static char *test_tags[5] = {"solar", "storage", "grid", "fusion", "carbon"};
+static char *test_certs[2] = {"ISO 9001", "CE"};
+
+/* Technology i: category i % 4, stage i % 3, tags i % 5 and (i + 1) % 5,
+   certification i % 2 when i is a multiple of 7 */
+static void test_tech(struct holos_technology *tech, int i, char *name, size_t size, char **tags) {
+    memset(tech, 0, sizeof(*tech));
+    snprintf(name, size, "tech%d", i);
+    tech->name = name;
+    tech->description = "catalog test";
+    tech->category = (char *)test_categories[i % 4];
+    tech->lifecycle_stage = (char *)test_stages[i % 3];
+    tech->trl = 1 + i % 9;
+    tech->efficiency = 0.01 * (i % 100);
+    tech->cost = 10.0 * i;
+    tags[0] = test_tags[i % 5];
+    tags[1] = test_tags[(i + 1) % 5];
+    tech->tags = tags;
+    tech->n_tags = 2;
+    if (i % 7 == 0) {
+        tech->regulatory_certifications = &test_certs[i % 2];
+        tech->n_certifications = 1;
+    }
+}
+
+static struct holos_tech_catalog *test_catalog(struct test *t, int n) {
+    struct holos_tech_catalog *cat = holos_tech_catalog_new();
+    struct holos_technology tech;
+    char name[32], *tags[2];
+    TEST_CHECK(t, cat != NULL, "cannot make a catalog");
+    for (int i = 0; cat && i < n; i++) {
+        test_tech(&tech, i, name, sizeof(name), tags);
+        if (!holos_tech_catalog_add(cat, &tech)) {
+            TEST_CHECK(t, 0, "cannot add technology %d", i);
+            break;
+        }
+    }
+    return cat;
+}
+
+void test_tech_catalog(struct test *t) {
+    struct holos_tech_catalog *cat = test_catalog(t, TEST_TECHS);
+    struct holos_technology tech, *a, *b, *old;
+    char name[32], *tags[2];
+    size_t bytes;
+    int ok = 1;
+    if (!cat) return;
+    TEST_CHECK(t, holos_tech_catalog_count(cat) == TEST_TECHS, "%zu technologies", holos_tech_catalog_count(cat));
+
+    /* Copies of the stack technologies, with IDs made for them */
+    for (int i = 0; i < TEST_TECHS && ok; i++) {
+        a = holos_tech_catalog_get(cat, (size_t)i);
+        snprintf(name, sizeof(name), "tech%d", i);
+        ok = a && a->name != name && strcmp(a->name, name) == 0 && a->trl == 1 + i % 9 && a->cost == 10.0 * i &&
+             a->n_tags == 2 && strcmp(a->tags[1], test_tags[(i + 1) % 5]) == 0 && a->id && *a->id;
+        TEST_CHECK(t, ok, "technology %d is not the one added", i);
+    }
+    a = holos_tech_catalog_get(cat, 0);
+    b = holos_tech_catalog_get(cat, 1);
+    TEST_CHECK(t, a && b && strcmp(a->id, b->id) != 0, "two technologies share an ID");
+    TEST_CHECK(t, holos_tech_catalog_get(cat, TEST_TECHS) == NULL, "technology past the end");
+
+    /* Equal strings are one interned pointer, numbered from 1 */
+    a = holos_tech_catalog_get(cat, 4);
+    b = holos_tech_catalog_get(cat, 2004);
+    TEST_CHECK(t, a && b && a->category == b->category && a->tags[0] == b->tags[0] && a->name != b->name,
+               "equal strings not interned once");
+    TEST_CHECK(t, holos_tech_string_count(cat) == 4 + 3 + 5 + 2, "%u interned strings",
+               holos_tech_string_count(cat));
+    for (uint32_t id = 1; id <= holos_tech_string_count(cat); id++)
+        TEST_CHECK(t, holos_tech_string_id(cat, holos_tech_string(cat, id)) == id, "string %u", id);
+    TEST_CHECK(t, holos_tech_string_id(cat, "absent") == 0 && holos_tech_string(cat, 0) == NULL &&
+                      holos_tech_intern(cat, NULL) == 0,
+               "absent strings numbered");
+    TEST_CHECK(t, holos_tech_intern(cat, "fresh") == 15 && holos_tech_intern(cat, "fresh") == 15,
+               "new string not numbered next, once");
+
+    /* A set copies anew: the technology it was stays readable */
+    old = holos_tech_catalog_get(cat, 10);
+    test_tech(&tech, 11, name, sizeof(name), tags);
+    tech.id = "replaced";
+    a = holos_tech_catalog_set(cat, 10, &tech);
+    name[0] = 'X';
+    tags[0] = "changed";
+    TEST_CHECK(t, a && holos_tech_catalog_get(cat, 10) == a && strcmp(a->name, "tech11") == 0 &&
+                      strcmp(a->id, "replaced") == 0 && strcmp(a->tags[0], test_tags[1]) == 0,
+               "set technology is not a copy");
+    TEST_CHECK(t, old && strcmp(old->name, "tech10") == 0 && old->trl == 2, "replaced technology overwritten");
+    TEST_CHECK(t, holos_tech_catalog_set(cat, TEST_TECHS, &tech) == NULL, "set past the end");
+
+    /* The arena grows by blocks, not by technologies */
+    bytes = holos_tech_catalog_memory(cat);
+    TEST_CHECK(t, bytes > TEST_TECHS * sizeof(struct holos_technology) && bytes < 4 * (1u << 20),
+               "%zu bytes for %d technologies", bytes, TEST_TECHS);
+    holos_tech_catalog_free(cat);
+
+    /* A batch is a catalog of its own */
+    {
+        const char *names[3] = {"a", "b", "c"}, *cats[3] = {"energy", "energy", "bio"};
+        struct holos_technology **batch = holos_tech_batch_create(names, NULL, cats, NULL, NULL, 3);
+        TEST_CHECK(t, batch && strcmp(batch[2]->name, "c") == 0 && batch[0]->category == batch[1]->category,
+                   "batch technologies");
+        TEST_CHECK(t, !batch || holos_tech_find_by_category(batch, 3, "bio") == batch[2], "bio not found in the batch");
+        holos_tech_batch_free(batch, 3);
+    }
+}
+
+/* ---------------- Indexes ---------------- */
+
+static int test_has(const struct holos_technology *tech, enum holos_tech_key key, const char *value) {
+    char **list = key == HOLOS_TECH_TAG ? tech->tags : tech->regulatory_certifications;
+    const int n = key == HOLOS_TECH_TAG ? tech->n_tags : tech->n_certifications;
+    if (key == HOLOS_TECH_CATEGORY) return tech->category && strcmp(tech->category, value) == 0;
+    if (key == HOLOS_TECH_LIFECYCLE) return tech->lifecycle_stage && strcmp(tech->lifecycle_stage, value) == 0;
+    for (int i = 0; i < n; i++)
+        if (list[i] && strcmp(list[i], value) == 0) return 1;
+    return 0;
+}
+
+/* The query answered by a scan of the catalog, against the index */
+static void test_query(struct test *t, const struct holos_tech_catalog *cat, const struct holos_tech_index *index,
+                       const struct holos_tech_term *terms, size_t n, int any) {
+    static struct holos_technology *out[TEST_TECHS + 1];
+    size_t want = 0;
+    long got = holos_tech_index_query(index, terms, n, any, out, TEST_TECHS + 1);
+    int order = 1;
+    for (size_t i = 0; i < holos_tech_catalog_count(cat); i++) {
+        const struct holos_technology *tech = holos_tech_catalog_get(cat, i);
+        int hit = !any;
+        for (size_t k = 0; k < n; k++)
+            hit = any ? hit || test_has(tech, terms[k].key, terms[k].value)
+                      : hit && test_has(tech, terms[k].key, terms[k].value);
+        if (hit && (want >= (size_t)(got > 0 ? got : 0) || out[want++] != tech)) order = 0;
+    }
+    TEST_CHECK(t, got == (long)want && order, "query of %zu terms (%s, first %s): %ld found, %zu in the catalog%s", n,
+               any ? "any" : "all", terms[0].value, got, want, order ? "" : ", out of order");
+}
+
+void test_tech_index(struct test *t) {
+    static struct holos_technology *out[TEST_TECHS];
+    struct holos_tech_catalog *cat = test_catalog(t, TEST_TECHS);
+    struct holos_tech_index *index = cat ? holos_tech_index_new(cat) : NULL;
+    const struct holos_tech_term all[3] = {{HOLOS_TECH_CATEGORY, "energy"}, {HOLOS_TECH_TAG, "solar"},
+                                           {HOLOS_TECH_LIFECYCLE, "pilot"}};
+    const struct holos_tech_term none[2] = {{HOLOS_TECH_TAG, "solar"}, {HOLOS_TECH_TAG, "absent"}};
+    const struct holos_tech_term cert[2] = {{HOLOS_TECH_CERTIFICATION, "CE"}, {HOLOS_TECH_TAG, "fusion"}};
+    struct holos_tech_term many[HOLOS_TECH_QUERY_MAX + 1];
+    struct holos_technology tech;
+    char name[32], *tags[2];
+    long n;
+    TEST_CHECK(t, index != NULL, "cannot index the catalog");
+    if (!index) goto out;
+
+    /* Tag solar is tag 0 of i % 5 == 0 and tag 1 of i % 5 == 4 */
+    n = holos_tech_index_find(index, HOLOS_TECH_TAG, "solar", out, TEST_TECHS);
+    TEST_CHECK(t, n == 2 * TEST_TECHS / 5, "%ld technologies tagged solar", n);
+    for (long i = 1; i < n && i < TEST_TECHS; i++)
+        TEST_CHECK(t, strcmp(out[i]->name, out[i - 1]->name) != 0 && test_has(out[i], HOLOS_TECH_TAG, "solar"),
+                   "match %ld of solar", i);
+    TEST_CHECK(t, holos_tech_index_find(index, HOLOS_TECH_CATEGORY, "bio", NULL, 0) == TEST_TECHS / 4 &&
+                      holos_tech_index_find(index, HOLOS_TECH_CATEGORY, "bio", out, 3) == TEST_TECHS / 4 &&
+                      out[0] == holos_tech_catalog_get(cat, 1) && out[2] == holos_tech_catalog_get(cat, 9),
+               "a find past max does not count every match");
+    TEST_CHECK(t, holos_tech_index_find(index, HOLOS_TECH_TAG, "absent", out, TEST_TECHS) == 0, "absent tag found");
+    TEST_CHECK(t, holos_tech_index_find(NULL, HOLOS_TECH_TAG, "solar", out, 1) == -1 &&
+                      holos_tech_index_find(index, (enum holos_tech_key)9, "solar", out, 1) == -1 &&
+                      holos_tech_index_find(index, HOLOS_TECH_TAG, NULL, out, 1) == -1,
+               "bad finds accepted");
+
+    test_query(t, cat, index, all, 3, 0);
+    test_query(t, cat, index, all, 3, 1);
+    test_query(t, cat, index, none, 2, 0);
+    test_query(t, cat, index, none, 2, 1);
+    test_query(t, cat, index, cert, 2, 0);
+    test_query(t, cat, index, cert, 2, 1);
+    for (int i = 0; i <= HOLOS_TECH_QUERY_MAX; i++) many[i] = all[0];
+    TEST_CHECK(t, holos_tech_index_query(index, many, HOLOS_TECH_QUERY_MAX + 1, 0, out, 1) == -1 &&
+                      holos_tech_index_query(index, many, 0, 0, out, 1) == -1,
+               "query of too many or no terms accepted");
+
+    /* Kept up to date through adds and sets */
+    test_tech(&tech, 1, name, sizeof(name), tags);
+    tech.category = "fresh";
+    holos_tech_catalog_add(cat, &tech);
+    holos_tech_catalog_set(cat, 0, &tech);
+    TEST_CHECK(t, holos_tech_index_find(index, HOLOS_TECH_CATEGORY, "fresh", out, 2) == 2 &&
+                      out[0] == holos_tech_catalog_get(cat, 0) && out[1] == holos_tech_catalog_get(cat, TEST_TECHS),
+               "index not updated by the add and the set");
+    TEST_CHECK(t, holos_tech_index_find(index, HOLOS_TECH_CATEGORY, "energy", NULL, 0) == TEST_TECHS / 4 - 1,
+               "technology 0 still in energy");
+    test_query(t, cat, index, all, 3, 1);
+
+    /* An index outliving its catalog is empty */
+    holos_tech_catalog_free(cat);
+    cat = NULL;
+    TEST_CHECK(t, holos_tech_index_find(index, HOLOS_TECH_TAG, "solar", out, TEST_TECHS) == 0,
+               "index of a freed catalog still finds");
+out:
+    holos_tech_index_free(index);
+    holos_tech_catalog_free(cat);
+}
+
+/* ---------------- Columns ---------------- */
+
+/* Row r of a utf8 column exported through the C data interface */
+static int test_utf8_is(const struct ArrowArray *a, int64_t r, const char *s) {
+    const uint8_t *valid = a->buffers[0];
+    const int32_t *off = a->buffers[1];
+    const char *data = a->buffers[2];
+    if (!s) return valid && !(valid[r / 8] >> (r % 8) & 1);
+    return (!valid || valid[r / 8] >> (r % 8) & 1) && (size_t)(off[r + 1] - off[r]) == strlen(s) &&
+           memcmp(data + off[r], s, strlen(s)) == 0;
+}
+
+void test_tech_columns(struct test *t) {
+    static uint32_t rows[TEST_TECHS + 1], sel[TEST_TECHS + 1];
+    struct holos_tech_catalog *cat = test_catalog(t, TEST_TECHS);
+    struct holos_tech_columns *cols = NULL;
+    struct holos_tech_aggregate agg, groups[8];
+    struct holos_technology tech;
+    struct ArrowSchema schema;
+    struct ArrowArray array;
+    char name[32], *tags[2], magic[8];
+    const double *eff;
+    size_t n, want = 0;
+    double sum = 0.0;
+    long g;
+    FILE *f;
+    if (!cat) return;
+    test_tech(&tech, TEST_TECHS, name, sizeof(name), tags);
+    tech.category = NULL;                   /* Grouped last */
+    holos_tech_catalog_add(cat, &tech);
+    cols = holos_tech_columns_new(cat);
+    TEST_CHECK(t, cols && holos_tech_columns_rows(cols) == TEST_TECHS + 1, "cannot take the snapshot");
+    if (!cols) goto out;
+
+    /* A snapshot is unchanged by its catalog after */
+    test_tech(&tech, 1, name, sizeof(name), tags);
+    holos_tech_catalog_set(cat, 0, &tech);
+    eff = holos_tech_columns_measure(cols, HOLOS_TECH_EFFICIENCY);
+    TEST_CHECK(t, eff && eff[0] == 0.0 && eff[17] == 0.17 && holos_tech_columns_measure(cols, HOLOS_TECH_CARBON) &&
+                      holos_tech_columns_measure(cols, HOLOS_TECH_MEASURES) == NULL,
+               "efficiency column");
+    if (!eff) goto out;
+
+    /* Filters and aggregates against a scan */
+    for (size_t i = 0; i <= TEST_TECHS; i++)
+        if (eff[i] >= 0.2 && eff[i] <= 0.5) want++;
+    n = holos_tech_columns_filter(cols, HOLOS_TECH_EFFICIENCY, 0.2, 0.5, NULL, 0, rows);
+    TEST_CHECK(t, n == want, "%zu rows in [0.2, 0.5], %zu in a scan", n, want);
+    for (size_t i = 0; i < n; i++) {
+        TEST_CHECK(t, eff[rows[i]] >= 0.2 && eff[rows[i]] <= 0.5 && (i == 0 || rows[i] > rows[i - 1]),
+                   "row %zu of the filter", i);
+        sum += eff[rows[i]];
+    }
+    n = holos_tech_columns_filter(cols, HOLOS_TECH_EFFICIENCY, 0.3, 0.3, rows, n, rows);   /* In place */
+    TEST_CHECK(t, n == (TEST_TECHS + 99) / 100 && eff[rows[0]] == 0.3, "%zu rows at 0.3", n);
+    want = holos_tech_columns_filter(cols, HOLOS_TECH_EFFICIENCY, 0.2, 0.5, NULL, 0, sel);
+    TEST_CHECK(t, holos_tech_columns_aggregate(cols, HOLOS_TECH_EFFICIENCY, sel, want, &agg) == 0 &&
+                      agg.count == want && fabs(agg.sum - sum) < 1e-9 && agg.min == 0.2 && agg.max == 0.5 &&
+                      fabs(agg.mean - sum / (double)want) < 1e-12,
+               "aggregate of the filter: %zu rows, sum %g", agg.count, agg.sum);
+    TEST_CHECK(t, holos_tech_columns_aggregate(cols, HOLOS_TECH_COST, sel, 0, &agg) == 0 && agg.count == 0 &&
+                      isnan(agg.mean) && isnan(agg.min),
+               "aggregate of no rows");
+
+    /* Groups in the order first met, NULL last */
+    g = holos_tech_columns_group(cols, HOLOS_TECH_CATEGORY, HOLOS_TECH_COST, NULL, 0, groups, 8);
+    TEST_CHECK(t, g == 5, "%ld categories", g);
+    for (long k = 0; k < 4 && g == 5; k++)
+        TEST_CHECK(t, groups[k].value && strcmp(groups[k].value, test_categories[k]) == 0 &&
+                          groups[k].count == TEST_TECHS / 4 && groups[k].min == 10.0 * k,
+                   "group %ld: %s of %zu", k, groups[k].value ? groups[k].value : "(none)", groups[k].count);
+    TEST_CHECK(t, g == 5 && groups[4].value == NULL && groups[4].count == 1 && groups[4].sum == 10.0 * TEST_TECHS,
+               "NULL category not grouped last");
+    TEST_CHECK(t, holos_tech_columns_group(cols, HOLOS_TECH_LIFECYCLE, HOLOS_TECH_COST, NULL, 0, groups, 1) == 3 &&
+                      strcmp(groups[0].value, test_stages[0]) == 0,
+               "lifecycle groups past max");
+    TEST_CHECK(t, holos_tech_columns_group(cols, HOLOS_TECH_TAG, HOLOS_TECH_COST, NULL, 0, groups, 8) == -1,
+               "grouped by tag");
+
+    /* An IPC file opens and closes with the Arrow magic */
+    TEST_CHECK(t, holos_tech_columns_write_arrow(cols, test_path(t, "techs.arrow")) == 0, "cannot write the file");
+    f = fopen(test_path(t, "techs.arrow"), "rb");
+    TEST_CHECK(t, f && fread(magic, 1, 8, f) == 8 && memcmp(magic, "ARROW1", 6) == 0 && fseek(f, -6, SEEK_END) == 0 &&
+                      fread(magic, 1, 6, f) == 6 && memcmp(magic, "ARROW1", 6) == 0,
+               "no Arrow magic at the ends of the file");
+    if (f) fclose(f);
+
+    /* The export keeps the snapshot until released */
+    TEST_CHECK(t, holos_tech_columns_export(cols, &schema, &array) == 0, "cannot export");
+    holos_tech_columns_free(cols);
+    cols = NULL;
+    TEST_CHECK(t, strcmp(schema.format, "+s") == 0 && schema.n_children == 18 && array.length == TEST_TECHS + 1 &&
+                      strcmp(schema.children[1]->name, "name") == 0 && strcmp(schema.children[1]->format, "u") == 0 &&
+                      strcmp(schema.children[5]->format, "i") == 0 && strcmp(schema.children[6]->format, "g") == 0,
+               "exported schema");
+    TEST_CHECK(t, test_utf8_is(array.children[1], 7, "tech7") && test_utf8_is(array.children[2], 6, "AI") &&
+                      test_utf8_is(array.children[2], TEST_TECHS, NULL) && array.children[2]->null_count == 1 &&
+                      ((const int32_t *)array.children[5]->buffers[1])[8] == 9 &&
+                      ((const double *)array.children[6]->buffers[1])[17] == 0.17,
+               "exported values");
+    array.release(&array);
+    schema.release(&schema);
+    TEST_CHECK(t, array.release == NULL && schema.release == NULL, "released export not marked");
+out:
+    holos_tech_columns_free(cols);
+    holos_tech_catalog_free(cat);
+}
@@ -0,0 +1,611 @@
+/* test_thermo.c - Tests of the thermodynamics of HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+   ----------------------------------------------------------------------
+   The columnar kernels are held to the scalar functions, state by
+   state, and to the same bits on any thread count; their logarithm to
+   libm within an ulp, and to libm itself where it hands over. EOS
+   tables are held to their EOS, to the partials of their own
+   interpolant, and to the bits of themselves sampled on threads or
+   read back from the cache. Conduction is held to profiles and decay
+   rates known in closed form, and to the heat its sources put in.
+   Observable streams must dump back what was pushed, to the bit.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+
+#include "core/phys/thermo/thermodynamics.h"
+#include "core/phys/thermo/entropy.h"
+#include "core/phys/thermo/heat_transfer.h"
+#include "core/phys/obs_stream.h"
+#include "tests.h"
+
+#define TEST_R 8.314462618              /* TD_R, private to the library */
+
+/* ---------------- Columnar Kernels ---------------- */
+
+/* |a - b| in ulps of b */
+static double test_ulps(double a, double b) {
+    return fabs(a - b) / (nextafter(fabs(b), INFINITY) - fabs(b));
+}
+
+/*
+    ln over 600 decades and the ulps around 1 within an ulp of libm, and
+    libm's own value at 0, negatives, subnormals, infinities and NaN; the
+    pressures, entropies and free energies of 1000 states within an ulp
+    or two of the scalar functions, on 0, 4 and all threads the same
+    bits, written over an input as well. Mixing entropies with a zero
+    fraction, a block loaded from and stored to states (NULL ones
+    skipped), and NULL columns refused.
+*/
+void test_td_kernels(struct test *t) {
+    enum { N = 1000, NC = 3 };
+    static const int threads[] = {4, -1};
+    static const double special[] = {0.0, -0.0, -1.0, 1e-310, 4.9e-324, INFINITY, -INFINITY, NAN, 1.0};
+    double x[N], y[N], z[N], n[N], T[N], V[N], S[N], P[N], P2[N], comp[N * NC], err = 0.0;
+    td_state_t states[4], *list[4];
+    td_state_block *block = td_state_block_alloc(4);
+    int ok = 1;
+    if (!block) {
+        TEST_CHECK(t, 0, "out of memory");
+        return;
+    }
+    for (int k = 0; k < N; k++)
+        x[k] = k < N / 2 ? pow(10.0, -300.0 + 600.0 * k / (N / 2)) : 1.0 + (k - 3 * N / 4) * DBL_EPSILON;
+    TEST_CHECK(t, td_log_n(x, y, N, 0) == 0, "serial logarithms");
+    for (int k = 0; k < N; k++) err = fmax(err, x[k] == 1.0 ? fabs(y[k]) : test_ulps(y[k], log(x[k])));
+    TEST_CHECK(t, err <= 1.0, "logarithms %g ulps off libm", err);
+    for (size_t r = 0; r < sizeof(threads) / sizeof(threads[0]); r++)
+        TEST_CHECK(t, td_log_n(x, z, N, threads[r]) == 0 && memcmp(y, z, sizeof(y)) == 0,
+                   "%d threads: the logarithms differ", threads[r]);
+    td_log_n(special, y, sizeof(special) / sizeof(special[0]), 0);
+    for (size_t k = 0; k < sizeof(special) / sizeof(special[0]); k++) {
+        const double l = log(special[k]);
+        if (isnan(l) ? !isnan(y[k]) : y[k] != l) ok = 0;
+    }
+    TEST_CHECK(t, ok, "ln of 0, negatives, subnormals, infinities or NaN is not libm's");
+
+    /* States of 0.1 to 10 mol at 10 K to 10^4 K in 1 l to 1 m^3 */
+    for (int k = 0; k < N; k++) {
+        n[k] = 0.1 * pow(100.0, (k % 17) / 16.0);
+        T[k] = 10.0 * pow(1e3, (k % 23) / 22.0);
+        V[k] = 1e-3 * pow(1e3, (k % 29) / 28.0);
+    }
+    err = 0.0;
+    td_ideal_gas_pressure_n(n, T, V, P, N, 0);
+    for (int k = 0; k < N; k++) err = fmax(err, test_ulps(P[k], td_ideal_gas_pressure(n[k], T[k], V[k])));
+    td_van_der_waals_pressure_n(n, T, V, 0.1382, 3.19e-5, P2, N, 0);
+    for (int k = 0; k < N; k++)
+        err = fmax(err, test_ulps(P2[k], td_van_der_waals_pressure(n[k], T[k], V[k], 0.1382, 3.19e-5)));
+    td_ideal_gas_entropy_n(n, V, T, S, N, 0);
+    for (int k = 0; k < N; k++) err = fmax(err, test_ulps(S[k], td_ideal_gas_entropy(n[k], V[k], T[k])));
+    TEST_CHECK(t, err <= 2.0, "pressures and entropies %g ulps off the scalar functions", err);
+    ok = fabs(td_ideal_gas_entropy(2.0, 0.5, 300.0) - 2.0 * (1.5 * TEST_R * log(300.0) + TEST_R * log(0.25))) < 1e-12;
+    TEST_CHECK(t, ok, "S(2 mol, 0.5 m^3, 300 K) = %.17g", td_ideal_gas_entropy(2.0, 0.5, 300.0));
+    for (size_t r = 0; r < sizeof(threads) / sizeof(threads[0]); r++) {
+        td_ideal_gas_entropy_n(n, V, T, z, N, threads[r]);
+        ok = memcmp(S, z, sizeof(S)) == 0;
+        ent_entropy_ideal_gas_n(n, V, T, z, N, threads[r]);
+        ok = ok && memcmp(S, z, sizeof(S)) == 0;
+        td_van_der_waals_pressure_n(n, T, V, 0.1382, 3.19e-5, z, N, threads[r]);
+        ok = ok && memcmp(P2, z, sizeof(P2)) == 0;
+        TEST_CHECK(t, ok, "%d threads: the kernels differ from the serial ones", threads[r]);
+    }
+
+    /* G = H - TS, F = U - TS and H = U + PV, H written over U */
+    err = 0.0;
+    memcpy(y, V, sizeof(V));
+    td_gibbs_free_energy_n(P, T, S, z, N, 4);
+    for (int k = 0; k < N; k++) err = fmax(err, test_ulps(z[k], td_gibbs_free_energy(P[k], T[k], S[k])));
+    td_helmholtz_free_energy_n(P2, T, S, z, N, 0);
+    for (int k = 0; k < N; k++) err = fmax(err, test_ulps(z[k], td_helmholtz_free_energy(P2[k], T[k], S[k])));
+    td_enthalpy_n(y, P, V, y, N, -1);
+    for (int k = 0; k < N; k++) err = fmax(err, test_ulps(y[k], td_enthalpy(V[k], P[k], V[k])));
+    TEST_CHECK(t, err <= 1.0, "free energies and enthalpies %g ulps off the scalar functions", err);
+
+    /* -R sum x ln x, 0 ln 0 taken as 0 */
+    for (int k = 0; k < N; k++) {
+        comp[NC * k] = (k % 10) / 10.0;
+        comp[NC * k + 1] = k % 3 ? 0.0 : (1.0 - comp[NC * k]) / 2.0;
+        comp[NC * k + 2] = 1.0 - comp[NC * k] - comp[NC * k + 1];
+    }
+    TEST_CHECK(t, ent_entropy_mixing_n(comp, NC, z, N, 4) == 0, "mixing entropies");
+    err = 0.0;
+    for (int k = 0; k < N; k++) {
+        double s = 0.0;
+        for (int c = 0; c < NC; c++)
+            if (comp[NC * k + c] > 0.0) s -= TEST_R * comp[NC * k + c] * log(comp[NC * k + c]);
+        err = fmax(err, fabs(z[k] - s));
+    }
+    TEST_CHECK(t, err < 1e-13, "mixing entropies off -R sum x ln x by %g", err);
+    TEST_CHECK(t, fabs(ent_entropy_mixing(comp + 3 * NC, NC) - z[3]) < 1e-15, "scalar mixing entropy");
+    TEST_CHECK(t, ent_entropy_phase_change(2.0, 6e3, 300.0) == 40.0, "n L / T = %g, not 40",
+               ent_entropy_phase_change(2.0, 6e3, 300.0));
+
+    /* States through a block, the NULL states left alone */
+    memset(states, 0, sizeof(states));
+    for (int i = 0; i < 4; i++) {
+        states[i].T = 100.0 + i;
+        states[i].V = 1.0 + i;
+        states[i].n = 2.0;
+        states[i].G = -1.0 - i;
+        list[i] = i == 2 ? NULL : &states[i];
+    }
+    TEST_CHECK(t, td_state_block_load(block, list, 4) == 0, "load");
+    td_ideal_gas_pressure_n(block->n_moles, block->T, block->V, block->P, 4, 0);
+    list[2] = &states[2];
+    list[1] = NULL;
+    TEST_CHECK(t, td_state_block_store(block, list, 4) == 0, "store");
+    TEST_CHECK(t, states[0].P == td_ideal_gas_pressure(2.0, 100.0, 1.0) && states[3].G == -4.0 && states[1].P == 0.0,
+               "stored P %g, %g, G %g", states[0].P, states[1].P, states[3].G);
+    TEST_CHECK(t, states[2].T == 0.0 && states[2].n == 0.0, "a skipped state loaded");
+    TEST_CHECK(t, td_state_block_load(block, list, 5) == -1, "5 states into a block of 4");
+    TEST_CHECK(t, td_log_n(NULL, y, 1, 0) == -1 && td_enthalpy_n(y, NULL, V, y, 1, 0) == -1 &&
+                      td_log_n(NULL, NULL, 0, 0) == 0,
+               "NULL columns");
+    td_state_block_free(block);
+}
+
+/* ---------------- Tabulated EOS ---------------- */
+
+static long test_eos_calls;
+
+/* Van der Waals pressure of a molar density, plus a step of width w K
+   across a boiling line that wanders with the density */
+static double test_eos_value(const td_state_t *s, double w) {
+    const double rho = s->n / s->V, T = s->T, Tb = 300.0 + 20.0 * sin(rho / 2000.0);
+    return rho * TEST_R * T / (1.0 - 3e-5 * rho) - 0.13 * rho * rho + 2e5 * tanh((T - Tb) / w);
+}
+
+static double test_eos(const td_state_t *s, void *params) {
+    test_eos_calls++;
+    return test_eos_value(s, *(const double *)params);
+}
+
+/* The same, safe to call from the threads of the sampling */
+static double test_eos_mt(const td_state_t *s, void *params) {
+    return test_eos_value(s, *(const double *)params);
+}
+
+static double test_eos_step(const td_state_t *s, void *params) {
+    (void)params;
+    return tanh((s->T - 300.0) / 0.05);
+}
+
+static double test_eos_nan(const td_state_t *s, void *params) {
+    (void)params;
+    return s->T > 400.0 ? NAN : s->T;
+}
+
+/*
+    A van der Waals gas with a step 10 K wide, tabulated to 1e-5 on
+    (rho, T): within a few tolerances of the EOS at 2000 states, its
+    partials those of the interpolant, the callback itself outside the
+    table, batches the single evaluations. The table sampled on 4
+    threads is the serial one; cached, it loads without a call and with
+    the same bits, and other params miss the cache. A step far sharper
+    than the grid does not overshoot, and an EOS that is not finite
+    cannot be tabulated.
+*/
+void test_td_eos_table(struct test *t) {
+    enum { N = 2000 };
+    double width = 10.0, x[N], T[N], f[N], g[N], err = 0.0;
+    char dir[4096];
+    td_eos_t eos, other;
+    td_eos_table_params prm;
+    long calls;
+    int ok = 1;
+
+    snprintf(dir, sizeof(dir), "%s", test_path(t, "."));
+    memset(&eos, 0, sizeof(eos));
+    eos.name = "test-vdw-step";
+    eos.eos_fn = test_eos;
+    eos.params = &width;
+    memset(&prm, 0, sizeof(prm));
+    prm.axes = TD_EOS_RHO_T;
+    prm.x_min = 10.0;
+    prm.x_max = 20000.0;
+    prm.T_min = 200.0;
+    prm.T_max = 500.0;
+    prm.rtol = 1e-5;
+    prm.atol = 1.0;
+    prm.max_nodes = 257;
+    prm.params_size = sizeof(width);
+    prm.cache_dir = dir;
+    TEST_CHECK(t, td_eos_tabulate(&eos, &prm) == 0 && eos.table, "tabulation");
+    for (int k = 0; k < N; k++) {
+        td_state_t s;
+        memset(&s, 0, sizeof(s));
+        x[k] = 10.0 + 19990.0 * (0.5 + 0.5 * sin(12.9898 * k));
+        T[k] = 200.0 + 300.0 * (0.5 + 0.5 * sin(78.233 * k + 1.0));
+        s.n = 1.0;
+        s.V = 1.0 / x[k];
+        s.T = T[k];
+        f[k] = td_eos_eval_xt(&eos, x[k], T[k], NULL, NULL);
+        err = fmax(err, fabs(td_eos_eval(&eos, &s) - test_eos_mt(&s, &width)) / (1e-5 * fabs(f[k]) + 1.0));
+    }
+    TEST_CHECK(t, err < 4.0, "the table %g tolerances off the EOS", err);
+    for (int k = 0; k < N; k += 97) {
+        const double h = 1e-4, hx = 1e-4 * x[k];
+        double dx, dT;
+        const double v = td_eos_eval_xt(&eos, x[k], T[k], &dx, &dT);
+        const double fx = (td_eos_eval_xt(&eos, x[k] + hx, T[k], NULL, NULL) -
+                           td_eos_eval_xt(&eos, x[k] - hx, T[k], NULL, NULL)) / (2 * hx);
+        const double fT = (td_eos_eval_xt(&eos, x[k], T[k] + h, NULL, NULL) -
+                           td_eos_eval_xt(&eos, x[k], T[k] - h, NULL, NULL)) / (2 * h);
+        if (v != f[k] || fabs(dx - fx) > 1e-4 * fabs(fx) + 1e-6 || fabs(dT - fT) > 1e-4 * fabs(fT) + 1e-6) ok = 0;
+    }
+    TEST_CHECK(t, ok, "partials not those of the interpolant");
+    {
+        td_state_t s;
+        memset(&s, 0, sizeof(s));
+        s.n = 2.0;
+        s.V = 2.0 / 30000.0;
+        s.T = 350.0;
+        TEST_CHECK(t, td_eos_eval_xt(&eos, 30000.0, 350.0, NULL, NULL) == test_eos_mt(&s, &width),
+                   "outside the table, not the EOS");
+    }
+    TEST_CHECK(t, td_eos_eval_n(&eos, x, T, g, N, 4) == 0 && memcmp(f, g, sizeof(f)) == 0,
+               "a batch on 4 threads differs from the single evaluations");
+
+    /* Sampled on 4 threads, and from the cache */
+    memset(&other, 0, sizeof(other));
+    other.name = "test-vdw-step-mt";
+    other.eos_fn = test_eos_mt;
+    other.params = &width;
+    prm.cache_dir = NULL;
+    prm.n_threads = 4;
+    TEST_CHECK(t, td_eos_tabulate(&other, &prm) == 0, "tabulation on 4 threads");
+    td_eos_eval_n(&other, x, T, g, N, 0);
+    TEST_CHECK(t, memcmp(f, g, sizeof(f)) == 0, "the table sampled on 4 threads differs");
+    td_eos_untabulate(&other);
+    td_eos_untabulate(&eos);
+    prm.cache_dir = dir;
+    prm.n_threads = 0;
+    calls = test_eos_calls;
+    TEST_CHECK(t, td_eos_tabulate(&eos, &prm) == 0 && test_eos_calls == calls, "%ld calls with the table cached",
+               test_eos_calls - calls);
+    td_eos_eval_n(&eos, x, T, g, N, 0);
+    TEST_CHECK(t, memcmp(f, g, sizeof(f)) == 0, "the cached table differs");
+    width = 20.0;
+    TEST_CHECK(t, td_eos_tabulate(&eos, &prm) == 0 && test_eos_calls > calls, "other params read from the cache");
+    td_eos_untabulate(&eos);
+
+    /* A step of 0.05 K between nodes: monotone, within [-1, 1] to rounding */
+    eos.eos_fn = test_eos_step;
+    prm.cache_dir = NULL;
+    prm.params_size = 0;
+    prm.max_nodes = 65;
+    TEST_CHECK(t, td_eos_tabulate(&eos, &prm) == 0, "step tabulation");
+    ok = 1;
+    for (int k = 0; k <= N; k++) {
+        const double v = td_eos_eval_xt(&eos, 1234.5, 290.0 + 20.0 * k / N, NULL, NULL);
+        if (fabs(v) > 1.0 + 1e-12 || (k && v < err - 1e-12)) ok = 0;
+        err = v;
+    }
+    TEST_CHECK(t, ok, "the step overshoots or turns back");
+    td_eos_untabulate(&eos);
+
+    /* Not finite, or no domain */
+    eos.eos_fn = test_eos_nan;
+    TEST_CHECK(t, td_eos_tabulate(&eos, &prm) == -1 && eos.table == NULL, "a NaN tabulated");
+    eos.eos_fn = test_eos_mt;
+    prm.x_max = prm.x_min;
+    TEST_CHECK(t, td_eos_tabulate(&eos, &prm) == -1, "an empty density range tabulated");
+    td_eos_untabulate(&eos);
+}
+
+/* ---------------- Conduction ---------------- */
+
+/* A system of two materials (k 10 and 200 W/m/K, rho c 1e6 J/m^3/K) and
+   the six faces of bc */
+struct test_heat {
+    ht_material_t materials[2], *material_list[2];
+    ht_boundary_t bc[6], *bc_list[6];
+    ht_system_t system;
+};
+
+static void test_heat_init(struct test_heat *h) {
+    memset(h, 0, sizeof(*h));
+    for (int m = 0; m < 2; m++) {
+        h->materials[m].density = 1000.0;
+        h->materials[m].specific_heat = 1000.0;
+        h->materials[m].conductivity = m ? 200.0 : 10.0;
+        h->material_list[m] = &h->materials[m];
+    }
+    for (int f = 0; f < 6; f++) h->bc_list[f] = &h->bc[f];
+    h->system.materials = h->material_list;
+    h->system.n_materials = 2;
+    h->system.boundaries = h->bc_list;
+    h->system.n_boundaries = 6;
+}
+
+/*
+    A bar, 400 K at one end and cooled by h = 50 W/m^2/K into 300 K at
+    the other: the Thomas solve of the line against CG on three lines
+    side by side, then at steady state on the straight profile of
+    q = 100 K / (L / k + 1 / h). An insulated cube gains exactly what its
+    sources put in; a periodic cosine decays by the Crank-Nicolson factor
+    of its discrete eigenvalue. A heterogeneous 32^3 box steps to the
+    serial bits on 4 threads, radiative faces rebuild the hierarchy each
+    step, and moving faces and unknown materials are refused.
+*/
+void test_ht_conduction(struct test *t) {
+    enum { NL = 100, NC = 16, NB = 32 };
+    const double d = 0.005, L = NL * d, q = 100.0 / (L / 10.0 + 1.0 / 50.0);
+    struct test_heat h;
+    ht_conduction_t *line = NULL, *sheet = NULL, *box = NULL, *other = NULL;
+    double T1[NL], T2[3 * NL], *T3 = malloc(NB * NB * NB * sizeof(double)), *T4 = malloc(NB * NB * NB * sizeof(double));
+    double *src = malloc(NC * NC * NC * sizeof(double)), err = 0.0, gain = 0.0, heat0 = 0.0;
+    size_t *region = malloc(NB * NB * NB * sizeof(size_t));
+    int ok = 1;
+
+    test_heat_init(&h);
+    h.bc[0].type = HT_BC_DIRICHLET;
+    h.bc[0].value = 400.0;
+    h.bc[1].type = HT_BC_CONVECTIVE;
+    h.bc[1].h = 50.0;
+    h.bc[1].T_inf = 300.0;
+    {
+        const ht_mesh_t m1 = {{NL, 1, 1}, {d, 0.1, 0.1}, NULL, NULL}, m2 = {{NL, 3, 1}, {d, 0.1 / 3, 0.1}, NULL, NULL};
+        line = ht_conduction_alloc(&h.system, &m1, NULL);
+        sheet = ht_conduction_alloc(&h.system, &m2, NULL);
+    }
+    if (!line || !sheet || !T3 || !T4 || !src || !region) {
+        TEST_CHECK(t, 0, "out of memory");
+        goto done;
+    }
+    for (int i = 0; i < 3 * NL; i++) T2[i] = T1[i % NL] = 300.0;
+    for (int s = 0; s < 20; s++)
+        ok = ok && ht_conduction_step(line, T1, 10.0) == 0 && ht_conduction_step(sheet, T2, 10.0) == 0;
+    TEST_CHECK(t, ok, "bar steps");
+    for (int i = 0; i < 3 * NL; i++) err = fmax(err, fabs(T2[i] - T1[i % NL]));
+    TEST_CHECK(t, err < 1e-4 && sheet->n_iterations > 0 && line->n_iterations == 0,
+               "CG %g K off the Thomas solve (%zu and %zu iterations)", err, sheet->n_iterations, line->n_iterations);
+    TEST_CHECK(t, fabs(line->boundary_flux - sheet->boundary_flux) < 1e-6 * fabs(line->boundary_flux),
+               "boundary flux %.10g against %.10g", line->boundary_flux, sheet->boundary_flux);
+    for (int s = 0; s < 4000; s++) ht_conduction_step(line, T1, 100.0);
+    err = 0.0;
+    for (int i = 0; i < NL; i++) err = fmax(err, fabs(T1[i] - (400.0 - q * (i + 0.5) * d / 10.0)));
+    TEST_CHECK(t, err < 1e-6 && fabs(line->boundary_flux) < 1e-4, "steady bar %g K off, %g W in", err,
+               line->boundary_flux);
+
+    /* Insulated, with sources: every joule stays, to the CG tolerance */
+    memset(h.bc, 0, sizeof(h.bc));
+    for (int c = 0; c < NC * NC * NC; c++) {
+        src[c] = (c % 7) * 1e4;
+        T3[c] = 300.0 + c % 13;
+        heat0 += 1e6 * 1e-6 * T3[c];
+        gain += 10 * 5.0 * src[c] * 1e-6;
+    }
+    {
+        const ht_mesh_t m = {{NC, NC, NC}, {0.01, 0.01, 0.01}, NULL, src};
+        const ht_conduction_params tight = {1e-12, 0, 0};
+        box = ht_conduction_alloc(&h.system, &m, &tight);
+    }
+    for (int s = 0; box && s < 10; s++) ok = ok && ht_conduction_step(box, T3, 5.0) == 0;
+    TEST_CHECK(t, box && ok && fabs(box->heat - heat0 - gain) < 1e-9 * gain, "heat gained %.12g J, not %.12g J",
+               box ? box->heat - heat0 : 0.0, gain);
+    ht_conduction_free(box);
+
+    /* Periodic: cos(2 pi x) decays by (1 - lambda dt / 2) / (1 + lambda dt / 2) */
+    for (int f = 0; f < 6; f++) h.bc[f].type = HT_BC_PERIODIC;
+    {
+        const ht_mesh_t m = {{NC, NC, NC}, {1.0 / NC, 1.0 / NC, 1.0 / NC}, NULL, NULL};
+        const double lambda = 1e-5 * (2.0 - 2.0 * cos(2.0 * M_PI / NC)) * NC * NC;
+        const double g = (1 - 50 * lambda) / (1 + 50 * lambda);
+        box = ht_conduction_alloc(&h.system, &m, NULL);
+        for (int c = 0; c < NC * NC * NC; c++) T3[c] = cos(2.0 * M_PI * (c % NC + 0.5) / NC);
+        TEST_CHECK(t, box && ht_conduction_step(box, T3, 100.0) == 0, "periodic step");
+        err = 0.0;
+        for (int c = 0; c < NC * NC * NC; c++) err = fmax(err, fabs(T3[c] - g * cos(2.0 * M_PI * (c % NC + 0.5) / NC)));
+        TEST_CHECK(t, err < 1e-8, "the periodic mode %g off its decay", err);
+    }
+    ht_conduction_free(box);
+
+    /* Slabs of both materials, 350 K on one face, convecting on the rest */
+    memset(h.bc, 0, sizeof(h.bc));
+    for (int f = 0; f < 6; f++) {
+        h.bc[f].type = f ? HT_BC_CONVECTIVE : HT_BC_DIRICHLET;
+        h.bc[f].value = 350.0;
+        h.bc[f].h = 20.0;
+        h.bc[f].T_inf = 290.0;
+    }
+    for (int c = 0; c < NB * NB * NB; c++) {
+        region[c] = (c % NB) / 8 % 2;
+        T3[c] = T4[c] = 300.0;
+    }
+    {
+        const ht_mesh_t m = {{NB, NB, NB}, {1e-3, 1e-3, 1e-3}, region, NULL};
+        const ht_conduction_params threaded = {0.0, 0, 4};
+        box = ht_conduction_alloc(&h.system, &m, NULL);
+        other = ht_conduction_alloc(&h.system, &m, &threaded);
+    }
+    ok = box && other;
+    for (int s = 0; ok && s < 3; s++)
+        ok = ht_conduction_step(box, T3, 1.0) == 0 && ht_conduction_step(other, T4, 1.0) == 0;
+    TEST_CHECK(t, ok && memcmp(T3, T4, NB * NB * NB * sizeof(double)) == 0 && box->n_iterations == other->n_iterations,
+               "4 threads: the steps differ from the serial ones");
+    ht_conduction_free(box);
+    ht_conduction_free(other);
+    other = NULL;
+
+    /* A radiating face, 1000 K into 300 K */
+    memset(h.bc, 0, sizeof(h.bc));
+    h.bc[1].type = HT_BC_RADIATIVE;
+    h.bc[1].emissivity = 0.9;
+    h.bc[1].T_inf = 300.0;
+    {
+        const ht_mesh_t m = {{20, 20, 1}, {0.01, 0.01, 0.01}, NULL, NULL};
+        box = ht_conduction_alloc(&h.system, &m, NULL);
+    }
+    for (int c = 0; c < 400; c++) T3[c] = 1000.0;
+    for (int s = 0; box && s < 20; s++) ok = ok && ht_conduction_step(box, T3, 100.0) == 0;
+    TEST_CHECK(t, box && ok && box->n_setups >= 20 && T3[19] < T3[0] && T3[0] < 1000.0 && T3[19] > 300.0,
+               "radiating: %zu setups, %g K to %g K", box ? box->n_setups : 0, T3[0], T3[19]);
+    ht_conduction_free(box);
+    box = NULL;
+
+    /* Moving faces and unknown materials */
+    h.bc[1].type = HT_BC_MOVING;
+    {
+        const ht_mesh_t m = {{4, 1, 1}, {0.01, 0.01, 0.01}, NULL, NULL};
+        const size_t far[4] = {0, 1, 2, 0};
+        const ht_mesh_t bad = {{4, 1, 1}, {0.01, 0.01, 0.01}, far, NULL};
+        TEST_CHECK(t, ht_conduction_alloc(&h.system, &m, NULL) == NULL, "a moving face accepted");
+        h.bc[1].type = HT_BC_NONE;
+        TEST_CHECK(t, ht_conduction_alloc(&h.system, &bad, NULL) == NULL, "material 2 of 2 accepted");
+    }
+done:
+    ht_conduction_free(line);
+    ht_conduction_free(sheet);
+    free(T3);
+    free(T4);
+    free(src);
+    free(region);
+}
+
+/* ---------------- Observable Streams ---------------- */
+
+/* Records of name in the dump of path: their columns (t first) into
+   rows (at most max of them, width + 1 each); -1 if unreadable */
+static long test_records(struct test *t, const char *path, const char *name, double *rows, size_t width, long max) {
+    FILE *f = fopen(test_path(t, "dump.txt"), "w+");
+    char line[4096];
+    long n = 0;
+    if (!f) return -1;
+    if (obs_stream_dump(path, f) != 0) {
+        fclose(f);
+        return -1;
+    }
+    rewind(f);
+    while (fgets(line, sizeof(line), f)) {
+        char *p = strchr(line, ' ');
+        if (!p || (size_t)(p - line) != strlen(name) || strncmp(line, name, strlen(name)) != 0) continue;
+        for (size_t c = 0; c <= width && n < max; c++) rows[n * (width + 1) + c] = strtod(p, &p);
+        n++;
+    }
+    fclose(f);
+    return n;
+}
+
+/*
+    1000 pushes of a profile, of a pair reduced over windows of 10 and
+    of a scalar kept every third, through chunks of 16: the dump gives
+    back every value to the bit, the window minima, maxima and means and
+    the kept pushes, encoded as stored raw in fewer bytes. A binding takes
+    a width once, and thermodynamic diagnostics stream their profiles;
+    a file that is not a stream is refused.
+*/
+void test_obs_stream(struct test *t) {
+    enum { N = 1000 };
+    const obs_stream_params prm = {16, 2, 0, 0}, raw = {16, 2, 0, 1};
+    static double rows[N * 7];
+    char path[4096], raw_path[4096];
+    double v[5];
+    size_t bytes = 0;
+    int ok = 1;
+
+    snprintf(path, sizeof(path), "%s", test_path(t, "obs.bin"));
+    snprintf(raw_path, sizeof(raw_path), "%s", test_path(t, "obs_raw.bin"));
+    for (int pass = 0; pass < 2; pass++) {
+        obs_stream *s = obs_stream_open(pass ? raw_path : path, pass ? &raw : &prm);
+        int a, b, c;
+        if (!s) {
+            TEST_CHECK(t, 0, "stream not opened");
+            return;
+        }
+        a = obs_stream_add(s, "profile", 5, 1, OBS_SAMPLE);
+        b = obs_stream_add(s, "pair", 2, 10, OBS_STATS);
+        c = obs_stream_add(s, "every3", 1, 3, OBS_SAMPLE);
+        TEST_CHECK(t, a >= 0 && b >= 0 && c >= 0 && a != b && b != c, "observables %d, %d, %d", a, b, c);
+        for (int k = 0; k < N; k++) {
+            const double w[2] = {k % 10 * 1.5, -k}, x = k;
+            for (int i = 0; i < 5; i++) v[i] = 300.0 + sin(0.001 * k + 0.01 * i);
+            TEST_CHECK(t, obs_stream_push(s, a, 0.1 * k, v) == 0 && obs_stream_push(s, b, k, w) == 0 &&
+                              obs_stream_push(s, c, k, &x) == 0,
+                       "push %d", k);
+        }
+        TEST_CHECK(t, obs_stream_flush(s) == 0 && s->n_chunks > N / 16, "%zu chunks", s->n_chunks);
+        TEST_CHECK(t, s->n_pushed == 3 * N && s->n_dropped == 0, "%zu pushed, %zu dropped", s->n_pushed,
+                   s->n_dropped);
+        if (pass) TEST_CHECK(t, s->bytes > bytes, "%zu bytes raw, %zu encoded", s->bytes, bytes);
+        bytes = s->bytes;
+        TEST_CHECK(t, obs_stream_close(s) == 0, "close");
+    }
+    for (int pass = 0; pass < 2; pass++) {
+        const char *p = pass ? raw_path : path;
+        ok = test_records(t, p, "profile", rows, 5, N) == N;
+        for (int k = 0; ok && k < N; k++) {
+            ok = rows[6 * k] == 0.1 * k;
+            for (int i = 0; ok && i < 5; i++) ok = rows[6 * k + 1 + i] == 300.0 + sin(0.001 * k + 0.01 * i);
+        }
+        TEST_CHECK(t, ok, "%s: the profile does not read back", pass ? "raw" : "encoded");
+        ok = test_records(t, p, "pair", rows, 6, N) == N / 10;
+        for (int r = 0; ok && r < N / 10; r++) {
+            const double *row = rows + 7 * r, mean = -(10.0 * r + 4.5);
+            /* Minima, maxima and means of the pair over pushes 10 r .. 10 r + 9 */
+            ok = row[1] == 0.0 && row[2] == -(10.0 * r + 9) && row[3] == 13.5 && row[4] == -10.0 * r &&
+                 fabs(row[5] - 6.75) < 1e-12 && fabs(row[6] - mean) < 1e-12;
+        }
+        TEST_CHECK(t, ok, "%s: window statistics", pass ? "raw" : "encoded");
+        ok = test_records(t, p, "every3", rows, 1, N) == (N + 2) / 3;
+        for (int r = 0; ok && r < (N + 2) / 3; r++) ok = rows[2 * r] == 3.0 * r && rows[2 * r + 1] == 3.0 * r;
+        TEST_CHECK(t, ok, "%s: every third push", pass ? "raw" : "encoded");
+    }
+
+    /* Bindings, and a system streaming its diagnostics */
+    {
+        obs_stream *s = obs_stream_open(path, NULL);
+        obs_binding *b = s ? obs_binding_alloc(s, "test", 0, OBS_SAMPLE) : NULL;
+        double profile[3] = {1.0, 2.0, 3.0};
+        td_system_t sys;
+        memset(&sys, 0, sizeof(sys));
+        TEST_CHECK(t, b && obs_binding_push(b, 0, "x", 0.0, v, 2) == 0 && obs_binding_push(b, 0, "x", 1.0, v, 3) == -1,
+                   "a binding took another width");
+        sys.diagnostics.property_profile = profile;
+        sys.diagnostics.n_profile = 3;
+        TEST_CHECK(t, s && td_diagnostics_stream(&sys, s, 0, OBS_SAMPLE) == 0, "streaming the diagnostics");
+        for (int k = 0; k < 4; k++) {
+            profile[1] = k;
+            td_diagnostics_update(&sys);
+        }
+        td_diagnostics_stream(&sys, NULL, 0, OBS_SAMPLE);
+        obs_binding_free(b);
+        TEST_CHECK(t, s && obs_stream_close(s) == 0, "close");
+        ok = test_records(t, path, "td.property_profile", rows, 3, N) == 4;
+        for (int k = 0; ok && k < 4; k++)
+            ok = rows[4 * k] == k && rows[4 * k + 1] == 1.0 && rows[4 * k + 2] == k && rows[4 * k + 3] == 3.0;
+        TEST_CHECK(t, ok, "the diagnostics do not read back");
+        TEST_CHECK(t, test_records(t, path, "test.x", rows, 2, N) == 1, "the binding's record");
+    }
+    {
+        FILE *f = fopen(path, "w");
+        if (f) {
+            fputs("HOLOSOBX not a stream\n", f);
+            fclose(f);
+        }
+        TEST_CHECK(t, test_records(t, path, "profile", rows, 5, N) == -1, "a file that is not a stream dumped");
+    }
+}
@@ -0,0 +1,232 @@
+/* test_trace.c - Tests of the trace zones of HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+   ----------------------------------------------------------------------
+   Zones of a known call tree, some left by an early return, are held to
+   the summary holos_trace_print() makes of them and to the events of
+   the Chrome trace; then on threads of their own, with a ring too small
+   for them, and with tracing off. The zones of a library stepper must
+   nest as its calls do. Built with --disable-trace, the case skips.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <gsl/gsl_vector.h>
+
+#include "core/trace/trace.h"
+#include "core/phys/mech/classical/dynamics.h"
+#include "tests.h"
+
+#ifdef HOLOS_TRACE
+
+static volatile double g_sink;
+
+static void test_spin(void) {
+    double x = 0;
+    for (int i = 0; i < 2000; i++) x += 1.0 / (i + 1);
+    g_sink = x;
+}
+
+static void test_leaf(void) {
+    HOLOS_TRACE_ZONE("leaf");
+    test_spin();
+}
+
+static void test_inner(int k) {
+    HOLOS_TRACE_ZONE("inner");
+    if (k == 1) return;                 /* The zone must end here too */
+    test_spin();
+}
+
+/* outer: three inner, the second left early, then tail */
+static void test_outer(void) {
+    HOLOS_TRACE_ZONE("outer");
+    for (int k = 0; k < 3; k++) test_inner(k);
+    {
+        HOLOS_TRACE_ZONE("tail \"quoted\\\"");
+        test_spin();
+    }
+}
+
+static void *test_outer_thread(void *arg) {
+    (void)arg;
+    test_outer();
+    return NULL;
+}
+
+static void *test_leaves_thread(void *arg) {
+    for (int i = 0; i < *(const int *)arg; i++) test_leaf();
+    return NULL;
+}
+
+/* What holos_trace_print() prints, malloc'd (or NULL) */
+static char *test_print(struct test *t, int json) {
+    FILE *f = fopen(test_path(t, json ? "trace.json" : "trace.txt"), "w+");
+    char *text = NULL;
+    long n;
+    if (!f) return NULL;
+    if (json) holos_trace_dump(f);
+    else holos_trace_print(f);
+    if ((n = ftell(f)) >= 0 && fseek(f, 0, SEEK_SET) == 0 && (text = malloc((size_t)n + 1))) {
+        if (fread(text, 1, (size_t)n, f) != (size_t)n) {
+            free(text);
+            text = NULL;
+        } else {
+            text[n] = '\0';
+        }
+    }
+    fclose(f);
+    return text;
+}
+
+/* Calls of the zone name on level (0: top) of the summary, -1 if none */
+static long test_calls(const char *text, int level, const char *name) {
+    const size_t n = strlen(name);
+    for (const char *p = text; p && *p; p = strchr(p, '\n'), p = p ? p + 1 : NULL) {
+        int spaces = 0;
+        while (p[spaces] == ' ') spaces++;
+        if (spaces == 2 * level && strncmp(p + spaces, name, n) == 0 && p[spaces + n] == ' ')
+            return strtol(p + spaces + n + strspn(p + spaces + n, " "), NULL, 10);
+    }
+    return -1;
+}
+
+static int test_count(const char *text, const char *needle) {
+    int n = 0;
+    for (const char *p = text; (p = strstr(p, needle)); p += strlen(needle)) n++;
+    return n;
+}
+
+#define TEST_THREADS 4
+
+void test_trace_zones(struct test *t) {
+    pthread_t threads[TEST_THREADS];
+    char *text = NULL;
+    int leaves = 20, ok;
+
+    /* A call tree: outer > inner x 3, tail; twice, and a leaf */
+    holos_trace_reset();
+    TEST_CHECK(t, holos_trace_start(0, 0) == 0, "tracing not started");
+    test_outer();
+    test_outer();
+    test_leaf();
+    holos_trace_stop();
+    test_leaf();                        /* Not traced */
+    text = test_print(t, 0);
+    TEST_CHECK(t, text != NULL, "no summary");
+    if (!text) goto out;
+    TEST_CHECK(t, test_calls(text, 0, "outer") == 2 && test_calls(text, 0, "leaf") == 1, "top zones: %s", text);
+    TEST_CHECK(t, test_calls(text, 1, "inner") == 6 && test_calls(text, 1, "tail \"quoted\\\"") == 2,
+               "zones under outer: %s", text);
+    TEST_CHECK(t, test_calls(text, 0, "inner") < 0 && test_calls(text, 0, "tail") < 0, "a zone out of its parent: %s",
+               text);
+    TEST_CHECK(t, strstr(text, "\n11 zones on 1 threads\n") != NULL, "not 11 zones on 1 thread: %s", text);
+    TEST_CHECK(t, strncmp(text, "zone ", 5) == 0 && !strstr(text, "IPC"), "header: %.80s", text);
+    free(text);
+
+    /* The same, one complete event each, names escaped */
+    text = test_print(t, 1);
+    TEST_CHECK(t, text != NULL, "no Chrome trace");
+    if (!text) goto out;
+    TEST_CHECK(t, strncmp(text, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", 39) == 0 && strstr(text, "\n]}\n"),
+               "not a Chrome trace: %.80s", text);
+    TEST_CHECK(t, test_count(text, "\"ph\":\"X\"") == 11 && test_count(text, "{\"name\":\"inner\"") == 6,
+               "%d events, %d of inner", test_count(text, "\"ph\":\"X\""), test_count(text, "{\"name\":\"inner\""));
+    TEST_CHECK(t, test_count(text, "{\"name\":\"tail \\\"quoted\\\\\\\"\"") == 2, "name not escaped: %s", text);
+    TEST_CHECK(t, strstr(text, "\"at\":\"" __FILE__ ":") != NULL, "no site of the zones");
+    free(text);
+
+    /* Each thread its own ring */
+    holos_trace_reset();
+    holos_trace_start(0, 0);
+    for (int i = 0; i < TEST_THREADS; i++) pthread_create(&threads[i], NULL, test_outer_thread, NULL);
+    for (int i = 0; i < TEST_THREADS; i++) pthread_join(threads[i], NULL);
+    holos_trace_stop();
+    text = test_print(t, 0);
+    TEST_CHECK(t, text && test_calls(text, 0, "outer") == TEST_THREADS && test_calls(text, 1, "inner") == 3 * TEST_THREADS,
+               "zones of %d threads: %s", TEST_THREADS, text ? text : "");
+    TEST_CHECK(t, text && strstr(text, "\n20 zones on 4 threads\n"), "not on 4 threads: %s", text ? text : "");
+    free(text);
+
+    /* A ring of 8: the last 8 zones kept, the rest counted */
+    holos_trace_reset();
+    holos_trace_start(0, 8);
+    pthread_create(&threads[0], NULL, test_leaves_thread, &leaves);
+    pthread_join(threads[0], NULL);
+    holos_trace_stop();
+    text = test_print(t, 0);
+    TEST_CHECK(t, text && test_calls(text, 0, "leaf") == 8 && strstr(text, "\n8 zones on 1 threads, 12 older dropped"),
+               "ring of 8, 20 zones: %s", text ? text : "");
+    free(text);
+
+    /* Off: nothing */
+    holos_trace_reset();
+    test_outer();
+    text = test_print(t, 0);
+    TEST_CHECK(t, text && strstr(text, "\n0 zones on 0 threads\n"), "zones while off: %s", text ? text : "");
+    free(text);
+
+    /* With counters: the column, if the system has them */
+    holos_trace_start(HOLOS_TRACE_COUNTERS, 0);
+    test_leaf();
+    holos_trace_stop();
+    text = test_print(t, 0);
+    ok = text && (strstr(text, "IPC") != NULL) == (holos_trace_counters() != 0);
+    TEST_CHECK(t, ok, "counters %d, header: %.120s", holos_trace_counters(), text ? text : "");
+    free(text);
+    text = NULL;
+
+    /* A library stepper: its force evaluation within its steps */
+    holos_trace_reset();
+    {
+        dyn_system_t *sys = dyn_system_alloc(8);
+        if (!sys) {
+            TEST_CHECK(t, 0, "out of memory");
+            goto out;
+        }
+        dyn_system_set_gravity(sys, 1.0);
+        for (size_t i = 0; i < 8; i++) {
+            for (size_t a = 0; a < 3; a++) gsl_vector_set(sys->particles[i].pos, a, (double)((i >> a) & 1));
+            sys->particles[i].mass = 1.0;
+        }
+        dyn_system_sync_masses(sys);
+        holos_trace_start(0, 0);
+        for (int s = 0; s < 3; s++) TEST_CHECK(t, dyn_system_step(sys, 1e-3, DYN_INT_LEAPFROG) == 0, "step %d failed", s);
+        holos_trace_stop();
+        dyn_system_free(sys);
+    }
+    text = test_print(t, 0);
+    TEST_CHECK(t, text && test_calls(text, 0, "dyn_system_step") == 3 && test_calls(text, 1, "dyn_system_compute_forces") >= 3,
+               "zones of dyn_system_step: %s", text ? text : "");
+out:
+    free(text);
+    holos_trace_stop();
+    holos_trace_reset();
+}
+
+#else
+
+void test_trace_zones(struct test *t) {
+    test_skip(t, "built with --disable-trace");
+}
+
+#endif
@@ -0,0 +1,247 @@
+/* tests.c - Automatic tests of HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+
+   ----------------------------------------------------------------------
+   tests [NAME]...: runs the cases (see tests.h), or those whose name
+   contains one of the NAMEs, and prints PASS, FAIL or SKIP for each,
+   with the checks that failed. Exits 0 when none failed, 1 otherwise,
+   77 (skipped, to make check) when every case run was skipped.
+
+   The scratch directories are made under $TMPDIR (/tmp by default)
+   and removed at the end, unless a case failed: then the run's is
+   kept, and named, for a look at what the case left.
+
+   With MPI (configure --enable-mpi) the collective cases run on every
+   rank of MPI_COMM_WORLD and the others on rank 0 only, which prints;
+   'mpiexec -n 4 ./tests grid_mpi' checks a real decomposition, where
+   make check runs one rank.
+*/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE                     /* nftw(), mkdtemp() */
+#endif
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <ftw.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_MPI
+#include <mpi.h>
+#endif
+#include "core/exec/exec.h"
+#include "tests.h"
+
+#define TEST_PATH_MAX 4096
+
+struct test {
+    const char *name;
+    int failed, skipped;
+    char dir[TEST_PATH_MAX];
+    char path[TEST_PATH_MAX];
+};
+
+struct test_case {
+    const char *name;
+    void (*run)(struct test *t);
+    int collective;                     /* Runs on every MPI rank */
+};
+
+static const struct test_case test_cases[] = {
+    {"block_timesteps", test_block_timesteps, 0},
+    {"circuit_mna", test_circuit_mna, 0},
+    {"philox", test_philox, 0},
+    {"circuit_monte_carlo", test_circuit_monte_carlo, 0},
+    {"circuit_ac_sweep", test_circuit_ac_sweep, 0},
+    {"fluid_sph", test_fluid_sph, 0},
+    {"yee_grid", test_yee_grid, 0},
+    {"yee_fdtd", test_yee_fdtd, 0},
+    {"wave_engine", test_wave_engine, 0},
+    {"wave_stencil", test_wave_stencil, 0},
+    {"grid_mpi", test_grid_mpi, 1},
+    {"depletion", test_depletion, 0},
+    {"bateman_batch", test_bateman_batch, 0},
+    {"alias_table", test_alias_table, 0},
+    {"xs_table", test_xs_table, 0},
+    {"ff_network", test_ff_network, 0},
+    {"nf_potential", test_nf_potential, 0},
+    {"td_kernels", test_td_kernels, 0},
+    {"phonons", test_phonons, 0},
+    {"cl_neighbors", test_cl_neighbors, 0},
+    {"band_engine", test_band_engine, 0},
+    {"bs_scf", test_bs_scf, 0},
+    {"bs_kmesh", test_bs_kmesh, 0},
+    {"cl_supercell", test_cl_supercell, 0},
+    {"cl_relax", test_cl_relax, 0},
+    {"lattice", test_lattice, 0},
+    {"qft_topology", test_qft_topology, 0},
+    {"field_h5", test_field_h5, 0},
+    {"lorentz_push", test_lorentz_push, 0},
+    {"lorentz_soa", test_lorentz_soa, 0},
+    {"exec_reduce", test_exec_reduce, 0},
+    {"exec_for", test_exec_for, 0},
+    {"p2p_event_order", test_p2p_event_order, 0},
+    {"p2p_delta", test_p2p_delta, 0},
+    {"p2p_chunks", test_p2p_chunks, 0},
+    {"p2p_tasks", test_p2p_tasks, 0},
+    {"p2p_peers", test_p2p_peers, 0},
+    {"p2p_stats", test_p2p_stats, 0},
+    {"p2p_wire", test_p2p_wire, 0},
+    {"forge_store", test_forge_store, 0},
+    {"forge_batch", test_forge_batch, 0},
+    {"soa_layout", test_soa_layout, 0},
+    {"integrators", test_integrators, 0},
+    {"diagnostics", test_diagnostics, 0},
+    {"gravity_threads", test_gravity_threads, 0},
+    {"pair_kernel", test_pair_kernel, 0},
+    {"tree_gravity", test_tree_gravity, 0},
+    {"neighbor_list", test_neighbor_list, 0},
+    {"trajectory", test_trajectory, 0},
+    {"gpu_offload", test_gpu_offload, 0},
+    {"decay_step", test_decay_step, 0},
+    {"mlp_batch", test_mlp_batch, 0},
+    {"cnn_engines", test_cnn_engines, 0},
+    {"rnn_batch", test_rnn_batch, 0},
+    {"rnn_bptt", test_rnn_bptt, 0},
+    {"transformer_session", test_transformer_session, 0},
+    {"transformer_attention", test_transformer_attention, 0},
+    {"gan_train", test_gan_train, 0},
+    {"ai_plan_pack", test_ai_plan_pack, 0},
+    {"ai_arena", test_ai_arena, 0},
+    {"ai_model", test_ai_model, 0},
+    {"ai_model_files", test_ai_model_files, 0},
+    {"ai_int8", test_ai_int8, 0},
+    {"mlp_q8", test_mlp_q8, 0},
+    {"cnn_q8", test_cnn_q8, 0},
+    {"mlp_precision", test_mlp_precision, 0},
+    {"cnn_precision", test_cnn_precision, 0},
+    {"rnn_precision", test_rnn_precision, 0},
+    {"transformer_precision", test_transformer_precision, 0},
+    {"tech_catalog", test_tech_catalog, 0},
+    {"tech_index", test_tech_index, 0},
+    {"tech_columns", test_tech_columns, 0},
+    {"cli_batch", test_cli_batch, 0},
+    {"cli_p2p_stats", test_cli_p2p_stats, 0},
+    {"cli_plugins", test_cli_plugins, 0},
+    {"cli_plugin_open", test_cli_plugin_open, 0},
+    {"ckpt_snapshot", test_ckpt_snapshot, 0},
+    {"ckpt_skip", test_ckpt_skip, 0},
+    {"ckpt_restore", test_ckpt_restore, 0},
+    {"ckpt_restart", test_ckpt_restart, 0},
+    {"trace_zones", test_trace_zones, 0},
+    {"td_eos_table", test_td_eos_table, 0},
+    {"ht_conduction", test_ht_conduction, 0},
+    {"obs_stream", test_obs_stream, 0},
+    {NULL, NULL, 0}
+};
+
+static int g_rank = 0;
+
+void test_fail(struct test *t, const char *file, int line, const char *fmt, ...) {
+    va_list ap;
+    if (g_rank) fprintf(stderr, "[rank %d] ", g_rank);
+    fprintf(stderr, "%s:%d: %s: ", file, line, t->name);
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    fputc('\n', stderr);
+    t->failed++;
+}
+
+void test_skip(struct test *t, const char *why) {
+    if (!g_rank) printf("SKIP: %s (%s)\n", t->name, why);
+    t->skipped = 1;
+}
+
+const char *test_path(struct test *t, const char *name) {
+    int n = snprintf(t->path, sizeof(t->path), "%s/%s", t->dir, name);
+    if (n < 0 || (size_t)n >= sizeof(t->path)) {
+        test_fail(t, __FILE__, __LINE__, "scratch path of %s too long", name);
+        t->path[0] = '\0';
+    }
+    return t->path;
+}
+
+static int test_remove(const char *path, const struct stat *st, int flag, struct FTW *ftw) {
+    (void)st;
+    (void)flag;
+    (void)ftw;
+    return remove(path);
+}
+
+static int test_selected(const char *name, int argc, char **argv) {
+    if (argc < 2) return 1;
+    for (int i = 1; i < argc; i++)
+        if (strstr(name, argv[i])) return 1;
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    const char *tmp = getenv("TMPDIR");
+    char root[TEST_PATH_MAX];
+    int n_run = 0, n_skipped = 0, n_failed = 0, rc;
+#ifdef HAVE_MPI
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    MPI_Comm_rank(MPI_COMM_WORLD, &g_rank);
+#endif
+    rc = snprintf(root, sizeof(root), "%s/holos-tests.XXXXXX", tmp && *tmp ? tmp : "/tmp");
+    if (rc < 0 || (size_t)rc >= sizeof(root) - 64 || !mkdtemp(root)) {
+        fprintf(stderr, "[tests] no scratch directory under %s: %s\n", tmp && *tmp ? tmp : "/tmp", strerror(errno));
+        return 99;
+    }
+
+    for (const struct test_case *c = test_cases; c->name; c++) {
+        struct test t;
+        if (!test_selected(c->name, argc, argv) || (g_rank && !c->collective)) continue;
+        memset(&t, 0, sizeof(t));
+        t.name = c->name;
+        rc = snprintf(t.dir, sizeof(t.dir), "%s/%s", root, c->name);
+        if (rc < 0 || (size_t)rc >= sizeof(t.dir) || mkdir(t.dir, 0700) != 0) {
+            fprintf(stderr, "[tests] %s: %s\n", t.dir, strerror(errno));
+            n_failed++;
+            continue;
+        }
+        c->run(&t);
+        n_run++;
+        if (t.failed) {
+            n_failed++;
+            if (!g_rank) printf("FAIL: %s (%d checks)\n", c->name, t.failed);
+        } else if (t.skipped) {
+            n_skipped++;
+        } else if (!g_rank) {
+            printf("PASS: %s\n", c->name);
+        }
+        fflush(stdout);
+    }
+    holos_exec_shutdown();
+
+    if (n_failed) fprintf(stderr, "[tests] scratch files kept in %s\n", root);
+    else nftw(root, test_remove, 16, FTW_DEPTH | FTW_PHYS);
+#ifdef HAVE_MPI
+    MPI_Allreduce(MPI_IN_PLACE, &n_failed, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Finalize();
+#endif
+    if (n_failed) return 1;
+    return n_run && n_skipped == n_run ? 77 : 0;
+}
@@ -0,0 +1,170 @@
+/* tests.h - Test harness of HOLOS
+   Copyright (C) 2025 4137314
+
+   This file is part of HOLOS.
+
+   HOLOS is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   HOLOS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with HOLOS.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+    A case checks one claim of a module and goes on after a failed check,
+    so a run reports every check that failed:
+
+        void test_depletion(struct test *t) {
+            ... set up, or test_skip(t, "why"); return; ...
+            TEST_CHECK(t, fabs(n - exact) < 1e-12, "N(%g) = %.17g", dt, n);
+        }
+
+    The cases are listed in tests.c and live in a test_<module>.c each,
+    declared below. Each runs in a scratch directory of its own, removed
+    at the end of the run.
+*/
+
+#ifndef HOLOS_TESTS_H
+#define HOLOS_TESTS_H
+
+#include <stddef.h>
+
+struct test;
+
+/* Records a failed check at file:line, with a printf message */
+void test_fail(struct test *t, const char *file, int line, const char *fmt, ...)
+    __attribute__((format(printf, 4, 5)));
+
+#define TEST_CHECK(t, cond, ...) ((cond) ? (void)0 : test_fail((t), __FILE__, __LINE__, __VA_ARGS__))
+
+/* Ends the case as skipped (what it needs is not built in); return after it */
+void test_skip(struct test *t, const char *why);
+
+/* Path of name in the scratch directory of the case (a buffer of t,
+   valid until the next call) */
+const char *test_path(struct test *t, const char *name);
+
+/* test_dynamics.c */
+void test_block_timesteps(struct test *t);
+void test_soa_layout(struct test *t);
+void test_integrators(struct test *t);
+void test_diagnostics(struct test *t);
+void test_gravity_threads(struct test *t);
+void test_pair_kernel(struct test *t);
+void test_tree_gravity(struct test *t);
+void test_neighbor_list(struct test *t);
+void test_trajectory(struct test *t);
+void test_gpu_offload(struct test *t);
+
+/* test_circuit.c */
+void test_circuit_mna(struct test *t);
+void test_philox(struct test *t);
+void test_circuit_monte_carlo(struct test *t);
+void test_circuit_ac_sweep(struct test *t);
+
+/* test_fluids.c */
+void test_fluid_sph(struct test *t);
+
+/* test_em.c */
+void test_yee_grid(struct test *t);
+void test_yee_fdtd(struct test *t);
+void test_wave_engine(struct test *t);
+void test_wave_stencil(struct test *t);
+void test_grid_mpi(struct test *t);
+void test_field_h5(struct test *t);
+void test_lorentz_push(struct test *t);
+void test_lorentz_soa(struct test *t);
+
+/* test_nuclear.c */
+void test_depletion(struct test *t);
+void test_bateman_batch(struct test *t);
+void test_alias_table(struct test *t);
+void test_xs_table(struct test *t);
+void test_decay_step(struct test *t);
+void test_ff_network(struct test *t);
+void test_nf_potential(struct test *t);
+
+/* test_thermo.c */
+void test_td_kernels(struct test *t);
+void test_td_eos_table(struct test *t);
+void test_ht_conduction(struct test *t);
+void test_obs_stream(struct test *t);
+
+/* test_ss.c */
+void test_phonons(struct test *t);
+void test_cl_neighbors(struct test *t);
+void test_band_engine(struct test *t);
+void test_bs_scf(struct test *t);
+void test_bs_kmesh(struct test *t);
+void test_cl_supercell(struct test *t);
+void test_cl_relax(struct test *t);
+
+/* test_qft.c */
+void test_lattice(struct test *t);
+void test_qft_topology(struct test *t);
+
+/* test_exec.c */
+void test_exec_reduce(struct test *t);
+void test_exec_for(struct test *t);
+
+/* test_p2p.c */
+void test_p2p_event_order(struct test *t);
+void test_p2p_delta(struct test *t);
+void test_p2p_chunks(struct test *t);
+void test_p2p_tasks(struct test *t);
+void test_p2p_peers(struct test *t);
+void test_p2p_stats(struct test *t);
+void test_p2p_wire(struct test *t);
+
+/* test_forge.c */
+void test_forge_store(struct test *t);
+void test_forge_batch(struct test *t);
+
+/* test_ai.c */
+void test_mlp_batch(struct test *t);
+void test_cnn_engines(struct test *t);
+void test_rnn_batch(struct test *t);
+void test_rnn_bptt(struct test *t);
+void test_transformer_session(struct test *t);
+void test_transformer_attention(struct test *t);
+void test_gan_train(struct test *t);
+void test_ai_plan_pack(struct test *t);
+void test_ai_arena(struct test *t);
+void test_ai_model(struct test *t);
+void test_ai_model_files(struct test *t);
+void test_ai_int8(struct test *t);
+void test_mlp_q8(struct test *t);
+void test_cnn_q8(struct test *t);
+void test_mlp_precision(struct test *t);
+void test_cnn_precision(struct test *t);
+void test_rnn_precision(struct test *t);
+void test_transformer_precision(struct test *t);
+
+/* test_tech.c */
+void test_tech_catalog(struct test *t);
+void test_tech_index(struct test *t);
+void test_tech_columns(struct test *t);
+
+/* test_cli.c */
+void test_cli_batch(struct test *t);
+void test_cli_p2p_stats(struct test *t);
+void test_cli_plugins(struct test *t);
+void test_cli_plugin_open(struct test *t);
+
+/* test_checkpoint.c */
+void test_ckpt_snapshot(struct test *t);
+void test_ckpt_skip(struct test *t);
+void test_ckpt_restore(struct test *t);
+void test_ckpt_restart(struct test *t);
+
+/* test_trace.c */
+void test_trace_zones(struct test *t);
+
+#endif /* HOLOS_TESTS_H */